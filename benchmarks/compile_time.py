@@ -0,0 +1,263 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+    TPP-MLIR Compile-Time Benchmark
+
+    Tracks the compile time and memory of the pipeline as models grow.
+
+    Generates MLPs of increasing depth with `mlir-gen` (constant weights), then
+    compiles each of them with `tpp-opt --default-pipeline` and with the
+    `tpp-run` code generation (`-emit=obj`). Both write their compile-time
+    report, which gives the time and the peak RSS by the end of each pass
+    bundle.
+
+    The time of the tracked passes and bundles should grow linearly with the
+    number of layers. When it grows faster between two depths, by more than
+    the tolerance, it is flagged as superlinear and the run fails.
+
+    Usage:
+     compile_time.py --build <build-dir> --layers 10,100,1000 --size 256
+"""
+
+import os
+import sys
+import argparse
+import json
+import tempfile
+import subprocess
+import time
+
+sys.path.append(os.path.join(os.path.dirname(__file__), "harness"))
+
+from Logger import Logger
+from TPPHelper import TPPHelper
+
+# Passes and bundles whose scaling is checked
+TRACKED = [
+    "constant-fold-pack",
+    "tile-consumer-and-fuse-producers",
+    "one-shot-bufferize",
+    "bufferize",
+]
+
+# Times below this are too noisy to compare, in seconds
+MIN_TIME = 0.05
+
+
+class Measure(object):
+    """Runs a command, returns its wall time, peak RSS and report"""
+
+    def __init__(self, loglevel):
+        self.logger = Logger("compile.measure", loglevel)
+
+    def run(self, command, report):
+        self.logger.debug(f"Executing: {' '.join(command)}")
+        start = time.perf_counter()
+        process = subprocess.Popen(
+            command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE
+        )
+        stderr = process.stderr.read().decode("utf-8")
+        # wait4 returns the resource usage of that child only
+        _, status, usage = os.wait4(process.pid, 0)
+        wallTime = time.perf_counter() - start
+        process.returncode = os.waitstatus_to_exitcode(status)
+        if process.returncode != 0:
+            self.logger.error(f"Command failed: {' '.join(command)}")
+            self.logger.error(stderr)
+            return None
+        with open(report) as reportFile:
+            result = json.load(reportFile)
+        result["wall_time"] = wallTime
+        result["process_rss_kb"] = usage.ru_maxrss
+        return result
+
+
+class CompileTimeBenchmark(object):
+    """Compiles MLPs of increasing depth and checks the scaling"""
+
+    def __init__(self, args, loglevel):
+        self.logger = Logger("compile.bench", loglevel)
+        self.args = args
+        self.measure = Measure(loglevel)
+        helper = TPPHelper(loglevel)
+        programs = helper.findTPPProgs(args.build)
+        if not programs:
+            raise FileNotFoundError("Cannot find the TPP programs")
+        self.bin_dir = os.path.dirname(programs["tpp-opt"])
+        self.layers = [int(n) for n in args.layers.split(",")]
+        self.results = {}
+
+    def _tool(self, name):
+        return os.path.join(self.bin_dir, name)
+
+    def generate(self, layers, path):
+        sizes = ",".join([str(self.args.size)] * (layers + 1))
+        command = [
+            self._tool("mlir-gen"),
+            "--kernel=const",
+            f"--batch={self.args.batch}",
+            f"--layers={sizes}",
+            f"--tiles={self.args.tiles}",
+            "--bias",
+            "--relu",
+            f"--float-type={self.args.float_type}",
+            "-o",
+            path,
+        ]
+        self.logger.debug(f"Executing: {' '.join(command)}")
+        res = subprocess.run(command, capture_output=True, encoding="utf-8")
+        if res.returncode != 0:
+            self.logger.error(f"Cannot generate {layers} layers")
+            self.logger.error(res.stderr)
+            return False
+        return True
+
+    def compile(self, layers, tmpDir):
+        source = os.path.join(tmpDir, f"mlp-{layers}.mlir")
+        report = os.path.join(tmpDir, f"report-{layers}.json")
+        if not self.generate(layers, source):
+            return False
+        self.logger.info(f"Compiling {layers} layers")
+
+        opt = [
+            self._tool("tpp-opt"),
+            source,
+            "--default-pipeline",
+            f"-compile-time-report={report}",
+            "-o",
+            os.devnull,
+        ]
+        optResult = self.measure.run(opt, report)
+
+        run = [
+            self._tool("tpp-run"),
+            source,
+            "-e",
+            "entry",
+            "-entry-point-result=void",
+            "-emit=obj",
+            f"-emit-output={os.path.join(tmpDir, 'kernel.o')}",
+            f"-compile-time-report={report}",
+        ]
+        runResult = self.measure.run(run, report)
+        if not optResult or not runResult:
+            return False
+        self.results[layers] = {"tpp-opt": optResult, "tpp-run": runResult}
+        return True
+
+    def run(self):
+        with tempfile.TemporaryDirectory() as tmpDir:
+            for layers in self.layers:
+                if not self.compile(layers, tmpDir):
+                    return False
+        return True
+
+    def _time(self, result, name):
+        for key in ["bundles", "tracked_passes"]:
+            if name in result[key]:
+                return result[key][name]
+        return None
+
+    def checkScaling(self):
+        """Flags the times that grow faster than the number of layers"""
+
+        superlinear = []
+        for tool in ["tpp-opt", "tpp-run"]:
+            for small, large in zip(self.layers, self.layers[1:]):
+                growth = large / small
+                for name in TRACKED + ["wall_time"]:
+                    if name == "wall_time":
+                        before = self.results[small][tool][name]
+                        after = self.results[large][tool][name]
+                    else:
+                        before = self._time(self.results[small][tool], name)
+                        after = self._time(self.results[large][tool], name)
+                    if before is None or after is None or after < MIN_TIME:
+                        continue
+                    ratio = after / max(before, MIN_TIME)
+                    if ratio > growth * self.args.tolerance:
+                        superlinear.append(
+                            f"{tool} {name}: {ratio:.1f}x slower for "
+                            f"{growth:.1f}x the layers ({small} to {large})"
+                        )
+        return superlinear
+
+    def printResults(self):
+        for tool in ["tpp-opt", "tpp-run"]:
+            print(f"Benchmark: {tool}")
+            for layers in self.layers:
+                result = self.results[layers][tool]
+                print(
+                    f"{layers:6} layers: {result['wall_time']:9.3f} s, "
+                    f"{result['process_rss_kb'] / 1024:9.1f} MiB"
+                )
+                for bundle, seconds in result["bundles"].items():
+                    rss = result["bundle_peak_rss_kb"].get(bundle, 0)
+                    print(
+                        f"  {bundle:30}: {seconds:9.3f} s, "
+                        f"{rss / 1024:9.1f} MiB"
+                    )
+                for pass_, seconds in result["tracked_passes"].items():
+                    print(f"  {pass_:30}: {seconds:9.3f} s")
+                for phase, seconds in result["phases"].items():
+                    print(f"  {phase:30}: {seconds:9.3f} s")
+            print("")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+        description="TPP-MLIR Compile-Time Benchmark"
+    )
+    parser.add_argument(
+        "--build", type=str, default="", help="Path to the build dir"
+    )
+    parser.add_argument(
+        "--layers",
+        type=str,
+        default="10,100,1000",
+        help="Comma-separated numbers of layers, in increasing order",
+    )
+    parser.add_argument(
+        "--size", type=int, default=256, help="Size of each layer"
+    )
+    parser.add_argument("--batch", type=int, default=256, help="Batch size")
+    parser.add_argument(
+        "--tiles", type=str, default="32,32,32", help="Tile sizes (N,K,C)"
+    )
+    parser.add_argument(
+        "--float-type", type=str, default="f32", help="Float type"
+    )
+    parser.add_argument(
+        "--tolerance",
+        type=float,
+        default=1.5,
+        help="Growth over the linear one before flagging a time",
+    )
+    parser.add_argument(
+        "-v",
+        "--verbose",
+        action="count",
+        default=0,
+        help="The verbosity of logging output",
+    )
+    parser.add_argument(
+        "-q", "--quiet", action="count", default=0, help="Suppress warnings"
+    )
+    args = parser.parse_args()
+
+    loglevel = args.verbose - (args.quiet > 0)
+    logger = Logger("compile", loglevel)
+
+    if not args.build:
+        args.build = TPPHelper(loglevel).findGitRoot(os.getcwd())
+    benchmark = CompileTimeBenchmark(args, loglevel)
+    if not benchmark.run():
+        logger.error("Error compiling the benchmarks")
+        sys.exit(1)
+    benchmark.printResults()
+
+    superlinear = benchmark.checkScaling()
+    for msg in superlinear:
+        logger.error(f"Superlinear compile time: {msg}")
+    sys.exit(1 if superlinear else 0)
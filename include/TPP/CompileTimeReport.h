@@ -0,0 +1,57 @@
+//===- CompileTimeReport.h - Compile-time breakdown of the pipeline -------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TPP_COMPILETIMEREPORT_H
+#define TPP_COMPILETIMEREPORT_H
+
+#include "mlir/Pass/PassManager.h"
+#include "llvm/ADT/MapVector.h"
+
+#include <mutex>
+#include <string>
+
+namespace mlir {
+namespace tpp {
+
+// Compile-time breakdown of the TPP pipeline, at the granularity of its pass
+// bundles, plus the slowest individual passes, the passes known to scale with
+// the module, the phases timed outside of the pass manager (e.g. the LLVM
+// optimizer) and the peak RSS, overall and by the end of each bundle.
+//
+// Passes nested on functions are summed over all functions, so their times
+// can exceed the wall time on a multi-threaded context.
+class CompileTimeReport {
+public:
+  // Times the passes of the pass manager, including the pass bundles that run
+  // dynamic pipelines.
+  void attach(PassManager &pm);
+
+  // Records a phase timed outside of the pass manager.
+  void addPhase(StringRef name, double seconds);
+
+  // Prints the report as a JSON object.
+  void print(raw_ostream &os) const;
+
+  // Writes the report to a file, "-" is stderr.
+  LogicalResult write(StringRef filename) const;
+
+  // Accumulates the time of a pass, called by the pass instrumentation.
+  void addPassTime(StringRef pass, double seconds);
+
+private:
+  mutable std::mutex mutex;
+  llvm::MapVector<std::string, double> bundles;
+  llvm::MapVector<std::string, int64_t> bundlePeakRSS;
+  llvm::StringMap<double> passes;
+  llvm::MapVector<std::string, double> phases;
+};
+
+} // namespace tpp
+} // namespace mlir
+
+#endif // TPP_COMPILETIMEREPORT_H
@@ -57,10 +57,10 @@ struct FusedMatch {
   BrgemmOp brgemmOp;
   // This is the (optional) binary op that follows the GEMM
   BinaryOp binaryOp;
-  BinaryKind binaryKind;
+  BinaryKind binaryKind = BinaryKind::NONE;
   // This is the (optional) unary op that follows the GEMM/Binary
   UnaryOp unaryOp;
-  UnaryKind unaryKind;
+  UnaryKind unaryKind = UnaryKind::NONE;
 };
 
 namespace utils {
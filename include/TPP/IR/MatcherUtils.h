@@ -9,6 +9,8 @@
 #ifndef TPP_IR_MATCHERUTILS_H
 #define TPP_IR_MATCHERUTILS_H
 
+#include "mlir/Support/LLVM.h"
+
 namespace mlir {
 class Value;
 namespace linalg {
@@ -32,6 +34,34 @@ bool isTwoDSubOp(linalg::LinalgOp linalgOp,
 bool isTwoDMulOp(linalg::LinalgOp linalgOp,
                  SmallVectorImpl<Value> *capturedOperands = nullptr);
 
+// Returns true if the linalg operation is a 2d eltwsie floating point
+// division.
+bool isTwoDDivOp(linalg::LinalgOp linalgOp,
+                 SmallVectorImpl<Value> *capturedOperands = nullptr);
+
+// Returns true if the linalg operation is a floating point sum of one of the
+// dimensions of a 2d input into a 1d output.
+bool isTwoDReduceAddOp(linalg::LinalgOp linalgOp,
+                       SmallVectorImpl<Value> *capturedOperands = nullptr);
+
+// Returns true if the linalg operation is a floating point max of one of the
+// dimensions of a 2d input into a 1d output.
+bool isTwoDReduceMaxOp(linalg::LinalgOp linalgOp,
+                       SmallVectorImpl<Value> *capturedOperands = nullptr);
+
+// Returns true if the linalg operation is a floating point sum of the squares
+// of a 2d input along one of its dimensions, e.g., the mean square of an RMS
+// normalization.
+bool isTwoDReduceSquareOp(linalg::LinalgOp linalgOp,
+                          SmallVectorImpl<Value> *capturedOperands = nullptr);
+
+// Returns true if the linalg operation is a floating point sum of the squares
+// of the difference of a 2d input and of a broadcast 1d input along one of
+// the dimensions, e.g., the variance of a layer normalization.
+bool isTwoDReduceSquaredDiffOp(
+    linalg::LinalgOp linalgOp,
+    SmallVectorImpl<Value> *capturedOperands = nullptr);
+
 // Returns true if the linalg.generic is a 2d eltwise floating point fill
 // operation with zeros.
 bool isTwoDZeroOp(linalg::LinalgOp linalgOp,
@@ -42,6 +72,16 @@ bool isTwoDZeroOp(linalg::LinalgOp linalgOp,
 bool isTwoDReluOp(linalg::LinalgOp linalgOp,
                   SmallVectorImpl<Value> *capturedOperands = nullptr);
 
+// Returns true if the linalg.generic is a 2d eltwise floating point
+// exponential.
+bool isTwoDExpOp(linalg::LinalgOp linalgOp,
+                 SmallVectorImpl<Value> *capturedOperands = nullptr);
+
+// Returns true if the linalg.generic is a 2d eltwise floating point
+// subtraction followed by an exponential.
+bool isTwoDSubExpOp(linalg::LinalgOp linalgOp,
+                    SmallVectorImpl<Value> *capturedOperands = nullptr);
+
 // Returns true if the linalg.generic is a 2d floating point copy operation.
 bool isTwoDIdentityOp(linalg::LinalgOp linalgOp,
                       SmallVectorImpl<Value> *capturedOperands = nullptr);
@@ -60,6 +100,50 @@ bool isTwoDTransposeOp(linalg::LinalgOp linalgOp,
 bool isTwoDFillOpWithZeros(linalg::LinalgOp linalgOp,
                            SmallVectorImpl<Value> *capturedOperands = nullptr);
 
+// Returns true if the linalg operation looks up rows of a 2d table captured by
+// its body, given by a 1d or 2d input of indices: either a gather of one row
+// per output row or an embedding bag adding the rows of each bag into the
+// output row. The captured operands are the table, the indices and the output.
+bool isEmbeddingBagOp(linalg::LinalgOp linalgOp,
+                      SmallVectorImpl<Value> *capturedOperands = nullptr);
+
+// Returns true if the linalg operation is a rotary position embedding of the
+// pairs of consecutive elements of the queries or keys, on a view of them
+// with a trailing dimension of 2. The input is read twice, at 0 and 1 along
+// it, and the rotated element of the pair is selected by `linalg.index` of
+// the last loop. The cosines and sines are inputs, or computed by math.cos
+// and math.sin of an input of angles. The captured operands are the input,
+// the cosines, the sines (the angles for both if computed) and the output.
+bool isRotaryEmbeddingOp(linalg::LinalgOp linalgOp,
+                         SmallVectorImpl<Value> *capturedOperands = nullptr);
+
+// Categories of the linalg operations, one per predicate above.
+enum class OpKind : unsigned {
+  Add,
+  Sub,
+  Mul,
+  Div,
+  ReduceAdd,
+  ReduceMax,
+  ReduceSquare,
+  ReduceSquaredDiff,
+  Zero,
+  Relu,
+  Exp,
+  SubExp,
+  Identity,
+  BiasRelu,
+  Transpose,
+  FillWithZeros,
+  EmbeddingBag,
+  RotaryEmbedding,
+};
+
+// Returns true if the predicate of the category `kind` holds for the linalg
+// operation. The operands are only captured if it does.
+bool isOpOfKind(linalg::LinalgOp linalgOp, OpKind kind,
+                SmallVectorImpl<Value> *capturedOperands = nullptr);
+
 // Return a pair where the first member is true if and only if the operation
 // represents a brgemm in VNNI layout. The second member tells if the brgemm has
 // the batch dimension; it has meaning only if the first field is valid.
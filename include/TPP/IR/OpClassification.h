@@ -0,0 +1,70 @@
+//===- OpClassification.h ---------------------------------------*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Memoized classification of the linalg operations into the categories of
+// MatcherUtils.h. The passes converting them try several categories on every
+// operation, and again on every iteration of the rewrite driver; each
+// predicate runs once per operation instead.
+//
+// The classification is an analysis, so that the following passes reuse it as
+// long as it is preserved. It must listen to the rewrites of the passes that
+// preserve it, the operations they change are classified again.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TPP_IR_OPCLASSIFICATION_H
+#define TPP_IR_OPCLASSIFICATION_H
+
+#include "TPP/IR/MatcherUtils.h"
+#include "mlir/IR/PatternMatch.h"
+#include "llvm/ADT/DenseMap.h"
+
+namespace mlir {
+namespace structured_match {
+
+class OpClassification : public RewriterBase::Listener {
+public:
+  explicit OpClassification(Operation *) {}
+
+  // Returns true if the linalg operation is of the category `kind`. The
+  // operands are not memoized, the predicate runs again to capture them.
+  bool isOpOfKind(linalg::LinalgOp linalgOp, utils::OpKind kind,
+                  SmallVectorImpl<Value> *capturedOperands = nullptr);
+
+  void notifyOperationInserted(Operation *op,
+                               OpBuilder::InsertPoint previous) override;
+  void notifyOperationModified(Operation *op) override;
+  void notifyOperationErased(Operation *op) override;
+
+private:
+  // Forgets the classes of the operation, of its users, whose operand types
+  // may change, and of the operations it is nested in, whose body changes.
+  void forget(Operation *op);
+
+  // Categories tried and matched, one bit per kind.
+  struct Classes {
+    uint32_t tried = 0;
+    uint32_t matched = 0;
+  };
+  llvm::DenseMap<Operation *, Classes> classes;
+};
+
+// Returns true if the linalg operation is of the category `kind`, from the
+// classification if any.
+inline bool isOpOfKind(OpClassification *classification,
+                       linalg::LinalgOp linalgOp, utils::OpKind kind,
+                       SmallVectorImpl<Value> *capturedOperands = nullptr) {
+  if (classification)
+    return classification->isOpOfKind(linalgOp, kind, capturedOperands);
+  return utils::isOpOfKind(linalgOp, kind, capturedOperands);
+}
+
+} // namespace structured_match
+} // namespace mlir
+
+#endif // TPP_IR_OPCLASSIFICATION_H
@@ -18,10 +18,18 @@ namespace affine {
 class AffineDialect;
 } // namespace affine
 
+namespace amx {
+class AMXDialect;
+} // namespace amx
+
 namespace arith {
 class ArithDialect;
 } // namespace arith
 
+namespace async {
+class AsyncDialect;
+} // namespace async
+
 namespace check {
 class CheckDialect;
 } // namespace check
@@ -30,6 +38,10 @@ namespace bufferization {
 class BufferizationDialect;
 } // namespace bufferization
 
+namespace cf {
+class ControlFlowDialect;
+} // namespace cf
+
 namespace func {
 class FuncOp;
 class FuncDialect;
@@ -56,6 +68,14 @@ namespace memref {
 class MemRefDialect;
 } // namespace memref
 
+namespace NVVM {
+class NVVMDialect;
+} // namespace NVVM
+
+namespace nvgpu {
+class NVGPUDialect;
+} // namespace nvgpu
+
 namespace perf {
 class PerfDialect;
 } // namespace perf
@@ -88,6 +108,10 @@ namespace vector {
 class VectorDialect;
 } // namespace vector
 
+namespace x86vector {
+class X86VectorDialect;
+} // namespace x86vector
+
 namespace xsmm {
 class XsmmDialect;
 } // namespace xsmm
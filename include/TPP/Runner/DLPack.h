@@ -0,0 +1,74 @@
+//===- DLPack.h - DLPack tensor declarations ---------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The tensors of the DLPack exchange format, as declared by dlpack/dlpack.h,
+// which the engine takes to run kernels on the buffers of other frameworks,
+// e.g. torch.utils.dlpack.to_dlpack. The declarations of dlpack.h are used
+// instead when it is included first, the layouts are the same.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TPP_RUNNER_DLPACK_H
+#define TPP_RUNNER_DLPACK_H
+
+#include <cstdint>
+
+#if !defined(DLPACK_VERSION) && !defined(DLPACK_MAJOR_VERSION)
+
+extern "C" {
+
+typedef enum {
+  kDLCPU = 1,
+  kDLCUDA = 2,
+  kDLCUDAHost = 3,
+} DLDeviceType;
+
+typedef struct {
+  DLDeviceType device_type;
+  int32_t device_id;
+} DLDevice;
+
+typedef enum {
+  kDLInt = 0U,
+  kDLUInt = 1U,
+  kDLFloat = 2U,
+  kDLOpaqueHandle = 3U,
+  kDLBfloat = 4U,
+  kDLComplex = 5U,
+  kDLBool = 6U,
+} DLDataTypeCode;
+
+typedef struct {
+  uint8_t code;
+  uint8_t bits;
+  uint16_t lanes;
+} DLDataType;
+
+/// A tensor of `ndim` dimensions at `data` + `byte_offset`. The strides are in
+/// elements, NULL for a compact row-major tensor.
+typedef struct {
+  void *data;
+  DLDevice device;
+  int32_t ndim;
+  DLDataType dtype;
+  int64_t *shape;
+  int64_t *strides;
+  uint64_t byte_offset;
+} DLTensor;
+
+typedef struct DLManagedTensor {
+  DLTensor dl_tensor;
+  void *manager_ctx;
+  void (*deleter)(struct DLManagedTensor *self);
+} DLManagedTensor;
+
+} // extern "C"
+
+#endif // !DLPACK_VERSION && !DLPACK_MAJOR_VERSION
+
+#endif // TPP_RUNNER_DLPACK_H
@@ -0,0 +1,249 @@
+//===- Engine.h - Embeddable compile-and-execute API -------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Library interface of the compiler and the JIT, for applications that run the
+// kernels in process instead of through tpp-run. An engine compiles the kernels
+// of MLIR sources with the default pipeline and returns handles that run them
+// on memref descriptors:
+//
+//   tpp::EngineOptions options;
+//   options.pipelineOptions = {{"def-parallel", "true"}};
+//   auto engine = tpp::Engine::create(options);
+//   auto kernel = (*engine)->load(source, "entry");
+//   StridedMemRefType<float, 2> a = ..., b = ..., c = ...;
+//   (*kernel)->invoke(a, b, c);
+//
+// The kernels take their tensor arguments as memrefs and write their tensor
+// results in place, in the memrefs following the arguments. The engine caches
+// the compiled kernels, loading the same source again does not compile it
+// again. The threads of the parallel runtimes and the dispatched LIBXSMM
+// kernels are process-wide, the engines share them. Kernels called from
+// different threads can run on disjoint cores with thread teams:
+//
+//   tpp::ThreadTeam team({0, 1, 2, 3});
+//   team.join();
+//   (*kernel)->invoke(a, b, c);
+//
+// The kernels also run on DLPack tensors, e.g. of PyTorch, in place when their
+// layout allows it:
+//
+//   const DLTensor *tensors[] = {&a->dl_tensor, &b->dl_tensor, &c->dl_tensor};
+//   (*kernel)->invoke(ArrayRef<const DLTensor *>(tensors));
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TPP_RUNNER_ENGINE_H
+#define TPP_RUNNER_ENGINE_H
+
+#include "TPP/Runner/DLPack.h"
+#include "mlir/ExecutionEngine/CRunnerUtils.h"
+#include "mlir/ExecutionEngine/ExecutionEngine.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/IR/MLIRContext.h"
+#include "mlir/Support/LogicalResult.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace mlir {
+namespace tpp {
+
+/// Kind of the elements of a buffer of a kernel.
+enum class ElementKind { Integer, Float, BFloat };
+
+/// Static shape and element type of a buffer of a kernel.
+struct KernelBuffer {
+  SmallVector<int64_t> shape;
+  unsigned elementBytes;
+  ElementKind elementKind;
+  /// Whether the kernel writes the buffer: memref arguments and tensor
+  /// results.
+  bool inPlace = false;
+
+  /// Size of the buffer, in bytes.
+  int64_t getNumBytes() const;
+};
+
+/// Entry point of a kernel and its buffers: its arguments, then its tensor
+/// results.
+struct KernelSignature {
+  std::string entryName;
+  SmallVector<KernelBuffer> args;
+  SmallVector<KernelBuffer> results;
+};
+
+/// Adds the entry point of a kernel to the module: a function with the C
+/// interface taking the buffers of the arguments and of the results of the
+/// kernel as memrefs, which calls the kernel and writes its results in place.
+/// Fails if the kernel is not found or takes or returns anything but
+/// statically shaped tensors and memrefs with the identity layout.
+FailureOr<KernelSignature> createKernelEntry(ModuleOp module,
+                                             StringRef kernelName);
+
+/// Memref descriptor of a buffer passed to a kernel, with its shape to check
+/// it against the signature.
+struct KernelBufferRef {
+  void *descriptor;
+  int64_t rank;
+  const int64_t *sizes;
+  unsigned elementBytes;
+};
+
+/// Returns the reference of a memref descriptor of the C runner utils.
+template <typename T, int N>
+KernelBufferRef getKernelBufferRef(StridedMemRefType<T, N> &memref) {
+  if constexpr (N == 0)
+    return {&memref, 0, nullptr, sizeof(T)};
+  else
+    return {&memref, N, memref.sizes, sizeof(T)};
+}
+
+/// Returns the strided memref descriptor of a buffer of `shape` at `data`, with
+/// the identity layout: the allocated and aligned pointers, the offset, the
+/// sizes and the strides.
+SmallVector<int64_t> createMemRefDescriptor(void *data,
+                                            ArrayRef<int64_t> shape);
+
+/// Returns the reference of a descriptor of createMemRefDescriptor, which must
+/// not move while it is in use.
+KernelBufferRef getKernelBufferRef(MutableArrayRef<int64_t> descriptor,
+                                   const KernelBuffer &buffer);
+
+/// A compiled kernel.
+class Kernel {
+public:
+  /// JIT-compiles `module`, lowered to LLVM, which has the entry point of
+  /// `signature` (see createKernelEntry).
+  static FailureOr<std::unique_ptr<Kernel>>
+  create(ModuleOp module, KernelSignature signature,
+         const ExecutionEngineOptions &options);
+
+  const KernelSignature &getSignature() const { return signature; }
+
+  /// Runs the kernel on the buffers of its arguments, then of its results.
+  /// Fails if they do not match the signature.
+  LogicalResult invoke(ArrayRef<KernelBufferRef> buffers);
+
+  /// Runs the kernel on the memref descriptors of its arguments, then of its
+  /// results, e.g. `StridedMemRefType<float, 2>`.
+  template <typename... Ts, int... Ns>
+  LogicalResult invoke(StridedMemRefType<Ts, Ns> &...descriptors) {
+    SmallVector<KernelBufferRef> buffers{getKernelBufferRef(descriptors)...};
+    return invoke(ArrayRef<KernelBufferRef>(buffers));
+  }
+
+  /// Runs the kernel on the DLPack tensors of its arguments, then of its
+  /// results, on the CPU. The kernel reads and writes the tensors in place
+  /// when they are row-major and aligned to their elements, otherwise on
+  /// packed copies, copied back to the tensors it writes. Fails if they do not
+  /// match the signature.
+  LogicalResult invoke(ArrayRef<const DLTensor *> tensors);
+
+private:
+  Kernel(std::unique_ptr<ExecutionEngine> engine, KernelSignature signature);
+
+  std::unique_ptr<ExecutionEngine> engine;
+  KernelSignature signature;
+  std::string entryName;
+};
+
+/// Threads of the task runtime bound to their own CPUs, to run kernels side by
+/// side on disjoint cores instead of on the threads of the whole process. The
+/// parallel loops of the kernels a thread invokes run on the team it joined,
+/// for the kernels compiled with {"parallel-runtime", "tasks"}: OpenMP keeps a
+/// single pool per process.
+class ThreadTeam {
+public:
+  /// Starts a thread per CPU of `cpus` but the first one, which is the CPU of
+  /// the thread joining the team.
+  explicit ThreadTeam(ArrayRef<unsigned> cpus);
+  ~ThreadTeam();
+
+  ThreadTeam(const ThreadTeam &) = delete;
+  ThreadTeam &operator=(const ThreadTeam &) = delete;
+
+  unsigned getNumThreads() const { return numThreads; }
+
+  /// Runs the parallel loops of the calling thread on the team, which takes a
+  /// single thread at a time, and binds the thread to the first CPU.
+  void join();
+
+  /// Runs the parallel loops of the calling thread on the default pool again.
+  static void leave();
+
+private:
+  void *team;
+  unsigned numThreads;
+};
+
+/// Options of an engine.
+struct EngineOptions {
+  /// Options of the default pipeline by name, as given to tpp-run, e.g.
+  /// {"def-parallel", "true"} or {"parallel-task-grid", "4,8"}. The options
+  /// not given keep their defaults.
+  SmallVector<std::pair<std::string, std::string>> pipelineOptions;
+  /// LLVM optimization and code generation level.
+  unsigned optLevel = 3;
+  /// Libraries the kernels are linked against: the runtimes of the XSMM and
+  /// MLIR runner utils (libtpp_xsmm_runner_utils, libmlir_c_runner_utils),
+  /// unless the application links them.
+  SmallVector<std::string> sharedLibPaths;
+  /// Threads of the parallel runtimes, 0 for TPP_NUM_THREADS, OMP_NUM_THREADS
+  /// or the hardware threads. The runtimes read it when the first parallel
+  /// loop starts, the first engine sets it for the process.
+  unsigned numThreads = 0;
+};
+
+/// Compiles the kernels of MLIR sources and keeps them. The engine is thread
+/// safe, the compilations are serialized.
+class Engine {
+public:
+  static FailureOr<std::unique_ptr<Engine>> create(EngineOptions options);
+
+  /// Returns the kernel `kernelName` of the MLIR `source`, compiled on the
+  /// first load. The kernel lives as long as the engine.
+  FailureOr<Kernel *> load(StringRef source, StringRef kernelName);
+
+  /// Returns the kernel `kernelName` of `module`, which is compiled in place.
+  /// The module is not cached.
+  FailureOr<std::unique_ptr<Kernel>> compile(ModuleOp module,
+                                             StringRef kernelName);
+
+  MLIRContext &getContext() { return context; }
+
+private:
+  explicit Engine(EngineOptions options);
+
+  FailureOr<std::unique_ptr<Kernel>> compileLocked(ModuleOp module,
+                                                   StringRef kernelName);
+
+  EngineOptions options;
+  MLIRContext context;
+  std::mutex mutex;
+  // Kernels by hash of their source and name.
+  llvm::StringMap<std::unique_ptr<Kernel>> kernels;
+};
+
+} // namespace tpp
+} // namespace mlir
+
+/// C entry point of the kernels on DLPack tensors, for the bindings holding
+/// the kernel as an opaque handle: runs the `tpp::Kernel` `kernel` on the
+/// `numTensors` tensors of `tensors` (see Kernel::invoke). Returns 0 on
+/// success.
+extern "C" int tpp_kernel_invoke_dlpack(void *kernel,
+                                        const DLTensor *const *tensors,
+                                        int32_t numTensors);
+
+#endif // TPP_RUNNER_ENGINE_H
@@ -49,6 +49,13 @@ struct MLIRBenchConfig {
   TensorInitType initType = TensorInitType::Auto;
   std::string backend = "cpu";
   bool offloadToDevice = true;
+  bool sharedMemory = false;
+  bool jsonOutput = false;
+  std::string inputDir;
+  bool runtimeInit = false;
+  std::string numaPolicy;
+  int64_t hugePageSize = 0;
+  llvm::SmallVector<int64_t> dynamicSizes;
 };
 
 /// MLIRBench - Creates wrapper for calling kernel methods.
@@ -73,6 +80,12 @@ class MLIRBench {
   /// Values of the kernel arguments (no need to declare every time)
   llvm::SmallVector<Value> kernelArgs;
 
+  /// Kernel tensor arguments updated in place on the device, as pairs of
+  /// the argument and the result it is returned as. Each call passes on the
+  /// result of the previous one, so that all the calls run in place on the
+  /// same device buffers
+  llvm::SmallVector<std::pair<unsigned, unsigned>> residentOutputs;
+
   /// Main wrapper function, calls kernel
   func::FuncOp main;
 
@@ -94,16 +107,85 @@ class MLIRBench {
   /// Allocate arguments on target device
   bool offloadToDevice;
 
+  /// The target device shares the host memory, e.g. an integrated GPU
+  bool sharedMemory;
+
+  /// Report results as JSON instead of printing them
+  bool jsonOutput;
+
+  /// Directory of tensor files to map into the kernel arguments, if any
+  std::string inputDir;
+
+  /// Initialize the kernel arguments at runtime instead of using globals
+  bool runtimeInit;
+
+  /// NUMA placement of the kernel arguments (interleave, first-touch, shard),
+  /// if any
+  std::string numaPolicy;
+
+  /// Huge page size of the kernel arguments in bytes, 0 for regular pages
+  int64_t hugePageSize;
+
+  /// Sizes of the dynamic dimensions of the kernel arguments, in order. The
+  /// last one repeats, so that a single size sets them all.
+  llvm::SmallVector<int64_t> dynamicSizes;
+
+  /// Prefix of the JSON report keys, to tell the results of kernels apart
+  std::string reportPrefix;
+
+  /// Hardware counters buffer of the last benchmarking loop, if collected
+  Value counters;
+
+  /// Energy buffer of the last benchmarking loop, if collected, and its
+  /// number of iterations
+  Value energy;
+  unsigned energyIters = 0;
+
+  /// Allocates the energy buffer of a benchmarking loop of `iters`
+  /// iterations and starts the energy counters
+  /// Returns the energy counters
+  Value startEnergy(unsigned iters);
+
   /// Gets module's main block
   Block &getModuleBlock();
 
   /// Gets main wrappers's block
   Block &getMainBlock();
 
+  /// Returns the static shape of `type` with the dynamic sizes, starting at
+  /// the dynamic size `next`, which is updated. Fails if there are not
+  /// enough sizes.
+  FailureOr<llvm::SmallVector<int64_t>> getStaticShape(ShapedType type,
+                                                       unsigned &next);
+
+  /// Maps the tensor file of the argument, argN.npy or argN.bin in the input
+  /// directory, into a memref. Returns a null value if there is no such file.
+  Value mapInputFile(unsigned argIdx, MemRefType memRefTy);
+
+  /// Allocates the buffer of a kernel argument, with the NUMA policy and
+  /// huge pages if requested. With `shard`, its outermost dimension is split
+  /// over the NUMA nodes.
+  Value createKernelArgBuffer(MemRefType memRefTy, bool shard);
+
+  /// Zeroes a buffer from the threads of a parallel loop, so that its pages
+  /// are placed on the NUMA nodes of the threads using them.
+  void firstTouch(Value buf);
+
+  /// Fills a buffer at runtime with the tensor initializer, keeping the IR
+  /// size independent of the tensor size.
+  void initTensorAtRuntime(Value buf);
+
   // Expose memref buffer to GPU
   // Returns registered buffer
   Value registerOnGpu(Value buf, MemRefType memRefTy);
 
+  /// Finds the kernel tensor arguments that stay on the device between calls
+  void findResidentOutputs();
+
+  /// Passes the results of `call` as the resident arguments of the next calls
+  /// Returns the results carried over
+  llvm::SmallVector<Value> getResidentResults(Operation *call);
+
 public:
   /// Creates context, builder
   MLIRBench(Operation *op, const MLIRBenchConfig &config);
@@ -118,6 +200,17 @@ public:
   /// Renames the kernel to _name, so that we can create the wrapper
   LogicalResult renameKernel();
 
+  /// Gets or sets the kernel the arguments and benchmarks are created for
+  func::FuncOp getKernel() { return kernel; }
+  void setKernel(func::FuncOp func) { kernel = func; }
+
+  /// Sets the name of the main wrapper, when no kernel is renamed
+  void setMainName(llvm::StringRef name) { mainName = name; }
+
+  /// Labels the results of the following benchmarks with the kernel name:
+  /// printed before them in text mode, as a key prefix in JSON mode
+  void labelResults(llvm::StringRef name);
+
   /// Replace all dense splat tensors/memrefs with random values in the kernel
   LogicalResult replaceSplatWithRandom();
 
@@ -131,17 +224,89 @@ public:
   /// Creates and returns a call to the kernel.
   Operation *callKernel();
 
+  /// Clones the kernel as a private `<kernel>_reference` function, to be
+  /// lowered separately
+  func::FuncOp createReferenceKernel();
+
+  /// Calls the kernel and the reference kernel on the same inputs and checks
+  /// that their results (or memref arguments, if there are none) are almost
+  /// equal.
+  /// Returns the kernel call
+  Operation *callAndValidateKernel(func::FuncOp reference, double threshold);
+
   /// Create a benchmarking region around the kernel call
+  /// Optionally, collects hardware counters over the whole region,
+  /// subtracts the empty loop overhead from the timer delta and collects
+  /// the energy consumed over the whole region
   /// Returns the timer delta
-  Value createTimerLoop(unsigned);
+  Value createTimerLoop(unsigned, bool collectCounters = false,
+                        bool subtractOverhead = false,
+                        bool collectEnergy = false);
+
+  /// Create a loop around the kernel call timing each iteration
+  /// Optionally, collects hardware counters over the whole loop, flushes
+  /// the caches before each iteration (not timed) and collects the energy
+  /// consumed over the whole loop
+  /// Returns the buffer of per-iteration deltas
+  Value createSampledTimerLoop(unsigned, bool collectCounters = false,
+                               bool flushCache = false,
+                               bool collectEnergy = false);
+
+  /// Starts timing the GPU kernels of the following benchmarking loop on
+  /// the device
+  /// Returns the device timer
+  Value startDeviceTimer();
+
+  /// Stops the device timer and prints the mean kernel time per iteration
+  void printDeviceMean(Value timer, unsigned iters);
 
   /// Get the timer average/deviation of the specified benchmarking loop
+  /// or of the sampled deltas
   /// The stored deltas get invalidated afterwards
   Value getTimerStats(Value);
 
   /// Prints the stats of the bench loop
   void printMean(Value);
 
+  /// Prints the ( min, p50, p90, p99, max ) of the sampled deltas
+  void printSampleStats(Value);
+
+  /// Prints f64 values as a single vector, or reports them under the given
+  /// keys in JSON mode
+  void printValues(llvm::ArrayRef<Value>, llvm::ArrayRef<llvm::StringRef>);
+
+  /// Records a named scalar result for the JSON report
+  void report(llvm::StringRef, Value);
+
+  /// Statically estimates the kernel FLOPs (from linalg ops) and the
+  /// compulsory bytes moved (kernel arguments and results)
+  LogicalResult estimateKernelCost(int64_t &flops, int64_t &bytes);
+
+  /// Prints ( GFLOP/s, GB/s, FLOP/byte ) of the kernel for the mean time
+  LogicalResult printRoofline(Value mean);
+
+  /// Sets the number of threads of the following benchmark loops
+  void setNumThreads(unsigned);
+
+  /// Prints ( threads, mean, speedup, efficiency ) of a thread sweep step,
+  /// the speedup is relative to the base mean
+  void printScaling(unsigned numThreads, Value mean, Value baseMean);
+
+  /// Writes the sampled deltas to a file, one per line
+  void dumpDeltas(Value, llvm::StringRef);
+
+  /// Reports the sampled deltas as an array of the JSON report
+  void reportSamples(Value);
+
+  /// Prints the hardware counters of the last benchmarking loop
+  /// (cycles, instructions, L1D/L2/LLC misses, FP ops; -1 if unavailable)
+  void printCounters();
+
+  /// Prints the energy of the last benchmarking loop per iteration and the
+  /// energy efficiency of the kernel
+  /// (package J, DRAM J, GFLOP/J; -1 if unavailable)
+  void printEnergy();
+
   /// Prints a float value (used for mean/dev)
   void printVector(Value);
 
@@ -22,11 +22,21 @@ class GenericOp;
 class LinalgOp;
 class Conv2DNchwFchwOp;
 class Conv2DNhwcHwcfOp;
+class Conv2DNgchwFgchwOp;
+class DepthwiseConv2DNhwcHwcOp;
 class MatmulOp;
 class BatchReduceMatmulOp;
 class BatchMatmulOp;
 } // namespace linalg
 
+namespace scf {
+class ForOp;
+} // namespace scf
+
+namespace structured_match {
+class OpClassification;
+} // namespace structured_match
+
 namespace linalgx {
 
 // Attempt to map the current linalgOp to a BRGEMM.
@@ -41,6 +51,19 @@ FailureOr<SmallVector<Value>> rewriteToBRGemmOp(RewriterBase &rewriter,
 FailureOr<linalg::MatmulOp> rewriteConvToMatmul(RewriterBase &rewriter,
                                                 linalg::LinalgOp linalgOp);
 
+// Rewrite a blocked convolution to a BRGEMM operation reducing over the
+// blocks of C, with the loops materialized up to the four innermost:
+// [N][K'][P][R][S] [C'][Q][k][c]. The image is read in place through a
+// strided view, strides and dilations are supported.
+FailureOr<linalg::BatchReduceMatmulOp>
+rewriteConvToBrgemm(RewriterBase &rewriter, linalg::LinalgOp linalgOp);
+
+// Rewrite a blocked depthwise convolution to an element-wise multiply and
+// accumulate, with the filter broadcasted along the rows, with the loops
+// materialized up to the two innermost: [N][C'][P][R][S] [Q][c].
+FailureOr<linalg::GenericOp>
+rewriteDepthwiseConvToFma(RewriterBase &rewriter, linalg::LinalgOp linalgOp);
+
 // Attempt to block a Conv2DNchwFchwOp.
 FailureOr<linalg::GenericOp>
 packConv2DNchwFchwOp(RewriterBase &rewriter, linalg::Conv2DNchwFchwOp linalgOp,
@@ -51,6 +74,24 @@ FailureOr<linalg::GenericOp>
 packConv2DNhwcHwcfOp(RewriterBase &rewriter, linalg::Conv2DNhwcHwcfOp linalgOp,
                      ArrayRef<OpFoldResult> tiles);
 
+// Attempt to block the channels of a DepthwiseConv2DNhwcHwcOp.
+FailureOr<linalg::GenericOp>
+packDepthwiseConv2DNhwcHwcOp(RewriterBase &rewriter,
+                             linalg::DepthwiseConv2DNhwcHwcOp linalgOp,
+                             OpFoldResult tile);
+
+// Attempt to block the channels of a max, min or sum pooling in NHWC layout
+// (PoolingNhwcMaxOp, PoolingNhwcMinOp or PoolingNhwcSumOp).
+FailureOr<linalg::GenericOp> packPoolingNhwcOp(RewriterBase &rewriter,
+                                               linalg::LinalgOp linalgOp,
+                                               OpFoldResult tile);
+
+// Split a grouped Conv2DNgchwFgchwOp into a loop of Conv2DNchwFchwOp, one
+// per group.
+FailureOr<scf::ForOp>
+splitGroupedConv2DNgchwFgchwOp(RewriterBase &rewriter,
+                               linalg::Conv2DNgchwFgchwOp linalgOp);
+
 // Attempt to block a MatmulOp to VNNI format.
 FailureOr<linalg::GenericOp> packVNNIMatmulOp(RewriterBase &rewriter,
                                               linalg::GenericOp linalgOp);
@@ -67,7 +108,11 @@ collapseIterators(RewriterBase &rewriter, linalg::GenericOp genericOp,
 } // namespace linalgx
 
 namespace tpp {
-void populateLinalgToXsmmPatterns(RewritePatternSet &patterns, ArrayRef<StringRef> skipPatterns);
+// With a classification, the matches of the linalg operations are memoized,
+// its listener must be attached to the rewriter applying the patterns.
+void populateLinalgToXsmmPatterns(
+    RewritePatternSet &patterns, ArrayRef<StringRef> skipPatterns,
+    structured_match::OpClassification *classification = nullptr);
 void populateSimplifyPacking(RewritePatternSet &patterns);
 void populateSinkPackPatterns(RewritePatternSet &patterns);
 } // namespace tpp
@@ -0,0 +1,147 @@
+//===- BlockingCostModel.h ---------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TPP_TRANSFORMS_UTILS_BLOCKINGCOSTMODEL_H
+#define TPP_TRANSFORMS_UTILS_BLOCKINGCOSTMODEL_H
+
+#include "mlir/Support/LogicalResult.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+namespace mlir {
+class Operation;
+class ShapedType;
+class Type;
+
+namespace linalg {
+class LinalgOp;
+} // namespace linalg
+
+namespace tpp {
+
+// CPU parameters of the blocking cost model. The defaults describe a generic
+// AVX-512 core, each parameter can be overridden by an entry of the "CPU"
+// device of the module DLTI target system spec:
+//   L1_cache_size_in_bytes, L2_cache_size_in_bytes, L3_cache_size_in_bytes,
+//   max_vector_op_width (in bits), num_vector_registers, has_amx, has_sve,
+//   has_sme.
+struct CpuTargetInfo {
+  int64_t l1CacheSize = 32 * 1024;
+  int64_t l2CacheSize = 1024 * 1024;
+  int64_t l3CacheSize = 32 * 1024 * 1024;
+  int64_t vectorWidth = 512;
+  int64_t numVectorRegisters = 32;
+  bool hasAmx = false;
+  // Arm scalable vectors and the SME outer product tiles of the ZA array.
+  bool hasSve = false;
+  bool hasSme = false;
+
+  // Return the target parameters of `op`, from the DLTI spec of its module.
+  // With `fromTargetArch`, the vector register file and AMX support default
+  // to the ones of the target libxsmm selects (see LIBXSMM_TARGET) instead of
+  // AVX-512: 16 256-bit registers for AVX2, 32 128-bit ones for NEON and 32
+  // of the vector length for SVE, AMX from Sapphire Rapids. The scalable SVE
+  // and SME lowerings are only enabled by the DLTI spec (see `--fpu` of
+  // tpp-run).
+  static CpuTargetInfo get(Operation *op, bool fromTargetArch = false);
+
+  // Return true if the module of `op` describes its CPU caches via DLTI.
+  static bool isDescribed(Operation *op);
+};
+
+// Return the [M, N, K] block factors of a matmul-like `linalgOp` picked by the
+// cost model: the blocks with the highest arithmetic intensity whose working
+// set stays in L1, dividing the dimensions evenly and vectorizing fully along
+// N. K blocks are multiples of the VNNI factor for low precision types (and
+// of the AMX tile depth with AMX). Fails on dynamic or non-contraction ops.
+FailureOr<SmallVector<int64_t>>
+getMatmulBlockingFactors(linalg::LinalgOp linalgOp,
+                         const CpuTargetInfo &target);
+
+// Return true if an output of `type` is larger than the last level cache: its
+// lines are evicted before they are read again, so that it is better written
+// with non-temporal stores that skip the read for ownership. False for
+// dynamic shapes.
+bool isStreamingOutput(ShapedType type, const CpuTargetInfo &target);
+
+// Return true if the contractions on `elementType` are lowered to scalable
+// SVE vectors on `target`.
+bool useScalableVectors(Type elementType, const CpuTargetInfo &target);
+
+// Return true if the contractions on `elementType` are lowered to SME outer
+// products on `target`.
+bool useMatrixTiles(Type elementType, const CpuTargetInfo &target);
+
+// Return the number of vector registers used by the broadcast and FMA
+// micro-kernel of a `blockM` x `blockN` register tile of `elementType`: the
+// accumulators, the broadcast lhs values and the rhs row. The scalable kernel
+// walks N one vector at a time and only holds a column of the tile.
+int64_t getRegisterBlockPressure(int64_t blockM, int64_t blockN,
+                                 Type elementType, const CpuTargetInfo &target);
+
+// Return the [MR, NR] register tile of a `sizeM` x `sizeN` accumulator of
+// `elementType`: the divisors of the dimensions with the highest FMA-to-load
+// ratio that fit in the vector registers. Fails if no tile fits. With SME,
+// the largest divisors that fit in the four f32 tiles of the ZA array at the
+// minimum streaming vector length `vectorWidth`.
+// With `allowRemainder`, the tile need not divide the dimensions and the
+// ratio is scaled by the fraction of the accumulator covered by full tiles,
+// the remainder being computed by smaller tiles.
+FailureOr<std::pair<int64_t, int64_t>>
+getRegisterBlock(int64_t sizeM, int64_t sizeN, Type elementType,
+                 const CpuTargetInfo &target, bool allowRemainder = false);
+
+// Return true if padding a `sizeM` x `sizeN` x `sizeK` matmul of
+// `elementType` accumulators up to multiples of `blockFactors` costs less
+// than computing the remainders on their own. The padded rows, columns and
+// depth are computed by full blocks; the remainders are the edges left out of
+// the blocked layout, computed by the register tiles of their narrower
+// shapes.
+bool isMatmulPaddingProfitable(int64_t sizeM, int64_t sizeN, int64_t sizeK,
+                               ArrayRef<int64_t> blockFactors,
+                               Type elementType, const CpuTargetInfo &target);
+
+// Order in which the threads walk a 2-D grid of tiles, e.g. the M x N tiles
+// of the parallel loops of the gemms. The threads run consecutive tiles of
+// the order at the same time.
+struct TileTraversal {
+  enum Order {
+    // Tiles by rows, the default order of the parallel loops.
+    RowMajor,
+    // Tiles by columns, the threads share the column panels (the B panels).
+    ColMajor,
+    // Groups of `size` rows of tiles walked column by column.
+    Grouped,
+    // Z-order curve inside blocks of `size` x `size` tiles, the blocks by rows.
+    Morton,
+  };
+  Order order = RowMajor;
+  int64_t size = 1;
+};
+
+// Return the traversal of a grid of `rows` x `cols` tiles run by `numThreads`
+// threads, whose tiles read a panel of `rowPanelBytes` shared by the tiles of
+// their row (the A panels of a gemm) and one of `colPanelBytes` shared by the
+// tiles of their column (the B panels). The grid stays row-major while all its
+// panels fit in L3. Otherwise, among the orders whose panels reused from one
+// round of threads to the next fit in L3, the one reading the fewest panel
+// bytes per round is picked, Morton when none fits. With `order`, only that
+// order is sized, row-major when it does not apply to the grid.
+TileTraversal
+getTileTraversal(int64_t rows, int64_t cols, int64_t rowPanelBytes,
+                 int64_t colPanelBytes, int64_t numThreads,
+                 const CpuTargetInfo &target,
+                 std::optional<TileTraversal::Order> order = std::nullopt);
+
+} // namespace tpp
+} // namespace mlir
+
+#endif
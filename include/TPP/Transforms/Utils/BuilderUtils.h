@@ -32,6 +32,13 @@ func::FuncOp createFunction(OpBuilder &builder, ModuleOp module,
                             llvm::StringRef name, TypeRange args, TypeRange ret,
                             bool createBody = true);
 
+// Returns the private declaration of the runtime function `name`, creating it
+// at the beginning of `module` if it does not exist yet. The C interface
+// wrapper is emitted for memref arguments if `emitCInterface` is set.
+func::FuncOp getOrCreateRuntimeFunc(ModuleOp module, llvm::StringRef name,
+                                    TypeRange argTypes, TypeRange resultTypes,
+                                    bool emitCInterface = false);
+
 // Create a local constant dense tensor
 Value createDenseTensor(OpBuilder &, TensorInitType, TensorType, int);
 
@@ -24,11 +24,12 @@
 
 // Base class for float values.
 struct TensorInitFloat : public TensorInit<llvm::APFloat> {
-  // Supported data types. (TODO: Support 8-bit data types)
-  enum class DataType { AUTO, FP16, FP32, FP64, BF16 };
+  // Supported data types.
+  enum class DataType { AUTO, FP16, FP32, FP64, BF16, FP8E5M2, FP8E4M3 };
 
   static bool isTypeSupported(const mlir::Type &type) {
-    return type.isF16() || type.isF32() || type.isF64() || type.isBF16();
+    return type.isF16() || type.isF32() || type.isF64() || type.isBF16() ||
+           llvm::isa<mlir::Float8E5M2Type, mlir::Float8E4M3FNType>(type);
   }
 
   // Get data type from element type.
@@ -66,6 +67,20 @@ protected:
                   &ignored);
   }
 
+  // FP8 (E5M2) conversion (by reference).
+  static void toFP8E5M2(llvm::APFloat &value) {
+    bool ignored;
+    value.convert(llvm::APFloat::Float8E5M2(),
+                  llvm::APFloat::rmNearestTiesToEven, &ignored);
+  }
+
+  // FP8 (E4M3) conversion (by reference).
+  static void toFP8E4M3(llvm::APFloat &value) {
+    bool ignored;
+    value.convert(llvm::APFloat::Float8E4M3FN(),
+                  llvm::APFloat::rmNearestTiesToEven, &ignored);
+  }
+
   // Tensor element data type.
   DataType type;
 
@@ -61,6 +61,9 @@ FailureOr<SmallVector<Range>> getLoopsToMaterialize(RewriterBase &rewriter,
 // Return true if `op` is a blocked convolution.
 bool isBlockedConvolution(Operation *op);
 
+// Return true if `op` is a depthwise convolution blocked on the channels.
+bool isBlockedDepthwiseConvolution(Operation *op);
+
 // Return true if `op` is a blocked matmul.
 bool isBlockedMatmul(Operation *op);
 
@@ -75,9 +78,30 @@ bool isBlockedMatmul(Operation *op);
 FailureOr<linalg::ContractionDimensions>
 isContraction(linalg::LinalgOp linalgOp);
 
+// Return true if `linalgOp` dequantizes a tensor of integers, e.g. the int8 or
+// int4 weights of a matmul:
+// - All its loops are parallel and its output map is the identity.
+// - Its first input has integer elements and the identity map, the others
+//   (scales and zero points) have float elements and any map.
+// - The body only converts the integers to floats, with casts and extensions,
+//   and combines them with the other inputs with float adds, subs and muls.
+//   The output is only written.
+// Int4 weights stored two per byte (see `pack-int4-weights`) are read through
+// a nibble map, see `isNibbleMap`, and unpacked in the body with shifts.
+bool isDequantize(linalg::LinalgOp linalgOp);
+
+// Return true if `map` reads a tensor of int4 pairs packed in bytes: the
+// identity, except for the innermost dimension divided by 2.
+bool isNibbleMap(AffineMap map);
+
 // Return constant range span or nullopt, otherwise.
 std::optional<int64_t> getConstantRange(const Range &range);
 
+// Return the coefficient of the dimension `dim` in the linear expression
+// `expr` (e.g., the stride of a convolution), or nullopt if `expr` is not
+// linear in the dimensions.
+std::optional<int64_t> getDimCoefficient(AffineExpr expr, unsigned dim);
+
 // Validate a tile configuration for a linalgOp when we can statically do that.
 // Specific dims can be passed using 'dims'. If dims is empty the validation
 // will start from the outermost dimension, moving to innermost ones up to the
@@ -90,12 +114,54 @@ bool validateFullTilesOnDims(TilingInterface tileOp,
                              ArrayRef<size_t> dims = {},
                              int64_t minTileFactor = 2);
 
+// Return true if the iterations of the loops from `rootLoop` down to `tile`
+// take disjoint tiles of `dest` that together cover it, i.e. each element of
+// `dest` is in the tile of exactly one iteration. Each offset of the tile is
+// either zero, on a full dimension, or a multiple of the induction variable of
+// a loop stepping over the dimension by the size of the tile. Only scf.for,
+// scf.forall and scf.parallel loops are allowed between the two.
+bool isCoveredByTiles(Value dest, OffsetSizeAndStrideOpInterface tile,
+                      Operation *rootLoop);
+
 // Rewrite scf.for to scf.forall. Assumes the loop to be parallel and
 // marked with `kLoopId`.
 constexpr const static llvm::StringLiteral kLoopParallel = "parallel";
 constexpr const static llvm::StringLiteral kLoopRoot = "root";
+// Marks the scf.forall of the partial accumulations of a split-K contraction,
+// the contractions in its body are already distributed and not tiled again.
+constexpr const static llvm::StringLiteral kSplitReduction = "split_reduction";
+// Marks the scf.forall of a fused attention, its contractions are already
+// tiled.
+constexpr const static llvm::StringLiteral kFusedAttention = "fused_attention";
+// Marks the operations writing a large write-once output, to be lowered to
+// non-temporal stores.
+constexpr const static llvm::StringLiteral kNonTemporal = "tpp.nontemporal";
+// Marks the linalg operations with the lowering selected for them, one of
+// `kLoweringXsmm` and `kLoweringVector`.
+constexpr const static llvm::StringLiteral kLowering = "tpp.lowering";
+constexpr const static llvm::StringLiteral kLoweringXsmm = "xsmm";
+constexpr const static llvm::StringLiteral kLoweringVector = "vector";
+// Marks the scf.forall of a fused normalization, the contractions of its
+// epilogue are already tiled.
+constexpr const static llvm::StringLiteral kFusedNormalization =
+    "fused_normalization";
+// Marks the scf.forall of an argmax fused with the contraction of its logits,
+// over blocks of the vocabulary, whose contractions are already tiled.
+constexpr const static llvm::StringLiteral kFusedTopK = "fused_top_k";
+// Marks the scf.forall of the grouped matmuls of the experts of a
+// mixture-of-experts layer, whose contractions are already tiled.
+constexpr const static llvm::StringLiteral kGroupedExperts =
+    "grouped_experts";
+// Marks the scf.forall of a rotary embedding fused with the projection of its
+// queries or keys, over blocks of rows, whose contractions are already tiled.
+constexpr const static llvm::StringLiteral kFusedRotaryEmbedding =
+    "fused_rotary_embedding";
 void populateScfForToForAllRewritePattern(RewritePatternSet &patterns);
 
+// Returns the number of threads the parallel loops run on, as the runtimes
+// pick it: TPP_NUM_THREADS, then OMP_NUM_THREADS, then the hardware threads.
+unsigned getDefaultNumThreads();
+
 // Given a value `val` expand its shape based on `reassociationMap`.
 Value expand(OpBuilder &builder, Location loc, Value val, Type newType,
              ArrayRef<ReassociationIndices> reassociationMap);
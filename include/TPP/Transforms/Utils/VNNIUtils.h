@@ -35,9 +35,19 @@ enum class VnniOperandRank {
   BRGEMM_OUTS = 3
 };
 
-// Return the VNNI blocking factor: 2 for BF16 and 4 for BF8.
+// Return the VNNI blocking factor: 2 for BF16 and 4 for I8.
 std::optional<int64_t> getVnniBlockingFactor(Type type);
 
+// Return true if the target has a dot product instruction for the element
+// type of `type`. Without one (e.g. bf16 before AVX512-BF16), libxsmm emulates
+// the VNNI kernels and a flat layout computed in f32 is faster.
+bool hasNativeDotProduct(Type type);
+
+// Return true if the target is x86 and has a dot product instruction for the
+// element type of `type` that the x86vector dialect exposes, i.e. vdpbf16ps
+// (AVX512-BF16) for bf16.
+bool hasX86DotProduct(Type type);
+
 // Return true if the memref is in VNNI layout with rank `expectedRank`.
 bool isInVnniLayout(VnniOperandRank expectedRank, MemRefType memref);
 
@@ -0,0 +1,66 @@
+//===- XsmmProfile.h ---------------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TPP_TRANSFORMS_UTILS_XSMMPROFILE_H
+#define TPP_TRANSFORMS_UTILS_XSMMPROFILE_H
+
+#include "mlir/Support/LogicalResult.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace mlir {
+namespace tpp {
+
+// Achieved performance of a gemm-like XSMM kernel of a previous run, as
+// written by the runtime telemetry (TPP_XSMM_PROFILE, see `--profile-out` of
+// tpp-run). `dtype` is the XSMM data type of the kernel, `batches` the number
+// of gemms of all its calls.
+struct XsmmKernelProfile {
+  std::string kind;
+  int64_t dtype;
+  int64_t m;
+  int64_t n;
+  int64_t k;
+  uint64_t calls;
+  uint64_t batches;
+  double seconds;
+
+  // Return the FLOP count of all the calls.
+  double getFlops() const { return 2.0 * m * n * k * batches; }
+};
+
+// Profile of the gemm-like XSMM kernels of a run. The element-wise kernels
+// report no FLOP count and are not part of it.
+class XsmmProfile {
+public:
+  // Read the profile at `path`. Fails with `error` set if the file cannot be
+  // read or is not a profile.
+  static FailureOr<XsmmProfile> load(StringRef path, std::string &error);
+
+  // Return the achieved performance of the `m` x `n` x `k` kernels of
+  // `dtype`, relative to the fastest kernel of the same data type: 1 for the
+  // fastest one, lower for the kernels that underperformed. The calls of
+  // kernels of the same shape (e.g., with different flags) are weighted
+  // together. Empty if no kernel of that shape was profiled.
+  std::optional<double> getEfficiency(int64_t dtype, int64_t m, int64_t n,
+                                      int64_t k) const;
+
+  ArrayRef<XsmmKernelProfile> getKernels() const { return kernels; }
+
+private:
+  SmallVector<XsmmKernelProfile> kernels;
+};
+
+} // namespace tpp
+} // namespace mlir
+
+#endif
@@ -0,0 +1,178 @@
+//===- CompileTimeReport.cpp - Compile-time breakdown of the pipeline -----===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/CompileTimeReport.h"
+
+#include "mlir/Pass/PassInstrumentation.h"
+#include "mlir/Support/FileUtilities.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/ToolOutputFile.h"
+
+#include <algorithm>
+#include <chrono>
+
+#ifdef __unix__
+#include <sys/resource.h>
+#endif
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+namespace {
+
+// Number of individual passes listed in the report.
+constexpr unsigned kNumSlowestPasses = 5;
+
+// Pass bundles of the default pipeline, reported on their own.
+bool isPassBundle(StringRef pass) {
+  static const llvm::StringSet<> bundles{
+      "default-pipeline",   "default-tpp-passes",   "gpu-pipeline",
+      "tpp-mapping",        "bufferize",            "linalg-lowering",
+      "vector-to-xsmm",     "vector-to-kernel",     "low-level-parallel",
+      "convert-xsmm-to-func", "lower-local-dialects", "postprocess",
+      "cleanup"};
+  return bundles.contains(pass);
+}
+
+// Passes whose compile time grows with the size of the module, always
+// reported to track their scaling.
+constexpr StringLiteral kTrackedPasses[] = {"constant-fold-pack",
+                                            "tile-consumer-and-fuse-producers",
+                                            "one-shot-bufferize"};
+
+// Times every pass run, keyed by the pass and the operation it runs on, so
+// that passes running concurrently on different functions don't mix up.
+class PassTimingInstrumentation : public PassInstrumentation {
+public:
+  PassTimingInstrumentation(CompileTimeReport &report) : report(report) {}
+
+  void runBeforePass(Pass *pass, Operation *op) override {
+    if (pass->getArgument().empty())
+      return;
+    std::lock_guard<std::mutex> lock(mutex);
+    starts[{pass, op}] = std::chrono::steady_clock::now();
+  }
+
+  void runAfterPass(Pass *pass, Operation *op) override { stop(pass, op); }
+
+  void runAfterPassFailed(Pass *pass, Operation *op) override {
+    stop(pass, op);
+  }
+
+private:
+  void stop(Pass *pass, Operation *op) {
+    if (pass->getArgument().empty())
+      return;
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point start;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = starts.find({pass, op});
+      if (it == starts.end())
+        return;
+      start = it->second;
+      starts.erase(it);
+    }
+    report.addPassTime(pass->getArgument(),
+                       std::chrono::duration<double>(now - start).count());
+  }
+
+  CompileTimeReport &report;
+  std::mutex mutex;
+  DenseMap<std::pair<Pass *, Operation *>, std::chrono::steady_clock::time_point>
+      starts;
+};
+
+// Peak resident set size of the process in KiB, 0 if unknown.
+int64_t getPeakRSS() {
+#ifdef __unix__
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+    return usage.ru_maxrss;
+#endif
+  return 0;
+}
+
+} // namespace
+
+void CompileTimeReport::attach(PassManager &pm) {
+  pm.addInstrumentation(std::make_unique<PassTimingInstrumentation>(*this));
+}
+
+void CompileTimeReport::addPhase(StringRef name, double seconds) {
+  std::lock_guard<std::mutex> lock(mutex);
+  phases[name.str()] += seconds;
+}
+
+void CompileTimeReport::addPassTime(StringRef pass, double seconds) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (isPassBundle(pass)) {
+    bundles[pass.str()] += seconds;
+    // The peak only grows, the bundles that raise it are the ones to look at.
+    bundlePeakRSS[pass.str()] = getPeakRSS();
+  } else
+    passes[pass] += seconds;
+}
+
+void CompileTimeReport::print(raw_ostream &os) const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  llvm::json::Object bundleTimes;
+  for (auto &bundle : bundles)
+    bundleTimes[bundle.first] = bundle.second;
+  llvm::json::Object bundleRSS;
+  for (auto &bundle : bundlePeakRSS)
+    bundleRSS[bundle.first] = bundle.second;
+
+  SmallVector<std::pair<StringRef, double>> slowest;
+  for (auto &pass : passes)
+    slowest.push_back({pass.first(), pass.second});
+  llvm::sort(slowest, [](auto &lhs, auto &rhs) {
+    return lhs.second > rhs.second;
+  });
+  if (slowest.size() > kNumSlowestPasses)
+    slowest.resize(kNumSlowestPasses);
+  llvm::json::Object passTimes;
+  for (auto &pass : slowest)
+    passTimes[pass.first] = pass.second;
+  llvm::json::Object trackedTimes;
+  for (StringRef pass : kTrackedPasses)
+    trackedTimes[pass] = passes.lookup(pass);
+
+  llvm::json::Object phaseTimes;
+  for (auto &phase : phases)
+    phaseTimes[phase.first] = phase.second;
+
+  llvm::json::Object report{{"bundles", std::move(bundleTimes)},
+                            {"bundle_peak_rss_kb", std::move(bundleRSS)},
+                            {"slowest_passes", std::move(passTimes)},
+                            {"tracked_passes", std::move(trackedTimes)},
+                            {"phases", std::move(phaseTimes)},
+                            {"peak_rss_kb", getPeakRSS()}};
+  os << llvm::formatv("{0:2}", llvm::json::Value(std::move(report))) << "\n";
+}
+
+LogicalResult CompileTimeReport::write(StringRef filename) const {
+  if (filename == "-") {
+    print(llvm::errs());
+    return success();
+  }
+
+  std::string errorMessage;
+  auto output = openOutputFile(filename, &errorMessage);
+  if (!output) {
+    llvm::errs() << "Error while writing the compile-time report: "
+                 << errorMessage << "\n";
+    return failure();
+  }
+  print(output->os());
+  output->keep();
+  return success();
+}
@@ -15,8 +15,12 @@
 #include "mlir/Dialect/Math/IR/Math.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Vector/IR/VectorOps.h"
+#include "mlir/IR/TypeUtilities.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 
+#include <limits>
+
 using namespace mlir;
 using namespace mlir::check;
 using namespace mlir::cf;
@@ -32,17 +36,200 @@ namespace tpp {
 
 namespace {
 
+// Elements of the innermost dimension read at once by the check loops.
+constexpr int64_t kCheckVectorLength = 8;
+
+// Reductions of the check loops over the elements.
+enum class CheckReduction { Sum, Max };
+
+// Returns the type the errors are computed in, the floats narrower than f32
+// are extended.
+static Type getComputeType(OpBuilder &b, Type elementType) {
+  auto floatType = dyn_cast<FloatType>(elementType);
+  if (floatType && floatType.getWidth() < 32)
+    return b.getF32Type();
+  return elementType;
+}
+
+// Converts the scalar or vector `value` to the element type `type`.
+static Value convertTo(OpBuilder &b, Location loc, Value value, Type type) {
+  Type valueType = getElementTypeOrSelf(value.getType());
+  if (valueType == type)
+    return value;
+  Type resultType = type;
+  if (auto vectorType = dyn_cast<VectorType>(value.getType()))
+    resultType = vectorType.clone(type);
+  if (isa<IntegerType>(type))
+    return b.create<arith::FPToSIOp>(loc, resultType, value);
+  if (valueType.getIntOrFloatBitWidth() < type.getIntOrFloatBitWidth())
+    return b.create<arith::ExtFOp>(loc, resultType, value);
+  return b.create<arith::TruncFOp>(loc, resultType, value);
+}
+
+// Returns the memref `value`, as a single element vector of a scalar.
+static Value getCheckedBuffer(PatternRewriter &rewriter, Location loc,
+                              Value value) {
+  auto type = cast<MemRefType>(value.getType());
+  if (type.getRank() != 0)
+    return value;
+  return rewriter.create<memref::ExpandShapeOp>(
+      loc, MemRefType::get({1}, type.getElementType()), value,
+      ArrayRef<ReassociationIndices>{});
+}
+
+// Builds a parallel loop over the elements of `operands`, with the innermost
+// dimension read in vectors padded with zeros past its end. `body` returns a
+// vector per reduction, which is reduced over its lanes and then over the
+// loop from `inits`. Returns the reduced values.
+static ValueRange buildCheckReduction(
+    PatternRewriter &rewriter, Location loc, ValueRange operands,
+    ValueRange inits, ArrayRef<CheckReduction> kinds,
+    function_ref<SmallVector<Value>(OpBuilder &, Location, ValueRange)>
+        body) {
+  auto type = cast<MemRefType>(operands[0].getType());
+  Type elementType = type.getElementType();
+  Value zero = rewriter.create<arith::ConstantIndexOp>(loc, 0);
+  Value one = rewriter.create<arith::ConstantIndexOp>(loc, 1);
+  SmallVector<Value> lbs(type.getRank(), zero);
+  SmallVector<Value> steps(type.getRank(), one);
+  steps.back() =
+      rewriter.create<arith::ConstantIndexOp>(loc, kCheckVectorLength);
+  SmallVector<Value> ubs;
+  for (int64_t idx = 0, rank = type.getRank(); idx < rank; idx++)
+    ubs.push_back(linalg::createOrFoldDimOp(rewriter, loc, operands[0], idx));
+  Value padding = rewriter.create<arith::ConstantOp>(
+      loc, elementType, rewriter.getZeroAttr(elementType));
+  auto vectorType = VectorType::get({kCheckVectorLength}, elementType);
+
+  auto loop = rewriter.create<scf::ParallelOp>(
+      loc, lbs, ubs, steps, inits,
+      [&](OpBuilder &b, Location loc, ValueRange ivs, ValueRange) {
+        SmallVector<Value> vectors;
+        for (Value operand : operands)
+          vectors.push_back(b.create<vector::TransferReadOp>(
+              loc, vectorType, operand, ivs, padding));
+
+        SmallVector<Value> results = body(b, loc, vectors);
+        SmallVector<Value> partials;
+        for (auto [lanes, kind] : llvm::zip(results, kinds)) {
+          bool isFloat =
+              isa<FloatType>(getElementTypeOrSelf(lanes.getType()));
+          auto combiningKind =
+              kind == CheckReduction::Sum ? vector::CombiningKind::ADD
+              : isFloat                   ? vector::CombiningKind::MAXNUMF
+                                          : vector::CombiningKind::MAXSI;
+          partials.push_back(
+              b.create<vector::ReductionOp>(loc, combiningKind, lanes));
+        }
+
+        // Simple reductions, that the OpenMP conversion can parallelize
+        auto reduce = b.create<scf::ReduceOp>(loc, partials);
+        for (auto [region, kind] : llvm::zip(reduce.getReductions(), kinds)) {
+          OpBuilder::InsertionGuard guard(b);
+          Block &block = region.front();
+          b.setInsertionPointToEnd(&block);
+          Value lhs = block.getArgument(0);
+          Value rhs = block.getArgument(1);
+          bool isFloat = isa<FloatType>(lhs.getType());
+          Value result;
+          if (kind == CheckReduction::Sum) {
+            result = b.create<arith::AddIOp>(loc, lhs, rhs);
+          } else {
+            Value greater =
+                isFloat ? b.create<arith::CmpFOp>(
+                              loc, arith::CmpFPredicate::OGT, lhs, rhs)
+                        : b.create<arith::CmpIOp>(
+                              loc, arith::CmpIPredicate::sgt, lhs, rhs);
+            result = b.create<arith::SelectOp>(loc, greater, lhs, rhs);
+          }
+          b.create<scf::ReduceReturnOp>(loc, result);
+        }
+      });
+  return loop.getResults();
+}
+
+// Returns the indices of the first element of `operands` with the highest f64
+// `score`, in plain element loops. Only reached by failed checks.
+static SmallVector<Value>
+findWorstElement(OpBuilder &b, Location loc, ValueRange operands,
+                 function_ref<Value(OpBuilder &, Location, ValueRange)> score) {
+  auto type = cast<MemRefType>(operands[0].getType());
+  Value zero = b.create<arith::ConstantIndexOp>(loc, 0);
+  Value one = b.create<arith::ConstantIndexOp>(loc, 1);
+  SmallVector<Value> lbs(type.getRank(), zero);
+  SmallVector<Value> steps(type.getRank(), one);
+  SmallVector<Value> ubs;
+  for (int64_t idx = 0, rank = type.getRank(); idx < rank; idx++)
+    ubs.push_back(linalg::createOrFoldDimOp(b, loc, operands[0], idx));
+  SmallVector<Value> inits{b.create<arith::ConstantOp>(
+      loc, b.getF64Type(), b.getF64FloatAttr(-1.0))};
+  inits.append(type.getRank(), zero);
+
+  auto nest = scf::buildLoopNest(
+      b, loc, lbs, ubs, steps, inits,
+      [&](OpBuilder &b, Location loc, ValueRange ivs, ValueRange iterArgs) {
+        SmallVector<Value> scalars;
+        for (Value operand : operands)
+          scalars.push_back(b.create<memref::LoadOp>(loc, operand, ivs));
+        Value value = score(b, loc, scalars);
+        Value better = b.create<arith::CmpFOp>(loc, arith::CmpFPredicate::OGT,
+                                               value, iterArgs[0]);
+        scf::ValueVector results{
+            b.create<arith::SelectOp>(loc, better, value, iterArgs[0])};
+        for (auto [iv, idx] : llvm::zip(ivs, iterArgs.drop_front()))
+          results.push_back(b.create<arith::SelectOp>(loc, better, iv, idx));
+        return results;
+      });
+  return llvm::to_vector(ArrayRef(nest.results).drop_front());
+}
+
+// Returns the number of elements of the memref `value`, as i64.
+static Value getNumElements(OpBuilder &b, Location loc, Value value) {
+  Value count = b.create<arith::ConstantIndexOp>(loc, 1);
+  for (int64_t idx = 0, rank = cast<MemRefType>(value.getType()).getRank();
+       idx < rank; idx++)
+    count = b.create<arith::MulIOp>(
+        loc, count, linalg::createOrFoldDimOp(b, loc, value, idx));
+  return b.create<arith::IndexCastOp>(loc, b.getI64Type(), count);
+}
+
+// Report printing, values are printed without a newline.
+static void print(OpBuilder &b, Location loc, StringRef str) {
+  b.create<vector::PrintOp>(loc, str);
+}
+
+static void print(OpBuilder &b, Location loc, Value value) {
+  if (value.getType().isIndex())
+    value = b.create<arith::IndexCastOp>(loc, b.getI64Type(), value);
+  b.create<vector::PrintOp>(loc, value,
+                            vector::PrintPunctuation::NoPunctuation);
+}
+
+static void printIndices(OpBuilder &b, Location loc, ValueRange indices) {
+  print(b, loc, "[");
+  for (auto [pos, idx] : llvm::enumerate(indices)) {
+    if (pos)
+      print(b, loc, ", ");
+    print(b, loc, idx);
+  }
+  print(b, loc, "]");
+}
+
 // Convert
-// check.expect_almost_equals(%t1:tensor<2x2xf32>, %t2:tensor<2x2xf32>,
+// check.expect_almost_eq(%t1:memref<2x16xf32>, %t2:memref<2x16xf32>,
 // %threshold:f32)
-// to the pattern:
-// scf.some_loop(%i, %j)
-// %0 = load from %t1
-// %1 = load from %t2
-// %diff = math.subf %0, %1
-// %abs = arith.absf %diff
-// %compare = arith.cmpf le, %abs, %threshold
-// cf.assert %compare, "Result mismatch"
+// to a parallel loop reducing vectors of the innermost dimension:
+// %mismatches, %nans, %infs, %maxAbs, %maxRel =
+//     scf.parallel (%i, %j) = (%c0, %c0) to (%c2, %c16) step (%c1, %c8)
+//   %0 = vector.transfer_read %t1[%i, %j]
+//   %1 = vector.transfer_read %t2[%i, %j]
+//   %abs = math.absf (arith.subf %0, %1)
+//   %mismatch = arith.cmpf ugt, %abs, %threshold
+//   ...
+//   scf.reduce(vector.reduction <add>, ... : i64, i64, i64, f32, f32)
+// scf.if %mismatches > 0
+//   vector.print the errors, then the worst element
+//   cf.assert %false, "Result mismatch"
 struct ConvertAlmostEqualsOp
     : public OpRewritePattern<check::ExpectAlmostEqOp> {
   using OpRewritePattern<check::ExpectAlmostEqOp>::OpRewritePattern;
@@ -50,42 +237,150 @@ struct ConvertAlmostEqualsOp
   LogicalResult matchAndRewrite(check::ExpectAlmostEqOp almostEqOp,
                                 PatternRewriter &rewriter) const override {
     Location loc = almostEqOp.getLoc();
-    SmallVector<Value> ubs;
     if (!isa<MemRefType>(almostEqOp.getLhs().getType())) {
       return failure();
     }
-    size_t rank = cast<MemRefType>(almostEqOp.getLhs().getType()).getRank();
-    for (size_t idx = 0; idx < rank; idx++) {
-      auto dim = linalg::createOrFoldDimOp(rewriter, loc,
-                                           almostEqOp.getOperand(0), idx);
-      ubs.push_back(dim);
+    Value lhs = getCheckedBuffer(rewriter, loc, almostEqOp.getLhs());
+    Value rhs = getCheckedBuffer(rewriter, loc, almostEqOp.getRhs());
+    Type elementType = cast<MemRefType>(lhs.getType()).getElementType();
+    Type computeType = getComputeType(rewriter, elementType);
+    bool isFloat = isa<FloatType>(computeType);
+    auto vectorType = VectorType::get({kCheckVectorLength}, computeType);
+    auto countType =
+        VectorType::get({kCheckVectorLength}, rewriter.getI64Type());
+
+    Value threshold =
+        convertTo(rewriter, loc, almostEqOp.getThreshold(), computeType);
+    Value thresholds =
+        rewriter.create<vector::BroadcastOp>(loc, vectorType, threshold);
+    Value noCount = rewriter.create<arith::ConstantOp>(
+        loc, rewriter.getI64Type(), rewriter.getI64IntegerAttr(0));
+    Value noError = rewriter.create<arith::ConstantOp>(
+        loc, computeType, rewriter.getZeroAttr(computeType));
+
+    // Integers only count the mismatches and their largest difference
+    SmallVector<Value> inits{noCount};
+    SmallVector<CheckReduction> kinds{CheckReduction::Sum};
+    if (isFloat) {
+      inits.append({noCount, noCount});
+      kinds.append({CheckReduction::Sum, CheckReduction::Sum});
     }
-    Value zero = rewriter.create<arith::ConstantIndexOp>(loc, 0);
-    SmallVector<Value> lbs(rank, zero);
-    Value one = rewriter.create<arith::ConstantIndexOp>(loc, 1);
-    SmallVector<Value> steps(rank, one);
-    (void)scf::buildLoopNest(
-        rewriter, loc, lbs, ubs, steps,
-        [&](OpBuilder &b, Location loc, ValueRange localIvs) {
-          Value scalarLhs =
-              b.create<memref::LoadOp>(loc, almostEqOp.getLhs(), localIvs);
-          Value scalarRhs =
-              b.create<memref::LoadOp>(loc, almostEqOp.getRhs(), localIvs);
-          Value compare;
-          if (isa<mlir::FloatType>(scalarLhs.getType())) {
-            Value diff = b.create<arith::SubFOp>(loc, scalarLhs, scalarRhs);
-            Value abs = b.create<math::AbsFOp>(loc, diff);
-            compare = b.create<arith::CmpFOp>(loc, arith::CmpFPredicate::OLE,
-                                              abs, almostEqOp.getThreshold());
-          } else {
-            Value diff = b.create<arith::SubIOp>(loc, scalarLhs, scalarRhs);
+    inits.push_back(noError);
+    kinds.push_back(CheckReduction::Max);
+    if (isFloat) {
+      inits.push_back(noError);
+      kinds.push_back(CheckReduction::Max);
+    }
+
+    Value inf, tiny;
+    if (isFloat) {
+      auto semantics = cast<FloatType>(computeType).getFloatSemantics();
+      inf = rewriter.create<vector::BroadcastOp>(
+          loc, vectorType,
+          rewriter.create<arith::ConstantOp>(
+              loc, computeType,
+              rewriter.getFloatAttr(computeType,
+                                    APFloat::getInf(semantics))));
+      tiny = rewriter.create<vector::BroadcastOp>(
+          loc, vectorType,
+          rewriter.create<arith::ConstantOp>(
+              loc, computeType,
+              rewriter.getFloatAttr(
+                  computeType, APFloat::getSmallestNormalized(semantics))));
+    }
+
+    ValueRange stats = buildCheckReduction(
+        rewriter, loc, {lhs, rhs}, inits, kinds,
+        [&](OpBuilder &b, Location loc, ValueRange vectors) {
+          Value lhsLanes = convertTo(b, loc, vectors[0], computeType);
+          Value rhsLanes = convertTo(b, loc, vectors[1], computeType);
+          auto count = [&](Value mask) -> Value {
+            return b.create<arith::ExtUIOp>(loc, countType, mask);
+          };
+          if (!isFloat) {
+            Value diff = b.create<arith::SubIOp>(loc, lhsLanes, rhsLanes);
             Value abs = b.create<math::AbsIOp>(loc, diff);
-            compare = b.create<arith::CmpIOp>(loc, arith::CmpIPredicate::sle,
-                                              abs, almostEqOp.getThreshold());
+            Value mismatch = b.create<arith::CmpIOp>(
+                loc, arith::CmpIPredicate::sgt, abs, thresholds);
+            return SmallVector<Value>{count(mismatch), abs};
           }
-          b.create<cf::AssertOp>(loc, compare,
-                                 b.getStringAttr("Result mismatch"));
+          // NaNs are mismatches, but not errors
+          Value diff = b.create<arith::SubFOp>(loc, lhsLanes, rhsLanes);
+          Value abs = b.create<math::AbsFOp>(loc, diff);
+          Value mismatch = b.create<arith::CmpFOp>(
+              loc, arith::CmpFPredicate::UGT, abs, thresholds);
+          Value lhsAbs = b.create<math::AbsFOp>(loc, lhsLanes);
+          Value rhsAbs = b.create<math::AbsFOp>(loc, rhsLanes);
+          Value magnitude = b.create<arith::MaxNumFOp>(
+              loc, b.create<arith::MaxNumFOp>(loc, lhsAbs, rhsAbs), tiny);
+          Value rel = b.create<arith::DivFOp>(loc, abs, magnitude);
+          Value isNan = b.create<arith::CmpFOp>(loc, arith::CmpFPredicate::UNO,
+                                                lhsLanes, lhsLanes);
+          Value isInf = b.create<arith::CmpFOp>(loc, arith::CmpFPredicate::OEQ,
+                                                lhsAbs, inf);
+          return SmallVector<Value>{count(mismatch), count(isNan),
+                                    count(isInf), abs, rel};
         });
+
+    Value failed = rewriter.create<arith::CmpIOp>(
+        loc, arith::CmpIPredicate::sgt, stats[0], noCount);
+    rewriter.create<scf::IfOp>(loc, failed, [&](OpBuilder &b, Location loc) {
+      print(b, loc, "check.expect_almost_eq: ");
+      print(b, loc, stats[0]);
+      print(b, loc, " of ");
+      print(b, loc, getNumElements(b, loc, lhs));
+      print(b, loc, " elements differ by more than ");
+      print(b, loc, threshold);
+      print(b, loc, ", max abs error ");
+      print(b, loc, stats[isFloat ? 3 : 1]);
+      if (isFloat) {
+        print(b, loc, ", max rel error ");
+        print(b, loc, stats[4]);
+        print(b, loc, ", ");
+        print(b, loc, stats[1]);
+        print(b, loc, " NaN, ");
+        print(b, loc, stats[2]);
+        print(b, loc, " Inf");
+      }
+      b.create<vector::PrintOp>(loc, vector::PrintPunctuation::NewLine);
+
+      // The worst element is the first NaN, or the largest difference
+      SmallVector<Value> worst = findWorstElement(
+          b, loc, {lhs, rhs},
+          [&](OpBuilder &b, Location loc, ValueRange scalars) -> Value {
+            Value lhsValue = convertTo(b, loc, scalars[0], computeType);
+            Value rhsValue = convertTo(b, loc, scalars[1], computeType);
+            if (!isFloat) {
+              Value diff = b.create<arith::SubIOp>(loc, lhsValue, rhsValue);
+              Value abs = b.create<math::AbsIOp>(loc, diff);
+              return b.create<arith::SIToFPOp>(loc, b.getF64Type(), abs);
+            }
+            Value diff = b.create<arith::SubFOp>(loc, lhsValue, rhsValue);
+            Value abs = convertTo(b, loc, b.create<math::AbsFOp>(loc, diff),
+                                  b.getF64Type());
+            Value isNan = b.create<arith::CmpFOp>(
+                loc, arith::CmpFPredicate::UNO, abs, abs);
+            Value inf = b.create<arith::ConstantOp>(
+                loc, b.getF64Type(),
+                b.getF64FloatAttr(std::numeric_limits<double>::infinity()));
+            return b.create<arith::SelectOp>(loc, isNan, inf, abs);
+          });
+      print(b, loc, "worst element ");
+      printIndices(b, loc, worst);
+      print(b, loc, ": ");
+      print(b, loc,
+            convertTo(b, loc, b.create<memref::LoadOp>(loc, lhs, worst),
+                      computeType));
+      print(b, loc, " vs ");
+      print(b, loc,
+            convertTo(b, loc, b.create<memref::LoadOp>(loc, rhs, worst),
+                      computeType));
+      b.create<vector::PrintOp>(loc, vector::PrintPunctuation::NewLine);
+
+      Value isFalse = b.create<arith::ConstantOp>(loc, b.getBoolAttr(false));
+      b.create<cf::AssertOp>(loc, isFalse, b.getStringAttr("Result mismatch"));
+      b.create<scf::YieldOp>(loc);
+    });
     rewriter.eraseOp(almostEqOp);
     return success();
   }
@@ -112,63 +407,104 @@ struct ConvertExpectTrueOp : public OpRewritePattern<ExpectTrueOp> {
 };
 
 // Convert
-// check.expect_sane(%t1:tensor<2x2xf32>)
-// to the pattern:
-// scf.some_loop(%i, %j)
-// %0 = load from %t1
-// %1 = arith.absf %0:f32
-// %2 = arith.cmpf ord, %1, %nan : f32
-// %3 = arith.cmpf one, %1, %inf : f32
-// %compare = arith.andi %2, %3 : i1
-// cf.assert %compare, "Buffer can't contain NaNs or Infinite values"
+// check.expect_sane(%t1:memref<2x16xf32>)
+// to a parallel loop counting the NaNs and infinities in vectors of the
+// innermost dimension:
+// %nans, %infs = scf.parallel (%i, %j) = (%c0, %c0) to (%c2, %c16)
+//                    step (%c1, %c8)
+//   %0 = vector.transfer_read %t1[%i, %j]
+//   %nan = arith.cmpf uno, %0, %0
+//   %inf = arith.cmpf oeq, (math.absf %0), %inf
+//   scf.reduce(vector.reduction <add>, ... : i64, i64)
+// scf.if %nans + %infs > 0
+//   vector.print the counts, then the first non-finite element
+//   cf.assert %false, "Buffer can't contain NaNs or Infinite values"
 struct ConvertExpectSaneOp : public OpRewritePattern<ExpectSaneOp> {
   using OpRewritePattern<ExpectSaneOp>::OpRewritePattern;
 
   LogicalResult matchAndRewrite(ExpectSaneOp expectSaneOp,
                                 PatternRewriter &rewriter) const override {
     Location loc = expectSaneOp.getLoc();
-    auto operand = expectSaneOp.getOperand();
-    auto operandType = operand.getType();
+    auto operandType = expectSaneOp.getOperand().getType();
     auto elementType = operandType.getElementType();
-    SmallVector<Value> ubs;
     if (!isa<MemRefType>(operandType) || !isa<mlir::FloatType>(elementType)) {
       return failure();
     }
-    size_t rank = cast<MemRefType>(operandType).getRank();
-    for (size_t idx = 0; idx < rank; idx++) {
-      auto dim = linalg::createOrFoldDimOp(rewriter, loc, operand, idx);
-      ubs.push_back(dim);
-    }
-    Value zero = rewriter.create<arith::ConstantIndexOp>(loc, 0);
-    SmallVector<Value> lbs(rank, zero);
-    Value one = rewriter.create<arith::ConstantIndexOp>(loc, 1);
-    SmallVector<Value> steps(rank, one);
-    (void)scf::buildLoopNest(
-        rewriter, loc, lbs, ubs, steps,
-        [&](OpBuilder &b, Location loc, ValueRange localIvs) {
-          Value scalarOperand =
-              b.create<memref::LoadOp>(loc, operand, localIvs);
-          Value scalarOperandAbsf = b.create<math::AbsFOp>(loc, scalarOperand);
-          Value zeroVal = b.create<arith::ConstantOp>(
-              loc, elementType, rewriter.getZeroAttr(elementType));
-
-          Value inf = rewriter.create<arith::ConstantOp>(
-              loc, elementType,
-              b.getFloatAttr(
-                  elementType,
-                  APFloat::getInf(
-                      cast<FloatType>(elementType).getFloatSemantics())));
-          Value notNan = b.create<arith::CmpFOp>(loc, arith::CmpFPredicate::ORD,
-                                                 scalarOperandAbsf, zeroVal);
-          Value notInf = b.create<arith::CmpFOp>(loc, arith::CmpFPredicate::ONE,
-                                                 scalarOperandAbsf, inf);
-
-          Value compare = b.create<arith::AndIOp>(loc, notNan, notInf);
-          b.create<cf::AssertOp>(
-              loc, compare,
-              b.getStringAttr("Buffer can't contain NaNs or Infinite values"));
+    Value operand = getCheckedBuffer(rewriter, loc, expectSaneOp.getOperand());
+    Type computeType = getComputeType(rewriter, elementType);
+    auto vectorType = VectorType::get({kCheckVectorLength}, computeType);
+    auto countType =
+        VectorType::get({kCheckVectorLength}, rewriter.getI64Type());
+    Value noCount = rewriter.create<arith::ConstantOp>(
+        loc, rewriter.getI64Type(), rewriter.getI64IntegerAttr(0));
+    Value inf = rewriter.create<vector::BroadcastOp>(
+        loc, vectorType,
+        rewriter.create<arith::ConstantOp>(
+            loc, computeType,
+            rewriter.getFloatAttr(
+                computeType,
+                APFloat::getInf(
+                    cast<FloatType>(computeType).getFloatSemantics()))));
+
+    ValueRange counts = buildCheckReduction(
+        rewriter, loc, operand, {noCount, noCount},
+        {CheckReduction::Sum, CheckReduction::Sum},
+        [&](OpBuilder &b, Location loc, ValueRange vectors) {
+          Value lanes = convertTo(b, loc, vectors[0], computeType);
+          Value isNan = b.create<arith::CmpFOp>(loc, arith::CmpFPredicate::UNO,
+                                                lanes, lanes);
+          Value isInf = b.create<arith::CmpFOp>(
+              loc, arith::CmpFPredicate::OEQ,
+              b.create<math::AbsFOp>(loc, lanes), inf);
+          return SmallVector<Value>{
+              b.create<arith::ExtUIOp>(loc, countType, isNan),
+              b.create<arith::ExtUIOp>(loc, countType, isInf)};
         });
 
+    Value bad = rewriter.create<arith::AddIOp>(loc, counts[0], counts[1]);
+    Value failed = rewriter.create<arith::CmpIOp>(
+        loc, arith::CmpIPredicate::sgt, bad, noCount);
+    rewriter.create<scf::IfOp>(loc, failed, [&](OpBuilder &b, Location loc) {
+      print(b, loc, "check.expect_sane: ");
+      print(b, loc, counts[0]);
+      print(b, loc, " NaN and ");
+      print(b, loc, counts[1]);
+      print(b, loc, " Inf of ");
+      print(b, loc, getNumElements(b, loc, operand));
+      print(b, loc, " elements");
+      b.create<vector::PrintOp>(loc, vector::PrintPunctuation::NewLine);
+
+      SmallVector<Value> first = findWorstElement(
+          b, loc, operand,
+          [&](OpBuilder &b, Location loc, ValueRange scalars) -> Value {
+            Value value = convertTo(b, loc, scalars[0], b.getF64Type());
+            Value abs = b.create<math::AbsFOp>(loc, value);
+            Value inf = b.create<arith::ConstantOp>(
+                loc, b.getF64Type(),
+                b.getF64FloatAttr(std::numeric_limits<double>::infinity()));
+            Value finite = b.create<arith::CmpFOp>(
+                loc, arith::CmpFPredicate::ONE, abs, inf);
+            Value zero = b.create<arith::ConstantOp>(loc, b.getF64Type(),
+                                                     b.getF64FloatAttr(0.0));
+            Value one = b.create<arith::ConstantOp>(loc, b.getF64Type(),
+                                                    b.getF64FloatAttr(1.0));
+            return b.create<arith::SelectOp>(loc, finite, zero, one);
+          });
+      print(b, loc, "first at ");
+      printIndices(b, loc, first);
+      print(b, loc, ": ");
+      print(b, loc,
+            convertTo(b, loc, b.create<memref::LoadOp>(loc, operand, first),
+                      computeType));
+      b.create<vector::PrintOp>(loc, vector::PrintPunctuation::NewLine);
+
+      Value isFalse = b.create<arith::ConstantOp>(loc, b.getBoolAttr(false));
+      b.create<cf::AssertOp>(
+          loc, isFalse,
+          b.getStringAttr("Buffer can't contain NaNs or Infinite values"));
+      b.create<scf::YieldOp>(loc);
+    });
+
     rewriter.eraseOp(expectSaneOp);
     return success();
   }
@@ -6,14 +6,18 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "TPP/IR/MatcherUtils.h"
 #include "TPP/Passes.h"
 #include "TPP/Transforms/Utils/ValueUtils.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 
+#include <optional>
+
 using namespace mlir;
 
 namespace mlir {
@@ -25,64 +29,95 @@ namespace tpp {
 
 namespace {
 
-// TODO: check if we can avoid passing the offset and do the computation in the
-// compiler.
-static SmallVector<Type> extractGemmOperandTypes(OpBuilder &builder,
-                                                 OperandRange operands) {
-  auto indexType = builder.getIndexType();
-  auto *ctx = builder.getContext();
-  SmallVector<Type> results;
-
-  results.push_back(indexType); // M
-  results.push_back(indexType); // N
-  results.push_back(indexType); // K
-  results.push_back(LLVM::LLVMPointerType::get(ctx));              // A
-  results.push_back(builder.getIndexType());                       // offset A
-  results.push_back(indexType);                                    // lda
-  results.push_back(LLVM::LLVMPointerType::get(ctx));              // B
-  results.push_back(builder.getIndexType());                       // offset B
-  results.push_back(indexType);                                    // ldb
-  results.push_back(LLVM::LLVMPointerType::get(ctx));              // C
-  results.push_back(builder.getIndexType());                       // offset C
-  results.push_back(indexType);                                    // ldc
-  return results;
+// Data types and post-ops of linalg_matmul_dnnl, see OneDnnlRunnerUtils.h.
+enum class DnnlDataTypes : int64_t {
+  F32 = 0,
+  BF16 = 1,
+  BF16F32 = 2,
+  S8S32 = 3,
+};
+constexpr int64_t kDnnlBias = 1;
+constexpr int64_t kDnnlRelu = 2;
+
+// Return the data types of the oneDNN matmul of `a` x `b` into `c`, if
+// supported.
+static std::optional<DnnlDataTypes> getDnnlDataTypes(Type a, Type b, Type c) {
+  if (a != b)
+    return std::nullopt;
+  if (a.isF32() && c.isF32())
+    return DnnlDataTypes::F32;
+  if (a.isBF16() && c.isBF16())
+    return DnnlDataTypes::BF16;
+  if (a.isBF16() && c.isF32())
+    return DnnlDataTypes::BF16F32;
+  if (a.isInteger(8) && c.isInteger(32))
+    return DnnlDataTypes::S8S32;
+  return std::nullopt;
 }
 
-static SmallVector<Value> getGemmOperands(OpBuilder &builder, Location loc,
-                                          ValueRange operands) {
-  SmallVector<Value> results;
-
-  Value m = linalg::createOrFoldDimOp(builder, loc, operands[2], /*dim=*/0);
-  Value n = linalg::createOrFoldDimOp(builder, loc, operands[2], /*dim=*/1);
-  Value k = linalg::createOrFoldDimOp(builder, loc, operands[0], /*dim=*/1);
-  results.push_back(m);
-  results.push_back(n);
-  results.push_back(k);
-  auto [ptrA, offsetA] = utils::getPtrAndOffset(builder, operands[0], loc);
-  results.push_back(ptrA);
-  results.push_back(offsetA);
-  results.push_back(m); // lda
-  auto [ptrB, offsetB] = utils::getPtrAndOffset(builder, operands[1], loc);
-  results.push_back(ptrB);
-  results.push_back(offsetB);
-  results.push_back(k); // ldb
-  auto [ptrC, offsetC] = utils::getPtrAndOffset(builder, operands[2], loc);
-  results.push_back(ptrC);
-  results.push_back(offsetC);
-  results.push_back(m); // ldc
-  return results;
+// Return true if the rows of `operand` are contiguous.
+static bool hasUnitInnerStride(Value operand) {
+  auto memref = cast<MemRefType>(operand.getType());
+  if (memref.getLayout().isIdentity())
+    return true;
+  SmallVector<int64_t> strides;
+  int64_t offset;
+  return succeeded(getStridesAndOffset(memref, strides, offset)) &&
+         !strides.empty() && strides.back() == 1;
 }
 
-static void buildInvokeCall(OpBuilder &builder, Operation *op) {
-  std::string funcName(op->getName().getStringRef().str());
-  std::replace(funcName.begin(), funcName.end(), '.', '_');
-  funcName.append("_blas");
-  Location loc = op->getLoc();
+// Return the stride of the dimension `dim` of the memref `operand`. Identity
+// layouts take it from the sizes, the others from the strided metadata.
+static Value getStride(OpBuilder &builder, Location loc, Value operand,
+                       unsigned dim) {
+  auto memref = cast<MemRefType>(operand.getType());
+  if (memref.getLayout().isIdentity()) {
+    Value stride;
+    for (int64_t i = dim + 1, e = memref.getRank(); i < e; i++) {
+      Value size = linalg::createOrFoldDimOp(builder, loc, operand, i);
+      stride =
+          stride ? builder.createOrFold<arith::MulIOp>(loc, stride, size) : size;
+    }
+    return stride ? stride : builder.create<arith::ConstantIndexOp>(loc, 1);
+  }
+  auto meta = builder.create<memref::ExtractStridedMetadataOp>(loc, operand);
+  return meta.getStrides()[dim];
+}
 
+// Append the pointer, the offset, the batch stride if `withBatchStride` and
+// the leading dimension of `operand` to `results`. A single batch has a zero
+// batch stride.
+static void appendOperand(OpBuilder &builder, Location loc, Value operand,
+                          bool withBatchStride,
+                          SmallVectorImpl<Value> &results) {
+  auto [ptr, offset] = utils::getPtrAndOffset(builder, operand, loc);
+  results.push_back(ptr);
+  results.push_back(offset);
+  unsigned rank = cast<MemRefType>(operand.getType()).getRank();
+  if (withBatchStride) {
+    results.push_back(rank == 3
+                          ? getStride(builder, loc, operand, 0)
+                          : builder.create<arith::ConstantIndexOp>(loc, 0));
+  }
+  results.push_back(getStride(builder, loc, operand, rank - 2));
+}
+
+// Return the M, N, K sizes of the matmul of `operands`, batched or not.
+static SmallVector<Value> getGemmSizes(OpBuilder &builder, Location loc,
+                                       ValueRange operands) {
+  unsigned rank = cast<MemRefType>(operands[2].getType()).getRank();
+  Value m = linalg::createOrFoldDimOp(builder, loc, operands[2], rank - 2);
+  Value n = linalg::createOrFoldDimOp(builder, loc, operands[2], rank - 1);
+  Value k = linalg::createOrFoldDimOp(builder, loc, operands[0], rank - 1);
+  return {m, n, k};
+}
+
+static void buildCall(OpBuilder &builder, Operation *op, StringRef funcName,
+                      ValueRange operands) {
+  Location loc = op->getLoc();
   FlatSymbolRefAttr fnName = SymbolRefAttr::get(op->getContext(), funcName);
   ModuleOp module = op->getParentOfType<ModuleOp>();
-  auto libFnType = builder.getFunctionType(
-      extractGemmOperandTypes(builder, op->getOperands()), {});
+  auto libFnType = builder.getFunctionType(operands.getTypes(), {});
 
   if (!module.lookupSymbol(fnName)) {
     OpBuilder::InsertionGuard guard(builder);
@@ -94,28 +129,160 @@ static void buildInvokeCall(OpBuilder &builder, Operation *op) {
     funcOp.setPrivate();
   }
 
-  builder.create<func::CallOp>(
-      loc, fnName.getValue(), TypeRange(),
-      getGemmOperands(builder, loc, op->getOperands()));
+  builder.create<func::CallOp>(loc, fnName.getValue(), TypeRange(), operands);
+}
+
+// Calls the f32 GEMM of the BLAS-style API.
+static void buildGemmCall(OpBuilder &builder, Operation *op,
+                          ValueRange operands) {
+  std::string funcName(op->getName().getStringRef().str());
+  std::replace(funcName.begin(), funcName.end(), '.', '_');
+  funcName.append("_blas");
+
+  Location loc = op->getLoc();
+  SmallVector<Value> args = getGemmSizes(builder, loc, operands);
+  for (Value operand : operands)
+    appendOperand(builder, loc, operand, /*withBatchStride=*/false, args);
+  buildCall(builder, op, funcName, args);
+}
+
+// Calls the oneDNN matmul primitive, adding the `bias` row if any and
+// applying a relu if `relu` as post-ops.
+static void buildDnnlCall(OpBuilder &builder, Operation *op,
+                          DnnlDataTypes dataTypes, ValueRange operands,
+                          Value bias, bool relu) {
+  Location loc = op->getLoc();
+  auto outType = cast<MemRefType>(operands[2].getType());
+  bool batched = outType.getRank() == 3;
+  int64_t postOps = (bias ? kDnnlBias : 0) | (relu ? kDnnlRelu : 0);
+
+  SmallVector<Value> args;
+  args.push_back(builder.create<arith::ConstantIntOp>(
+      loc, static_cast<int64_t>(dataTypes), 64));
+  args.push_back(builder.create<arith::ConstantIntOp>(loc, postOps, 64));
+  args.push_back(batched
+                     ? linalg::createOrFoldDimOp(builder, loc, operands[2], 0)
+                     : builder.create<arith::ConstantIndexOp>(loc, 1));
+  args.append(getGemmSizes(builder, loc, operands));
+  for (Value operand : operands)
+    appendOperand(builder, loc, operand, /*withBatchStride=*/true, args);
+  if (bias) {
+    auto [ptr, offset] = utils::getPtrAndOffset(builder, bias, loc);
+    args.push_back(ptr);
+    args.push_back(offset);
+  } else {
+    args.push_back(builder.create<LLVM::ZeroOp>(
+        loc, LLVM::LLVMPointerType::get(builder.getContext())));
+    args.push_back(builder.create<arith::ConstantIndexOp>(loc, 0));
+  }
+  buildCall(builder, op, "linalg_matmul_dnnl", args);
+}
+
+// Return the bias row added in place to all the rows of `out` by `op`.
+static Value getBiasAdd(Operation *op, Value out) {
+  auto genericOp = dyn_cast_or_null<linalg::GenericOp>(op);
+  if (!genericOp || !genericOp.hasPureBufferSemantics() ||
+      genericOp.getNumDpsInits() != 1 || genericOp.getDpsInits()[0] != out ||
+      !structured_match::utils::isTwoDAddOp(genericOp)) {
+    return nullptr;
+  }
+  Value bias;
+  for (OpOperand *input : genericOp.getDpsInputOperands()) {
+    AffineMap map = genericOp.getMatchingIndexingMap(input);
+    if (input->get() == out && map.isIdentity())
+      continue;
+    auto biasType = dyn_cast<MemRefType>(input->get().getType());
+    if (bias || !biasType || !biasType.getLayout().isIdentity() ||
+        biasType.getElementType() != cast<MemRefType>(out.getType())
+                                         .getElementType()) {
+      return nullptr;
+    }
+    // A row of N, or a 1xN matrix.
+    ArrayRef<AffineExpr> results = map.getResults();
+    if (results.empty() ||
+        results.back() != getAffineDimExpr(1, op->getContext()))
+      return nullptr;
+    if (!llvm::all_of(results.drop_back(), [](AffineExpr expr) {
+          auto cst = dyn_cast<AffineConstantExpr>(expr);
+          return cst && cst.getValue() == 0;
+        })) {
+      return nullptr;
+    }
+    bias = input->get();
+  }
+  // With the bias as only input, the output is the other term of the sum.
+  if (genericOp.getNumDpsInputs() == 1 &&
+      !genericOp.payloadUsesValueFromOperand(genericOp.getDpsInitOperand(0)))
+    return nullptr;
+  return bias;
+}
+
+// Return true if `op` applies a relu in place to `out`.
+static bool isReluInPlace(Operation *op, Value out) {
+  auto genericOp = dyn_cast_or_null<linalg::GenericOp>(op);
+  return genericOp && genericOp.hasPureBufferSemantics() &&
+         genericOp.getNumDpsInits() == 1 && genericOp.getDpsInits()[0] == out &&
+         llvm::all_of(genericOp.getDpsInputs(),
+                      [&](Value input) { return input == out; }) &&
+         structured_match::utils::isTwoDReluOp(genericOp);
 }
 
-struct ConvertMatmulOp : public OpRewritePattern<linalg::MatmulOp> {
-  using OpRewritePattern<linalg::MatmulOp>::OpRewritePattern;
+template <typename OpTy>
+struct ConvertMatmulOp : public OpRewritePattern<OpTy> {
+  using OpRewritePattern<OpTy>::OpRewritePattern;
 
-  LogicalResult matchAndRewrite(linalg::MatmulOp matmulOp,
+  LogicalResult matchAndRewrite(OpTy matmulOp,
                                 PatternRewriter &rewriter) const override {
     if (!matmulOp.hasPureBufferSemantics())
       return failure();
     SmallVector<Value> operands = matmulOp.getDpsInputs();
     operands.push_back(matmulOp.getDpsInits()[0]);
-    if (!llvm::all_of(operands, [](Value operand) {
-          MemRefType memref = cast<MemRefType>(operand.getType());
-          return memref.getLayout().isIdentity() &&
-                 memref.getElementType().isF32();
-        })) {
+    if (!llvm::all_of(operands, hasUnitInnerStride))
+      return failure();
+    auto getElementType = [](Value operand) {
+      return cast<MemRefType>(operand.getType()).getElementType();
+    };
+    auto dataTypes =
+        getDnnlDataTypes(getElementType(operands[0]),
+                         getElementType(operands[1]),
+                         getElementType(operands[2]));
+    if (!dataTypes)
       return failure();
+
+    // The bias and relu applied in place right after a matmul become
+    // post-ops of the primitive.
+    Value out = operands[2];
+    Operation *biasOp = nullptr;
+    Operation *reluOp = nullptr;
+    Value bias;
+    if (isa<linalg::MatmulOp>(matmulOp)) {
+      Operation *next = matmulOp->getNextNode();
+      bias = getBiasAdd(next, out);
+      // The bias is read by the call, in place of the matmul.
+      Operation *biasDef = bias ? bias.getDefiningOp() : nullptr;
+      if (biasDef && biasDef->getBlock() == matmulOp->getBlock() &&
+          !biasDef->isBeforeInBlock(matmulOp)) {
+        bias = nullptr;
+      }
+      if (bias) {
+        biasOp = next;
+        next = next->getNextNode();
+      }
+      if (isReluInPlace(next, out))
+        reluOp = next;
+    }
+
+    if (isa<linalg::MatmulOp>(matmulOp) && *dataTypes == DnnlDataTypes::F32 &&
+        !biasOp && !reluOp) {
+      buildGemmCall(rewriter, matmulOp, operands);
+    } else {
+      buildDnnlCall(rewriter, matmulOp, *dataTypes, operands, bias,
+                    reluOp != nullptr);
     }
-    buildInvokeCall(rewriter, matmulOp);
+    if (reluOp)
+      rewriter.eraseOp(reluOp);
+    if (biasOp)
+      rewriter.eraseOp(biasOp);
     rewriter.eraseOp(matmulOp);
     return success();
   }
@@ -126,7 +293,8 @@ struct ConvertLinalgToFunc
   void runOnOperation() override {
     auto *ctx = &getContext();
     RewritePatternSet patterns(ctx);
-    patterns.add<ConvertMatmulOp>(ctx);
+    patterns.add<ConvertMatmulOp<linalg::MatmulOp>,
+                 ConvertMatmulOp<linalg::BatchMatmulOp>>(ctx);
     (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
   }
 };
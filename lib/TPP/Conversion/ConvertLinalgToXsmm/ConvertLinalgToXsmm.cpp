@@ -9,6 +9,7 @@
 #include "TPP/Dialect/Xsmm/XsmmOps.h"
 #include "TPP/Dialect/Xsmm/XsmmUtils.h"
 #include "TPP/IR/MatcherUtils.h"
+#include "TPP/IR/OpClassification.h"
 #include "TPP/IR/StructuredOpMatcher.h"
 #include "TPP/Passes.h"
 #include "TPP/Transforms/Transforms.h"
@@ -18,13 +19,21 @@
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
 #include "mlir/Dialect/Linalg/Utils/Utils.h"
+#include "mlir/Dialect/Math/IR/Math.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/Dialect/Tensor/IR/Tensor.h"
 #include "mlir/Dialect/Utils/IndexingUtils.h"
+#include "mlir/IR/Dominance.h"
+#include "mlir/IR/Matchers.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 #include "llvm/Support/Debug.h"
 
 using namespace mlir;
+using structured_match::isOpOfKind;
+using structured_match::OpClassification;
+using structured_match::utils::OpKind;
 
 namespace mlir {
 namespace tpp {
@@ -63,6 +72,13 @@ struct BrgemmInfo {
   int64_t strideB;
 
   bool isVnni = false;
+
+  // A is stored as (k, m) or B as (n, k).
+  bool isTransposedA = false;
+  bool isTransposedB = false;
+
+  // Position of m in the output when m is only known at runtime.
+  std::optional<unsigned> dynamicMPosInC = std::nullopt;
 };
 
 } // namespace
@@ -98,14 +114,34 @@ static void replaceOpWithBinary(RewriterBase &rewriter,
                                               invokeOperands);
 }
 
+// Create a unary dispatch plus invoke at the current insertion point.
+static void createUnary(RewriterBase &rewriter, Location loc,
+                        ArrayRef<Value> operands, xsmm::UnaryInfo unaryInfo,
+                        ArrayAttr flags, xsmm::UnaryKindAttr kind) {
+  IntegerType integer64 = IntegerType::get(rewriter.getContext(), 64);
+  DenseI64ArrayAttr dims = DenseI64ArrayAttr::get(
+      rewriter.getContext(), ArrayRef<int64_t>{unaryInfo.m, unaryInfo.n,
+                                               unaryInfo.ldi, unaryInfo.ldo});
+  auto dtype = xsmm::utils::getDataType(rewriter, operands.back().getType());
+  Value dispatched = rewriter.create<xsmm::UnaryDispatchOp>(
+      loc, integer64, kind, dims, flags, dtype);
+  SmallVector<Value> invokeOperands;
+  invokeOperands.push_back(dispatched);
+  invokeOperands.append(operands.begin(), operands.end());
+  rewriter.create<xsmm::UnaryOp>(loc, dtype, kind, invokeOperands);
+}
+
 // Convert a linalg.fill to XSMM zero, if the fill fills with zeros.
 struct ConvertFillOpToUnaryZero : public OpRewritePattern<linalg::FillOp> {
-  using OpRewritePattern<linalg::FillOp>::OpRewritePattern;
+  ConvertFillOpToUnaryZero(MLIRContext *ctx, OpClassification *classification)
+      : OpRewritePattern<linalg::FillOp>(ctx),
+        classification(classification) {}
 
   LogicalResult matchAndRewrite(linalg::FillOp fillOp,
                                 PatternRewriter &rewriter) const override {
     SmallVector<Value> operands;
-    if (!structured_match::utils::isTwoDFillOpWithZeros(fillOp, &operands) ||
+    if (!isOpOfKind(classification, fillOp, OpKind::FillWithZeros,
+                    &operands) ||
         operands.size() != 2) {
       return failure();
     }
@@ -123,18 +159,35 @@ struct ConvertFillOpToUnaryZero : public OpRewritePattern<linalg::FillOp> {
                                     flags, kind);
     return success();
   }
+
+private:
+  OpClassification *classification;
 };
 
+// Returns the flags of the XSMM unary replacing `op`: non-temporal stores for
+// the copies marked as writing a streaming output.
+static ArrayAttr getCopyUnaryFlags(RewriterBase &rewriter, Operation *op) {
+  xsmm::UnaryFlags flag = op->hasAttr(linalgx::utils::kNonTemporal)
+                              ? xsmm::UnaryFlags::NTS_HINT
+                              : xsmm::UnaryFlags::NONE;
+  return rewriter.getArrayAttr(
+      xsmm::UnaryFlagsAttr::get(rewriter.getContext(), flag));
+}
+
 // Convert a linalg.transpose to a XSMM unary transpose.
 struct ConvertTransposeOpToUnaryTranspose
     : public OpRewritePattern<linalg::TransposeOp> {
-  using OpRewritePattern<linalg::TransposeOp>::OpRewritePattern;
+  ConvertTransposeOpToUnaryTranspose(MLIRContext *ctx,
+                                     OpClassification *classification)
+      : OpRewritePattern<linalg::TransposeOp>(ctx),
+        classification(classification) {}
 
   LogicalResult matchAndRewrite(linalg::TransposeOp transposeOp,
                                 PatternRewriter &rewriter) const override {
 
     SmallVector<Value> operands;
-    if (!structured_match::utils::isTwoDTransposeOp(transposeOp, &operands) ||
+    if (!isOpOfKind(classification, transposeOp, OpKind::Transpose,
+                    &operands) ||
         operands.size() != 2) {
       return failure();
     }
@@ -146,14 +199,16 @@ struct ConvertTransposeOpToUnaryTranspose
 
     // LIBXSMM for transpose wants the input dims and not the output.
     std::swap((*unaryInfo).m, (*unaryInfo).n);
-    auto flags = rewriter.getArrayAttr(xsmm::UnaryFlagsAttr::get(
-        rewriter.getContext(), xsmm::UnaryFlags::NONE));
+    auto flags = getCopyUnaryFlags(rewriter, transposeOp);
     xsmm::UnaryKindAttr kind = xsmm::UnaryKindAttr::get(
         rewriter.getContext(), xsmm::UnaryKind::TRANSPOSE);
     xsmm::utils::replaceOpWithUnary(rewriter, transposeOp, operands, *unaryInfo,
                                     flags, kind);
     return success();
   }
+
+private:
+  OpClassification *classification;
 };
 
 // Get the OpOperand matching 'input', assert if 'input' is not found.
@@ -267,9 +322,11 @@ static Value makeOperandShapeRowBroadCastable(RewriterBase &rewriter,
                                 *reassoc);
 }
 
-// Convert linalg.generic to xsmm unary relu or identity op.
+// Convert linalg.generic to xsmm unary relu, identity or exp op.
 struct ConvertGenericToUnary : public OpRewritePattern<linalg::GenericOp> {
-  using OpRewritePattern<linalg::GenericOp>::OpRewritePattern;
+  ConvertGenericToUnary(MLIRContext *ctx, OpClassification *classification)
+      : OpRewritePattern<linalg::GenericOp>(ctx),
+        classification(classification) {}
 
   LogicalResult matchAndRewrite(linalg::GenericOp genericOp,
                                 PatternRewriter &rewriter) const override {
@@ -278,13 +335,16 @@ struct ConvertGenericToUnary : public OpRewritePattern<linalg::GenericOp> {
       return failure();
 
     xsmm::UnaryKindAttr kind = xsmm::UnaryKindAttr();
-    if (structured_match::utils::isTwoDReluOp(genericOp, &operands)) {
+    if (isOpOfKind(classification, genericOp, OpKind::Relu, &operands)) {
       kind = xsmm::UnaryKindAttr::get(rewriter.getContext(),
                                       xsmm::UnaryKind::RELU);
-    } else if (structured_match::utils::isTwoDIdentityOp(genericOp,
-                                                         &operands)) {
+    } else if (isOpOfKind(classification, genericOp, OpKind::Identity,
+                          &operands)) {
       kind = xsmm::UnaryKindAttr::get(rewriter.getContext(),
                                       xsmm::UnaryKind::IDENTITY);
+    } else if (isOpOfKind(classification, genericOp, OpKind::Exp, &operands)) {
+      kind = xsmm::UnaryKindAttr::get(rewriter.getContext(),
+                                      xsmm::UnaryKind::EXP);
     }
 
     if (!kind || operands.size() != 2)
@@ -315,6 +375,9 @@ struct ConvertGenericToUnary : public OpRewritePattern<linalg::GenericOp> {
                                     flags, kind);
     return success();
   }
+
+private:
+  OpClassification *classification;
 };
 
 static FailureOr<xsmm::BinaryFlags>
@@ -401,8 +464,11 @@ static LogicalResult rewriteBinaryOp(RewriterBase &rewriter,
 // 1. Add
 // 2. Mul
 // 3. Sub
+// 4. Div
 struct ConvertGenericToBinary : public OpRewritePattern<linalg::GenericOp> {
-  using OpRewritePattern<linalg::GenericOp>::OpRewritePattern;
+  ConvertGenericToBinary(MLIRContext *ctx, OpClassification *classification)
+      : OpRewritePattern<linalg::GenericOp>(ctx),
+        classification(classification) {}
 
   LogicalResult matchAndRewrite(linalg::GenericOp genericOp,
                                 PatternRewriter &rewriter) const override {
@@ -411,17 +477,535 @@ struct ConvertGenericToBinary : public OpRewritePattern<linalg::GenericOp> {
       return failure();
     xsmm::BinaryKind kind = xsmm::BinaryKind::NONE;
 
-    if (structured_match::utils::isTwoDAddOp(genericOp, &operands))
+    if (isOpOfKind(classification, genericOp, OpKind::Add, &operands))
       kind = xsmm::BinaryKind::ADD;
-    else if (structured_match::utils::isTwoDMulOp(genericOp, &operands))
+    else if (isOpOfKind(classification, genericOp, OpKind::Mul, &operands))
       kind = xsmm::BinaryKind::MUL;
-    else if (structured_match::utils::isTwoDSubOp(genericOp, &operands))
+    else if (isOpOfKind(classification, genericOp, OpKind::Sub, &operands))
       kind = xsmm::BinaryKind::SUB;
+    else if (isOpOfKind(classification, genericOp, OpKind::Div, &operands))
+      kind = xsmm::BinaryKind::DIV;
 
     if (kind == xsmm::BinaryKind::NONE || operands.size() != 3)
       return failure();
     return rewriteBinaryOp(rewriter, genericOp, operands, kind);
   }
+
+private:
+  OpClassification *classification;
+};
+
+// Convert the numerator of a decomposed softmax, exp(input - max), to an xsmm
+// binary sub followed by an in-place xsmm unary exp on the output.
+struct ConvertGenericToSubExp : public OpRewritePattern<linalg::GenericOp> {
+  ConvertGenericToSubExp(MLIRContext *ctx, OpClassification *classification)
+      : OpRewritePattern<linalg::GenericOp>(ctx),
+        classification(classification) {}
+
+  LogicalResult matchAndRewrite(linalg::GenericOp genericOp,
+                                PatternRewriter &rewriter) const override {
+    SmallVector<Value> operands;
+    if (!genericOp.hasPureBufferSemantics() ||
+        !isOpOfKind(classification, genericOp, OpKind::SubExp, &operands) ||
+        operands.size() != 3) {
+      return failure();
+    }
+
+    Value output = operands[2];
+    auto unaryInfo =
+        xsmm::utils::getUnaryInfo(output, output, xsmm::UnaryFlags::NONE);
+    if (failed(unaryInfo))
+      return failure();
+
+    Location loc = genericOp.getLoc();
+    Operation *next = genericOp->getNextNode();
+    if (failed(rewriteBinaryOp(rewriter, genericOp, operands,
+                               xsmm::BinaryKind::SUB))) {
+      return failure();
+    }
+
+    rewriter.setInsertionPoint(next);
+    auto flags = rewriter.getArrayAttr(xsmm::UnaryFlagsAttr::get(
+        rewriter.getContext(), xsmm::UnaryFlags::NONE));
+    auto kind =
+        xsmm::UnaryKindAttr::get(rewriter.getContext(), xsmm::UnaryKind::EXP);
+    createUnary(rewriter, loc, {output, output}, *unaryInfo, flags, kind);
+    return success();
+  }
+
+private:
+  OpClassification *classification;
+};
+
+namespace {
+// Matrix equation built from the body of a linalg.generic, see
+// `xsmm.equation.dispatch`. Each input read by the body becomes an argument,
+// each supported operation a unary or binary node. The equation computes the
+// output `resultIdx` of the generic.
+struct EquationBuilder {
+  EquationBuilder(linalg::GenericOp genericOp, unsigned resultIdx = 0)
+      : genericOp(genericOp), resultIdx(resultIdx) {}
+
+  Value getOutput() { return genericOp.getDpsInits()[resultIdx]; }
+
+  // Append the nodes computing `value` in pre-order. Return the broadcast of
+  // `value` if it is an argument, the flags go on the node using it.
+  FailureOr<BroadCastType> addNodes(Value value);
+
+  linalg::GenericOp genericOp;
+  unsigned resultIdx;
+  SmallVector<int64_t> args;
+  SmallVector<int64_t> nodes;
+  SmallVector<Value> operands;
+  int64_t numOps = 0;
+
+private:
+  FailureOr<BroadCastType> addArg(BlockArgument blockArg);
+  LogicalResult addUnary(xsmm::UnaryKind kind, Value operand);
+  LogicalResult addBinary(xsmm::BinaryKind kind, Value lhs, Value rhs);
+
+  void addNode(xsmm::EquationNodeKind kind, int64_t op, int64_t flags) {
+    nodes.append({static_cast<int64_t>(kind), op, flags});
+  }
+
+  // Equation argument of each input operand.
+  DenseMap<unsigned, int64_t> argIdx;
+};
+} // namespace
+
+// The [m, n, ld] of an argument with broadcast `type`. A broadcast argument
+// must be contiguous as it is described by its own shape.
+static FailureOr<SmallVector<int64_t>>
+getEquationArgShape(Value operand, AffineMap map, BroadCastType type,
+                    int64_t m, int64_t n) {
+  auto memrefType = dyn_cast<MemRefType>(operand.getType());
+  auto strides = mlir::utils::getStaticStrides(operand);
+  if (!memrefType || !memrefType.hasStaticShape() || failed(strides))
+    return failure();
+
+  if (type == BroadCastType::NONE) {
+    if (!map.isIdentity() || strides->back() != 1 ||
+        memrefType.getShape() != ArrayRef<int64_t>{m, n}) {
+      return failure();
+    }
+    return SmallVector<int64_t>{m, n, strides->front()};
+  }
+
+  for (auto [size, stride] : llvm::zip(memrefType.getShape(), *strides)) {
+    if (size != 1 && stride != 1)
+      return failure();
+  }
+  SmallVector<int64_t> shape;
+  if (type == BroadCastType::ROW)
+    shape = {m, 1, 1};
+  else if (type == BroadCastType::COL)
+    shape = {1, n, n};
+  else
+    shape = {1, 1, 1};
+  if (memrefType.getNumElements() != shape[0] * shape[1])
+    return failure();
+  return shape;
+}
+
+FailureOr<BroadCastType> EquationBuilder::addArg(BlockArgument blockArg) {
+  if (blockArg.getOwner() != genericOp.getBody())
+    return failure();
+  // Reading the output would make the equation accumulate.
+  OpOperand *operand = genericOp.getMatchingOpOperand(blockArg);
+  if (!genericOp.isDpsInput(operand))
+    return failure();
+
+  AffineMap map = genericOp.getMatchingIndexingMap(operand);
+  auto broadCastType = getBroadCastFromMap(map);
+  if (failed(broadCastType))
+    return failure();
+
+  auto [it, inserted] =
+      argIdx.try_emplace(operand->getOperandNumber(), operands.size());
+  if (inserted) {
+    auto outputType = cast<MemRefType>(getOutput().getType());
+    auto shape = getEquationArgShape(operand->get(), map, *broadCastType,
+                                     outputType.getShape()[0],
+                                     outputType.getShape()[1]);
+    if (failed(shape))
+      return failure();
+    args.append(*shape);
+    operands.push_back(operand->get());
+  }
+  addNode(xsmm::EquationNodeKind::ARG, it->second, /*flags=*/0);
+  return *broadCastType;
+}
+
+LogicalResult EquationBuilder::addUnary(xsmm::UnaryKind kind, Value operand) {
+  size_t nodeIdx = nodes.size();
+  addNode(xsmm::EquationNodeKind::UNARY, static_cast<int64_t>(kind),
+          /*flags=*/0);
+  auto broadCastType = addNodes(operand);
+  if (failed(broadCastType))
+    return failure();
+
+  xsmm::UnaryFlags flags = xsmm::UnaryFlags::NONE;
+  if (*broadCastType == BroadCastType::SCALAR)
+    flags = xsmm::UnaryFlags::BCAST_SCALAR;
+  else if (*broadCastType == BroadCastType::ROW)
+    flags = xsmm::UnaryFlags::BCAST_ROW;
+  else if (*broadCastType == BroadCastType::COL)
+    flags = xsmm::UnaryFlags::BCAST_COL;
+  nodes[nodeIdx + 2] = static_cast<int64_t>(flags);
+  return success();
+}
+
+LogicalResult EquationBuilder::addBinary(xsmm::BinaryKind kind, Value lhs,
+                                         Value rhs) {
+  size_t nodeIdx = nodes.size();
+  addNode(xsmm::EquationNodeKind::BINARY, static_cast<int64_t>(kind),
+          /*flags=*/0);
+  int64_t flags = 0;
+  SmallVector<Value, 2> binaryOperands = {lhs, rhs};
+  for (auto [idx, operand] : llvm::enumerate(binaryOperands)) {
+    auto broadCastType = addNodes(operand);
+    if (failed(broadCastType))
+      return failure();
+    switch (*broadCastType) {
+    case BroadCastType::SCALAR:
+      flags |= static_cast<int64_t>(idx == 0
+                                        ? xsmm::BinaryFlags::BCAST_SCALAR_IN_0
+                                        : xsmm::BinaryFlags::BCAST_SCALAR_IN_1);
+      break;
+    case BroadCastType::ROW:
+      flags |= static_cast<int64_t>(idx == 0
+                                        ? xsmm::BinaryFlags::BCAST_ROW_IN_0
+                                        : xsmm::BinaryFlags::BCAST_ROW_IN_1);
+      break;
+    case BroadCastType::COL:
+      flags |= static_cast<int64_t>(idx == 0
+                                        ? xsmm::BinaryFlags::BCAST_COL_IN_0
+                                        : xsmm::BinaryFlags::BCAST_COL_IN_1);
+      break;
+    case BroadCastType::NONE:
+      break;
+    }
+  }
+  nodes[nodeIdx + 2] = flags;
+  return success();
+}
+
+FailureOr<BroadCastType> EquationBuilder::addNodes(Value value) {
+  if (!isa<FloatType>(value.getType()))
+    return failure();
+  if (auto blockArg = dyn_cast<BlockArgument>(value))
+    return addArg(blockArg);
+
+  Operation *op = value.getDefiningOp();
+  if (op->getBlock() != genericOp.getBody())
+    return failure();
+  numOps++;
+
+  LogicalResult result = failure();
+  auto isZero = [](Value val) { return matchPattern(val, m_AnyZeroFloat()); };
+  if (isa<math::ExpOp>(op)) {
+    result = addUnary(xsmm::UnaryKind::EXP, op->getOperand(0));
+  } else if (isa<math::TanhOp>(op)) {
+    result = addUnary(xsmm::UnaryKind::TANH, op->getOperand(0));
+  } else if (isa<math::SqrtOp>(op)) {
+    result = addUnary(xsmm::UnaryKind::SQRT, op->getOperand(0));
+  } else if (isa<math::RsqrtOp>(op)) {
+    result = addUnary(xsmm::UnaryKind::RECIPROCAL_SQRT, op->getOperand(0));
+  } else if (isa<arith::NegFOp>(op)) {
+    result = addUnary(xsmm::UnaryKind::NEGATE, op->getOperand(0));
+  } else if (isa<arith::MaximumFOp, arith::MaxNumFOp>(op) &&
+             (isZero(op->getOperand(0)) || isZero(op->getOperand(1)))) {
+    Value operand = op->getOperand(isZero(op->getOperand(0)) ? 1 : 0);
+    result = addUnary(xsmm::UnaryKind::RELU, operand);
+  } else if (isa<arith::DivFOp>(op) &&
+             matchPattern(op->getOperand(0), m_OneFloat())) {
+    result = addUnary(xsmm::UnaryKind::RECIPROCAL, op->getOperand(1));
+  } else if (isa<arith::AddFOp>(op)) {
+    result = addBinary(xsmm::BinaryKind::ADD, op->getOperand(0),
+                       op->getOperand(1));
+  } else if (isa<arith::SubFOp>(op)) {
+    result = addBinary(xsmm::BinaryKind::SUB, op->getOperand(0),
+                       op->getOperand(1));
+  } else if (isa<arith::MulFOp>(op)) {
+    result = addBinary(xsmm::BinaryKind::MUL, op->getOperand(0),
+                       op->getOperand(1));
+  } else if (isa<arith::DivFOp>(op)) {
+    result = addBinary(xsmm::BinaryKind::DIV, op->getOperand(0),
+                       op->getOperand(1));
+  }
+  if (failed(result))
+    return failure();
+  return BroadCastType::NONE;
+}
+
+// Fill `builder` with the nodes computing its output, which must take at least
+// `minOps` operations.
+static LogicalResult buildEquation(EquationBuilder &builder, int64_t minOps) {
+  linalg::GenericOp genericOp = builder.genericOp;
+  OpOperand *outputOperand = genericOp.getDpsInitOperand(builder.resultIdx);
+  auto outputType = cast<MemRefType>(builder.getOutput().getType());
+  auto strides = mlir::utils::getStaticStrides(builder.getOutput());
+  if (!genericOp.getMatchingIndexingMap(outputOperand).isIdentity() ||
+      !outputType.hasStaticShape() ||
+      !isa<FloatType>(outputType.getElementType()) || failed(strides) ||
+      strides->back() != 1) {
+    return failure();
+  }
+
+  auto yieldOp = cast<linalg::YieldOp>(genericOp.getBody()->getTerminator());
+  if (failed(builder.addNodes(yieldOp.getOperand(builder.resultIdx))) ||
+      builder.numOps < minOps) {
+    return failure();
+  }
+  Type elementType = outputType.getElementType();
+  if (llvm::any_of(builder.operands, [&](Value operand) {
+        return getElementTypeOrSelf(operand.getType()) != elementType;
+      })) {
+    return failure();
+  }
+  return success();
+}
+
+// Dispatch and invoke the equation of `builder` on its output.
+static void createEquation(RewriterBase &rewriter, EquationBuilder &builder) {
+  Location loc = builder.genericOp.getLoc();
+  Value output = builder.getOutput();
+  auto outputType = cast<MemRefType>(output.getType());
+  auto strides = *mlir::utils::getStaticStrides(output);
+  auto dtype = xsmm::utils::getDataType(rewriter, outputType);
+  Value dispatched = rewriter.create<xsmm::EquationDispatchOp>(
+      loc, rewriter.getI64Type(),
+      rewriter.getDenseI64ArrayAttr({outputType.getShape()[0],
+                                     outputType.getShape()[1],
+                                     strides.front()}),
+      rewriter.getDenseI64ArrayAttr(builder.args),
+      rewriter.getDenseI64ArrayAttr(builder.nodes), dtype);
+  SmallVector<Value> invokeOperands = {dispatched};
+  llvm::append_range(invokeOperands, builder.operands);
+  invokeOperands.push_back(output);
+  rewriter.create<xsmm::EquationOp>(loc, dtype, invokeOperands);
+}
+
+// Convert a 2d element-wise linalg.generic whose body is a tree of unary and
+// binary operations to a single xsmm equation. The intermediate results stay
+// in registers instead of going back to memory as with one xsmm unary or
+// binary per operation. Bodies with a single operation are left to the unary
+// and binary patterns.
+struct ConvertGenericToEquation : public OpRewritePattern<linalg::GenericOp> {
+  using OpRewritePattern<linalg::GenericOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(linalg::GenericOp genericOp,
+                                PatternRewriter &rewriter) const override {
+    if (!genericOp.hasPureBufferSemantics() || genericOp.getNumLoops() != 2 ||
+        genericOp.getNumParallelLoops() != 2 ||
+        genericOp.getNumDpsInits() != 1 || genericOp.getNumDpsInputs() == 0) {
+      return failure();
+    }
+    EquationBuilder builder(genericOp);
+    if (failed(buildEquation(builder, /*minOps=*/2)))
+      return failure();
+
+    rewriter.setInsertionPoint(genericOp);
+    createEquation(rewriter, builder);
+    rewriter.eraseOp(genericOp);
+    return success();
+  }
+};
+
+// Return the buffer `value` is a view of.
+static Value getViewSource(Value value) {
+  while (auto viewOp = value.getDefiningOp<ViewLikeOpInterface>())
+    value = viewOp.getViewSource();
+  return value;
+}
+
+// Convert a 2d element-wise linalg.generic with several outputs, e.g. the fused
+// parameter and moment updates of an optimizer step, to one xsmm equation per
+// output. The equations run back to back on the same operands, which are
+// still in cache for all but the first one. An output may overwrite an operand
+// in place, so the equations are ordered such that no output is written before
+// the other equations are done reading its buffer.
+struct ConvertGenericToEquations : public OpRewritePattern<linalg::GenericOp> {
+  using OpRewritePattern<linalg::GenericOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(linalg::GenericOp genericOp,
+                                PatternRewriter &rewriter) const override {
+    if (!genericOp.hasPureBufferSemantics() || genericOp.getNumLoops() != 2 ||
+        genericOp.getNumParallelLoops() != 2 ||
+        genericOp.getNumDpsInits() < 2 || genericOp.getNumDpsInputs() == 0) {
+      return failure();
+    }
+    SmallVector<EquationBuilder, 4> builders;
+    for (unsigned idx = 0, e = genericOp.getNumDpsInits(); idx < e; idx++) {
+      builders.emplace_back(genericOp, idx);
+      if (failed(buildEquation(builders.back(), /*minOps=*/1)))
+        return failure();
+    }
+
+    // An equation can run once no other pending one reads its output.
+    auto readsBuffer = [](EquationBuilder &builder, Value buffer) {
+      return llvm::any_of(builder.operands, [&](Value operand) {
+        return getViewSource(operand) == buffer;
+      });
+    };
+    SmallVector<unsigned> order;
+    SmallVector<bool> pending(builders.size(), true);
+    while (order.size() < builders.size()) {
+      size_t numOrdered = order.size();
+      for (size_t idx = 0, e = builders.size(); idx < e; idx++) {
+        if (!pending[idx])
+          continue;
+        Value buffer = getViewSource(builders[idx].getOutput());
+        bool isRead = false;
+        for (size_t other = 0; other < e; other++) {
+          if (other != idx && pending[other])
+            isRead |= readsBuffer(builders[other], buffer);
+        }
+        if (isRead)
+          continue;
+        order.push_back(idx);
+        pending[idx] = false;
+      }
+      if (order.size() == numOrdered)
+        return rewriter.notifyMatchFailure(genericOp,
+                                           "outputs overwrite each other");
+    }
+
+    rewriter.setInsertionPoint(genericOp);
+    for (unsigned idx : order)
+      createEquation(rewriter, builders[idx]);
+    rewriter.eraseOp(genericOp);
+    return success();
+  }
+};
+
+// Return the operation writing the neutral element of the reduction `kind`
+// into `init` right before `op`: a linalg.fill, or an xsmm zero for a sum.
+// Operations without memory effects in between are skipped.
+static Operation *getNeutralInit(Operation *op, Value init,
+                                 xsmm::UnaryKind kind) {
+  Operation *prev = op->getPrevNode();
+  while (prev && isMemoryEffectFree(prev))
+    prev = prev->getPrevNode();
+  if (!prev)
+    return nullptr;
+
+  if (auto zeroOp = dyn_cast<xsmm::UnaryOp>(prev)) {
+    bool isZero = zeroOp.getCallee() == xsmm::UnaryKind::ZERO &&
+                  zeroOp.getInputs().back() == init;
+    return (isZero && kind == xsmm::UnaryKind::REDUCE_X_OP_ADD) ? prev
+                                                                : nullptr;
+  }
+
+  auto fillOp = dyn_cast<linalg::FillOp>(prev);
+  if (!fillOp || fillOp.getDpsInits()[0] != init)
+    return nullptr;
+
+  Value value = fillOp.getDpsInputs()[0];
+  if (kind == xsmm::UnaryKind::REDUCE_X_OP_ADD)
+    return mlir::utils::isValConstZero(value) ? prev : nullptr;
+
+  // A max starts from -inf, or from the lowest finite value.
+  FloatAttr cst;
+  if (!matchPattern(value, m_Constant(&cst)))
+    return nullptr;
+  APFloat neutral = cst.getValue();
+  if (!neutral.isNegative() || (!neutral.isInfinity() && !neutral.isLargest()))
+    return nullptr;
+  return prev;
+}
+
+// Get the unary info of a reduction of the 2d `input` into the 1d `output`.
+static FailureOr<xsmm::UnaryInfo> getReduceInfo(Value input, Value output) {
+  auto inputType = cast<ShapedType>(input.getType());
+  auto stridesOnInput = mlir::utils::getStaticStrides(input);
+  if (failed(stridesOnInput) || stridesOnInput->back() != 1)
+    return failure();
+  auto stridesOnOutput = mlir::utils::getStaticStrides(output);
+  if (failed(stridesOnOutput) || stridesOnOutput->back() != 1)
+    return failure();
+
+  xsmm::UnaryInfo unaryInfo;
+  unaryInfo.m = inputType.getShape()[0];
+  unaryInfo.n = inputType.getShape()[1];
+  unaryInfo.ldi = stridesOnInput->front();
+  // The output is a contiguous vector, the leading dimension only has to
+  // cover the row.
+  unaryInfo.ldo = unaryInfo.n;
+  return unaryInfo;
+}
+
+// Convert a 2d sum or max reduction to an xsmm unary reduce. Reducing the
+// innermost dimension maps to `reduce_rows`, the outermost to `reduce_cols`.
+// LIBXSMM overwrites the output, so the reduction must start from the neutral
+// element written right before it; that initialization is then dropped.
+struct ConvertReductionToUnaryReduce
+    : public OpInterfaceRewritePattern<linalg::LinalgOp> {
+  ConvertReductionToUnaryReduce(MLIRContext *ctx,
+                                OpClassification *classification)
+      : OpInterfaceRewritePattern<linalg::LinalgOp>(ctx),
+        classification(classification) {}
+
+  LogicalResult matchAndRewrite(linalg::LinalgOp linalgOp,
+                                PatternRewriter &rewriter) const override {
+    if (!isa<linalg::GenericOp, linalg::ReduceOp>(linalgOp) ||
+        !linalgOp.hasPureBufferSemantics()) {
+      return failure();
+    }
+
+    SmallVector<Value> operands;
+    xsmm::UnaryKind kind = xsmm::UnaryKind::NONE;
+    if (isOpOfKind(classification, linalgOp, OpKind::ReduceAdd, &operands))
+      kind = xsmm::UnaryKind::REDUCE_X_OP_ADD;
+    else if (isOpOfKind(classification, linalgOp, OpKind::ReduceMax, &operands))
+      kind = xsmm::UnaryKind::REDUCE_X_OP_MAX;
+    if (kind == xsmm::UnaryKind::NONE || operands.size() != 2)
+      return failure();
+
+    // The output keeps the parallel dimension.
+    AffineMap outputMap =
+        linalgOp.getMatchingIndexingMap(linalgOp.getDpsInitOperand(0));
+    unsigned outputDim = 0;
+    for (AffineExpr expr : outputMap.getResults()) {
+      if (auto dimExpr = dyn_cast<AffineDimExpr>(expr))
+        outputDim = dimExpr.getPosition();
+    }
+    if (!linalg::isParallelIterator(
+            linalgOp.getIteratorTypesArray()[outputDim])) {
+      return failure();
+    }
+    xsmm::UnaryFlags flag = (outputDim == 0) ? xsmm::UnaryFlags::REDUCE_ROWS
+                                             : xsmm::UnaryFlags::REDUCE_COLS;
+
+    Operation *initOp = getNeutralInit(linalgOp, operands[1], kind);
+    if (!initOp)
+      return rewriter.notifyMatchFailure(linalgOp, "expects a neutral init");
+
+    auto unaryInfo = getReduceInfo(operands[0], operands[1]);
+    if (failed(unaryInfo))
+      return failure();
+
+    // Drop the unit reduced dimension, if any, of the output.
+    auto outputType = cast<MemRefType>(operands[1].getType());
+    if (outputType.getRank() == 2) {
+      SmallVector<ReassociationIndices> reassoc = {{0, 1}};
+      operands[1] = linalgx::utils::collapse(
+          rewriter, linalgOp.getLoc(), operands[1],
+          memref::CollapseShapeOp::computeCollapsedType(outputType, reassoc),
+          reassoc);
+    }
+
+    auto flags = rewriter.getArrayAttr(
+        xsmm::UnaryFlagsAttr::get(rewriter.getContext(), flag));
+    auto kindAttr = xsmm::UnaryKindAttr::get(rewriter.getContext(), kind);
+    xsmm::utils::replaceOpWithUnary(rewriter, linalgOp, operands, *unaryInfo,
+                                    flags, kindAttr);
+    rewriter.eraseOp(initOp);
+    return success();
+  }
+
+private:
+  OpClassification *classification;
 };
 
 // Replace linalgOp with a matmul or a batch reduce matmul.
@@ -439,27 +1023,57 @@ static void replaceOpWithGemmLikeOp(RewriterBase &rewriter,
   int64_t strideA = brgemmInfo.strideA;
   int64_t strideB = brgemmInfo.strideB;
 
+  // Use the input type, integer gemms accumulate i8 inputs into i32.
   auto dtype =
-      xsmm::utils::getDataType(rewriter, linalgOp.getDpsInits()[0].getType());
+      xsmm::utils::getDataType(rewriter, linalgOp.getDpsInputs()[0].getType());
+  // bf16 and f16 gemms accumulate in f32, an f32 output stores the
+  // accumulator as it is.
+  xsmm::DataTypeAttr outputType;
+  if ((dtype.getValue() == xsmm::DataType::BF16 ||
+       dtype.getValue() == xsmm::DataType::F16) &&
+      getElementTypeOrSelf(linalgOp.getDpsInits()[0].getType()).isF32()) {
+    outputType =
+        xsmm::DataTypeAttr::get(rewriter.getContext(), xsmm::DataType::F32);
+  }
   IntegerType integer64 = IntegerType::get(rewriter.getContext(), 64);
   Location loc = linalgOp.getLoc();
-  xsmm::GemmFlagsAttr gemmFlags;
+  SmallVector<Attribute> gemmFlags;
   if (brgemmInfo.isVnni) {
-    gemmFlags = xsmm::GemmFlagsAttr::get(rewriter.getContext(),
-                                         xsmm::GemmFlags::VNNI_B);
-  } else {
-    gemmFlags =
-        xsmm::GemmFlagsAttr::get(rewriter.getContext(), xsmm::GemmFlags::NONE);
+    gemmFlags.push_back(xsmm::GemmFlagsAttr::get(rewriter.getContext(),
+                                                 xsmm::GemmFlags::VNNI_B));
+  }
+  if (brgemmInfo.isTransposedA) {
+    gemmFlags.push_back(xsmm::GemmFlagsAttr::get(rewriter.getContext(),
+                                                 xsmm::GemmFlags::TRANS_A));
+  }
+  if (brgemmInfo.isTransposedB) {
+    gemmFlags.push_back(xsmm::GemmFlagsAttr::get(rewriter.getContext(),
+                                                 xsmm::GemmFlags::TRANS_B));
+  }
+  if (gemmFlags.empty()) {
+    gemmFlags.push_back(
+        xsmm::GemmFlagsAttr::get(rewriter.getContext(), xsmm::GemmFlags::NONE));
   }
   auto flags = rewriter.getArrayAttr(gemmFlags);
   SmallVector<Value> invokeOperands;
 
+  // A dynamic m is read from the output and the kernel is dispatched on it at
+  // runtime.
+  SmallVector<Value> dynamicInputs;
+  if (brgemmInfo.dynamicMPosInC) {
+    Value dimM = linalg::createOrFoldDimOp(rewriter, loc,
+                                           linalgOp.getDpsInits()[0],
+                                           *brgemmInfo.dynamicMPosInC);
+    dynamicInputs.push_back(
+        rewriter.create<arith::IndexCastOp>(loc, integer64, dimM));
+  }
+
   if (batch != 0) {
     DenseI64ArrayAttr dims = DenseI64ArrayAttr::get(
         rewriter.getContext(),
         ArrayRef<int64_t>{m, n, k, lda, ldb, ldc, strideA, strideB});
     Value dispatched = rewriter.create<xsmm::BrgemmDispatchOp>(
-        loc, integer64, dims, flags, dtype);
+        loc, integer64, dynamicInputs, dims, flags, dtype, outputType);
     Value batchDim = rewriter.create<arith::ConstantOp>(
         loc, integer64, rewriter.getIntegerAttr(integer64, batch));
     invokeOperands.push_back(dispatched);
@@ -472,7 +1086,7 @@ static void replaceOpWithGemmLikeOp(RewriterBase &rewriter,
     DenseI64ArrayAttr dims = DenseI64ArrayAttr::get(
         rewriter.getContext(), ArrayRef<int64_t>{m, n, k, lda, ldb, ldc});
     Value dispatched = rewriter.create<xsmm::GemmDispatchOp>(
-        loc, integer64, dims, flags, dtype);
+        loc, integer64, dynamicInputs, dims, flags, dtype, outputType);
     invokeOperands.push_back(dispatched);
     invokeOperands.append(linalgOp->getOperands().begin(),
                           linalgOp->getOperands().end());
@@ -487,8 +1101,6 @@ checkStructure(linalg::LinalgOp linalgOp) {
   using namespace structured_match;
   auto maybeBrgemmMatcher =
     StructuredOpMatcher::make<linalg::LinalgOp>()
-      .output(MatchAll(), HasStaticShape())
-      .input(MatchAll(), HasStaticShape())
       .output(MatchAll(), HasStaticStrides())
       .input(MatchAll(), HasStaticStrides())
       .operation(NumOfLoops(GreaterThanOrEqualTo(3)));
@@ -515,10 +1127,26 @@ checkStructure(linalg::LinalgOp linalgOp) {
                << "[checkStructure] Not all loops are classified\n");
     return failure();
   }
+  // Only m can be dynamic, it is dispatched at runtime. The other sizes
+  // determine the leading dimensions and the batch strides.
+  for (auto [pos, size] : llvm::enumerate(linalgOp.computeStaticLoopSizes())) {
+    if (ShapedType::isDynamic(size) && pos != contractionDims->m[0]) {
+      LLVM_DEBUG(llvm::dbgs() << "[checkStructure] Dynamic n, k or batch\n");
+      return failure();
+    }
+  }
   return contractionDims;
 }
 
 // Access matcher.
+// LIBXSMM reads the transposed A and B of f32 gemms in place, see TRANS_A and
+// TRANS_B. The other types need their operands in a VNNI layout.
+static bool hasTransposeFlags(linalg::LinalgOp linalgOp) {
+  return llvm::all_of(linalgOp.getDpsInputs(), [](Value operand) {
+    return getElementTypeOrSelf(operand.getType()).isF32();
+  });
+}
+
 static FailureOr<BrgemmInfo> checkAccess(linalg::LinalgOp linalgOp, unsigned m,
                                          unsigned n, unsigned k,
                                          std::optional<unsigned> batchPos) {
@@ -540,14 +1168,24 @@ static FailureOr<BrgemmInfo> checkAccess(linalg::LinalgOp linalgOp, unsigned m,
     return (*stridesOnOperand)[*majorDimPosInCodomain];
   };
 
-  // A(m, k)
+  // A(m, k), or A(k, m) transposed.
+  bool isTransposedA = false;
   auto lda = checkStridesAndGetLda(k, m, operandA);
+  if (failed(lda) && hasTransposeFlags(linalgOp)) {
+    lda = checkStridesAndGetLda(m, k, operandA);
+    isTransposedA = succeeded(lda);
+  }
   if (failed(lda))
     return failure();
   LLVM_DEBUG(llvm::dbgs() << "[isMappableToBrgemm] Strides on A: OK\n");
 
-  // B(k, n)
+  // B(k, n), or B(n, k) transposed.
+  bool isTransposedB = false;
   auto ldb = checkStridesAndGetLda(n, k, operandB);
+  if (failed(ldb) && hasTransposeFlags(linalgOp)) {
+    ldb = checkStridesAndGetLda(k, n, operandB);
+    isTransposedB = succeeded(ldb);
+  }
   if (failed(ldb))
     return failure();
   LLVM_DEBUG(llvm::dbgs() << "[isMappableToBrgemm] Strides on B: OK\n");
@@ -577,6 +1215,10 @@ static FailureOr<BrgemmInfo> checkAccess(linalg::LinalgOp linalgOp, unsigned m,
 
   BrgemmInfo info{loops[m], loops[n], loops[k], batchVal, *lda,
                   *ldb,     *ldc,     strideA,  strideB};
+  info.isTransposedA = isTransposedA;
+  info.isTransposedB = isTransposedB;
+  if (ShapedType::isDynamic(info.m))
+    info.dynamicMPosInC = getPosInCodomain(m, operandC, linalgOp);
   return info;
 }
 
@@ -745,11 +1387,14 @@ makeMinorDimensionsInnerMost(RewriterBase &rewriter, linalg::GenericOp linalgOp,
     LLVM_DEBUG(llvm::dbgs()
                << "[makeMinorDimensionsInnerMost] emit transpose for C\n");
     assert(isInnerMostDim(&operandC, *minorMInCodomainOpC));
-    if (isInnerMostDim(operandA, *minorKInCodomainOpA)) {
+    // Once swapped, transposed operands are read in place with the gemm
+    // flags.
+    bool emitTransposes = !hasTransposeFlags(linalgOp);
+    if (emitTransposes && isInnerMostDim(operandA, *minorKInCodomainOpA)) {
       emitTransposeOnOperand(rewriter, linalgOp, operandA, *minorKInCodomainOpA,
                              *minorMInCodomainOpA);
     }
-    if (isInnerMostDim(operandB, *minorNInCodomainOpB)) {
+    if (emitTransposes && isInnerMostDim(operandB, *minorNInCodomainOpB)) {
       emitTransposeOnOperand(rewriter, linalgOp, operandB, *minorNInCodomainOpB,
                              *minorKInCodomainOpB);
     }
@@ -789,13 +1434,24 @@ makeMinorDimensionsInnerMost(RewriterBase &rewriter, linalg::GenericOp linalgOp,
   return linalgOp;
 }
 
+// Return true if `op` was routed to another lowering than XSMM.
+static bool isRoutedToOtherLowering(Operation *op) {
+  auto lowering = op->getAttrOfType<StringAttr>(linalgx::utils::kLowering);
+  return lowering && lowering.getValue() != linalgx::utils::kLoweringXsmm;
+}
+
 void ConvertLinalgToXsmm::runOnOperation() {
   MLIRContext *ctx = &getContext();
   RewritePatternSet patterns(ctx);
-  IRRewriter rewriter(&getContext());
+  // The generics are matched against each category of the patterns, at every
+  // iteration of the driver, the classification memoizes the matches.
+  auto &classification = getAnalysis<OpClassification>();
+  IRRewriter rewriter(&getContext(), &classification);
 
   // Enable conversion for linalg.generic to XSMM Brgemm if possible.
   auto res = getOperation()->walk([&](linalg::GenericOp genericOp) {
+    if (isRoutedToOtherLowering(genericOp))
+      return WalkResult::skip();
     auto contractionDims = checkStructure(genericOp);
     // If the generic does not match the structure of a Brgemm op, skip it.
     if (failed(contractionDims))
@@ -808,6 +1464,9 @@ void ConvertLinalgToXsmm::runOnOperation() {
       contractionDims->k.front();
 
     if (failed(checkAccess(genericOp, m, n, k, batch))) {
+      // The transposes below need static shapes.
+      if (genericOp.hasDynamicShape())
+        return WalkResult::skip();
       // The generic is a Brgemm but the strides of the selected dims (m, n, k)
       // are not unit strides. Inject transposes to bring them innermost.
       if (failed(makeMinorDimensionsInnerMost(rewriter, genericOp, m, n, k))) {
@@ -822,9 +1481,34 @@ void ConvertLinalgToXsmm::runOnOperation() {
   }
   SmallVector<StringRef> skipPatterns(skipOperations.begin(),
                                       skipOperations.end());
-  tpp::populateLinalgToXsmmPatterns(patterns, skipPatterns);
-  if (failed(applyPatternsAndFoldGreedily(getOperation(), std::move(patterns))))
+  tpp::populateLinalgToXsmmPatterns(patterns, skipPatterns, &classification);
+  GreedyRewriteConfig config;
+  config.listener = &classification;
+
+  // The operations routed to another lowering are not rewritten, only the
+  // others and the ones created by the patterns are.
+  SmallVector<Operation *> ops;
+  bool hasRoutedOps = false;
+  getOperation()->walk([&](Operation *op) {
+    if (op == getOperation())
+      return;
+    if (isRoutedToOtherLowering(op))
+      hasRoutedOps = true;
+    else
+      ops.push_back(op);
+  });
+  if (hasRoutedOps) {
+    config.strictMode = GreedyRewriteStrictness::ExistingAndNewOps;
+    if (failed(applyOpPatternsAndFold(ops, std::move(patterns), config)))
+      return signalPassFailure();
+    markAnalysesPreserved<OpClassification>();
+    return;
+  }
+
+  if (failed(applyPatternsAndFoldGreedily(getOperation(), std::move(patterns),
+                                          config)))
     return signalPassFailure();
+  markAnalysesPreserved<OpClassification>();
 }
 
 // Set the beta flags of a gemm dispatch to zero by cloning and updating the
@@ -864,8 +1548,54 @@ static void updateGemmOpFlags(RewriterBase &rewriter, XsmmDisTy gemmDispatchOp,
       [&](OpOperand &operand) { return operand.getOwner() == gemmOp; });
 }
 
+// Return the output (i.e. C matrix) of `op` if it is a gemm-like operation.
+static Value getGemmLikeOutput(Operation *op) {
+  if (auto gemmOp = dyn_cast<xsmm::GemmOp>(op))
+    return gemmOp.getOutput();
+  if (auto brgemmOp = dyn_cast<xsmm::BrgemmOp>(op))
+    return brgemmOp.getOutput();
+  if (auto fusedBrgemmOp = dyn_cast<xsmm::FusedBrgemmOp>(op))
+    return fusedBrgemmOp.getOutput();
+  return nullptr;
+}
+
+// Given a loop nest `loopOp` writing `dest` tile by tile, for example the
+// body of an scf.forall after bufferization, return the gemm-like operation
+// computing the tiles if it is the only one touching `dest` and each element
+// of `dest` is in exactly one tile:
+//
+// scf.forall (%i, %j) in (4, 2) {
+//   %tile = memref.subview %dest[%i * 32, %j * 32] [32, 32] [1, 1]
+//   xsmm.gemm(.., %tile)
+// }
+//
+// The gemm is not nested in a reduction loop of its own, it zero initializes
+// its tile when it overwrites it.
+static Operation *getTiledGemmLikeOp(Value dest, Operation *loopOp) {
+  if (!isa<scf::ForOp, scf::ForallOp, scf::ParallelOp>(loopOp))
+    return nullptr;
+  memref::SubViewOp tile;
+  for (Operation *user : dest.getUsers()) {
+    if (!loopOp->isProperAncestor(user))
+      continue;
+    auto subview = dyn_cast<memref::SubViewOp>(user);
+    if (tile || !subview)
+      return nullptr;
+    tile = subview;
+  }
+  if (!tile || !tile->hasOneUse())
+    return nullptr;
+  Operation *gemmLikeOp = *tile->getUsers().begin();
+  if (getGemmLikeOutput(gemmLikeOp) != tile.getResult() ||
+      gemmLikeOp->getBlock() != tile->getBlock() ||
+      !linalgx::utils::isCoveredByTiles(dest, tile, loopOp)) {
+    return nullptr;
+  }
+  return gemmLikeOp;
+}
+
 // Given `rootOp` return the first gemm-like operation that is zero initialized
-// by `rootOp`.
+// by `rootOp`, either directly or tile by tile in a loop nest.
 static std::optional<Operation *> getZeroInitGemmLikeOp(xsmm::UnaryOp rootOp) {
   // Walk the bb and make sure there are only side-effect free operations
   // between the zero op and the gemm. Bail out if any operations take a subview
@@ -899,6 +1629,23 @@ static std::optional<Operation *> getZeroInitGemmLikeOp(xsmm::UnaryOp rootOp) {
     return std::nullopt;
 
   while (++it != itEnd) {
+    // A loop touching `dest` in its body only reads it or computes its tiles.
+    SmallVector<Operation *> nestedUsers;
+    for (Operation *user : destUsers) {
+      if (it->isProperAncestor(user))
+        nestedUsers.push_back(user);
+    }
+    if (!nestedUsers.empty()) {
+      if (llvm::all_of(nestedUsers, [&](Operation *user) {
+            return !isa<ViewLikeOpInterface>(user) &&
+                   mlir::hasSingleEffect<MemoryEffects::Read>(user, dest);
+          })) {
+        continue;
+      }
+      if (Operation *gemmLikeOp = getTiledGemmLikeOp(dest, &*it))
+        return gemmLikeOp;
+      return std::nullopt;
+    }
     // Skip operations that do not touch `dest`.
     if (!destUsers.count(&*it))
       continue;
@@ -968,6 +1715,127 @@ static void fuseZeroWithGemmOrBrgemm(RewriterBase &rewriter,
   rewriter.eraseOp(rootOp);
 }
 
+// Return the input of `genericOp` if it only rounds it to the output type,
+// element by element.
+static Value getTruncatedInput(linalg::GenericOp genericOp) {
+  if (!genericOp.hasPureBufferSemantics() || genericOp.getNumDpsInputs() != 1 ||
+      genericOp.getNumDpsInits() != 1 ||
+      !llvm::all_of(genericOp.getIndexingMapsArray(),
+                    [](AffineMap map) { return map.isIdentity(); }) ||
+      genericOp.getNumParallelLoops() != genericOp.getNumLoops()) {
+    return nullptr;
+  }
+  Block *body = genericOp.getBody();
+  auto yieldOp = cast<linalg::YieldOp>(body->getTerminator());
+  auto truncOp = yieldOp.getValues()[0].getDefiningOp<arith::TruncFOp>();
+  if (!truncOp || &body->front() != truncOp.getOperation() ||
+      truncOp.getIn() != body->getArgument(0)) {
+    return nullptr;
+  }
+  return genericOp.getDpsInputs()[0];
+}
+
+// Return true if `value` is available before `op`. A subview between the two
+// is moved before `op` if its operands are.
+static bool isAvailableBefore(Value value, Operation *op,
+                              DominanceInfo &domInfo) {
+  if (domInfo.properlyDominates(value, op))
+    return true;
+  auto subview = value.getDefiningOp<memref::SubViewOp>();
+  if (!subview || subview->getBlock() != op->getBlock() ||
+      !llvm::all_of(subview->getOperands(), [&](Value operand) {
+        return domInfo.properlyDominates(operand, op);
+      })) {
+    return false;
+  }
+  subview->moveBefore(op);
+  return true;
+}
+
+// Fold the rounding of an f32 gemm output to bf16 or f16 into the gemm: the
+// kernel rounds its f32 accumulator when it stores C, for example:
+//
+//   %alloc = memref.alloc() : memref<32x32xf32>
+//   xsmm.gemm(.., %alloc) with beta_0 and output_type = f32
+//   linalg.generic ins(%alloc) outs(%out : memref<32x32xbf16>) { arith.truncf }
+//
+// lets the gemm write %out directly, the temporary buffer goes away.
+static void fuseTruncWithGemmOrBrgemm(RewriterBase &rewriter,
+                                      linalg::GenericOp truncOp,
+                                      DominanceInfo &domInfo) {
+  Value input = getTruncatedInput(truncOp);
+  if (!input || !input.getDefiningOp<memref::AllocOp>())
+    return;
+  Value output = truncOp.getDpsInits()[0];
+  auto inputType = cast<MemRefType>(input.getType());
+  auto outputType = cast<MemRefType>(output.getType());
+  if (inputType.getShape() != outputType.getShape() ||
+      failed(mlir::utils::getStaticStrides(output)) ||
+      *mlir::utils::getStaticStrides(input) !=
+          *mlir::utils::getStaticStrides(output)) {
+    return;
+  }
+
+  // The temporary buffer is only written by the gemm, read by the rounding
+  // and released.
+  Operation *gemmLikeOp = nullptr;
+  for (Operation *user : input.getUsers()) {
+    if (user == truncOp || isa<memref::DeallocOp>(user))
+      continue;
+    if (gemmLikeOp || !isa<xsmm::GemmOp, xsmm::BrgemmOp>(user) ||
+        user->getOperand(3) != input) {
+      return;
+    }
+    gemmLikeOp = user;
+  }
+  if (!gemmLikeOp || gemmLikeOp->getBlock() != truncOp->getBlock() ||
+      !gemmLikeOp->isBeforeInBlock(truncOp)) {
+    return;
+  }
+
+  // The gemm overwrites C and stores the f32 accumulator.
+  Operation *dispatchOp = gemmLikeOp->getOperand(0).getDefiningOp();
+  if (!isa_and_nonnull<xsmm::GemmDispatchOp, xsmm::BrgemmDispatchOp>(
+          dispatchOp) ||
+      !dispatchOp->hasAttr("output_type")) {
+    return;
+  }
+  auto flags = cast<ArrayAttr>(dispatchOp->getAttr("flags"));
+  if (!llvm::is_contained(flags, xsmm::GemmFlagsAttr::get(
+                                     rewriter.getContext(),
+                                     xsmm::GemmFlags::BETA_0))) {
+    return;
+  }
+
+  // Nothing touches the output between the gemm and the rounding.
+  for (Operation *op = gemmLikeOp->getNextNode(); op != truncOp;
+       op = op->getNextNode()) {
+    if (llvm::is_contained(op->getOperands(), output))
+      return;
+  }
+  if (!isAvailableBefore(output, gemmLikeOp, domInfo))
+    return;
+
+  LLVM_DEBUG(llvm::dbgs() << "[fuseTruncWithGemmOrBrgemm] Fold: " << truncOp
+                          << "\n");
+  OpBuilder::InsertionGuard guard(rewriter);
+  rewriter.setInsertionPoint(dispatchOp);
+  Operation *clonedOp = rewriter.clone(*dispatchOp);
+  rewriter.modifyOpInPlace(clonedOp,
+                           [&]() { clonedOp->removeAttr("output_type"); });
+  rewriter.modifyOpInPlace(gemmLikeOp, [&]() {
+    gemmLikeOp->setOperand(0, clonedOp->getResult(0));
+    gemmLikeOp->setOperand(3, output);
+  });
+  if (dispatchOp->use_empty())
+    rewriter.eraseOp(dispatchOp);
+  rewriter.eraseOp(truncOp);
+  Operation *allocOp = input.getDefiningOp();
+  for (Operation *user : llvm::make_early_inc_range(input.getUsers()))
+    rewriter.eraseOp(user);
+  rewriter.eraseOp(allocOp);
+}
+
 void FoldXsmmFlags::runOnOperation() {
   SmallVector<xsmm::UnaryOp> producers;
   IRRewriter rewriter(&getContext());
@@ -976,13 +1844,20 @@ void FoldXsmmFlags::runOnOperation() {
     if (kind == xsmm::UnaryKind::ZERO)
       fuseZeroWithGemmOrBrgemm(rewriter, unaryOp);
   });
+  // The zero initialization is now part of the gemm flags.
+  DominanceInfo &domInfo = getAnalysis<DominanceInfo>();
+  getOperation()->walk([&](linalg::GenericOp genericOp) {
+    fuseTruncWithGemmOrBrgemm(rewriter, genericOp, domInfo);
+  });
 }
 
-// Convert a linalg.matmul to a XSMM matmul op.
-struct ConvertMatmulToMatmul : public OpRewritePattern<linalg::MatmulOp> {
-  using OpRewritePattern<linalg::MatmulOp>::OpRewritePattern;
+// Convert a linalg.matmul, or a matmul with a transposed operand, to a XSMM
+// matmul op.
+template <typename MatmulOpTy>
+struct ConvertMatmulToMatmul : public OpRewritePattern<MatmulOpTy> {
+  using OpRewritePattern<MatmulOpTy>::OpRewritePattern;
 
-  LogicalResult matchAndRewrite(linalg::MatmulOp matmulOp,
+  LogicalResult matchAndRewrite(MatmulOpTy matmulOp,
                                 PatternRewriter &rewriter) const override {
     auto gemmInfo = isMappableToBrgemm(matmulOp);
     if (failed(gemmInfo))
@@ -1044,12 +1919,13 @@ struct ConvertVnniPacking : public OpRewritePattern<linalg::TransposeOp> {
     if (failed(stridesOnOutput) || stridesOnOutput->back() != 1)
       return failure();
     // Ajust ldo based on the VNNI factor.
-    unaryInfo.ldo = stridesOnOutput->front() /
-                    *vnni::utils::getVnniBlockingFactor(out.getType());
+    int64_t blockingFactor = *vnni::utils::getVnniBlockingFactor(out.getType());
+    unaryInfo.ldo = stridesOnOutput->front() / blockingFactor;
     auto flags = rewriter.getArrayAttr(xsmm::UnaryFlagsAttr::get(
         rewriter.getContext(), xsmm::UnaryFlags::NONE));
-    xsmm::UnaryKindAttr kind =
-        xsmm::UnaryKindAttr::get(rewriter.getContext(), xsmm::UnaryKind::VNNI2);
+    xsmm::UnaryKindAttr kind = xsmm::UnaryKindAttr::get(
+        rewriter.getContext(), blockingFactor == 4 ? xsmm::UnaryKind::VNNI4
+                                                   : xsmm::UnaryKind::VNNI2);
     xsmm::utils::replaceOpWithUnary(rewriter, transposeOp, {source, out},
                                     unaryInfo, flags, kind);
     return success();
@@ -1131,8 +2007,7 @@ struct ConvertCopyOp : public OpRewritePattern<linalg::CopyOp> {
         xsmm::utils::getUnaryInfo(source, dest, xsmm::UnaryFlags::NONE);
     if (failed(unaryInfo))
       return failure();
-    auto flags = rewriter.getArrayAttr(xsmm::UnaryFlagsAttr::get(
-        rewriter.getContext(), xsmm::UnaryFlags::NONE));
+    auto flags = getCopyUnaryFlags(rewriter, copyOp);
     xsmm::UnaryKindAttr kind = xsmm::UnaryKindAttr::get(
         rewriter.getContext(), xsmm::UnaryKind::IDENTITY);
     SmallVector<Value> operands{source, dest};
@@ -1142,13 +2017,159 @@ struct ConvertCopyOp : public OpRewritePattern<linalg::CopyOp> {
   }
 };
 
+// Convert an embedding lookup to loops over its rows. Each row of the table is
+// copied, for a gather, or added to the output row, for a bag, by a single
+// XSMM kernel dispatched once. The rows are scattered across the table, so the
+// start of the row of the next lookup is prefetched while the current one is
+// processed.
+struct ConvertEmbeddingBag : public OpRewritePattern<linalg::GenericOp> {
+  ConvertEmbeddingBag(MLIRContext *ctx, OpClassification *classification)
+      : OpRewritePattern<linalg::GenericOp>(ctx),
+        classification(classification) {}
+
+  LogicalResult matchAndRewrite(linalg::GenericOp genericOp,
+                                PatternRewriter &rewriter) const override {
+    SmallVector<Value> operands;
+    if (!genericOp.hasPureBufferSemantics() ||
+        !isOpOfKind(classification, genericOp, OpKind::EmbeddingBag,
+                    &operands)) {
+      return failure();
+    }
+    Value table = operands[0];
+    Value indices = operands[1];
+    Value output = operands[2];
+    auto tableStrides = mlir::utils::getStaticStrides(table);
+    auto outputStrides = mlir::utils::getStaticStrides(output);
+    if (failed(tableStrides) || failed(outputStrides) ||
+        tableStrides->back() != 1 || outputStrides->back() != 1) {
+      return rewriter.notifyMatchFailure(genericOp,
+                                         "expect unit column stride");
+    }
+
+    Location loc = genericOp.getLoc();
+    MLIRContext *ctx = rewriter.getContext();
+    auto outputType = cast<MemRefType>(output.getType());
+    int64_t numBags = outputType.getShape()[0];
+    int64_t numCols = outputType.getShape()[1];
+    bool isBag = genericOp.getNumLoops() == 3;
+    int64_t bagSize =
+        isBag ? cast<MemRefType>(indices.getType()).getShape()[1] : 1;
+
+    // One row of the table, copied or added to one row of the output.
+    IntegerType integer64 = IntegerType::get(ctx, 64);
+    auto dtype = xsmm::utils::getDataType(rewriter, outputType);
+    int64_t ldTable = (*tableStrides)[0];
+    int64_t ldOutput = (*outputStrides)[0];
+    Value dispatched;
+    if (isBag) {
+      dispatched = rewriter.create<xsmm::BinaryDispatchOp>(
+          loc, integer64,
+          xsmm::BinaryKindAttr::get(ctx, xsmm::BinaryKind::ADD),
+          rewriter.getDenseI64ArrayAttr(
+              {1, numCols, ldTable, ldOutput, ldOutput}),
+          rewriter.getArrayAttr(
+              xsmm::BinaryFlagsAttr::get(ctx, xsmm::BinaryFlags::NONE)),
+          dtype);
+    } else {
+      dispatched = rewriter.create<xsmm::UnaryDispatchOp>(
+          loc, integer64,
+          xsmm::UnaryKindAttr::get(ctx, xsmm::UnaryKind::IDENTITY),
+          rewriter.getDenseI64ArrayAttr({1, numCols, ldTable, ldOutput}),
+          rewriter.getArrayAttr(
+              xsmm::UnaryFlagsAttr::get(ctx, xsmm::UnaryFlags::NONE)),
+          dtype);
+    }
+
+    // Return the row of `source` at `row`.
+    auto getRow = [&](OpBuilder &builder, Value source, Value row) -> Value {
+      SmallVector<OpFoldResult> offsets = {row, builder.getIndexAttr(0)};
+      SmallVector<OpFoldResult> sizes = {builder.getIndexAttr(1),
+                                         builder.getIndexAttr(numCols)};
+      SmallVector<OpFoldResult> strides(2, builder.getIndexAttr(1));
+      return builder.create<memref::SubViewOp>(loc, source, offsets, sizes,
+                                               strides);
+    };
+    // Return the row of the table selected by the index at `coordinates`.
+    auto loadRow = [&](OpBuilder &builder, ValueRange coordinates) -> Value {
+      Value index = builder.create<memref::LoadOp>(loc, indices, coordinates);
+      if (index.getType().isIndex())
+        return index;
+      return builder.create<arith::IndexCastOp>(loc, builder.getIndexType(),
+                                                index);
+    };
+
+    Value zero = rewriter.create<arith::ConstantIndexOp>(loc, 0);
+    Value one = rewriter.create<arith::ConstantIndexOp>(loc, 1);
+    // The last lookup prefetches itself instead of reading past the indices.
+    int64_t numLookups = isBag ? bagSize : numBags;
+    Value lastLookup =
+        rewriter.create<arith::ConstantIndexOp>(loc, numLookups - 1);
+    auto createLookup = [&](OpBuilder &builder, Value bag, Value lookup) {
+      SmallVector<Value, 2> coordinates = {bag};
+      SmallVector<Value, 2> nextCoordinates;
+      Value next = builder.create<arith::MinUIOp>(
+          loc, builder.create<arith::AddIOp>(loc, isBag ? lookup : bag, one),
+          lastLookup);
+      if (isBag) {
+        coordinates.push_back(lookup);
+        nextCoordinates = {bag, next};
+      } else {
+        nextCoordinates = {next};
+      }
+      Value row = loadRow(builder, coordinates);
+      Value nextRow = loadRow(builder, nextCoordinates);
+      builder.create<memref::PrefetchOp>(loc, table, ValueRange{nextRow, zero},
+                                         /*isWrite=*/false,
+                                         /*localityHint=*/3,
+                                         /*isDataCache=*/true);
+      Value tableRow = getRow(builder, table, row);
+      Value outputRow = getRow(builder, output, bag);
+      if (isBag) {
+        builder.create<xsmm::BinaryOp>(
+            loc, dtype, xsmm::BinaryKindAttr::get(ctx, xsmm::BinaryKind::ADD),
+            ValueRange{dispatched, tableRow, outputRow, outputRow});
+      } else {
+        builder.create<xsmm::UnaryOp>(
+            loc, dtype,
+            xsmm::UnaryKindAttr::get(ctx, xsmm::UnaryKind::IDENTITY),
+            ValueRange{dispatched, tableRow, outputRow});
+      }
+    };
+
+    Value numBagsValue = rewriter.create<arith::ConstantIndexOp>(loc, numBags);
+    Value bagSizeValue = rewriter.create<arith::ConstantIndexOp>(loc, bagSize);
+    rewriter.create<scf::ForOp>(
+        loc, zero, numBagsValue, one, std::nullopt,
+        [&](OpBuilder &builder, Location loc, Value bag, ValueRange) {
+          if (isBag) {
+            builder.create<scf::ForOp>(
+                loc, zero, bagSizeValue, one, std::nullopt,
+                [&](OpBuilder &builder, Location loc, Value lookup,
+                    ValueRange) {
+                  createLookup(builder, bag, lookup);
+                  builder.create<scf::YieldOp>(loc);
+                });
+          } else {
+            createLookup(builder, bag, /*lookup=*/nullptr);
+          }
+          builder.create<scf::YieldOp>(loc);
+        });
+    rewriter.eraseOp(genericOp);
+    return success();
+  }
+
+private:
+  OpClassification *classification;
+};
+
 } // namespace
 
 void mlir::tpp::populateLinalgToXsmmPatterns(
-    RewritePatternSet &patterns, ArrayRef<StringRef> skipPatterns) {
-  std::vector<StringRef> patternsToAdd = {"fill",   "transpose", "unary",
-                                          "binary", "brgemm",    "matmul",
-                                          "copy",   "vnni"};
+    RewritePatternSet &patterns, ArrayRef<StringRef> skipPatterns,
+    OpClassification *classification) {
+  std::vector<StringRef> patternsToAdd = {
+      "fill",   "transpose", "unary", "binary", "equation",
+      "reduce", "brgemm",    "matmul", "copy", "vnni", "gather"};
   // If skipping all patterns, just don't do anything.
   if (skipPatterns.size() == 1 && skipPatterns[0] == "all") {
     LLVM_DEBUG(llvm::dbgs() << "[LinalgToXsmm] ignoring all patterns\n");
@@ -1158,7 +2179,7 @@ void mlir::tpp::populateLinalgToXsmmPatterns(
   // If skip list is not empty, remove all that were listed.
   // This is O(n^2), but the lists are small
   if (!skipPatterns.empty()) {
-    assert(skipPatterns.size() <= 8);
+    assert(skipPatterns.size() <= 10);
     auto newEnd = std::remove_if(patternsToAdd.begin(), patternsToAdd.end(),
                    [&skipPatterns](StringRef elm) -> bool {
                      return std::find(skipPatterns.begin(),
@@ -1173,30 +2194,44 @@ void mlir::tpp::populateLinalgToXsmmPatterns(
   auto ctx = patterns.getContext();
   for (auto pattern : patternsToAdd) {
     if (pattern == "fill") {
-      patterns.add<ConvertFillOpToUnaryZero>(ctx);
+      patterns.add<ConvertFillOpToUnaryZero>(ctx, classification);
       LLVM_DEBUG(llvm::dbgs() << "[LinalgToXsmm] adding fill\n");
     } else if (pattern == "transpose") {
-      patterns.add<ConvertTransposeOpToUnaryTranspose>(ctx);
+      patterns.add<ConvertTransposeOpToUnaryTranspose>(ctx, classification);
       LLVM_DEBUG(llvm::dbgs() << "[LinalgToXsmm] adding transpose\n");
     } else if (pattern == "copy") {
       patterns.add<ConvertCopyOp>(ctx);
       LLVM_DEBUG(llvm::dbgs() << "[LinalgToXsmm] adding copy\n");
     } else if (pattern == "unary") {
-      patterns.add<ConvertGenericToUnary>(ctx);
+      patterns.add<ConvertGenericToUnary>(ctx, classification);
       LLVM_DEBUG(llvm::dbgs() << "[LinalgToXsmm] adding unary\n");
     } else if (pattern == "binary") {
-      patterns.add<ConvertGenericToBinary>(ctx);
+      patterns.add<ConvertGenericToBinary, ConvertGenericToSubExp>(
+          ctx, classification);
       LLVM_DEBUG(llvm::dbgs() << "[LinalgToXsmm] adding binary\n");
+    } else if (pattern == "equation") {
+      // Prefer a single equation over the unary and binary chains.
+      patterns.add<ConvertGenericToEquation, ConvertGenericToEquations>(
+          ctx, /*benefit=*/2);
+      LLVM_DEBUG(llvm::dbgs() << "[LinalgToXsmm] adding equation\n");
+    } else if (pattern == "reduce") {
+      patterns.add<ConvertReductionToUnaryReduce>(ctx, classification);
+      LLVM_DEBUG(llvm::dbgs() << "[LinalgToXsmm] adding reduce\n");
     } else if (pattern == "brgemm") {
       patterns.add<ConvertGenericToBrgemm,
                    ConvertBatchReduceMatmulToBatchReduceMatmul>(ctx);
       LLVM_DEBUG(llvm::dbgs() << "[LinalgToXsmm] adding brgem\n");
     } else if (pattern == "matmul") {
-      patterns.add<ConvertMatmulToMatmul>(ctx);
+      patterns.add<ConvertMatmulToMatmul<linalg::MatmulOp>,
+                   ConvertMatmulToMatmul<linalg::MatmulTransposeAOp>,
+                   ConvertMatmulToMatmul<linalg::MatmulTransposeBOp>>(ctx);
       LLVM_DEBUG(llvm::dbgs() << "[LinalgToXsmm] adding matmul\n");
     } else if (pattern == "vnni") {
       patterns.add<ConvertVnniPacking, ConvertGenericToVnniMatmulLikeOp>(ctx);
       LLVM_DEBUG(llvm::dbgs() << "[LinalgToXsmm] adding vnni\n");
+    } else if (pattern == "gather") {
+      patterns.add<ConvertEmbeddingBag>(ctx, classification);
+      LLVM_DEBUG(llvm::dbgs() << "[LinalgToXsmm] adding gather\n");
     }
   }
 }
@@ -0,0 +1,229 @@
+//===- ConvertParallelToTasks.cpp --------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the lowering of the parallel loops to the work-stealing
+// thread pool of the runtime.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "TPP/Transforms/Utils/BuilderUtils.h"
+#include "mlir/Conversion/LLVMCommon/TypeConverter.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/LLVMIR/LLVMDialect.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/IR/IRMapping.h"
+#include "mlir/IR/SymbolTable.h"
+#include "mlir/Transforms/RegionUtils.h"
+
+using namespace mlir;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_CONVERTPARALLELTOTASKS
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+namespace {
+
+// Task runtime entry point, see runtime/TaskRunnerUtils.h.
+constexpr const static llvm::StringLiteral kParallelForFunc =
+    "tpp_parallel_for";
+
+// Returns true if `value` is a constant, rematerialized in the task instead
+// of being passed in the context.
+static bool isConstant(Value value) {
+  Operation *defOp = value.getDefiningOp();
+  return defOp && defOp->hasTrait<OpTrait::ConstantLike>();
+}
+
+// Lowers `parallelOp` to a call to the task runtime:
+//
+// func.func private @fn_task(%begin: i64, %end: i64, %ctx: !llvm.ptr) {
+//   %values = llvm.load %ctx
+//   scf.for %iv = %begin to %end {
+//     <body of the loop at the delinearized %iv>
+//   }
+// }
+//
+// func.func @fn(...) {
+//   llvm.store <values used in the body>, %ctx
+//   func.call @tpp_parallel_for(@fn_task, %ctx, <number of iterations>)
+// }
+static void convertParallelOp(RewriterBase &rewriter, ModuleOp module,
+                              SymbolTable &symbolTable,
+                              const LLVMTypeConverter &typeConverter,
+                              scf::ParallelOp parallelOp) {
+  auto parentFunc = parallelOp->getParentOfType<func::FuncOp>();
+  if (!parentFunc || !parallelOp.getInitVals().empty())
+    return;
+
+  // The values used by the task are passed with their LLVM types.
+  SetVector<Value> usedValues;
+  getUsedValuesDefinedAbove(parallelOp.getRegion(), usedValues);
+  if (!llvm::all_of(usedValues, [&](Value value) {
+        return isConstant(value) || typeConverter.convertType(value.getType());
+      })) {
+    return;
+  }
+
+  Location loc = parallelOp.getLoc();
+  MLIRContext *ctx = rewriter.getContext();
+  rewriter.setInsertionPoint(parallelOp);
+
+  // Number of iterations of each dimension, the task delinearizes its range.
+  SmallVector<Value> tripCounts;
+  Value numIterations;
+  for (auto [lb, ub, step] :
+       llvm::zip(parallelOp.getLowerBound(), parallelOp.getUpperBound(),
+                 parallelOp.getStep())) {
+    Value range = rewriter.createOrFold<arith::SubIOp>(loc, ub, lb);
+    Value tripCount =
+        rewriter.createOrFold<arith::CeilDivSIOp>(loc, range, step);
+    tripCounts.push_back(tripCount);
+    numIterations = numIterations ? rewriter.createOrFold<arith::MulIOp>(
+                                        loc, numIterations, tripCount)
+                                  : tripCount;
+  }
+  usedValues.insert(parallelOp.getLowerBound().begin(),
+                    parallelOp.getLowerBound().end());
+  usedValues.insert(parallelOp.getStep().begin(), parallelOp.getStep().end());
+  usedValues.insert(std::next(tripCounts.begin()), tripCounts.end());
+  SmallVector<Value> contextValues;
+  SmallVector<Type> contextTypes;
+  for (Value value : usedValues) {
+    if (isConstant(value))
+      continue;
+    contextValues.push_back(value);
+    contextTypes.push_back(typeConverter.convertType(value.getType()));
+  }
+
+  Type i64 = rewriter.getI64Type();
+  auto ptrType = LLVM::LLVMPointerType::get(ctx);
+  auto contextType = LLVM::LLVMStructType::getLiteral(ctx, contextTypes);
+  FunctionType taskType = rewriter.getFunctionType({i64, i64, ptrType}, {});
+
+  // Outline the body, the iterations [begin, end) run in an scf.for.
+  OpBuilder::InsertionGuard guard(rewriter);
+  rewriter.setInsertionPoint(parentFunc);
+  auto taskFunc = rewriter.create<func::FuncOp>(
+      loc, (parentFunc.getSymName() + "_task").str(), taskType);
+  taskFunc.setPrivate();
+  symbolTable.insert(taskFunc);
+  Block *entry = taskFunc.addEntryBlock();
+  rewriter.setInsertionPointToStart(entry);
+  IRMapping mapping;
+  for (Value value : usedValues) {
+    if (isConstant(value))
+      mapping.map(value, rewriter.clone(*value.getDefiningOp())->getResult(0));
+  }
+  if (!contextValues.empty()) {
+    Value context =
+        rewriter.create<LLVM::LoadOp>(loc, contextType, entry->getArgument(2));
+    for (auto [idx, value] : llvm::enumerate(contextValues)) {
+      Value field = rewriter.create<LLVM::ExtractValueOp>(
+          loc, context, ArrayRef<int64_t>{static_cast<int64_t>(idx)});
+      if (field.getType() != value.getType()) {
+        field = rewriter
+                    .create<UnrealizedConversionCastOp>(loc, value.getType(),
+                                                        field)
+                    .getResult(0);
+      }
+      mapping.map(value, field);
+    }
+  }
+  Type indexType = rewriter.getIndexType();
+  Value begin = rewriter.create<arith::IndexCastOp>(loc, indexType,
+                                                    entry->getArgument(0));
+  Value end = rewriter.create<arith::IndexCastOp>(loc, indexType,
+                                                  entry->getArgument(1));
+  Value one = rewriter.create<arith::ConstantIndexOp>(loc, 1);
+  auto forOp = rewriter.create<scf::ForOp>(loc, begin, end, one);
+  rewriter.setInsertionPointToStart(forOp.getBody());
+  Value linearIv = forOp.getInductionVar();
+  for (int64_t dim = parallelOp.getNumLoops() - 1; dim >= 0; --dim) {
+    Value idx = linearIv;
+    if (dim > 0) {
+      Value tripCount = mapping.lookup(tripCounts[dim]);
+      idx = rewriter.create<arith::RemUIOp>(loc, linearIv, tripCount);
+      linearIv = rewriter.create<arith::DivUIOp>(loc, linearIv, tripCount);
+    }
+    Value offset = rewriter.create<arith::MulIOp>(
+        loc, idx, mapping.lookup(parallelOp.getStep()[dim]));
+    Value iv = rewriter.create<arith::AddIOp>(
+        loc, mapping.lookup(parallelOp.getLowerBound()[dim]), offset);
+    mapping.map(parallelOp.getInductionVars()[dim], iv);
+  }
+  for (Operation &op : parallelOp.getBody()->without_terminator())
+    rewriter.clone(op, mapping);
+  rewriter.setInsertionPointToEnd(entry);
+  rewriter.create<func::ReturnOp>(loc);
+
+  // The context lives on the stack of the caller, allocated once on entry.
+  rewriter.setInsertionPoint(parallelOp);
+  Value context;
+  if (contextValues.empty()) {
+    context = rewriter.create<LLVM::ZeroOp>(loc, ptrType);
+  } else {
+    {
+      OpBuilder::InsertionGuard entryGuard(rewriter);
+      rewriter.setInsertionPointToStart(&parentFunc.getBody().front());
+      Value size = rewriter.create<LLVM::ConstantOp>(
+          loc, i64, rewriter.getI64IntegerAttr(1));
+      context =
+          rewriter.create<LLVM::AllocaOp>(loc, ptrType, contextType, size);
+    }
+    Value contextStruct = rewriter.create<LLVM::UndefOp>(loc, contextType);
+    for (auto [idx, value] : llvm::enumerate(contextValues)) {
+      Value field = value;
+      if (value.getType() != contextTypes[idx]) {
+        field = rewriter
+                    .create<UnrealizedConversionCastOp>(loc, contextTypes[idx],
+                                                        value)
+                    .getResult(0);
+      }
+      contextStruct = rewriter.create<LLVM::InsertValueOp>(
+          loc, contextStruct, field,
+          ArrayRef<int64_t>{static_cast<int64_t>(idx)});
+    }
+    rewriter.create<LLVM::StoreOp>(loc, contextStruct, context);
+  }
+
+  func::FuncOp parallelForFunc = getOrCreateRuntimeFunc(
+      module, kParallelForFunc, {taskType, ptrType, i64}, {});
+  Value task =
+      rewriter.create<func::ConstantOp>(loc, taskType, taskFunc.getSymName());
+  Value count = rewriter.create<arith::IndexCastOp>(loc, i64, numIterations);
+  rewriter.create<func::CallOp>(loc, parallelForFunc,
+                                ValueRange{task, context, count});
+  rewriter.eraseOp(parallelOp);
+}
+
+struct ConvertParallelToTasks
+    : public tpp::impl::ConvertParallelToTasksBase<ConvertParallelToTasks> {
+  void runOnOperation() override {
+    ModuleOp module = getOperation();
+    SmallVector<scf::ParallelOp> parallelOps;
+    module.walk([&](scf::ParallelOp parallelOp) {
+      if (!parallelOp->getParentOfType<scf::ParallelOp>())
+        parallelOps.push_back(parallelOp);
+    });
+
+    LLVMTypeConverter typeConverter(&getContext());
+    SymbolTable symbolTable(module);
+    IRRewriter rewriter(&getContext());
+    for (scf::ParallelOp parallelOp : parallelOps) {
+      convertParallelOp(rewriter, module, symbolTable, typeConverter,
+                        parallelOp);
+    }
+  }
+};
+
+} // namespace
@@ -18,6 +18,7 @@
 #include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/Dialect/Tensor/IR/Tensor.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+#include "llvm/ADT/StringSwitch.h"
 #include "llvm/ADT/TypeSwitch.h"
 
 using namespace mlir;
@@ -55,7 +56,7 @@ static SmallVector<Type> extractNormalizedTypes(OpBuilder &b,
               UnrankedTensorType::get(tensorType.getElementType());
           results.push_back(unrankedTensor);
         })
-        .Case<TimerType>([&](Type t) {
+        .Case<TimerType, CountersType, EnergyType>([&](Type t) {
           auto i64 = IntegerType::get(b.getContext(), 64);
           results.push_back(i64);
         })
@@ -91,8 +92,10 @@ static SmallVector<Value> getNormalizedOperands(OpBuilder &b, Location loc,
   return res;
 }
 
-// Create a perf function prototype.
-static func::FuncOp createPerfFuncPrototype(Location loc, const std::string& funcName,
+// Create a perf function prototype with the given type.
+static func::FuncOp createPerfFuncPrototype(Location loc,
+                                            const std::string &funcName,
+                                            FunctionType libFnType,
                                             Operation *op,
                                             PatternRewriter &rewriter) {
   // Insert before module terminator.
@@ -102,10 +105,6 @@ static func::FuncOp createPerfFuncPrototype(Location loc, const std::string& fun
                              std::prev(module.getBody()->end()));
 
   FlatSymbolRefAttr fnName = SymbolRefAttr::get(op->getContext(), funcName);
-  auto libFnType = rewriter.getFunctionType(
-      extractNormalizedTypes(rewriter, op->getOperands()),
-      extractNormalizedTypes(rewriter, op->getResults()));
-
   auto funcOp =
       rewriter.create<func::FuncOp>(loc, fnName.getValue(), libFnType);
   funcOp.setPrivate();
@@ -113,6 +112,16 @@ static func::FuncOp createPerfFuncPrototype(Location loc, const std::string& fun
   return funcOp;
 }
 
+// Create a perf function prototype.
+static func::FuncOp createPerfFuncPrototype(Location loc, const std::string& funcName,
+                                            Operation *op,
+                                            PatternRewriter &rewriter) {
+  auto libFnType = rewriter.getFunctionType(
+      extractNormalizedTypes(rewriter, op->getOperands()),
+      extractNormalizedTypes(rewriter, op->getResults()));
+  return createPerfFuncPrototype(loc, funcName, libFnType, op, rewriter);
+}
+
 // Generate function implementation for perf.sink operation.
 static LogicalResult buildPerfSinkFunc(Location loc,
                                        const std::string &funcName,
@@ -149,6 +158,19 @@ static LogicalResult buildPerfRuntimeFunc(Location loc,
   return success();
 }
 
+// Create a perf runtime function prototype which takes memref arguments.
+// The memrefs are passed to the runtime as unranked descriptors through the C
+// interface wrapper.
+static LogicalResult buildPerfRuntimeCIfaceFunc(Location loc,
+                                                const std::string &funcName,
+                                                Operation *op,
+                                                PatternRewriter &rewriter) {
+  auto funcOp = createPerfFuncPrototype(loc, funcName, op, rewriter);
+  funcOp->setAttr(LLVM::LLVMDialect::getEmitCWrapperAttrName(),
+                  rewriter.getUnitAttr());
+  return success();
+}
+
 // Insert calls to functions implementing corresponding perf op functionality.
 // If a function is unavailable in the current module, the function's builder
 // is called.
@@ -169,6 +191,12 @@ static LogicalResult buildPerfFuncCall(Location loc, std::string funcName,
                    .Case<perf::SinkOp>([&](Operation *op) {
                      return buildPerfSinkFunc(loc, funcName, op, rewriter);
                    })
+                   .Case<perf::StopCountersOp, perf::StopEnergyOp, perf::MinOp,
+                         perf::MaxOp, perf::MeanOp, perf::MedianOp>(
+                       [&](Operation *op) {
+                         return buildPerfRuntimeCIfaceFunc(loc, funcName, op,
+                                                           rewriter);
+                       })
                    .Default([&](Operation *op) {
                      return buildPerfRuntimeFunc(loc, funcName, op, rewriter);
                    });
@@ -186,6 +214,71 @@ static LogicalResult buildPerfFuncCall(Location loc, std::string funcName,
   return success();
 }
 
+// Insert a call to a perf runtime function taking explicit operands instead
+// of the op's own. The runtime function is declared with a C interface such
+// that memrefs are passed as unranked descriptors.
+static func::CallOp buildPerfRuntimeCIfaceCall(Location loc,
+                                               const std::string &funcName,
+                                               ValueRange operands,
+                                               TypeRange resultTypes,
+                                               Operation *op,
+                                               PatternRewriter &rewriter) {
+  auto normalizedOperands = getNormalizedOperands(rewriter, loc, operands);
+
+  FlatSymbolRefAttr fnName = SymbolRefAttr::get(op->getContext(), funcName);
+  ModuleOp module = op->getParentOfType<ModuleOp>();
+  if (!module.lookupSymbol(fnName.getAttr())) {
+    auto libFnType = rewriter.getFunctionType(
+        ValueRange{normalizedOperands}.getTypes(), resultTypes);
+    auto funcOp =
+        createPerfFuncPrototype(loc, funcName, libFnType, op, rewriter);
+    funcOp->setAttr(LLVM::LLVMDialect::getEmitCWrapperAttrName(),
+                    rewriter.getUnitAttr());
+  }
+
+  return rewriter.create<func::CallOp>(loc, fnName.getValue(), resultTypes,
+                                       normalizedOperands);
+}
+
+// Create a private constant 1-D global and return a memref to it.
+static Value buildConstantGlobal(Location loc, StringRef prefix,
+                                 DenseElementsAttr initValue, Operation *op,
+                                 PatternRewriter &rewriter) {
+  ModuleOp module = op->getParentOfType<ModuleOp>();
+  auto globalType = MemRefType::get(initValue.getType().getShape(),
+                                    initValue.getElementType());
+
+  // Pick a unique symbol name.
+  std::string name;
+  unsigned idx = 0;
+  do {
+    name = prefix.str() + std::to_string(idx++);
+  } while (module.lookupSymbol(name));
+
+  {
+    OpBuilder::InsertionGuard guard(rewriter);
+    rewriter.setInsertionPointToStart(module.getBody());
+    rewriter.create<memref::GlobalOp>(
+        loc, name, rewriter.getStringAttr("private"), globalType, initValue,
+        /*constant=*/true, /*alignment=*/nullptr);
+  }
+
+  return rewriter.create<memref::GetGlobalOp>(loc, globalType, name);
+}
+
+// Create a private constant global holding a null-terminated string and
+// return a memref to it.
+static Value buildStringGlobal(Location loc, StringRef str, Operation *op,
+                               PatternRewriter &rewriter) {
+  SmallVector<int8_t> chars(str.begin(), str.end());
+  chars.push_back(0);
+  auto initValue = DenseElementsAttr::get(
+      RankedTensorType::get({static_cast<int64_t>(chars.size())},
+                            rewriter.getI8Type()),
+      ArrayRef<int8_t>(chars));
+  return buildConstantGlobal(loc, "__perf_str_", initValue, op, rewriter);
+}
+
 struct ConvertStartTimerOp : public OpRewritePattern<perf::StartTimerOp> {
   using OpRewritePattern<perf::StartTimerOp>::OpRewritePattern;
 
@@ -214,6 +307,332 @@ struct ConvertStopTimerOp : public OpRewritePattern<perf::StopTimerOp> {
   }
 };
 
+struct ConvertStartDeviceTimerOp
+    : public OpRewritePattern<perf::StartDeviceTimerOp> {
+  using OpRewritePattern<perf::StartDeviceTimerOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(perf::StartDeviceTimerOp startTimerOp,
+                                PatternRewriter &rewriter) const override {
+    auto res = buildPerfFuncCall(startTimerOp.getLoc(),
+                                 startTimerOp.getLibraryCallName(),
+                                 startTimerOp, rewriter);
+    if (succeeded(res))
+      rewriter.eraseOp(startTimerOp);
+    return res;
+  }
+};
+
+struct ConvertStopDeviceTimerOp
+    : public OpRewritePattern<perf::StopDeviceTimerOp> {
+  using OpRewritePattern<perf::StopDeviceTimerOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(perf::StopDeviceTimerOp stopTimerOp,
+                                PatternRewriter &rewriter) const override {
+    auto res = buildPerfFuncCall(stopTimerOp.getLoc(),
+                                 stopTimerOp.getLibraryCallName(), stopTimerOp,
+                                 rewriter);
+    if (succeeded(res))
+      rewriter.eraseOp(stopTimerOp);
+    return res;
+  }
+};
+
+struct ConvertStartCountersOp
+    : public OpRewritePattern<perf::StartCountersOp> {
+  using OpRewritePattern<perf::StartCountersOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(perf::StartCountersOp startCountersOp,
+                                PatternRewriter &rewriter) const override {
+    auto res = buildPerfFuncCall(startCountersOp.getLoc(),
+                                 startCountersOp.getLibraryCallName(),
+                                 startCountersOp, rewriter);
+    if (succeeded(res))
+      rewriter.eraseOp(startCountersOp);
+    return res;
+  }
+};
+
+struct ConvertStopCountersOp : public OpRewritePattern<perf::StopCountersOp> {
+  using OpRewritePattern<perf::StopCountersOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(perf::StopCountersOp stopCountersOp,
+                                PatternRewriter &rewriter) const override {
+    auto res = buildPerfFuncCall(stopCountersOp.getLoc(),
+                                 stopCountersOp.getLibraryCallName(),
+                                 stopCountersOp, rewriter);
+    if (succeeded(res))
+      rewriter.eraseOp(stopCountersOp);
+    return res;
+  }
+};
+
+struct ConvertStartEnergyOp : public OpRewritePattern<perf::StartEnergyOp> {
+  using OpRewritePattern<perf::StartEnergyOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(perf::StartEnergyOp startEnergyOp,
+                                PatternRewriter &rewriter) const override {
+    auto res = buildPerfFuncCall(startEnergyOp.getLoc(),
+                                 startEnergyOp.getLibraryCallName(),
+                                 startEnergyOp, rewriter);
+    if (succeeded(res))
+      rewriter.eraseOp(startEnergyOp);
+    return res;
+  }
+};
+
+struct ConvertStopEnergyOp : public OpRewritePattern<perf::StopEnergyOp> {
+  using OpRewritePattern<perf::StopEnergyOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(perf::StopEnergyOp stopEnergyOp,
+                                PatternRewriter &rewriter) const override {
+    auto res = buildPerfFuncCall(stopEnergyOp.getLoc(),
+                                 stopEnergyOp.getLibraryCallName(),
+                                 stopEnergyOp, rewriter);
+    if (succeeded(res))
+      rewriter.eraseOp(stopEnergyOp);
+    return res;
+  }
+};
+
+struct ConvertFlushCacheOp : public OpRewritePattern<perf::FlushCacheOp> {
+  using OpRewritePattern<perf::FlushCacheOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(perf::FlushCacheOp flushOp,
+                                PatternRewriter &rewriter) const override {
+    auto res = buildPerfFuncCall(flushOp.getLoc(),
+                                 flushOp.getLibraryCallName(), flushOp,
+                                 rewriter);
+    if (succeeded(res))
+      rewriter.eraseOp(flushOp);
+    return res;
+  }
+};
+
+struct ConvertSetNumThreadsOp
+    : public OpRewritePattern<perf::SetNumThreadsOp> {
+  using OpRewritePattern<perf::SetNumThreadsOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(perf::SetNumThreadsOp setOp,
+                                PatternRewriter &rewriter) const override {
+    auto res = buildPerfFuncCall(setOp.getLoc(), setOp.getLibraryCallName(),
+                                 setOp, rewriter);
+    if (succeeded(res))
+      rewriter.eraseOp(setOp);
+    return res;
+  }
+};
+
+struct ConvertTraceBeginOp : public OpRewritePattern<perf::TraceBeginOp> {
+  using OpRewritePattern<perf::TraceBeginOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(perf::TraceBeginOp beginOp,
+                                PatternRewriter &rewriter) const override {
+    // Pass the region name to the runtime as a null-terminated string.
+    auto loc = beginOp.getLoc();
+    Value name = buildStringGlobal(loc, beginOp.getLabel(), beginOp, rewriter);
+    (void)buildPerfRuntimeCIfaceCall(loc, beginOp.getLibraryCallName(), name,
+                                     TypeRange{}, beginOp, rewriter);
+    rewriter.eraseOp(beginOp);
+    return success();
+  }
+};
+
+struct ConvertTraceEndOp : public OpRewritePattern<perf::TraceEndOp> {
+  using OpRewritePattern<perf::TraceEndOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(perf::TraceEndOp endOp,
+                                PatternRewriter &rewriter) const override {
+    auto res = buildPerfFuncCall(endOp.getLoc(), endOp.getLibraryCallName(),
+                                 endOp, rewriter);
+    if (succeeded(res))
+      rewriter.eraseOp(endOp);
+    return res;
+  }
+};
+
+template <typename StatOpTy>
+struct ConvertStatOp : public OpRewritePattern<StatOpTy> {
+  using OpRewritePattern<StatOpTy>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(StatOpTy statOp,
+                                PatternRewriter &rewriter) const override {
+    auto res = buildPerfFuncCall(statOp.getLoc(), statOp.getLibraryCallName(),
+                                 statOp, rewriter);
+    if (succeeded(res))
+      rewriter.eraseOp(statOp);
+    return res;
+  }
+};
+
+struct ConvertPercentileOp : public OpRewritePattern<perf::PercentileOp> {
+  using OpRewritePattern<perf::PercentileOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(perf::PercentileOp percentileOp,
+                                PatternRewriter &rewriter) const override {
+    // Pass the percentile to the runtime as an argument.
+    auto loc = percentileOp.getLoc();
+    Value percentile = rewriter.create<arith::ConstantOp>(
+        loc, percentileOp.getPercentileAttr());
+    auto call = buildPerfRuntimeCIfaceCall(
+        loc, percentileOp.getLibraryCallName(),
+        {percentileOp.getDeltas(), percentile}, percentileOp.getType(),
+        percentileOp, rewriter);
+    rewriter.replaceOp(percentileOp, call.getResults());
+    return success();
+  }
+};
+
+struct ConvertDumpOp : public OpRewritePattern<perf::DumpOp> {
+  using OpRewritePattern<perf::DumpOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(perf::DumpOp dumpOp,
+                                PatternRewriter &rewriter) const override {
+    // Pass the file name to the runtime as a null-terminated string.
+    auto loc = dumpOp.getLoc();
+    Value file = buildStringGlobal(loc, dumpOp.getFile(), dumpOp, rewriter);
+    (void)buildPerfRuntimeCIfaceCall(loc, dumpOp.getLibraryCallName(),
+                                     {dumpOp.getDeltas(), file}, TypeRange{},
+                                     dumpOp, rewriter);
+    rewriter.eraseOp(dumpOp);
+    return success();
+  }
+};
+
+struct ConvertReportOp : public OpRewritePattern<perf::ReportOp> {
+  using OpRewritePattern<perf::ReportOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(perf::ReportOp reportOp,
+                                PatternRewriter &rewriter) const override {
+    // Pass the key to the runtime as a null-terminated string.
+    auto loc = reportOp.getLoc();
+    Value key = buildStringGlobal(loc, reportOp.getKey(), reportOp, rewriter);
+    (void)buildPerfRuntimeCIfaceCall(loc, reportOp.getLibraryCallName(),
+                                     {key, reportOp.getValue()}, TypeRange{},
+                                     reportOp, rewriter);
+    rewriter.eraseOp(reportOp);
+    return success();
+  }
+};
+
+struct ConvertMapFileOp : public OpRewritePattern<perf::MapFileOp> {
+  using OpRewritePattern<perf::MapFileOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(perf::MapFileOp mapFileOp,
+                                PatternRewriter &rewriter) const override {
+    // Pass the file name and the expected shape to the runtime, which
+    // returns a descriptor of the mapped data.
+    auto loc = mapFileOp.getLoc();
+    auto memrefType = mapFileOp.getType();
+    Value file =
+        buildStringGlobal(loc, mapFileOp.getFile(), mapFileOp, rewriter);
+    auto shapeValue = DenseElementsAttr::get(
+        RankedTensorType::get({memrefType.getRank()}, rewriter.getI64Type()),
+        memrefType.getShape());
+    Value shape =
+        buildConstantGlobal(loc, "__perf_shape_", shapeValue, mapFileOp,
+                            rewriter);
+
+    auto unrankedType = UnrankedMemRefType::get(memrefType.getElementType(),
+                                                memrefType.getMemorySpace());
+    auto call = buildPerfRuntimeCIfaceCall(
+        loc, mapFileOp.getLibraryCallName(), {file, shape}, unrankedType,
+        mapFileOp, rewriter);
+    rewriter.replaceOpWithNewOp<memref::CastOp>(mapFileOp, memrefType,
+                                                call.getResult(0));
+    return success();
+  }
+};
+
+struct ConvertMapBlobOp : public OpRewritePattern<perf::MapBlobOp> {
+  using OpRewritePattern<perf::MapBlobOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(perf::MapBlobOp mapBlobOp,
+                                PatternRewriter &rewriter) const override {
+    // Pass the blob name, the expected shape and the offset of the data to
+    // the runtime, which returns a descriptor of the mapped data.
+    auto loc = mapBlobOp.getLoc();
+    auto memrefType = mapBlobOp.getType();
+    Value file =
+        buildStringGlobal(loc, mapBlobOp.getFile(), mapBlobOp, rewriter);
+    auto shapeValue = DenseElementsAttr::get(
+        RankedTensorType::get({memrefType.getRank()}, rewriter.getI64Type()),
+        memrefType.getShape());
+    Value shape =
+        buildConstantGlobal(loc, "__perf_shape_", shapeValue, mapBlobOp,
+                            rewriter);
+    Value offset = rewriter.create<arith::ConstantOp>(
+        loc, rewriter.getI64IntegerAttr(mapBlobOp.getOffset()));
+
+    auto unrankedType = UnrankedMemRefType::get(memrefType.getElementType(),
+                                                memrefType.getMemorySpace());
+    auto call = buildPerfRuntimeCIfaceCall(
+        loc, mapBlobOp.getLibraryCallName(), {file, shape, offset},
+        unrankedType, mapBlobOp, rewriter);
+    rewriter.replaceOpWithNewOp<memref::CastOp>(mapBlobOp, memrefType,
+                                                call.getResult(0));
+    return success();
+  }
+};
+
+struct ConvertAllocOp : public OpRewritePattern<perf::AllocOp> {
+  using OpRewritePattern<perf::AllocOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(perf::AllocOp allocOp,
+                                PatternRewriter &rewriter) const override {
+    // Pass the shape and the placement policy, as numbered by the perf
+    // runtime, to the runtime, which returns a descriptor of the allocated
+    // data.
+    auto loc = allocOp.getLoc();
+    auto memrefType = allocOp.getType();
+    auto shapeValue = DenseElementsAttr::get(
+        RankedTensorType::get({memrefType.getRank()}, rewriter.getI64Type()),
+        memrefType.getShape());
+    Value shape = buildConstantGlobal(loc, "__perf_shape_", shapeValue,
+                                      allocOp, rewriter);
+    int64_t policyKind = allocOp.getInterleave() ? 1
+                         : allocOp.getShard()    ? 2
+                                                 : 0;
+    Value policy = rewriter.create<arith::ConstantOp>(
+        loc, rewriter.getI64IntegerAttr(policyKind));
+    Value pageSize = rewriter.create<arith::ConstantOp>(
+        loc, rewriter.getI64IntegerAttr(allocOp.getPageSize()));
+
+    auto unrankedType = UnrankedMemRefType::get(memrefType.getElementType(),
+                                                memrefType.getMemorySpace());
+    auto call = buildPerfRuntimeCIfaceCall(
+        loc, allocOp.getLibraryCallName(), {shape, policy, pageSize},
+        unrankedType, allocOp, rewriter);
+    rewriter.replaceOpWithNewOp<memref::CastOp>(allocOp, memrefType,
+                                                call.getResult(0));
+    return success();
+  }
+};
+
+struct ConvertInitTensorOp : public OpRewritePattern<perf::InitTensorOp> {
+  using OpRewritePattern<perf::InitTensorOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(perf::InitTensorOp initOp,
+                                PatternRewriter &rewriter) const override {
+    // Pass the initializer kind, as numbered by the perf runtime, and the
+    // seed to the runtime.
+    auto loc = initOp.getLoc();
+    int64_t kind = llvm::StringSwitch<int64_t>(initOp.getInit())
+                       .Case("const", 0)
+                       .Case("simple", 1)
+                       .Case("cont", 2)
+                       .Case("random", 3)
+                       .Case("normal", 4);
+    Value kindValue = rewriter.create<arith::ConstantOp>(
+        loc, rewriter.getI64IntegerAttr(kind));
+    Value seed = rewriter.create<arith::ConstantOp>(loc, initOp.getSeedAttr());
+    buildPerfRuntimeCIfaceCall(loc, initOp.getLibraryCallName(),
+                               {initOp.getBuffer(), kindValue, seed},
+                               TypeRange(), initOp, rewriter);
+    rewriter.eraseOp(initOp);
+    return success();
+  }
+};
+
 struct ConvertSinkOp : public OpRewritePattern<perf::SinkOp> {
   using OpRewritePattern<perf::SinkOp>::OpRewritePattern;
 
@@ -233,7 +652,18 @@ struct ConvertSinkOp : public OpRewritePattern<perf::SinkOp> {
 };
 
 void populatePerfToFuncPatterns(RewritePatternSet &patterns) {
-  patterns.add<ConvertStartTimerOp, ConvertStopTimerOp, ConvertSinkOp>(
+  patterns.add<ConvertStartTimerOp, ConvertStopTimerOp,
+               ConvertStartDeviceTimerOp, ConvertStopDeviceTimerOp,
+               ConvertStartCountersOp, ConvertStopCountersOp,
+               ConvertStartEnergyOp, ConvertStopEnergyOp,
+               ConvertFlushCacheOp, ConvertSetNumThreadsOp,
+               ConvertTraceBeginOp, ConvertTraceEndOp,
+               ConvertStatOp<perf::MinOp>,
+               ConvertStatOp<perf::MaxOp>, ConvertStatOp<perf::MeanOp>,
+               ConvertStatOp<perf::MedianOp>, ConvertPercentileOp,
+               ConvertDumpOp, ConvertReportOp, ConvertMapFileOp,
+               ConvertMapBlobOp, ConvertAllocOp, ConvertInitTensorOp,
+               ConvertSinkOp>(
       patterns.getContext());
 }
 
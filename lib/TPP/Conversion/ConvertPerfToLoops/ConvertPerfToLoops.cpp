@@ -80,9 +80,30 @@ struct ConvertBenchToLoops : public OpRewritePattern<perf::BenchOp> {
     assert((benchOp.getBodyResults().size() == loop.getResults().size() + 1) &&
            "expect equal number of return variables");
 
+    // Time a loop with the same trip count, whose body only calls an opaque
+    // function like the benchmarked one calls the kernel, and remove it from
+    // the measurement. The sink keeps the loop from being optimized away.
+    // Clamp at zero as the overhead measurement is noisy too.
+    Value benchDelta = delta;
+    if (benchOp.getSubtractOverhead()) {
+      rewriter.setInsertionPointAfter(delta);
+      auto overheadTimer = rewriter.create<perf::StartTimerOp>(
+          loc, TimerType::get(rewriter.getContext()));
+      auto overheadLoop = rewriter.create<scf::ForOp>(loc, zero, numIters, one);
+      rewriter.setInsertionPointToStart(overheadLoop.getBody());
+      rewriter.create<perf::SinkOp>(loc, overheadLoop.getInductionVar());
+      rewriter.setInsertionPointAfter(overheadLoop);
+      auto overhead = rewriter.create<perf::StopTimerOp>(
+          loc, rewriter.getF64Type(), overheadTimer.getTimer());
+      auto diff = rewriter.create<arith::SubFOp>(loc, delta, overhead);
+      auto zeroTime = rewriter.create<arith::ConstantOp>(
+          loc, rewriter.getF64FloatAttr(0.0));
+      benchDelta = rewriter.create<arith::MaximumFOp>(loc, diff, zeroTime);
+    }
+
     // First, we add the timer delta as a loop result
     SmallVector<Value> loopResults;
-    loopResults.push_back(delta);
+    loopResults.push_back(benchDelta);
     // Then we add the rest of the iter args
     loopResults.append(loop.getResults().begin(), loop.getResults().end());
     // And replace everything
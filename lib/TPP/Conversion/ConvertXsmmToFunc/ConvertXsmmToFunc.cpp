@@ -15,7 +15,9 @@
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+#include "llvm/ADT/MapVector.h"
 
 using namespace mlir;
 using namespace mlir::xsmm;
@@ -35,7 +37,7 @@ namespace tpp {
 namespace {
 
 static SmallVector<Type> extractInvokeOperandTypes(OpBuilder &builder,
-                                                   OperandRange operands) {
+                                                   ValueRange operands) {
   SmallVector<Type> results;
   // One extra operand for datatype
   IntegerType integer64 = IntegerType::get(builder.getContext(), 64);
@@ -79,11 +81,11 @@ static SmallVector<Value> getOperands(OpBuilder &builder, Location loc,
 
 static void buildInvokeCall(OpBuilder &builder, Location loc,
                             const std::string &funcName, Operation *op,
-                            IntegerAttr dataTypeAttr) {
+                            ValueRange operands, IntegerAttr dataTypeAttr) {
   FlatSymbolRefAttr fnName = SymbolRefAttr::get(op->getContext(), funcName);
   ModuleOp module = op->getParentOfType<ModuleOp>();
-  auto libFnType = builder.getFunctionType(
-      extractInvokeOperandTypes(builder, op->getOperands()), {});
+  auto libFnType =
+      builder.getFunctionType(extractInvokeOperandTypes(builder, operands), {});
 
   if (!module.lookupSymbol(fnName)) {
     OpBuilder::InsertionGuard guard(builder);
@@ -97,7 +99,34 @@ static void buildInvokeCall(OpBuilder &builder, Location loc,
 
   builder.create<func::CallOp>(
       loc, fnName.getValue(), TypeRange(),
-      getOperands(builder, loc, op->getOperands(), dataTypeAttr));
+      getOperands(builder, loc, operands, dataTypeAttr));
+}
+
+static void buildInvokeCall(OpBuilder &builder, Location loc,
+                            const std::string &funcName, Operation *op,
+                            IntegerAttr dataTypeAttr) {
+  buildInvokeCall(builder, loc, funcName, op, op->getOperands(), dataTypeAttr);
+}
+
+// Mixed-precision gemms pass their output type in the second byte of the data
+// type, the runtime decodes it (see getGemmOutputType in XsmmRunnerUtils).
+static IntegerAttr getGemmDataTypeAttr(Builder &builder, DataType dataType,
+                                       std::optional<DataType> outputType) {
+  int64_t value = static_cast<int64_t>(dataType);
+  if (outputType)
+    value |= static_cast<int64_t>(*outputType) << 8;
+  return builder.getI64IntegerAttr(value);
+}
+
+// bf16 and f16 gemm invokes with an f32 C store the f32 accumulator.
+static IntegerAttr getGemmDataTypeAttr(Builder &builder, DataType dataType,
+                                       Value output) {
+  std::optional<DataType> outputType;
+  if ((dataType == DataType::BF16 || dataType == DataType::F16) &&
+      getElementTypeOrSelf(output.getType()).isF32()) {
+    outputType = DataType::F32;
+  }
+  return getGemmDataTypeAttr(builder, dataType, outputType);
 }
 
 struct ConvertGemmXsmmOp : public OpRewritePattern<GemmOp> {
@@ -106,8 +135,11 @@ struct ConvertGemmXsmmOp : public OpRewritePattern<GemmOp> {
   LogicalResult matchAndRewrite(GemmOp gemmOp,
                                 PatternRewriter &rewriter) const override {
     std::string funcName = "xsmm_gemm_invoke";
+    if (gemmOp.hasPrefetch())
+      funcName = "xsmm_gemm_prefetch_invoke";
     buildInvokeCall(rewriter, gemmOp.getLoc(), funcName, gemmOp,
-                    gemmOp.getDataTypeAttr());
+                    getGemmDataTypeAttr(rewriter, gemmOp.getDataType(),
+                                        gemmOp.getOutput()));
     rewriter.eraseOp(gemmOp);
     return success();
   }
@@ -119,8 +151,11 @@ struct ConvertBrgemmXsmmOp : public OpRewritePattern<BrgemmOp> {
   LogicalResult matchAndRewrite(BrgemmOp brgemmOp,
                                 PatternRewriter &rewriter) const override {
     std::string funcName = "xsmm_brgemm_invoke";
+    if (brgemmOp.hasPrefetch())
+      funcName = "xsmm_brgemm_prefetch_invoke";
     buildInvokeCall(rewriter, brgemmOp.getLoc(), funcName, brgemmOp,
-                    brgemmOp.getDataTypeAttr());
+                    getGemmDataTypeAttr(rewriter, brgemmOp.getDataType(),
+                                        brgemmOp.getOutput()));
     rewriter.eraseOp(brgemmOp);
     return success();
   }
@@ -158,6 +193,82 @@ struct ConvertBinaryXsmmOp : public OpRewritePattern<BinaryOp> {
   }
 };
 
+struct ConvertBrgemmIndirectXsmmOp
+    : public OpRewritePattern<BrgemmIndirectOp> {
+  using OpRewritePattern<BrgemmIndirectOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(BrgemmIndirectOp brgemmOp,
+                                PatternRewriter &rewriter) const override {
+    std::string funcName = "xsmm_brgemm_offset_invoke";
+    if (brgemmOp.getKind() == BatchReduceKind::ADDRESS)
+      funcName = "xsmm_brgemm_address_invoke";
+    buildInvokeCall(rewriter, brgemmOp.getLoc(), funcName, brgemmOp,
+                    getGemmDataTypeAttr(rewriter, brgemmOp.getDataType(),
+                                        brgemmOp.getOutput()));
+    rewriter.eraseOp(brgemmOp);
+    return success();
+  }
+};
+
+struct ConvertBrgemmGroupedXsmmOp : public OpRewritePattern<BrgemmGroupedOp> {
+  using OpRewritePattern<BrgemmGroupedOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(BrgemmGroupedOp brgemmOp,
+                                PatternRewriter &rewriter) const override {
+    // The number of brgemms in the group is passed after the op operands.
+    Location loc = brgemmOp.getLoc();
+    SmallVector<Value> operands = brgemmOp->getOperands();
+    operands.push_back(rewriter.create<arith::ConstantOp>(
+        loc, rewriter.getI64IntegerAttr(brgemmOp.getNumGroups())));
+    buildInvokeCall(rewriter, loc, "xsmm_brgemm_grouped_invoke", brgemmOp,
+                    operands,
+                    getGemmDataTypeAttr(rewriter, brgemmOp.getDataType(),
+                                        brgemmOp.getOutput()));
+    rewriter.eraseOp(brgemmOp);
+    return success();
+  }
+};
+
+struct ConvertEquationXsmmOp : public OpRewritePattern<EquationOp> {
+  using OpRewritePattern<EquationOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(EquationOp equationOp,
+                                PatternRewriter &rewriter) const override {
+    // The number of arguments varies with the equation. Pass them as a list
+    // of (aligned pointer, offset) pairs on the stack, the scope releases the
+    // list after the call even in a loop.
+    Location loc = equationOp.getLoc();
+    ValueRange args = equationOp.getArgs();
+    int64_t numArgs = args.size();
+    IntegerType integer64 = rewriter.getI64Type();
+    auto scope = rewriter.create<memref::AllocaScopeOp>(loc, TypeRange());
+    rewriter.setInsertionPointToStart(&scope.getBodyRegion().emplaceBlock());
+    Value list = rewriter.create<memref::AllocaOp>(
+        loc, MemRefType::get({numArgs * 2}, integer64));
+    auto store = [&](Value value, int64_t pos) {
+      Value asI64 = rewriter.create<arith::IndexCastOp>(loc, integer64, value);
+      Value index = rewriter.create<arith::ConstantIndexOp>(loc, pos);
+      rewriter.create<memref::StoreOp>(loc, asI64, list, index);
+    };
+    for (auto [idx, arg] : llvm::enumerate(args)) {
+      Value ptr =
+          rewriter.create<memref::ExtractAlignedPointerAsIndexOp>(loc, arg);
+      auto meta = rewriter.create<memref::ExtractStridedMetadataOp>(loc, arg);
+      store(ptr, idx * 2);
+      store(meta.getOffset(), idx * 2 + 1);
+    }
+    Value numArgsVal = rewriter.create<arith::ConstantOp>(
+        loc, rewriter.getI64IntegerAttr(numArgs));
+    SmallVector<Value> operands = {equationOp.getDispatch(), list,
+                                   equationOp.getOutput(), numArgsVal};
+    buildInvokeCall(rewriter, loc, "xsmm_equation_invoke", equationOp,
+                    operands, equationOp.getDataTypeAttr());
+    rewriter.create<memref::AllocaScopeReturnOp>(loc);
+    rewriter.eraseOp(equationOp);
+    return success();
+  }
+};
+
 struct ConvertFusedBrgemmXsmmOp : public OpRewritePattern<FusedBrgemmOp> {
   using OpRewritePattern<FusedBrgemmOp>::OpRewritePattern;
 
@@ -248,9 +359,41 @@ void addKindOperand(RewriterBase &rewriter,
   /* do nothing */
 }
 
+static bool isPrefetchFlag(Attribute flag) {
+  auto gemmFlag = dyn_cast_or_null<xsmm::GemmFlagsAttr>(flag);
+  return gemmFlag && (gemmFlag.getValue() == GemmFlags::PREFETCH_A ||
+                      gemmFlag.getValue() == GemmFlags::PREFETCH_B);
+}
+
+static bool hasPrefetchFlags(ArrayAttr flags) {
+  return llvm::any_of(flags, isPrefetchFlag);
+}
+
+static bool isBatchReduceFlag(Attribute flag) {
+  auto gemmFlag = dyn_cast_or_null<xsmm::GemmFlagsAttr>(flag);
+  return gemmFlag &&
+         (gemmFlag.getValue() == GemmFlags::BATCH_REDUCE_ADDRESS ||
+          gemmFlag.getValue() == GemmFlags::BATCH_REDUCE_OFFSET);
+}
+
+// Prefetch flags are passed as-is, the runtime maps them to the libxsmm
+// prefetch strategy.
+static int64_t getOredPrefetchFlags(ArrayAttr flags) {
+  int64_t oredFlag = 0;
+  for (auto flag : flags) {
+    if (isPrefetchFlag(flag))
+      oredFlag |= cast<IntegerAttr>(flag).getInt();
+  }
+  return oredFlag;
+}
+
 static int64_t getOredFlags(ArrayAttr flags) {
   int64_t oredFlag = 0;
   for (auto flag : flags) {
+    // Prefetch and batch-reduce flags are not libxsmm gemm flags, they are
+    // passed separately or select the entry point.
+    if (isPrefetchFlag(flag) || isBatchReduceFlag(flag))
+      continue;
     int64_t intAttr = dyn_cast<IntegerAttr>(flag).getInt();
     // LIBXSMM is col-major, swap A and B flags.
     if (auto gemmFlag = dyn_cast_or_null<xsmm::GemmFlagsAttr>(flag)) {
@@ -295,6 +438,15 @@ void addUnaryAndBinaryFlags(RewriterBase &rewriter,
   dispatchOperandTypes.push_back(integer64);
 }
 
+// Runtime sizes of the dispatch. Only gemm and brgemm dispatches have any.
+static ValueRange getDynamicInputs(Operation *dispatchOp) {
+  if (auto gemmDispatchOp = dyn_cast<GemmDispatchOp>(dispatchOp))
+    return gemmDispatchOp.getDynamicInputs();
+  if (auto brgemmDispatchOp = dyn_cast<BrgemmDispatchOp>(dispatchOp))
+    return brgemmDispatchOp.getDynamicInputs();
+  return ValueRange{};
+}
+
 template <typename OpTy>
 static LogicalResult buildDispatchOp(RewriterBase &rewriter, OpTy dispatchOp,
                                      std::string funcName) {
@@ -316,14 +468,27 @@ static LogicalResult buildDispatchOp(RewriterBase &rewriter, OpTy dispatchOp,
   }
 
   // Dispatch the data type.
-  dispatchOperands.push_back(rewriter.create<arith::ConstantOp>(
-      loc, integer64, cast<TypedAttr>(dispatchOp.getDataTypeAttr())));
+  IntegerAttr dataTypeAttr = dispatchOp.getDataTypeAttr();
+  if constexpr (llvm::is_one_of<OpTy, GemmDispatchOp,
+                                BrgemmDispatchOp>::value) {
+    dataTypeAttr = getGemmDataTypeAttr(rewriter, dispatchOp.getDataType(),
+                                       dispatchOp.getOutputType());
+  }
+  dispatchOperands.push_back(
+      rewriter.create<arith::ConstantOp>(loc, integer64, dataTypeAttr));
   dispatchOperandTypes.push_back(integer64);
 
-  // Dispatch the inputs.
+  // Dispatch the inputs. Dynamic inputs are forwarded as they are, the
+  // kernel is then dispatched on the sizes seen at runtime.
   ArrayRef<int64_t> integers = dispatchOp.getInputsAttr().asArrayRef();
+  auto dynamicInputs = getDynamicInputs(dispatchOp).begin();
   size_t arrayAttrSize = integers.size();
   for (size_t idx = 0; idx < arrayAttrSize; idx++) {
+    if (ShapedType::isDynamic(integers[idx])) {
+      dispatchOperands.push_back(*dynamicInputs++);
+      dispatchOperandTypes.push_back(integer64);
+      continue;
+    }
     IntegerAttr attr = IntegerAttr::get(rewriter.getI64Type(), integers[idx]);
     dispatchOperands.push_back(
         rewriter.create<arith::ConstantOp>(loc, integer64, attr));
@@ -339,6 +504,17 @@ static LogicalResult buildDispatchOp(RewriterBase &rewriter, OpTy dispatchOp,
       loc, integer64, IntegerAttr::get(rewriter.getI64Type(), oredFlag)));
   dispatchOperandTypes.push_back(integer64);
 
+  // Kernels with software prefetch take the prefetch flags as an extra
+  // operand (see xsmm_*_prefetch_dispatch). The tile configuration does not
+  // prefetch, the flags are simply dropped.
+  if (llvm::is_one_of<OpTy, GemmDispatchOp, BrgemmDispatchOp>::value &&
+      hasPrefetchFlags(dispatchOp.getFlagsAttr())) {
+    int64_t prefetchFlag = getOredPrefetchFlags(dispatchOp.getFlagsAttr());
+    dispatchOperands.push_back(rewriter.create<arith::ConstantOp>(
+        loc, integer64, IntegerAttr::get(rewriter.getI64Type(), prefetchFlag)));
+    dispatchOperandTypes.push_back(integer64);
+  }
+
   if (auto dispatchBrgemmOp = dyn_cast_or_null<xsmm::FusedBrgemmDispatchOp>(
           dispatchOp.getOperation())) {
     addUnaryAndBinaryFlags(rewriter, dispatchBrgemmOp, dispatchOperands,
@@ -356,8 +532,10 @@ struct ConvertGemmDispatchOp : public OpRewritePattern<GemmDispatchOp> {
 
   LogicalResult matchAndRewrite(GemmDispatchOp dispatchOp,
                                 PatternRewriter &rewriter) const override {
-    return buildDispatchOp<GemmDispatchOp>(rewriter, dispatchOp,
-                                           "xsmm_gemm_dispatch");
+    std::string funcName = "xsmm_gemm_dispatch";
+    if (hasPrefetchFlags(dispatchOp.getFlags()))
+      funcName = "xsmm_gemm_prefetch_dispatch";
+    return buildDispatchOp<GemmDispatchOp>(rewriter, dispatchOp, funcName);
   }
 };
 
@@ -366,8 +544,17 @@ struct ConvertBrgemmDispatchOp : public OpRewritePattern<BrgemmDispatchOp> {
 
   LogicalResult matchAndRewrite(BrgemmDispatchOp dispatchOp,
                                 PatternRewriter &rewriter) const override {
-    return buildDispatchOp<BrgemmDispatchOp>(rewriter, dispatchOp,
-                                             "xsmm_brgemm_dispatch");
+    std::string funcName = "xsmm_brgemm_dispatch";
+    if (hasPrefetchFlags(dispatchOp.getFlags()))
+      funcName = "xsmm_brgemm_prefetch_dispatch";
+    for (Attribute flag : dispatchOp.getFlags()) {
+      auto gemmFlag = cast<xsmm::GemmFlagsAttr>(flag).getValue();
+      if (gemmFlag == GemmFlags::BATCH_REDUCE_ADDRESS)
+        funcName = "xsmm_brgemm_address_dispatch";
+      if (gemmFlag == GemmFlags::BATCH_REDUCE_OFFSET)
+        funcName = "xsmm_brgemm_offset_dispatch";
+    }
+    return buildDispatchOp<BrgemmDispatchOp>(rewriter, dispatchOp, funcName);
   }
 };
 
@@ -421,17 +608,267 @@ struct ConvertFusedBrgemmOp : public OpRewritePattern<FusedBrgemmDispatchOp> {
   }
 };
 
+struct ConvertEquationDispatchOp
+    : public OpRewritePattern<EquationDispatchOp> {
+  using OpRewritePattern<EquationDispatchOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(EquationDispatchOp dispatchOp,
+                                PatternRewriter &rewriter) const override {
+    // The arguments and the nodes are stored, in this order, in a constant
+    // global. Its address also identifies the equation in the runtime
+    // dispatch cache.
+    Location loc = dispatchOp.getLoc();
+    ModuleOp module = dispatchOp->getParentOfType<ModuleOp>();
+    SmallVector<int64_t> descriptor(dispatchOp.getArgs());
+    llvm::append_range(descriptor, dispatchOp.getNodes());
+    IntegerType integer64 = rewriter.getI64Type();
+    auto type = MemRefType::get({static_cast<int64_t>(descriptor.size())},
+                                integer64);
+    auto init = DenseElementsAttr::get(
+        RankedTensorType::get(type.getShape(), integer64),
+        ArrayRef<int64_t>(descriptor));
+    memref::GlobalOp global;
+    {
+      OpBuilder::InsertionGuard guard(rewriter);
+      rewriter.setInsertionPointToStart(module.getBody());
+      global = rewriter.create<memref::GlobalOp>(
+          loc, "__xsmm_equation", rewriter.getStringAttr("private"), type,
+          init, /*constant=*/true, /*alignment=*/nullptr);
+      SymbolTable(module).insert(global);
+    }
+    Value descriptorBuffer = rewriter.create<memref::GetGlobalOp>(
+        loc, type, global.getSymName());
+
+    SmallVector<Value> dispatchOperands;
+    auto addI64 = [&](int64_t value) {
+      dispatchOperands.push_back(rewriter.create<arith::ConstantOp>(
+          loc, integer64, rewriter.getI64IntegerAttr(value)));
+    };
+    dispatchOperands.push_back(rewriter.create<arith::ConstantOp>(
+        loc, integer64, cast<TypedAttr>(dispatchOp.getDataTypeAttr())));
+    for (int64_t input : dispatchOp.getInputs())
+      addI64(input);
+    auto [ptr, offset] =
+        utils::getPtrAndOffset(rewriter, descriptorBuffer, loc);
+    dispatchOperands.push_back(ptr);
+    dispatchOperands.push_back(offset);
+    addI64(dispatchOp.getNumArgs());
+    addI64(dispatchOp.getNumNodes());
+
+    SmallVector<Type> dispatchOperandTypes =
+        llvm::to_vector(ValueRange(dispatchOperands).getTypes());
+    FlatSymbolRefAttr fnName =
+        SymbolRefAttr::get(rewriter.getContext(), "xsmm_equation_dispatch");
+    func::CallOp call = buildDispatchCall(rewriter, loc, dispatchOperands,
+                                          dispatchOperandTypes, module, fnName);
+    rewriter.replaceOp(dispatchOp, call.getResult(0));
+    return success();
+  }
+};
+
+static bool isDispatchOp(Operation *op) {
+  return isa<GemmDispatchOp, BrgemmDispatchOp, UnaryDispatchOp,
+             BinaryDispatchOp, FusedBrgemmDispatchOp,
+             IntelAMXTileConfigDispatchOp, EquationDispatchOp>(op);
+}
+
+static memref::GlobalOp createHandleGlobal(OpBuilder &builder, Location loc,
+                                           StringRef name, Type elementType,
+                                           TypedAttr initValue) {
+  auto type = MemRefType::get({}, elementType);
+  auto init = DenseElementsAttr::get(RankedTensorType::get({}, elementType),
+                                     initValue);
+  return builder.create<memref::GlobalOp>(loc, name,
+                                          builder.getStringAttr("private"),
+                                          type, init, /*constant=*/false,
+                                          /*alignment=*/nullptr);
+}
+
+static Value loadGlobal(OpBuilder &builder, Location loc,
+                        memref::GlobalOp global) {
+  Value handle = builder.create<memref::GetGlobalOp>(loc, global.getType(),
+                                                     global.getSymName());
+  return builder.create<memref::LoadOp>(loc, handle);
+}
+
+static void storeGlobal(OpBuilder &builder, Location loc, Value value,
+                        memref::GlobalOp global) {
+  Value handle = builder.create<memref::GetGlobalOp>(loc, global.getType(),
+                                                     global.getSymName());
+  builder.create<memref::StoreOp>(loc, value, handle);
+}
+
+// States of the initialization flag of the hoisted dispatches.
+enum DispatchInitState : int64_t { Uninitialized = 0, Running = 1, Done = 2 };
+
+static Value getGlobalPtr(OpBuilder &builder, Location loc,
+                          memref::GlobalOp global) {
+  Value handle = builder.create<memref::GetGlobalOp>(loc, global.getType(),
+                                                     global.getSymName());
+  return utils::getPtrAndOffset(builder, handle, loc).first;
+}
+
+// Loads the initialization flag at `ptr` with acquire ordering, so that the
+// handles stored before it was set are visible.
+static Value loadInitState(OpBuilder &builder, Location loc, Value ptr) {
+  auto load = builder.create<LLVM::LoadOp>(loc, builder.getI64Type(), ptr,
+                                           /*alignment=*/8);
+  load.setOrdering(LLVM::AtomicOrdering::acquire);
+  return load;
+}
+
+// Move all dispatch operations into a single initializer function.
+//
+// Every unique dispatch (same operation, same attributes) gets a private i64
+// global holding its kernel handle. The initializer dispatches all the kernels
+// once and stores the handles. Each function using a dispatch calls the
+// initializer on entry if it has not run yet and then only loads the handles,
+// so the dispatch cost is paid once per process instead of once per call.
+//
+// The functions may run on several threads at once. The first thread to
+// enter the initializer claims it with a compare-and-swap of the flag, the
+// others wait until it is done. The flag is set with release ordering after
+// the handles are stored, and read with acquire ordering before they are
+// loaded.
+static void hoistDispatchOps(ModuleOp module) {
+  // Group dispatches by function and by unique key. Dispatches without operands
+  // are pure and fully described by their attributes, so the attribute
+  // dictionary is a sufficient key.
+  using DispatchKey = std::pair<OperationName, DictionaryAttr>;
+  llvm::MapVector<DispatchKey, Operation *> uniqueDispatches;
+  llvm::MapVector<func::FuncOp, SmallVector<Operation *>> dispatchesPerFunc;
+  module->walk([&](Operation *op) {
+    // Dispatches on runtime sizes stay where they are, the runtime dispatch
+    // cache keeps them cheap.
+    if (!isDispatchOp(op) || op->getNumOperands() != 0)
+      return;
+    auto func = op->getParentOfType<func::FuncOp>();
+    if (!func || func->getParentOfType<ModuleOp>() != module)
+      return;
+    uniqueDispatches.insert({{op->getName(), op->getAttrDictionary()}, op});
+    dispatchesPerFunc[func].push_back(op);
+  });
+  if (uniqueDispatches.empty())
+    return;
+
+  MLIRContext *ctx = module.getContext();
+  OpBuilder builder(ctx);
+  Location loc = module.getLoc();
+  IntegerType integer64 = builder.getI64Type();
+  SymbolTable symbolTable(module);
+
+  // Globals holding the kernel handles and the initialization flag.
+  builder.setInsertionPointToStart(module.getBody());
+  DenseMap<DispatchKey, memref::GlobalOp> handleGlobals;
+  for (auto [idx, entry] : llvm::enumerate(uniqueDispatches)) {
+    auto global = createHandleGlobal(
+        builder, entry.second->getLoc(),
+        "__xsmm_dispatch_" + std::to_string(idx), integer64,
+        builder.getI64IntegerAttr(0));
+    symbolTable.insert(global);
+    handleGlobals[entry.first] = global;
+  }
+  auto initFlag = createHandleGlobal(
+      builder, loc, "__xsmm_dispatch_initialized", integer64,
+      builder.getI64IntegerAttr(DispatchInitState::Uninitialized));
+  symbolTable.insert(initFlag);
+
+  // The initializer dispatches every unique kernel once.
+  builder.setInsertionPoint(module.getBody(),
+                            std::prev(module.getBody()->end()));
+  auto initFunc = builder.create<func::FuncOp>(
+      loc, "__xsmm_dispatch_init", builder.getFunctionType({}, {}));
+  initFunc.setPrivate();
+  symbolTable.insert(initFunc);
+  builder.setInsertionPointToStart(initFunc.addEntryBlock());
+  auto getState = [&](OpBuilder &b, Location l, DispatchInitState state) {
+    return b.create<arith::ConstantOp>(l, integer64,
+                                       b.getI64IntegerAttr(state));
+  };
+  Value flagPtr = getGlobalPtr(builder, loc, initFlag);
+  auto claim = builder.create<LLVM::AtomicCmpXchgOp>(
+      loc, flagPtr, getState(builder, loc, DispatchInitState::Uninitialized),
+      getState(builder, loc, DispatchInitState::Running),
+      LLVM::AtomicOrdering::acquire, LLVM::AtomicOrdering::monotonic);
+  Value claimed =
+      builder.create<LLVM::ExtractValueOp>(loc, claim, ArrayRef<int64_t>{1});
+  builder.create<scf::IfOp>(
+      loc, claimed,
+      [&](OpBuilder &b, Location l) {
+        for (auto &entry : uniqueDispatches) {
+          Operation *dispatch = b.clone(*entry.second);
+          storeGlobal(b, dispatch->getLoc(), dispatch->getResult(0),
+                      handleGlobals[entry.first]);
+        }
+        auto publish = b.create<LLVM::StoreOp>(
+            l, getState(b, l, DispatchInitState::Done), flagPtr,
+            /*alignment=*/8);
+        publish.setOrdering(LLVM::AtomicOrdering::release);
+        b.create<scf::YieldOp>(l);
+      },
+      [&](OpBuilder &b, Location l) {
+        // Another thread is dispatching, wait until it publishes the handles.
+        b.create<scf::WhileOp>(
+            l, TypeRange{}, ValueRange{},
+            [&](OpBuilder &wb, Location wl, ValueRange) {
+              Value running = wb.create<arith::CmpIOp>(
+                  wl, arith::CmpIPredicate::ne, loadInitState(wb, wl, flagPtr),
+                  getState(wb, wl, DispatchInitState::Done));
+              wb.create<scf::ConditionOp>(wl, running, ValueRange{});
+            },
+            [&](OpBuilder &wb, Location wl, ValueRange) {
+              wb.create<scf::YieldOp>(wl);
+            });
+        b.create<scf::YieldOp>(l);
+      });
+  builder.create<func::ReturnOp>(loc);
+
+  // Replace the dispatches in each function with loads of the handles.
+  for (auto &[func, dispatches] : dispatchesPerFunc) {
+    Block &entryBlock = func.getBody().front();
+    builder.setInsertionPointToStart(&entryBlock);
+    Location funcLoc = func.getLoc();
+    Value state = loadInitState(builder, funcLoc,
+                                getGlobalPtr(builder, funcLoc, initFlag));
+    Value notDone = builder.create<arith::CmpIOp>(
+        funcLoc, arith::CmpIPredicate::ne, state,
+        getState(builder, funcLoc, DispatchInitState::Done));
+    builder.create<scf::IfOp>(
+        funcLoc, notDone, [&](OpBuilder &b, Location l) {
+          b.create<func::CallOp>(l, initFunc, ValueRange{});
+          b.create<scf::YieldOp>(l);
+        });
+
+    DenseMap<DispatchKey, Value> handles;
+    for (Operation *dispatch : dispatches) {
+      DispatchKey key{dispatch->getName(), dispatch->getAttrDictionary()};
+      Value &handle = handles[key];
+      if (!handle)
+        handle = loadGlobal(builder, dispatch->getLoc(), handleGlobals[key]);
+      dispatch->getResult(0).replaceAllUsesWith(handle);
+      dispatch->erase();
+    }
+  }
+}
+
 struct ConvertXsmmToFunc
     : public tpp::impl::ConvertXsmmToFuncBase<ConvertXsmmToFunc> {
+  using ConvertXsmmToFuncBase::ConvertXsmmToFuncBase;
+
   void runOnOperation() override {
+    if (hoistDispatch)
+      hoistDispatchOps(getOperation());
+
     RewritePatternSet patterns(&getContext());
     patterns.add<ConvertBinaryXsmmOp, ConvertUnaryXsmmOp, ConvertGemmXsmmOp,
-                 ConvertBrgemmXsmmOp, ConvertFusedBrgemmXsmmOp,
-                 ConvertIntelAMXTileConfigXsmmOp>(patterns.getContext());
+                 ConvertBrgemmXsmmOp, ConvertBrgemmIndirectXsmmOp,
+                 ConvertBrgemmGroupedXsmmOp, ConvertFusedBrgemmXsmmOp,
+                 ConvertEquationXsmmOp, ConvertIntelAMXTileConfigXsmmOp>(
+        patterns.getContext());
     patterns.add<ConvertBinaryDispatchOp, ConvertUnaryDispatchOp,
                  ConvertGemmDispatchOp, ConvertBrgemmDispatchOp,
-                 ConvertFusedBrgemmOp, ConvertIntelAMXTileConfigDispatchOp>(
-        patterns.getContext());
+                 ConvertFusedBrgemmOp, ConvertEquationDispatchOp,
+                 ConvertIntelAMXTileConfigDispatchOp>(patterns.getContext());
     (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
   }
 };
@@ -22,6 +22,7 @@
 #include "TPP/Dialect/Perf/PerfOps.h"
 #include "TPP/Dialect/Xsmm/XsmmDialect.h"
 #include "TPP/PassUtils.h"
+#include "TPP/Transforms/Utils/BlockingCostModel.h"
 #include "mlir/Transforms/Passes.h"
 
 #include <string>
@@ -40,16 +41,48 @@ llvm::cl::opt<bool> linalgToLoops("linalg-to-loops",
                                   llvm::cl::desc("Lower linalg to loops"),
                                   llvm::cl::init(false));
 
+llvm::cl::opt<bool>
+    linalgToBlas("linalg-to-blas",
+                 llvm::cl::desc("Lower the matmuls to oneDNN calls"),
+                 llvm::cl::init(false));
+
 // Control parallelism.
 llvm::cl::opt<bool>
     defParallel("def-parallel",
                 llvm::cl::desc("Default pipeline - enable parallel execution"),
                 llvm::cl::init(false));
 
+// Runtime of the parallel loops.
+llvm::cl::opt<std::string> parallelRuntime(
+    "parallel-runtime",
+    llvm::cl::desc("Runtime of the parallel loops with def-parallel: omp "
+                   "or tasks (work-stealing thread pool)"),
+    llvm::cl::init("omp"));
+
+// Parses the grid sizes, `auto` stands for 0, the grid is then sized from
+// the number of threads.
+struct TaskGridParser : public llvm::cl::basic_parser<unsigned> {
+  TaskGridParser(llvm::cl::Option &option) : basic_parser(option) {}
+
+  bool parse(llvm::cl::Option &option, StringRef argName, StringRef arg,
+             unsigned &value) {
+    if (arg == "auto") {
+      value = 0;
+      return false;
+    }
+    if (arg.getAsInteger(0, value))
+      return option.error("'" + arg + "' value invalid for grid size!");
+    return false;
+  }
+
+  StringRef getValueName() const override { return "uint|auto"; }
+};
+
 // Control grid parallelism sizes.
-llvm::cl::list<unsigned>
+llvm::cl::list<unsigned, bool, TaskGridParser>
     parallelTaskGrid("parallel-task-grid",
-                     llvm::cl::desc("Grid-sizes for parallel tasks"),
+                     llvm::cl::desc("Grid-sizes for parallel tasks, auto to "
+                                    "size them from the number of threads"),
                      llvm::cl::list_init<unsigned>(SmallVector<unsigned>{2, 8}),
                      llvm::cl::CommaSeparated);
 
@@ -61,27 +94,329 @@ llvm::cl::opt<bool> vectorToKernel("vector-to-kernels",
                                    llvm::cl::desc("Lower vector to micro-kernels"),
                                    llvm::cl::init(false)); 
 
+llvm::cl::opt<bool> perOpLowering(
+    "per-op-lowering",
+    llvm::cl::desc("Lower each operation to XSMM or to micro-kernels, as "
+                   "selected by the cost model"),
+    llvm::cl::init(false));
+
+// Feedback of the XSMM kernels of a previous run, written by tpp-run
+// -profile-out
+llvm::cl::opt<std::string> profileIn(
+    "profile-in",
+    llvm::cl::desc("Revisit the lowering of the operations whose XSMM kernel "
+                   "underperformed in the given profile (implies "
+                   "-per-op-lowering)"),
+    llvm::cl::value_desc("filename"), llvm::cl::init(""));
+
 llvm::cl::opt<bool> lowerPackUnpackWithoutTranspose(
     "lower-pack-unpack-without-transpose",
     llvm::cl::desc("Lower packs and unpacks reverting any dim permutations"),
     llvm::cl::init(false));
 
-// Lhs tile sizes for linalg-to-vector.
+// Blocking factors of the packed matmuls, the pass defaults if empty.
+llvm::cl::list<int64_t>
+    matmulBlockFactors("matmul-block-factors",
+                       llvm::cl::desc("Blocking factors of the packed matmuls"),
+                       llvm::cl::CommaSeparated);
+
+// Target-aware blocking factors of the packed matmuls.
+llvm::cl::opt<bool> matmulCostModel(
+    "matmul-cost-model",
+    llvm::cl::desc("Pick the matmul blocking factors with the cost model"),
+    llvm::cl::init(false));
+
+// Outer cache level of the tiling of the fused matmuls, none if empty.
+llvm::cl::list<int64_t>
+    fusionOuterTiles("fusion-outer-tiles",
+                     llvm::cl::desc("Outer cache level tile sizes of the fused "
+                                    "matmuls"),
+                     llvm::cl::CommaSeparated);
+
+// Remarks on the layout conversions left between operations.
+llvm::cl::opt<bool> reportResidualLayouts(
+    "report-residual-layouts",
+    llvm::cl::desc("Report the pack and unpack left between operations"),
+    llvm::cl::init(false));
+
+// Split the matmul reductions across this many threads, 0 disables it and -1
+// takes the threads of the parallel runtimes.
+llvm::cl::opt<int64_t> splitKThreads(
+    "split-k-threads",
+    llvm::cl::desc("Split the reduction of matmuls with fewer tiles than "
+                   "this number of threads (-1 for the runtime threads)"),
+    llvm::cl::init(0));
+
+// Tiles per thread below which the matmul reductions are split.
+llvm::cl::opt<int64_t> splitKMinTilesPerThread(
+    "split-k-min-tiles-per-thread",
+    llvm::cl::desc("Split the reduction of matmuls with fewer tiles than "
+                   "this many per split-K thread"),
+    llvm::cl::init(1));
+
+// Balance the last wave of matmul tiles across the split-K threads.
+llvm::cl::opt<bool>
+    streamK("stream-k",
+            llvm::cl::desc("Split the reduction of the last wave of matmul "
+                           "tiles across the split-K threads"),
+            llvm::cl::init(false));
+
+// Fuse the contractions and softmax of attention into tiled loops.
+llvm::cl::opt<bool>
+    fuseAttention("fuse-attention",
+                  llvm::cl::desc("Fuse attention into tiled loops with an "
+                                 "online softmax"),
+                  llvm::cl::init(false));
+
+// Split the keys of the fused attention into blocks processed in parallel.
+llvm::cl::opt<int64_t> attentionKvSplit(
+    "attention-kv-split",
+    llvm::cl::desc("Blocks of the keys of the fused attention processed in "
+                   "parallel, e.g., to decode a single token"),
+    llvm::cl::init(1));
+
+// Fuse the reductions and element-wise operations of layer and RMS
+// normalizations into loops over tiles of rows.
+llvm::cl::opt<bool>
+    fuseNormalization("fuse-normalization",
+                      llvm::cl::desc("Fuse layer and RMS normalizations into "
+                                     "loops over tiles of rows"),
+                      llvm::cl::init(false));
+
+// Fuse the argmax of the logits into blocks of the contraction computing
+// them.
+llvm::cl::opt<bool>
+    fuseTopK("fuse-top-k",
+             llvm::cl::desc("Fuse the argmax of the logits into blocks of the "
+                            "contraction computing them"),
+             llvm::cl::init(false));
+
+// Row panels of the matmul chains, e.g. small-batch MLPs, run through all
+// the layers by a single thread.
+llvm::cl::opt<bool>
+    fuseLayers("fuse-layers",
+               llvm::cl::desc("Fuse the layers of the matmul chains along "
+                              "row panels of their activations"),
+               llvm::cl::init(false));
+
+// Matmuls of the experts of mixture-of-experts layers, with runtime numbers
+// of tokens, grouped into one parallel loop.
+llvm::cl::opt<bool> groupExpertMatmuls(
+    "group-expert-matmuls",
+    llvm::cl::desc("Group the matmuls of the experts of mixture-of-experts "
+                   "layers into one parallel loop"),
+    llvm::cl::init(false));
+
+// Rotary embeddings of the queries and keys applied to the row blocks of
+// their projections.
+llvm::cl::opt<bool> fuseRotaryEmbedding(
+    "fuse-rotary-embedding",
+    llvm::cl::desc("Apply the rotary embeddings of the queries and keys to "
+                   "the row blocks of their projections"),
+    llvm::cl::init(false));
+
+// Map batch matmuls directly and run the gemms of small batches in groups.
+llvm::cl::opt<int64_t> batchMatmulGroupSize(
+    "batch-matmul-group-size",
+    llvm::cl::desc("Map batch matmuls directly, grouping the brgemms of this "
+                   "many batches into one invoke"),
+    llvm::cl::init(0));
+
+// Mixed-precision bf16 on targets without a bf16 dot product.
+llvm::cl::opt<bool> bf16F32Compute(
+    "bf16-f32-compute",
+    llvm::cl::desc("Compute bf16 contractions in f32 from a flat layout on "
+                   "targets without a bf16 dot product"),
+    llvm::cl::init(false));
+
+// Lhs tile sizes for linalg-to-vector, selected from the target register file
+// when empty.
 llvm::cl::list<unsigned>
     lhsTile("lhsTile", llvm::cl::desc("Lhs tile size for brgemm operation"),
-            llvm::cl::list_init<unsigned>(SmallVector<unsigned>{8, 8}),
             llvm::cl::CommaSeparated);
 
-// Rhs tile sizes for linalg-to-vector
+// Rhs tile sizes for linalg-to-vector, selected from the target register file
+// when empty.
 llvm::cl::list<unsigned>
     rhsTile("rhsTile", llvm::cl::desc("Rhs tile size for brgemm operation"),
-            llvm::cl::list_init<unsigned>(SmallVector<unsigned>{8, 16}),
             llvm::cl::CommaSeparated);
 
 llvm::cl::opt<bool> vectorToXSMM("vector-to-XSMM",
                                  llvm::cl::desc("Lower vector to XSMM"),
                                  llvm::cl::init(false));
 
+// Dispatch all XSMM kernels once, ahead of the first kernel call.
+llvm::cl::opt<bool> hoistXsmmDispatch(
+    "hoist-xsmm-dispatch",
+    llvm::cl::desc("Hoist XSMM dispatches into a module initializer"),
+    llvm::cl::init(false));
+
+// Run the brgemms of inner loops in a single call.
+llvm::cl::opt<bool> groupXsmmInvokes(
+    "group-xsmm-invokes",
+    llvm::cl::desc("Group the XSMM brgemm invokes of inner loops"),
+    llvm::cl::init(false));
+
+// Block-sparse brgemms on pruned constant weights.
+llvm::cl::opt<double> sparseWeightDensity(
+    "sparse-weight-density",
+    llvm::cl::desc("Skip the zero blocks of constant weights with at most "
+                   "this fraction of non-zero blocks (0 disables)"),
+    llvm::cl::init(0.0));
+
+// Non-temporal stores of the outputs larger than the last level cache.
+llvm::cl::opt<bool> nontemporalStores(
+    "nontemporal-stores",
+    llvm::cl::desc("Write the large write-once outputs with non-temporal "
+                   "stores"),
+    llvm::cl::init(false));
+
+// Approximations of the transcendental functions of the activations.
+llvm::cl::opt<std::string> mathApprox(
+    "math-approx",
+    llvm::cl::desc("Approximate exp, tanh and erf with vector-to-kernels: "
+                   "none (libm), fast or accurate"),
+    llvm::cl::init("none"));
+
+// Packing of the matmul activations fused into the tile loops.
+llvm::cl::opt<bool> fuseLhsPack(
+    "fuse-lhs-pack",
+    llvm::cl::desc("Pack the block rows of the matmul activations in the "
+                   "tile loops"),
+    llvm::cl::init(false));
+
+// Dequantization of the weight-only quantized matmuls fused into the tile
+// loops.
+llvm::cl::opt<bool> fuseDequantize(
+    "fuse-dequantize",
+    llvm::cl::desc("Pack the quantized weights of the matmuls and dequantize "
+                   "their blocks in the tile loops"),
+    llvm::cl::init(false));
+
+// Winograd F(2x2, 3x3) for the 3x3 stride-1 convolutions.
+llvm::cl::opt<bool> winogradConv(
+    "winograd-conv",
+    llvm::cl::desc("Rewrite the 3x3 stride-1 convolutions with Winograd "
+                   "F(2x2, 3x3)"),
+    llvm::cl::init(false));
+
+// Single-pass kernels of the elementwise update chains, as the optimizer steps.
+llvm::cl::opt<bool> fuseUpdates(
+    "fuse-updates",
+    llvm::cl::desc("Fuse the elementwise update chains of the function "
+                   "arguments into single-pass kernels"),
+    llvm::cl::init(false));
+
+// Transposing packs lowered to the kernels of their 2-D blocks.
+llvm::cl::opt<bool> transposeKernels(
+    "transpose-kernels",
+    llvm::cl::desc("Lower the transposes of the packs to the kernels of "
+                   "2-D blocks"),
+    llvm::cl::init(false));
+
+// Static planning of the intermediate buffers into an arena.
+llvm::cl::opt<bool> planMemory(
+    "plan-memory",
+    llvm::cl::desc("Plan the intermediate buffers into a single arena"),
+    llvm::cl::init(false));
+
+llvm::cl::opt<bool> globalArena(
+    "global-arena",
+    llvm::cl::desc("Allocate the arena of the buffers once for the program"),
+    llvm::cl::init(false));
+
+// Transient buffers of the parallel loops taken from the runtime arena.
+llvm::cl::opt<bool> scratchArena(
+    "scratch-arena",
+    llvm::cl::desc("Take the buffers of the parallel iterations from a "
+                   "scratch arena"),
+    llvm::cl::init(false));
+
+// Fills, copies and element-wise ops outside of the tiled loops run in
+// parallel by rows.
+llvm::cl::opt<bool> parallelStandaloneOps(
+    "parallel-standalone-ops",
+    llvm::cl::desc("Parallelize the fills, copies and element-wise ops left "
+                   "outside of the tiled loops, by rows"),
+    llvm::cl::init(false));
+
+// Rows of consecutive parallel loops, e.g. MLP layers, run without barrier.
+llvm::cl::opt<bool> pipelineLayers(
+    "pipeline-layers",
+    llvm::cl::desc("Start the rows of a parallel loop as soon as the same "
+                   "rows of the previous loop are done (async runtime)"),
+    llvm::cl::init(false));
+
+// Thread distribution of the parallel loops, e.g. for weights sharded over
+// the NUMA nodes by output columns.
+llvm::cl::opt<bool> distributeLastDim(
+    "distribute-last-dim",
+    llvm::cl::desc("Split the last dimension of the parallel loops into "
+                   "contiguous ranges over the threads"),
+    llvm::cl::init(false));
+
+// Order of the tiles of the parallel loops over the threads.
+llvm::cl::opt<std::string> tileTraversal(
+    "tile-traversal",
+    llvm::cl::desc("Walk the tiles of the parallel loops by row, col, "
+                   "grouped or morton order, or pick one from the cache "
+                   "sizes (auto)"),
+    llvm::cl::init("row"));
+
+// Large constants moved out of the binary into a memory-mapped weight blob.
+llvm::cl::opt<std::string>
+    weightBlob("weight-blob",
+               llvm::cl::desc("Write the large constants to this weight blob, "
+                              "mapped at load time"),
+               llvm::cl::init(""));
+
+llvm::cl::opt<int64_t> weightBlobMinBytes(
+    "weight-blob-min-bytes",
+    llvm::cl::desc("Size of the smallest constant moved to the weight blob"),
+    llvm::cl::init(65536));
+
+// Reduction loops of matmuls tiled before the pipeline.
+llvm::cl::opt<bool> loopsToBrgemm(
+    "loops-to-brgemm",
+    llvm::cl::desc("Rewrite the reduction loops of pre-tiled matmuls to "
+                   "BRGEMM"),
+    llvm::cl::init(false));
+
+// Weights of the next layer fetched while the previous one computes.
+llvm::cl::opt<bool> prefetchNextLayer(
+    "prefetch-next-layer",
+    llvm::cl::desc("Prefetch the weight panels of the next parallel loop to L2 "
+                   "during the previous one"),
+    llvm::cl::init(false));
+
+// Software prefetch distance of the brgemm loops of the vector lowering.
+llvm::cl::opt<int64_t> prefetchDistance(
+    "prefetch-distance",
+    llvm::cl::desc("Prefetch the blocks of the vectorized brgemms this many "
+                   "batch-reduce iterations ahead (0 disables)"),
+    llvm::cl::init(0));
+
+// Remainder handling of the matmuls not divided by their blocks.
+llvm::cl::opt<bool> peelRemainders(
+    "peel-remainders",
+    llvm::cl::desc("Peel the edges of the matmuls not divided by their "
+                   "blocks"),
+    llvm::cl::init(false));
+
+// Padding of the matmuls not divided by their blocks.
+llvm::cl::opt<bool> padMatmuls(
+    "pad-matmuls",
+    llvm::cl::desc("Pad the matmuls up to their blocks when it is cheaper "
+                   "than their remainders"),
+    llvm::cl::init(false));
+
+// Replay of the CUDA kernel launches.
+llvm::cl::opt<bool>
+    gpuGraphs("gpu-graphs",
+              llvm::cl::desc("Replay the kernel launch sequences from CUDA "
+                             "graphs"),
+              llvm::cl::init(false));
+
 namespace mlir {
 namespace tpp {
 #define GEN_PASS_DEF_DEFAULTPIPELINE
@@ -155,16 +490,65 @@ private:
       // Apply the default preprocessing pass
       DefaultTppPassesOptions tppDefaultOptions; 
       tppDefaultOptions.linalgToLoops = linalgToLoops;
+      tppDefaultOptions.linalgToBlas = linalgToBlas;
       tppDefaultOptions.parallelTaskGrid = SmallVector<unsigned>{
           parallelTaskGrid.begin(), parallelTaskGrid.end()};
       tppDefaultOptions.linalgToVector = linalgToVector;
       tppDefaultOptions.vectorToXSMM = vectorToXSMM;
       tppDefaultOptions.lowerPackUnpackWithoutTranspose = lowerPackUnpackWithoutTranspose;
+      tppDefaultOptions.matmulBlockFactors = SmallVector<int64_t>{
+          matmulBlockFactors.begin(), matmulBlockFactors.end()};
+      tppDefaultOptions.matmulCostModel = matmulCostModel;
+      tppDefaultOptions.fusionOuterTiles = SmallVector<int64_t>{
+          fusionOuterTiles.begin(), fusionOuterTiles.end()};
+      tppDefaultOptions.reportResidualLayouts = reportResidualLayouts;
+      tppDefaultOptions.splitKThreads = splitKThreads;
+      tppDefaultOptions.streamK = streamK;
+      tppDefaultOptions.splitKMinTilesPerThread = splitKMinTilesPerThread;
+      tppDefaultOptions.fuseAttention = fuseAttention;
+      tppDefaultOptions.attentionKvSplit = attentionKvSplit;
+      tppDefaultOptions.fuseNormalization = fuseNormalization;
+      tppDefaultOptions.fuseTopK = fuseTopK;
+      tppDefaultOptions.fuseLayers = fuseLayers;
+      tppDefaultOptions.groupExpertMatmuls = groupExpertMatmuls;
+      tppDefaultOptions.fuseRotaryEmbedding = fuseRotaryEmbedding;
+      tppDefaultOptions.batchMatmulGroupSize = batchMatmulGroupSize;
+      tppDefaultOptions.bf16F32Compute = bf16F32Compute;
       tppDefaultOptions.lhsTile =
           SmallVector<unsigned>{lhsTile.begin(), lhsTile.end()};
       tppDefaultOptions.rhsTile =
           SmallVector<unsigned>{rhsTile.begin(), rhsTile.end()};
       tppDefaultOptions.vectorToKernel = vectorToKernel;
+      // The profile revisits the per-op choices, unless all the operations
+      // take another lowering.
+      tppDefaultOptions.perOpLowering =
+          perOpLowering || (!profileIn.empty() && !linalgToVector &&
+                            !vectorToXSMM && !vectorToKernel);
+      tppDefaultOptions.loweringProfile = profileIn;
+      tppDefaultOptions.hoistXsmmDispatch = hoistXsmmDispatch;
+      tppDefaultOptions.groupXsmmInvokes = groupXsmmInvokes;
+      tppDefaultOptions.sparseWeightDensity = sparseWeightDensity;
+      tppDefaultOptions.nontemporalStores = nontemporalStores;
+      tppDefaultOptions.mathApprox = mathApprox;
+      tppDefaultOptions.prefetchDistance = prefetchDistance;
+      tppDefaultOptions.peelRemainders = peelRemainders;
+      tppDefaultOptions.padMatmuls = padMatmuls;
+      tppDefaultOptions.fuseLhsPack = fuseLhsPack;
+      tppDefaultOptions.fuseDequantize = fuseDequantize;
+      tppDefaultOptions.winogradConv = winogradConv;
+      tppDefaultOptions.fuseUpdates = fuseUpdates;
+      tppDefaultOptions.transposeKernels = transposeKernels;
+      tppDefaultOptions.planMemory = planMemory;
+      tppDefaultOptions.globalArena = globalArena;
+      tppDefaultOptions.scratchArena = scratchArena;
+      tppDefaultOptions.parallelStandaloneOps = parallelStandaloneOps;
+      tppDefaultOptions.pipelineLayers = pipelineLayers;
+      tppDefaultOptions.distributeLastDim = distributeLastDim;
+      tppDefaultOptions.tileTraversal = tileTraversal;
+      tppDefaultOptions.weightBlob = weightBlob;
+      tppDefaultOptions.weightBlobMinBytes = weightBlobMinBytes;
+      tppDefaultOptions.loopsToBrgemm = loopsToBrgemm;
+      tppDefaultOptions.prefetchNextLayer = prefetchNextLayer;
 
       pm.addPass(createDefaultTppPasses(tppDefaultOptions));
     }
@@ -179,12 +563,33 @@ private:
       return;
     }
 
+    // The vector-to-kernel path may emit scalable outer products for SME.
+    bool armSme =
+        CpuTargetInfo::get(getOperation(), /*fromTargetArch=*/true).hasSme;
+
     // Partial Lowering
     pm.addPass(memref::createExpandStridedMetadataPass());
     pm.addPass(createConvertTensorToLinalgPass());
     pm.addNestedPass<func::FuncOp>(createConvertLinalgToLoopsPass());
-    if (defParallel)
+    bool taskRuntime = parallelRuntime == "tasks";
+    if (defParallel && taskRuntime) {
+      pm.addPass(createConvertParallelToTasks());
+    } else if (defParallel) {
       pm.addPass(createConvertSCFToOpenMPPass());
+      pm.addNestedPass<func::FuncOp>(
+          createIntelAMXTileConfigThreadHoistingPass());
+    }
+    if (armSme) {
+      pm.addPass(arm_sme::createVectorLegalizationPass());
+      pm.addPass(createCanonicalizerPass());
+      pm.addPass(createCSEPass());
+      pm.addPass(createArithToArmSMEConversionPass());
+      pm.addPass(createConvertVectorToArmSMEPass());
+      pm.addNestedPass<func::FuncOp>(arm_sme::createEnableArmStreamingPass(
+          arm_sme::ArmStreamingMode::StreamingLocally,
+          arm_sme::ArmZaMode::NewZA, /*ifRequiredByOps=*/true));
+      pm.addPass(createConvertArmSMEToSCFPass());
+    }
     pm.addPass(createConvertVectorToSCFPass());
     pm.addPass(arith::createArithExpandOpsPass());
     pm.addPass(createLowerAffinePass());
@@ -194,14 +599,31 @@ private:
       pm.addPass(createPrintIRPass());
 
     // Lower to LLVM
-    pm.addPass(createConvertVectorToLLVMPass());
+    // The vector-to-kernel path may emit x86vector dot products and AMX
+    // tile operations.
+    if (armSme) {
+      // The ZA tiles are allocated on the control flow graph.
+      pm.addPass(createConvertSCFToCFPass());
+      pm.addNestedPass<func::FuncOp>(createConvertArmSMEToLLVMPass());
+      pm.addPass(createCanonicalizerPass());
+      pm.addPass(createCSEPass());
+    }
+    ConvertVectorToLLVMPassOptions vectorToLLVMOptions;
+    vectorToLLVMOptions.x86Vector = true;
+    vectorToLLVMOptions.amx = true;
+    pm.addPass(createConvertVectorToLLVMPass(vectorToLLVMOptions));
     pm.addPass(createFinalizeMemRefToLLVMConversionPass());
     pm.addPass(createConvertSCFToCFPass());
-    if (defParallel)
+    if (defParallel && !taskRuntime)
       pm.addPass(createConvertOpenMPToLLVMPass());
     pm.addPass(createConvertMathToLLVMPass());
 
     pm.addNestedPass<func::FuncOp>(createGpuAsyncRegionPass());
+    // The graphs capture the launch chains of the async regions.
+    if (gpuGraphs && gpuBackend == "cuda") {
+      pm.addPass(createGpuGraphCapture());
+      pm.addPass(createFinalizeMemRefToLLVMConversionPass());
+    }
     pm.addPass(createGpuToLLVMConversionPass());
     GpuModuleToBinaryPassOptions gpuModuleToBinaryPassOptions;
     gpuModuleToBinaryPassOptions.compilationTarget = "fatbin";
@@ -70,7 +70,7 @@ struct DefaultTppPasses
 
 private:
   void constructPipeline() override {
-    // We currently have four branches:
+    // We currently have five branches:
     //  * Linalg-to-XSMM: the default path, no options needed
     //  * Linalg-to-Vector: Enable with `linalg-to-vector` flag.
     //    No further changes done to the IR, lowers straigt to LLVM.
@@ -79,9 +79,16 @@ private:
     //  * Vector-to-Kernel: Enable with `vector-to-kernel` flag, forces
     //    `linalg-to-vector` and lowers vector patterns to libxsmm-like
     //    micro-kernels via specialized lowering of certain vector patterns.
+    //  * Per-op: Enable with `per-op-lowering` flag, each operation takes
+    //    the Linalg-to-XSMM or the Vector-to-Kernel branch as selected by
+    //    the cost model.
     assert(!(vectorToXSMM && vectorToKernel) &&
            "XSMM and Kernel lowering are mutually exclusive");
-    bool forceLinalgToVector = (vectorToXSMM || vectorToKernel);
+    assert(!(perOpLowering && (linalgToVector || vectorToXSMM ||
+                               vectorToKernel)) &&
+           "Per-op lowering selects the branch of each operation");
+    bool forceLinalgToVector =
+        (vectorToXSMM || vectorToKernel || perOpLowering);
 
     // List of operations to skip when lowering Linalg to XSMM / Kernel.
     // This allows further passes to lower to vector, function, codegen
@@ -100,7 +107,7 @@ private:
     }
 
     // Pipeline building starts here.
-    pm.addPass(createFoldAddIntoDest());
+    pm.addNestedPass<func::FuncOp>(createFoldAddIntoDest());
     if (linalgToLoops) {
       // Lower linalg directly to loops.
       // Skip all TPP transformations.
@@ -109,20 +116,46 @@ private:
       pm.addNestedPass<func::FuncOp>(createDecomposeAggregatedOps());
       pm.addPass(createBufferize());
       pm.addNestedPass<func::FuncOp>(createConvertLinalgToLoopsPass());
-      pm.addPass(createCleanup());
+      pm.addNestedPass<func::FuncOp>(createCleanup());
+    } else if (linalgToBlas) {
+      // Lower the matmuls to oneDNN calls, fusing their bias and relu, as a
+      // baseline of the TPP transformations.
+      pm.addNestedPass<func::FuncOp>(createConvertLinalgToInplace());
+      pm.addPass(createLowerPacksAndUnPacks());
+      pm.addNestedPass<func::FuncOp>(createDecomposeAggregatedOps());
+      pm.addPass(createBufferize());
+      pm.addNestedPass<func::FuncOp>(createLinalgDeGeneralize());
+      pm.addPass(createConvertLinalgToFunc());
+      pm.addNestedPass<func::FuncOp>(createConvertLinalgToLoopsPass());
+      pm.addNestedPass<func::FuncOp>(createCleanup());
     } else {
-      pm.addPass(createFoldIntoEltwise());
+      // Collapse the reduction loops of the matmuls tiled by the front-end.
+      if (loopsToBrgemm)
+        pm.addNestedPass<func::FuncOp>(createRewriteLoopsToBrgemm());
+      pm.addNestedPass<func::FuncOp>(
+          createFoldIntoEltwise(FoldIntoEltwiseOptions{fuseUpdates}));
       pm.addNestedPass<func::FuncOp>(createConvertLinalgToInplace());
-      // Convert linalg.batch_matmul to linalg.matmul.
-      pm.addPass(createRewriteBatchMatmulToMatmul());
+      // Convert linalg.batch_matmul to linalg.matmul, unless batch matmuls
+      // are packed and tiled with the batch as a parallel dimension.
+      if (batchMatmulGroupSize <= 0)
+        pm.addPass(createRewriteBatchMatmulToMatmul());
 
       // Applies a set of passes at the linalg level to fuse and pack.
-      TppMappingOptions tppMappingOptions{lowerPackUnpackWithoutTranspose};
+      TppMappingOptions tppMappingOptions{
+          lowerPackUnpackWithoutTranspose,
+          SmallVector<int64_t>{*matmulBlockFactors}, matmulCostModel,
+          SmallVector<int64_t>{*fusionOuterTiles}, reportResidualLayouts,
+          splitKThreads, streamK, splitKMinTilesPerThread, fuseAttention,
+          attentionKvSplit, fuseNormalization, batchMatmulGroupSize,
+          bf16F32Compute, peelRemainders, padMatmuls, fuseLhsPack,
+          fuseDequantize, winogradConv, fuseTopK, fuseLayers,
+          groupExpertMatmuls, fuseRotaryEmbedding};
       pm.addPass(createTppMapping(tppMappingOptions));
 
       // Generalize tensor.pack and tensor.unpack.
-      pm.addPass(createLowerPacksAndUnPacks());
-      pm.addPass(createCleanup());
+      pm.addPass(createLowerPacksAndUnPacks(
+          LowerPacksAndUnPacksOptions{nontemporalStores, transposeKernels}));
+      pm.addNestedPass<func::FuncOp>(createCleanup());
 
       // Decompose Aggregated operations. These ops currently do not
       // bufferize. Once this is possible we can move this pass after
@@ -131,6 +164,17 @@ private:
 
       // Bufferize: tensor->memref.
       pm.addPass(createBufferize());
+      if (loopsToBrgemm)
+        pm.addNestedPass<func::FuncOp>(createRewriteLoopsToBrgemm());
+      if (prefetchNextLayer)
+        pm.addNestedPass<func::FuncOp>(createPrefetchNextLayer());
+      if (parallelStandaloneOps)
+        pm.addNestedPass<func::FuncOp>(createParallelizeStandaloneOps());
+
+      // Route each operation to XSMM or to the vector lowering.
+      if (perOpLowering)
+        pm.addNestedPass<func::FuncOp>(
+            createSelectLowering(SelectLoweringOptions{loweringProfile}));
 
       // Lower Linalg to XSMM.
       pm.addNestedPass<func::FuncOp>(
@@ -140,7 +184,9 @@ private:
         // Vectorizes the remaining Linalg operations
         pm.addNestedPass<func::FuncOp>(createBrgemmLinalgTiling(
             BrgemmLinalgTilingOptions{SmallVector<unsigned>{*lhsTile},
-                                      SmallVector<unsigned>{*rhsTile}}));
+                                      SmallVector<unsigned>{*rhsTile},
+                                      /*reportRegisterBlock=*/false,
+                                      peelRemainders}));
         pm.addNestedPass<func::FuncOp>(createLoopInvariantCodeMotionPass());
         pm.addNestedPass<func::FuncOp>(createVectorizationPass());
 
@@ -151,20 +197,36 @@ private:
         if (vectorToXSMM) {
           pm.addPass(createVectorToXSMM());
         }
-        if (vectorToKernel) {
-          pm.addPass(createVectorToKernel());
+        if (vectorToKernel || perOpLowering) {
+          pm.addPass(
+              createVectorToKernel(
+              VectorToKernelOptions{nontemporalStores, mathApprox}));
+        }
+        // The XSMM brgemms prefetch on their own.
+        if (prefetchDistance > 0 && !vectorToXSMM) {
+          pm.addNestedPass<func::FuncOp>(
+              createBrgemmPrefetch(BrgemmPrefetchOptions{prefetchDistance}));
         }
       }
 
       // Final cleanup.
-      pm.addPass(createCleanup());
+      pm.addNestedPass<func::FuncOp>(createCleanup());
     }
 
+    // Pack the intermediate buffers into a single arena.
+    if (planMemory)
+      pm.addPass(createPlanMemory(PlanMemoryOptions{globalArena}));
+
     // Convert forAll to parallel loops should run after bufferization
     // as scf.parallel does not handle tensor.
     pm.addPass(createConvertForAllToParallelOp());
+    if (pipelineLayers)
+      pm.addNestedPass<func::FuncOp>(createPipelineParallelLayers());
+    if (scratchArena)
+      pm.addPass(createConvertAllocsToScratch());
     LowLevelParallelizationOptions LowLevelParallelization{
-        SmallVector<unsigned>{*parallelTaskGrid}};
+        SmallVector<unsigned>{*parallelTaskGrid}, distributeLastDim,
+        tileTraversal};
 
     if (linalgToVector) {
       pm.addPass(createConvertVectorToSCFPass());
@@ -181,9 +243,21 @@ private:
       pm.addNestedPass<func::FuncOp>(createLoopInvariantCodeMotionPass());
       pm.addNestedPass<func::FuncOp>(createCanonicalizerPass());
       pm.addNestedPass<func::FuncOp>(createIntelAMXTileConfigHoistingPass());
+      if (sparseWeightDensity > 0) {
+        pm.addPass(createSparsifyBrgemmWeights(
+            SparsifyBrgemmWeightsOptions{sparseWeightDensity}));
+      }
+      if (groupXsmmInvokes || batchMatmulGroupSize > 0)
+        pm.addNestedPass<func::FuncOp>(createGroupXsmmInvokes());
       // TODO: This pass has been moved out of LocalDialectsLowering since it is
       // applicable to xsmm only. It'll be moved back in subsequent commits.
-      pm.addPass(createConvertXsmmToFunc());
+      pm.addPass(createConvertXsmmToFunc(
+          ConvertXsmmToFuncOptions{hoistXsmmDispatch}));
+    }
+    // Move the large constants to a weight blob mapped at load time.
+    if (!weightBlob.empty()) {
+      pm.addPass(createExternalizeConstants(
+          ExternalizeConstantsOptions{weightBlob, weightBlobMinBytes}));
     }
     // Covert all local TPP-related dialects.
     pm.addPass(createLocalDialectsLowering());
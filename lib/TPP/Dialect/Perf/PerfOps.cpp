@@ -25,20 +25,145 @@ using namespace mlir::perf;
 // StopTimerOp
 //===----------------------------------------------------------------------===//
 
-LogicalResult StopTimerOp::verify() {
-  auto *timerSrc = getTimer().getDefiningOp();
-  if (!timerSrc || !isa<StartTimerOp>(timerSrc))
-    return emitOpError("invalid timer input");
-
-  // Any timer can only be stopped once. It is unusable afterwards.
-  int numStopTimers = 0;
-  for (auto *user : timerSrc->getUsers()) {
-    if (isa<StopTimerOp>(*user))
-      ++numStopTimers;
+// Verify that a stop op consumes a handle created by the matching start op and
+// that the handle is stopped only once.
+template <typename StartOpTy, typename StopOpTy>
+static LogicalResult verifyStopOp(StopOpTy stopOp, Value handle,
+                                  StringRef handleName) {
+  auto *handleSrc = handle.getDefiningOp();
+  if (!handleSrc || !isa<StartOpTy>(handleSrc))
+    return stopOp.emitOpError("invalid ") << handleName << " input";
+
+  // Any handle can only be stopped once. It is unusable afterwards.
+  int numStops = 0;
+  for (auto *user : handleSrc->getUsers()) {
+    if (isa<StopOpTy>(*user))
+      ++numStops;
   }
-  if (numStopTimers != 1)
-    return emitOpError("timer stopped multiple times");
+  if (numStops != 1)
+    return stopOp.emitOpError() << handleName << " stopped multiple times";
+
+  return success();
+}
+
+LogicalResult StopTimerOp::verify() {
+  return verifyStopOp<StartTimerOp>(*this, getTimer(), "timer");
+}
+
+//===----------------------------------------------------------------------===//
+// StopDeviceTimerOp
+//===----------------------------------------------------------------------===//
+
+LogicalResult StopDeviceTimerOp::verify() {
+  return verifyStopOp<StartDeviceTimerOp>(*this, getTimer(), "timer");
+}
+
+//===----------------------------------------------------------------------===//
+// StopCountersOp
+//===----------------------------------------------------------------------===//
+
+LogicalResult StopCountersOp::verify() {
+  return verifyStopOp<StartCountersOp>(*this, getCounters(), "counters");
+}
+
+//===----------------------------------------------------------------------===//
+// StopEnergyOp
+//===----------------------------------------------------------------------===//
+
+LogicalResult StopEnergyOp::verify() {
+  return verifyStopOp<StartEnergyOp>(*this, getEnergy(), "energy counters");
+}
+
+//===----------------------------------------------------------------------===//
+// PercentileOp
+//===----------------------------------------------------------------------===//
+
+LogicalResult PercentileOp::verify() {
+  double percentile = getPercentile().convertToDouble();
+  if (percentile < 0.0 || percentile > 100.0)
+    return emitOpError("expect percentile in range [0, 100] but got: ")
+           << percentile;
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// MapFileOp
+//===----------------------------------------------------------------------===//
+
+// Element types supported by the perf runtime tensor routines.
+static bool isRuntimeElementType(Type elementType) {
+  return elementType.isF32() || elementType.isF64() || elementType.isF16() ||
+         elementType.isBF16() || elementType.isInteger(8) ||
+         elementType.isInteger(16) || elementType.isInteger(32) ||
+         elementType.isInteger(64);
+}
+
+LogicalResult MapFileOp::verify() {
+  auto elementType = getType().getElementType();
+  if (!isRuntimeElementType(elementType))
+    return emitOpError("unsupported element type: ") << elementType;
+  if (!getType().getLayout().isIdentity())
+    return emitOpError("expect an identity layout");
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// MapBlobOp
+//===----------------------------------------------------------------------===//
+
+LogicalResult MapBlobOp::verify() {
+  auto elementType = getType().getElementType();
+  if (!isRuntimeElementType(elementType))
+    return emitOpError("unsupported element type: ") << elementType;
+  if (!getType().getLayout().isIdentity())
+    return emitOpError("expect an identity layout");
+  int64_t offset = getOffset();
+  if (offset <= 0 || offset % (elementType.getIntOrFloatBitWidth() / 8) != 0)
+    return emitOpError("expect a positive offset aligned to the element "
+                       "size but got: ")
+           << offset;
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// AllocOp
+//===----------------------------------------------------------------------===//
+
+LogicalResult AllocOp::verify() {
+  auto elementType = getType().getElementType();
+  if (!isRuntimeElementType(elementType))
+    return emitOpError("unsupported element type: ") << elementType;
+  if (!getType().getLayout().isIdentity())
+    return emitOpError("expect an identity layout");
+  if (getInterleave() && getShard())
+    return emitOpError("expect either interleave or shard");
+
+  int64_t pageSize = getPageSize();
+  if (pageSize != 0 && pageSize != (int64_t(1) << 21) &&
+      pageSize != (int64_t(1) << 30))
+    return emitOpError("expect a page size of 2MB or 1GB but got: ")
+           << pageSize;
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// InitTensorOp
+//===----------------------------------------------------------------------===//
 
+LogicalResult InitTensorOp::verify() {
+  auto bufferType = cast<MemRefType>(getBuffer().getType());
+  auto elementType = bufferType.getElementType();
+  if (!isRuntimeElementType(elementType))
+    return emitOpError("unsupported element type: ") << elementType;
+  if (!bufferType.getLayout().isIdentity())
+    return emitOpError("expect an identity layout");
+
+  auto init = getInit();
+  if (init != "const" && init != "simple" && init != "cont" &&
+      init != "random" && init != "normal")
+    return emitOpError("unknown initializer: ") << init;
+  if ((init == "random" || init == "normal") && getSeed() == 0)
+    return emitOpError("expect a non-zero seed for random initializers");
   return success();
 }
 
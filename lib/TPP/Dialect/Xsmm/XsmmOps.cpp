@@ -22,6 +22,7 @@ using namespace mlir::xsmm;
 namespace {
 constexpr std::string_view INPUTS = "inputs";
 constexpr std::string_view DATA_TYPE = "data_type";
+constexpr std::string_view OUTPUT_TYPE = "output_type";
 constexpr std::string_view FLAGS_NAME = "flags";
 constexpr std::string_view KIND = "kind";
 constexpr std::string_view UNARY_FLAGS_NAME = "unary_flags";
@@ -52,8 +53,41 @@ static ParseResult parseInputImpl(OpAsmParser &parser, OperationState &result) {
   return success();
 }
 
+// Parse gemm-like inputs where each entry is either an integer or an i64 SSA
+// value known only at runtime, i.e., `[%m, 64, 32, 32, 64, 64]`.
+static ParseResult parseDynamicInputsImpl(OpAsmParser &parser,
+                                          OperationState &result) {
+  auto &builder = parser.getBuilder();
+  SmallVector<int64_t> inputs;
+  SmallVector<OpAsmParser::UnresolvedOperand> dynamicInputs;
+  auto parseInput = [&]() -> ParseResult {
+    OpAsmParser::UnresolvedOperand operand;
+    OptionalParseResult parsedOperand = parser.parseOptionalOperand(operand);
+    if (parsedOperand.has_value()) {
+      if (failed(*parsedOperand))
+        return failure();
+      dynamicInputs.push_back(operand);
+      inputs.push_back(ShapedType::kDynamic);
+      return success();
+    }
+    int64_t input;
+    if (parser.parseInteger(input))
+      return failure();
+    inputs.push_back(input);
+    return success();
+  };
+  if (parser.parseCommaSeparatedList(OpAsmParser::Delimiter::Square,
+                                     parseInput)) {
+    return failure();
+  }
+  result.addAttribute(INPUTS, builder.getDenseI64ArrayAttr(inputs));
+  return parser.resolveOperands(dynamicInputs, builder.getI64Type(),
+                                result.operands);
+}
+
 static ParseResult parseDataTypeImpl(OpAsmParser &parser,
-                                     OperationState &result) {
+                                     OperationState &result,
+                                     bool hasOutputType = false) {
   auto &builder = parser.getBuilder();
   if (parser.parseKeyword(DATA_TYPE) || parser.parseEqual())
     return failure();
@@ -62,6 +96,14 @@ static ParseResult parseDataTypeImpl(OpAsmParser &parser,
     return failure();
   result.addAttribute(DATA_TYPE,
                       DataTypeAttr::get(builder.getContext(), dataType));
+  // Gemm-like dispatches may store C in a different type.
+  if (hasOutputType && succeeded(parser.parseOptionalKeyword(OUTPUT_TYPE))) {
+    DataType outputType;
+    if (parser.parseEqual() || parseEnum(outputType, parser))
+      return failure();
+    result.addAttribute(OUTPUT_TYPE,
+                        DataTypeAttr::get(builder.getContext(), outputType));
+  }
   result.addTypes(builder.getIntegerType(64));
 
   // Parse the optional attribute list
@@ -91,19 +133,19 @@ static ParseResult parserFlagsImpl(OpAsmParser &parser, OperationState &result,
 }
 
 ParseResult GemmDispatchOp::parse(OpAsmParser &parser, OperationState &result) {
-  if (failed(parseInputImpl(parser, result)))
+  if (failed(parseDynamicInputsImpl(parser, result)))
     return failure();
   if (failed(parserFlagsImpl<GemmFlags>(parser, result, FLAGS_NAME)))
     return failure();
-  return parseDataTypeImpl(parser, result);
+  return parseDataTypeImpl(parser, result, /*hasOutputType=*/true);
 }
 
 ParseResult BrgemmDispatchOp::parse(OpAsmParser &parser,
                                     OperationState &result) {
-  if (failed(parseInputImpl(parser, result)) ||
+  if (failed(parseDynamicInputsImpl(parser, result)) ||
       failed(parserFlagsImpl<GemmFlags>(parser, result, FLAGS_NAME)))
     return failure();
-  return parseDataTypeImpl(parser, result);
+  return parseDataTypeImpl(parser, result, /*hasOutputType=*/true);
 }
 
 ParseResult FusedBrgemmDispatchOp::parse(OpAsmParser &parser,
@@ -165,16 +207,36 @@ static void printerInputImpl(OpAsmPrinter &printer, OpTy op) {
   printer << " [" << op.getInputs() << ']';
 };
 
+template <typename OpTy>
+static void printerDynamicInputsImpl(OpAsmPrinter &printer, OpTy op) {
+  auto dynamicInputs = op.getDynamicInputs().begin();
+  printer << " [";
+  llvm::interleaveComma(op.getInputs(), printer, [&](int64_t input) {
+    if (ShapedType::isDynamic(input))
+      printer << *dynamicInputs++;
+    else
+      printer << input;
+  });
+  printer << ']';
+}
+
 template <typename OpTy>
 static void printerDataTypeImpl(OpAsmPrinter &printer, OpTy op) {
   printer << DATA_TYPE << " = ";
   auto dataType = op.getDataType();
   printer << xsmm::stringifyDataType(dataType);
+  if constexpr (llvm::is_one_of<OpTy, GemmDispatchOp,
+                                BrgemmDispatchOp>::value) {
+    if (std::optional<DataType> outputType = op.getOutputType()) {
+      printer << " " << OUTPUT_TYPE << " = "
+              << xsmm::stringifyDataType(*outputType);
+    }
+  }
   printer.printOptionalAttrDict(
       op->getAttrs(),
-      /*elidedAttrs=*/{DATA_TYPE, FLAGS_NAME, INPUTS, KIND, FLAGS_NAME,
-                       UNARY_FLAGS_NAME, BINARY_FLAGS_NAME, BINARY_KIND,
-                       UNARY_KIND});
+      /*elidedAttrs=*/{DATA_TYPE, OUTPUT_TYPE, FLAGS_NAME, INPUTS, KIND,
+                       FLAGS_NAME, UNARY_FLAGS_NAME, BINARY_FLAGS_NAME,
+                       BINARY_KIND, UNARY_KIND});
 }
 
 template <typename AttrTy>
@@ -189,14 +251,14 @@ static void printerFlagsImpl(OpAsmPrinter &printer,
 }
 
 void GemmDispatchOp::print(OpAsmPrinter &printer) {
-  printerInputImpl<GemmDispatchOp>(printer, *this);
+  printerDynamicInputsImpl<GemmDispatchOp>(printer, *this);
   auto getOpFlags = [this]() -> ArrayAttr { return this->getFlags(); };
   printerFlagsImpl<GemmFlagsAttr>(printer, getOpFlags, FLAGS_NAME);
   printerDataTypeImpl<GemmDispatchOp>(printer, *this);
 }
 
 void BrgemmDispatchOp::print(OpAsmPrinter &printer) {
-  printerInputImpl<BrgemmDispatchOp>(printer, *this);
+  printerDynamicInputsImpl<BrgemmDispatchOp>(printer, *this);
   auto getOpFlags = [this]() -> ArrayAttr { return this->getFlags(); };
   printerFlagsImpl<GemmFlagsAttr>(printer, getOpFlags, FLAGS_NAME);
   printerDataTypeImpl<BrgemmDispatchOp>(printer, *this);
@@ -288,13 +350,53 @@ static LogicalResult verifyGemmFlags(ArrayAttr flags, DataType dataType,
   for (auto flag : flags) {
     flagsAsInt.push_back(cast<IntegerAttr>(flag).getInt());
   }
-  // VNNI flags must be specified only for bf16 type
-  if (dataType != DataType::BF16 && llvm::any_of(flagsAsInt, [](int64_t flag) {
+  // VNNI flags must be specified only for bf16 and i8 types
+  if (dataType != DataType::BF16 && dataType != DataType::I8 &&
+      llvm::any_of(flagsAsInt, [](int64_t flag) {
         return (flag == static_cast<int64_t>(GemmFlags::VNNI_B) ||
                 flag == static_cast<int64_t>(GemmFlags::VNNI_A) ||
                 flag == static_cast<int64_t>(GemmFlags::VNNI_C));
       })) {
-    return op->emitOpError() << "VNNI flags but type is not bf16";
+    return op->emitOpError() << "VNNI flags but type is not bf16 or i8";
+  }
+
+  // A transposed operand is not in VNNI layout.
+  auto hasFlags = [&](GemmFlags lhs, GemmFlags rhs) {
+    return llvm::is_contained(flagsAsInt, static_cast<int64_t>(lhs)) &&
+           llvm::is_contained(flagsAsInt, static_cast<int64_t>(rhs));
+  };
+  if (hasFlags(GemmFlags::TRANS_A, GemmFlags::VNNI_A) ||
+      hasFlags(GemmFlags::TRANS_B, GemmFlags::VNNI_B)) {
+    return op->emitOpError() << "transpose and VNNI flags on the same operand";
+  }
+
+  // Prefetch is only supported by the gemm and brgemm kernels.
+  if (isa<FusedBrgemmDispatchOp>(op.getOperation()) &&
+      llvm::any_of(flagsAsInt, [](int64_t flag) {
+        return (flag == static_cast<int64_t>(GemmFlags::PREFETCH_A) ||
+                flag == static_cast<int64_t>(GemmFlags::PREFETCH_B));
+      })) {
+    return op->emitOpError() << "prefetch flags are not supported";
+  }
+
+  // Batch-reduce type is only supported by the brgemm kernel, and not
+  // together with prefetch.
+  bool isAddress = llvm::is_contained(
+      flagsAsInt, static_cast<int64_t>(GemmFlags::BATCH_REDUCE_ADDRESS));
+  bool isOffset = llvm::is_contained(
+      flagsAsInt, static_cast<int64_t>(GemmFlags::BATCH_REDUCE_OFFSET));
+  if (!isAddress && !isOffset)
+    return success();
+  if (!isa<BrgemmDispatchOp>(op.getOperation()))
+    return op->emitOpError() << "batch-reduce flags are not supported";
+  if (isAddress && isOffset)
+    return op->emitOpError() << "conflicting batch-reduce flags";
+  if (llvm::any_of(flagsAsInt, [](int64_t flag) {
+        return (flag == static_cast<int64_t>(GemmFlags::PREFETCH_A) ||
+                flag == static_cast<int64_t>(GemmFlags::PREFETCH_B));
+      })) {
+    return op->emitOpError()
+           << "prefetch flags are not supported with batch-reduce flags";
   }
 
   return success();
@@ -304,7 +406,8 @@ template <typename OpTy>
 static LogicalResult verifyDispatchInputs(OpTy op, size_t expected) {
   static_assert(llvm::is_one_of<OpTy, xsmm::UnaryDispatchOp,
                                 xsmm::BinaryDispatchOp, GemmDispatchOp,
-                                BrgemmDispatchOp, FusedBrgemmDispatchOp>::value,
+                                BrgemmDispatchOp, FusedBrgemmDispatchOp,
+                                EquationDispatchOp>::value,
                 "applies to xsmm dispatch operations only");
 
   // `inputs` are leading dimensions and sizes
@@ -327,27 +430,82 @@ template <typename OpTy> static LogicalResult verifyGemmLikeOp(OpTy op) {
 
   // Verify leading dims.
   ArrayRef<int64_t> inputs = op.getInputs();
+  int64_t m = inputs[0];
   int64_t n = inputs[1];
   int64_t k = inputs[2];
   int64_t lda = inputs[3];
   int64_t ldb = inputs[4];
   int64_t ldc = inputs[5];
-  if (lda < k)
-    return op.emitOpError() << "expect lda to be >= of dimension k\n";
-  if (ldb < n)
-    return op.emitOpError() << "expect ldb to be >= of dimension n\n";
-  if (ldc < n)
+  // Dynamic sizes are only known at runtime, skip them.
+  auto isLess = [](int64_t ld, int64_t dim) {
+    return !ShapedType::isDynamic(ld) && !ShapedType::isDynamic(dim) &&
+           ld < dim;
+  };
+  // A transposed A is stored as (k, m), a transposed B as (n, k).
+  auto hasFlag = [&](GemmFlags flag) {
+    return llvm::is_contained(op.getFlags(),
+                              GemmFlagsAttr::get(op.getContext(), flag));
+  };
+  bool isTransposedA = hasFlag(GemmFlags::TRANS_A);
+  bool isTransposedB = hasFlag(GemmFlags::TRANS_B);
+  if (isLess(lda, isTransposedA ? m : k)) {
+    return op.emitOpError() << "expect lda to be >= of dimension "
+                            << (isTransposedA ? "m" : "k") << "\n";
+  }
+  if (isLess(ldb, isTransposedB ? k : n)) {
+    return op.emitOpError() << "expect ldb to be >= of dimension "
+                            << (isTransposedB ? "k" : "n") << "\n";
+  }
+  if (isLess(ldc, n))
     return op.emitOpError() << "expect ldc to be >= of dimension n\n";
 
   // Verify dispatch flags.
   return verifyGemmFlags(op.getFlags(), op.getDataType(), op, FLAGS_NAME);
 }
 
+// Each dynamic entry in `inputs` must have a matching operand.
+template <typename OpTy> static LogicalResult verifyDynamicInputs(OpTy op) {
+  static_assert(llvm::is_one_of<OpTy, GemmDispatchOp, BrgemmDispatchOp>::value,
+                "applies to dynamic gemm-like dispatch operations only");
+
+  size_t numDynamic = llvm::count_if(op.getInputs(), [](int64_t input) {
+    return ShapedType::isDynamic(input);
+  });
+  size_t numOperands = op.getDynamicInputs().size();
+  if (numDynamic != numOperands) {
+    return op.emitOpError() << "expect " << numDynamic
+                            << " dynamic inputs but got: " << numOperands;
+  }
+  return success();
+}
+
+// Reduced precision floats accumulate in f32, only their gemms can store C in
+// f32 instead of the input type.
+template <typename OpTy> static LogicalResult verifyOutputType(OpTy op) {
+  static_assert(llvm::is_one_of<OpTy, GemmDispatchOp, BrgemmDispatchOp>::value,
+                "applies to dynamic gemm-like dispatch operations only");
+
+  std::optional<DataType> outputType = op.getOutputType();
+  if (!outputType)
+    return success();
+  if (*outputType != DataType::F32 ||
+      (op.getDataType() != DataType::BF16 &&
+       op.getDataType() != DataType::F16)) {
+    return op.emitOpError()
+           << "expect output type f32 only for bf16 and f16 data types";
+  }
+  return success();
+}
+
 LogicalResult GemmDispatchOp::verify() {
+  if (failed(verifyDynamicInputs(*this)) || failed(verifyOutputType(*this)))
+    return failure();
   return verifyGemmLikeOp<GemmDispatchOp>(*this);
 }
 
 LogicalResult BrgemmDispatchOp::verify() {
+  if (failed(verifyDynamicInputs(*this)) || failed(verifyOutputType(*this)))
+    return failure();
   return verifyGemmLikeOp<BrgemmDispatchOp>(*this);
 }
 
@@ -369,6 +527,64 @@ LogicalResult BinaryDispatchOp::verify() {
   return verifyDispatchInputs(*this, /*expected=*/5);
 }
 
+LogicalResult EquationDispatchOp::verify() {
+  // 'inputs' = [m, n, ldo]
+  if (failed(verifyDispatchInputs(*this, /*expected=*/3)))
+    return failure();
+  if (getInputs()[2] < getInputs()[1])
+    return emitOpError() << "expect ldo to be >= of dimension n";
+
+  ArrayRef<int64_t> args = getArgs();
+  if (args.empty() || args.size() % 3 != 0)
+    return emitOpError() << "expect an [m, n, ld] triple per argument";
+  for (int64_t idx = 0, e = getNumArgs(); idx < e; idx++) {
+    if (args[idx * 3 + 2] < args[idx * 3 + 1]) {
+      return emitOpError() << "expect ld to be >= of dimension n for argument "
+                           << idx;
+    }
+  }
+
+  ArrayRef<int64_t> nodes = getNodes();
+  if (nodes.empty() || nodes.size() % 3 != 0)
+    return emitOpError() << "expect a [kind, op, flags] triple per node";
+
+  // The nodes are the tree in pre-order, track the number of operands still
+  // expected to complete it.
+  int64_t pending = 1;
+  for (int64_t idx = 0, e = getNumNodes(); idx < e; idx++) {
+    if (pending == 0)
+      return emitOpError() << "expect a single tree but got extra node " << idx;
+    pending--;
+    auto kind = symbolizeEquationNodeKind(nodes[idx * 3]);
+    if (!kind)
+      return emitOpError() << "invalid kind for node " << idx;
+    int64_t op = nodes[idx * 3 + 1];
+    switch (*kind) {
+    case EquationNodeKind::ARG:
+      if (op >= getNumArgs()) {
+        return emitOpError() << "expect argument index of node " << idx
+                             << " to be < " << getNumArgs();
+      }
+      break;
+    case EquationNodeKind::UNARY:
+      if (!symbolizeUnaryKind(op))
+        return emitOpError() << "invalid unary kind for node " << idx;
+      pending += 1;
+      break;
+    case EquationNodeKind::BINARY:
+      if (!symbolizeBinaryKind(op))
+        return emitOpError() << "invalid binary kind for node " << idx;
+      pending += 2;
+      break;
+    }
+  }
+  if (pending != 0) {
+    return emitOpError() << "expect " << pending
+                         << " more node(s) to complete the tree";
+  }
+  return success();
+}
+
 LogicalResult FusedBrgemmDispatchOp::verify() {
   if (failed(verifyUniquenessAndConsistency<BinaryFlags>(
           getBinaryFlags(), getOperation(), BINARY_FLAGS_NAME)) ||
@@ -402,6 +618,44 @@ LogicalResult FusedBrgemmDispatchOp::verify() {
   return success();
 }
 
+// Returns true if `type` matches `dataType`. Integer gemms take i8 inputs and
+// accumulate into an i32 output, fp8 gemms accumulate into an f32 output, bf16
+// and f16 gemms store either the input type or their f32 accumulator (see
+// `output_type`), any other operation uses a single type.
+static bool isCompatibleType(xsmm::DataType dataType, Type type,
+                             bool isGemmOutput) {
+  switch (dataType) {
+  case xsmm::DataType::F32:
+    return type.isF32();
+  case xsmm::DataType::BF16:
+    return type.isBF16() || (isGemmOutput && type.isF32());
+  case xsmm::DataType::F16:
+    return type.isF16() || (isGemmOutput && type.isF32());
+  case xsmm::DataType::BF8:
+    return isGemmOutput ? type.isF32() : isa<Float8E5M2Type>(type);
+  case xsmm::DataType::HF8:
+    return isGemmOutput ? type.isF32() : isa<Float8E4M3FNType>(type);
+  case xsmm::DataType::I8:
+    return type.isInteger(isGemmOutput ? 32 : 8);
+  }
+  llvm_unreachable("unexpected data type");
+}
+
+static StringRef getExpectedTypeName(xsmm::DataType dataType,
+                                     bool isGemmOutput) {
+  if (isGemmOutput) {
+    if (dataType == xsmm::DataType::I8)
+      return "i32";
+    if (dataType == xsmm::DataType::BF8 || dataType == xsmm::DataType::HF8)
+      return "f32";
+    if (dataType == xsmm::DataType::BF16)
+      return "bf16 or f32";
+    if (dataType == xsmm::DataType::F16)
+      return "f16 or f32";
+  }
+  return xsmm::stringifyDataType(dataType);
+}
+
 template <typename OpTy>
 static LogicalResult verifyXsmmCommon(OpTy invokeOp,
                                       const size_t expectedInputs) {
@@ -419,31 +673,53 @@ static LogicalResult verifyXsmmCommon(OpTy invokeOp,
            << " for operand 0 (dispatch)";
   }
 
-  auto isCompatible = [](xsmm::DataType dataType, Type type) {
-    if (dataType == xsmm::DataType::F32)
-      return type.isF32();
-    return type.isBF16();
-  };
-
   // Skip dispatch at index 0. In case of a brgemm operation
-  // skip the last operand (batch).
-  size_t upTo = inputs.size();
-  if (llvm::is_one_of<OpTy, xsmm::BrgemmOp, xsmm::FusedBrgemmOp>::value)
-    upTo--;
-
-  for (size_t idx = 1; idx < upTo; idx++) {
+  // skip the batch operand. It is the last operand unless the brgemm
+  // carries prefetch operands.
+  size_t batchIdx = inputs.size();
+  if (std::is_same<OpTy, xsmm::BrgemmOp>::value)
+    batchIdx = 4;
+  if (std::is_same<OpTy, xsmm::FusedBrgemmOp>::value)
+    batchIdx = inputs.size() - 1;
+
+  // The output of gemm-like operations is at index 3.
+  constexpr bool isGemmLike =
+      llvm::is_one_of<OpTy, xsmm::GemmOp, xsmm::BrgemmOp,
+                      xsmm::FusedBrgemmOp>::value;
+
+  for (size_t idx = 1; idx < inputs.size(); idx++) {
+    if (idx == batchIdx)
+      continue;
     Type elementType = getElementTypeOrSelf(inputs[idx].getType());
-    if (!isCompatible(invokeOp.getDataType(), elementType)) {
+    bool isGemmOutput = isGemmLike && idx == 3;
+    if (!isCompatibleType(invokeOp.getDataType(), elementType, isGemmOutput)) {
       return invokeOp.emitOpError()
-             << "expect " << xsmm::stringifyDataType(invokeOp.getDataType())
+             << "expect "
+             << getExpectedTypeName(invokeOp.getDataType(), isGemmOutput)
              << " but got: " << elementType << " for operand at index: " << idx;
     }
   }
   return success();
 }
 
+// The prefetch operands are the next A and B blocks, they must match the
+// current ones.
+template <typename OpTy> static LogicalResult verifyPrefetchOperands(OpTy op) {
+  static_assert(llvm::is_one_of<OpTy, xsmm::GemmOp, xsmm::BrgemmOp>::value);
+
+  if (!op.hasPrefetch())
+    return success();
+  if (op.getPrefetchA().getType() != op.getOperandA().getType())
+    return op.emitOpError() << "expect prefetch operand A to match operand A";
+  if (op.getPrefetchB().getType() != op.getOperandB().getType())
+    return op.emitOpError() << "expect prefetch operand B to match operand B";
+  return success();
+}
+
 LogicalResult GemmOp::verify() {
-  if (failed(verifyXsmmCommon(*this, /*expectedInputs=*/4)))
+  size_t expectedInputs = hasPrefetch() ? 6 : 4;
+  if (failed(verifyXsmmCommon(*this, expectedInputs)) ||
+      failed(verifyPrefetchOperands(*this)))
     return failure();
 
   // Verify the rank of the shaped operands.
@@ -508,7 +784,56 @@ static LogicalResult verifyBrgemmLikeOpCommon(OpTy brgemmOp,
 }
 
 LogicalResult BrgemmOp::verify() {
-  return verifyBrgemmLikeOpCommon(*this, /*expectedInputs=*/5);
+  if (failed(verifyBrgemmLikeOpCommon(
+          *this, /*expectedInputs=*/hasPrefetch() ? 7 : 5)))
+    return failure();
+  return verifyPrefetchOperands(*this);
+}
+
+// Verifies the element types of gemm-like ops with named A, B and C operands.
+template <typename OpTy> static LogicalResult verifyNamedGemmOperands(OpTy op) {
+  static_assert(
+      llvm::is_one_of<OpTy, BrgemmIndirectOp, BrgemmGroupedOp>::value);
+
+  SmallVector<Value> memrefOperands = {op.getOperandA(), op.getOperandB(),
+                                       op.getOutput()};
+  for (size_t idx = 0; idx < memrefOperands.size(); idx++) {
+    size_t actualIdx = idx + 1 /*skip dispatch*/;
+    bool isGemmOutput = idx == 2;
+    if (!isCompatibleType(op.getDataType(),
+                          getElementTypeOrSelf(memrefOperands[idx]),
+                          isGemmOutput)) {
+      return op.emitOpError()
+             << "expect " << getExpectedTypeName(op.getDataType(), isGemmOutput)
+             << " but got: " << getElementTypeOrSelf(memrefOperands[idx])
+             << " for operand at index: " << actualIdx;
+    }
+  }
+  return success();
+}
+
+LogicalResult BrgemmIndirectOp::verify() {
+  if (failed(verifyNamedGemmOperands(*this)))
+    return failure();
+
+  auto listA = cast<MemRefType>(getListA().getType());
+  auto listB = cast<MemRefType>(getListB().getType());
+  if (listA.getShape() != listB.getShape())
+    return emitOpError() << "expect lists of A and B to have the same size";
+  return success();
+}
+
+LogicalResult BrgemmGroupedOp::verify() {
+  if (failed(verifyNamedGemmOperands(*this)))
+    return failure();
+
+  auto descriptors = cast<MemRefType>(getDescriptors().getType());
+  if (descriptors.getShape()[1] != 3) {
+    return emitOpError()
+           << "expect 3 offsets (A, B and C) per descriptor but got "
+           << descriptors.getShape()[1];
+  }
+  return success();
 }
 
 LogicalResult FusedBrgemmOp::verify() {
@@ -522,3 +847,27 @@ LogicalResult UnaryOp::verify() {
 LogicalResult BinaryOp::verify() {
   return verifyXsmmCommon(*this, /*expectedInputs=*/4);
 }
+
+LogicalResult EquationOp::verify() {
+  // The dispatch, at least one argument and the output.
+  size_t numInputs = getInputs().size();
+  if (numInputs < 3) {
+    return emitOpError() << "expect at least 3 inputs but got " << numInputs;
+  }
+  if (failed(verifyXsmmCommon(*this, numInputs)))
+    return failure();
+
+  for (size_t idx = 1; idx < numInputs; idx++) {
+    if (!isa<MemRefType>(getInputs()[idx].getType()))
+      return emitOpError() << "expect a memref for operand at index: " << idx;
+  }
+
+  if (auto dispatch = getDispatch().getDefiningOp<EquationDispatchOp>()) {
+    int64_t numArgs = getArgs().size();
+    if (numArgs != dispatch.getNumArgs()) {
+      return emitOpError() << "expect " << dispatch.getNumArgs()
+                           << " arguments as dispatched but got " << numArgs;
+    }
+  }
+  return success();
+}
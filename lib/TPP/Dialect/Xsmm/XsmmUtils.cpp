@@ -66,6 +66,14 @@ DataTypeAttr getDataType(RewriterBase &rewriter, Type type) {
   auto elemType = getElementTypeOrSelf(type);
   if (elemType.isBF16())
     return xsmm::DataTypeAttr::get(rewriter.getContext(), xsmm::DataType::BF16);
+  if (elemType.isF16())
+    return xsmm::DataTypeAttr::get(rewriter.getContext(), xsmm::DataType::F16);
+  if (isa<Float8E5M2Type>(elemType))
+    return xsmm::DataTypeAttr::get(rewriter.getContext(), xsmm::DataType::BF8);
+  if (isa<Float8E4M3FNType>(elemType))
+    return xsmm::DataTypeAttr::get(rewriter.getContext(), xsmm::DataType::HF8);
+  if (elemType.isInteger(8))
+    return xsmm::DataTypeAttr::get(rewriter.getContext(), xsmm::DataType::I8);
   return xsmm::DataTypeAttr::get(rewriter.getContext(), xsmm::DataType::F32);
 }
 
@@ -531,8 +539,10 @@ FailureOr<FusedMatch> getFusedBrgemmSequenceFromProducer(Operation *op) {
       // We have already made sure it didn't come before this
       // unary in the binary check above
 
-      // For now we only support RELU as unary
-      if (unOp.getCallee() != UnaryKind::RELU)
+      // Only activations have a fused epilogue
+      UnaryKind kind = unOp.getCallee();
+      if (kind != UnaryKind::RELU && kind != UnaryKind::TANH &&
+          kind != UnaryKind::SIGMOID && kind != UnaryKind::GELU)
         return failure();
 
       // Make sure the op is new or the same as before
@@ -40,6 +40,18 @@ static FailureOr<DispatchTy> verifyDispatch(InvokeTy invokeOp) {
   return dispatchOp;
 }
 
+static bool hasPrefetchOperands(xsmm::GemmOp gemmOp) {
+  return gemmOp.hasPrefetch();
+}
+
+static bool hasPrefetchOperands(xsmm::BrgemmOp brgemmOp) {
+  return brgemmOp.hasPrefetch();
+}
+
+static bool hasPrefetchOperands(xsmm::FusedBrgemmOp fusedBrgemmOp) {
+  return false;
+}
+
 template <typename DispatchTy, typename InvokeTy>
 static LogicalResult verifyGemmDispatchAndInvokeLikeOp(InvokeTy gemmOp) {
   static_assert(llvm::is_one_of<InvokeTy, xsmm::FusedBrgemmOp, xsmm::BrgemmOp,
@@ -72,8 +84,13 @@ static LogicalResult verifyGemmDispatchAndInvokeLikeOp(InvokeTy gemmOp) {
 
   // VNNI flags must be consistent with the memref shapes.
   ArrayAttr flags = dispatchOp->getFlags();
+  bool hasPrefetchFlags = false;
   for (auto flag : flags) {
     int64_t gemmFlag = cast<IntegerAttr>(flag).getInt();
+    if (gemmFlag == static_cast<int64_t>(xsmm::GemmFlags::PREFETCH_A) ||
+        gemmFlag == static_cast<int64_t>(xsmm::GemmFlags::PREFETCH_B)) {
+      hasPrefetchFlags = true;
+    }
     if (gemmFlag == static_cast<int64_t>(xsmm::GemmFlags::VNNI_A) &&
         !vnni::utils::isInVnniLayout(expectedVnniRankIns, operandA)) {
       return gemmOp.emitOpError(
@@ -90,16 +107,104 @@ static LogicalResult verifyGemmDispatchAndInvokeLikeOp(InvokeTy gemmOp) {
           "expect VNNI layout for operand C or invalid VNNI_C flags");
     }
   }
+
+  // Prefetch flags and prefetch operands go together.
+  if (hasPrefetchFlags != hasPrefetchOperands(gemmOp)) {
+    return gemmOp.emitOpError(
+        "expect prefetch operands if and only if prefetch flags are set");
+  }
+  return success();
+}
+
+static LogicalResult
+verifyBrgemmIndirectDispatchAndInvoke(xsmm::BrgemmIndirectOp brgemmOp) {
+  auto dispatchOp =
+      verifyDispatch<xsmm::BrgemmDispatchOp, xsmm::BrgemmIndirectOp>(brgemmOp);
+  if (failed(dispatchOp))
+    return failure();
+
+  auto expectedFlag = brgemmOp.getKind() == xsmm::BatchReduceKind::ADDRESS
+                          ? xsmm::GemmFlags::BATCH_REDUCE_ADDRESS
+                          : xsmm::GemmFlags::BATCH_REDUCE_OFFSET;
+  if (!llvm::is_contained(
+          dispatchOp->getFlags(),
+          xsmm::GemmFlagsAttr::get(brgemmOp.getContext(), expectedFlag))) {
+    return brgemmOp.emitOpError("inconsistent batch-reduce kind");
+  }
+  return success();
+}
+
+static LogicalResult
+verifyBrgemmGroupedDispatchAndInvoke(xsmm::BrgemmGroupedOp brgemmOp) {
+  auto dispatchOp =
+      verifyDispatch<xsmm::BrgemmDispatchOp, xsmm::BrgemmGroupedOp>(brgemmOp);
+  if (failed(dispatchOp))
+    return failure();
+
+  // The runtime calls the kernel as a plain strided brgemm.
+  if (llvm::any_of(dispatchOp->getFlags(), [](Attribute flag) {
+        auto gemmFlag = cast<xsmm::GemmFlagsAttr>(flag).getValue();
+        return gemmFlag == xsmm::GemmFlags::PREFETCH_A ||
+               gemmFlag == xsmm::GemmFlags::PREFETCH_B ||
+               gemmFlag == xsmm::GemmFlags::BATCH_REDUCE_ADDRESS ||
+               gemmFlag == xsmm::GemmFlags::BATCH_REDUCE_OFFSET;
+      })) {
+    return brgemmOp.emitOpError("expect a strided brgemm dispatch");
+  }
+  return success();
+}
+
+// The arguments must hold as many elements as their dispatched [m, n] shape
+// and the output must be the [m, n] result.
+static LogicalResult
+verifyEquationDispatchAndInvoke(xsmm::EquationOp equationOp) {
+  auto dispatchOp =
+      verifyDispatch<xsmm::EquationDispatchOp, xsmm::EquationOp>(equationOp);
+  if (failed(dispatchOp))
+    return failure();
+
+  ArrayRef<int64_t> args = dispatchOp->getArgs();
+  for (auto [idx, arg] : llvm::enumerate(equationOp.getArgs())) {
+    auto argType = cast<MemRefType>(arg.getType());
+    if (argType.getNumElements() != args[idx * 3] * args[idx * 3 + 1]) {
+      return equationOp.emitOpError()
+             << "expect argument " << idx << " to match its dispatched shape";
+    }
+  }
+
+  ArrayRef<int64_t> inputs = dispatchOp->getInputs();
+  auto outputType = cast<MemRefType>(equationOp.getOutput().getType());
+  if (outputType.getShape() != ArrayRef<int64_t>{inputs[0], inputs[1]})
+    return equationOp.emitOpError("expect the output to match the dispatch");
   return success();
 }
 
+static bool isReduceFlag(Attribute flag) {
+  auto unaryFlag = cast<xsmm::UnaryFlagsAttr>(flag).getValue();
+  return unaryFlag == xsmm::UnaryFlags::REDUCE_ROWS ||
+         unaryFlag == xsmm::UnaryFlags::REDUCE_COLS;
+}
+
 static LogicalResult verifyFlags(xsmm::UnaryOp invokeUnaryOp,
                                  xsmm::UnaryDispatchOp dispatchUnaryOp) {
+  auto flags = dispatchUnaryOp.getFlags();
+  // Reductions do not broadcast, the output drops the reduced dimension.
+  if (llvm::any_of(flags, isReduceFlag)) {
+    auto inputType =
+        dyn_cast<ShapedType>(invokeUnaryOp.getInputs()[1].getType());
+    auto outputType =
+        cast<ShapedType>(invokeUnaryOp.getInputs()[2].getType());
+    if (!inputType || inputType.getRank() != 2 || outputType.getRank() != 1) {
+      return invokeUnaryOp.emitOpError(
+          "expect a 2d input and a 1d output for a reduction");
+    }
+    return success();
+  }
+
   auto expectedFlag =
       xsmm::utils::getUnaryFlags(invokeUnaryOp.getInputs()[1].getType(),
                                  invokeUnaryOp.getInputs()[2].getType());
   assert(succeeded(expectedFlag));
-  auto flags = dispatchUnaryOp.getFlags();
   for (auto flag : flags) {
     switch (cast<xsmm::UnaryFlagsAttr>(flag).getValue()) {
     case xsmm::UnaryFlags::NONE:
@@ -123,6 +228,9 @@ static LogicalResult verifyFlags(xsmm::UnaryOp invokeUnaryOp,
             "invalid 'bcast_scalar' flag for input");
       }
       return success();
+    case xsmm::UnaryFlags::REDUCE_COLS:
+    case xsmm::UnaryFlags::REDUCE_ROWS:
+      llvm_unreachable("reductions are verified above");
     }
   }
   return success();
@@ -199,6 +307,17 @@ static bool hasBCastSemantics(xsmm::BinaryOp invokeOp) {
          callee == xsmm::BinaryKind::MUL || callee == xsmm::BinaryKind::DIV;
 }
 
+// fp8 types are a storage format only, they can be moved around but any
+// arithmetic has to happen on a wider type.
+static bool isDataMovement(xsmm::UnaryOp invokeOp) {
+  auto callee = invokeOp.getCallee();
+  return callee == xsmm::UnaryKind::IDENTITY ||
+         callee == xsmm::UnaryKind::ZERO ||
+         callee == xsmm::UnaryKind::TRANSPOSE;
+}
+
+static bool isDataMovement(xsmm::BinaryOp invokeOp) { return false; }
+
 template <typename DispatchTy, typename InvokeTy>
 static LogicalResult verifyUnaryOrBinaryCommon(InvokeTy invokeOp) {
   static_assert(
@@ -213,6 +332,12 @@ static LogicalResult verifyUnaryOrBinaryCommon(InvokeTy invokeOp) {
   if (invokeOp.getCallee() != dispatchOp->getKind())
     return invokeOp.emitOpError("inconsistent callee kind");
 
+  xsmm::DataType dataType = invokeOp.getDataType();
+  if ((dataType == xsmm::DataType::BF8 || dataType == xsmm::DataType::HF8) &&
+      !isDataMovement(invokeOp)) {
+    return invokeOp.emitOpError("expect a data movement kernel for fp8 types");
+  }
+
   if (hasBCastSemantics(invokeOp) &&
       failed(verifyFlags(invokeOp, *dispatchOp))) {
     return failure();
@@ -243,6 +368,22 @@ struct VerifyXsmmCalls
     if (walkResult.wasInterrupted())
       return signalPassFailure();
 
+    walkResult = getOperation()->walk([](xsmm::BrgemmIndirectOp brgemmOp) {
+      if (failed(verifyBrgemmIndirectDispatchAndInvoke(brgemmOp)))
+        return WalkResult::interrupt();
+      return WalkResult::advance();
+    });
+    if (walkResult.wasInterrupted())
+      return signalPassFailure();
+
+    walkResult = getOperation()->walk([](xsmm::BrgemmGroupedOp brgemmOp) {
+      if (failed(verifyBrgemmGroupedDispatchAndInvoke(brgemmOp)))
+        return WalkResult::interrupt();
+      return WalkResult::advance();
+    });
+    if (walkResult.wasInterrupted())
+      return signalPassFailure();
+
     walkResult = getOperation()->walk([&](xsmm::FusedBrgemmOp brgemmOp) {
       if (failed(verifyGemmDispatchAndInvokeLikeOp<
                  xsmm::FusedBrgemmDispatchOp, xsmm::FusedBrgemmOp>(brgemmOp))) {
@@ -274,6 +415,14 @@ struct VerifyXsmmCalls
     });
     if (walkResult.wasInterrupted())
       return signalPassFailure();
+
+    walkResult = getOperation()->walk([](xsmm::EquationOp equationOp) {
+      if (failed(verifyEquationDispatchAndInvoke(equationOp)))
+        return WalkResult::interrupt();
+      return WalkResult::advance();
+    });
+    if (walkResult.wasInterrupted())
+      return signalPassFailure();
   }
 };
 
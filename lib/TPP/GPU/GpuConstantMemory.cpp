@@ -0,0 +1,89 @@
+//===- GpuConstantMemory.cpp -------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the placement of the constant globals of the kernel
+// modules in the CUDA constant memory.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+
+#include "mlir/Dialect/GPU/IR/GPUDialect.h"
+#include "mlir/Dialect/LLVMIR/NVVMDialect.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/IR/PatternMatch.h"
+
+using namespace mlir;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_GPUCONSTANTMEMORY
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+namespace {
+
+// Returns the size in bytes of the global, or std::nullopt if it cannot be
+// placed in the constant memory.
+static std::optional<int64_t> getConstantBytes(memref::GlobalOp globalOp) {
+  MemRefType type = globalOp.getType();
+  if (!globalOp.getConstant() || !globalOp.getInitialValue() ||
+      type.getMemorySpace() || !type.hasStaticShape() ||
+      !type.getElementType().isIntOrFloat())
+    return std::nullopt;
+  return type.getNumElements() *
+         llvm::divideCeil(type.getElementTypeBitWidth(), 8);
+}
+
+struct GpuConstantMemory
+    : public tpp::impl::GpuConstantMemoryBase<GpuConstantMemory> {
+  using GpuConstantMemoryBase::GpuConstantMemoryBase;
+
+  void runOnOperation() override {
+    gpu::GPUModuleOp gpuModule = getOperation();
+    MLIRContext *ctx = &getContext();
+    auto constantSpace = IntegerAttr::get(
+        IntegerType::get(ctx, 64), NVVM::NVVMMemorySpace::kConstantMemorySpace);
+
+    // The globals are placed in order until the constant memory is full.
+    llvm::StringMap<MemRefType> placed;
+    int64_t usedBytes = 0;
+    for (auto globalOp : gpuModule.getOps<memref::GlobalOp>()) {
+      std::optional<int64_t> bytes = getConstantBytes(globalOp);
+      if (!bytes || usedBytes + *bytes > maxBytes)
+        continue;
+      usedBytes += *bytes;
+      MemRefType type = globalOp.getType();
+      placed[globalOp.getSymName()] = type;
+      globalOp.setTypeAttr(TypeAttr::get(
+          MemRefType::Builder(type).setMemorySpace(constantSpace)));
+    }
+    if (placed.empty())
+      return;
+
+    IRRewriter rewriter(ctx);
+    gpuModule.walk([&](memref::GetGlobalOp getGlobalOp) {
+      auto it = placed.find(getGlobalOp.getName());
+      if (it == placed.end())
+        return;
+      MemRefType type = it->second;
+      rewriter.setInsertionPointAfter(getGlobalOp);
+      rewriter.modifyOpInPlace(getGlobalOp, [&]() {
+        getGlobalOp.getResult().setType(
+            MemRefType::Builder(type).setMemorySpace(constantSpace));
+      });
+      auto castOp = rewriter.create<memref::MemorySpaceCastOp>(
+          getGlobalOp.getLoc(), type, getGlobalOp.getResult());
+      rewriter.replaceAllUsesExcept(getGlobalOp.getResult(), castOp,
+                                    castOp);
+    });
+  }
+};
+
+} // namespace
@@ -67,12 +67,29 @@ private:
     if (isIntel) {
       pm.addNestedPass<func::FuncOp>(createLinalgToXeGPU(LinalgToXeGPUOptions{
           kTile, stages, SmallVector<int64_t>{*dpasTile}}));
+    } else if (mma) {
+      pm.addNestedPass<func::FuncOp>(
+          createLinalgToGpuMma(LinalgToGpuMmaOptions{/*warpSize=*/32, stages}));
     }
     pm.addNestedPass<func::FuncOp>(createConvertLinalgToLoopsPass());
     pm.addPass(createCleanup());
 
+    // Fuse the layers into persistent kernels. The XeGPU ops only address
+    // global memory, the activations of the Intel kernels stay there.
+    if (megakernel) {
+      GpuFuseLaunchesOptions fuseOptions;
+      fuseOptions.maxBlocks = megakernelBlocks;
+      fuseOptions.promoteToShared = !isIntel;
+      pm.addNestedPass<func::FuncOp>(createGpuFuseLaunches(fuseOptions));
+    }
+
     // Create GPU kernels.
-    pm.addNestedPass<func::FuncOp>(createGpuInlineConstants());
+    // The SPIR-V kernels cannot hold globals, the constant buffers stay
+    // kernel arguments.
+    GpuInlineConstantsOptions inlineOptions;
+    if (isIntel)
+      inlineOptions.maxGlobalBytes = 0;
+    pm.addNestedPass<func::FuncOp>(createGpuInlineConstants(inlineOptions));
     pm.addPass(createGpuKernelOutliningPass());
 
     // Generic cleanup.
@@ -13,6 +13,7 @@
 #include "mlir/Dialect/GPU/IR/GPUDialect.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/IR/Dialect.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 #include "mlir/Transforms/Passes.h"
@@ -163,9 +164,61 @@ static FailureOr<Value> transferMemref(RewriterBase &rewriter,
   return gpuBuffer;
 }
 
-// Move host data used by GPU kernel calls to the device.
+// Returns true if the buffer `value`, or a view of it, leaves its block, e.g.
+// is returned, its lifetime is not bound to the block.
+static bool escapesBlock(Value value) {
+  for (Operation *user : value.getUsers()) {
+    if (user->hasTrait<OpTrait::IsTerminator>())
+      return true;
+    auto viewOp = dyn_cast<ViewLikeOpInterface>(user);
+    if (viewOp && viewOp.getViewSource() == value &&
+        escapesBlock(viewOp->getResult(0)))
+      return true;
+  }
+  return false;
+}
+
+// Replaces the host allocation `allocOp` with a buffer shared by the host and
+// the device, which the kernels access in place without transfers. Its
+// deallocations are replaced too, it is freed at the end of its block if it
+// had none. Returns failure if the buffer outlives its block.
+static LogicalResult shareAllocation(RewriterBase &rewriter,
+                                     memref::AllocOp allocOp) {
+  if (escapesBlock(allocOp.getMemref()))
+    return failure();
+
+  OpBuilder::InsertionGuard guard(rewriter);
+  rewriter.setInsertionPoint(allocOp);
+  auto sharedAlloc = rewriter.create<gpu::AllocOp>(
+      allocOp.getLoc(), TypeRange{allocOp.getType()}, ValueRange{},
+      allocOp.getDynamicSizes(), allocOp.getSymbolOperands(),
+      /*hostShared=*/true);
+  Value sharedBuffer = sharedAlloc.getMemref();
+
+  bool hasDealloc = false;
+  for (Operation *user : llvm::make_early_inc_range(allocOp->getUsers())) {
+    if (auto deallocOp = dyn_cast<memref::DeallocOp>(user)) {
+      rewriter.setInsertionPoint(deallocOp);
+      rewriter.replaceOpWithNewOp<gpu::DeallocOp>(deallocOp, std::nullopt,
+                                                  sharedBuffer);
+      hasDealloc = true;
+    }
+  }
+  if (!hasDealloc) {
+    rewriter.setInsertionPoint(allocOp->getBlock()->getTerminator());
+    rewriter.create<gpu::DeallocOp>(allocOp.getLoc(), std::nullopt,
+                                    sharedBuffer);
+  }
+  rewriter.replaceOp(allocOp, sharedBuffer);
+  return success();
+}
+
+// Move host data used by GPU kernel calls to the device. With `hostShared`,
+// the device shares the host memory, e.g. an integrated GPU: the host
+// allocations are shared with the device instead of copied to it.
 struct TransferDataToGpu : public OpRewritePattern<gpu::LaunchFuncOp> {
-  using OpRewritePattern<gpu::LaunchFuncOp>::OpRewritePattern;
+  TransferDataToGpu(MLIRContext *ctx, bool hostShared)
+      : OpRewritePattern<gpu::LaunchFuncOp>(ctx), hostShared(hostShared) {}
 
   LogicalResult matchAndRewrite(gpu::LaunchFuncOp launchFuncOp,
                                 PatternRewriter &rewriter) const override {
@@ -188,7 +241,14 @@ struct TransferDataToGpu : public OpRewritePattern<gpu::LaunchFuncOp> {
 
       FailureOr<Value> newOperand = failure();
 
-      if (auto allocOp = dyn_cast<memref::AllocOp>(*src)) {
+      auto allocOp = dyn_cast<memref::AllocOp>(*src);
+      if (allocOp && hostShared &&
+          succeeded(shareAllocation(rewriter, allocOp))) {
+        // The operand is now a view of the shared buffer.
+        newOperands.push_back(operand);
+        continue;
+      }
+      if (allocOp) {
         // Copy data back to the host as it might have been updated on
         // the device.
         newOperand =
@@ -226,19 +286,270 @@ struct TransferDataToGpu : public OpRewritePattern<gpu::LaunchFuncOp> {
 
     return success();
   }
+
+private:
+  bool hostShared;
+};
+
+// Returns the buffer `value` is a view of.
+static Value getRootBuffer(Value value) {
+  while (auto viewOp = value.getDefiningOp<ViewLikeOpInterface>())
+    value = viewOp.getViewSource();
+  return value;
+}
+
+// Rewrites the allocations, transfers and kernel launches of a block into
+// async ops chained by tokens, so that the host only waits for the device
+// when it uses the data again.
+//
+// Each host-to-device copy starts its own stream, after the last ops on its
+// buffers, so that the inputs of a kernel are copied while the previous
+// kernels run. A kernel runs after the copies and kernels of its operands,
+// and the copies back to the host follow it on its stream. A host op using a
+// buffer with pending transfers waits for their stream, the remaining
+// streams are waited for at the end of the block. The lowering to the GPU
+// runtime takes a single dependency per async op, several are first joined
+// by a `gpu.wait async`.
+class AsyncTransfers {
+public:
+  AsyncTransfers(RewriterBase &rewriter)
+      : rewriter(rewriter),
+        tokenType(rewriter.getType<gpu::AsyncTokenType>()) {}
+
+  void run(Block &block) {
+    for (Operation &op : llvm::make_early_inc_range(block)) {
+      rewriter.setInsertionPoint(&op);
+      if (auto allocOp = dyn_cast<gpu::AllocOp>(op)) {
+        if (!allocOp.getAsyncToken() && !allocOp.getHostShared())
+          makeAsync(allocOp);
+        continue;
+      }
+      if (auto memcpyOp = dyn_cast<gpu::MemcpyOp>(op)) {
+        if (!memcpyOp.getAsyncToken())
+          makeAsync(memcpyOp);
+        continue;
+      }
+      if (auto launchOp = dyn_cast<gpu::LaunchFuncOp>(op)) {
+        if (!launchOp.getAsyncToken())
+          makeAsync(launchOp);
+        continue;
+      }
+      if (auto deallocOp = dyn_cast<gpu::DeallocOp>(op)) {
+        if (!deallocOp.getAsyncToken())
+          makeAsync(deallocOp);
+        continue;
+      }
+      // Nested regions, e.g. loops with their own transfers, and calls run
+      // after all the pending ops.
+      if (op.hasTrait<OpTrait::IsTerminator>() || op.getNumRegions() != 0 ||
+          isa<CallOpInterface>(op)) {
+        waitAll(op.getLoc());
+        continue;
+      }
+      if (isMemoryEffectFree(&op) || isa<ViewLikeOpInterface>(op))
+        continue;
+      for (Value operand : op.getOperands()) {
+        Value root = getRootBuffer(operand);
+        for (auto *tokens : {&hostTokens, &deviceTokens}) {
+          auto it = tokens->find(root);
+          if (it != tokens->end())
+            waitStream(op.getLoc(), it->second);
+        }
+      }
+    }
+  }
+
+private:
+  void makeAsync(gpu::AllocOp allocOp) {
+    Value dep = getDependency(allocOp.getLoc(), allocToken);
+    auto newAlloc = rewriter.create<gpu::AllocOp>(
+        allocOp.getLoc(), TypeRange{allocOp.getType(), tokenType},
+        ValueRange{dep}, allocOp.getDynamicSizes(),
+        allocOp.getSymbolOperands());
+    allocToken = record(newAlloc.getAsyncToken(), dep);
+    deviceTokens[newAlloc.getMemref()] = allocToken;
+    rewriter.replaceAllUsesWith(allocOp.getMemref(), newAlloc.getMemref());
+    rewriter.eraseOp(allocOp);
+  }
+
+  void makeAsync(gpu::MemcpyOp memcpyOp) {
+    Value dst = getRootBuffer(memcpyOp.getDst());
+    Value src = getRootBuffer(memcpyOp.getSrc());
+    bool toDevice = dst.getDefiningOp<gpu::AllocOp>() != nullptr;
+    Value device = toDevice ? dst : src;
+    Value host = toDevice ? src : dst;
+    SmallVector<Value> deps = getTokens(device, host);
+    // Copies to the device start their own stream, the copies back follow
+    // the kernel that produced the data.
+    Value dep = getDependency(memcpyOp.getLoc(), deps,
+                              /*freshStream=*/toDevice);
+    auto newCopy = rewriter.create<gpu::MemcpyOp>(
+        memcpyOp.getLoc(), tokenType, ValueRange{dep}, memcpyOp.getDst(),
+        memcpyOp.getSrc());
+    Value token = record(newCopy.getAsyncToken(), dep);
+    deviceTokens[device] = token;
+    hostTokens[host] = token;
+    rewriter.eraseOp(memcpyOp);
+  }
+
+  void makeAsync(gpu::LaunchFuncOp launchOp) {
+    auto kernel = SymbolTable::lookupNearestSymbolFrom<gpu::GPUFuncOp>(
+        launchOp, launchOp.getKernel());
+    if (!kernel)
+      return;
+    // The host waits for the kernels writing the buffers shared with it too.
+    SmallVector<Value> roots;
+    for (Value operand : launchOp.getKernelOperands()) {
+      Value root = getRootBuffer(operand);
+      auto allocOp = root.getDefiningOp<gpu::AllocOp>();
+      if (deviceTokens.count(root) || (allocOp && allocOp.getHostShared()))
+        roots.push_back(root);
+    }
+    SmallVector<Value> deps;
+    for (Value root : roots)
+      deps.push_back(deviceTokens.lookup(root));
+    Value dep = getDependency(launchOp.getLoc(), deps);
+    std::optional<gpu::KernelDim3> clusterSize;
+    if (launchOp.hasClusterSize())
+      clusterSize = launchOp.getClusterSizeOperandValues();
+    auto newLaunch = rewriter.create<gpu::LaunchFuncOp>(
+        launchOp.getLoc(), kernel, launchOp.getGridSizeOperandValues(),
+        launchOp.getBlockSizeOperandValues(),
+        launchOp.getDynamicSharedMemorySize(), launchOp.getKernelOperands(),
+        tokenType, ValueRange{dep}, clusterSize);
+    Value token = record(newLaunch.getAsyncToken(), dep);
+    for (Value root : roots)
+      deviceTokens[root] = token;
+    rewriter.eraseOp(launchOp);
+  }
+
+  void makeAsync(gpu::DeallocOp deallocOp) {
+    Value root = getRootBuffer(deallocOp.getMemref());
+    Value dep = getDependency(deallocOp.getLoc(), getTokens(root, Value()));
+    auto newDealloc = rewriter.create<gpu::DeallocOp>(
+        deallocOp.getLoc(), tokenType, ValueRange{dep},
+        deallocOp.getMemref());
+    record(newDealloc.getAsyncToken(), dep);
+    deviceTokens.erase(root);
+    rewriter.eraseOp(deallocOp);
+  }
+
+  // Returns the pending tokens of the device and host buffers.
+  SmallVector<Value> getTokens(Value device, Value host) {
+    SmallVector<Value> tokens;
+    auto it = deviceTokens.find(device);
+    if (it != deviceTokens.end())
+      tokens.push_back(it->second);
+    it = hostTokens.find(host);
+    if (host && it != hostTokens.end())
+      tokens.push_back(it->second);
+    return tokens;
+  }
+
+  // Returns the dependency of an async op after `deps`: the only one left
+  // once the tokens implied by the others are dropped, or a new stream
+  // waiting for all of them.
+  Value getDependency(Location loc, ArrayRef<Value> deps,
+                      bool freshStream = false) {
+    SmallVector<Value> needed;
+    for (Value dep : deps) {
+      if (!dep || llvm::is_contained(needed, dep))
+        continue;
+      bool implied = llvm::any_of(deps, [&](Value other) {
+        return other && other != dep && implies[other].contains(dep);
+      });
+      if (!implied)
+        needed.push_back(dep);
+    }
+    if (needed.size() == 1 && !freshStream)
+      return needed.front();
+    auto waitOp = rewriter.create<gpu::WaitOp>(loc, tokenType, needed);
+    Value stream = waitOp.getAsyncToken();
+    streams[stream] = stream;
+    lastTokens[stream] = stream;
+    for (Value dep : needed)
+      addImplied(stream, dep);
+    return stream;
+  }
+
+  // Records `token` on the stream of its dependency `dep`.
+  Value record(Value token, Value dep) {
+    Value stream = streams[dep];
+    streams[token] = stream;
+    lastTokens[stream] = token;
+    addImplied(token, dep);
+    return token;
+  }
+
+  void addImplied(Value token, Value dep) {
+    // Copied first, inserting in the map may move the sets.
+    llvm::SmallDenseSet<Value> done = implies[dep];
+    done.insert(dep);
+    implies[token].insert(done.begin(), done.end());
+  }
+
+  // Waits on the host for the stream of `token`, its ops are done.
+  void waitStream(Location loc, Value token) {
+    Value stream = streams[token];
+    rewriter.create<gpu::WaitOp>(loc, Type(), lastTokens[stream]);
+    lastTokens.erase(stream);
+    auto onStream = [&](Value value) { return streams[value] == stream; };
+    for (auto *tokens : {&hostTokens, &deviceTokens}) {
+      SmallVector<Value> done;
+      for (auto &[buffer, pending] : *tokens) {
+        if (onStream(pending))
+          done.push_back(buffer);
+      }
+      for (Value buffer : done)
+        tokens->erase(buffer);
+    }
+    if (allocToken && onStream(allocToken))
+      allocToken = nullptr;
+  }
+
+  void waitAll(Location loc) {
+    SmallVector<Value> pending;
+    for (auto &[stream, token] : lastTokens)
+      pending.push_back(token);
+    if (!pending.empty())
+      rewriter.create<gpu::WaitOp>(loc, Type(), pending);
+    lastTokens.clear();
+    hostTokens.clear();
+    deviceTokens.clear();
+    allocToken = nullptr;
+  }
+
+  RewriterBase &rewriter;
+  Type tokenType;
+  // Last token of the device allocations, which share a stream.
+  Value allocToken;
+  // Pending tokens of the device buffers and of the host buffers.
+  llvm::MapVector<Value, Value> deviceTokens;
+  llvm::MapVector<Value, Value> hostTokens;
+  // Stream of each token, named by the token that started it, and the last
+  // token of each live stream.
+  DenseMap<Value, Value> streams;
+  llvm::MapVector<Value, Value> lastTokens;
+  // Tokens done once a token is.
+  DenseMap<Value, llvm::SmallDenseSet<Value>> implies;
 };
 
 // Transfer data from host to a GPU device.
 class GpuDataTransfer : public tpp::impl::GpuDataTransferBase<GpuDataTransfer> {
 public:
-  GpuDataTransfer() = default;
+  using GpuDataTransferBase::GpuDataTransferBase;
 
   void runOnOperation() override {
     MLIRContext *ctx = getOperation().getContext();
     RewritePatternSet patterns(ctx);
     // TODO: Add cleanup patterns to minimize data copies.
-    patterns.add<TransferDataToGpu>(ctx);
+    patterns.add<TransferDataToGpu>(ctx, hostShared);
     (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
+
+    if (async) {
+      IRRewriter rewriter(ctx);
+      AsyncTransfers(rewriter).run(getOperation().getBody().front());
+    }
   }
 };
 
@@ -0,0 +1,354 @@
+//===- GpuFuseLaunches.cpp ---------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the fusion of chains of GPU launches into a persistent
+// kernel.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/GPU/IR/GPUDialect.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/IR/IRMapping.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "mlir/Interfaces/ViewLikeInterface.h"
+#include "mlir/Pass/Pass.h"
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_GPUFUSELAUNCHES
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+namespace {
+
+// Returns true if the launch can be a layer of a persistent kernel: a plain
+// synchronous launch of a single block body.
+static bool isFusible(gpu::LaunchOp launch) {
+  return !launch.getAsyncToken() && launch.getAsyncDependencies().empty() &&
+         !launch.getDynamicSharedMemorySize() && !launch.hasClusterSize() &&
+         launch.getNumWorkgroupAttributions() == 0 &&
+         launch.getNumPrivateAttributions() == 0 &&
+         launch.getBody().hasOneBlock();
+}
+
+static bool isSameSize(Value lhs, Value rhs) {
+  if (lhs == rhs)
+    return true;
+  std::optional<int64_t> lhsConst = getConstantIntValue(lhs);
+  std::optional<int64_t> rhsConst = getConstantIntValue(rhs);
+  return lhsConst && rhsConst && *lhsConst == *rhsConst;
+}
+
+// The layers share the threads of the persistent kernel, their blocks must
+// have the same size.
+static bool haveSameBlockSize(gpu::LaunchOp lhs, gpu::LaunchOp rhs) {
+  return isSameSize(lhs.getBlockSizeX(), rhs.getBlockSizeX()) &&
+         isSameSize(lhs.getBlockSizeY(), rhs.getBlockSizeY()) &&
+         isSameSize(lhs.getBlockSizeZ(), rhs.getBlockSizeZ());
+}
+
+// Returns true if `op`, between two launches of a chain, can be moved before
+// the chain: the constants, the views and the allocations.
+static bool isHoistable(Operation *op) {
+  if (op->getNumRegions() != 0)
+    return false;
+  return isa<memref::AllocOp>(op) || isMemoryEffectFree(op);
+}
+
+// Returns the chains of consecutive fusible launches of `block` with the same
+// block size, and of at least two launches.
+static SmallVector<SmallVector<gpu::LaunchOp>> collectChains(Block &block) {
+  SmallVector<SmallVector<gpu::LaunchOp>> chains;
+  SmallVector<gpu::LaunchOp> chain;
+  auto flush = [&]() {
+    if (chain.size() > 1)
+      chains.push_back(chain);
+    chain.clear();
+  };
+  for (Operation &op : block) {
+    auto launch = dyn_cast<gpu::LaunchOp>(op);
+    if (launch && isFusible(launch)) {
+      if (!chain.empty() && !haveSameBlockSize(chain.front(), launch))
+        flush();
+      chain.push_back(launch);
+      continue;
+    }
+    if (!chain.empty() && isHoistable(&op))
+      continue;
+    flush();
+  }
+  flush();
+  return chains;
+}
+
+// Makes all the blocks of the kernel wait for each other. The first thread
+// of each block arrives on the grid `counter`, then waits until the
+// `numBlocks` blocks arrived at the barrier `index`, counted from 1.
+static void createGridBarrier(OpBuilder &b, Location loc, gpu::LaunchOp launch,
+                              Value counter, Value numBlocks, int64_t index) {
+  b.create<gpu::BarrierOp>(loc);
+
+  Value zero = b.create<arith::ConstantIndexOp>(loc, 0);
+  gpu::KernelDim3 threadIds = launch.getThreadIds();
+  Value isLeader = b.create<arith::ConstantIntOp>(loc, 1, 1);
+  for (Value threadId : {threadIds.x, threadIds.y, threadIds.z}) {
+    Value isFirst = b.create<arith::CmpIOp>(loc, arith::CmpIPredicate::eq,
+                                            threadId, zero);
+    isLeader = b.create<arith::AndIOp>(loc, isLeader, isFirst);
+  }
+  b.create<scf::IfOp>(loc, isLeader, [&](OpBuilder &b, Location loc) {
+    Value zeroI32 = b.create<arith::ConstantIntOp>(loc, 0, 32);
+    Value oneI32 = b.create<arith::ConstantIntOp>(loc, 1, 32);
+    b.create<memref::AtomicRMWOp>(loc, arith::AtomicRMWKind::addi, oneI32,
+                                  counter, ValueRange{zero});
+    Value target = b.create<arith::MulIOp>(
+        loc,
+        b.create<arith::IndexCastUIOp>(loc, b.getI32Type(), numBlocks),
+        b.create<arith::ConstantIntOp>(loc, index, 32));
+    // The atomic reads keep the loads from being hoisted or cached.
+    b.create<scf::WhileOp>(
+        loc, TypeRange{}, ValueRange{},
+        [&](OpBuilder &b, Location loc, ValueRange) {
+          Value arrived = b.create<memref::AtomicRMWOp>(
+              loc, arith::AtomicRMWKind::addi, zeroI32, counter,
+              ValueRange{zero});
+          Value waiting = b.create<arith::CmpIOp>(
+              loc, arith::CmpIPredicate::ult, arrived, target);
+          b.create<scf::ConditionOp>(loc, waiting, ValueRange{});
+        },
+        [&](OpBuilder &b, Location loc, ValueRange) {
+          b.create<scf::YieldOp>(loc);
+        });
+    b.create<scf::YieldOp>(loc);
+  });
+
+  b.create<gpu::BarrierOp>(loc);
+}
+
+// Gives `value` the memory space `space`, and the views of it.
+static void setMemorySpace(Value value, Attribute space) {
+  auto type = cast<MemRefType>(value.getType());
+  value.setType(MemRefType::Builder(type).setMemorySpace(space));
+  for (Operation *user : value.getUsers()) {
+    auto view = dyn_cast<ViewLikeOpInterface>(user);
+    if (!view || view.getViewSource() != value)
+      continue;
+    for (Value result : user->getResults()) {
+      if (isa<MemRefType>(result.getType()))
+        setMemorySpace(result, space);
+    }
+  }
+}
+
+// Moves the buffers only used by the single block kernel `launch` to its
+// shared memory, up to `maxBytes` bytes.
+static void promoteToSharedMemory(gpu::LaunchOp launch, int64_t maxBytes) {
+  Block *block = launch->getBlock();
+  auto space = gpu::AddressSpaceAttr::get(launch.getContext(),
+                                          gpu::AddressSpace::Workgroup);
+  int64_t sharedBytes = 0;
+  auto allocs = llvm::make_early_inc_range(block->getOps<memref::AllocOp>());
+  for (memref::AllocOp alloc : allocs) {
+    MemRefType type = alloc.getType();
+    if (!type.hasStaticShape() || !type.getLayout().isIdentity() ||
+        type.getMemorySpace() || !type.getElementType().isIntOrFloat())
+      continue;
+    int64_t bytes = type.getNumElements() *
+                    llvm::divideCeil(type.getElementTypeBitWidth(), 8);
+    if (sharedBytes + bytes > maxBytes)
+      continue;
+    SmallPtrSet<Operation *, 2> deallocs;
+    bool isInternal = llvm::all_of(alloc->getUses(), [&](OpOperand &use) {
+      Operation *user = use.getOwner();
+      if (isa<memref::DeallocOp>(user)) {
+        deallocs.insert(user);
+        return true;
+      }
+      return launch->isProperAncestor(user);
+    });
+    if (!isInternal || alloc->use_empty())
+      continue;
+
+    sharedBytes += bytes;
+    BlockArgument buffer = launch.addWorkgroupAttribution(
+        MemRefType::Builder(type).setMemorySpace(space), alloc.getLoc());
+    alloc.getResult().replaceAllUsesExcept(buffer, deallocs);
+    setMemorySpace(buffer, space);
+    for (Operation *dealloc : deallocs)
+      dealloc->erase();
+    alloc->erase();
+  }
+}
+
+// Fuses the launches of `chain` into a persistent kernel: each launch becomes
+// a layer, run by the blocks of the kernel in a grid-stride loop over the
+// blocks of the launch, and the layers are separated by grid barriers.
+static void fuseChain(ArrayRef<gpu::LaunchOp> chain, int64_t maxBlocks,
+                      bool promoteToShared, int64_t maxSharedBytes) {
+  gpu::LaunchOp first = chain.front();
+  Location loc = first.getLoc();
+  for (Operation *op = first->getNextNode(), *next = nullptr;
+       op != chain.back(); op = next) {
+    next = op->getNextNode();
+    if (!isa<gpu::LaunchOp>(op))
+      op->moveBefore(first);
+  }
+
+  OpBuilder b(first);
+  SmallVector<Value> layerBlocks;
+  Value numBlocks;
+  for (gpu::LaunchOp launch : chain) {
+    Value blocks = b.createOrFold<arith::MulIOp>(
+        loc,
+        b.createOrFold<arith::MulIOp>(loc, launch.getGridSizeX(),
+                                      launch.getGridSizeY()),
+        launch.getGridSizeZ());
+    layerBlocks.push_back(blocks);
+    numBlocks = numBlocks ? b.createOrFold<arith::MaxUIOp>(loc, numBlocks,
+                                                           blocks)
+                          : blocks;
+  }
+  numBlocks = b.createOrFold<arith::MinUIOp>(
+      loc, numBlocks, b.create<arith::ConstantIndexOp>(loc, maxBlocks));
+  std::optional<int64_t> constBlocks = getConstantIntValue(numBlocks);
+  bool singleBlock = constBlocks && *constBlocks == 1;
+
+  // A single block only synchronizes its threads.
+  Value counter;
+  if (!singleBlock) {
+    counter = b.create<memref::AllocOp>(
+        loc, MemRefType::get({1}, b.getI32Type()));
+    b.create<memref::StoreOp>(loc, b.create<arith::ConstantIntOp>(loc, 0, 32),
+                              counter,
+                              ValueRange{b.create<arith::ConstantIndexOp>(
+                                  loc, 0)});
+  }
+
+  Value one = b.create<arith::ConstantIndexOp>(loc, 1);
+  auto fused = b.create<gpu::LaunchOp>(
+      loc, numBlocks, one, one, first.getBlockSizeX(), first.getBlockSizeY(),
+      first.getBlockSizeZ());
+  b.setInsertionPointToStart(&fused.getBody().front());
+  Value blockId = fused.getBlockIds().x;
+  for (auto [index, launch] : llvm::enumerate(chain)) {
+    if (index > 0) {
+      if (singleBlock)
+        b.create<gpu::BarrierOp>(loc);
+      else
+        createGridBarrier(b, loc, fused, counter, numBlocks, index);
+    }
+
+    auto loop =
+        b.create<scf::ForOp>(loc, blockId, layerBlocks[index], numBlocks);
+    OpBuilder::InsertionGuard guard(b);
+    b.setInsertionPointToStart(loop.getBody());
+    // The block of the layer, in the grid of its launch.
+    Value linear = loop.getInductionVar();
+    Value x = b.create<arith::RemUIOp>(loc, linear, launch.getGridSizeX());
+    Value rest = b.create<arith::DivUIOp>(loc, linear, launch.getGridSizeX());
+    Value y = b.create<arith::RemUIOp>(loc, rest, launch.getGridSizeY());
+    Value z = b.create<arith::DivUIOp>(loc, rest, launch.getGridSizeY());
+
+    IRMapping mapping;
+    gpu::KernelDim3 blockIds = launch.getBlockIds();
+    gpu::KernelDim3 threadIds = launch.getThreadIds();
+    gpu::KernelDim3 gridSizes = launch.getGridSize();
+    gpu::KernelDim3 blockSizes = launch.getBlockSize();
+    gpu::KernelDim3 fusedThreadIds = fused.getThreadIds();
+    gpu::KernelDim3 fusedBlockSizes = fused.getBlockSize();
+    mapping.map(blockIds.x, x);
+    mapping.map(blockIds.y, y);
+    mapping.map(blockIds.z, z);
+    mapping.map(threadIds.x, fusedThreadIds.x);
+    mapping.map(threadIds.y, fusedThreadIds.y);
+    mapping.map(threadIds.z, fusedThreadIds.z);
+    mapping.map(gridSizes.x, launch.getGridSizeX());
+    mapping.map(gridSizes.y, launch.getGridSizeY());
+    mapping.map(gridSizes.z, launch.getGridSizeZ());
+    mapping.map(blockSizes.x, fusedBlockSizes.x);
+    mapping.map(blockSizes.y, fusedBlockSizes.y);
+    mapping.map(blockSizes.z, fusedBlockSizes.z);
+    for (Operation &op : launch.getBody().front().without_terminator())
+      b.clone(op, mapping);
+
+    // The block and grid queries of the layer refer to its own grid.
+    loop.getBody()->walk([&](Operation *op) {
+      Value replacement;
+      if (auto blockIdOp = dyn_cast<gpu::BlockIdOp>(op)) {
+        switch (blockIdOp.getDimension()) {
+        case gpu::Dimension::x:
+          replacement = x;
+          break;
+        case gpu::Dimension::y:
+          replacement = y;
+          break;
+        case gpu::Dimension::z:
+          replacement = z;
+          break;
+        }
+      } else if (auto gridDimOp = dyn_cast<gpu::GridDimOp>(op)) {
+        switch (gridDimOp.getDimension()) {
+        case gpu::Dimension::x:
+          replacement = launch.getGridSizeX();
+          break;
+        case gpu::Dimension::y:
+          replacement = launch.getGridSizeY();
+          break;
+        case gpu::Dimension::z:
+          replacement = launch.getGridSizeZ();
+          break;
+        }
+      }
+      if (replacement) {
+        op->getResult(0).replaceAllUsesWith(replacement);
+        op->erase();
+      }
+    });
+  }
+  b.create<gpu::TerminatorOp>(loc);
+
+  if (counter) {
+    b.setInsertionPointAfter(fused);
+    b.create<memref::DeallocOp>(loc, counter);
+  }
+  for (gpu::LaunchOp launch : chain)
+    launch->erase();
+
+  if (singleBlock && promoteToShared)
+    promoteToSharedMemory(fused, maxSharedBytes);
+}
+
+struct GpuFuseLaunches
+    : public tpp::impl::GpuFuseLaunchesBase<GpuFuseLaunches> {
+  using GpuFuseLaunchesBase::GpuFuseLaunchesBase;
+
+  void runOnOperation() override {
+    if (maxBlocks < 1) {
+      getOperation().emitError("gpu-fuse-launches needs max-blocks >= 1");
+      return signalPassFailure();
+    }
+    SmallVector<SmallVector<gpu::LaunchOp>> chains;
+    getOperation().walk([&](Block *block) {
+      chains.append(collectChains(*block));
+    });
+    for (ArrayRef<gpu::LaunchOp> chain : chains)
+      fuseChain(chain, maxBlocks, promoteToShared, maxSharedBytes);
+  }
+};
+
+} // namespace
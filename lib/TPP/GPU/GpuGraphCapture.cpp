@@ -0,0 +1,259 @@
+//===- GpuGraphCapture.cpp ---------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the replay of the kernel launch sequences of the host
+// functions from CUDA graphs.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/ControlFlow/IR/ControlFlowOps.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/GPU/IR/GPUDialect.h"
+#include "mlir/Dialect/LLVMIR/LLVMDialect.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/IR/Matchers.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+
+using namespace mlir;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_GPUGRAPHCAPTURE
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+namespace {
+
+// Runtime interface, see GpuGraphRunnerUtils.h.
+constexpr StringLiteral kGraphBegin = "tpp_cuda_graph_begin";
+constexpr StringLiteral kGraphEnd = "tpp_cuda_graph_end";
+
+// A sequence of kernel launches chained on the stream of a gpu.wait, up to the
+// host synchronization on its last launch. The launches may be interleaved
+// with side effect free ops.
+struct LaunchChain {
+  gpu::WaitOp streamOp;
+  SmallVector<gpu::LaunchFuncOp> launches;
+  SmallVector<Operation *> pureOps;
+  gpu::WaitOp syncOp;
+};
+
+// Returns true if the operand is the same for all the replays of a graph, or
+// if it can be recorded in the signature of the graph.
+static bool isGraphOperand(Value value) {
+  if (matchPattern(value, m_Constant()))
+    return true;
+  Type type = value.getType();
+  if (isa<MemRefType>(type) || type.isIndex())
+    return true;
+  return (isa<IntegerType>(type) || isa<FloatType>(type)) &&
+         type.getIntOrFloatBitWidth() <= 64;
+}
+
+static std::optional<LaunchChain> matchLaunchChain(gpu::WaitOp streamOp) {
+  if (!streamOp.getAsyncToken() || !streamOp.getAsyncDependencies().empty())
+    return std::nullopt;
+
+  LaunchChain chain;
+  chain.streamOp = streamOp;
+  Value token = streamOp.getAsyncToken();
+  for (Operation *op = streamOp->getNextNode(); op; op = op->getNextNode()) {
+    // The stream is only used by the chain.
+    if (!token.hasOneUse())
+      return std::nullopt;
+    if (auto launchOp = dyn_cast<gpu::LaunchFuncOp>(op)) {
+      if (!launchOp.getAsyncToken() ||
+          launchOp.getAsyncDependencies().size() != 1 ||
+          launchOp.getAsyncDependencies().front() != token ||
+          !llvm::all_of(launchOp->getOperands(), isGraphOperand))
+        return std::nullopt;
+      chain.launches.push_back(launchOp);
+      token = launchOp.getAsyncToken();
+      continue;
+    }
+    if (auto waitOp = dyn_cast<gpu::WaitOp>(op)) {
+      if (waitOp.getAsyncToken() ||
+          waitOp.getAsyncDependencies().size() != 1 ||
+          waitOp.getAsyncDependencies().front() != token ||
+          chain.launches.empty())
+        return std::nullopt;
+      chain.syncOp = waitOp;
+      return chain;
+    }
+    if (op->getNumRegions() != 0 || !isMemoryEffectFree(op))
+      return std::nullopt;
+    chain.pureOps.push_back(op);
+  }
+  return std::nullopt;
+}
+
+// Appends the value of a launch operand to the signature of the graph as i64
+// values. Constants are left out, they are the same for all the replays.
+static void appendSignature(OpBuilder &builder, Location loc, Value value,
+                            SmallVectorImpl<Value> &signature) {
+  if (matchPattern(value, m_Constant()))
+    return;
+
+  Type i64 = builder.getI64Type();
+  auto appendIndex = [&](Value index) {
+    signature.push_back(builder.create<arith::IndexCastOp>(loc, i64, index));
+  };
+  if (auto memrefType = dyn_cast<MemRefType>(value.getType())) {
+    appendIndex(
+        builder.create<memref::ExtractAlignedPointerAsIndexOp>(loc, value));
+    SmallVector<int64_t> strides;
+    int64_t offset;
+    if (memrefType.hasStaticShape() &&
+        succeeded(getStridesAndOffset(memrefType, strides, offset)) &&
+        !ShapedType::isDynamic(offset) &&
+        !ShapedType::isDynamicShape(strides))
+      return;
+    auto metadata =
+        builder.create<memref::ExtractStridedMetadataOp>(loc, value);
+    appendIndex(metadata.getOffset());
+    for (Value size : metadata.getSizes())
+      appendIndex(size);
+    for (Value stride : metadata.getStrides())
+      appendIndex(stride);
+    return;
+  }
+  if (value.getType().isIndex()) {
+    appendIndex(value);
+    return;
+  }
+
+  unsigned width = value.getType().getIntOrFloatBitWidth();
+  auto intType = builder.getIntegerType(width);
+  if (isa<FloatType>(value.getType()))
+    value = builder.create<arith::BitcastOp>(loc, intType, value);
+  if (width < 64)
+    value = builder.create<arith::ExtUIOp>(loc, i64, value);
+  signature.push_back(value);
+}
+
+static func::FuncOp getOrCreateFunc(ModuleOp module, StringRef name,
+                                    TypeRange argTypes, TypeRange resultTypes,
+                                    bool emitCInterface = false) {
+  if (auto funcOp = module.lookupSymbol<func::FuncOp>(name))
+    return funcOp;
+  OpBuilder builder = OpBuilder::atBlockBegin(module.getBody());
+  auto funcOp = builder.create<func::FuncOp>(
+      module.getLoc(), name, builder.getFunctionType(argTypes, resultTypes));
+  funcOp.setPrivate();
+  if (emitCInterface) {
+    funcOp->setAttr(LLVM::LLVMDialect::getEmitCWrapperAttrName(),
+                    builder.getUnitAttr());
+  }
+  return funcOp;
+}
+
+// Rewrites the chain such that the launches are captured into a graph by
+// their first run, which is replayed by the following runs with the same
+// signature:
+//
+//   %stream = gpu.wait async
+//   %replayed = call @tpp_cuda_graph_begin(%stream, id, %signature)
+//   cf.cond_br %replayed, ^done, ^capture
+// ^capture:
+//   ... // launches on %stream
+//   call @tpp_cuda_graph_end(%stream, id)
+//   cf.br ^done
+// ^done:
+//   gpu.wait [%stream]
+static void captureChain(ModuleOp module, LaunchChain &chain, int64_t id) {
+  MLIRContext *ctx = module.getContext();
+  Location loc = chain.streamOp.getLoc();
+  OpBuilder builder(chain.streamOp);
+
+  // Independent of the launches, the pure ops run before the graph.
+  for (Operation *op : chain.pureOps)
+    op->moveBefore(chain.streamOp);
+
+  SmallVector<Value> signature;
+  for (gpu::LaunchFuncOp launchOp : chain.launches) {
+    for (Value operand : launchOp->getOperands()) {
+      if (!isa<gpu::AsyncTokenType>(operand.getType()))
+        appendSignature(builder, loc, operand, signature);
+    }
+  }
+  auto i64 = builder.getI64Type();
+  auto signatureBuf = builder.create<memref::AllocaOp>(
+      loc, MemRefType::get({static_cast<int64_t>(signature.size())}, i64));
+  for (auto [idx, value] : llvm::enumerate(signature)) {
+    Value pos = builder.create<arith::ConstantIndexOp>(loc, idx);
+    builder.create<memref::StoreOp>(loc, value, signatureBuf,
+                                    ValueRange{pos});
+  }
+  Value signatureArg = builder.create<memref::CastOp>(
+      loc,
+      UnrankedMemRefType::get(i64, signatureBuf.getType().getMemorySpace()),
+      signatureBuf);
+
+  // The token is the stream once lowered to LLVM.
+  builder.setInsertionPointAfter(chain.streamOp);
+  Value streamToken = chain.streamOp.getAsyncToken();
+  auto ptrType = LLVM::LLVMPointerType::get(ctx);
+  Value stream =
+      builder.create<UnrealizedConversionCastOp>(loc, ptrType, streamToken)
+          .getResult(0);
+  Value idValue = builder.create<arith::ConstantIntOp>(loc, id, 64);
+  auto beginFunc = getOrCreateFunc(
+      module, kGraphBegin, {ptrType, i64, signatureArg.getType()},
+      {builder.getI1Type()}, /*emitCInterface=*/true);
+  auto endFunc = getOrCreateFunc(module, kGraphEnd, {ptrType, i64}, {});
+  Value replayed = builder
+                       .create<func::CallOp>(loc, beginFunc,
+                                             ValueRange{stream, idValue,
+                                                        signatureArg})
+                       .getResult(0);
+  builder.setInsertionPoint(chain.syncOp);
+  builder.create<func::CallOp>(loc, endFunc, ValueRange{stream, idValue});
+
+  Block *block = chain.streamOp->getBlock();
+  Block *captureBlock = block->splitBlock(chain.launches.front());
+  Block *doneBlock = captureBlock->splitBlock(chain.syncOp);
+  builder.setInsertionPointToEnd(block);
+  builder.create<cf::CondBranchOp>(loc, replayed, doneBlock, captureBlock);
+  builder.setInsertionPointToEnd(captureBlock);
+  builder.create<cf::BranchOp>(loc, doneBlock);
+
+  // Either way, the host waits for the stream.
+  chain.syncOp.getAsyncDependenciesMutable().assign(streamToken);
+}
+
+struct GpuGraphCapture
+    : public tpp::impl::GpuGraphCaptureBase<GpuGraphCapture> {
+  using GpuGraphCaptureBase::GpuGraphCaptureBase;
+
+  void runOnOperation() override {
+    ModuleOp module = getOperation();
+
+    // Only the launches of the function bodies are captured, the launches of
+    // a loop would replay a graph for a few iterations at best.
+    SmallVector<LaunchChain> chains;
+    for (auto funcOp : module.getOps<func::FuncOp>()) {
+      if (funcOp.isExternal())
+        continue;
+      for (auto streamOp : funcOp.getBody().front().getOps<gpu::WaitOp>()) {
+        std::optional<LaunchChain> chain = matchLaunchChain(streamOp);
+        if (chain && static_cast<int64_t>(chain->launches.size()) >=
+                         minLaunches)
+          chains.push_back(*chain);
+      }
+    }
+
+    for (auto [id, chain] : llvm::enumerate(chains))
+      captureChain(module, chain, id);
+  }
+};
+
+} // namespace
@@ -12,7 +12,10 @@
 #include "mlir/Dialect/Arith/IR/Arith.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/GPU/IR/GPUDialect.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/IR/Dialect.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "mlir/Interfaces/ViewLikeInterface.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Pass/PassManager.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
@@ -31,9 +34,38 @@ namespace tpp {
 
 namespace {
 
+// Returns true if `getGlobalOp` reads a constant global of at most `maxBytes`
+// bytes, small enough to be copied into the kernel module.
+static bool isSmallConstantGlobal(memref::GetGlobalOp getGlobalOp,
+                                  int64_t maxBytes) {
+  auto type = getGlobalOp.getType();
+  if (!type.hasStaticShape() || !type.getElementType().isIntOrFloat() ||
+      type.getNumElements() *
+              llvm::divideCeil(type.getElementTypeBitWidth(), 8) >
+          maxBytes)
+    return false;
+  auto globalOp = SymbolTable::lookupNearestSymbolFrom<memref::GlobalOp>(
+      getGlobalOp, getGlobalOp.getNameAttr());
+  return globalOp && globalOp.getConstant() &&
+         globalOp.getInitialValue().has_value();
+}
+
+// Returns true if `op` is a view of a small constant global, which is read
+// from the kernel module instead of being passed to the kernel.
+static bool isSmallConstantBuffer(Operation *op, int64_t maxBytes) {
+  if (auto getGlobalOp = dyn_cast<memref::GetGlobalOp>(op))
+    return isSmallConstantGlobal(getGlobalOp, maxBytes);
+  auto viewOp = dyn_cast<ViewLikeOpInterface>(op);
+  if (!viewOp || !isMemoryEffectFree(op))
+    return false;
+  Operation *source = viewOp.getViewSource().getDefiningOp();
+  return source && isSmallConstantBuffer(source, maxBytes);
+}
+
 // Inlines constants into GPU launch body.
 struct InlineConstantsIntoGPULaunch : public OpRewritePattern<gpu::LaunchOp> {
-  using OpRewritePattern<gpu::LaunchOp>::OpRewritePattern;
+  InlineConstantsIntoGPULaunch(MLIRContext *ctx, int64_t maxGlobalBytes)
+      : OpRewritePattern<gpu::LaunchOp>(ctx), maxGlobalBytes(maxGlobalBytes) {}
 
   LogicalResult matchAndRewrite(gpu::LaunchOp launchOp,
                                 PatternRewriter &rewriter) const override {
@@ -48,9 +80,12 @@ struct InlineConstantsIntoGPULaunch : public OpRewritePattern<gpu::LaunchOp> {
     for (auto val : aboveVals) {
       auto *op = val.getDefiningOp();
       // TODO: Add more constant representations.
-      if (op && isa<arith::ConstantOp>(op))
+      if (op && (isa<arith::ConstantOp>(op) ||
+                 isSmallConstantBuffer(op, maxGlobalBytes)))
         constantOps.insert(op);
     }
+    if (constantOps.empty())
+      return failure();
 
     // Clone the constants into the gpu.launch body.
     OpBuilder::InsertionGuard guard(rewriter);
@@ -68,10 +103,15 @@ struct InlineConstantsIntoGPULaunch : public OpRewritePattern<gpu::LaunchOp> {
 
     return success();
   }
+
+private:
+  int64_t maxGlobalBytes;
 };
 
-void populateGpuInlineConstantsPatterns(RewritePatternSet &patterns) {
-  patterns.add<InlineConstantsIntoGPULaunch>(patterns.getContext());
+void populateGpuInlineConstantsPatterns(RewritePatternSet &patterns,
+                                        int64_t maxGlobalBytes) {
+  patterns.add<InlineConstantsIntoGPULaunch>(patterns.getContext(),
+                                             maxGlobalBytes);
 }
 
 struct GpuInlineConstants
@@ -80,7 +120,7 @@ struct GpuInlineConstants
 
   void runOnOperation() override {
     RewritePatternSet patterns(&getContext());
-    populateGpuInlineConstantsPatterns(patterns);
+    populateGpuInlineConstantsPatterns(patterns, maxGlobalBytes);
     (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
   }
 };
@@ -69,6 +69,37 @@ llvm::cl::opt<bool> gpuVector("gpu-vector",
                               llvm::cl::desc("Vectorize GPU kernel"),
                               llvm::cl::init(false));
 
+// Use tensor cores for the CUDA matmuls.
+llvm::cl::opt<bool> gpuMma("gpu-mma",
+                           llvm::cl::desc("Lower GPU matmuls to tensor cores"),
+                           llvm::cl::init(false));
+
+// Fuse the layers into persistent kernels.
+llvm::cl::opt<bool>
+    gpuMegakernel("gpu-megakernel",
+                  llvm::cl::desc("Fuse chains of GPU launches into "
+                                 "persistent kernels"),
+                  llvm::cl::init(false));
+
+llvm::cl::opt<int64_t> gpuMegakernelBlocks(
+    "gpu-megakernel-blocks",
+    llvm::cl::desc("Maximum number of blocks of a persistent kernel, all of "
+                   "which must be resident at once"),
+    llvm::cl::init(32));
+
+// Overlap the CUDA data transfers with the kernels.
+llvm::cl::opt<bool>
+    gpuAsyncTransfers("gpu-async-transfers",
+                      llvm::cl::desc("Use async GPU data transfers"),
+                      llvm::cl::init(false));
+
+// Integrated GPUs access the host memory in place.
+llvm::cl::opt<bool>
+    gpuSharedMemory("gpu-shared-memory",
+                    llvm::cl::desc("The GPU shares the host memory, use the "
+                                   "host buffers without device copies"),
+                    llvm::cl::init(false));
+
 namespace mlir {
 namespace tpp {
 #define GEN_PASS_DEF_GPUPIPELINE
@@ -107,6 +138,11 @@ GpuOptions getGpuOptions(GpuType gpuType) {
     options.triple = "nvptx64-nvidia-cuda";
     options.chip = "sm_70";
     options.features = "+ptx60";
+    // The async copies of the staged tensor core inputs need Ampere.
+    if (gpuMma && stages > 1) {
+      options.chip = "sm_80";
+      options.features = "+ptx70";
+    }
     break;
   }
   case GpuType::Intel: {
@@ -217,14 +253,17 @@ private:
     // Convert to generic GPU ops.
     pm.addPass(createGpuConversion(GpuConversionOptions{
         gpuType == GpuType::Intel, kTile, stages,
-        SmallVector<int64_t>{gpuDpasTile.begin(), gpuDpasTile.end()}}));
+        SmallVector<int64_t>{gpuDpasTile.begin(), gpuDpasTile.end()},
+        gpuMma, gpuMegakernel, gpuMegakernelBlocks}));
 
     // Lower GPU ops to the chosen GPU backend.
     switch (gpuType) {
     case GpuType::Cuda: {
       // Perform explicit GPU data transfers only for CUDA as the unified
-      // memory is not currently used here.
-      pm.addNestedPass<func::FuncOp>(createGpuDataTransfer());
+      // memory is not currently used here, unless the GPU shares the host
+      // memory.
+      pm.addNestedPass<func::FuncOp>(createGpuDataTransfer(
+          GpuDataTransferOptions{gpuAsyncTransfers, gpuSharedMemory}));
       pm.addPass(createGpuToCuda(GpuToCudaOptions{
           gpuOptions.triple, gpuOptions.chip, gpuOptions.features}));
       break;
@@ -63,6 +63,7 @@ private:
   void constructPipeline() override {
 #ifdef TPP_CUDA_ENABLE
     // Preprocess and lower standard ops.
+    pm.addNestedPass<gpu::GPUModuleOp>(createGpuConstantMemory());
     pm.addNestedPass<gpu::GPUModuleOp>(
         memref::createExpandStridedMetadataPass());
     pm.addNestedPass<gpu::GPUModuleOp>(arith::createArithExpandOpsPass());
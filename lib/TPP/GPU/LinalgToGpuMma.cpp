@@ -0,0 +1,422 @@
+//===- LinalgToGpuMma.cpp ----------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+
+#include "TPP/Transforms/Utils/ValueUtils.h"
+
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/GPU/IR/GPUDialect.h"
+#include "mlir/Dialect/LLVMIR/NVVMDialect.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/NVGPU/IR/NVGPUDialect.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/IR/Dialect.h"
+#include "mlir/IR/PatternMatch.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "mlir/Pass/Pass.h"
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_LINALGTOGPUMMA
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+namespace {
+
+// WMMA fragment sizes, the same for all the supported precisions.
+constexpr int64_t kMmaTile = 16;
+// Maximum number of threads per block.
+constexpr int64_t kMaxBlockThreads = 1024;
+// Shared memory available to a block without opting in to more.
+constexpr int64_t kMaxSharedBytes = 48 * 1024;
+// Elements of an async copy, 16 bytes of f16.
+constexpr int64_t kCopyElements = 8;
+// Padding of the shared memory rows, which shifts each row of a fragment to
+// other banks.
+constexpr int64_t kSharedPadding = 8;
+
+// Returns the row stride of a memref operand whose rows are contiguous,
+// or failure.
+static FailureOr<int64_t> getLeadDimension(Value operand) {
+  auto strides = utils::getStaticStrides(operand);
+  if (failed(strides) || strides->size() < 2 || strides->back() != 1)
+    return failure();
+  return (*strides)[strides->size() - 2];
+}
+
+// Returns true if the matmul or batch-reduce matmul fits the WMMA fragments:
+// f16 inputs, an f16 or f32 output, static sizes that are multiples of the
+// fragments and contiguous rows.
+static bool isMmaCompatible(linalg::LinalgOp linalgOp) {
+  if (!isa<linalg::MatmulOp, linalg::BatchReduceMatmulOp>(linalgOp) ||
+      !linalgOp.hasPureBufferSemantics() || linalgOp.hasDynamicShape())
+    return false;
+
+  auto aType = cast<MemRefType>(linalgOp.getDpsInputs()[0].getType());
+  auto bType = cast<MemRefType>(linalgOp.getDpsInputs()[1].getType());
+  auto cType = cast<MemRefType>(linalgOp.getDpsInits()[0].getType());
+  if (!aType.getElementType().isF16() || !bType.getElementType().isF16() ||
+      !(cType.getElementType().isF16() || cType.getElementType().isF32()))
+    return false;
+
+  int64_t m = cType.getShape()[0];
+  int64_t n = cType.getShape()[1];
+  int64_t k = aType.getShape().back();
+  if (m % kMmaTile != 0 || n % kMmaTile != 0 || k % kMmaTile != 0)
+    return false;
+
+  return llvm::all_of(linalgOp->getOperands(), [](Value operand) {
+    return succeeded(getLeadDimension(operand));
+  });
+}
+
+// Returns true if `op`, outside of the matmuls, may write to memory.
+static bool mayWrite(Operation *op) {
+  if (auto effects = dyn_cast<MemoryEffectOpInterface>(op))
+    return effects.hasEffect<MemoryEffects::Write>();
+  return !op->hasTrait<OpTrait::HasRecursiveMemoryEffects>();
+}
+
+// Returns the bytes of shared memory staging `stages` fragments of A and B
+// for each of `numWarps` warps.
+static int64_t getSharedBytes(int64_t numWarps, int64_t stages) {
+  return 2 * numWarps * stages * kMmaTile * (kMmaTile + kSharedPadding) *
+         sizeof(uint16_t);
+}
+
+// Shared memory staging of the input fragments of a warp: multi-buffered
+// tiles of [warp, stage, row, column] filled by async copies, `stages` - 1
+// steps of the reduction ahead of the tensor cores.
+struct SharedStaging {
+  int64_t stages;
+  Value warp;
+  Value lane;
+  Value tileA;
+  Value tileB;
+};
+
+// Copies the fragments of A and B of the reduction `step` into the stage
+// `slot`, each lane copying 8 elements of a row. Returns the token of the
+// group of copies.
+static Value copyFragments(RewriterBase &rewriter, Location loc,
+                           linalg::LinalgOp linalgOp,
+                           const SharedStaging &staging, Value row, Value col,
+                           Value step, Value slot) {
+  Value matA = linalgOp.getDpsInputs()[0];
+  Value matB = linalgOp.getDpsInputs()[1];
+  auto aType = cast<MemRefType>(matA.getType());
+  bool isBrgemm = isa<linalg::BatchReduceMatmulOp>(linalgOp);
+
+  auto getConst = [&](int64_t value) -> Value {
+    return rewriter.create<arith::ConstantIndexOp>(loc, value);
+  };
+  Value numKTiles = getConst(aType.getShape().back() / kMmaTile);
+  Value tile = getConst(kMmaTile);
+  Value chunks = getConst(kMmaTile / kCopyElements);
+  Value batch = rewriter.create<arith::DivUIOp>(loc, step, numKTiles);
+  Value red = rewriter.create<arith::MulIOp>(
+      loc, rewriter.create<arith::RemUIOp>(loc, step, numKTiles), tile);
+  Value laneRow = rewriter.create<arith::DivUIOp>(loc, staging.lane, chunks);
+  Value laneCol = rewriter.create<arith::MulIOp>(
+      loc, rewriter.create<arith::RemUIOp>(loc, staging.lane, chunks),
+      getConst(kCopyElements));
+
+  auto add = [&](Value lhs, Value rhs) -> Value {
+    return rewriter.create<arith::AddIOp>(loc, lhs, rhs);
+  };
+  SmallVector<Value> indicesA{add(row, laneRow), add(red, laneCol)};
+  SmallVector<Value> indicesB{add(red, laneRow), add(col, laneCol)};
+  if (isBrgemm) {
+    indicesA.insert(indicesA.begin(), batch);
+    indicesB.insert(indicesB.begin(), batch);
+  }
+  SmallVector<Value> sharedIndices{staging.warp, slot, laneRow, laneCol};
+
+  auto tokenType = rewriter.getType<nvgpu::DeviceAsyncTokenType>();
+  auto copy = [&](Value dst, Value src, ValueRange srcIndices) -> Value {
+    return rewriter.create<nvgpu::DeviceAsyncCopyOp>(
+        loc, tokenType, dst, sharedIndices, src, srcIndices,
+        rewriter.getIndexAttr(kCopyElements), /*srcElements=*/Value(),
+        /*bypassL1=*/UnitAttr());
+  };
+  SmallVector<Value> tokens{copy(staging.tileA, matA, indicesA),
+                            copy(staging.tileB, matB, indicesB)};
+  return rewriter.create<nvgpu::DeviceAsyncCreateGroupOp>(loc, tokenType,
+                                                          tokens);
+}
+
+// Synchronizes the lanes of the warp on the shared memory stages.
+static void syncWarp(RewriterBase &rewriter, Location loc) {
+  Value mask = rewriter.create<arith::ConstantIntOp>(loc, -1, 32);
+  rewriter.create<NVVM::SyncWarpOp>(loc, mask);
+}
+
+// Replaces the matmul by loops over its output fragments, each accumulating
+// the products of the input fragments along the reduction dimensions.
+// With `staging`, the input fragments are loaded from its shared memory
+// stages, refilled by async copies while the tensor cores run.
+static void lowerToMma(RewriterBase &rewriter, linalg::LinalgOp linalgOp,
+                       const SharedStaging *staging) {
+  Location loc = linalgOp.getLoc();
+  rewriter.setInsertionPoint(linalgOp);
+
+  Value matA = linalgOp.getDpsInputs()[0];
+  Value matB = linalgOp.getDpsInputs()[1];
+  Value matC = linalgOp.getDpsInits()[0];
+  auto aType = cast<MemRefType>(matA.getType());
+  auto cType = cast<MemRefType>(matC.getType());
+  bool isBrgemm = isa<linalg::BatchReduceMatmulOp>(linalgOp);
+
+  auto getFragType = [&](Type elemType, StringRef operand) {
+    return gpu::MMAMatrixType::get({kMmaTile, kMmaTile}, elemType, operand);
+  };
+  Type f16 = rewriter.getF16Type();
+  auto fragA = getFragType(f16, "AOp");
+  auto fragB = getFragType(f16, "BOp");
+  auto fragC = getFragType(cType.getElementType(), "COp");
+  auto ldA = rewriter.getIndexAttr(*getLeadDimension(matA));
+  auto ldB = rewriter.getIndexAttr(*getLeadDimension(matB));
+  auto ldC = rewriter.getIndexAttr(*getLeadDimension(matC));
+
+  auto getConst = [&](int64_t value) -> Value {
+    return rewriter.create<arith::ConstantIndexOp>(loc, value);
+  };
+  Value zero = getConst(0);
+  Value one = getConst(1);
+  Value tile = getConst(kMmaTile);
+  Value batch = getConst(isBrgemm ? aType.getShape()[0] : 1);
+  Value m = getConst(cType.getShape()[0]);
+  Value n = getConst(cType.getShape()[1]);
+  Value k = getConst(aType.getShape().back());
+
+  // Fragments of the output.
+  auto loopM = rewriter.create<scf::ForOp>(loc, zero, m, tile);
+  rewriter.setInsertionPointToStart(loopM.getBody());
+  auto loopN = rewriter.create<scf::ForOp>(loc, zero, n, tile);
+  rewriter.setInsertionPointToStart(loopN.getBody());
+  Value row = loopM.getInductionVar();
+  Value col = loopN.getInductionVar();
+  Value acc = rewriter.create<gpu::SubgroupMmaLoadMatrixOp>(
+      loc, fragC, matC, ValueRange{row, col}, ldC, /*transpose=*/UnitAttr());
+
+  if (staging) {
+    // Steps of the reduction over the batch and the K fragments.
+    int64_t numSteps = (isBrgemm ? aType.getShape()[0] : 1) *
+                       aType.getShape().back() / kMmaTile;
+    int64_t stages = staging->stages;
+    Value lastStep = getConst(numSteps - 1);
+
+    // Fill all the stages but one. Missing steps are replaced by the last
+    // one, the copies stay in bounds and their stages are never read.
+    for (int64_t stage = 0; stage < stages - 1; ++stage) {
+      (void)copyFragments(rewriter, loc, linalgOp, *staging, row, col,
+                          getConst(std::min(stage, numSteps - 1)),
+                          getConst(stage));
+    }
+
+    auto loopSteps = rewriter.create<scf::ForOp>(
+        loc, zero, getConst(numSteps), one, ValueRange{acc});
+    rewriter.setInsertionPointToStart(loopSteps.getBody());
+    Value step = loopSteps.getInductionVar();
+    Value stagesVal = getConst(stages);
+
+    // Refill the stage read by the previous step, then wait for the copies
+    // of the current one.
+    Value ahead = rewriter.create<arith::AddIOp>(loc, step,
+                                                 getConst(stages - 1));
+    Value group = copyFragments(
+        rewriter, loc, linalgOp, *staging, row, col,
+        rewriter.create<arith::MinUIOp>(loc, ahead, lastStep),
+        rewriter.create<arith::RemUIOp>(loc, ahead, stagesVal));
+    rewriter.create<nvgpu::DeviceAsyncWaitOp>(
+        loc, group, rewriter.getI32IntegerAttr(stages - 1));
+    syncWarp(rewriter, loc);
+
+    Value slot = rewriter.create<arith::RemUIOp>(loc, step, stagesVal);
+    SmallVector<Value> sharedIndices{staging->warp, slot, zero, zero};
+    auto ldShared = rewriter.getIndexAttr(kMmaTile + kSharedPadding);
+    Value a = rewriter.create<gpu::SubgroupMmaLoadMatrixOp>(
+        loc, fragA, staging->tileA, sharedIndices, ldShared,
+        /*transpose=*/UnitAttr());
+    Value b = rewriter.create<gpu::SubgroupMmaLoadMatrixOp>(
+        loc, fragB, staging->tileB, sharedIndices, ldShared,
+        /*transpose=*/UnitAttr());
+    Value res = rewriter.create<gpu::SubgroupMmaComputeOp>(
+        loc, fragC, a, b, loopSteps.getRegionIterArgs()[0],
+        /*a_transpose=*/UnitAttr(), /*b_transpose=*/UnitAttr());
+    // All the lanes are done with the stage before it gets refilled.
+    syncWarp(rewriter, loc);
+    rewriter.create<scf::YieldOp>(loc, res);
+
+    rewriter.setInsertionPointAfter(loopSteps);
+    rewriter.create<gpu::SubgroupMmaStoreMatrixOp>(
+        loc, loopSteps.getResult(0), matC, ValueRange{row, col}, ldC,
+        /*transpose=*/UnitAttr());
+    rewriter.eraseOp(linalgOp);
+    return;
+  }
+
+  // Reduction over the batch and the K fragments.
+  auto loopBatch =
+      rewriter.create<scf::ForOp>(loc, zero, batch, one, ValueRange{acc});
+  rewriter.setInsertionPointToStart(loopBatch.getBody());
+  auto loopK = rewriter.create<scf::ForOp>(
+      loc, zero, k, tile, ValueRange{loopBatch.getRegionIterArgs()[0]});
+  rewriter.setInsertionPointToStart(loopK.getBody());
+  Value red = loopK.getInductionVar();
+  SmallVector<Value> indicesA{row, red};
+  SmallVector<Value> indicesB{red, col};
+  if (isBrgemm) {
+    indicesA.insert(indicesA.begin(), loopBatch.getInductionVar());
+    indicesB.insert(indicesB.begin(), loopBatch.getInductionVar());
+  }
+  Value a = rewriter.create<gpu::SubgroupMmaLoadMatrixOp>(
+      loc, fragA, matA, indicesA, ldA, /*transpose=*/UnitAttr());
+  Value b = rewriter.create<gpu::SubgroupMmaLoadMatrixOp>(
+      loc, fragB, matB, indicesB, ldB, /*transpose=*/UnitAttr());
+  Value res = rewriter.create<gpu::SubgroupMmaComputeOp>(
+      loc, fragC, a, b, loopK.getRegionIterArgs()[0],
+      /*a_transpose=*/UnitAttr(), /*b_transpose=*/UnitAttr());
+  rewriter.create<scf::YieldOp>(loc, res);
+  rewriter.setInsertionPointAfter(loopK);
+  rewriter.create<scf::YieldOp>(loc, loopK.getResults());
+
+  rewriter.setInsertionPointAfter(loopBatch);
+  rewriter.create<gpu::SubgroupMmaStoreMatrixOp>(
+      loc, loopBatch.getResult(0), matC, ValueRange{row, col}, ldC,
+      /*transpose=*/UnitAttr());
+
+  rewriter.eraseOp(linalgOp);
+}
+
+struct LinalgToGpuMma : public tpp::impl::LinalgToGpuMmaBase<LinalgToGpuMma> {
+  using LinalgToGpuMmaBase::LinalgToGpuMmaBase;
+
+  void runOnOperation() override {
+    IRRewriter rewriter(&getContext());
+    getOperation().walk([&](gpu::LaunchOp launchOp) {
+      (void)convertLaunch(rewriter, launchOp);
+    });
+  }
+
+private:
+  // Lowers the matmuls of a launch whose threads can all become warps.
+  LogicalResult convertLaunch(RewriterBase &rewriter, gpu::LaunchOp launchOp) {
+    SmallVector<linalg::LinalgOp> matmuls;
+    bool isSupported = true;
+    launchOp.getBody().walk<WalkOrder::PreOrder>([&](Operation *op) {
+      auto linalgOp = dyn_cast<linalg::LinalgOp>(op);
+      if (linalgOp && isMmaCompatible(linalgOp)) {
+        matmuls.push_back(linalgOp);
+        return WalkResult::skip();
+      }
+      if (mayWrite(op)) {
+        isSupported = false;
+        return WalkResult::interrupt();
+      }
+      return WalkResult::advance();
+    });
+    if (!isSupported || matmuls.empty())
+      return failure();
+
+    // All the lanes of a warp take the place of one thread.
+    std::optional<int64_t> sizeX =
+        getConstantIntValue(launchOp.getBlockSizeX());
+    std::optional<int64_t> sizeY =
+        getConstantIntValue(launchOp.getBlockSizeY());
+    std::optional<int64_t> sizeZ =
+        getConstantIntValue(launchOp.getBlockSizeZ());
+    if (!sizeX || !sizeY || !sizeZ ||
+        *sizeX * *sizeY * *sizeZ * warpSize > kMaxBlockThreads)
+      return failure();
+
+    rewriter.setInsertionPoint(launchOp);
+    Value warpSizeX = rewriter.create<arith::ConstantIndexOp>(
+        launchOp.getLoc(), *sizeX * warpSize);
+    rewriter.modifyOpInPlace(launchOp, [&]() {
+      launchOp.getBlockSizeXMutable().assign(warpSizeX);
+    });
+
+    // The thread indices and the block size along x count the warps.
+    Block &body = launchOp.getBody().front();
+    rewriter.setInsertionPointToStart(&body);
+    Value lanes =
+        rewriter.create<arith::ConstantIndexOp>(launchOp.getLoc(), warpSize);
+    for (Value dim : {launchOp.getThreadIds().x, launchOp.getBlockSize().x}) {
+      auto warps =
+          rewriter.create<arith::DivUIOp>(launchOp.getLoc(), dim, lanes);
+      rewriter.replaceAllUsesExcept(dim, warps, warps);
+    }
+
+    // Stage the inputs in shared memory, as long as the stages of all the
+    // matmuls fit and their rows can be copied 16 bytes at a time.
+    int64_t numWarps = *sizeX * *sizeY * *sizeZ;
+    int64_t sharedBytes = 0;
+    for (linalg::LinalgOp matmul : matmuls) {
+      bool isStaged =
+          stages > 1 &&
+          sharedBytes + getSharedBytes(numWarps, stages) <= kMaxSharedBytes &&
+          llvm::all_of(matmul.getDpsInputs(), [](Value input) {
+            return *getLeadDimension(input) % kCopyElements == 0;
+          });
+      if (!isStaged) {
+        lowerToMma(rewriter, matmul, /*staging=*/nullptr);
+        continue;
+      }
+      sharedBytes += getSharedBytes(numWarps, stages);
+      SharedStaging staging =
+          createStaging(rewriter, launchOp, matmul, numWarps, *sizeX);
+      lowerToMma(rewriter, matmul, &staging);
+    }
+    return success();
+  }
+
+  // Adds the shared memory stages of `matmul` to the launch and computes the
+  // warp and lane ids of the thread.
+  SharedStaging createStaging(RewriterBase &rewriter, gpu::LaunchOp launchOp,
+                              linalg::LinalgOp matmul, int64_t numWarps,
+                              int64_t warpsX) {
+    Location loc = matmul.getLoc();
+    auto sharedSpace = gpu::AddressSpaceAttr::get(
+        rewriter.getContext(), gpu::AddressSpace::Workgroup);
+    auto sharedType = MemRefType::get(
+        {numWarps, stages, kMmaTile, kMmaTile + kSharedPadding},
+        rewriter.getF16Type(), MemRefLayoutAttrInterface{}, sharedSpace);
+
+    SharedStaging staging;
+    staging.stages = stages;
+    staging.tileA = launchOp.addWorkgroupAttribution(sharedType, loc);
+    staging.tileB = launchOp.addWorkgroupAttribution(sharedType, loc);
+
+    // The warps are numbered along x first, as the threads they replace.
+    rewriter.setInsertionPoint(matmul);
+    Value lanes = rewriter.create<arith::ConstantIndexOp>(loc, warpSize);
+    Value threadX = rewriter.create<gpu::ThreadIdOp>(loc, gpu::Dimension::x);
+    Value threadY = rewriter.create<gpu::ThreadIdOp>(loc, gpu::Dimension::y);
+    Value threadZ = rewriter.create<gpu::ThreadIdOp>(loc, gpu::Dimension::z);
+    Value sizeY = rewriter.create<gpu::BlockDimOp>(loc, gpu::Dimension::y);
+    Value warp = rewriter.create<arith::AddIOp>(
+        loc, rewriter.create<arith::MulIOp>(loc, threadZ, sizeY), threadY);
+    warp = rewriter.create<arith::MulIOp>(
+        loc, warp, rewriter.create<arith::ConstantIndexOp>(loc, warpsX));
+    staging.warp = rewriter.create<arith::AddIOp>(
+        loc, warp, rewriter.create<arith::DivUIOp>(loc, threadX, lanes));
+    staging.lane = rewriter.create<gpu::LaneIdOp>(loc, IntegerAttr());
+    return staging;
+  }
+};
+
+} // namespace
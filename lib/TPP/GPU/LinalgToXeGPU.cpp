@@ -9,6 +9,7 @@
 #include "TPP/Passes.h"
 
 #include "TPP/IR/MatcherUtils.h"
+#include "TPP/IR/OpClassification.h"
 #include "TPP/IR/StructuredOpMatcher.h"
 #include "TPP/Transforms/Utils/ValueUtils.h"
 
@@ -25,6 +26,9 @@
 #include "mlir/Dialect/Vector/IR/VectorOps.h"
 #include "mlir/Dialect/XeGPU/IR/XeGPU.h"
 #include "mlir/IR/Dialect.h"
+#include "mlir/IR/IRMapping.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "mlir/Interfaces/ViewLikeInterface.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Pass/PassManager.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
@@ -163,12 +167,76 @@ static LogicalResult isValidMemrefOperand(linalg::LinalgOp linalgOp,
   return success();
 }
 
+// Returns true if the body of the op only holds element-wise arith and math
+// ops on scalars, that apply unchanged to vectors.
+static bool hasElementwiseBody(linalg::LinalgOp linalgOp) {
+  for (Operation &op : linalgOp.getBlock()->without_terminator()) {
+    if (isa<arith::ConstantOp>(op))
+      continue;
+    Dialect *dialect = op.getDialect();
+    if (!dialect || !isa<arith::ArithDialect, math::MathDialect>(dialect) ||
+        !OpTrait::hasElementwiseMappableTraits(&op))
+      return false;
+    if (!llvm::all_of(op.getResultTypes(),
+                      [](Type type) { return type.isIntOrFloat(); }))
+      return false;
+  }
+  return true;
+}
+
+// Applies the element-wise body of the op on vector tiles of shape
+// `tileShape`. The values of its block arguments are given in `args`, null for
+// the unused ones.
+static Value vectorizeElementwiseBody(PatternRewriter &rewriter, Location loc,
+                                      linalg::LinalgOp linalgOp,
+                                      ArrayRef<Value> args,
+                                      ArrayRef<int64_t> tileShape) {
+  Block *body = linalgOp.getBlock();
+  IRMapping mapping;
+  for (auto [arg, value] : llvm::zip_equal(body->getArguments(), args)) {
+    if (value)
+      mapping.map(arg, value);
+  }
+
+  // Values from above the body are broadcast to the tile.
+  auto getVector = [&](Value value) -> Value {
+    if (Value mapped = mapping.lookupOrNull(value))
+      return mapped;
+    auto vecType = VectorType::get(tileShape, value.getType());
+    Value vec = rewriter.create<vector::BroadcastOp>(loc, vecType, value);
+    mapping.map(value, vec);
+    return vec;
+  };
+
+  for (Operation &op : body->without_terminator()) {
+    if (auto constOp = dyn_cast<arith::ConstantOp>(op)) {
+      auto vecType = VectorType::get(tileShape, constOp.getType());
+      Value vec = rewriter.create<arith::ConstantOp>(
+          loc, vecType, DenseElementsAttr::get(vecType, constOp.getValue()));
+      mapping.map(constOp.getResult(), vec);
+      continue;
+    }
+    SmallVector<Value> operands;
+    for (Value operand : op.getOperands())
+      operands.push_back(getVector(operand));
+    SmallVector<Type> resultTypes;
+    for (Type type : op.getResultTypes())
+      resultTypes.push_back(VectorType::get(tileShape, type));
+    OperationState state(loc, op.getName().getStringRef(), operands,
+                         resultTypes, op.getAttrs());
+    Operation *vecOp = rewriter.create(state);
+    mapping.map(op.getResults(), vecOp->getResults());
+  }
+
+  return getVector(body->getTerminator()->getOperand(0));
+}
+
 // Match and, if possible, lower a generic operation to an XeGPU compatible op.
 // Returns the result of the lowered op or nullopt, otherwise.
-static std::optional<Value> lowerGenericOp(linalg::GenericOp genericOp,
-                                           ArrayRef<Value> operands,
-                                           VectorType resType,
-                                           PatternRewriter &rewriter) {
+static std::optional<Value>
+lowerGenericOp(linalg::GenericOp genericOp, ArrayRef<Value> operands,
+               VectorType resType, PatternRewriter &rewriter,
+               structured_match::OpClassification *classification) {
   Location loc = genericOp.getLoc();
 
   // Expect operands to be already loaded vectors.
@@ -177,9 +245,9 @@ static std::optional<Value> lowerGenericOp(linalg::GenericOp genericOp,
       return std::nullopt;
   }
 
-  if (structured_match::utils::isTwoDReluOp(genericOp, /*operands=*/nullptr)) {
-    assert(operands.size() == 1 &&
-           "Invalid number of operands for generic 2D ReLU");
+  if (operands.size() == 1 &&
+      structured_match::isOpOfKind(classification, genericOp,
+                                   structured_match::utils::OpKind::Relu)) {
 
     auto eltType = resType.getElementType();
     Value zeroConst;
@@ -203,28 +271,41 @@ static std::optional<Value> lowerGenericOp(linalg::GenericOp genericOp,
         .getResult();
   }
 
-  if (structured_match::utils::isTwoDAddOp(genericOp, /*operands=*/nullptr)) {
-    assert(operands.size() == 2 &&
-           "Invalid number of operands for generic 2D add");
+  if (operands.size() == 2 &&
+      structured_match::isOpOfKind(classification, genericOp,
+                                   structured_match::utils::OpKind::Add)) {
     return rewriter
         .create<arith::AddFOp>(loc, resType, operands[0], operands[1])
         .getResult();
   }
 
+  // Other element-wise bodies are applied as is on the tiles, they may mix
+  // element types.
+  OpOperand *init = genericOp.getDpsInitOperand(0);
+  if (hasElementwiseBody(genericOp) &&
+      genericOp.getMatchingBlockArgument(init).use_empty()) {
+    SmallVector<Value> args{operands};
+    args.push_back(Value());
+    return vectorizeElementwiseBody(rewriter, loc, genericOp, args,
+                                    resType.getShape());
+  }
+
   return std::nullopt;
 }
 
 // Lower an elementwise operation to an XeGPU compatible op.
 // Returns the result of the lowered op or nullopt, otherwise.
-static std::optional<Value> lowerEltwiseOp(linalg::LinalgOp linalgOp,
-                                           ArrayRef<Value> operands,
-                                           PatternRewriter &rewriter) {
+static std::optional<Value>
+lowerEltwiseOp(linalg::LinalgOp linalgOp, ArrayRef<Value> operands,
+               PatternRewriter &rewriter,
+               structured_match::OpClassification *classification) {
   Location loc = linalgOp.getLoc();
 
-  assert(llvm::all_of(operands,
-                      [&](Value tile) {
-                        return tile.getType() == operands[0].getType();
-                      }) &&
+  assert((isa<linalg::GenericOp>(linalgOp) ||
+          llvm::all_of(operands,
+                       [&](Value tile) {
+                         return tile.getType() == operands[0].getType();
+                       })) &&
          "All eltwise operands must have the same type.");
 
   // Expect operands to be already loaded vectors.
@@ -365,7 +446,8 @@ static std::optional<Value> lowerEltwiseOp(linalg::LinalgOp linalgOp,
         return std::nullopt;
       })
       .Case([&](linalg::GenericOp genericOp) -> std::optional<Value> {
-        return lowerGenericOp(genericOp, operands, resType, rewriter);
+        return lowerGenericOp(genericOp, operands, resType, rewriter,
+                              classification);
       })
       .Default(
           [&](Operation *op) -> std::optional<Value> { return std::nullopt; });
@@ -832,6 +914,286 @@ extractVecSubTiles(PatternRewriter &rewriter, Location loc,
   return subTiles;
 }
 
+// Returns the dimension of the 2D iteration space of the op that a 1D memref
+// operand of the op follows, when the operand is broadcast along the other
+// dimension of the shape `shape`.
+static std::optional<unsigned> getBroadcastDim(linalg::LinalgOp linalgOp,
+                                               OpOperand *operand,
+                                               ArrayRef<int64_t> shape) {
+  auto type = dyn_cast<MemRefType>(operand->get().getType());
+  AffineMap map = linalgOp.getMatchingIndexingMap(operand);
+  if (!type || type.getRank() != 1 || !type.hasStaticShape() ||
+      map.getNumDims() != 2 || map.getNumResults() != 1)
+    return std::nullopt;
+  auto strides = utils::getStaticStrides(operand->get());
+  if (failed(strides) || strides->back() != 1)
+    return std::nullopt;
+
+  auto dimExpr = dyn_cast<AffineDimExpr>(map.getResult(0));
+  if (!dimExpr || type.getShape()[0] != shape[dimExpr.getPosition()])
+    return std::nullopt;
+  return dimExpr.getPosition();
+}
+
+// Loads a 1D source following the dimension `dim` of a 2D shape and
+// broadcasts it into vector sub-tiles of that shape. Each slice of the source
+// is loaded once.
+//
+// The sub-tiles are ordered in row-major fashion with respect to the whole
+// shape.
+static SmallVector<Value>
+loadBroadcastSubTiles(PatternRewriter &rewriter, Location loc, Value src,
+                      unsigned dim, ArrayRef<int64_t> shape,
+                      ArrayRef<int64_t> subTile, xegpu::CachePolicyAttr hint) {
+  auto elemType = cast<ShapedType>(src.getType()).getElementType();
+  auto descType = xegpu::TensorDescType::get({subTile[dim]}, elemType,
+                                             /*array_length=*/1,
+                                             /*boundary_check=*/true);
+  auto tileType = VectorType::get(subTile, elemType);
+  // Broadcasts only add leading dimensions, the values along the rows are
+  // broadcast to the transposed tile first.
+  auto transposedType = VectorType::get({subTile[1], subTile[0]}, elemType);
+
+  SmallVector<Value> slices;
+  for (int64_t offset = 0; offset < shape[dim]; offset += subTile[dim]) {
+    Value offsetCst = rewriter.create<arith::ConstantIndexOp>(loc, offset);
+    auto desc = rewriter.create<xegpu::CreateNdDescOp>(
+        loc, descType, dyn_cast<TypedValue<MemRefType>>(src),
+        SmallVector<OpFoldResult>{offsetCst});
+    Value slice =
+        loadNdDescTiles(rewriter, loc, ValueRange{desc.getResult()}, hint)[0];
+    if (dim == 1) {
+      slice = rewriter.create<vector::BroadcastOp>(loc, tileType, slice);
+    } else {
+      slice = rewriter.create<vector::BroadcastOp>(loc, transposedType, slice);
+      slice = rewriter.create<vector::TransposeOp>(loc, slice,
+                                                   ArrayRef<int64_t>{1, 0});
+    }
+    slices.push_back(slice);
+  }
+
+  SmallVector<Value> tiles;
+  for (int64_t i = 0; i < shape[0] / subTile[0]; i++) {
+    for (int64_t j = 0; j < shape[1] / subTile[1]; j++)
+      tiles.push_back(slices[dim == 0 ? i : j]);
+  }
+  return tiles;
+}
+
+// Returns the buffer a view is taken of.
+static Value getRootBuffer(Value buffer) {
+  while (auto view = buffer.getDefiningOp<ViewLikeOpInterface>())
+    buffer = view.getViewSource();
+  return buffer;
+}
+
+// Returns true if the innermost stride of the memref is static and one.
+static bool hasUnitInnerStride(Value operand) {
+  auto strides = utils::getStaticStrides(operand);
+  return succeeded(strides) && !strides->empty() && strides->back() == 1;
+}
+
+// Kinds of the operands of a fused epilogue op, with respect to the 2D output
+// tile of the GEMM.
+enum class EpilogueOperand {
+  // The current value of the output tile.
+  Accumulator,
+  // A 2D memref of the output tile shape, like a residual.
+  Tile,
+  // A 1D memref broadcast along one dimension of the tile, like a bias.
+  Broadcast,
+  // A scalar broadcast over the whole tile.
+  Scalar,
+};
+
+// Classifies the operand of an epilogue op consuming the accumulator `acc` of
+// shape `shape`, none if it cannot be loaded into register tiles.
+static std::optional<EpilogueOperand>
+getEpilogueOperandKind(linalg::LinalgOp linalgOp, OpOperand *operand,
+                       Value acc, ArrayRef<int64_t> shape) {
+  Value value = operand->get();
+  AffineMap map = linalgOp.getMatchingIndexingMap(operand);
+  auto type = dyn_cast<MemRefType>(value.getType());
+  if (!type) {
+    if (!value.getType().isIntOrFloat())
+      return std::nullopt;
+    return EpilogueOperand::Scalar;
+  }
+  if (!type.hasStaticShape() || !hasUnitInnerStride(value))
+    return std::nullopt;
+
+  if (map.isIdentity() && type.getShape() == shape)
+    return value == acc ? EpilogueOperand::Accumulator : EpilogueOperand::Tile;
+
+  if (getBroadcastDim(linalgOp, operand, shape))
+    return EpilogueOperand::Broadcast;
+
+  return std::nullopt;
+}
+
+// Returns true if `linalgOp` is an element-wise consumer of the GEMM
+// accumulator `acc` that can be applied on its register tiles: it reads
+// `acc` and writes a buffer of the same shape, its other operands are
+// residuals, biases or scalars.
+static bool isFusableEpilogueOp(linalg::LinalgOp linalgOp, Value acc,
+                                ArrayRef<int64_t> shape,
+                                ArrayRef<Value> writtenRoots) {
+  if (!linalgOp.hasPureBufferSemantics() || linalgOp.getNumDpsInits() != 1 ||
+      linalgOp.getNumLoops() != 2 ||
+      linalgOp.getNumParallelLoops() != linalgOp.getNumLoops() ||
+      linalgOp.hasIndexSemantics() || !hasElementwiseBody(linalgOp))
+    return false;
+
+  OpOperand *init = linalgOp.getDpsInitOperand(0);
+  auto initKind = getEpilogueOperandKind(linalgOp, init, acc, shape);
+  if (!initKind || (*initKind != EpilogueOperand::Accumulator &&
+                    *initKind != EpilogueOperand::Tile))
+    return false;
+
+  bool readsAcc = false;
+  for (OpOperand &operand : linalgOp->getOpOperands()) {
+    auto kind = getEpilogueOperandKind(linalgOp, &operand, acc, shape);
+    if (!kind)
+      return false;
+    bool isRead = !linalgOp.getMatchingBlockArgument(&operand).use_empty();
+    if (*kind == EpilogueOperand::Accumulator) {
+      readsAcc |= isRead;
+      continue;
+    }
+    // The other buffers must not alias the tiles still held in registers.
+    if (isa<MemRefType>(operand.get().getType()) &&
+        llvm::is_contained(writtenRoots, getRootBuffer(operand.get())))
+      return false;
+  }
+  return readsAcc;
+}
+
+// Returns the chain of element-wise consumers of the output of the GEMM-like
+// op that directly follow it, each one reading the output of the previous.
+// The pure ops in between, like the views of the consumer operands, are
+// moved before the GEMM.
+static SmallVector<linalg::LinalgOp>
+getEpilogueOps(linalg::LinalgOp gemmOp, PatternRewriter &rewriter) {
+  Value acc = gemmOp.getDpsInits()[0];
+  auto shape = cast<ShapedType>(acc.getType()).getShape();
+  SmallVector<Value> writtenRoots{getRootBuffer(acc)};
+
+  SmallVector<linalg::LinalgOp> epilogueOps;
+  SmallVector<Operation *> pureOps;
+  for (Operation *op = gemmOp->getNextNode(); op; op = op->getNextNode()) {
+    auto linalgOp = dyn_cast<linalg::LinalgOp>(op);
+    if (linalgOp && isFusableEpilogueOp(linalgOp, acc, shape, writtenRoots)) {
+      for (Operation *pureOp : pureOps)
+        rewriter.moveOpBefore(pureOp, gemmOp);
+      pureOps.clear();
+      epilogueOps.push_back(linalgOp);
+      acc = linalgOp.getDpsInits()[0];
+      writtenRoots.push_back(getRootBuffer(acc));
+      continue;
+    }
+    if (!isMemoryEffectFree(op) || op->getNumRegions() != 0)
+      break;
+    pureOps.push_back(op);
+  }
+  return epilogueOps;
+}
+
+// Returns true if the values of `buffer` are only used by the given ops, so
+// that they don't need to be stored.
+static bool isOnlyUsedBy(Value buffer, ArrayRef<Operation *> ops) {
+  Value root = getRootBuffer(buffer);
+  if (!root.getDefiningOp<memref::AllocOp>())
+    return false;
+  SmallVector<Value> worklist{root};
+  while (!worklist.empty()) {
+    Value value = worklist.pop_back_val();
+    for (Operation *user : value.getUsers()) {
+      if (llvm::is_contained(ops, user) || isa<memref::DeallocOp>(user))
+        continue;
+      auto view = dyn_cast<ViewLikeOpInterface>(user);
+      if (!view || view.getViewSource() != value)
+        return false;
+      worklist.push_back(view->getResult(0));
+    }
+  }
+  return true;
+}
+
+// Applies the epilogue ops on the GEMM result tiles `results` held in
+// registers and stores the final tiles to the output of the last op. The
+// intermediate outputs are only stored when used after the epilogue.
+static void storeEpilogueResults(PatternRewriter &rewriter, Location loc,
+                                 linalg::LinalgOp gemmOp,
+                                 ArrayRef<linalg::LinalgOp> epilogueOps,
+                                 SmallVector<Value> results,
+                                 ArrayRef<int64_t> tileShape,
+                                 xegpu::CachePolicyAttr readCacheHint,
+                                 xegpu::CachePolicyAttr writeCacheHint) {
+  Value acc = gemmOp.getDpsInits()[0];
+  auto shape = cast<ShapedType>(acc.getType()).getShape();
+  SmallVector<Operation *> fusedOps{gemmOp};
+  fusedOps.append(epilogueOps.begin(), epilogueOps.end());
+
+  auto storeTiles = [&](ValueRange values, Value buffer) {
+    SmallVector<Value> tiles =
+        createDescriptorTiles(rewriter, loc, buffer, shape, {0, 0}, tileShape);
+    for (auto [value, tile] : llvm::zip_equal(values, tiles)) {
+      rewriter.create<xegpu::StoreNdOp>(loc, value, tile,
+                                        /*l1_hint=*/writeCacheHint,
+                                        /*l2_hint=*/writeCacheHint,
+                                        /*l3_hint=*/writeCacheHint);
+    }
+  };
+
+  for (linalg::LinalgOp linalgOp : epilogueOps) {
+    Value output = linalgOp.getDpsInits()[0];
+    if (output != acc && !isOnlyUsedBy(acc, fusedOps))
+      storeTiles(results, acc);
+
+    // Load the register tiles of the other operands.
+    SmallVector<SmallVector<Value>> operandTiles;
+    for (OpOperand &operand : linalgOp->getOpOperands()) {
+      auto &tiles = operandTiles.emplace_back(results.size(), Value());
+      if (linalgOp.getMatchingBlockArgument(&operand).use_empty())
+        continue;
+      Value value = operand.get();
+      switch (*getEpilogueOperandKind(linalgOp, &operand, acc, shape)) {
+      case EpilogueOperand::Accumulator:
+        tiles.assign(results.begin(), results.end());
+        break;
+      case EpilogueOperand::Tile: {
+        SmallVector<Value> descTiles = createDescriptorTiles(
+            rewriter, loc, value, shape, {0, 0}, tileShape);
+        tiles = loadNdDescTiles(rewriter, loc, descTiles, readCacheHint);
+        break;
+      }
+      case EpilogueOperand::Broadcast:
+        tiles = loadBroadcastSubTiles(
+            rewriter, loc, value, *getBroadcastDim(linalgOp, &operand, shape),
+            shape, tileShape, readCacheHint);
+        break;
+      case EpilogueOperand::Scalar: {
+        auto tileType = VectorType::get(tileShape, value.getType());
+        Value tile = rewriter.create<vector::BroadcastOp>(loc, tileType, value);
+        tiles.assign(results.size(), tile);
+        break;
+      }
+      }
+    }
+
+    for (size_t i = 0; i < results.size(); i++) {
+      SmallVector<Value> args;
+      for (auto &tiles : operandTiles)
+        args.push_back(tiles[i]);
+      results[i] =
+          vectorizeElementwiseBody(rewriter, loc, linalgOp, args, tileShape);
+    }
+    acc = output;
+  }
+
+  storeTiles(results, acc);
+}
+
 // Create XeGPU DPAS kernel out of GEMM-like operation.
 static LogicalResult createDPASKernel(linalg::LinalgOp linalgOp,
                                       ArrayRef<int64_t> dpasTile, int kTile,
@@ -864,6 +1226,10 @@ static LogicalResult createDPASKernel(linalg::LinalgOp linalgOp,
 
   bool isBrgemm = isa<linalg::BatchReduceMatmulOp>(linalgOp);
 
+  // Element-wise consumers of the output fused into the kernel.
+  SmallVector<linalg::LinalgOp> epilogueOps =
+      getEpilogueOps(linalgOp, rewriter);
+
   Value zero = rewriter.create<arith::ConstantIndexOp>(loc, 0);
 
   int dimM = typeC.getShape()[0];
@@ -1155,44 +1521,57 @@ static LogicalResult createDPASKernel(linalg::LinalgOp linalgOp,
   }
 
   // Write back the final C sub-tiles results to the output buffer.
-  SmallVector<xegpu::StoreNdOp> storeOps;
-  for (size_t i = 0; i < tilesC.size(); i++) {
-    auto storeOp =
-        rewriter.create<xegpu::StoreNdOp>(loc, results[i], tilesC[i],
-                                          /*l1_hint=*/writeCacheHint,
-                                          /*l2_hint=*/writeCacheHint,
-                                          /*l3_hint=*/writeCacheHint);
-    storeOps.push_back(storeOp);
+  if (epilogueOps.empty()) {
+    for (size_t i = 0; i < tilesC.size(); i++) {
+      rewriter.create<xegpu::StoreNdOp>(loc, results[i], tilesC[i],
+                                        /*l1_hint=*/writeCacheHint,
+                                        /*l2_hint=*/writeCacheHint,
+                                        /*l3_hint=*/writeCacheHint);
+    }
+  } else {
+    // Apply the fused consumers on the registers before the store.
+    storeEpilogueResults(rewriter, loc, linalgOp, epilogueOps, results,
+                         {dpasTileM, dpasTileN}, readCacheHint,
+                         writeCacheHint);
   }
 
   rewriter.eraseOp(linalgOp);
+  for (linalg::LinalgOp epilogueOp : epilogueOps)
+    rewriter.eraseOp(epilogueOp);
 
   return success();
 }
 
 // Create XeGPU kernel out of elementwise operation.
-LogicalResult createEltwiseKernel(linalg::LinalgOp linalgOp,
-                                  PatternRewriter &rewriter) {
+LogicalResult
+createEltwiseKernel(linalg::LinalgOp linalgOp, PatternRewriter &rewriter,
+                    structured_match::OpClassification *classification) {
   Location loc = linalgOp.getLoc();
   auto ctx = linalgOp.getContext();
 
   auto output = linalgOp.getDpsInits()[0];
   auto outputShape = cast<ShapedType>(output.getType()).getShape();
 
-  // Create descriptors and load values for all inputs.
-  SmallVector<SmallVector<Value>> loadedInputs;
-  for (auto input : linalgOp.getDpsInputs()) {
+  // Create descriptors and load values for all inputs of the output shape.
+  // The broadcast inputs are loaded once the sub-tile shape is known.
+  SmallVector<OpOperand *> inputs = linalgOp.getDpsInputOperands();
+  SmallVector<SmallVector<Value>> loadedInputs(inputs.size());
+  SmallVector<int64_t> loadShape;
+  for (auto [input, loadedVals] : llvm::zip_equal(inputs, loadedInputs)) {
+    if (getBroadcastDim(linalgOp, input, outputShape))
+      continue;
     SmallVector<Value> inputTiles = createCoarseDscTiles(
-        rewriter, loc, input, outputShape, /*isVnni=*/false);
-    SmallVector<Value> loadedVals =
-        loadNdDescTiles(rewriter, loc, inputTiles, /*hint=*/nullptr);
-    loadedInputs.push_back(loadedVals);
+        rewriter, loc, input->get(), outputShape, /*isVnni=*/false);
+    loadedVals = loadNdDescTiles(rewriter, loc, inputTiles, /*hint=*/nullptr);
+    // Inputs with narrower elements load wider tiles.
+    auto shape = cast<VectorType>(loadedVals[0].getType()).getShape();
+    if (loadShape.empty() || shape[1] < loadShape[1])
+      loadShape.assign(shape.begin(), shape.end());
   }
 
   // Extract SIMD sized sub-tiles from loaded tiles.
   // TODO: Fetch SIMD sizes from target descriptor.
   int maxSizeSIMD = 256;
-  auto loadShape = cast<VectorType>(loadedInputs[0][0].getType()).getShape();
   // For sake of n-D loads and store, the vectorized operations are kept in 2D
   // shape. The loaded tiles might be larger than what SIMD units can handle.
   // Thus, split the registers into contiguous smaller slices. The current
@@ -1205,10 +1584,19 @@ LogicalResult createEltwiseKernel(linalg::LinalgOp linalgOp,
   int64_t subTileRows = std::min(loadShape[0], maxSizeSIMD / subTileCols);
 
   SmallVector<SmallVector<Value>> vecSubTiles;
-  for (auto inputTiles : loadedInputs) {
+  for (auto [input, inputTiles] : llvm::zip_equal(inputs, loadedInputs)) {
+    if (inputTiles.empty()) {
+      vecSubTiles.push_back(loadBroadcastSubTiles(
+          rewriter, loc, input->get(),
+          *getBroadcastDim(linalgOp, input, outputShape), outputShape,
+          {subTileRows, subTileCols}, /*hint=*/nullptr));
+      continue;
+    }
+    auto inputLoadShape =
+        cast<VectorType>(inputTiles[0].getType()).getShape();
     TilesArray subTiles =
-        extractVecSubTiles(rewriter, loc, inputTiles, outputShape, loadShape,
-                           {subTileRows, subTileCols});
+        extractVecSubTiles(rewriter, loc, inputTiles, outputShape,
+                           inputLoadShape, {subTileRows, subTileCols});
     vecSubTiles.push_back(subTiles.toFlatVector());
   }
 
@@ -1222,7 +1610,7 @@ LogicalResult createEltwiseKernel(linalg::LinalgOp linalgOp,
     }
 
     // Create SIMD operations on the sub-tiles.
-    auto res = lowerEltwiseOp(linalgOp, operands, rewriter);
+    auto res = lowerEltwiseOp(linalgOp, operands, rewriter, classification);
     if (!res)
       return failure();
 
@@ -1248,6 +1636,96 @@ LogicalResult createEltwiseKernel(linalg::LinalgOp linalgOp,
   return success();
 }
 
+// Returns the kind of the reduction of a body combining its input and output
+// with a single op, none otherwise.
+static std::optional<vector::CombiningKind>
+getReductionKind(linalg::LinalgOp linalgOp) {
+  Block *body = linalgOp.getBlock();
+  if (body->getOperations().size() != 2 || body->getNumArguments() != 2)
+    return std::nullopt;
+  Operation &op = body->front();
+  if (op.getNumOperands() != 2 || op.getNumResults() != 1 ||
+      body->getTerminator()->getOperand(0) != op.getResult(0) ||
+      !llvm::is_contained(op.getOperands(), body->getArgument(0)) ||
+      !llvm::is_contained(op.getOperands(), body->getArgument(1)))
+    return std::nullopt;
+
+  using vector::CombiningKind;
+  return llvm::TypeSwitch<Operation *, std::optional<CombiningKind>>(&op)
+      .Case<arith::AddFOp, arith::AddIOp>(
+          [](auto) { return CombiningKind::ADD; })
+      .Case<arith::MulFOp, arith::MulIOp>(
+          [](auto) { return CombiningKind::MUL; })
+      .Case([](arith::MaximumFOp) { return CombiningKind::MAXIMUMF; })
+      .Case([](arith::MinimumFOp) { return CombiningKind::MINIMUMF; })
+      .Case([](arith::MaxNumFOp) { return CombiningKind::MAXNUMF; })
+      .Case([](arith::MinNumFOp) { return CombiningKind::MINNUMF; })
+      .Default([](Operation *) { return std::nullopt; });
+}
+
+// Create XeGPU kernel out of a reduction along the rows of a 2D input.
+//
+// Each block of rows of the input is loaded with 2D block loads and its
+// tiles are combined element-wise in registers. The combined tile is then
+// reduced across its columns, together with the initial output values.
+static LogicalResult createRowReductionKernel(linalg::LinalgOp linalgOp,
+                                              vector::CombiningKind kind,
+                                              PatternRewriter &rewriter) {
+  Location loc = linalgOp.getLoc();
+  auto ctx = linalgOp.getContext();
+
+  auto input = linalgOp.getDpsInputs()[0];
+  auto output = linalgOp.getDpsInits()[0];
+  auto inputShape = cast<ShapedType>(input.getType()).getShape();
+  auto elemType = cast<ShapedType>(output.getType()).getElementType();
+
+  // Cache hints for loads and stores.
+  auto readCacheHint =
+      xegpu::CachePolicyAttr::get(ctx, xegpu::CachePolicy::CACHED);
+  auto writeCacheHint =
+      xegpu::CachePolicyAttr::get(ctx, xegpu::CachePolicy::WRITE_BACK);
+
+  SmallVector<Value> inputTiles = createCoarseDscTiles(
+      rewriter, loc, input, inputShape, /*isVnni=*/false);
+  SmallVector<Value> loadedTiles =
+      loadNdDescTiles(rewriter, loc, inputTiles, readCacheHint);
+  auto loadShape = cast<VectorType>(loadedTiles[0].getType()).getShape();
+  int64_t numTileRows = inputShape[0] / loadShape[0];
+  int64_t numTileCols = inputShape[1] / loadShape[1];
+
+  auto outputDescType = xegpu::TensorDescType::get(
+      {loadShape[0]}, elemType, /*array_length=*/1, /*boundary_check=*/true);
+  for (int64_t i = 0; i < numTileRows; i++) {
+    // Combine the tiles of the row block first, to reduce a single tile.
+    Value acc = loadedTiles[i * numTileCols];
+    for (int64_t j = 1; j < numTileCols; j++) {
+      acc = vector::makeArithReduction(rewriter, loc, kind,
+                                       loadedTiles[i * numTileCols + j], acc);
+    }
+
+    Value offset =
+        rewriter.create<arith::ConstantIndexOp>(loc, i * loadShape[0]);
+    auto outputTile = rewriter.create<xegpu::CreateNdDescOp>(
+        loc, outputDescType, dyn_cast<TypedValue<MemRefType>>(output),
+        SmallVector<OpFoldResult>{offset});
+    Value init = loadNdDescTiles(rewriter, loc,
+                                 ValueRange{outputTile.getResult()},
+                                 readCacheHint)[0];
+
+    // Reduce across the columns held by the lanes of the subgroup.
+    Value rows = rewriter.create<vector::MultiDimReductionOp>(
+        loc, acc, init, ArrayRef<bool>{false, true}, kind);
+    rewriter.create<xegpu::StoreNdOp>(loc, rows, outputTile,
+                                      /*l1_hint=*/writeCacheHint,
+                                      /*l2_hint=*/writeCacheHint,
+                                      /*l3_hint=*/writeCacheHint);
+  }
+
+  rewriter.eraseOp(linalgOp);
+
+  return success();
+}
+
 // Convert a GEMM-like operation to an XeGPU kernel.
 template <typename LinalgOpTy>
 struct ConvertGemmLikeToXeGPU : public OpRewritePattern<LinalgOpTy> {
@@ -1330,8 +1808,10 @@ template <typename LinalgOpTy>
 struct ConvertNamedEltwiseToXeGPU : public OpRewritePattern<LinalgOpTy> {
   using OpRewritePattern<LinalgOpTy>::OpRewritePattern;
 
-  ConvertNamedEltwiseToXeGPU(MLIRContext *ctx, LinalgToXeGPUOptions options)
-      : OpRewritePattern<LinalgOpTy>(ctx), options(options) {}
+  ConvertNamedEltwiseToXeGPU(MLIRContext *ctx, LinalgToXeGPUOptions options,
+                             structured_match::OpClassification *classification)
+      : OpRewritePattern<LinalgOpTy>(ctx), options(options),
+        classification(classification) {}
 
   LogicalResult matchAndRewrite(LinalgOpTy eltwiseOp,
                                 PatternRewriter &rewriter) const override {
@@ -1354,7 +1834,159 @@ struct ConvertNamedEltwiseToXeGPU : public OpRewritePattern<LinalgOpTy> {
     if (failed(isOutputValid))
       return isOutputValid;
 
-    return createEltwiseKernel(eltwiseOp, rewriter);
+    return createEltwiseKernel(eltwiseOp, rewriter, classification);
+  }
+
+private:
+  LinalgToXeGPUOptions options;
+  structured_match::OpClassification *classification;
+};
+
+// Convert an element-wise generic operation to an XeGPU kernel.
+struct ConvertGenericEltwiseToXeGPU
+    : public OpRewritePattern<linalg::GenericOp> {
+  using OpRewritePattern<linalg::GenericOp>::OpRewritePattern;
+
+  ConvertGenericEltwiseToXeGPU(
+      MLIRContext *ctx, LinalgToXeGPUOptions options,
+      structured_match::OpClassification *classification)
+      : OpRewritePattern<linalg::GenericOp>(ctx), options(options),
+        classification(classification) {}
+
+  LogicalResult matchAndRewrite(linalg::GenericOp genericOp,
+                                PatternRewriter &rewriter) const override {
+    if (!genericOp.hasPureBufferSemantics()) {
+      return rewriter.notifyMatchFailure(
+          genericOp, "Linalg eltwise to GPU expects memref type");
+    }
+    if (genericOp.hasDynamicShape()) {
+      return rewriter.notifyMatchFailure(
+          genericOp, "Expect static shape when mapping to GPU");
+    }
+    if (genericOp.getNumDpsInits() != 1 || genericOp.getNumLoops() != 2 ||
+        genericOp.getNumParallelLoops() != 2 ||
+        genericOp.hasIndexSemantics()) {
+      return rewriter.notifyMatchFailure(
+          genericOp, "Expect 2D parallel generic for eltwise lowering");
+    }
+
+    OpOperand *init = genericOp.getDpsInitOperand(0);
+    if (!genericOp.getMatchingIndexingMap(init).isIdentity()) {
+      return rewriter.notifyMatchFailure(genericOp,
+                                         "Expect identity output map");
+    }
+    auto isOutputValid = isValidMemrefOperand(genericOp, init->get(), rewriter);
+    if (failed(isOutputValid))
+      return isOutputValid;
+
+    // At least one input spans the whole output, the others can be
+    // broadcast along one dimension.
+    auto outputShape = cast<ShapedType>(init->get().getType()).getShape();
+    bool hasFullInput = false;
+    for (OpOperand *input : genericOp.getDpsInputOperands()) {
+      if (getBroadcastDim(genericOp, input, outputShape))
+        continue;
+      if (!genericOp.getMatchingIndexingMap(input).isIdentity()) {
+        return rewriter.notifyMatchFailure(
+            genericOp, "Expect identity or broadcast input maps");
+      }
+      auto isInputValid = isValidMemrefOperand(genericOp, input->get(),
+                                               rewriter);
+      if (failed(isInputValid))
+        return isInputValid;
+      hasFullInput = true;
+    }
+    if (!hasFullInput) {
+      return rewriter.notifyMatchFailure(
+          genericOp, "Expect an input of the output shape");
+    }
+
+    int64_t numInputs = genericOp.getNumDpsInputs();
+    bool isSupported =
+        (numInputs == 1 &&
+         structured_match::isOpOfKind(classification, genericOp,
+                                      structured_match::utils::OpKind::Relu)) ||
+        (numInputs == 2 &&
+         structured_match::isOpOfKind(classification, genericOp,
+                                      structured_match::utils::OpKind::Add)) ||
+        (hasElementwiseBody(genericOp) &&
+         genericOp.getMatchingBlockArgument(init).use_empty());
+    if (!isSupported) {
+      return rewriter.notifyMatchFailure(genericOp,
+                                         "Unsupported eltwise generic body");
+    }
+
+    return createEltwiseKernel(genericOp, rewriter, classification);
+  }
+
+private:
+  LinalgToXeGPUOptions options;
+  structured_match::OpClassification *classification;
+};
+
+// Convert a reduction along the rows of a 2D operation to an XeGPU kernel.
+template <typename LinalgOpTy>
+struct ConvertRowReductionToXeGPU : public OpRewritePattern<LinalgOpTy> {
+  using OpRewritePattern<LinalgOpTy>::OpRewritePattern;
+  // Constrain conversion to the supported reduction ops.
+  static_assert(
+      llvm::is_one_of<LinalgOpTy, linalg::GenericOp, linalg::ReduceOp>::value);
+
+  ConvertRowReductionToXeGPU(MLIRContext *ctx, LinalgToXeGPUOptions options)
+      : OpRewritePattern<LinalgOpTy>(ctx), options(options) {}
+
+  LogicalResult matchAndRewrite(LinalgOpTy reduceOp,
+                                PatternRewriter &rewriter) const override {
+    auto linalgOp = cast<linalg::LinalgOp>(reduceOp.getOperation());
+    if (!linalgOp.hasPureBufferSemantics()) {
+      return rewriter.notifyMatchFailure(
+          reduceOp, "Linalg reduction to GPU expects memref type");
+    }
+    if (linalgOp.hasDynamicShape()) {
+      return rewriter.notifyMatchFailure(
+          reduceOp, "Expect static shape when mapping to GPU");
+    }
+    SmallVector<utils::IteratorType> iteratorTypes =
+        linalgOp.getIteratorTypesArray();
+    if (linalgOp.getNumDpsInputs() != 1 || linalgOp.getNumDpsInits() != 1 ||
+        iteratorTypes.size() != 2 ||
+        iteratorTypes[0] != utils::IteratorType::parallel ||
+        iteratorTypes[1] != utils::IteratorType::reduction) {
+      return rewriter.notifyMatchFailure(
+          reduceOp, "Expect a reduction along the rows of a 2D input");
+    }
+
+    OpOperand *input = linalgOp.getDpsInputOperand(0);
+    OpOperand *init = linalgOp.getDpsInitOperand(0);
+    auto inputShape = cast<ShapedType>(input->get().getType()).getShape();
+    if (!linalgOp.getMatchingIndexingMap(input).isIdentity() ||
+        getBroadcastDim(linalgOp, init, inputShape) != 0u) {
+      return rewriter.notifyMatchFailure(
+          reduceOp, "Expect identity input and row output maps");
+    }
+    auto isInputValid =
+        isValidMemrefOperand(linalgOp, input->get(), rewriter);
+    if (failed(isInputValid))
+      return isInputValid;
+
+    auto kind = getReductionKind(linalgOp);
+    if (!kind) {
+      return rewriter.notifyMatchFailure(reduceOp,
+                                         "Unsupported reduction body");
+    }
+
+    // The coarse load tiles must cover the input exactly, padded elements
+    // would change the result.
+    auto elemType = cast<ShapedType>(input->get().getType()).getElementType();
+    int64_t loadRows = std::min<int64_t>(inputShape[0], 32);
+    int64_t loadCols = std::min<int64_t>(
+        inputShape[1], 64 / (elemType.getIntOrFloatBitWidth() / 8));
+    if (inputShape[0] % loadRows != 0 || inputShape[1] % loadCols != 0) {
+      return rewriter.notifyMatchFailure(
+          reduceOp, "Reduction shape does not fit in load tiles");
+    }
+
+    return createRowReductionKernel(linalgOp, *kind, rewriter);
   }
 
 private:
@@ -1369,8 +2001,9 @@ void populateLinalgGemmToXeGPUPatterns(RewritePatternSet &patterns,
                                                           options);
 }
 
-void populateLinalgEltwiseToXeGPUPatterns(RewritePatternSet &patterns,
-                                          LinalgToXeGPUOptions options) {
+void populateLinalgEltwiseToXeGPUPatterns(
+    RewritePatternSet &patterns, LinalgToXeGPUOptions options,
+    structured_match::OpClassification *classification) {
   patterns.add<ConvertNamedEltwiseToXeGPU<linalg::AbsOp>,
                ConvertNamedEltwiseToXeGPU<linalg::AddOp>,
                ConvertNamedEltwiseToXeGPU<linalg::CeilOp>,
@@ -1381,8 +2014,12 @@ void populateLinalgEltwiseToXeGPUPatterns(RewritePatternSet &patterns,
                ConvertNamedEltwiseToXeGPU<linalg::MaxOp>,
                ConvertNamedEltwiseToXeGPU<linalg::MulOp>,
                ConvertNamedEltwiseToXeGPU<linalg::NegFOp>,
-               ConvertNamedEltwiseToXeGPU<linalg::SubOp>>(patterns.getContext(),
-                                                          options);
+               ConvertNamedEltwiseToXeGPU<linalg::SubOp>,
+               ConvertGenericEltwiseToXeGPU>(patterns.getContext(), options,
+                                             classification);
+  patterns.add<ConvertRowReductionToXeGPU<linalg::GenericOp>,
+               ConvertRowReductionToXeGPU<linalg::ReduceOp>>(
+      patterns.getContext(), options);
 }
 
 struct LinalgToXeGPU : public tpp::impl::LinalgToXeGPUBase<LinalgToXeGPU> {
@@ -1394,15 +2031,23 @@ struct LinalgToXeGPU : public tpp::impl::LinalgToXeGPUBase<LinalgToXeGPU> {
     options.stages = stages;
     options.dpasTile = SmallVector<int64_t>{*dpasTile};
 
+    // The classification of the ops is kept up to date by both rewrites.
+    auto &classification = getAnalysis<structured_match::OpClassification>();
+    GreedyRewriteConfig config;
+    config.listener = &classification;
+
     // Run GEMM pattern first to allow fusion with its consumers.
     RewritePatternSet gemmPatterns(&getContext());
     populateLinalgGemmToXeGPUPatterns(gemmPatterns, options);
-    (void)applyPatternsAndFoldGreedily(getOperation(), std::move(gemmPatterns));
+    (void)applyPatternsAndFoldGreedily(getOperation(), std::move(gemmPatterns),
+                                       config);
 
     // Convert other remaining ops.
     RewritePatternSet patterns(&getContext());
-    populateLinalgEltwiseToXeGPUPatterns(patterns, options);
-    (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
+    populateLinalgEltwiseToXeGPUPatterns(patterns, options, &classification);
+    (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns),
+                                       config);
+    markAnalysesPreserved<structured_match::OpClassification>();
   }
 };
 
@@ -6,11 +6,16 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "TPP/IR/MatcherUtils.h"
 #include "TPP/IR/StructuredOpMatcher.h"
 #include "TPP/Transforms/Utils/VNNIUtils.h"
 #include "TPP/Transforms/Utils/ValueUtils.h"
 #include "mlir/Dialect/Arith/IR/Arith.h"
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/Math/IR/Math.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/Tensor/IR/Tensor.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
 
 namespace mlir {
 namespace structured_match {
@@ -47,6 +52,13 @@ std::pair<bool, bool> isBrgemmVnniOp(linalg::GenericOp linalgOp,
 
   AffineMap mapOperandA, mapOperandB, mapOperandC;
   using namespace structured_match;
+  // Integer brgemms sign-extend the i8 inputs to the i32 accumulation type.
+  WithOpChain<arith::MulFOp, arith::AddFOp> floatChain(operands);
+  WithOpChain<arith::ExtSIOp, arith::ExtSIOp, arith::MulIOp, arith::AddIOp>
+      intChain(operands);
+  auto isMulAddChain = [&](Region *region, Operation *op) {
+    return floatChain(region, op) || intChain(region, op);
+  };
   // clang-format off
   auto matmulMatcher =
       StructuredOpMatcher::make<linalg::GenericOp>()
@@ -59,8 +71,7 @@ std::pair<bool, bool> isBrgemmVnniOp(linalg::GenericOp linalgOp,
           .input(MatchOne(0), HasMap(BroadcastableProjectedPermutation(), &mapOperandA))
           .input(MatchOne(1), HasMap(Any(), &mapOperandB))
           .output(MatchOne(0), HasMap(BroadcastableProjectedPermutation(), &mapOperandC))
-          .region(MatchOne(0),
-                  WithOpChain<arith::MulFOp, arith::AddFOp>(operands));
+          .region(MatchOne(0), isMulAddChain);
   // clang-format on
   if (!matmulMatcher.match(linalgOp))
     return std::make_pair(false, hasBatch);
@@ -217,6 +228,213 @@ bool isTwoDMulOp(linalg::LinalgOp linalgOp, SmallVectorImpl<Value> *operands) {
   return isTwoDEltWiseOpOfTypeTy<arith::MulFOp>(linalgOp, operands);
 }
 
+bool isTwoDDivOp(linalg::LinalgOp linalgOp, SmallVectorImpl<Value> *operands) {
+  return isTwoDEltWiseOpOfTypeTy<arith::DivFOp>(linalgOp, operands);
+}
+
+// Return true if the body of `op` applies a single OpTy to its only input and
+// yields the result. Capture the input and the output.
+template <typename OpTy>
+static bool hasUnaryBody(Operation *op, SmallVectorImpl<Value> *captured) {
+  auto linalgOp = dyn_cast<linalg::LinalgOp>(op);
+  if (!linalgOp || linalgOp.getNumDpsInputs() != 1 ||
+      linalgOp.getNumDpsInits() != 1) {
+    return false;
+  }
+  Block *body = linalgOp.getBlock();
+  if (std::distance(body->begin(), body->end()) != 2)
+    return false;
+  auto innerOp = dyn_cast<OpTy>(&body->front());
+  if (!innerOp)
+    return false;
+  Operation *yieldOp = body->getTerminator();
+  if (yieldOp->getNumOperands() != 1 ||
+      yieldOp->getOperand(0).getDefiningOp() != innerOp)
+    return false;
+  auto arg = dyn_cast<BlockArgument>(innerOp->getOperand(0));
+  if (!arg || arg.getOwner() != body || arg.getArgNumber() != 0)
+    return false;
+  if (captured) {
+    captured->push_back(linalgOp.getDpsInputs()[0]);
+    captured->push_back(linalgOp.getDpsInits()[0]);
+  }
+  return true;
+}
+
+// Return true if the body of `op` combines its input with its output using a
+// single operation of one of the types `OpTy`, i.e., it is the body of a
+// reduction. Capture the input and the output.
+template <typename... OpTy>
+static bool hasReductionBody(Operation *op, SmallVectorImpl<Value> *captured) {
+  auto linalgOp = dyn_cast<linalg::LinalgOp>(op);
+  if (!linalgOp || linalgOp.getNumDpsInputs() != 1 ||
+      linalgOp.getNumDpsInits() != 1) {
+    return false;
+  }
+  Block *body = linalgOp.getBlock();
+  if (std::distance(body->begin(), body->end()) != 2)
+    return false;
+  Operation *innerOp = &body->front();
+  if (!isa<OpTy...>(innerOp) || innerOp->getNumOperands() != 2)
+    return false;
+  Operation *yieldOp = body->getTerminator();
+  if (yieldOp->getNumOperands() != 1 ||
+      yieldOp->getOperand(0).getDefiningOp() != innerOp)
+    return false;
+  // The combiner is commutative, accept the input and the accumulator in any
+  // order.
+  Value in = body->getArgument(0);
+  Value acc = body->getArgument(1);
+  Value lhs = innerOp->getOperand(0);
+  Value rhs = innerOp->getOperand(1);
+  if (!(lhs == in && rhs == acc) && !(lhs == acc && rhs == in))
+    return false;
+  if (captured) {
+    captured->push_back(linalgOp.getDpsInputs()[0]);
+    captured->push_back(linalgOp.getDpsInits()[0]);
+  }
+  return true;
+}
+
+// Return true if only one of the dimensions is left in the result of `map`,
+// e.g., the parallel dimension of the output of a 2d reduction.
+static bool keepsOneDim(AffineMap map) {
+  return BroadcastableProjectedPermutation()(map) &&
+         llvm::count_if(map.getResults(), [](AffineExpr expr) {
+           return isa<AffineDimExpr>(expr);
+         }) == 1;
+}
+
+// Return true if the linalg operation reduces one of the two dimensions of a
+// 2d input with the combiner `OpTy`. The output is 1d, or 2d with a unit
+// reduced dimension.
+template <typename... OpTy>
+static bool isTwoDReduceOpOfTypeTy(linalg::LinalgOp linalgOp,
+                                   SmallVectorImpl<Value> *operands) {
+  // clang-format off
+  auto reduceMatcher =
+    StructuredOpMatcher::make<linalg::LinalgOp>()
+      .operation(NumDpsInits(EqualsTo(1)))
+      .operation(NumDpsInputs(EqualsTo(1)))
+      .operation(NumOfLoops(EqualsTo(2)))
+      .input(MatchAll(), HasRank({2}))
+      .input(MatchAll(), HasMap(Identity()))
+      .output(MatchAll(), HasRank({1, 2}))
+      .output(MatchAll(), HasMap(keepsOneDim))
+      .region(MatchOne(0), [&](Region *region, Operation *op) {
+        return hasReductionBody<OpTy...>(op, operands);
+      });
+  // clang-format on
+  return isTppOp(linalgOp) && linalgOp.getNumReductionLoops() == 1 &&
+         reduceMatcher.match(linalgOp);
+}
+
+bool isTwoDReduceAddOp(linalg::LinalgOp linalgOp,
+                       SmallVectorImpl<Value> *operands) {
+  return isTwoDReduceOpOfTypeTy<arith::AddFOp>(linalgOp, operands);
+}
+
+bool isTwoDReduceMaxOp(linalg::LinalgOp linalgOp,
+                       SmallVectorImpl<Value> *operands) {
+  return isTwoDReduceOpOfTypeTy<arith::MaximumFOp, arith::MaxNumFOp>(linalgOp,
+                                                                     operands);
+}
+
+// Return true if the body of `op` adds the square of its first input, or of
+// the difference of its two inputs if `centered`, to its output.
+static bool hasSumOfSquaresBody(Operation *op, bool centered) {
+  auto linalgOp = dyn_cast<linalg::LinalgOp>(op);
+  if (!linalgOp || linalgOp.getNumDpsInputs() != (centered ? 2 : 1) ||
+      linalgOp.getNumDpsInits() != 1) {
+    return false;
+  }
+  Block *body = linalgOp.getBlock();
+  if (std::distance(body->begin(), body->end()) != (centered ? 4 : 3))
+    return false;
+  Operation *yieldOp = body->getTerminator();
+  if (yieldOp->getNumOperands() != 1)
+    return false;
+  auto addOp = yieldOp->getOperand(0).getDefiningOp<arith::AddFOp>();
+  if (!addOp)
+    return false;
+  Value acc = linalgOp.getMatchingBlockArgument(linalgOp.getDpsInitOperand(0));
+  Value square = addOp.getLhs() == acc ? addOp.getRhs() : addOp.getLhs();
+  if (square == acc || (addOp.getLhs() != acc && addOp.getRhs() != acc))
+    return false;
+  auto mulOp = square.getDefiningOp<arith::MulFOp>();
+  if (!mulOp || mulOp.getLhs() != mulOp.getRhs())
+    return false;
+  Value in = linalgOp.getMatchingBlockArgument(linalgOp.getDpsInputOperand(0));
+  if (!centered)
+    return mulOp.getLhs() == in;
+  auto subOp = mulOp.getLhs().getDefiningOp<arith::SubFOp>();
+  return subOp && subOp.getLhs() == in &&
+         subOp.getRhs() ==
+             linalgOp.getMatchingBlockArgument(linalgOp.getDpsInputOperand(1));
+}
+
+bool isTwoDReduceSquareOp(linalg::LinalgOp linalgOp,
+                          SmallVectorImpl<Value> *operands) {
+  // clang-format off
+  auto reduceMatcher =
+    StructuredOpMatcher::make<linalg::LinalgOp>()
+      .operation(NumDpsInits(EqualsTo(1)))
+      .operation(NumDpsInputs(EqualsTo(1)))
+      .operation(NumOfLoops(EqualsTo(2)))
+      .input(MatchAll(), HasRank({2}))
+      .input(MatchAll(), HasMap(Identity()))
+      .output(MatchAll(), HasRank({1, 2}))
+      .output(MatchAll(), HasMap(keepsOneDim))
+      .region(MatchOne(0), [](Region *region, Operation *op) {
+        return hasSumOfSquaresBody(op, /*centered=*/false);
+      });
+  // clang-format on
+  if (!isTppOp(linalgOp) || linalgOp.getNumReductionLoops() != 1 ||
+      !reduceMatcher.match(linalgOp)) {
+    return false;
+  }
+  if (operands) {
+    operands->push_back(linalgOp.getDpsInputs()[0]);
+    operands->push_back(linalgOp.getDpsInits()[0]);
+  }
+  return true;
+}
+
+bool isTwoDReduceSquaredDiffOp(linalg::LinalgOp linalgOp,
+                               SmallVectorImpl<Value> *operands) {
+  // clang-format off
+  auto reduceMatcher =
+    StructuredOpMatcher::make<linalg::LinalgOp>()
+      .operation(NumDpsInits(EqualsTo(1)))
+      .operation(NumDpsInputs(EqualsTo(2)))
+      .operation(NumOfLoops(EqualsTo(2)))
+      .input(MatchOne(0), HasRank({2}))
+      .input(MatchOne(0), HasMap(Identity()))
+      .input(MatchOne(1), HasRank({1, 2}))
+      .input(MatchOne(1), HasMap(keepsOneDim))
+      .output(MatchAll(), HasRank({1, 2}))
+      .output(MatchAll(), HasMap(keepsOneDim))
+      .region(MatchOne(0), [](Region *region, Operation *op) {
+        return hasSumOfSquaresBody(op, /*centered=*/true);
+      });
+  // clang-format on
+  if (!isTppOp(linalgOp) || linalgOp.getNumReductionLoops() != 1 ||
+      !reduceMatcher.match(linalgOp)) {
+    return false;
+  }
+  // The subtrahend is broadcast along the reduced dimension.
+  if (linalgOp.getMatchingIndexingMap(linalgOp.getDpsInputOperand(1)) !=
+      linalgOp.getMatchingIndexingMap(linalgOp.getDpsInitOperand(0))) {
+    return false;
+  }
+  if (operands) {
+    operands->push_back(linalgOp.getDpsInputs()[0]);
+    operands->push_back(linalgOp.getDpsInputs()[1]);
+    operands->push_back(linalgOp.getDpsInits()[0]);
+  }
+  return true;
+}
+
 static bool hasReluBody(Operation *op, SmallVectorImpl<Value> *captured) {
   if (!isa<linalg::LinalgOp>(op))
     return false;
@@ -381,6 +599,20 @@ bool isTwoDIdentityOp(linalg::LinalgOp linalgOp,
   return true;
 }
 
+// Return true if the linalg.generic can be mapped to a tpp.exp.
+bool isTwoDExpOp(linalg::LinalgOp linalgOp, SmallVectorImpl<Value> *operands) {
+  // clang-format off
+  auto expMatcher =
+    StructuredOpMatcher::make<linalg::LinalgOp>()
+    .output(MatchAll(), HasMap(Identity()))
+    .input(MatchAll(), HasMap(BroadcastableProjectedPermutation()))
+    .region(MatchOne(0), [&](Region *region, Operation *op) {
+      return hasUnaryBody<math::ExpOp>(op, operands);
+    });
+  // clang-format on
+  return isTppUnaryOp(linalgOp) && expMatcher.match(linalgOp);
+}
+
 // Return true if the linalg.generic can be mapped to a tpp.zero.
 bool isTwoDZeroOp(linalg::LinalgOp linalgOp, SmallVectorImpl<Value> *operands) {
   // clang-format off
@@ -432,6 +664,30 @@ bool isTwoDBiasReluOp(linalg::LinalgOp linalgOp,
   return true;
 }
 
+// Return true if the linalg.generic can be mapped to a tpp.sub + tpp.exp, as
+// the numerator of a softmax.
+bool isTwoDSubExpOp(linalg::LinalgOp linalgOp,
+                    SmallVectorImpl<Value> *operands) {
+  // clang-format off
+  auto subExpMatcher =
+    StructuredOpMatcher::make<linalg::LinalgOp>()
+      .operation(NumDpsInputs(EqualsTo(2)))
+      .region(MatchOne(0), WithOpChain<arith::SubFOp, math::ExpOp>(operands));
+  // clang-format on
+
+  if (!isTppBinaryOp(linalgOp) || !subExpMatcher.match(linalgOp))
+    return false;
+
+  // Take the output as the exponentiation is applied in-place on it.
+  Value output = linalgOp.getDpsInits()[0];
+  if (!isa<ShapedType>(output.getType()))
+    return false;
+
+  if (operands)
+    operands->push_back(output);
+  return true;
+}
+
 bool isTwoDTransposeOp(linalg::LinalgOp linalgOp,
                        SmallVectorImpl<Value> *operands) {
   // clang-format off
@@ -471,6 +727,312 @@ bool isTwoDFillOpWithZeros(linalg::LinalgOp linalgOp, SmallVectorImpl<Value> *op
   return true;
 }
 
+// Return the table read by the body of `linalgOp` at the row given by its
+// index input and at the column of its innermost loop, if the body only reads
+// it, yielding the element for a gather or adding it to the output for a bag.
+static Value getEmbeddingTable(linalg::LinalgOp linalgOp, bool isBag) {
+  Block *body = linalgOp.getBlock();
+  Value row = linalgOp.getMatchingBlockArgument(linalgOp.getDpsInputOperand(0));
+  Value acc = linalgOp.getMatchingBlockArgument(linalgOp.getDpsInitOperand(0));
+  Operation *yieldOp = body->getTerminator();
+  if (yieldOp->getNumOperands() != 1)
+    return nullptr;
+  Value element = yieldOp->getOperand(0);
+  if (isBag) {
+    auto addOp = element.getDefiningOp<arith::AddFOp>();
+    if (!addOp || (addOp.getLhs() != acc && addOp.getRhs() != acc))
+      return nullptr;
+    element = addOp.getLhs() == acc ? addOp.getRhs() : addOp.getLhs();
+  }
+
+  Value table;
+  SmallVector<Value, 2> coordinates;
+  if (auto extractOp = element.getDefiningOp<tensor::ExtractOp>()) {
+    table = extractOp.getTensor();
+    coordinates = llvm::to_vector(extractOp.getIndices());
+  } else if (auto loadOp = element.getDefiningOp<memref::LoadOp>()) {
+    table = loadOp.getMemRef();
+    coordinates = llvm::to_vector(loadOp.getIndices());
+  } else {
+    return nullptr;
+  }
+  if (coordinates.size() != 2 ||
+      linalgOp->isAncestor(table.getParentRegion()->getParentOp())) {
+    return nullptr;
+  }
+
+  // Index cast of the row, index of the column, read, add and yield.
+  int64_t numOps = isBag ? 4 : 3;
+  if (auto castOp = coordinates[0].getDefiningOp<arith::IndexCastOp>()) {
+    coordinates[0] = castOp.getIn();
+    numOps++;
+  }
+  auto colOp = coordinates[1].getDefiningOp<linalg::IndexOp>();
+  if (coordinates[0] != row || !colOp ||
+      colOp.getDim() != linalgOp.getNumLoops() - 1 ||
+      std::distance(body->begin(), body->end()) != numOps) {
+    return nullptr;
+  }
+  return table;
+}
+
+bool isEmbeddingBagOp(linalg::LinalgOp linalgOp,
+                      SmallVectorImpl<Value> *operands) {
+  if (linalgOp.getNumDpsInputs() != 1 || linalgOp.getNumDpsInits() != 1)
+    return false;
+  unsigned numLoops = linalgOp.getNumLoops();
+  bool isBag = numLoops == 3;
+  if (numLoops != 2 && !isBag)
+    return false;
+  SmallVector<mlir::utils::IteratorType> iterators =
+      linalgOp.getIteratorTypesArray();
+  if (iterators.front() != mlir::utils::IteratorType::parallel ||
+      iterators.back() != mlir::utils::IteratorType::parallel ||
+      (isBag && iterators[1] != mlir::utils::IteratorType::reduction)) {
+    return false;
+  }
+
+  // (bag, [lookup,] col) -> (bag, [lookup]) for the indices and
+  // (bag, [lookup,] col) -> (bag, col) for the output.
+  MLIRContext *ctx = linalgOp.getContext();
+  SmallVector<AffineExpr> indexExprs = {getAffineDimExpr(0, ctx)};
+  if (isBag)
+    indexExprs.push_back(getAffineDimExpr(1, ctx));
+  SmallVector<AffineExpr> outputExprs = {getAffineDimExpr(0, ctx),
+                                         getAffineDimExpr(numLoops - 1, ctx)};
+  OpOperand *indices = linalgOp.getDpsInputOperand(0);
+  OpOperand *output = linalgOp.getDpsInitOperand(0);
+  if (linalgOp.getMatchingIndexingMap(indices) !=
+          AffineMap::get(numLoops, 0, indexExprs, ctx) ||
+      linalgOp.getMatchingIndexingMap(output) !=
+          AffineMap::get(numLoops, 0, outputExprs, ctx)) {
+    return false;
+  }
+
+  auto indicesType = dyn_cast<ShapedType>(indices->get().getType());
+  auto outputType = dyn_cast<ShapedType>(output->get().getType());
+  if (!indicesType || !outputType || !indicesType.hasStaticShape() ||
+      !outputType.hasStaticShape() ||
+      !isa<IntegerType, IndexType>(indicesType.getElementType()) ||
+      !isa<FloatType>(outputType.getElementType())) {
+    return false;
+  }
+
+  Value table = getEmbeddingTable(linalgOp, isBag);
+  if (!table)
+    return false;
+  auto tableType = cast<ShapedType>(table.getType());
+  if (!tableType.hasStaticShape() ||
+      tableType.getElementType() != outputType.getElementType() ||
+      tableType.getShape()[1] != outputType.getShape()[1]) {
+    return false;
+  }
+  if (operands) {
+    operands->push_back(table);
+    operands->push_back(indices->get());
+    operands->push_back(output->get());
+  }
+  return true;
+}
+
+// Returns true if `value` is the product of `lhs` and `rhs`, in any order.
+static bool isMulOf(Value value, Value lhs, Value rhs) {
+  auto mulOp = value.getDefiningOp<arith::MulFOp>();
+  return mulOp && ((mulOp.getLhs() == lhs && mulOp.getRhs() == rhs) ||
+                   (mulOp.getLhs() == rhs && mulOp.getRhs() == lhs));
+}
+
+// Returns the factor of the product `value` other than `factor`, null if it
+// is not such a product.
+static Value getOtherFactor(Value value, Value factor) {
+  auto mulOp = value.getDefiningOp<arith::MulFOp>();
+  if (!mulOp)
+    return nullptr;
+  if (mulOp.getLhs() == factor)
+    return mulOp.getRhs();
+  if (mulOp.getRhs() == factor)
+    return mulOp.getLhs();
+  return nullptr;
+}
+
+// Returns the block argument of the table `value` is read from, directly or
+// computed by `TrigOp` of angles, in which case `isComputed` is set.
+template <typename TrigOp>
+static BlockArgument getTableArgument(Value value, bool &isComputed) {
+  if (auto trigOp = value.getDefiningOp<TrigOp>()) {
+    isComputed = true;
+    value = trigOp.getOperand();
+  }
+  return dyn_cast<BlockArgument>(value);
+}
+
+// Returns true if `cond` compares `linalg.index` of the last loop with 0 or
+// 1, and sets `isFirst` to whether it holds on the first element of a pair.
+static bool getPairSelector(Value cond, unsigned lastLoop, bool &isFirst) {
+  auto cmpOp = cond.getDefiningOp<arith::CmpIOp>();
+  if (!cmpOp || (cmpOp.getPredicate() != arith::CmpIPredicate::eq &&
+                 cmpOp.getPredicate() != arith::CmpIPredicate::ne))
+    return false;
+  Value index = cmpOp.getLhs();
+  Value other = cmpOp.getRhs();
+  if (!index.getDefiningOp<linalg::IndexOp>())
+    std::swap(index, other);
+  auto indexOp = index.getDefiningOp<linalg::IndexOp>();
+  std::optional<int64_t> element = getConstantIntValue(other);
+  if (!indexOp || indexOp.getDim() != lastLoop || !element ||
+      (*element != 0 && *element != 1))
+    return false;
+  isFirst = (cmpOp.getPredicate() == arith::CmpIPredicate::eq) ==
+            (*element == 0);
+  return true;
+}
+
+bool isRotaryEmbeddingOp(linalg::LinalgOp linalgOp,
+                         SmallVectorImpl<Value> *operands) {
+  unsigned numInputs = linalgOp.getNumDpsInputs();
+  if ((numInputs != 3 && numInputs != 4) || linalgOp.getNumDpsInits() != 1 ||
+      linalgOp.getNumLoops() < 2 ||
+      linalgOp.getNumParallelLoops() != linalgOp.getNumLoops())
+    return false;
+  OpOperand *first = linalgOp.getDpsInputOperand(0);
+  OpOperand *second = linalgOp.getDpsInputOperand(1);
+  OpOperand *output = linalgOp.getDpsInitOperand(0);
+  auto outputType = dyn_cast<ShapedType>(output->get().getType());
+  if (first->get() != second->get() || !outputType ||
+      !outputType.hasStaticShape() || outputType.getShape().back() != 2 ||
+      !isa<FloatType>(outputType.getElementType()) ||
+      first->get().getType() != outputType)
+    return false;
+
+  // (d0, ..., dn) -> (d0, ..., 0) and (d0, ..., 1) for the pairs, the tables
+  // do not depend on the last loop.
+  unsigned numLoops = linalgOp.getNumLoops();
+  unsigned lastLoop = numLoops - 1;
+  MLIRContext *ctx = linalgOp.getContext();
+  auto getPairMap = [&](int64_t element) {
+    SmallVector<AffineExpr> exprs;
+    for (unsigned dim : llvm::seq<unsigned>(0, lastLoop))
+      exprs.push_back(getAffineDimExpr(dim, ctx));
+    exprs.push_back(getAffineConstantExpr(element, ctx));
+    return AffineMap::get(numLoops, 0, exprs, ctx);
+  };
+  if (linalgOp.getMatchingIndexingMap(first) != getPairMap(0) ||
+      linalgOp.getMatchingIndexingMap(second) != getPairMap(1) ||
+      !linalgOp.getMatchingIndexingMap(output).isIdentity())
+    return false;
+  for (unsigned idx : llvm::seq<unsigned>(2, numInputs)) {
+    AffineMap map =
+        linalgOp.getMatchingIndexingMap(linalgOp.getDpsInputOperand(idx));
+    if (!map.isProjectedPermutation() || map.isFunctionOfDim(lastLoop))
+      return false;
+  }
+
+  // select(first element, x0 * cos - x1 * sin, x0 * sin + x1 * cos)
+  Block *body = linalgOp.getBlock();
+  if (std::distance(body->begin(), body->end()) > 14)
+    return false;
+  Value x0 = body->getArgument(0);
+  Value x1 = body->getArgument(1);
+  auto yieldOp = cast<linalg::YieldOp>(body->getTerminator());
+  auto selectOp = yieldOp.getOperand(0).getDefiningOp<arith::SelectOp>();
+  bool isFirst;
+  if (!selectOp ||
+      !getPairSelector(selectOp.getCondition(), lastLoop, isFirst))
+    return false;
+  Value rotated0 = selectOp.getTrueValue();
+  Value rotated1 = selectOp.getFalseValue();
+  if (!isFirst)
+    std::swap(rotated0, rotated1);
+  auto subOp = rotated0.getDefiningOp<arith::SubFOp>();
+  auto addOp = rotated1.getDefiningOp<arith::AddFOp>();
+  if (!subOp || !addOp)
+    return false;
+  Value cos = getOtherFactor(subOp.getLhs(), x0);
+  Value sin = getOtherFactor(subOp.getRhs(), x1);
+  if (!cos || !sin ||
+      !((isMulOf(addOp.getLhs(), x0, sin) &&
+         isMulOf(addOp.getRhs(), x1, cos)) ||
+        (isMulOf(addOp.getLhs(), x1, cos) &&
+         isMulOf(addOp.getRhs(), x0, sin))))
+    return false;
+
+  // The tables are the other inputs, the same angles if computed.
+  bool isCosComputed = false;
+  bool isSinComputed = false;
+  BlockArgument cosArg = getTableArgument<math::CosOp>(cos, isCosComputed);
+  BlockArgument sinArg = getTableArgument<math::SinOp>(sin, isSinComputed);
+  if (!cosArg || !sinArg || cosArg.getOwner() != body ||
+      sinArg.getOwner() != body || isCosComputed != isSinComputed ||
+      (isCosComputed ? numInputs != 3 || cosArg != sinArg
+                     : numInputs != 4 || cosArg == sinArg) ||
+      cosArg.getArgNumber() < 2 || cosArg.getArgNumber() >= numInputs ||
+      sinArg.getArgNumber() < 2 || sinArg.getArgNumber() >= numInputs)
+    return false;
+
+  if (operands) {
+    operands->push_back(first->get());
+    operands->push_back(linalgOp->getOperand(cosArg.getArgNumber()));
+    operands->push_back(linalgOp->getOperand(sinArg.getArgNumber()));
+    operands->push_back(output->get());
+  }
+  return true;
+}
+
+static bool matchesKind(linalg::LinalgOp linalgOp, OpKind kind,
+                        SmallVectorImpl<Value> *operands) {
+  switch (kind) {
+  case OpKind::Add:
+    return isTwoDAddOp(linalgOp, operands);
+  case OpKind::Sub:
+    return isTwoDSubOp(linalgOp, operands);
+  case OpKind::Mul:
+    return isTwoDMulOp(linalgOp, operands);
+  case OpKind::Div:
+    return isTwoDDivOp(linalgOp, operands);
+  case OpKind::ReduceAdd:
+    return isTwoDReduceAddOp(linalgOp, operands);
+  case OpKind::ReduceMax:
+    return isTwoDReduceMaxOp(linalgOp, operands);
+  case OpKind::ReduceSquare:
+    return isTwoDReduceSquareOp(linalgOp, operands);
+  case OpKind::ReduceSquaredDiff:
+    return isTwoDReduceSquaredDiffOp(linalgOp, operands);
+  case OpKind::Zero:
+    return isTwoDZeroOp(linalgOp, operands);
+  case OpKind::Relu:
+    return isTwoDReluOp(linalgOp, operands);
+  case OpKind::Exp:
+    return isTwoDExpOp(linalgOp, operands);
+  case OpKind::SubExp:
+    return isTwoDSubExpOp(linalgOp, operands);
+  case OpKind::Identity:
+    return isTwoDIdentityOp(linalgOp, operands);
+  case OpKind::BiasRelu:
+    return isTwoDBiasReluOp(linalgOp, operands);
+  case OpKind::Transpose:
+    return isTwoDTransposeOp(linalgOp, operands);
+  case OpKind::FillWithZeros:
+    return isTwoDFillOpWithZeros(linalgOp, operands);
+  case OpKind::EmbeddingBag:
+    return isEmbeddingBagOp(linalgOp, operands);
+  case OpKind::RotaryEmbedding:
+    return isRotaryEmbeddingOp(linalgOp, operands);
+  }
+  llvm_unreachable("unknown op kind");
+}
+
+bool isOpOfKind(linalg::LinalgOp linalgOp, OpKind kind,
+                SmallVectorImpl<Value> *operands) {
+  // The predicates may capture some operands before failing.
+  if (!operands)
+    return matchesKind(linalgOp, kind, nullptr);
+  SmallVector<Value> captured;
+  if (!matchesKind(linalgOp, kind, &captured))
+    return false;
+  operands->append(captured.begin(), captured.end());
+  return true;
+}
+
 } // namespace utils
 } // namespace structured_match
 } // namespace mlir
@@ -0,0 +1,62 @@
+//===- OpClassification.cpp --------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/IR/OpClassification.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+
+namespace mlir {
+namespace structured_match {
+
+static_assert(static_cast<unsigned>(utils::OpKind::RotaryEmbedding) < 32,
+              "one bit per kind");
+
+bool OpClassification::isOpOfKind(linalg::LinalgOp linalgOp,
+                                  utils::OpKind kind,
+                                  SmallVectorImpl<Value> *capturedOperands) {
+  uint32_t bit = 1u << static_cast<unsigned>(kind);
+  Classes &opClasses = classes[linalgOp];
+  if (opClasses.tried & bit) {
+    if (!(opClasses.matched & bit))
+      return false;
+    if (!capturedOperands)
+      return true;
+  }
+
+  bool matched = utils::isOpOfKind(linalgOp, kind, capturedOperands);
+  opClasses.tried |= bit;
+  if (matched)
+    opClasses.matched |= bit;
+  return matched;
+}
+
+void OpClassification::forget(Operation *op) {
+  for (Operation *parent = op; parent; parent = parent->getParentOp())
+    classes.erase(parent);
+  for (Operation *user : op->getUsers())
+    classes.erase(user);
+}
+
+void OpClassification::notifyOperationInserted(
+    Operation *op, OpBuilder::InsertPoint previous) {
+  // Moved operations may change the body they leave.
+  if (previous.isSet() && previous.getBlock()->getParentOp())
+    forget(previous.getBlock()->getParentOp());
+  if (Operation *parent = op->getParentOp())
+    forget(parent);
+}
+
+void OpClassification::notifyOperationModified(Operation *op) { forget(op); }
+
+void OpClassification::notifyOperationErased(Operation *op) {
+  // The address may be reused by a new operation.
+  op->walk([&](Operation *nested) { classes.erase(nested); });
+  forget(op);
+}
+
+} // namespace structured_match
+} // namespace mlir
@@ -60,10 +60,12 @@ private:
     pm.addNestedPass<func::FuncOp>(createLoopInvariantCodeMotionPass());
     // Run cleanup after LICM to allow CSE to eliminate common operations now
     // that they are hoisted out of loops.
-    pm.addPass(createCleanup());
+    pm.addNestedPass<func::FuncOp>(createCleanup());
 
     mlir::tpp::SCFParallelLoopTilingOptions tilingOptions;
     tilingOptions.tileSizes = SmallVector<unsigned>{*parallelTaskGrid};
-    pm.addPass(createSCFParallelLoopTiling(tilingOptions));
+    tilingOptions.distributeLastDim = distributeLastDim;
+    tilingOptions.tileTraversal = tileTraversal;
+    pm.addNestedPass<func::FuncOp>(createSCFParallelLoopTiling(tilingOptions));
   }
 };
@@ -8,9 +8,12 @@
 
 #include "TPP/PassBundles.h"
 
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Bufferization/IR/Bufferization.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
 #include "mlir/Dialect/Linalg/Passes.h"
+#include "mlir/Dialect/Math/IR/Math.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/Dialect/Tensor/IR/Tensor.h"
@@ -53,16 +56,39 @@ struct TppMapping : public tpp::impl::TppMappingBase<TppMapping>,
 
 private:
   void constructPipeline() override {
+    // Consecutive function passes share one nested pipeline, which runs on
+    // the functions in parallel. Only ConstantFoldPack and CacheInvariantPacks
+    // need the whole module.
+
     // Preprocess convolutions.
     pm.addPass(createConvInitSimplify());
-    pm.addPass(createCleanup());
+    pm.addNestedPass<func::FuncOp>(createFoldBatchNorm());
+    pm.addNestedPass<func::FuncOp>(createCleanup());
+    // Rewrite the 3x3 stride-1 convolutions as a batch matmul between their
+    // Winograd transforms, before the remaining ones get packed.
+    if (winogradConv)
+      pm.addNestedPass<func::FuncOp>(createWinogradConv2D());
 
     // Convert ops to packed layouts.
+    pm.addPass(createPackGroupedConv());
     pm.addPass(createPackConv2DNhwcHwcf());
     pm.addPass(createPackConv2DNchwFchw());
     pm.addPass(createRewriteConvToMatmulOrBrgemm());
-    pm.addPass(createPackMatmul());
-    pm.addPass(createPackVNNI());
+    // Padded matmuls are packed with full blocks, the remaining ones can
+    // still be peeled.
+    if (padMatmuls) {
+      pm.addPass(createPadMatmul(
+          PadMatmulOptions{SmallVector<int64_t>{*matmulBlockFactors},
+                           matmulCostModel}));
+    }
+    pm.addPass(createPackMatmul(
+        PackMatmulOptions{SmallVector<int64_t>{*matmulBlockFactors},
+                          matmulCostModel, /*gemvMaxRows=*/1,
+                          peelRemainders}));
+    pm.addPass(createPackVNNI(PackVNNIOptions{bf16F32Compute}));
+    // Pack the quantized weights rather than their dequantized floats.
+    if (fuseDequantize)
+      pm.addNestedPass<func::FuncOp>(createPackQuantizedWeights());
 
     if (lowerPackUnpackWithoutTranspose) {
       pm.addPass(createLowerPacksAndUnpacksWithoutTranspose());
@@ -71,17 +97,64 @@ private:
     // Run only canonicalizer at this stage as full cleanup (mostly CSE) can
     // mess up tensor producer-consumer chains used for analysis in the
     // following passes.
-    pm.addPass(createPropagatePackUnPack());
+    pm.addPass(createPropagatePackUnPack(
+        PropagatePackUnPackOptions{reportResidualLayouts}));
     pm.addPass(createConstantFoldPack());
+    // Store the folded int4 weights two per byte.
+    if (fuseDequantize)
+      pm.addNestedPass<func::FuncOp>(createPackInt4Weights());
+    pm.addPass(createCacheInvariantPacks());
     pm.addPass(createSimplifyAndCanonicalizePack());
 
     pm.addNestedPass<func::FuncOp>(createLinalgGeneralizeNamedOpsPass());
-    pm.addPass(createCleanup());
+    pm.addNestedPass<func::FuncOp>(createCleanup());
     pm.addNestedPass<func::FuncOp>(
         createLinalgConvertCompareSelectToMaximumfPass());
 
-    pm.addPass(createTileConsumerAndFuseProducers());
+    // Fuse attention before its contractions get tiled on their own.
+    if (fuseAttention) {
+      FuseAttentionOptions fuseAttentionOptions;
+      fuseAttentionOptions.kvSplit = attentionKvSplit;
+      pm.addNestedPass<func::FuncOp>(
+          createFuseAttention(fuseAttentionOptions));
+    }
+
+    // Fuse normalizations, with their producer contractions, before the
+    // contractions get tiled on their own.
+    if (fuseNormalization)
+      pm.addNestedPass<func::FuncOp>(createFuseNormalization());
+
+    // Fuse the argmax of the logits into the contraction computing them,
+    // over blocks of the vocabulary.
+    if (fuseTopK)
+      pm.addNestedPass<func::FuncOp>(createFuseTopK());
+
+    // Group the matmuls of the experts, whose rows are only known at
+    // runtime, into balanced tiles before the static ones get tiled.
+    if (groupExpertMatmuls)
+      pm.addNestedPass<func::FuncOp>(createGroupExpertMatmuls());
+
+    // Rotate the queries and keys on the row blocks of their projections,
+    // with the sines and cosines of constant angles folded into tables.
+    if (fuseRotaryEmbedding)
+      pm.addNestedPass<func::FuncOp>(createFuseRotaryEmbedding());
+
+    // Distribute the reduction of skinny matmuls, and of the last wave of
+    // tiles with stream-K, before their tiling.
+    if (splitKThreads != 0) {
+      pm.addNestedPass<func::FuncOp>(createSplitKReduction(
+          SplitKReductionOptions{splitKThreads, streamK,
+                                 splitKMinTilesPerThread}));
+    }
+
+    TileConsumerAndFuseProducersOptions tilingOptions;
+    tilingOptions.outerTileSizes = SmallVector<int64_t>{*fusionOuterTiles};
+    tilingOptions.batchGroupSize = batchMatmulGroupSize;
+    tilingOptions.fuseLhsPack = fuseLhsPack;
+    tilingOptions.fuseDequantize = fuseDequantize;
+    tilingOptions.fuseLayers = fuseLayers;
+    pm.addPass(createTileConsumerAndFuseProducers(tilingOptions));
     pm.addPass(createSimplifyAndCanonicalizePack());
-    pm.addPass(createCleanup());
+    pm.addNestedPass<func::FuncOp>(createCleanup());
   }
 };
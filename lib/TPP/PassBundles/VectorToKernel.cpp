@@ -6,9 +6,11 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "mlir/Dialect/AMX/AMXDialect.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/Dialect/Vector/IR/VectorOps.h"
+#include "mlir/Dialect/X86Vector/X86VectorDialect.h"
 #include "mlir/IR/BuiltinOps.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Pass/PassManager.h"
@@ -34,6 +36,8 @@ namespace tpp {
 // specialized micro-kernels akin to libxsmm kernels.
 struct VectorToKernel : public tpp::impl::VectorToKernelBase<VectorToKernel>,
                     PassBundle<ModuleOp> {
+  using VectorToKernelBase::VectorToKernelBase;
+
   void runOnOperation() override {
     auto module = getOperation();
 
@@ -49,8 +53,18 @@ struct VectorToKernel : public tpp::impl::VectorToKernelBase<VectorToKernel>,
 
 private:
   void constructPipeline() override {
+    // Before the contractions are unrolled, the epilogues are still short.
+    if (mathApprox != "none")
+      pm.addNestedPass<func::FuncOp>(
+          createMathApproximation(MathApproximationOptions{mathApprox}));
+    // SME accumulates in the ZA tiles, before the accumulator is hoisted
+    // into registers.
+    pm.addNestedPass<func::FuncOp>(createVectorContractToOuterproduct(
+        VectorContractToOuterproductOptions{/*sme=*/true}));
     pm.addNestedPass<func::FuncOp>(createHoistVectorTransfers());
     pm.addNestedPass<func::FuncOp>(createCanonicalizerPass());
-    pm.addNestedPass<func::FuncOp>(createVectorContractToFMA());
+    pm.addNestedPass<func::FuncOp>(createVectorContractToAMX());
+    pm.addNestedPass<func::FuncOp>(createVectorContractToFMA(
+        VectorContractToFMAOptions{nontemporalStores}));
   }
 };
@@ -0,0 +1,541 @@
+//===- Engine.cpp - Embeddable compile-and-execute API -----------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Runner/Engine.h"
+
+#include "TPP/Dialect/Check/CheckDialect.h"
+#include "TPP/Dialect/Perf/PerfDialect.h"
+#include "TPP/Dialect/Xsmm/XsmmDialect.h"
+#include "TPP/PassBundles.h"
+#include "TaskRunnerUtils.h"
+
+#include "mlir/Dialect/Bufferization/IR/Bufferization.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/LLVMIR/LLVMDialect.h"
+#include "mlir/ExecutionEngine/OptUtils.h"
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/BuiltinTypes.h"
+#include "mlir/InitAllDialects.h"
+#include "mlir/InitAllExtensions.h"
+#include "mlir/Parser/Parser.h"
+#include "mlir/Pass/PassManager.h"
+#include "mlir/Target/LLVMIR/Dialect/All.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/SHA256.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+namespace {
+
+// Returns the buffer of a kernel argument or result type, if the entry point
+// can pass it.
+std::optional<KernelBuffer> getKernelBuffer(Type type) {
+  auto shapedType = dyn_cast<ShapedType>(type);
+  if (!shapedType || !shapedType.hasStaticShape())
+    return std::nullopt;
+  if (auto tensorType = dyn_cast<RankedTensorType>(type)) {
+    if (tensorType.getEncoding())
+      return std::nullopt;
+  } else if (auto memrefType = dyn_cast<MemRefType>(type)) {
+    if (!memrefType.getLayout().isIdentity() || memrefType.getMemorySpace())
+      return std::nullopt;
+  } else {
+    return std::nullopt;
+  }
+
+  Type elementType = shapedType.getElementType();
+  if (!elementType.isIntOrFloat() ||
+      elementType.getIntOrFloatBitWidth() % 8 != 0)
+    return std::nullopt;
+  ElementKind elementKind = ElementKind::Integer;
+  if (elementType.isBF16())
+    elementKind = ElementKind::BFloat;
+  else if (isa<FloatType>(elementType))
+    elementKind = ElementKind::Float;
+  return KernelBuffer{SmallVector<int64_t>(shapedType.getShape()),
+                      elementType.getIntOrFloatBitWidth() / 8, elementKind};
+}
+
+// Returns true if `dtype` is the element type of `buffer`.
+bool matchesDLDataType(const DLDataType &dtype, const KernelBuffer &buffer) {
+  if (dtype.lanes != 1 || dtype.bits != buffer.elementBytes * 8)
+    return false;
+  switch (buffer.elementKind) {
+  case ElementKind::Float:
+    return dtype.code == kDLFloat;
+  case ElementKind::BFloat:
+    return dtype.code == kDLBfloat;
+  case ElementKind::Integer:
+    return dtype.code == kDLInt || dtype.code == kDLUInt ||
+           dtype.code == kDLBool;
+  }
+  return false;
+}
+
+// Returns true if the elements of `tensor` are in row-major order without
+// gaps, the layout of the kernel buffers. The strides of the unit dimensions
+// do not matter.
+bool isRowMajor(const DLTensor &tensor) {
+  if (!tensor.strides)
+    return true;
+  int64_t stride = 1;
+  for (int32_t dim = tensor.ndim - 1; dim >= 0; dim--) {
+    if (tensor.shape[dim] != 1 && tensor.strides[dim] != stride)
+      return false;
+    stride *= tensor.shape[dim];
+  }
+  return true;
+}
+
+// Returns the strides of the row-major layout of `shape`, in elements.
+SmallVector<int64_t> getRowMajorStrides(ArrayRef<int64_t> shape) {
+  SmallVector<int64_t> strides(shape.size(), 1);
+  for (int64_t dim = static_cast<int64_t>(shape.size()) - 2; dim >= 0; dim--)
+    strides[dim] = strides[dim + 1] * shape[dim + 1];
+  return strides;
+}
+
+// Copies the elements of `shape` from `src` to `dst`, with their strides in
+// elements.
+void copyStrided(char *dst, const int64_t *dstStrides, const char *src,
+                 const int64_t *srcStrides, ArrayRef<int64_t> shape,
+                 unsigned elementBytes) {
+  if (shape.empty()) {
+    std::memcpy(dst, src, elementBytes);
+    return;
+  }
+  if (shape.size() == 1 && dstStrides[0] == 1 && srcStrides[0] == 1) {
+    std::memcpy(dst, src, shape[0] * elementBytes);
+    return;
+  }
+  for (int64_t i = 0; i < shape[0]; i++)
+    copyStrided(dst + i * dstStrides[0] * elementBytes, dstStrides + 1,
+                src + i * srcStrides[0] * elementBytes, srcStrides + 1,
+                shape.drop_front(), elementBytes);
+}
+
+// Packed copy of a DLPack tensor the kernel cannot use in place.
+struct PackedCopy {
+  struct Free {
+    void operator()(char *data) const { std::free(data); }
+  };
+
+  std::unique_ptr<char, Free> data;
+  const DLTensor *tensor;
+  const KernelBuffer *buffer;
+};
+
+// Sets the registered options of the default pipeline, the pipeline reads
+// them when it is built. Returns the options set, to reset them once done.
+FailureOr<SmallVector<llvm::cl::Option *>> applyPipelineOptions(
+    ArrayRef<std::pair<std::string, std::string>> pipelineOptions) {
+  auto &registered = llvm::cl::getRegisteredOptions();
+  SmallVector<llvm::cl::Option *> applied;
+  for (const auto &[name, value] : pipelineOptions) {
+    llvm::cl::Option *option = registered.lookup(name);
+    if (!option) {
+      llvm::errs() << "Error: unknown pipeline option " << name << "\n";
+      for (llvm::cl::Option *set : applied)
+        set->reset();
+      return failure();
+    }
+    option->reset();
+    applied.push_back(option);
+    SmallVector<StringRef> values;
+    if (option->getMiscFlags() & llvm::cl::CommaSeparated)
+      StringRef(value).split(values, ',');
+    else
+      values.push_back(value);
+    for (StringRef optionValue : values) {
+      // The option prints the error.
+      if (option->addOccurrence(/*pos=*/0, name, optionValue)) {
+        for (llvm::cl::Option *set : applied)
+          set->reset();
+        return failure();
+      }
+    }
+  }
+  return applied;
+}
+
+} // namespace
+
+int64_t KernelBuffer::getNumBytes() const {
+  int64_t bytes = elementBytes;
+  for (int64_t dim : shape)
+    bytes *= dim;
+  return bytes;
+}
+
+FailureOr<KernelSignature> mlir::tpp::createKernelEntry(ModuleOp module,
+                                                        StringRef kernelName) {
+  auto kernel = module.lookupSymbol<func::FuncOp>(kernelName);
+  if (!kernel || kernel.isDeclaration())
+    return module.emitOpError("Kernel function not found: " + kernelName);
+
+  // Results returned as memrefs belong to the kernel, only tensor results are
+  // written in place.
+  KernelSignature signature;
+  signature.entryName = ("_tpp_entry_" + kernelName).str();
+  FunctionType kernelType = kernel.getFunctionType();
+  SmallVector<Type> bufferTypes;
+  for (Type type : kernelType.getInputs()) {
+    auto buffer = getKernelBuffer(type);
+    if (!buffer)
+      return kernel.emitOpError("Unsupported kernel argument of type ")
+             << type;
+    buffer->inPlace = isa<MemRefType>(type);
+    signature.args.push_back(*buffer);
+    bufferTypes.push_back(MemRefType::get(
+        buffer->shape, cast<ShapedType>(type).getElementType()));
+  }
+  for (Type type : kernelType.getResults()) {
+    auto buffer = getKernelBuffer(type);
+    if (!buffer || !isa<RankedTensorType>(type))
+      return kernel.emitOpError("Unsupported kernel result of type ") << type;
+    buffer->inPlace = true;
+    signature.results.push_back(*buffer);
+    bufferTypes.push_back(MemRefType::get(
+        buffer->shape, cast<ShapedType>(type).getElementType()));
+  }
+
+  MLIRContext *ctx = module.getContext();
+  ctx->getOrLoadDialect<bufferization::BufferizationDialect>();
+  OpBuilder builder(ctx);
+  builder.setInsertionPointToEnd(module.getBody());
+  Location loc = kernel.getLoc();
+  auto entry = builder.create<func::FuncOp>(
+      loc, signature.entryName, builder.getFunctionType(bufferTypes, {}));
+  entry->setAttr(LLVM::LLVMDialect::getEmitCWrapperAttrName(),
+                 builder.getUnitAttr());
+  Block *block = entry.addEntryBlock();
+  builder.setInsertionPointToStart(block);
+
+  // The tensors are the buffers themselves, so that bufferization neither
+  // allocates nor copies the inputs.
+  SmallVector<Value> operands;
+  for (auto [type, buffer] :
+       llvm::zip(kernelType.getInputs(), block->getArguments())) {
+    if (isa<MemRefType>(type)) {
+      operands.push_back(buffer);
+      continue;
+    }
+    operands.push_back(builder.create<bufferization::ToTensorOp>(
+        loc, buffer, /*restrict=*/true, /*writable=*/true));
+  }
+  auto call = builder.create<func::CallOp>(loc, kernel, operands);
+  auto resultBuffers =
+      block->getArguments().drop_front(kernelType.getNumInputs());
+  for (auto [result, buffer] : llvm::zip(call.getResults(), resultBuffers))
+    builder.create<bufferization::MaterializeInDestinationOp>(
+        loc, /*result=*/Type(), result, buffer, /*restrict=*/true,
+        /*writable=*/true);
+  builder.create<func::ReturnOp>(loc);
+  return signature;
+}
+
+SmallVector<int64_t>
+mlir::tpp::createMemRefDescriptor(void *data, ArrayRef<int64_t> shape) {
+  auto address = static_cast<int64_t>(reinterpret_cast<intptr_t>(data));
+  SmallVector<int64_t> descriptor{address, address, 0};
+  descriptor.append(shape.begin(), shape.end());
+  llvm::append_range(descriptor, getRowMajorStrides(shape));
+  return descriptor;
+}
+
+KernelBufferRef
+mlir::tpp::getKernelBufferRef(MutableArrayRef<int64_t> descriptor,
+                              const KernelBuffer &buffer) {
+  // The pointers and the offset, then the sizes.
+  return {descriptor.data(), static_cast<int64_t>(buffer.shape.size()),
+          descriptor.data() + 3, buffer.elementBytes};
+}
+
+//===----------------------------------------------------------------------===//
+// Kernel
+//===----------------------------------------------------------------------===//
+
+Kernel::Kernel(std::unique_ptr<ExecutionEngine> engine,
+               KernelSignature signature)
+    : engine(std::move(engine)), signature(std::move(signature)),
+      entryName("_mlir_ciface_" + this->signature.entryName) {}
+
+FailureOr<std::unique_ptr<Kernel>>
+Kernel::create(ModuleOp module, KernelSignature signature,
+               const ExecutionEngineOptions &options) {
+  auto engine = ExecutionEngine::create(module, options);
+  if (!engine) {
+    llvm::errs() << "Error while creating the execution engine: "
+                 << llvm::toString(engine.takeError()) << "\n";
+    return failure();
+  }
+  return std::unique_ptr<Kernel>(
+      new Kernel(std::move(*engine), std::move(signature)));
+}
+
+LogicalResult Kernel::invoke(ArrayRef<KernelBufferRef> buffers) {
+  size_t numBuffers = signature.args.size() + signature.results.size();
+  if (buffers.size() != numBuffers) {
+    llvm::errs() << "Error: " << signature.entryName << " takes " << numBuffers
+                 << " buffers, got " << buffers.size() << "\n";
+    return failure();
+  }
+  for (auto [index, buffer] : llvm::enumerate(buffers)) {
+    const KernelBuffer &expected =
+        index < signature.args.size()
+            ? signature.args[index]
+            : signature.results[index - signature.args.size()];
+    if (buffer.rank != static_cast<int64_t>(expected.shape.size()) ||
+        buffer.elementBytes != expected.elementBytes ||
+        !llvm::equal(ArrayRef<int64_t>(buffer.sizes, buffer.rank),
+                     expected.shape)) {
+      llvm::errs() << "Error: buffer " << index << " of "
+                   << signature.entryName << " does not match its type\n";
+      return failure();
+    }
+  }
+
+  // The C interface takes pointers to the descriptors, the packed arguments
+  // point to them.
+  SmallVector<void *> descriptors;
+  for (const KernelBufferRef &buffer : buffers)
+    descriptors.push_back(buffer.descriptor);
+  SmallVector<void *> packedArgs;
+  for (void *&descriptor : descriptors)
+    packedArgs.push_back(&descriptor);
+  if (auto err = engine->invokePacked(entryName, packedArgs)) {
+    llvm::errs() << "Error while running the kernel: "
+                 << llvm::toString(std::move(err)) << "\n";
+    return failure();
+  }
+  return success();
+}
+
+LogicalResult Kernel::invoke(ArrayRef<const DLTensor *> tensors) {
+  size_t numBuffers = signature.args.size() + signature.results.size();
+  if (tensors.size() != numBuffers) {
+    llvm::errs() << "Error: " << signature.entryName << " takes " << numBuffers
+                 << " buffers, got " << tensors.size() << "\n";
+    return failure();
+  }
+
+  // The descriptors point to the tensors, or to packed copies of the tensors
+  // that are strided or not aligned to their elements.
+  SmallVector<SmallVector<int64_t>> descriptors;
+  SmallVector<const KernelBuffer *> buffers;
+  SmallVector<PackedCopy> copies;
+  for (auto [index, tensor] : llvm::enumerate(tensors)) {
+    const KernelBuffer &expected =
+        index < signature.args.size()
+            ? signature.args[index]
+            : signature.results[index - signature.args.size()];
+    if (tensor->device.device_type != kDLCPU ||
+        tensor->ndim != static_cast<int32_t>(expected.shape.size()) ||
+        !matchesDLDataType(tensor->dtype, expected) ||
+        !llvm::equal(ArrayRef<int64_t>(tensor->shape, tensor->ndim),
+                     expected.shape)) {
+      llvm::errs() << "Error: DLPack tensor " << index << " of "
+                   << signature.entryName << " does not match its type\n";
+      return failure();
+    }
+
+    char *data = static_cast<char *>(tensor->data) + tensor->byte_offset;
+    if (isRowMajor(*tensor) &&
+        reinterpret_cast<uintptr_t>(data) % expected.elementBytes == 0) {
+      descriptors.push_back(createMemRefDescriptor(data, expected.shape));
+      buffers.push_back(&expected);
+      continue;
+    }
+
+    int64_t numBytes = llvm::alignTo(expected.getNumBytes(), 64);
+    PackedCopy copy{
+        std::unique_ptr<char, PackedCopy::Free>(
+            static_cast<char *>(std::aligned_alloc(64, numBytes))),
+        tensor, &expected};
+    descriptors.push_back(createMemRefDescriptor(copy.data.get(),
+                                                 expected.shape));
+    buffers.push_back(&expected);
+    // The results are overwritten, only the arguments are read.
+    if (index < signature.args.size()) {
+      SmallVector<int64_t> packedStrides = getRowMajorStrides(expected.shape);
+      const int64_t *strides =
+          tensor->strides ? tensor->strides : packedStrides.data();
+      copyStrided(copy.data.get(), packedStrides.data(), data, strides,
+                  expected.shape, expected.elementBytes);
+    }
+    copies.push_back(std::move(copy));
+  }
+
+  // The descriptors do not move anymore.
+  SmallVector<KernelBufferRef> refs;
+  for (auto [descriptor, buffer] : llvm::zip(descriptors, buffers))
+    refs.push_back(getKernelBufferRef(descriptor, *buffer));
+  if (failed(invoke(ArrayRef<KernelBufferRef>(refs))))
+    return failure();
+
+  for (const PackedCopy &copy : copies) {
+    if (!copy.buffer->inPlace)
+      continue;
+    SmallVector<int64_t> packedStrides =
+        getRowMajorStrides(copy.buffer->shape);
+    const int64_t *strides =
+        copy.tensor->strides ? copy.tensor->strides : packedStrides.data();
+    char *data =
+        static_cast<char *>(copy.tensor->data) + copy.tensor->byte_offset;
+    copyStrided(data, strides, copy.data.get(), packedStrides.data(),
+                copy.buffer->shape, copy.buffer->elementBytes);
+  }
+  return success();
+}
+
+extern "C" int tpp_kernel_invoke_dlpack(void *kernel,
+                                        const DLTensor *const *tensors,
+                                        int32_t numTensors) {
+  ArrayRef<const DLTensor *> tensorRefs(tensors, numTensors);
+  return failed(static_cast<Kernel *>(kernel)->invoke(tensorRefs)) ? 1 : 0;
+}
+
+//===----------------------------------------------------------------------===//
+// ThreadTeam
+//===----------------------------------------------------------------------===//
+
+ThreadTeam::ThreadTeam(ArrayRef<unsigned> cpus) : numThreads(cpus.size()) {
+  SmallVector<int32_t> teamCpus(cpus.begin(), cpus.end());
+  team = tpp_tasks_create_team(teamCpus.data(), teamCpus.size());
+}
+
+ThreadTeam::~ThreadTeam() { tpp_tasks_destroy_team(team); }
+
+void ThreadTeam::join() { tpp_tasks_set_team(team); }
+
+void ThreadTeam::leave() { tpp_tasks_set_team(nullptr); }
+
+//===----------------------------------------------------------------------===//
+// Engine
+//===----------------------------------------------------------------------===//
+
+Engine::Engine(EngineOptions options) : options(std::move(options)) {
+  DialectRegistry registry;
+  registry.insert<xsmm::XsmmDialect>();
+  registry.insert<check::CheckDialect>();
+  registry.insert<perf::PerfDialect>();
+  registerAllDialects(registry);
+  registerAllExtensions(registry);
+  registerAllToLLVMIRTranslations(registry);
+  context.appendDialectRegistry(registry);
+}
+
+FailureOr<std::unique_ptr<Engine>> Engine::create(EngineOptions options) {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  // Check the pipeline options once, the compilations set them again.
+  auto applied = applyPipelineOptions(options.pipelineOptions);
+  if (failed(applied))
+    return failure();
+  for (llvm::cl::Option *option : *applied)
+    option->reset();
+
+  // Both runtimes read the number of threads when they start.
+  if (options.numThreads) {
+    std::string threads = std::to_string(options.numThreads);
+    setenv("TPP_NUM_THREADS", threads.c_str(), /*overwrite=*/1);
+    setenv("OMP_NUM_THREADS", threads.c_str(), /*overwrite=*/1);
+  }
+  return std::unique_ptr<Engine>(new Engine(std::move(options)));
+}
+
+FailureOr<Kernel *> Engine::load(StringRef source, StringRef kernelName) {
+  std::string key;
+  {
+    llvm::raw_string_ostream os(key);
+    os << kernelName << '\0' << source;
+  }
+  auto hash = llvm::SHA256::hash(llvm::arrayRefFromStringRef(key));
+  std::string hashKey = llvm::toHex(hash, /*LowerCase=*/true);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = kernels.find(hashKey);
+  if (it != kernels.end())
+    return it->second.get();
+
+  OwningOpRef<ModuleOp> module = parseSourceString<ModuleOp>(source, &context);
+  if (!module)
+    return failure();
+  auto kernel = compileLocked(*module, kernelName);
+  if (failed(kernel))
+    return failure();
+  Kernel *loaded = kernel->get();
+  kernels[hashKey] = std::move(*kernel);
+  return loaded;
+}
+
+FailureOr<std::unique_ptr<Kernel>> Engine::compile(ModuleOp module,
+                                                   StringRef kernelName) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return compileLocked(module, kernelName);
+}
+
+FailureOr<std::unique_ptr<Kernel>> Engine::compileLocked(ModuleOp module,
+                                                         StringRef kernelName) {
+  auto signature = createKernelEntry(module, kernelName);
+  if (failed(signature))
+    return failure();
+
+  auto applied = applyPipelineOptions(options.pipelineOptions);
+  if (failed(applied))
+    return failure();
+  PassManager passManager(module.getContext());
+  passManager.addPass(createDefaultPipeline());
+  LogicalResult lowered = passManager.run(module);
+  for (llvm::cl::Option *option : *applied)
+    option->reset();
+  if (failed(lowered)) {
+    llvm::errs() << "Error: failed to lower " << kernelName
+                 << " to the LLVM dialect\n";
+    return failure();
+  }
+
+  // Optimize for the host, with the fast-math flags MLIR does not set.
+  std::shared_ptr<llvm::TargetMachine> targetMachine;
+  auto machineBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+  if (machineBuilder) {
+    auto machine = machineBuilder->createTargetMachine();
+    if (machine)
+      targetMachine = std::move(*machine);
+    else
+      llvm::consumeError(machine.takeError());
+  } else {
+    llvm::consumeError(machineBuilder.takeError());
+  }
+  auto optimize = makeOptimizingTransformer(
+      options.optLevel, /*sizeLevel=*/0, targetMachine.get());
+  ExecutionEngineOptions engineOptions;
+  engineOptions.transformer = [targetMachine,
+                               optimize](llvm::Module *llvmModule) {
+    for (auto &func : llvmModule->functions())
+      func.addFnAttr("unsafe-fp-math", "true");
+    return optimize(llvmModule);
+  };
+  engineOptions.jitCodeGenOptLevel =
+      static_cast<llvm::CodeGenOptLevel>(options.optLevel);
+  SmallVector<StringRef> sharedLibPaths(options.sharedLibPaths.begin(),
+                                        options.sharedLibPaths.end());
+  engineOptions.sharedLibPaths = sharedLibPaths;
+  return Kernel::create(module, std::move(*signature), engineOptions);
+}
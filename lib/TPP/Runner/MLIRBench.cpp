@@ -19,17 +19,22 @@
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/GPU/IR/GPUDialect.h"
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
 #include "mlir/Dialect/Linalg/Passes.h"
 #include "mlir/Dialect/Math/IR/Math.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/Dialect/Tensor/IR/Tensor.h"
 #include "mlir/Dialect/Utils/ReshapeOpsUtils.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
 #include "mlir/Dialect/Vector/IR/VectorOps.h"
 #include "mlir/IR/BuiltinAttributes.h"
 #include "mlir/IR/BuiltinTypes.h"
 #include "mlir/IR/Dialect.h"
 #include "mlir/IR/ValueRange.h"
+#include "mlir/Interfaces/CastInterfaces.h"
+#include "mlir/Interfaces/DestinationStyleOpInterface.h"
+#include "mlir/Interfaces/LoopLikeInterface.h"
 #include "mlir/InitAllDialects.h"
 #include "mlir/InitAllPasses.h"
 #include "mlir/Pass/Pass.h"
@@ -38,7 +43,10 @@
 #include "llvm/ADT/TypeSwitch.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
 
+#include "TPP/Dialect/Check/CheckOps.h"
 #include "TPP/Dialect/Perf/PerfDialect.h"
 #include "TPP/Dialect/Perf/PerfOps.h"
 #include "TPP/Passes.h"
@@ -59,12 +67,20 @@ MLIRBench::MLIRBench(mlir::Operation *op, const MLIRBenchConfig &config)
   backend = config.backend;
   initType = config.initType;
   offloadToDevice = config.offloadToDevice;
+  sharedMemory = config.sharedMemory;
+  jsonOutput = config.jsonOutput;
+  inputDir = config.inputDir;
+  runtimeInit = config.runtimeInit;
+  numaPolicy = config.numaPolicy;
+  hugePageSize = config.hugePageSize;
+  dynamicSizes = config.dynamicSizes;
 
   module = dyn_cast<ModuleOp>(op);
   assert(module && "expected a 'builtin.Module' op");
 }
 
 LogicalResult MLIRBench::findKernel(StringRef name) {
+  kernel = nullptr;
   auto &moduleOps = getModuleBlock().getOperations();
   if (!name.empty()) {
     // If the user passed the entry point, use it
@@ -163,6 +179,12 @@ LogicalResult MLIRBench::replaceSplatWithRandom() {
   return success();
 }
 
+void MLIRBench::labelResults(StringRef name) {
+  reportPrefix = (name + ".").str();
+  if (!jsonOutput)
+    builder.create<vector::PrintOp>(unkLoc, name);
+}
+
 LogicalResult MLIRBench::renameKernel() {
   // Rename the entry point to something else and make the main the entry point
   // This is required because we can't change the original Name
@@ -175,11 +197,24 @@ LogicalResult MLIRBench::renameKernel() {
 
 Value MLIRBench::registerOnGpu(Value buf, MemRefType memRefTy) {
   // Do nothing when not using GPU
-  if (!offloadToDevice || !(backend == "cuda"))
+  if (!offloadToDevice ||
+      !(backend == "cuda" || (backend == "intel" && sharedMemory)))
+    return buf;
+
+  // A device sharing the host memory accesses the host buffer in place once
+  // it is registered, without a device copy
+  if (sharedMemory && backend == "cuda") {
+    auto unrankedTy = UnrankedMemRefType::get(memRefTy.getElementType(),
+                                              memRefTy.getMemorySpace());
+    Value unranked = builder.create<memref::CastOp>(unkLoc, unrankedTy, buf);
+    builder.create<gpu::HostRegisterOp>(unkLoc, unranked);
     return buf;
+  }
 
   // Allocate an arg buffer on device and copy data from host
-  // Use shared memory on Intel GPU and dedicated GPU allocation, otherwise
+  // Use shared memory on Intel GPU and dedicated GPU allocation, otherwise.
+  // Level Zero cannot register host memory, the shared buffer is in host
+  // memory on integrated GPUs, the copy is done once by the host
   bool isHostShared = backend == "intel";
   auto gpuAlloc =
       builder.create<gpu::AllocOp>(unkLoc, memRefTy, ValueRange{}, ValueRange{},
@@ -204,37 +239,154 @@ Value MLIRBench::registerOnGpu(Value buf, MemRefType memRefTy) {
   return gpuBuf;
 }
 
+// Returns the argument of `kernel` that `value` is computed in place of,
+// following the destinations of the ops and the inits of the loops.
+static BlockArgument getTiedArgument(func::FuncOp kernel, Value value) {
+  while (auto result = dyn_cast<OpResult>(value)) {
+    Operation *op = result.getOwner();
+    if (auto dpsOp = dyn_cast<DestinationStyleOpInterface>(op)) {
+      value = dpsOp.getTiedOpOperand(result)->get();
+      continue;
+    }
+    auto loopOp = dyn_cast<LoopLikeOpInterface>(op);
+    OpOperand *init = loopOp ? loopOp.getTiedLoopInit(result) : nullptr;
+    if (!init)
+      return nullptr;
+    value = init->get();
+  }
+  auto arg = cast<BlockArgument>(value);
+  return arg.getOwner()->getParentOp() == kernel ? arg : nullptr;
+}
+
+void MLIRBench::findResidentOutputs() {
+  // Only the device arguments can be copied by the bufferization between
+  // calls, the host ones stay in place
+  residentOutputs.clear();
+  if (!offloadToDevice || backend != "cuda" || kernel.isExternal())
+    return;
+
+  auto returnOp = cast<func::ReturnOp>(kernel.getBody().back().getTerminator());
+  for (auto [idx, result] : llvm::enumerate(returnOp.getOperands())) {
+    if (!isa<TensorType>(result.getType()))
+      continue;
+    BlockArgument arg = getTiedArgument(kernel, result);
+    if (!arg || arg.getType() != result.getType() ||
+        llvm::any_of(residentOutputs, [&](auto pair) {
+          return pair.first == arg.getArgNumber();
+        }))
+      continue;
+    residentOutputs.push_back({arg.getArgNumber(), idx});
+  }
+}
+
+SmallVector<Value> MLIRBench::getResidentResults(Operation *call) {
+  SmallVector<Value> results;
+  for (auto [argIdx, resultIdx] : residentOutputs)
+    results.push_back(call->getResult(resultIdx));
+  return results;
+}
+
+// Returns true if `arg` is the weight of a contraction blocked along the
+// outermost dimension by the output columns, e.g. the packed B of a blocked
+// matmul, whose outermost blocks get split over the threads like the output.
+static bool isBlockedWeight(BlockArgument arg) {
+  for (OpOperand &use : arg.getUses()) {
+    auto linalgOp = dyn_cast<linalg::LinalgOp>(use.getOwner());
+    if (!linalgOp || linalgOp.getNumDpsInputs() != 2 ||
+        linalgOp.getNumDpsInits() != 1 ||
+        use.getOperandNumber() !=
+            linalgOp.getDpsInputOperand(1)->getOperandNumber() ||
+        !linalg::isaContractionOpInterface(linalgOp))
+      continue;
+    AffineMap map = linalgOp.getMatchingIndexingMap(&use);
+    if (map.getNumResults() == 0)
+      continue;
+    auto outerDim = dyn_cast<AffineDimExpr>(map.getResult(0));
+    if (!outerDim ||
+        !linalg::isParallelIterator(
+            linalgOp.getIteratorTypesArray()[outerDim.getPosition()]))
+      continue;
+    AffineMap outputMap =
+        linalgOp.getMatchingIndexingMap(linalgOp.getDpsInitOperand(0));
+    if (outputMap.isFunctionOfDim(outerDim.getPosition()))
+      return true;
+  }
+  return false;
+}
+
 LogicalResult MLIRBench::createKernelArgs() {
   // Clear current args and rebuild them from scratch
   kernelArgs.clear();
 
-  // Create global dense memrefs (Module insertion point)
+  // Create global dense memrefs (Module insertion point), after the previous
+  // kernel benchmarks, if any
   auto &mainBody = getMainBlock();
-  builder.setInsertionPointToStart(&mainBody);
-
-  for (auto &ty : kernel.getArgumentTypes()) {
-    auto arg = TypeSwitch<Type, std::optional<Value>>(ty)
-                   .Case<MemRefType>([&](auto memRefTy) {
-                     // Create a memref global
-                     Value data = createDenseMemref(builder, module, initType,
-                                                    memRefTy, seed);
-                     data = registerOnGpu(data, memRefTy);
-                     return data;
-                   })
-                   .Case<TensorType>([&](auto tensorTy) {
-                     // Create a memref global and cast it to a tensor
-                     // to ensure that the buffer is writable and
-                     // bufferization does not insert extra
-                     // allocations + copies
-                     auto memrefType = MemRefType::get(
-                         tensorTy.getShape(), tensorTy.getElementType());
-                     auto data = createDenseMemref(builder, module, initType,
-                                                   memrefType, seed);
-                     data = registerOnGpu(data, memrefType);
-                     return builder.create<bufferization::ToTensorOp>(
-                         unkLoc, data, /*restrict=*/true, /*writable=*/true);
-                   })
-                   .Default([&](auto t) { return std::nullopt; });
+  builder.setInsertionPointToEnd(&mainBody);
+
+  // Dynamic arguments are created with the given sizes and cast to the
+  // kernel types
+  unsigned nextDynamicSize = 0;
+  for (auto [idx, ty] : llvm::enumerate(kernel.getArgumentTypes())) {
+    // Map the argument's tensor file or create an initialized memref
+    auto createData = [&, idx = idx](MemRefType memRefTy) -> Value {
+      if (Value data = mapInputFile(idx, memRefTy))
+        return data;
+      bool customAlloc = !numaPolicy.empty() || hugePageSize;
+      if (!runtimeInit && !customAlloc)
+        return createDenseMemref(builder, module, initType, memRefTy, seed);
+
+      // Allocate the argument and initialize it in place
+      bool shard = numaPolicy == "shard" && !kernel.isExternal() &&
+                   isBlockedWeight(kernel.getArgument(idx));
+      Value data = createKernelArgBuffer(memRefTy, shard);
+      if (runtimeInit) {
+        initTensorAtRuntime(data);
+      } else {
+        auto init =
+            createDenseMemref(builder, module, initType, memRefTy, seed);
+        builder.create<memref::CopyOp>(unkLoc, init, data);
+      }
+      return data;
+    };
+
+    SmallVector<int64_t> shape;
+    if (auto shapedTy = dyn_cast<ShapedType>(ty)) {
+      auto staticShape = getStaticShape(shapedTy, nextDynamicSize);
+      if (failed(staticShape))
+        return module.emitError(
+            "Dynamic kernel arguments need sizes, use -dynamic-sizes");
+      shape = *staticShape;
+    }
+
+    auto arg =
+        TypeSwitch<Type, std::optional<Value>>(ty)
+            .Case<MemRefType>([&](auto memRefTy) -> Value {
+              auto staticTy = MemRefType::get(
+                  shape, memRefTy.getElementType(), MemRefLayoutAttrInterface(),
+                  memRefTy.getMemorySpace());
+              Value data = createData(staticTy);
+              data = registerOnGpu(data, staticTy);
+              if (staticTy != memRefTy)
+                data = builder.create<memref::CastOp>(unkLoc, memRefTy, data);
+              return data;
+            })
+            .Case<TensorType>([&](auto tensorTy) -> Value {
+              // Create a memref and cast it to a tensor
+              // to ensure that the buffer is writable and
+              // bufferization does not insert extra
+              // allocations + copies
+              auto memrefType =
+                  MemRefType::get(shape, tensorTy.getElementType());
+              auto data = createData(memrefType);
+              data = registerOnGpu(data, memrefType);
+              Value tensor = builder.create<bufferization::ToTensorOp>(
+                  unkLoc, data, /*restrict=*/true, /*writable=*/true);
+              if (tensor.getType() != tensorTy)
+                tensor = builder.create<tensor::CastOp>(unkLoc, tensorTy,
+                                                        tensor);
+              return tensor;
+            })
+            .Default([&](auto t) { return std::nullopt; });
 
     if (!arg)
       return failure();
@@ -242,9 +394,130 @@ LogicalResult MLIRBench::createKernelArgs() {
     kernelArgs.push_back(*arg);
   }
 
+  findResidentOutputs();
   return success();
 }
 
+FailureOr<SmallVector<int64_t>> MLIRBench::getStaticShape(ShapedType type,
+                                                         unsigned &next) {
+  SmallVector<int64_t> shape(type.getShape());
+  for (int64_t &size : shape) {
+    if (!ShapedType::isDynamic(size))
+      continue;
+    if (dynamicSizes.empty())
+      return failure();
+    size = dynamicSizes[std::min<size_t>(next++, dynamicSizes.size() - 1)];
+  }
+  return shape;
+}
+
+Value MLIRBench::mapInputFile(unsigned argIdx, MemRefType memRefTy) {
+  if (inputDir.empty())
+    return nullptr;
+
+  // NumPy files take precedence over raw files
+  for (StringRef ext : {".npy", ".bin"}) {
+    SmallString<128> path(inputDir);
+    llvm::sys::path::append(path, "arg" + std::to_string(argIdx) + ext);
+    if (!llvm::sys::fs::exists(path))
+      continue;
+    (void)llvm::sys::fs::make_absolute(path);
+    return builder.create<perf::MapFileOp>(unkLoc, memRefTy,
+                                           builder.getStringAttr(path));
+  }
+  return nullptr;
+}
+
+Value MLIRBench::createKernelArgBuffer(MemRefType memRefTy, bool shard) {
+  if (numaPolicy.empty() && !hugePageSize) {
+    auto alloc = builder.create<memref::AllocOp>(
+        unkLoc, memRefTy, builder.getI64IntegerAttr(128));
+
+    // Dealloc the buffer at the end of program
+    builder.setInsertionPointToEnd(&getMainBlock());
+    builder.create<memref::DeallocOp>(unkLoc, alloc);
+
+    // Continue inserting ops after the allocation
+    builder.setInsertionPointAfter(alloc);
+    return alloc;
+  }
+
+  // Fresh pages, placed by the policy or by their first write. The arguments
+  // that cannot be sharded are first touched instead.
+  auto interleave =
+      numaPolicy == "interleave" ? builder.getUnitAttr() : UnitAttr();
+  auto alloc = builder.create<perf::AllocOp>(
+      unkLoc, memRefTy, interleave, shard ? builder.getUnitAttr() : UnitAttr(),
+      builder.getI64IntegerAttr(hugePageSize));
+  if (numaPolicy == "first-touch" || (numaPolicy == "shard" && !shard))
+    firstTouch(alloc);
+  return alloc;
+}
+
+void MLIRBench::firstTouch(Value buf) {
+  // Zero the buffer in a parallel loop over its outermost dimension, which
+  // gets the same static distribution over the threads as the parallel loops
+  // of the kernel, so each page lands on the node of the thread using it.
+  auto memRefTy = cast<MemRefType>(buf.getType());
+  Value zero = builder.create<arith::ConstantOp>(
+      unkLoc, builder.getZeroAttr(memRefTy.getElementType()));
+  if (memRefTy.getRank() == 0) {
+    builder.create<linalg::FillOp>(unkLoc, ValueRange{zero}, ValueRange{buf});
+    return;
+  }
+
+  auto lb = builder.create<arith::ConstantIndexOp>(unkLoc, 0);
+  auto ub = builder.create<arith::ConstantIndexOp>(unkLoc,
+                                                   memRefTy.getShape()[0]);
+  auto step = builder.create<arith::ConstantIndexOp>(unkLoc, 1);
+  builder.create<scf::ParallelOp>(
+      unkLoc, ValueRange{lb}, ValueRange{ub}, ValueRange{step},
+      [&](OpBuilder &b, Location loc, ValueRange ivs) {
+        SmallVector<OpFoldResult> offsets(memRefTy.getRank(),
+                                          b.getIndexAttr(0));
+        SmallVector<OpFoldResult> sizes;
+        SmallVector<OpFoldResult> strides(memRefTy.getRank(),
+                                          b.getIndexAttr(1));
+        offsets[0] = ivs[0];
+        sizes.push_back(b.getIndexAttr(1));
+        for (int64_t dim : memRefTy.getShape().drop_front())
+          sizes.push_back(b.getIndexAttr(dim));
+        Value row =
+            b.create<memref::SubViewOp>(loc, buf, offsets, sizes, strides);
+        b.create<linalg::FillOp>(loc, ValueRange{zero}, ValueRange{row});
+      });
+}
+
+void MLIRBench::initTensorAtRuntime(Value buf) {
+  // Same defaults as the compile-time initializers
+  auto type = initType;
+  if (type == TensorInitType::Auto)
+    type = seed ? TensorInitType::Normal : TensorInitType::Constant;
+  StringRef init;
+  switch (type) {
+  case TensorInitType::Constant:
+    init = "const";
+    break;
+  case TensorInitType::Simple:
+    init = "simple";
+    break;
+  case TensorInitType::Continuous:
+    init = "cont";
+    break;
+  case TensorInitType::Random:
+    init = "random";
+    break;
+  case TensorInitType::Normal:
+    init = "normal";
+    break;
+  default:
+    llvm_unreachable("Invalid tensor initializer type");
+  }
+
+  builder.create<perf::InitTensorOp>(unkLoc, buf, builder.getStringAttr(init),
+                                     builder.getI64IntegerAttr(seed));
+}
+
 LogicalResult MLIRBench::createMainWrapper() {
   // Add a `main` function (with no args/rets) to handle init/tear down
   auto funcType = builder.getFunctionType({}, {});
@@ -258,30 +531,218 @@ LogicalResult MLIRBench::createMainWrapper() {
 }
 
 Operation *MLIRBench::callKernel() {
-  // Call the kernel
-  return builder.create<func::CallOp>(unkLoc, kernel, kernelArgs);
+  // Call the kernel, the following calls run on its resident results
+  auto call = builder.create<func::CallOp>(unkLoc, kernel, kernelArgs);
+  for (auto [argIdx, resultIdx] : residentOutputs)
+    kernelArgs[argIdx] = call.getResult(resultIdx);
+  return call;
+}
+
+func::FuncOp MLIRBench::createReferenceKernel() {
+  auto reference = cast<func::FuncOp>(kernel->clone());
+  reference.setName(builder.getStringAttr(kernel.getName() + "_reference"));
+  reference.setPrivate();
+  SymbolTable(module).insert(reference,
+                             ++Block::iterator(kernel.getOperation()));
+  return reference;
+}
+
+Operation *MLIRBench::callAndValidateKernel(func::FuncOp reference,
+                                            double threshold) {
+  // Memref arguments are updated in place, the reference runs on copies
+  SmallVector<Value> args(kernelArgs);
+  SmallVector<Value> refArgs;
+  SmallVector<Value> copies;
+  for (Value arg : args) {
+    auto memRefTy = dyn_cast<MemRefType>(arg.getType());
+    if (!memRefTy) {
+      refArgs.push_back(arg);
+      continue;
+    }
+    SmallVector<Value> sizes;
+    for (auto [dim, size] : llvm::enumerate(memRefTy.getShape())) {
+      if (ShapedType::isDynamic(size))
+        sizes.push_back(builder.create<memref::DimOp>(unkLoc, arg, dim));
+    }
+    auto bufferTy =
+        MemRefType::get(memRefTy.getShape(), memRefTy.getElementType(),
+                        MemRefLayoutAttrInterface(),
+                        memRefTy.getMemorySpace());
+    Value copy = builder.create<memref::AllocOp>(unkLoc, bufferTy, sizes);
+    builder.create<memref::CopyOp>(unkLoc, arg, copy);
+    copies.push_back(copy);
+    if (bufferTy != memRefTy)
+      copy = builder.create<memref::CastOp>(unkLoc, memRefTy, copy);
+    refArgs.push_back(copy);
+  }
+
+  auto *call = callKernel();
+  auto refCall = builder.create<func::CallOp>(unkLoc, reference, refArgs);
+
+  // Compare the results or, without any, the buffers written in place
+  SmallVector<std::pair<Value, Value>> outputs;
+  if (call->getNumResults()) {
+    outputs.push_back({call->getResult(0), refCall.getResult(0)});
+  } else {
+    for (auto [arg, refArg] : llvm::zip(args, refArgs))
+      if (isa<MemRefType>(arg.getType()))
+        outputs.push_back({arg, refArg});
+  }
+  auto thresholdVal = builder.create<arith::ConstantOp>(
+      unkLoc, builder.getF32FloatAttr(threshold));
+  for (auto [output, refOutput] : outputs) {
+    if (!isa<ShapedType>(output.getType()))
+      continue;
+    builder.create<check::ExpectAlmostEqOp>(unkLoc, output, refOutput,
+                                            thresholdVal);
+  }
+
+  for (Value copy : copies)
+    builder.create<memref::DeallocOp>(unkLoc, copy);
+  return call;
 }
 
-Value MLIRBench::createTimerLoop(unsigned iters) {
+Value MLIRBench::createTimerLoop(unsigned iters, bool collectCounters,
+                                 bool subtractOverhead, bool collectEnergy) {
   // Allocates buffer for results
   auto count = getConstInt(builder, iters, 64);
 
+  // Start hardware counters around the whole benchmark region
+  Value counterHandle;
+  if (collectCounters) {
+    auto bufType = MemRefType::get({perf::StopCountersOp::kNumEvents},
+                                   builder.getI64Type());
+    counters = builder.create<memref::AllocaOp>(unkLoc, bufType);
+    counterHandle = builder.create<perf::StartCountersOp>(
+        unkLoc, perf::CountersType::get(builder.getContext()));
+  }
+  Value energyHandle;
+  if (collectEnergy)
+    energyHandle = startEnergy(iters);
+
   // Create perf benchmarking region, set insertion to inside the body
-  auto bench = builder.create<perf::BenchOp>(unkLoc, count);
+  // The resident arguments are carried between the iterations
+  SmallVector<Value> residentArgs;
+  for (auto [argIdx, resultIdx] : residentOutputs)
+    residentArgs.push_back(kernelArgs[argIdx]);
+  auto bench = builder.create<perf::BenchOp>(unkLoc, count, residentArgs);
+  bench.setSubtractOverhead(subtractOverhead);
   builder.setInsertionPointToStart(bench.getBody());
+  for (auto [pair, arg] : llvm::zip_equal(residentOutputs, residentArgs))
+    kernelArgs[pair.first] =
+        bench.getBody()->addArgument(arg.getType(), unkLoc);
 
   // Call the kernel, ignore output
-  [[maybe_unused]] auto *call = callKernel();
+  auto *call = callKernel();
   assert(call && "Failed to generate a kernel call");
+  if (!residentArgs.empty())
+    builder.create<perf::YieldOp>(unkLoc, getResidentResults(call));
 
   // Revert insertion point and return the accumulation ID
   builder.setInsertionPointAfter(bench);
+  for (auto [pair, result] :
+       llvm::zip_equal(residentOutputs, bench.getBodyResults().drop_front()))
+    kernelArgs[pair.first] = result;
+
+  if (collectEnergy)
+    builder.create<perf::StopEnergyOp>(unkLoc, energyHandle, energy);
+  if (collectCounters)
+    builder.create<perf::StopCountersOp>(unkLoc, counterHandle, counters);
 
   // The first result is the timer deltas
   return bench.getResults()[0];
 }
 
+Value MLIRBench::createSampledTimerLoop(unsigned iters, bool collectCounters,
+                                        bool flushCache, bool collectEnergy) {
+  // Allocates buffer for the per-iteration deltas
+  auto bufType = MemRefType::get({iters}, builder.getF64Type());
+  auto deltas = builder.create<memref::AllocOp>(unkLoc, bufType);
+
+  // Start hardware counters around the whole benchmark loop
+  Value counterHandle;
+  if (collectCounters) {
+    auto countersType = MemRefType::get({perf::StopCountersOp::kNumEvents},
+                                        builder.getI64Type());
+    counters = builder.create<memref::AllocaOp>(unkLoc, countersType);
+    counterHandle = builder.create<perf::StartCountersOp>(
+        unkLoc, perf::CountersType::get(builder.getContext()));
+  }
+  Value energyHandle;
+  if (collectEnergy)
+    energyHandle = startEnergy(iters);
+
+  // Time each iteration separately, carrying the resident arguments
+  auto zero = getConstIndex(builder, 0);
+  auto one = getConstIndex(builder, 1);
+  auto count = getConstIndex(builder, iters);
+  SmallVector<Value> residentArgs;
+  for (auto [argIdx, resultIdx] : residentOutputs)
+    residentArgs.push_back(kernelArgs[argIdx]);
+  auto loop =
+      builder.create<scf::ForOp>(unkLoc, zero, count, one, residentArgs);
+  builder.setInsertionPointToStart(loop.getBody());
+  for (auto [pair, iterArg] :
+       llvm::zip_equal(residentOutputs, loop.getRegionIterArgs()))
+    kernelArgs[pair.first] = iterArg;
+
+  // Evict the kernel data before each iteration, outside of the timed region
+  if (flushCache)
+    builder.create<perf::FlushCacheOp>(unkLoc);
+
+  auto timer = builder.create<perf::StartTimerOp>(
+      unkLoc, perf::TimerType::get(builder.getContext()));
+  auto *call = callKernel();
+  assert(call && "Failed to generate a kernel call");
+  auto delta = builder.create<perf::StopTimerOp>(unkLoc, builder.getF64Type(),
+                                                 timer.getTimer());
+  builder.create<memref::StoreOp>(unkLoc, delta, deltas,
+                                  ValueRange{loop.getInductionVar()});
+  if (!residentArgs.empty())
+    builder.create<scf::YieldOp>(unkLoc, getResidentResults(call));
+
+  builder.setInsertionPointAfter(loop);
+  for (auto [pair, result] :
+       llvm::zip_equal(residentOutputs, loop.getResults()))
+    kernelArgs[pair.first] = result;
+  Operation *last = loop;
+  if (collectEnergy)
+    last = builder.create<perf::StopEnergyOp>(unkLoc, energyHandle, energy);
+  if (collectCounters)
+    last = builder.create<perf::StopCountersOp>(unkLoc, counterHandle,
+                                                counters);
+
+  // Dealloc the deltas at the end of program, then restore insertion point
+  builder.setInsertionPointToEnd(&getMainBlock());
+  builder.create<memref::DeallocOp>(unkLoc, deltas);
+  builder.setInsertionPointAfter(last);
+
+  return deltas;
+}
+
+Value MLIRBench::startDeviceTimer() {
+  return builder.create<perf::StartDeviceTimerOp>(
+      unkLoc, perf::TimerType::get(builder.getContext()));
+}
+
+void MLIRBench::printDeviceMean(Value timer, unsigned iters) {
+  auto f64 = builder.getF64Type();
+  auto delta = builder.create<perf::StopDeviceTimerOp>(unkLoc, f64, timer);
+  auto fIters = builder.create<arith::ConstantOp>(
+      unkLoc, builder.getFloatAttr(f64, iters));
+  Value mean = builder.create<arith::DivFOp>(unkLoc, delta, fIters);
+  if (jsonOutput) {
+    report("device_mean", mean);
+    return;
+  }
+  builder.create<vector::PrintOp>(unkLoc, mean);
+}
+
 Value MLIRBench::getTimerStats(Value deltas) {
+  // Sampled deltas, compute the mean of all samples
+  if (isa<MemRefType>(deltas.getType()))
+    return builder.create<perf::MeanOp>(unkLoc, builder.getF64Type(), deltas);
+
   // Num iterations is in the perf.bench op
   auto *bench = deltas.getDefiningOp();
   assert(isa<perf::BenchOp>(bench) && "Invalid delta definition");
@@ -296,9 +757,303 @@ Value MLIRBench::getTimerStats(Value deltas) {
 
 void MLIRBench::printMean(Value mean) {
   assert(isa<mlir::Float64Type>(mean.getType()) && "Invalid mean type");
+  if (jsonOutput) {
+    report("mean", mean);
+    return;
+  }
   builder.create<vector::PrintOp>(unkLoc, mean);
 }
 
+void MLIRBench::report(StringRef key, Value value) {
+  builder.create<perf::ReportOp>(unkLoc, value,
+                                 builder.getStringAttr(reportPrefix + key));
+}
+
+void MLIRBench::printSampleStats(Value deltas) {
+  // Print ( min, p50, p90, p99, max )
+  auto f64 = builder.getF64Type();
+  SmallVector<Value> stats;
+  stats.push_back(builder.create<perf::MinOp>(unkLoc, f64, deltas));
+  stats.push_back(builder.create<perf::MedianOp>(unkLoc, f64, deltas));
+  for (double percentile : {90.0, 99.0}) {
+    stats.push_back(builder.create<perf::PercentileOp>(
+        unkLoc, f64, deltas, builder.getF64FloatAttr(percentile)));
+  }
+  stats.push_back(builder.create<perf::MaxOp>(unkLoc, f64, deltas));
+
+  printValues(stats, {"min", "p50", "p90", "p99", "max"});
+}
+
+void MLIRBench::printValues(ArrayRef<Value> values,
+                            ArrayRef<StringRef> keys) {
+  assert(values.size() == keys.size() && "Expected a key per value");
+  if (jsonOutput) {
+    for (auto [key, value] : llvm::zip_equal(keys, values))
+      report(key, value);
+    return;
+  }
+
+  // Stores the values in a buffer and prints it as a single vector
+  auto f64 = builder.getF64Type();
+  auto numValues = static_cast<int64_t>(values.size());
+  auto bufType = MemRefType::get({numValues}, f64);
+  auto buf = builder.create<memref::AllocaOp>(unkLoc, bufType);
+  for (auto [idx, value] : llvm::enumerate(values)) {
+    builder.create<memref::StoreOp>(unkLoc, value, buf,
+                                    ValueRange{getConstIndex(builder, idx)});
+  }
+
+  auto vecType = VectorType::get({numValues}, f64);
+  auto zero = getConstIndex(builder, 0);
+  auto padding = builder.create<arith::ConstantOp>(
+      unkLoc, builder.getF64FloatAttr(0.0));
+  auto vector = builder.create<vector::TransferReadOp>(
+      unkLoc, vecType, buf, ValueRange{zero}, padding);
+  builder.create<vector::PrintOp>(unkLoc, vector);
+}
+
+// Returns the static trip count of the loops enclosing the op within the
+// kernel, or std::nullopt if any of them is not static.
+static std::optional<int64_t> getEnclosingTripCount(Operation *op,
+                                                    func::FuncOp kernel) {
+  int64_t tripCount = 1;
+  bool isStatic = true;
+  auto multiplyTripCount = [&](ArrayRef<OpFoldResult> lbs,
+                               ArrayRef<OpFoldResult> ubs,
+                               ArrayRef<OpFoldResult> steps) {
+    for (auto [lb, ub, step] : llvm::zip_equal(lbs, ubs, steps)) {
+      auto lbCst = getConstantIntValue(lb);
+      auto ubCst = getConstantIntValue(ub);
+      auto stepCst = getConstantIntValue(step);
+      if (!lbCst || !ubCst || !stepCst || *stepCst <= 0) {
+        isStatic = false;
+        return;
+      }
+      tripCount *= llvm::divideCeil(std::max<int64_t>(*ubCst - *lbCst, 0),
+                                    *stepCst);
+    }
+  };
+
+  for (Operation *parent = op->getParentOp(); parent && parent != kernel;
+       parent = parent->getParentOp()) {
+    TypeSwitch<Operation *>(parent)
+        .Case<scf::ForOp>([&](scf::ForOp forOp) {
+          multiplyTripCount(OpFoldResult(forOp.getLowerBound()),
+                            OpFoldResult(forOp.getUpperBound()),
+                            OpFoldResult(forOp.getStep()));
+        })
+        .Case<scf::ForallOp>([&](scf::ForallOp forallOp) {
+          multiplyTripCount(forallOp.getMixedLowerBound(),
+                            forallOp.getMixedUpperBound(),
+                            forallOp.getMixedStep());
+        })
+        .Case<scf::ParallelOp>([&](scf::ParallelOp parallelOp) {
+          multiplyTripCount(getAsOpFoldResult(parallelOp.getLowerBound()),
+                            getAsOpFoldResult(parallelOp.getUpperBound()),
+                            getAsOpFoldResult(parallelOp.getStep()));
+        })
+        .Default([&](Operation *op) {
+          // Unknown loops cannot be accounted for.
+          if (isa<LoopLikeOpInterface>(op))
+            isStatic = false;
+        });
+    if (!isStatic)
+      return std::nullopt;
+  }
+  return tripCount;
+}
+
+// Returns the number of bytes of a statically shaped type, 0 for scalars.
+static std::optional<int64_t> getTypeBytes(Type type) {
+  auto shapedType = dyn_cast<ShapedType>(type);
+  if (!shapedType)
+    return 0;
+  if (!shapedType.hasStaticShape() ||
+      !shapedType.getElementType().isIntOrFloat())
+    return std::nullopt;
+  return llvm::divideCeil(shapedType.getNumElements() *
+                              shapedType.getElementTypeBitWidth(),
+                          8);
+}
+
+LogicalResult MLIRBench::estimateKernelCost(int64_t &flops, int64_t &bytes) {
+  // FLOPs: every arithmetic op in the payload of a linalg op is executed once
+  // per point of its iteration space, e.g., 2 * M * N * K for a matmul.
+  flops = 0;
+  auto walkResult = kernel.walk([&](linalg::LinalgOp linalgOp) {
+    int64_t payloadOps = 0;
+    for (Operation &op : linalgOp.getBlock()->without_terminator()) {
+      if (isa<CastOpInterface>(op) || op.hasTrait<OpTrait::ConstantLike>())
+        continue;
+      if (isa_and_nonnull<arith::ArithDialect, math::MathDialect>(
+              op.getDialect()))
+        payloadOps++;
+    }
+    if (!payloadOps)
+      return WalkResult::advance();
+
+    auto tripCount = getEnclosingTripCount(linalgOp, kernel);
+    if (!tripCount || linalgOp.hasDynamicShape())
+      return WalkResult::interrupt();
+    int64_t iterations = 1;
+    for (int64_t size : linalgOp.getStaticLoopRanges())
+      iterations *= size;
+    flops += *tripCount * iterations * payloadOps;
+    return WalkResult::advance();
+  });
+  if (walkResult.wasInterrupted())
+    return failure();
+
+  // Bytes: compulsory traffic, all kernel arguments and results are moved
+  // once to or from memory.
+  bytes = 0;
+  auto funcType = kernel.getFunctionType();
+  for (Type type : llvm::concat<const Type>(funcType.getInputs(),
+                                            funcType.getResults())) {
+    auto typeBytes = getTypeBytes(type);
+    if (!typeBytes)
+      return failure();
+    bytes += *typeBytes;
+  }
+
+  return success();
+}
+
+LogicalResult MLIRBench::printRoofline(Value mean) {
+  int64_t flops = 0;
+  int64_t bytes = 0;
+  if (failed(estimateKernelCost(flops, bytes)))
+    return failure();
+
+  // Print ( GFLOP/s, GB/s, FLOP/byte ) for the mean kernel time
+  auto f64 = builder.getF64Type();
+  auto getConstF64 = [&](double value) -> Value {
+    return builder.create<arith::ConstantOp>(unkLoc,
+                                             builder.getFloatAttr(f64, value));
+  };
+  Value gflops = builder.create<arith::DivFOp>(
+      unkLoc, getConstF64(static_cast<double>(flops) / 1e9), mean);
+  Value gbytes = builder.create<arith::DivFOp>(
+      unkLoc, getConstF64(static_cast<double>(bytes) / 1e9), mean);
+  double intensity = bytes ? static_cast<double>(flops) / bytes : 0.0;
+  printValues({gflops, gbytes, getConstF64(intensity)},
+              {"gflops", "gbytes", "intensity"});
+
+  return success();
+}
+
+void MLIRBench::setNumThreads(unsigned numThreads) {
+  builder.create<perf::SetNumThreadsOp>(unkLoc,
+                                        getConstInt(builder, numThreads, 64));
+}
+
+void MLIRBench::printScaling(unsigned numThreads, Value mean, Value baseMean) {
+  // Print ( threads, mean, speedup, efficiency ) relative to the base mean
+  auto f64 = builder.getF64Type();
+  Value threads = builder.create<arith::ConstantOp>(
+      unkLoc, builder.getFloatAttr(f64, numThreads));
+  Value speedup = builder.create<arith::DivFOp>(unkLoc, baseMean, mean);
+  Value efficiency = builder.create<arith::DivFOp>(unkLoc, speedup, threads);
+
+  std::string suffix = "_t" + std::to_string(numThreads);
+  std::string meanKey = "mean" + suffix;
+  std::string speedupKey = "speedup" + suffix;
+  std::string efficiencyKey = "efficiency" + suffix;
+  if (jsonOutput) {
+    printValues({mean, speedup, efficiency},
+                {meanKey, speedupKey, efficiencyKey});
+    return;
+  }
+  printValues({threads, mean, speedup, efficiency},
+              {"threads", meanKey, speedupKey, efficiencyKey});
+}
+
+void MLIRBench::dumpDeltas(Value deltas, StringRef file) {
+  builder.create<perf::DumpOp>(unkLoc, deltas, builder.getStringAttr(file));
+}
+
+void MLIRBench::reportSamples(Value deltas) {
+  assert(jsonOutput && "Samples are only reported as JSON");
+  report("samples", deltas);
+}
+
+void MLIRBench::printCounters() {
+  assert(counters && "Counters were not collected");
+  if (jsonOutput) {
+    // Same order as perf.stop_counters
+    StringRef names[] = {"cycles",     "instructions", "l1d_misses",
+                         "l2_misses",  "llc_misses",   "fp_ops"};
+    static_assert(std::extent_v<decltype(names)> ==
+                      perf::StopCountersOp::kNumEvents,
+                  "Expected a name per counter");
+    for (auto [idx, name] : llvm::enumerate(names)) {
+      Value event = builder.create<memref::LoadOp>(
+          unkLoc, counters, ValueRange{getConstIndex(builder, idx)});
+      report(name, event);
+    }
+    return;
+  }
+
+  auto numEvents = perf::StopCountersOp::kNumEvents;
+  auto vecType = VectorType::get({numEvents}, builder.getI64Type());
+  auto zero = getConstIndex(builder, 0);
+  auto padding = getConstInt(builder, -1, 64);
+  auto vector = builder.create<vector::TransferReadOp>(
+      unkLoc, vecType, counters, ValueRange{zero}, padding);
+  builder.create<vector::PrintOp>(unkLoc, vector);
+}
+
+void MLIRBench::printEnergy() {
+  assert(energy && "Energy was not collected");
+
+  // Joules per iteration, -1 stays for the unavailable domains
+  auto f64 = builder.getF64Type();
+  auto getConstF64 = [&](double value) -> Value {
+    return builder.create<arith::ConstantOp>(unkLoc,
+                                             builder.getFloatAttr(f64, value));
+  };
+  Value zero = getConstF64(0.0);
+  Value unavailable = getConstF64(-1.0);
+  Value iters = getConstF64(energyIters);
+  SmallVector<Value> joules;
+  for (int64_t idx = 0; idx < perf::StopEnergyOp::kNumDomains; idx++) {
+    Value total = builder.create<memref::LoadOp>(
+        unkLoc, energy, ValueRange{getConstIndex(builder, idx)});
+    Value available = builder.create<arith::CmpFOp>(
+        unkLoc, arith::CmpFPredicate::OGE, total, zero);
+    Value perIter = builder.create<arith::DivFOp>(unkLoc, total, iters);
+    joules.push_back(builder.create<arith::SelectOp>(unkLoc, available,
+                                                     perIter, unavailable));
+  }
+
+  // GFLOP/J over the package and DRAM energy, if the FLOPs are known
+  Value gflopPerJoule = unavailable;
+  int64_t flops = 0;
+  int64_t bytes = 0;
+  if (succeeded(estimateKernelCost(flops, bytes))) {
+    Value dram = builder.create<arith::MaximumFOp>(unkLoc, joules[1], zero);
+    Value total = builder.create<arith::AddFOp>(unkLoc, joules[0], dram);
+    Value gflops = builder.create<arith::DivFOp>(
+        unkLoc, getConstF64(static_cast<double>(flops) / 1e9), total);
+    Value available = builder.create<arith::CmpFOp>(
+        unkLoc, arith::CmpFPredicate::OGT, joules[0], zero);
+    gflopPerJoule = builder.create<arith::SelectOp>(unkLoc, available, gflops,
+                                                    unavailable);
+  }
+
+  printValues({joules[0], joules[1], gflopPerJoule},
+              {"pkg_joules", "dram_joules", "gflop_per_joule"});
+}
+
+Value MLIRBench::startEnergy(unsigned iters) {
+  auto bufType = MemRefType::get({perf::StopEnergyOp::kNumDomains},
+                                 builder.getF64Type());
+  energy = builder.create<memref::AllocaOp>(unkLoc, bufType);
+  energyIters = iters;
+  return builder.create<perf::StartEnergyOp>(
+      unkLoc, perf::EnergyType::get(builder.getContext()));
+}
+
 void MLIRBench::printVector(Value vector) {
   auto op = vector;
   auto vectorValue = dyn_cast<VectorType>(vector.getType());
@@ -380,6 +1135,21 @@ LogicalResult MLIRBench::printResult(Operation *kernelCall) {
   // Kernels must return a single result
   Value result = kernelCall->getResult(0);
 
+  // Dynamic results are printed with the sizes of the arguments
+  auto resultTy = cast<ShapedType>(result.getType());
+  if (!resultTy.hasStaticShape()) {
+    unsigned nextDynamicSize = 0;
+    auto shape = getStaticShape(resultTy, nextDynamicSize);
+    if (failed(shape))
+      return failure();
+    if (auto memRefTy = dyn_cast<MemRefType>(resultTy))
+      result = builder.create<memref::CastOp>(
+          unkLoc, MemRefType::get(*shape, memRefTy.getElementType()), result);
+    else
+      result = builder.create<tensor::CastOp>(
+          unkLoc, resultTy.clone(*shape), result);
+  }
+
   bool isIntel = (backend == "intel");
   if (((backend == "cuda") || isIntel) && offloadToDevice) {
     auto resType = cast<ShapedType>(result.getType());
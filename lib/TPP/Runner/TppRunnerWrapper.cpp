@@ -10,7 +10,10 @@
 
 #include "mlir/Conversion/Passes.h"
 #include "mlir/Dialect/Bufferization/IR/Bufferization.h"
+#include "mlir/Dialect/Bufferization/Transforms/OneShotAnalysis.h"
+#include "mlir/Dialect/Bufferization/Transforms/Passes.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/Linalg/Passes.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/IR/Dialect.h"
@@ -18,6 +21,8 @@
 #include "mlir/Pass/PassManager.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 #include "mlir/Transforms/Passes.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/Path.h"
 
 #include "TPP/Dialect/Perf/PerfDialect.h"
 #include "TPP/Runner/MLIRBench.h"
@@ -55,8 +60,36 @@ struct TppRunnerWrapper
       seed = std::time(0);
     }
 
+    if (outputFormat != "text" && outputFormat != "json") {
+      module.emitError("Invalid output format '" + outputFormat + "'");
+      return signalPassFailure();
+    }
+
+    if (!numaPolicy.empty() && numaPolicy != "interleave" &&
+        numaPolicy != "first-touch" && numaPolicy != "shard") {
+      module.emitError("Invalid NUMA policy '" + numaPolicy + "'");
+      return signalPassFailure();
+    }
+
+    int64_t hugePageSize = llvm::StringSwitch<int64_t>(hugePages)
+                               .Case("", 0)
+                               .Case("2MB", int64_t(1) << 21)
+                               .Case("1GB", int64_t(1) << 30)
+                               .Default(-1);
+    if (hugePageSize < 0) {
+      module.emitError("Invalid huge page size '" + hugePages + "'");
+      return signalPassFailure();
+    }
+
     // Benchmark object.
     MLIRBenchConfig config(seed, tensorInitType, backend, offloadToDevice);
+    config.jsonOutput = outputFormat == "json";
+    config.inputDir = inputDir;
+    config.runtimeInit = runtimeInit;
+    config.numaPolicy = numaPolicy;
+    config.hugePageSize = hugePageSize;
+    config.sharedMemory = sharedMemory;
+    config.dynamicSizes.assign(dynamicSizes.begin(), dynamicSizes.end());
     MLIRBench bench(module, config);
 
     // Can only either print or run benchmarks, make this clear before we try to
@@ -76,6 +109,21 @@ struct TppRunnerWrapper
       return;
     }
 
+    if (validate &&
+        (!kernelNames.empty() || backend == "cuda" || backend == "intel")) {
+      (void)bench.emitError(
+          "Validation only supports a single kernel on the CPU");
+      return;
+    }
+
+    // Several kernels benchmarked in turn from a single main.
+    if (!kernelNames.empty()) {
+      if (failed(createMultiKernelBenchmark(bench)))
+        return;
+      (void)bench.terminate();
+      return;
+    }
+
     if (failed(bench.findKernel(kernelName))) {
       (void)bench.emitError("Cannot find kernel '" + kernelName + "'");
       return;
@@ -111,26 +159,37 @@ struct TppRunnerWrapper
       return;
     }
 
+    // The reference is lowered before the kernel is called, so that it gets
+    // the same inputs.
+    func::FuncOp reference;
+    if (validate) {
+      if (bench.getKernel().isExternal()) {
+        (void)bench.emitError("Cannot validate an external kernel");
+        return;
+      }
+      reference = bench.createReferenceKernel();
+      if (failed(lowerReferenceKernel(reference))) {
+        (void)bench.emitError("Cannot lower the reference kernel to loops");
+        return;
+      }
+    }
+
     // Either run once or run benchmarks
     if (numBenchLoops > 1) {
-      if (benchWarmup) {
-        // Warmup to 1% of the total runs, but no less than 1 and no more than
-        // 50.
-        int warmupIter = numBenchLoops / 100;
-        warmupIter = std::max(warmupIter, 1);
-        warmupIter = std::min(warmupIter, 50);
-
-        // This is the warmup loop, if N > 1, ignore the result.
-        (void)bench.createTimerLoop(warmupIter);
+      // Validated once before the benchmark.
+      if (validate && !bench.callAndValidateKernel(reference,
+                                                   validateThreshold)) {
+        (void)bench.emitError("Cannot generate a call to the kernel");
+        return;
       }
-
-      // This is the benchmark loop.
-      auto delta = bench.createTimerLoop(numBenchLoops);
-      auto stats = bench.getTimerStats(delta);
-      (void)bench.printMean(stats);
+      if (failed(createBenchmark(bench, dumpDeltas)))
+        return;
     } else {
       // Call kernel only once.
-      auto *call = bench.callKernel();
+      auto *call = validate
+                       ? bench.callAndValidateKernel(reference,
+                                                     validateThreshold)
+                       : bench.callKernel();
       if (!call) {
         (void)bench.emitError("Cannot generate a call to the kernel");
         return;
@@ -152,6 +211,182 @@ struct TppRunnerWrapper
     // Terminate the created wrapper.
     (void)bench.terminate();
   }
+
+private:
+  // Lowers the reference kernel straight to loops, as the linalg-to-loops
+  // pipeline does. Only its body is bufferized, its tensor arguments and
+  // results are left to the bufferization of the module, while the linalg
+  // passes that follow have nothing to transform in it.
+  LogicalResult lowerReferenceKernel(func::FuncOp reference) {
+    OpPassManager pm(func::FuncOp::getOperationName());
+    pm.addPass(createLowerPacksAndUnPacks());
+    pm.addPass(createDecomposeAggregatedOps());
+    pm.addPass(bufferization::createEmptyTensorToAllocTensorPass());
+    if (failed(runPipeline(pm, reference)))
+      return failure();
+
+    bufferization::OneShotBufferizationOptions buffOpts;
+    if (failed(bufferization::runOneShotBufferize(reference, buffOpts)))
+      return failure();
+
+    // The returned buffers are new allocations, nothing else aliases them.
+    for (Value result :
+         reference.getBody().back().getTerminator()->getOperands()) {
+      if (auto toTensor = result.getDefiningOp<bufferization::ToTensorOp>())
+        toTensor.setRestrict(true);
+    }
+
+    OpPassManager loopsPm(func::FuncOp::getOperationName());
+    loopsPm.addPass(createConvertLinalgToLoopsPass());
+    loopsPm.addPass(createCanonicalizerPass());
+    return runPipeline(loopsPm, reference);
+  }
+
+  // Benchmarks each of the kernels in turn, with their own arguments, from a
+  // main named after the entry point. Results are labelled with the kernel
+  // names, so that they come out as a single report.
+  LogicalResult createMultiKernelBenchmark(MLIRBench &bench) {
+    if (numBenchLoops <= 1 || printResult)
+      return bench.emitError(
+          "Multiple kernels can only be benchmarked (bench-loops > 1)");
+
+    // Find all kernels first. The one named after the entry point, if any,
+    // is moved to a local name as for a single kernel.
+    SmallVector<std::pair<std::string, func::FuncOp>> kernels;
+    bench.setMainName(kernelName);
+    for (auto &name : kernelNames) {
+      if (failed(bench.findKernel(name)))
+        return bench.emitError("Cannot find kernel '" + name + "'");
+      if (randomSplat && failed(bench.replaceSplatWithRandom()))
+        return bench.emitError(
+            "Error converting splat tensors with random values");
+      if (name == kernelName && failed(bench.renameKernel()))
+        return bench.emitError("Cannot rename kernel function");
+      kernels.push_back({name, bench.getKernel()});
+    }
+    if (SymbolTable::lookupSymbolIn(getOperation(), kernelName))
+      return bench.emitError("Entry point '" + kernelName +
+                             "' is a function that is not benchmarked");
+
+    if (failed(bench.createMainWrapper()))
+      return bench.emitError("Cannot create main wrapper");
+
+    for (auto [idx, entry] : llvm::enumerate(kernels)) {
+      auto &[name, kernel] = entry;
+      bench.setKernel(kernel);
+      bench.labelResults(name);
+      if (failed(bench.createKernelArgs()))
+        return bench.emitError("Cannot create inputs of kernel '" + name +
+                               "'");
+      // Each kernel dumps to its own file, numbered before the extension:
+      // deltas.txt becomes deltas.0.txt, deltas.1.txt, ...
+      SmallString<128> deltasPath(dumpDeltas);
+      if (!deltasPath.empty()) {
+        std::string ext = llvm::sys::path::extension(deltasPath).str();
+        llvm::sys::path::replace_extension(deltasPath, Twine(idx) + ext);
+      }
+      if (failed(createBenchmark(bench, deltasPath)))
+        return failure();
+    }
+    return success();
+  }
+
+  // Emits the warmup and benchmark loops of the current kernel and prints
+  // their results. The iteration times are written to deltasPath, if any.
+  LogicalResult createBenchmark(MLIRBench &bench, StringRef deltasPath) {
+    // Warmup to 1% of the total runs, but no less than 1 and no more than
+    // 50.
+    int warmupIter = numBenchLoops / 100;
+    warmupIter = std::max(warmupIter, 1);
+    warmupIter = std::min(warmupIter, 50);
+
+    // Compiled once, benchmarked at each thread count.
+    if (sweepThreads > 0) {
+      if (perfCounters || perfEnergy || deviceTimer || subtractOverhead ||
+          benchStats || !deltasPath.empty() || reportSamples || flushCache ||
+          roofline)
+        return bench.emitError(
+            "Thread sweep only supports the default benchmark loop");
+
+      // 1, 2, 4, ... up to and including the maximum.
+      SmallVector<unsigned> threadCounts;
+      for (unsigned threads = 1; threads < sweepThreads; threads *= 2)
+        threadCounts.push_back(threads);
+      threadCounts.push_back(sweepThreads);
+
+      Value baseMean;
+      for (unsigned threads : threadCounts) {
+        bench.setNumThreads(threads);
+        // Also warms up the thread pool at the new size.
+        if (benchWarmup)
+          (void)bench.createTimerLoop(warmupIter);
+        auto delta = bench.createTimerLoop(numBenchLoops);
+        auto mean = bench.getTimerStats(delta);
+        if (!baseMean)
+          baseMean = mean;
+        bench.printScaling(threads, mean, baseMean);
+      }
+
+      return success();
+    }
+
+    if (benchWarmup) {
+      // This is the warmup loop, if N > 1, ignore the result.
+      (void)bench.createTimerLoop(warmupIter);
+    }
+
+    // Per-iteration statistics need every delta to be recorded. Cold cache
+    // runs need it too, to keep the flush out of the timed region.
+    bool sampled =
+        benchStats || !deltasPath.empty() || reportSamples || flushCache;
+    if (sampled && subtractOverhead)
+      return bench.emitError(
+          "Cannot subtract overhead from per-iteration samples");
+    if (flushCache && perfCounters)
+      return bench.emitError(
+          "Cannot collect counters while flushing caches, the flush would "
+          "be counted");
+    if (flushCache && perfEnergy)
+      return bench.emitError(
+          "Cannot collect energy while flushing caches, the flush would be "
+          "counted");
+    if (reportSamples && outputFormat != "json")
+      return bench.emitError("Reporting the samples requires JSON output");
+
+    if (deviceTimer && (backend == "cpu" || !offloadToDevice))
+      return bench.emitError(
+          "Device timers require the kernel to be offloaded to a GPU");
+
+    // This is the benchmark loop.
+    Value deviceTimerHandle;
+    if (deviceTimer)
+      deviceTimerHandle = bench.startDeviceTimer();
+    Value delta;
+    if (sampled)
+      delta = bench.createSampledTimerLoop(numBenchLoops, perfCounters,
+                                           flushCache, perfEnergy);
+    else
+      delta = bench.createTimerLoop(numBenchLoops, perfCounters,
+                                    subtractOverhead, perfEnergy);
+    auto stats = bench.getTimerStats(delta);
+    (void)bench.printMean(stats);
+    if (deviceTimer)
+      bench.printDeviceMean(deviceTimerHandle, numBenchLoops);
+    if (roofline && failed(bench.printRoofline(stats)))
+      return bench.emitError("Cannot estimate the kernel FLOPs and bytes, "
+                             "static shapes and loop bounds are required");
+    if (benchStats)
+      bench.printSampleStats(delta);
+    if (!deltasPath.empty())
+      bench.dumpDeltas(delta, deltasPath);
+    if (reportSamples)
+      bench.reportSamples(delta);
+    if (perfCounters)
+      bench.printCounters();
+    if (perfEnergy)
+      bench.printEnergy();
+    return success();
+  }
 };
 
 } // namespace
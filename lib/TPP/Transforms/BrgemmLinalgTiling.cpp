@@ -10,6 +10,7 @@
 //
 //===----------------------------------------------------------------------===//
 #include "TPP/Transforms/Transforms.h"
+#include "TPP/Transforms/Utils/BlockingCostModel.h"
 #include "mlir/Dialect/Affine/IR/AffineOps.h"
 #include "mlir/Dialect/Affine/IR/AffineValueMap.h"
 #include "mlir/Dialect/Affine/Utils.h"
@@ -43,6 +44,136 @@ using namespace mlir::tpp;
 
 namespace mlir {
 namespace tpp {
+
+// Return the [M, K] and [K, N] tile counts of `brgemmOp` for a register tile
+// selected from the vector register file of the target. K is not tiled so
+// that the micro-kernel is a sequence of broadcasts and FMAs. With SME, the
+// tile accumulates in the ZA array over the whole K instead.
+static FailureOr<std::pair<SmallVector<int64_t>, SmallVector<int64_t>>>
+getRegisterTileShapes(linalg::BatchReduceMatmulOp brgemmOp) {
+  auto lhsType = cast<MemRefType>(brgemmOp.getDpsInputs()[0].getType());
+  auto accType = cast<MemRefType>(brgemmOp.getDpsInits()[0].getType());
+  if (!lhsType.hasStaticShape() || !accType.hasStaticShape())
+    return failure();
+  int64_t sizeM = accType.getDimSize(0);
+  int64_t sizeN = accType.getDimSize(1);
+  int64_t sizeK = lhsType.getDimSize(2);
+  auto target = CpuTargetInfo::get(brgemmOp, /*fromTargetArch=*/true);
+  auto block = getRegisterBlock(sizeM, sizeN, accType.getElementType(), target);
+  if (failed(block))
+    return failure();
+  int64_t tilesK = useMatrixTiles(accType.getElementType(), target) ? 1 : sizeK;
+  return std::make_pair(SmallVector<int64_t>{sizeM / block->first, tilesK},
+                        SmallVector<int64_t>{tilesK, sizeN / block->second});
+}
+
+// Check the register tile of `brgemmOp` tiled by `tileShapeM` and
+// `tileShapeN` against the vector register file of the target. Warns when the
+// broadcast and FMA micro-kernel would spill, and reports the tile on request.
+static void checkRegisterTile(linalg::BatchReduceMatmulOp brgemmOp,
+                              ArrayRef<int64_t> tileShapeM,
+                              ArrayRef<int64_t> tileShapeN, bool report) {
+  auto lhsType = cast<MemRefType>(brgemmOp.getDpsInputs()[0].getType());
+  auto accType = cast<MemRefType>(brgemmOp.getDpsInits()[0].getType());
+  int64_t blockM = accType.getDimSize(0) / tileShapeM[0];
+  int64_t blockN = accType.getDimSize(1) / tileShapeN[1];
+  int64_t blockK = lhsType.getDimSize(2) / tileShapeM[1];
+  auto target = CpuTargetInfo::get(brgemmOp, /*fromTargetArch=*/true);
+  if (useMatrixTiles(accType.getElementType(), target)) {
+    if (report) {
+      brgemmOp.emitRemark("register block ")
+          << blockM << "x" << blockN << " accumulates in the ZA array";
+    }
+    return;
+  }
+  int64_t pressure = getRegisterBlockPressure(
+      blockM, blockN, accType.getElementType(), target);
+  // Only the micro-kernel of a K block of one is register allocated as such.
+  if (blockK == 1 && pressure > target.numVectorRegisters) {
+    brgemmOp.emitWarning("register block ")
+        << blockM << "x" << blockN << " needs " << pressure
+        << " vector registers, the target has " << target.numVectorRegisters;
+    return;
+  }
+  if (report) {
+    brgemmOp.emitRemark("register block ")
+        << blockM << "x" << blockN << " uses " << pressure << " of "
+        << target.numVectorRegisters << " vector registers";
+  }
+}
+
+// Split `brgemmOp` into the brgemms of the rows [0, mainM) and [mainM, M) by
+// the columns [0, mainN) and [mainN, N) of its accumulator, so that full
+// register tiles cover the first one and the edges are tiled on their own.
+static void peelBrgemm(RewriterBase &rewriter,
+                       linalg::BatchReduceMatmulOp brgemmOp, int64_t mainM,
+                       int64_t mainN) {
+  Value lhs = brgemmOp.getDpsInputs()[0];
+  Value rhs = brgemmOp.getDpsInputs()[1];
+  Value acc = brgemmOp.getDpsInits()[0];
+  auto lhsType = cast<MemRefType>(lhs.getType());
+  auto rhsType = cast<MemRefType>(rhs.getType());
+  auto accType = cast<MemRefType>(acc.getType());
+  int64_t sizeB = lhsType.getDimSize(0);
+  int64_t sizeK = lhsType.getDimSize(2);
+  SmallVector<std::pair<int64_t, int64_t>> rows{{0, mainM}};
+  if (mainM < accType.getDimSize(0))
+    rows.emplace_back(mainM, accType.getDimSize(0) - mainM);
+  SmallVector<std::pair<int64_t, int64_t>> cols{{0, mainN}};
+  if (mainN < rhsType.getDimSize(2))
+    cols.emplace_back(mainN, rhsType.getDimSize(2) - mainN);
+
+  Location loc = brgemmOp.getLoc();
+  rewriter.setInsertionPoint(brgemmOp);
+  auto subview = [&](Value source, ArrayRef<int64_t> offsets,
+                     ArrayRef<int64_t> sizes) -> Value {
+    if (cast<MemRefType>(source.getType()).getShape() == sizes)
+      return source;
+    SmallVector<int64_t> strides(offsets.size(), 1);
+    return rewriter.create<memref::SubViewOp>(loc, source, offsets, sizes,
+                                              strides);
+  };
+  for (auto [offsetM, sizeM] : rows) {
+    Value lhsRows = subview(lhs, {0, offsetM, 0}, {sizeB, sizeM, sizeK});
+    for (auto [offsetN, sizeN] : cols) {
+      Value rhsCols = subview(rhs, {0, 0, offsetN}, {sizeB, sizeK, sizeN});
+      Value accTile = subview(acc, {offsetM, offsetN}, {sizeM, sizeN});
+      rewriter.create<linalg::BatchReduceMatmulOp>(
+          loc, ValueRange{lhsRows, rhsCols}, ValueRange{accTile});
+    }
+  }
+  rewriter.eraseOp(brgemmOp);
+}
+
+// Peel the edges of the brgemms whose dimensions are not divided by the
+// register tile of the target.
+static void peelRegisterTileRemainders(Operation *root) {
+  SmallVector<std::tuple<linalg::BatchReduceMatmulOp, int64_t, int64_t>>
+      peeled;
+  root->walk([&](linalg::BatchReduceMatmulOp brgemmOp) {
+    if (!brgemmOp.hasPureBufferSemantics())
+      return;
+    auto lhsType = cast<MemRefType>(brgemmOp.getDpsInputs()[0].getType());
+    auto accType = cast<MemRefType>(brgemmOp.getDpsInits()[0].getType());
+    if (!lhsType.hasStaticShape() || !accType.hasStaticShape())
+      return;
+    int64_t sizeM = accType.getDimSize(0);
+    int64_t sizeN = accType.getDimSize(1);
+    auto target = CpuTargetInfo::get(brgemmOp, /*fromTargetArch=*/true);
+    auto block = getRegisterBlock(sizeM, sizeN, accType.getElementType(),
+                                  target, /*allowRemainder=*/true);
+    if (failed(block))
+      return;
+    int64_t mainM = sizeM - sizeM % block->first;
+    int64_t mainN = sizeN - sizeN % block->second;
+    if (mainM != sizeM || mainN != sizeN)
+      peeled.emplace_back(brgemmOp, mainM, mainN);
+  });
+  IRRewriter rewriter(root->getContext());
+  for (auto [brgemmOp, mainM, mainN] : peeled)
+    peelBrgemm(rewriter, brgemmOp, mainM, mainN);
+}
+
 struct LinalgOpTiling : OpRewritePattern<linalg::BatchReduceMatmulOp> {
   using OpRewritePattern<linalg::BatchReduceMatmulOp>::OpRewritePattern;
 
@@ -54,11 +185,18 @@ struct LinalgOpTiling : OpRewritePattern<linalg::BatchReduceMatmulOp> {
 
     if (!brgemmOp.hasPureBufferSemantics())
       return failure();
-    //  Get the M and N tile shape from the user input
+    //  Get the M and N tile shape from the user input, or from the target
+    //  register file when not given.
     SmallVector<int64_t> tileShapeM(options.mTileShape.begin(),
                                     options.mTileShape.end());
     SmallVector<int64_t> tileShapeN(options.nTileShape.begin(),
                                     options.nTileShape.end());
+    if (tileShapeM.empty() && tileShapeN.empty()) {
+      auto tileShapes = getRegisterTileShapes(brgemmOp);
+      if (failed(tileShapes))
+        return failure();
+      std::tie(tileShapeM, tileShapeN) = *tileShapes;
+    }
 
     if (tileShapeM.size() != 2 || tileShapeN.size() != 2)
            return failure();
@@ -66,6 +204,12 @@ struct LinalgOpTiling : OpRewritePattern<linalg::BatchReduceMatmulOp> {
     if (tileShapeM[1] != tileShapeN[0])
             return failure();
 
+    if (llvm::is_contained(tileShapeM, 0) || llvm::is_contained(tileShapeN, 0))
+      return failure();
+
+    checkRegisterTile(brgemmOp, tileShapeM, tileShapeN,
+                      options.reportRegisterBlock);
+
     // Stores the M, N, and K Tile Sizes
     SmallVector<int64_t> mxnxkTile(3);
      // Stores the M, and N Tile Sizes
@@ -226,6 +370,10 @@ struct BrgemmLinalgTiling : public tpp::impl::BrgemmLinalgTilingBase<BrgemmLinal
     BrgemmLinalgTilingOptions options;
     options.mTileShape = SmallVector<unsigned>{*mTileShape};
     options.nTileShape = SmallVector<unsigned>{*nTileShape};
+    options.reportRegisterBlock = reportRegisterBlock;
+    // Given tiles are applied as is.
+    if (peelRemainders && mTileShape.empty() && nTileShape.empty())
+      peelRegisterTileRemainders(getOperation());
     RewritePatternSet patterns(&getContext());
     populateBrgemmLinalgTilingPatterns(patterns, options);
     GreedyRewriteConfig config;
@@ -0,0 +1,151 @@
+//===- BrgemmPrefetch.cpp ----------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements software prefetching of the next blocks of A and B in
+// the loops of the vectorized brgemms.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Arith/Utils/Utils.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/IR/Builders.h"
+#include "llvm/Support/Debug.h"
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_BRGEMMPREFETCH
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+using namespace mlir;
+
+#define DEBUG_TYPE "brgemm-prefetch"
+
+// Prefetches are issued per cache line, at most this many per block.
+static constexpr int64_t kCacheLineBytes = 64;
+static constexpr int64_t kMaxPrefetchLines = 16;
+
+// Returns the loop whose induction variable indexes the leading dimension of
+// `subview`, if it reads a block of a brgemm operand: a static block of a
+// single batch of an operand of rank 3 or more (4 in VNNI layout) defined
+// outside the loop.
+static scf::ForOp getBatchReduceLoop(memref::SubViewOp subview) {
+  MemRefType sourceType = subview.getSourceType();
+  MemRefType blockType = subview.getType();
+  if (sourceType.getRank() < 3 || blockType.getRank() != sourceType.getRank() ||
+      !blockType.hasStaticShape() || blockType.getDimSize(0) != 1 ||
+      !llvm::all_of(subview.getStaticStrides(),
+                    [](int64_t stride) { return stride == 1; }))
+    return nullptr;
+
+  if (!subview.isDynamicOffset(0))
+    return nullptr;
+  auto iv = dyn_cast<BlockArgument>(subview.getDynamicOffset(0));
+  if (!iv)
+    return nullptr;
+  auto forOp = dyn_cast<scf::ForOp>(iv.getOwner()->getParentOp());
+  if (!forOp || forOp.getInductionVar() != iv ||
+      !forOp.isDefinedOutsideOfLoop(subview.getSource()))
+    return nullptr;
+  return forOp;
+}
+
+namespace {
+
+struct BrgemmPrefetch : public tpp::impl::BrgemmPrefetchBase<BrgemmPrefetch> {
+  using BrgemmPrefetchBase::BrgemmPrefetchBase;
+
+  void runOnOperation() override {
+    if (distance <= 0)
+      return;
+
+    SmallVector<std::pair<memref::SubViewOp, scf::ForOp>> blocks;
+    getOperation()->walk([&](memref::SubViewOp subview) {
+      if (scf::ForOp forOp = getBatchReduceLoop(subview))
+        blocks.push_back({subview, forOp});
+    });
+
+    DenseMap<Operation *, Value> nextIndices;
+    for (auto [subview, forOp] : blocks) {
+      Value &next = nextIndices[forOp];
+      if (!next)
+        next = getNextIndex(forOp);
+      insertPrefetches(subview, next);
+    }
+  }
+
+private:
+  // Returns the induction variable of `forOp` `distance` iterations ahead,
+  // clamped to the last one, computed at the start of its body.
+  Value getNextIndex(scf::ForOp forOp) {
+    OpBuilder builder = OpBuilder::atBlockBegin(forOp.getBody());
+    Location loc = forOp.getLoc();
+    Value ahead = builder.create<arith::MulIOp>(
+        loc, forOp.getStep(),
+        builder.create<arith::ConstantIndexOp>(loc, distance));
+    Value next =
+        builder.create<arith::AddIOp>(loc, forOp.getInductionVar(), ahead);
+    Value last = builder.create<arith::SubIOp>(
+        loc, forOp.getUpperBound(),
+        builder.create<arith::ConstantIndexOp>(loc, 1));
+    return builder.create<arith::MinSIOp>(loc, next, last);
+  }
+
+  // Prefetches the lines of the block of `subview` at the batch `next`, row
+  // by row, before the subview.
+  void insertPrefetches(memref::SubViewOp subview, Value next) {
+    MemRefType blockType = subview.getType();
+    int64_t elementBytes =
+        llvm::divideCeil(blockType.getElementTypeBitWidth(), 8);
+    int64_t lineElements = std::max<int64_t>(kCacheLineBytes / elementBytes, 1);
+    ArrayRef<int64_t> shape = blockType.getShape();
+    int64_t rank = blockType.getRank();
+
+    OpBuilder builder(subview);
+    Location loc = subview.getLoc();
+    SmallVector<Value> offsets = getValueOrCreateConstantIndexOp(
+        builder, loc, subview.getMixedOffsets());
+    offsets[0] = next;
+
+    // Walk the block in row-major order, one line of the last dimension at a
+    // time.
+    SmallVector<int64_t> position(rank, 0);
+    for (int64_t line = 0; line < kMaxPrefetchLines; line++) {
+      SmallVector<Value> indices(offsets);
+      for (int64_t dim = 1; dim < rank; dim++) {
+        if (position[dim] == 0)
+          continue;
+        indices[dim] = builder.create<arith::AddIOp>(
+            loc, offsets[dim],
+            builder.create<arith::ConstantIndexOp>(loc, position[dim]));
+      }
+      builder.create<memref::PrefetchOp>(loc, subview.getSource(), indices,
+                                         /*isWrite=*/false,
+                                         /*localityHint=*/3,
+                                         /*isDataCache=*/true);
+
+      // Advance to the next line, carrying into the outer dimensions.
+      position[rank - 1] += lineElements;
+      int64_t dim = rank - 1;
+      while (dim > 0 && position[dim] >= shape[dim]) {
+        position[dim] = 0;
+        position[--dim]++;
+      }
+      if (dim == 0)
+        break;
+    }
+  }
+};
+
+} // namespace
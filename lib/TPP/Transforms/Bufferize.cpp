@@ -24,9 +24,11 @@
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/Dialect/Tensor/IR/Tensor.h"
+#include "mlir/Dialect/Tensor/Transforms/Transforms.h"
 #include "mlir/IR/Dialect.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Pass/PassManager.h"
+#include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 #include "mlir/Transforms/Passes.h"
 
 #include "TPP/Dialect/Check/BufferizableOpInterfaceImpl.h"
@@ -44,6 +46,8 @@ namespace tpp {
 #include "TPP/Passes.h.inc"
 #define GEN_PASS_DEF_DUPLICATEFILL
 #include "TPP/Passes.h.inc"
+#define GEN_PASS_DEF_CONCATINPLACE
+#include "TPP/Passes.h.inc"
 } // namespace tpp
 } // namespace mlir
 
@@ -76,6 +80,10 @@ struct DuplicateFill : public tpp::impl::DuplicateFillBase<DuplicateFill> {
   void runOnOperation() override;
 };
 
+struct ConcatInPlace : public tpp::impl::ConcatInPlaceBase<ConcatInPlace> {
+  void runOnOperation() override;
+};
+
 void DuplicateFill::runOnOperation() {
   IRRewriter rewriter(&getContext());
 
@@ -110,12 +118,173 @@ void DuplicateFill::runOnOperation() {
   });
 }
 
+// Returns the static box of the slice of `insertOp`, as offsets and sizes.
+static std::optional<std::pair<SmallVector<int64_t>, SmallVector<int64_t>>>
+getStaticSlice(tensor::InsertSliceOp insertOp) {
+  if (!insertOp.hasUnitStride() ||
+      ShapedType::isDynamicShape(insertOp.getStaticOffsets()) ||
+      ShapedType::isDynamicShape(insertOp.getStaticSizes()))
+    return std::nullopt;
+  return std::make_pair(llvm::to_vector(insertOp.getStaticOffsets()),
+                        llvm::to_vector(insertOp.getStaticSizes()));
+}
+
+// Returns the chain of insert_slice ending at `last`, from the first one, if
+// they insert disjoint static slices into a tensor.empty of the same block,
+// each into the result of the previous one only.
+static FailureOr<SmallVector<tensor::InsertSliceOp>>
+getDisjointInsertChain(tensor::InsertSliceOp last) {
+  SmallVector<tensor::InsertSliceOp> chain = {last};
+  Value dest = last.getDest();
+  while (auto insertOp = dest.getDefiningOp<tensor::InsertSliceOp>()) {
+    if (!dest.hasOneUse() || insertOp->getBlock() != last->getBlock())
+      return failure();
+    chain.push_back(insertOp);
+    dest = insertOp.getDest();
+  }
+  auto emptyOp = dest.getDefiningOp<tensor::EmptyOp>();
+  if (chain.size() < 2 || !emptyOp || !dest.hasOneUse() ||
+      !emptyOp.getDynamicSizes().empty() ||
+      emptyOp->getBlock() != last->getBlock())
+    return failure();
+  std::reverse(chain.begin(), chain.end());
+
+  SmallVector<std::pair<SmallVector<int64_t>, SmallVector<int64_t>>> slices;
+  for (tensor::InsertSliceOp insertOp : chain) {
+    auto slice = getStaticSlice(insertOp);
+    if (!slice)
+      return failure();
+    // Two slices are disjoint if they are along one of the dimensions.
+    for (auto &[offsets, sizes] : slices) {
+      bool disjoint = false;
+      for (auto [offset, size, otherOffset, otherSize] :
+           llvm::zip(slice->first, slice->second, offsets, sizes)) {
+        disjoint |= offset + size <= otherOffset ||
+                    otherOffset + otherSize <= offset;
+      }
+      if (!disjoint)
+        return failure();
+    }
+    slices.push_back(std::move(*slice));
+  }
+  return chain;
+}
+
+// Moves the tensor.empty the producer of `source` writes into, and its fill,
+// right before the producer, where the empty tensor elimination can replace
+// it by a slice of the destination inserted into so far.
+static void sinkProducerInit(Value source) {
+  Value value = source;
+  while (auto dpsOp = value.getDefiningOp<DestinationStyleOpInterface>()) {
+    Value init = dpsOp.getTiedOpOperand(cast<OpResult>(value))->get();
+    Operation *initOp = init.getDefiningOp();
+    if (!init.hasOneUse() || !initOp || initOp->getBlock() != dpsOp->getBlock())
+      return;
+    if (auto emptyOp = dyn_cast<tensor::EmptyOp>(initOp)) {
+      emptyOp->moveBefore(dpsOp);
+      return;
+    }
+    if (auto fillOp = dyn_cast<linalg::FillOp>(initOp)) {
+      Value fillInit = fillOp.getOutputs()[0];
+      auto emptyOp = fillInit.getDefiningOp<tensor::EmptyOp>();
+      if (!emptyOp || !fillInit.hasOneUse() ||
+          emptyOp->getBlock() != fillOp->getBlock())
+        return;
+      fillOp->moveBefore(dpsOp);
+      emptyOp->moveBefore(fillOp);
+      return;
+    }
+    value = init;
+  }
+}
+
+// Rebuilds the disjoint insertions of `chain` in the order their sources are
+// computed, each one right after its source.
+static void reorderInsertChain(RewriterBase &rewriter,
+                               ArrayRef<tensor::InsertSliceOp> chain) {
+  Block *block = chain.front()->getBlock();
+  // The op of the block computing `value`, null if it is computed before.
+  auto getProducer = [&](Value value) -> Operation * {
+    Operation *defOp = value.getDefiningOp();
+    return defOp ? block->findAncestorOpInBlock(*defOp) : nullptr;
+  };
+  SmallVector<tensor::InsertSliceOp> sorted(chain);
+  llvm::stable_sort(sorted, [&](tensor::InsertSliceOp lhs,
+                                tensor::InsertSliceOp rhs) {
+    Operation *lhsProducer = getProducer(lhs.getSource());
+    Operation *rhsProducer = getProducer(rhs.getSource());
+    if (!rhsProducer)
+      return false;
+    return !lhsProducer || lhsProducer->isBeforeInBlock(rhsProducer);
+  });
+
+  Operation *emptyOp = chain.front().getDest().getDefiningOp();
+  if (emptyOp != &block->front())
+    emptyOp->moveBefore(&block->front());
+  Value dest = emptyOp->getResult(0);
+  Operation *insertionPoint = emptyOp;
+  for (tensor::InsertSliceOp insertOp : sorted) {
+    Operation *producer = getProducer(insertOp.getSource());
+    if (producer && insertionPoint->isBeforeInBlock(producer))
+      insertionPoint = producer;
+    rewriter.setInsertionPointAfter(insertionPoint);
+    auto newInsertOp = rewriter.create<tensor::InsertSliceOp>(
+        insertOp.getLoc(), insertOp.getSource(), dest,
+        insertOp.getMixedOffsets(), insertOp.getMixedSizes(),
+        insertOp.getMixedStrides());
+    dest = newInsertOp.getResult();
+    insertionPoint = newInsertOp;
+    sinkProducerInit(insertOp.getSource());
+  }
+
+  rewriter.replaceAllUsesWith(chain.back().getResult(), dest);
+  for (tensor::InsertSliceOp insertOp : llvm::reverse(chain))
+    rewriter.eraseOp(insertOp);
+}
+
+void ConcatInPlace::runOnOperation() {
+  func::FuncOp func = getOperation();
+
+  RewritePatternSet patterns(&getContext());
+  tensor::populateDecomposeTensorConcatPatterns(patterns);
+  if (failed(applyPatternsAndFoldGreedily(func, std::move(patterns))))
+    return signalPassFailure();
+
+  // The last insertion of each chain, which no other one inserts into.
+  SmallVector<tensor::InsertSliceOp> lastInserts;
+  func.walk([&](tensor::InsertSliceOp insertOp) {
+    if (llvm::none_of(insertOp->getUses(), [](OpOperand &use) {
+          auto user = dyn_cast<tensor::InsertSliceOp>(use.getOwner());
+          return user && &use == &user.getDestMutable();
+        }))
+      lastInserts.push_back(insertOp);
+  });
+
+  IRRewriter rewriter(&getContext());
+  for (tensor::InsertSliceOp last : lastInserts) {
+    auto chain = getDisjointInsertChain(last);
+    if (succeeded(chain))
+      reorderInsertChain(rewriter, *chain);
+  }
+}
+
+// Marks the copies inserted by bufferization until they are reported.
+constexpr const static llvm::StringLiteral kBufferizationCopyAttr =
+    "tpp.bufferization_copy";
+
 static LogicalResult defaultMemCpyFn(OpBuilder &builder, Location loc,
                                      Value from, Value to) {
   builder.create<linalg::CopyOp>(loc, from, to);
   return success();
 }
 
+static LogicalResult markedMemCpyFn(OpBuilder &builder, Location loc,
+                                    Value from, Value to) {
+  auto copyOp = builder.create<linalg::CopyOp>(loc, from, to);
+  copyOp->setAttr(kBufferizationCopyAttr, builder.getUnitAttr());
+  return success();
+}
+
 void Bufferize::runOnOperation() {
   ModuleOp moduleOp = getOperation();
 
@@ -124,6 +293,7 @@ void Bufferize::runOnOperation() {
   // Pre-processing.
   if (this->duplicateFill)
     passManager.addNestedPass<func::FuncOp>(tpp::createDuplicateFill());
+  passManager.addNestedPass<func::FuncOp>(tpp::createConcatInPlace());
   passManager.addPass(bufferization::createEmptyTensorEliminationPass());
   passManager.addPass(bufferization::createEmptyTensorToAllocTensorPass());
 
@@ -132,7 +302,7 @@ void Bufferize::runOnOperation() {
   buffOpts.bufferizeFunctionBoundaries = true;
   buffOpts.setFunctionBoundaryTypeConversion(
       bufferization::LayoutMapOption::IdentityLayoutMap);
-  buffOpts.memCpyFn = defaultMemCpyFn;
+  buffOpts.memCpyFn = this->reportCopies ? markedMemCpyFn : defaultMemCpyFn;
   bool runOnlyAnalysis = this->testAnalysisOnly || this->printConflicts;
   if (runOnlyAnalysis) {
     buffOpts.printConflicts = this->printConflicts;
@@ -161,6 +331,17 @@ void Bufferize::runOnOperation() {
   passManager.addPass(createBufferizationToMemRefPass());
   if (failed(runPipeline(passManager, moduleOp)))
     return signalPassFailure();
+
+  // Report the copies that survived the cleanups, e.g. the ones left by the
+  // read-after-write conflicts of chains not written in place.
+  if (this->reportCopies) {
+    moduleOp->walk([](linalg::CopyOp copyOp) {
+      if (!copyOp->removeAttr(kBufferizationCopyAttr))
+        return;
+      copyOp.emitRemark("copy inserted by bufferization: ")
+          << copyOp.getInputs()[0].getType();
+    });
+  }
 }
 
 } // namespace
@@ -0,0 +1,199 @@
+//===- CacheInvariantPacks.cpp -----------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "TPP/Transforms/Utils/BuilderUtils.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Bufferization/IR/Bufferization.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Tensor/IR/Tensor.h"
+#include "mlir/IR/IRMapping.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/xxhash.h"
+
+using namespace mlir;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_CACHEINVARIANTPACKS
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+namespace {
+
+// Marks the function arguments that hold the same data across calls.
+constexpr const static llvm::StringLiteral kInvariantAttr = "tpp.invariant";
+
+// Pack cache runtime entry points, see runtime/PackCacheRunnerUtils.h.
+constexpr const static llvm::StringLiteral kLookupFunc =
+    "tpp_pack_cache_lookup";
+constexpr const static llvm::StringLiteral kIsValidFunc =
+    "tpp_pack_cache_is_valid";
+constexpr const static llvm::StringLiteral kCommitFunc =
+    "tpp_pack_cache_commit";
+
+// Return the chain of packs from an invariant function argument to `packOp`,
+// innermost first (e.g., the blocking then the VNNI pack of a weight). Empty
+// if `packOp` doesn't pack an invariant argument.
+static SmallVector<tensor::PackOp> getInvariantPackChain(tensor::PackOp packOp) {
+  SmallVector<tensor::PackOp> chain;
+  Value source = packOp.getResult();
+  while (auto pack = source.getDefiningOp<tensor::PackOp>()) {
+    if (pack.getPaddingValue() || !pack.getDestType().hasStaticShape() ||
+        !pack.getDest().getDefiningOp<tensor::EmptyOp>())
+      return {};
+    chain.insert(chain.begin(), pack);
+    source = pack.getSource();
+  }
+
+  auto arg = dyn_cast<BlockArgument>(source);
+  if (!arg || !arg.getOwner()->isEntryBlock())
+    return {};
+  auto funcOp = dyn_cast<func::FuncOp>(arg.getOwner()->getParentOp());
+  if (!funcOp || !funcOp.getArgAttr(arg.getArgNumber(), kInvariantAttr) ||
+      !cast<RankedTensorType>(arg.getType()).hasStaticShape())
+    return {};
+  return chain;
+}
+
+// Return an identifier of the layout produced by `chain`, the same for all the
+// packs of a source into the same layout.
+static int64_t getLayoutId(ArrayRef<tensor::PackOp> chain) {
+  std::string layout;
+  llvm::raw_string_ostream os(layout);
+  for (tensor::PackOp pack : chain) {
+    os << pack.getDestType() << "[";
+    llvm::interleaveComma(pack.getInnerDimsPos(), os);
+    os << "][";
+    llvm::interleaveComma(pack.getStaticInnerTiles(), os);
+    os << "][";
+    llvm::interleaveComma(pack.getOuterDimsPerm(), os);
+    os << "]";
+  }
+  return static_cast<int64_t>(llvm::xxHash64(os.str()));
+}
+
+// Replace the last pack of `chain` with the buffer of its cache entry, packing
+// into the buffer only when the entry is not valid:
+//
+// %buf = tpp_pack_cache_lookup(&source, layout, bytes)
+// if (!tpp_pack_cache_is_valid(&source, layout)) {
+//   %buf = pack(source)
+//   tpp_pack_cache_commit(&source, layout)
+// }
+// %packed = to_tensor(%buf)
+static void cachePack(RewriterBase &rewriter, ModuleOp module,
+                      ArrayRef<tensor::PackOp> chain) {
+  tensor::PackOp packOp = chain.back();
+  Value source = chain.front().getSource();
+  Location loc = packOp.getLoc();
+  OpBuilder::InsertionGuard guard(rewriter);
+  rewriter.setInsertionPoint(packOp);
+
+  Type i64 = rewriter.getI64Type();
+  Type i8 = rewriter.getI8Type();
+  func::FuncOp lookupFunc = getOrCreateRuntimeFunc(
+      module, kLookupFunc, {i64, i64, i64}, UnrankedMemRefType::get(i8, 0),
+      /*emitCInterface=*/true);
+  func::FuncOp isValidFunc =
+      getOrCreateRuntimeFunc(module, kIsValidFunc, {i64, i64}, i64);
+  func::FuncOp commitFunc =
+      getOrCreateRuntimeFunc(module, kCommitFunc, {i64, i64}, {});
+
+  // The address of the argument identifies its data.
+  auto sourceType = cast<RankedTensorType>(source.getType());
+  Value sourceBuffer = rewriter.create<bufferization::ToMemrefOp>(
+      loc, MemRefType::get(sourceType.getShape(), sourceType.getElementType()),
+      source, /*read_only=*/true);
+  Value address = rewriter.create<memref::ExtractAlignedPointerAsIndexOp>(
+      loc, rewriter.getIndexType(), sourceBuffer);
+  address = rewriter.create<arith::IndexCastOp>(loc, i64, address);
+  Value layout = rewriter.create<arith::ConstantOp>(
+      loc, rewriter.getI64IntegerAttr(getLayoutId(chain)));
+
+  RankedTensorType packedType = packOp.getDestType();
+  int64_t bytes =
+      packedType.getNumElements() *
+      llvm::divideCeil(packedType.getElementType().getIntOrFloatBitWidth(), 8);
+  Value numBytes =
+      rewriter.create<arith::ConstantOp>(loc, rewriter.getI64IntegerAttr(bytes));
+  Value entry = rewriter
+                    .create<func::CallOp>(loc, lookupFunc,
+                                          ValueRange{address, layout, numBytes})
+                    .getResult(0);
+  entry = rewriter.create<memref::CastOp>(
+      loc, MemRefType::get({ShapedType::kDynamic}, i8), entry);
+  Value zero = rewriter.create<arith::ConstantIndexOp>(loc, 0);
+  Value buffer = rewriter.create<memref::ViewOp>(
+      loc, MemRefType::get(packedType.getShape(), packedType.getElementType()),
+      entry, zero, ValueRange{});
+
+  Value isValid = rewriter
+                      .create<func::CallOp>(loc, isValidFunc,
+                                            ValueRange{address, layout})
+                      .getResult(0);
+  Value falseValue =
+      rewriter.create<arith::ConstantOp>(loc, rewriter.getI64IntegerAttr(0));
+  Value isMiss = rewriter.create<arith::CmpIOp>(loc, arith::CmpIPredicate::eq,
+                                                isValid, falseValue);
+  auto ifOp = rewriter.create<scf::IfOp>(loc, isMiss, /*withElseRegion=*/false);
+
+  // Pack into the entry on a miss. The packs of the chain are cloned, the
+  // original ones may have other users.
+  rewriter.setInsertionPointToStart(ifOp.thenBlock());
+  IRMapping mapping;
+  for (tensor::PackOp pack : chain) {
+    rewriter.clone(*pack.getDest().getDefiningOp(), mapping);
+    rewriter.clone(*pack, mapping);
+  }
+  rewriter.create<bufferization::MaterializeInDestinationOp>(
+      loc, /*result=*/Type(), mapping.lookup(packOp.getResult()), buffer,
+      /*restrict=*/true, /*writable=*/true);
+  rewriter.create<func::CallOp>(loc, commitFunc, ValueRange{address, layout});
+
+  rewriter.setInsertionPointAfter(ifOp);
+  Value packed = rewriter.create<bufferization::ToTensorOp>(
+      loc, buffer, /*restrict=*/true, /*writable=*/false);
+  rewriter.replaceOp(packOp, packed);
+
+  // Drop the packs of the chain that are now unused.
+  for (tensor::PackOp pack : llvm::reverse(chain.drop_back())) {
+    if (pack->use_empty())
+      rewriter.eraseOp(pack);
+  }
+}
+
+struct CacheInvariantPacks
+    : public tpp::impl::CacheInvariantPacksBase<CacheInvariantPacks> {
+  void runOnOperation() override {
+    ModuleOp module = getOperation();
+
+    // Only cache the last pack of each chain, the intermediate packs only
+    // feed the next pack.
+    SmallVector<SmallVector<tensor::PackOp>> chains;
+    module.walk([&](tensor::PackOp packOp) {
+      if (llvm::all_of(packOp->getUsers(), [](Operation *user) {
+            return isa<tensor::PackOp>(user);
+          }))
+        return;
+      SmallVector<tensor::PackOp> chain = getInvariantPackChain(packOp);
+      if (!chain.empty())
+        chains.push_back(std::move(chain));
+    });
+
+    // Outer chains first, their inner packs may end other chains.
+    IRRewriter rewriter(&getContext());
+    for (auto &chain : llvm::reverse(chains))
+      cachePack(rewriter, module, chain);
+  }
+};
+
+} // namespace
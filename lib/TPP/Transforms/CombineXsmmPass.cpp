@@ -35,7 +35,11 @@ struct CombineXsmmOp : public OpRewritePattern<xsmm::BrgemmOp> {
   LogicalResult matchAndRewrite(xsmm::BrgemmOp brgemmOp,
                                 PatternRewriter &rewriter) const override {
     auto *output = brgemmOp.getOperand(3).getDefiningOp();
-    if (!output)
+    auto brgemmDispatch =
+        brgemmOp.getOperand(0).getDefiningOp<xsmm::BrgemmDispatchOp>();
+    // The fused dispatch has no runtime sizes and stores C in the input type.
+    if (!output || !brgemmDispatch || brgemmDispatch.hasDynamicInputs() ||
+        brgemmDispatch.getOutputType())
       return failure();
 
     // First, match the required fused ops
@@ -43,33 +47,44 @@ struct CombineXsmmOp : public OpRewritePattern<xsmm::BrgemmOp> {
     if (failed(result))
       return failure();
     auto fusedMatch = *result;
-    // TODO: Support BRGEMM + BINARY && BRGEMM + UNARY patterns
-    if (!fusedMatch.binaryOp || !fusedMatch.unaryOp)
+    if (!fusedMatch.binaryOp && !fusedMatch.unaryOp)
       return failure();
     // Validate broadcast flags
-    auto unaryFlags =
-        xsmm::utils::getUnaryFlags(fusedMatch.unaryOp.getOperand(0).getType(),
-                                   fusedMatch.unaryOp.getOperand(2).getType());
-    if (unaryFlags != mlir::xsmm::UnaryFlags::BCAST_SCALAR &&
-        unaryFlags != mlir::xsmm::UnaryFlags::NONE)
-      return failure();
+    if (fusedMatch.unaryOp) {
+      auto unaryFlags = xsmm::utils::getUnaryFlags(
+          fusedMatch.unaryOp.getOperand(0).getType(),
+          fusedMatch.unaryOp.getOperand(2).getType());
+      if (unaryFlags != mlir::xsmm::UnaryFlags::BCAST_SCALAR &&
+          unaryFlags != mlir::xsmm::UnaryFlags::NONE)
+        return failure();
+    }
 
-    // TODO: Support more than just COL_0 BCAST
-    auto binaryFlags =
-        xsmm::utils::getBinaryFlags(fusedMatch.binaryOp.getOperand(1).getType(),
-                                    fusedMatch.binaryOp.getOperand(3).getType(),
-                                    mlir::xsmm::utils::OperandPos::LHS);
-    int binaryArg = 0;
-    switch (*binaryFlags) {
-    case mlir::xsmm::BinaryFlags::BCAST_COL_IN_0:
-      binaryArg = 1;
-      break;
-    case mlir::xsmm::BinaryFlags::BCAST_COL_IN_1:
-      binaryArg = 2;
-      binaryFlags = mlir::xsmm::BinaryFlags::BCAST_COL_IN_0;
-      break;
-    default:
-      return failure();
+    // The bias is the first input of the binary and the BRGEMM output the
+    // second one. The fused kernel reads the bias as operand D.
+    // Without a binary, D is unused and the output is passed instead.
+    Value operandD = brgemmOp.getOperand(3);
+    auto binaryFlags = mlir::xsmm::BinaryFlags::NONE;
+    if (fusedMatch.binaryOp) {
+      operandD = fusedMatch.binaryOp.getOperand(1);
+      if (fusedMatch.binaryOp.getOperand(2) != brgemmOp.getOperand(3) ||
+          !isa<MemRefType>(operandD.getType()))
+        return failure();
+      auto flags = xsmm::utils::getBinaryFlags(
+          operandD.getType(), fusedMatch.binaryOp.getOperand(3).getType(),
+          mlir::xsmm::utils::OperandPos::LHS);
+      if (failed(flags))
+        return failure();
+      // The fused kernel reads D as a broadcast bias only. A full D operand
+      // (an element-wise add of two matrices) keeps the unfused binary.
+      switch (*flags) {
+      case mlir::xsmm::BinaryFlags::BCAST_COL_IN_0:
+      case mlir::xsmm::BinaryFlags::BCAST_ROW_IN_0:
+      case mlir::xsmm::BinaryFlags::BCAST_SCALAR_IN_0:
+        binaryFlags = *flags;
+        break;
+      default:
+        return failure();
+      }
     }
     // Now, replace the ops with a fused BRGEMM
     auto dtype =
@@ -77,17 +92,12 @@ struct CombineXsmmOp : public OpRewritePattern<xsmm::BrgemmOp> {
     IntegerType integer64 = IntegerType::get(rewriter.getContext(), 64);
 
     Location loc = brgemmOp.getLoc();
-    auto dims = DenseI64ArrayAttr::get(
-        rewriter.getContext(), dyn_cast<mlir::xsmm::BrgemmDispatchOp>(
-                                   brgemmOp.getOperand(0).getDefiningOp())
-                                   .getInputs());
+    auto dims = DenseI64ArrayAttr::get(rewriter.getContext(),
+                                       brgemmDispatch.getInputs());
     auto memrefB = brgemmOp.getOperand(2);
     int64_t batchSize = cast<ShapedType>(memrefB.getType()).getShape()[0];
     auto brgemmFlags = xsmm::utils::getBrgemmFlags<xsmm::BrgemmDispatchOp>(
-        rewriter,
-        dyn_cast<xsmm::BrgemmDispatchOp>(
-            brgemmOp.getOperand(0).getDefiningOp()),
-        true);
+        rewriter, brgemmDispatch, true);
     if (failed(brgemmFlags))
       return failure();
     auto attributes = *brgemmFlags;
@@ -100,7 +110,9 @@ struct CombineXsmmOp : public OpRewritePattern<xsmm::BrgemmOp> {
                                                     xsmm::GemmFlags::BETA_0));
     }
     OpBuilder::InsertionGuard guard(rewriter);
-    rewriter.setInsertionPointAfter(fusedMatch.binaryOp);
+    rewriter.setInsertionPointAfter(fusedMatch.unaryOp
+                                        ? fusedMatch.unaryOp.getOperation()
+                                        : fusedMatch.binaryOp.getOperation());
     Value dispatched = rewriter.create<xsmm::FusedBrgemmDispatchOp>(
         loc, integer64, dims,
         xsmm::BinaryKindAttr::get(rewriter.getContext(), fusedMatch.binaryKind),
@@ -109,7 +121,7 @@ struct CombineXsmmOp : public OpRewritePattern<xsmm::BrgemmOp> {
         rewriter.getArrayAttr(xsmm::UnaryFlagsAttr::get(
             rewriter.getContext(), xsmm::UnaryFlags::NONE)),
         rewriter.getArrayAttr(
-            xsmm::BinaryFlagsAttr::get(rewriter.getContext(), *binaryFlags)),
+            xsmm::BinaryFlagsAttr::get(rewriter.getContext(), binaryFlags)),
         dtype);
 
     Value batchDim = rewriter.create<arith::ConstantOp>(
@@ -121,24 +133,27 @@ struct CombineXsmmOp : public OpRewritePattern<xsmm::BrgemmOp> {
     std::advance(opItr, 1);
     invokeOperands.append(opItr, brgemmOp->getOperands().end());
     invokeOperands.pop_back();
-    invokeOperands.push_back(fusedMatch.binaryOp->getOperand(binaryArg));
+    invokeOperands.push_back(operandD);
     invokeOperands.push_back(batchDim);
 
-    // Replace and delete the old invokes and their dispatches
+    // Replace and delete the old invokes and their dispatches. Dispatches
+    // may be shared with other invokes, only drop them once unused.
     rewriter.create<xsmm::FusedBrgemmOp>(loc, dtype, invokeOperands);
-    rewriter.eraseOp(brgemmOp);
-    rewriter.eraseOp(brgemmOp.getOperand(0).getDefiningOp());
-    if (fusedMatch.binaryOp) {
-      rewriter.eraseOp(fusedMatch.binaryOp);
-      rewriter.eraseOp(fusedMatch.binaryOp->getOperand(0).getDefiningOp());
-    }
-    if (fusedMatch.unaryOp) {
-      rewriter.eraseOp(fusedMatch.unaryOp);
-      rewriter.eraseOp(fusedMatch.unaryOp->getOperand(0).getDefiningOp());
-    }
-    if (fusedMatch.zeroOp) {
-      rewriter.eraseOp(fusedMatch.zeroOp);
-      rewriter.eraseOp(fusedMatch.zeroOp->getOperand(0).getDefiningOp());
+    SmallVector<Operation *, 4> dispatches;
+    auto eraseInvoke = [&](Operation *invoke) {
+      dispatches.push_back(invoke->getOperand(0).getDefiningOp());
+      rewriter.eraseOp(invoke);
+    };
+    eraseInvoke(brgemmOp);
+    if (fusedMatch.binaryOp)
+      eraseInvoke(fusedMatch.binaryOp);
+    if (fusedMatch.unaryOp)
+      eraseInvoke(fusedMatch.unaryOp);
+    if (fusedMatch.zeroOp)
+      eraseInvoke(fusedMatch.zeroOp);
+    for (Operation *dispatch : dispatches) {
+      if (dispatch && dispatch->use_empty())
+        rewriter.eraseOp(dispatch);
     }
     return success();
   }
@@ -14,8 +14,15 @@
 #include "mlir/Dialect/Tensor/IR/Tensor.h"
 #include "mlir/Dialect/Tensor/Transforms/Transforms.h"
 #include "mlir/Dialect/Utils/IndexingUtils.h"
+#include "mlir/IR/AsmState.h"
+#include "mlir/IR/DialectResourceBlobManager.h"
+#include "mlir/IR/Matchers.h"
 #include "mlir/IR/Threading.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SetVector.h"
+
+#include <cstring>
 
 using namespace mlir;
 
@@ -28,6 +35,231 @@ namespace tpp {
 
 namespace {
 
+// Packed rows are split in chunks of about this many bytes, packed in parallel.
+static constexpr int64_t kChunkBytes = 64 * 1024;
+
+// A tensor.pack of a constant, packed directly on the raw data of the
+// constant.
+struct ConstantPack {
+  tensor::PackOp packOp;
+  arith::ConstantOp constOp;
+  ArrayRef<char> source;
+  // Raw value of the padding, zeros without padding value.
+  SmallVector<char> padding;
+  int64_t elementBytes = 0;
+  SmallVector<int64_t> sourceShape;
+  SmallVector<int64_t> sourceStrides;
+  SmallVector<int64_t> destShape;
+  // Dimension of the source indexed by each dimension of the destination and
+  // its scale, i.e., the tile size for the outer dimensions of tiled ones.
+  SmallVector<int64_t> dimSource;
+  SmallVector<int64_t> dimScale;
+  // Packed data, filled in parallel.
+  AsmResourceBlob result;
+};
+
+// Return the raw data of a constant, if it's stored unpacked in memory.
+static std::optional<ArrayRef<char>> getRawData(Attribute value) {
+  if (auto dense = dyn_cast<DenseIntOrFPElementsAttr>(value)) {
+    // Splats are handled by the tensor.pack folder.
+    if (dense.isSplat())
+      return std::nullopt;
+    return dense.getRawData();
+  }
+  if (auto resource = dyn_cast<DenseResourceElementsAttr>(value)) {
+    AsmResourceBlob *blob = resource.getRawHandle().getBlob();
+    if (!blob)
+      return std::nullopt;
+    return blob->getData();
+  }
+  return std::nullopt;
+}
+
+static std::optional<ConstantPack> getConstantPack(tensor::PackOp packOp) {
+  auto constOp = packOp.getSource().getDefiningOp<arith::ConstantOp>();
+  if (!constOp || !packOp.getDest().getDefiningOp<tensor::EmptyOp>())
+    return std::nullopt;
+  RankedTensorType sourceType = packOp.getSourceType();
+  RankedTensorType destType = packOp.getDestType();
+  if (!sourceType.hasStaticShape() || !destType.hasStaticShape() ||
+      destType.getRank() == 0 || destType.getNumElements() == 0)
+    return std::nullopt;
+  // Sub-byte elements are not stored one per byte.
+  Type elementType = sourceType.getElementType();
+  if (!elementType.isIntOrFloat() ||
+      elementType.getIntOrFloatBitWidth() % 8 != 0)
+    return std::nullopt;
+  auto source = getRawData(constOp.getValue());
+  if (!source)
+    return std::nullopt;
+
+  ConstantPack pack;
+  pack.packOp = packOp;
+  pack.constOp = constOp;
+  pack.source = *source;
+  pack.elementBytes = elementType.getIntOrFloatBitWidth() / 8;
+  if (static_cast<int64_t>(pack.source.size()) !=
+      sourceType.getNumElements() * pack.elementBytes)
+    return std::nullopt;
+
+  pack.padding.assign(pack.elementBytes, 0);
+  if (Value paddingValue = packOp.getPaddingValue()) {
+    TypedAttr paddingAttr;
+    if (!matchPattern(paddingValue, m_Constant(&paddingAttr)))
+      return std::nullopt;
+    auto splat = DenseElementsAttr::get(
+        RankedTensorType::get({1}, elementType), Attribute(paddingAttr));
+    ArrayRef<char> raw = cast<DenseIntOrFPElementsAttr>(splat).getRawData();
+    pack.padding.assign(raw.begin(), raw.end());
+  }
+
+  pack.sourceShape = llvm::to_vector(sourceType.getShape());
+  pack.sourceStrides = computeStrides(pack.sourceShape);
+  pack.destShape = llvm::to_vector(destType.getShape());
+
+  int64_t rank = sourceType.getRank();
+  SmallVector<int64_t> outerDims = llvm::to_vector(packOp.getOuterDimsPerm());
+  if (outerDims.empty())
+    outerDims = llvm::to_vector(llvm::seq<int64_t>(0, rank));
+  SmallVector<int64_t> tiles(rank, 1);
+  for (auto [dim, tile] :
+       llvm::zip(packOp.getInnerDimsPos(), packOp.getStaticInnerTiles()))
+    tiles[dim] = tile;
+  for (int64_t dim : outerDims) {
+    pack.dimSource.push_back(dim);
+    pack.dimScale.push_back(tiles[dim]);
+  }
+  for (int64_t dim : packOp.getInnerDimsPos()) {
+    pack.dimSource.push_back(dim);
+    pack.dimScale.push_back(1);
+  }
+  return pack;
+}
+
+// Pack the rows [beginRow, endRow) of the destination, i.e., its innermost
+// dimension. Rows whose source elements are contiguous are copied at once,
+// the elements out of the source are padding.
+static void packRows(ConstantPack &pack, int64_t beginRow, int64_t endRow) {
+  int64_t destRank = pack.destShape.size();
+  int64_t rowSize = pack.destShape.back();
+  int64_t elementBytes = pack.elementBytes;
+  int64_t rowDim = pack.dimSource.back();
+  int64_t rowStride = pack.dimScale.back() * pack.sourceStrides[rowDim];
+  MutableArrayRef<char> dest = pack.result.getMutableData();
+
+  SmallVector<int64_t> index(pack.sourceShape.size());
+  for (int64_t row = beginRow; row < endRow; row++) {
+    std::fill(index.begin(), index.end(), 0);
+    int64_t rest = row;
+    for (int64_t dim = destRank - 2; dim >= 0; dim--) {
+      index[pack.dimSource[dim]] +=
+          (rest % pack.destShape[dim]) * pack.dimScale[dim];
+      rest /= pack.destShape[dim];
+    }
+
+    int64_t numValid = 0;
+    bool inBounds = llvm::all_of(llvm::seq<size_t>(0, index.size()),
+                                 [&](size_t dim) {
+                                   return index[dim] < pack.sourceShape[dim];
+                                 });
+    if (inBounds) {
+      numValid = std::min<int64_t>(
+          rowSize, llvm::divideCeil(pack.sourceShape[rowDim] - index[rowDim],
+                                    pack.dimScale.back()));
+    }
+
+    char *out = dest.data() + row * rowSize * elementBytes;
+    const char *in =
+        pack.source.data() +
+        linearize(index, pack.sourceStrides) * elementBytes;
+    if (rowStride == 1) {
+      std::memcpy(out, in, numValid * elementBytes);
+    } else {
+      for (int64_t i = 0; i < numValid; i++) {
+        std::memcpy(out + i * elementBytes, in + i * rowStride * elementBytes,
+                    elementBytes);
+      }
+    }
+    for (int64_t i = numValid; i < rowSize; i++)
+      std::memcpy(out + i * elementBytes, pack.padding.data(), elementBytes);
+  }
+}
+
+// Fold the packs of constants on their raw data, in parallel across and
+// within the constants. The constants left without uses are erased and the
+// resource blobs they held are released, dense attributes are owned by the
+// context and stay alive.
+static void foldConstantPacks(ModuleOp module) {
+  SmallVector<ConstantPack> packs;
+  module.walk([&](tensor::PackOp packOp) {
+    if (auto pack = getConstantPack(packOp))
+      packs.push_back(std::move(*pack));
+  });
+  if (packs.empty())
+    return;
+
+  SmallVector<std::tuple<size_t, int64_t, int64_t>> chunks;
+  for (auto [idx, pack] : llvm::enumerate(packs)) {
+    int64_t rowBytes = pack.destShape.back() * pack.elementBytes;
+    int64_t numRows =
+        pack.packOp.getDestType().getNumElements() / pack.destShape.back();
+    pack.result = HeapAsmResourceBlob::allocate(numRows * rowBytes,
+                                                pack.elementBytes,
+                                                /*dataIsMutable=*/true);
+    int64_t rowsPerChunk =
+        std::max<int64_t>(kChunkBytes / rowBytes, 1);
+    for (int64_t row = 0; row < numRows; row += rowsPerChunk)
+      chunks.push_back({idx, row, std::min(row + rowsPerChunk, numRows)});
+  }
+  parallelFor(module.getContext(), 0, chunks.size(), [&](size_t i) {
+    auto [idx, beginRow, endRow] = chunks[i];
+    packRows(packs[idx], beginRow, endRow);
+  });
+
+  IRRewriter rewriter(module.getContext());
+  llvm::SetVector<arith::ConstantOp> sources;
+  for (ConstantPack &pack : packs) {
+    RankedTensorType destType = pack.packOp.getDestType();
+    TypedAttr folded;
+    if (auto resource =
+            dyn_cast<DenseResourceElementsAttr>(pack.constOp.getValue())) {
+      std::string name = (resource.getRawHandle().getKey() + "_packed").str();
+      folded = DenseResourceElementsAttr::get(destType, name,
+                                              std::move(pack.result));
+    } else {
+      folded = DenseElementsAttr::getFromRawBuffer(destType,
+                                                   pack.result.getData());
+    }
+    rewriter.setInsertionPoint(pack.packOp);
+    rewriter.replaceOpWithNewOp<arith::ConstantOp>(pack.packOp, folded);
+    sources.insert(pack.constOp);
+  }
+
+  SmallVector<DenseResourceElementsHandle> released;
+  for (arith::ConstantOp constOp : sources) {
+    if (!constOp->use_empty())
+      continue;
+    if (auto resource = dyn_cast<DenseResourceElementsAttr>(constOp.getValue()))
+      released.push_back(resource.getRawHandle());
+    rewriter.eraseOp(constOp);
+  }
+  if (released.empty())
+    return;
+
+  // Only release the blobs that no other operation refers to.
+  llvm::DenseSet<void *> used;
+  module->walk([&](Operation *op) {
+    for (NamedAttribute attr : op->getAttrs()) {
+      if (auto resource = dyn_cast<DenseResourceElementsAttr>(attr.getValue()))
+        used.insert(resource.getRawHandle().getResource());
+    }
+  });
+  for (DenseResourceElementsHandle handle : released) {
+    if (!used.contains(handle.getResource()))
+      handle.getResource()->setBlob(AsmResourceBlob());
+  }
+}
+
 // Helper pattern - lower tensor.pack operations that pack constants.
 struct LowerConstantPacking : public OpRewritePattern<tensor::PackOp> {
   using OpRewritePattern<tensor::PackOp>::OpRewritePattern;
@@ -70,6 +302,10 @@ struct ConstantFoldPack
     auto module = getOperation();
     auto *ctx = &getContext();
 
+    // Fold the packs of large constants directly on their data, the patterns
+    // below handle the remaining cases (e.g., splats).
+    foldConstantPacks(module);
+
     RewritePatternSet patterns(ctx);
     // Temporarily lower constant packing operation to allow other existing
     // patterns to fold the operation completely.
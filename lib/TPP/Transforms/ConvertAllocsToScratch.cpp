@@ -0,0 +1,156 @@
+//===- ConvertAllocsToScratch.cpp --------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the lowering of the allocations of the iterations of
+// parallel loops to the thread-local scratch arena of the runtime.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "TPP/Transforms/Utils/BuilderUtils.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "llvm/Support/MathExtras.h"
+
+using namespace mlir;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_CONVERTALLOCSTOSCRATCH
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+namespace {
+
+// Scratch arena runtime entry points, see runtime/ScratchRunnerUtils.h.
+constexpr const static llvm::StringLiteral kMarkFunc = "tpp_scratch_mark";
+constexpr const static llvm::StringLiteral kGetFunc = "tpp_scratch_get";
+constexpr const static llvm::StringLiteral kResetFunc = "tpp_scratch_reset";
+
+// The arena aligns its buffers to a cache line.
+constexpr static int64_t kScratchAlignment = 64;
+
+// Returns the size in bytes of the buffer of `op` if it can be taken from the
+// arena: static, with an identity layout in the default memory space, and
+// released at the end of the iteration. Heap buffers must be deallocated in
+// the iteration, stack buffers of less than `minAllocaBytes` stay on the stack.
+static std::optional<int64_t> getScratchSize(Operation *op,
+                                             int64_t minAllocaBytes) {
+  MemRefType type;
+  std::optional<uint64_t> alignment;
+  if (auto allocOp = dyn_cast<memref::AllocOp>(op)) {
+    type = allocOp.getType();
+    alignment = allocOp.getAlignment();
+  } else if (auto allocaOp = dyn_cast<memref::AllocaOp>(op)) {
+    type = allocaOp.getType();
+    alignment = allocaOp.getAlignment();
+  } else {
+    return std::nullopt;
+  }
+  if (!type.hasStaticShape() || !type.getLayout().isIdentity() ||
+      type.getMemorySpace() || !type.getElementType().isIntOrFloat() ||
+      alignment.value_or(0) > static_cast<uint64_t>(kScratchAlignment))
+    return std::nullopt;
+  int64_t bytes =
+      type.getNumElements() *
+      llvm::divideCeil(type.getElementType().getIntOrFloatBitWidth(), 8);
+
+  Block *block = op->getBlock();
+  int64_t numDeallocs = 0;
+  for (Operation *user : op->getUsers()) {
+    if (user->hasTrait<OpTrait::IsTerminator>())
+      return std::nullopt;
+    if (isa<memref::DeallocOp>(user)) {
+      if (user->getBlock() != block)
+        return std::nullopt;
+      ++numDeallocs;
+    }
+  }
+  if (isa<memref::AllocaOp>(op))
+    return bytes >= minAllocaBytes ? std::optional<int64_t>(bytes)
+                                   : std::nullopt;
+  return numDeallocs == 1 ? std::optional<int64_t>(bytes) : std::nullopt;
+}
+
+// Takes the buffers allocated in the body of `parallelOp` from the arena of
+// the thread running the iteration, which is reset at the end of it:
+//
+// scf.parallel {
+//   %mark = tpp_scratch_mark()
+//   %buf = memref.view tpp_scratch_get(bytes)
+//   ...
+//   tpp_scratch_reset(%mark)
+// }
+static void convertAllocs(RewriterBase &rewriter, ModuleOp module,
+                          scf::ParallelOp parallelOp, int64_t minAllocaBytes) {
+  Block *body = parallelOp.getBody();
+  SmallVector<std::pair<Operation *, int64_t>> allocs;
+  for (Operation &op : *body) {
+    if (std::optional<int64_t> bytes = getScratchSize(&op, minAllocaBytes))
+      allocs.emplace_back(&op, *bytes);
+  }
+  if (allocs.empty())
+    return;
+
+  Type i64 = rewriter.getI64Type();
+  auto scratchType =
+      MemRefType::get({ShapedType::kDynamic}, rewriter.getI8Type());
+  func::FuncOp markFunc = getOrCreateRuntimeFunc(module, kMarkFunc, {}, i64);
+  func::FuncOp getFunc =
+      getOrCreateRuntimeFunc(module, kGetFunc, i64, scratchType,
+                             /*emitCInterface=*/true);
+  func::FuncOp resetFunc =
+      getOrCreateRuntimeFunc(module, kResetFunc, i64, {});
+
+  Location loc = parallelOp.getLoc();
+  rewriter.setInsertionPointToStart(body);
+  Value mark = rewriter.create<func::CallOp>(loc, markFunc, ValueRange{})
+                   .getResult(0);
+  rewriter.setInsertionPoint(body->getTerminator());
+  rewriter.create<func::CallOp>(loc, resetFunc, mark);
+
+  for (auto [op, bytes] : allocs) {
+    rewriter.setInsertionPoint(op);
+    Location allocLoc = op->getLoc();
+    Value numBytes = rewriter.create<arith::ConstantOp>(
+        allocLoc, rewriter.getI64IntegerAttr(bytes));
+    Value buffer = rewriter.create<func::CallOp>(allocLoc, getFunc, numBytes)
+                       .getResult(0);
+    Value zero = rewriter.create<arith::ConstantIndexOp>(allocLoc, 0);
+    Value view = rewriter.create<memref::ViewOp>(
+        allocLoc, cast<MemRefType>(op->getResult(0).getType()), buffer, zero,
+        ValueRange{});
+    for (Operation *user : llvm::make_early_inc_range(op->getUsers())) {
+      if (isa<memref::DeallocOp>(user))
+        rewriter.eraseOp(user);
+    }
+    rewriter.replaceOp(op, view);
+  }
+}
+
+struct ConvertAllocsToScratch
+    : public tpp::impl::ConvertAllocsToScratchBase<ConvertAllocsToScratch> {
+  using ConvertAllocsToScratchBase::ConvertAllocsToScratchBase;
+
+  void runOnOperation() override {
+    ModuleOp module = getOperation();
+    SmallVector<scf::ParallelOp> parallelOps;
+    module.walk([&](scf::ParallelOp parallelOp) {
+      parallelOps.push_back(parallelOp);
+    });
+
+    IRRewriter rewriter(&getContext());
+    for (scf::ParallelOp parallelOp : parallelOps)
+      convertAllocs(rewriter, module, parallelOp, minAllocaBytes);
+  }
+};
+
+} // namespace
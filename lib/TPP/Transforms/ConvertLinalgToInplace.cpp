@@ -9,7 +9,9 @@
 #include "mlir/Dialect/Arith/IR/Arith.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/Linalg/Transforms/Transforms.h"
 #include "mlir/Dialect/Linalg/Utils/Utils.h"
+#include "mlir/Dialect/Tensor/IR/Tensor.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 namespace mlir {
@@ -130,11 +132,168 @@ struct EltwiseUnaryGenericToInplace
   }
 };
 
+// Returns true if the elementwise `linalgOp` can write its result into the
+// buffer of `input`: the input has no other use and is accessed like the
+// init, whose initial values are not used.
+static bool canUpdateInPlace(linalg::LinalgOp linalgOp, OpOperand *input) {
+  OpOperand *init = linalgOp.getDpsInitOperand(0);
+  return input->get().hasOneUse() &&
+         input->get().getType() == init->get().getType() &&
+         linalgOp.getMatchingIndexingMap(input) ==
+             linalgOp.getMatchingIndexingMap(init);
+}
+
+// Rewrites the elementwise `linalgOp` to update its input `input` in place:
+// the input becomes the init of a linalg.generic and the original init is
+// dropped.
+static void updateInPlace(RewriterBase &rewriter, linalg::LinalgOp linalgOp,
+                          OpOperand *input) {
+  int64_t inputIndex = input->getOperandNumber();
+  auto genericOp = dyn_cast<linalg::GenericOp>(linalgOp.getOperation());
+  if (!genericOp)
+    genericOp = *linalg::generalizeNamedOp(rewriter, linalgOp);
+
+  SmallVector<Value> inputs;
+  SmallVector<AffineMap> indexingMaps;
+  SmallVector<AffineMap> maps = genericOp.getIndexingMapsArray();
+  for (auto [index, operand] : llvm::enumerate(genericOp.getInputs())) {
+    if (static_cast<int64_t>(index) == inputIndex)
+      continue;
+    inputs.push_back(operand);
+    indexingMaps.push_back(maps[index]);
+  }
+  Value output = genericOp.getInputs()[inputIndex];
+  indexingMaps.push_back(maps[inputIndex]);
+
+  auto newGeneric = rewriter.create<linalg::GenericOp>(
+      genericOp.getLoc(), output.getType(), inputs, output, indexingMaps,
+      genericOp.getIteratorTypesArray());
+  rewriter.inlineRegionBefore(genericOp->getRegion(0), newGeneric.getRegion(),
+                              newGeneric.getRegion().begin());
+
+  // The init block argument now holds the values of the input.
+  Block *body = newGeneric.getBody();
+  rewriter.replaceAllUsesWith(body->getArgument(inputIndex),
+                              body->getArguments().back());
+  body->eraseArgument(inputIndex);
+  rewriter.replaceOp(genericOp, newGeneric->getResults());
+}
+
+// Returns true if the elementwise `linalgOp` overwrites its whole init.
+static bool isOverwritingEltwise(linalg::LinalgOp linalgOp) {
+  return linalgOp.hasPureTensorSemantics() && linalgOp.getNumDpsInits() == 1 &&
+         linalg::isElementwise(linalgOp) &&
+         !linalgOp.payloadUsesValueFromOperand(linalgOp.getDpsInitOperand(0));
+}
+
+// Writes an elementwise op of a chain, e.g. the bias or the activation
+// after a matmul, into the buffer of the operand produced by the previous op
+// of the chain instead of a new one.
+//
+// %0 = linalg.matmul outs(%fill)
+// %1 = linalg.add ins(%0, %bias) outs(%empty)
+// ->
+// %0 = linalg.matmul outs(%fill)
+// %1 = linalg.generic ins(%bias) outs(%0)
+struct EltwiseToInplace : public OpInterfaceRewritePattern<linalg::LinalgOp> {
+  using OpInterfaceRewritePattern<linalg::LinalgOp>::OpInterfaceRewritePattern;
+
+  LogicalResult matchAndRewrite(linalg::LinalgOp linalgOp,
+                                PatternRewriter &rewriter) const override {
+    if (!isOverwritingEltwise(linalgOp) || linalgOp.getNumDpsInputs() < 2)
+      return rewriter.notifyMatchFailure(linalgOp,
+                                         "not an overwriting elementwise op");
+    if (!linalgOp.getDpsInits()[0].getDefiningOp<tensor::EmptyOp>())
+      return rewriter.notifyMatchFailure(linalgOp, "expects an empty init");
+
+    // Only the inputs produced by the chain are updated, the function
+    // arguments are left to the caller.
+    for (OpOperand *input : linalgOp.getDpsInputOperands()) {
+      if (input->get().getDefiningOp<DestinationStyleOpInterface>() &&
+          canUpdateInPlace(linalgOp, input)) {
+        updateInPlace(rewriter, linalgOp, input);
+        return success();
+      }
+    }
+    return rewriter.notifyMatchFailure(linalgOp, "no input to update");
+  }
+};
+
+// Returns true if `value` is available at `op`.
+static bool isAvailableAt(Value value, Operation *op) {
+  Operation *ancestor = value.getParentBlock()->findAncestorOpInBlock(*op);
+  if (!ancestor)
+    return false;
+  return isa<BlockArgument>(value) ||
+         value.getDefiningOp()->isBeforeInBlock(ancestor);
+}
+
+// Passes the destination of the last elementwise op of a chain, e.g. an
+// output argument of the function, up to the op starting the chain, so that
+// the whole chain writes into it and the function result aliases the
+// argument without a copy.
+//
+// %0 = linalg.fill outs(%empty)
+// %1 = linalg.matmul outs(%0)
+// %2 = linalg.generic ins(%bias) outs(%1)
+// %3 = linalg.generic ins(%2) outs(%arg)
+// ->
+// %0 = linalg.fill outs(%arg)
+// %1 = linalg.matmul outs(%0)
+// %2 = linalg.generic ins(%bias) outs(%1)
+// %3 = linalg.generic outs(%2)
+struct PropagateDestinationInplace
+    : public OpInterfaceRewritePattern<linalg::LinalgOp> {
+  using OpInterfaceRewritePattern<linalg::LinalgOp>::OpInterfaceRewritePattern;
+
+  LogicalResult matchAndRewrite(linalg::LinalgOp linalgOp,
+                                PatternRewriter &rewriter) const override {
+    if (!isOverwritingEltwise(linalgOp) || linalgOp.getNumDpsInputs() == 0)
+      return rewriter.notifyMatchFailure(linalgOp,
+                                         "not an overwriting elementwise op");
+    // The destination is only written by this op, so it can be written
+    // earlier in the chain.
+    Value dest = linalgOp.getDpsInits()[0];
+    if (dest.getDefiningOp<tensor::EmptyOp>() || !dest.hasOneUse())
+      return rewriter.notifyMatchFailure(linalgOp, "expects a destination");
+
+    for (OpOperand *input : linalgOp.getDpsInputOperands()) {
+      if (!canUpdateInPlace(linalgOp, input))
+        continue;
+      // Follow the inits tied to the results of the chain up to its empty
+      // tensor.
+      OpOperand *emptyOperand = nullptr;
+      Value value = input->get();
+      while (auto dpsOp = value.getDefiningOp<DestinationStyleOpInterface>()) {
+        OpOperand *tiedInit = dpsOp.getTiedOpOperand(cast<OpResult>(value));
+        value = tiedInit->get();
+        if (value.getDefiningOp<tensor::EmptyOp>()) {
+          emptyOperand = tiedInit;
+          break;
+        }
+        if (!value.hasOneUse())
+          break;
+      }
+      if (!emptyOperand || !isAvailableAt(dest, emptyOperand->getOwner()))
+        continue;
+
+      rewriter.modifyOpInPlace(emptyOperand->getOwner(),
+                               [&]() { emptyOperand->set(dest); });
+      updateInPlace(rewriter, linalgOp, input);
+      return success();
+    }
+    return rewriter.notifyMatchFailure(linalgOp, "no chain to write into");
+  }
+};
+
 struct ConvertLinalgToInplace
     : public tpp::impl::ConvertLinalgToInplaceBase<ConvertLinalgToInplace> {
   void populateCombinePatterns(RewritePatternSet &patterns) {
-    patterns.add<ConvertAddInplace, EltwiseUnaryGenericToInplace>(
-        patterns.getContext());
+    patterns.add<ConvertAddInplace, EltwiseUnaryGenericToInplace,
+                 EltwiseToInplace>(patterns.getContext());
+    // Writing into the destination takes precedence over dropping it.
+    patterns.add<PropagateDestinationInplace>(patterns.getContext(),
+                                              /*benefit=*/2);
   }
 
   void runOnOperation() override {
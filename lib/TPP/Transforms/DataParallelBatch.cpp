@@ -0,0 +1,324 @@
+//===- DataParallelBatch.cpp -------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the split of the batch of a kernel across the ranks of
+// a data-parallel run, with the collectives of the runtime.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "TPP/Transforms/Utils/BuilderUtils.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Bufferization/IR/Bufferization.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/Tensor/IR/Tensor.h"
+#include "mlir/Dialect/Tensor/Transforms/Transforms.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "mlir/Interfaces/TilingInterface.h"
+
+using namespace mlir;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_DATAPARALLELBATCH
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+namespace {
+
+// Collective runtime entry points, see runtime/CollectiveRunnerUtils.h.
+constexpr const static llvm::StringLiteral kRankFunc = "tpp_collective_rank";
+constexpr const static llvm::StringLiteral kAllGatherFunc = "tpp_all_gather";
+
+// Returns the suffix of the collectives of `type`, empty if there are none.
+static StringRef getTypeSuffix(Type type) {
+  if (type.isF32())
+    return "f32";
+  if (type.isBF16())
+    return "bf16";
+  if (type.isInteger(32))
+    return "i32";
+  return "";
+}
+
+// Returns true if the slice takes `source` whole.
+static bool isFullSlice(tensor::ExtractSliceOp sliceOp) {
+  auto isZero = [](OpFoldResult ofr) { return isConstantIntValue(ofr, 0); };
+  auto isOne = [](OpFoldResult ofr) { return isConstantIntValue(ofr, 1); };
+  return sliceOp.getSourceType() == sliceOp.getResultType() &&
+         llvm::all_of(sliceOp.getMixedOffsets(), isZero) &&
+         llvm::all_of(sliceOp.getMixedStrides(), isOne);
+}
+
+class BatchSplitter {
+public:
+  BatchSplitter(ModuleOp module, func::FuncOp func, int64_t numRanks)
+      : module(module), func(func), numRanks(numRanks),
+        rewriter(module.getContext()) {}
+
+  // Returns the loop of the op producing `result` that iterates over its
+  // batch, the outermost dimension, if the op can compute the rows of a rank
+  // alone.
+  std::optional<unsigned> getBatchLoop(Value result) {
+    auto tilingOp = result.getDefiningOp<TilingInterface>();
+    auto linalgOp = dyn_cast_or_null<linalg::LinalgOp>(result.getDefiningOp());
+    auto type = dyn_cast<RankedTensorType>(result.getType());
+    if (!tilingOp || !linalgOp || !linalgOp.hasPureTensorSemantics() ||
+        linalgOp->getNumResults() != 1 || !type || !type.hasStaticShape() ||
+        type.getRank() == 0 || type.getDimSize(0) % numRanks != 0 ||
+        getTypeSuffix(type.getElementType()).empty())
+      return std::nullopt;
+    AffineMap map = linalgOp.getIndexingMapMatchingResult(
+        cast<OpResult>(result));
+    auto dim = dyn_cast<AffineDimExpr>(map.getResult(0));
+    if (!dim)
+      return std::nullopt;
+    SmallVector<int64_t> ranges = linalgOp.getStaticLoopRanges();
+    if (ranges[dim.getPosition()] != type.getDimSize(0))
+      return std::nullopt;
+    return dim.getPosition();
+  }
+
+  // Computes the rows of the rank of `result`, produced along `batchLoop`,
+  // with the producers fused in, and all-gathers the rows of the ranks.
+  Value split(Value result, unsigned batchLoop) {
+    auto tilingOp = result.getDefiningOp<TilingInterface>();
+    auto type = cast<RankedTensorType>(result.getType());
+    int64_t rows = type.getDimSize(0) / numRanks;
+    rewriter.setInsertionPoint(tilingOp);
+    Location loc = tilingOp.getLoc();
+
+    SmallVector<OpFoldResult> offsets, sizes;
+    for (Range range : tilingOp.getIterationDomain(rewriter)) {
+      offsets.push_back(range.offset);
+      sizes.push_back(range.size);
+    }
+    offsets[batchLoop] = getRowOffset(rows);
+    sizes[batchLoop] = rewriter.getIndexAttr(rows);
+    FailureOr<TilingResult> tiled =
+        tilingOp.getTiledImplementation(rewriter, offsets, sizes);
+    if (failed(tiled))
+      return result;
+
+    // The producers compute the rows of the rank as well, down to the
+    // arguments and the constants.
+    SmallVector<Operation *> worklist(tiled->tiledOps.begin(),
+                                      tiled->tiledOps.end());
+    while (!worklist.empty()) {
+      Operation *op = worklist.pop_back_val();
+      for (Value operand : op->getOperands()) {
+        auto sliceOp = operand.getDefiningOp<tensor::ExtractSliceOp>();
+        auto producer = sliceOp ? dyn_cast<OpResult>(sliceOp.getSource())
+                                : OpResult();
+        if (!producer || !isa<TilingInterface>(producer.getOwner()))
+          continue;
+        rewriter.setInsertionPoint(sliceOp);
+        FailureOr<TilingResult> fused =
+            tensor::replaceExtractSliceWithTiledProducer(rewriter, sliceOp,
+                                                         producer);
+        if (failed(fused))
+          continue;
+        rewriter.replaceOp(sliceOp, fused->tiledValues[0]);
+        worklist.append(fused->tiledOps.begin(), fused->tiledOps.end());
+      }
+    }
+
+    rewriter.setInsertionPointAfter(tiled->tiledOps.back());
+    Value dim = rewriter.create<arith::ConstantOp>(
+        loc, rewriter.getI64IntegerAttr(0));
+    return createCollective(loc, kAllGatherFunc, tiled->tiledValues[0], type,
+                            dim);
+  }
+
+  // Simplifies the slices left by the split: the whole tensors are used
+  // directly, the empty tensors are created at the size of their slices and
+  // the arguments only used by their rows of the rank become the rows, so
+  // that each rank only holds its part of the batch. Other arguments, e.g.
+  // the weights, are replicated.
+  void simplifySlices() {
+    SmallVector<tensor::ExtractSliceOp> sliceOps;
+    func.walk([&](tensor::ExtractSliceOp sliceOp) {
+      sliceOps.push_back(sliceOp);
+    });
+    for (tensor::ExtractSliceOp sliceOp : sliceOps) {
+      if (isFullSlice(sliceOp)) {
+        rewriter.replaceOp(sliceOp, sliceOp.getSource());
+        continue;
+      }
+      auto emptyOp = sliceOp.getSource().getDefiningOp<tensor::EmptyOp>();
+      if (emptyOp && sliceOp.getResultType().hasStaticShape()) {
+        rewriter.setInsertionPoint(sliceOp);
+        rewriter.replaceOpWithNewOp<tensor::EmptyOp>(
+            sliceOp, sliceOp.getResultType().getShape(),
+            sliceOp.getResultType().getElementType());
+      }
+    }
+
+    for (BlockArgument arg : func.getArguments()) {
+      if (arg.use_empty() || !llvm::all_of(arg.getUsers(), [&](Operation *op) {
+            return isRowSlice(op);
+          }))
+        continue;
+      auto type = cast<RankedTensorType>(arg.getType());
+      SmallVector<int64_t> shape(type.getShape());
+      shape[0] /= numRanks;
+      arg.setType(type.clone(shape));
+      for (Operation *user : llvm::make_early_inc_range(arg.getUsers()))
+        rewriter.replaceOp(user, arg);
+    }
+
+    // The whole batch is not computed anymore.
+    Block &body = func.getBody().front();
+    for (Operation &op : llvm::make_early_inc_range(llvm::reverse(body))) {
+      if (isOpTriviallyDead(&op))
+        rewriter.eraseOp(&op);
+    }
+  }
+
+  // Updates the type of the function with its split arguments.
+  void updateFunctionType() {
+    func.setType(FunctionType::get(func.getContext(),
+                                   func.getBody().front().getArgumentTypes(),
+                                   func.getResultTypes()));
+  }
+
+private:
+  // Returns the rank of the process, queried on entry.
+  Value getRank() {
+    if (rank)
+      return rank;
+    OpBuilder::InsertionGuard guard(rewriter);
+    rewriter.setInsertionPointToStart(&func.getBody().front());
+    func::FuncOp rankFunc = getOrCreateRuntimeFunc(module, kRankFunc, {},
+                                                   rewriter.getI64Type());
+    Value rank64 =
+        rewriter.create<func::CallOp>(func.getLoc(), rankFunc, ValueRange{})
+            .getResult(0);
+    rank = rewriter.create<arith::IndexCastOp>(
+        func.getLoc(), rewriter.getIndexType(), rank64);
+    return rank;
+  }
+
+  // Returns the first row of the rank in a batch split into parts of `rows`
+  // rows, shared by the splits of the same size.
+  Value getRowOffset(int64_t rows) {
+    Value &offset = rowOffsets[rows];
+    if (offset)
+      return offset;
+    OpBuilder::InsertionGuard guard(rewriter);
+    Value rankValue = getRank();
+    rewriter.setInsertionPointAfterValue(rankValue);
+    Location loc = func.getLoc();
+    Value partSize = rewriter.create<arith::ConstantIndexOp>(loc, rows);
+    offset = rewriter.create<arith::MulIOp>(loc, rankValue, partSize);
+    return offset;
+  }
+
+  // Returns true if `op` slices the rows of the rank of its whole source.
+  bool isRowSlice(Operation *op) {
+    auto sliceOp = dyn_cast<tensor::ExtractSliceOp>(op);
+    if (!sliceOp)
+      return false;
+    RankedTensorType sourceType = sliceOp.getSourceType();
+    RankedTensorType resultType = sliceOp.getResultType();
+    if (!sourceType.hasStaticShape() ||
+        sourceType.getRank() != resultType.getRank() ||
+        sourceType.getDimSize(0) % numRanks != 0)
+      return false;
+    int64_t rows = sourceType.getDimSize(0) / numRanks;
+    auto it = rowOffsets.find(rows);
+    if (it == rowOffsets.end() ||
+        dyn_cast<Value>(sliceOp.getMixedOffsets()[0]) != it->second ||
+        resultType.getDimSize(0) != rows)
+      return false;
+    for (int64_t dim = 1; dim < sourceType.getRank(); dim++) {
+      if (!isConstantIntValue(sliceOp.getMixedOffsets()[dim], 0) ||
+          resultType.getDimSize(dim) != sourceType.getDimSize(dim))
+        return false;
+    }
+    return llvm::all_of(sliceOp.getMixedStrides(), [](OpFoldResult ofr) {
+      return isConstantIntValue(ofr, 1);
+    });
+  }
+
+  // Calls the collective `name` of the runtime from `input` into a buffer of
+  // `resultType`, returned as a tensor.
+  Value createCollective(Location loc, StringRef name, Value input,
+                         RankedTensorType resultType, ValueRange extraArgs) {
+    Type elementType = resultType.getElementType();
+    auto inputType = cast<RankedTensorType>(input.getType());
+    Value inputBuffer = rewriter.create<bufferization::ToMemrefOp>(
+        loc, MemRefType::get(inputType.getShape(), elementType), input);
+    Value resultBuffer = rewriter.create<memref::AllocOp>(
+        loc, MemRefType::get(resultType.getShape(), elementType),
+        rewriter.getI64IntegerAttr(64));
+
+    auto unrankedType = UnrankedMemRefType::get(elementType, 0);
+    SmallVector<Value> args{
+        rewriter.create<memref::CastOp>(loc, unrankedType, inputBuffer),
+        rewriter.create<memref::CastOp>(loc, unrankedType, resultBuffer)};
+    args.append(extraArgs.begin(), extraArgs.end());
+    std::string funcName =
+        (name + "_" + getTypeSuffix(elementType)).str();
+    func::FuncOp collectiveFunc =
+        getOrCreateRuntimeFunc(module, funcName, ValueRange(args).getTypes(),
+                               {}, /*emitCInterface=*/true);
+    rewriter.create<func::CallOp>(loc, collectiveFunc, args);
+    return rewriter.create<bufferization::ToTensorOp>(
+        loc, resultBuffer, /*restrict=*/true, /*writable=*/true);
+  }
+
+  ModuleOp module;
+  func::FuncOp func;
+  int64_t numRanks;
+  IRRewriter rewriter;
+  Value rank;
+  llvm::DenseMap<int64_t, Value> rowOffsets;
+};
+
+struct DataParallelBatch
+    : public tpp::impl::DataParallelBatchBase<DataParallelBatch> {
+  using DataParallelBatchBase::DataParallelBatchBase;
+
+  void runOnOperation() override {
+    ModuleOp module = getOperation();
+    if (numRanks <= 1)
+      return;
+
+    SmallVector<func::FuncOp> funcs(module.getOps<func::FuncOp>());
+    for (func::FuncOp func : funcs) {
+      if (func.isExternal() || !func.getBody().hasOneBlock())
+        continue;
+      BatchSplitter splitter(module, func, numRanks);
+      auto returnOp =
+          cast<func::ReturnOp>(func.getBody().front().getTerminator());
+      bool changed = false;
+      for (OpOperand &operand : returnOp->getOpOperands()) {
+        std::optional<unsigned> batchLoop =
+            splitter.getBatchLoop(operand.get());
+        if (!batchLoop)
+          continue;
+        Value full = splitter.split(operand.get(), *batchLoop);
+        if (full == operand.get())
+          continue;
+        operand.set(full);
+        changed = true;
+      }
+      if (!changed)
+        continue;
+      splitter.simplifySlices();
+      splitter.updateFunctionType();
+    }
+  }
+};
+
+} // namespace
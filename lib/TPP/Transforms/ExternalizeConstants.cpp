@@ -0,0 +1,164 @@
+//===- ExternalizeConstants.cpp ----------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file moves the large constant globals of a module to a weight blob,
+// mapped at runtime in place of being embedded in the binary.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Dialect/Perf/PerfOps.h"
+#include "TPP/Passes.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/IR/BuiltinAttributes.h"
+#include "mlir/IR/SymbolTable.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_EXTERNALIZECONSTANTS
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+using namespace mlir;
+
+#define DEBUG_TYPE "externalize-constants"
+
+namespace {
+
+// Magic of the weight blobs, checked by the runtime (see perf.map_blob).
+constexpr const static llvm::StringLiteral kBlobMagic = "TPPBLOB1";
+
+// Offsets of the data in the blob are aligned to cache lines at least.
+constexpr const static int64_t kBlobAlignment = 64;
+
+// Returns the data of `globalOp` if it is a constant the runtime can map: a
+// dense, non-splat array of a type of whole bytes, of at least `minBytes`.
+static DenseElementsAttr getExternalizableData(memref::GlobalOp globalOp,
+                                               int64_t minBytes) {
+  if (!globalOp.getConstant())
+    return nullptr;
+  auto data =
+      dyn_cast_or_null<DenseElementsAttr>(globalOp.getInitialValueAttr());
+  if (!data || data.isSplat())
+    return nullptr;
+  if (!globalOp.getType().getLayout().isIdentity())
+    return nullptr;
+
+  Type elementType = data.getElementType();
+  if (!elementType.isF32() && !elementType.isF64() && !elementType.isF16() &&
+      !elementType.isBF16() && !elementType.isInteger(8) &&
+      !elementType.isInteger(16) && !elementType.isInteger(32) &&
+      !elementType.isInteger(64))
+    return nullptr;
+
+  int64_t numBytes =
+      data.getNumElements() * (elementType.getIntOrFloatBitWidth() / 8);
+  if (numBytes < minBytes)
+    return nullptr;
+  return data;
+}
+
+struct ExternalizeConstants
+    : public tpp::impl::ExternalizeConstantsBase<ExternalizeConstants> {
+  using ExternalizeConstantsBase::ExternalizeConstantsBase;
+
+  void runOnOperation() override {
+    ModuleOp module = getOperation();
+    if (blobFile.empty()) {
+      module.emitError("Missing the weight blob file");
+      return signalPassFailure();
+    }
+
+    // Lay out the data of the constants, sharing the offset of identical
+    // ones.
+    SmallVector<DenseElementsAttr> blobData;
+    SmallVector<int64_t> blobOffsets;
+    DenseMap<Attribute, int64_t> dataOffsets;
+    llvm::StringMap<int64_t> globalOffsets;
+    int64_t blobSize = kBlobAlignment;
+    for (auto globalOp : module.getOps<memref::GlobalOp>()) {
+      DenseElementsAttr data = getExternalizableData(globalOp, minBytes);
+      if (!data)
+        continue;
+
+      auto it = dataOffsets.find(data);
+      if (it == dataOffsets.end()) {
+        int64_t alignment = std::max<int64_t>(
+            kBlobAlignment, globalOp.getAlignment().value_or(0));
+        int64_t offset = llvm::alignTo(blobSize, alignment);
+        blobData.push_back(data);
+        blobOffsets.push_back(offset);
+        blobSize = offset + data.getRawData().size();
+        it = dataOffsets.try_emplace(data, offset).first;
+      }
+      globalOffsets[globalOp.getSymName()] = it->second;
+    }
+    if (blobData.empty())
+      return;
+
+    std::error_code error;
+    llvm::raw_fd_ostream os(blobFile, error);
+    if (error) {
+      module.emitError("Cannot open the weight blob file '")
+          << blobFile << "': " << error.message();
+      return signalPassFailure();
+    }
+    os << kBlobMagic;
+    uint64_t position = kBlobMagic.size();
+    for (auto [data, offset] : llvm::zip(blobData, blobOffsets)) {
+      os.write_zeros(offset - position);
+      ArrayRef<char> rawData = data.getRawData();
+      os.write(rawData.data(), rawData.size());
+      position = offset + rawData.size();
+    }
+    os.close();
+    if (os.has_error()) {
+      module.emitError("Cannot write the weight blob file '")
+          << blobFile << "': " << os.error().message();
+      os.clear_error();
+      return signalPassFailure();
+    }
+
+    // Map the data once per function, at its entry, as the globals have no
+    // address until the blob is mapped.
+    for (auto funcOp : module.getOps<func::FuncOp>()) {
+      if (funcOp.isExternal())
+        continue;
+      llvm::StringMap<Value> mappedData;
+      OpBuilder builder(funcOp.getBody());
+      funcOp.walk([&](memref::GetGlobalOp getGlobalOp) {
+        auto offset = globalOffsets.find(getGlobalOp.getName());
+        if (offset == globalOffsets.end())
+          return;
+        Value &mapped = mappedData[getGlobalOp.getName()];
+        if (!mapped) {
+          mapped = builder.create<perf::MapBlobOp>(
+              getGlobalOp.getLoc(), getGlobalOp.getType(),
+              builder.getStringAttr(blobFile),
+              builder.getI64IntegerAttr(offset->second));
+        }
+        getGlobalOp.replaceAllUsesWith(mapped);
+        getGlobalOp.erase();
+      });
+    }
+
+    // Drop the globals left without uses.
+    for (auto globalOp :
+         llvm::make_early_inc_range(module.getOps<memref::GlobalOp>())) {
+      if (globalOffsets.contains(globalOp.getSymName()) &&
+          SymbolTable::symbolKnownUseEmpty(globalOp, module))
+        globalOp.erase();
+    }
+  }
+};
+
+} // namespace
@@ -0,0 +1,306 @@
+//===- FoldBatchNorm.cpp -----------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the folding of the inference batchnorms into the
+// weights and the bias of their convolutions.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "TPP/Transforms/Utils/ValueUtils.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/Math/IR/Math.h"
+#include "mlir/Dialect/Tensor/IR/Tensor.h"
+#include "mlir/IR/Matchers.h"
+#include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+#include "llvm/Support/Debug.h"
+
+#include <cmath>
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_FOLDBATCHNORM
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+#define DEBUG_TYPE "fold-batch-norm"
+
+namespace {
+
+// Dimension of the channels of the output of a Conv2DNhwcHwcfOp.
+constexpr unsigned kChannelDim = 3;
+
+// Return the values of a constant operand of an element-wise op for each of
+// the `channels`, read through `map`: a splat, or a 1-D constant indexed by
+// the channels.
+static std::optional<SmallVector<float>>
+getChannelValues(Value value, AffineMap map, int64_t channels) {
+  DenseFPElementsAttr attr;
+  if (!matchPattern(value, m_Constant(&attr)) ||
+      !attr.getElementType().isF32())
+    return std::nullopt;
+  if (attr.isSplat())
+    return SmallVector<float>(channels, attr.getSplatValue<float>());
+  if (map.getNumResults() != 1 ||
+      map.getResult(0) != getAffineDimExpr(kChannelDim, map.getContext()) ||
+      attr.getNumElements() != channels)
+    return std::nullopt;
+  return llvm::to_vector(attr.getValues<float>());
+}
+
+// A value of the body of the batchnorm for a channel, scale * x + shift where
+// x is the output of the convolution.
+struct AffineValue {
+  double scale = 0.0;
+  double shift = 0.0;
+  bool dependsOnX = false;
+};
+
+// Evaluate the body of the element-wise `bnOp` as an affine function of its
+// input `x`, with the values of the other inputs for the channel `channel`.
+// Fails on anything but additions, subtractions, products and divisions by
+// values independent of x, and square roots of the latter.
+static FailureOr<AffineValue>
+evaluateAffine(linalg::GenericOp bnOp, unsigned x,
+               ArrayRef<SmallVector<float>> channelValues, int64_t channel) {
+  Block *body = bnOp.getBlock();
+  DenseMap<Value, AffineValue> values;
+  for (auto [index, arg] : llvm::enumerate(
+           body->getArguments().take_front(bnOp.getNumDpsInputs()))) {
+    if (index == x)
+      values[arg] = {1.0, 0.0, true};
+    else
+      values[arg] = {0.0, channelValues[index][channel], false};
+  }
+  auto lookup = [&](Value value) -> std::optional<AffineValue> {
+    auto it = values.find(value);
+    if (it != values.end())
+      return it->second;
+    FloatAttr constant;
+    if (matchPattern(value, m_Constant(&constant)))
+      return AffineValue{0.0, constant.getValueAsDouble(), false};
+    return std::nullopt;
+  };
+
+  for (Operation &op : body->without_terminator()) {
+    if (auto constOp = dyn_cast<arith::ConstantOp>(op)) {
+      if (!lookup(constOp.getResult()))
+        return failure();
+      continue;
+    }
+    SmallVector<AffineValue> operands;
+    for (Value operand : op.getOperands()) {
+      std::optional<AffineValue> value = lookup(operand);
+      if (!value)
+        return failure();
+      operands.push_back(*value);
+    }
+    AffineValue result;
+    if (isa<arith::AddFOp, arith::SubFOp>(op)) {
+      double sign = isa<arith::SubFOp>(op) ? -1.0 : 1.0;
+      result = {operands[0].scale + sign * operands[1].scale,
+                operands[0].shift + sign * operands[1].shift,
+                operands[0].dependsOnX || operands[1].dependsOnX};
+    } else if (isa<arith::MulFOp>(op)) {
+      AffineValue lhs = operands[0], rhs = operands[1];
+      if (lhs.dependsOnX && rhs.dependsOnX)
+        return failure();
+      if (rhs.dependsOnX)
+        std::swap(lhs, rhs);
+      result = {lhs.scale * rhs.shift, lhs.shift * rhs.shift, lhs.dependsOnX};
+    } else if (isa<arith::DivFOp>(op)) {
+      if (operands[1].dependsOnX)
+        return failure();
+      result = {operands[0].scale / operands[1].shift,
+                operands[0].shift / operands[1].shift, operands[0].dependsOnX};
+    } else if (isa<arith::NegFOp>(op)) {
+      result = {-operands[0].scale, -operands[0].shift, operands[0].dependsOnX};
+    } else if (isa<math::SqrtOp, math::RsqrtOp>(op)) {
+      if (operands[0].dependsOnX)
+        return failure();
+      double root = std::sqrt(operands[0].shift);
+      result = {0.0, isa<math::RsqrtOp>(op) ? 1.0 / root : root, false};
+    } else {
+      return failure();
+    }
+    values[op.getResult(0)] = result;
+  }
+  std::optional<AffineValue> yield =
+      lookup(body->getTerminator()->getOperand(0));
+  if (!yield)
+    return failure();
+  return *yield;
+}
+
+// Return the bias of a convolution initialized with `init`: zeros, or the
+// broadcast of a constant to the channels.
+static std::optional<SmallVector<float>> getConvBias(Value init,
+                                                     int64_t channels) {
+  if (utils::isZeroTensor(init))
+    return SmallVector<float>(channels, 0.0f);
+  auto broadcastOp = init.getDefiningOp<linalg::GenericOp>();
+  if (!broadcastOp || broadcastOp.getNumDpsInputs() != 1 ||
+      broadcastOp.getNumDpsInits() != 1 ||
+      !isa<linalg::YieldOp>(broadcastOp.getBlock()->front()) ||
+      broadcastOp.getBlock()->getArgument(0) !=
+          broadcastOp.getBlock()->front().getOperand(0))
+    return std::nullopt;
+  OpOperand *input = broadcastOp.getDpsInputOperand(0);
+  return getChannelValues(input->get(),
+                          broadcastOp.getMatchingIndexingMap(input), channels);
+}
+
+// Fold an inference batchnorm, an element-wise op computing scale * x + shift
+// for each channel of the output x of a convolution, into the convolution:
+//
+//   %x = linalg.conv_2d_nhwc_hwcf ins(%image, %filter) outs(%bias)
+//   %y = linalg.generic ins(%x, %mean, %var, %gamma, %beta) {
+//     (x - mean) / sqrt(var + eps) * gamma + beta
+//   }
+//
+// becomes:
+//
+//   %y = linalg.conv_2d_nhwc_hwcf ins(%image, %filter * scale)
+//                                 outs(%bias * scale + shift)
+//
+// The filter, the bias and the other inputs of the batchnorm are constants,
+// the new filter and bias are computed at compile time.
+struct FoldBatchNormIntoConv : public OpRewritePattern<linalg::GenericOp> {
+  using OpRewritePattern<linalg::GenericOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(linalg::GenericOp bnOp,
+                                PatternRewriter &rewriter) const override {
+    if (!bnOp.hasPureTensorSemantics() || bnOp.getNumDpsInits() != 1 ||
+        bnOp.getNumParallelLoops() != bnOp.getNumLoops() ||
+        bnOp.getNumLoops() != 4)
+      return rewriter.notifyMatchFailure(bnOp, "not element-wise");
+    OpOperand *init = bnOp.getDpsInitOperand(0);
+    if (!bnOp.getMatchingIndexingMap(init).isIdentity() ||
+        bnOp.payloadUsesValueFromOperand(init))
+      return rewriter.notifyMatchFailure(bnOp, "reads its output");
+
+    // The input produced by the convolution.
+    linalg::Conv2DNhwcHwcfOp convOp;
+    unsigned x = 0;
+    for (OpOperand *input : bnOp.getDpsInputOperands()) {
+      auto producer = input->get().getDefiningOp<linalg::Conv2DNhwcHwcfOp>();
+      if (!producer)
+        continue;
+      if (convOp)
+        return rewriter.notifyMatchFailure(bnOp, "multiple convolutions");
+      convOp = producer;
+      x = input->getOperandNumber();
+    }
+    if (!convOp || !convOp->hasOneUse() ||
+        !bnOp.getMatchingIndexingMap(bnOp.getDpsInputOperand(x)).isIdentity())
+      return rewriter.notifyMatchFailure(bnOp, "no single-use convolution");
+    auto outputType = cast<RankedTensorType>(convOp.getResultTypes()[0]);
+    if (!outputType.hasStaticShape() || !outputType.getElementType().isF32() ||
+        outputType != bnOp.getResultTypes()[0])
+      return rewriter.notifyMatchFailure(bnOp, "expects static f32 outputs");
+    int64_t channels = outputType.getDimSize(kChannelDim);
+
+    Value filter = convOp.getDpsInputOperand(1)->get();
+    DenseFPElementsAttr filterAttr;
+    if (!matchPattern(filter, m_Constant(&filterAttr)) ||
+        !filterAttr.getElementType().isF32())
+      return rewriter.notifyMatchFailure(bnOp, "expects a constant filter");
+    std::optional<SmallVector<float>> bias =
+        getConvBias(convOp.getDpsInitOperand(0)->get(), channels);
+    if (!bias)
+      return rewriter.notifyMatchFailure(bnOp, "expects a constant bias");
+
+    SmallVector<SmallVector<float>> channelValues(bnOp.getNumDpsInputs());
+    for (OpOperand *input : bnOp.getDpsInputOperands()) {
+      if (input->getOperandNumber() == x)
+        continue;
+      std::optional<SmallVector<float>> values = getChannelValues(
+          input->get(), bnOp.getMatchingIndexingMap(input), channels);
+      if (!values)
+        return rewriter.notifyMatchFailure(bnOp, "expects constant channels");
+      channelValues[input->getOperandNumber()] = std::move(*values);
+    }
+
+    SmallVector<float> scales, shifts;
+    for (int64_t channel = 0; channel < channels; channel++) {
+      FailureOr<AffineValue> value =
+          evaluateAffine(bnOp, x, channelValues, channel);
+      if (failed(value) || !value->dependsOnX)
+        return rewriter.notifyMatchFailure(bnOp, "not an affine batchnorm");
+      scales.push_back(value->scale);
+      shifts.push_back(value->shift);
+    }
+
+    // Scale the filter along its output channels, the innermost dimension.
+    SmallVector<float> filterValues =
+        llvm::to_vector(filterAttr.getValues<float>());
+    for (auto [index, value] : llvm::enumerate(filterValues))
+      value *= scales[index % channels];
+    SmallVector<float> newBias;
+    for (int64_t channel = 0; channel < channels; channel++)
+      newBias.push_back(scales[channel] * (*bias)[channel] + shifts[channel]);
+
+    Location loc = bnOp.getLoc();
+    auto filterType = cast<RankedTensorType>(filterAttr.getType());
+    Value newFilter = rewriter.create<arith::ConstantOp>(
+        loc, filterType,
+        DenseElementsAttr::get(filterType, ArrayRef<float>(filterValues)));
+    auto biasType = RankedTensorType::get({channels}, rewriter.getF32Type());
+    Value biasConst = rewriter.create<arith::ConstantOp>(
+        loc, biasType,
+        DenseElementsAttr::get(biasType, ArrayRef<float>(newBias)));
+
+    // Broadcast the bias into the init of the convolution, as
+    // conv-init-simplify does.
+    MLIRContext *ctx = rewriter.getContext();
+    Value empty = rewriter.create<tensor::EmptyOp>(
+        loc, outputType.getShape(), outputType.getElementType());
+    SmallVector<AffineMap> maps{
+        AffineMap::get(4, 0, getAffineDimExpr(kChannelDim, ctx)),
+        rewriter.getMultiDimIdentityMap(4)};
+    Value newInit =
+        rewriter
+            .create<linalg::GenericOp>(
+                loc, outputType, ValueRange{biasConst}, ValueRange{empty}, maps,
+                SmallVector<utils::IteratorType>(
+                    4, utils::IteratorType::parallel),
+                [](OpBuilder &b, Location loc, ValueRange args) {
+                  b.create<linalg::YieldOp>(loc, args[0]);
+                })
+            .getResult(0);
+
+    auto newConv = rewriter.create<linalg::Conv2DNhwcHwcfOp>(
+        loc, outputType,
+        ValueRange{convOp.getDpsInputOperand(0)->get(), newFilter}, newInit,
+        convOp.getStrides(), convOp.getDilations());
+    if (auto metadata = convOp->getAttr("metadata"))
+      newConv->setAttr("metadata", metadata);
+    LLVM_DEBUG(llvm::dbgs() << "[FoldBatchNorm] folded " << bnOp << "\n");
+    rewriter.replaceOp(bnOp, newConv.getResults());
+    rewriter.eraseOp(convOp);
+    return success();
+  }
+};
+
+struct FoldBatchNorm : public tpp::impl::FoldBatchNormBase<FoldBatchNorm> {
+  using FoldBatchNormBase::FoldBatchNormBase;
+
+  void runOnOperation() override {
+    RewritePatternSet patterns(&getContext());
+    patterns.add<FoldBatchNormIntoConv>(&getContext());
+    (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
+  }
+};
+
+} // namespace
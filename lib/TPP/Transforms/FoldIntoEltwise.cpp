@@ -11,11 +11,15 @@
 #include "TPP/Transforms/Utils/TransformUtils.h"
 #include "mlir/Dialect/Affine/IR/AffineOps.h"
 #include "mlir/Dialect/Arith/Utils/Utils.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
 #include "mlir/Dialect/Linalg/Transforms/Transforms.h"
 #include "mlir/Dialect/Linalg/Utils/Utils.h"
+#include "mlir/Dialect/Tensor/IR/Tensor.h"
 #include "mlir/IR/AffineMap.h"
 #include "mlir/IR/PatternMatch.h"
+#include "mlir/Interfaces/FunctionInterfaces.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 
 using namespace mlir;
@@ -188,10 +192,121 @@ struct FillIntoMax : public OpRewritePattern<linalg::MaxOp> {
   }
 };
 
+// Returns true if `value` is computed by elementwise ops from the function
+// arguments and constants only, as the updates of an optimizer step:
+//   m' = b1 * m + (1 - b1) * g
+//   w' = w - lr * m'
+// The results of contractions, e.g. in the epilogues of matmuls, are not.
+static bool isUpdateChain(Value value) {
+  SmallVector<Value> worklist{value};
+  DenseSet<Value> visited;
+  while (!worklist.empty()) {
+    Value current = worklist.pop_back_val();
+    if (!visited.insert(current).second)
+      continue;
+    if (auto blockArg = dyn_cast<BlockArgument>(current)) {
+      if (!isa<FunctionOpInterface>(blockArg.getOwner()->getParentOp()))
+        return false;
+      continue;
+    }
+    Operation *op = current.getDefiningOp();
+    if (isa<arith::ConstantOp, tensor::EmptyOp>(op))
+      continue;
+    // Scalar hyper-parameters, e.g. (1 - b1).
+    if (!isa<ShapedType>(current.getType()) && isPure(op) &&
+        op->getNumRegions() == 0) {
+      llvm::append_range(worklist, op->getOperands());
+      continue;
+    }
+    auto linalgOp = dyn_cast<linalg::LinalgOp>(op);
+    if (!linalgOp || !linalgOp.hasPureTensorSemantics() ||
+        !(linalg::isElementwise(linalgOp) ||
+          isa<linalg::FillOp, linalg::BroadcastOp>(op))) {
+      return false;
+    }
+    llvm::append_range(worklist, op->getOperands());
+  }
+  return true;
+}
+
+// Returns true if `op` is an elementwise op of an update chain.
+static bool isUpdateChainOp(Operation *op) {
+  auto linalgOp = dyn_cast<linalg::LinalgOp>(op);
+  if (!linalgOp || !linalgOp.hasPureTensorSemantics() ||
+      !linalg::isElementwise(linalgOp) ||
+      isa<linalg::FillOp, linalg::BroadcastOp, linalg::CopyOp>(op)) {
+    return false;
+  }
+  return llvm::all_of(op->getResults(), isUpdateChain);
+}
+
+// Generalize the named elementwise ops of the update chains that have a
+// producer or a user in the chain, so that they fuse with them.
+struct GeneralizeUpdateChainOp
+    : public OpInterfaceRewritePattern<linalg::LinalgOp> {
+  using OpInterfaceRewritePattern<linalg::LinalgOp>::OpInterfaceRewritePattern;
+
+  LogicalResult matchAndRewrite(linalg::LinalgOp linalgOp,
+                                PatternRewriter &rewriter) const override {
+    if (isa<linalg::GenericOp>(linalgOp) || !isUpdateChainOp(linalgOp))
+      return rewriter.notifyMatchFailure(linalgOp, "not a named update op");
+
+    bool hasProducer = llvm::any_of(linalgOp.getDpsInputs(), [](Value input) {
+      Operation *producer = input.getDefiningOp();
+      return producer && isUpdateChainOp(producer);
+    });
+    bool hasUser = llvm::any_of(linalgOp->getUsers(), isUpdateChainOp);
+    if (!hasProducer && !hasUser)
+      return rewriter.notifyMatchFailure(linalgOp, "not chained");
+
+    if (failed(linalg::generalizeNamedOp(rewriter, linalgOp)))
+      return rewriter.notifyMatchFailure(linalgOp, "cannot generalize");
+    return success();
+  }
+};
+
+// Fuse the producers of an update chain into their elementwise users. The
+// producer results also used outside of the chain become results of the fused
+// op, so that all the updates are computed in a single pass.
+struct FuseUpdateChainOps : public OpRewritePattern<linalg::GenericOp> {
+  using OpRewritePattern<linalg::GenericOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(linalg::GenericOp genericOp,
+                                PatternRewriter &rewriter) const override {
+    if (!isUpdateChainOp(genericOp))
+      return rewriter.notifyMatchFailure(genericOp, "not an update op");
+
+    for (OpOperand &operand : genericOp->getOpOperands()) {
+      auto producer = operand.get().getDefiningOp<linalg::GenericOp>();
+      if (!producer || !isUpdateChainOp(producer) ||
+          !linalg::areElementwiseOpsFusable(&operand))
+        continue;
+
+      FailureOr<linalg::ElementwiseOpFusionResult> fusionResult =
+          linalg::fuseElementwiseOps(rewriter, &operand);
+      if (failed(fusionResult))
+        continue;
+      // Both the consumer and the preserved producer results are replaced,
+      // the producer is then dead.
+      for (auto [origVal, replacement] : fusionResult->replacements)
+        rewriter.replaceAllUsesWith(origVal, replacement);
+      rewriter.eraseOp(genericOp);
+      return success();
+    }
+    return rewriter.notifyMatchFailure(genericOp, "no fusable producer");
+  }
+};
+
 struct FoldIntoEltwise : tpp::impl::FoldIntoEltwiseBase<FoldIntoEltwise> {
+  using FoldIntoEltwiseBase::FoldIntoEltwiseBase;
+
   void runOnOperation() override {
     RewritePatternSet patterns(&getContext());
     patterns.add<BroadcastIntoEltwise, FillIntoMax>(patterns.getContext());
+    if (fuseUpdateChains) {
+      patterns.add<GeneralizeUpdateChainOp, FuseUpdateChainOps>(
+          patterns.getContext());
+    }
     (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
   }
 };
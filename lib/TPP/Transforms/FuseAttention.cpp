@@ -0,0 +1,668 @@
+//===- FuseAttention.cpp -----------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the fusion of the attention of transformers, scores =
+// Q * K^T, softmax and scores * V, into a tiled loop with an online softmax
+// that never materializes the whole score matrix.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "TPP/Transforms/Utils/TransformUtils.h"
+#include "TPP/Transforms/Utils/ValueUtils.h"
+
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/Math/IR/Math.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Tensor/IR/Tensor.h"
+#include "mlir/Dialect/Utils/StructuredOpsUtils.h"
+#include "mlir/IR/PatternMatch.h"
+#include "llvm/ADT/DenseSet.h"
+
+#include <algorithm>
+#include <optional>
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_FUSEATTENTION
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+namespace {
+
+// Attention as a contraction of the scores into the output, with an optional
+// softmax of the scores along the reduction of the output.
+struct Attention {
+  // S = Q * K^T
+  linalg::LinalgOp scores;
+  // P = softmax(S), if any.
+  linalg::SoftmaxOp softmax;
+  // O = P * V
+  linalg::LinalgOp output;
+  // The operand of `output` holding P.
+  OpOperand *probs = nullptr;
+  // The dimension of the scores reduced by `output`.
+  unsigned kvDim = 0;
+  // The reduction loop of `output`.
+  unsigned kvLoop = 0;
+};
+
+static bool isStaticContraction(linalg::LinalgOp linalgOp) {
+  return linalgOp && linalgOp.hasPureTensorSemantics() &&
+         linalgOp->getNumResults() == 1 && !linalgOp.hasDynamicShape() &&
+         llvm::all_of(linalgOp.getIndexingMapsArray(),
+                      [](AffineMap map) {
+                        return map.isProjectedPermutation();
+                      }) &&
+         succeeded(linalgx::utils::isContraction(linalgOp));
+}
+
+static FailureOr<Attention> matchAttention(linalg::LinalgOp outputOp) {
+  if (!isStaticContraction(outputOp) ||
+      outputOp.getNumReductionLoops() != 1 ||
+      outputOp->getParentOfType<scf::ForallOp>())
+    return failure();
+
+  Attention attention;
+  attention.output = outputOp;
+  SmallVector<unsigned> reductionLoops;
+  outputOp.getReductionDims(reductionLoops);
+  attention.kvLoop = reductionLoops.front();
+
+  for (OpOperand *input : outputOp.getDpsInputOperands()) {
+    Value probs = input->get();
+    if (!probs.hasOneUse())
+      continue;
+    Value scores = probs;
+    linalg::SoftmaxOp softmaxOp = probs.getDefiningOp<linalg::SoftmaxOp>();
+    if (softmaxOp) {
+      scores = softmaxOp.getInput();
+      if (!scores.hasOneUse())
+        continue;
+    }
+    auto scoresOp = scores.getDefiningOp<linalg::LinalgOp>();
+    if (!isStaticContraction(scoresOp) ||
+        !utils::isZeroTensor(scoresOp.getDpsInits()[0]))
+      continue;
+
+    // The reduction of the output runs along a dimension of the scores.
+    AffineMap probsMap = outputOp.getMatchingIndexingMap(input);
+    std::optional<unsigned> kvDim =
+        probsMap.getResultPosition(getAffineDimExpr(attention.kvLoop,
+                                                    outputOp.getContext()));
+    if (!kvDim || probsMap.getNumResults() < 2 ||
+        probsMap.getNumResults() !=
+                      scoresOp.getMatchingIndexingMap(
+                                  scoresOp.getDpsInitOperand(0))
+                          .getNumResults())
+      continue;
+
+    // The online softmax rescales the accumulators, they must start at zero.
+    if (softmaxOp &&
+        (softmaxOp.getDimension() != *kvDim ||
+         !isa<FloatType>(getElementTypeOrSelf(probs.getType())) ||
+         !utils::isZeroTensor(outputOp.getDpsInits()[0])))
+      continue;
+
+    attention.scores = scoresOp;
+    attention.softmax = softmaxOp;
+    attention.probs = input;
+    attention.kvDim = *kvDim;
+    return attention;
+  }
+  return failure();
+}
+
+// Offsets and sizes of the loops of an operation.
+struct LoopSlice {
+  SmallVector<OpFoldResult> offsets;
+  SmallVector<int64_t> sizes;
+};
+
+static LoopSlice getFullSlice(OpBuilder &builder, linalg::LinalgOp linalgOp) {
+  LoopSlice slice;
+  slice.sizes = llvm::to_vector(linalgOp.getStaticLoopRanges());
+  slice.offsets.assign(slice.sizes.size(), builder.getIndexAttr(0));
+  return slice;
+}
+
+// Return the slice of the operand (or result) indexed by `map` on `slice`.
+static SmallVector<int64_t> getSliceShape(AffineMap map,
+                                          const LoopSlice &slice) {
+  SmallVector<int64_t> shape;
+  for (unsigned result : llvm::seq<unsigned>(0, map.getNumResults()))
+    shape.push_back(slice.sizes[map.getDimPosition(result)]);
+  return shape;
+}
+
+static Value extractSlice(OpBuilder &builder, Location loc, Value source,
+                          AffineMap map, const LoopSlice &slice) {
+  SmallVector<OpFoldResult> offsets, sizes;
+  for (unsigned result : llvm::seq<unsigned>(0, map.getNumResults())) {
+    unsigned dim = map.getDimPosition(result);
+    offsets.push_back(slice.offsets[dim]);
+    sizes.push_back(builder.getIndexAttr(slice.sizes[dim]));
+  }
+  SmallVector<OpFoldResult> strides(map.getNumResults(),
+                                    builder.getIndexAttr(1));
+  return builder.create<tensor::ExtractSliceOp>(loc, source, offsets, sizes,
+                                                strides);
+}
+
+// Compute `slice` of `linalgOp` into `acc`, replacing the slice of the input
+// `replaced`, if any, with `replacement`.
+static Value computeSlice(OpBuilder &builder, Location loc,
+                          linalg::LinalgOp linalgOp, const LoopSlice &slice,
+                          Value acc, OpOperand *replaced = nullptr,
+                          Value replacement = nullptr) {
+  SmallVector<Value> operands;
+  for (OpOperand *input : linalgOp.getDpsInputOperands()) {
+    if (input == replaced) {
+      operands.push_back(replacement);
+      continue;
+    }
+    operands.push_back(extractSlice(builder, loc, input->get(),
+                                    linalgOp.getMatchingIndexingMap(input),
+                                    slice));
+  }
+  operands.push_back(acc);
+  return clone(builder, linalgOp.getOperation(), TypeRange{acc.getType()},
+               operands)
+      ->getResult(0);
+}
+
+static Value createFilledTensor(OpBuilder &builder, Location loc,
+                                ArrayRef<int64_t> shape, Type elementType,
+                                TypedAttr value) {
+  Value empty = builder.create<tensor::EmptyOp>(loc, shape, elementType);
+  Value cst = builder.create<arith::ConstantOp>(loc, elementType, value);
+  return builder.create<linalg::FillOp>(loc, cst, empty).getResult(0);
+}
+
+// Elementwise `fn` of `inputs` into a new tensor of `type`, the inputs are
+// indexed by `maps` over the dimensions of `type`.
+static Value
+createElementwise(OpBuilder &builder, Location loc, RankedTensorType type,
+                  ValueRange inputs, ArrayRef<AffineMap> maps,
+                  function_ref<Value(OpBuilder &, Location, ValueRange)> fn) {
+  Value empty = builder.create<tensor::EmptyOp>(loc, type.getShape(),
+                                                type.getElementType());
+  SmallVector<AffineMap> indexingMaps(maps);
+  indexingMaps.push_back(
+      builder.getMultiDimIdentityMap(type.getRank()));
+  SmallVector<utils::IteratorType> iterators(type.getRank(),
+                                             utils::IteratorType::parallel);
+  return builder
+      .create<linalg::GenericOp>(
+          loc, type, inputs, ValueRange{empty}, indexingMaps, iterators,
+          [&](OpBuilder &builder, Location loc, ValueRange args) {
+            Value result = fn(builder, loc, args.drop_back());
+            builder.create<linalg::YieldOp>(loc, result);
+          })
+      .getResult(0);
+}
+
+// Reduce `input` along `dim` into `init`, combined with `combine`.
+static Value
+createRowReduction(OpBuilder &builder, Location loc, Value input, Value init,
+                   unsigned dim,
+                   function_ref<Value(OpBuilder &, Location, Value, Value)>
+                       combine) {
+  return builder
+      .create<linalg::ReduceOp>(
+          loc, ValueRange{input}, ValueRange{init},
+          SmallVector<int64_t>{dim},
+          [&](OpBuilder &builder, Location loc, ValueRange args) {
+            Value result = combine(builder, loc, args[0], args[1]);
+            builder.create<linalg::YieldOp>(loc, result);
+          })
+      .getResult(0);
+}
+
+// Return the map from the dimensions of a tile of rank `rank` to the rows
+// of the softmax, i.e., all but `dim`.
+static AffineMap getRowMap(MLIRContext *ctx, unsigned rank, unsigned dim) {
+  SmallVector<AffineExpr> exprs;
+  for (unsigned idx : llvm::seq<unsigned>(0, rank)) {
+    if (idx != dim)
+      exprs.push_back(getAffineDimExpr(idx, ctx));
+  }
+  return AffineMap::get(rank, /*symbolCount=*/0, exprs, ctx);
+}
+
+// Combine the partial results of the blocks of keys of `forallOp` into the
+// output, `init` without a softmax. `accRowMap` maps the output to the rows
+// of the softmax.
+static Value combineBlocks(RewriterBase &rewriter, Location loc,
+                           scf::ForallOp forallOp, Value init,
+                           AffineMap accRowMap, bool hasSoftmax) {
+  MLIRContext *ctx = rewriter.getContext();
+  auto outType = cast<RankedTensorType>(init.getType());
+  Type elementType = outType.getElementType();
+  auto add = [](OpBuilder &builder, Location loc, Value in, Value out) {
+    return builder.create<arith::AddFOp>(loc, in, out);
+  };
+  Value accParts = forallOp.getResult(0);
+  if (!hasSoftmax)
+    return createRowReduction(rewriter, loc, accParts, init, /*dim=*/0, add);
+
+  // Rescale the blocks to the maximum of their rows.
+  Value maxParts = forallOp.getResult(1);
+  Value sumParts = forallOp.getResult(2);
+  auto partsType = cast<RankedTensorType>(maxParts.getType());
+  ArrayRef<int64_t> rowsShape = partsType.getShape().drop_front();
+  auto floatType = cast<FloatType>(elementType);
+  Value max = createRowReduction(
+      rewriter, loc, maxParts,
+      createFilledTensor(rewriter, loc, rowsShape, elementType,
+                         rewriter.getFloatAttr(
+                             floatType,
+                             APFloat::getInf(floatType.getFloatSemantics(),
+                                             /*Negative=*/true))),
+      /*dim=*/0, [](OpBuilder &builder, Location loc, Value in, Value out) {
+        return builder.create<arith::MaximumFOp>(loc, in, out);
+      });
+  AffineMap partsIdentity =
+      rewriter.getMultiDimIdentityMap(partsType.getRank());
+  Value scale = createElementwise(
+      rewriter, loc, partsType, {maxParts, max},
+      {partsIdentity, getRowMap(ctx, partsType.getRank(), /*dim=*/0)},
+      [](OpBuilder &builder, Location loc, ValueRange args) {
+        Value sub = builder.create<arith::SubFOp>(loc, args[0], args[1]);
+        return builder.create<math::ExpOp>(loc, sub);
+      });
+  auto mul = [](OpBuilder &builder, Location loc, ValueRange args) {
+    return builder.create<arith::MulFOp>(loc, args[0], args[1]);
+  };
+  Value sum = createElementwise(rewriter, loc, partsType, {sumParts, scale},
+                                {partsIdentity, partsIdentity}, mul);
+  sum = createRowReduction(rewriter, loc, sum,
+                           createFilledTensor(rewriter, loc, rowsShape,
+                                              elementType,
+                                              rewriter.getZeroAttr(elementType)),
+                           /*dim=*/0, add);
+
+  // The rows of the partial accumulators are the ones of the output, after
+  // the block dimension.
+  auto accPartsType = cast<RankedTensorType>(accParts.getType());
+  SmallVector<AffineExpr> rowExprs{getAffineDimExpr(0, ctx)};
+  for (AffineExpr expr : accRowMap.shiftDims(1).getResults())
+    rowExprs.push_back(expr);
+  AffineMap accPartsRowMap =
+      AffineMap::get(accPartsType.getRank(), /*symbolCount=*/0, rowExprs, ctx);
+  Value acc = createElementwise(
+      rewriter, loc, accPartsType, {accParts, scale},
+      {rewriter.getMultiDimIdentityMap(accPartsType.getRank()), accPartsRowMap},
+      mul);
+  acc = createRowReduction(rewriter, loc, acc,
+                           createFilledTensor(rewriter, loc,
+                                              outType.getShape(), elementType,
+                                              rewriter.getZeroAttr(elementType)),
+                           /*dim=*/0, add);
+  return createElementwise(
+      rewriter, loc, outType, {acc, sum},
+      {rewriter.getMultiDimIdentityMap(outType.getRank()), accRowMap},
+      [](OpBuilder &builder, Location loc, ValueRange args) {
+        return builder.create<arith::DivFOp>(loc, args[0], args[1]);
+      });
+}
+
+// Fuse `attention` into a loop over the tiles of its output rows, each
+// iterating over the tiles of the keys:
+//
+// %O = forall (rows) {
+//   %max = fill(-inf), %sum = fill(0), %acc = %O[rows]
+//   for (kv) {
+//     %S = Q[rows] * K[kv]^T
+//     %maxNew = max(%max, rowmax(%S))
+//     %P = exp(%S - %maxNew)
+//     %scale = exp(%max - %maxNew)
+//     %sum = %sum * %scale + rowsum(%P)
+//     %acc = %acc * %scale + %P * V[kv]
+//   }
+//   %O[rows] = %acc / %sum
+// }
+//
+// Only a tile of the scores is live at a time. Without a softmax, the tiles
+// of the scores are accumulated into the output as they are.
+//
+// With `kvSplit` blocks of keys, the forall also runs over the blocks, and
+// each iteration writes its accumulators, row maxima and sums, before the
+// normalization, into partial results with a leading block dimension. They
+// are combined once the forall is over:
+//
+//   %max = rowmax over the blocks(%maxParts)
+//   %scale = exp(%maxParts - %max)
+//   %O = sum over the blocks(%accParts * %scale)
+//        / sum over the blocks(%sumParts * %scale)
+static LogicalResult fuseAttention(RewriterBase &rewriter,
+                                   const Attention &attention,
+                                   int64_t rowTile, int64_t kvTile,
+                                   int64_t kvSplit) {
+  linalg::LinalgOp outputOp = attention.output;
+  linalg::LinalgOp scoresOp = attention.scores;
+  MLIRContext *ctx = outputOp.getContext();
+  Location loc = outputOp.getLoc();
+  AffineMap probsMap = outputOp.getMatchingIndexingMap(attention.probs);
+  AffineMap scoresMap =
+      scoresOp.getMatchingIndexingMap(scoresOp.getDpsInitOperand(0));
+  AffineMap outMap =
+      outputOp.getMatchingIndexingMap(outputOp.getDpsInitOperand(0));
+  SmallVector<int64_t> loopsRange =
+      llvm::to_vector(outputOp.getStaticLoopRanges());
+
+  // Tile the keys, the memory saving comes from there. The blocks of keys
+  // are tiled on their own, they may be smaller than a tile.
+  int64_t kvRange = loopsRange[attention.kvLoop];
+  int64_t numBlocks = std::max<int64_t>(kvSplit, 1);
+  if (kvRange % numBlocks != 0)
+    return failure();
+  int64_t kvBlock = kvRange / numBlocks;
+  if (numBlocks > 1)
+    kvTile = std::min(kvTile, kvBlock);
+  if (kvTile <= 0 || kvBlock % kvTile != 0 ||
+      (numBlocks == 1 && kvRange <= kvTile))
+    return failure();
+
+  // The blocks are combined with floating-point reductions.
+  RankedTensorType probsType =
+      cast<RankedTensorType>(attention.probs->get().getType());
+  Type elementType = probsType.getElementType();
+  if (numBlocks > 1 && !isa<FloatType>(elementType))
+    return failure();
+
+  // Tile the rows of the scores by `rowTile` on the innermost one and by 1
+  // on the others, e.g., the batch and the heads.
+  SmallVector<int64_t> tiles(loopsRange.size(), 0);
+  unsigned rowDim = attention.kvDim == probsMap.getNumResults() - 1
+                        ? probsMap.getNumResults() - 2
+                        : probsMap.getNumResults() - 1;
+  for (unsigned dim : llvm::seq<unsigned>(0, probsMap.getNumResults())) {
+    if (dim == attention.kvDim)
+      continue;
+    unsigned loop = probsMap.getDimPosition(dim);
+    int64_t tile = 1;
+    if (dim == rowDim)
+      tile = loopsRange[loop] % rowTile == 0 ? rowTile : loopsRange[loop];
+    if (tile < loopsRange[loop])
+      tiles[loop] = tile;
+  }
+  SmallVector<unsigned> tiledLoops;
+  SmallVector<OpFoldResult> ubs;
+  for (auto [loop, tile] : llvm::enumerate(tiles)) {
+    if (tile == 0)
+      continue;
+    tiledLoops.push_back(loop);
+    ubs.push_back(rewriter.getIndexAttr(loopsRange[loop] / tile));
+  }
+  if (numBlocks > 1)
+    ubs.push_back(rewriter.getIndexAttr(numBlocks));
+  if (ubs.empty())
+    return failure();
+
+  // The rows of the softmax broadcast along the output, e.g., the columns of
+  // V are not rows of the scores.
+  SmallVector<AffineExpr> rowExprs;
+  for (unsigned dim : llvm::seq<unsigned>(0, probsMap.getNumResults())) {
+    if (dim == attention.kvDim)
+      continue;
+    std::optional<unsigned> pos = outMap.getResultPosition(
+        getAffineDimExpr(probsMap.getDimPosition(dim), ctx));
+    if (!pos)
+      return failure();
+    rowExprs.push_back(getAffineDimExpr(*pos, ctx));
+  }
+  AffineMap accRowMap = AffineMap::get(outMap.getNumResults(),
+                                       /*symbolCount=*/0, rowExprs, ctx);
+  AffineMap accIdentity = AffineMap::getMultiDimIdentityMap(
+      outMap.getNumResults(), ctx);
+
+  OpBuilder::InsertionGuard guard(rewriter);
+  rewriter.setInsertionPoint(outputOp);
+  Value init = outputOp.getDpsInits()[0];
+  auto outType = cast<RankedTensorType>(init.getType());
+
+  // The partial results of the blocks, the rows of the softmax are the
+  // dimensions of the scores but the keys.
+  SmallVector<int64_t> rowsShape(probsType.getShape());
+  rowsShape.erase(rowsShape.begin() + attention.kvDim);
+  auto getPartsShape = [&](ArrayRef<int64_t> shape) {
+    SmallVector<int64_t> partsShape{numBlocks};
+    partsShape.append(shape.begin(), shape.end());
+    return partsShape;
+  };
+  SmallVector<Value> sharedOuts{init};
+  if (numBlocks > 1) {
+    sharedOuts.front() = rewriter.create<tensor::EmptyOp>(
+        loc, getPartsShape(outType.getShape()), elementType);
+    if (attention.softmax) {
+      for (int i = 0; i < 2; i++)
+        sharedOuts.push_back(rewriter.create<tensor::EmptyOp>(
+            loc, getPartsShape(rowsShape), elementType));
+    }
+  }
+
+  auto forallOp = rewriter.create<scf::ForallOp>(loc, ubs, sharedOuts,
+                                                 /*mapping=*/std::nullopt);
+  forallOp->setAttr(linalgx::utils::kFusedAttention, rewriter.getUnitAttr());
+  rewriter.setInsertionPoint(forallOp.getTerminator());
+
+  // The slice of the output of the iteration, the keys are sliced below.
+  LoopSlice outSlice = getFullSlice(rewriter, outputOp);
+  AffineExpr d0;
+  bindDims(ctx, d0);
+  for (auto [loop, iv] : llvm::zip(tiledLoops, forallOp.getInductionVars())) {
+    outSlice.sizes[loop] = tiles[loop];
+    outSlice.offsets[loop] = affine::makeComposedFoldedAffineApply(
+        rewriter, loc, d0 * tiles[loop], {iv});
+  }
+
+  // The accumulators of a block start at zero, the output is added when
+  // combining the blocks.
+  Value accInit;
+  if (numBlocks > 1) {
+    accInit = createFilledTensor(rewriter, loc,
+                                 getSliceShape(outMap, outSlice), elementType,
+                                 rewriter.getZeroAttr(elementType));
+  } else {
+    accInit = extractSlice(rewriter, loc, forallOp.getRegionIterArgs()[0],
+                           outMap, outSlice);
+  }
+
+  // The rows of the softmax of the iteration.
+  outSlice.sizes[attention.kvLoop] = kvTile;
+  SmallVector<int64_t> tileShape = getSliceShape(probsMap, outSlice);
+  auto tileType = RankedTensorType::get(tileShape, elementType);
+  SmallVector<int64_t> rowShape(tileShape);
+  rowShape.erase(rowShape.begin() + attention.kvDim);
+  auto rowType = RankedTensorType::get(rowShape, elementType);
+  SmallVector<Value> iterArgs{accInit};
+  if (attention.softmax) {
+    auto floatType = cast<FloatType>(elementType);
+    iterArgs.push_back(createFilledTensor(
+        rewriter, loc, rowShape, elementType,
+        rewriter.getFloatAttr(floatType,
+                              APFloat::getInf(floatType.getFloatSemantics(),
+                                              /*Negative=*/true))));
+    iterArgs.push_back(createFilledTensor(rewriter, loc, rowShape, elementType,
+                                          rewriter.getZeroAttr(elementType)));
+  }
+
+  Value lb, ub;
+  if (numBlocks > 1) {
+    Value block = forallOp.getInductionVars().back();
+    lb = affine::makeComposedAffineApply(rewriter, loc, d0 * kvBlock, {block});
+    ub = affine::makeComposedAffineApply(rewriter, loc, d0 * kvBlock + kvBlock,
+                                         {block});
+  } else {
+    lb = rewriter.create<arith::ConstantIndexOp>(loc, 0);
+    ub = rewriter.create<arith::ConstantIndexOp>(loc, kvRange);
+  }
+  Value step = rewriter.create<arith::ConstantIndexOp>(loc, kvTile);
+  auto forOp = rewriter.create<scf::ForOp>(
+      loc, lb, ub, step, iterArgs,
+      [&](OpBuilder &builder, Location loc, Value iv, ValueRange args) {
+        LoopSlice kvSlice = outSlice;
+        kvSlice.offsets[attention.kvLoop] = iv;
+
+        // The tile of the scores, on the same rows and keys.
+        LoopSlice scoresSlice = getFullSlice(builder, scoresOp);
+        for (unsigned dim : llvm::seq<unsigned>(0, probsMap.getNumResults())) {
+          unsigned loop = probsMap.getDimPosition(dim);
+          unsigned scoresLoop = scoresMap.getDimPosition(dim);
+          scoresSlice.offsets[scoresLoop] = kvSlice.offsets[loop];
+          scoresSlice.sizes[scoresLoop] = kvSlice.sizes[loop];
+        }
+        Value scoresInit = createFilledTensor(
+            builder, loc, tileShape, elementType,
+            builder.getZeroAttr(elementType));
+        Value probs =
+            computeSlice(builder, loc, scoresOp, scoresSlice, scoresInit);
+
+        Value acc = args[0];
+        SmallVector<Value> yields;
+        if (attention.softmax) {
+          AffineMap identity = builder.getMultiDimIdentityMap(tileShape.size());
+          AffineMap rowMap = getRowMap(ctx, tileShape.size(), attention.kvDim);
+          AffineMap rowIdentity =
+              builder.getMultiDimIdentityMap(rowShape.size());
+          Value max = args[1];
+          Value sum = args[2];
+          Value maxNew = createRowReduction(
+              builder, loc, probs, max, attention.kvDim,
+              [](OpBuilder &builder, Location loc, Value in, Value out) {
+                return builder.create<arith::MaximumFOp>(loc, in, out);
+              });
+          probs = createElementwise(
+              builder, loc, tileType, {probs, maxNew}, {identity, rowMap},
+              [](OpBuilder &builder, Location loc, ValueRange args) {
+                Value sub =
+                    builder.create<arith::SubFOp>(loc, args[0], args[1]);
+                return builder.create<math::ExpOp>(loc, sub);
+              });
+          Value scale = createElementwise(
+              builder, loc, rowType, {max, maxNew}, {rowIdentity, rowIdentity},
+              [](OpBuilder &builder, Location loc, ValueRange args) {
+                Value sub =
+                    builder.create<arith::SubFOp>(loc, args[0], args[1]);
+                return builder.create<math::ExpOp>(loc, sub);
+              });
+          auto mul = [](OpBuilder &builder, Location loc, ValueRange args) {
+            return builder.create<arith::MulFOp>(loc, args[0], args[1]);
+          };
+          sum = createElementwise(builder, loc, rowType, {sum, scale},
+                                  {rowIdentity, rowIdentity}, mul);
+          sum = createRowReduction(
+              builder, loc, probs, sum, attention.kvDim,
+              [](OpBuilder &builder, Location loc, Value in, Value out) {
+                return builder.create<arith::AddFOp>(loc, in, out);
+              });
+
+          // Rescale the accumulators to the new maximum of their rows.
+          acc = createElementwise(
+              builder, loc, cast<RankedTensorType>(acc.getType()),
+              {acc, scale}, {accIdentity, accRowMap}, mul);
+          yields.append({maxNew, sum});
+        }
+        acc = computeSlice(builder, loc, outputOp, kvSlice, acc,
+                           attention.probs, probs);
+        yields.insert(yields.begin(), acc);
+        builder.create<scf::YieldOp>(loc, yields);
+      });
+
+  // Normalize the rows by their sum, the blocks are normalized once
+  // combined.
+  Value result = forOp.getResult(0);
+  if (attention.softmax && numBlocks == 1) {
+    result = createElementwise(
+        rewriter, loc, cast<RankedTensorType>(result.getType()),
+        {result, forOp.getResult(2)}, {accIdentity, accRowMap},
+        [](OpBuilder &builder, Location loc, ValueRange args) {
+          return builder.create<arith::DivFOp>(loc, args[0], args[1]);
+        });
+  }
+
+  // Insert the results of the iteration, in the partial results of its block
+  // with a split.
+  rewriter.setInsertionPointToStart(forallOp.getTerminator().getBody());
+  auto insertSlice = [&](Value source, Value dest, AffineMap map,
+                         std::optional<unsigned> skippedDim) {
+    SmallVector<OpFoldResult> offsets, sizes;
+    if (numBlocks > 1) {
+      offsets.push_back(forallOp.getInductionVars().back());
+      sizes.push_back(rewriter.getIndexAttr(1));
+    }
+    for (unsigned result : llvm::seq<unsigned>(0, map.getNumResults())) {
+      if (result == skippedDim)
+        continue;
+      unsigned loop = map.getDimPosition(result);
+      offsets.push_back(outSlice.offsets[loop]);
+      sizes.push_back(rewriter.getIndexAttr(outSlice.sizes[loop]));
+    }
+    SmallVector<OpFoldResult> strides(offsets.size(),
+                                      rewriter.getIndexAttr(1));
+    rewriter.create<tensor::ParallelInsertSliceOp>(loc, source, dest, offsets,
+                                                   sizes, strides);
+  };
+  auto sharedArgs = forallOp.getRegionIterArgs();
+  insertSlice(result, sharedArgs[0], outMap, /*skippedDim=*/std::nullopt);
+  if (attention.softmax && numBlocks > 1) {
+    insertSlice(forOp.getResult(1), sharedArgs[1], probsMap, attention.kvDim);
+    insertSlice(forOp.getResult(2), sharedArgs[2], probsMap, attention.kvDim);
+  }
+
+  Value combined = forallOp.getResult(0);
+  if (numBlocks > 1) {
+    rewriter.setInsertionPointAfter(forallOp);
+    combined = combineBlocks(rewriter, loc, forallOp, init, accRowMap,
+                             attention.softmax != nullptr);
+  }
+
+  rewriter.replaceOp(outputOp, combined);
+  if (attention.softmax)
+    rewriter.eraseOp(attention.softmax);
+  rewriter.eraseOp(scoresOp);
+  return success();
+}
+
+struct FuseAttention : public tpp::impl::FuseAttentionBase<FuseAttention> {
+  using FuseAttentionBase::FuseAttentionBase;
+
+  void runOnOperation() override {
+    SmallVector<Attention> attentions;
+    getOperation()->walk([&](linalg::LinalgOp linalgOp) {
+      auto attention = matchAttention(linalgOp);
+      if (succeeded(attention))
+        attentions.push_back(*attention);
+    });
+
+    // The output of an attention may be the scores of the next one, skip the
+    // attentions whose operations are already fused.
+    IRRewriter rewriter(&getContext());
+    llvm::SmallDenseSet<Operation *> fusedOps;
+    for (const Attention &attention : attentions) {
+      if (fusedOps.contains(attention.scores) ||
+          fusedOps.contains(attention.output))
+        continue;
+      Operation *scoresOp = attention.scores;
+      Operation *outputOp = attention.output;
+      if (succeeded(
+              fuseAttention(rewriter, attention, rowTile, kvTile, kvSplit)))
+        fusedOps.insert({scoresOp, outputOp});
+    }
+  }
+};
+
+} // namespace
@@ -0,0 +1,451 @@
+//===- FuseNormalization.cpp -------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the fusion of the layer and RMS normalizations of
+// transformers, decomposed into row reductions and element-wise operations,
+// into a loop over tiles of rows. The statistics of a layer normalization are
+// computed in a single pass over its input.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "TPP/IR/MatcherUtils.h"
+#include "TPP/Transforms/Utils/TransformUtils.h"
+#include "TPP/Transforms/Utils/ValueUtils.h"
+
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Tensor/IR/Tensor.h"
+#include "mlir/Dialect/Utils/StructuredOpsUtils.h"
+#include "mlir/IR/IRMapping.h"
+#include "mlir/IR/Matchers.h"
+#include "mlir/IR/PatternMatch.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SetVector.h"
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_FUSENORMALIZATION
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+namespace {
+
+enum class NormKind { LayerNorm, RMSNorm };
+
+// A normalization of the rows of a 2d tensor, the operations computing `root`
+// from the same rows of their operands, in the order of the block.
+struct Normalization {
+  NormKind kind;
+  SmallVector<linalg::LinalgOp> ops;
+  linalg::LinalgOp root;
+  // The row sum of the input and the sum of the squares of the input
+  // centered on its mean, of a layer normalization.
+  linalg::LinalgOp sum;
+  linalg::LinalgOp variance;
+};
+
+// Return true if each row of the results of `linalgOp` only depends on the
+// same row of its operands, the rows being its first loop, of `rows`
+// iterations. Operands not indexed by the rows are broadcast along them.
+static bool isRowWise(linalg::LinalgOp linalgOp, int64_t rows) {
+  if (!linalgOp.hasPureTensorSemantics() || linalgOp.hasDynamicShape() ||
+      linalgOp.getNumLoops() == 0 ||
+      linalgOp.getIteratorTypesArray()[0] != utils::IteratorType::parallel ||
+      linalgOp.getStaticLoopRanges()[0] != rows)
+    return false;
+  AffineExpr rowExpr = getAffineDimExpr(0, linalgOp.getContext());
+  for (OpOperand &operand : linalgOp->getOpOperands()) {
+    AffineMap map = linalgOp.getMatchingIndexingMap(&operand);
+    for (auto [idx, expr] : llvm::enumerate(map.getResults())) {
+      if (expr.isFunctionOfDim(0) && (idx != 0 || expr != rowExpr))
+        return false;
+    }
+    bool hasRows = map.getNumResults() != 0 && map.getResult(0) == rowExpr;
+    if (linalgOp.isDpsInit(&operand) && !hasRows)
+      return false;
+  }
+  return true;
+}
+
+// Collect the row-wise operations computing `root` in its block. Operations
+// with uses outside of them are left out, but for fills, which are cheap to
+// recompute. Contractions are only fused if their rows are at most
+// `maxEpilogueCols` wide.
+static SmallVector<linalg::LinalgOp> collectRowSlice(linalg::LinalgOp root,
+                                                     int64_t maxEpilogueCols) {
+  int64_t rows = root.getStaticLoopRanges()[0];
+  int64_t cols = root.getStaticLoopRanges()[1];
+  llvm::SetVector<Operation *> slice;
+  slice.insert(root);
+  auto isUsedInSlice = [&](Operation *op) {
+    return llvm::all_of(op->getUsers(),
+                        [&](Operation *user) { return slice.contains(user); });
+  };
+  // A producer is added once all its users are, iterate until no more are.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (unsigned idx = 0; idx < slice.size(); ++idx) {
+      for (Value operand : slice[idx]->getOperands()) {
+        auto producer = operand.getDefiningOp<linalg::LinalgOp>();
+        if (!producer || slice.contains(producer) ||
+            producer->getBlock() != root->getBlock() ||
+            !isRowWise(producer, rows))
+          continue;
+        if (!isa<linalg::FillOp>(producer) && !isUsedInSlice(producer))
+          continue;
+        if (succeeded(linalgx::utils::isContraction(producer)) &&
+            cols > maxEpilogueCols)
+          continue;
+        slice.insert(producer);
+        changed = true;
+      }
+    }
+  }
+
+  SmallVector<linalg::LinalgOp> ops;
+  for (Operation *op : slice)
+    ops.push_back(cast<linalg::LinalgOp>(op));
+  llvm::sort(ops, [](linalg::LinalgOp lhs, linalg::LinalgOp rhs) {
+    return lhs->isBeforeInBlock(rhs);
+  });
+  return ops;
+}
+
+// Return true if `linalgOp` divides `sum` by `count`, or multiplies it by the
+// inverse of `count`, element-wise.
+static bool isMeanOf(linalg::LinalgOp linalgOp, Value sum, int64_t count) {
+  if (!linalgOp || linalgOp.getNumDpsInputs() != 1 ||
+      linalgOp.getDpsInputs()[0] != sum ||
+      linalgOp.getNumParallelLoops() != linalgOp.getNumLoops())
+    return false;
+  Block *body = linalgOp.getBlock();
+  if (std::distance(body->begin(), body->end()) != 2)
+    return false;
+  Operation *innerOp = &body->front();
+  if (body->getTerminator()->getOperand(0) != innerOp->getResult(0))
+    return false;
+  Value in = body->getArgument(0);
+  APFloat cst(0.0);
+  if (auto divOp = dyn_cast<arith::DivFOp>(innerOp)) {
+    return divOp.getLhs() == in &&
+           matchPattern(divOp.getRhs(), m_ConstantFloat(&cst)) &&
+           cst.convertToDouble() == static_cast<double>(count);
+  }
+  if (auto mulOp = dyn_cast<arith::MulFOp>(innerOp)) {
+    Value other = mulOp.getLhs() == in ? mulOp.getRhs() : mulOp.getLhs();
+    return (mulOp.getLhs() == in || mulOp.getRhs() == in) &&
+           matchPattern(other, m_ConstantFloat(&cst)) &&
+           std::abs(cst.convertToDouble() * count - 1.0) < 1e-6;
+  }
+  return false;
+}
+
+// Match a normalization of the rows computed by `root`, an element-wise
+// operation on a 2d tensor. A layer normalization reduces the squares of its
+// input centered on the mean of the rows, an RMS normalization the squares
+// of its input.
+static FailureOr<Normalization> matchNormalization(linalg::LinalgOp root,
+                                                   int64_t maxEpilogueCols) {
+  if (!root.hasPureTensorSemantics() || root.hasDynamicShape() ||
+      root->getNumResults() != 1 || root.getNumLoops() != 2 ||
+      root.getNumParallelLoops() != 2 ||
+      !root.getMatchingIndexingMap(root.getDpsInitOperand(0)).isIdentity() ||
+      root->getParentOfType<scf::ForallOp>())
+    return failure();
+
+  Normalization norm;
+  norm.root = root;
+  norm.ops = collectRowSlice(root, maxEpilogueCols);
+  int64_t cols = root.getStaticLoopRanges()[1];
+  auto isInSlice = [&](Value value) {
+    auto producer = value.getDefiningOp<linalg::LinalgOp>();
+    return producer && llvm::is_contained(norm.ops, producer);
+  };
+
+  // The output of the loop is the init of the root, recreated if it is
+  // computed in the loop and is not read.
+  OpOperand *init = root.getDpsInitOperand(0);
+  if (isInSlice(init->get()) && root.payloadUsesValueFromOperand(init))
+    return failure();
+
+  bool isRMSNorm = false;
+  for (linalg::LinalgOp linalgOp : norm.ops) {
+    SmallVector<Value> operands;
+    if (structured_match::utils::isTwoDReduceSquareOp(linalgOp, &operands)) {
+      isRMSNorm |= mlir::utils::isZeroTensor(operands[1]);
+      continue;
+    }
+    if (!structured_match::utils::isTwoDReduceSquaredDiffOp(linalgOp,
+                                                            &operands) ||
+        !mlir::utils::isZeroTensor(operands[2]) || !isInSlice(operands[1]))
+      continue;
+
+    // The centered input is x - sum(x) / N.
+    auto meanOp = operands[1].getDefiningOp<linalg::LinalgOp>();
+    Value sum =
+        meanOp.getNumDpsInputs() == 1 ? meanOp.getDpsInputs()[0] : Value();
+    if (!sum || !isInSlice(sum) || !isMeanOf(meanOp, sum, cols))
+      continue;
+    auto sumOp = sum.getDefiningOp<linalg::LinalgOp>();
+    SmallVector<Value> sumOperands;
+    if (!structured_match::utils::isTwoDReduceAddOp(sumOp, &sumOperands) ||
+        sumOperands[0] != operands[0] ||
+        !mlir::utils::isZeroTensor(sumOperands[1]) ||
+        sumOp->getResult(0).getType() != linalgOp->getResult(0).getType())
+      continue;
+    norm.kind = NormKind::LayerNorm;
+    norm.sum = sumOp;
+    norm.variance = linalgOp;
+    return norm;
+  }
+  if (!isRMSNorm)
+    return failure();
+  norm.kind = NormKind::RMSNorm;
+  return norm;
+}
+
+static Value createZeroTensor(OpBuilder &builder, Location loc,
+                              RankedTensorType type) {
+  Value empty = builder.create<tensor::EmptyOp>(loc, type.getShape(),
+                                                type.getElementType());
+  Value zero = builder.create<arith::ConstantOp>(
+      loc, type.getElementType(), builder.getZeroAttr(type.getElementType()));
+  return builder.create<linalg::FillOp>(loc, zero, empty).getResult(0);
+}
+
+// Compute the statistics of the layer normalization `norm` in a single pass
+// over the input x, shifted by the first element k of its rows to not lose
+// the variance to cancellation:
+//
+// %s, %q = rowsum(x - k), rowsum((x - k)^2)
+// %sum = %s + N * k
+// %variance = %q - %s * %s / N
+//
+// The variance is the sum of the squares centered on the mean, %sum / N.
+static void computeStatisticsInOnePass(RewriterBase &rewriter,
+                                       const Normalization &norm) {
+  linalg::LinalgOp sumOp = norm.sum;
+  MLIRContext *ctx = sumOp.getContext();
+  Location loc = sumOp.getLoc();
+  Value input = sumOp.getDpsInputs()[0];
+  auto statsType = cast<RankedTensorType>(sumOp->getResult(0).getType());
+  Type elementType = statsType.getElementType();
+  AffineMap statsMap =
+      sumOp.getMatchingIndexingMap(sumOp.getDpsInitOperand(0));
+  int64_t cols = sumOp.getStaticLoopRanges()[1];
+
+  OpBuilder::InsertionGuard guard(rewriter);
+  rewriter.setInsertionPoint(sumOp);
+  AffineExpr d0, d1;
+  bindDims(ctx, d0, d1);
+  AffineExpr zero = getAffineConstantExpr(0, ctx);
+  AffineMap identity = AffineMap::get(2, /*symbolCount=*/0, {d0, d1}, ctx);
+  AffineMap firstMap = AffineMap::get(2, /*symbolCount=*/0, {d0, zero}, ctx);
+  Value zeros = createZeroTensor(rewriter, loc, statsType);
+  auto partialOp = rewriter.create<linalg::GenericOp>(
+      loc, TypeRange{statsType, statsType}, ValueRange{input, input},
+      ValueRange{zeros, zeros},
+      ArrayRef<AffineMap>{identity, firstMap, statsMap, statsMap},
+      sumOp.getIteratorTypesArray(),
+      [](OpBuilder &builder, Location loc, ValueRange args) {
+        Value diff = builder.create<arith::SubFOp>(loc, args[0], args[1]);
+        Value square = builder.create<arith::MulFOp>(loc, diff, diff);
+        Value sum = builder.create<arith::AddFOp>(loc, args[2], diff);
+        Value squares = builder.create<arith::AddFOp>(loc, args[3], square);
+        builder.create<linalg::YieldOp>(loc, ValueRange{sum, squares});
+      });
+
+  // Undo the shift, element-wise on the statistics.
+  unsigned rank = statsType.getRank();
+  AffineMap statsIdentity = rewriter.getMultiDimIdentityMap(rank);
+  AffineMap rowFirstMap = AffineMap::get(
+      rank, /*symbolCount=*/0, {getAffineDimExpr(0, ctx), zero}, ctx);
+  Value count = rewriter.create<arith::ConstantOp>(
+      loc, elementType, rewriter.getFloatAttr(elementType, cols));
+  Value sumInit = rewriter.create<tensor::EmptyOp>(loc, statsType.getShape(),
+                                                   elementType);
+  Value varianceInit = rewriter.create<tensor::EmptyOp>(
+      loc, statsType.getShape(), elementType);
+  auto statsOp = rewriter.create<linalg::GenericOp>(
+      loc, TypeRange{statsType, statsType},
+      ValueRange{partialOp.getResult(0), partialOp.getResult(1), input},
+      ValueRange{sumInit, varianceInit},
+      ArrayRef<AffineMap>{statsIdentity, statsIdentity, rowFirstMap,
+                          statsIdentity, statsIdentity},
+      SmallVector<utils::IteratorType>(rank, utils::IteratorType::parallel),
+      [&](OpBuilder &builder, Location loc, ValueRange args) {
+        Value shift = builder.create<arith::MulFOp>(loc, args[2], count);
+        Value sum = builder.create<arith::AddFOp>(loc, args[0], shift);
+        Value square = builder.create<arith::MulFOp>(loc, args[0], args[0]);
+        Value correction = builder.create<arith::DivFOp>(loc, square, count);
+        Value variance =
+            builder.create<arith::SubFOp>(loc, args[1], correction);
+        builder.create<linalg::YieldOp>(loc, ValueRange{sum, variance});
+      });
+
+  rewriter.replaceOp(norm.variance, statsOp.getResult(1));
+  rewriter.replaceOp(sumOp, statsOp.getResult(0));
+}
+
+// Fuse the operations `ops` of a normalization computing `root` into a loop
+// over the tiles of its rows:
+//
+// %out = forall (rows) {
+//   %x = %in[rows]
+//   %stats = rowreduce(%x)
+//   %out[rows] = normalize(%x, %stats)
+// }
+//
+// Each iteration computes its rows with the other operands as they are, they
+// are broadcast along the rows.
+static LogicalResult fuseNormalization(RewriterBase &rewriter,
+                                       ArrayRef<linalg::LinalgOp> ops,
+                                       int64_t rowTile) {
+  linalg::LinalgOp root = ops.back();
+  MLIRContext *ctx = root.getContext();
+  Location loc = root.getLoc();
+  int64_t rows = root.getStaticLoopRanges()[0];
+  if (rowTile <= 0 || rows <= rowTile || rows % rowTile != 0)
+    return failure();
+
+  OpBuilder::InsertionGuard guard(rewriter);
+  rewriter.setInsertionPoint(root);
+  Value init = root.getDpsInits()[0];
+  auto initType = cast<RankedTensorType>(init.getType());
+  auto initProducer = init.getDefiningOp<linalg::LinalgOp>();
+  if (initProducer && llvm::is_contained(ops, initProducer)) {
+    init = rewriter.create<tensor::EmptyOp>(loc, initType.getShape(),
+                                            initType.getElementType());
+  }
+  auto forallOp = rewriter.create<scf::ForallOp>(
+      loc, ArrayRef<OpFoldResult>{rewriter.getIndexAttr(rows / rowTile)},
+      ValueRange{init}, /*mapping=*/std::nullopt);
+  forallOp->setAttr(linalgx::utils::kFusedNormalization,
+                    rewriter.getUnitAttr());
+  rewriter.setInsertionPoint(forallOp.getTerminator());
+
+  AffineExpr d0;
+  bindDims(ctx, d0);
+  OpFoldResult offset = affine::makeComposedFoldedAffineApply(
+      rewriter, loc, d0 * rowTile, {forallOp.getInductionVars()[0]});
+  Value sharedOut = forallOp.getRegionIterArgs()[0];
+  auto getRowsShape = [&](ShapedType type) {
+    SmallVector<int64_t> shape(type.getShape());
+    shape[0] = rowTile;
+    return shape;
+  };
+  auto getRowsSlice = [&](Value source) -> Value {
+    auto type = cast<RankedTensorType>(source.getType());
+    SmallVector<OpFoldResult> offsets(type.getRank(), rewriter.getIndexAttr(0));
+    offsets[0] = offset;
+    SmallVector<OpFoldResult> sizes =
+        getAsIndexOpFoldResult(ctx, getRowsShape(type));
+    SmallVector<OpFoldResult> strides(type.getRank(),
+                                      rewriter.getIndexAttr(1));
+    return rewriter.create<tensor::ExtractSliceOp>(loc, source, offsets, sizes,
+                                                   strides);
+  };
+
+  // Clone the operations on the rows of the iteration. The rows of the
+  // output are read from the shared output, other iterations write others.
+  AffineExpr rowExpr = getAffineDimExpr(0, ctx);
+  IRMapping mapping;
+  DenseMap<Value, Value> rowSlices;
+  for (linalg::LinalgOp linalgOp : ops) {
+    SmallVector<Value> operands;
+    for (OpOperand &operand : linalgOp->getOpOperands()) {
+      Value value = operand.get();
+      AffineMap map = linalgOp.getMatchingIndexingMap(&operand);
+      if (Value mapped = mapping.lookupOrNull(value)) {
+        operands.push_back(mapped);
+        continue;
+      }
+      if (map.getNumResults() == 0 || map.getResult(0) != rowExpr) {
+        operands.push_back(value);
+        continue;
+      }
+      if (value != init && value.getDefiningOp<tensor::EmptyOp>()) {
+        auto type = cast<RankedTensorType>(value.getType());
+        operands.push_back(rewriter.create<tensor::EmptyOp>(
+            loc, getRowsShape(type), type.getElementType()));
+        continue;
+      }
+      Value &slice = rowSlices[value];
+      if (!slice)
+        slice = getRowsSlice(value == init ? sharedOut : value);
+      operands.push_back(slice);
+    }
+    SmallVector<Type> resultTypes;
+    for (OpOperand &operand : linalgOp.getDpsInitsMutable())
+      resultTypes.push_back(operands[operand.getOperandNumber()].getType());
+    Operation *tiledOp =
+        clone(rewriter, linalgOp.getOperation(), resultTypes, operands);
+    mapping.map(linalgOp->getResults(), tiledOp->getResults());
+  }
+
+  Value result = mapping.lookup(root->getResult(0));
+  SmallVector<OpFoldResult> offsets{offset, rewriter.getIndexAttr(0)};
+  SmallVector<OpFoldResult> sizes =
+      getAsIndexOpFoldResult(ctx, getRowsShape(initType));
+  SmallVector<OpFoldResult> strides(2, rewriter.getIndexAttr(1));
+  rewriter.setInsertionPointToStart(forallOp.getTerminator().getBody());
+  rewriter.create<tensor::ParallelInsertSliceOp>(loc, result, sharedOut,
+                                                 offsets, sizes, strides);
+
+  rewriter.replaceOp(root, forallOp.getResults());
+  for (linalg::LinalgOp linalgOp : llvm::reverse(ops.drop_back())) {
+    if (linalgOp->use_empty())
+      rewriter.eraseOp(linalgOp);
+  }
+  return success();
+}
+
+struct FuseNormalization
+    : public tpp::impl::FuseNormalizationBase<FuseNormalization> {
+  using FuseNormalizationBase::FuseNormalizationBase;
+
+  void runOnOperation() override {
+    SmallVector<linalg::LinalgOp> roots;
+    getOperation()->walk([&](linalg::LinalgOp linalgOp) {
+      if (linalgOp.getNumLoops() == 2 &&
+          linalgOp.getNumParallelLoops() == 2)
+        roots.push_back(linalgOp);
+    });
+
+    // Start from the last operations, an element-wise consumer of a
+    // normalization is fused with it. Skip the roots fused already.
+    IRRewriter rewriter(&getContext());
+    llvm::SmallDenseSet<Operation *> fusedOps;
+    for (linalg::LinalgOp root : llvm::reverse(roots)) {
+      if (fusedOps.contains(root))
+        continue;
+      auto norm = matchNormalization(root, epilogueMaxCols);
+      if (failed(norm))
+        continue;
+      SmallVector<linalg::LinalgOp> ops = norm->ops;
+      if (onePass && norm->kind == NormKind::LayerNorm) {
+        computeStatisticsInOnePass(rewriter, *norm);
+        ops = collectRowSlice(root, epilogueMaxCols);
+      }
+      SmallVector<Operation *> rootOps(ops.begin(), ops.end());
+      if (succeeded(fuseNormalization(rewriter, ops, rowTile)))
+        fusedOps.insert(rootOps.begin(), rootOps.end());
+    }
+  }
+};
+
+} // namespace
@@ -0,0 +1,343 @@
+//===- FuseRotaryEmbedding.cpp -----------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the fusion of the rotary position embedding of the
+// queries or keys of an attention into the contraction projecting them, over
+// blocks of rows, with its sines and cosines folded into constant tables.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/IR/MatcherUtils.h"
+#include "TPP/Passes.h"
+#include "TPP/Transforms/Utils/TransformUtils.h"
+#include "TPP/Transforms/Utils/ValueUtils.h"
+
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/Math/IR/Math.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Tensor/IR/Tensor.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/Dialect/Utils/StructuredOpsUtils.h"
+#include "mlir/IR/IRMapping.h"
+#include "mlir/IR/Matchers.h"
+#include "mlir/IR/PatternMatch.h"
+
+#include <cmath>
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_FUSEROTARYEMBEDDING
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+namespace {
+
+// The rotary embedding of the rows computed by a contraction, e.g., the
+// queries or keys projected from the hidden states.
+struct RotaryEmbedding {
+  // rows = h * W
+  linalg::LinalgOp projection;
+  // The rows viewed as pairs, their first dimension kept.
+  tensor::ExpandShapeOp pairs;
+  // The rotation of the pairs by their angles.
+  linalg::GenericOp rotation;
+};
+
+static bool isStaticContraction(linalg::LinalgOp linalgOp) {
+  return linalgOp && linalgOp.hasPureTensorSemantics() &&
+         linalgOp->getNumResults() == 1 && !linalgOp.hasDynamicShape() &&
+         llvm::all_of(linalgOp.getIndexingMapsArray(),
+                      [](AffineMap map) {
+                        return map.isProjectedPermutation();
+                      }) &&
+         succeeded(linalgx::utils::isContraction(linalgOp));
+}
+
+// Fold the sines and cosines `rotation` computes from constant angles into
+// constant tables, read as two inputs by a copy of it. Return the copy, or
+// `rotation` if its tables are already inputs or its angles not constant.
+static linalg::GenericOp foldTables(RewriterBase &rewriter,
+                                    linalg::GenericOp rotation) {
+  if (rotation.getNumDpsInputs() != 3)
+    return rotation;
+  DenseFPElementsAttr angles;
+  if (!matchPattern(rotation.getDpsInputs()[2], m_Constant(&angles)))
+    return rotation;
+  // The angles only feed the sines and cosines.
+  Block *body = rotation.getBody();
+  BlockArgument anglesArg = body->getArgument(2);
+  if (!llvm::all_of(anglesArg.getUsers(), [](Operation *user) {
+        return isa<math::CosOp, math::SinOp>(user);
+      }))
+    return rotation;
+
+  OpBuilder::InsertionGuard guard(rewriter);
+  rewriter.setInsertionPoint(rotation);
+  Location loc = rotation.getLoc();
+  auto floatType = cast<FloatType>(angles.getElementType());
+  auto getTable = [&](function_ref<double(double)> fn) -> Value {
+    DenseElementsAttr table =
+        angles.mapValues(floatType, [&](const APFloat &angle) {
+          APFloat value(fn(angle.convertToDouble()));
+          bool losesInfo;
+          value.convert(floatType.getFloatSemantics(),
+                        APFloat::rmNearestTiesToEven, &losesInfo);
+          return value.bitcastToAPInt();
+        });
+    return rewriter.create<arith::ConstantOp>(loc, table);
+  };
+  Value cos = getTable([](double angle) { return std::cos(angle); });
+  Value sin = getTable([](double angle) { return std::sin(angle); });
+
+  Value pairs = rotation.getDpsInputs()[0];
+  SmallVector<AffineMap> maps = rotation.getIndexingMapsArray();
+  maps.insert(maps.begin() + 3, maps[2]);
+  auto tableOp = rewriter.create<linalg::GenericOp>(
+      loc, rotation->getResultTypes(), ValueRange{pairs, pairs, cos, sin},
+      rotation.getDpsInits(), maps, rotation.getIteratorTypesArray(),
+      [&](OpBuilder &builder, Location loc, ValueRange args) {
+        IRMapping mapping;
+        mapping.map(body->getArgument(0), args[0]);
+        mapping.map(body->getArgument(1), args[1]);
+        mapping.map(body->getArgument(3), args[4]);
+        for (Operation &op : body->getOperations()) {
+          if (isa<math::CosOp>(op)) {
+            mapping.map(op.getResult(0), args[2]);
+            continue;
+          }
+          if (isa<math::SinOp>(op)) {
+            mapping.map(op.getResult(0), args[3]);
+            continue;
+          }
+          builder.clone(op, mapping);
+        }
+      });
+  Operation *anglesOp = rotation.getDpsInputs()[2].getDefiningOp();
+  rewriter.replaceOp(rotation, tableOp->getResults());
+  if (anglesOp->use_empty())
+    rewriter.eraseOp(anglesOp);
+  return tableOp;
+}
+
+// Match the rotary embedding `genericOp` of the rows of a contraction, viewed
+// as pairs by an expansion of their columns only, both of single use.
+static FailureOr<RotaryEmbedding> matchProjection(linalg::GenericOp genericOp) {
+  if (!genericOp.hasPureTensorSemantics() ||
+      genericOp->getParentOfType<scf::ForallOp>())
+    return failure();
+  Value pairs = genericOp.getDpsInputs()[0];
+  auto expandOp = pairs.getDefiningOp<tensor::ExpandShapeOp>();
+  if (!expandOp || expandOp->getBlock() != genericOp->getBlock() ||
+      !llvm::all_of(pairs.getUsers(),
+                    [&](Operation *user) { return user == genericOp; }))
+    return failure();
+  SmallVector<ReassociationIndices> reassociation =
+      expandOp.getReassociationIndices();
+  if (reassociation.size() != 2 || reassociation[0] != ReassociationIndices{0})
+    return failure();
+
+  Value rows = expandOp.getSrc();
+  auto projection = rows.getDefiningOp<linalg::LinalgOp>();
+  if (!rows.hasOneUse() || !isStaticContraction(projection) ||
+      projection->getBlock() != genericOp->getBlock() ||
+      projection.getMatchingIndexingMap(projection.getDpsInitOperand(0))
+              .getNumResults() != 2)
+    return failure();
+  return RotaryEmbedding{projection, expandOp, genericOp};
+}
+
+// Offsets and sizes of the loops of an operation.
+struct LoopSlice {
+  SmallVector<OpFoldResult> offsets;
+  SmallVector<int64_t> sizes;
+};
+
+static LoopSlice getFullSlice(OpBuilder &builder, linalg::LinalgOp linalgOp) {
+  LoopSlice slice;
+  slice.sizes = llvm::to_vector(linalgOp.getStaticLoopRanges());
+  slice.offsets.assign(slice.sizes.size(), builder.getIndexAttr(0));
+  return slice;
+}
+
+// Return the slice of `source` indexed by `map` on `slice`, `source` itself if
+// it is whole, e.g., the weights of the projection.
+static Value extractSlice(OpBuilder &builder, Location loc, Value source,
+                          AffineMap map, const LoopSlice &slice) {
+  auto type = cast<RankedTensorType>(source.getType());
+  SmallVector<OpFoldResult> offsets, sizes;
+  bool isWhole = true;
+  for (unsigned result : llvm::seq<unsigned>(0, map.getNumResults())) {
+    unsigned dim = map.getDimPosition(result);
+    offsets.push_back(slice.offsets[dim]);
+    sizes.push_back(builder.getIndexAttr(slice.sizes[dim]));
+    isWhole &= isConstantIntValue(slice.offsets[dim], 0) &&
+               slice.sizes[dim] == type.getDimSize(result);
+  }
+  if (isWhole)
+    return source;
+  SmallVector<OpFoldResult> strides(map.getNumResults(),
+                                    builder.getIndexAttr(1));
+  return builder.create<tensor::ExtractSliceOp>(loc, source, offsets, sizes,
+                                                strides);
+}
+
+// Clone `linalgOp` on `slice` of its loops. The operands already computed on
+// the slice are taken from `mapping`, the others are sliced; a zero or empty
+// init is created with the shape of the slice instead.
+static Value computeSlice(OpBuilder &builder, Location loc,
+                          linalg::LinalgOp linalgOp, const LoopSlice &slice,
+                          IRMapping &mapping) {
+  SmallVector<Value> operands;
+  for (OpOperand &operand : linalgOp->getOpOperands()) {
+    Value value = operand.get();
+    if (Value mapped = mapping.lookupOrNull(value)) {
+      operands.push_back(mapped);
+      continue;
+    }
+    AffineMap map = linalgOp.getMatchingIndexingMap(&operand);
+    bool isZero = utils::isZeroTensor(value);
+    if (linalgOp.isDpsInit(&operand) &&
+        (isZero || value.getDefiningOp<tensor::EmptyOp>())) {
+      SmallVector<int64_t> shape;
+      for (unsigned result : llvm::seq<unsigned>(0, map.getNumResults()))
+        shape.push_back(slice.sizes[map.getDimPosition(result)]);
+      Type elementType = getElementTypeOrSelf(value.getType());
+      Value init = builder.create<tensor::EmptyOp>(loc, shape, elementType);
+      if (isZero) {
+        Value zero = builder.create<arith::ConstantOp>(
+            loc, elementType, builder.getZeroAttr(elementType));
+        init = builder.create<linalg::FillOp>(loc, zero, init).getResult(0);
+      }
+      operands.push_back(init);
+      continue;
+    }
+    operands.push_back(extractSlice(builder, loc, value, map, slice));
+  }
+  Type resultType =
+      operands[linalgOp.getDpsInitOperand(0)->getOperandNumber()].getType();
+  Value result =
+      clone(builder, linalgOp.getOperation(), TypeRange{resultType}, operands)
+          ->getResult(0);
+  mapping.map(linalgOp->getResult(0), result);
+  return result;
+}
+
+// Fuse the rotation of `embedding` into an scf.forall over blocks of rows of
+// its projection, the largest dividing the rows up to `tileRows`:
+//
+// %out = forall (blocks) shared_outs(%init) {
+//   %rows = h[block] * W
+//   %init[block] = rotate(expand(%rows), cos[block], sin[block])
+// }
+//
+// The projection of a block is rotated while it is in cache, and never
+// written to memory before.
+static LogicalResult fuseRotaryEmbedding(RewriterBase &rewriter,
+                                         const RotaryEmbedding &embedding,
+                                         int64_t tileRows) {
+  linalg::GenericOp rotation = embedding.rotation;
+  linalg::LinalgOp projection = embedding.projection;
+  tensor::ExpandShapeOp expandOp = embedding.pairs;
+  MLIRContext *ctx = rotation.getContext();
+  Location loc = rotation.getLoc();
+  int64_t rows = rotation.getStaticLoopRanges()[0];
+  if (tileRows <= 0 || rows <= tileRows)
+    return failure();
+  int64_t blockRows = tileRows;
+  while (rows % blockRows != 0)
+    --blockRows;
+
+  OpBuilder::InsertionGuard guard(rewriter);
+  rewriter.setInsertionPoint(rotation);
+  auto forallOp = rewriter.create<scf::ForallOp>(
+      loc, ArrayRef<OpFoldResult>{rewriter.getIndexAttr(rows / blockRows)},
+      rotation.getDpsInits(), /*mapping=*/std::nullopt);
+  forallOp->setAttr(linalgx::utils::kFusedRotaryEmbedding,
+                    rewriter.getUnitAttr());
+  rewriter.setInsertionPoint(forallOp.getTerminator());
+
+  AffineExpr d0;
+  bindDims(ctx, d0);
+  Value block = forallOp.getInductionVars()[0];
+  OpFoldResult offset = affine::makeComposedFoldedAffineApply(
+      rewriter, loc, d0 * blockRows, {block});
+
+  // The rows of the block, viewed as pairs.
+  IRMapping mapping;
+  LoopSlice slice = getFullSlice(rewriter, projection);
+  unsigned rowLoop =
+      projection.getMatchingIndexingMap(projection.getDpsInitOperand(0))
+          .getDimPosition(0);
+  slice.offsets[rowLoop] = offset;
+  slice.sizes[rowLoop] = blockRows;
+  Value blockRowsValue =
+      computeSlice(rewriter, loc, projection, slice, mapping);
+  RankedTensorType pairsType = expandOp.getResultType();
+  SmallVector<int64_t> pairsShape(pairsType.getShape());
+  pairsShape[0] = blockRows;
+  Value pairs = rewriter.create<tensor::ExpandShapeOp>(
+      loc, RankedTensorType::get(pairsShape, pairsType.getElementType()),
+      blockRowsValue, expandOp.getReassociationIndices());
+  mapping.map(expandOp.getResult(), pairs);
+
+  // Rotate them into the block of the shared output, the first loop of the
+  // rotation runs along the rows.
+  LoopSlice rotationSlice = getFullSlice(rewriter, rotation);
+  rotationSlice.offsets[0] = offset;
+  rotationSlice.sizes[0] = blockRows;
+  Value out = forallOp.getRegionIterArgs()[0];
+  AffineMap outMap =
+      rotation.getMatchingIndexingMap(rotation.getDpsInitOperand(0));
+  mapping.map(rotation.getDpsInits()[0],
+              extractSlice(rewriter, loc, out, outMap, rotationSlice));
+  Value rotated = computeSlice(rewriter, loc, rotation, rotationSlice, mapping);
+
+  rewriter.setInsertionPointToStart(forallOp.getTerminator().getBody());
+  SmallVector<OpFoldResult> sizes;
+  for (int64_t size : rotationSlice.sizes)
+    sizes.push_back(rewriter.getIndexAttr(size));
+  SmallVector<OpFoldResult> strides(sizes.size(), rewriter.getIndexAttr(1));
+  rewriter.create<tensor::ParallelInsertSliceOp>(
+      loc, rotated, out, rotationSlice.offsets, sizes, strides);
+
+  rewriter.replaceOp(rotation, forallOp.getResults());
+  rewriter.eraseOp(expandOp);
+  rewriter.eraseOp(projection);
+  return success();
+}
+
+struct FuseRotaryEmbedding
+    : public tpp::impl::FuseRotaryEmbeddingBase<FuseRotaryEmbedding> {
+  using FuseRotaryEmbeddingBase::FuseRotaryEmbeddingBase;
+
+  void runOnOperation() override {
+    SmallVector<linalg::GenericOp> rotations;
+    getOperation()->walk([&](linalg::GenericOp genericOp) {
+      if (genericOp.hasPureTensorSemantics() &&
+          structured_match::utils::isRotaryEmbeddingOp(genericOp))
+        rotations.push_back(genericOp);
+    });
+
+    IRRewriter rewriter(&getContext());
+    for (linalg::GenericOp rotation : rotations) {
+      rotation = foldTables(rewriter, rotation);
+      auto embedding = matchProjection(rotation);
+      if (succeeded(embedding))
+        (void)fuseRotaryEmbedding(rewriter, *embedding, tileRows);
+    }
+  }
+};
+
+} // namespace
@@ -0,0 +1,471 @@
+//===- FuseTopK.cpp ----------------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the fusion of the argmax of the logits of a language
+// model head into the contraction computing them, over blocks of the
+// vocabulary, so that the logits are never materialized.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "TPP/Transforms/Utils/TransformUtils.h"
+#include "TPP/Transforms/Utils/ValueUtils.h"
+
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Arith/Utils/Utils.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Tensor/IR/Tensor.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/Dialect/Utils/StructuredOpsUtils.h"
+#include "mlir/IR/IRMapping.h"
+#include "mlir/IR/PatternMatch.h"
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_FUSETOPK
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+namespace {
+
+// The argmax of the rows of logits computed by a contraction, through
+// element-wise operations, e.g., a bias or a temperature.
+struct Argmax {
+  // logits = h * W
+  linalg::LinalgOp contraction;
+  // The element-wise operations from the contraction to the argmax, in order.
+  SmallVector<linalg::LinalgOp> epilogue;
+  // max, index = argmax(logits), along the columns.
+  linalg::GenericOp argmax;
+  // The column of the element in the payload of `argmax`.
+  Value column;
+};
+
+static bool isStaticContraction(linalg::LinalgOp linalgOp) {
+  return linalgOp && linalgOp.hasPureTensorSemantics() &&
+         linalgOp->getNumResults() == 1 && !linalgOp.hasDynamicShape() &&
+         llvm::all_of(linalgOp.getIndexingMapsArray(),
+                      [](AffineMap map) {
+                        return map.isProjectedPermutation();
+                      }) &&
+         succeeded(linalgx::utils::isContraction(linalgOp));
+}
+
+// Return true if `linalgOp` is an element-wise operation on a static 2d
+// tensor, its other operands broadcast along it.
+static bool isElementwise2D(linalg::LinalgOp linalgOp) {
+  return linalgOp && !isa<linalg::FillOp>(linalgOp) &&
+         linalgOp.hasPureTensorSemantics() && !linalgOp.hasDynamicShape() &&
+         linalgOp->getNumResults() == 1 && linalgOp.getNumLoops() == 2 &&
+         linalgOp.getNumParallelLoops() == 2 &&
+         linalgOp.getMatchingIndexingMap(linalgOp.getDpsInitOperand(0))
+             .isIdentity() &&
+         llvm::all_of(linalgOp.getIndexingMapsArray(), [](AffineMap map) {
+           return map.isProjectedPermutation();
+         });
+}
+
+// Return the column of the element in the payload of an argmax along the
+// columns, whose index is `linalg.index 1`, possibly cast.
+static Value getColumn(Value value) {
+  Operation *op = value.getDefiningOp();
+  if (isa_and_nonnull<arith::IndexCastOp, arith::IndexCastUIOp>(op)) {
+    if (!value.hasOneUse())
+      return nullptr;
+    value = op->getOperand(0);
+  }
+  auto indexOp = value.getDefiningOp<linalg::IndexOp>();
+  if (!indexOp || indexOp.getDim() != 1 || !value.hasOneUse())
+    return nullptr;
+  return op->getResult(0);
+}
+
+// Return true if `op` keeps the maximum of `in` and `out`, selected with the
+// comparison `cmp`.
+static bool isMaxOf(Operation *op, Value in, Value out, Value cmp) {
+  if (auto selectOp = dyn_cast_or_null<arith::SelectOp>(op)) {
+    return selectOp.getCondition() == cmp &&
+           selectOp.getTrueValue() == in && selectOp.getFalseValue() == out;
+  }
+  if (!isa_and_nonnull<arith::MaximumFOp, arith::MaxNumFOp>(op))
+    return false;
+  return (op->getOperand(0) == in && op->getOperand(1) == out) ||
+         (op->getOperand(0) == out && op->getOperand(1) == in);
+}
+
+// Match the argmax along the columns of a 2d float tensor:
+//
+// %max, %index = linalg.generic ins(%logits) outs(%maxInit, %indexInit) {
+//   %gt = arith.cmpf ogt, %in, %max
+//   %newMax = arith.select %gt, %in, %max
+//   %newIndex = arith.select %gt, (index_cast (linalg.index 1)), %index
+// }
+static bool isArgmax(linalg::GenericOp genericOp, Value &column) {
+  if (!genericOp.hasPureTensorSemantics() || genericOp.hasDynamicShape() ||
+      genericOp.getNumDpsInputs() != 1 || genericOp.getNumDpsInits() != 2 ||
+      genericOp.getNumLoops() != 2 ||
+      genericOp.getIteratorTypesArray()[0] != utils::IteratorType::parallel ||
+      genericOp.getIteratorTypesArray()[1] != utils::IteratorType::reduction ||
+      !isa<FloatType>(
+          getElementTypeOrSelf(genericOp.getDpsInputs()[0].getType())))
+    return false;
+  MLIRContext *ctx = genericOp.getContext();
+  AffineMap rowsMap =
+      AffineMap::get(2, /*symbolCount=*/0, getAffineDimExpr(0, ctx));
+  SmallVector<AffineMap> maps = genericOp.getIndexingMapsArray();
+  if (!maps[0].isIdentity() || maps[1] != rowsMap || maps[2] != rowsMap)
+    return false;
+
+  Block *body = genericOp.getBody();
+  if (std::distance(body->begin(), body->end()) > 6)
+    return false;
+  auto yieldOp = cast<linalg::YieldOp>(body->getTerminator());
+  Value in = body->getArgument(0);
+  Value max = body->getArgument(1);
+  Value index = body->getArgument(2);
+  auto indexSelect = yieldOp.getOperand(1).getDefiningOp<arith::SelectOp>();
+  if (!indexSelect || indexSelect.getFalseValue() != index)
+    return false;
+  auto cmpOp = indexSelect.getCondition().getDefiningOp<arith::CmpFOp>();
+  if (!cmpOp || cmpOp.getLhs() != in || cmpOp.getRhs() != max)
+    return false;
+  switch (cmpOp.getPredicate()) {
+  case arith::CmpFPredicate::OGT:
+  case arith::CmpFPredicate::OGE:
+  case arith::CmpFPredicate::UGT:
+  case arith::CmpFPredicate::UGE:
+    break;
+  default:
+    return false;
+  }
+  if (!isMaxOf(yieldOp.getOperand(0).getDefiningOp(), in, max,
+               cmpOp.getResult()))
+    return false;
+  column = getColumn(indexSelect.getTrueValue());
+  return column != nullptr;
+}
+
+// Match the argmax `genericOp` of the logits of a contraction, through
+// element-wise operations of single use.
+static FailureOr<Argmax> matchArgmax(linalg::GenericOp genericOp) {
+  Argmax argmax;
+  if (!isArgmax(genericOp, argmax.column) ||
+      genericOp->getParentOfType<scf::ForallOp>())
+    return failure();
+  argmax.argmax = genericOp;
+
+  Value logits = genericOp.getDpsInputs()[0];
+  while (logits.hasOneUse()) {
+    auto producer = logits.getDefiningOp<linalg::LinalgOp>();
+    if (!producer || producer->getBlock() != genericOp->getBlock())
+      return failure();
+    if (isStaticContraction(producer)) {
+      AffineMap outMap =
+          producer.getMatchingIndexingMap(producer.getDpsInitOperand(0));
+      if (outMap.getNumResults() != 2)
+        return failure();
+      argmax.contraction = producer;
+      std::reverse(argmax.epilogue.begin(), argmax.epilogue.end());
+      return argmax;
+    }
+    if (!isElementwise2D(producer))
+      return failure();
+
+    // The logits are the single operand of the same shape computed by a
+    // linalg operation, the others are broadcast or read as they are.
+    Value next;
+    for (OpOperand &operand : producer->getOpOperands()) {
+      Value value = operand.get();
+      auto valueProducer = value.getDefiningOp<linalg::LinalgOp>();
+      if (!valueProducer || isa<linalg::FillOp>(valueProducer) ||
+          !producer.getMatchingIndexingMap(&operand).isIdentity())
+        continue;
+      if (next)
+        return failure();
+      next = value;
+    }
+    if (!next)
+      return failure();
+    argmax.epilogue.push_back(producer);
+    logits = next;
+  }
+  return failure();
+}
+
+// Offsets and sizes of the loops of an operation.
+struct LoopSlice {
+  SmallVector<OpFoldResult> offsets;
+  SmallVector<int64_t> sizes;
+};
+
+static LoopSlice getFullSlice(OpBuilder &builder, linalg::LinalgOp linalgOp) {
+  LoopSlice slice;
+  slice.sizes = llvm::to_vector(linalgOp.getStaticLoopRanges());
+  slice.offsets.assign(slice.sizes.size(), builder.getIndexAttr(0));
+  return slice;
+}
+
+// Return the slice of `source` indexed by `map` on `slice`, `source` itself if
+// it is whole, e.g., the rows of the hidden states.
+static Value extractSlice(OpBuilder &builder, Location loc, Value source,
+                          AffineMap map, const LoopSlice &slice) {
+  auto type = cast<RankedTensorType>(source.getType());
+  SmallVector<OpFoldResult> offsets, sizes;
+  bool isWhole = true;
+  for (unsigned result : llvm::seq<unsigned>(0, map.getNumResults())) {
+    unsigned dim = map.getDimPosition(result);
+    offsets.push_back(slice.offsets[dim]);
+    sizes.push_back(builder.getIndexAttr(slice.sizes[dim]));
+    isWhole &= isConstantIntValue(slice.offsets[dim], 0) &&
+               slice.sizes[dim] == type.getDimSize(result);
+  }
+  if (isWhole)
+    return source;
+  SmallVector<OpFoldResult> strides(map.getNumResults(),
+                                    builder.getIndexAttr(1));
+  return builder.create<tensor::ExtractSliceOp>(loc, source, offsets, sizes,
+                                                strides);
+}
+
+// Clone `linalgOp` on `slice` of its loops. The operands already computed on
+// the slice are taken from `mapping`, the others are sliced; a zero or empty
+// init is created with the shape of the slice instead.
+static Value computeSlice(OpBuilder &builder, Location loc,
+                          linalg::LinalgOp linalgOp, const LoopSlice &slice,
+                          IRMapping &mapping) {
+  SmallVector<Value> operands;
+  for (OpOperand &operand : linalgOp->getOpOperands()) {
+    Value value = operand.get();
+    if (Value mapped = mapping.lookupOrNull(value)) {
+      operands.push_back(mapped);
+      continue;
+    }
+    AffineMap map = linalgOp.getMatchingIndexingMap(&operand);
+    bool isZero = utils::isZeroTensor(value);
+    if (linalgOp.isDpsInit(&operand) &&
+        (isZero || value.getDefiningOp<tensor::EmptyOp>())) {
+      SmallVector<int64_t> shape;
+      for (unsigned result : llvm::seq<unsigned>(0, map.getNumResults()))
+        shape.push_back(slice.sizes[map.getDimPosition(result)]);
+      Type elementType = getElementTypeOrSelf(value.getType());
+      Value init = builder.create<tensor::EmptyOp>(loc, shape, elementType);
+      if (isZero) {
+        Value zero = builder.create<arith::ConstantOp>(
+            loc, elementType, builder.getZeroAttr(elementType));
+        init = builder.create<linalg::FillOp>(loc, zero, init).getResult(0);
+      }
+      operands.push_back(init);
+      continue;
+    }
+    operands.push_back(extractSlice(builder, loc, value, map, slice));
+  }
+  Type resultType =
+      operands[linalgOp.getDpsInitOperand(0)->getOperandNumber()].getType();
+  Value result =
+      clone(builder, linalgOp.getOperation(), TypeRange{resultType}, operands)
+          ->getResult(0);
+  mapping.map(linalgOp->getResult(0), result);
+  return result;
+}
+
+// Compute the argmax of the columns [offset, offset + size) of the logits,
+// from the contraction on. Return the maxima of the rows and the indices of
+// the columns, in the whole logits.
+static std::pair<Value, Value> computeBlock(OpBuilder &builder, Location loc,
+                                            const Argmax &argmax,
+                                            OpFoldResult offset,
+                                            int64_t size) {
+  IRMapping mapping;
+  linalg::LinalgOp contraction = argmax.contraction;
+  LoopSlice slice = getFullSlice(builder, contraction);
+  unsigned colLoop =
+      contraction.getMatchingIndexingMap(contraction.getDpsInitOperand(0))
+          .getDimPosition(1);
+  slice.offsets[colLoop] = offset;
+  slice.sizes[colLoop] = size;
+  Value logits = computeSlice(builder, loc, contraction, slice, mapping);
+
+  for (linalg::LinalgOp linalgOp : argmax.epilogue) {
+    LoopSlice opSlice = getFullSlice(builder, linalgOp);
+    opSlice.offsets[1] = offset;
+    opSlice.sizes[1] = size;
+    logits = computeSlice(builder, loc, linalgOp, opSlice, mapping);
+  }
+
+  // The argmax of the block starts from the inits of the argmax, which hold
+  // the rows only.
+  linalg::GenericOp argmaxOp = argmax.argmax;
+  SmallVector<Value> operands{logits};
+  operands.append(argmaxOp.getDpsInits().begin(),
+                  argmaxOp.getDpsInits().end());
+  Operation *blockOp =
+      clone(builder, argmaxOp.getOperation(), argmaxOp->getResultTypes(),
+            operands);
+
+  // Shift the indices of the columns of the block by its offset.
+  Value indices = blockOp->getResult(1);
+  auto indicesType = cast<RankedTensorType>(indices.getType());
+  Type indexType = indicesType.getElementType();
+  Value shift = getValueOrCreateConstantIndexOp(builder, loc, offset);
+  if (!indexType.isIndex())
+    shift = builder.create<arith::IndexCastOp>(loc, indexType, shift);
+  Value empty = builder.create<tensor::EmptyOp>(loc, indicesType.getShape(),
+                                                indexType);
+  AffineMap identity = builder.getMultiDimIdentityMap(1);
+  indices = builder
+                .create<linalg::GenericOp>(
+                    loc, indicesType, ValueRange{indices}, ValueRange{empty},
+                    ArrayRef<AffineMap>{identity, identity},
+                    utils::IteratorType::parallel,
+                    [&](OpBuilder &builder, Location loc, ValueRange args) {
+                      Value sum =
+                          builder.create<arith::AddIOp>(loc, args[0], shift);
+                      builder.create<linalg::YieldOp>(loc, sum);
+                    })
+                .getResult(0);
+  return {blockOp->getResult(0), indices};
+}
+
+// Fuse `argmax` into an scf.forall over blocks of `vocabBlock` columns of
+// the logits, each computing its columns and their argmax:
+//
+// %maxParts, %indexParts = forall (blocks) {
+//   %logits = h * W[block]
+//   %maxParts[block], %indexParts[block] = argmax(epilogue(%logits))
+// }
+// %max, %index = argmax over the blocks(%maxParts, %indexParts)
+//
+// A last block smaller than the others is computed after the forall. The
+// blocks are combined in order with the comparison of the argmax, which keeps
+// the same column among equal maxima.
+static LogicalResult fuseArgmax(RewriterBase &rewriter, const Argmax &argmax,
+                                int64_t vocabBlock) {
+  linalg::GenericOp argmaxOp = argmax.argmax;
+  MLIRContext *ctx = argmaxOp.getContext();
+  Location loc = argmaxOp.getLoc();
+  int64_t cols = argmaxOp.getStaticLoopRanges()[1];
+  if (vocabBlock <= 0 || cols <= vocabBlock)
+    return failure();
+  int64_t numBlocks = cols / vocabBlock;
+  int64_t remainder = cols % vocabBlock;
+  int64_t numParts = numBlocks + (remainder != 0 ? 1 : 0);
+
+  OpBuilder::InsertionGuard guard(rewriter);
+  rewriter.setInsertionPoint(argmaxOp);
+  SmallVector<Value> sharedOuts;
+  for (Value init : argmaxOp.getDpsInits()) {
+    auto type = cast<RankedTensorType>(init.getType());
+    sharedOuts.push_back(rewriter.create<tensor::EmptyOp>(
+        loc, ArrayRef<int64_t>{numParts, type.getDimSize(0)},
+        type.getElementType()));
+  }
+  auto forallOp = rewriter.create<scf::ForallOp>(
+      loc, ArrayRef<OpFoldResult>{rewriter.getIndexAttr(numBlocks)},
+      sharedOuts, /*mapping=*/std::nullopt);
+  forallOp->setAttr(linalgx::utils::kFusedTopK, rewriter.getUnitAttr());
+  rewriter.setInsertionPoint(forallOp.getTerminator());
+
+  AffineExpr d0;
+  bindDims(ctx, d0);
+  Value block = forallOp.getInductionVars()[0];
+  OpFoldResult offset = affine::makeComposedFoldedAffineApply(
+      rewriter, loc, d0 * vocabBlock, {block});
+  auto [maxPart, indexPart] =
+      computeBlock(rewriter, loc, argmax, offset, vocabBlock);
+
+  // Insert the maxima and the indices of the rows as a row of the parts.
+  auto getPartSlice = [&](OpFoldResult part, Value source) {
+    auto type = cast<RankedTensorType>(source.getType());
+    SmallVector<OpFoldResult> offsets{part, rewriter.getIndexAttr(0)};
+    SmallVector<OpFoldResult> sizes{rewriter.getIndexAttr(1),
+                                    rewriter.getIndexAttr(type.getDimSize(0))};
+    SmallVector<OpFoldResult> strides(2, rewriter.getIndexAttr(1));
+    return std::make_tuple(offsets, sizes, strides);
+  };
+  rewriter.setInsertionPointToStart(forallOp.getTerminator().getBody());
+  SmallVector<Value> blockParts{maxPart, indexPart};
+  for (auto [source, dest] :
+       llvm::zip(blockParts, forallOp.getRegionIterArgs())) {
+    auto [offsets, sizes, strides] = getPartSlice(block, source);
+    rewriter.create<tensor::ParallelInsertSliceOp>(loc, source, dest, offsets,
+                                                   sizes, strides);
+  }
+
+  rewriter.setInsertionPointAfter(forallOp);
+  SmallVector<Value> parts(forallOp.getResults());
+  if (remainder != 0) {
+    auto [maxLast, indexLast] =
+        computeBlock(rewriter, loc, argmax,
+                     rewriter.getIndexAttr(numBlocks * vocabBlock), remainder);
+    SmallVector<Value> lastParts{maxLast, indexLast};
+    for (unsigned idx : llvm::seq<unsigned>(0, parts.size())) {
+      auto [offsets, sizes, strides] =
+          getPartSlice(rewriter.getIndexAttr(numBlocks), lastParts[idx]);
+      parts[idx] = rewriter.create<tensor::InsertSliceOp>(
+          loc, lastParts[idx], parts[idx], offsets, sizes, strides);
+    }
+  }
+
+  // Combine the parts with the payload of the argmax, the index of a part
+  // taking the place of the column.
+  AffineMap partsMap =
+      AffineMap::get(2, /*symbolCount=*/0,
+                     {getAffineDimExpr(1, ctx), getAffineDimExpr(0, ctx)}, ctx);
+  AffineMap rowsMap =
+      AffineMap::get(2, /*symbolCount=*/0, getAffineDimExpr(0, ctx));
+  Block *body = argmaxOp.getBody();
+  auto combineOp = rewriter.create<linalg::GenericOp>(
+      loc, argmaxOp->getResultTypes(), parts, argmaxOp.getDpsInits(),
+      ArrayRef<AffineMap>{partsMap, partsMap, rowsMap, rowsMap},
+      argmaxOp.getIteratorTypesArray(),
+      [&](OpBuilder &builder, Location loc, ValueRange args) {
+        IRMapping mapping;
+        mapping.map(body->getArgument(0), args[0]);
+        mapping.map(argmax.column, args[1]);
+        mapping.map(body->getArgument(1), args[2]);
+        mapping.map(body->getArgument(2), args[3]);
+        for (Operation &op : body->getOperations()) {
+          if (isa<linalg::IndexOp>(op) ||
+              llvm::is_contained(op.getResults(), argmax.column))
+            continue;
+          builder.clone(op, mapping);
+        }
+      });
+
+  rewriter.replaceOp(argmaxOp, combineOp->getResults());
+  for (linalg::LinalgOp linalgOp : llvm::reverse(argmax.epilogue))
+    rewriter.eraseOp(linalgOp);
+  rewriter.eraseOp(argmax.contraction);
+  return success();
+}
+
+struct FuseTopK : public tpp::impl::FuseTopKBase<FuseTopK> {
+  using FuseTopKBase::FuseTopKBase;
+
+  void runOnOperation() override {
+    SmallVector<Argmax> argmaxes;
+    getOperation()->walk([&](linalg::GenericOp genericOp) {
+      auto argmax = matchArgmax(genericOp);
+      if (succeeded(argmax))
+        argmaxes.push_back(*argmax);
+    });
+
+    IRRewriter rewriter(&getContext());
+    for (const Argmax &argmax : argmaxes)
+      (void)fuseArgmax(rewriter, argmax, vocabBlock);
+  }
+};
+
+} // namespace
@@ -0,0 +1,418 @@
+//===- GroupExpertMatmuls.cpp ------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the grouping of the matmuls of the experts of a
+// mixture-of-experts layer, each on its own runtime number of tokens, into a
+// single parallel loop over tiles of all the experts.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "TPP/Transforms/Utils/TransformUtils.h"
+
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Tensor/IR/Tensor.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/IR/PatternMatch.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "llvm/Support/Debug.h"
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_GROUPEXPERTMATMULS
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+#define DEBUG_TYPE "group-expert-matmuls"
+
+namespace {
+
+// The loop over the experts of a mixture-of-experts layer, each multiplying
+// its rows of the tokens by its weights into the same rows of the output:
+//
+// scf.for %e = 0 to E iter_args(%out = %init) {
+//   %rows = offsets[%e + 1] - offsets[%e]
+//   %x = tokens[offsets[%e], 0] [%rows, K]
+//   %w = weights[%e, 0, 0] [1, K, N]
+//   %y = linalg.matmul ins(%x, %w) outs(fill(%value))
+//   scf.yield insert %y into %out[offsets[%e], 0] [%rows, N]
+// }
+struct ExpertMatmuls {
+  scf::ForOp loop;
+  // Tokens of all the experts, T x K.
+  Value tokens;
+  // Weights of the experts, E x K x N.
+  Value weights;
+  // First row of each expert, and the end of the last one, E + 1.
+  Value offsets;
+  // Value the output tiles are filled with.
+  Value fillValue;
+  int64_t numExperts;
+};
+
+} // namespace
+
+// Returns `value`, an index cast from an integer.
+static Value skipIndexCast(Value value) {
+  if (auto castOp = value.getDefiningOp<arith::IndexCastOp>())
+    return castOp.getIn();
+  if (auto castOp = value.getDefiningOp<arith::IndexCastUIOp>())
+    return castOp.getIn();
+  return value;
+}
+
+// Returns the tensor `value` is read from at `iv` + `shift`, null if it is
+// not such a read.
+static Value getOffsetsRead(Value value, Value iv, int64_t shift) {
+  auto extractOp = skipIndexCast(value).getDefiningOp<tensor::ExtractOp>();
+  if (!extractOp || extractOp.getIndices().size() != 1)
+    return nullptr;
+  Value index = extractOp.getIndices()[0];
+  if (shift != 0) {
+    auto addOp = index.getDefiningOp<arith::AddIOp>();
+    if (!addOp)
+      return nullptr;
+    Value other = addOp.getLhs() == iv   ? addOp.getRhs()
+                  : addOp.getRhs() == iv ? addOp.getLhs()
+                                         : nullptr;
+    if (!other || getConstantIntValue(other) != shift)
+      return nullptr;
+  } else if (index != iv) {
+    return nullptr;
+  }
+  return extractOp.getTensor();
+}
+
+// Returns true if `sliceOp` is a unit-stride slice of a value defined out of
+// `loop`, at `offsets` and of `sizes`, matched by value or constant.
+static bool isLoopInvariantSlice(tensor::ExtractSliceOp sliceOp,
+                                 scf::ForOp loop,
+                                 ArrayRef<OpFoldResult> offsets,
+                                 ArrayRef<OpFoldResult> sizes) {
+  if (!loop.isDefinedOutsideOfLoop(sliceOp.getSource()) ||
+      !sliceOp.hasUnitStride())
+    return false;
+  auto isEqual = [](OpFoldResult lhs, OpFoldResult rhs) {
+    return lhs == rhs || (getConstantIntValue(lhs) &&
+                          getConstantIntValue(lhs) == getConstantIntValue(rhs));
+  };
+  return llvm::equal(sliceOp.getMixedOffsets(), offsets, isEqual) &&
+         llvm::equal(sliceOp.getMixedSizes(), sizes, isEqual);
+}
+
+static FailureOr<ExpertMatmuls> matchExpertMatmuls(scf::ForOp loop) {
+  std::optional<int64_t> lb = getConstantIntValue(loop.getLowerBound());
+  std::optional<int64_t> ub = getConstantIntValue(loop.getUpperBound());
+  std::optional<int64_t> step = getConstantIntValue(loop.getStep());
+  if (!lb || *lb != 0 || !ub || *ub <= 0 || !step || *step != 1 ||
+      loop.getNumRegionIterArgs() != 1)
+    return failure();
+  Value iv = loop.getInductionVar();
+  Value out = loop.getRegionIterArgs()[0];
+  auto outType = dyn_cast<RankedTensorType>(out.getType());
+  if (!outType || outType.getRank() != 2 || !outType.hasStaticShape())
+    return failure();
+
+  // The body only computes the slice of the output, there is nothing left
+  // once it is grouped.
+  if (!llvm::all_of(loop.getBody()->without_terminator(),
+                    [](Operation &op) { return isMemoryEffectFree(&op); }))
+    return failure();
+
+  auto yieldOp = cast<scf::YieldOp>(loop.getBody()->getTerminator());
+  auto insertOp = yieldOp.getOperand(0).getDefiningOp<tensor::InsertSliceOp>();
+  if (!insertOp || insertOp.getDest() != out || !insertOp.hasUnitStride())
+    return failure();
+  auto matmulOp = insertOp.getSource().getDefiningOp<linalg::MatmulOp>();
+  if (!matmulOp || !matmulOp.hasPureTensorSemantics())
+    return failure();
+
+  // The rows of the expert, from the offsets.
+  SmallVector<OpFoldResult> outOffsets = insertOp.getMixedOffsets();
+  SmallVector<OpFoldResult> outSizes = insertOp.getMixedSizes();
+  int64_t cols = outType.getDimSize(1);
+  auto start = dyn_cast<Value>(outOffsets[0]);
+  auto rows = dyn_cast<Value>(outSizes[0]);
+  if (!start || !rows || getConstantIntValue(outOffsets[1]) != 0 ||
+      getConstantIntValue(outSizes[1]) != cols)
+    return failure();
+  auto subOp = rows.getDefiningOp<arith::SubIOp>();
+  if (!subOp || subOp.getRhs() != start)
+    return failure();
+  Value offsets = getOffsetsRead(start, iv, 0);
+  if (!offsets || getOffsetsRead(subOp.getLhs(), iv, 1) != offsets ||
+      !loop.isDefinedOutsideOfLoop(offsets))
+    return failure();
+  auto offsetsType = cast<RankedTensorType>(offsets.getType());
+  if (!offsetsType.hasStaticShape() || offsetsType.getDimSize(0) != *ub + 1)
+    return failure();
+
+  // The tokens of the expert, and its weights.
+  auto tokensSlice =
+      matmulOp.getDpsInputs()[0].getDefiningOp<tensor::ExtractSliceOp>();
+  auto weightsSlice =
+      matmulOp.getDpsInputs()[1].getDefiningOp<tensor::ExtractSliceOp>();
+  if (!tokensSlice || !weightsSlice)
+    return failure();
+  Value tokens = tokensSlice.getSource();
+  Value weights = weightsSlice.getSource();
+  auto tokensType = cast<RankedTensorType>(tokens.getType());
+  auto weightsType = cast<RankedTensorType>(weights.getType());
+  if (tokensType.getRank() != 2 || !tokensType.hasStaticShape() ||
+      weightsType.getRank() != 3 || !weightsType.hasStaticShape() ||
+      weightsType.getDimSize(0) != *ub ||
+      weightsType.getDimSize(2) != cols ||
+      tokensType.getDimSize(0) != outType.getDimSize(0))
+    return failure();
+  int64_t depth = tokensType.getDimSize(1);
+  OpBuilder builder(loop);
+  auto cst = [&](int64_t value) -> OpFoldResult {
+    return builder.getIndexAttr(value);
+  };
+  if (weightsType.getDimSize(1) != depth ||
+      !isLoopInvariantSlice(tokensSlice, loop, {start, cst(0)},
+                            {rows, cst(depth)}) ||
+      !isLoopInvariantSlice(weightsSlice, loop, {iv, cst(0), cst(0)},
+                            {cst(1), cst(depth), cst(cols)}))
+    return failure();
+
+  // The output of the expert starts from a constant, any previous content is
+  // overwritten.
+  auto fillOp = matmulOp.getDpsInits()[0].getDefiningOp<linalg::FillOp>();
+  if (!fillOp || !fillOp.hasPureTensorSemantics() ||
+      !loop.isDefinedOutsideOfLoop(fillOp.getInputs()[0]))
+    return failure();
+
+  return ExpertMatmuls{loop, tokens, weights, offsets, fillOp.getInputs()[0],
+                       *ub};
+}
+
+// Group the matmuls of `experts` into a single scf.forall over tiles of
+// `tileM` rows of an expert and `tileN` columns of the output:
+//
+// %tileStarts = first tile of each expert, exclusive prefix sum of
+//               ceildiv(rows, tileM)
+// scf.forall (%tile, %col) in (ceildiv(T, tileM) + E, N / tileN) {
+//   %e = expert of %tile, from %tileStarts
+//   %rows = rows of the expert in %tile, at most tileM, 0 past the last tile
+//   %y = tokens[rows] * weights[%e][cols], padded to tileM rows if partial
+//   out[rows, cols] = %y[0:%rows]
+// }
+//
+// The work items are tiles of the same size from any expert, the threads get
+// the same share of them whatever the number of tokens of each expert. All
+// the experts share the layout of their weights and the tile kernel.
+static void groupExpertMatmuls(RewriterBase &rewriter,
+                               const ExpertMatmuls &experts, int64_t tileM,
+                               int64_t tileN) {
+  scf::ForOp loop = experts.loop;
+  Location loc = loop.getLoc();
+  MLIRContext *ctx = loop.getContext();
+  auto outType = cast<RankedTensorType>(loop.getResult(0).getType());
+  auto tokensType = cast<RankedTensorType>(experts.tokens.getType());
+  auto weightsType = cast<RankedTensorType>(experts.weights.getType());
+  int64_t numTokens = tokensType.getDimSize(0);
+  int64_t depth = tokensType.getDimSize(1);
+  int64_t cols = outType.getDimSize(1);
+  int64_t numExperts = experts.numExperts;
+  if (tileN <= 0 || cols % tileN != 0)
+    tileN = cols;
+  // Each expert starts a new tile, at most one more partial tile each.
+  int64_t maxRowTiles = llvm::divideCeil(numTokens, tileM) + numExperts;
+
+  OpBuilder::InsertionGuard guard(rewriter);
+  rewriter.setInsertionPoint(loop);
+  auto cst = [&](int64_t value) -> Value {
+    return rewriter.create<arith::ConstantIndexOp>(loc, value);
+  };
+  auto readOffset = [&](OpBuilder &builder, Value expert) -> Value {
+    Value offset =
+        builder.create<tensor::ExtractOp>(loc, experts.offsets, expert);
+    if (!offset.getType().isIndex())
+      offset = builder.create<arith::IndexCastOp>(loc, builder.getIndexType(),
+                                                  offset);
+    return offset;
+  };
+
+  // First tile of each expert, and the number of tiles.
+  Value zero = cst(0);
+  Value one = cst(1);
+  Value tileRows = cst(tileM);
+  Value tileStarts = rewriter.create<tensor::EmptyOp>(
+      loc, ArrayRef<int64_t>{numExperts + 1}, rewriter.getIndexType());
+  tileStarts = rewriter.create<tensor::InsertOp>(loc, zero, tileStarts, zero);
+  auto prefixLoop = rewriter.create<scf::ForOp>(
+      loc, zero, cst(numExperts), one, ValueRange{tileStarts, zero},
+      [&](OpBuilder &builder, Location loc, Value expert, ValueRange args) {
+        Value next = builder.create<arith::AddIOp>(loc, expert, one);
+        Value rows = builder.create<arith::SubIOp>(
+            loc, readOffset(builder, next), readOffset(builder, expert));
+        rows = builder.create<arith::MaxSIOp>(loc, rows, zero);
+        Value tiles = builder.create<arith::CeilDivSIOp>(loc, rows, tileRows);
+        Value sum = builder.create<arith::AddIOp>(loc, args[1], tiles);
+        Value starts =
+            builder.create<tensor::InsertOp>(loc, sum, args[0], next);
+        builder.create<scf::YieldOp>(loc, ValueRange{starts, sum});
+      });
+  tileStarts = prefixLoop.getResult(0);
+  Value numTiles = prefixLoop.getResult(1);
+
+  auto forallOp = rewriter.create<scf::ForallOp>(
+      loc,
+      ArrayRef<OpFoldResult>{rewriter.getIndexAttr(maxRowTiles),
+                             rewriter.getIndexAttr(cols / tileN)},
+      ValueRange{loop.getInitArgs()[0]}, /*mapping=*/std::nullopt);
+  forallOp->setAttr(linalgx::utils::kGroupedExperts, rewriter.getUnitAttr());
+  rewriter.setInsertionPoint(forallOp.getTerminator());
+  Value tile = forallOp.getInductionVars()[0];
+  Value col = forallOp.getInductionVars()[1];
+
+  // The expert of the tile is the last one starting at or before it, the
+  // experts without tokens start at the same tile as the next one.
+  auto expertLoop = rewriter.create<scf::ForOp>(
+      loc, one, cst(numExperts), one, ValueRange{zero},
+      [&](OpBuilder &builder, Location loc, Value expert, ValueRange args) {
+        Value start =
+            builder.create<tensor::ExtractOp>(loc, tileStarts, expert);
+        Value started = builder.create<arith::CmpIOp>(
+            loc, arith::CmpIPredicate::ule, start, tile);
+        Value count = builder.create<arith::AddIOp>(
+            loc, args[0],
+            builder.create<arith::SelectOp>(loc, started, one, zero));
+        builder.create<scf::YieldOp>(loc, count);
+      });
+  Value expert = expertLoop.getResult(0);
+
+  // Rows of the tile, none for the tiles past the last one.
+  Value firstTile = rewriter.create<tensor::ExtractOp>(loc, tileStarts, expert);
+  Value expertStart = readOffset(rewriter, expert);
+  Value expertEnd =
+      readOffset(rewriter, rewriter.create<arith::AddIOp>(loc, expert, one));
+  Value rowStart = rewriter.create<arith::AddIOp>(
+      loc, expertStart,
+      rewriter.create<arith::MulIOp>(
+          loc, rewriter.create<arith::SubIOp>(loc, tile, firstTile),
+          tileRows));
+  Value rows = rewriter.create<arith::MinSIOp>(
+      loc, tileRows, rewriter.create<arith::SubIOp>(loc, expertEnd, rowStart));
+  Value active = rewriter.create<arith::CmpIOp>(
+      loc, arith::CmpIPredicate::ult, tile, numTiles);
+  rowStart = rewriter.create<arith::SelectOp>(loc, active, rowStart, zero);
+  rows = rewriter.create<arith::SelectOp>(loc, active, rows, zero);
+
+  AffineExpr d0;
+  bindDims(ctx, d0);
+  OpFoldResult colStart = affine::makeComposedFoldedAffineApply(
+      rewriter, loc, d0 * tileN, {col});
+  auto panelType =
+      RankedTensorType::get({depth, tileN}, weightsType.getElementType());
+  Value panel = rewriter.create<tensor::ExtractSliceOp>(
+      loc, panelType, experts.weights,
+      ArrayRef<OpFoldResult>{expert, rewriter.getIndexAttr(0), colStart},
+      ArrayRef<OpFoldResult>{rewriter.getIndexAttr(1),
+                             rewriter.getIndexAttr(depth),
+                             rewriter.getIndexAttr(tileN)},
+      SmallVector<OpFoldResult>(3, rewriter.getIndexAttr(1)));
+
+  // The tile kernel has a static shape, a partial tile is padded.
+  auto resultType =
+      RankedTensorType::get({tileM, tileN}, outType.getElementType());
+  auto lhsType =
+      RankedTensorType::get({tileM, depth}, tokensType.getElementType());
+  SmallVector<OpFoldResult> unitStrides(2, rewriter.getIndexAttr(1));
+  auto computeTile = [&](OpBuilder &builder, Location loc, Value lhs) {
+    Value empty = builder.create<tensor::EmptyOp>(
+        loc, resultType.getShape(), resultType.getElementType());
+    Value acc = builder.create<linalg::FillOp>(loc, experts.fillValue, empty)
+                    .getResult(0);
+    Value result = builder
+                       .create<linalg::MatmulOp>(loc, resultType,
+                                                 ValueRange{lhs, panel},
+                                                 ValueRange{acc})
+                       .getResult(0);
+    builder.create<scf::YieldOp>(loc, result);
+  };
+  Value full = rewriter.create<arith::CmpIOp>(loc, arith::CmpIPredicate::eq,
+                                              rows, tileRows);
+  auto ifOp = rewriter.create<scf::IfOp>(
+      loc, full,
+      [&](OpBuilder &builder, Location loc) {
+        Value lhs = builder.create<tensor::ExtractSliceOp>(
+            loc, lhsType, experts.tokens,
+            ArrayRef<OpFoldResult>{rowStart, builder.getIndexAttr(0)},
+            ArrayRef<OpFoldResult>{builder.getIndexAttr(tileM),
+                                   builder.getIndexAttr(depth)},
+            unitStrides);
+        computeTile(builder, loc, lhs);
+      },
+      [&](OpBuilder &builder, Location loc) {
+        Value lhs = builder.create<tensor::ExtractSliceOp>(
+            loc, experts.tokens,
+            ArrayRef<OpFoldResult>{rowStart, builder.getIndexAttr(0)},
+            ArrayRef<OpFoldResult>{rows, builder.getIndexAttr(depth)},
+            unitStrides);
+        Value padding = builder.create<arith::ConstantOp>(
+            loc, builder.getZeroAttr(tokensType.getElementType()));
+        Value missing = builder.create<arith::SubIOp>(loc, tileRows, rows);
+        lhs = builder.create<tensor::PadOp>(
+            loc, lhsType, lhs,
+            SmallVector<OpFoldResult>(2, builder.getIndexAttr(0)),
+            ArrayRef<OpFoldResult>{missing, builder.getIndexAttr(0)},
+            padding);
+        computeTile(builder, loc, lhs);
+      });
+  Value result = rewriter.create<tensor::ExtractSliceOp>(
+      loc, ifOp.getResult(0),
+      SmallVector<OpFoldResult>(2, rewriter.getIndexAttr(0)),
+      ArrayRef<OpFoldResult>{rows, rewriter.getIndexAttr(tileN)},
+      unitStrides);
+
+  rewriter.setInsertionPointToStart(forallOp.getTerminator().getBody());
+  rewriter.create<tensor::ParallelInsertSliceOp>(
+      loc, result, forallOp.getRegionIterArgs()[0],
+      ArrayRef<OpFoldResult>{rowStart, colStart},
+      ArrayRef<OpFoldResult>{rows, rewriter.getIndexAttr(tileN)},
+      unitStrides);
+
+  rewriter.replaceOp(loop, forallOp.getResults());
+}
+
+namespace {
+
+struct GroupExpertMatmuls
+    : public tpp::impl::GroupExpertMatmulsBase<GroupExpertMatmuls> {
+  using GroupExpertMatmulsBase::GroupExpertMatmulsBase;
+
+  void runOnOperation() override {
+    if (tileM <= 0)
+      return;
+    SmallVector<ExpertMatmuls> groups;
+    getOperation()->walk([&](scf::ForOp loop) {
+      auto experts = matchExpertMatmuls(loop);
+      if (succeeded(experts))
+        groups.push_back(*experts);
+    });
+
+    IRRewriter rewriter(&getContext());
+    for (const ExpertMatmuls &experts : groups) {
+      LLVM_DEBUG(llvm::dbgs() << "Grouping the matmuls of "
+                              << experts.numExperts << " experts\n");
+      groupExpertMatmuls(rewriter, experts, tileM, tileN);
+    }
+  }
+};
+
+} // namespace
@@ -0,0 +1,163 @@
+//===- GroupXsmmInvokes.cpp --------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements grouping of the brgemm invokes of an inner loop into a
+// single grouped invoke.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Dialect/Xsmm/XsmmOps.h"
+#include "TPP/Passes.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/IR/PatternMatch.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "llvm/Support/Debug.h"
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_GROUPXSMMINVOKES
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+using namespace mlir;
+
+#define DEBUG_TYPE "group-xsmm-invokes"
+
+namespace {
+
+// Walks back the views of `value` until a buffer defined outside of `loop`.
+// Only views that keep the aligned pointer of their source are looked
+// through, so that offsets of the view are offsets into the base buffer.
+static FailureOr<Value> getLoopInvariantBase(scf::ForOp loop, Value value) {
+  while (!loop.isDefinedOutsideOfLoop(value)) {
+    Operation *viewOp = value.getDefiningOp();
+    if (!isa_and_nonnull<memref::SubViewOp, memref::ExpandShapeOp,
+                         memref::CollapseShapeOp>(viewOp)) {
+      return failure();
+    }
+    value = viewOp->getOperand(0);
+  }
+  return value;
+}
+
+// Returns the number of iterations of `loop` if it has constant bounds.
+static std::optional<int64_t> getConstantTripCount(scf::ForOp loop) {
+  std::optional<int64_t> lb = getConstantIntValue(loop.getLowerBound());
+  std::optional<int64_t> ub = getConstantIntValue(loop.getUpperBound());
+  std::optional<int64_t> step = getConstantIntValue(loop.getStep());
+  if (!lb || !ub || !step || *step <= 0 || *ub <= *lb)
+    return std::nullopt;
+  return llvm::divideCeil(*ub - *lb, *step);
+}
+
+// Returns the brgemm of `loop` if the loop only computes the operands of a
+// single brgemm with a loop invariant kernel.
+static xsmm::BrgemmOp getGroupableBrgemm(scf::ForOp loop) {
+  if (loop.getNumRegionIterArgs() != 0)
+    return nullptr;
+
+  xsmm::BrgemmOp brgemmOp;
+  for (Operation &op : loop.getBody()->without_terminator()) {
+    if (auto invokeOp = dyn_cast<xsmm::BrgemmOp>(op)) {
+      if (brgemmOp)
+        return nullptr;
+      brgemmOp = invokeOp;
+      continue;
+    }
+    // Any other side effect would be reordered with the brgemms.
+    if (op.getNumRegions() != 0 || !isMemoryEffectFree(&op))
+      return nullptr;
+  }
+  if (!brgemmOp || brgemmOp.hasPrefetch())
+    return nullptr;
+
+  auto dispatchOp =
+      brgemmOp.getDispatch().getDefiningOp<xsmm::BrgemmDispatchOp>();
+  if (!dispatchOp || !loop.isDefinedOutsideOfLoop(dispatchOp) ||
+      !loop.isDefinedOutsideOfLoop(brgemmOp.getBatch())) {
+    return nullptr;
+  }
+  return brgemmOp;
+}
+
+static void groupBrgemms(RewriterBase &rewriter, scf::ForOp loop,
+                         xsmm::BrgemmOp brgemmOp, ArrayRef<Value> bases,
+                         int64_t numGroups) {
+  Location loc = brgemmOp.getLoc();
+
+  // Allocate the descriptors at the start of the closest allocation scope,
+  // every execution of the loop overwrites all of them.
+  Operation *scope =
+      loop->getParentWithTrait<OpTrait::AutomaticAllocationScope>();
+  rewriter.setInsertionPointToStart(&scope->getRegion(0).front());
+  auto descriptorsType = MemRefType::get({numGroups, 3}, rewriter.getI64Type());
+  Value descriptors = rewriter.create<memref::AllocaOp>(loc, descriptorsType);
+
+  // Record the offsets of the tiles of this iteration in place of the brgemm.
+  rewriter.setInsertionPoint(brgemmOp);
+  Value group = rewriter.create<arith::SubIOp>(loc, loop.getInductionVar(),
+                                               loop.getLowerBound());
+  group = rewriter.create<arith::DivUIOp>(loc, group, loop.getStep());
+  Value tiles[] = {brgemmOp.getOperandA(), brgemmOp.getOperandB(),
+                   brgemmOp.getOutput()};
+  for (auto [idx, tile] : llvm::enumerate(tiles)) {
+    auto metadata =
+        rewriter.create<memref::ExtractStridedMetadataOp>(loc, tile);
+    Value offset = rewriter.create<arith::IndexCastOp>(
+        loc, rewriter.getI64Type(), metadata.getOffset());
+    Value column = rewriter.create<arith::ConstantIndexOp>(loc, idx);
+    rewriter.create<memref::StoreOp>(loc, offset, descriptors,
+                                     ValueRange{group, column});
+  }
+
+  rewriter.setInsertionPointAfter(loop);
+  rewriter.create<xsmm::BrgemmGroupedOp>(
+      loc, brgemmOp.getDataTypeAttr(), brgemmOp.getDispatch(), bases[0],
+      bases[1], bases[2], descriptors, brgemmOp.getBatch());
+  rewriter.eraseOp(brgemmOp);
+}
+
+struct GroupXsmmInvokes
+    : public tpp::impl::GroupXsmmInvokesBase<GroupXsmmInvokes> {
+  void runOnOperation() override {
+    SmallVector<std::pair<scf::ForOp, xsmm::BrgemmOp>> candidates;
+    getOperation()->walk([&](scf::ForOp loop) {
+      if (xsmm::BrgemmOp brgemmOp = getGroupableBrgemm(loop))
+        candidates.emplace_back(loop, brgemmOp);
+    });
+
+    IRRewriter rewriter(&getContext());
+    for (auto [loop, brgemmOp] : candidates) {
+      std::optional<int64_t> numGroups = getConstantTripCount(loop);
+      if (!numGroups || *numGroups < 2)
+        continue;
+
+      SmallVector<Value> bases;
+      for (Value tile : {brgemmOp.getOperandA(), brgemmOp.getOperandB(),
+                         brgemmOp.getOutput()}) {
+        FailureOr<Value> base = getLoopInvariantBase(loop, tile);
+        if (failed(base))
+          break;
+        bases.push_back(*base);
+      }
+      if (bases.size() != 3) {
+        LLVM_DEBUG(llvm::dbgs() << "[GroupXsmmInvokes] Tiles are not views of "
+                                   "loop invariant buffers\n");
+        continue;
+      }
+      groupBrgemms(rewriter, loop, brgemmOp, bases, *numGroups);
+    }
+  }
+};
+
+} // namespace
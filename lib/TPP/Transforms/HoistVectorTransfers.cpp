@@ -7,18 +7,24 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// This file implements tile configuration hoisting on parallel loops.
+// This file implements the hoisting of the accumulators of vector
+// contractions out of their reduction loops.
 //
 //===----------------------------------------------------------------------===//
+#include "TPP/Transforms/Utils/TransformUtils.h"
+#include "TPP/Transforms/Utils/ValueUtils.h"
 #include "mlir/Dialect/Arith/IR/Arith.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/Linalg/Transforms/Transforms.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/Dialect/Vector/IR/VectorOps.h"
 #include "mlir/Dialect/Vector/Transforms/LoweringPatterns.h"
 #include "mlir/Dialect/Vector/Transforms/VectorRewritePatterns.h"
 #include "mlir/IR/BuiltinAttributes.h"
-#include "mlir/IR/IRMapping.h"
+#include "mlir/Interfaces/LoopLikeInterface.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 namespace mlir {
@@ -31,210 +37,234 @@ namespace tpp {
 namespace mlir {
 namespace tpp {
 
-static FailureOr<SmallVector<vector::TransferReadOp>>
-getContractOperands(vector::ContractionOp contractOp) {
-  SmallVector<vector::TransferReadOp> list;
-  for (int i = 0; i < 3; i++) {
-    auto vectorReadOp =
-        contractOp.getOperand(i).getDefiningOp<vector::TransferReadOp>();
-    if (!vectorReadOp)
-      return failure();
-    list.push_back(vectorReadOp);
-  }
-  return list;
-}
-
-static FailureOr<SmallVector<memref::SubViewOp>>
-getReadOperands(SmallVector<vector::TransferReadOp> readOps) {
-  SmallVector<memref::SubViewOp> list;
-  for (vector::TransferReadOp readOp : readOps) {
-    auto subViewOp = readOp.getOperand(0).getDefiningOp<memref::SubViewOp>();
-    if (!subViewOp)
-      return failure();
-    list.push_back(subViewOp);
-  }
-  return list;
+// Returns true if `writeOp` writes back to the location read by `readOp`.
+static bool isSameTransfer(vector::TransferReadOp readOp,
+                           vector::TransferWriteOp writeOp) {
+  return readOp.getSource() == writeOp.getSource() &&
+         readOp.getIndices() == writeOp.getIndices() &&
+         readOp.getPermutationMap() == writeOp.getPermutationMap() &&
+         readOp.getVectorType() == writeOp.getVectorType() &&
+         !readOp.getMask() && !writeOp.getMask();
 }
 
-static FailureOr<SmallVector<scf::ForOp>>
-getNestedLoop(vector::ContractionOp contractOp) {
-  SmallVector<scf::ForOp> list;
-  Operation *current = contractOp;
-  for (int i = 0; i < 4; i++) {
-    Operation *parent = current->getParentOfType<scf::ForOp>();
-    if (!parent)
-      return failure();
-    list.push_back(dyn_cast<scf::ForOp>(parent));
-    current = parent;
-  }
-  return list;
-}
-
-static LogicalResult checkNestedLoop(SmallVector<scf::ForOp> loops,
-                                     SmallVector<memref::SubViewOp> subviews) {
-  auto subviewOpLhsOffsets = subviews[0].getOffsets();
-  auto subviewOpRhsOffsets = subviews[1].getOffsets();
-  auto subviewOpAccOffsets = subviews[2].getOffsets();
-
-  Value ivK = loops[0].getInductionVar();
-  if (ivK != subviewOpLhsOffsets[2] || ivK != subviewOpRhsOffsets[1])
-    return failure();
-
-  Value ivReduction = loops[1].getInductionVar();
-  if (ivReduction != subviewOpLhsOffsets[0] ||
-      ivReduction != subviewOpRhsOffsets[0])
-    return failure();
-
-  Value ivN = loops[2].getInductionVar();
-  if (ivN != subviewOpAccOffsets[1] || ivN != subviewOpRhsOffsets[2])
-    return failure();
-
-  Value ivM = loops[3].getInductionVar();
-  if (ivM != subviewOpLhsOffsets[1] || ivM != subviewOpAccOffsets[0])
-    return failure();
-
-  return success();
+// Returns true if the accumulator accesses `readOp` and `writeOp` are
+// invariant in `forOp`, and are the only accesses of their buffer there.
+static bool isInvariantAccumulator(scf::ForOp forOp,
+                                   vector::TransferReadOp readOp,
+                                   vector::TransferWriteOp writeOp) {
+  if (!llvm::all_of(readOp->getOperands(), [&](Value operand) {
+        return forOp.isDefinedOutsideOfLoop(operand);
+      }))
+    return false;
+  return llvm::all_of(readOp.getSource().getUsers(), [&](Operation *user) {
+    return user == readOp || user == writeOp ||
+           !forOp->isProperAncestor(user);
+  });
 }
 
+// Keeps the accumulator of a vector contraction in registers across its
+// reduction loops: the transfer_read of the accumulator is hoisted before the
+// loops, the accumulator is carried by their iter_args and the
+// transfer_write is sunk after them. The reduction loops are the scf.for
+// around the contraction in which the accumulator is invariant, e.g. the
+// batch-reduce and K loops of a tiled brgemm.
+//
+// The contraction may accumulate in a wider type than its buffer, e.g. a bf16
+// output through arith.extf and arith.truncf, in which case the conversions
+// move out of the loops too. Several contractions may share the loops, each
+// one adds its own iter_arg. An epilogue reading the accumulator right after
+// the loops, e.g. a fused bias or activation, uses the final value directly.
 struct HoistVectorTransferOp : OpRewritePattern<vector::ContractionOp> {
   using OpRewritePattern<vector::ContractionOp>::OpRewritePattern;
 
   LogicalResult matchAndRewrite(vector::ContractionOp contractOp,
                                 PatternRewriter &rewriter) const override {
-
-    // Check the vector contract operation satisfies the required pattern.
-    // Check the Acc, Lhs, and Rhs of contract operation
-
-    auto operands = getContractOperands(contractOp);
-    if (failed(operands))
-      return rewriter.notifyMatchFailure(contractOp,
-                                         "Invalid operands for contract op");
-
-    auto readOps = *operands;
-    auto vectorReadOpAcc = readOps[2];
-    auto vectorReadOpLhs = readOps[0];
-    auto vectorReadOpRhs = readOps[1];
-
-    // Check whether the operand of vector transfer read is a subview
-    auto subviews = getReadOperands(readOps);
-    if (failed(subviews))
-      return rewriter.notifyMatchFailure(
-          contractOp, "Vector read op operands are not a subview");
-
-    // Check the operation type MatMul, B-MatMul, or BR-MatMul
-    SmallVector<vector::IteratorType> contractIteratorTypes =
-        contractOp.getIteratorTypesArray();
-    int reductionCount =
-        std::count(contractIteratorTypes.begin(), contractIteratorTypes.end(),
-                   vector::IteratorType::reduction);
-
-    auto vectorReadOpLhsType = cast<ShapedType>(vectorReadOpLhs.getType());
-    auto vectorReadOpRhsRank =
-        (cast<ShapedType>(vectorReadOpRhs.getType())).getRank();
-
-    if (reductionCount == 2 &&
-        (vectorReadOpLhsType.getRank() != 3 || vectorReadOpRhsRank != 3))
-      return rewriter.notifyMatchFailure(
-          contractOp, "Invalid rank for batch reduce operation");
-
-    if (reductionCount == 1)
-      return rewriter.notifyMatchFailure(
-          contractOp, "Batch matmul operation not supported yet");
-
-    if (reductionCount > 2)
+    auto innerForOp = dyn_cast<scf::ForOp>(contractOp->getParentOp());
+    if (!innerForOp)
+      return rewriter.notifyMatchFailure(contractOp, "Not in a scf.for");
+
+    // Match read -> [extf] -> contract -> [truncf] -> write.
+    Value acc = contractOp.getAcc();
+    auto extOp = acc.getDefiningOp<arith::ExtFOp>();
+    if (extOp)
+      acc = extOp.getIn();
+    auto readOp = acc.getDefiningOp<vector::TransferReadOp>();
+    Value result = contractOp.getResult();
+    if (!result.hasOneUse())
+      return rewriter.notifyMatchFailure(contractOp, "Expect a single use");
+    Operation *user = *result.getUsers().begin();
+    auto truncOp = dyn_cast<arith::TruncFOp>(user);
+    if (truncOp) {
+      if (!truncOp->hasOneUse())
+        return rewriter.notifyMatchFailure(contractOp, "Expect a single use");
+      user = *truncOp->getUsers().begin();
+    }
+    auto writeOp = dyn_cast<vector::TransferWriteOp>(user);
+    if (!readOp || !writeOp || writeOp->getNumResults() != 0 ||
+        !isSameTransfer(readOp, writeOp) ||
+        static_cast<bool>(extOp) != static_cast<bool>(truncOp))
       return rewriter.notifyMatchFailure(
-          contractOp, "The vector contract operation is not a gemm");
-
-    // Check the K-dim to be 1
-    int64_t K =
-        vectorReadOpLhsType.getDimSize(vectorReadOpLhsType.getRank() - 1);
-    if (K != 1)
-      return rewriter.notifyMatchFailure(contractOp, "K dim is not 1");
-
-    // Check whether the linalg tiling + vector contract pattern matches for the
-    // 4-nested loop structure
-    auto loops = getNestedLoop(contractOp);
-    if (failed(loops))
+          contractOp, "Accumulator is not read and written back");
+    if (!readOp->hasOneUse() || (extOp && !extOp->hasOneUse()))
+      return rewriter.notifyMatchFailure(contractOp,
+                                         "Accumulator read has other uses");
+    Block *body = innerForOp.getBody();
+    if (readOp->getBlock() != body || writeOp->getBlock() != body ||
+        (extOp && extOp->getBlock() != body) ||
+        (truncOp && truncOp->getBlock() != body))
       return rewriter.notifyMatchFailure(
-          contractOp, "Invalid loop nest in contract pattern");
-
-    auto checkLoops = checkNestedLoop(*loops, *subviews);
-    if (failed(checkLoops))
+          contractOp, "Accumulator accesses not in the loop body");
+
+    // Collect the reduction loops, innermost first.
+    SmallVector<scf::ForOp> loops;
+    scf::ForOp forOp = innerForOp;
+    while (forOp && isInvariantAccumulator(forOp, readOp, writeOp)) {
+      loops.push_back(forOp);
+      forOp = dyn_cast<scf::ForOp>(forOp->getParentOp());
+    }
+    if (loops.empty())
       return rewriter.notifyMatchFailure(
-          contractOp, "Loops doesn't match the iv in subviews");
-
-    auto nestedLoops = *loops;
-    auto kForOp = nestedLoops[0];
-    auto reductionForOp = nestedLoops[1];
-
-    // Move the vector transfer read before the reduction and k loop
-    rewriter.setInsertionPoint(reductionForOp);
-    auto *cloneVectorReadOp = rewriter.clone(*vectorReadOpAcc);
-
-    // Code to re-create the reduction and k loop with iter args
-    auto vectorReadOpValue = cloneVectorReadOp->getResult(0);
-    auto newReductionForOp = rewriter.create<scf::ForOp>(
-        reductionForOp.getLoc(), reductionForOp.getLowerBound(),
-        reductionForOp.getUpperBound(), reductionForOp.getStep(),
-        ValueRange{vectorReadOpValue},
-        [&](OpBuilder &rewriterNewReductionForOp, Location locNewReductionForOp,
-            Value ivNewReductionForOp, ValueRange iterArgsNewReductionForOp) {
-          auto newKForOp = rewriter.create<scf::ForOp>(
-              kForOp.getLoc(), kForOp.getLowerBound(), kForOp.getUpperBound(),
-              kForOp.getStep(), iterArgsNewReductionForOp,
-              [&](OpBuilder &rewriterNewKForOp, Location locNewKForOp,
-                  Value ivNewKForOp, ValueRange iterArgsNewKForOp) {
-                IRMapping mapper;
-                mapper.map(reductionForOp.getInductionVar(),
-                           ivNewReductionForOp);
-                mapper.map(kForOp.getInductionVar(), ivNewKForOp);
-
-                for (auto &op : kForOp.getBody()->without_terminator()) {
-                  rewriterNewKForOp.clone(op, mapper);
-                }
-                rewriterNewKForOp.create<scf::YieldOp>(locNewKForOp,
-                                                       iterArgsNewKForOp);
-              });
-          rewriterNewReductionForOp.create<scf::YieldOp>(
-              locNewReductionForOp, newKForOp.getResult(0));
-        });
-
-    // Code to hoist vector transfer write after reduction loop and also to
-    // update the yield of k loop
-    auto newKForOp =
-        llvm::dyn_cast<scf::ForOp>(newReductionForOp.getBody()->front());
-    Value newcontractOpValue;
-    vector::TransferWriteOp vectorWriteOperation;
-    Block *bodyBlock = newKForOp.getBody();
-    for (auto &op : bodyBlock->getOperations()) {
-      if (auto vectorContractOp = llvm::dyn_cast<vector::ContractionOp>(op)) {
-        vectorContractOp.setOperand(vectorContractOp.getNumOperands() - 1,
-                                    newKForOp.getRegionIterArgs()[0]);
-        newcontractOpValue = vectorContractOp.getResult();
-      }
-      if (auto yieldOp = llvm::dyn_cast<scf::YieldOp>(op)) {
-        yieldOp.setOperand(0, newcontractOpValue);
-      }
-      if (auto vectorWriteOp = llvm::dyn_cast<vector::TransferWriteOp>(op)) {
-        vectorWriteOperation = vectorWriteOp;
-      }
+          contractOp, "Accumulator is not invariant in the loops");
+
+    // Hoist the read, and the conversion, before the outermost loop.
+    scf::ForOp outerForOp = loops.back();
+    rewriter.moveOpBefore(readOp, outerForOp);
+    Value init = readOp.getResult();
+    if (extOp) {
+      rewriter.moveOpBefore(extOp, outerForOp);
+      init = extOp.getResult();
     }
 
-    vectorWriteOperation.setOperand(0, newReductionForOp.getResult(0));
-    vectorWriteOperation->moveBefore(reductionForOp);
-
-    // Erase the old vector contract operation
-    for (auto result : contractOp->getResults()) {
-      for (auto *userOp : result.getUsers()) {
-        userOp->erase();
+    // Carry the accumulator through the loops. The uses of `init` in each
+    // loop, the contraction then the init of the nested loop, are replaced
+    // by the new iter_arg.
+    Value yielded = result;
+    for (scf::ForOp loop : loops) {
+      FailureOr<LoopLikeOpInterface> newLoop =
+          cast<LoopLikeOpInterface>(loop.getOperation())
+              .replaceWithAdditionalYields(
+                  rewriter, init, /*replaceInitOperandUsesInLoop=*/true,
+                  [&](OpBuilder &, Location, ArrayRef<BlockArgument>) {
+                    return SmallVector<Value>{yielded};
+                  });
+      if (failed(newLoop))
+        return failure();
+      yielded = newLoop->getOperation()->getResults().back();
+    }
+    Operation *newOuterForOp = yielded.getDefiningOp();
+
+    // Write the final value back after the loops.
+    Value finalValue = yielded;
+    if (truncOp) {
+      rewriter.moveOpAfter(truncOp, newOuterForOp);
+      rewriter.modifyOpInPlace(
+          truncOp, [&]() { truncOp.getInMutable().assign(yielded); });
+      finalValue = truncOp.getResult();
+    }
+    rewriter.moveOpAfter(writeOp, finalValue.getDefiningOp());
+    rewriter.modifyOpInPlace(
+        writeOp, [&]() { writeOp.getVectorMutable().assign(finalValue); });
+
+    // Forward the final value to the reads of the epilogue, up to the next
+    // op that may write to memory.
+    SmallVector<vector::TransferReadOp> epilogueReads;
+    for (Operation *op = writeOp->getNextNode(); op; op = op->getNextNode()) {
+      if (auto epilogueRead = dyn_cast<vector::TransferReadOp>(op)) {
+        if (isSameTransfer(epilogueRead, writeOp))
+          epilogueReads.push_back(epilogueRead);
+        continue;
       }
+      if (op->getNumRegions() != 0 || !isa<MemoryEffectOpInterface>(op) ||
+          hasEffect<MemoryEffects::Write>(op))
+        break;
     }
-    contractOp.erase();
-
+    for (vector::TransferReadOp epilogueRead : epilogueReads)
+      rewriter.replaceOp(epilogueRead, finalValue);
     return success();
   }
 };
 
+// Returns true if `op` accesses the whole of its statically shaped buffer.
+static bool isFullTransfer(VectorTransferOpInterface op) {
+  auto sourceType = dyn_cast<MemRefType>(op.getSource().getType());
+  return sourceType && sourceType.hasStaticShape() && !op.getMask() &&
+         op.getPermutationMap().isMinorIdentity() &&
+         sourceType.getShape() == op.getVectorType().getShape() &&
+         llvm::all_of(op.getIndices(),
+                      [](Value index) { return isZeroIndex(index); });
+}
+
+// Returns the first op from `begin` in its block that is, or contains, a user
+// of `value`.
+static Operation *getNextAccess(Value value, Operation *begin) {
+  for (Operation *op = begin; op; op = op->getNextNode()) {
+    if (llvm::any_of(value.getUsers(),
+                     [&](Operation *user) { return op->isAncestor(user); }))
+      return op;
+  }
+  return nullptr;
+}
+
+// Folds the zero initialization of a buffer into the accumulators of the
+// contractions computing it, once they are hoisted, for example:
+//
+//   vector.transfer_write %zero, %dest
+//   scf.for %i {
+//     %tile = memref.subview %dest[%i, 0]
+//     %acc = vector.transfer_read %tile
+//     ... reduction loops ...
+//     vector.transfer_write %res, %tile
+//   }
+//
+// starts the accumulators from a zero constant and drops the write of %zero,
+// the buffer is not traversed just to zero it. The loops, if any, take each
+// element of the buffer in exactly one tile.
+static void foldZeroInit(RewriterBase &rewriter,
+                         vector::TransferWriteOp zeroOp) {
+  Value dest = zeroOp.getSource();
+  if (zeroOp->getNumResults() != 0 || !isFullTransfer(zeroOp) ||
+      !utils::isZeroTensor(zeroOp.getVector()))
+    return;
+  Operation *next = getNextAccess(dest, zeroOp->getNextNode());
+  if (!next)
+    return;
+
+  // The accumulator is either `dest` or a tile of it taken by a loop nest.
+  Value acc = dest;
+  Operation *begin = next;
+  if (next->getNumRegions() != 0) {
+    memref::SubViewOp tile;
+    for (Operation *user : dest.getUsers()) {
+      if (!next->isProperAncestor(user))
+        continue;
+      auto subview = dyn_cast<memref::SubViewOp>(user);
+      if (tile || !subview)
+        return;
+      tile = subview;
+    }
+    if (!tile || !linalgx::utils::isCoveredByTiles(dest, tile, next))
+      return;
+    acc = tile.getResult();
+    begin = tile->getNextNode();
+  }
+
+  // The accumulator is read whole, then written back, before any other access.
+  auto readOp =
+      dyn_cast_or_null<vector::TransferReadOp>(getNextAccess(acc, begin));
+  if (!readOp || readOp.getSource() != acc || !isFullTransfer(readOp))
+    return;
+  auto writeOp = dyn_cast_or_null<vector::TransferWriteOp>(
+      getNextAccess(acc, readOp->getNextNode()));
+  if (!writeOp || writeOp->getNumResults() != 0 ||
+      !isSameTransfer(readOp, writeOp))
+    return;
+
+  rewriter.setInsertionPoint(readOp);
+  rewriter.replaceOpWithNewOp<arith::ConstantOp>(
+      readOp, cast<TypedAttr>(rewriter.getZeroAttr(readOp.getVectorType())));
+  rewriter.eraseOp(zeroOp);
+}
+
 void populateHoistVectorTransferPatterns(RewritePatternSet &patterns) {
   patterns.add<HoistVectorTransferOp>(patterns.getContext());
 }
@@ -250,6 +280,14 @@ struct HoistVectorTransfers
     config.strictMode = GreedyRewriteStrictness::ExistingOps;
     (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns),
                                        config);
+
+    // The accumulators are now read before their reduction loops.
+    SmallVector<vector::TransferWriteOp> writeOps;
+    getOperation()->walk(
+        [&](vector::TransferWriteOp writeOp) { writeOps.push_back(writeOp); });
+    IRRewriter rewriter(&getContext());
+    for (vector::TransferWriteOp writeOp : writeOps)
+      foldZeroInit(rewriter, writeOp);
   }
 };
 } // namespace tpp
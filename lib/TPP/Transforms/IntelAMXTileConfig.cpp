@@ -29,6 +29,14 @@ using namespace mlir;
 namespace mlir {
 namespace tpp {
 
+static bool hasDynamicInputs(xsmm::BrgemmDispatchOp dispatchOp) {
+  return dispatchOp.hasDynamicInputs();
+}
+
+static bool hasDynamicInputs(xsmm::FusedBrgemmDispatchOp dispatchOp) {
+  return false;
+}
+
 template <typename InvokeOpTy, typename DispatchOpTy>
 struct IntelAMXTileConfig : OpRewritePattern<InvokeOpTy> {
   using OpRewritePattern<InvokeOpTy>::OpRewritePattern;
@@ -38,6 +46,10 @@ struct IntelAMXTileConfig : OpRewritePattern<InvokeOpTy> {
     if (xsmm::utils::getDataType(rewriter, op.getOperand(1).getType()) !=
         xsmm::DataTypeAttr::get(rewriter.getContext(), xsmm::DataType::BF16))
       return failure();
+    // The tile configuration is only dispatched on static sizes.
+    if (hasDynamicInputs(
+            dyn_cast<DispatchOpTy>(op.getOperand(0).getDefiningOp())))
+      return failure();
     auto flags =
         dyn_cast<DispatchOpTy>(op.getOperand(0).getDefiningOp()).getFlags();
     for (auto flagItr : flags)
@@ -6,18 +6,25 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// This file implements tile configuration hoisting on parallel loops.
+// This file implements tile configuration hoisting on parallel loops, the
+// coalescing of identical configurations of consecutive brgemms and the
+// hoisting of the configuration to once per thread of an OpenMP parallel
+// region.
 //
 //===----------------------------------------------------------------------===//
 #include "TPP/Dialect/Xsmm/XsmmOps.h"
+#include "mlir/Analysis/SliceAnalysis.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/OpenMP/OpenMPDialect.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 namespace mlir {
 namespace tpp {
 #define GEN_PASS_DEF_INTELAMXTILECONFIGHOISTINGPASS
+#define GEN_PASS_DEF_INTELAMXTILECONFIGTHREADHOISTINGPASS
 #include "TPP/Passes.h.inc"
 } // namespace tpp
 } // namespace mlir
@@ -25,6 +32,77 @@ namespace tpp {
 using namespace mlir;
 using namespace mlir::xsmm;
 
+static bool hasGemmFlag(xsmm::IntelAMXTileConfigDispatchOp dispatch,
+                        xsmm::GemmFlags flag) {
+  return llvm::is_contained(dispatch.getFlags(),
+                            GemmFlagsAttr::get(dispatch.getContext(), flag));
+}
+
+static xsmm::IntelAMXTileConfigDispatchOp
+getTileConfigDispatch(xsmm::IntelAMXTileConfigOp tileConfig) {
+  return tileConfig.getOperand(0)
+      .getDefiningOp<xsmm::IntelAMXTileConfigDispatchOp>();
+}
+
+// Returns true if the tile configuration is left untouched by `op`: eltwise
+// kernels and pure index or view computations do not use the tiles.
+static bool preservesTileConfig(Operation *op) {
+  return isa<xsmm::UnaryOp, xsmm::BinaryOp, memref::AllocaOp>(op) ||
+         isMemoryEffectFree(op);
+}
+
+// Returns the user of `buffer` other than `user` if they are its only users.
+static Operation *getOtherUser(Value buffer, Operation *user) {
+  SmallVector<Operation *> users(buffer.getUsers());
+  if (users.size() != 2 || !llvm::is_contained(users, user))
+    return nullptr;
+  return users[0] == user ? users[1] : users[0];
+}
+
+// Consecutive brgemms with the same shapes are each wrapped in their own
+// setup and reset of the same tile configuration. Drop the reset of the first
+// one and the setup of the second one so that the tiles are configured once
+// for both, the remaining reset uses the buffer of the remaining setup.
+static void coalesceTileConfigs(func::FuncOp funcOp) {
+  SmallVector<xsmm::IntelAMXTileConfigOp> resets;
+  funcOp.walk([&](xsmm::IntelAMXTileConfigOp tileConfig) {
+    auto dispatch = getTileConfigDispatch(tileConfig);
+    if (dispatch && hasGemmFlag(dispatch, GemmFlags::NO_SETUP_TILECONFIG))
+      resets.push_back(tileConfig);
+  });
+
+  for (xsmm::IntelAMXTileConfigOp reset : resets) {
+    Operation *next = reset->getNextNode();
+    while (next && preservesTileConfig(next))
+      next = next->getNextNode();
+    auto setup = dyn_cast_or_null<xsmm::IntelAMXTileConfigOp>(next);
+    if (!setup)
+      continue;
+
+    // Each buffer is used by the setup and the reset around one brgemm.
+    auto firstSetup = dyn_cast_or_null<xsmm::IntelAMXTileConfigOp>(
+        getOtherUser(reset.getOperand(1), reset));
+    Value buffer = setup.getOperand(1);
+    Operation *nextReset = getOtherUser(buffer, setup);
+    if (!firstSetup || !nextReset || !buffer.getDefiningOp<memref::AllocaOp>())
+      continue;
+
+    auto firstDispatch = getTileConfigDispatch(firstSetup);
+    auto setupDispatch = getTileConfigDispatch(setup);
+    if (!firstDispatch || !setupDispatch ||
+        !hasGemmFlag(setupDispatch, GemmFlags::NO_RESET_TILECONFIG) ||
+        firstDispatch.getInputs() != setupDispatch.getInputs() ||
+        firstDispatch.getFlags() != setupDispatch.getFlags() ||
+        firstDispatch.getDataType() != setupDispatch.getDataType())
+      continue;
+
+    nextReset->setOperand(1, reset.getOperand(1));
+    setup->erase();
+    buffer.getDefiningOp()->erase();
+    reset->erase();
+  }
+}
+
 namespace mlir {
 namespace tpp {
 
@@ -72,7 +150,18 @@ struct IntelAMXTileConfigHoisting : OpRewritePattern<memref::AllocaOp> {
       op = op->getParentOp();
     }
 
-    if (parallelOpParent == NULL)
+    if (parallelOpParent == NULL || !firstTileConfig || !secondTileConfig)
+      return failure();
+
+    // Other configurations in the parallel region would be interleaved with
+    // this one once hoisted.
+    WalkResult otherConfig = parallelOpParent.getBody()->walk(
+        [&](xsmm::IntelAMXTileConfigOp tileConfig) {
+          if (tileConfig == firstTileConfig || tileConfig == secondTileConfig)
+            return WalkResult::advance();
+          return WalkResult::interrupt();
+        });
+    if (otherConfig.wasInterrupted())
       return failure();
 
     rewriter.moveOpBefore(alloca, parallelOpParent.getBody(),
@@ -92,10 +181,87 @@ struct IntelAMXTileConfigHoistingPass
   }
 
   void runOnOperation() override {
+    coalesceTileConfigs(getOperation());
     RewritePatternSet patterns(&getContext());
     populateCombinePatterns(patterns);
     (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
   }
 };
+
+static bool isTileConfigInvoke(Operation *op) {
+  auto call = dyn_cast<func::CallOp>(op);
+  return call && call.getCallee() == "xsmm_intel_amx_tile_config_invoke";
+}
+
+// After the SCF to OpenMP conversion, the tile configuration hoisted to the
+// body of a parallel loop still runs once per iteration of the worksharing
+// loop. When the body starts with the setup and ends with the reset of the
+// tile configuration, move them, together with their buffer and operands, to
+// the parallel region around the worksharing loop so that each thread
+// configures the tiles once.
+static void hoistTileConfigToThread(omp::WsloopOp wsloop) {
+  if (!isa<omp::ParallelOp>(wsloop->getParentOp()))
+    return;
+  auto loopNest =
+      dyn_cast<omp::LoopNestOp>(&wsloop.getRegion().front().front());
+  if (!loopNest)
+    return;
+  Block *body = &loopNest.getRegion().front();
+  // The conversion wraps a body with allocas in an alloca scope.
+  if (auto scope = dyn_cast<memref::AllocaScopeOp>(&body->front());
+      scope && scope->getNextNode() == body->getTerminator())
+    body = &scope.getBodyRegion().front();
+
+  Operation *setup = nullptr, *reset = nullptr;
+  for (Operation &op : body->without_terminator()) {
+    if (isa<memref::AllocaOp>(op) || isMemoryEffectFree(&op))
+      continue;
+    if (!setup)
+      setup = &op;
+    reset = &op;
+  }
+  if (!setup || setup == reset || !isTileConfigInvoke(setup) ||
+      !isTileConfigInvoke(reset))
+    return;
+
+  Region &loopRegion = loopNest.getRegion();
+  BackwardSliceOptions options;
+  options.filter = [&](Operation *op) {
+    return loopRegion.isAncestor(op->getParentRegion());
+  };
+  SetVector<Operation *> slice;
+  getBackwardSlice(setup, &slice, options);
+  getBackwardSlice(reset, &slice, options);
+
+  // Everything the calls depend on in the loop must be invariant and free of
+  // side effects but the buffer, which becomes private to each thread.
+  auto isInvariant = [&](Operation *op) {
+    return llvm::all_of(op->getOperands(), [&](Value operand) {
+      return !loopRegion.isAncestor(operand.getParentRegion()) ||
+             slice.contains(operand.getDefiningOp());
+    });
+  };
+  for (Operation *op : slice) {
+    if (op->getNumRegions() != 0 || !isInvariant(op) ||
+        (!isa<memref::AllocaOp>(op) && !isMemoryEffectFree(op)))
+      return;
+  }
+  if (!isInvariant(setup) || !isInvariant(reset))
+    return;
+
+  for (Operation *op : slice)
+    op->moveBefore(wsloop);
+  setup->moveBefore(wsloop);
+  reset->moveAfter(wsloop);
+}
+
+struct IntelAMXTileConfigThreadHoistingPass
+    : public impl::IntelAMXTileConfigThreadHoistingPassBase<
+          IntelAMXTileConfigThreadHoistingPass> {
+  void runOnOperation() override {
+    getOperation()->walk(
+        [](omp::WsloopOp wsloop) { hoistTileConfigToThread(wsloop); });
+  }
+};
 } // namespace tpp
 } // namespace mlir
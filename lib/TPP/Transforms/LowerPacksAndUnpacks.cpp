@@ -8,6 +8,7 @@
 
 #include "TPP/Passes.h"
 #include "TPP/Transforms/Transforms.h"
+#include "TPP/Transforms/Utils/BlockingCostModel.h"
 #include "TPP/Transforms/Utils/TransformUtils.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
@@ -15,6 +16,8 @@
 #include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/Dialect/SCF/Transforms/TileUsingInterface.h"
 #include "mlir/Dialect/Tensor/IR/Tensor.h"
+#include "mlir/Dialect/Utils/IndexingUtils.h"
+#include "mlir/Dialect/Utils/ReshapeOpsUtils.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 
@@ -172,9 +175,200 @@ struct LowerUnPackPattern : public OpRewritePattern<tensor::UnPackOp> {
   }
 };
 
+// Returns true if `transposeOp` interleaves the rows of a 2-D matrix in VNNI
+// layout, i.e. the expand_shape + transpose lowering a VNNI pack, which maps
+// to the XSMM VNNI kernels as is.
+static bool isVnniTranspose(linalg::TransposeOp transposeOp) {
+  auto expandShapeOp =
+      transposeOp.getInput().getDefiningOp<tensor::ExpandShapeOp>();
+  return expandShapeOp && expandShapeOp.getSrcType().getRank() == 2 &&
+         transposeOp.getPermutation() == ArrayRef<int64_t>{0, 2, 1};
+}
+
+// Drops the unit dimensions of a transpose so that the tiles of the packs
+// map to the 2-D XSMM transpose, or to an identity copy when only unit
+// dimensions move:
+//   linalg.transpose ins(tensor<1x32x1x32xf32>) outs(tensor<1x1x32x32xf32>)
+//     permutation = [0, 2, 3, 1]
+// becomes a 2-D transpose of the collapsed 32x32 tensors expanded back to the
+// shape of the destination.
+struct DropUnitDimsOfTranspose : public OpRewritePattern<linalg::TransposeOp> {
+  using OpRewritePattern<linalg::TransposeOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(linalg::TransposeOp transposeOp,
+                                PatternRewriter &rewriter) const override {
+    if (!transposeOp.hasPureTensorSemantics() || isVnniTranspose(transposeOp))
+      return failure();
+    auto inputType = cast<RankedTensorType>(transposeOp.getInput().getType());
+    auto initType = cast<RankedTensorType>(transposeOp.getInit().getType());
+    if (!inputType.hasStaticShape() ||
+        !llvm::is_contained(inputType.getShape(), 1))
+      return failure();
+
+    // Renumber the non-unit dimensions of the input.
+    SmallVector<int64_t> reducedInputShape;
+    SmallVector<int64_t> reducedDims(inputType.getRank(), -1);
+    for (auto [dim, size] : llvm::enumerate(inputType.getShape())) {
+      if (size == 1)
+        continue;
+      reducedDims[dim] = reducedInputShape.size();
+      reducedInputShape.push_back(size);
+    }
+    if (reducedInputShape.empty())
+      return failure();
+    SmallVector<int64_t> reducedPermutation;
+    SmallVector<int64_t> reducedInitShape;
+    for (int64_t dim : transposeOp.getPermutation()) {
+      if (reducedDims[dim] < 0)
+        continue;
+      reducedPermutation.push_back(reducedDims[dim]);
+      reducedInitShape.push_back(inputType.getDimSize(dim));
+    }
+
+    Type elementType = inputType.getElementType();
+    auto reducedInputType =
+        RankedTensorType::get(reducedInputShape, elementType);
+    auto reducedInitType = RankedTensorType::get(reducedInitShape, elementType);
+    std::optional<SmallVector<ReassociationIndices>> inputReassociation =
+        getReassociationIndicesForReshape(inputType, reducedInputType);
+    std::optional<SmallVector<ReassociationIndices>> initReassociation =
+        getReassociationIndicesForReshape(initType, reducedInitType);
+    if (!inputReassociation || !initReassociation)
+      return failure();
+
+    Location loc = transposeOp.getLoc();
+    Value input = rewriter.create<tensor::CollapseShapeOp>(
+        loc, reducedInputType, transposeOp.getInput(), *inputReassociation);
+    Value init = rewriter.create<tensor::CollapseShapeOp>(
+        loc, reducedInitType, transposeOp.getInit(), *initReassociation);
+    Value result;
+    if (isIdentityPermutation(reducedPermutation)) {
+      result = rewriter.create<linalg::CopyOp>(loc, input, init)->getResult(0);
+    } else {
+      result = rewriter
+                   .create<linalg::TransposeOp>(loc, input, init,
+                                                reducedPermutation)
+                   ->getResult(0);
+    }
+    rewriter.replaceOpWithNewOp<tensor::ExpandShapeOp>(
+        transposeOp, initType, result, *initReassociation);
+    return success();
+  }
+};
+
+// Tiles by one the outer dimensions a transpose leaves in place, e.g. the
+// blocks of a pack whose outer dimensions were not tiled, into a scf.forall.
+// Each thread then transposes a 2-D block, or a lower rank one, whose unit
+// dimensions are dropped by `DropUnitDimsOfTranspose`.
+struct TileBatchedTranspose : public OpRewritePattern<linalg::TransposeOp> {
+  using OpRewritePattern<linalg::TransposeOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(linalg::TransposeOp transposeOp,
+                                PatternRewriter &rewriter) const override {
+    if (!transposeOp.hasPureTensorSemantics() || isVnniTranspose(transposeOp))
+      return failure();
+    auto inputType = cast<RankedTensorType>(transposeOp.getInput().getType());
+    if (!inputType.hasStaticShape() ||
+        llvm::is_contained(inputType.getShape(), 1))
+      return failure();
+    ArrayRef<int64_t> permutation = transposeOp.getPermutation();
+    int64_t numBatchDims = 0;
+    while (numBatchDims < static_cast<int64_t>(permutation.size()) &&
+           permutation[numBatchDims] == numBatchDims)
+      numBatchDims++;
+    if (numBatchDims == 0 ||
+        numBatchDims == static_cast<int64_t>(permutation.size()))
+      return failure();
+
+    SmallVector<int64_t> tiles(inputType.getRank(), 0);
+    std::fill_n(tiles.begin(), numBatchDims, 1);
+    scf::SCFTilingOptions tilingOpts;
+    tilingOpts.setTileSizes(
+        getAsIndexOpFoldResult(rewriter.getContext(), tiles));
+    tilingOpts.setLoopType(scf::SCFTilingOptions::LoopType::ForallOp);
+    FailureOr<scf::SCFTilingResult> tilingResult = scf::tileUsingSCF(
+        rewriter, cast<TilingInterface>(transposeOp.getOperation()),
+        tilingOpts);
+    if (failed(tilingResult))
+      return failure();
+    rewriter.replaceOp(transposeOp, tilingResult->replacements);
+    return success();
+  }
+};
+
+// Makes the write of `insertOp` into its destination an explicit linalg.copy
+// into the slice, which bufferizes in place and carries the hint.
+template <typename InsertOpTy>
+static void copyIntoSlice(RewriterBase &rewriter, InsertOpTy insertOp,
+                          Operation *insertionPoint) {
+  rewriter.setInsertionPoint(insertionPoint);
+  Location loc = insertOp.getLoc();
+  Value slice = rewriter.create<tensor::ExtractSliceOp>(
+      loc, insertOp.getSourceType(), insertOp.getDest(),
+      insertOp.getMixedOffsets(), insertOp.getMixedSizes(),
+      insertOp.getMixedStrides());
+  auto copyOp =
+      rewriter.create<linalg::CopyOp>(loc, insertOp.getSource(), slice);
+  copyOp->setAttr(linalgx::utils::kNonTemporal, rewriter.getUnitAttr());
+  rewriter.modifyOpInPlace(insertOp, [&]() {
+    insertOp.getSourceMutable().assign(copyOp->getResult(0));
+  });
+}
+
+// Marks the writes of `value`, through the inserts of tiles and the results
+// of the loops around them, as non-temporal.
+static void markNonTemporalWrites(RewriterBase &rewriter, Value value) {
+  auto result = dyn_cast<OpResult>(value);
+  if (!result)
+    return;
+  Operation *op = result.getOwner();
+  if (auto forallOp = dyn_cast<scf::ForallOp>(op)) {
+    BlockArgument sharedOut =
+        forallOp.getRegionIterArgs()[result.getResultNumber()];
+    SmallVector<tensor::ParallelInsertSliceOp> insertOps;
+    for (Operation &yieldingOp : forallOp.getTerminator().getYieldingOps()) {
+      auto insertOp = dyn_cast<tensor::ParallelInsertSliceOp>(yieldingOp);
+      if (insertOp && insertOp.getDest() == sharedOut)
+        insertOps.push_back(insertOp);
+    }
+    for (tensor::ParallelInsertSliceOp insertOp : insertOps)
+      copyIntoSlice(rewriter, insertOp, forallOp.getTerminator());
+    return;
+  }
+  if (auto forOp = dyn_cast<scf::ForOp>(op)) {
+    markNonTemporalWrites(
+        rewriter, forOp.getYieldedValues()[result.getResultNumber()]);
+    return;
+  }
+  if (auto insertOp = dyn_cast<tensor::InsertSliceOp>(op)) {
+    copyIntoSlice(rewriter, insertOp, insertOp);
+    return;
+  }
+  if (isa<linalg::LinalgOp>(op))
+    op->setAttr(linalgx::utils::kNonTemporal, rewriter.getUnitAttr());
+}
+
 class LowerPacksAndUnPacks
     : public tpp::impl::LowerPacksAndUnPacksBase<LowerPacksAndUnPacks> {
+public:
+  using LowerPacksAndUnPacksBase::LowerPacksAndUnPacksBase;
+
+private:
   void runOnOperation() override {
+    // The unpacks writing a large output of the function, these are written
+    // once and evicted before any reuse.
+    SmallVector<unsigned> streamingResults;
+    if (nontemporalStores) {
+      auto target = tpp::CpuTargetInfo::get(getOperation());
+      getOperation()->walk([&](func::ReturnOp returnOp) {
+        for (OpOperand &operand : returnOp->getOpOperands()) {
+          auto unPackOp = operand.get().getDefiningOp<tensor::UnPackOp>();
+          if (unPackOp && unPackOp->hasOneUse() &&
+              tpp::isStreamingOutput(unPackOp.getDestType(), target))
+            streamingResults.push_back(operand.getOperandNumber());
+        }
+      });
+    }
 
     // Step1. Tile and fuse pack consumer and producer.
     auto *ctx = &getContext();
@@ -238,7 +432,14 @@ class LowerPacksAndUnPacks
       }
     }
 
-    // Step6. Canonicalize.
+    // Step6. Reduce the transposes to the kernels of the 2-D blocks.
+    if (transposeKernels) {
+      RewritePatternSet patterns(ctx);
+      patterns.add<DropUnitDimsOfTranspose, TileBatchedTranspose>(ctx);
+      (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
+    }
+
+    // Step7. Canonicalize.
     {
       RewritePatternSet patterns(ctx);
       linalg::GenericOp::getCanonicalizationPatterns(patterns, ctx);
@@ -248,6 +449,15 @@ class LowerPacksAndUnPacks
           ->getCanonicalizationPatterns(patterns);
       (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
     }
+
+    // Step8. Mark the writes of the streaming outputs.
+    if (!streamingResults.empty()) {
+      IRRewriter rewriter(ctx);
+      getOperation()->walk([&](func::ReturnOp returnOp) {
+        for (unsigned resultNumber : streamingResults)
+          markNonTemporalWrites(rewriter, returnOp.getOperand(resultNumber));
+      });
+    }
   }
 };
 
@@ -0,0 +1,240 @@
+//===- MathApproximation.cpp -------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the polynomial and rational approximations of the
+// transcendental functions of the activations and of softmax, in place of
+// their libm calls.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/Math/IR/Math.h"
+#include "mlir/Dialect/Vector/IR/VectorOps.h"
+#include "mlir/IR/BuiltinAttributes.h"
+#include "mlir/IR/ImplicitLocOpBuilder.h"
+#include "mlir/IR/PatternMatch.h"
+#include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_MATHAPPROXIMATION
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+using namespace mlir;
+
+#define DEBUG_TYPE "math-approximation"
+
+namespace {
+
+// Builds the approximations in f32, on scalars or on vectors of any shape,
+// fixed or scalable: the constants are splat to the type of the operand.
+class ApproxBuilder {
+public:
+  ApproxBuilder(ImplicitLocOpBuilder &b, Type type) : b(b), type(type) {
+    intType = getSameShape(b.getI32Type());
+  }
+
+  Value f32(double value) {
+    Attribute attr = b.getF32FloatAttr(value);
+    if (auto shapedType = dyn_cast<ShapedType>(type))
+      attr = DenseElementsAttr::get(shapedType, attr);
+    return b.create<arith::ConstantOp>(type, cast<TypedAttr>(attr));
+  }
+
+  Value i32(int32_t value) {
+    Attribute attr = b.getI32IntegerAttr(value);
+    if (auto shapedType = dyn_cast<ShapedType>(intType))
+      attr = DenseElementsAttr::get(shapedType, attr);
+    return b.create<arith::ConstantOp>(intType, cast<TypedAttr>(attr));
+  }
+
+  Value add(Value lhs, Value rhs) { return b.create<arith::AddFOp>(lhs, rhs); }
+  Value sub(Value lhs, Value rhs) { return b.create<arith::SubFOp>(lhs, rhs); }
+  Value mul(Value lhs, Value rhs) { return b.create<arith::MulFOp>(lhs, rhs); }
+  Value div(Value lhs, Value rhs) { return b.create<arith::DivFOp>(lhs, rhs); }
+  Value fma(Value a, Value x, Value c) { return b.create<math::FmaOp>(a, x, c); }
+
+  Value clamp(Value x, double lower, double upper) {
+    x = b.create<arith::MaximumFOp>(x, f32(lower));
+    return b.create<arith::MinimumFOp>(x, f32(upper));
+  }
+
+  // Evaluates the polynomial of `coeffs`, from degree 0 up, with Horner's
+  // scheme.
+  Value poly(Value x, ArrayRef<double> coeffs) {
+    Value result = f32(coeffs.back());
+    for (double coeff : llvm::reverse(coeffs.drop_back()))
+      result = fma(result, x, f32(coeff));
+    return result;
+  }
+
+  // exp(x) = 2^n * exp(r), n = round(x / ln2), r = x - n * ln2 in
+  // [-ln2/2, ln2/2], with ln2 split in two for an exact first product (Cody
+  // and Waite). 2^n is built from its exponent bits. The input saturates to
+  // keep n a normal exponent: exp(x) is 1.2e-38 below -87.34 and 2.4e38 above
+  // 88.38.
+  Value exp(Value x, bool fast) {
+    x = clamp(x, -87.3365478515625, 88.3762588500976);
+    Value n =
+        b.create<math::FloorOp>(fma(x, f32(1.44269504088896341), f32(0.5)));
+    Value r = fma(n, f32(-0.693359375), x);
+    r = fma(n, f32(2.12194440e-4), r);
+
+    Value expR;
+    if (fast) {
+      // Degree 4 on the Chebyshev nodes, relative error 3.5e-6.
+      expR = poly(r, {1.0, 0.99996229465, 0.49999372139, 0.16792143017,
+                      0.04187564445});
+    } else {
+      // Cephes expf: 1 + r + r^2 * P(r), relative error 1e-7 in f32.
+      Value p = poly(r, {5.0000001201e-1, 1.6666665459e-1, 4.1665795894e-2,
+                         8.3334519073e-3, 1.3981999507e-3, 1.9875691500e-4});
+      expR = add(fma(mul(r, r), p, r), f32(1.0));
+    }
+
+    Value exponent = b.create<arith::FPToSIOp>(intType, n);
+    exponent = b.create<arith::AddIOp>(exponent, i32(127));
+    exponent = b.create<arith::ShLIOp>(exponent, i32(23));
+    Value pow2n = b.create<arith::BitcastOp>(type, exponent);
+    return mul(expR, pow2n);
+  }
+
+  // Odd rational approximation p(x) / q(x) of tanh, clamped where it reaches
+  // +-1 in f32.
+  Value tanh(Value x, bool fast) {
+    if (fast) {
+      // Least squares on [0, 6], absolute error 4.2e-5.
+      x = clamp(x, -6.0, 6.0);
+      Value x2 = mul(x, x);
+      Value p = mul(x, poly(x2, {0.99984313045, 0.11281708876,
+                                 1.41072205035e-3}));
+      Value q = poly(x2, {1.0, 0.44582735729, 1.69254230192e-2,
+                          5.04297257514e-5});
+      return div(p, q);
+    }
+
+    // Eigen's 13/6 rational approximation, absolute error 2.6e-7. Below
+    // 4e-4, tanh(x) is x in f32.
+    Value tiny = b.create<arith::CmpFOp>(
+        arith::CmpFPredicate::OLT, b.create<math::AbsFOp>(x), f32(0.0004));
+    Value clamped = clamp(x, -7.90531110763549805, 7.90531110763549805);
+    Value x2 = mul(clamped, clamped);
+    Value p = mul(clamped,
+                  poly(x2, {4.89352455891786e-03, 6.37261928875436e-04,
+                            1.48572235717979e-05, 5.12229709037114e-08,
+                            -8.60467152213735e-11, 2.00018790482477e-13,
+                            -2.76076847742355e-16}));
+    Value q = poly(x2, {4.89352518554385e-03, 2.26843463243900e-03,
+                        1.18534705686654e-04, 1.19825839466702e-06});
+    return b.create<arith::SelectOp>(tiny, x, div(p, q));
+  }
+
+  // erf of the exact GELU, from Abramowitz and Stegun, on |x| with the sign
+  // of x.
+  Value erf(Value x, bool fast) {
+    Value absX = b.create<math::AbsFOp>(x);
+    Value result;
+    if (fast) {
+      // 7.1.27: 1 - 1 / (1 + a1 x + ... + a4 x^4)^4, absolute error 5e-4.
+      Value d = poly(absX, {1.0, 0.278393, 0.230389, 0.000972, 0.078108});
+      Value d2 = mul(d, d);
+      result = sub(f32(1.0), div(f32(1.0), mul(d2, d2)));
+    } else {
+      // 7.1.26: 1 - t (a1 + ... + a5 t^4) exp(-x^2), t = 1 / (1 + p x),
+      // absolute error 1.4e-7.
+      Value t = div(f32(1.0), fma(absX, f32(0.3275911), f32(1.0)));
+      Value p = mul(t, poly(t, {0.254829592, -0.284496736, 1.421413741,
+                                -1.453152027, 1.061405429}));
+      Value expX2 = exp(b.create<arith::NegFOp>(mul(absX, absX)),
+                        /*fast=*/false);
+      result = sub(f32(1.0), mul(p, expX2));
+    }
+    return b.create<math::CopySignOp>(result, x);
+  }
+
+private:
+  Type getSameShape(Type elementType) {
+    if (auto shapedType = dyn_cast<ShapedType>(type))
+      return shapedType.clone(elementType);
+    return elementType;
+  }
+
+  ImplicitLocOpBuilder &b;
+  Type type;
+  Type intType;
+};
+
+using ApproxFn = Value (ApproxBuilder::*)(Value, bool);
+
+// Replaces a math op on f32, f16 or bf16 scalars or vectors by its
+// approximation, computed in f32.
+template <typename OpTy>
+struct ApproximateMathOp : public OpRewritePattern<OpTy> {
+  ApproximateMathOp(MLIRContext *context, ApproxFn approx, bool fast)
+      : OpRewritePattern<OpTy>(context), approx(approx), fast(fast) {}
+
+  LogicalResult matchAndRewrite(OpTy op,
+                                PatternRewriter &rewriter) const override {
+    Type type = op.getType();
+    Type elementType = getElementTypeOrSelf(type);
+    if (!elementType.isF32() && !elementType.isF16() &&
+        !elementType.isBF16())
+      return rewriter.notifyMatchFailure(op, "not a f32, f16 or bf16 op");
+    if (isa<ShapedType>(type) && !isa<VectorType>(type))
+      return rewriter.notifyMatchFailure(op, "not a scalar or vector op");
+
+    ImplicitLocOpBuilder b(op.getLoc(), rewriter);
+    Type f32Type = b.getF32Type();
+    if (auto vectorType = dyn_cast<VectorType>(type))
+      f32Type = vectorType.clone(f32Type);
+
+    Value x = op.getOperand();
+    if (!elementType.isF32())
+      x = b.create<arith::ExtFOp>(f32Type, x);
+    ApproxBuilder builder(b, f32Type);
+    Value result = (builder.*approx)(x, fast);
+    if (!elementType.isF32())
+      result = b.create<arith::TruncFOp>(type, result);
+    rewriter.replaceOp(op, result);
+    return success();
+  }
+
+private:
+  ApproxFn approx;
+  bool fast;
+};
+
+struct MathApproximation
+    : public tpp::impl::MathApproximationBase<MathApproximation> {
+  using MathApproximationBase::MathApproximationBase;
+
+  void runOnOperation() override {
+    bool fast = accuracy == "fast";
+    if (!fast && accuracy != "accurate") {
+      getOperation().emitError("Invalid math approximation accuracy '" +
+                               accuracy + "'");
+      return signalPassFailure();
+    }
+
+    MLIRContext *context = &getContext();
+    RewritePatternSet patterns(context);
+    patterns.add<ApproximateMathOp<math::ExpOp>>(context, &ApproxBuilder::exp,
+                                                 fast);
+    patterns.add<ApproximateMathOp<math::TanhOp>>(
+        context, &ApproxBuilder::tanh, fast);
+    patterns.add<ApproximateMathOp<math::ErfOp>>(context, &ApproxBuilder::erf,
+                                                 fast);
+    (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
+  }
+};
+
+} // namespace
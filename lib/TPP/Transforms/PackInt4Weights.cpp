@@ -0,0 +1,158 @@
+//===- PackInt4Weights.cpp ---------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the storage of the constant int4 weights of the
+// dequantizations two per byte.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "TPP/Transforms/Utils/TransformUtils.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/IR/IRMapping.h"
+#include "mlir/IR/Matchers.h"
+#include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+#include "llvm/Support/Debug.h"
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_PACKINT4WEIGHTS
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+#define DEBUG_TYPE "pack-int4-weights"
+
+namespace {
+
+// Return the int4 elements of `value` two per byte along its innermost
+// dimension, the even ones in the low nibble.
+static DenseElementsAttr packNibbles(DenseIntElementsAttr value,
+                                     RankedTensorType bytesType) {
+  SmallVector<APInt> bytes;
+  bytes.reserve(bytesType.getNumElements());
+  auto values = value.getValues<APInt>();
+  for (auto it = values.begin(), end = values.end(); it != end;) {
+    uint64_t low = (*it++).getZExtValue() & 0xF;
+    uint64_t high = (*it++).getZExtValue() & 0xF;
+    bytes.push_back(APInt(8, low | (high << 4)));
+  }
+  return DenseElementsAttr::get(bytesType, bytes);
+}
+
+// Store the constant int4 weights of a dequantization two per byte, and unpack
+// them in its body:
+//
+//   %q = arith.constant dense<...> : tensor<...x32xi4>
+//   %w = linalg.generic ins(%q, %scales) outs(%empty) {
+//     ^bb0(%in: i4, ...)
+//
+// becomes:
+//
+//   %q = arith.constant dense<...> : tensor<...x16xi8>
+//   %w = linalg.generic ins(%q, %scales) outs(%empty) {
+//     ^bb0(%byte: i8, ...)
+//       %in = trunci (odd ? %byte >> 4 : (%byte << 4) >> 4) to i4
+//
+// The nibbles are only unpacked in registers, the weights are read at half a
+// byte per element.
+struct PackInt4Pairs : public OpRewritePattern<linalg::GenericOp> {
+  using OpRewritePattern<linalg::GenericOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(linalg::GenericOp dequantOp,
+                                PatternRewriter &rewriter) const override {
+    if (!linalgx::utils::isDequantize(dequantOp))
+      return rewriter.notifyMatchFailure(dequantOp, "not a dequantization");
+    OpOperand *quantized = dequantOp.getDpsInputOperand(0);
+    auto quantizedType = cast<RankedTensorType>(quantized->get().getType());
+    if (!quantizedType.getElementType().isInteger(4) ||
+        !dequantOp.getMatchingIndexingMap(quantized).isIdentity())
+      return rewriter.notifyMatchFailure(dequantOp, "not int4 elements");
+    int64_t rank = quantizedType.getRank();
+    if (rank == 0 || !quantizedType.hasStaticShape() ||
+        quantizedType.getShape().back() % 2 != 0)
+      return rewriter.notifyMatchFailure(dequantOp, "odd innermost dimension");
+    DenseIntElementsAttr value;
+    if (!matchPattern(quantized->get(), m_Constant(&value)))
+      return rewriter.notifyMatchFailure(dequantOp, "not a constant");
+
+    Location loc = dequantOp.getLoc();
+    SmallVector<int64_t> bytesShape(quantizedType.getShape());
+    bytesShape.back() /= 2;
+    auto bytesType = RankedTensorType::get(bytesShape, rewriter.getI8Type());
+    Value bytes = rewriter.create<arith::ConstantOp>(
+        loc, bytesType, packNibbles(value, bytesType));
+
+    SmallVector<Value> inputs{bytes};
+    SmallVector<AffineMap> maps(dequantOp.getIndexingMapsArray());
+    MLIRContext *ctx = rewriter.getContext();
+    SmallVector<AffineExpr> nibbleExprs;
+    for (int64_t dim = 0; dim < rank - 1; dim++)
+      nibbleExprs.push_back(getAffineDimExpr(dim, ctx));
+    nibbleExprs.push_back(getAffineDimExpr(rank - 1, ctx).floorDiv(2));
+    maps[0] = AffineMap::get(rank, 0, nibbleExprs, ctx);
+    for (OpOperand *input : llvm::drop_begin(dequantOp.getDpsInputOperands()))
+      inputs.push_back(input->get());
+
+    Block *body = dequantOp.getBlock();
+    auto packedOp = rewriter.create<linalg::GenericOp>(
+        loc, dequantOp.getResultTypes(), inputs, dequantOp.getOutputs(), maps,
+        dequantOp.getIteratorTypesArray(),
+        [&](OpBuilder &b, Location loc, ValueRange args) {
+          Type i8 = b.getI8Type();
+          Value index = b.create<linalg::IndexOp>(loc, rank - 1);
+          Value two = b.create<arith::ConstantIndexOp>(loc, 2);
+          Value zero = b.create<arith::ConstantIndexOp>(loc, 0);
+          Value isOdd = b.create<arith::CmpIOp>(
+              loc, arith::CmpIPredicate::ne,
+              b.create<arith::RemUIOp>(loc, index, two), zero);
+          Value four = b.create<arith::ConstantIntOp>(loc, 4, i8);
+          Value high = b.create<arith::ShRSIOp>(loc, args[0], four);
+          Value low = b.create<arith::ShRSIOp>(
+              loc, b.create<arith::ShLIOp>(loc, args[0], four), four);
+          Value nibble = b.create<arith::TruncIOp>(
+              loc, b.getIntegerType(4),
+              b.create<arith::SelectOp>(loc, isOdd, high, low));
+
+          IRMapping mapping;
+          mapping.map(body->getArgument(0), nibble);
+          for (auto [arg, newArg] :
+               llvm::zip(body->getArguments().drop_front(), args.drop_front()))
+            mapping.map(arg, newArg);
+          for (Operation &op : body->without_terminator())
+            b.clone(op, mapping);
+          SmallVector<Value> yields;
+          for (Value yield : body->getTerminator()->getOperands())
+            yields.push_back(mapping.lookupOrDefault(yield));
+          b.create<linalg::YieldOp>(loc, yields);
+        });
+    LLVM_DEBUG(llvm::dbgs() << "[PackInt4Weights] " << packedOp << "\n");
+    rewriter.replaceOp(dequantOp, packedOp->getResults());
+    return success();
+  }
+};
+
+struct PackInt4Weights
+    : public tpp::impl::PackInt4WeightsBase<PackInt4Weights> {
+  using PackInt4WeightsBase::PackInt4WeightsBase;
+
+  void runOnOperation() override {
+    RewritePatternSet patterns(&getContext());
+    patterns.add<PackInt4Pairs>(&getContext());
+    if (failed(applyPatternsAndFoldGreedily(getOperation(),
+                                            std::move(patterns))))
+      return signalPassFailure();
+  }
+};
+
+} // namespace
@@ -0,0 +1,139 @@
+//===- PackQuantizedWeights.cpp ----------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the packing of the quantized weights of the matmuls
+// ahead of their dequantization.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "TPP/Transforms/Utils/TransformUtils.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/Tensor/IR/Tensor.h"
+#include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+#include "llvm/Support/Debug.h"
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_PACKQUANTIZEDWEIGHTS
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+#define DEBUG_TYPE "pack-quantized-weights"
+
+namespace {
+
+// Return the map from the loops of the packed dequantization to the loops of
+// the original one: each tiled dimension is its outer block times its tile
+// plus its inner position. Fails on dynamic tiles.
+static FailureOr<AffineMap> getUnpackedLoopsMap(tensor::PackOp packOp) {
+  MLIRContext *ctx = packOp.getContext();
+  int64_t rank = packOp.getSourceRank();
+  ArrayRef<int64_t> innerDimsPos = packOp.getInnerDimsPos();
+  SmallVector<int64_t> outerDimsPerm(packOp.getOuterDimsPerm());
+  if (outerDimsPerm.empty())
+    outerDimsPerm = llvm::to_vector(llvm::seq<int64_t>(0, rank));
+
+  SmallVector<AffineExpr> exprs(rank);
+  for (auto [outerDim, dim] : llvm::enumerate(outerDimsPerm))
+    exprs[dim] = getAffineDimExpr(outerDim, ctx);
+  for (auto [index, tile] : llvm::enumerate(packOp.getStaticInnerTiles())) {
+    if (ShapedType::isDynamic(tile))
+      return failure();
+    int64_t dim = innerDimsPos[index];
+    exprs[dim] = exprs[dim] * tile + getAffineDimExpr(rank + index, ctx);
+  }
+  return AffineMap::get(packOp.getDestRank(), 0, exprs, ctx);
+}
+
+// Swap the pack of a dequantization with it: the integers are packed, and
+// dequantized in the packed layout.
+//
+//   %w = linalg.generic ins(%q, %scales) outs(%empty)   // dequantize
+//   %p = tensor.pack %w inner_tiles = [...] into %dest
+//
+// becomes:
+//
+//   %pq = tensor.pack %q inner_tiles = [...] into %qdest
+//   %p = linalg.generic ins(%pq, %scales) outs(%dest)   // dequantize
+//
+// The scales and zero points keep their layout, their maps read them at the
+// unpacked position of each packed element. Packs with padding or dynamic
+// shapes are left as is.
+struct SwapPackAndDequantize : public OpRewritePattern<tensor::PackOp> {
+  using OpRewritePattern<tensor::PackOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(tensor::PackOp packOp,
+                                PatternRewriter &rewriter) const override {
+    auto dequantOp = packOp.getSource().getDefiningOp<linalg::GenericOp>();
+    if (!dequantOp || !dequantOp->hasOneUse() ||
+        !linalgx::utils::isDequantize(dequantOp))
+      return rewriter.notifyMatchFailure(packOp, "not a dequantization");
+    if (!dequantOp.getMatchingIndexingMap(dequantOp.getDpsInputOperand(0))
+             .isIdentity())
+      return rewriter.notifyMatchFailure(packOp, "packed nibbles");
+    if (packOp.getPaddingValue())
+      return rewriter.notifyMatchFailure(packOp, "padded pack");
+    if (!packOp.getDestType().hasStaticShape())
+      return rewriter.notifyMatchFailure(packOp, "dynamic shape");
+    auto unpackedMap = getUnpackedLoopsMap(packOp);
+    if (failed(unpackedMap))
+      return rewriter.notifyMatchFailure(packOp, "dynamic tiles");
+
+    Location loc = packOp.getLoc();
+    Value quantized = dequantOp.getDpsInputOperand(0)->get();
+    auto quantizedDest = rewriter.create<tensor::EmptyOp>(
+        loc, packOp.getDestType().getShape(),
+        getElementTypeOrSelf(quantized.getType()));
+    Value packedQuantized = rewriter.create<tensor::PackOp>(
+        loc, quantized, quantizedDest, packOp.getInnerDimsPos(),
+        packOp.getMixedTiles(), /*paddingValue=*/std::nullopt,
+        packOp.getOuterDimsPerm());
+
+    int64_t packedRank = packOp.getDestRank();
+    SmallVector<Value> inputs{packedQuantized};
+    SmallVector<AffineMap> maps{rewriter.getMultiDimIdentityMap(packedRank)};
+    for (OpOperand *input : llvm::drop_begin(dequantOp.getDpsInputOperands())) {
+      inputs.push_back(input->get());
+      maps.push_back(
+          dequantOp.getMatchingIndexingMap(input).compose(*unpackedMap));
+    }
+    maps.push_back(rewriter.getMultiDimIdentityMap(packedRank));
+
+    auto packedOp = rewriter.create<linalg::GenericOp>(
+        loc, packOp.getDestType(), inputs, ValueRange{packOp.getDest()}, maps,
+        SmallVector<utils::IteratorType>(packedRank,
+                                         utils::IteratorType::parallel));
+    rewriter.inlineRegionBefore(dequantOp.getRegion(), packedOp.getRegion(),
+                                packedOp.getRegion().begin());
+    LLVM_DEBUG(llvm::dbgs() << "[PackQuantizedWeights] " << packedOp << "\n");
+    rewriter.replaceOp(packOp, packedOp->getResults());
+    rewriter.eraseOp(dequantOp);
+    return success();
+  }
+};
+
+struct PackQuantizedWeights
+    : public tpp::impl::PackQuantizedWeightsBase<PackQuantizedWeights> {
+  using PackQuantizedWeightsBase::PackQuantizedWeightsBase;
+
+  void runOnOperation() override {
+    RewritePatternSet patterns(&getContext());
+    patterns.add<SwapPackAndDequantize>(&getContext());
+    if (failed(applyPatternsAndFoldGreedily(getOperation(),
+                                            std::move(patterns))))
+      return signalPassFailure();
+  }
+};
+
+} // namespace
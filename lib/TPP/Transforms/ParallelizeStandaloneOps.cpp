@@ -0,0 +1,146 @@
+//===- ParallelizeStandaloneOps.cpp ------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the parallelization by rows of the fills, copies and
+// element-wise ops left outside of the tiled loops.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Interfaces/LoopLikeInterface.h"
+
+using namespace mlir;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_PARALLELIZESTANDALONEOPS
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+namespace {
+
+// Returns the number of rows of a tile of `numRows` rows: the largest divisor
+// of `numRows` up to `rowTile`, so that all the tiles have the same static
+// shape and still lower to XSMM.
+static int64_t getRowTile(int64_t numRows, int64_t rowTile) {
+  for (int64_t tile = std::min(numRows, rowTile); tile > 1; --tile) {
+    if (numRows % tile == 0)
+      return tile;
+  }
+  return 1;
+}
+
+// Returns true if `linalgOp` is a standalone fill, copy or element-wise op on
+// buffers of at least `minElements` elements: all its loops are parallel and
+// static, its body does not depend on the iteration and it is not nested in
+// a loop already.
+static bool isStandaloneElementwise(linalg::LinalgOp linalgOp,
+                                    int64_t minElements) {
+  if (!linalgOp.hasPureBufferSemantics() || linalgOp.getNumLoops() == 0 ||
+      linalgOp.getNumParallelLoops() != linalgOp.getNumLoops() ||
+      linalgOp.hasIndexSemantics() ||
+      linalgOp->getParentOfType<LoopLikeOpInterface>())
+    return false;
+  if (!llvm::all_of(linalgOp.getIndexingMapsArray(), [](AffineMap map) {
+        return map.isProjectedPermutation();
+      }))
+    return false;
+  SmallVector<int64_t> ranges = linalgOp.getStaticLoopRanges();
+  if (ShapedType::isDynamicShape(ranges))
+    return false;
+  int64_t numElements = 1;
+  for (int64_t range : ranges)
+    numElements *= range;
+  return numElements >= minElements;
+}
+
+// Replaces `linalgOp` by an scf.forall over tiles of the rows of its first
+// loop. Each tile runs the op on the subviews of its operands at the rows of
+// the tile, the operands broadcast along the rows are used whole.
+static void parallelizeRows(RewriterBase &rewriter, linalg::LinalgOp linalgOp,
+                            int64_t rowTile) {
+  int64_t numRows = linalgOp.getStaticLoopRanges()[0];
+  int64_t tile = getRowTile(numRows, rowTile);
+  if (tile == numRows)
+    return;
+
+  Location loc = linalgOp.getLoc();
+  rewriter.setInsertionPoint(linalgOp);
+  auto forallOp = rewriter.create<scf::ForallOp>(
+      loc, ArrayRef<OpFoldResult>{rewriter.getIndexAttr(0)},
+      ArrayRef<OpFoldResult>{rewriter.getIndexAttr(numRows)},
+      ArrayRef<OpFoldResult>{rewriter.getIndexAttr(tile)},
+      /*outputs=*/ValueRange{}, /*mapping=*/std::nullopt);
+  rewriter.setInsertionPointToStart(forallOp.getBody());
+  Value row = forallOp.getInductionVars()[0];
+
+  AffineExpr rowDim = rewriter.getAffineDimExpr(0);
+  SmallVector<Value> operands;
+  for (OpOperand &operand : linalgOp->getOpOperands()) {
+    auto type = dyn_cast<MemRefType>(operand.get().getType());
+    AffineMap map = linalgOp.getMatchingIndexingMap(&operand);
+    std::optional<unsigned> pos =
+        type ? map.getResultPosition(rowDim) : std::nullopt;
+    if (!pos) {
+      operands.push_back(operand.get());
+      continue;
+    }
+    SmallVector<OpFoldResult> offsets(type.getRank(),
+                                      rewriter.getIndexAttr(0));
+    offsets[*pos] = row;
+    SmallVector<OpFoldResult> sizes;
+    for (int64_t size : type.getShape())
+      sizes.push_back(rewriter.getIndexAttr(size));
+    sizes[*pos] = rewriter.getIndexAttr(tile);
+    SmallVector<OpFoldResult> strides(type.getRank(),
+                                      rewriter.getIndexAttr(1));
+    operands.push_back(rewriter.create<memref::SubViewOp>(
+        loc, operand.get(), offsets, sizes, strides));
+  }
+  linalgOp.clone(rewriter, loc, /*resultTypes=*/TypeRange{}, operands);
+  rewriter.eraseOp(linalgOp);
+}
+
+struct ParallelizeStandaloneOps
+    : public tpp::impl::ParallelizeStandaloneOpsBase<
+          ParallelizeStandaloneOps> {
+  using ParallelizeStandaloneOpsBase::ParallelizeStandaloneOpsBase;
+
+  void runOnOperation() override {
+    IRRewriter rewriter(&getContext());
+
+    // Large copies of whole buffers are rewritten as linalg copies to share
+    // the tiling and the XSMM lowering.
+    getOperation().walk([&](memref::CopyOp copyOp) {
+      auto sourceType = dyn_cast<MemRefType>(copyOp.getSource().getType());
+      auto targetType = dyn_cast<MemRefType>(copyOp.getTarget().getType());
+      if (!sourceType || !targetType || !sourceType.hasStaticShape() ||
+          sourceType.getNumElements() < minElements ||
+          copyOp->getParentOfType<LoopLikeOpInterface>())
+        return;
+      rewriter.setInsertionPoint(copyOp);
+      rewriter.replaceOpWithNewOp<linalg::CopyOp>(copyOp, copyOp.getSource(),
+                                                  copyOp.getTarget());
+    });
+
+    SmallVector<linalg::LinalgOp> candidates;
+    getOperation().walk([&](linalg::LinalgOp linalgOp) {
+      if (isStandaloneElementwise(linalgOp, minElements))
+        candidates.push_back(linalgOp);
+    });
+    for (linalg::LinalgOp linalgOp : candidates)
+      parallelizeRows(rewriter, linalgOp, rowTile);
+  }
+};
+
+} // namespace
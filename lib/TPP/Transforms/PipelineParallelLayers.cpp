@@ -0,0 +1,286 @@
+//===- PipelineParallelLayers.cpp --------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the pipelining of consecutive parallel loops, e.g. the
+// layers of an MLP, by rows with the async runtime.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Async/IR/Async.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/IR/IRMapping.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "mlir/Interfaces/ViewLikeInterface.h"
+#include "mlir/Transforms/RegionUtils.h"
+#include "llvm/ADT/DenseSet.h"
+
+using namespace mlir;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_PIPELINEPARALLELLAYERS
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+namespace {
+
+// Returns the buffer `value` is a view of.
+static Value getRootBuffer(Value value) {
+  while (auto viewOp = value.getDefiningOp<ViewLikeOpInterface>())
+    value = viewOp.getViewSource();
+  return value;
+}
+
+static bool isSameValue(Value lhs, Value rhs) {
+  if (lhs == rhs)
+    return true;
+  std::optional<int64_t> lhsCst = getConstantIntValue(lhs);
+  std::optional<int64_t> rhsCst = getConstantIntValue(rhs);
+  return lhsCst && rhsCst && *lhsCst == *rhsCst;
+}
+
+// Returns true if the rows of `loop` are its iterations along the first
+// dimension, with a static step, and its body only has known side effects
+// on its memref operands.
+static bool isPipelinable(scf::ParallelOp loop) {
+  if (!loop.getInitVals().empty() || !getConstantIntValue(loop.getStep()[0]))
+    return false;
+  WalkResult result = loop.getBody()->walk([](Operation *op) {
+    if (isa<memref::GetGlobalOp>(op) ||
+        (!isa<MemoryEffectOpInterface>(op) &&
+         !op->hasTrait<OpTrait::HasRecursiveMemoryEffects>()))
+      return WalkResult::interrupt();
+    return WalkResult::advance();
+  });
+  return !result.wasInterrupted();
+}
+
+// Returns true if `loop` accesses `buffer` by rows only: each use is a
+// subview at the row of the iteration, at most a step high.
+static bool isRowAccess(scf::ParallelOp loop, Value buffer) {
+  Value row = loop.getInductionVars()[0];
+  int64_t step = *getConstantIntValue(loop.getStep()[0]);
+  for (OpOperand &use : buffer.getUses()) {
+    if (!loop->isProperAncestor(use.getOwner()))
+      continue;
+    auto subview = dyn_cast<memref::SubViewOp>(use.getOwner());
+    if (!subview || subview.getSource() != buffer)
+      return false;
+    std::optional<int64_t> height =
+        getConstantIntValue(subview.getMixedSizes()[0]);
+    if (dyn_cast<Value>(subview.getMixedOffsets()[0]) != row || !height ||
+        *height > step)
+      return false;
+  }
+  return true;
+}
+
+// Returns true if the rows of the loops can run as soon as the same rows of
+// the previous loops are done. The loops share their rows, and the buffers
+// used by several of them are accessed by rows, so that a row only depends
+// on the same row of the previous loops and the rows are independent.
+static bool canPipeline(ArrayRef<scf::ParallelOp> loops) {
+  scf::ParallelOp first = loops.front();
+  DenseMap<Value, unsigned> numLoopsOfBuffer;
+  SmallVector<SetVector<Value>> capturedBuffers;
+  for (scf::ParallelOp loop : loops) {
+    if (!isSameValue(loop.getLowerBound()[0], first.getLowerBound()[0]) ||
+        !isSameValue(loop.getUpperBound()[0], first.getUpperBound()[0]) ||
+        !isSameValue(loop.getStep()[0], first.getStep()[0]))
+      return false;
+    SetVector<Value> captured;
+    getUsedValuesDefinedAbove(loop.getRegion(), captured);
+    auto &buffers = capturedBuffers.emplace_back();
+    llvm::DenseSet<Value> roots;
+    for (Value value : captured) {
+      if (!isa<MemRefType>(value.getType()))
+        continue;
+      buffers.insert(value);
+      if (roots.insert(getRootBuffer(value)).second)
+        ++numLoopsOfBuffer[getRootBuffer(value)];
+    }
+  }
+  for (auto [loop, buffers] : llvm::zip(loops, capturedBuffers)) {
+    for (Value buffer : buffers) {
+      Value root = getRootBuffer(buffer);
+      if (numLoopsOfBuffer[root] < 2)
+        continue;
+      // The rows of the views of a buffer may not line up.
+      if (buffer != root || !isRowAccess(loop, buffer))
+        return false;
+    }
+  }
+  return true;
+}
+
+// Returns ceil((ub - lb) / step).
+static Value getTripCount(OpBuilder &builder, Location loc, Value lb, Value ub,
+                          Value step) {
+  Value range = builder.createOrFold<arith::SubIOp>(loc, ub, lb);
+  return builder.createOrFold<arith::CeilDivSIOp>(loc, range, step);
+}
+
+// Runs the row `row` of `loop` in an async.execute, after `dependency`. The
+// iterations of the row run in their own async.execute, awaited by the row.
+static Value createRowTask(OpBuilder &builder, scf::ParallelOp loop, Value row,
+                           Value dependency) {
+  Location loc = loop.getLoc();
+  SmallVector<Value> dependencies;
+  if (dependency)
+    dependencies.push_back(dependency);
+
+  auto cloneBody = [&](OpBuilder &b, ValueRange ivs) {
+    IRMapping mapping;
+    mapping.map(loop.getInductionVars(), ivs);
+    for (Operation &op : loop.getBody()->without_terminator())
+      b.clone(op, mapping);
+  };
+
+  auto rowTask = builder.create<async::ExecuteOp>(
+      loc, TypeRange{}, dependencies, ValueRange{},
+      [&](OpBuilder &b, Location rowLoc, ValueRange) {
+        if (loop.getNumLoops() == 1) {
+          cloneBody(b, row);
+          b.create<async::YieldOp>(rowLoc, ValueRange{});
+          return;
+        }
+        auto lbs = loop.getLowerBound().drop_front();
+        auto ubs = loop.getUpperBound().drop_front();
+        auto steps = loop.getStep().drop_front();
+        Value numTasks;
+        for (auto [lb, ub, step] : llvm::zip(lbs, ubs, steps)) {
+          Value tripCount = getTripCount(b, rowLoc, lb, ub, step);
+          numTasks = numTasks ? b.createOrFold<arith::MulIOp>(
+                                    rowLoc, numTasks, tripCount)
+                              : tripCount;
+        }
+        Value group = b.create<async::CreateGroupOp>(
+            rowLoc, b.getType<async::GroupType>(), numTasks);
+        scf::buildLoopNest(
+            b, rowLoc, lbs, ubs, steps,
+            [&](OpBuilder &nb, Location nestLoc, ValueRange ivs) {
+              SmallVector<Value> allIvs{row};
+              allIvs.append(ivs.begin(), ivs.end());
+              auto task = nb.create<async::ExecuteOp>(
+                  nestLoc, TypeRange{}, ValueRange{}, ValueRange{},
+                  [&](OpBuilder &tb, Location taskLoc, ValueRange) {
+                    cloneBody(tb, allIvs);
+                    tb.create<async::YieldOp>(taskLoc, ValueRange{});
+                  });
+              nb.create<async::AddToGroupOp>(nestLoc, nb.getIndexType(),
+                                             task.getToken(), group);
+            });
+        b.create<async::AwaitAllOp>(rowLoc, group);
+        b.create<async::YieldOp>(rowLoc, ValueRange{});
+      });
+  return rowTask.getToken();
+}
+
+// Replaces the chain of `loops` by a loop over their rows, launching the row
+// of each loop after the same row of the previous one:
+//
+// scf.for %row {
+//   %t0 = async.execute { <row %row of loop 0> }
+//   %t1 = async.execute [%t0] { <row %row of loop 1> }
+//   ...
+// }
+// async.await_all
+//
+// The deallocations between the loops are moved after the await.
+static void pipelineLoops(RewriterBase &rewriter,
+                          ArrayRef<scf::ParallelOp> loops,
+                          ArrayRef<Operation *> deallocs) {
+  scf::ParallelOp first = loops.front();
+  Location loc = first.getLoc();
+  rewriter.setInsertionPoint(loops.back());
+  Value lb = first.getLowerBound()[0];
+  Value step = first.getStep()[0];
+  Value numRows =
+      getTripCount(rewriter, loc, lb, first.getUpperBound()[0], step);
+  Value rows = rewriter.create<async::CreateGroupOp>(
+      loc, rewriter.getType<async::GroupType>(), numRows);
+  Value zero = rewriter.create<arith::ConstantIndexOp>(loc, 0);
+  Value one = rewriter.create<arith::ConstantIndexOp>(loc, 1);
+  auto rowLoop = rewriter.create<scf::ForOp>(loc, zero, numRows, one);
+  rewriter.setInsertionPointToStart(rowLoop.getBody());
+  Value offset =
+      rewriter.create<arith::MulIOp>(loc, rowLoop.getInductionVar(), step);
+  Value row = rewriter.create<arith::AddIOp>(loc, lb, offset);
+  Value token;
+  for (scf::ParallelOp loop : loops)
+    token = createRowTask(rewriter, loop, row, token);
+  rewriter.create<async::AddToGroupOp>(loc, rewriter.getIndexType(), token,
+                                       rows);
+
+  rewriter.setInsertionPointAfter(rowLoop);
+  auto awaitOp = rewriter.create<async::AwaitAllOp>(loc, rows);
+  for (Operation *dealloc : llvm::reverse(deallocs))
+    rewriter.moveOpAfter(dealloc, awaitOp);
+  for (scf::ParallelOp loop : loops)
+    rewriter.eraseOp(loop);
+}
+
+struct PipelineParallelLayers
+    : public tpp::impl::PipelineParallelLayersBase<PipelineParallelLayers> {
+  void runOnOperation() override {
+    // Chains of pipelinable loops, separated by ops that can be moved after
+    // the first loop of their chain.
+    SmallVector<std::pair<SmallVector<scf::ParallelOp>,
+                          SmallVector<Operation *>>>
+        chains;
+    getOperation().walk([&](Block *block) {
+      SmallVector<scf::ParallelOp> loops;
+      SmallVector<Operation *> deallocs;
+      auto closeChain = [&]() {
+        if (loops.size() > 1)
+          chains.emplace_back(loops, deallocs);
+        loops.clear();
+        deallocs.clear();
+      };
+      for (Operation &op : *block) {
+        if (auto loop = dyn_cast<scf::ParallelOp>(op)) {
+          if (loop->getParentOfType<scf::ParallelOp>() ||
+              !isPipelinable(loop)) {
+            closeChain();
+            continue;
+          }
+          loops.push_back(loop);
+          if (!canPipeline(loops)) {
+            loops.pop_back();
+            closeChain();
+            loops.push_back(loop);
+          }
+          continue;
+        }
+        if (loops.empty())
+          continue;
+        if (isa<memref::DeallocOp>(op)) {
+          deallocs.push_back(&op);
+          continue;
+        }
+        if (op.getNumRegions() == 0 &&
+            (isMemoryEffectFree(&op) ||
+             isa<memref::AllocOp, memref::AllocaOp>(op)))
+          continue;
+        closeChain();
+      }
+      closeChain();
+    });
+
+    IRRewriter rewriter(&getContext());
+    for (auto &[loops, deallocs] : chains)
+      pipelineLoops(rewriter, loops, deallocs);
+  }
+};
+
+} // namespace
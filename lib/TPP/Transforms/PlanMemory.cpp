@@ -0,0 +1,231 @@
+//===- PlanMemory.cpp --------------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the static planning of the intermediate buffers of a
+// function into a single arena.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/IR/SymbolTable.h"
+#include "mlir/Interfaces/CastInterfaces.h"
+#include "mlir/Interfaces/ControlFlowInterfaces.h"
+#include "mlir/Interfaces/ViewLikeInterface.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/MathExtras.h"
+
+#define DEBUG_TYPE "plan-memory"
+
+using namespace mlir;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_PLANMEMORY
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+namespace {
+
+// Alignment of the arena and of the buffers in it, a cache line.
+constexpr static int64_t kArenaAlignment = 64;
+
+// A buffer of the entry block, live from its allocation to its deallocation.
+struct BufferInterval {
+  memref::AllocOp alloc;
+  memref::DeallocOp dealloc;
+  int64_t start;
+  int64_t end;
+  int64_t size;
+  int64_t offset = 0;
+
+  bool overlaps(const BufferInterval &other) const {
+    return start < other.end && other.start < end;
+  }
+};
+
+// Returns the size in bytes of the buffers of `type` that can be placed in
+// the arena: static, with an identity layout in the default memory space.
+static std::optional<int64_t> getPlannableSize(MemRefType type) {
+  if (!type.hasStaticShape() || !type.getLayout().isIdentity() ||
+      type.getMemorySpace() || !type.getElementType().isIntOrFloat())
+    return std::nullopt;
+  return type.getNumElements() *
+         llvm::divideCeil(type.getElementType().getIntOrFloatBitWidth(), 8);
+}
+
+// Returns true if all the uses of `value` and of its views are before
+// `dealloc` and none of them carries the buffer out of its ops, e.g. through
+// a yield.
+static bool isUsedBefore(Value value, memref::DeallocOp dealloc) {
+  Block *block = dealloc->getBlock();
+  SmallVector<Value> worklist{value};
+  while (!worklist.empty()) {
+    Value alias = worklist.pop_back_val();
+    for (Operation *user : alias.getUsers()) {
+      if (user == dealloc.getOperation())
+        continue;
+      Operation *ancestor = block->findAncestorOpInBlock(*user);
+      if (!ancestor || !ancestor->isBeforeInBlock(dealloc))
+        return false;
+      if (isa<ViewLikeOpInterface, CastOpInterface>(user)) {
+        llvm::append_range(worklist, user->getResults());
+        continue;
+      }
+      if (user->hasTrait<OpTrait::IsTerminator>() ||
+          isa<RegionBranchTerminatorOpInterface>(user) ||
+          llvm::any_of(user->getResultTypes(),
+                       [](Type type) { return isa<BaseMemRefType>(type); }))
+        return false;
+    }
+  }
+  return true;
+}
+
+// Collects the buffers allocated and deallocated in the entry block of
+// `funcOp`, the ones whose lifetime is known statically.
+static SmallVector<BufferInterval> collectBuffers(func::FuncOp funcOp) {
+  Block &entry = funcOp.getBody().front();
+  DenseMap<Operation *, int64_t> positions;
+  for (auto [index, op] : llvm::enumerate(entry))
+    positions[&op] = index;
+
+  SmallVector<BufferInterval> buffers;
+  for (auto alloc : entry.getOps<memref::AllocOp>()) {
+    std::optional<int64_t> size = getPlannableSize(alloc.getType());
+    if (!size || !alloc.getDynamicSizes().empty() ||
+        !alloc.getSymbolOperands().empty())
+      continue;
+    SmallVector<memref::DeallocOp> deallocs;
+    for (Operation *user : alloc->getUsers()) {
+      if (auto dealloc = dyn_cast<memref::DeallocOp>(user))
+        deallocs.push_back(dealloc);
+    }
+    if (deallocs.size() != 1 || deallocs[0]->getBlock() != &entry ||
+        !isUsedBefore(alloc.getResult(), deallocs[0]))
+      continue;
+    buffers.push_back({alloc, deallocs[0], positions[alloc],
+                       positions[deallocs[0]], *size});
+  }
+  return buffers;
+}
+
+// Assigns the offsets of `buffers` in the arena and returns its size. The
+// largest buffers are placed first, each one at the lowest aligned offset
+// that does not overlap the buffers live at the same time.
+static int64_t assignOffsets(MutableArrayRef<BufferInterval> buffers,
+                             int64_t alignment) {
+  SmallVector<BufferInterval *> order;
+  for (BufferInterval &buffer : buffers)
+    order.push_back(&buffer);
+  llvm::stable_sort(order, [](BufferInterval *lhs, BufferInterval *rhs) {
+    return lhs->size > rhs->size;
+  });
+
+  int64_t arenaSize = 0;
+  SmallVector<BufferInterval *> placed;
+  for (BufferInterval *buffer : order) {
+    SmallVector<BufferInterval *> live;
+    for (BufferInterval *other : placed) {
+      if (buffer->overlaps(*other))
+        live.push_back(other);
+    }
+    llvm::sort(live, [](BufferInterval *lhs, BufferInterval *rhs) {
+      return lhs->offset < rhs->offset;
+    });
+    int64_t offset = 0;
+    for (BufferInterval *other : live) {
+      if (offset + buffer->size <= other->offset)
+        break;
+      offset = std::max(offset,
+                        llvm::alignTo(other->offset + other->size, alignment));
+    }
+    buffer->offset = offset;
+    arenaSize = std::max(arenaSize, offset + buffer->size);
+    placed.push_back(buffer);
+  }
+  return llvm::alignTo(arenaSize, alignment);
+}
+
+// Packs the intermediate buffers of the functions into one arena per
+// function. The arena is allocated once per call, or once for the program
+// with `globalArena`.
+struct PlanMemory : public tpp::impl::PlanMemoryBase<PlanMemory> {
+  using PlanMemoryBase::PlanMemoryBase;
+
+  void runOnOperation() override {
+    ModuleOp module = getOperation();
+    SymbolTable symbolTable(module);
+    SmallVector<func::FuncOp> funcOps(module.getOps<func::FuncOp>());
+    for (func::FuncOp funcOp : funcOps) {
+      if (!funcOp.isExternal())
+        planFunction(funcOp, symbolTable);
+    }
+  }
+
+private:
+  void planFunction(func::FuncOp funcOp, SymbolTable &symbolTable) {
+    SmallVector<BufferInterval> buffers = collectBuffers(funcOp);
+    // A single buffer only gains from the arena when it is hoisted.
+    if (buffers.empty() || (!globalArena && buffers.size() < 2))
+      return;
+
+    int64_t alignment = kArenaAlignment;
+    for (BufferInterval &buffer : buffers) {
+      alignment = std::max<int64_t>(
+          alignment, buffer.alloc.getAlignment().value_or(0));
+    }
+    int64_t arenaSize = assignOffsets(buffers, alignment);
+    LLVM_DEBUG({
+      int64_t totalSize = 0;
+      for (BufferInterval &buffer : buffers)
+        totalSize += buffer.size;
+      llvm::dbgs() << "[" DEBUG_TYPE "] " << funcOp.getSymName() << ": "
+                   << buffers.size() << " buffers of " << totalSize
+                   << " bytes in an arena of " << arenaSize << " bytes\n";
+    });
+
+    Block &entry = funcOp.getBody().front();
+    Location loc = funcOp.getLoc();
+    IRRewriter rewriter(funcOp.getContext());
+    rewriter.setInsertionPointToStart(&entry);
+    auto arenaType = MemRefType::get({arenaSize}, rewriter.getI8Type());
+    Value arena;
+    if (globalArena) {
+      OpBuilder::InsertionGuard guard(rewriter);
+      rewriter.setInsertionPoint(funcOp);
+      auto globalOp = rewriter.create<memref::GlobalOp>(
+          loc, ("__arena_" + funcOp.getSymName()).str(),
+          rewriter.getStringAttr("private"), arenaType,
+          rewriter.getUnitAttr(), /*constant=*/false,
+          rewriter.getI64IntegerAttr(alignment));
+      symbolTable.insert(globalOp);
+      arena = rewriter.create<memref::GetGlobalOp>(loc, arenaType,
+                                                   globalOp.getSymName());
+    } else {
+      arena = rewriter.create<memref::AllocOp>(
+          loc, arenaType, rewriter.getI64IntegerAttr(alignment));
+      rewriter.setInsertionPoint(entry.getTerminator());
+      rewriter.create<memref::DeallocOp>(loc, arena);
+    }
+
+    for (BufferInterval &buffer : buffers) {
+      rewriter.setInsertionPoint(buffer.alloc);
+      Value offset = rewriter.create<arith::ConstantIndexOp>(
+          buffer.alloc.getLoc(), buffer.offset);
+      rewriter.replaceOpWithNewOp<memref::ViewOp>(
+          buffer.alloc, buffer.alloc.getType(), arena, offset, ValueRange{});
+      rewriter.eraseOp(buffer.dealloc);
+    }
+  }
+};
+
+} // namespace
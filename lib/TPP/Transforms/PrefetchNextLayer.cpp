@@ -0,0 +1,255 @@
+//===- PrefetchNextLayer.cpp -------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the prefetching of the weights of the next layer while
+// the parallel loop of the previous one computes.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/Linalg/IR/LinalgInterfaces.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/IR/Dominance.h"
+#include "mlir/IR/IRMapping.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "llvm/Support/Debug.h"
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_PREFETCHNEXTLAYER
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+using namespace mlir;
+
+#define DEBUG_TYPE "prefetch-next-layer"
+
+// Prefetches are issued per cache line.
+static constexpr int64_t kCacheLineBytes = 64;
+
+namespace {
+
+// Static iteration space of a scf.forall.
+struct IterationSpace {
+  SmallVector<int64_t> lowerBounds;
+  SmallVector<int64_t> steps;
+  SmallVector<int64_t> tripCounts;
+
+  int64_t getNumIterations() const {
+    int64_t iterations = 1;
+    for (int64_t tripCount : tripCounts)
+      iterations *= tripCount;
+    return iterations;
+  }
+};
+
+} // namespace
+
+static std::optional<IterationSpace> getIterationSpace(scf::ForallOp loop) {
+  IterationSpace space;
+  for (auto [lbOfr, ubOfr, stepOfr] :
+       llvm::zip(loop.getMixedLowerBound(), loop.getMixedUpperBound(),
+                 loop.getMixedStep())) {
+    std::optional<int64_t> lb = getConstantIntValue(lbOfr);
+    std::optional<int64_t> ub = getConstantIntValue(ubOfr);
+    std::optional<int64_t> step = getConstantIntValue(stepOfr);
+    if (!lb || !ub || !step || *step <= 0 || *ub <= *lb)
+      return std::nullopt;
+    space.lowerBounds.push_back(*lb);
+    space.steps.push_back(*step);
+    space.tripCounts.push_back(llvm::divideCeil(*ub - *lb, *step));
+  }
+  return space;
+}
+
+// Returns the weight panels read by the contractions of `loop`: static
+// subviews of buffers defined before `prevLoop`, which change with the
+// iterations of `loop`.
+static SmallVector<memref::SubViewOp> getWeightPanels(scf::ForallOp loop,
+                                                      scf::ForallOp prevLoop,
+                                                      DominanceInfo &domInfo) {
+  SmallVector<memref::SubViewOp> panels;
+  loop.getBody()->walk([&](linalg::LinalgOp linalgOp) {
+    if (!linalg::isaContractionOpInterface(linalgOp) ||
+        !linalgOp.hasPureBufferSemantics() || linalgOp.getNumDpsInputs() != 2)
+      return;
+    auto panel = linalgOp.getDpsInputs()[1].getDefiningOp<memref::SubViewOp>();
+    if (!panel || !panel.getType().hasStaticShape() ||
+        panel->getParentOfType<scf::ForallOp>() != loop ||
+        !domInfo.properlyDominates(panel.getSource(), prevLoop) ||
+        llvm::all_of(panel.getOffsets(), [&](Value offset) {
+          return !loop->isAncestor(offset.getParentBlock()->getParentOp());
+        }))
+      return;
+    if (!llvm::is_contained(panels, panel))
+      panels.push_back(panel);
+  });
+  return panels;
+}
+
+// Clones the computation of the index `value` of the body of `loop` at the
+// insertion point of `builder`, from the values of the induction variables in
+// `mapping`. Returns null if it depends on other values of the body or on
+// values not available at the insertion point.
+static Value cloneIndex(OpBuilder &builder, Value value, scf::ForallOp loop,
+                        IRMapping &mapping, DominanceInfo &domInfo) {
+  if (Value mapped = mapping.lookupOrNull(value))
+    return mapped;
+  if (!loop->isAncestor(value.getParentBlock()->getParentOp())) {
+    Operation *insertionOp = &*builder.getInsertionPoint();
+    return domInfo.properlyDominates(value, insertionOp) ? value : nullptr;
+  }
+  Operation *op = value.getDefiningOp();
+  if (!op || !isPure(op) || op->getNumRegions() != 0)
+    return nullptr;
+  for (Value operand : op->getOperands()) {
+    if (!cloneIndex(builder, operand, loop, mapping, domInfo))
+      return nullptr;
+  }
+  builder.clone(*op, mapping);
+  return mapping.lookup(value);
+}
+
+// Prefetches, at the start of the body of `prevLoop`, the weight `panels` of
+// the iteration of `loop` the thread of the current iteration of `prevLoop`
+// runs. The iterations are distributed in contiguous blocks to the threads, a
+// thread runs the same fraction of the iterations of both loops: iteration k
+// of n of `prevLoop` maps to iteration k * m / n of m of `loop`.
+static bool prefetchPanels(scf::ForallOp prevLoop, const IterationSpace &prev,
+                           scf::ForallOp loop, const IterationSpace &next,
+                           ArrayRef<memref::SubViewOp> panels,
+                           DominanceInfo &domInfo) {
+  OpBuilder builder = OpBuilder::atBlockBegin(prevLoop.getBody());
+  Location loc = prevLoop.getLoc();
+  auto cst = [&](int64_t value) -> Value {
+    return builder.create<arith::ConstantIndexOp>(loc, value);
+  };
+
+  // Linear index of the current iteration, row-major.
+  Value iteration = cst(0);
+  for (auto [iv, lb, step, tripCount] :
+       llvm::zip(prevLoop.getInductionVars(), prev.lowerBounds, prev.steps,
+                 prev.tripCounts)) {
+    Value coord = builder.create<arith::DivUIOp>(
+        loc, builder.create<arith::SubIOp>(loc, iv, cst(lb)), cst(step));
+    iteration = builder.create<arith::AddIOp>(
+        loc, builder.create<arith::MulIOp>(loc, iteration, cst(tripCount)),
+        coord);
+  }
+  Value nextIteration = builder.create<arith::DivUIOp>(
+      loc, builder.create<arith::MulIOp>(loc, iteration,
+                                         cst(next.getNumIterations())),
+      cst(prev.getNumIterations()));
+
+  IRMapping mapping;
+  for (int64_t dim = next.tripCounts.size() - 1; dim >= 0; dim--) {
+    Value coord =
+        builder.create<arith::RemUIOp>(loc, nextIteration,
+                                       cst(next.tripCounts[dim]));
+    nextIteration = builder.create<arith::DivUIOp>(loc, nextIteration,
+                                                   cst(next.tripCounts[dim]));
+    mapping.map(loop.getInductionVars()[dim],
+                builder.create<arith::AddIOp>(
+                    loc, cst(next.lowerBounds[dim]),
+                    builder.create<arith::MulIOp>(loc, coord,
+                                                  cst(next.steps[dim]))));
+  }
+
+  bool prefetched = false;
+  for (memref::SubViewOp panel : panels) {
+    SmallVector<OpFoldResult> mixedOperands[3] = {
+        panel.getMixedOffsets(), panel.getMixedSizes(),
+        panel.getMixedStrides()};
+    bool cloned = true;
+    for (SmallVector<OpFoldResult> &operands : mixedOperands) {
+      for (OpFoldResult &ofr : operands) {
+        auto value = dyn_cast<Value>(ofr);
+        if (!value)
+          continue;
+        Value nextValue = cloneIndex(builder, value, loop, mapping, domInfo);
+        if (!nextValue) {
+          cloned = false;
+          break;
+        }
+        ofr = nextValue;
+      }
+    }
+    if (!cloned)
+      continue;
+
+    // Prefetch the panel into L2, a line of its last dimension at a time.
+    MemRefType panelType = panel.getType();
+    Value nextPanel = builder.create<memref::SubViewOp>(
+        loc, panelType, panel.getSource(), mixedOperands[0], mixedOperands[1],
+        mixedOperands[2]);
+    int64_t elementBytes =
+        llvm::divideCeil(panelType.getElementTypeBitWidth(), 8);
+    int64_t lineElements = std::max<int64_t>(kCacheLineBytes / elementBytes, 1);
+    SmallVector<Value> lbs, ubs, steps;
+    for (int64_t size : panelType.getShape()) {
+      lbs.push_back(cst(0));
+      ubs.push_back(cst(size));
+      steps.push_back(cst(1));
+    }
+    if (!steps.empty())
+      steps.back() = cst(lineElements);
+    scf::buildLoopNest(
+        builder, loc, lbs, ubs, steps,
+        [&](OpBuilder &nestBuilder, Location loc, ValueRange indices) {
+          nestBuilder.create<memref::PrefetchOp>(loc, nextPanel, indices,
+                                                 /*isWrite=*/false,
+                                                 /*localityHint=*/2,
+                                                 /*isDataCache=*/true);
+        });
+    prefetched = true;
+  }
+  return prefetched;
+}
+
+namespace {
+
+struct PrefetchNextLayer
+    : public tpp::impl::PrefetchNextLayerBase<PrefetchNextLayer> {
+  void runOnOperation() override {
+    DominanceInfo &domInfo = getAnalysis<DominanceInfo>();
+
+    // The layers are consecutive parallel loops of the same block.
+    SmallVector<std::pair<scf::ForallOp, scf::ForallOp>> layers;
+    getOperation()->walk([&](Block *block) {
+      scf::ForallOp prevLoop;
+      for (auto loop : block->getOps<scf::ForallOp>()) {
+        if (prevLoop)
+          layers.emplace_back(prevLoop, loop);
+        prevLoop = loop;
+      }
+    });
+
+    for (auto [prevLoop, loop] : layers) {
+      std::optional<IterationSpace> prev = getIterationSpace(prevLoop);
+      std::optional<IterationSpace> next = getIterationSpace(loop);
+      if (!prev || !next)
+        continue;
+      SmallVector<memref::SubViewOp> panels =
+          getWeightPanels(loop, prevLoop, domInfo);
+      if (panels.empty())
+        continue;
+      if (prefetchPanels(prevLoop, *prev, loop, *next, panels, domInfo)) {
+        LLVM_DEBUG(llvm::dbgs() << "Prefetching " << panels.size()
+                                << " weight panels of " << loop << "\n");
+      }
+    }
+  }
+};
+
+} // namespace
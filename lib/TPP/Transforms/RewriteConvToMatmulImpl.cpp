@@ -9,198 +9,126 @@
 #include "TPP/IR/StructuredOpMatcher.h"
 #include "TPP/Transforms/Transforms.h"
 #include "TPP/Transforms/Utils/TransformUtils.h"
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
 #include "mlir/Dialect/Linalg/Utils/Utils.h"
 #include "mlir/IR/BuiltinTypes.h"
 
 using namespace mlir;
 
-// Return the size of the image slice to extract and use into the GEMM
-// operation. If we have a slide window (R and S are not 1). The size
-// of the image slice depend on the filter and on the output.
-static SmallVector<OpFoldResult>
-computeSizeGemmForImage(OpBuilder &builder, linalg::LinalgOp linalgOp) {
-  OpOperand *image = linalgOp.getDpsInputOperands()[0];
-  unsigned rank = cast<ShapedType>(image->get().getType()).getRank();
-  SmallVector<OpFoldResult> sizes;
-  sizes.reserve(rank);
-
-  // All other dimesions but the last two are not involved and we
-  // can simply use size of 1.
-  for (size_t idx = 0, e = rank - /*GEMM operand size=*/2; idx < e; idx++)
-    sizes.push_back(builder.getIndexAttr(1));
-
-  Value output = linalgOp.getDpsInits()[0];
-  OpOperand *filter = linalgOp.getDpsInputOperands()[1];
-  ArrayRef<int64_t> outputShape = cast<ShapedType>(output.getType()).getShape();
-  ArrayRef<int64_t> filterShape =
-      cast<ShapedType>(filter->get().getType()).getShape();
-  int64_t mIdx = outputShape.size() - 2;
-  int64_t kIdx = filterShape.size() - 2;
-  sizes.push_back(
-      linalg::createFoldedDimOp(builder, linalgOp.getLoc(), output, mIdx));
-  sizes.push_back(linalg::createFoldedDimOp(builder, linalgOp.getLoc(),
-                                            filter->get(), kIdx));
-  return sizes;
-}
+// The GEMM loop a result of an operand map is a function of, if any, and its
+// coefficient.
+using GemmAccess = std::pair<std::optional<unsigned>, int64_t>;
 
-// Return success if `expr` is either a dimExpr or a mul expression dim * cst OR
-// cst * dim.
-static LogicalResult isDimExprOrMulExpr(AffineExpr expr,
-                                        AffineExpr &multiplicativeFactor) {
-  if (auto dimExpr = dyn_cast<AffineDimExpr>(expr))
-    return success();
-  if (auto mulExpr = dyn_cast<AffineBinaryOpExpr>(expr)) {
-    if (mulExpr.getKind() != AffineExprKind::Mul)
-      return failure();
-    auto lhs = mulExpr.getLHS();
-    auto rhs = mulExpr.getRHS();
-    // Assert if we find a symbol. We need to check that we don't have them in
-    // the preconditions for this pattern. `verifyConvolutionInterface` allows
-    // them.
-    if (auto symbol = dyn_cast<AffineSymbolExpr>(lhs))
-      assert(false && "unexpected symbol expr");
-    if (auto symbol = dyn_cast<AffineSymbolExpr>(rhs))
-      assert(false && "unexpected symbol expr");
-    // If the lhs is a constant the rhs is a dim and viceversa.
-    if (auto constant = dyn_cast<AffineConstantExpr>(lhs)) {
-      if (auto dim = dyn_cast<AffineDimExpr>(rhs)) {
-        multiplicativeFactor = multiplicativeFactor * constant.getValue();
-        return success();
-      }
-      return failure();
+// Return, for each result of the operand map `map`, the GEMM loop the result
+// is a function of and the coefficient of this loop (e.g., the stride on W of
+// the image). The GEMM loops are the loops after the `numIvs` materialized
+// ones. A result that only depends on the materialized loops has no GEMM
+// loop. Fail if a result is a function of two GEMM loops, this would need an
+// im2col copy, or if the operand does not have `rank` GEMM dimensions.
+static FailureOr<SmallVector<GemmAccess>>
+getGemmAccesses(AffineMap map, unsigned numIvs, unsigned rank) {
+  if (map.getNumSymbols() != 0)
+    return failure();
+  unsigned numLoops = map.getNumDims();
+  SmallVector<GemmAccess> accesses;
+  unsigned gemmRank = 0;
+  for (AffineExpr result : map.getResults()) {
+    std::optional<unsigned> gemmLoop;
+    for (unsigned pos = numIvs; pos < numLoops; pos++) {
+      if (!result.isFunctionOfDim(pos))
+        continue;
+      if (gemmLoop)
+        return failure();
+      gemmLoop = pos;
     }
-    if (auto constant = dyn_cast<AffineConstantExpr>(rhs)) {
-      if (auto dim = dyn_cast<AffineDimExpr>(lhs)) {
-        multiplicativeFactor = multiplicativeFactor * constant.getValue();
-        return success();
-      }
-      return failure();
+    if (!gemmLoop) {
+      accesses.push_back({std::nullopt, 1});
+      continue;
     }
-    return failure();
-  }
-  return failure();
-}
-
-// Walk `convExpr` in pre-order and extract a constant if any.
-[[maybe_unused]] static LogicalResult walkConvExpr(AffineExpr convExpr,
-                                  AffineExpr &multiplicativeFactor) {
-  if (auto dimExpr = dyn_cast<AffineDimExpr>(convExpr))
-    return success();
-  if (auto binExpr = dyn_cast<AffineBinaryOpExpr>(convExpr)) {
-    if (binExpr.getKind() != AffineExprKind::Add)
+    std::optional<int64_t> stride =
+        linalgx::utils::getDimCoefficient(result, *gemmLoop);
+    if (!stride || *stride <= 0)
       return failure();
-    return success(
-        succeeded(isDimExprOrMulExpr(binExpr.getLHS(), multiplicativeFactor)) &&
-        succeeded(isDimExprOrMulExpr(binExpr.getRHS(), multiplicativeFactor)));
+    accesses.push_back({gemmLoop, *stride});
+    gemmRank++;
   }
-  return failure();
+  if (gemmRank != rank)
+    return failure();
+  return accesses;
 }
 
-static FailureOr<Value> getSlicedConvOperandImpl(OpBuilder &builder,
-                                                 linalg::LinalgOp linalgOp,
-                                                 OpOperand *operand,
-                                                 ValueRange ivs,
-                                                 ValueRange valuesToUse) {
+// Extract the slice of `operand` used by the GEMM at the materialized
+// induction variables `ivs`. The offset of each dimension is the result of
+// the operand map evaluated at `ivs` with the GEMM loops at zero, this keeps
+// the strides and dilations the outer loops are scaled by. The GEMM
+// dimensions take the full range of their loop at their stride.
+static FailureOr<Value> getSlicedConvOperand(OpBuilder &builder,
+                                             linalg::LinalgOp linalgOp,
+                                             OpOperand *operand, ValueRange ivs,
+                                             ValueRange valuesToUse,
+                                             unsigned desiredResultRank) {
   Value operandToUse = valuesToUse[operand->getOperandNumber()];
-  ShapedType operandType = cast<ShapedType>(operandToUse.getType());
-  size_t rank = operandType.getRank();
-  bool isImage = operand->getOperandNumber() == 0;
-  unsigned desiredResultRank = 2;
-
-  SmallVector<OpFoldResult> offsets, sizes;
-  offsets.reserve(rank);
-  sizes.reserve(rank);
-
-  // Offset into the tensor is the induction var or 0.
-  for (size_t idx = 0, e = ivs.size(); idx < e; idx++)
-    offsets.push_back(ivs[idx]);
-  for (size_t idx = ivs.size(), e = rank; idx < e; idx++)
-    offsets.push_back(builder.getIndexAttr(0));
-
-  // If the filter has R and S not 1 we need to deal with a sliding window. The
-  // sizes of the matmul depend on the filter and output, use
-  // `computeSizeGemmForImage` to compute them.
-  if (isImage) {
-    sizes = computeSizeGemmForImage(builder, linalgOp);
-  } else {
-    // Get full sizes from [rank - desiredResultRank, rank).
-    for (size_t idx = 0, e = rank - desiredResultRank; idx < e; idx++)
-      sizes.push_back(builder.getIndexAttr(1));
-    for (size_t idx = rank - desiredResultRank, e = rank; idx < e; idx++)
-      sizes.push_back(linalg::createFoldedDimOp(builder, linalgOp.getLoc(),
-                                                operand->get(), idx));
+  AffineMap map = linalgOp.getMatchingIndexingMap(operand);
+  unsigned numIvs = ivs.size();
+  auto accesses = getGemmAccesses(map, numIvs, desiredResultRank);
+  if (failed(accesses))
+    return failure();
+
+  Location loc = linalgOp.getLoc();
+  MLIRContext *ctx = linalgOp.getContext();
+  SmallVector<int64_t> loopRanges = linalgOp.getStaticLoopRanges();
+  SmallVector<AffineExpr> gemmLoopsAtZero;
+  for (unsigned pos = 0, e = map.getNumDims(); pos < e; pos++) {
+    gemmLoopsAtZero.push_back(pos < numIvs ? getAffineDimExpr(pos, ctx)
+                                           : getAffineConstantExpr(0, ctx));
   }
 
-  // We need to take into accound possible strides on W. Strides on the H
-  // are already computed using affine maps as the loops iterating over H are
-  // materialized. The W dimension is the last - 1 dimension.
-  SmallVector<OpFoldResult> strides(rank, builder.getIndexAttr(1));
-  if (isImage) {
-    AffineMap imageMap = linalgOp.getMatchingIndexingMap(operand);
-    [[maybe_unused]] AffineExpr wExpr = imageMap.getResult(imageMap.getNumResults() - 2);
-    AffineExpr multiplicativeFactor =
-        getAffineConstantExpr(1, linalgOp.getContext());
-    // By definition a convolution affine expression can either be:
-    // a) AffineDimExpr
-    // b) AffineDimExpr + AffineDimExpr
-    // c) AffineDimExpr * AffineConstantExpr/AffineSymbolExpr + AffineDimExpr
-    assert(succeeded(walkConvExpr(wExpr, multiplicativeFactor)) &&
-           "something went really wrong");
-    strides[strides.size() - 2] = builder.getIndexAttr(
-        cast<AffineConstantExpr>(multiplicativeFactor).getValue());
+  SmallVector<OpFoldResult> offsets, sizes, strides;
+  for (auto [result, access] : llvm::zip(map.getResults(), *accesses)) {
+    AffineMap offsetMap = AffineMap::get(
+        numIvs, /*symbolCount=*/0, result.replaceDims(gemmLoopsAtZero));
+    offsets.push_back(affine::makeComposedFoldedAffineApply(
+        builder, loc, offsetMap, getAsOpFoldResult(ivs)));
+    auto [gemmLoop, stride] = access;
+    sizes.push_back(builder.getIndexAttr(gemmLoop ? loopRanges[*gemmLoop] : 1));
+    strides.push_back(builder.getIndexAttr(stride));
   }
   return linalgx::utils::getSliceOperand(builder, linalgOp, operandToUse,
                                          offsets, sizes, strides,
                                          desiredResultRank);
 }
 
-// Extract the sliced version of `operand` such that we can use it in a
-// linalg.matmul.
-static FailureOr<Value> getSlicedConvOperand(OpBuilder &builder,
-                                             OpOperand *operand,
-                                             linalg::LinalgOp linalgOp,
-                                             ValueRange ivs,
-                                             ValueRange valuesToUse) {
-  Location loc = linalgOp.getLoc();
-  FailureOr<SmallVector<Value>> involvedDimForOperand =
-      linalgx::utils::getInvolvedLocalDimsForOperand(
-          builder, loc, operand, linalgOp.getMatchingIndexingMap(operand), ivs);
-  if (failed(involvedDimForOperand))
-    return failure();
-  return getSlicedConvOperandImpl(builder, linalgOp, operand,
-                                  *involvedDimForOperand, valuesToUse);
+// Return true if the image, the filter and the output can be sliced to
+// operands of rank `ranks` with the `numIvs` outermost loops materialized.
+static bool canSliceConvOperands(linalg::LinalgOp linalgOp, unsigned numIvs,
+                                 ArrayRef<unsigned> ranks) {
+  for (auto [operand, rank] : llvm::zip(linalgOp->getOpOperands(), ranks)) {
+    if (failed(getGemmAccesses(linalgOp.getMatchingIndexingMap(&operand),
+                               numIvs, rank)))
+      return false;
+  }
+  return true;
 }
 
+// Extract the sliced image, filter and output, with ranks `ranks`: 2, 2 and 2
+// for a matmul, 3, 3 and 2 for a BRGEMM.
 static FailureOr<SmallVector<Value>>
 getSlicedConvOperands(OpBuilder &builder, ValueRange localIvs,
-                      linalg::LinalgOp linalgOp, ValueRange valuesToUse) {
+                      linalg::LinalgOp linalgOp, ValueRange valuesToUse,
+                      ArrayRef<unsigned> ranks) {
   assert(linalgOp->getNumOperands() == 3 && "expect 3 input/output operands");
   assert(linalgOp.getDpsInputOperands().size() == 2 &&
          "expect 2 input operands");
 
   SmallVector<Value> slicedOperands;
-  OpOperand *image = linalgOp.getDpsInputOperands()[0];
-  FailureOr<Value> slicedImage =
-      getSlicedConvOperand(builder, image, linalgOp, localIvs, valuesToUse);
-
-  if (failed(slicedImage))
-    return failure();
-  slicedOperands.push_back(*slicedImage);
-
-  OpOperand *filter = linalgOp.getDpsInputOperands()[1];
-  FailureOr<Value> slicedFilter =
-      getSlicedConvOperand(builder, filter, linalgOp, localIvs, valuesToUse);
-  if (failed(slicedFilter))
-    return failure();
-  slicedOperands.push_back(*slicedFilter);
-
-  OpOperand &output = linalgOp.getDpsInitsMutable()[0];
-  FailureOr<Value> slicedOutput =
-      getSlicedConvOperand(builder, &output, linalgOp, localIvs, valuesToUse);
-  if (failed(slicedOutput))
-    return failure();
-  slicedOperands.push_back(*slicedOutput);
+  for (auto [operand, rank] : llvm::zip(linalgOp->getOpOperands(), ranks)) {
+    FailureOr<Value> slicedOperand = getSlicedConvOperand(
+        builder, linalgOp, &operand, localIvs, valuesToUse, rank);
+    if (failed(slicedOperand))
+      return failure();
+    slicedOperands.push_back(*slicedOperand);
+  }
 
   return slicedOperands;
 }
@@ -222,22 +150,36 @@ static bool checkMappingToMatmul(linalg::LinalgOp linalgOp) {
   return isMatmulLike.match(linalgOp);
 }
 
-FailureOr<linalg::MatmulOp>
-mlir::linalgx::rewriteConvToMatmul(RewriterBase &rewriter,
-                                   linalg::LinalgOp linalgOp) {
-  if (!llvm::isa_and_nonnull<linalg::GenericOp>(linalgOp))
-    return rewriter.notifyMatchFailure(linalgOp, "require a linalg.generic");
-
-  if (failed(mlir::linalg::detail::verifyConvolutionInterface(linalgOp)))
-    return rewriter.notifyMatchFailure(linalgOp,
-                                       "operation is not a convolution");
+// Check if the four innermost loops can be mapped to a BRGEMM operation.
+// Check also the body and make sure it is a matmul-like.
+static bool checkMappingToBrgemm(linalg::LinalgOp linalgOp) {
+  // clang-format off
+  using namespace mlir::structured_match;
+  auto isBrgemmLike =
+    StructuredOpMatcher::make<linalg::LinalgOp>()
+      .operation(NumOfLoops(GreaterThanOrEqualTo(4)))
+      .dim(MatchRange(/*lowerBound=*/0, /*upperBound=*/4),
+          {utils::IteratorType::reduction, utils::IteratorType::parallel,
+           utils::IteratorType::parallel, utils::IteratorType::reduction})
+      .region(MatchOne(0), WithOpChain<KindMul, KindAdd>(
+                                     /*captures=*/nullptr));
+  // clang-format on
+  return isBrgemmLike.match(linalgOp);
+}
 
-  if (!checkMappingToMatmul(linalgOp))
+// Materialize all but the `numGemmLoops` innermost loops of the convolution
+// and map the innermost ones to the operation created by `buildGemm` on the
+// operands sliced to `ranks`.
+static FailureOr<Operation *> rewriteConvToGemm(
+    RewriterBase &rewriter, linalg::LinalgOp linalgOp, unsigned numGemmLoops,
+    ArrayRef<unsigned> ranks,
+    function_ref<Operation *(OpBuilder &, Location, ValueRange)> buildGemm) {
+  // peel-out all loops but the GEMM ones.
+  unsigned upTo = linalgOp.getNumLoops() - numGemmLoops;
+  if (!canSliceConvOperands(linalgOp, upTo, ranks))
     return rewriter.notifyMatchFailure(
-        linalgOp, "cannot match operation iterators with matmul iterators");
+        linalgOp, "cannot slice the operands without an im2col copy");
 
-  // peel-out all loops but the three innermost.
-  unsigned upTo = linalgOp.getNumLoops() - /*GEMM loops=*/3;
   FailureOr<SmallVector<Range>> maybeLoopRanges =
       linalgx::utils::getLoopsToMaterialize(rewriter, linalgOp, upTo);
   if (failed(maybeLoopRanges))
@@ -245,15 +187,15 @@ mlir::linalgx::rewriteConvToMatmul(RewriterBase &rewriter,
   SmallVector<Range> loopRanges = *maybeLoopRanges;
 
   SmallVector<Value> ivs, tensorResults;
-  linalg::MatmulOp matmul = nullptr;
+  Operation *gemm = nullptr;
   auto gemmBuilder = [&](OpBuilder &builder, Location loc, ValueRange localIvs,
                          ValueRange operandsValuesToUse) -> scf::ValueVector {
     assert(operandsValuesToUse.size() ==
                static_cast<size_t>(linalgOp->getNumOperands()) &&
            "expect the number of operands and inputs and outputs to match");
     ivs.assign(localIvs.begin(), localIvs.end());
-    FailureOr<SmallVector<Value>> maybeSlicedOperands =
-        getSlicedConvOperands(builder, localIvs, linalgOp, operandsValuesToUse);
+    FailureOr<SmallVector<Value>> maybeSlicedOperands = getSlicedConvOperands(
+        builder, localIvs, linalgOp, operandsValuesToUse, ranks);
     if (failed(maybeSlicedOperands)) {
       assert(0 && "failed to generate loops for op");
       return {};
@@ -261,16 +203,9 @@ mlir::linalgx::rewriteConvToMatmul(RewriterBase &rewriter,
     SmallVector<Value> slicedOperands = *maybeSlicedOperands;
     assert(slicedOperands.size() == 3 && "expect three operands");
 
-    matmul = (linalgOp.hasPureTensorSemantics())
-                 ? builder.create<linalg::MatmulOp>(
-                       loc, slicedOperands[2].getType(),
-                       ValueRange{slicedOperands[0], slicedOperands[1]},
-                       slicedOperands[2])
-                 : builder.create<linalg::MatmulOp>(
-                       loc, ValueRange{slicedOperands[0], slicedOperands[1]},
-                       slicedOperands[2]);
+    gemm = buildGemm(builder, loc, slicedOperands);
     tensorResults = insertSlicesBack(builder, loc, linalgOp, slicedOperands,
-                                     matmul->getResults());
+                                     gemm->getResults());
 
     return scf::ValueVector(tensorResults.begin(), tensorResults.end());
   };
@@ -307,6 +242,126 @@ mlir::linalgx::rewriteConvToMatmul(RewriterBase &rewriter,
 
   rewriter.replaceOp(linalgOp, outermostLoop ? outermostLoop->getResults()
                                              : tensorResults);
-  assert(matmul && "invalid return");
-  return matmul;
+  assert(gemm && "invalid return");
+  return gemm;
+}
+
+// Common preconditions to map a convolution to a GEMM-like operation.
+static LogicalResult checkConvolution(RewriterBase &rewriter,
+                                      linalg::LinalgOp linalgOp) {
+  if (!llvm::isa_and_nonnull<linalg::GenericOp>(linalgOp))
+    return rewriter.notifyMatchFailure(linalgOp, "require a linalg.generic");
+
+  if (failed(mlir::linalg::detail::verifyConvolutionInterface(linalgOp)))
+    return rewriter.notifyMatchFailure(linalgOp,
+                                       "operation is not a convolution");
+
+  if (linalgOp.hasDynamicShape())
+    return rewriter.notifyMatchFailure(linalgOp, "require static shapes");
+  return success();
+}
+
+// Build a `GemmOpTy` computing the sliced output from the sliced image and
+// filter.
+template <typename GemmOpTy>
+static Operation *buildGemmOp(OpBuilder &builder, Location loc,
+                              ValueRange slicedOperands) {
+  if (isa<RankedTensorType>(slicedOperands[2].getType())) {
+    return builder.create<GemmOpTy>(
+        loc, slicedOperands[2].getType(),
+        ValueRange{slicedOperands[0], slicedOperands[1]}, slicedOperands[2]);
+  }
+  return builder.create<GemmOpTy>(
+      loc, ValueRange{slicedOperands[0], slicedOperands[1]}, slicedOperands[2]);
+}
+
+FailureOr<linalg::MatmulOp>
+mlir::linalgx::rewriteConvToMatmul(RewriterBase &rewriter,
+                                   linalg::LinalgOp linalgOp) {
+  if (failed(checkConvolution(rewriter, linalgOp)))
+    return failure();
+
+  if (!checkMappingToMatmul(linalgOp))
+    return rewriter.notifyMatchFailure(
+        linalgOp, "cannot match operation iterators with matmul iterators");
+
+  FailureOr<Operation *> matmul =
+      rewriteConvToGemm(rewriter, linalgOp, /*numGemmLoops=*/3,
+                        /*ranks=*/{2, 2, 2}, buildGemmOp<linalg::MatmulOp>);
+  if (failed(matmul))
+    return failure();
+  return cast<linalg::MatmulOp>(*matmul);
+}
+
+FailureOr<linalg::BatchReduceMatmulOp>
+mlir::linalgx::rewriteConvToBrgemm(RewriterBase &rewriter,
+                                   linalg::LinalgOp linalgOp) {
+  if (failed(checkConvolution(rewriter, linalgOp)))
+    return failure();
+
+  if (!checkMappingToBrgemm(linalgOp))
+    return rewriter.notifyMatchFailure(
+        linalgOp, "cannot match operation iterators with brgemm iterators");
+
+  FailureOr<Operation *> brgemm = rewriteConvToGemm(
+      rewriter, linalgOp, /*numGemmLoops=*/4, /*ranks=*/{3, 3, 2},
+      buildGemmOp<linalg::BatchReduceMatmulOp>);
+  if (failed(brgemm))
+    return failure();
+  return cast<linalg::BatchReduceMatmulOp>(*brgemm);
+}
+
+// Check if the two innermost loops are parallel and the body is a multiply
+// and accumulate.
+static bool checkMappingToFma(linalg::LinalgOp linalgOp) {
+  // clang-format off
+  using namespace mlir::structured_match;
+  auto isFmaLike =
+    StructuredOpMatcher::make<linalg::LinalgOp>()
+      .operation(NumOfLoops(GreaterThanOrEqualTo(2)))
+      .dim(MatchRange(/*lowerBound=*/0, /*upperBound=*/2),
+          {utils::IteratorType::parallel, utils::IteratorType::parallel})
+      .region(MatchOne(0), WithOpChain<KindMul, KindAdd>(
+                                     /*captures=*/nullptr));
+  // clang-format on
+  return isFmaLike.match(linalgOp);
+}
+
+FailureOr<linalg::GenericOp>
+mlir::linalgx::rewriteDepthwiseConvToFma(RewriterBase &rewriter,
+                                         linalg::LinalgOp linalgOp) {
+  if (failed(checkConvolution(rewriter, linalgOp)))
+    return failure();
+
+  if (!checkMappingToFma(linalgOp))
+    return rewriter.notifyMatchFailure(
+        linalgOp, "cannot match operation iterators with fma iterators");
+
+  // [Q][c] += [Q][c] * [c], the filter row is broadcasted along Q.
+  auto buildFma = [&](OpBuilder &builder, Location loc,
+                      ValueRange slicedOperands) -> Operation * {
+    MLIRContext *ctx = builder.getContext();
+    AffineExpr q, c;
+    bindDims(ctx, q, c);
+    AffineMap identity = AffineMap::get(/*dims=*/2, /*symbols=*/0, {q, c}, ctx);
+    AffineMap broadcast = AffineMap::get(/*dims=*/2, /*symbols=*/0, {c}, ctx);
+    Value output = slicedOperands[2];
+    SmallVector<Type> resultTypes;
+    if (isa<RankedTensorType>(output.getType()))
+      resultTypes.push_back(output.getType());
+    auto fma = builder.create<linalg::GenericOp>(
+        loc, resultTypes, ValueRange{slicedOperands[0], slicedOperands[1]},
+        output, ArrayRef<AffineMap>{identity, broadcast, identity},
+        ArrayRef<utils::IteratorType>{utils::IteratorType::parallel,
+                                      utils::IteratorType::parallel});
+    builder.cloneRegionBefore(linalgOp->getRegion(0), fma.getRegion(),
+                              fma.getRegion().begin());
+    return fma;
+  };
+  FailureOr<Operation *> fma =
+      rewriteConvToGemm(rewriter, linalgOp, /*numGemmLoops=*/2,
+                        /*ranks=*/{2, 1, 2}, buildFma);
+  if (failed(fma))
+    return failure();
+  return cast<linalg::GenericOp>(*fma);
 }
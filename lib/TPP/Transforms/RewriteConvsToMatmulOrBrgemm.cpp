@@ -41,32 +41,6 @@ static bool hasStaticShape(Value image, Value filter, Value output) {
            (!outputType.hasStaticShape()));
 }
 
-// return true if the conv has stride != 1.
-template <typename CONVOP> static bool hasStride(CONVOP convOp) {
-  if (DenseIntElementsAttr strides = convOp.getStrides()) {
-    auto values = strides.getValues<APInt>();
-    if (llvm::any_of(values, [](const APInt &value) {
-          return value.getSExtValue() != 1;
-        })) {
-      return true;
-    }
-  }
-  return false;
-}
-
-// return true if the conv has dilation != 1.
-template <typename CONVOP> static bool hasDilation(CONVOP convOp) {
-  if (DenseIntElementsAttr dilations = convOp.getDilations()) {
-    auto values = dilations.getValues<APInt>();
-    if (llvm::any_of(values, [](const APInt &value) {
-          return value.getSExtValue() != 1;
-        })) {
-      return true;
-    }
-  }
-  return false;
-}
-
 // Check dimension at index 'i' and 'j'. If both are '1' return true
 // otherwise false. The operand is expected to have static shape.
 static bool hasFilterWithRandSEqualOne(OpOperand *filter, unsigned i,
@@ -80,6 +54,21 @@ static bool hasFilterWithRandSEqualOne(OpOperand *filter, unsigned i,
   return ((filterShape[i] == 1) && (filterShape[j] == 1));
 }
 
+// Return true if the blocked convolution `linalgOp` moves with unit strides
+// along P and Q on the image.
+// [N][K'][P][Q][k] += [N][C'][P * SH + R * DH][Q * SW + S * DW][c] * ...
+static bool hasUnitStridesOnImage(linalg::LinalgOp linalgOp) {
+  AffineMap imageMap =
+      linalgOp.getMatchingIndexingMap(linalgOp.getDpsInputOperands()[0]);
+  if (imageMap.getNumResults() != 5)
+    return false;
+  std::optional<int64_t> strideH =
+      linalgx::utils::getDimCoefficient(imageMap.getResult(2), /*P=*/2);
+  std::optional<int64_t> strideW =
+      linalgx::utils::getDimCoefficient(imageMap.getResult(3), /*Q=*/3);
+  return strideH && strideW && *strideH == 1 && *strideW == 1;
+}
+
 struct RewriteConv2DNhwcHwcfToMatmul : OpRewritePattern<linalg::GenericOp> {
   using OpRewritePattern::OpRewritePattern;
 
@@ -167,10 +156,6 @@ struct GeneralizeConv2DNhwcHwcf : OpRewritePattern<linalg::Conv2DNhwcHwcfOp> {
 
   LogicalResult matchAndRewrite(linalg::Conv2DNhwcHwcfOp convOp,
                                 PatternRewriter &rewriter) const override {
-    // Do not handle convolutions with dilation.
-    if (hasDilation<linalg::Conv2DNhwcHwcfOp>(convOp))
-      return failure();
-
     // [N][H][W][C]
     Value image = convOp.image();
     // [R][S][C][K]
@@ -201,11 +186,6 @@ struct BlockConv2DNchwFchw : OpRewritePattern<linalg::Conv2DNchwFchwOp> {
 
   LogicalResult
   blockConv2DNchwFchwPreconditions(linalg::Conv2DNchwFchwOp convOp) const {
-    // do not handle convolutions with dilation and strides.
-    if (hasStride<linalg::Conv2DNchwFchwOp>(convOp) ||
-        hasDilation<linalg::Conv2DNchwFchwOp>(convOp))
-      return failure();
-
     // [N][C][H][W]
     Value image = convOp.image();
     // [K][C][R][S]
@@ -347,6 +327,9 @@ struct CollapseFilterAndImage : OpRewritePattern<linalg::GenericOp> {
     OpOperand *filter = linalgOp.getDpsInputOperands()[1];
     if (!hasFilterWithRandSEqualOne(filter, /*Rpos=*/2, /*Spos=*/3))
       return failure();
+    // Collapsing P and Q requires the image to be walked contiguously.
+    if (!hasUnitStridesOnImage(linalgOp))
+      return failure();
     return success();
   }
 
@@ -527,6 +510,155 @@ struct MapToBRGEMM : OpRewritePattern<linalg::GenericOp> {
   }
 };
 
+// Interchange a blocked convolution to expose a BRGEMM over the blocks of C
+// for each position of the filter. This handles sliding windows and strides,
+// 1x1 convolutions with unit strides marked by `BlockConv2DNchwFchw` are
+// collapsed instead, see `CollapseFilterAndImage`.
+struct InterchangeIteratorsConv2DNchwFchwForBrgemm
+    : OpRewritePattern<linalg::GenericOp> {
+  using OpRewritePattern::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(linalg::GenericOp linalgOp,
+                                PatternRewriter &rewriter) const override {
+    if (!linalgx::utils::isBlockedConvolution(linalgOp))
+      return failure();
+    OpOperand *filter = linalgOp.getDpsInputOperands()[1];
+    if (isMarkedWithTpp(linalgOp, "tpp.BlockedConv2DNchwFchwOp") &&
+        hasFilterWithRandSEqualOne(filter, /*Rpos=*/2, /*Spos=*/3) &&
+        hasUnitStridesOnImage(linalgOp))
+      return failure();
+
+    // clang-format off
+    // N                [parallel]
+    //  K'              [parallel]
+    //   P              [parallel]
+    //    Q             [parallel]
+    //     k            [parallel]
+    //      C'          [reduction]
+    //       R          [reduction]
+    //        S         [reduction]
+    //         c        [reduction]
+    //          output[N][K'][P][Q][k] +=
+    //            image[N][C'][P * SH + R * DH][Q * SW + S * DW][c] *
+    //            filter[K'][C'][R][S][c][k]
+
+    // expose BRGEMM by interchange:
+
+    // N                [parallel]
+    //  K'              [parallel]
+    //   P              [parallel]
+    //    R             [reduction]
+    //     S            [reduction]
+    //      C'          [reduction] // BRGEMM red dimension
+    //      /* GEMM */
+    //       Q          [parallel]
+    //        k         [parallel]
+    //         c        [reduction]
+    //
+    // The image is accessed in place at offset
+    // [N][0][P * SH + R * DH][S * DW][0] with a stride of SW on Q.
+    // clang-format on
+
+    SmallVector<unsigned> interchangeVector = {0, 1, 2, 6, 7, 5, 3, 4, 8};
+    if (linalgOp.getNumLoops() != interchangeVector.size())
+      return failure();
+    FailureOr<linalg::GenericOp> maybeInterchange =
+        interchangeGenericOp(rewriter, linalgOp, interchangeVector);
+    if (failed(maybeInterchange))
+      return failure();
+    StringAttr name =
+        rewriter.getStringAttr("tpp.BlockedAndInterConv2DNchwFchwOp");
+    (*maybeInterchange).setLibraryCallAttr(name);
+    return success();
+  }
+};
+
+struct RewriteConv2DNchwFchwToBrgemm : OpRewritePattern<linalg::GenericOp> {
+  using OpRewritePattern::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(linalg::GenericOp linalgOp,
+                                PatternRewriter &rewriter) const override {
+    if (!isMarkedWithTpp(linalgOp, "tpp.BlockedAndInterConv2DNchwFchwOp"))
+      return failure();
+    FailureOr<linalg::BatchReduceMatmulOp> brgemm =
+        mlir::linalgx::rewriteConvToBrgemm(rewriter, linalgOp);
+    if (failed(brgemm))
+      return failure();
+    return success();
+  }
+};
+
+// Interchange a blocked depthwise convolution to expose an element-wise
+// multiply and accumulate on the innermost channels.
+struct InterchangeIteratorsDepthwiseConv : OpRewritePattern<linalg::GenericOp> {
+  using OpRewritePattern::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(linalg::GenericOp linalgOp,
+                                PatternRewriter &rewriter) const override {
+    if (!linalgx::utils::isBlockedDepthwiseConvolution(linalgOp))
+      return failure();
+
+    // clang-format off
+    // N              [parallel]
+    //  C'            [parallel]
+    //   P            [parallel]
+    //    Q           [parallel]
+    //     c          [parallel]
+    //      R         [reduction]
+    //       S        [reduction]
+    //        output[N][C'][P][Q][c] +=
+    //          image[N][C'][P * SH + R * DH][Q * SW + S * DW][c] *
+    //          filter[C'][R][S][c]
+
+    // expose the FMA by interchange:
+
+    // N              [parallel]
+    //  C'            [parallel]
+    //   P            [parallel]
+    //    R           [reduction]
+    //     S          [reduction]
+    //      /* FMA */
+    //      Q         [parallel]
+    //       c        [parallel]
+    //
+    // output[*][*][*][Q][c] += image[*][*][*][Q * SW][c] * filter[*][*][*][c]
+    // clang-format on
+
+    SmallVector<unsigned> interchangeVector = {0, 1, 2, 5, 6, 3, 4};
+    FailureOr<linalg::GenericOp> maybeInterchange =
+        interchangeGenericOp(rewriter, linalgOp, interchangeVector);
+    if (failed(maybeInterchange))
+      return failure();
+    StringAttr name =
+        rewriter.getStringAttr("tpp.BlockedAndInterDepthwiseConv2DNhwcHwcOp");
+    (*maybeInterchange).setLibraryCallAttr(name);
+    return success();
+  }
+};
+
+struct RewriteDepthwiseConvToFma : OpRewritePattern<linalg::GenericOp> {
+  using OpRewritePattern::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(linalg::GenericOp linalgOp,
+                                PatternRewriter &rewriter) const override {
+    if (!isMarkedWithTpp(linalgOp,
+                         "tpp.BlockedAndInterDepthwiseConv2DNhwcHwcOp"))
+      return failure();
+    FailureOr<linalg::GenericOp> fma =
+        mlir::linalgx::rewriteDepthwiseConvToFma(rewriter, linalgOp);
+    if (failed(fma))
+      return failure();
+    return success();
+  }
+};
+
+// patterns for mapping a blocked depthwise convolution to element-wise
+// multiply and accumulate operations.
+void populateRewriteDepthwiseConvPatterns(RewritePatternSet &patterns) {
+  patterns.insert<InterchangeIteratorsDepthwiseConv, RewriteDepthwiseConvToFma>(
+      patterns.getContext());
+}
+
 // patterns for mapping a Conv2DNhwcHwcfOp to a GEMM operation.
 void populateRewrite2DNhwcHwcfConvPatterns(RewritePatternSet &patterns) {
   patterns.insert<GeneralizeConv2DNhwcHwcf, RewriteConv2DNhwcHwcfToMatmul,
@@ -546,6 +678,10 @@ void populateRewriteBlockedConvPatterns(RewritePatternSet &patterns,
   // [*][* ][P * Q][k] = [*][* ][H * W][c] * [* ][* ][c][k] // GEMM with c as red.
   // [*][* ][P * Q][k] = [*][C'][H * W][c] * [* ][C'][c][k] // BRGEMM with C' as red.
   //
+  // otherwise, for each (R, S) position of the filter:
+  //
+  // [*][* ][*][Q][k] = [*][C'][*][Q * SW][c] * [* ][C'][*][*][c][k] // BRGEMM with C' as red.
+  //
   // clang-format on
 
   // Rewrite to GEMM.
@@ -556,8 +692,9 @@ void populateRewriteBlockedConvPatterns(RewritePatternSet &patterns,
   // Rewrite to BRGEMM.
   else {
     patterns.insert<CollapseFilterAndImage,
-                    InterchangeAfterBlockingAndCollapsing, MapToBRGEMM>(
-        patterns.getContext());
+                    InterchangeAfterBlockingAndCollapsing, MapToBRGEMM,
+                    InterchangeIteratorsConv2DNchwFchwForBrgemm,
+                    RewriteConv2DNchwFchwToBrgemm>(patterns.getContext());
   }
 }
 
@@ -570,6 +707,7 @@ struct RewriteConvToMatmulOrBrgemm
     RewritePatternSet patterns(getOperation().getContext());
     populateRewrite2DNhwcHwcfConvPatterns(patterns);
     populateRewriteBlockedConvPatterns(patterns, this->enableBrgemm);
+    populateRewriteDepthwiseConvPatterns(patterns);
     tensor::populateMergeConsecutiveInsertExtractSlicePatterns(patterns);
     (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
   }
@@ -12,19 +12,28 @@
 #include "TPP/Transforms/Utils/TransformUtils.h"
 #include "TPP/Transforms/Utils/VNNIUtils.h"
 #include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
 #include "mlir/Dialect/Linalg/Utils/Utils.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/Dialect/SCF/Utils/Utils.h"
+#include "mlir/Dialect/Tensor/IR/Tensor.h"
 #include "mlir/Dialect/Tensor/Transforms/Transforms.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/Interfaces/SideEffectInterfaces.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 #include "llvm/Support/Debug.h"
 
-using namespace mlir;
-
-#define GEN_PASS_CLASSES
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_REWRITELOOPSTOBRGEMM
 #include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+using namespace mlir;
 
 #define DEBUG_TYPE "mlir-rewrite-to-brgemm"
 
@@ -263,3 +272,444 @@ mlir::linalgx::rewriteToBRGemmOp(RewriterBase &rewriter,
                                              : tensorResults);
   return outermostLoop ? outermostLoop->getResults() : tensorResults;
 }
+
+// Returns the coefficient of an induction variable in `expr`, from its
+// coefficients in the dimensions and symbols of `expr`.
+static FailureOr<int64_t> getExprCoefficient(AffineExpr expr,
+                                             ArrayRef<int64_t> dimCoeffs,
+                                             ArrayRef<int64_t> symCoeffs) {
+  if (isa<AffineConstantExpr>(expr))
+    return 0;
+  if (auto dimExpr = dyn_cast<AffineDimExpr>(expr))
+    return dimCoeffs[dimExpr.getPosition()];
+  if (auto symExpr = dyn_cast<AffineSymbolExpr>(expr))
+    return symCoeffs[symExpr.getPosition()];
+
+  auto binaryExpr = cast<AffineBinaryOpExpr>(expr);
+  FailureOr<int64_t> lhs =
+      getExprCoefficient(binaryExpr.getLHS(), dimCoeffs, symCoeffs);
+  FailureOr<int64_t> rhs =
+      getExprCoefficient(binaryExpr.getRHS(), dimCoeffs, symCoeffs);
+  if (failed(lhs) || failed(rhs))
+    return failure();
+  if (expr.getKind() == AffineExprKind::Add)
+    return *lhs + *rhs;
+  // Any other expression of invariants is invariant.
+  if (*lhs == 0 && *rhs == 0)
+    return 0;
+  if (expr.getKind() != AffineExprKind::Mul)
+    return failure();
+  if (auto cst = dyn_cast<AffineConstantExpr>(binaryExpr.getRHS()))
+    return *lhs * cst.getValue();
+  if (auto cst = dyn_cast<AffineConstantExpr>(binaryExpr.getLHS()))
+    return cst.getValue() * *rhs;
+  return failure();
+}
+
+// Returns the coefficient c of the induction variable iv of `loop` in
+// `value` = c * iv + v, where v is invariant in `loop`, or failure if `value`
+// is not affine in iv. The induction variables of the loops nested in `loop`
+// count as invariants: they take the same values at each iteration of `loop`
+// once their bounds are checked to be invariant.
+static FailureOr<int64_t> getIvCoefficient(Value value, scf::ForOp loop) {
+  if (value == loop.getInductionVar())
+    return 1;
+  if (loop.isDefinedOutsideOfLoop(value))
+    return 0;
+
+  if (auto blockArg = dyn_cast<BlockArgument>(value)) {
+    Operation *owner = blockArg.getOwner()->getParentOp();
+    unsigned argNumber = blockArg.getArgNumber();
+    if (auto forOp = dyn_cast<scf::ForOp>(owner))
+      return argNumber == 0 ? FailureOr<int64_t>(0) : failure();
+    if (auto forallOp = dyn_cast<scf::ForallOp>(owner))
+      return argNumber < forallOp.getRank() ? FailureOr<int64_t>(0)
+                                            : failure();
+    if (isa<scf::ParallelOp>(owner))
+      return 0;
+    return failure();
+  }
+
+  Operation *op = value.getDefiningOp();
+  if (getConstantIntValue(value))
+    return 0;
+  if (isa<arith::AddIOp, arith::SubIOp, arith::MulIOp>(op)) {
+    FailureOr<int64_t> lhs = getIvCoefficient(op->getOperand(0), loop);
+    FailureOr<int64_t> rhs = getIvCoefficient(op->getOperand(1), loop);
+    if (failed(lhs) || failed(rhs))
+      return failure();
+    if (isa<arith::AddIOp>(op))
+      return *lhs + *rhs;
+    if (isa<arith::SubIOp>(op))
+      return *lhs - *rhs;
+    if (*lhs == 0 && *rhs == 0)
+      return 0;
+    if (std::optional<int64_t> cst = getConstantIntValue(op->getOperand(1)))
+      return *lhs * *cst;
+    if (std::optional<int64_t> cst = getConstantIntValue(op->getOperand(0)))
+      return *cst * *rhs;
+    return failure();
+  }
+  if (isa<arith::IndexCastOp, arith::IndexCastUIOp>(op))
+    return getIvCoefficient(op->getOperand(0), loop);
+  if (auto applyOp = dyn_cast<affine::AffineApplyOp>(op)) {
+    SmallVector<int64_t> coeffs;
+    for (Value operand : applyOp.getMapOperands()) {
+      FailureOr<int64_t> coeff = getIvCoefficient(operand, loop);
+      if (failed(coeff))
+        return failure();
+      coeffs.push_back(*coeff);
+    }
+    AffineMap map = applyOp.getAffineMap();
+    ArrayRef<int64_t> allCoeffs(coeffs);
+    return getExprCoefficient(map.getResult(0),
+                              allCoeffs.take_front(map.getNumDims()),
+                              allCoeffs.drop_front(map.getNumDims()));
+  }
+
+  // Any other pure computation of invariants is invariant.
+  if (!isPure(op) || op->getNumRegions() != 0)
+    return failure();
+  for (Value operand : op->getOperands()) {
+    FailureOr<int64_t> coeff = getIvCoefficient(operand, loop);
+    if (failed(coeff) || *coeff != 0)
+      return failure();
+  }
+  return 0;
+}
+
+static bool isLoopInvariant(Value value, scf::ForOp loop) {
+  FailureOr<int64_t> coeff = getIvCoefficient(value, loop);
+  return succeeded(coeff) && *coeff == 0;
+}
+
+// Returns the number of iterations of `loop` if it has constant bounds.
+static std::optional<int64_t> getConstantTripCount(scf::ForOp loop) {
+  std::optional<int64_t> lb = getConstantIntValue(loop.getLowerBound());
+  std::optional<int64_t> ub = getConstantIntValue(loop.getUpperBound());
+  std::optional<int64_t> step = getConstantIntValue(loop.getStep());
+  if (!lb || !ub || !step || *step <= 0 || *ub <= *lb)
+    return std::nullopt;
+  return llvm::divideCeil(*ub - *lb, *step);
+}
+
+namespace {
+
+// A reduction loop of a matmul, with the distance between the A and B tiles
+// of consecutive iterations.
+struct BatchReduceLoop {
+  scf::ForOp loop;
+  int64_t tripCount;
+  int64_t batchStrides[2];
+  // Dimension of the slices of A and B along which the tiles move, on
+  // tensors.
+  unsigned batchDims[2];
+};
+
+} // namespace
+
+// Returns the distance, in elements, between the tiles of `operand` of
+// consecutive iterations of `loop`: `operand` is a subview of a memref
+// defined outside of `loop`, at offsets affine in its induction variable.
+static FailureOr<int64_t> getSubViewBatchStride(Value operand,
+                                                scf::ForOp loop) {
+  auto subView = operand.getDefiningOp<memref::SubViewOp>();
+  if (!subView || !loop.isDefinedOutsideOfLoop(subView.getSource()))
+    return failure();
+  SmallVector<int64_t> tileStrides;
+  int64_t tileOffset;
+  if (failed(getStridesAndOffset(subView.getType(), tileStrides,
+                                 tileOffset)) ||
+      llvm::any_of(tileStrides, ShapedType::isDynamic))
+    return failure();
+  SmallVector<int64_t> sourceStrides;
+  int64_t sourceOffset;
+  if (failed(getStridesAndOffset(subView.getSourceType(), sourceStrides,
+                                 sourceOffset)))
+    return failure();
+  if (!llvm::all_of(subView.getSizes(),
+                    [&](Value size) { return isLoopInvariant(size, loop); }) ||
+      !llvm::all_of(subView.getStrides(), [&](Value stride) {
+        return isLoopInvariant(stride, loop);
+      }))
+    return failure();
+
+  int64_t stride = 0;
+  for (auto [offset, sourceStride] :
+       llvm::zip(subView.getMixedOffsets(), sourceStrides)) {
+    auto offsetValue = dyn_cast<Value>(offset);
+    if (!offsetValue)
+      continue;
+    FailureOr<int64_t> coeff = getIvCoefficient(offsetValue, loop);
+    if (failed(coeff))
+      return failure();
+    if (*coeff == 0)
+      continue;
+    if (ShapedType::isDynamic(sourceStride))
+      return failure();
+    stride += *coeff * sourceStride;
+  }
+  return stride;
+}
+
+// Returns the dimension and the distance between the tiles of `operand` of
+// consecutive iterations of `loop`: `operand` is a slice of a tensor defined
+// outside of `loop`, at an offset affine in its induction variable along a
+// single dimension, dropped by the slice and preceding the kept ones.
+static FailureOr<std::pair<unsigned, int64_t>>
+getSliceBatchStride(Value operand, scf::ForOp loop) {
+  auto slice = operand.getDefiningOp<tensor::ExtractSliceOp>();
+  if (!slice || !loop.isDefinedOutsideOfLoop(slice.getSource()))
+    return failure();
+  if (!llvm::all_of(slice.getSizes(),
+                    [&](Value size) { return isLoopInvariant(size, loop); }) ||
+      !llvm::all_of(slice.getStrides(), [&](Value stride) {
+        return isLoopInvariant(stride, loop);
+      }))
+    return failure();
+
+  std::optional<std::pair<unsigned, int64_t>> batch;
+  for (auto [dim, offset] : llvm::enumerate(slice.getMixedOffsets())) {
+    auto offsetValue = dyn_cast<Value>(offset);
+    if (!offsetValue)
+      continue;
+    FailureOr<int64_t> coeff = getIvCoefficient(offsetValue, loop);
+    if (failed(coeff) || (*coeff != 0 && batch))
+      return failure();
+    if (*coeff != 0)
+      batch = std::make_pair(static_cast<unsigned>(dim), *coeff);
+  }
+  if (!batch)
+    return failure();
+
+  llvm::SmallBitVector droppedDims = slice.getDroppedDims();
+  for (unsigned dim = 0; dim <= batch->first; ++dim) {
+    if (!droppedDims.test(dim))
+      return failure();
+  }
+  return *batch;
+}
+
+// Returns the dynamic lower bounds, upper bounds and steps of a scf.for,
+// scf.forall or scf.parallel.
+static SmallVector<Value> getLoopBounds(Operation *loopOp) {
+  SmallVector<Value> bounds;
+  if (auto forOp = dyn_cast<scf::ForOp>(loopOp)) {
+    bounds = {forOp.getLowerBound(), forOp.getUpperBound(), forOp.getStep()};
+  } else if (auto forallOp = dyn_cast<scf::ForallOp>(loopOp)) {
+    llvm::append_range(bounds, forallOp.getDynamicLowerBound());
+    llvm::append_range(bounds, forallOp.getDynamicUpperBound());
+    llvm::append_range(bounds, forallOp.getDynamicStep());
+  } else {
+    auto parallelOp = cast<scf::ParallelOp>(loopOp);
+    llvm::append_range(bounds, parallelOp.getLowerBound());
+    llvm::append_range(bounds, parallelOp.getUpperBound());
+    llvm::append_range(bounds, parallelOp.getStep());
+  }
+  return bounds;
+}
+
+// Returns true if `matmulOp` is the only op of `loop` with side effects, and
+// the loops nested in `loop` iterate the same at each of its iterations.
+static bool hasOnlyMatmulEffects(scf::ForOp loop, linalg::MatmulOp matmulOp) {
+  WalkResult result = loop.getBody()->walk([&](Operation *op) {
+    if (op == matmulOp || op->hasTrait<OpTrait::IsTerminator>())
+      return WalkResult::advance();
+    if (isa<scf::ForOp, scf::ForallOp, scf::ParallelOp>(op)) {
+      if (op->getNumResults() != 0 ||
+          !llvm::all_of(getLoopBounds(op), [&](Value bound) {
+            return isLoopInvariant(bound, loop);
+          }))
+        return WalkResult::interrupt();
+      return WalkResult::advance();
+    }
+    // The matmul must not be nested in the regions of other ops.
+    if (op->getNumRegions() != 0 || !isMemoryEffectFree(op))
+      return WalkResult::interrupt();
+    return WalkResult::advance();
+  });
+  return !result.wasInterrupted();
+}
+
+// Returns the reduction loop of `matmulOp` on buffers: the closest enclosing
+// scf.for, through any nest of scf.for, scf.forall and scf.parallel, that
+// accumulates into the same tile of C tiles of A and B at a constant
+// distance.
+static std::optional<BatchReduceLoop>
+getBufferReduceLoop(linalg::MatmulOp matmulOp) {
+  Value output = matmulOp.getDpsInits()[0];
+  for (Operation *parent = matmulOp->getParentOp();
+       isa<scf::ForOp, scf::ForallOp, scf::ParallelOp>(parent);
+       parent = parent->getParentOp()) {
+    auto loop = dyn_cast<scf::ForOp>(parent);
+    if (!loop)
+      continue;
+    std::optional<int64_t> tripCount = getConstantTripCount(loop);
+    if (!tripCount || loop.getNumResults() != 0 ||
+        !hasOnlyMatmulEffects(loop, matmulOp))
+      continue;
+
+    auto outputView = output.getDefiningOp<memref::SubViewOp>();
+    bool invariantOutput =
+        loop.isDefinedOutsideOfLoop(output) ||
+        (outputView && loop.isDefinedOutsideOfLoop(outputView.getSource()) &&
+         llvm::all_of(outputView->getOperands().drop_front(),
+                      [&](Value operand) {
+                        return isLoopInvariant(operand, loop);
+                      }));
+    if (!invariantOutput)
+      continue;
+
+    int64_t step = *getConstantIntValue(loop.getStep());
+    BatchReduceLoop reduceLoop{loop, *tripCount, {0, 0}, {0, 0}};
+    bool matched = true;
+    for (auto [idx, input] : llvm::enumerate(matmulOp.getDpsInputs())) {
+      FailureOr<int64_t> stride = getSubViewBatchStride(input, loop);
+      if (failed(stride) || *stride <= 0) {
+        matched = false;
+        break;
+      }
+      reduceLoop.batchStrides[idx] = *stride * step;
+    }
+    if (matched)
+      return reduceLoop;
+  }
+  return std::nullopt;
+}
+
+// Returns the reduction loop of `matmulOp` on tensors: the enclosing scf.for
+// carries the output of the matmul, and only of it, across iterations.
+static std::optional<BatchReduceLoop>
+getTensorReduceLoop(linalg::MatmulOp matmulOp) {
+  auto loop = dyn_cast<scf::ForOp>(matmulOp->getParentOp());
+  if (!loop || loop.getNumRegionIterArgs() != 1)
+    return std::nullopt;
+  std::optional<int64_t> tripCount = getConstantTripCount(loop);
+  if (!tripCount)
+    return std::nullopt;
+
+  BlockArgument iterArg = loop.getRegionIterArgs()[0];
+  Value result = matmulOp->getResult(0);
+  auto yieldOp = cast<scf::YieldOp>(loop.getBody()->getTerminator());
+  if (matmulOp.getDpsInits()[0] != iterArg || !iterArg.hasOneUse() ||
+      yieldOp.getOperand(0) != result || !result.hasOneUse() ||
+      !hasOnlyMatmulEffects(loop, matmulOp))
+    return std::nullopt;
+
+  int64_t step = *getConstantIntValue(loop.getStep());
+  BatchReduceLoop reduceLoop{loop, *tripCount, {0, 0}, {0, 0}};
+  for (auto [idx, input] : llvm::enumerate(matmulOp.getDpsInputs())) {
+    FailureOr<std::pair<unsigned, int64_t>> batch =
+        getSliceBatchStride(input, loop);
+    if (failed(batch) || batch->second <= 0)
+      return std::nullopt;
+    reduceLoop.batchDims[idx] = batch->first;
+    reduceLoop.batchStrides[idx] = batch->second * step;
+  }
+  return reduceLoop;
+}
+
+// Returns the view of the tiles of `tile` over all the iterations of the
+// reduction loop, with the batch as outermost dimension.
+static Value getBatchedTile(RewriterBase &rewriter, Location loc, Value tile,
+                            int64_t batchStride, unsigned batchDim,
+                            int64_t tripCount) {
+  if (auto tileType = dyn_cast<MemRefType>(tile.getType())) {
+    SmallVector<int64_t> tileStrides;
+    int64_t tileOffset;
+    (void)getStridesAndOffset(tileType, tileStrides, tileOffset);
+    SmallVector<int64_t> shape{tripCount};
+    llvm::append_range(shape, tileType.getShape());
+    SmallVector<int64_t> strides{batchStride};
+    llvm::append_range(strides, tileStrides);
+    auto batchedType = MemRefType::get(
+        shape, tileType.getElementType(),
+        StridedLayoutAttr::get(rewriter.getContext(), ShapedType::kDynamic,
+                               strides),
+        tileType.getMemorySpace());
+    auto metadata =
+        rewriter.create<memref::ExtractStridedMetadataOp>(loc, tile);
+    return rewriter.create<memref::ReinterpretCastOp>(
+        loc, batchedType, metadata.getBaseBuffer(),
+        getAsOpFoldResult(metadata.getOffset()),
+        getAsIndexOpFoldResult(rewriter.getContext(), shape),
+        getAsIndexOpFoldResult(rewriter.getContext(), strides));
+  }
+
+  auto slice = tile.getDefiningOp<tensor::ExtractSliceOp>();
+  SmallVector<OpFoldResult> offsets = slice.getMixedOffsets();
+  SmallVector<OpFoldResult> sizes = slice.getMixedSizes();
+  SmallVector<OpFoldResult> strides = slice.getMixedStrides();
+  sizes[batchDim] = rewriter.getIndexAttr(tripCount);
+  strides[batchDim] = rewriter.getIndexAttr(batchStride);
+  auto batchedType = cast<RankedTensorType>(
+      tensor::ExtractSliceOp::inferCanonicalRankReducedResultType(
+          /*resultRank=*/3, slice.getSourceType(), offsets, sizes, strides));
+  return rewriter.create<tensor::ExtractSliceOp>(
+      loc, batchedType, slice.getSource(), offsets, sizes, strides);
+}
+
+// Replaces `matmulOp` by a brgemm over the iterations of its reduction loop,
+// then peels the single iteration left of the loop.
+static void rewriteReduceLoop(RewriterBase &rewriter,
+                              linalg::MatmulOp matmulOp,
+                              const BatchReduceLoop &reduceLoop) {
+  Location loc = matmulOp.getLoc();
+  rewriter.setInsertionPoint(matmulOp);
+  SmallVector<Value> inputs;
+  for (auto [idx, input] : llvm::enumerate(matmulOp.getDpsInputs())) {
+    inputs.push_back(getBatchedTile(
+        rewriter, loc, input, reduceLoop.batchStrides[idx],
+        reduceLoop.batchDims[idx], reduceLoop.tripCount));
+  }
+  Value output = matmulOp.getDpsInits()[0];
+  if (matmulOp.hasPureTensorSemantics()) {
+    rewriter.replaceOpWithNewOp<linalg::BatchReduceMatmulOp>(
+        matmulOp, output.getType(), inputs, output);
+  } else {
+    rewriter.create<linalg::BatchReduceMatmulOp>(loc, inputs, output);
+    rewriter.eraseOp(matmulOp);
+  }
+
+  scf::ForOp loop = reduceLoop.loop;
+  auto yieldOp = cast<scf::YieldOp>(loop.getBody()->getTerminator());
+  SmallVector<Value> results(yieldOp.getOperands());
+  rewriter.eraseOp(yieldOp);
+  SmallVector<Value> bodyArgs{loop.getLowerBound()};
+  llvm::append_range(bodyArgs, loop.getInitArgs());
+  rewriter.inlineBlockBefore(loop.getBody(), loop, bodyArgs);
+  rewriter.replaceOp(loop, results);
+}
+
+namespace {
+
+struct RewriteLoopsToBrgemm
+    : public tpp::impl::RewriteLoopsToBrgemmBase<RewriteLoopsToBrgemm> {
+  void runOnOperation() override {
+    SmallVector<std::pair<linalg::MatmulOp, BatchReduceLoop>> candidates;
+    getOperation()->walk([&](linalg::MatmulOp matmulOp) {
+      auto isStaticTile = [](Value operand) {
+        auto type = dyn_cast<ShapedType>(operand.getType());
+        return type && type.getRank() == 2 && type.hasStaticShape();
+      };
+      if (!llvm::all_of(matmulOp->getOperands(), isStaticTile))
+        return;
+
+      std::optional<BatchReduceLoop> reduceLoop =
+          matmulOp.hasPureBufferSemantics() ? getBufferReduceLoop(matmulOp)
+                                            : getTensorReduceLoop(matmulOp);
+      if (reduceLoop) {
+        LLVM_DEBUG(llvm::dbgs() << "Batch reduce loop of " << matmulOp
+                                << " over " << reduceLoop->tripCount
+                                << " iterations\n");
+        candidates.emplace_back(matmulOp, *reduceLoop);
+      }
+    });
+
+    IRRewriter rewriter(&getContext());
+    for (auto &[matmulOp, reduceLoop] : candidates)
+      rewriteReduceLoop(rewriter, matmulOp, reduceLoop);
+  }
+};
+
+} // namespace
@@ -10,11 +10,21 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "TPP/Transforms/Utils/BlockingCostModel.h"
+#include "TPP/Transforms/Utils/TransformUtils.h"
 #include "mlir/Dialect/Affine/IR/AffineOps.h"
 #include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/Dialect/SCF/Utils/Utils.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
 #include "mlir/Pass/Pass.h"
+#include "llvm/ADT/StringSwitch.h"
+
+#include <algorithm>
+#include <optional>
+#include <tuple>
+
 namespace mlir {
 namespace tpp {
 #define GEN_PASS_DECL_SCFPARALLELLOOPTILING
@@ -53,13 +63,13 @@ using namespace mlir::scf;
 /// where the uses of %i0 and %i1 in the loop body are replaced by
 /// %i0 + j0 and %i1 + %j1.
 ///
-/// The old loop is replaced with the new one.
-void tileParallelLoop(ParallelOp op, ArrayRef<unsigned> tileSizes,
-                      bool noMinMaxBounds) {
+/// The old loop is replaced with the new one, which is returned.
+ParallelOp tileParallelLoop(ParallelOp op, ArrayRef<unsigned> tileSizes,
+                            bool noMinMaxBounds) {
   bool useParallelOp = false;
   /* TODO, need to implement this case */
   if (!useParallelOp && noMinMaxBounds) {
-    return;
+    return nullptr;
   }
 
   OpBuilder b(op);
@@ -238,6 +248,319 @@ void tileParallelLoop(ParallelOp op, ArrayRef<unsigned> tileSizes,
   }
 
   op.erase();
+  return outerLoop;
+}
+
+/// Returns the trip count of the dimension `dim` of `op`, if static.
+static std::optional<int64_t> getStaticTripCount(ParallelOp op, unsigned dim) {
+  std::optional<int64_t> lb = getConstantIntValue(op.getLowerBound()[dim]);
+  std::optional<int64_t> ub = getConstantIntValue(op.getUpperBound()[dim]);
+  std::optional<int64_t> step = getConstantIntValue(op.getStep()[dim]);
+  if (!lb || !ub || !step || *step <= 0)
+    return std::nullopt;
+  return std::max<int64_t>(0, llvm::divideCeil(*ub - *lb, *step));
+}
+
+/// Returns the tile sizes of `op`, where the sizes of 0 of the first two
+/// dimensions are chosen for `numThreads` threads.
+///
+/// A grid of t0 x t1 tiles runs in ceil(tiles / threads) rounds of t0 * t1
+/// iterations. The sizes that finish in the fewest iterations are kept, then
+/// the ones where each thread touches the fewest rows and columns of tiles,
+/// i.e. rounds * (t0 + t1): square tiles reuse the operands of the gemms the
+/// most. Only the sizes ceil(n / k) are tried, the others give as many tiles
+/// for larger tiles.
+static SmallVector<unsigned> getTileSizes(ParallelOp op,
+                                          ArrayRef<unsigned> tileSizes,
+                                          unsigned numThreads) {
+  unsigned numLoops = op.getNumLoops();
+  SmallVector<unsigned> sizes(numLoops, 1);
+  for (unsigned dim = 0; dim < numLoops && dim < tileSizes.size(); ++dim)
+    sizes[dim] = tileSizes[dim];
+  // A single 0 sizes the whole grid.
+  if (tileSizes.size() == 1 && tileSizes[0] == 0 && numLoops > 1)
+    sizes[1] = 0;
+
+  // The fixed tiles multiply the number of tiles of the grid.
+  int64_t numFixedTiles = 1;
+  SmallVector<int64_t, 2> tripCounts;
+  SmallVector<SmallVector<int64_t>, 2> candidates;
+  for (unsigned dim = 0; dim < numLoops; ++dim) {
+    std::optional<int64_t> tripCount = getStaticTripCount(op, dim);
+    if (sizes[dim] != 0) {
+      if (tripCount)
+        numFixedTiles *= llvm::divideCeil(*tripCount, sizes[dim]);
+      continue;
+    }
+    if (dim >= 2 || !tripCount || *tripCount == 0) {
+      sizes[dim] = 1;
+      if (tripCount)
+        numFixedTiles *= *tripCount;
+      continue;
+    }
+    tripCounts.push_back(*tripCount);
+    auto &dimCandidates = candidates.emplace_back();
+    for (int64_t numTiles = 1; numTiles <= *tripCount; ++numTiles) {
+      int64_t size = llvm::divideCeil(*tripCount, numTiles);
+      if (dimCandidates.empty() || dimCandidates.back() != size)
+        dimCandidates.push_back(size);
+      // Past sqrt(n), each size gives a different number of tiles.
+      if (size * size <= *tripCount) {
+        for (int64_t smaller = size - 1; smaller > 0; --smaller)
+          dimCandidates.push_back(smaller);
+        break;
+      }
+    }
+  }
+  if (candidates.empty())
+    return sizes;
+  if (candidates.size() == 1) {
+    tripCounts.push_back(1);
+    candidates.push_back({1});
+  }
+
+  std::optional<std::tuple<int64_t, int64_t>> bestCost;
+  int64_t bestRows = 1, bestCols = 1;
+  for (int64_t rows : candidates[0]) {
+    for (int64_t cols : candidates[1]) {
+      int64_t numTiles = llvm::divideCeil(tripCounts[0], rows) *
+                         llvm::divideCeil(tripCounts[1], cols) * numFixedTiles;
+      int64_t rounds = llvm::divideCeil(numTiles, numThreads);
+      auto cost = std::make_tuple(rounds * rows * cols, rounds * (rows + cols));
+      if (!bestCost || cost < *bestCost) {
+        bestCost = cost;
+        bestRows = rows;
+        bestCols = cols;
+      }
+    }
+  }
+  SmallVector<int64_t, 2> best{bestRows, bestCols};
+  for (unsigned dim = 0, idx = 0; dim < numLoops; ++dim) {
+    if (sizes[dim] == 0)
+      sizes[dim] = best[idx++];
+  }
+  return sizes;
+}
+
+/// Returns the tile sizes of all the dimensions of a loop of `numLoops`
+/// dimensions, rotated like the loop by rotateParallelLoop.
+static SmallVector<unsigned> rotateTileSizes(ArrayRef<unsigned> tileSizes,
+                                             unsigned numLoops) {
+  SmallVector<unsigned> sizes(numLoops, 1);
+  for (unsigned dim = 0; dim < numLoops && dim < tileSizes.size(); ++dim)
+    sizes[dim] = tileSizes[dim];
+  if (tileSizes.size() == 1 && tileSizes[0] == 0)
+    sizes[1] = 0;
+  std::rotate(sizes.begin(), std::prev(sizes.end()), sizes.end());
+  return sizes;
+}
+
+/// Moves the last dimension of `op` first, the runtimes split the outermost
+/// dimension of the parallel loops into contiguous ranges over the threads.
+static ParallelOp rotateParallelLoop(ParallelOp op) {
+  auto rotate = [](ValueRange values) {
+    SmallVector<Value> rotated{values.back()};
+    rotated.append(values.begin(), std::prev(values.end()));
+    return rotated;
+  };
+  OpBuilder b(op);
+  unsigned numLoops = op.getNumLoops();
+  auto newOp = b.create<ParallelOp>(
+      op.getLoc(), rotate(op.getLowerBound()), rotate(op.getUpperBound()),
+      rotate(op.getStep()), [&](OpBuilder &nb, Location, ValueRange ivs) {
+        IRMapping mapping;
+        for (unsigned dim = 0; dim < numLoops; ++dim)
+          mapping.map(op.getInductionVars()[dim], ivs[(dim + 1) % numLoops]);
+        for (Operation &bodyOp : op.getBody()->without_terminator())
+          nb.clone(bodyOp, mapping);
+      });
+  op.erase();
+  return newOp;
+}
+
+/// Returns true if `value` is computed from `iv` in the body of `loop`.
+static bool dependsOn(Value value, Value iv, ParallelOp loop) {
+  SmallVector<Value> worklist{value};
+  DenseSet<Value> visited;
+  while (!worklist.empty()) {
+    Value current = worklist.pop_back_val();
+    if (current == iv)
+      return true;
+    if (!visited.insert(current).second)
+      continue;
+    Operation *defOp = current.getDefiningOp();
+    if (defOp && loop->isProperAncestor(defOp))
+      llvm::append_range(worklist, defOp->getOperands());
+  }
+  return false;
+}
+
+/// Returns the bytes of a row and of a column of the `rows` x `cols` grid of
+/// tiles of `loop`: the buffers sliced by the first induction variable only
+/// are split in row panels, e.g. the A panels of a gemm, the ones sliced by
+/// the second only in column panels, e.g. the B panels.
+static std::pair<int64_t, int64_t> getPanelBytes(ParallelOp loop, int64_t rows,
+                                                 int64_t cols) {
+  Value rowIv = loop.getInductionVars()[0];
+  Value colIv = loop.getInductionVars()[1];
+  int64_t rowPanelBytes = 0, colPanelBytes = 0;
+  DenseSet<Value> sources;
+  loop.getBody()->walk([&](memref::SubViewOp subview) {
+    Value source = subview.getSource();
+    auto type = cast<MemRefType>(source.getType());
+    if (loop.getRegion().isAncestor(source.getParentRegion()) ||
+        !type.hasStaticShape() || !type.getElementType().isIntOrFloat())
+      return;
+    auto slicedBy = [&](Value iv) {
+      return llvm::any_of(subview.getOffsets(), [&](Value offset) {
+        return dependsOn(offset, iv, loop);
+      });
+    };
+    bool byRow = slicedBy(rowIv);
+    if (byRow == slicedBy(colIv) || !sources.insert(source).second)
+      return;
+    int64_t bytes = type.getNumElements() *
+                    llvm::divideCeil(type.getElementTypeBitWidth(), 8);
+    if (byRow)
+      rowPanelBytes += bytes / rows;
+    else
+      colPanelBytes += bytes / cols;
+  });
+  return {rowPanelBytes, colPanelBytes};
+}
+
+/// Returns the row and the column of the tile `k` of a `rows` x `cols` grid
+/// walked in `traversal` order.
+static std::pair<Value, Value> getTileCoords(OpBuilder &b, Location loc,
+                                             Value k, int64_t rows,
+                                             int64_t cols,
+                                             tpp::TileTraversal traversal) {
+  auto cst = [&](int64_t value) -> Value {
+    return b.create<arith::ConstantIndexOp>(loc, value);
+  };
+  auto div = [&](Value lhs, int64_t rhs) -> Value {
+    return b.create<arith::DivUIOp>(loc, lhs, cst(rhs));
+  };
+  auto rem = [&](Value lhs, int64_t rhs) -> Value {
+    return b.create<arith::RemUIOp>(loc, lhs, cst(rhs));
+  };
+  int64_t size = traversal.size;
+  switch (traversal.order) {
+  case tpp::TileTraversal::RowMajor:
+    return {div(k, cols), rem(k, cols)};
+  case tpp::TileTraversal::ColMajor:
+    return {rem(k, rows), div(k, rows)};
+  case tpp::TileTraversal::Grouped: {
+    // The last group may have fewer rows.
+    Value first = b.create<arith::MulIOp>(loc, div(k, size * cols), cst(size));
+    Value within = rem(k, size * cols);
+    Value groupRows = b.create<arith::MinUIOp>(
+        loc, b.create<arith::SubIOp>(loc, cst(rows), first), cst(size));
+    Value row = b.create<arith::AddIOp>(
+        loc, first, b.create<arith::RemUIOp>(loc, within, groupRows));
+    return {row, b.create<arith::DivUIOp>(loc, within, groupRows)};
+  }
+  case tpp::TileTraversal::Morton: {
+    // The odd bits of the position in the block give the row, the even ones
+    // the column.
+    Value block = div(k, size * size);
+    Value within = rem(k, size * size);
+    int64_t blocksPerRow = cols / size;
+    Value row =
+        b.create<arith::MulIOp>(loc, div(block, blocksPerRow), cst(size));
+    Value col =
+        b.create<arith::MulIOp>(loc, rem(block, blocksPerRow), cst(size));
+    for (int64_t bit = 0; (int64_t(1) << bit) < size; ++bit) {
+      Value mask = cst(int64_t(1) << bit);
+      row = b.create<arith::OrIOp>(
+          loc, row,
+          b.create<arith::AndIOp>(
+              loc, b.create<arith::ShRUIOp>(loc, within, cst(bit + 1)), mask));
+      col = b.create<arith::OrIOp>(
+          loc, col,
+          b.create<arith::AndIOp>(
+              loc, b.create<arith::ShRUIOp>(loc, within, cst(bit)), mask));
+    }
+    return {row, col};
+  }
+  }
+  llvm_unreachable("unknown tile traversal");
+}
+
+/// Walks the 2-D grid of tiles of `op` in the order picked by the cost model
+/// among `order`, all of them if not set. The tiles are numbered along the
+/// order and dealt round-robin to `numThreads` threads, so that the threads
+/// run consecutive tiles at the same time and share their panels in cache:
+///   scf.parallel (%t) = (0) to (numThreads) step (1)
+///     scf.for %round = 0 to ceil(tiles / numThreads)
+///       %k = %round * numThreads + %t
+///       scf.if (%k < tiles)
+///         (%i0, %i1) = lb + tile(%k) * step
+///         ...
+/// The loops with more dimensions or dynamic trip counts keep their order.
+static void reorderTiles(ParallelOp op,
+                         std::optional<tpp::TileTraversal::Order> order,
+                         int64_t numThreads) {
+  if (op.getNumLoops() != 2)
+    return;
+  std::optional<int64_t> rows = getStaticTripCount(op, 0);
+  std::optional<int64_t> cols = getStaticTripCount(op, 1);
+  if (!rows || !cols)
+    return;
+  auto [rowPanelBytes, colPanelBytes] = getPanelBytes(op, *rows, *cols);
+  tpp::TileTraversal traversal = tpp::getTileTraversal(
+      *rows, *cols, rowPanelBytes, colPanelBytes, numThreads,
+      tpp::CpuTargetInfo::get(op), order);
+  if (traversal.order == tpp::TileTraversal::RowMajor)
+    return;
+
+  OpBuilder b(op);
+  Location loc = op.getLoc();
+  int64_t numTiles = *rows * *cols;
+  int64_t threads = std::min(numThreads, numTiles);
+  Value zero = b.create<arith::ConstantIndexOp>(loc, 0);
+  Value one = b.create<arith::ConstantIndexOp>(loc, 1);
+  Value threadsCst = b.create<arith::ConstantIndexOp>(loc, threads);
+  Value rounds = b.create<arith::ConstantIndexOp>(
+      loc, llvm::divideCeil(numTiles, threads));
+  auto buildTile = [&](OpBuilder &tb, Location loc, Value k) {
+    auto [row, col] = getTileCoords(tb, loc, k, *rows, *cols, traversal);
+    SmallVector<Value, 2> coords{row, col};
+    IRMapping mapping;
+    for (auto [iv, coord, lb, step] :
+         llvm::zip_equal(op.getInductionVars(), coords, op.getLowerBound(),
+                         op.getStep())) {
+      mapping.map(iv, tb.create<arith::AddIOp>(
+                          loc, lb, tb.create<arith::MulIOp>(loc, coord, step)));
+    }
+    for (Operation &bodyOp : op.getBody()->without_terminator())
+      tb.clone(bodyOp, mapping);
+  };
+  b.create<ParallelOp>(
+      loc, ValueRange{zero}, ValueRange{threadsCst}, ValueRange{one},
+      [&](OpBuilder &pb, Location loc, ValueRange threadIvs) {
+        pb.create<scf::ForOp>(
+            loc, zero, rounds, one, std::nullopt,
+            [&](OpBuilder &fb, Location loc, Value round, ValueRange) {
+              Value k = fb.create<arith::AddIOp>(
+                  loc, fb.create<arith::MulIOp>(loc, round, threadsCst),
+                  threadIvs[0]);
+              if (numTiles % threads == 0) {
+                buildTile(fb, loc, k);
+              } else {
+                Value inGrid = fb.create<arith::CmpIOp>(
+                    loc, arith::CmpIPredicate::ult, k,
+                    fb.create<arith::ConstantIndexOp>(loc, numTiles));
+                fb.create<scf::IfOp>(loc, inGrid,
+                                     [&](OpBuilder &tb, Location loc) {
+                                       buildTile(tb, loc, k);
+                                       tb.create<scf::YieldOp>(loc);
+                                     });
+              }
+              fb.create<scf::YieldOp>(loc);
+            });
+      });
+  op.erase();
 }
 
 namespace {
@@ -253,22 +576,45 @@ struct SCFParallelLoopTiling
   SCFParallelLoopTiling(const tpp::SCFParallelLoopTilingOptions &options) {
     tileSizes = options.tileSizes;
     noMinMaxBounds = options.noMinMaxBounds;
+    numThreads = options.numThreads;
+    distributeLastDim = options.distributeLastDim;
+    tileTraversal = options.tileTraversal;
   };
 
   void runOnOperation() override {
-    for (auto tileSize : tileSizes)
-      if (tileSize == 0) {
-        mlir::emitError(mlir::UnknownLoc::get(&Pass::getContext()),
-                        "tile size cannot be 0");
+    unsigned threads =
+        numThreads ? numThreads : linalgx::utils::getDefaultNumThreads();
+    auto *parentOp = getOperation();
+    // No order is given for auto, the cost model picks one.
+    std::optional<tpp::TileTraversal::Order> order;
+    if (tileTraversal != "auto") {
+      order = llvm::StringSwitch<std::optional<tpp::TileTraversal::Order>>(
+                  tileTraversal)
+                  .Case("row", tpp::TileTraversal::RowMajor)
+                  .Case("col", tpp::TileTraversal::ColMajor)
+                  .Case("grouped", tpp::TileTraversal::Grouped)
+                  .Case("morton", tpp::TileTraversal::Morton)
+                  .Default(std::nullopt);
+      if (!order) {
+        parentOp->emitError("unknown tile traversal: ") << tileTraversal;
         return signalPassFailure();
       }
-    auto *parentOp = getOperation();
+    }
     SmallVector<ParallelOp, 2> innermostPloops;
     getInnermostParallelLoops(parentOp, innermostPloops);
     for (ParallelOp ploop : innermostPloops) {
       // FIXME: Add reduction support.
-      if (ploop.getNumReductions() == 0)
-        tileParallelLoop(ploop, tileSizes, noMinMaxBounds);
+      if (ploop.getNumReductions() != 0)
+        continue;
+      SmallVector<unsigned> sizes(tileSizes.begin(), tileSizes.end());
+      if (distributeLastDim && ploop.getNumLoops() > 1) {
+        sizes = rotateTileSizes(tileSizes, ploop.getNumLoops());
+        ploop = rotateParallelLoop(ploop);
+      }
+      ParallelOp tiledLoop = tileParallelLoop(
+          ploop, getTileSizes(ploop, sizes, threads), noMinMaxBounds);
+      if (tiledLoop && order != tpp::TileTraversal::RowMajor)
+        reorderTiles(tiledLoop, order, threads);
     }
   }
 };
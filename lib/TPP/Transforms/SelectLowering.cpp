@@ -0,0 +1,174 @@
+//===- SelectLowering.cpp ----------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the per-operation selection of the lowering of the
+// linalg contractions and element-wise operations.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Dialect/Xsmm/XsmmEnum.h"
+#include "TPP/Passes.h"
+#include "TPP/Transforms/Utils/BlockingCostModel.h"
+#include "TPP/Transforms/Utils/TransformUtils.h"
+#include "TPP/Transforms/Utils/XsmmProfile.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/Linalg/IR/LinalgInterfaces.h"
+#include "llvm/Support/Debug.h"
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_SELECTLOWERING
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+#define DEBUG_TYPE "select-lowering"
+
+namespace {
+
+// Return true if all the operands of `linalgOp` are f32 buffers.
+static bool hasF32Operands(linalg::LinalgOp linalgOp) {
+  return llvm::all_of(linalgOp->getOperandTypes(), [](Type type) {
+    auto memrefType = dyn_cast<MemRefType>(type);
+    return memrefType && memrefType.getElementType().isF32();
+  });
+}
+
+// Return the product of the static `sizes` of `dims`.
+static int64_t getSizeOfDims(ArrayRef<int64_t> sizes, ArrayRef<unsigned> dims) {
+  int64_t size = 1;
+  for (unsigned dim : dims)
+    size *= sizes[dim];
+  return size;
+}
+
+// Return true if the micro-kernels of the vector lowering are expected to be
+// faster than libxsmm for the contraction `linalgOp`: its whole accumulator
+// is a single register tile, computed without loops by the FMA kernel.
+static bool preferVectorContraction(linalg::LinalgOp linalgOp,
+                                    const linalg::ContractionDimensions &dims,
+                                    const CpuTargetInfo &target) {
+  // The vectorization only handles the brgemms and generics.
+  if (!isa<linalg::BatchReduceMatmulOp, linalg::GenericOp>(linalgOp))
+    return false;
+  // Low precision contractions and AMX tiles are faster in libxsmm.
+  if (!hasF32Operands(linalgOp) || target.hasAmx)
+    return false;
+  if (!dims.batch.empty())
+    return false;
+  SmallVector<int64_t> sizes = linalgOp.getStaticLoopRanges();
+  int64_t sizeM = getSizeOfDims(sizes, dims.m);
+  int64_t sizeN = getSizeOfDims(sizes, dims.n);
+  auto registerBlock =
+      getRegisterBlock(sizeM, sizeN, Float32Type::get(linalgOp.getContext()),
+                       target);
+  return succeeded(registerBlock) &&
+         *registerBlock == std::make_pair(sizeM, sizeN);
+}
+
+// Return true if the vector lowering is expected to be faster than libxsmm
+// for the element-wise `linalgOp`: all its operands fit in the vector
+// registers, so that the call to libxsmm would dominate.
+static bool preferVectorElementwise(linalg::LinalgOp linalgOp,
+                                    const CpuTargetInfo &target) {
+  if (!isa<linalg::GenericOp>(linalgOp) || !hasF32Operands(linalgOp))
+    return false;
+  int64_t numElements = 1;
+  for (int64_t size : linalgOp.getStaticLoopRanges())
+    numElements *= size;
+  int64_t lanes = target.vectorWidth / 32;
+  return numElements * linalgOp->getNumOperands() <=
+         target.numVectorRegisters * lanes;
+}
+
+// Return true if the libxsmm kernel of the contraction `linalgOp` achieved
+// less than `threshold` of the fastest kernel of the profile. Only the f32
+// contractions the vector lowering takes are looked up.
+static bool isUnderperforming(linalg::LinalgOp linalgOp,
+                              const linalg::ContractionDimensions &dims,
+                              const XsmmProfile &profile, double threshold,
+                              const CpuTargetInfo &target) {
+  if (!isa<linalg::BatchReduceMatmulOp, linalg::GenericOp>(linalgOp) ||
+      !hasF32Operands(linalgOp) || target.hasAmx || !dims.batch.empty())
+    return false;
+  // The innermost reduction is the K of the kernel, the others are the
+  // batch of the brgemm.
+  SmallVector<int64_t> sizes = linalgOp.getStaticLoopRanges();
+  int64_t sizeM = getSizeOfDims(sizes, dims.m);
+  int64_t sizeN = getSizeOfDims(sizes, dims.n);
+  int64_t sizeK = sizes[dims.k.back()];
+  auto efficiency =
+      profile.getEfficiency(static_cast<int64_t>(xsmm::DataType::F32), sizeM,
+                            sizeN, sizeK);
+  if (!efficiency || *efficiency >= threshold)
+    return false;
+  LLVM_DEBUG(llvm::dbgs() << "[SelectLowering] kernel " << sizeM << "x"
+                          << sizeN << "x" << sizeK << " achieved "
+                          << *efficiency << " of the fastest\n");
+  return succeeded(getRegisterBlock(sizeM, sizeN,
+                                    Float32Type::get(linalgOp.getContext()),
+                                    target, /*allowRemainder=*/true));
+}
+
+struct SelectLowering
+    : public tpp::impl::SelectLoweringBase<SelectLowering> {
+  using SelectLoweringBase::SelectLoweringBase;
+
+  LogicalResult initialize(MLIRContext *ctx) override {
+    if (profile.empty())
+      return success();
+    std::string error;
+    auto loaded = XsmmProfile::load(profile, error);
+    if (failed(loaded))
+      return emitError(UnknownLoc::get(ctx)) << "select-lowering: " << error;
+    xsmmProfile = std::move(*loaded);
+    return success();
+  }
+
+  void runOnOperation() override {
+    auto funcOp = getOperation();
+    auto target = CpuTargetInfo::get(funcOp, /*fromTargetArch=*/true);
+    Builder builder(&getContext());
+
+    funcOp->walk([&](linalg::LinalgOp linalgOp) {
+      if (linalgOp->hasAttr(linalgx::utils::kLowering) ||
+          !linalgOp.hasPureBufferSemantics() || linalgOp.hasDynamicShape())
+        return;
+
+      StringRef lowering;
+      if (auto dims = linalgx::utils::isContraction(linalgOp);
+          succeeded(dims)) {
+        bool preferVector =
+            preferVectorContraction(linalgOp, *dims, target) ||
+            (xsmmProfile && isUnderperforming(linalgOp, *dims, *xsmmProfile,
+                                              profileThreshold, target));
+        lowering = preferVector ? linalgx::utils::kLoweringVector
+                                : linalgx::utils::kLoweringXsmm;
+      } else if (linalg::isElementwise(linalgOp)) {
+        lowering = preferVectorElementwise(linalgOp, target)
+                       ? linalgx::utils::kLoweringVector
+                       : linalgx::utils::kLoweringXsmm;
+      } else {
+        return;
+      }
+      LLVM_DEBUG(llvm::dbgs() << "[SelectLowering] " << lowering << ": "
+                              << linalgOp << "\n");
+      linalgOp->setAttr(linalgx::utils::kLowering,
+                        builder.getStringAttr(lowering));
+    });
+  }
+
+private:
+  std::optional<XsmmProfile> xsmmProfile;
+};
+
+} // namespace
@@ -0,0 +1,347 @@
+//===- SparsifyBrgemmWeights.cpp ---------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the block-sparse rewrite of brgemms on constant
+// weights with few non-zero blocks.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Dialect/Xsmm/XsmmOps.h"
+#include "TPP/Passes.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Arith/Utils/Utils.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/IR/PatternMatch.h"
+#include "mlir/IR/SymbolTable.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/Support/Debug.h"
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_SPARSIFYBRGEMMWEIGHTS
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+using namespace mlir;
+
+#define DEBUG_TYPE "sparsify-brgemm-weights"
+
+namespace {
+
+// A row of blocks of constant weights, the brgemm reduces over its columns.
+struct WeightRow {
+  memref::GlobalOp global;
+  DenseElementsAttr values;
+  OpFoldResult row;
+};
+
+// Block-sparse encoding of constant weights. The non-zero blocks are stored
+// row after row, a row without any holds a single zero block so that every
+// brgemm still initializes its output. Each row of the offset tables lists
+// the byte offsets of the blocks of A and B the row reduces over, `batches`
+// their number.
+struct SparseWeights {
+  memref::GlobalOp blocks;
+  memref::GlobalOp offsetsA;
+  memref::GlobalOp offsetsB;
+  memref::GlobalOp batches;
+};
+
+// Matches B of `brgemmOp` as a full row of blocks of a constant global, i.e.
+// a rank-reducing subview [row, 0, ...] [1, ...] of the global.
+static FailureOr<WeightRow> getWeightRow(xsmm::BrgemmOp brgemmOp,
+                                         SymbolTable &symbolTable) {
+  auto subView = brgemmOp.getOperandB().getDefiningOp<memref::SubViewOp>();
+  if (!subView)
+    return failure();
+  auto getGlobalOp = subView.getSource().getDefiningOp<memref::GetGlobalOp>();
+  if (!getGlobalOp)
+    return failure();
+  auto global = symbolTable.lookup<memref::GlobalOp>(getGlobalOp.getName());
+  if (!global || !global.getConstant())
+    return failure();
+  auto values =
+      dyn_cast_or_null<DenseElementsAttr>(global.getInitialValueAttr());
+  if (!values || values.isSplat())
+    return failure();
+
+  MemRefType sourceType = subView.getSourceType();
+  if (subView.getType().getShape() != sourceType.getShape().drop_front())
+    return failure();
+  SmallVector<OpFoldResult> offsets = subView.getMixedOffsets();
+  if (!isConstantIntValue(subView.getMixedSizes()[0], 1) ||
+      !areAllConstantIntValue(ArrayRef(offsets).drop_front(), 0) ||
+      !areAllConstantIntValue(subView.getMixedStrides(), 1)) {
+    return failure();
+  }
+  return WeightRow{global, values, offsets[0]};
+}
+
+// Number of elements of a block, the two outer dimensions index the blocks.
+static int64_t getBlockSize(MemRefType type) {
+  return type.getNumElements() / (type.getDimSize(0) * type.getDimSize(1));
+}
+
+static memref::GlobalOp createConstantGlobal(OpBuilder &builder,
+                                             SymbolTable &symbolTable,
+                                             Location loc, StringRef name,
+                                             DenseElementsAttr init,
+                                             IntegerAttr alignment) {
+  auto type = MemRefType::get(init.getType().getShape(),
+                              init.getType().getElementType());
+  auto global = builder.create<memref::GlobalOp>(
+      loc, name, builder.getStringAttr("private"), type, init,
+      /*constant=*/true, alignment);
+  symbolTable.insert(global);
+  return global;
+}
+
+// Encodes the weights if at most `maxDensity` of their blocks are non-zero.
+// `strideA` is the distance, in elements, between the blocks of A.
+static std::optional<SparseWeights>
+encodeWeights(OpBuilder &builder, SymbolTable &symbolTable,
+              const WeightRow &weights, int64_t strideA, double maxDensity) {
+  MemRefType type = weights.global.getType();
+  int64_t rows = type.getDimSize(0);
+  int64_t cols = type.getDimSize(1);
+  int64_t blockSize = getBlockSize(type);
+  // The raw data of a non-splat attribute holds its elements back to back,
+  // unless they are narrower than a byte.
+  Type elementType = type.getElementType();
+  if (elementType.getIntOrFloatBitWidth() % 8 != 0)
+    return std::nullopt;
+  int64_t elementBytes = elementType.getIntOrFloatBitWidth() / 8;
+  int64_t blockBytes = blockSize * elementBytes;
+  ArrayRef<char> rawData = weights.values.getRawData();
+
+  // -0.0 is a zero too, the check goes through the typed values.
+  auto isZeroBlock = [&](int64_t block) {
+    int64_t begin = block * blockSize;
+    if (isa<FloatType>(elementType)) {
+      auto it = weights.values.value_begin<APFloat>() + begin;
+      return llvm::all_of(llvm::make_range(it, it + blockSize),
+                          [](const APFloat &value) { return value.isZero(); });
+    }
+    auto it = weights.values.value_begin<APInt>() + begin;
+    return llvm::all_of(llvm::make_range(it, it + blockSize),
+                        [](const APInt &value) { return value.isZero(); });
+  };
+
+  SmallVector<SmallVector<int64_t>> nonZeroCols(rows);
+  int64_t numNonZeros = 0;
+  for (int64_t row = 0; row < rows; row++) {
+    for (int64_t col = 0; col < cols; col++) {
+      if (isZeroBlock(row * cols + col))
+        continue;
+      nonZeroCols[row].push_back(col);
+      numNonZeros++;
+    }
+  }
+  double density = static_cast<double>(numNonZeros) / (rows * cols);
+  LLVM_DEBUG(llvm::dbgs() << "[SparsifyBrgemmWeights] Density of "
+                          << weights.global.getSymName() << ": " << density
+                          << "\n");
+  if (density > maxDensity)
+    return std::nullopt;
+
+  int64_t maxBatch = 1;
+  for (ArrayRef<int64_t> colsOfRow : nonZeroCols)
+    maxBatch = std::max(maxBatch, static_cast<int64_t>(colsOfRow.size()));
+
+  // The blocks are copied as raw bytes, the offsets of B are byte offsets.
+  SmallVector<char> blocks;
+  SmallVector<int64_t> offsetsA(rows * maxBatch, 0);
+  SmallVector<int64_t> offsetsB(rows * maxBatch, 0);
+  SmallVector<int64_t> batches;
+  for (int64_t row = 0; row < rows; row++) {
+    if (nonZeroCols[row].empty()) {
+      offsetsB[row * maxBatch] = blocks.size();
+      blocks.append(blockBytes, 0);
+      batches.push_back(1);
+      continue;
+    }
+    for (auto [idx, col] : llvm::enumerate(nonZeroCols[row])) {
+      offsetsA[row * maxBatch + idx] = col * strideA * elementBytes;
+      offsetsB[row * maxBatch + idx] = blocks.size();
+      const char *block = rawData.data() + (row * cols + col) * blockBytes;
+      blocks.append(block, block + blockBytes);
+    }
+    batches.push_back(nonZeroCols[row].size());
+  }
+
+  OpBuilder::InsertionGuard guard(builder);
+  builder.setInsertionPoint(weights.global);
+  Location loc = weights.global.getLoc();
+  SmallVector<int64_t> blocksShape = {
+      static_cast<int64_t>(blocks.size()) / blockBytes};
+  llvm::append_range(blocksShape, type.getShape().drop_front(2));
+  auto blocksInit = DenseElementsAttr::getFromRawBuffer(
+      RankedTensorType::get(blocksShape, elementType), blocks);
+
+  IntegerType integer64 = builder.getI64Type();
+  auto offsetsType = RankedTensorType::get({rows, maxBatch}, integer64);
+  auto offsetsAInit =
+      DenseElementsAttr::get(offsetsType, ArrayRef<int64_t>(offsetsA));
+  auto offsetsBInit =
+      DenseElementsAttr::get(offsetsType, ArrayRef<int64_t>(offsetsB));
+  auto batchesInit = DenseElementsAttr::get(
+      RankedTensorType::get({rows}, integer64), ArrayRef<int64_t>(batches));
+
+  SparseWeights sparseWeights;
+  sparseWeights.blocks =
+      createConstantGlobal(builder, symbolTable, loc, "__sparse_blocks",
+                           blocksInit, weights.global.getAlignmentAttr());
+  sparseWeights.offsetsA = createConstantGlobal(
+      builder, symbolTable, loc, "__sparse_offsets_a", offsetsAInit, nullptr);
+  sparseWeights.offsetsB = createConstantGlobal(
+      builder, symbolTable, loc, "__sparse_offsets_b", offsetsBInit, nullptr);
+  sparseWeights.batches = createConstantGlobal(
+      builder, symbolTable, loc, "__sparse_batches", batchesInit, nullptr);
+  return sparseWeights;
+}
+
+static Value getGlobal(OpBuilder &builder, Location loc,
+                       memref::GlobalOp global) {
+  return builder.create<memref::GetGlobalOp>(loc, global.getType(),
+                                             global.getSymName());
+}
+
+// Returns the offsets of row `row` of `table`.
+static Value getOffsetsOfRow(OpBuilder &builder, Location loc,
+                             memref::GlobalOp table, Value row) {
+  MemRefType tableType = table.getType();
+  int64_t maxBatch = tableType.getDimSize(1);
+  SmallVector<OpFoldResult> offsets = {row, builder.getIndexAttr(0)};
+  SmallVector<OpFoldResult> sizes = {builder.getIndexAttr(1),
+                                     builder.getIndexAttr(maxBatch)};
+  SmallVector<OpFoldResult> strides(2, builder.getIndexAttr(1));
+  auto listType = memref::SubViewOp::inferRankReducedResultType(
+      {maxBatch}, tableType, offsets, sizes, strides);
+  return builder.create<memref::SubViewOp>(loc, cast<MemRefType>(listType),
+                                           getGlobal(builder, loc, table),
+                                           offsets, sizes, strides);
+}
+
+static void rewriteToOffsetBrgemm(RewriterBase &rewriter,
+                                  xsmm::BrgemmOp brgemmOp,
+                                  xsmm::BrgemmDispatchOp dispatchOp,
+                                  OpFoldResult row,
+                                  const SparseWeights &weights) {
+  Location loc = brgemmOp.getLoc();
+
+  // Same kernel, reducing over the listed blocks instead of a fixed stride.
+  rewriter.setInsertionPointAfter(dispatchOp);
+  SmallVector<Attribute> flags;
+  for (Attribute flag : dispatchOp.getFlags()) {
+    if (cast<xsmm::GemmFlagsAttr>(flag).getValue() != xsmm::GemmFlags::NONE)
+      flags.push_back(flag);
+  }
+  flags.push_back(xsmm::GemmFlagsAttr::get(
+      rewriter.getContext(), xsmm::GemmFlags::BATCH_REDUCE_OFFSET));
+  Value dispatch = rewriter.create<xsmm::BrgemmDispatchOp>(
+      loc, rewriter.getI64Type(), dispatchOp.getDynamicInputs(),
+      dispatchOp.getInputsAttr(), rewriter.getArrayAttr(flags),
+      dispatchOp.getDataTypeAttr(), dispatchOp.getOutputTypeAttr());
+
+  rewriter.setInsertionPoint(brgemmOp);
+  Value rowIdx = getValueOrCreateConstantIndexOp(rewriter, loc, row);
+  Value batch = rewriter.create<memref::LoadOp>(
+      loc, getGlobal(rewriter, loc, weights.batches), rowIdx);
+  Value blocks = getGlobal(rewriter, loc, weights.blocks);
+  Value offsetsA = getOffsetsOfRow(rewriter, loc, weights.offsetsA, rowIdx);
+  Value offsetsB = getOffsetsOfRow(rewriter, loc, weights.offsetsB, rowIdx);
+  rewriter.replaceOpWithNewOp<xsmm::BrgemmIndirectOp>(
+      brgemmOp,
+      xsmm::BatchReduceKindAttr::get(rewriter.getContext(),
+                                     xsmm::BatchReduceKind::OFFSET),
+      brgemmOp.getDataTypeAttr(), dispatch, brgemmOp.getOperandA(), blocks,
+      brgemmOp.getOutput(), offsetsA, offsetsB, batch);
+}
+
+struct SparsifyBrgemmWeights
+    : public tpp::impl::SparsifyBrgemmWeightsBase<SparsifyBrgemmWeights> {
+  using SparsifyBrgemmWeightsBase::SparsifyBrgemmWeightsBase;
+
+  void runOnOperation() override {
+    ModuleOp module = getOperation();
+    SymbolTable symbolTable(module);
+    SmallVector<xsmm::BrgemmOp> brgemmOps;
+    module->walk([&](xsmm::BrgemmOp brgemmOp) {
+      if (!brgemmOp.hasPrefetch())
+        brgemmOps.push_back(brgemmOp);
+    });
+
+    // Brgemms on the same weights with the same blocks of A share their
+    // encoding.
+    DenseMap<std::pair<Operation *, int64_t>, std::optional<SparseWeights>>
+        encodings;
+    IRRewriter rewriter(&getContext());
+    llvm::SetVector<Operation *> sparsifiedGlobals;
+    for (xsmm::BrgemmOp brgemmOp : brgemmOps) {
+      auto dispatchOp =
+          brgemmOp.getDispatch().getDefiningOp<xsmm::BrgemmDispatchOp>();
+      if (!dispatchOp || dispatchOp.hasDynamicInputs())
+        continue;
+      if (llvm::any_of(dispatchOp.getFlags(), [](Attribute flag) {
+            auto gemmFlag = cast<xsmm::GemmFlagsAttr>(flag).getValue();
+            return gemmFlag == xsmm::GemmFlags::BATCH_REDUCE_ADDRESS ||
+                   gemmFlag == xsmm::GemmFlags::BATCH_REDUCE_OFFSET;
+          })) {
+        continue;
+      }
+      FailureOr<WeightRow> weights = getWeightRow(brgemmOp, symbolTable);
+      if (failed(weights))
+        continue;
+      // The batch must be the whole row, with a stride of B of one block. The
+      // inputs are [m, n, k, lda, ldb, ldc, strideA, strideB].
+      MemRefType weightsType = weights->global.getType();
+      ArrayRef<int64_t> inputs = dispatchOp.getInputs();
+      if (getConstantIntValue(brgemmOp.getBatch()) !=
+              weightsType.getDimSize(1) ||
+          inputs[7] != getBlockSize(weightsType)) {
+        LLVM_DEBUG(llvm::dbgs() << "[SparsifyBrgemmWeights] Batch is not a "
+                                   "row of blocks\n");
+        continue;
+      }
+
+      auto key = std::make_pair(weights->global.getOperation(), inputs[6]);
+      auto it = encodings.find(key);
+      if (it == encodings.end()) {
+        it = encodings
+                 .try_emplace(key, encodeWeights(rewriter, symbolTable,
+                                                 *weights, inputs[6],
+                                                 maxDensity))
+                 .first;
+      }
+      if (!it->second)
+        continue;
+      auto subView = brgemmOp.getOperandB().getDefiningOp<memref::SubViewOp>();
+      rewriteToOffsetBrgemm(rewriter, brgemmOp, dispatchOp, weights->row,
+                            *it->second);
+      if (dispatchOp->use_empty())
+        rewriter.eraseOp(dispatchOp);
+      Operation *getGlobalOp = subView.getSource().getDefiningOp();
+      if (subView->use_empty())
+        rewriter.eraseOp(subView);
+      if (getGlobalOp->use_empty())
+        rewriter.eraseOp(getGlobalOp);
+      sparsifiedGlobals.insert(weights->global);
+    }
+
+    // Drop the dense weights once no brgemm reads them.
+    for (Operation *global : sparsifiedGlobals) {
+      if (SymbolTable::symbolKnownUseEmpty(global, module))
+        symbolTable.erase(global);
+    }
+  }
+};
+
+} // namespace
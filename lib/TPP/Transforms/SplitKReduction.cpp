@@ -0,0 +1,558 @@
+//===- SplitKReduction.cpp ---------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the parallel split of the reduction of contractions
+// with fewer parallel tiles than threads (split-K), and of the tiles of their
+// last wave (stream-K).
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "TPP/Transforms/Utils/TransformUtils.h"
+
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/Linalg/IR/LinalgInterfaces.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/SCF/Transforms/TileUsingInterface.h"
+#include "mlir/Dialect/Tensor/IR/Tensor.h"
+#include "mlir/Dialect/Utils/IndexingUtils.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/Dialect/Utils/StructuredOpsUtils.h"
+#include "mlir/IR/PatternMatch.h"
+#include "llvm/Support/MathExtras.h"
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_SPLITKREDUCTION
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+namespace {
+
+// Tile of the dimensions of plain matmuls in TileConsumerAndFuseProducers.
+static constexpr int64_t kMatmulTile = 32;
+
+// Return the smallest divisor of `size` not smaller than `count`, `size` if
+// `count` is larger.
+static int64_t getDivisorAtLeast(int64_t size, int64_t count) {
+  for (int64_t divisor = std::max<int64_t>(count, 1); divisor < size;
+       divisor++) {
+    if (size % divisor == 0)
+      return divisor;
+  }
+  return size;
+}
+
+// Return the largest divisor of `size` not larger than `count`.
+static int64_t getDivisorAtMost(int64_t size, int64_t count) {
+  for (int64_t divisor = std::min(count, size); divisor > 1; divisor--) {
+    if (size % divisor == 0)
+      return divisor;
+  }
+  return 1;
+}
+
+// Return the parallel tiles of `linalgOp` as picked by the default tiling of
+// TileConsumerAndFuseProducers: 32 on the dimensions of plain matmuls, 1 on
+// the outer blocks of blocked contractions, 0 on the dimensions not tiled.
+static SmallVector<int64_t>
+getParallelTiles(linalg::LinalgOp linalgOp,
+                 const linalg::ContractionDimensions &dims) {
+  SmallVector<int64_t, 4> loopsRange = linalgOp.getStaticLoopRanges();
+  SmallVector<int64_t> tiles(linalgOp.getNumLoops(), 0);
+  if (linalgOp.getNumLoops() == 3 && dims.batch.empty()) {
+    for (unsigned dim : {dims.m.front(), dims.n.front()}) {
+      if (loopsRange[dim] % kMatmulTile == 0)
+        tiles[dim] = kMatmulTile;
+    }
+    return tiles;
+  }
+  for (unsigned dim : llvm::drop_end(dims.m))
+    tiles[dim] = 1;
+  for (unsigned dim : llvm::drop_end(dims.n))
+    tiles[dim] = 1;
+  for (unsigned dim : dims.batch)
+    tiles[dim] = 1;
+  return tiles;
+}
+
+// Return the tiles of the reduction of the partial accumulators of shape
+// [splits, `shape`], to have at least `numThreads` of them when possible.
+static SmallVector<OpFoldResult> getCombineTiles(OpBuilder &builder,
+                                                 ArrayRef<int64_t> shape,
+                                                 int64_t numThreads) {
+  SmallVector<OpFoldResult> tiles{builder.getIndexAttr(0)};
+  int64_t needed = numThreads;
+  for (int64_t size : shape) {
+    int64_t count = getDivisorAtLeast(size, std::min(needed, size));
+    tiles.push_back(builder.getIndexAttr(count > 1 ? size / count : 0));
+    needed = llvm::divideCeil(needed, count);
+  }
+  return tiles;
+}
+
+static OpFoldResult getScaledIndex(OpBuilder &builder, Location loc,
+                                   OpFoldResult index, int64_t scale,
+                                   int64_t offset = 0) {
+  if (scale == 1 && offset == 0)
+    return index;
+  AffineExpr d0;
+  bindDims(builder.getContext(), d0);
+  return affine::makeComposedFoldedAffineApply(builder, loc,
+                                               d0 * scale + offset, {index});
+}
+
+// Parallel tiles of a contraction and its reduction dimension split across
+// threads.
+struct ContractionTiles {
+  SmallVector<int64_t> loopsRange;
+  // Tile of each loop, 0 if it is not tiled.
+  SmallVector<int64_t> tiles;
+  SmallVector<unsigned> tiledDims;
+  int64_t numTiles = 1;
+  // The outermost reduction dimension, e.g., the batch of the brgemm of
+  // blocked contractions.
+  unsigned splitDim = 0;
+};
+
+static FailureOr<ContractionTiles>
+getContractionTiles(linalg::LinalgOp linalgOp) {
+  if (!linalgOp.hasPureTensorSemantics() || linalgOp->getNumResults() != 1 ||
+      linalgOp.hasDynamicShape() ||
+      linalgOp->getParentOfType<scf::ForallOp>())
+    return failure();
+  if (!llvm::all_of(linalgOp.getIndexingMapsArray(),
+                    [](AffineMap map) { return map.isProjectedPermutation(); }))
+    return failure();
+  auto dims = linalgx::utils::isContraction(linalgOp);
+  if (failed(dims))
+    return failure();
+
+  ContractionTiles contraction;
+  contraction.loopsRange = llvm::to_vector(linalgOp.getStaticLoopRanges());
+  contraction.tiles = getParallelTiles(linalgOp, *dims);
+  for (auto [dim, tile] : llvm::enumerate(contraction.tiles)) {
+    if (tile == 0)
+      continue;
+    contraction.tiledDims.push_back(dim);
+    contraction.numTiles *= contraction.loopsRange[dim] / tile;
+  }
+  contraction.splitDim = dims->k.front();
+  return contraction;
+}
+
+// Return the number of tiles along each tiled dimension.
+static SmallVector<int64_t> getTileCounts(const ContractionTiles &contraction) {
+  SmallVector<int64_t> counts;
+  for (unsigned dim : contraction.tiledDims) {
+    counts.push_back(contraction.loopsRange[dim] / contraction.tiles[dim]);
+  }
+  return counts;
+}
+
+// Return the position of the tile of linear index `tile` along each tiled
+// dimension, the last one varying the fastest.
+static SmallVector<OpFoldResult>
+delinearizeTile(OpBuilder &builder, Location loc,
+                const ContractionTiles &contraction, OpFoldResult tile) {
+  SmallVector<int64_t> counts = getTileCounts(contraction);
+  SmallVector<int64_t> strides = computeSuffixProduct(counts);
+  AffineExpr d0;
+  bindDims(builder.getContext(), d0);
+  SmallVector<OpFoldResult> ids;
+  for (size_t idx = 0; idx < counts.size(); idx++) {
+    AffineExpr expr = d0.floorDiv(strides[idx]);
+    if (idx != 0)
+      expr = expr % counts[idx];
+    ids.push_back(
+        affine::makeComposedFoldedAffineApply(builder, loc, expr, {tile}));
+  }
+  return ids;
+}
+
+// Slice of the loops of a contraction computed by a tile.
+struct LoopSlice {
+  SmallVector<OpFoldResult> offsets;
+  SmallVector<int64_t> sizes;
+};
+
+// Return the slice of the loops of the tile at `tileIds` and, if `splitId`
+// is set, of its `splitId`-th share of the `numSplits` of the reduction.
+static LoopSlice getLoopSlice(OpBuilder &builder, Location loc,
+                              const ContractionTiles &contraction,
+                              ArrayRef<OpFoldResult> tileIds,
+                              OpFoldResult splitId = nullptr,
+                              int64_t numSplits = 1) {
+  LoopSlice slice;
+  slice.offsets.assign(contraction.loopsRange.size(),
+                       builder.getIndexAttr(0));
+  slice.sizes = contraction.loopsRange;
+  for (auto [id, dim] : llvm::zip(tileIds, contraction.tiledDims)) {
+    slice.sizes[dim] = contraction.tiles[dim];
+    slice.offsets[dim] =
+        getScaledIndex(builder, loc, id, contraction.tiles[dim]);
+  }
+  if (splitId) {
+    unsigned dim = contraction.splitDim;
+    slice.sizes[dim] = contraction.loopsRange[dim] / numSplits;
+    slice.offsets[dim] =
+        getScaledIndex(builder, loc, splitId, slice.sizes[dim]);
+  }
+  return slice;
+}
+
+// Offsets, sizes and shape of the tile of the output of `linalgOp` computed
+// by `slice`.
+struct OutputTile {
+  SmallVector<OpFoldResult> offsets;
+  SmallVector<OpFoldResult> sizes;
+  SmallVector<int64_t> shape;
+};
+
+static OutputTile getOutputTile(OpBuilder &builder, linalg::LinalgOp linalgOp,
+                                const LoopSlice &slice) {
+  OutputTile tile;
+  AffineMap initMap =
+      linalgOp.getMatchingIndexingMap(linalgOp.getDpsInitOperand(0));
+  for (unsigned result : llvm::seq<unsigned>(0, initMap.getNumResults())) {
+    unsigned dim = initMap.getDimPosition(result);
+    tile.offsets.push_back(slice.offsets[dim]);
+    tile.sizes.push_back(builder.getIndexAttr(slice.sizes[dim]));
+    tile.shape.push_back(slice.sizes[dim]);
+  }
+  return tile;
+}
+
+// Compute `slice` of `linalgOp` into the accumulators `acc`: a clone of
+// `linalgOp` on the slices of its inputs.
+static Value computeSlice(OpBuilder &builder, Location loc,
+                          linalg::LinalgOp linalgOp, const LoopSlice &slice,
+                          Value acc) {
+  SmallVector<Value> operands;
+  for (OpOperand *input : linalgOp.getDpsInputOperands()) {
+    AffineMap map = linalgOp.getMatchingIndexingMap(input);
+    SmallVector<OpFoldResult> offsets, sizes;
+    for (unsigned result : llvm::seq<unsigned>(0, map.getNumResults())) {
+      unsigned dim = map.getDimPosition(result);
+      offsets.push_back(slice.offsets[dim]);
+      sizes.push_back(builder.getIndexAttr(slice.sizes[dim]));
+    }
+    SmallVector<OpFoldResult> strides(map.getNumResults(),
+                                      builder.getIndexAttr(1));
+    operands.push_back(builder.create<tensor::ExtractSliceOp>(
+        loc, input->get(), offsets, sizes, strides));
+  }
+  operands.push_back(acc);
+  return clone(builder, linalgOp.getOperation(), TypeRange{acc.getType()},
+               operands)
+      ->getResult(0);
+}
+
+// Add the partial accumulators of `partial` along its outermost dimension
+// into `init`.
+static linalg::ReduceOp createCombine(OpBuilder &builder, Location loc,
+                                      Value partial, Value init) {
+  Type elementType = getElementTypeOrSelf(init.getType());
+  return builder.create<linalg::ReduceOp>(
+      loc, ValueRange{partial}, ValueRange{init}, SmallVector<int64_t>{0},
+      [&](OpBuilder &builder, Location loc, ValueRange args) {
+        Value sum;
+        if (isa<FloatType>(elementType))
+          sum = builder.create<arith::AddFOp>(loc, args[0], args[1]);
+        else
+          sum = builder.create<arith::AddIOp>(loc, args[0], args[1]);
+        builder.create<linalg::YieldOp>(loc, sum);
+      });
+}
+
+// Return zero-filled partial accumulators of shape [`prefix`, `shape`].
+static Value createPartialAccumulators(OpBuilder &builder, Location loc,
+                                       ArrayRef<int64_t> prefix,
+                                       ArrayRef<int64_t> shape,
+                                       Type elementType) {
+  SmallVector<int64_t> partialShape(prefix.begin(), prefix.end());
+  llvm::append_range(partialShape, shape);
+  Value partial =
+      builder.create<tensor::EmptyOp>(loc, partialShape, elementType);
+  Value zero = builder.create<arith::ConstantOp>(
+      loc, elementType, builder.getZeroAttr(elementType));
+  return builder.create<linalg::FillOp>(loc, zero, partial).getResult(0);
+}
+
+// Create an scf.forall over `numIters` whose contractions are not tiled
+// again and set the insertion point before its terminator.
+static scf::ForallOp createDistributedLoop(OpBuilder &builder, Location loc,
+                                           ArrayRef<int64_t> numIters,
+                                           Value dest) {
+  SmallVector<OpFoldResult> ubs;
+  for (int64_t iters : numIters)
+    ubs.push_back(builder.getIndexAttr(iters));
+  auto forallOp = builder.create<scf::ForallOp>(
+      loc, ubs, ValueRange{dest}, /*mapping=*/std::nullopt);
+  forallOp->setAttr(linalgx::utils::kSplitReduction, builder.getUnitAttr());
+  builder.setInsertionPoint(forallOp.getTerminator());
+  return forallOp;
+}
+
+static void insertIntoDest(OpBuilder &builder, Location loc,
+                           scf::ForallOp forallOp, Value tile,
+                           ArrayRef<OpFoldResult> offsets,
+                           ArrayRef<OpFoldResult> sizes) {
+  OpBuilder::InsertionGuard guard(builder);
+  builder.setInsertionPointToStart(forallOp.getTerminator().getBody());
+  SmallVector<OpFoldResult> strides(offsets.size(), builder.getIndexAttr(1));
+  builder.create<tensor::ParallelInsertSliceOp>(
+      loc, tile, forallOp.getRegionIterArgs()[0], offsets, sizes, strides);
+}
+
+// Split the reduction of `contraction` across threads when its parallel
+// tiles are fewer than `numTargetTiles`, e.g. a tile per thread:
+//
+// %partial = fill(0) : [splits, C]
+// %partial = forall (split, tiles...) {
+//   %partial[split, tile] = contraction(A[tile, split], B[tile, split])
+// }
+// %C = forall (C tiles) {
+//   %C[tile] += reduce(%partial[:, tile])
+// }
+//
+// Each split computes a share of the reduction into its own accumulators,
+// the final reduction is tiled across threads as well.
+static LogicalResult splitReduction(RewriterBase &rewriter,
+                                    linalg::LinalgOp linalgOp,
+                                    const ContractionTiles &contraction,
+                                    int64_t numThreads,
+                                    int64_t numTargetTiles) {
+  // Split the reduction just enough to reach the target tiles.
+  int64_t splitSize = contraction.loopsRange[contraction.splitDim];
+  int64_t numSplits = getDivisorAtLeast(
+      splitSize,
+      std::min(llvm::divideCeil(numTargetTiles, contraction.numTiles),
+               splitSize));
+  if (numSplits < 2)
+    return failure();
+
+  Location loc = linalgOp.getLoc();
+  OpBuilder::InsertionGuard guard(rewriter);
+  rewriter.setInsertionPoint(linalgOp);
+
+  Value init = linalgOp.getDpsInits()[0];
+  auto initType = cast<RankedTensorType>(init.getType());
+  Value partial = createPartialAccumulators(
+      rewriter, loc, numSplits, initType.getShape(), initType.getElementType());
+
+  SmallVector<int64_t> numIters{numSplits};
+  llvm::append_range(numIters, getTileCounts(contraction));
+  auto forallOp = createDistributedLoop(rewriter, loc, numIters, partial);
+  SmallVector<OpFoldResult> ivs =
+      getAsOpFoldResult(forallOp.getInductionVars());
+  LoopSlice slice =
+      getLoopSlice(rewriter, loc, contraction, ArrayRef(ivs).drop_front(),
+                   ivs[0], numSplits);
+
+  // The accumulators of the split, rank-reduced to the tile of the output.
+  OutputTile tile = getOutputTile(rewriter, linalgOp, slice);
+  tile.offsets.insert(tile.offsets.begin(), ivs[0]);
+  tile.sizes.insert(tile.sizes.begin(), rewriter.getIndexAttr(1));
+  SmallVector<OpFoldResult> strides(tile.offsets.size(),
+                                    rewriter.getIndexAttr(1));
+  Value acc = rewriter.create<tensor::ExtractSliceOp>(
+      loc, RankedTensorType::get(tile.shape, initType.getElementType()),
+      forallOp.getRegionIterArgs()[0], tile.offsets, tile.sizes, strides);
+  Value splitTile = computeSlice(rewriter, loc, linalgOp, slice, acc);
+  insertIntoDest(rewriter, loc, forallOp, splitTile, tile.offsets, tile.sizes);
+
+  // Add the partial accumulators into the original ones.
+  rewriter.setInsertionPointAfter(forallOp);
+  auto reduceOp = createCombine(rewriter, loc, forallOp.getResult(0), init);
+  Value result = reduceOp.getResult(0);
+  SmallVector<OpFoldResult> combineTiles =
+      getCombineTiles(rewriter, initType.getShape(), numThreads);
+  if (!llvm::all_of(combineTiles, isZeroIndex)) {
+    scf::SCFTilingOptions tilingOpts;
+    tilingOpts.setLoopType(scf::SCFTilingOptions::LoopType::ForallOp);
+    tilingOpts.setTileSizes(combineTiles);
+    FailureOr<scf::SCFTilingResult> tilingResult = scf::tileUsingSCF(
+        rewriter, cast<TilingInterface>(reduceOp.getOperation()), tilingOpts);
+    if (succeeded(tilingResult)) {
+      result = tilingResult->replacements[0];
+      rewriter.replaceOp(reduceOp, result);
+    }
+  }
+
+  rewriter.replaceOp(linalgOp, result);
+  return success();
+}
+
+// Balance the last wave of the tiles of `contraction` across threads when
+// its tiles are not a multiple of `numThreads` (stream-K):
+//
+// %C = forall (tile) in (full waves) {
+//   %C[tile] = contraction(A[tile], B[tile], C[tile])
+// }
+// %partial = fill(0) : [splits, last wave, tile]
+// %partial = forall (split, tile) in (splits, last wave) {
+//   %partial[split, tile] = contraction(A[tile, split], B[tile, split])
+// }
+// %C = forall (tile) in (last wave) {
+//   %C[tile] += reduce(%partial[:, tile])
+// }
+//
+// The tiles of the full waves are computed whole, the reduction of the tiles
+// of the last wave is split so that their shares keep all the threads busy,
+// and their partial accumulators are added in a fix-up loop.
+static LogicalResult streamKDecompose(RewriterBase &rewriter,
+                                      linalg::LinalgOp linalgOp,
+                                      const ContractionTiles &contraction,
+                                      int64_t numThreads) {
+  int64_t numLastTiles = contraction.numTiles % numThreads;
+  if (numLastTiles == 0)
+    return failure();
+  int64_t numFullTiles = contraction.numTiles - numLastTiles;
+  int64_t splitSize = contraction.loopsRange[contraction.splitDim];
+  int64_t numSplits = getDivisorAtMost(splitSize, numThreads / numLastTiles);
+  if (numSplits < 2)
+    return failure();
+
+  Location loc = linalgOp.getLoc();
+  OpBuilder::InsertionGuard guard(rewriter);
+  rewriter.setInsertionPoint(linalgOp);
+  Value init = linalgOp.getDpsInits()[0];
+  Type elementType = getElementTypeOrSelf(init.getType());
+
+  // Full waves, one whole tile per iteration.
+  auto fullLoop = createDistributedLoop(rewriter, loc, numFullTiles, init);
+  {
+    SmallVector<OpFoldResult> tileIds = delinearizeTile(
+        rewriter, loc, contraction, fullLoop.getInductionVars()[0]);
+    LoopSlice slice = getLoopSlice(rewriter, loc, contraction, tileIds);
+    OutputTile tile = getOutputTile(rewriter, linalgOp, slice);
+    SmallVector<OpFoldResult> strides(tile.offsets.size(),
+                                      rewriter.getIndexAttr(1));
+    Value acc = rewriter.create<tensor::ExtractSliceOp>(
+        loc, fullLoop.getRegionIterArgs()[0], tile.offsets, tile.sizes,
+        strides);
+    Value fullTile = computeSlice(rewriter, loc, linalgOp, slice, acc);
+    insertIntoDest(rewriter, loc, fullLoop, fullTile, tile.offsets,
+                   tile.sizes);
+  }
+
+  // Shares of the reduction of the tiles of the last wave.
+  rewriter.setInsertionPointAfter(fullLoop);
+  LoopSlice anySlice = getLoopSlice(
+      rewriter, loc, contraction,
+      SmallVector<OpFoldResult>(contraction.tiledDims.size(),
+                                rewriter.getIndexAttr(0)));
+  SmallVector<int64_t> tileShape =
+      getOutputTile(rewriter, linalgOp, anySlice).shape;
+  Value partial = createPartialAccumulators(
+      rewriter, loc, {numSplits, numLastTiles}, tileShape, elementType);
+  auto lastLoop = createDistributedLoop(rewriter, loc,
+                                        {numSplits, numLastTiles}, partial);
+  {
+    Value splitId = lastLoop.getInductionVars()[0];
+    Value lastId = lastLoop.getInductionVars()[1];
+    SmallVector<OpFoldResult> tileIds = delinearizeTile(
+        rewriter, loc, contraction,
+        getScaledIndex(rewriter, loc, lastId, 1, numFullTiles));
+    LoopSlice slice = getLoopSlice(rewriter, loc, contraction, tileIds,
+                                   splitId, numSplits);
+    SmallVector<OpFoldResult> offsets{splitId, lastId};
+    SmallVector<OpFoldResult> sizes(2, rewriter.getIndexAttr(1));
+    for (int64_t size : tileShape) {
+      offsets.push_back(rewriter.getIndexAttr(0));
+      sizes.push_back(rewriter.getIndexAttr(size));
+    }
+    SmallVector<OpFoldResult> strides(offsets.size(),
+                                      rewriter.getIndexAttr(1));
+    Value acc = rewriter.create<tensor::ExtractSliceOp>(
+        loc, RankedTensorType::get(tileShape, elementType),
+        lastLoop.getRegionIterArgs()[0], offsets, sizes, strides);
+    Value shareTile = computeSlice(rewriter, loc, linalgOp, slice, acc);
+    insertIntoDest(rewriter, loc, lastLoop, shareTile, offsets, sizes);
+  }
+
+  // Fix-up of the tiles of the last wave.
+  rewriter.setInsertionPointAfter(lastLoop);
+  auto fixupLoop = createDistributedLoop(rewriter, loc, numLastTiles,
+                                         fullLoop.getResult(0));
+  {
+    Value lastId = fixupLoop.getInductionVars()[0];
+    SmallVector<OpFoldResult> tileIds = delinearizeTile(
+        rewriter, loc, contraction,
+        getScaledIndex(rewriter, loc, lastId, 1, numFullTiles));
+    LoopSlice slice = getLoopSlice(rewriter, loc, contraction, tileIds);
+    OutputTile tile = getOutputTile(rewriter, linalgOp, slice);
+    SmallVector<OpFoldResult> strides(tile.offsets.size(),
+                                      rewriter.getIndexAttr(1));
+    Value acc = rewriter.create<tensor::ExtractSliceOp>(
+        loc, fixupLoop.getRegionIterArgs()[0], tile.offsets, tile.sizes,
+        strides);
+
+    SmallVector<OpFoldResult> offsets{rewriter.getIndexAttr(0), lastId};
+    SmallVector<OpFoldResult> sizes{rewriter.getIndexAttr(numSplits),
+                                    rewriter.getIndexAttr(1)};
+    SmallVector<int64_t> sharesShape{numSplits};
+    for (int64_t size : tileShape) {
+      offsets.push_back(rewriter.getIndexAttr(0));
+      sizes.push_back(rewriter.getIndexAttr(size));
+      sharesShape.push_back(size);
+    }
+    SmallVector<OpFoldResult> sharesStrides(offsets.size(),
+                                            rewriter.getIndexAttr(1));
+    Value shares = rewriter.create<tensor::ExtractSliceOp>(
+        loc, RankedTensorType::get(sharesShape, elementType),
+        lastLoop.getResult(0), offsets, sizes, sharesStrides);
+    Value fixedTile = createCombine(rewriter, loc, shares, acc).getResult(0);
+    insertIntoDest(rewriter, loc, fixupLoop, fixedTile, tile.offsets,
+                   tile.sizes);
+  }
+
+  rewriter.replaceOp(linalgOp, fixupLoop.getResult(0));
+  return success();
+}
+
+struct SplitKReduction
+    : public tpp::impl::SplitKReductionBase<SplitKReduction> {
+  using SplitKReductionBase::SplitKReductionBase;
+
+  void runOnOperation() override {
+    int64_t threads =
+        numThreads < 0 ? linalgx::utils::getDefaultNumThreads() : numThreads;
+    if (threads <= 1)
+      return;
+    int64_t numTargetTiles = threads * std::max<int64_t>(minTilesPerThread, 1);
+
+    SmallVector<linalg::LinalgOp> contractions;
+    getOperation()->walk([&](linalg::LinalgOp linalgOp) {
+      if (succeeded(linalgx::utils::isContraction(linalgOp)))
+        contractions.push_back(linalgOp);
+    });
+
+    IRRewriter rewriter(&getContext());
+    for (linalg::LinalgOp linalgOp : contractions) {
+      auto contraction = getContractionTiles(linalgOp);
+      if (failed(contraction))
+        continue;
+      if (contraction->numTiles < numTargetTiles)
+        (void)splitReduction(rewriter, linalgOp, *contraction, threads,
+                             numTargetTiles);
+      else if (streamK)
+        (void)streamKDecompose(rewriter, linalgOp, *contraction, threads);
+    }
+  }
+};
+
+} // namespace
@@ -0,0 +1,277 @@
+//===- TensorParallelMatmuls.cpp ---------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the sharding of the matmuls across the ranks of a
+// tensor-parallel kernel, with the collectives of the runtime.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "TPP/Transforms/Utils/BuilderUtils.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Bufferization/IR/Bufferization.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/Tensor/IR/Tensor.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/IR/Matchers.h"
+
+using namespace mlir;
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_TENSORPARALLELMATMULS
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+namespace {
+
+// Collective runtime entry points, see runtime/CollectiveRunnerUtils.h.
+constexpr const static llvm::StringLiteral kRankFunc = "tpp_collective_rank";
+constexpr const static llvm::StringLiteral kAllGatherFunc = "tpp_all_gather";
+constexpr const static llvm::StringLiteral kAllReduceFunc = "tpp_all_reduce";
+
+// Returns the suffix of the collectives of `type`, empty if there are none.
+static StringRef getTypeSuffix(Type type) {
+  if (type.isF32())
+    return "f32";
+  if (type.isBF16())
+    return "bf16";
+  if (type.isInteger(32))
+    return "i32";
+  return "";
+}
+
+// Returns true if `linalgOp` is a matmul of static 2-D tensors:
+// C(m, n) += A(m, k) * B(k, n).
+static bool isMatmul(linalg::LinalgOp linalgOp) {
+  if (!linalgOp.hasPureTensorSemantics() || linalgOp.getNumDpsInputs() != 2 ||
+      linalgOp.getNumDpsInits() != 1 ||
+      !linalg::isaContractionOpInterface(linalgOp))
+    return false;
+  if (!llvm::all_of(linalgOp->getOperandTypes(), [](Type type) {
+        return cast<ShapedType>(type).hasStaticShape();
+      }))
+    return false;
+  MLIRContext *ctx = linalgOp.getContext();
+  using MapList = ArrayRef<ArrayRef<AffineExpr>>;
+  auto infer = [&](MapList m) {
+    return AffineMap::inferFromExprList(m, ctx);
+  };
+  AffineExpr m, n, k;
+  bindDims(ctx, m, n, k);
+  return linalgOp.getIndexingMapsArray() == infer({{m, k}, {k, n}, {m, n}});
+}
+
+// Returns true if `value` is filled with zeros.
+static bool isZeroFill(Value value) {
+  auto fillOp = value.getDefiningOp<linalg::FillOp>();
+  if (!fillOp)
+    return false;
+  Value fill = fillOp.getInputs()[0];
+  return matchPattern(fill, m_AnyZeroFloat()) || matchPattern(fill, m_Zero());
+}
+
+class MatmulSharder {
+public:
+  MatmulSharder(ModuleOp module, func::FuncOp func, int64_t numRanks)
+      : module(module), func(func), numRanks(numRanks),
+        rewriter(module.getContext()) {}
+
+  // Shards the output columns of the matmul: each rank multiplies by its
+  // columns of the weight, and the columns of the ranks are gathered.
+  void shardColumns(linalg::LinalgOp matmul) {
+    Value input = matmul.getDpsInputs()[0];
+    Value weight = matmul.getDpsInputs()[1];
+    Value init = matmul.getDpsInits()[0];
+    rewriter.setInsertionPoint(matmul);
+    Location loc = matmul.getLoc();
+    Value localWeight = getShard(weight, /*dim=*/1, matmul);
+    Value localInit = getSlice(init, /*dim=*/1);
+    Operation *local =
+        matmul.clone(rewriter, loc, localInit.getType(),
+                     ValueRange{input, localWeight, localInit});
+    Value dim = rewriter.create<arith::ConstantOp>(
+        loc, rewriter.getI64IntegerAttr(1));
+    Value full = createCollective(loc, kAllGatherFunc, local->getResult(0),
+                                  cast<RankedTensorType>(init.getType()), dim);
+    rewriter.replaceOp(matmul, full);
+  }
+
+  // Shards the reduction of the matmul: each rank multiplies its columns of
+  // the input by its rows of the weight, and the partial sums of the ranks
+  // are reduced.
+  void shardRows(linalg::LinalgOp matmul) {
+    Value input = matmul.getDpsInputs()[0];
+    Value weight = matmul.getDpsInputs()[1];
+    Value init = matmul.getDpsInits()[0];
+    rewriter.setInsertionPoint(matmul);
+    Location loc = matmul.getLoc();
+    Value localInput = getSlice(input, /*dim=*/1);
+    Value localWeight = getShard(weight, /*dim=*/0, matmul);
+    auto initType = cast<RankedTensorType>(init.getType());
+    Value zero = rewriter.create<arith::ConstantOp>(
+        loc, rewriter.getZeroAttr(initType.getElementType()));
+    Value empty = rewriter.create<tensor::EmptyOp>(
+        loc, initType.getShape(), initType.getElementType());
+    Value zeros =
+        rewriter.create<linalg::FillOp>(loc, zero, empty).getResult(0);
+    Operation *partial =
+        matmul.clone(rewriter, loc, initType,
+                     ValueRange{localInput, localWeight, zeros});
+    Value sum = createCollective(loc, kAllReduceFunc, partial->getResult(0),
+                                 initType, ValueRange{});
+    if (!isZeroFill(init)) {
+      sum = rewriter
+                .create<linalg::AddOp>(loc, ValueRange{sum, init},
+                                       ValueRange{init})
+                .getResult(0);
+    }
+    rewriter.replaceOp(matmul, sum);
+  }
+
+  // Updates the type of the function with its sharded arguments.
+  void updateFunctionType() {
+    func.setType(FunctionType::get(func.getContext(),
+                                   func.getBody().front().getArgumentTypes(),
+                                   func.getResultTypes()));
+  }
+
+private:
+  // Returns the rank of the process, queried on entry.
+  Value getRank() {
+    if (rank)
+      return rank;
+    OpBuilder::InsertionGuard guard(rewriter);
+    rewriter.setInsertionPointToStart(&func.getBody().front());
+    func::FuncOp rankFunc = getOrCreateRuntimeFunc(module, kRankFunc, {},
+                                                   rewriter.getI64Type());
+    Value rank64 =
+        rewriter.create<func::CallOp>(func.getLoc(), rankFunc, ValueRange{})
+            .getResult(0);
+    rank = rewriter.create<arith::IndexCastOp>(
+        func.getLoc(), rewriter.getIndexType(), rank64);
+    return rank;
+  }
+
+  // Returns the part of the rank of `value` along `dim`.
+  Value getSlice(Value value, int64_t dim) {
+    auto type = cast<RankedTensorType>(value.getType());
+    SmallVector<int64_t> shape(type.getShape());
+    shape[dim] /= numRanks;
+    Location loc = value.getLoc();
+    Value partSize = rewriter.create<arith::ConstantIndexOp>(loc, shape[dim]);
+    Value offset = rewriter.create<arith::MulIOp>(loc, getRank(), partSize);
+    SmallVector<OpFoldResult> offsets(type.getRank(), rewriter.getIndexAttr(0));
+    offsets[dim] = offset;
+    SmallVector<OpFoldResult> sizes = getAsIndexOpFoldResult(
+        rewriter.getContext(), shape);
+    SmallVector<OpFoldResult> strides(type.getRank(),
+                                      rewriter.getIndexAttr(1));
+    return rewriter.create<tensor::ExtractSliceOp>(
+        loc, type.clone(shape), value, offsets, sizes, strides);
+  }
+
+  // Returns the shard of the rank of the weight `value` along `dim`. An
+  // argument of the function only used by `user` becomes the shard itself,
+  // so that each rank only holds its part of the weight.
+  Value getShard(Value value, int64_t dim, Operation *user) {
+    auto arg = dyn_cast<BlockArgument>(value);
+    if (!arg || arg.getOwner() != &func.getBody().front() || !arg.hasOneUse() ||
+        *arg.getUsers().begin() != user)
+      return getSlice(value, dim);
+    auto type = cast<RankedTensorType>(value.getType());
+    SmallVector<int64_t> shape(type.getShape());
+    shape[dim] /= numRanks;
+    arg.setType(type.clone(shape));
+    return arg;
+  }
+
+  // Calls the collective `name` of the runtime from `input` into a buffer of
+  // `resultType`, returned as a tensor.
+  Value createCollective(Location loc, StringRef name, Value input,
+                         RankedTensorType resultType, ValueRange extraArgs) {
+    Type elementType = resultType.getElementType();
+    auto inputType = cast<RankedTensorType>(input.getType());
+    Value inputBuffer = rewriter.create<bufferization::ToMemrefOp>(
+        loc, MemRefType::get(inputType.getShape(), elementType), input);
+    Value resultBuffer = rewriter.create<memref::AllocOp>(
+        loc, MemRefType::get(resultType.getShape(), elementType),
+        rewriter.getI64IntegerAttr(64));
+
+    auto unrankedType = UnrankedMemRefType::get(elementType, 0);
+    SmallVector<Value> args{
+        rewriter.create<memref::CastOp>(loc, unrankedType, inputBuffer),
+        rewriter.create<memref::CastOp>(loc, unrankedType, resultBuffer)};
+    args.append(extraArgs.begin(), extraArgs.end());
+    std::string funcName =
+        (name + "_" + getTypeSuffix(elementType)).str();
+    func::FuncOp collectiveFunc =
+        getOrCreateRuntimeFunc(module, funcName, ValueRange(args).getTypes(),
+                               {}, /*emitCInterface=*/true);
+    rewriter.create<func::CallOp>(loc, collectiveFunc, args);
+    return rewriter.create<bufferization::ToTensorOp>(
+        loc, resultBuffer, /*restrict=*/true, /*writable=*/true);
+  }
+
+  ModuleOp module;
+  func::FuncOp func;
+  int64_t numRanks;
+  IRRewriter rewriter;
+  Value rank;
+};
+
+struct TensorParallelMatmuls
+    : public tpp::impl::TensorParallelMatmulsBase<TensorParallelMatmuls> {
+  using TensorParallelMatmulsBase::TensorParallelMatmulsBase;
+
+  void runOnOperation() override {
+    ModuleOp module = getOperation();
+    bool columns = mode == "column";
+    if (!columns && mode != "row") {
+      module.emitError("Invalid tensor parallel mode '" + mode + "'");
+      return signalPassFailure();
+    }
+    if (numRanks <= 1)
+      return;
+
+    SmallVector<func::FuncOp> funcs(module.getOps<func::FuncOp>());
+    for (func::FuncOp func : funcs) {
+      if (func.isExternal())
+        continue;
+      // The sharded dimension must split evenly over the ranks.
+      SmallVector<linalg::LinalgOp> matmuls;
+      func.walk([&](linalg::LinalgOp linalgOp) {
+        if (!isMatmul(linalgOp))
+          return;
+        auto weightType =
+            cast<ShapedType>(linalgOp.getDpsInputs()[1].getType());
+        auto initType = cast<ShapedType>(linalgOp.getDpsInits()[0].getType());
+        int64_t shardedSize = weightType.getDimSize(columns ? 1 : 0);
+        if (shardedSize % numRanks == 0 &&
+            !getTypeSuffix(initType.getElementType()).empty())
+          matmuls.push_back(linalgOp);
+      });
+      if (matmuls.empty())
+        continue;
+
+      MatmulSharder sharder(module, func, numRanks);
+      for (linalg::LinalgOp matmul : matmuls) {
+        if (columns)
+          sharder.shardColumns(matmul);
+        else
+          sharder.shardRows(matmul);
+      }
+      sharder.updateFunctionType();
+    }
+  }
+};
+
+} // namespace
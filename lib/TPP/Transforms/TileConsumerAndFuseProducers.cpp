@@ -6,6 +6,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "TPP/IR/MatcherUtils.h"
 #include "TPP/Passes.h"
 #include "TPP/Transforms/Transforms.h"
 #include "TPP/Transforms/Utils/TransformUtils.h"
@@ -15,6 +16,7 @@
 #include "mlir/Dialect/Linalg/Transforms/Transforms.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/Dialect/SCF/Transforms/TileUsingInterface.h"
+#include "mlir/Dialect/Tensor/IR/Tensor.h"
 #include "mlir/Dialect/Tensor/Transforms/Transforms.h"
 #include "mlir/Interfaces/DestinationStyleOpInterface.h"
 #include "mlir/Interfaces/TilingInterface.h"
@@ -39,6 +41,14 @@ namespace tpp {
 
 namespace {
 
+// Marks the root loop of the inner level of a multi-level tiling, whose iter
+// args are fixed up like the outer root but which stays sequential.
+constexpr const static llvm::StringLiteral kInnerLevel = "inner_level";
+
+// Marks the root loop of the row panels of fused layers, whose contractions
+// are tiled and fused already.
+constexpr const static llvm::StringLiteral kFusedLayers = "fused_layers";
+
 // Replace the iter operand of the outermost loop with the region iter argument
 // of the innermost loop in the region of the innermost loop. This fix-up
 // destination passing style in tile-consumer-and-fuse-producers:
@@ -84,6 +94,13 @@ static bool isConvolutionLike(Operation *op) {
   return false;
 }
 
+// Return true if `op` is a gather or an embedding bag lookup, see
+// `isEmbeddingBagOp`.
+static bool isEmbeddingBag(Operation *op) {
+  auto linalgOp = dyn_cast_or_null<linalg::LinalgOp>(op);
+  return linalgOp && structured_match::utils::isEmbeddingBagOp(linalgOp);
+}
+
 // Return true if `op` can be tiled using `tileSizes`. Require to statically
 // know the range and the tile factor. The tile must be full.
 static bool canBeTiledWithCurrentSpec(Operation *op,
@@ -326,12 +343,68 @@ void incDepthAndSwap(std::queue<Operation *> &frontier,
   }
 }
 
+// Return true if `packOp` packs the lhs of the contraction owning `operand`,
+// with a single use, and `packTiles` of the contraction only tile the outer
+// blocks of the lhs. The loops of the rhs are not tiled, or by tiles spanning
+// them, so each tile packs its block rows once, just in time, into a buffer
+// of the size of the tile instead of a separate pass over the whole tensor.
+static bool isFusableLhsPack(
+    OpOperand &operand, tensor::PackOp packOp,
+    const llvm::DenseMap<Operation *, SmallVector<OpFoldResult>> &packTiles) {
+  auto linalgOp = dyn_cast<linalg::LinalgOp>(operand.getOwner());
+  if (!linalgOp || operand.getOperandNumber() != 0 || !packOp->hasOneUse() ||
+      failed(linalgx::utils::isContraction(linalgOp)))
+    return false;
+  auto tilesIt = packTiles.find(linalgOp);
+  if (tilesIt == packTiles.end())
+    return false;
+  AffineMap lhsMap = linalgOp.getMatchingIndexingMap(&operand);
+  if (!lhsMap.isProjectedPermutation())
+    return false;
+
+  int64_t numOuterDims =
+      packOp.getDestType().getRank() - packOp.getInnerDimsPos().size();
+  SmallVector<int64_t> loopRanges = linalgOp.getStaticLoopRanges();
+  bool isTiled = false;
+  for (auto [dim, tile] : llvm::enumerate(tilesIt->second)) {
+    std::optional<int64_t> tileSize = getConstantIntValue(tile);
+    if (tileSize && (*tileSize == 0 || *tileSize == loopRanges[dim]))
+      continue;
+    std::optional<unsigned> pos = lhsMap.getResultPosition(
+        getAffineDimExpr(dim, linalgOp.getContext()));
+    if (!pos || static_cast<int64_t>(*pos) >= numOuterDims)
+      return false;
+    isTiled = true;
+  }
+  return isTiled;
+}
+
+// Return true if `producer` is the single-use dequantization of the rhs of
+// the contraction owning `operand`, e.g. its int8 weights scaled per channel.
+// The rhs of a tile of the contraction is then dequantized in the tile loops,
+// from the packed integers into a buffer of the size of the tile, instead of
+// a separate pass writing the whole dequantized weights.
+static bool isFusableRhsDequantize(OpOperand &operand, Operation *producer) {
+  auto linalgOp = dyn_cast<linalg::LinalgOp>(operand.getOwner());
+  auto dequantOp = dyn_cast_or_null<linalg::LinalgOp>(producer);
+  if (!linalgOp || !dequantOp || operand.getOperandNumber() != 1 ||
+      !dequantOp->hasOneUse() || !linalgx::utils::isDequantize(dequantOp) ||
+      failed(linalgx::utils::isContraction(linalgOp)))
+    return false;
+  return linalgOp.getMatchingIndexingMap(&operand).isProjectedPermutation();
+}
+
 // Return a list of producers op that can be fused together based on what has
-// already been fused and the current tile specification.
+// already been fused and the current tile specification. With `packTiles`,
+// the packs of the lhs of the contractions tiled by them are fused too, see
+// `isFusableLhsPack`. With `fuseDequantize`, the dequantizations of the rhs
+// of the contractions as well, see `isFusableRhsDequantize`.
 static llvm::SmallDenseSet<Operation *> collectFusableProducers(
     TilingInterface rootConsumer,
     llvm::DenseMap<Operation *, SmallVector<OpFoldResult>> &tileSizes,
-    const llvm::SmallDenseSet<Operation *> &alreadyFusedOps, int64_t maxDepth) {
+    const llvm::SmallDenseSet<Operation *> &alreadyFusedOps, int64_t maxDepth,
+    const llvm::DenseMap<Operation *, SmallVector<OpFoldResult>> *packTiles,
+    bool fuseDequantize) {
   if (alreadyFusedOps.count(rootConsumer.getOperation()))
     return {};
 
@@ -362,8 +435,27 @@ static llvm::SmallDenseSet<Operation *> collectFusableProducers(
         worklist.insert(producer);
         continue;
       }
+      auto packOp = dyn_cast_or_null<tensor::PackOp>(producer);
+      if (packOp && packTiles && !alreadyFusedOps.count(packOp) &&
+          isFusableLhsPack(operand, packOp, *packTiles)) {
+        LLVM_DEBUG(llvm::dbgs() << "WORKLIST INSERT LHS PACK: " << packOp
+                                << "\n");
+        worklist.insert(packOp);
+        continue;
+      }
+      if (fuseDequantize && !worklist.count(producer) &&
+          !alreadyFusedOps.count(producer) &&
+          isFusableRhsDequantize(operand, producer)) {
+        LLVM_DEBUG(llvm::dbgs() << "WORKLIST INSERT RHS DEQUANTIZE: "
+                                << producer << "\n");
+        worklist.insert(producer);
+        continue;
+      }
+      // Lookups are not recomputed for each tile of their consumer, they are
+      // tiled on their own.
       if (producer && isa<TilingInterface>(producer) &&
           !worklist.count(producer) && producer->getNumResults() == 1 &&
+          !isEmbeddingBag(producer) &&
           !alreadyFusedOps.count(producer) &&
           hasCompatibleParallelLoops(operand, producer, tileSizes) &&
           hasAllUsersInWorklist(producer, worklist)) {
@@ -381,12 +473,73 @@ static llvm::SmallDenseSet<Operation *> collectFusableProducers(
   return worklist;
 }
 
+// Tile `consumer` with `tiles` and the loop order `interchange`, and fuse the
+// producers in `worklist` into the tiled loops.
+static FailureOr<scf::SCFTileAndFuseResult>
+tileAndFuse(RewriterBase &rewriter, TilingInterface consumer,
+            ArrayRef<OpFoldResult> tiles, ArrayRef<int64_t> interchange,
+            const llvm::SmallDenseSet<Operation *> &worklist,
+            const llvm::SmallDenseSet<Operation *> &alreadyFusedOps) {
+  scf::SCFTilingOptions options;
+  options.setTileSizes(tiles);
+  if (!interchange.empty())
+    options.setInterchange(interchange);
+  scf::SCFTileAndFuseOptions tileAndFuseOptions;
+  tileAndFuseOptions.setTilingOptions(options);
+  scf::SCFTileAndFuseOptions::ControlFnTy controlFn =
+      [&](tensor::ExtractSliceOp candidateSliceOp, OpResult originalProducer,
+          bool isDestinationOperand)
+      -> std::optional<scf::SCFTileAndFuseOptions::ControlFnResult> {
+    Operation *candidateOp = originalProducer.getOwner();
+    if (!candidateOp || worklist.count(candidateOp) == 0 ||
+        (alreadyFusedOps.count(candidateOp) &&
+         !isa<linalg::FillOp>(candidateOp))) {
+      return std::nullopt;
+    }
+    scf::SCFTileAndFuseOptions::ControlFnResult res;
+    res.yieldProducerReplacement = false;
+    return res;
+  };
+  tileAndFuseOptions.setFusionControlFn(controlFn);
+  FailureOr<scf::SCFTileAndFuseResult> tileAndFuseResult =
+      scf::tileConsumerAndFuseProducersUsingSCF(rewriter, consumer,
+                                                tileAndFuseOptions);
+  if (failed(tileAndFuseResult)) {
+    return rewriter.notifyMatchFailure(
+        consumer, "failed to tile and fuse with op as root");
+  }
+  if (!tileAndFuseResult->loops.empty()) {
+    tileAndFuseResult->loops[0]->setAttr(
+        linalgx::utils::kLoopParallel,
+        rewriter.getStringAttr(linalgx::utils::kLoopRoot));
+  }
+  return *tileAndFuseResult;
+}
+
+// Return true if the inner level `innerTiles` only tiles loops that are also
+// tiled by the outer level `outerTiles`, so that the producers fused at the
+// outer level remain fusable at the inner one.
+static bool isNestedTiling(ArrayRef<OpFoldResult> innerTiles,
+                           ArrayRef<OpFoldResult> outerTiles) {
+  for (auto [idx, tile] : llvm::enumerate(innerTiles)) {
+    if (isConstantIntValue(tile, 0))
+      continue;
+    if (idx >= outerTiles.size() || isConstantIntValue(outerTiles[idx], 0))
+      return false;
+  }
+  return true;
+}
+
 // Entry point for fusion with element-wise operations.
 static FailureOr<scf::SCFTileAndFuseResult> fuseWithEltwise(
     RewriterBase &rewriter, TilingInterface consumer,
     llvm::DenseMap<Operation *, SmallVector<OpFoldResult>> &tileSizes,
+    const llvm::DenseMap<Operation *, SmallVector<OpFoldResult>> &outerTiles,
+    const llvm::DenseMap<Operation *, SmallVector<int64_t>> &outerInterchange,
+    const llvm::DenseMap<Operation *, SmallVector<OpFoldResult>>
+        &outerContractionTiles,
     llvm::SmallDenseSet<Operation *> &alreadyFusedOps, int64_t maxDepth,
-    int64_t minTileFactor) {
+    int64_t minTileFactor, bool fuseLhsPacks, bool fuseDequantize) {
   // Step 0. Early exit if tileSizes are empty.
   if (tileSizes.empty() || !tileSizes.count(consumer)) {
     LLVM_DEBUG(llvm::dbgs() << "EMPTY TILE SIZES\n");
@@ -408,47 +561,63 @@ static FailureOr<scf::SCFTileAndFuseResult> fuseWithEltwise(
     return failure();
   }
 
-  // Step 3. Collect the operations that can be tiled and fused.
-  llvm::SmallDenseSet<Operation *> worklist =
-      collectFusableProducers(consumer, tileSizes, alreadyFusedOps, maxDepth);
+  // Step 3. Collect the operations that can be tiled and fused. The packs of
+  // the lhs are fused at the outermost level only.
+  ArrayRef<OpFoldResult> innerTiles = tileSizes.at(consumer);
+  auto outerIt = outerTiles.find(consumer);
+  bool hasOuterLevel =
+      outerIt != outerTiles.end() &&
+      isNestedTiling(innerTiles, outerIt->second) &&
+      canBeTiledWithCurrentSpec(consumer, outerIt->second, minTileFactor);
+  const llvm::DenseMap<Operation *, SmallVector<OpFoldResult>> *packTiles =
+      nullptr;
+  if (fuseLhsPacks)
+    packTiles = hasOuterLevel ? &outerContractionTiles : &tileSizes;
+  llvm::SmallDenseSet<Operation *> worklist = collectFusableProducers(
+      consumer, tileSizes, alreadyFusedOps, maxDepth, packTiles,
+      fuseDequantize);
   LLVM_DEBUG(llvm::dbgs() << "#WORKLIST: " << worklist.size() << "\n");
   if (worklist.size() < 1)
     return failure();
 
   // Step 4. Tile the consumer and move the producers
-  // in the fusion domain.
-  scf::SCFTilingOptions options;
-  options.setTileSizes(tileSizes.at(consumer));
-  scf::SCFTileAndFuseOptions tileAndFuseOptions;
-  tileAndFuseOptions.setTilingOptions(options);
-  scf::SCFTileAndFuseOptions::ControlFnTy controlFn =
-      [&](tensor::ExtractSliceOp candidateSliceOp, OpResult originalProducer,
-          bool isDestinationOperand)
-      -> std::optional<scf::SCFTileAndFuseOptions::ControlFnResult> {
-    Operation *candidateOp = originalProducer.getOwner();
-    if (!candidateOp || worklist.count(candidateOp) == 0 ||
-        (alreadyFusedOps.count(candidateOp) &&
-         !isa<linalg::FillOp>(candidateOp))) {
-      return std::nullopt;
-    }
-    scf::SCFTileAndFuseOptions::ControlFnResult res;
-    res.yieldProducerReplacement = false;
-    return res;
-  };
-  tileAndFuseOptions.setFusionControlFn(controlFn);
-  FailureOr<scf::SCFTileAndFuseResult> tileAndFuseResult =
-      scf::tileConsumerAndFuseProducersUsingSCF(rewriter, consumer,
-                                                tileAndFuseOptions);
-  if (failed(tileAndFuseResult)) {
-    return rewriter.notifyMatchFailure(
-        consumer, "failed to tile and fuse with op as root");
+  // in the fusion domain. Without an outer level, we are done.
+  if (!hasOuterLevel) {
+    return tileAndFuse(rewriter, consumer, innerTiles, /*interchange=*/{},
+                       worklist, alreadyFusedOps);
   }
-  if (!tileAndFuseResult->loops.empty()) {
-    tileAndFuseResult->loops[0]->setAttr(
-        linalgx::utils::kLoopParallel,
-        rewriter.getStringAttr(linalgx::utils::kLoopRoot));
+
+  // Step 5. Tile at the outer level first, then tile the consumer within each
+  // outer tile with the inner tiles, fusing the same producers again except
+  // the packs, whose block rows are reused by the inner tiles. Only the outer
+  // loops run in parallel, each thread walks its outer tile in order.
+  FailureOr<scf::SCFTileAndFuseResult> outerResult =
+      tileAndFuse(rewriter, consumer, outerIt->second,
+                  outerInterchange.lookup(consumer), worklist, alreadyFusedOps);
+  if (failed(outerResult))
+    return failure();
+
+  Operation *tiledConsumer = outerResult->tiledAndFusedOps.front();
+  llvm::SmallDenseSet<Operation *> innerWorklist;
+  for (Operation *tiledOp : outerResult->tiledAndFusedOps)
+    if (!isa<tensor::PackOp>(tiledOp))
+      innerWorklist.insert(tiledOp);
+  if (!canBeTiledWithCurrentSpec(tiledConsumer, innerTiles, minTileFactor)) {
+    LLVM_DEBUG(llvm::dbgs() << "CONSUMER: " << consumer
+                            << "\nONLY TILED AT THE OUTER LEVEL\n");
+    return outerResult;
   }
-  return *tileAndFuseResult;
+  FailureOr<scf::SCFTileAndFuseResult> innerResult =
+      tileAndFuse(rewriter, cast<TilingInterface>(tiledConsumer), innerTiles,
+                  /*interchange=*/{}, innerWorklist, alreadyFusedOps);
+  if (succeeded(innerResult)) {
+    if (!innerResult->loops.empty())
+      innerResult->loops[0]->setAttr(kInnerLevel, rewriter.getUnitAttr());
+    rewriter.replaceOp(
+        tiledConsumer,
+        innerResult->replacements[tiledConsumer->getResult(0)]);
+  }
+  return outerResult;
 }
 
 // Trivial tile selection. If the dimension is statically known, it perfectly
@@ -534,6 +703,13 @@ getDefaultTileSizesForMatmulLikeOp(linalg::LinalgOp linalgOp) {
 static FailureOr<SmallVector<int64_t>>
 getDefaultTileSizes(linalg::LinalgOp linalgOp,
                     ArrayRef<int64_t> userProvidedTiles) {
+  // Lookups are distributed by groups of bags, the rows stay whole. The user
+  // tiles are meant for the contractions.
+  if (isEmbeddingBag(linalgOp)) {
+    SmallVector<int64_t> tiles(linalgOp.getNumLoops(), 0);
+    tiles[0] = getTileForDim(linalgOp, 0);
+    return tiles;
+  }
   // The user-provided tiles are considered from the outer
   // most loop. If not enough tiles are provided we pad with
   // zeros.
@@ -658,18 +834,251 @@ static Operation *getLastFusableEltWiseConsumer(
   return currentConsumer;
 }
 
+// Return the loop order of the outer tiling level of `root`, the fusion root of
+// `contractionOp`, with `outerTiles` in the loop space of the contraction.
+// Iterating over the M tiles within an N tile keeps the panel of B resident
+// and streams A once per N tile, the converse streams B once per M tile; the
+// order that moves the least data is picked. The N loops go first, an empty
+// order is the identity, i.e. M first.
+static SmallVector<int64_t>
+getOuterLevelInterchange(linalg::LinalgOp contractionOp, Operation *root,
+                         ArrayRef<int64_t> outerTiles) {
+  auto dims = linalgx::utils::isContraction(contractionOp);
+  if (failed(dims))
+    return {};
+  SmallVector<int64_t, 4> loopsRange = contractionOp.getStaticLoopRanges();
+  auto getSizes = [&](ArrayRef<unsigned> loops) {
+    double size = 1, tile = 1;
+    for (auto loop : loops) {
+      size *= loopsRange[loop];
+      tile *= (loop < outerTiles.size() && outerTiles[loop] != 0)
+                  ? outerTiles[loop]
+                  : loopsRange[loop];
+    }
+    return std::make_pair(size, tile);
+  };
+  for (auto loop : llvm::concat<unsigned>(dims->m, dims->n, dims->k)) {
+    if (ShapedType::isDynamic(loopsRange[loop]))
+      return {};
+  }
+  auto [sizeM, tileM] = getSizes(dims->m);
+  auto [sizeN, tileN] = getSizes(dims->n);
+  double sizeK = getSizes(dims->k).first;
+  double trafficNFirst = sizeK * sizeN + sizeM * sizeK * (sizeN / tileN);
+  double trafficMFirst = sizeM * sizeK + sizeK * sizeN * (sizeM / tileM);
+  if (trafficNFirst > trafficMFirst)
+    return {};
+
+  // The loops of the root are the result dims of the contraction, unless the
+  // root is the contraction itself.
+  auto rootOp = cast<linalg::LinalgOp>(root);
+  llvm::SmallDenseSet<unsigned> nLoops;
+  if (root == contractionOp.getOperation()) {
+    nLoops.insert(dims->n.begin(), dims->n.end());
+  } else {
+    AffineMap outputMap = contractionOp.getIndexingMapMatchingResult(
+        contractionOp->getResult(0));
+    for (auto [pos, expr] : llvm::enumerate(outputMap.getResults())) {
+      auto dimExpr = dyn_cast<AffineDimExpr>(expr);
+      if (dimExpr && llvm::is_contained(dims->n, dimExpr.getPosition()))
+        nLoops.insert(pos);
+    }
+  }
+
+  SmallVector<int64_t> interchange;
+  for (auto loop : llvm::seq<int64_t>(0, rootOp.getNumLoops()))
+    if (nLoops.contains(loop))
+      interchange.push_back(loop);
+  for (auto loop : llvm::seq<int64_t>(0, rootOp.getNumLoops()))
+    if (!nLoops.contains(loop))
+      interchange.push_back(loop);
+  return interchange;
+}
+
+// Return the outer tiles grouping the batches of a blocked batch contraction
+// by `groupSize`, if the gemm of each batch has a single block of output. The
+// groups run in parallel and the inner level walks the batches of a group in
+// order, so that their brgemms can later run in a single grouped invoke.
+static FailureOr<SmallVector<int64_t>>
+getBatchGroupTileSizes(linalg::LinalgOp linalgOp, int64_t groupSize) {
+  auto dims = linalgx::utils::isContraction(linalgOp);
+  if (failed(dims) || dims->batch.size() != 1 || dims->m.size() != 2 ||
+      dims->n.size() != 2) {
+    return failure();
+  }
+  SmallVector<int64_t, 4> loopsRange = linalgOp.getStaticLoopRanges();
+  if (ShapedType::isDynamic(loopsRange[dims->batch[0]]) ||
+      loopsRange[dims->m[0]] != 1 || loopsRange[dims->n[0]] != 1) {
+    return failure();
+  }
+  // The outer level must also tile the blocks of M and N, these are tiled by
+  // the inner level.
+  SmallVector<int64_t> tiles(linalgOp.getNumLoops(), 0);
+  tiles[dims->batch[0]] = groupSize;
+  tiles[dims->m[0]] = 1;
+  tiles[dims->n[0]] = 1;
+  return tiles;
+}
+
+// Return true if `op` is in the row panels of fused layers.
+static bool isInFusedLayers(Operation *op) {
+  for (auto forOp = op->getParentOfType<scf::ForOp>(); forOp;
+       forOp = forOp->getParentOfType<scf::ForOp>()) {
+    if (forOp->hasAttr(kFusedLayers))
+      return true;
+  }
+  return false;
+}
+
+// A layer of a chain of contractions: the contraction, the last element-wise
+// consumer fused with it and the tiles of its rows, i.e. of the M loops only.
+struct Layer {
+  linalg::LinalgOp contraction;
+  Operation *root;
+  SmallVector<int64_t> rowTiles;
+};
+
+// Return the tiles `loopTiles` of the loops of `linalgOp` as tiles of the
+// dimensions of `operand`.
+static FailureOr<SmallVector<int64_t>>
+getOperandTiles(linalg::LinalgOp linalgOp, OpOperand &operand,
+                ArrayRef<int64_t> loopTiles) {
+  AffineMap map = linalgOp.getMatchingIndexingMap(&operand);
+  if (!map.isProjectedPermutation())
+    return failure();
+  SmallVector<int64_t> tiles;
+  for (AffineExpr expr : map.getResults())
+    tiles.push_back(loopTiles[cast<AffineDimExpr>(expr).getPosition()]);
+  return tiles;
+}
+
+// Fuse the chains of contractions whose lhs is the single-use result of the
+// previous one, e.g. the layers of a MLP, along their rows. The last layer is
+// tiled by row panels with whole columns, and all the layers of the chain are
+// fused into its tile loop: a thread takes a panel of rows through all the
+// layers, whose activations stay in cache, without a barrier between layers.
+// As the rows of a matmul are independent, nothing is recomputed.
+static void fuseLayers(RewriterBase &rewriter, func::FuncOp func,
+                       ArrayRef<int64_t> tileSizes, int64_t minTileFactor) {
+  SmallVector<Layer> layers;
+  llvm::DenseMap<Operation *, unsigned> layerOfRoot;
+  llvm::SmallDenseSet<Operation *> visitedConsumers;
+  llvm::DenseMap<Operation *, SmallVector<OpFoldResult>> rowTiles;
+  func->walk<WalkOrder::PostOrder>([&](linalg::LinalgOp linalgOp) {
+    if (linalgOp->getParentOp() != func.getOperation() ||
+        !linalgOp.hasPureTensorSemantics() ||
+        linalgOp.getNumDpsInputs() != 2 || linalgOp->getNumResults() != 1)
+      return;
+    auto dims = linalgx::utils::isContraction(linalgOp);
+    if (failed(dims) || !dims->batch.empty())
+      return;
+    auto tiles = getDefaultTileSizes(linalgOp, tileSizes);
+    if (failed(tiles))
+      return;
+    SmallVector<int64_t> layerTiles(linalgOp.getNumLoops(), 0);
+    for (unsigned dim : dims->m)
+      layerTiles[dim] = (*tiles)[dim];
+    rowTiles[linalgOp] =
+        getAsOpFoldResult(rewriter.getI64ArrayAttr(layerTiles));
+    Operation *root =
+        getLastFusableEltWiseConsumer(linalgOp, visitedConsumers, rowTiles);
+    layerOfRoot[root] = layers.size();
+    layers.push_back({linalgOp, root, layerTiles});
+  });
+
+  // Link each layer to the previous one if a row panel of its lhs is a row
+  // panel of the result of the previous layer, with whole columns.
+  SmallVector<std::optional<unsigned>> nextLayer(layers.size());
+  llvm::SmallBitVector hasPrevLayer(layers.size());
+  for (auto [idx, layer] : llvm::enumerate(layers)) {
+    OpOperand *lhs = layer.contraction.getDpsInputOperand(0);
+    auto it = layerOfRoot.find(lhs->get().getDefiningOp());
+    if (it == layerOfRoot.end() || nextLayer[it->second])
+      continue;
+    Layer &prevLayer = layers[it->second];
+    if (!prevLayer.root->getResult(0).hasOneUse())
+      continue;
+    auto lhsTiles = getOperandTiles(layer.contraction, *lhs, layer.rowTiles);
+    auto resultTiles = getOperandTiles(
+        prevLayer.contraction, *prevLayer.contraction.getDpsInitOperand(0),
+        prevLayer.rowTiles);
+    if (failed(lhsTiles) || failed(resultTiles) || *lhsTiles != *resultTiles)
+      continue;
+    nextLayer[it->second] = idx;
+    hasPrevLayer.set(idx);
+  }
+
+  for (auto idx : llvm::seq<unsigned>(0, layers.size())) {
+    if (hasPrevLayer.test(idx) || !nextLayer[idx])
+      continue;
+
+    // Fuse the contractions of the chain, their fills and their element-wise
+    // consumers.
+    llvm::SmallDenseSet<Operation *> worklist;
+    unsigned lastLayer = idx;
+    for (std::optional<unsigned> layerIdx = idx; layerIdx;
+         layerIdx = nextLayer[*layerIdx]) {
+      lastLayer = *layerIdx;
+      Layer &layer = layers[*layerIdx];
+      Operation *op = layer.contraction;
+      worklist.insert(op);
+      while (op != layer.root) {
+        op = *op->getResult(0).getUsers().begin();
+        worklist.insert(op);
+      }
+      Value init = layer.contraction.getDpsInits()[0];
+      if (auto fillOp = init.getDefiningOp<linalg::FillOp>())
+        worklist.insert(fillOp);
+    }
+
+    Operation *root = layers[lastLayer].root;
+    ArrayRef<OpFoldResult> rootTiles = rowTiles.at(root);
+    if (!canBeTiledWithCurrentSpec(root, rootTiles, minTileFactor)) {
+      LLVM_DEBUG(llvm::dbgs() << "LAYERS ROOT: " << *root
+                              << "\nCANNOT BE TILED BY ROW PANELS\n");
+      continue;
+    }
+    FailureOr<scf::SCFTileAndFuseResult> result =
+        tileAndFuse(rewriter, cast<TilingInterface>(root), rootTiles,
+                    /*interchange=*/{}, worklist, /*alreadyFusedOps=*/{});
+    if (failed(result) || result->loops.empty())
+      continue;
+    LLVM_DEBUG(llvm::dbgs() << "FUSED " << lastLayer - idx + 1
+                            << " LAYERS\n");
+    result->loops[0]->setAttr(kFusedLayers, rewriter.getUnitAttr());
+    rewriter.replaceOp(root, result->replacements[root->getResult(0)]);
+  }
+}
+
 // Run `fuseWithEltwise` on contraction-like operations.
 static void doFusion(RewriterBase &rewriter, func::FuncOp func,
-                     ArrayRef<int64_t> tileSizes, int64_t maxDepth,
-                     int64_t minTileFactor) {
+                     ArrayRef<int64_t> tileSizes,
+                     ArrayRef<int64_t> outerTileSizes, int64_t batchGroupSize,
+                     int64_t maxDepth, int64_t minTileFactor,
+                     bool fuseLhsPacks, bool fuseDequantize) {
   // Set to keep track of fused ops.
   llvm::SmallDenseSet<Operation *> fusedOps;
 
   SmallVector<linalg::LinalgOp> linalgContractionOperations;
   // Walk postorder to increase fusion boundaries.
   func->walk<WalkOrder::PostOrder>([&](linalg::LinalgOp linalgOp) {
+    // Split-K contractions are already distributed across threads, and the
+    // contractions of fused attentions, normalizations, argmaxes, layers,
+    // grouped experts and rotary embeddings already tiled.
+    auto forallOp = linalgOp->getParentOfType<scf::ForallOp>();
+    if (forallOp && (forallOp->hasAttr(linalgx::utils::kSplitReduction) ||
+                     forallOp->hasAttr(linalgx::utils::kFusedAttention) ||
+                     forallOp->hasAttr(linalgx::utils::kFusedNormalization) ||
+                     forallOp->hasAttr(linalgx::utils::kFusedTopK) ||
+                     forallOp->hasAttr(linalgx::utils::kGroupedExperts) ||
+                     forallOp->hasAttr(
+                         linalgx::utils::kFusedRotaryEmbedding)))
+      return;
+    if (isInFusedLayers(linalgOp))
+      return;
     if ((isConvolutionLike(linalgOp) ||
-         succeeded(linalgx::utils::isContraction(linalgOp))) &&
+         succeeded(linalgx::utils::isContraction(linalgOp)) ||
+         isEmbeddingBag(linalgOp)) &&
         linalgOp.hasPureTensorSemantics())
       linalgContractionOperations.push_back(linalgOp);
   });
@@ -698,10 +1107,41 @@ static void doFusion(RewriterBase &rewriter, func::FuncOp func,
         getAsOpFoldResult(rewriter.getI64ArrayAttr(*tiles));
   }
 
+  // Tile sizes and loop order of the outer level of the fusion roots, if any,
+  // and the tile sizes of that level for the contractions themselves.
+  llvm::DenseMap<Operation *, SmallVector<OpFoldResult>> outerTiles;
+  llvm::DenseMap<Operation *, SmallVector<int64_t>> outerInterchange;
+  llvm::DenseMap<Operation *, SmallVector<OpFoldResult>> outerContractionTiles;
+
   for (linalg::LinalgOp contractionOp : linalgContractionOperations) {
     Operation *consumerOp = getLastFusableEltWiseConsumer(
         contractionOp, visitedConsumers, defaultTiles);
     fusionRoots.insert(consumerOp);
+
+    if (outerTileSizes.empty()) {
+      if (batchGroupSize <= 0)
+        continue;
+      auto tiles = getBatchGroupTileSizes(contractionOp, batchGroupSize);
+      if (succeeded(tiles)) {
+        outerContractionTiles[contractionOp] =
+            getAsOpFoldResult(rewriter.getI64ArrayAttr(*tiles));
+        outerTiles[consumerOp] = getTileForEltWiseConsumer(
+            consumerOp, contractionOp, outerContractionTiles[contractionOp]);
+      }
+      continue;
+    }
+    auto tiles = getDefaultTileSizes(contractionOp, outerTileSizes);
+    if (failed(tiles)) {
+      LLVM_DEBUG(llvm::dbgs() << "Invalid outer tile sizes for: "
+                              << contractionOp << "\n");
+      continue;
+    }
+    outerContractionTiles[contractionOp] =
+        getAsOpFoldResult(rewriter.getI64ArrayAttr(*tiles));
+    outerTiles[consumerOp] = getTileForEltWiseConsumer(
+        consumerOp, contractionOp, outerContractionTiles[contractionOp]);
+    outerInterchange[consumerOp] =
+        getOuterLevelInterchange(contractionOp, consumerOp, *tiles);
   }
   LLVM_DEBUG(llvm::dbgs() << "#fusionRoots: " << fusionRoots.size() << "\n");
 
@@ -718,7 +1158,9 @@ static void doFusion(RewriterBase &rewriter, func::FuncOp func,
       LLVM_DEBUG(llvm::dbgs() << "\n\n");
       FailureOr<scf::SCFTileAndFuseResult> fuseAndTileResult =
           fuseWithEltwise(rewriter, cast<TilingInterface>(linalgOp),
-                          defaultTiles, fusedOps, maxDepth, minTileFactor);
+                          defaultTiles, outerTiles, outerInterchange,
+                          outerContractionTiles, fusedOps, maxDepth,
+                          minTileFactor, fuseLhsPacks, fuseDequantize);
       LLVM_DEBUG(llvm::dbgs() << "\n\n");
       if (succeeded(fuseAndTileResult)) {
         rewriter.replaceOp(
@@ -744,12 +1186,20 @@ struct TileConsumerAndFuseProducers
       (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
     }
 
+    // Fuse the layers first, their contractions are not tiled on their own.
+    if (this->fuseLayers) {
+      IRRewriter rewriter(&getContext());
+      fuseLayers(rewriter, getOperation(), this->tileSizes,
+                 this->minTileFactor);
+    }
+
     int64_t numIters = this->numIters;
     do {
       func::FuncOp func = getOperation();
       IRRewriter rewriter(&getContext());
-      doFusion(rewriter, func, this->tileSizes, this->maxDepth,
-               this->minTileFactor);
+      doFusion(rewriter, func, this->tileSizes, this->outerTileSizes,
+               this->batchGroupSize, this->maxDepth, this->minTileFactor,
+               this->fuseLhsPack, this->fuseDequantize);
 
       {
         RewritePatternSet patterns(&ctx);
@@ -762,6 +1212,10 @@ struct TileConsumerAndFuseProducers
             RankReductionStrategy::ExtractInsertSlice;
         linalg::populateFoldUnitExtentDimsPatterns(patterns, options);
         tensor::populateMergeConsecutiveInsertExtractSlicePatterns(patterns);
+        // The fused packs and dequantizations write into a buffer of the size
+        // of their tile.
+        if (this->fuseLhsPack || this->fuseDequantize)
+          tensor::populateFoldTensorEmptyPatterns(patterns);
 
         // TODO: Remove the generalization of named ops after resolving the
         // above dependency with "populateFoldUnitExtentDimsViaSlicesPatterns".
@@ -777,6 +1231,13 @@ struct TileConsumerAndFuseProducers
       (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
     }
 
+    // Only the outer level of a multi-level tiling runs in parallel.
+    getOperation()->walk([](scf::ForOp forOp) {
+      if (forOp->removeAttr(kInnerLevel))
+        forOp->removeAttr(linalgx::utils::kLoopParallel);
+      forOp->removeAttr(kFusedLayers);
+    });
+
     {
       // Patterns for scf.forall.
       RewritePatternSet patterns(&ctx);
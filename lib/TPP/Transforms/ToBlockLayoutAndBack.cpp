@@ -8,9 +8,11 @@
 
 #include "TPP/Passes.h"
 #include "TPP/Transforms/Transforms.h"
+#include "TPP/Transforms/Utils/BlockingCostModel.h"
 #include "TPP/Transforms/Utils/TransformUtils.h"
 #include "TPP/Transforms/Utils/VNNIUtils.h"
 #include "mlir/Dialect/Affine/Utils.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
 #include "mlir/Dialect/Bufferization/IR/Bufferization.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
@@ -22,6 +24,7 @@
 #include "mlir/Dialect/Traits.h"
 #include "mlir/Dialect/Utils/IndexingUtils.h"
 #include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/IR/Matchers.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 
 #include "llvm/Support/MathExtras.h"
@@ -34,10 +37,14 @@ namespace tpp {
 #include "TPP/Passes.h.inc"
 #define GEN_PASS_DEF_PACKMATMUL
 #include "TPP/Passes.h.inc"
+#define GEN_PASS_DEF_PADMATMUL
+#include "TPP/Passes.h.inc"
 #define GEN_PASS_DEF_PACKCONV2DNCHWFCHW
 #include "TPP/Passes.h.inc"
 #define GEN_PASS_DEF_PACKCONV2DNHWCHWCF
 #include "TPP/Passes.h.inc"
+#define GEN_PASS_DEF_PACKGROUPEDCONV
+#include "TPP/Passes.h.inc"
 #define GEN_PASS_DEF_PROPAGATEPACKUNPACK
 #include "TPP/Passes.h.inc"
 #define GEN_PASS_DEF_SIMPLIFYANDCANONICALIZEPACK
@@ -183,6 +190,37 @@ static Value toPackLayoutKCRS_KCRSck(OpBuilder &builder, Location loc,
                           /*outerDimsPerm=*/{});
 }
 
+// Helper function to pack from RSC to CRSc.
+static Value toPackLayoutRSC_CRSc(OpBuilder &builder, Location loc,
+                                  Value input, ArrayRef<OpFoldResult> tiles) {
+  assert(tiles.size() == 1 && "expect one tile size for RSC_CRSc");
+  SmallVector<int64_t> innerDimsPos = {2};
+  SmallVector<int64_t> outerDimsPerm = {2, 0, 1};
+  return toPackLayoutImpl(builder, loc, input, tiles, innerDimsPos,
+                          outerDimsPerm);
+}
+
+// Return the strides and the dilations of `convOp`, default to 1.
+template <typename OpTy>
+static std::pair<SmallVector<int64_t, 2>, SmallVector<int64_t, 2>>
+getStridesAndDilations(OpTy convOp) {
+  SmallVector<int64_t, 2> strides = {1, 1};
+  if (DenseIntElementsAttr stridesAttr = convOp.getStrides()) {
+    auto strideValues = stridesAttr.getValues<int64_t>();
+    assert(strideValues.size() == 2 && "expect two stride values");
+    strides[0] = strideValues[0];
+    strides[1] = strideValues[1];
+  }
+  SmallVector<int64_t, 2> dilations = {1, 1};
+  if (DenseIntElementsAttr dilationsAttr = convOp.getDilations()) {
+    auto dilationValues = dilationsAttr.getValues<int64_t>();
+    assert(dilationValues.size() == 2 && "expect two dilation values");
+    dilations[0] = dilationValues[0];
+    dilations[1] = dilationValues[1];
+  }
+  return {strides, dilations};
+}
+
 template <typename OpTy>
 static FailureOr<linalg::GenericOp>
 packConvolutions(RewriterBase &rewriter, OpTy convOp,
@@ -227,13 +265,7 @@ packConvolutions(RewriterBase &rewriter, OpTy convOp,
           ? toPackLayoutNPQK_NKPQk(rewriter, loc, output, tiles[0])
           : toPackLayoutNCHW_NCHWc(rewriter, loc, output, tiles[0]);
 
-  SmallVector<int64_t, 2> strides = {1, 1};
-  if (DenseIntElementsAttr stridesAttr = convOp.getStrides()) {
-    auto strideValues = stridesAttr.getValues<int64_t>();
-    assert(strideValues.size() == 2 && "expect two stride values");
-    strides[0] = strideValues[0];
-    strides[1] = strideValues[1];
-  }
+  auto [strides, dilations] = getStridesAndDilations(convOp);
 
   // Swap convolution with generic.
   //         N   K   P   Q   k   C   R   S   c
@@ -243,7 +275,9 @@ packConvolutions(RewriterBase &rewriter, OpTy convOp,
       AffineMap::get(/*dims=*/9, /*symbols=*/0, {p1, p2, p3, p4, p5}, ctx);
   AffineMap mapImg = AffineMap::get(
       /*dims=*/9, /*symbols=*/0,
-      {p1, r1, p3 * strides[0] + r2, p4 * strides[1] + r3, r4}, ctx);
+      {p1, r1, p3 * strides[0] + r2 * dilations[0],
+       p4 * strides[1] + r3 * dilations[1], r4},
+      ctx);
   AffineMap mapFil =
       AffineMap::get(/*dims=*/9, /*symbols=*/0, {p2, r1, r2, r3, r4, p5}, ctx);
   linalg::GenericOp replacementOp = rewriter.create<linalg::GenericOp>(
@@ -306,6 +340,210 @@ mlir::linalgx::packConv2DNchwFchwOp(RewriterBase &rewriter,
   return packConvolutions(rewriter, convOp, tiles);
 }
 
+//===----------------------------------------------------------------------===//
+// DepthwiseConv2DNhwcHwcOp
+//===----------------------------------------------------------------------===//
+// Original layout: [N][P][Q][C] += [N][H][W][C] * [R][S][C]
+// New      layout: [N][C'][P][Q][c] += [N][C'][H][W][c] * [C'][R][S][c]
+FailureOr<linalg::GenericOp> mlir::linalgx::packDepthwiseConv2DNhwcHwcOp(
+    RewriterBase &rewriter, linalg::DepthwiseConv2DNhwcHwcOp convOp,
+    OpFoldResult tile) {
+  if (convOp.hasDynamicShape())
+    return rewriter.notifyMatchFailure(convOp, "require static shape");
+  if (convOp.hasPureBufferSemantics())
+    return rewriter.notifyMatchFailure(convOp, "require tensor semantics");
+  if (!linalgx::utils::validateFullTilesOnDims(
+          cast<TilingInterface>(convOp.getOperation()), {tile},
+          {/*Cidx=*/3}))
+    return rewriter.notifyMatchFailure(convOp, "expect full tiles only");
+
+  Location loc = convOp.getLoc();
+  MLIRContext *ctx = convOp.getContext();
+  Value packedImage =
+      toPackLayoutNPQK_NKPQk(rewriter, loc, convOp.getDpsInputs()[0], tile);
+  Value packedFilter =
+      toPackLayoutRSC_CRSc(rewriter, loc, convOp.getDpsInputs()[1], tile);
+  Value output = convOp.getDpsInits()[0];
+  Value packedOutput = toPackLayoutNPQK_NKPQk(rewriter, loc, output, tile);
+
+  auto [strides, dilations] = getStridesAndDilations(convOp);
+
+  // Swap convolution with generic.
+  //         N   C   P   Q   c   R   S
+  AffineExpr p1, p2, p3, p4, p5, r1, r2;
+  bindDims(ctx, p1, p2, p3, p4, p5, r1, r2);
+  AffineMap mapOut =
+      AffineMap::get(/*dims=*/7, /*symbols=*/0, {p1, p2, p3, p4, p5}, ctx);
+  AffineMap mapImg = AffineMap::get(
+      /*dims=*/7, /*symbols=*/0,
+      {p1, p2, p3 * strides[0] + r1 * dilations[0],
+       p4 * strides[1] + r2 * dilations[1], p5},
+      ctx);
+  AffineMap mapFil =
+      AffineMap::get(/*dims=*/7, /*symbols=*/0, {p2, r1, r2, p5}, ctx);
+  linalg::GenericOp replacementOp = rewriter.create<linalg::GenericOp>(
+      loc, packedOutput.getType(), ValueRange{packedImage, packedFilter},
+      ValueRange{packedOutput}, ArrayRef<AffineMap>{mapImg, mapFil, mapOut},
+      ArrayRef<utils::IteratorType>{
+          utils::IteratorType::parallel, utils::IteratorType::parallel,
+          utils::IteratorType::parallel, utils::IteratorType::parallel,
+          utils::IteratorType::parallel, utils::IteratorType::reduction,
+          utils::IteratorType::reduction},
+      /*doc=*/"", /*libraryCall=*/"");
+  rewriter.inlineRegionBefore(convOp->getRegion(0), replacementOp.getRegion(),
+                              replacementOp.getRegion().begin());
+  if (auto metadata = convOp->getAttr("metadata"))
+    replacementOp->setAttr("metadata", metadata);
+
+  // convert back from pack layout.
+  Value outReplacement = fromPackLayoutNKPQk_NPQK(
+      rewriter, loc, replacementOp.getResult(0), output, tile);
+  rewriter.replaceOp(convOp, outReplacement);
+  return replacementOp;
+}
+
+//===----------------------------------------------------------------------===//
+// PoolingNhwc{Max,Min,Sum}Op
+//===----------------------------------------------------------------------===//
+// Original layout: [N][P][Q][C] = pool([N][H][W][C]) over [R][S]
+// New      layout: [N][C'][P][Q][c] = pool([N][C'][H][W][c]) over [R][S]
+template <typename OpTy>
+static FailureOr<linalg::GenericOp>
+packPooling(RewriterBase &rewriter, OpTy poolingOp, OpFoldResult tile) {
+  if (poolingOp.hasDynamicShape())
+    return rewriter.notifyMatchFailure(poolingOp, "require static shape");
+  if (poolingOp.hasPureBufferSemantics())
+    return rewriter.notifyMatchFailure(poolingOp, "require tensor semantics");
+  if (!linalgx::utils::validateFullTilesOnDims(
+          cast<TilingInterface>(poolingOp.getOperation()), {tile},
+          {/*Cidx=*/3}))
+    return rewriter.notifyMatchFailure(poolingOp, "expect full tiles only");
+
+  Location loc = poolingOp.getLoc();
+  MLIRContext *ctx = poolingOp.getContext();
+  Value packedImage =
+      toPackLayoutNPQK_NKPQk(rewriter, loc, poolingOp.getDpsInputs()[0], tile);
+  // The window only carries the sizes of R and S.
+  Value window = poolingOp.getDpsInputs()[1];
+  Value output = poolingOp.getDpsInits()[0];
+  Value packedOutput = toPackLayoutNPQK_NKPQk(rewriter, loc, output, tile);
+
+  auto [strides, dilations] = getStridesAndDilations(poolingOp);
+
+  // Swap pooling with generic.
+  //         N   C   P   Q   c   R   S
+  AffineExpr p1, p2, p3, p4, p5, r1, r2;
+  bindDims(ctx, p1, p2, p3, p4, p5, r1, r2);
+  AffineMap mapOut =
+      AffineMap::get(/*dims=*/7, /*symbols=*/0, {p1, p2, p3, p4, p5}, ctx);
+  AffineMap mapImg = AffineMap::get(
+      /*dims=*/7, /*symbols=*/0,
+      {p1, p2, p3 * strides[0] + r1 * dilations[0],
+       p4 * strides[1] + r2 * dilations[1], p5},
+      ctx);
+  AffineMap mapWin = AffineMap::get(/*dims=*/7, /*symbols=*/0, {r1, r2}, ctx);
+  linalg::GenericOp replacementOp = rewriter.create<linalg::GenericOp>(
+      loc, packedOutput.getType(), ValueRange{packedImage, window},
+      ValueRange{packedOutput}, ArrayRef<AffineMap>{mapImg, mapWin, mapOut},
+      ArrayRef<utils::IteratorType>{
+          utils::IteratorType::parallel, utils::IteratorType::parallel,
+          utils::IteratorType::parallel, utils::IteratorType::parallel,
+          utils::IteratorType::parallel, utils::IteratorType::reduction,
+          utils::IteratorType::reduction},
+      /*doc=*/"", /*libraryCall=*/"");
+  rewriter.inlineRegionBefore(poolingOp->getRegion(0),
+                              replacementOp.getRegion(),
+                              replacementOp.getRegion().begin());
+  if (auto metadata = poolingOp->getAttr("metadata"))
+    replacementOp->setAttr("metadata", metadata);
+
+  // convert back from pack layout.
+  Value outReplacement = fromPackLayoutNKPQk_NPQK(
+      rewriter, loc, replacementOp.getResult(0), output, tile);
+  rewriter.replaceOp(poolingOp, outReplacement);
+  return replacementOp;
+}
+
+FailureOr<linalg::GenericOp>
+mlir::linalgx::packPoolingNhwcOp(RewriterBase &rewriter,
+                                 linalg::LinalgOp linalgOp, OpFoldResult tile) {
+  if (auto maxOp = dyn_cast<linalg::PoolingNhwcMaxOp>(linalgOp.getOperation()))
+    return packPooling(rewriter, maxOp, tile);
+  if (auto minOp = dyn_cast<linalg::PoolingNhwcMinOp>(linalgOp.getOperation()))
+    return packPooling(rewriter, minOp, tile);
+  if (auto sumOp = dyn_cast<linalg::PoolingNhwcSumOp>(linalgOp.getOperation()))
+    return packPooling(rewriter, sumOp, tile);
+  return rewriter.notifyMatchFailure(linalgOp, "not an NHWC pooling");
+}
+
+//===----------------------------------------------------------------------===//
+// Conv2DNgchwFgchwOp
+//===----------------------------------------------------------------------===//
+// Original layout: [N][G][K][P][Q] += [N][G][C][H][W] * [K][G][C][R][S]
+// New      layout: for each g:
+//                  [N][K][P][Q] += [N][C][H][W] * [K][C][R][S]
+FailureOr<scf::ForOp>
+mlir::linalgx::splitGroupedConv2DNgchwFgchwOp(
+    RewriterBase &rewriter, linalg::Conv2DNgchwFgchwOp convOp) {
+  if (convOp.hasDynamicShape())
+    return rewriter.notifyMatchFailure(convOp, "require static shape");
+  if (convOp.hasPureBufferSemantics())
+    return rewriter.notifyMatchFailure(convOp, "require tensor semantics");
+
+  Location loc = convOp.getLoc();
+  Value image = convOp.getDpsInputs()[0];
+  Value filter = convOp.getDpsInputs()[1];
+  Value output = convOp.getDpsInits()[0];
+  int64_t groups = cast<ShapedType>(image.getType()).getShape()[1];
+
+  // Slice the group dimension out of `operand`, at `groupDim`.
+  auto getGroupSlice = [&](OpBuilder &builder, Value operand, Value group,
+                           unsigned groupDim) -> Value {
+    auto operandType = cast<RankedTensorType>(operand.getType());
+    unsigned rank = operandType.getRank();
+    SmallVector<OpFoldResult> offsets(rank, builder.getIndexAttr(0));
+    offsets[groupDim] = group;
+    SmallVector<OpFoldResult> sizes =
+        getAsIndexOpFoldResult(builder.getContext(), operandType.getShape());
+    sizes[groupDim] = builder.getIndexAttr(1);
+    SmallVector<OpFoldResult> strides(rank, builder.getIndexAttr(1));
+    auto sliceType =
+        tensor::ExtractSliceOp::inferCanonicalRankReducedResultType(
+            rank - 1, operandType, offsets, sizes, strides);
+    return builder.create<tensor::ExtractSliceOp>(
+        loc, cast<RankedTensorType>(sliceType), operand, offsets, sizes,
+        strides);
+  };
+
+  Value zero = rewriter.create<arith::ConstantIndexOp>(loc, 0);
+  Value one = rewriter.create<arith::ConstantIndexOp>(loc, 1);
+  Value ub = rewriter.create<arith::ConstantIndexOp>(loc, groups);
+  auto loop = rewriter.create<scf::ForOp>(
+      loc, zero, ub, one, ValueRange{output},
+      [&](OpBuilder &builder, Location loc, Value group, ValueRange iterArgs) {
+        Value groupImage = getGroupSlice(builder, image, group, 1);
+        Value groupFilter = getGroupSlice(builder, filter, group, 1);
+        Value groupOutput = getGroupSlice(builder, iterArgs[0], group, 1);
+        auto groupConv = builder.create<linalg::Conv2DNchwFchwOp>(
+            loc, groupOutput.getType(), ValueRange{groupImage, groupFilter},
+            ValueRange{groupOutput}, convOp.getStrides(),
+            convOp.getDilations());
+        auto outputType = cast<RankedTensorType>(iterArgs[0].getType());
+        unsigned rank = outputType.getRank();
+        SmallVector<OpFoldResult> offsets(rank, builder.getIndexAttr(0));
+        offsets[1] = group;
+        SmallVector<OpFoldResult> sizes = getAsIndexOpFoldResult(
+            builder.getContext(), outputType.getShape());
+        sizes[1] = builder.getIndexAttr(1);
+        SmallVector<OpFoldResult> strides(rank, builder.getIndexAttr(1));
+        Value inserted = builder.create<tensor::InsertSliceOp>(
+            loc, groupConv.getResult(0), iterArgs[0], offsets, sizes, strides);
+        builder.create<scf::YieldOp>(loc, inserted);
+      });
+  rewriter.replaceOp(convOp, loop.getResults());
+  return loop;
+}
+
 //===----------------------------------------------------------------------===//
 // MatmulOp (VNNI packing)
 //===----------------------------------------------------------------------===//
@@ -316,11 +554,10 @@ mlir::linalgx::packConv2DNchwFchwOp(RewriterBase &rewriter,
 FailureOr<linalg::GenericOp>
 mlir::linalgx::packVNNIMatmulOp(RewriterBase &rewriter,
                                 linalg::GenericOp matmulOp) {
-  if (matmulOp.getInputs().size() > 0) {
-    auto elementType = getElementTypeOrSelf(matmulOp.getInputs()[0].getType());
-    if (!elementType.isBF16())
-      return rewriter.notifyMatchFailure(matmulOp, "require bf16 type");
-  }
+  // VNNI packing applies to bf16 (VNNI2) and i8 (VNNI4) only.
+  if (matmulOp.getInputs().size() > 0 &&
+      !vnni::utils::getVnniBlockingFactor(matmulOp.getInputs()[0].getType()))
+    return rewriter.notifyMatchFailure(matmulOp, "require bf16 or i8 type");
 
   if (matmulOp.hasDynamicShape())
     return rewriter.notifyMatchFailure(matmulOp, "require static shape");
@@ -391,9 +628,8 @@ mlir::linalgx::packVNNIMatmulOp(RewriterBase &rewriter,
 FailureOr<linalg::GenericOp>
 mlir::linalgx::packVNNIBRGemmOp(RewriterBase &rewriter,
                                 linalg::BatchReduceMatmulOp brgemmOp) {
-  auto elementType = getElementTypeOrSelf(brgemmOp.getInputs()[0].getType());
-  if (!elementType.isBF16())
-    return rewriter.notifyMatchFailure(brgemmOp, "require bf16 type");
+  if (!vnni::utils::getVnniBlockingFactor(brgemmOp.getInputs()[0].getType()))
+    return rewriter.notifyMatchFailure(brgemmOp, "require bf16 or i8 type");
 
   if (brgemmOp.hasDynamicShape())
     return rewriter.notifyMatchFailure(brgemmOp, "require static shape");
@@ -408,7 +644,8 @@ mlir::linalgx::packVNNIBRGemmOp(RewriterBase &rewriter,
     return rewriter.notifyMatchFailure(brgemmOp,
                                        "unsupported blocking factor for type");
   }
-  SmallVector<OpFoldResult> tilesOnK = {rewriter.getI64IntegerAttr(2)};
+  SmallVector<OpFoldResult> tilesOnK = {
+      rewriter.getI64IntegerAttr(*blockingFactor)};
 
   Location loc = brgemmOp.getLoc();
   // Reshape input B.
@@ -460,10 +697,214 @@ getDefaultBlockingFactors(linalg::LinalgOp linalgOp) {
   return {32, 32, 32};
 }
 
+// Split `matmulOp` along `dim` of its [M, N, K] iteration space into the
+// matmuls of [0, mainSize) and of the remainder. The remainder of M or N
+// writes its own slice of the output, the remainder of K accumulates into the
+// result of the leading part. Returns the matmul of the leading part.
+static linalg::MatmulOp peelMatmul(RewriterBase &rewriter,
+                                   linalg::MatmulOp matmulOp, int64_t dim,
+                                   int64_t mainSize) {
+  Location loc = matmulOp.getLoc();
+  Value lhs = matmulOp.getDpsInputs()[0];
+  Value rhs = matmulOp.getDpsInputs()[1];
+  Value acc = matmulOp.getDpsInits()[0];
+  int64_t size = matmulOp.getStaticLoopRanges()[dim];
+
+  rewriter.setInsertionPoint(matmulOp);
+  // Slices [offset, offset + sliceSize) of the dimension `sliceDim` of a 2-D
+  // tensor.
+  auto slice = [&](Value source, int64_t sliceDim, int64_t offset,
+                   int64_t sliceSize) -> Value {
+    auto type = cast<RankedTensorType>(source.getType());
+    SmallVector<int64_t> offsets(2, 0);
+    SmallVector<int64_t> sizes(type.getShape());
+    offsets[sliceDim] = offset;
+    sizes[sliceDim] = sliceSize;
+    return rewriter.create<tensor::ExtractSliceOp>(
+        loc, source, getAsIndexOpFoldResult(rewriter.getContext(), offsets),
+        getAsIndexOpFoldResult(rewriter.getContext(), sizes),
+        getAsIndexOpFoldResult(rewriter.getContext(), {1, 1}));
+  };
+  auto matmul = [&](Value a, Value b, Value c) {
+    return rewriter.create<linalg::MatmulOp>(loc, c.getType(),
+                                             ValueRange{a, b}, ValueRange{c});
+  };
+  auto insert = [&](Value source, Value dest, int64_t sliceDim,
+                    int64_t offset) -> Value {
+    SmallVector<int64_t> offsets(2, 0);
+    offsets[sliceDim] = offset;
+    return rewriter.create<tensor::InsertSliceOp>(
+        loc, source, dest,
+        getAsIndexOpFoldResult(rewriter.getContext(), offsets),
+        tensor::getMixedSizes(rewriter, loc, source),
+        getAsIndexOpFoldResult(rewriter.getContext(), {1, 1}));
+  };
+
+  int64_t remSize = size - mainSize;
+  linalg::MatmulOp mainOp;
+  Value result;
+  if (dim == 2) {
+    mainOp = matmul(slice(lhs, 1, 0, mainSize), slice(rhs, 0, 0, mainSize),
+                    acc);
+    result = matmul(slice(lhs, 1, mainSize, remSize),
+                    slice(rhs, 0, mainSize, remSize), mainOp.getResult(0))
+                 .getResult(0);
+  } else {
+    // M slices the rows of the lhs and N the columns of the rhs.
+    Value operand = dim == 0 ? lhs : rhs;
+    int64_t operandDim = dim == 0 ? 0 : 1;
+    auto sliceOperand = [&](int64_t offset, int64_t sliceSize) {
+      return slice(operand, operandDim, offset, sliceSize);
+    };
+    Value mainOperand = sliceOperand(0, mainSize);
+    Value remOperand = sliceOperand(mainSize, remSize);
+    Value mainAcc = slice(acc, dim, 0, mainSize);
+    Value remAcc = slice(acc, dim, mainSize, remSize);
+    mainOp = dim == 0 ? matmul(mainOperand, rhs, mainAcc)
+                      : matmul(lhs, mainOperand, mainAcc);
+    linalg::MatmulOp remOp = dim == 0 ? matmul(remOperand, rhs, remAcc)
+                                      : matmul(lhs, remOperand, remAcc);
+    result = insert(mainOp.getResult(0), acc, dim, 0);
+    result = insert(remOp.getResult(0), result, dim, mainSize);
+  }
+  rewriter.replaceOp(matmulOp, result);
+  return mainOp;
+}
+
+// Peel the remainders of the dimensions of `matmulOp` not divided by
+// `blockFactors`, so that only the leading part is packed and the edges are
+// left to their own, unpacked, kernels.
+static void peelMatmulRemainders(RewriterBase &rewriter,
+                                 linalg::MatmulOp matmulOp,
+                                 ArrayRef<int64_t> blockFactors) {
+  SmallVector<int64_t, 4> loopsRange = matmulOp.getStaticLoopRanges();
+  for (int64_t dim = 0; dim < 3; dim++) {
+    int64_t size = loopsRange[dim];
+    int64_t mainSize = size - size % blockFactors[dim];
+    if (mainSize == size || mainSize == 0)
+      continue;
+    matmulOp = peelMatmul(rewriter, matmulOp, dim, mainSize);
+  }
+}
+
+// Returns the [M, N, K] block factors of `linalgOp`: the user defined
+// `blockingFactors`, or the ones picked by the cost model, or the defaults.
+// Block factors are adjusted to smaller dimensions: if a dimension is smaller
+// than the blocking factor, then try to block by the dimension size.
+static FailureOr<SmallVector<int64_t>>
+getMatmulBlockFactors(linalg::LinalgOp linalgOp,
+                      ArrayRef<int64_t> blockingFactors, bool useCostModel,
+                      const tpp::CpuTargetInfo &target) {
+  SmallVector<int64_t> blockFactors;
+  FailureOr<SmallVector<int64_t>> modelFactors = failure();
+  if (blockingFactors.empty() && useCostModel)
+    modelFactors = tpp::getMatmulBlockingFactors(linalgOp, target);
+  if (!blockingFactors.empty())
+    blockFactors.assign(blockingFactors.begin(), blockingFactors.end());
+  else if (succeeded(modelFactors))
+    blockFactors = *modelFactors;
+  else
+    blockFactors = getDefaultBlockingFactors(linalgOp);
+
+  auto dims = linalg::inferContractionDims(linalgOp);
+  if (failed(dims))
+    return failure();
+
+  OpBuilder builder(linalgOp);
+  auto tileOp = cast<TilingInterface>(linalgOp.getOperation());
+  SmallVector<Range> iterationDomain = tileOp.getIterationDomain(builder);
+
+  if (std::optional<int64_t> dimM =
+          linalgx::utils::getConstantRange(iterationDomain[dims->m.back()]))
+    blockFactors[0] = std::min(*dimM, blockFactors[0]);
+  if (std::optional<int64_t> dimN =
+          linalgx::utils::getConstantRange(iterationDomain[dims->n.back()]))
+    blockFactors[1] = std::min(*dimN, blockFactors[1]);
+  if (std::optional<int64_t> dimK =
+          linalgx::utils::getConstantRange(iterationDomain[dims->k.back()]))
+    blockFactors[2] = std::min(*dimK, blockFactors[2]);
+  return blockFactors;
+}
+
+// Pad the operands of `matmulOp` with zeros up to `paddedSizes` of its
+// [M, N, K] iteration space and extract the original result from the padded
+// matmul.
+static void padMatmul(RewriterBase &rewriter, linalg::MatmulOp matmulOp,
+                      ArrayRef<int64_t> paddedSizes) {
+  Location loc = matmulOp.getLoc();
+  rewriter.setInsertionPoint(matmulOp);
+  auto pad = [&](Value source, int64_t rows, int64_t cols) -> Value {
+    auto type = cast<RankedTensorType>(source.getType());
+    if (type.getShape() == ArrayRef<int64_t>{rows, cols})
+      return source;
+    auto paddedType = RankedTensorType::get({rows, cols},
+                                            type.getElementType());
+    Value zero = rewriter.create<arith::ConstantOp>(
+        loc, rewriter.getZeroAttr(type.getElementType()));
+    SmallVector<OpFoldResult> low(2, rewriter.getIndexAttr(0));
+    SmallVector<OpFoldResult> high{
+        rewriter.getIndexAttr(rows - type.getDimSize(0)),
+        rewriter.getIndexAttr(cols - type.getDimSize(1))};
+    return rewriter.create<tensor::PadOp>(loc, paddedType, source, low, high,
+                                          zero);
+  };
+  int64_t paddedM = paddedSizes[0];
+  int64_t paddedN = paddedSizes[1];
+  int64_t paddedK = paddedSizes[2];
+  Value lhs = pad(matmulOp.getDpsInputs()[0], paddedM, paddedK);
+  Value rhs = pad(matmulOp.getDpsInputs()[1], paddedK, paddedN);
+  Value acc = matmulOp.getDpsInits()[0];
+  Value paddedAcc = pad(acc, paddedM, paddedN);
+  auto paddedOp = rewriter.create<linalg::MatmulOp>(
+      loc, paddedAcc.getType(), ValueRange{lhs, rhs}, ValueRange{paddedAcc});
+  SmallVector<OpFoldResult> offsets(2, rewriter.getIndexAttr(0));
+  SmallVector<OpFoldResult> strides(2, rewriter.getIndexAttr(1));
+  rewriter.replaceOpWithNewOp<tensor::ExtractSliceOp>(
+      matmulOp, paddedOp.getResult(0), offsets,
+      tensor::getMixedSizes(rewriter, loc, acc), strides);
+}
+
 //===----------------------------------------------------------------------===//
 // Passes
 //===----------------------------------------------------------------------===//
 
+// Pad the matmuls whose dimensions the block factors do not divide, when
+// computing full blocks costs less than the remainders.
+struct PadMatmul : public tpp::impl::PadMatmulBase<PadMatmul> {
+  using PadMatmulBase::PadMatmulBase;
+
+  void runOnOperation() override {
+    bool useCostModel =
+        costModel || tpp::CpuTargetInfo::isDescribed(getOperation());
+    auto target = tpp::CpuTargetInfo::get(getOperation());
+
+    SmallVector<std::pair<linalg::MatmulOp, SmallVector<int64_t>>> padded;
+    getOperation()->walk([&](linalg::MatmulOp matmulOp) {
+      if (!matmulOp.hasPureTensorSemantics() || matmulOp.hasDynamicShape())
+        return;
+      FailureOr<SmallVector<int64_t>> blockFactors = getMatmulBlockFactors(
+          matmulOp, *blockingFactors, useCostModel, target);
+      if (failed(blockFactors))
+        return;
+      SmallVector<int64_t, 4> sizes = matmulOp.getStaticLoopRanges();
+      SmallVector<int64_t> paddedSizes;
+      for (auto [size, block] : llvm::zip(sizes, *blockFactors))
+        paddedSizes.push_back(llvm::alignTo(size, block));
+      if (ArrayRef<int64_t>(paddedSizes) == ArrayRef<int64_t>(sizes))
+        return;
+      Type accType = getElementTypeOrSelf(matmulOp.getDpsInits()[0]);
+      if (!tpp::isMatmulPaddingProfitable(sizes[0], sizes[1], sizes[2],
+                                          *blockFactors, accType, target))
+        return;
+      padded.emplace_back(matmulOp, paddedSizes);
+    });
+
+    IRRewriter rewriter(&getContext());
+    for (auto &[matmulOp, paddedSizes] : padded)
+      padMatmul(rewriter, matmulOp, paddedSizes);
+  }
+};
+
 // Entry point for packing a matmul operation.
 // Pack MatmulOp as following:
 // [NB][KB][nb][kb] += [NB][CB][nb][cb] * [KB][CB][cb][kb]
@@ -478,6 +919,36 @@ struct PackMatmul : public tpp::impl::PackMatmulBase<PackMatmul> {
     MLIRContext *ctx = getOperation().getContext();
     RewritePatternSet patterns(ctx);
 
+    // The cost model is used on request or when the target is described.
+    bool useCostModel =
+        costModel || tpp::CpuTargetInfo::isDescribed(getOperation());
+    auto target = tpp::CpuTargetInfo::get(getOperation());
+
+    // Enforce user defined blocking factors, or pick them with the cost
+    // model, or use defaults.
+    auto getBlockFactors = [&](linalg::LinalgOp linalgOp) {
+      return getMatmulBlockFactors(linalgOp, *blockingFactors, useCostModel,
+                                   target);
+    };
+
+    // Peel the edges of the matmuls the block factors do not divide, the
+    // packed part then runs full blocks.
+    if (peelRemainders) {
+      SmallVector<linalg::MatmulOp> matmulOps;
+      getOperation()->walk([&](linalg::MatmulOp matmulOp) {
+        if (matmulOp.hasPureTensorSemantics() &&
+            !matmulOp.hasDynamicShape())
+          matmulOps.push_back(matmulOp);
+      });
+      IRRewriter rewriter(ctx);
+      for (linalg::MatmulOp matmulOp : matmulOps) {
+        FailureOr<SmallVector<int64_t>> blockFactors =
+            getBlockFactors(matmulOp);
+        if (succeeded(blockFactors))
+          peelMatmulRemainders(rewriter, matmulOp, *blockFactors);
+      }
+    }
+
     // TODO: Add a cost function that decides whether to pack at all.
     auto packControlFn = [&](linalg::LinalgOp linalgOp)
         -> std::optional<linalg::BlockPackMatmulOptions> {
@@ -491,39 +962,27 @@ struct PackMatmul : public tpp::impl::PackMatmulBase<PackMatmul> {
         return std::nullopt;
       }
 
-      // Enforce user defined blocking factors or use defaults.
-      if (!blockingFactors.empty()) {
-        SmallVector<int64_t, 3> blockFactors{*blockingFactors};
-        options.blockFactors = blockFactors;
-      } else {
-        options.blockFactors = getDefaultBlockingFactors(linalgOp);
+      // Matrix-vector products stream the weights once, keep them unpacked
+      // and let the gemm of each output tile vectorize over its columns.
+      // Types with a VNNI layout still need the packs of the weights.
+      if (isa<linalg::MatmulOp>(linalgOp) && gemvMaxRows > 0 &&
+          !vnni::utils::getVnniBlockingFactor(
+              linalgOp.getDpsInputOperand(1)->get().getType())) {
+        int64_t dimM = linalgOp.getStaticLoopRanges()[0];
+        if (!ShapedType::isDynamic(dimM) && dimM <= gemvMaxRows)
+          return std::nullopt;
       }
 
-      // Allow padding to avoid double checks.
-      options.allowPadding = true;
-
-      // Adjust block factors to smaller dimensions.
-      // If a dimension is smaller than the blocking factor, then
-      // try to block by the dimension size.
-      auto dims = linalg::inferContractionDims(linalgOp);
-      if (failed(dims))
+      FailureOr<SmallVector<int64_t>> blockFactors = getBlockFactors(linalgOp);
+      if (failed(blockFactors))
         return std::nullopt;
+      options.blockFactors.assign(blockFactors->begin(), blockFactors->end());
 
-      OpBuilder builder(linalgOp);
-      auto tileOp = cast<TilingInterface>(linalgOp.getOperation());
-      SmallVector<Range> iterationDomain = tileOp.getIterationDomain(builder);
-
-      if (std::optional<int64_t> dimM =
-              linalgx::utils::getConstantRange(iterationDomain[dims->m.back()]))
-        options.blockFactors[0] = std::min(*dimM, options.blockFactors[0]);
-      if (std::optional<int64_t> dimN =
-              linalgx::utils::getConstantRange(iterationDomain[dims->n.back()]))
-        options.blockFactors[1] = std::min(*dimN, options.blockFactors[1]);
-      if (std::optional<int64_t> dimK =
-              linalgx::utils::getConstantRange(iterationDomain[dims->k.back()]))
-        options.blockFactors[2] = std::min(*dimK, options.blockFactors[2]);
+      // Allow padding to avoid double checks.
+      options.allowPadding = true;
 
       // Apply more restrictive packing validation.
+      OpBuilder builder(linalgOp);
       SmallVector<OpFoldResult> tiles =
           getAsOpFoldResult(builder.getI64ArrayAttr(options.blockFactors));
       OpFoldResult tileOnI = tiles[0];
@@ -551,6 +1010,9 @@ struct PackMatmul : public tpp::impl::PackMatmulBase<PackMatmul> {
     };
     linalg::populateBlockPackMatmulPatterns(patterns, packControlFn);
     linalg::populateLinalgDeGeneralizationPatterns(patterns);
+    // Fold the pads of padded matmuls into their packs and the slice of the
+    // result into its unpack.
+    tensor::populateFoldIntoPackAndUnpackPatterns(patterns);
 
     (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
   }
@@ -616,6 +1078,30 @@ private:
   mutable SmallVector<int64_t> blockingFactors;
 };
 
+// Block the channels of the NHWC poolings as the outputs of the convolutions,
+// so that a pooling reads the blocked output of its convolution as is.
+template <typename OpTy>
+struct DoItOnPoolingNhwc : public OpRewritePattern<OpTy> {
+  DoItOnPoolingNhwc(MLIRContext *context, ArrayRef<int64_t> blockingFactors,
+                    PatternBenefit benefit = 1)
+      : OpRewritePattern<OpTy>(context, benefit),
+        blockingFactors(blockingFactors) {}
+
+  LogicalResult matchAndRewrite(OpTy linalgOp,
+                                PatternRewriter &rewriter) const override {
+    int64_t blockFactor = blockingFactors.empty() ? 32 : blockingFactors[0];
+    FailureOr<linalg::GenericOp> maybeGeneric =
+        mlir::linalgx::packPoolingNhwcOp(
+            rewriter, linalgOp, rewriter.getI64IntegerAttr(blockFactor));
+    if (failed(maybeGeneric))
+      return failure();
+    return success();
+  }
+
+private:
+  SmallVector<int64_t> blockingFactors;
+};
+
 struct PackConv2DNhwcHwcf
     : tpp::impl::PackConv2DNhwcHwcfBase<PackConv2DNhwcHwcf> {
   using PackConv2DNhwcHwcfBase::PackConv2DNhwcHwcfBase;
@@ -624,58 +1110,251 @@ struct PackConv2DNhwcHwcf
     MLIRContext *ctx = getOperation().getContext();
     RewritePatternSet patterns(ctx);
     patterns.add<DoItOnConv2DNhwcHwcf>(ctx, blockingFactors);
+    patterns.add<DoItOnPoolingNhwc<linalg::PoolingNhwcMaxOp>,
+                 DoItOnPoolingNhwc<linalg::PoolingNhwcMinOp>,
+                 DoItOnPoolingNhwc<linalg::PoolingNhwcSumOp>>(ctx,
+                                                              blockingFactors);
+    (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
+  }
+};
+
+struct DoItOnDepthwiseConv2DNhwcHwc
+    : public OpRewritePattern<linalg::DepthwiseConv2DNhwcHwcOp> {
+  DoItOnDepthwiseConv2DNhwcHwc(MLIRContext *context, int64_t blockFactor,
+                               PatternBenefit benefit = 1)
+      : OpRewritePattern<linalg::DepthwiseConv2DNhwcHwcOp>(context, benefit),
+        blockFactor(blockFactor) {}
+
+  LogicalResult matchAndRewrite(linalg::DepthwiseConv2DNhwcHwcOp linalgOp,
+                                PatternRewriter &rewriter) const override {
+    FailureOr<linalg::GenericOp> maybeGeneric =
+        mlir::linalgx::packDepthwiseConv2DNhwcHwcOp(
+            rewriter, linalgOp, rewriter.getI64IntegerAttr(blockFactor));
+    if (failed(maybeGeneric))
+      return failure();
+    return success();
+  }
+
+private:
+  int64_t blockFactor;
+};
+
+struct DoItOnConv2DNgchwFgchw
+    : public OpRewritePattern<linalg::Conv2DNgchwFgchwOp> {
+  using OpRewritePattern<linalg::Conv2DNgchwFgchwOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(linalg::Conv2DNgchwFgchwOp linalgOp,
+                                PatternRewriter &rewriter) const override {
+    FailureOr<scf::ForOp> maybeLoop =
+        mlir::linalgx::splitGroupedConv2DNgchwFgchwOp(rewriter, linalgOp);
+    if (failed(maybeLoop))
+      return failure();
+    return success();
+  }
+};
+
+struct PackGroupedConv : tpp::impl::PackGroupedConvBase<PackGroupedConv> {
+  using PackGroupedConvBase::PackGroupedConvBase;
+
+  void runOnOperation() override {
+    MLIRContext *ctx = getOperation().getContext();
+    RewritePatternSet patterns(ctx);
+    patterns.add<DoItOnDepthwiseConv2DNhwcHwc>(ctx, blockFactor);
+    patterns.add<DoItOnConv2DNgchwFgchw>(ctx);
     (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
   }
 };
 
+// Return true if `linalgOp` is better computed in f32 from its flat bf16
+// operands than emulated on VNNI ones.
+static bool keepFlatBf16(linalg::LinalgOp linalgOp, bool bf16F32Compute) {
+  if (!bf16F32Compute)
+    return false;
+  Type inputType = linalgOp.getDpsInputs()[0].getType();
+  return getElementTypeOrSelf(inputType).isBF16() &&
+         !vnni::utils::hasNativeDotProduct(inputType);
+}
+
 // Pack MatmulOp to VNNI.
 struct VNNIOnMatmul : public OpRewritePattern<linalg::GenericOp> {
-  VNNIOnMatmul(MLIRContext *context, PatternBenefit benefit = 1)
-      : OpRewritePattern<linalg::GenericOp>(context, benefit) {}
+  VNNIOnMatmul(MLIRContext *context, bool bf16F32Compute,
+               PatternBenefit benefit = 1)
+      : OpRewritePattern<linalg::GenericOp>(context, benefit),
+        bf16F32Compute(bf16F32Compute) {}
   LogicalResult matchAndRewrite(linalg::GenericOp matmulOp,
                                 PatternRewriter &rewriter) const override {
+    if (keepFlatBf16(matmulOp, bf16F32Compute))
+      return failure();
     FailureOr<linalg::GenericOp> packedMatmul =
         mlir::linalgx::packVNNIMatmulOp(rewriter, matmulOp);
     if (failed(packedMatmul))
       return failure();
     return success();
   }
+
+private:
+  bool bf16F32Compute;
 };
 
 // Pack BRGemmOp to VNNI.
 struct VNNIOnBRGemm : public OpRewritePattern<linalg::BatchReduceMatmulOp> {
-  VNNIOnBRGemm(MLIRContext *context, PatternBenefit benefit = 1)
-      : OpRewritePattern<linalg::BatchReduceMatmulOp>(context, benefit) {}
+  VNNIOnBRGemm(MLIRContext *context, bool bf16F32Compute,
+               PatternBenefit benefit = 1)
+      : OpRewritePattern<linalg::BatchReduceMatmulOp>(context, benefit),
+        bf16F32Compute(bf16F32Compute) {}
   LogicalResult matchAndRewrite(linalg::BatchReduceMatmulOp brgemmOp,
                                 PatternRewriter &rewriter) const override {
+    if (keepFlatBf16(brgemmOp, bf16F32Compute))
+      return failure();
     FailureOr<linalg::GenericOp> packedBRGemm =
         mlir::linalgx::packVNNIBRGemmOp(rewriter, brgemmOp);
     if (failed(packedBRGemm))
       return failure();
     return success();
   }
+
+private:
+  bool bf16F32Compute;
 };
 
 // Entry point for packing a matmul/brgemm operation to vnni format.
 struct PackVNNI : public tpp::impl::PackVNNIBase<PackVNNI> {
+  using PackVNNIBase::PackVNNIBase;
 
   void runOnOperation() override {
     MLIRContext *ctx = getOperation().getContext();
     RewritePatternSet patterns(ctx);
     linalg::populateLinalgDeGeneralizationPatterns(patterns);
-    patterns.add<VNNIOnMatmul, VNNIOnBRGemm>(ctx);
+    patterns.add<VNNIOnMatmul, VNNIOnBRGemm>(ctx, bf16F32Compute);
     (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
   }
 };
 
+// Generalize a named element-wise operation that consumes a tensor.unpack or
+// feeds a tensor.pack (i.e., linalg.add, linalg.max or linalg.broadcast for the
+// bias and relu of a layer). The propagation patterns only apply to
+// linalg.generic, generalizing lets the blocked layout flow to the next layer.
+struct GeneralizeEltwiseAtLayoutBoundary
+    : public OpInterfaceRewritePattern<linalg::LinalgOp> {
+  using OpInterfaceRewritePattern<linalg::LinalgOp>::OpInterfaceRewritePattern;
+
+  LogicalResult matchAndRewrite(linalg::LinalgOp linalgOp,
+                                PatternRewriter &rewriter) const override {
+    if (isa<linalg::GenericOp, linalg::FillOp>(linalgOp) ||
+        !linalgOp.hasPureTensorSemantics() || !linalg::isElementwise(linalgOp))
+      return failure();
+    bool consumesUnPack =
+        llvm::any_of(linalgOp->getOperands(), [](Value operand) {
+          return operand.getDefiningOp<tensor::UnPackOp>();
+        });
+    bool feedsPack = llvm::any_of(linalgOp->getUsers(), [](Operation *user) {
+      return isa<tensor::PackOp>(user);
+    });
+    if (!consumesUnPack && !feedsPack)
+      return failure();
+    if (failed(linalg::generalizeNamedOp(rewriter, linalgOp)))
+      return failure();
+    return success();
+  }
+};
+
+// Return true if `packOp` restores the layout undone by `unPackOp`, so that
+// the pair folds away.
+static bool isSameLayout(tensor::PackOp packOp, tensor::UnPackOp unPackOp) {
+  return !packOp.getPaddingValue() &&
+         packOp.getDestType() == unPackOp.getSourceType() &&
+         packOp.getInnerDimsPos() == unPackOp.getInnerDimsPos() &&
+         packOp.getOuterDimsPerm() == unPackOp.getOuterDimsPerm() &&
+         packOp.getStaticInnerTiles() == unPackOp.getStaticInnerTiles();
+}
+
+// Return why a layout blocked on the dimensions `innerDimsPos` of a tensor of
+// `linalgOp` accessed with `map` could not be propagated through `linalgOp`.
+static StringRef getPropagationBarrier(linalg::LinalgOp linalgOp,
+                                       AffineMap map,
+                                       ArrayRef<int64_t> innerDimsPos) {
+  if (!isa<linalg::GenericOp>(linalgOp))
+    return "not an element-wise operation";
+  if (linalgOp->getNumResults() != 1)
+    return "more than one result";
+  if (!map.isProjectedPermutation())
+    return "non-permutation indexing map";
+  SmallVector<utils::IteratorType> iterators =
+      linalgOp.getIteratorTypesArray();
+  for (int64_t pos : innerDimsPos) {
+    auto dimExpr = dyn_cast<AffineDimExpr>(map.getResult(pos));
+    if (dimExpr &&
+        !linalg::isParallelIterator(iterators[dimExpr.getPosition()]))
+      return "reduction over a blocked dimension";
+  }
+  if (llvm::count_if(linalgOp->getOperands(), [](Value operand) {
+        return operand.getDefiningOp<tensor::UnPackOp>();
+      }) > 1) {
+    return "more than one operand in blocked layout";
+  }
+  return "unsupported by the propagation patterns";
+}
+
+// Emit a remark on each layout conversion left between two operations of
+// `func`: the tensor.unpack not returned or repacked in the same layout, and
+// the tensor.pack of values computed in the function.
+static void reportResidualConversions(func::FuncOp func) {
+  func.walk([](tensor::UnPackOp unPackOp) {
+    for (OpOperand &use : unPackOp->getUses()) {
+      Operation *user = use.getOwner();
+      if (isa<func::ReturnOp>(user))
+        continue;
+      StringRef reason = "not a linalg operation";
+      if (auto packOp = dyn_cast<tensor::PackOp>(user)) {
+        if (isSameLayout(packOp, unPackOp))
+          continue;
+        reason = "repacked into a different layout";
+      } else if (auto linalgOp = dyn_cast<linalg::LinalgOp>(user)) {
+        reason = getPropagationBarrier(linalgOp,
+                                       linalgOp.getMatchingIndexingMap(&use),
+                                       unPackOp.getInnerDimsPos());
+      }
+      unPackOp.emitRemark("residual layout conversion into '")
+          << user->getName() << "': " << reason;
+    }
+  });
+
+  func.walk([](tensor::PackOp packOp) {
+    Value source = packOp.getSource();
+    Operation *producer = source.getDefiningOp();
+    // Packs of the arguments, of constants and of fills are not conversions
+    // between operations, packs of an unpack are reported above.
+    if (!producer || matchPattern(source, m_Constant()) ||
+        isa<tensor::EmptyOp, tensor::UnPackOp, linalg::FillOp>(producer))
+      return;
+    StringRef reason = "not a linalg operation";
+    if (!source.hasOneUse()) {
+      reason = "more than one use of the packed value";
+    } else if (auto linalgOp = dyn_cast<linalg::LinalgOp>(producer)) {
+      reason = getPropagationBarrier(
+          linalgOp,
+          linalgOp.getIndexingMapMatchingResult(cast<OpResult>(source)),
+          packOp.getInnerDimsPos());
+    }
+    packOp.emitRemark("residual layout conversion from '")
+        << producer->getName() << "': " << reason;
+  });
+}
+
 struct PropagatePackUnPack
     : public tpp::impl::PropagatePackUnPackBase<PropagatePackUnPack> {
+  using PropagatePackUnPackBase::PropagatePackUnPackBase;
+
   void runOnOperation() override {
     MLIRContext *ctx = getOperation().getContext();
     RewritePatternSet patterns(ctx);
     linalg::populateDataLayoutPropagationPatterns(
         patterns, [](OpOperand *operand) { return true; });
+    patterns.add<GeneralizeEltwiseAtLayoutBoundary>(ctx);
     (void)applyPatternsAndFoldGreedily(getOperation(), std::move(patterns));
+
+    if (reportResidual)
+      reportResidualConversions(getOperation());
   }
 };
 
@@ -6,14 +6,18 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <cstdlib>
+#include <thread>
 #include <utility>
 
 #include "TPP/IR/StructuredOpMatcher.h"
 #include "TPP/Transforms/Utils/TransformUtils.h"
 #include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
 #include "mlir/Dialect/Linalg/Utils/Utils.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/Dialect/SCF/Utils/Utils.h"
 #include "mlir/Dialect/Tensor/IR/Tensor.h"
 #include "mlir/IR/AffineExprVisitor.h"
@@ -256,19 +260,56 @@ bool isBlockedConvolution(Operation *op) {
   return isBlockedConv.match(op);
 }
 
+bool isBlockedDepthwiseConvolution(Operation *op) {
+  // clang-format off
+  using namespace structured_match;
+
+  auto isBlockedDepthwiseConv =
+    StructuredOpMatcher::make<linalg::LinalgOp>()
+      .operation(NumDpsInits(EqualsTo(1)))
+      .operation(NumDpsInputs(EqualsTo(2)))
+      .operation(NumAffineMaps(EqualsTo(3)))
+      .operation(NumOfLoops(EqualsTo(7)))
+      .operation(VerifyOpProperty(
+            mlir::linalg::detail::verifyConvolutionInterface))
+      .dim(MatchRange(/*lowerBound=*/0, /*upperBound=*/7),
+          {mlir::utils::IteratorType::reduction,
+           mlir::utils::IteratorType::reduction,
+           mlir::utils::IteratorType::parallel,
+           mlir::utils::IteratorType::parallel,
+           mlir::utils::IteratorType::parallel,
+           mlir::utils::IteratorType::parallel,
+           mlir::utils::IteratorType::parallel})
+      .input(MatchOne(1), HasRank({4}))
+      .region(MatchOne(0),
+            WithOpChain<KindMul, KindAdd>(/*captures=*/nullptr));
+  // clang-format on
+  return isBlockedDepthwiseConv.match(op);
+}
+
 FailureOr<linalg::ContractionDimensions>
 isContraction(linalg::LinalgOp linalgOp) {
   using namespace structured_match;
 
+  // Floating point contraction or contraction with the inputs extended to the
+  // accumulation type (i8 to i32, fp8 to f32).
+  WithOpChain<arith::MulFOp, arith::AddFOp> floatChain(/*captures=*/nullptr);
+  WithOpChain<arith::ExtFOp, arith::ExtFOp, arith::MulFOp, arith::AddFOp>
+      extFloatChain(/*captures=*/nullptr);
+  WithOpChain<arith::ExtSIOp, arith::ExtSIOp, arith::MulIOp, arith::AddIOp>
+      intChain(/*captures=*/nullptr);
+  auto isMulAddChain = [&](Region *region, Operation *op) {
+    return floatChain(region, op) || extFloatChain(region, op) ||
+           intChain(region, op);
+  };
+
   // clang-format off
   auto maybeContraction =
     StructuredOpMatcher::make<linalg::LinalgOp>()
       .operation(NumDpsInits(EqualsTo(1)))
       .operation(NumDpsInputs(EqualsTo(2)))
       .operation(NumAffineMaps(EqualsTo(3)))
-      .region(MatchOne(0),
-            WithOpChain<arith::MulFOp,
-                        arith::AddFOp>(/*captures=*/nullptr));
+      .region(MatchOne(0), isMulAddChain);
   // clang-format on
   if (!maybeContraction.match(linalgOp))
     return failure();
@@ -281,6 +322,58 @@ isContraction(linalg::LinalgOp linalgOp) {
   return dims;
 }
 
+bool isDequantize(linalg::LinalgOp linalgOp) {
+  if (!linalgOp.hasPureTensorSemantics() || linalgOp.getNumDpsInits() != 1 ||
+      linalgOp.getNumDpsInputs() < 1 ||
+      linalgOp.getNumParallelLoops() != linalgOp.getNumLoops())
+    return false;
+  OpOperand *init = linalgOp.getDpsInitOperand(0);
+  OpOperand *quantized = linalgOp.getDpsInputOperand(0);
+  AffineMap quantizedMap = linalgOp.getMatchingIndexingMap(quantized);
+  if (!linalgOp.getMatchingIndexingMap(init).isIdentity() ||
+      (!quantizedMap.isIdentity() && !isNibbleMap(quantizedMap)) ||
+      linalgOp.payloadUsesValueFromOperand(init))
+    return false;
+  auto getElementType = [](OpOperand *operand) {
+    return getElementTypeOrSelf(operand->get().getType());
+  };
+  if (!isa<IntegerType>(getElementType(quantized)) ||
+      !isa<FloatType>(getElementType(init)))
+    return false;
+  for (OpOperand *input : linalgOp.getDpsInputOperands()) {
+    if (input != quantized && !isa<FloatType>(getElementType(input)))
+      return false;
+  }
+  // Only the conversion of the integers and the float arithmetic, and the
+  // unpacking of the nibbles.
+  bool isNibblePacked = !quantizedMap.isIdentity();
+  return llvm::all_of(
+      linalgOp.getBlock()->without_terminator(), [&](Operation &op) {
+        if (isa<arith::ExtSIOp, arith::ExtUIOp, arith::SIToFPOp,
+                arith::UIToFPOp, arith::ExtFOp, arith::TruncFOp, arith::MulFOp,
+                arith::SubFOp, arith::AddFOp>(op))
+          return true;
+        return isNibblePacked &&
+               isa<linalg::IndexOp, arith::ConstantOp, arith::RemUIOp,
+                   arith::CmpIOp, arith::ShLIOp, arith::ShRSIOp,
+                   arith::SelectOp, arith::TruncIOp>(op);
+      });
+}
+
+bool isNibbleMap(AffineMap map) {
+  unsigned numDims = map.getNumDims();
+  if (numDims == 0 || map.getNumSymbols() != 0 ||
+      map.getNumResults() != numDims)
+    return false;
+  MLIRContext *ctx = map.getContext();
+  for (unsigned dim = 0; dim < numDims - 1; dim++) {
+    if (map.getResult(dim) != getAffineDimExpr(dim, ctx))
+      return false;
+  }
+  return map.getResult(numDims - 1) ==
+         getAffineDimExpr(numDims - 1, ctx).floorDiv(2);
+}
+
 std::optional<int64_t> getConstantRange(const Range &range) {
   std::optional<int64_t> stride = getConstantIntValue(range.stride);
   if (!stride || *stride != 1)
@@ -294,6 +387,26 @@ std::optional<int64_t> getConstantRange(const Range &range) {
   return (*size - *offset);
 }
 
+std::optional<int64_t> getDimCoefficient(AffineExpr expr, unsigned dim) {
+  if (!expr.isPureAffine())
+    return std::nullopt;
+  MLIRContext *ctx = expr.getContext();
+  unsigned numDims = 0;
+  expr.walk([&](AffineExpr e) {
+    if (auto dimExpr = dyn_cast<AffineDimExpr>(e))
+      numDims = std::max(numDims, dimExpr.getPosition() + 1);
+  });
+  numDims = std::max(numDims, dim + 1);
+  SmallVector<AffineExpr> atZero(numDims, getAffineConstantExpr(0, ctx));
+  SmallVector<AffineExpr> atOne = atZero;
+  atOne[dim] = getAffineConstantExpr(1, ctx);
+  auto zero = dyn_cast<AffineConstantExpr>(expr.replaceDims(atZero));
+  auto one = dyn_cast<AffineConstantExpr>(expr.replaceDims(atOne));
+  if (!zero || !one)
+    return std::nullopt;
+  return one.getValue() - zero.getValue();
+}
+
 static bool validateFullTilesOnDim(TilingInterface tileOp,
                                    const OpFoldResult &tile, size_t dim,
                                    int64_t minTileFactor) {
@@ -346,6 +459,126 @@ bool validateFullTilesOnDims(TilingInterface tileOp,
   return true;
 }
 
+// Return the induction variables of `op` if it is a loop taking tiles.
+static SmallVector<Value> getTileLoopIvs(Operation *op) {
+  if (auto forOp = dyn_cast<scf::ForOp>(op))
+    return {forOp.getInductionVar()};
+  if (auto forallOp = dyn_cast<scf::ForallOp>(op))
+    return llvm::to_vector(forallOp.getInductionVars());
+  if (auto parallelOp = dyn_cast<scf::ParallelOp>(op))
+    return llvm::to_vector(parallelOp.getInductionVars());
+  return {};
+}
+
+// Return the constant lower bound, upper bound and step of the loop of `iv`.
+static std::optional<std::tuple<int64_t, int64_t, int64_t>>
+getConstantLoopBounds(Value iv) {
+  auto arg = dyn_cast<BlockArgument>(iv);
+  if (!arg)
+    return std::nullopt;
+  Operation *loopOp = arg.getOwner()->getParentOp();
+  OpFoldResult lb, ub, step;
+  if (auto forOp = dyn_cast<scf::ForOp>(loopOp)) {
+    if (iv != forOp.getInductionVar())
+      return std::nullopt;
+    lb = forOp.getLowerBound();
+    ub = forOp.getUpperBound();
+    step = forOp.getStep();
+  } else if (auto forallOp = dyn_cast<scf::ForallOp>(loopOp)) {
+    unsigned idx = arg.getArgNumber();
+    if (idx >= forallOp.getRank())
+      return std::nullopt;
+    lb = forallOp.getMixedLowerBound()[idx];
+    ub = forallOp.getMixedUpperBound()[idx];
+    step = forallOp.getMixedStep()[idx];
+  } else if (auto parallelOp = dyn_cast<scf::ParallelOp>(loopOp)) {
+    unsigned idx = arg.getArgNumber();
+    lb = parallelOp.getLowerBound()[idx];
+    ub = parallelOp.getUpperBound()[idx];
+    step = parallelOp.getStep()[idx];
+  } else {
+    return std::nullopt;
+  }
+  std::optional<int64_t> lbCst = getConstantIntValue(lb);
+  std::optional<int64_t> ubCst = getConstantIntValue(ub);
+  std::optional<int64_t> stepCst = getConstantIntValue(step);
+  if (!lbCst || !ubCst || !stepCst)
+    return std::nullopt;
+  return std::make_tuple(*lbCst, *ubCst, *stepCst);
+}
+
+// Return the induction variable and its coefficient in `offset` if it is
+// `iv` or `affine.apply (d0 * c)(iv)`.
+static std::optional<std::pair<Value, int64_t>>
+getScaledInductionVar(OpFoldResult offset) {
+  auto value = dyn_cast<Value>(offset);
+  if (!value)
+    return std::nullopt;
+  if (isa<BlockArgument>(value))
+    return std::make_pair(value, int64_t(1));
+  auto applyOp = value.getDefiningOp<affine::AffineApplyOp>();
+  if (!applyOp || applyOp.getMapOperands().size() != 1 ||
+      applyOp.getAffineMap().getNumDims() != 1)
+    return std::nullopt;
+  AffineExpr expr = applyOp.getAffineMap().getResult(0);
+  std::optional<int64_t> coeff = getDimCoefficient(expr, 0);
+  auto atZero = dyn_cast<AffineConstantExpr>(
+      expr.replaceDims(getAffineConstantExpr(0, expr.getContext())));
+  if (!coeff || !atZero || atZero.getValue() != 0)
+    return std::nullopt;
+  return std::make_pair(applyOp.getMapOperands()[0], *coeff);
+}
+
+bool isCoveredByTiles(Value dest, OffsetSizeAndStrideOpInterface tile,
+                      Operation *rootLoop) {
+  auto destType = dyn_cast<ShapedType>(dest.getType());
+  if (!destType || !destType.hasStaticShape() ||
+      tile->getOperand(0) != dest || !rootLoop->isProperAncestor(tile))
+    return false;
+
+  ArrayRef<int64_t> shape = destType.getShape();
+  SmallVector<OpFoldResult> offsets = tile.getMixedOffsets();
+  ArrayRef<int64_t> sizes = tile.getStaticSizes();
+  ArrayRef<int64_t> strides = tile.getStaticStrides();
+  if (offsets.size() != shape.size())
+    return false;
+
+  // Each dimension is either taken whole or stepped over by one loop.
+  DenseSet<Value> tileIvs;
+  for (auto [dim, offset] : llvm::enumerate(offsets)) {
+    if (ShapedType::isDynamic(sizes[dim]) || strides[dim] != 1)
+      return false;
+    std::optional<int64_t> cstOffset = getConstantIntValue(offset);
+    if (cstOffset && *cstOffset == 0 && sizes[dim] == shape[dim])
+      continue;
+    auto scaledIv = getScaledInductionVar(offset);
+    if (!scaledIv)
+      return false;
+    auto [iv, coeff] = *scaledIv;
+    auto bounds = getConstantLoopBounds(iv);
+    if (!bounds || !rootLoop->isAncestor(iv.getParentRegion()->getParentOp()) ||
+        !tileIvs.insert(iv).second)
+      return false;
+    auto [lb, ub, step] = *bounds;
+    if (lb != 0 || step <= 0 || ub % step != 0 ||
+        coeff * step != sizes[dim] || coeff * ub != shape[dim])
+      return false;
+  }
+
+  // Every loop steps over a dimension, otherwise the tiles are taken more
+  // than once.
+  for (Operation *op = tile->getParentOp();; op = op->getParentOp()) {
+    SmallVector<Value> ivs = getTileLoopIvs(op);
+    if (ivs.empty() || !llvm::all_of(ivs, [&](Value iv) {
+          return tileIvs.contains(iv);
+        }))
+      return false;
+    if (op == rootLoop)
+      break;
+  }
+  return true;
+}
+
 namespace {
 
 // Convert scf.for to scf.forall after fusion.
@@ -451,6 +684,17 @@ void populateScfForToForAllRewritePattern(RewritePatternSet &patterns) {
   patterns.add<ConvertToForAll>(patterns.getContext());
 }
 
+unsigned getDefaultNumThreads() {
+  for (const char *name : {"TPP_NUM_THREADS", "OMP_NUM_THREADS"}) {
+    if (const char *value = std::getenv(name)) {
+      unsigned numThreads = 0;
+      if (!StringRef(value).getAsInteger(10, numThreads) && numThreads > 0)
+        return numThreads;
+    }
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
 } // namespace utils
 
 } // namespace linalgx
@@ -0,0 +1,456 @@
+//===- BlockingCostModel.cpp -------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Transforms/Utils/BlockingCostModel.h"
+#include "TPP/Transforms/Utils/VNNIUtils.h"
+
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/Linalg/IR/LinalgInterfaces.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/Interfaces/DataLayoutInterfaces.h"
+#include "llvm/Support/MathExtras.h"
+
+#include "libxsmm.h"
+
+#include <algorithm>
+#include <optional>
+#include <tuple>
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+// Range of the block factors considered on any dimension. Smaller blocks are
+// only used for dimensions that are smaller.
+static constexpr int64_t kMinBlockFactor = 8;
+static constexpr int64_t kMaxBlockFactor = 256;
+
+// Return the "CPU" device spec of the DLTI target system spec of the module
+// of `op`, if any.
+static std::optional<TargetDeviceSpecInterface>
+getCpuDeviceSpec(Operation *op) {
+  auto moduleOp = dyn_cast<ModuleOp>(op);
+  if (!moduleOp)
+    moduleOp = op->getParentOfType<ModuleOp>();
+  if (!moduleOp)
+    return std::nullopt;
+  TargetSystemSpecInterface sysSpec = moduleOp.getTargetSystemSpec();
+  if (!sysSpec)
+    return std::nullopt;
+  auto deviceId = StringAttr::get(op->getContext(), "CPU");
+  return sysSpec.getDeviceSpecForDeviceID(deviceId);
+}
+
+static std::optional<int64_t> getSpecEntry(TargetDeviceSpecInterface spec,
+                                           StringRef key) {
+  DataLayoutEntryInterface entry =
+      spec.getSpecForIdentifier(StringAttr::get(spec.getContext(), key));
+  if (!entry)
+    return std::nullopt;
+  if (auto intAttr = dyn_cast<IntegerAttr>(entry.getValue()))
+    return intAttr.getValue().getZExtValue();
+  return std::nullopt;
+}
+
+// Set the vector register file and AMX support of `target` from the
+// architecture libxsmm targets, left as is on unknown architectures.
+static void setTargetArchFeatures(CpuTargetInfo &target) {
+  int archId = libxsmm_get_target_archid();
+  if (archId >= LIBXSMM_X86_GENERIC && archId < LIBXSMM_X86_AVX2) {
+    target.vectorWidth = 128;
+    target.numVectorRegisters = 16;
+  } else if (archId >= LIBXSMM_X86_AVX2 && archId < LIBXSMM_X86_AVX512_SKX) {
+    target.vectorWidth = 256;
+    target.numVectorRegisters = 16;
+  } else if (archId >= LIBXSMM_X86_AVX512_SKX &&
+             archId <= LIBXSMM_X86_ALLFEAT) {
+    target.vectorWidth = 512;
+    target.numVectorRegisters = 32;
+    target.hasAmx = archId >= LIBXSMM_X86_AVX512_SPR;
+  } else if (archId >= LIBXSMM_AARCH64_V81 &&
+             archId <= LIBXSMM_AARCH64_ALLFEAT) {
+    target.numVectorRegisters = 32;
+    if (archId >= LIBXSMM_AARCH64_SVE512)
+      target.vectorWidth = 512;
+    else if (archId >= LIBXSMM_AARCH64_SVE256)
+      target.vectorWidth = 256;
+    else
+      target.vectorWidth = 128;
+  }
+}
+
+CpuTargetInfo CpuTargetInfo::get(Operation *op, bool fromTargetArch) {
+  CpuTargetInfo target;
+  if (fromTargetArch)
+    setTargetArchFeatures(target);
+  auto spec = getCpuDeviceSpec(op);
+  if (!spec)
+    return target;
+  if (auto value = getSpecEntry(*spec, "L1_cache_size_in_bytes"))
+    target.l1CacheSize = *value;
+  if (auto value = getSpecEntry(*spec, "L2_cache_size_in_bytes"))
+    target.l2CacheSize = *value;
+  if (auto value = getSpecEntry(*spec, "L3_cache_size_in_bytes"))
+    target.l3CacheSize = *value;
+  if (auto value = getSpecEntry(*spec, "max_vector_op_width"))
+    target.vectorWidth = *value;
+  if (auto value = getSpecEntry(*spec, "num_vector_registers"))
+    target.numVectorRegisters = *value;
+  if (auto value = getSpecEntry(*spec, "has_amx"))
+    target.hasAmx = *value != 0;
+  if (auto value = getSpecEntry(*spec, "has_sve"))
+    target.hasSve = *value != 0;
+  if (auto value = getSpecEntry(*spec, "has_sme"))
+    target.hasSme = *value != 0;
+  return target;
+}
+
+bool CpuTargetInfo::isDescribed(Operation *op) {
+  auto spec = getCpuDeviceSpec(op);
+  return spec && getSpecEntry(*spec, "L1_cache_size_in_bytes");
+}
+
+// Return the divisors of `size` that are multiples of `step`, in the range of
+// block factors.
+static SmallVector<int64_t> getBlockCandidates(int64_t size, int64_t step) {
+  SmallVector<int64_t> candidates;
+  int64_t minBlock = std::min(size, kMinBlockFactor);
+  for (int64_t block = step; block <= std::min(size, kMaxBlockFactor);
+       block += step) {
+    if (block >= minBlock && size % block == 0)
+      candidates.push_back(block);
+  }
+  return candidates;
+}
+
+FailureOr<SmallVector<int64_t>>
+tpp::getMatmulBlockingFactors(linalg::LinalgOp linalgOp,
+                              const CpuTargetInfo &target) {
+  auto dims = linalg::inferContractionDims(linalgOp);
+  if (failed(dims) || dims->m.empty() || dims->n.empty() || dims->k.empty())
+    return failure();
+
+  SmallVector<int64_t, 4> loopsRange = linalgOp.getStaticLoopRanges();
+  int64_t sizeM = loopsRange[dims->m.back()];
+  int64_t sizeN = loopsRange[dims->n.back()];
+  int64_t sizeK = loopsRange[dims->k.back()];
+  if (ShapedType::isDynamic(sizeM) || ShapedType::isDynamic(sizeN) ||
+      ShapedType::isDynamic(sizeK))
+    return failure();
+
+  Type inputType = getElementTypeOrSelf(linalgOp.getDpsInputs()[0].getType());
+  Type accType = getElementTypeOrSelf(linalgOp.getDpsInits()[0].getType());
+  if (!inputType.isIntOrFloat() || !accType.isIntOrFloat())
+    return failure();
+  int64_t inputBytes =
+      std::max<int64_t>(inputType.getIntOrFloatBitWidth() / 8, 1);
+  int64_t accBytes = std::max<int64_t>(accType.getIntOrFloatBitWidth() / 8, 1);
+
+  // Accumulators are vectorized along N, as many rows of them as the
+  // registers hold form the micro-kernel tile. Low precision types are packed
+  // along K by the VNNI factor. AMX tiles are 16 rows of 64 bytes, i.e. 16
+  // rows by 16 accumulators, with K packed by 64 bytes of input.
+  int64_t lanes = std::max<int64_t>(
+      target.vectorWidth / accType.getIntOrFloatBitWidth(), 1);
+  int64_t stepK = 1;
+  if (auto vnniFactor = vnni::utils::getVnniBlockingFactor(inputType))
+    stepK = std::max<int64_t>(*vnniFactor, 1);
+  bool useAmx = target.hasAmx && stepK > 1;
+  if (useAmx) {
+    lanes = 16;
+    stepK = 64 / inputBytes;
+  }
+
+  SmallVector<int64_t> blocksM = getBlockCandidates(sizeM, 1);
+  SmallVector<int64_t> blocksN = getBlockCandidates(sizeN, lanes);
+  if (blocksN.empty())
+    blocksN = getBlockCandidates(sizeN, 1);
+  SmallVector<int64_t> blocksK = getBlockCandidates(sizeK, stepK);
+  if (blocksM.empty() || blocksN.empty() || blocksK.empty())
+    return failure();
+
+  // Score the blocks by their arithmetic intensity over the L1 working set,
+  // scaled by the fraction of the vector lanes and of the register tile rows
+  // they use. Blocks whose K panels of A and B overflow L2 are reloaded from
+  // memory across the brgemm reduction and cost twice as much.
+  std::optional<std::tuple<double, int64_t, int64_t, int64_t>> best;
+  for (int64_t blockM : blocksM) {
+    for (int64_t blockN : blocksN) {
+      int64_t vectorsN = llvm::divideCeil(blockN, lanes);
+      int64_t rowsM = 16;
+      if (!useAmx) {
+        int64_t maxVectors = std::max<int64_t>(
+            (target.numVectorRegisters - 1) / 2, 1);
+        int64_t tileVectors = std::min(vectorsN, maxVectors);
+        rowsM = std::max<int64_t>(
+            (target.numVectorRegisters - 1 - tileVectors) / tileVectors, 1);
+      }
+      double laneUse = static_cast<double>(blockN) / (vectorsN * lanes);
+      double rowUse = static_cast<double>(blockM) /
+                      (llvm::divideCeil(blockM, rowsM) * rowsM);
+
+      for (int64_t blockK : blocksK) {
+        int64_t workingSet =
+            (blockM * blockK + blockK * blockN) * inputBytes +
+            blockM * blockN * accBytes;
+        if (workingSet > target.l1CacheSize)
+          continue;
+        int64_t panels = (blockM * sizeK + sizeK * blockN) * inputBytes +
+                         blockM * blockN * accBytes;
+        double intensity =
+            2.0 * blockM * blockN * blockK / static_cast<double>(workingSet);
+        double score = intensity * laneUse * rowUse;
+        if (panels > target.l2CacheSize)
+          score /= 2;
+        auto candidate = std::make_tuple(score, blockN, blockM, blockK);
+        if (!best || candidate > *best)
+          best = candidate;
+      }
+    }
+  }
+  if (!best)
+    return failure();
+
+  return SmallVector<int64_t>{std::get<2>(*best), std::get<1>(*best),
+                              std::get<3>(*best)};
+}
+
+// Return the vector length in elements of `elementType`.
+static int64_t getVectorLanes(Type elementType, const CpuTargetInfo &target) {
+  return std::max<int64_t>(
+      target.vectorWidth / elementType.getIntOrFloatBitWidth(), 1);
+}
+
+bool tpp::isStreamingOutput(ShapedType type, const CpuTargetInfo &target) {
+  if (!type.hasStaticShape() || !type.getElementType().isIntOrFloat())
+    return false;
+  int64_t bytes = type.getNumElements() *
+                  llvm::divideCeil(type.getElementTypeBitWidth(), 8);
+  return bytes > target.l3CacheSize;
+}
+
+bool tpp::useScalableVectors(Type elementType, const CpuTargetInfo &target) {
+  return target.hasSve && elementType.isF32();
+}
+
+bool tpp::useMatrixTiles(Type elementType, const CpuTargetInfo &target) {
+  return target.hasSme && elementType.isF32();
+}
+
+// Return the largest divisor of `size` not greater than `limit`.
+static int64_t getLargestDivisor(int64_t size, int64_t limit) {
+  for (int64_t block = std::min(size, limit); block > 1; block--) {
+    if (size % block == 0)
+      return block;
+  }
+  return 1;
+}
+
+int64_t tpp::getRegisterBlockPressure(int64_t blockM, int64_t blockN,
+                                      Type elementType,
+                                      const CpuTargetInfo &target) {
+  if (useScalableVectors(elementType, target))
+    return 2 * blockM + 1;
+  int64_t vectorsN =
+      llvm::divideCeil(blockN, getVectorLanes(elementType, target));
+  return blockM * vectorsN + blockM + vectorsN;
+}
+
+FailureOr<std::pair<int64_t, int64_t>>
+tpp::getRegisterBlock(int64_t sizeM, int64_t sizeN, Type elementType,
+                      const CpuTargetInfo &target, bool allowRemainder) {
+  if (ShapedType::isDynamic(sizeM) || ShapedType::isDynamic(sizeN) ||
+      !elementType.isIntOrFloat())
+    return failure();
+
+  // The ZA array holds 2x2 f32 tiles of a streaming vector length each way.
+  if (useMatrixTiles(elementType, target)) {
+    int64_t tileSize = 2 * getVectorLanes(elementType, target);
+    if (allowRemainder) {
+      return std::make_pair(std::min(sizeM, tileSize),
+                            std::min(sizeN, tileSize));
+    }
+    return std::make_pair(getLargestDivisor(sizeM, tileSize),
+                          getLargestDivisor(sizeN, tileSize));
+  }
+
+  // The scalable kernel loops over the whole N, the accumulators and the
+  // broadcasts of MR rows take two registers per row.
+  if (useScalableVectors(elementType, target)) {
+    int64_t maxBlockM = (target.numVectorRegisters - 1) / 2;
+    if (maxBlockM < 1)
+      return failure();
+    if (allowRemainder)
+      return std::make_pair(std::min(sizeM, maxBlockM), sizeN);
+    return std::make_pair(getLargestDivisor(sizeM, maxBlockM), sizeN);
+  }
+
+  // Rows of the rhs are loaded in full vectors, unless N is narrower.
+  int64_t lanes = getVectorLanes(elementType, target);
+  int64_t stepN =
+      sizeN % lanes == 0 || (allowRemainder && sizeN > lanes) ? lanes : sizeN;
+
+  // Each step of K loads MR broadcasts and NR / lanes vectors of the rhs for
+  // MR * NR / lanes FMAs. Prefer the highest ratio, then the largest tile.
+  std::optional<std::tuple<double, int64_t, int64_t, int64_t>> best;
+  for (int64_t blockN = stepN; blockN <= sizeN; blockN += stepN) {
+    if (!allowRemainder && sizeN % blockN != 0)
+      continue;
+    int64_t vectorsN = llvm::divideCeil(blockN, lanes);
+    for (int64_t blockM = 1; blockM <= sizeM; blockM++) {
+      if ((!allowRemainder && sizeM % blockM != 0) ||
+          getRegisterBlockPressure(blockM, blockN, elementType, target) >
+              target.numVectorRegisters)
+        continue;
+      int64_t fmas = blockM * vectorsN;
+      double ratio = static_cast<double>(fmas) / (blockM + vectorsN);
+      // The remainder is left to tiles with a lower ratio.
+      double fullTiles =
+          static_cast<double>((sizeM - sizeM % blockM) *
+                              (sizeN - sizeN % blockN)) /
+          (sizeM * sizeN);
+      auto candidate =
+          std::make_tuple(ratio * fullTiles, fmas, blockN, blockM);
+      if (!best || candidate > *best)
+        best = candidate;
+    }
+  }
+  if (!best)
+    return failure();
+  return std::make_pair(std::get<3>(*best), std::get<2>(*best));
+}
+
+// Edges are computed out of the blocked layout from strided operands, count
+// them a quarter more than the blocks.
+static constexpr double kEdgeOverhead = 1.25;
+
+// Return the FMAs on useful lanes per register load of the micro-kernel of a
+// `sizeM` x `sizeN` accumulator of `elementType`.
+static double getRegisterTileEfficiency(int64_t sizeM, int64_t sizeN,
+                                        Type elementType,
+                                        const CpuTargetInfo &target) {
+  int64_t lanes = getVectorLanes(elementType, target);
+  auto block = tpp::getRegisterBlock(sizeM, sizeN, elementType, target);
+  // A scalar loop loads both operands of each FMA.
+  if (failed(block))
+    return 1.0 / (2 * lanes);
+  auto [blockM, blockN] = *block;
+  int64_t vectorsN = llvm::divideCeil(blockN, lanes);
+  return static_cast<double>(blockM * blockN) / lanes / (blockM + vectorsN);
+}
+
+bool tpp::isMatmulPaddingProfitable(int64_t sizeM, int64_t sizeN,
+                                    int64_t sizeK,
+                                    ArrayRef<int64_t> blockFactors,
+                                    Type elementType,
+                                    const CpuTargetInfo &target) {
+  if (blockFactors.size() != 3 || !elementType.isIntOrFloat())
+    return false;
+  int64_t blockM = blockFactors[0];
+  int64_t blockN = blockFactors[1];
+  int64_t blockK = blockFactors[2];
+  double blockCost =
+      1.0 / getRegisterTileEfficiency(blockM, blockN, elementType, target);
+  double padded = static_cast<double>(llvm::alignTo(sizeM, blockM)) *
+                  llvm::alignTo(sizeN, blockN) * llvm::alignTo(sizeK, blockK) *
+                  blockCost;
+
+  // The K remainder only shortens the reduction, the M and N remainders
+  // are computed by the tiles of their edges.
+  SmallVector<std::pair<int64_t, int64_t>> partsM{
+      {sizeM - sizeM % blockM, blockM}, {sizeM % blockM, sizeM % blockM}};
+  SmallVector<std::pair<int64_t, int64_t>> partsN{
+      {sizeN - sizeN % blockN, blockN}, {sizeN % blockN, sizeN % blockN}};
+  double peeled = 0;
+  for (auto [idxM, partM] : llvm::enumerate(partsM)) {
+    for (auto [idxN, partN] : llvm::enumerate(partsN)) {
+      auto [sizePartM, tileM] = partM;
+      auto [sizePartN, tileN] = partN;
+      if (sizePartM == 0 || sizePartN == 0)
+        continue;
+      double cost = static_cast<double>(sizePartM) * sizePartN * sizeK /
+                    getRegisterTileEfficiency(tileM, tileN, elementType,
+                                              target);
+      if (idxM != 0 || idxN != 0)
+        cost *= kEdgeOverhead;
+      peeled += cost;
+    }
+  }
+  return padded < peeled;
+}
+
+TileTraversal
+tpp::getTileTraversal(int64_t rows, int64_t cols, int64_t rowPanelBytes,
+                      int64_t colPanelBytes, int64_t numThreads,
+                      const CpuTargetInfo &target,
+                      std::optional<TileTraversal::Order> order) {
+  if (rows < 2 || cols < 2 || numThreads < 2)
+    return {};
+  if (!order &&
+      rows * rowPanelBytes + cols * colPanelBytes <= target.l3CacheSize)
+    return {};
+
+  // The tiles of a round span `roundRows` x `roundCols` panels, the
+  // `resident` ones are read again by the next rounds.
+  struct Candidate {
+    TileTraversal traversal;
+    int64_t roundBytes;
+    int64_t residentBytes;
+  };
+  int64_t threads = std::min(numThreads, rows * cols);
+  SmallVector<Candidate> candidates;
+  auto addCandidate = [&](TileTraversal::Order candidateOrder, int64_t size,
+                          int64_t roundRows, int64_t residentRows,
+                          int64_t residentCols) {
+    if (order && *order != candidateOrder)
+      return;
+    int64_t roundCols = llvm::divideCeil(threads, roundRows);
+    candidates.push_back(
+        {{candidateOrder, size},
+         roundRows * rowPanelBytes + roundCols * colPanelBytes,
+         residentRows * rowPanelBytes + residentCols * colPanelBytes});
+  };
+  addCandidate(TileTraversal::RowMajor, 1, llvm::divideCeil(threads, cols),
+               0, cols);
+  addCandidate(TileTraversal::ColMajor, 1, std::min(threads, rows), rows, 0);
+  for (int64_t group = 2; group < rows; ++group)
+    addCandidate(TileTraversal::Grouped, group, std::min(threads, group),
+                 group, 0);
+  // The Morton blocks must divide the grid.
+  int64_t block = 1;
+  while ((rows % (block * 2)) == 0 && (cols % (block * 2)) == 0)
+    block *= 2;
+  std::optional<Candidate> morton;
+  if (block > 1) {
+    int64_t side = 1;
+    while (side * side < threads && side < block)
+      side *= 2;
+    addCandidate(TileTraversal::Morton, block, side, block, block);
+    if (!candidates.empty() &&
+        candidates.back().traversal.order == TileTraversal::Morton)
+      morton = candidates.back();
+  }
+  if (candidates.empty())
+    return {};
+
+  std::optional<Candidate> best;
+  for (const Candidate &candidate : candidates) {
+    if (candidate.residentBytes > target.l3CacheSize)
+      continue;
+    if (!best || candidate.roundBytes < best->roundBytes)
+      best = candidate;
+  }
+  if (!best && morton)
+    best = morton;
+  if (!best) {
+    best = candidates.front();
+    for (const Candidate &candidate : candidates)
+      if (candidate.roundBytes < best->roundBytes)
+        best = candidate;
+  }
+  return best->traversal;
+}
@@ -8,6 +8,7 @@
 
 #include "mlir/Dialect/Arith/IR/Arith.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/LLVMIR/LLVMDialect.h"
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/Tensor/IR/Tensor.h"
@@ -54,6 +55,22 @@ func::FuncOp createFunction(OpBuilder &builder, ModuleOp module, StringRef name,
   }
 }
 
+func::FuncOp getOrCreateRuntimeFunc(ModuleOp module, StringRef name,
+                                    TypeRange argTypes, TypeRange resultTypes,
+                                    bool emitCInterface) {
+  if (auto funcOp = module.lookupSymbol<func::FuncOp>(name))
+    return funcOp;
+  OpBuilder builder = OpBuilder::atBlockBegin(module.getBody());
+  auto funcOp = builder.create<func::FuncOp>(
+      module.getLoc(), name, builder.getFunctionType(argTypes, resultTypes));
+  funcOp.setPrivate();
+  if (emitCInterface) {
+    funcOp->setAttr(LLVM::LLVMDialect::getEmitCWrapperAttrName(),
+                    builder.getUnitAttr());
+  }
+  return funcOp;
+}
+
 Value getConstInt(OpBuilder &builder, int value, int width) {
   switch (width) {
   case 32:
@@ -20,6 +20,10 @@ TensorInitFloat::getTensorInitDataType(mlir::Type type) {
     return DataType::FP32;
   if (type.isF64())
     return DataType::FP64;
+  if (isa<Float8E5M2Type>(type))
+    return DataType::FP8E5M2;
+  if (isa<Float8E4M3FNType>(type))
+    return DataType::FP8E4M3;
   return DataType::AUTO;
 }
 
@@ -45,6 +49,12 @@ void TensorInitFloat::convertType(llvm::APFloat &value) {
   case DataType::BF16:
     toBF16(value);
     break;
+  case DataType::FP8E5M2:
+    toFP8E5M2(value);
+    break;
+  case DataType::FP8E4M3:
+    toFP8E4M3(value);
+    break;
   case DataType::AUTO:
     toFP32(value);
     break;
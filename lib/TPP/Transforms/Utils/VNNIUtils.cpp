@@ -23,18 +23,38 @@ std::optional<int64_t> getVnniBlockingFactor(Type type) {
   auto elementType = getElementTypeOrSelf(type);
   if (elementType.isBF16())
     return libxsmm_cpuid_dot_pack_factor(LIBXSMM_DATATYPE_BF16);
+  if (elementType.isInteger(8))
+    return libxsmm_cpuid_dot_pack_factor(LIBXSMM_DATATYPE_I8);
   return std::nullopt;
 }
 
+bool hasNativeDotProduct(Type type) {
+  if (!getElementTypeOrSelf(type).isBF16())
+    return true;
+  // The kernels are JITed for the target libxsmm selects (see LIBXSMM_TARGET).
+  int archId = libxsmm_get_target_archid();
+  if (archId < LIBXSMM_X86_GENERIC || archId > LIBXSMM_X86_ALLFEAT)
+    return true;
+  return archId >= LIBXSMM_X86_AVX512_CPX;
+}
+
+bool hasX86DotProduct(Type type) {
+  if (!getElementTypeOrSelf(type).isBF16())
+    return false;
+  int archId = libxsmm_get_target_archid();
+  return archId >= LIBXSMM_X86_AVX512_CPX && archId <= LIBXSMM_X86_ALLFEAT;
+}
+
 // Until we have a better way to express the VNNI layout (see: #563), it is up
 // to the callee to specify the expected rank in the VNNI layout as the rank
 // depends on the operations we are dealing with.
 bool isInVnniLayout(VnniOperandRank expectedRank, MemRefType memref) {
+  auto blockingFactor = vnni::utils::getVnniBlockingFactor(memref);
   if (memref.getRank() != static_cast<int64_t>(expectedRank) ||
-      !memref.getElementType().isBF16()) {
+      !blockingFactor) {
     return false;
   }
-  return memref.getShape().back() == vnni::utils::getVnniBlockingFactor(memref);
+  return memref.getShape().back() == *blockingFactor;
 }
 
 FailureOr<AffineDimExpr> isInVnniLayout(linalg::GenericOp linalgOp,
@@ -75,10 +95,10 @@ bool isInVnniLayout(VnniOperandRank expectedRank, VectorType vector) {
 }
 
 bool isInVnniLayout(int64_t expectedRank, VectorType vector) {
-  if (vector.getRank() != expectedRank || !vector.getElementType().isBF16()) {
+  auto blockingFactor = vnni::utils::getVnniBlockingFactor(vector);
+  if (vector.getRank() != expectedRank || !blockingFactor)
     return false;
-  }
-  return vector.getShape().back() == vnni::utils::getVnniBlockingFactor(vector);
+  return vector.getShape().back() == *blockingFactor;
 }
 
 } // namespace utils
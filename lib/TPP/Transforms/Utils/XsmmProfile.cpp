@@ -0,0 +1,88 @@
+//===- XsmmProfile.cpp -------------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the reading of the XSMM kernel profiles written by the
+// runtime telemetry.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Transforms/Utils/XsmmProfile.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <algorithm>
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+// Kinds of the kernels with a FLOP count.
+static bool isGemmLike(StringRef kind) {
+  return kind == "gemm" || kind == "brgemm" || kind == "fused_brgemm";
+}
+
+FailureOr<XsmmProfile> XsmmProfile::load(StringRef path, std::string &error) {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer) {
+    error = "cannot read " + path.str() + ": " + buffer.getError().message();
+    return failure();
+  }
+  auto json = llvm::json::parse((*buffer)->getBuffer());
+  if (!json) {
+    error = "invalid profile " + path.str() + ": " +
+            llvm::toString(json.takeError());
+    return failure();
+  }
+  auto *root = json->getAsObject();
+  auto *entries = root ? root->getArray("xsmm_kernels") : nullptr;
+  if (!entries) {
+    error = "invalid profile " + path.str() + ": no xsmm_kernels";
+    return failure();
+  }
+
+  XsmmProfile profile;
+  for (auto &entry : *entries) {
+    auto *kernel = entry.getAsObject();
+    if (!kernel)
+      continue;
+    auto kind = kernel->getString("kind");
+    auto dtype = kernel->getInteger("dtype");
+    auto m = kernel->getInteger("m");
+    auto n = kernel->getInteger("n");
+    auto k = kernel->getInteger("k");
+    auto calls = kernel->getInteger("calls");
+    auto batches = kernel->getInteger("batches");
+    auto seconds = kernel->getNumber("seconds");
+    if (!kind || !isGemmLike(*kind) || !dtype || !m || !n || !k || !calls ||
+        !batches || !seconds || *seconds <= 0)
+      continue;
+    profile.kernels.push_back({kind->str(), *dtype, *m, *n, *k,
+                               static_cast<uint64_t>(*calls),
+                               static_cast<uint64_t>(*batches), *seconds});
+  }
+  return profile;
+}
+
+std::optional<double> XsmmProfile::getEfficiency(int64_t dtype, int64_t m,
+                                                 int64_t n, int64_t k) const {
+  double flops = 0;
+  double seconds = 0;
+  double best = 0;
+  for (const XsmmKernelProfile &kernel : kernels) {
+    if (kernel.dtype != dtype)
+      continue;
+    best = std::max(best, kernel.getFlops() / kernel.seconds);
+    if (kernel.m == m && kernel.n == n && kernel.k == k) {
+      flops += kernel.getFlops();
+      seconds += kernel.seconds;
+    }
+  }
+  if (seconds == 0 || best == 0)
+    return std::nullopt;
+  return flops / seconds / best;
+}
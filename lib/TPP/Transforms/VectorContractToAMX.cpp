@@ -0,0 +1,248 @@
+//===- VectorContractToAMX.cpp -----------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements lowering of bf16 and int8 vector contractions in VNNI
+// layout to Intel AMX tile operations.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Transforms/Transforms.h"
+#include "TPP/Transforms/Utils/BlockingCostModel.h"
+#include "mlir/Dialect/AMX/AMXDialect.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Vector/IR/VectorOps.h"
+#include "mlir/Pass/Pass.h"
+#include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+
+#define DEBUG_TYPE "vector-contract-to-amx"
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_VECTORCONTRACTTOAMX
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+// A tile has at most 16 rows of 64 bytes.
+static constexpr int64_t kTileRows = 16;
+static constexpr int64_t kTileRowBytes = 64;
+
+static bool fitsInTile(int64_t rows, int64_t cols, Type elementType) {
+  return rows <= kTileRows &&
+         cols * elementType.getIntOrFloatBitWidth() / 8 <= kTileRowBytes;
+}
+
+// Returns true if `readOp` reads a whole 2-D memref in-bounds with an
+// identity map, i.e. a row-major tile AMX can load directly.
+static bool isTileRead(vector::TransferReadOp readOp) {
+  return readOp && !readOp.getMask() &&
+         isa<MemRefType>(readOp.getShapedType()) &&
+         readOp.getShapedType().getRank() == 2 &&
+         readOp.getPermutationMap().isMinorIdentity() &&
+         !readOp.hasOutOfBoundsDim() &&
+         llvm::all_of(readOp.getIndices(), isZeroIndex);
+}
+
+// The 4-D VNNI operands are collapsed to the 2-D rows of a tile:
+// [1, M, K/vnni, vnni] to [M, K] for the lhs, [1, K/vnni, N, vnni] to
+// [K/vnni, N * vnni] for the rhs.
+static SmallVector<ReassociationIndices> getTileReassociation() {
+  return {{0, 1}, {2, 3}};
+}
+
+// Returns true if `readOp` reads a whole 4-D VNNI memref in-bounds that can
+// be collapsed to the rows of a tile.
+static bool isVnniTileRead(vector::TransferReadOp readOp) {
+  if (!readOp || readOp.getMask() || readOp.hasOutOfBoundsDim() ||
+      !readOp.getPermutationMap().isMinorIdentity() ||
+      !llvm::all_of(readOp.getIndices(), isZeroIndex))
+    return false;
+  auto memrefType = dyn_cast<MemRefType>(readOp.getShapedType());
+  return memrefType && memrefType.getRank() == 4 &&
+         memrefType.getShape() == readOp.getVectorType().getShape() &&
+         memref::CollapseShapeOp::isGuaranteedCollapsible(
+             memrefType, getTileReassociation());
+}
+
+namespace {
+
+// Lowers a batch-reduce contraction of a single batch in VNNI layout,
+//   lhs (b, m, k, vnni) x rhs (b, k, n, vnni) -> acc (m, n),
+// to amx.tile_mulf (tdpbf16ps) for bf16 and amx.tile_muli (tdpbssd) for int8.
+// When the accumulator is carried by the iter_args of the surrounding loops
+// from a transfer_read to a transfer_write, these become tile loads and
+// stores so that the accumulator stays in a tile across the reduction.
+//
+// The tile configuration is not materialized: the X86 backend configures the
+// tiles once per function from their shapes.
+struct VectorContractToAMXPattern
+    : public OpRewritePattern<vector::ContractionOp> {
+  using OpRewritePattern<vector::ContractionOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(vector::ContractionOp op,
+                                PatternRewriter &rewriter) const override {
+    if (op.getKind() != vector::CombiningKind::ADD)
+      return rewriter.notifyMatchFailure(op, "Expect add combining kind");
+
+    auto maskableOp = cast<vector::MaskableOpInterface>(op.getOperation());
+    if (maskableOp.isMasked())
+      return rewriter.notifyMatchFailure(op, "Masked contractOp not supported");
+
+    MLIRContext *context = op.getContext();
+    AffineExpr b, m, n, k, vnni;
+    bindDims(context, b, m, n, k, vnni);
+    auto lhsMap = AffineMap::get(5, 0, {b, m, k, vnni}, context);
+    auto rhsMap = AffineMap::get(5, 0, {b, k, n, vnni}, context);
+    auto accMap = AffineMap::get(5, 0, {m, n}, context);
+    if (op.getIndexingMapsArray() !=
+        SmallVector<AffineMap>{lhsMap, rhsMap, accMap})
+      return rewriter.notifyMatchFailure(op, "Not a VNNI brgemm");
+
+    VectorType lhsType = op.getLhsType();
+    VectorType rhsType = op.getRhsType();
+    auto accType = dyn_cast<VectorType>(op.getAccType());
+    if (!accType)
+      return rewriter.notifyMatchFailure(op, "Expect a vector accumulator");
+    Type elementType = lhsType.getElementType();
+    Type accElementType = accType.getElementType();
+    bool isBF16 = elementType.isBF16() && accElementType.isF32();
+    bool isInt8 = elementType.isInteger(8) && accElementType.isInteger(32);
+    if (!isBF16 && !isInt8)
+      return rewriter.notifyMatchFailure(op, "Expect bf16 or int8 operands");
+
+    // A tile row of the rhs packs the VNNI factor of K.
+    int64_t vnniFactor = isBF16 ? 2 : 4;
+    int64_t M = lhsType.getDimSize(1);
+    int64_t kTiles = lhsType.getDimSize(2);
+    int64_t N = rhsType.getDimSize(2);
+    if (lhsType.getDimSize(0) != 1 || lhsType.getDimSize(3) != vnniFactor ||
+        rhsType.getDimSize(3) != vnniFactor)
+      return rewriter.notifyMatchFailure(op, "Expect a single VNNI batch");
+    if (!fitsInTile(M, kTiles * vnniFactor, elementType) ||
+        !fitsInTile(kTiles, N * vnniFactor, elementType) ||
+        !fitsInTile(M, N, accElementType))
+      return rewriter.notifyMatchFailure(op, "Does not fit in AMX tiles");
+
+    auto lhsRead = op.getLhs().getDefiningOp<vector::TransferReadOp>();
+    auto rhsRead = op.getRhs().getDefiningOp<vector::TransferReadOp>();
+    if (!isVnniTileRead(lhsRead) || !isVnniTileRead(rhsRead))
+      return rewriter.notifyMatchFailure(op, "Unsupported operand reads");
+
+    Location loc = op.getLoc();
+    Value c0 = rewriter.create<arith::ConstantIndexOp>(loc, 0);
+    auto loadTile = [&](vector::TransferReadOp readOp, int64_t rows,
+                        int64_t cols) -> Value {
+      Value rowsView = rewriter.create<memref::CollapseShapeOp>(
+          loc, readOp.getSource(), getTileReassociation());
+      return rewriter.create<amx::TileLoadOp>(
+          loc, VectorType::get({rows, cols}, elementType), rowsView,
+          ValueRange{c0, c0});
+    };
+    Value lhs = loadTile(lhsRead, M, kTiles * vnniFactor);
+    Value rhs = loadTile(rhsRead, kTiles, N * vnniFactor);
+    if (isBF16) {
+      rewriter.replaceOpWithNewOp<amx::TileMulFOp>(op, accType, lhs, rhs,
+                                                   op.getAcc());
+    } else {
+      rewriter.replaceOpWithNewOp<amx::TileMulIOp>(
+          op, accType, lhs, rhs, op.getAcc(), /*isZextLhs=*/UnitAttr(),
+          /*isZextRhs=*/UnitAttr());
+    }
+    return success();
+  }
+};
+
+// Keeps the accumulator of the AMX tile multiplications in a tile: the
+// transfer_read initializing it, possibly through the iter_args of the
+// reduction loops, and the transfer_write of the final value become tile
+// loads and stores.
+struct AccumulatorToTilePattern
+    : public OpRewritePattern<vector::TransferReadOp> {
+  using OpRewritePattern<vector::TransferReadOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(vector::TransferReadOp readOp,
+                                PatternRewriter &rewriter) const override {
+    if (!isTileRead(readOp) || !readOp->hasOneUse())
+      return failure();
+    VectorType vectorType = readOp.getVectorType();
+    if (!fitsInTile(vectorType.getDimSize(0), vectorType.getDimSize(1),
+                    vectorType.getElementType()))
+      return failure();
+
+    // Follow the accumulator down the loop nest to its multiplication and
+    // back up through the yields to its final value.
+    Value value = readOp.getResult();
+    SmallVector<scf::ForOp> loops;
+    OpOperand *use = &*value.getUses().begin();
+    while (auto forOp = dyn_cast<scf::ForOp>(use->getOwner())) {
+      BlockArgument iterArg = forOp.getTiedLoopRegionIterArg(use);
+      if (!iterArg || !iterArg.hasOneUse())
+        return failure();
+      loops.push_back(forOp);
+      use = &*iterArg.getUses().begin();
+    }
+    Operation *mulOp = use->getOwner();
+    if (!isa<amx::TileMulFOp, amx::TileMulIOp>(mulOp) ||
+        use->getOperandNumber() != 2 || !mulOp->hasOneUse())
+      return failure();
+
+    value = mulOp->getResult(0);
+    for (scf::ForOp forOp : llvm::reverse(loops)) {
+      OpOperand &yielded = *value.getUses().begin();
+      if (yielded.getOwner() != forOp.getBody()->getTerminator())
+        return failure();
+      value = forOp.getResult(yielded.getOperandNumber());
+      if (!value.hasOneUse())
+        return failure();
+    }
+    auto writeOp = dyn_cast<vector::TransferWriteOp>(
+        value.getUses().begin()->getOwner());
+    if (!writeOp || writeOp.getSource() != readOp.getSource() ||
+        writeOp.getMask() || writeOp.hasOutOfBoundsDim() ||
+        !writeOp.getPermutationMap().isMinorIdentity() ||
+        !llvm::all_of(writeOp.getIndices(), isZeroIndex))
+      return failure();
+
+    rewriter.setInsertionPoint(writeOp);
+    rewriter.replaceOpWithNewOp<amx::TileStoreOp>(
+        writeOp, writeOp.getSource(), writeOp.getIndices(), value);
+    rewriter.setInsertionPoint(readOp);
+    rewriter.replaceOpWithNewOp<amx::TileLoadOp>(
+        readOp, vectorType, readOp.getSource(), readOp.getIndices());
+    return success();
+  }
+};
+
+struct VectorContractToAMX
+    : public tpp::impl::VectorContractToAMXBase<VectorContractToAMX> {
+  using VectorContractToAMXBase::VectorContractToAMXBase;
+
+  void runOnOperation() override {
+    func::FuncOp funcOp = getOperation();
+    if (!CpuTargetInfo::get(funcOp, /*fromTargetArch=*/true).hasAmx)
+      return;
+
+    RewritePatternSet patterns(&getContext());
+    patterns.add<VectorContractToAMXPattern>(&getContext());
+    if (failed(applyPatternsAndFoldGreedily(funcOp, std::move(patterns))))
+      return signalPassFailure();
+
+    RewritePatternSet tilePatterns(&getContext());
+    tilePatterns.add<AccumulatorToTilePattern>(&getContext());
+    if (failed(applyPatternsAndFoldGreedily(funcOp, std::move(tilePatterns))))
+      return signalPassFailure();
+  }
+};
+
+} // namespace
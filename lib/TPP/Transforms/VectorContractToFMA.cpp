@@ -5,15 +5,20 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// This file implements lowering of vector contraction to vector fma.
+// This file implements lowering of vector contraction to vector fma, on
+// scalable SVE vectors where available, and, for bf16 contractions in VNNI
+// layout, to the AVX512-BF16 dot product.
 //
 //===----------------------------------------------------------------------===//
 
 #include "TPP/Transforms/Transforms.h"
+#include "TPP/Transforms/Utils/BlockingCostModel.h"
+#include "TPP/Transforms/Utils/VNNIUtils.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/Dialect/Tensor/IR/Tensor.h"
 #include "mlir/Dialect/Vector/IR/VectorOps.h"
+#include "mlir/Dialect/X86Vector/X86VectorDialect.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 
@@ -76,8 +81,69 @@ struct TransformationContext {
   scf::ForOp outermostLoop;
 };
 
+// Returns the transfer_read initializing the accumulator \p acc of \p op.
+// The accumulator must be carried by the iterargs of the two loops around the
+// contraction, these loops and their parent are recorded in \p ctx.
+static FailureOr<vector::TransferReadOp>
+getAccumulatorRead(Value acc, vector::ContractionOp op,
+                   TransformationContext &ctx) {
+  ctx.innerForOp = op->getParentOfType<scf::ForOp>();
+  if (!ctx.innerForOp)
+    return failure();
+  ctx.outerForOp = ctx.innerForOp->getParentOfType<scf::ForOp>();
+  if (!ctx.outerForOp)
+    return failure();
+  ctx.outermostLoop = ctx.outerForOp->getParentOfType<scf::ForOp>();
+  if (!ctx.outermostLoop)
+    return failure();
+
+  // Verify original inner loop has only one iterarg.
+  auto origIterArgs = ctx.innerForOp.getRegionIterArgs();
+  if (origIterArgs.size() != 1)
+    return failure();
+
+  // Verify chain, accumulator must be inner loop's iterarg.
+  auto bbArg = dyn_cast<BlockArgument>(acc);
+  if (!bbArg)
+    return failure();
+
+  // This block arg must be init arg, not induction variable.
+  if (bbArg.getOwner() != ctx.innerForOp.getBody() ||
+      bbArg.getArgNumber() == 0) {
+    return failure();
+  }
+
+  // This iterarg must be intialized by outer loop's iterarg.
+  auto innerInitValue = ctx.innerForOp.getInitArgs()[bbArg.getArgNumber() - 1];
+  auto outerBBArg = dyn_cast<BlockArgument>(innerInitValue);
+  if (!outerBBArg)
+    return failure();
+
+  // This block arg must be init arg, not induction variable.
+  if (outerBBArg.getOwner() != ctx.outerForOp.getBody() ||
+      outerBBArg.getArgNumber() == 0) {
+    return failure();
+  }
+
+  // Outer loop's iterarg initializer must be a TransferReadOp.
+  acc = ctx.outerForOp.getInitArgs()[outerBBArg.getArgNumber() - 1];
+
+  //  This must be defined by vector.transfer_read
+  auto accDefiningOp = acc.getDefiningOp<vector::TransferReadOp>();
+  if (!accDefiningOp)
+    return failure();
+  return accDefiningOp;
+}
+
 enum class MatMulType { Standard, Batch, BatchReduce };
 
+// Returns the buffer `subview` is a view of, through nested subviews.
+static Value getRootBuffer(Value subview) {
+  while (auto subviewOp = subview.getDefiningOp<memref::SubViewOp>())
+    subview = subviewOp.getSource();
+  return subview;
+}
+
 struct VectorContractToFMA
     : public tpp::impl::VectorContractToFMABase<VectorContractToFMA> {
 
@@ -92,8 +158,11 @@ private:
 struct VectorContractToFMAPattern
     : public OpRewritePattern<vector::ContractionOp> {
   using OpRewritePattern<vector::ContractionOp>::OpRewritePattern;
-  VectorContractToFMAPattern(MLIRContext *context, TransformationContext &ctx)
-      : OpRewritePattern<vector::ContractionOp>(context), ctx(ctx) {}
+  VectorContractToFMAPattern(MLIRContext *context, TransformationContext &ctx,
+                             const CpuTargetInfo &target,
+                             bool nontemporalStores)
+      : OpRewritePattern<vector::ContractionOp>(context), ctx(ctx),
+        target(target), nontemporalStores(nontemporalStores) {}
 
   LogicalResult matchAndRewrite(vector::ContractionOp op,
                                 PatternRewriter &rewriter) const override {
@@ -182,55 +251,10 @@ struct VectorContractToFMAPattern
 
     // Verify that the accumulator is coming through a chain of iterargs of
     // nested loop and it is define by 'TransferReadOp'.
-    ctx.innerForOp = op->getParentOfType<scf::ForOp>();
-    if (!ctx.innerForOp)
-      return failure();
-    ctx.outerForOp = ctx.innerForOp->getParentOfType<scf::ForOp>();
-    if (!ctx.outerForOp)
-      return failure();
-    ctx.outermostLoop = ctx.outerForOp->getParentOfType<scf::ForOp>();
-    if (!ctx.outermostLoop)
-      return failure();
-
-    // Verify original inner loop has only one iterarg.
-    auto origIterArgs = ctx.innerForOp.getRegionIterArgs();
-    if (origIterArgs.size() != 1)
-      return failure();
-
-    // Verify chain, accumulator must be inner loop's iterarg.
-    auto bbArg = dyn_cast<BlockArgument>(acc);
-    if (!bbArg)
-      return failure();
-
-    // This block arg must be init arg, not induction variable.
-    if (bbArg.getOwner() != ctx.innerForOp.getBody() ||
-        bbArg.getArgNumber() == 0) {
-      return failure();
-    }
-
-    // This iterarg must be intialized by outer loop's iterarg.
-    auto innerInitValue =
-        ctx.innerForOp.getInitArgs()[bbArg.getArgNumber() - 1];
-    auto outerBBArg = dyn_cast<BlockArgument>(innerInitValue);
-    if (!outerBBArg)
-      return failure();
-
-    // This block arg must be init arg, not induction variable.
-    if (outerBBArg.getOwner() != ctx.outerForOp.getBody() ||
-        outerBBArg.getArgNumber() == 0) {
-      return failure();
-    }
-
-    // Outer loop's iterarg initializer must be a TransferReadOp.
-    acc = ctx.outerForOp.getInitArgs()[outerBBArg.getArgNumber() - 1];
-
-    //  This must be defined by vector.transfer_read
-    if (!acc.getDefiningOp<vector::TransferReadOp>())
-      return failure();
-
-    accDefiningOp = acc.getDefiningOp<vector::TransferReadOp>();
-    if (!accDefiningOp)
+    auto maybeAccRead = getAccumulatorRead(acc, op, ctx);
+    if (failed(maybeAccRead))
       return failure();
+    accDefiningOp = *maybeAccRead;
 
     // Only 2-D output expected.
     auto accType = cast<ShapedType>(accDefiningOp.getType());
@@ -272,6 +296,12 @@ struct VectorContractToFMAPattern
       subview_2_splits.push_back(split);
     }
 
+    if (useScalableVectors(elementType, target)) {
+      rewriteToScalableFMA(rewriter, loc, lhsDefiningOp, rhsDefiningOp,
+                           subview_2_splits, N, elementType);
+      return success();
+    }
+
     // Intialize each accumulator with a vector of size N
     SmallVector<Value, 4> initAccs;
     for (auto subview : subview_2_splits) {
@@ -354,12 +384,18 @@ struct VectorContractToFMAPattern
         break;
     }
 
-    // Store final results back to original locations.
+    // Store final results back to original locations. These are the only
+    // writes of the tile, large outputs bypass the caches.
     if (writeOp) {
+      bool nontemporal =
+          nontemporalStores &&
+          isStreamingOutput(
+              cast<ShapedType>(getRootBuffer(accSubview).getType()), target);
       for (int i = 0; i < M; i++) {
-        rewriter.create<vector::StoreOp>(loc, newOuterForOp.getResult(i),
-                                         subview_2_splits[i],
-                                         ValueRange{c0, c0});
+        auto storeOp = rewriter.create<vector::StoreOp>(
+            loc, newOuterForOp.getResult(i), subview_2_splits[i],
+            ValueRange{c0, c0});
+        storeOp.setNontemporal(nontemporal);
       }
     }
 
@@ -370,6 +406,322 @@ struct VectorContractToFMAPattern
     return success();
   }
 
+private:
+  // Lowers to a loop over N in steps of the scalable vector length, around
+  // clones of the reduction loops that carry one vector per row of the
+  // accumulator. The accesses of the last step are masked when N is not a
+  // multiple of the vector length.
+  void rewriteToScalableFMA(PatternRewriter &rewriter, Location loc,
+                            vector::TransferReadOp lhsDefiningOp,
+                            vector::TransferReadOp rhsDefiningOp,
+                            ArrayRef<Value> accRows, int64_t N,
+                            Type elementType) const {
+    // SVE vectors are a multiple of 128 bits.
+    int64_t minLanes = 128 / elementType.getIntOrFloatBitWidth();
+    auto vecType = VectorType::get({minLanes}, elementType,
+                                   /*scalableDims=*/{true});
+    auto maskType = VectorType::get({minLanes}, rewriter.getI1Type(),
+                                    /*scalableDims=*/{true});
+
+    Value c0 = rewriter.create<arith::ConstantIndexOp>(loc, 0);
+    Value cN = rewriter.create<arith::ConstantIndexOp>(loc, N);
+    Value vscale =
+        rewriter.create<vector::VectorScaleOp>(loc, rewriter.getIndexType());
+    Value step = rewriter.create<arith::MulIOp>(
+        loc, vscale, rewriter.create<arith::ConstantIndexOp>(loc, minLanes));
+    Value zero = rewriter.create<arith::ConstantOp>(
+        loc, vecType, rewriter.getZeroAttr(vecType));
+
+    rewriter.create<scf::ForOp>(
+        loc, c0, cN, step, ValueRange{},
+        [&](OpBuilder &builder, Location loc, Value col, ValueRange) {
+          Value remaining = builder.create<arith::SubIOp>(loc, cN, col);
+          Value mask =
+              builder.create<vector::CreateMaskOp>(loc, maskType, remaining);
+          SmallVector<Value> initAccs;
+          for (Value row : accRows) {
+            initAccs.push_back(builder.create<vector::MaskedLoadOp>(
+                loc, vecType, row, ValueRange{c0, col}, mask, zero));
+          }
+
+          auto newOuterForOp = builder.create<scf::ForOp>(
+              loc, ctx.outerForOp.getLowerBound(),
+              ctx.outerForOp.getUpperBound(), ctx.outerForOp.getStep(),
+              initAccs,
+              [&](OpBuilder &nestedBuilder, Location loc, Value iv,
+                  ValueRange iterArgs) {
+                auto newInnerForOp = nestedBuilder.create<scf::ForOp>(
+                    loc, ctx.innerForOp.getLowerBound(),
+                    ctx.innerForOp.getUpperBound(), ctx.innerForOp.getStep(),
+                    iterArgs,
+                    [&](OpBuilder &innerBuilder, Location loc, Value innerIv,
+                        ValueRange innerIterArgs) {
+                      Operation *lhsSubview =
+                          lhsDefiningOp.getSource().getDefiningOp();
+                      IRMapping mapping;
+                      mapping.map(lhsSubview->getOperand(1), iv);
+                      mapping.map(lhsSubview->getOperand(3), innerIv);
+                      auto lhsClone = innerBuilder.clone(*lhsSubview, mapping);
+
+                      Operation *rhsSubview =
+                          rhsDefiningOp.getSource().getDefiningOp();
+                      IRMapping rhsMapping;
+                      rhsMapping.map(rhsSubview->getOperand(1), iv);
+                      rhsMapping.map(rhsSubview->getOperand(2), innerIv);
+                      auto rhsClone =
+                          innerBuilder.clone(*rhsSubview, rhsMapping);
+                      Value rowVec = innerBuilder.create<vector::MaskedLoadOp>(
+                          loc, vecType, rhsClone->getResult(0),
+                          ValueRange{c0, c0, col}, mask, zero);
+
+                      SmallVector<Value> results;
+                      for (auto [i, acc] : llvm::enumerate(innerIterArgs)) {
+                        Value row =
+                            innerBuilder.create<arith::ConstantIndexOp>(loc, i);
+                        Value elem = innerBuilder.create<memref::LoadOp>(
+                            loc, lhsClone->getResult(0),
+                            ValueRange{c0, row, c0});
+                        Value bcast = innerBuilder.create<vector::BroadcastOp>(
+                            loc, vecType, elem);
+                        results.push_back(innerBuilder.create<vector::FMAOp>(
+                            loc, bcast, rowVec, acc));
+                      }
+                      innerBuilder.create<scf::YieldOp>(loc, results);
+                    });
+                nestedBuilder.create<scf::YieldOp>(loc,
+                                                   newInnerForOp.getResults());
+              });
+
+          for (auto [row, acc] :
+               llvm::zip_equal(accRows, newOuterForOp.getResults())) {
+            builder.create<vector::MaskedStoreOp>(loc, row, ValueRange{c0, col},
+                                                  mask, acc);
+          }
+          builder.create<scf::YieldOp>(loc);
+        });
+
+    // The final values are stored by the loop, the original write is dead.
+    for (Operation *user : ctx.outerForOp.getResult(0).getUsers()) {
+      if (isa<vector::TransferWriteOp>(user)) {
+        rewriter.eraseOp(user);
+        break;
+      }
+    }
+  }
+
+  TransformationContext &ctx;
+  CpuTargetInfo target;
+  bool nontemporalStores;
+};
+
+// Lowers a bf16 batch-reduce contraction in VNNI layout with an f32
+// accumulator to AVX512-BF16 dot products (vdpbf16ps). Each step of the
+// reduction loops handles one VNNI pair: the M pairs of the lhs are
+// broadcast and multiplied with the contiguous pairs of the rhs row.
+struct VectorContractToBF16DotPattern
+    : public OpRewritePattern<vector::ContractionOp> {
+  using OpRewritePattern<vector::ContractionOp>::OpRewritePattern;
+  VectorContractToBF16DotPattern(MLIRContext *context,
+                                 TransformationContext &ctx)
+      : OpRewritePattern<vector::ContractionOp>(context), ctx(ctx) {}
+
+  LogicalResult matchAndRewrite(vector::ContractionOp op,
+                                PatternRewriter &rewriter) const override {
+    if (op.getKind() != vector::CombiningKind::ADD)
+      return rewriter.notifyMatchFailure(
+          op, "Unsupported combining kind, only supports ADD at the moment)");
+
+    auto maskableOp = cast<vector::MaskableOpInterface>(op.getOperation());
+    if (maskableOp.isMasked())
+      return rewriter.notifyMatchFailure(op, "Masked contractOp not supported");
+
+    // Expect a batch-reduce gemm with the VNNI dimension as innermost
+    // reduction: lhs (b, m, k, vnni), rhs (b, k, n, vnni) and acc (m, n).
+    MLIRContext *context = op.getContext();
+    AffineExpr b, m, n, k, vnni;
+    bindDims(context, b, m, n, k, vnni);
+    auto lhsMap = AffineMap::get(5, 0, {b, m, k, vnni}, context);
+    auto rhsMap = AffineMap::get(5, 0, {b, k, n, vnni}, context);
+    auto accMap = AffineMap::get(5, 0, {m, n}, context);
+    if (op.getIndexingMapsArray() !=
+        SmallVector<AffineMap>{lhsMap, rhsMap, accMap})
+      return rewriter.notifyMatchFailure(op, "Not a VNNI brgemm");
+
+    auto lhsDefiningOp = op.getLhs().getDefiningOp<vector::TransferReadOp>();
+    auto rhsDefiningOp = op.getRhs().getDefiningOp<vector::TransferReadOp>();
+    if (!lhsDefiningOp || !rhsDefiningOp)
+      return failure();
+    if (!llvm::all_of(lhsDefiningOp.getIndices(), isZeroIndex) ||
+        !llvm::all_of(rhsDefiningOp.getIndices(), isZeroIndex))
+      return failure();
+
+    // The operands are cloned per iteration with the loop induction variables
+    // as offsets, see below.
+    auto lhsSubview =
+        lhsDefiningOp.getSource().getDefiningOp<memref::SubViewOp>();
+    auto rhsSubview =
+        rhsDefiningOp.getSource().getDefiningOp<memref::SubViewOp>();
+    if (!lhsSubview || !rhsSubview || lhsSubview.getOffsets().size() < 3 ||
+        rhsSubview.getOffsets().size() < 2)
+      return failure();
+
+    // vdpbf16ps multiplies pairs of bf16 and accumulates into f32.
+    auto lhsType = lhsDefiningOp.getVectorType();
+    auto rhsType = rhsDefiningOp.getVectorType();
+    if (!lhsType.getElementType().isBF16() ||
+        !rhsType.getElementType().isBF16())
+      return rewriter.notifyMatchFailure(op, "Expect bf16 operands");
+    if (!vnni::utils::hasX86DotProduct(lhsType))
+      return rewriter.notifyMatchFailure(op, "No bf16 dot product on target");
+
+    int64_t M = lhsType.getDimSize(1);
+    int64_t N = rhsType.getDimSize(2);
+    if (lhsType.getDimSize(0) != 1 || lhsType.getDimSize(2) != 1 ||
+        lhsType.getDimSize(3) != 2 || rhsType.getDimSize(0) != 1 ||
+        rhsType.getDimSize(1) != 1 || rhsType.getDimSize(3) != 2)
+      return rewriter.notifyMatchFailure(op, "Expect a single VNNI pair of K");
+
+    auto maybeAccRead = getAccumulatorRead(op.getAcc(), op, ctx);
+    if (failed(maybeAccRead))
+      return failure();
+    vector::TransferReadOp accDefiningOp = *maybeAccRead;
+    auto accType = accDefiningOp.getVectorType();
+    if (!accType.getElementType().isF32() ||
+        accType.getShape() != ArrayRef<int64_t>{M, N})
+      return rewriter.notifyMatchFailure(op, "Expect an MxN f32 accumulator");
+
+    // The dot product works on 128, 256 or 512-bit accumulators, split N in
+    // the widest that divides it.
+    int64_t vecLen = 0;
+    for (int64_t len : {16, 8, 4}) {
+      if (N % len == 0) {
+        vecLen = len;
+        break;
+      }
+    }
+    if (vecLen == 0)
+      return rewriter.notifyMatchFailure(op, "N not a multiple of 4");
+    int64_t numChunks = N / vecLen;
+
+    Location loc = op.getLoc();
+    Value accSubview = accDefiningOp.getSource();
+    auto accVecType = VectorType::get({vecLen}, rewriter.getF32Type());
+    auto bf16VecType = VectorType::get({2 * vecLen}, rewriter.getBF16Type());
+    auto pairVecType = VectorType::get({2}, rewriter.getBF16Type());
+    auto i32VecType = VectorType::get({1}, rewriter.getI32Type());
+    auto i32BcastType = VectorType::get({vecLen}, rewriter.getI32Type());
+
+    rewriter.setInsertionPoint(
+        ctx.outermostLoop.getBody(),
+        std::prev(ctx.outermostLoop.getBody()->end(), 1));
+
+    // Create M different <1xN> subviews and load them by chunks.
+    Value c0 = rewriter.create<arith::ConstantIndexOp>(loc, 0);
+    SmallVector<OpFoldResult> sizes = {rewriter.getIndexAttr(1),
+                                       rewriter.getIndexAttr(N)};
+    SmallVector<OpFoldResult> strides = {rewriter.getIndexAttr(1),
+                                         rewriter.getIndexAttr(1)};
+    SmallVector<Value> accRows;
+    SmallVector<Value> initAccs;
+    for (int64_t i = 0; i < M; i++) {
+      SmallVector<OpFoldResult> offsets = {rewriter.getIndexAttr(i),
+                                           rewriter.getIndexAttr(0)};
+      Value row = rewriter.create<memref::SubViewOp>(loc, accSubview, offsets,
+                                                     sizes, strides);
+      accRows.push_back(row);
+      for (int64_t j = 0; j < numChunks; j++) {
+        Value col = rewriter.create<arith::ConstantIndexOp>(loc, j * vecLen);
+        initAccs.push_back(rewriter.create<vector::LoadOp>(
+            loc, accVecType, row, ValueRange{c0, col}));
+      }
+    }
+
+    auto newOuterForOp = rewriter.create<scf::ForOp>(
+        loc, ctx.outerForOp.getLowerBound(), ctx.outerForOp.getUpperBound(),
+        ctx.outerForOp.getStep(), initAccs,
+        [&](OpBuilder &nestedBuilder, Location loc, Value iv,
+            ValueRange iterArgs) {
+          auto newInnerForOp = nestedBuilder.create<scf::ForOp>(
+              loc, ctx.innerForOp.getLowerBound(),
+              ctx.innerForOp.getUpperBound(), ctx.innerForOp.getStep(),
+              iterArgs,
+              [&](OpBuilder &innerBuilder, Location loc, Value innerIv,
+                  ValueRange innerIterArgs) {
+                IRMapping mapping;
+                mapping.map(lhsSubview->getOperand(1), iv);
+                mapping.map(lhsSubview->getOperand(3), innerIv);
+                Value lhsClone =
+                    innerBuilder.clone(*lhsSubview, mapping)->getResult(0);
+
+                // Broadcast each VNNI pair of the lhs as a single i32.
+                SmallVector<Value> broadcasts;
+                for (int64_t i = 0; i < M; i++) {
+                  Value row =
+                      innerBuilder.create<arith::ConstantIndexOp>(loc, i);
+                  Value pair = innerBuilder.create<vector::LoadOp>(
+                      loc, pairVecType, lhsClone, ValueRange{c0, row, c0, c0});
+                  Value packed = innerBuilder.create<vector::BitCastOp>(
+                      loc, i32VecType, pair);
+                  Value bcast = innerBuilder.create<vector::BroadcastOp>(
+                      loc, i32BcastType, packed);
+                  broadcasts.push_back(innerBuilder.create<vector::BitCastOp>(
+                      loc, bf16VecType, bcast));
+                }
+
+                // The pairs of the rhs row are contiguous, read them as
+                // a flat vector.
+                IRMapping rhsMapping;
+                rhsMapping.map(rhsSubview->getOperand(1), iv);
+                rhsMapping.map(rhsSubview->getOperand(2), innerIv);
+                Value rhsClone =
+                    innerBuilder.clone(*rhsSubview, rhsMapping)->getResult(0);
+                Value rhsRow = innerBuilder.create<memref::CollapseShapeOp>(
+                    loc, rhsClone,
+                    SmallVector<ReassociationIndices>{{0}, {1}, {2, 3}});
+                SmallVector<Value> rhsVecs;
+                for (int64_t j = 0; j < numChunks; j++) {
+                  Value col = innerBuilder.create<arith::ConstantIndexOp>(
+                      loc, j * 2 * vecLen);
+                  rhsVecs.push_back(innerBuilder.create<vector::LoadOp>(
+                      loc, bf16VecType, rhsRow, ValueRange{c0, c0, col}));
+                }
+
+                SmallVector<Value> results;
+                for (int64_t i = 0; i < M; i++) {
+                  for (int64_t j = 0; j < numChunks; j++) {
+                    results.push_back(innerBuilder.create<x86vector::DotBF16Op>(
+                        loc, accVecType, innerIterArgs[i * numChunks + j],
+                        broadcasts[i], rhsVecs[j]));
+                  }
+                }
+                innerBuilder.create<scf::YieldOp>(loc, results);
+              });
+          nestedBuilder.create<scf::YieldOp>(loc, newInnerForOp.getResults());
+        });
+
+    vector::TransferWriteOp writeOp;
+    for (Operation *user : ctx.outerForOp.getResult(0).getUsers()) {
+      writeOp = dyn_cast<vector::TransferWriteOp>(user);
+      if (writeOp)
+        break;
+    }
+
+    // Store final results back to original locations and erase the write.
+    if (writeOp) {
+      for (int64_t i = 0; i < M; i++) {
+        for (int64_t j = 0; j < numChunks; j++) {
+          Value col = rewriter.create<arith::ConstantIndexOp>(loc, j * vecLen);
+          rewriter.create<vector::StoreOp>(
+              loc, newOuterForOp.getResult(i * numChunks + j), accRows[i],
+              ValueRange{c0, col});
+        }
+      }
+      rewriter.eraseOp(writeOp);
+    }
+
+    return success();
+  }
+
 private:
   TransformationContext &ctx;
 };
@@ -379,7 +731,10 @@ void VectorContractToFMA::runOnOperation() {
   MLIRContext *context = &getContext();
 
   RewritePatternSet patterns(context);
-  patterns.add<VectorContractToFMAPattern>(context, ctx);
+  patterns.add<VectorContractToFMAPattern>(
+      context, ctx, CpuTargetInfo::get(funcOp, /*fromTargetArch=*/true),
+      nontemporalStores);
+  patterns.add<VectorContractToBF16DotPattern>(context, ctx);
 
   if (failed(applyPatternsAndFoldGreedily(funcOp, std::move(patterns)))) {
     signalPassFailure();
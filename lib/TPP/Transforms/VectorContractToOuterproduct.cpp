@@ -5,13 +5,18 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// This file implements lowering of vector contraction to vector outerproduct.
+// This file implements lowering of vector contraction to vector outerproduct,
+// and to scalable outer products for SME.
 //
 //===----------------------------------------------------------------------===//
 
 #include "TPP/Transforms/Transforms.h"
+#include "TPP/Transforms/Utils/BlockingCostModel.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/SCF/Utils/Utils.h"
 #include "mlir/Dialect/Tensor/IR/Tensor.h"
 #include "mlir/Dialect/Vector/IR/VectorOps.h"
 #include "mlir/Dialect/Vector/Transforms/LoweringPatterns.h"
@@ -80,47 +85,60 @@ namespace tpp {
 // Enum to represent the type of matmul operation
 enum class MatMulType { Standard, Batch, BatchReduce };
 
+// Returns the variant of matrix multiply of `contractOp`, setting
+// `outerDimIndex` to the position of its m dimension.
+static FailureOr<MatMulType> getMatMulType(vector::ContractionOp contractOp,
+                                           PatternRewriter &rewriter,
+                                           unsigned &outerDimIndex) {
+  if (contractOp.getKind() != vector::CombiningKind::ADD)
+    return rewriter.notifyMatchFailure(
+        contractOp,
+        "Unsupported combining kind, only supports ADD at the moment)");
+
+  SmallVector<AffineMap, 3> maps = contractOp.getIndexingMapsArray();
+  if (llvm::any_of(
+          maps, [](AffineMap map) { return !map.isProjectedPermutation(); }))
+    return rewriter.notifyMatchFailure(contractOp, "Unexpected map");
+
+  // Check for the variant of matrix multiply.
+  auto iteratorTypes = contractOp.getIteratorTypesArray();
+  MatMulType matmulType;
+  outerDimIndex = 0;
+  if (iteratorTypes.size() > 3) {
+    outerDimIndex = iteratorTypes.size() - 4;
+    matmulType = iteratorTypes[outerDimIndex] == vector::IteratorType::parallel
+                     ? MatMulType::Batch
+                     : MatMulType::BatchReduce;
+    outerDimIndex++;
+  } else if (iteratorTypes.size() == 3) {
+    matmulType = MatMulType::Standard;
+  } else {
+    return rewriter.notifyMatchFailure(contractOp, "Not a gemm");
+  }
+
+  if (matmulType == MatMulType::Batch)
+    return rewriter.notifyMatchFailure(contractOp,
+                                       "Batch matmul not supported");
+  if (iteratorTypes[outerDimIndex] != vector::IteratorType::parallel ||
+      iteratorTypes[outerDimIndex + 1] != vector::IteratorType::parallel ||
+      iteratorTypes[outerDimIndex + 2] != vector::IteratorType::reduction)
+    return rewriter.notifyMatchFailure(contractOp, "Not a gemm");
+  return matmulType;
+}
+
 struct VectorContractToOuterproductPattern
     : public OpRewritePattern<vector::ContractionOp> {
   using OpRewritePattern<vector::ContractionOp>::OpRewritePattern;
 
   LogicalResult matchAndRewrite(vector::ContractionOp contractOp,
                                 PatternRewriter &rewriter) const override {
-
-    if (contractOp.getKind() != vector::CombiningKind::ADD)
-      return rewriter.notifyMatchFailure(
-          contractOp,
-          "Unsupported combining kind, only supports ADD at the moment)");
-
+    unsigned outerDimIndex;
+    FailureOr<MatMulType> maybeMatmulType =
+        getMatMulType(contractOp, rewriter, outerDimIndex);
+    if (failed(maybeMatmulType))
+      return failure();
+    MatMulType matmulType = *maybeMatmulType;
     SmallVector<AffineMap, 3> maps = contractOp.getIndexingMapsArray();
-    if (llvm::any_of(
-            maps, [](AffineMap map) { return !map.isProjectedPermutation(); }))
-      return rewriter.notifyMatchFailure(contractOp, "Unexpected map");
-
-    // Check for the variant of matrix multiply.
-    auto iteratorTypes = contractOp.getIteratorTypesArray();
-    MatMulType matmulType;
-    unsigned outerDimIndex = 0;
-    if (iteratorTypes.size() > 3) {
-      outerDimIndex = iteratorTypes.size() - 4;
-      matmulType =
-          iteratorTypes[outerDimIndex] == vector::IteratorType::parallel
-              ? MatMulType::Batch
-              : MatMulType::BatchReduce;
-      outerDimIndex++;
-    } else if (iteratorTypes.size() == 3) {
-      matmulType = MatMulType::Standard;
-    } else {
-      return rewriter.notifyMatchFailure(contractOp, "Not a gemm");
-    }
-
-    if (matmulType == MatMulType::Batch)
-      return rewriter.notifyMatchFailure(contractOp,
-                                         "Batch matmul not supported");
-    if (iteratorTypes[outerDimIndex] != vector::IteratorType::parallel ||
-        iteratorTypes[outerDimIndex + 1] != vector::IteratorType::parallel ||
-        iteratorTypes[outerDimIndex + 2] != vector::IteratorType::reduction)
-      return rewriter.notifyMatchFailure(contractOp, "Not a gemm");
 
     Value acc = contractOp.getAcc();
     // Find the original tensor operands
@@ -260,6 +278,186 @@ struct VectorContractToOuterproductPattern
   }
 };
 
+// Returns true if `readOp` reads a memref from its origin without mask.
+static bool isWholeMemRefRead(vector::TransferReadOp readOp) {
+  return readOp && !readOp.getMask() &&
+         isa<MemRefType>(readOp.getShapedType()) &&
+         llvm::all_of(readOp.getIndices(), isZeroIndex);
+}
+
+// Lowers a f32 contraction whose accumulator is read from a memref and
+// written back to it to scalable outer products. The output is walked in
+// blocks of vector<[8]x[8]xf32>, i.e. 2x2 of the f32 ZA tiles, and each block
+// accumulates one outer product of a lhs column and a rhs row per k. The
+// edges of the output are masked, so that the block does not need to divide
+// the output.
+struct VectorContractToSMEPattern
+    : public OpRewritePattern<vector::ContractionOp> {
+  using OpRewritePattern<vector::ContractionOp>::OpRewritePattern;
+
+  // A f32 ZA tile has vscale * 4 rows and columns, a block spans two.
+  static constexpr int64_t kBlockLanes = 8;
+
+  LogicalResult matchAndRewrite(vector::ContractionOp contractOp,
+                                PatternRewriter &rewriter) const override {
+    auto maskableOp =
+        cast<vector::MaskableOpInterface>(contractOp.getOperation());
+    if (maskableOp.isMasked())
+      return rewriter.notifyMatchFailure(contractOp,
+                                         "Masked contractOp not supported");
+
+    unsigned outerDimIndex;
+    FailureOr<MatMulType> matmulType =
+        getMatMulType(contractOp, rewriter, outerDimIndex);
+    if (failed(matmulType))
+      return failure();
+
+    auto lhsRead = contractOp.getLhs().getDefiningOp<vector::TransferReadOp>();
+    auto rhsRead = contractOp.getRhs().getDefiningOp<vector::TransferReadOp>();
+    auto accRead = contractOp.getAcc().getDefiningOp<vector::TransferReadOp>();
+    if (!isWholeMemRefRead(lhsRead) || !isWholeMemRefRead(rhsRead) ||
+        !isWholeMemRefRead(accRead))
+      return rewriter.notifyMatchFailure(contractOp, "Unsupported reads");
+
+    auto lhsType = cast<ShapedType>(lhsRead.getType());
+    auto rhsType = cast<ShapedType>(rhsRead.getType());
+    auto accType = cast<ShapedType>(accRead.getType());
+    if (!lhsType.getElementType().isF32() ||
+        !rhsType.getElementType().isF32() || !accType.getElementType().isF32())
+      return rewriter.notifyMatchFailure(contractOp, "Expect f32 operands");
+    int64_t rank = *matmulType == MatMulType::BatchReduce ? 3 : 2;
+    if (lhsType.getRank() != rank || rhsType.getRank() != rank ||
+        accType.getRank() != 2)
+      return failure();
+
+    // Only non-transposed operands, (b, m, k) x (b, k, n) -> (m, n).
+    MLIRContext *context = contractOp.getContext();
+    unsigned numDims = rank + 1;
+    AffineExpr m = getAffineDimExpr(numDims - 3, context);
+    AffineExpr n = getAffineDimExpr(numDims - 2, context);
+    AffineExpr k = getAffineDimExpr(numDims - 1, context);
+    SmallVector<AffineExpr> lhsExprs = {m, k};
+    SmallVector<AffineExpr> rhsExprs = {k, n};
+    if (*matmulType == MatMulType::BatchReduce) {
+      lhsExprs.insert(lhsExprs.begin(), getAffineDimExpr(0, context));
+      rhsExprs.insert(rhsExprs.begin(), getAffineDimExpr(0, context));
+    }
+    if (contractOp.getIndexingMapsArray() !=
+        SmallVector<AffineMap>{AffineMap::get(numDims, 0, lhsExprs, context),
+                               AffineMap::get(numDims, 0, rhsExprs, context),
+                               AffineMap::get(numDims, 0, {m, n}, context)})
+      return rewriter.notifyMatchFailure(
+          contractOp, "Transposed matrices are not expected");
+
+    // The result must be written back to where the accumulator comes from.
+    if (!accRead->hasOneUse() || !contractOp->hasOneUse())
+      return failure();
+    auto writeOp =
+        dyn_cast<vector::TransferWriteOp>(*contractOp->getUsers().begin());
+    if (!writeOp || writeOp.getMask() ||
+        writeOp.getSource() != accRead.getSource() ||
+        !llvm::all_of(writeOp.getIndices(), isZeroIndex))
+      return rewriter.notifyMatchFailure(contractOp, "Unsupported write");
+
+    Location loc = contractOp.getLoc();
+    Type f32 = rewriter.getF32Type();
+    auto blockType =
+        VectorType::get({kBlockLanes, kBlockLanes}, f32, {true, true});
+    auto blockMaskType = VectorType::get({kBlockLanes, kBlockLanes},
+                                         rewriter.getI1Type(), {true, true});
+    auto sliceType = VectorType::get({kBlockLanes}, f32, {true});
+    auto sliceMaskType =
+        VectorType::get({kBlockLanes}, rewriter.getI1Type(), {true});
+
+    Value c0 = rewriter.create<arith::ConstantIndexOp>(loc, 0);
+    Value c1 = rewriter.create<arith::ConstantIndexOp>(loc, 1);
+    Value cM = rewriter.create<arith::ConstantIndexOp>(
+        loc, accType.getDimSize(0));
+    Value cN = rewriter.create<arith::ConstantIndexOp>(
+        loc, accType.getDimSize(1));
+    Value cK = rewriter.create<arith::ConstantIndexOp>(
+        loc, lhsType.getDimSize(rank - 1));
+    Value f0 = rewriter.create<arith::ConstantFloatOp>(
+        loc, APFloat::getZero(APFloat::IEEEsingle()), rewriter.getF32Type());
+    Value vscale =
+        rewriter.create<vector::VectorScaleOp>(loc, rewriter.getIndexType());
+    Value step = rewriter.create<arith::MulIOp>(
+        loc, vscale, rewriter.create<arith::ConstantIndexOp>(loc, kBlockLanes));
+
+    // Reduction loops over the batch, if any, and over k.
+    SmallVector<Value> lbs = {c0};
+    SmallVector<Value> ubs = {cK};
+    SmallVector<Value> steps = {c1};
+    if (*matmulType == MatMulType::BatchReduce) {
+      lbs.push_back(c0);
+      ubs.insert(ubs.begin(), rewriter.create<arith::ConstantIndexOp>(
+                                  loc, lhsType.getDimSize(0)));
+      steps.push_back(c1);
+    }
+
+    // The lhs is read along its m dimension, the rhs along its n dimension.
+    auto lhsMap = AffineMapAttr::get(
+        AffineMap::get(rank, 0, getAffineDimExpr(rank - 2, context)));
+    auto rhsMap = AffineMapAttr::get(
+        AffineMap::get(rank, 0, getAffineDimExpr(rank - 1, context)));
+    auto accMap =
+        AffineMapAttr::get(AffineMap::getMultiDimIdentityMap(2, context));
+    ArrayAttr sliceInBounds = rewriter.getBoolArrayAttr({false});
+    ArrayAttr blockInBounds = rewriter.getBoolArrayAttr({false, false});
+
+    Value accBuffer = accRead.getSource();
+    scf::buildLoopNest(
+        rewriter, loc, {c0, c0}, {cM, cN}, {step, step},
+        [&](OpBuilder &builder, Location loc, ValueRange ivs) {
+          Value m0 = ivs[0];
+          Value n0 = ivs[1];
+          Value remM = builder.create<arith::SubIOp>(loc, cM, m0);
+          Value remN = builder.create<arith::SubIOp>(loc, cN, n0);
+          Value blockMask = builder.create<vector::CreateMaskOp>(
+              loc, blockMaskType, ValueRange{remM, remN});
+          Value lhsMask =
+              builder.create<vector::CreateMaskOp>(loc, sliceMaskType, remM);
+          Value rhsMask =
+              builder.create<vector::CreateMaskOp>(loc, sliceMaskType, remN);
+          Value block = builder.create<vector::TransferReadOp>(
+              loc, blockType, accBuffer, ValueRange{m0, n0}, accMap, f0,
+              blockMask, blockInBounds);
+
+          scf::LoopNest reduction = scf::buildLoopNest(
+              builder, loc, lbs, ubs, steps, ValueRange{block},
+              [&](OpBuilder &nestedBuilder, Location loc, ValueRange redIvs,
+                  ValueRange iterArgs) -> scf::ValueVector {
+                Value k = redIvs.back();
+                SmallVector<Value> lhsIndices =
+                    llvm::to_vector(redIvs.drop_back());
+                lhsIndices.append({m0, k});
+                SmallVector<Value> rhsIndices =
+                    llvm::to_vector(redIvs.drop_back());
+                rhsIndices.append({k, n0});
+                Value lhsSlice = nestedBuilder.create<vector::TransferReadOp>(
+                    loc, sliceType, lhsRead.getSource(), lhsIndices, lhsMap,
+                    f0, lhsMask, sliceInBounds);
+                Value rhsSlice = nestedBuilder.create<vector::TransferReadOp>(
+                    loc, sliceType, rhsRead.getSource(), rhsIndices, rhsMap,
+                    f0, rhsMask, sliceInBounds);
+                Value outerProduct =
+                    nestedBuilder.create<vector::OuterProductOp>(
+                        loc, blockType, lhsSlice, rhsSlice, iterArgs[0],
+                        vector::CombiningKind::ADD);
+                return {outerProduct};
+              });
+
+          builder.create<vector::TransferWriteOp>(
+              loc, reduction.results[0], accBuffer, ValueRange{m0, n0},
+              accMap, blockMask, blockInBounds);
+        });
+
+    rewriter.eraseOp(writeOp);
+    rewriter.eraseOp(contractOp);
+    return success();
+  }
+};
+
 struct VectorContractToOuterproduct
     : public tpp::impl::VectorContractToOuterproductBase<
           VectorContractToOuterproduct> {
@@ -271,7 +469,13 @@ struct VectorContractToOuterproduct
     MLIRContext *context = &getContext();
 
     RewritePatternSet patterns(context);
-    patterns.add<VectorContractToOuterproductPattern>(context);
+    if (sme) {
+      if (!CpuTargetInfo::get(funcOp, /*fromTargetArch=*/true).hasSme)
+        return;
+      patterns.add<VectorContractToSMEPattern>(context);
+    } else {
+      patterns.add<VectorContractToOuterproductPattern>(context);
+    }
 
     if (failed(applyPatternsAndFoldGreedily(funcOp, std::move(patterns)))) {
       signalPassFailure();
@@ -0,0 +1,275 @@
+//===- WinogradConv2D.cpp ----------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the rewrite of the 3x3 stride-1 convolutions with the
+// Winograd F(2x2, 3x3) algorithm.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TPP/Passes.h"
+#include "TPP/Transforms/Utils/TransformUtils.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "mlir/Dialect/Tensor/IR/Tensor.h"
+#include "mlir/IR/Matchers.h"
+#include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+#include "llvm/Support/Debug.h"
+
+namespace mlir {
+namespace tpp {
+#define GEN_PASS_DEF_WINOGRADCONV2D
+#include "TPP/Passes.h.inc"
+} // namespace tpp
+} // namespace mlir
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+#define DEBUG_TYPE "winograd-conv2d"
+
+namespace {
+
+// F(2x2, 3x3): each 4x4 tile of the image gives a 2x2 tile of the output.
+constexpr int64_t kTile = 4;
+constexpr int64_t kOutTile = 2;
+constexpr int64_t kFilter = 3;
+
+// Filter transform G, input transform B^T and output transform A^T.
+constexpr float kG[kTile][kFilter] = {
+    {1.0f, 0.0f, 0.0f},
+    {0.5f, 0.5f, 0.5f},
+    {0.5f, -0.5f, 0.5f},
+    {0.0f, 0.0f, 1.0f}};
+constexpr float kBT[kTile][kTile] = {{1.0f, 0.0f, -1.0f, 0.0f},
+                                     {0.0f, 1.0f, 1.0f, 0.0f},
+                                     {0.0f, -1.0f, 1.0f, 0.0f},
+                                     {0.0f, 1.0f, 0.0f, -1.0f}};
+constexpr float kAT[kOutTile][kTile] = {{1.0f, 1.0f, 1.0f, 0.0f},
+                                        {0.0f, 1.0f, -1.0f, -1.0f}};
+
+template <int64_t Rows, int64_t Cols>
+static Value getMatrix(OpBuilder &builder, Location loc,
+                       const float (&matrix)[Rows][Cols]) {
+  auto type = RankedTensorType::get({Rows, Cols}, builder.getF32Type());
+  SmallVector<float> values;
+  for (const auto &row : matrix)
+    values.append(std::begin(row), std::end(row));
+  return builder.create<arith::ConstantOp>(
+      loc, type, DenseElementsAttr::get(type, ArrayRef<float>(values)));
+}
+
+// Return a zero tensor of `shape`.
+static Value getZeros(OpBuilder &builder, Location loc,
+                      ArrayRef<int64_t> shape) {
+  Type f32 = builder.getF32Type();
+  Value empty = builder.create<tensor::EmptyOp>(loc, shape, f32);
+  Value zero =
+      builder.create<arith::ConstantOp>(loc, builder.getZeroAttr(f32));
+  return builder.create<linalg::FillOp>(loc, zero, empty).getResult(0);
+}
+
+// Return a transform of a tile, `init` += `lhs` * `tile` * `rhs`, summed over
+// the last `numReductions` loops.
+static Value createTransform(OpBuilder &builder, Location loc, Value lhs,
+                             Value tile, Value rhs, Value init,
+                             ArrayRef<AffineMap> maps, int64_t numReductions) {
+  int64_t numLoops = maps.front().getNumDims();
+  SmallVector<utils::IteratorType> iterators(numLoops - numReductions,
+                                             utils::IteratorType::parallel);
+  iterators.append(numReductions, utils::IteratorType::reduction);
+  return builder
+      .create<linalg::GenericOp>(
+          loc, init.getType(), ValueRange{lhs, tile, rhs}, ValueRange{init},
+          maps, iterators,
+          [](OpBuilder &b, Location loc, ValueRange args) {
+            Value mul = b.create<arith::MulFOp>(loc, args[0], args[1]);
+            mul = b.create<arith::MulFOp>(loc, mul, args[2]);
+            Value add = b.create<arith::AddFOp>(loc, args[3], mul);
+            b.create<linalg::YieldOp>(loc, add);
+          })
+      .getResult(0);
+}
+
+// Return the transformed filter U = G * F * G^T, [4][4][C][F], computed at
+// compile time if the filter is a constant.
+static Value transformFilter(OpBuilder &builder, Location loc, Value filter) {
+  auto filterType = cast<RankedTensorType>(filter.getType());
+  int64_t channels = filterType.getDimSize(2);
+  int64_t features = filterType.getDimSize(3);
+  SmallVector<int64_t> shape{kTile, kTile, channels, features};
+
+  DenseFPElementsAttr filterAttr;
+  if (matchPattern(filter, m_Constant(&filterAttr))) {
+    SmallVector<float> values(filterAttr.getValues<float>());
+    SmallVector<float> transformed(kTile * kTile * channels * features, 0.0f);
+    int64_t plane = channels * features;
+    for (int64_t i = 0; i < kTile; i++) {
+      for (int64_t j = 0; j < kTile; j++) {
+        float *dest = &transformed[(i * kTile + j) * plane];
+        for (int64_t r = 0; r < kFilter; r++) {
+          for (int64_t s = 0; s < kFilter; s++) {
+            float scale = kG[i][r] * kG[j][s];
+            if (scale == 0.0f)
+              continue;
+            const float *source = &values[(r * kFilter + s) * plane];
+            for (int64_t k = 0; k < plane; k++)
+              dest[k] += scale * source[k];
+          }
+        }
+      }
+    }
+    auto type = RankedTensorType::get(shape, builder.getF32Type());
+    return builder.create<arith::ConstantOp>(
+        loc, type, DenseElementsAttr::get(type, ArrayRef<float>(transformed)));
+  }
+
+  // (i, j, c, f, r, s)
+  MLIRContext *ctx = builder.getContext();
+  AffineExpr i, j, c, f, r, s;
+  bindDims(ctx, i, j, c, f, r, s);
+  SmallVector<AffineMap> maps =
+      AffineMap::inferFromExprList({{i, r}, {r, s, c, f}, {j, s}, {i, j, c, f}},
+                                   ctx);
+  Value g = getMatrix(builder, loc, kG);
+  return createTransform(builder, loc, g, filter, g,
+                         getZeros(builder, loc, shape), maps,
+                         /*numReductions=*/2);
+}
+
+// Rewrite a 3x3 stride-1 NHWC convolution with Winograd F(2x2, 3x3):
+//
+//   U[4][4][C][F] = G * filter * G^T
+//   V[4][4][N][P/2][Q/2][C] = B^T * image tile * B
+//   M[4][4][N][P/2][Q/2][F] = V * U, a batch matmul over the 16 positions
+//   output[N][P][Q][F] += A^T * M * A
+//
+// The transforms are linalg.generic ops, vectorized later on; the batch
+// matmul is packed and mapped to brgemms as any other. Only f32 convolutions
+// whose output sizes are even are rewritten.
+struct WinogradConv2DNhwcHwcf
+    : public OpRewritePattern<linalg::Conv2DNhwcHwcfOp> {
+  using OpRewritePattern<linalg::Conv2DNhwcHwcfOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(linalg::Conv2DNhwcHwcfOp convOp,
+                                PatternRewriter &rewriter) const override {
+    if (!convOp.hasPureTensorSemantics())
+      return rewriter.notifyMatchFailure(convOp, "expects tensors");
+    auto isOne = [](int64_t value) { return value == 1; };
+    if (!llvm::all_of(convOp.getStrides().getValues<int64_t>(), isOne) ||
+        !llvm::all_of(convOp.getDilations().getValues<int64_t>(), isOne))
+      return rewriter.notifyMatchFailure(convOp, "expects unit strides");
+    Value image = convOp.getInputs()[0];
+    Value filter = convOp.getInputs()[1];
+    Value output = convOp.getOutputs()[0];
+    auto imageType = cast<RankedTensorType>(image.getType());
+    auto filterType = cast<RankedTensorType>(filter.getType());
+    auto outputType = cast<RankedTensorType>(output.getType());
+    if (!imageType.hasStaticShape() || !filterType.hasStaticShape() ||
+        !outputType.hasStaticShape())
+      return rewriter.notifyMatchFailure(convOp, "expects static shapes");
+    if (!imageType.getElementType().isF32() ||
+        !filterType.getElementType().isF32() ||
+        !outputType.getElementType().isF32())
+      return rewriter.notifyMatchFailure(convOp, "expects f32");
+    if (filterType.getDimSize(0) != kFilter ||
+        filterType.getDimSize(1) != kFilter)
+      return rewriter.notifyMatchFailure(convOp, "expects a 3x3 filter");
+    int64_t batch = outputType.getDimSize(0);
+    int64_t height = outputType.getDimSize(1);
+    int64_t width = outputType.getDimSize(2);
+    int64_t features = outputType.getDimSize(3);
+    int64_t channels = imageType.getDimSize(3);
+    if (height % kOutTile != 0 || width % kOutTile != 0)
+      return rewriter.notifyMatchFailure(convOp, "expects even output sizes");
+    int64_t tilesH = height / kOutTile;
+    int64_t tilesW = width / kOutTile;
+
+    Location loc = convOp.getLoc();
+    MLIRContext *ctx = rewriter.getContext();
+    Value filterTransform = transformFilter(rewriter, loc, filter);
+
+    // Input transform, (i, j, n, h, w, c, k, l) with the tiles overlapping by
+    // 2 rows and columns.
+    AffineExpr i, j, n, h, w, c, k, l;
+    bindDims(ctx, i, j, n, h, w, c, k, l);
+    SmallVector<AffineMap> inputMaps = AffineMap::inferFromExprList(
+        {{i, k},
+         {n, h * kOutTile + k, w * kOutTile + l, c},
+         {j, l},
+         {i, j, n, h, w, c}},
+        ctx);
+    Value bt = getMatrix(rewriter, loc, kBT);
+    Value inputTransform = createTransform(
+        rewriter, loc, bt, image, bt,
+        getZeros(rewriter, loc,
+                 {kTile, kTile, batch, tilesH, tilesW, channels}),
+        inputMaps, /*numReductions=*/2);
+
+    // Batch matmul over the positions of the tiles.
+    int64_t numTiles = batch * tilesH * tilesW;
+    SmallVector<ReassociationIndices> tileReassoc{{0, 1}, {2, 3, 4}, {5}};
+    Value lhs = linalgx::utils::collapse(
+        rewriter, loc, inputTransform,
+        RankedTensorType::get({kTile * kTile, numTiles, channels},
+                              rewriter.getF32Type()),
+        tileReassoc);
+    Value rhs = linalgx::utils::collapse(
+        rewriter, loc, filterTransform,
+        RankedTensorType::get({kTile * kTile, channels, features},
+                              rewriter.getF32Type()),
+        {{0, 1}, {2}, {3}});
+    Value product =
+        rewriter
+            .create<linalg::BatchMatmulOp>(
+                loc, ValueRange{lhs, rhs},
+                ValueRange{getZeros(rewriter, loc,
+                                    {kTile * kTile, numTiles, features})})
+            .getResult(0);
+    product = linalgx::utils::expand(
+        rewriter, loc, product,
+        RankedTensorType::get({kTile, kTile, batch, tilesH, tilesW, features},
+                              rewriter.getF32Type()),
+        tileReassoc);
+
+    // Output transform, (n, h, a, w, b, f, i, j), accumulated into the output
+    // viewed as 2x2 tiles.
+    AffineExpr a, b, f;
+    bindDims(ctx, n, h, a, w, b, f, i, j);
+    SmallVector<AffineMap> outputMaps = AffineMap::inferFromExprList(
+        {{a, i}, {i, j, n, h, w, f}, {b, j}, {n, h, a, w, b, f}}, ctx);
+    SmallVector<ReassociationIndices> outputReassoc{{0}, {1, 2}, {3, 4}, {5}};
+    auto tiledOutputType = RankedTensorType::get(
+        {batch, tilesH, kOutTile, tilesW, kOutTile, features},
+        rewriter.getF32Type());
+    Value tiledOutput = linalgx::utils::expand(rewriter, loc, output,
+                                               tiledOutputType, outputReassoc);
+    Value at = getMatrix(rewriter, loc, kAT);
+    Value result = createTransform(rewriter, loc, at, product, at, tiledOutput,
+                                   outputMaps, /*numReductions=*/2);
+    result = linalgx::utils::collapse(rewriter, loc, result, outputType,
+                                      outputReassoc);
+    LLVM_DEBUG(llvm::dbgs() << "[WinogradConv2D] rewrote " << convOp << "\n");
+    rewriter.replaceOp(convOp, result);
+    return success();
+  }
+};
+
+struct WinogradConv2D : public tpp::impl::WinogradConv2DBase<WinogradConv2D> {
+  using WinogradConv2DBase::WinogradConv2DBase;
+
+  void runOnOperation() override {
+    RewritePatternSet patterns(&getContext());
+    patterns.add<WinogradConv2DNhwcHwcf>(&getContext());
+    if (failed(applyPatternsAndFoldGreedily(getOperation(),
+                                            std::move(patterns))))
+      return signalPassFailure();
+  }
+};
+
+} // namespace
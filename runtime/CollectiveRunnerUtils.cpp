@@ -0,0 +1,308 @@
+//===- CollectiveRunnerUtils.cpp - Shared-memory collectives --------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "CollectiveRunnerUtils.h"
+#include "TraceRunnerUtils.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2,
+              "the barrier needs lock-free atomics between processes");
+
+// The header of the segment holds the barrier, the slots follow it.
+constexpr size_t kHeaderBytes = 4096;
+constexpr size_t kDefaultSlotBytes = size_t(1) << 28;
+// Waiting ranks spin this many times before they yield.
+constexpr int kSpinIterations = 1 << 12;
+
+void collectiveError(const std::string &msg) {
+  fprintf(stderr, "tpp collectives: %s\n", msg.c_str());
+  exit(EXIT_FAILURE);
+}
+
+int64_t readEnv(const char *name, int64_t defaultValue) {
+  const char *value = std::getenv(name);
+  return value ? std::atoll(value) : defaultValue;
+}
+
+struct SegmentHeader {
+  std::atomic<int> count;
+  std::atomic<int> generation;
+};
+
+class Collectives {
+public:
+  static Collectives &get() {
+    static Collectives collectives;
+    return collectives;
+  }
+
+  int64_t getRank() const { return rank; }
+  int64_t getNumRanks() const { return numRanks; }
+
+  // Returns the slot of `owner` for `bytes` bytes, the slot after the last
+  // rank holds the sums of the reductions. With a single rank, the slots are
+  // private buffers grown on demand.
+  char *getSlot(int64_t owner, size_t bytes) {
+    if (numRanks == 1) {
+      if (localSlots[owner].size() < bytes)
+        localSlots[owner].resize(bytes);
+      return localSlots[owner].data();
+    }
+    if (bytes > slotBytes)
+      collectiveError("a collective of " + std::to_string(bytes) +
+                      " bytes exceeds TPP_COLLECTIVE_BYTES");
+    return segment + kHeaderBytes + owner * slotBytes;
+  }
+
+  // Sense-reversing barrier: the last rank to arrive starts a new generation.
+  void barrier() {
+    if (numRanks == 1)
+      return;
+    tpp_trace::ScopedEvent barrierEvent("barrier", "barrier");
+    int generation = header->generation.load(std::memory_order_acquire);
+    if (header->count.fetch_add(1, std::memory_order_acq_rel) + 1 ==
+        numRanks) {
+      header->count.store(0, std::memory_order_relaxed);
+      header->generation.fetch_add(1, std::memory_order_release);
+      return;
+    }
+    int spins = 0;
+    while (header->generation.load(std::memory_order_acquire) == generation) {
+      if (++spins >= kSpinIterations)
+        std::this_thread::yield();
+    }
+  }
+
+private:
+  Collectives()
+      : rank(readEnv("TPP_RANK", 0)), numRanks(readEnv("TPP_NUM_RANKS", 1)),
+        slotBytes(readEnv("TPP_COLLECTIVE_BYTES", kDefaultSlotBytes)) {
+    if (numRanks < 1 || rank < 0 || rank >= numRanks)
+      collectiveError("invalid rank " + std::to_string(rank) + " of " +
+                      std::to_string(numRanks));
+    if (numRanks == 1) {
+      localSlots.resize(2);
+      return;
+    }
+    mapSegment();
+  }
+
+  // Maps the segment of all the ranks, created zeroed by the first one to
+  // open it. Its name is released once all the ranks have it mapped.
+  void mapSegment() {
+#ifdef __linux__
+    const char *name = std::getenv("TPP_COLLECTIVE_NAME");
+    if (!name || !*name)
+      collectiveError("TPP_COLLECTIVE_NAME is required with several ranks");
+    std::string path = std::string("/dev/shm/") + name;
+    size_t bytes = kHeaderBytes + (numRanks + 1) * slotBytes;
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0 || ftruncate(fd, bytes) != 0)
+      collectiveError(path + ": " + strerror(errno));
+    void *base =
+        mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+      collectiveError(path + ": " + strerror(errno));
+    segment = static_cast<char *>(base);
+    header = reinterpret_cast<SegmentHeader *>(segment);
+    barrier();
+    if (rank == 0)
+      unlink(path.c_str());
+#else
+    collectiveError("several ranks are only supported on Linux");
+#endif
+  }
+
+  const int64_t rank;
+  const int64_t numRanks;
+  const size_t slotBytes;
+  char *segment = nullptr;
+  SegmentHeader *header = nullptr;
+  std::vector<std::vector<char>> localSlots;
+};
+
+// A strided view of the elements of a memref.
+template <typename T> struct View {
+  T *data;
+  std::vector<int64_t> sizes;
+  std::vector<int64_t> strides;
+
+  explicit View(UnrankedMemRefType<T> *memref) {
+    DynamicMemRefType<T> desc(*memref);
+    data = desc.data + desc.offset;
+    sizes.assign(desc.sizes, desc.sizes + desc.rank);
+    strides.assign(desc.strides, desc.strides + desc.rank);
+  }
+
+  int64_t getNumElements() const {
+    int64_t numElements = 1;
+    for (int64_t size : sizes)
+      numElements *= size;
+    return numElements;
+  }
+
+  // Calls `fn` on the elements in row-major order.
+  template <typename Fn> void forEach(Fn fn) const {
+    int64_t numElements = getNumElements();
+    int64_t rank = sizes.size();
+    std::vector<int64_t> idx(rank, 0);
+    T *ptr = data;
+    for (int64_t i = 0; i < numElements; i++) {
+      fn(*ptr, i);
+      for (int64_t dim = rank - 1; dim >= 0; dim--) {
+        ptr += strides[dim];
+        if (++idx[dim] < sizes[dim])
+          break;
+        ptr -= strides[dim] * sizes[dim];
+        idx[dim] = 0;
+      }
+    }
+  }
+};
+
+// Element arithmetic of the reductions, bf16 is summed in f32.
+inline float bf16ToFloat(int16_t value) {
+  uint32_t bits = static_cast<uint32_t>(static_cast<uint16_t>(value)) << 16;
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+inline int16_t floatToBf16(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  // Round to nearest even.
+  bits += 0x7fff + ((bits >> 16) & 1);
+  return static_cast<int16_t>(bits >> 16);
+}
+
+template <typename T> struct Accumulator {
+  using type = T;
+  static type load(T value) { return value; }
+  static T store(type value) { return value; }
+};
+
+template <> struct Accumulator<int16_t> {
+  using type = float;
+  static type load(int16_t value) { return bf16ToFloat(value); }
+  static int16_t store(type value) { return floatToBf16(value); }
+};
+
+template <typename T>
+void allGather(UnrankedMemRefType<T> *localMemref,
+               UnrankedMemRefType<T> *fullMemref, int64_t dim) {
+  Collectives &collectives = Collectives::get();
+  int64_t numRanks = collectives.getNumRanks();
+  View<T> local(localMemref);
+  View<T> full(fullMemref);
+  bool compatible = local.sizes.size() == full.sizes.size() && dim >= 0 &&
+                    dim < static_cast<int64_t>(local.sizes.size());
+  for (size_t i = 0; compatible && i < local.sizes.size(); i++) {
+    int64_t factor = static_cast<int64_t>(i) == dim ? numRanks : 1;
+    compatible = full.sizes[i] == local.sizes[i] * factor;
+  }
+  if (!compatible)
+    collectiveError("all-gather of mismatched shapes for " +
+                    std::to_string(numRanks) + " ranks");
+
+  size_t bytes = local.getNumElements() * sizeof(T);
+  T *slot = reinterpret_cast<T *>(
+      collectives.getSlot(collectives.getRank(), bytes));
+  local.forEach([&](const T &value, int64_t i) { slot[i] = value; });
+  collectives.barrier();
+
+  // The part of each rank is a view of the full tensor at its offset.
+  View<T> part = full;
+  part.sizes = local.sizes;
+  for (int64_t owner = 0; owner < numRanks; owner++) {
+    part.data = full.data + owner * local.sizes[dim] * full.strides[dim];
+    const T *src = reinterpret_cast<T *>(collectives.getSlot(owner, bytes));
+    part.forEach([&](T &value, int64_t i) { value = src[i]; });
+  }
+  collectives.barrier();
+}
+
+template <typename T>
+void allReduce(UnrankedMemRefType<T> *partialMemref,
+               UnrankedMemRefType<T> *resultMemref) {
+  Collectives &collectives = Collectives::get();
+  int64_t numRanks = collectives.getNumRanks();
+  int64_t rank = collectives.getRank();
+  View<T> partial(partialMemref);
+  View<T> result(resultMemref);
+  if (partial.sizes != result.sizes)
+    collectiveError("all-reduce of mismatched shapes");
+
+  int64_t numElements = partial.getNumElements();
+  size_t bytes = numElements * sizeof(T);
+  T *slot = reinterpret_cast<T *>(collectives.getSlot(rank, bytes));
+  partial.forEach([&](const T &value, int64_t i) { slot[i] = value; });
+  collectives.barrier();
+
+  // Reduce-scatter: each rank sums its chunk of the partials.
+  using Acc = Accumulator<T>;
+  T *sums = reinterpret_cast<T *>(collectives.getSlot(numRanks, bytes));
+  int64_t begin = numElements * rank / numRanks;
+  int64_t end = numElements * (rank + 1) / numRanks;
+  std::vector<typename Acc::type> chunk(end - begin);
+  for (int64_t owner = 0; owner < numRanks; owner++) {
+    const T *src = reinterpret_cast<T *>(collectives.getSlot(owner, bytes));
+    for (int64_t i = begin; i < end; i++)
+      chunk[i - begin] += Acc::load(src[i]);
+  }
+  for (int64_t i = begin; i < end; i++)
+    sums[i] = Acc::store(chunk[i - begin]);
+  collectives.barrier();
+
+  // All-gather of the sums.
+  result.forEach([&](T &value, int64_t i) { value = sums[i]; });
+  collectives.barrier();
+}
+
+} // namespace
+
+int64_t tpp_collective_rank() { return Collectives::get().getRank(); }
+
+int64_t tpp_collective_num_ranks() { return Collectives::get().getNumRanks(); }
+
+void tpp_collective_barrier() { Collectives::get().barrier(); }
+
+#define DEFINE_TPP_COLLECTIVES(suffix, type)                                   \
+  void _mlir_ciface_tpp_all_gather_##suffix(UnrankedMemRefType<type> *local,   \
+                                            UnrankedMemRefType<type> *full,    \
+                                            int64_t dim) {                     \
+    allGather(local, full, dim);                                               \
+  }                                                                            \
+  void _mlir_ciface_tpp_all_reduce_##suffix(                                   \
+      UnrankedMemRefType<type> *partial, UnrankedMemRefType<type> *result) {   \
+    allReduce(partial, result);                                                \
+  }
+
+DEFINE_TPP_COLLECTIVES(f32, float)
+DEFINE_TPP_COLLECTIVES(bf16, int16_t)
+DEFINE_TPP_COLLECTIVES(i32, int32_t)
+
+#undef DEFINE_TPP_COLLECTIVES
@@ -0,0 +1,75 @@
+//===- CollectiveRunnerUtils.h - Shared-memory collectives ----------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Collectives between the ranks of a tensor-parallel kernel, the processes of
+// a node that each run the kernel on their shard of the weights. The ranks
+// exchange their data through a shared memory segment with a slot per rank,
+// and synchronize on a barrier in the segment.
+//
+// The ranks are set up from the environment: TPP_NUM_RANKS ranks (1 if not
+// set), the rank TPP_RANK of the process, and the name TPP_COLLECTIVE_NAME of
+// the segment, which must be fresh for each run. A slot holds up to
+// TPP_COLLECTIVE_BYTES bytes (256 MB by default), only the pages used are
+// backed by memory. With a single rank, the collectives are copies.
+//
+// The collectives must be called by all the ranks in the same order.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TPP_EXECUTIONENGINE_COLLECTIVERUNNERUTILS_H
+#define TPP_EXECUTIONENGINE_COLLECTIVERUNNERUTILS_H
+
+#include "mlir/ExecutionEngine/RunnerUtils.h"
+
+//===----------------------------------------------------------------------===//
+// Compiler interface, see the tensor-parallel-matmuls pass
+//===----------------------------------------------------------------------===//
+
+// Returns the rank of the process.
+extern "C" MLIR_RUNNERUTILS_EXPORT int64_t tpp_collective_rank();
+
+// Gathers the `local` tensors of the ranks into `full`, in rank order along
+// the dimension `dim`.
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+_mlir_ciface_tpp_all_gather_f32(UnrankedMemRefType<float> *local,
+                                UnrankedMemRefType<float> *full, int64_t dim);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+_mlir_ciface_tpp_all_gather_bf16(UnrankedMemRefType<int16_t> *local,
+                                 UnrankedMemRefType<int16_t> *full,
+                                 int64_t dim);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+_mlir_ciface_tpp_all_gather_i32(UnrankedMemRefType<int32_t> *local,
+                                UnrankedMemRefType<int32_t> *full, int64_t dim);
+
+// Sums the `partial` tensors of the ranks into `result`, as a reduce-scatter
+// of the partials followed by an all-gather of the sums.
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+_mlir_ciface_tpp_all_reduce_f32(UnrankedMemRefType<float> *partial,
+                                UnrankedMemRefType<float> *result);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+_mlir_ciface_tpp_all_reduce_bf16(UnrankedMemRefType<int16_t> *partial,
+                                 UnrankedMemRefType<int16_t> *result);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+_mlir_ciface_tpp_all_reduce_i32(UnrankedMemRefType<int32_t> *partial,
+                                UnrankedMemRefType<int32_t> *result);
+
+//===----------------------------------------------------------------------===//
+// User interface
+//===----------------------------------------------------------------------===//
+
+// Returns the number of ranks.
+extern "C" MLIR_RUNNERUTILS_EXPORT int64_t tpp_collective_num_ranks();
+
+// Waits until all the ranks reach the barrier.
+extern "C" MLIR_RUNNERUTILS_EXPORT void tpp_collective_barrier();
+
+#endif // TPP_EXECUTIONENGINE_COLLECTIVERUNNERUTILS_H
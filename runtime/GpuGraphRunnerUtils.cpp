@@ -0,0 +1,198 @@
+//===- GpuGraphRunnerUtils.cpp - CUDA graph replay ------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "GpuGraphRunnerUtils.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef __unix__
+#include <dlfcn.h>
+#endif
+
+namespace {
+
+// Subset of the CUDA driver API, see cuda.h.
+using CUresult = int;
+using CUdevice = int;
+using CUcontext = void *;
+using CUstream = void *;
+using CUgraph = void *;
+using CUgraphExec = void *;
+
+constexpr CUresult kCudaSuccess = 0;
+// Other threads may use the driver while a stream is captured.
+constexpr int kCaptureModeRelaxed = 2;
+// Graphs kept per launch site, the oldest one is replaced first.
+constexpr size_t kMaxGraphsPerSite = 4;
+
+void graphError(const std::string &msg, CUresult result) {
+  fprintf(stderr, "tpp cuda graphs: %s (CUresult %d)\n", msg.c_str(),
+          result);
+  exit(EXIT_FAILURE);
+}
+
+struct Graph {
+  std::vector<int64_t> signature;
+  CUgraphExec exec;
+};
+
+struct LaunchSite {
+  std::vector<Graph> graphs;
+  // Signature of the capture in progress.
+  std::vector<int64_t> pending;
+  bool capturing = false;
+};
+
+class CudaGraphs {
+public:
+  static CudaGraphs &get() {
+    static CudaGraphs graphs;
+    return graphs;
+  }
+
+  bool begin(CUstream stream, int64_t id,
+             const std::vector<int64_t> &signature) {
+    if (!available)
+      return false;
+    std::lock_guard<std::mutex> guard(lock);
+    LaunchSite &site = sites[id];
+    for (const Graph &graph : site.graphs) {
+      if (graph.signature != signature)
+        continue;
+      ScopedContext scope(*this);
+      check(graphLaunch(graph.exec, stream), "cannot launch a graph");
+      return true;
+    }
+
+    ScopedContext scope(*this);
+    if (streamBeginCapture(stream, kCaptureModeRelaxed) != kCudaSuccess)
+      return false;
+    site.pending = signature;
+    site.capturing = true;
+    return false;
+  }
+
+  void end(CUstream stream, int64_t id) {
+    if (!available)
+      return;
+    std::lock_guard<std::mutex> guard(lock);
+    LaunchSite &site = sites[id];
+    if (!site.capturing)
+      return;
+    site.capturing = false;
+
+    ScopedContext scope(*this);
+    CUgraph graph = nullptr;
+    check(streamEndCapture(stream, &graph), "cannot capture the launches");
+    CUgraphExec exec = nullptr;
+    check(graphInstantiate(&exec, graph, 0), "cannot instantiate a graph");
+    check(graphDestroy(graph), "cannot release a graph");
+    if (site.graphs.size() == kMaxGraphsPerSite) {
+      check(graphExecDestroy(site.graphs.front().exec),
+            "cannot release a graph");
+      site.graphs.erase(site.graphs.begin());
+    }
+    site.graphs.push_back(Graph{site.pending, exec});
+
+    // The captured kernels did not run yet.
+    check(graphLaunch(exec, stream), "cannot launch a graph");
+  }
+
+private:
+  // The launches run in the primary context of the default device, as in
+  // the MLIR CUDA runtime wrappers.
+  struct ScopedContext {
+    explicit ScopedContext(CudaGraphs &graphs) : graphs(graphs) {
+      graphs.check(graphs.ctxPushCurrent(graphs.context),
+                   "cannot set the CUDA context");
+    }
+    ~ScopedContext() {
+      CUcontext popped = nullptr;
+      graphs.ctxPopCurrent(&popped);
+    }
+    CudaGraphs &graphs;
+  };
+
+  CudaGraphs() {
+#ifdef __unix__
+    void *cuda = dlopen("libcuda.so.1", RTLD_NOW | RTLD_GLOBAL);
+    if (!cuda)
+      return;
+    bool resolved =
+        resolve(cuda, "cuInit", init) &&
+        resolve(cuda, "cuDeviceGet", deviceGet) &&
+        resolve(cuda, "cuDevicePrimaryCtxRetain", primaryCtxRetain) &&
+        resolve(cuda, "cuCtxPushCurrent_v2", ctxPushCurrent) &&
+        resolve(cuda, "cuCtxPopCurrent_v2", ctxPopCurrent) &&
+        resolve(cuda, "cuStreamBeginCapture_v2", streamBeginCapture) &&
+        resolve(cuda, "cuStreamEndCapture", streamEndCapture) &&
+        resolve(cuda, "cuGraphInstantiateWithFlags", graphInstantiate) &&
+        resolve(cuda, "cuGraphLaunch", graphLaunch) &&
+        resolve(cuda, "cuGraphDestroy", graphDestroy) &&
+        resolve(cuda, "cuGraphExecDestroy", graphExecDestroy);
+    if (!resolved)
+      return;
+    CUdevice device = 0;
+    available = init(0) == kCudaSuccess &&
+                deviceGet(&device, /*ordinal=*/0) == kCudaSuccess &&
+                primaryCtxRetain(&context, device) == kCudaSuccess;
+#endif
+  }
+
+#ifdef __unix__
+  template <typename Fn>
+  static bool resolve(void *library, const char *name, Fn &fn) {
+    fn = reinterpret_cast<Fn>(dlsym(library, name));
+    return fn != nullptr;
+  }
+#endif
+
+  void check(CUresult result, const char *msg) {
+    if (result != kCudaSuccess)
+      graphError(msg, result);
+  }
+
+  CUresult (*init)(unsigned) = nullptr;
+  CUresult (*deviceGet)(CUdevice *, int) = nullptr;
+  CUresult (*primaryCtxRetain)(CUcontext *, CUdevice) = nullptr;
+  CUresult (*ctxPushCurrent)(CUcontext) = nullptr;
+  CUresult (*ctxPopCurrent)(CUcontext *) = nullptr;
+  CUresult (*streamBeginCapture)(CUstream, int) = nullptr;
+  CUresult (*streamEndCapture)(CUstream, CUgraph *) = nullptr;
+  CUresult (*graphInstantiate)(CUgraphExec *, CUgraph,
+                               unsigned long long) = nullptr;
+  CUresult (*graphLaunch)(CUgraphExec, CUstream) = nullptr;
+  CUresult (*graphDestroy)(CUgraph) = nullptr;
+  CUresult (*graphExecDestroy)(CUgraphExec) = nullptr;
+
+  bool available = false;
+  CUcontext context = nullptr;
+  std::mutex lock;
+  std::map<int64_t, LaunchSite> sites;
+};
+
+} // namespace
+
+bool _mlir_ciface_tpp_cuda_graph_begin(
+    void *stream, int64_t id, UnrankedMemRefType<int64_t> *signature) {
+  DynamicMemRefType<int64_t> desc(*signature);
+  std::vector<int64_t> values(desc.sizes[0]);
+  for (int64_t i = 0; i < desc.sizes[0]; i++)
+    values[i] = desc.data[desc.offset + i * desc.strides[0]];
+  return CudaGraphs::get().begin(stream, id, values);
+}
+
+void tpp_cuda_graph_end(void *stream, int64_t id) {
+  CudaGraphs::get().end(stream, id);
+}
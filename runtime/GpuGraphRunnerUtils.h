@@ -0,0 +1,39 @@
+//===- GpuGraphRunnerUtils.h - CUDA graph replay --------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Replay of the kernel launch sequences from CUDA graphs. The first run of a
+// launch sequence is captured from its stream into a graph, the following
+// runs with the same signature launch the graph instead of the kernels. Each
+// launch site keeps the graphs of its last few signatures.
+//
+// The CUDA driver is resolved at runtime. Without it, or if a stream cannot
+// be captured, the kernels are launched as usual.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TPP_EXECUTIONENGINE_GPUGRAPHRUNNERUTILS_H
+#define TPP_EXECUTIONENGINE_GPUGRAPHRUNNERUTILS_H
+
+#include "mlir/ExecutionEngine/RunnerUtils.h"
+
+//===----------------------------------------------------------------------===//
+// Compiler interface, see the gpu-graph-capture pass
+//===----------------------------------------------------------------------===//
+
+// Launches the graph of the launch site `id` for `signature` on `stream` and
+// returns true if it was captured already. Otherwise, starts capturing the
+// stream and returns false, the launches follow.
+extern "C" MLIR_RUNNERUTILS_EXPORT bool
+_mlir_ciface_tpp_cuda_graph_begin(void *stream, int64_t id,
+                                  UnrankedMemRefType<int64_t> *signature);
+
+// Ends the capture of the launch site `id` and launches its graph on `stream`.
+extern "C" MLIR_RUNNERUTILS_EXPORT void tpp_cuda_graph_end(void *stream,
+                                                           int64_t id);
+
+#endif // TPP_EXECUTIONENGINE_GPUGRAPHRUNNERUTILS_H
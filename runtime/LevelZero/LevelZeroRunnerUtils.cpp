@@ -0,0 +1,415 @@
+//===- LevelZeroRunnerUtils.cpp - Level Zero GPU runtime ------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "LevelZeroRunnerUtils.h"
+
+#include <level_zero/ze_api.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// The event pool grows by this many events.
+constexpr uint32_t kEventsPerPool = 64;
+// The buffers are aligned to a cache line.
+constexpr size_t kBufferAlignment = 64;
+
+void zeError(const char *msg, ze_result_t result) {
+  fprintf(stderr, "tpp level zero: %s (ze_result_t 0x%x)\n", msg,
+          static_cast<unsigned>(result));
+  exit(EXIT_FAILURE);
+}
+
+void check(ze_result_t result, const char *msg) {
+  if (result != ZE_RESULT_SUCCESS)
+    zeError(msg, result);
+}
+
+// A kernel and the group size of its last launch, which is only set again
+// when it changes.
+struct Kernel {
+  ze_kernel_handle_t handle = nullptr;
+  uint32_t groupSize[3] = {0, 0, 0};
+};
+
+class LevelZero {
+public:
+  static LevelZero &get() {
+    static LevelZero runtime;
+    return runtime;
+  }
+
+  ze_module_handle_t loadModule(const void *data, size_t size) {
+    std::lock_guard<std::mutex> guard(lock);
+    std::string binary(static_cast<const char *>(data), size);
+    auto it = modules.find(binary);
+    if (it != modules.end())
+      return it->second;
+
+    ze_module_desc_t desc = {ZE_STRUCTURE_TYPE_MODULE_DESC,
+                             nullptr,
+                             ZE_MODULE_FORMAT_IL_SPIRV,
+                             size,
+                             static_cast<const uint8_t *>(data),
+                             "",
+                             nullptr};
+    ze_module_handle_t module = nullptr;
+    ze_module_build_log_handle_t buildLog = nullptr;
+    ze_result_t result =
+        zeModuleCreate(context, device, &desc, &module, &buildLog);
+    if (result != ZE_RESULT_SUCCESS) {
+      size_t logSize = 0;
+      zeModuleBuildLogGetString(buildLog, &logSize, nullptr);
+      std::string log(logSize, '\0');
+      zeModuleBuildLogGetString(buildLog, &logSize, &log[0]);
+      fprintf(stderr, "%s\n", log.c_str());
+      zeError("cannot build the module", result);
+    }
+    zeModuleBuildLogDestroy(buildLog);
+    modules.emplace(std::move(binary), module);
+    return module;
+  }
+
+  Kernel *getKernel(ze_module_handle_t module, const char *name) {
+    std::lock_guard<std::mutex> guard(lock);
+    Kernel &kernel = kernels[std::make_pair(module, std::string(name))];
+    if (!kernel.handle) {
+      ze_kernel_desc_t desc = {ZE_STRUCTURE_TYPE_KERNEL_DESC, nullptr, 0,
+                               name};
+      check(zeKernelCreate(module, &desc, &kernel.handle),
+            "cannot create the kernel");
+    }
+    return &kernel;
+  }
+
+  void launch(Kernel &kernel, const uint32_t groupCount[3],
+              const uint32_t groupSize[3], ze_command_list_handle_t list,
+              void **params, size_t paramsCount) {
+    // The arguments are set on the kernel object, then captured by the
+    // launch: the launches of a kernel are serialized.
+    std::lock_guard<std::mutex> guard(lock);
+    if (!std::equal(groupSize, groupSize + 3, kernel.groupSize)) {
+      check(zeKernelSetGroupSize(kernel.handle, groupSize[0], groupSize[1],
+                                 groupSize[2]),
+            "cannot set the group size");
+      std::copy(groupSize, groupSize + 3, kernel.groupSize);
+    }
+    for (size_t i = 0; i + 1 < paramsCount; i += 2) {
+      auto size = *static_cast<int64_t *>(params[i + 1]);
+      check(zeKernelSetArgumentValue(kernel.handle, i / 2, size, params[i]),
+            "cannot set a kernel argument");
+    }
+    ze_group_count_t counts = {groupCount[0], groupCount[1], groupCount[2]};
+    check(zeCommandListAppendLaunchKernel(list, kernel.handle, &counts,
+                                          nullptr, 0, nullptr),
+          "cannot launch the kernel");
+  }
+
+  // Returns an immediate command list, from the ones of the destroyed
+  // streams if any.
+  ze_command_list_handle_t createStream() {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if (!freeLists.empty()) {
+        ze_command_list_handle_t list = freeLists.back();
+        freeLists.pop_back();
+        return list;
+      }
+    }
+    ze_command_queue_desc_t desc = {ZE_STRUCTURE_TYPE_COMMAND_QUEUE_DESC,
+                                    nullptr,
+                                    computeOrdinal,
+                                    0,
+                                    0,
+                                    ZE_COMMAND_QUEUE_MODE_ASYNCHRONOUS,
+                                    ZE_COMMAND_QUEUE_PRIORITY_NORMAL};
+    ze_command_list_handle_t list = nullptr;
+    check(zeCommandListCreateImmediate(context, device, &desc, &list),
+          "cannot create a command list");
+    return list;
+  }
+
+  void destroyStream(ze_command_list_handle_t list) {
+    synchronize(list);
+    std::lock_guard<std::mutex> guard(lock);
+    freeLists.push_back(list);
+  }
+
+  // The stream of the commands without one.
+  ze_command_list_handle_t getStream(void *stream) {
+    if (stream)
+      return static_cast<ze_command_list_handle_t>(stream);
+    std::call_once(defaultStreamFlag,
+                   [this] { defaultStream = createStream(); });
+    return defaultStream;
+  }
+
+  void synchronize(ze_command_list_handle_t list) {
+    check(zeCommandListHostSynchronize(list, UINT64_MAX),
+          "cannot synchronize the stream");
+  }
+
+  // Returns an unsignaled event of the pools, which grow as needed.
+  ze_event_handle_t createEvent() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (freeEvents.empty()) {
+      ze_event_pool_desc_t poolDesc = {ZE_STRUCTURE_TYPE_EVENT_POOL_DESC,
+                                       nullptr,
+                                       ZE_EVENT_POOL_FLAG_HOST_VISIBLE,
+                                       kEventsPerPool};
+      ze_event_pool_handle_t pool = nullptr;
+      check(zeEventPoolCreate(context, &poolDesc, 1, &device, &pool),
+            "cannot create an event pool");
+      eventPools.push_back(pool);
+      for (uint32_t index = 0; index < kEventsPerPool; index++) {
+        ze_event_desc_t desc = {ZE_STRUCTURE_TYPE_EVENT_DESC, nullptr, index,
+                                ZE_EVENT_SCOPE_FLAG_HOST,
+                                ZE_EVENT_SCOPE_FLAG_HOST};
+        ze_event_handle_t event = nullptr;
+        check(zeEventCreate(pool, &desc, &event), "cannot create an event");
+        freeEvents.push_back(event);
+      }
+    }
+    ze_event_handle_t event = freeEvents.back();
+    freeEvents.pop_back();
+    check(zeEventHostReset(event), "cannot reset an event");
+    return event;
+  }
+
+  void destroyEvent(ze_event_handle_t event) {
+    std::lock_guard<std::mutex> guard(lock);
+    freeEvents.push_back(event);
+  }
+
+  void *allocate(uint64_t size, bool shared) {
+    if (size == 0)
+      return nullptr;
+    ze_device_mem_alloc_desc_t deviceDesc = {
+        ZE_STRUCTURE_TYPE_DEVICE_MEM_ALLOC_DESC, nullptr, 0, 0};
+    void *ptr = nullptr;
+    // An integrated GPU reads the host memory directly, the shared buffers
+    // are host USM, which is never migrated.
+    if (shared && integrated) {
+      ze_host_mem_alloc_desc_t hostDesc = {
+          ZE_STRUCTURE_TYPE_HOST_MEM_ALLOC_DESC, nullptr, 0};
+      check(zeMemAllocHost(context, &hostDesc, size, kBufferAlignment, &ptr),
+            "cannot allocate a host buffer");
+    } else if (shared) {
+      ze_host_mem_alloc_desc_t hostDesc = {
+          ZE_STRUCTURE_TYPE_HOST_MEM_ALLOC_DESC, nullptr, 0};
+      check(zeMemAllocShared(context, &deviceDesc, &hostDesc, size,
+                             kBufferAlignment, device, &ptr),
+            "cannot allocate a shared buffer");
+    } else {
+      check(zeMemAllocDevice(context, &deviceDesc, size, kBufferAlignment,
+                             device, &ptr),
+            "cannot allocate a device buffer");
+    }
+    return ptr;
+  }
+
+  void free(void *ptr) {
+    if (ptr)
+      check(zeMemFree(context, ptr), "cannot free a buffer");
+  }
+
+private:
+  LevelZero() {
+    check(zeInit(ZE_INIT_FLAG_GPU_ONLY), "cannot initialize Level Zero");
+    uint32_t numDrivers = 0;
+    check(zeDriverGet(&numDrivers, nullptr), "cannot find a driver");
+    std::vector<ze_driver_handle_t> drivers(numDrivers);
+    check(zeDriverGet(&numDrivers, drivers.data()), "cannot find a driver");
+    ze_driver_handle_t driver = nullptr;
+    for (ze_driver_handle_t candidate : drivers) {
+      uint32_t numDevices = 0;
+      check(zeDeviceGet(candidate, &numDevices, nullptr),
+            "cannot find a device");
+      std::vector<ze_device_handle_t> devices(numDevices);
+      check(zeDeviceGet(candidate, &numDevices, devices.data()),
+            "cannot find a device");
+      for (ze_device_handle_t handle : devices) {
+        ze_device_properties_t properties = {};
+        properties.stype = ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES;
+        check(zeDeviceGetProperties(handle, &properties),
+              "cannot query a device");
+        if (properties.type == ZE_DEVICE_TYPE_GPU) {
+          driver = candidate;
+          device = handle;
+          integrated = properties.flags & ZE_DEVICE_PROPERTY_FLAG_INTEGRATED;
+          break;
+        }
+      }
+      if (device)
+        break;
+    }
+    if (!device)
+      zeError("no GPU found", ZE_RESULT_ERROR_UNINITIALIZED);
+
+    ze_context_desc_t contextDesc = {ZE_STRUCTURE_TYPE_CONTEXT_DESC, nullptr,
+                                     0};
+    check(zeContextCreate(driver, &contextDesc, &context),
+          "cannot create the context");
+
+    // The command lists submit to the first compute engine.
+    uint32_t numGroups = 0;
+    check(zeDeviceGetCommandQueueGroupProperties(device, &numGroups, nullptr),
+          "cannot query the command queues");
+    std::vector<ze_command_queue_group_properties_t> groups(numGroups);
+    for (ze_command_queue_group_properties_t &group : groups) {
+      group = {};
+      group.stype = ZE_STRUCTURE_TYPE_COMMAND_QUEUE_GROUP_PROPERTIES;
+    }
+    check(zeDeviceGetCommandQueueGroupProperties(device, &numGroups,
+                                                 groups.data()),
+          "cannot query the command queues");
+    bool found = false;
+    for (uint32_t ordinal = 0; ordinal < numGroups && !found; ordinal++) {
+      if (groups[ordinal].flags &
+          ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COMPUTE) {
+        computeOrdinal = ordinal;
+        found = true;
+      }
+    }
+    if (!found)
+      zeError("no compute engine found", ZE_RESULT_ERROR_UNINITIALIZED);
+  }
+
+  ze_device_handle_t device = nullptr;
+  ze_context_handle_t context = nullptr;
+  uint32_t computeOrdinal = 0;
+  // The device shares the host memory.
+  bool integrated = false;
+
+  std::mutex lock;
+  // Modules by SPIR-V binary.
+  std::map<std::string, ze_module_handle_t> modules;
+  // Kernels by module and name, their addresses are the function handles.
+  std::map<std::pair<ze_module_handle_t, std::string>, Kernel> kernels;
+  std::vector<ze_command_list_handle_t> freeLists;
+  std::vector<ze_event_pool_handle_t> eventPools;
+  std::vector<ze_event_handle_t> freeEvents;
+
+  std::once_flag defaultStreamFlag;
+  ze_command_list_handle_t defaultStream = nullptr;
+};
+
+} // namespace
+
+void *mgpuModuleLoad(void *data, size_t size) {
+  return LevelZero::get().loadModule(data, size);
+}
+
+void mgpuModuleUnload(void *) {}
+
+void *mgpuModuleGetFunction(void *module, const char *name) {
+  return LevelZero::get().getKernel(static_cast<ze_module_handle_t>(module),
+                                    name);
+}
+
+void mgpuLaunchKernel(void *function, intptr_t gridX, intptr_t gridY,
+                      intptr_t gridZ, intptr_t blockX, intptr_t blockY,
+                      intptr_t blockZ, int32_t smem, void *stream,
+                      void **params, void **, size_t paramsCount) {
+  if (smem != 0)
+    zeError("dynamic shared memory is not supported",
+            ZE_RESULT_ERROR_UNSUPPORTED_FEATURE);
+  LevelZero &runtime = LevelZero::get();
+  const uint32_t groupCount[3] = {static_cast<uint32_t>(gridX),
+                                  static_cast<uint32_t>(gridY),
+                                  static_cast<uint32_t>(gridZ)};
+  const uint32_t groupSize[3] = {static_cast<uint32_t>(blockX),
+                                 static_cast<uint32_t>(blockY),
+                                 static_cast<uint32_t>(blockZ)};
+  runtime.launch(*static_cast<Kernel *>(function), groupCount, groupSize,
+                 runtime.getStream(stream), params, paramsCount);
+}
+
+void *mgpuStreamCreate() { return LevelZero::get().createStream(); }
+
+void mgpuStreamDestroy(void *stream) {
+  LevelZero::get().destroyStream(
+      static_cast<ze_command_list_handle_t>(stream));
+}
+
+void mgpuStreamSynchronize(void *stream) {
+  LevelZero &runtime = LevelZero::get();
+  runtime.synchronize(runtime.getStream(stream));
+}
+
+void mgpuStreamWaitEvent(void *stream, void *event) {
+  auto handle = static_cast<ze_event_handle_t>(event);
+  check(zeCommandListAppendWaitOnEvents(LevelZero::get().getStream(stream), 1,
+                                        &handle),
+        "cannot wait for an event");
+}
+
+void *mgpuEventCreate() { return LevelZero::get().createEvent(); }
+
+void mgpuEventDestroy(void *event) {
+  LevelZero::get().destroyEvent(static_cast<ze_event_handle_t>(event));
+}
+
+void mgpuEventSynchronize(void *event) {
+  check(zeEventHostSynchronize(static_cast<ze_event_handle_t>(event),
+                               UINT64_MAX),
+        "cannot synchronize an event");
+}
+
+void mgpuEventRecord(void *event, void *stream) {
+  check(zeCommandListAppendSignalEvent(LevelZero::get().getStream(stream),
+                                       static_cast<ze_event_handle_t>(event)),
+        "cannot record an event");
+}
+
+void *mgpuMemAlloc(uint64_t sizeBytes, void *, bool isHostShared) {
+  return LevelZero::get().allocate(sizeBytes, isHostShared);
+}
+
+void mgpuMemFree(void *ptr, void *stream) {
+  LevelZero &runtime = LevelZero::get();
+  runtime.synchronize(runtime.getStream(stream));
+  runtime.free(ptr);
+}
+
+void mgpuMemcpy(void *dst, void *src, size_t sizeBytes, void *stream) {
+  check(zeCommandListAppendMemoryCopy(LevelZero::get().getStream(stream), dst,
+                                      src, sizeBytes, nullptr, 0, nullptr),
+        "cannot copy a buffer");
+}
+
+// The fill pattern is read when the command runs, the stream is synchronized
+// before it goes out of scope.
+template <typename T>
+static void fillBuffer(void *dst, T value, size_t count, void *stream) {
+  LevelZero &runtime = LevelZero::get();
+  ze_command_list_handle_t list = runtime.getStream(stream);
+  check(zeCommandListAppendMemoryFill(list, dst, &value, sizeof(T),
+                                      count * sizeof(T), nullptr, 0, nullptr),
+        "cannot fill a buffer");
+  runtime.synchronize(list);
+}
+
+void mgpuMemset32(void *dst, unsigned int value, size_t count, void *stream) {
+  fillBuffer(dst, value, count, stream);
+}
+
+void mgpuMemset16(void *dst, unsigned short value, size_t count,
+                  void *stream) {
+  fillBuffer(dst, value, count, stream);
+}
+
+void mgpuSetDefaultDevice(int32_t) {}
@@ -0,0 +1,88 @@
+//===- LevelZeroRunnerUtils.h - Level Zero GPU runtime --------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// GPU runtime of the Intel GPUs on Level Zero, with the interface of the MLIR
+// GPU runtime wrappers which the gpu-to-llvm lowering calls. It is tuned for
+// the launch latency of small kernels:
+//   - the streams are immediate command lists, the commands are submitted as
+//     they are appended and only the stream and event synchronizations wait;
+//   - the command lists of the destroyed streams and the events are pooled,
+//     creating them again costs nothing;
+//   - the modules are cached by their SPIR-V binary and the kernels by their
+//     module and name, neither is built again when loaded again;
+//   - the buffers are USM device allocations, or shared ones for the buffers
+//     the host accesses.
+//
+// The runtime uses the first GPU of the first driver, ZE_AFFINITY_MASK selects
+// the visible devices. The kernels are lowered with the sizes of their
+// arguments interspersed (gpu-to-llvm{intersperse-sizes-for-kernels}).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TPP_EXECUTIONENGINE_LEVELZERORUNNERUTILS_H
+#define TPP_EXECUTIONENGINE_LEVELZERORUNNERUTILS_H
+
+#include "mlir/ExecutionEngine/RunnerUtils.h"
+
+#include <cstddef>
+#include <cstdint>
+
+//===----------------------------------------------------------------------===//
+// Compiler interface, see the MLIR GPU runtime wrappers
+//===----------------------------------------------------------------------===//
+
+// Returns the module of the SPIR-V binary `data` of `size` bytes.
+extern "C" MLIR_RUNNERUTILS_EXPORT void *mgpuModuleLoad(void *data,
+                                                        size_t size);
+
+// Modules are cached for the process, unloading them does nothing.
+extern "C" MLIR_RUNNERUTILS_EXPORT void mgpuModuleUnload(void *module);
+
+// Returns the kernel `name` of `module`.
+extern "C" MLIR_RUNNERUTILS_EXPORT void *
+mgpuModuleGetFunction(void *module, const char *name);
+
+// Launches `function` on `stream`. The `paramsCount` pointers of `params`
+// point to the value of each argument followed by its size in bytes, an
+// int64. Dynamic shared memory is not supported, `smem` must be 0.
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+mgpuLaunchKernel(void *function, intptr_t gridX, intptr_t gridY,
+                 intptr_t gridZ, intptr_t blockX, intptr_t blockY,
+                 intptr_t blockZ, int32_t smem, void *stream, void **params,
+                 void **extra, size_t paramsCount);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void *mgpuStreamCreate();
+extern "C" MLIR_RUNNERUTILS_EXPORT void mgpuStreamDestroy(void *stream);
+extern "C" MLIR_RUNNERUTILS_EXPORT void mgpuStreamSynchronize(void *stream);
+extern "C" MLIR_RUNNERUTILS_EXPORT void mgpuStreamWaitEvent(void *stream,
+                                                            void *event);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void *mgpuEventCreate();
+extern "C" MLIR_RUNNERUTILS_EXPORT void mgpuEventDestroy(void *event);
+extern "C" MLIR_RUNNERUTILS_EXPORT void mgpuEventSynchronize(void *event);
+extern "C" MLIR_RUNNERUTILS_EXPORT void mgpuEventRecord(void *event,
+                                                        void *stream);
+
+// Allocates a device buffer, or a shared one with `isHostShared`.
+extern "C" MLIR_RUNNERUTILS_EXPORT void *
+mgpuMemAlloc(uint64_t sizeBytes, void *stream, bool isHostShared);
+
+// Frees `ptr` once the commands of `stream` are done.
+extern "C" MLIR_RUNNERUTILS_EXPORT void mgpuMemFree(void *ptr, void *stream);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+mgpuMemcpy(void *dst, void *src, size_t sizeBytes, void *stream);
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+mgpuMemset32(void *dst, unsigned int value, size_t count, void *stream);
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+mgpuMemset16(void *dst, unsigned short value, size_t count, void *stream);
+
+// The runtime uses a single device.
+extern "C" MLIR_RUNNERUTILS_EXPORT void mgpuSetDefaultDevice(int32_t device);
+
+#endif // TPP_EXECUTIONENGINE_LEVELZERORUNNERUTILS_H
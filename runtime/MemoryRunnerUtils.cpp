@@ -0,0 +1,124 @@
+//===- MemoryRunnerUtils.cpp - Heap tracking of the kernels ---------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The counters are relaxed atomics: the allocations of a kernel may come from
+// the threads of its parallel regions, which all count as part of the call
+// in flight on the calling thread.
+//
+//===----------------------------------------------------------------------===//
+
+#include "MemoryRunnerUtils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#define TPP_MEMORY_HAS_USABLE_SIZE 1
+#endif
+
+namespace {
+
+struct MemoryCounters {
+  std::atomic<int64_t> activeKernels{0};
+  std::atomic<int64_t> kernelCalls{0};
+  std::atomic<int64_t> kernelAllocs{0};
+  std::atomic<int64_t> kernelBytes{0};
+  std::atomic<int64_t> kernelPeakBytes{0};
+  std::atomic<int64_t> harnessAllocs{0};
+  std::atomic<int64_t> harnessBytes{0};
+  std::atomic<int64_t> liveBytes{0};
+  std::atomic<int64_t> peakBytes{0};
+  // Live bytes at the begin of the current kernel call.
+  std::atomic<int64_t> callBaseBytes{0};
+};
+
+MemoryCounters counters;
+
+void updateMax(std::atomic<int64_t> &max, int64_t value) {
+  int64_t current = max.load(std::memory_order_relaxed);
+  while (value > current &&
+         !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    ;
+}
+
+int64_t getUsableSize(void *ptr) {
+#ifdef TPP_MEMORY_HAS_USABLE_SIZE
+  return static_cast<int64_t>(malloc_usable_size(ptr));
+#else
+  (void)ptr;
+  return 0;
+#endif
+}
+
+void *track(void *ptr, size_t size) {
+  if (!ptr)
+    return ptr;
+  int64_t bytes = static_cast<int64_t>(size);
+  if (counters.activeKernels.load(std::memory_order_relaxed) > 0) {
+    counters.kernelAllocs.fetch_add(1, std::memory_order_relaxed);
+    counters.kernelBytes.fetch_add(bytes, std::memory_order_relaxed);
+  } else {
+    counters.harnessAllocs.fetch_add(1, std::memory_order_relaxed);
+    counters.harnessBytes.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  int64_t usable = getUsableSize(ptr);
+  int64_t live =
+      counters.liveBytes.fetch_add(usable, std::memory_order_relaxed) + usable;
+  updateMax(counters.peakBytes, live);
+  if (counters.activeKernels.load(std::memory_order_relaxed) > 0)
+    updateMax(counters.kernelPeakBytes,
+              live - counters.callBaseBytes.load(std::memory_order_relaxed));
+  return ptr;
+}
+
+} // namespace
+
+void *tpp_memory_malloc(size_t size) { return track(malloc(size), size); }
+
+void *tpp_memory_aligned_alloc(size_t alignment, size_t size) {
+  // posix_memalign takes alignments of at least a pointer.
+  void *ptr = nullptr;
+  if (posix_memalign(&ptr, std::max(alignment, sizeof(void *)), size) != 0)
+    return nullptr;
+  return track(ptr, size);
+}
+
+void tpp_memory_free(void *ptr) {
+  if (ptr)
+    counters.liveBytes.fetch_sub(getUsableSize(ptr), std::memory_order_relaxed);
+  free(ptr);
+}
+
+void tpp_memory_kernel_begin() {
+  // Nested kernels (e.g., a kernel calling another one) are one call.
+  if (counters.activeKernels.fetch_add(1, std::memory_order_relaxed) != 0)
+    return;
+  counters.kernelCalls.fetch_add(1, std::memory_order_relaxed);
+  counters.callBaseBytes.store(
+      counters.liveBytes.load(std::memory_order_relaxed),
+      std::memory_order_relaxed);
+}
+
+void tpp_memory_kernel_end() {
+  counters.activeKernels.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void tpp_memory_get_stats(TppMemoryStats *stats) {
+  stats->kernelCalls = counters.kernelCalls.load(std::memory_order_relaxed);
+  stats->kernelAllocs = counters.kernelAllocs.load(std::memory_order_relaxed);
+  stats->kernelBytes = counters.kernelBytes.load(std::memory_order_relaxed);
+  stats->kernelPeakBytes =
+      counters.kernelPeakBytes.load(std::memory_order_relaxed);
+  stats->harnessAllocs =
+      counters.harnessAllocs.load(std::memory_order_relaxed);
+  stats->harnessBytes = counters.harnessBytes.load(std::memory_order_relaxed);
+  stats->peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+}
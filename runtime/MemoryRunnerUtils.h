@@ -0,0 +1,65 @@
+//===- MemoryRunnerUtils.h - Heap tracking of the kernels -----------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Tracked replacements of the allocation functions the memref allocations
+// lower to. tpp-run -memory-report redirects the malloc, aligned_alloc and
+// free calls of the compiled module to them, and marks the calls of the
+// kernels, which splits the allocations of the kernels from the ones of the
+// benchmark harness (inputs, outputs and reference results).
+//
+// The live bytes are counted with the usable size of the allocations, which
+// is only available with glibc. Elsewhere only the allocations are counted.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TPP_EXECUTIONENGINE_MEMORYRUNNERUTILS_H
+#define TPP_EXECUTIONENGINE_MEMORYRUNNERUTILS_H
+
+#include "mlir/ExecutionEngine/RunnerUtils.h"
+
+#include <cstddef>
+#include <cstdint>
+
+//===----------------------------------------------------------------------===//
+// Compiler interface, see tpp-run -memory-report
+//===----------------------------------------------------------------------===//
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void *tpp_memory_malloc(size_t size);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void *
+tpp_memory_aligned_alloc(size_t alignment, size_t size);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void tpp_memory_free(void *ptr);
+
+// Marks the begin and the end of a call of a kernel.
+extern "C" MLIR_RUNNERUTILS_EXPORT void tpp_memory_kernel_begin();
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void tpp_memory_kernel_end();
+
+//===----------------------------------------------------------------------===//
+// Host interface
+//===----------------------------------------------------------------------===//
+
+struct TppMemoryStats {
+  // Calls of the kernels, and their allocations.
+  int64_t kernelCalls;
+  int64_t kernelAllocs;
+  int64_t kernelBytes;
+  // Highest growth of the heap during a kernel call.
+  int64_t kernelPeakBytes;
+  // Allocations out of the kernels.
+  int64_t harnessAllocs;
+  int64_t harnessBytes;
+  // Highest number of live bytes of all the tracked allocations.
+  int64_t peakBytes;
+};
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+tpp_memory_get_stats(TppMemoryStats *stats);
+
+#endif // TPP_EXECUTIONENGINE_MEMORYRUNNERUTILS_H
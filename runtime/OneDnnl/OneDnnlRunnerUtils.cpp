@@ -1,4 +1,4 @@
-//===- CRunnerUtils.cpp - Utils for MLIR execution ------------------------===//
+//===- OneDnnlRunnerUtils.cpp - oneDNN BLAS fallback ----------------------===//
 //
 // Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
 // See https://llvm.org/LICENSE.txt for license information.
@@ -6,21 +6,214 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// This file implements basic functions to manipulate structured MLIR types at
-// runtime. Entities in this file are meant to be retargetable, including on
-// targets without a C++ runtime, and must be kept C compatible.
+// This file implements the oneDNN entry points of the matmuls lowered by
+// convert-linalg-to-func.
 //
 //===----------------------------------------------------------------------===//
 
 #include "OneDnnlRunnerUtils.h"
 #include "dnnl.h"
 #include <cassert>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace {
+
+#define CHECK_DNNL(call)                                                       \
+  do {                                                                         \
+    dnnl_status_t status = (call);                                             \
+    (void)status;                                                              \
+    assert(status == dnnl_success && #call);                                   \
+  } while (0)
+
+// Shape of a matmul primitive, the data handles are given at execution.
+struct Key {
+  int64_t dataTypes;
+  int64_t postOps;
+  size_t batch, m, n, k;
+  size_t strideA, lda, strideB, ldb, strideC, ldc;
+
+  bool operator<(const Key &other) const {
+    return std::tie(dataTypes, postOps, batch, m, n, k, strideA, lda, strideB,
+                    ldb, strideC, ldc) <
+           std::tie(other.dataTypes, other.postOps, other.batch, other.m,
+                    other.n, other.k, other.strideA, other.lda, other.strideB,
+                    other.ldb, other.strideC, other.ldc);
+  }
+};
+
+struct Entry {
+  dnnl_primitive_t primitive = nullptr;
+  dnnl_memory_desc_t srcMd = nullptr;
+  dnnl_memory_desc_t weightsMd = nullptr;
+  dnnl_memory_desc_t biasMd = nullptr;
+  dnnl_memory_desc_t dstMd = nullptr;
+};
+
+dnnl_engine_t getEngine() {
+  static dnnl_engine_t engine = [] {
+    dnnl_engine_t engine;
+    CHECK_DNNL(dnnl_engine_create(&engine, dnnl_cpu, 0));
+    return engine;
+  }();
+  return engine;
+}
+
+// Streams are not thread-safe, each thread calling into oneDNN gets its own.
+dnnl_stream_t getStream() {
+  static thread_local dnnl_stream_t stream = [] {
+    dnnl_stream_t stream;
+    CHECK_DNNL(
+        dnnl_stream_create(&stream, getEngine(), dnnl_stream_default_flags));
+    return stream;
+  }();
+  return stream;
+}
+
+void getDataTypes(int64_t dataTypes, dnnl_data_type_t &a, dnnl_data_type_t &b,
+                  dnnl_data_type_t &c) {
+  switch (dataTypes) {
+  case TPP_DNNL_F32:
+    a = b = c = dnnl_f32;
+    return;
+  case TPP_DNNL_BF16:
+    a = b = c = dnnl_bf16;
+    return;
+  case TPP_DNNL_BF16_F32:
+    a = b = dnnl_bf16;
+    c = dnnl_f32;
+    return;
+  case TPP_DNNL_S8_S32:
+    a = b = dnnl_s8;
+    c = dnnl_s32;
+    return;
+  }
+  assert(false && "Unknown data types");
+}
+
+size_t getSize(dnnl_data_type_t dataType) {
+  switch (dataType) {
+  case dnnl_bf16:
+    return 2;
+  case dnnl_s8:
+    return 1;
+  default:
+    return 4;
+  }
+}
+
+dnnl_memory_desc_t createMd(dnnl_data_type_t dataType, size_t batch,
+                            size_t rows, size_t cols, size_t batchStride,
+                            size_t ld) {
+  dnnl_dims_t dims = {static_cast<dnnl_dim_t>(batch),
+                      static_cast<dnnl_dim_t>(rows),
+                      static_cast<dnnl_dim_t>(cols)};
+  dnnl_dims_t strides = {static_cast<dnnl_dim_t>(batchStride),
+                         static_cast<dnnl_dim_t>(ld), 1};
+  dnnl_memory_desc_t md;
+  CHECK_DNNL(
+      dnnl_memory_desc_create_with_strides(&md, 3, dims, dataType, strides));
+  return md;
+}
+
+// C is accumulated into by a sum post-op, before the bias and the relu.
+Entry createEntry(const Key &key) {
+  dnnl_data_type_t typeA, typeB, typeC;
+  getDataTypes(key.dataTypes, typeA, typeB, typeC);
+
+  Entry entry;
+  entry.srcMd = createMd(typeA, key.batch, key.m, key.k, key.strideA, key.lda);
+  entry.weightsMd =
+      createMd(typeB, key.batch, key.k, key.n, key.strideB, key.ldb);
+  entry.dstMd = createMd(typeC, key.batch, key.m, key.n, key.strideC, key.ldc);
+  if (key.postOps & TPP_DNNL_BIAS)
+    entry.biasMd = createMd(typeC, 1, 1, key.n, key.n, key.n);
+
+  dnnl_post_ops_t postOps;
+  CHECK_DNNL(dnnl_post_ops_create(&postOps));
+  CHECK_DNNL(dnnl_post_ops_append_sum(postOps, 1.0f, 0, dnnl_data_type_undef));
+  if (key.postOps & TPP_DNNL_RELU) {
+    CHECK_DNNL(
+        dnnl_post_ops_append_eltwise(postOps, dnnl_eltwise_relu, 0.0f, 0.0f));
+  }
+  dnnl_primitive_attr_t attr;
+  CHECK_DNNL(dnnl_primitive_attr_create(&attr));
+  CHECK_DNNL(dnnl_primitive_attr_set_post_ops(attr, postOps));
+
+  dnnl_primitive_desc_t desc;
+  CHECK_DNNL(dnnl_matmul_primitive_desc_create(
+      &desc, getEngine(), entry.srcMd, entry.weightsMd, entry.biasMd,
+      entry.dstMd, attr));
+  CHECK_DNNL(dnnl_primitive_create(&entry.primitive, desc));
+  CHECK_DNNL(dnnl_primitive_desc_destroy(desc));
+  CHECK_DNNL(dnnl_primitive_attr_destroy(attr));
+  CHECK_DNNL(dnnl_post_ops_destroy(postOps));
+  return entry;
+}
+
+// Primitives are created once per shape and never released, the lock is only
+// held for the lookup.
+std::mutex cacheMutex;
+std::map<Key, Entry> entries;
+
+const Entry &lookup(const Key &key) {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  auto it = entries.find(key);
+  if (it == entries.end())
+    it = entries.insert(std::make_pair(key, createEntry(key))).first;
+  return it->second;
+}
+
+dnnl_memory_t createMemory(const_dnnl_memory_desc_t md, const void *data) {
+  dnnl_memory_t memory;
+  CHECK_DNNL(dnnl_memory_create(&memory, md, getEngine(),
+                                const_cast<void *>(data)));
+  return memory;
+}
+
+} // namespace
 
 extern "C" void linalg_matmul_blas(size_t m, size_t n, size_t k, const float *A,
                                    size_t offsetA, size_t lda, const float *B,
                                    size_t offsetB, size_t ldb, float *C,
                                    size_t offsetC, size_t ldc) {
-  auto status = dnnl_sgemm('n', 'n', m, n, k, 1.0, A + offsetA, lda,
-                           B + offsetB, ldb, 1.0, C + offsetC, ldc);
-  assert(status == 0);
+  CHECK_DNNL(dnnl_sgemm('n', 'n', m, n, k, 1.0, A + offsetA, lda, B + offsetB,
+                        ldb, 1.0, C + offsetC, ldc));
+}
+
+extern "C" void
+linalg_matmul_dnnl(int64_t dataTypes, int64_t postOps, size_t batch, size_t m,
+                   size_t n, size_t k, const void *A, size_t offsetA,
+                   size_t strideA, size_t lda, const void *B, size_t offsetB,
+                   size_t strideB, size_t ldb, void *C, size_t offsetC,
+                   size_t strideC, size_t ldc, const void *bias,
+                   size_t offsetBias) {
+  Key key = {dataTypes, postOps, batch,   m,      n,       k,
+             strideA,   lda,     strideB, ldb,    strideC, ldc};
+  const Entry &entry = lookup(key);
+
+  dnnl_data_type_t typeA, typeB, typeC;
+  getDataTypes(dataTypes, typeA, typeB, typeC);
+  const char *dataA = static_cast<const char *>(A) + offsetA * getSize(typeA);
+  const char *dataB = static_cast<const char *>(B) + offsetB * getSize(typeB);
+  char *dataC = static_cast<char *>(C) + offsetC * getSize(typeC);
+
+  dnnl_exec_arg_t args[4] = {
+      {DNNL_ARG_SRC, createMemory(entry.srcMd, dataA)},
+      {DNNL_ARG_WEIGHTS, createMemory(entry.weightsMd, dataB)},
+      {DNNL_ARG_DST, createMemory(entry.dstMd, dataC)},
+      {DNNL_ARG_BIAS, nullptr}};
+  int numArgs = 3;
+  if (postOps & TPP_DNNL_BIAS) {
+    const char *dataBias =
+        static_cast<const char *>(bias) + offsetBias * getSize(typeC);
+    args[numArgs++].memory = createMemory(entry.biasMd, dataBias);
+  }
+
+  dnnl_stream_t stream = getStream();
+  CHECK_DNNL(dnnl_primitive_execute(entry.primitive, stream, numArgs, args));
+  CHECK_DNNL(dnnl_stream_wait(stream));
+  for (int i = 0; i < numArgs; i++)
+    CHECK_DNNL(dnnl_memory_destroy(args[i].memory));
 }
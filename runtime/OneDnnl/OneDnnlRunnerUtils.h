@@ -1,11 +1,57 @@
+//===- OneDnnlRunnerUtils.h - oneDNN BLAS fallback ------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Entry points of the matmuls lowered by convert-linalg-to-func. All operands
+// are row-major with a unit inner stride, C is accumulated into.
+//
+// linalg_matmul_blas calls the f32 GEMM of oneDNN. linalg_matmul_dnnl runs
+// the oneDNN matmul primitive on the other data types, batches and fused
+// post-ops. Its primitives are created on the first call of each shape and
+// cached for the lifetime of the process; they run on the oneDNN threads and
+// may be called from parallel regions.
+//
+//===----------------------------------------------------------------------===//
+
 #ifndef ONE_DNNL_EXECUTIONENGINE_CRUNNERUTILS_H
 #define ONE_DNNL_EXECUTIONENGINE_CRUNNERUTILS_H
 
 #include "mlir/ExecutionEngine/RunnerUtils.h"
 
+// Data types of the A, B and C operands of linalg_matmul_dnnl.
+enum TppDnnlDataTypes : int64_t {
+  TPP_DNNL_F32 = 0,      // f32 x f32 -> f32
+  TPP_DNNL_BF16 = 1,     // bf16 x bf16 -> bf16
+  TPP_DNNL_BF16_F32 = 2, // bf16 x bf16 -> f32
+  TPP_DNNL_S8_S32 = 3,   // s8 x s8 -> s32
+};
+
+// Post-ops of linalg_matmul_dnnl, applied after the accumulation in order.
+enum TppDnnlPostOps : int64_t {
+  TPP_DNNL_NONE = 0,
+  // Add the bias row of N elements of the type of C to all the rows of C.
+  TPP_DNNL_BIAS = 1,
+  TPP_DNNL_RELU = 2,
+};
+
+// C[m][n] += sum_k A[m][k] * B[k][n] in f32.
 extern "C" MLIR_RUNNERUTILS_EXPORT void
 linalg_matmul_blas(size_t m, size_t n, size_t k, const float *A, size_t offsetA,
                    size_t lda, const float *B, size_t offsetB, size_t ldb,
                    float *C, size_t offsetC, size_t ldc);
 
+// Batch b of C at `C + offsetC + b * strideC` += the product of the batches b
+// of A and B, followed by `postOps`. A single batch is a plain matmul.
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+linalg_matmul_dnnl(int64_t dataTypes, int64_t postOps, size_t batch, size_t m,
+                   size_t n, size_t k, const void *A, size_t offsetA,
+                   size_t strideA, size_t lda, const void *B, size_t offsetB,
+                   size_t strideB, size_t ldb, void *C, size_t offsetC,
+                   size_t strideC, size_t ldc, const void *bias,
+                   size_t offsetBias);
+
 #endif // ONE_DNNL_EXECUTIONENGINE_CRUNNERUTILS_H
@@ -0,0 +1,115 @@
+//===- PackCacheRunnerUtils.cpp - Cache of packed invariant tensors -------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "PackCacheRunnerUtils.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+// Packed buffers are aligned for the widest vector loads.
+constexpr size_t kAlignment = 128;
+
+struct Entry {
+  void *data = nullptr;
+  int64_t bytes = 0;
+  bool valid = false;
+};
+
+using Key = std::pair<int64_t, int64_t>;
+
+struct KeyHash {
+  size_t operator()(const Key &key) const {
+    return std::hash<int64_t>()(key.first) ^
+           (std::hash<int64_t>()(key.second) * 0x9e3779b97f4a7c15ULL);
+  }
+};
+
+// Lookups happen once per call of a kernel, outside of its parallel regions,
+// a single lock is enough.
+std::mutex cacheMutex;
+std::unordered_map<Key, Entry, KeyHash> entries;
+
+bool isCacheEnabled() {
+  static const bool enabled = [] {
+    const char *env = getenv("TPP_PACK_CACHE");
+    return !env || strcmp(env, "0") != 0;
+  }();
+  return enabled;
+}
+
+} // namespace
+
+void _mlir_ciface_tpp_pack_cache_lookup(UnrankedMemRefType<int8_t> *result,
+                                        int64_t source, int64_t layout,
+                                        int64_t bytes) {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  Entry &entry = entries[Key(source, layout)];
+  if (entry.bytes != bytes) {
+    free(entry.data);
+    entry.data = nullptr;
+    if (posix_memalign(&entry.data, kAlignment,
+                       static_cast<size_t>(bytes > 0 ? bytes : 1)) != 0) {
+      fprintf(stderr, "tpp_pack_cache_lookup: out of memory\n");
+      abort();
+    }
+    entry.bytes = bytes;
+    entry.valid = false;
+  }
+
+  // Rank-1 descriptor: allocated and aligned pointers, offset, size, stride.
+  char *descriptor = static_cast<char *>(
+      malloc(2 * sizeof(int8_t *) + 3 * sizeof(int64_t)));
+  int8_t **ptrs = reinterpret_cast<int8_t **>(descriptor);
+  ptrs[0] = static_cast<int8_t *>(entry.data);
+  ptrs[1] = static_cast<int8_t *>(entry.data);
+  int64_t *ints =
+      reinterpret_cast<int64_t *>(descriptor + 2 * sizeof(int8_t *));
+  ints[0] = 0;
+  ints[1] = bytes;
+  ints[2] = 1;
+  result->rank = 1;
+  result->descriptor = descriptor;
+}
+
+int64_t tpp_pack_cache_is_valid(int64_t source, int64_t layout) {
+  if (!isCacheEnabled())
+    return 0;
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  auto it = entries.find(Key(source, layout));
+  return it != entries.end() && it->second.valid ? 1 : 0;
+}
+
+void tpp_pack_cache_commit(int64_t source, int64_t layout) {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  auto it = entries.find(Key(source, layout));
+  if (it != entries.end())
+    it->second.valid = true;
+}
+
+void tpp_pack_cache_invalidate(const void *source) {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  int64_t address = static_cast<int64_t>(reinterpret_cast<intptr_t>(source));
+  for (auto &entry : entries) {
+    if (entry.first.first == address)
+      entry.second.valid = false;
+  }
+}
+
+void tpp_pack_cache_clear() {
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  for (auto &entry : entries)
+    free(entry.second.data);
+  entries.clear();
+}
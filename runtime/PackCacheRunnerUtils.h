@@ -0,0 +1,59 @@
+//===- PackCacheRunnerUtils.h - Cache of packed invariant tensors ---------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Process-wide cache of the packed copies of the kernel arguments marked as
+// invariant (`tpp.invariant`), e.g. weights loaded once at startup. Entries
+// are keyed by the address of the source data and the packed layout, so a
+// kernel packs each invariant argument on its first call only.
+//
+// The cache doesn't see writes to the source data: after updating it, call
+// tpp_pack_cache_invalidate on its address so that the next call repacks.
+// Invalidating or clearing must not run concurrently with the kernels.
+//
+// The cache can be disabled by setting TPP_PACK_CACHE=0, the kernels then
+// repack on every call.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TPP_EXECUTIONENGINE_PACKCACHERUNNERUTILS_H
+#define TPP_EXECUTIONENGINE_PACKCACHERUNNERUTILS_H
+
+#include "mlir/ExecutionEngine/RunnerUtils.h"
+
+//===----------------------------------------------------------------------===//
+// Compiler interface, see the cache-invariant-packs pass
+//===----------------------------------------------------------------------===//
+
+// Returns the buffer of `bytes` bytes of the entry of `source` in `layout`,
+// allocating it if needed.
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+_mlir_ciface_tpp_pack_cache_lookup(UnrankedMemRefType<int8_t> *result,
+                                   int64_t source, int64_t layout,
+                                   int64_t bytes);
+
+// Returns 1 if the buffer of the entry holds the packed data, 0 otherwise.
+extern "C" MLIR_RUNNERUTILS_EXPORT int64_t
+tpp_pack_cache_is_valid(int64_t source, int64_t layout);
+
+// Marks the buffer of the entry as holding the packed data.
+extern "C" MLIR_RUNNERUTILS_EXPORT void tpp_pack_cache_commit(int64_t source,
+                                                              int64_t layout);
+
+//===----------------------------------------------------------------------===//
+// User interface
+//===----------------------------------------------------------------------===//
+
+// Invalidates the packed copies of the data at `source`, the next calls repack
+// it into the same buffers.
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+tpp_pack_cache_invalidate(const void *source);
+
+// Drops all the entries and releases their buffers.
+extern "C" MLIR_RUNNERUTILS_EXPORT void tpp_pack_cache_clear();
+
+#endif // TPP_EXECUTIONENGINE_PACKCACHERUNNERUTILS_H
@@ -10,8 +10,41 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
 #include <ctime>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#ifdef __unix__
+#include <cerrno>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include "PerfRunnerUtils.h"
 
@@ -19,17 +52,1551 @@
 // Perf dialect utils
 //===----------------------------------------------------------------------===//
 
+// Timers use std::chrono by default. Setting TPP_PERF_TIMER=tsc switches to
+// the CPU timestamp counter (serialized rdtsc on x86, cntvct_el0 on aarch64)
+// which is much cheaper to read for sub-microsecond kernels. The counter is
+// converted to seconds with a tick period calibrated once at startup.
+namespace {
+
+enum class TimerKind { Chrono, Tsc };
+
+#if defined(__x86_64__) || defined(__aarch64__)
+#define TPP_PERF_HAS_TSC 1
+#endif
+
+#ifdef TPP_PERF_HAS_TSC
+// Read the counter once all the preceding instructions have completed and
+// before any of the following ones start.
+inline uint64_t readTscStart() {
+#if defined(__x86_64__)
+  _mm_lfence();
+  uint64_t tsc = __rdtsc();
+  _mm_lfence();
+  return tsc;
+#else
+  uint64_t tsc;
+  asm volatile("isb\n\tmrs %0, cntvct_el0" : "=r"(tsc) : : "memory");
+  return tsc;
+#endif
+}
+
+// Read the counter once all the measured instructions have completed.
+inline uint64_t readTscStop() {
+#if defined(__x86_64__)
+  unsigned aux;
+  uint64_t tsc = __rdtscp(&aux);
+  _mm_lfence();
+  return tsc;
+#else
+  return readTscStart();
+#endif
+}
+
+// Seconds per counter tick.
+double calibrateTsc() {
+#if defined(__x86_64__)
+  // The invariant TSC runs at a constant rate, measure it against the
+  // steady clock over a short interval.
+  auto clockStart = std::chrono::steady_clock::now();
+  uint64_t tscStart = readTscStart();
+  while (std::chrono::steady_clock::now() - clockStart <
+         std::chrono::milliseconds(10))
+    ;
+  uint64_t tscStop = readTscStop();
+  auto clockStop = std::chrono::steady_clock::now();
+  double seconds =
+      std::chrono::duration<double>(clockStop - clockStart).count();
+  return seconds / static_cast<double>(tscStop - tscStart);
+#else
+  // The generic timer frequency is architecturally exposed.
+  uint64_t freq;
+  asm volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+  return 1.0 / static_cast<double>(freq);
+#endif
+}
+#endif
+
+TimerKind readTimerKind() {
+#ifdef TPP_PERF_HAS_TSC
+  const char *env = getenv("TPP_PERF_TIMER");
+  if (env && strcmp(env, "tsc") == 0)
+    return TimerKind::Tsc;
+#endif
+  return TimerKind::Chrono;
+}
+
+// Thread-safe initialization of function local statics.
+TimerKind getTimerKind() {
+  static const TimerKind kind = readTimerKind();
+  return kind;
+}
+
+#ifdef TPP_PERF_HAS_TSC
+double getTscPeriod() {
+  static const double period = calibrateTsc();
+  return period;
+}
+
+// Calibrate at startup to keep it out of the first measurement.
+const bool tscCalibrated = getTimerKind() == TimerKind::Tsc && getTscPeriod();
+#endif
+
+} // namespace
+
 // Return the current timestamp.
 int64_t perf_start_timer() {
+#ifdef TPP_PERF_HAS_TSC
+  if (getTimerKind() == TimerKind::Tsc)
+    return static_cast<int64_t>(readTscStart());
+#endif
   auto timestamp = std::chrono::high_resolution_clock::now();
   return timestamp.time_since_epoch().count();
 }
 
 // Compute time delta between the starting time and now.
 double perf_stop_timer(int64_t startTimestamp) {
+#ifdef TPP_PERF_HAS_TSC
+  if (getTimerKind() == TimerKind::Tsc) {
+    uint64_t stop = readTscStop();
+    return static_cast<double>(stop - static_cast<uint64_t>(startTimestamp)) *
+           getTscPeriod();
+  }
+#endif
   auto stop = std::chrono::high_resolution_clock::now();
   std::chrono::high_resolution_clock::time_point start{
       std::chrono::high_resolution_clock::duration{startTimestamp}};
   return std::chrono::duration_cast<std::chrono::duration<double>>(stop - start)
       .count();
 }
+
+//===----------------------------------------------------------------------===//
+// JSON report
+//===----------------------------------------------------------------------===//
+//
+// Reported results are kept in order and printed as one JSON object to stdout
+// at exit. TPP_PERF_REPORT_HEADER may hold extra JSON members (without the
+// enclosing braces) which are printed first.
+//
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+struct PerfReport {
+  std::mutex lock;
+  std::vector<std::pair<std::string, std::string>> entries;
+  // Reported timer deltas, by key, for the host (see tpp_perf_get_samples).
+  std::map<std::string, std::vector<double>> samples;
+};
+
+PerfReport &getReport() {
+  static PerfReport report;
+  return report;
+}
+
+std::string escapeJson(const char *str) {
+  std::string escaped;
+  for (const char *c = str; *c; c++) {
+    if (*c == '"' || *c == '\\')
+      escaped += '\\';
+    escaped += *c;
+  }
+  return escaped;
+}
+
+void printReport() {
+  auto &report = getReport();
+  std::lock_guard<std::mutex> guard(report.lock);
+
+  printf("{");
+  const char *sep = "";
+  const char *header = getenv("TPP_PERF_REPORT_HEADER");
+  if (header && *header) {
+    printf("%s", header);
+    sep = ", ";
+  }
+  for (auto &entry : report.entries) {
+    printf("%s\"%s\": %s", sep, entry.first.c_str(), entry.second.c_str());
+    sep = ", ";
+  }
+  printf("}\n");
+  fflush(stdout);
+}
+
+void addReportEntry(UnrankedMemRefType<int8_t> *key, std::string value) {
+  DynamicMemRefType<int8_t> keyStr(*key);
+  auto &report = getReport();
+  std::lock_guard<std::mutex> guard(report.lock);
+  if (report.entries.empty())
+    atexit(printReport);
+  report.entries.emplace_back(
+      escapeJson(reinterpret_cast<const char *>(keyStr.data + keyStr.offset)),
+      std::move(value));
+}
+
+} // namespace
+
+void _mlir_ciface_perf_report_f64(UnrankedMemRefType<int8_t> *key,
+                                  double value) {
+  // JSON has no representation for NaN and infinity.
+  if (!std::isfinite(value)) {
+    addReportEntry(key, "null");
+    return;
+  }
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.9e", value);
+  addReportEntry(key, buf);
+}
+
+void _mlir_ciface_perf_report_i64(UnrankedMemRefType<int8_t> *key,
+                                  int64_t value) {
+  addReportEntry(key, std::to_string(value));
+}
+
+//===----------------------------------------------------------------------===//
+// Cache flush
+//===----------------------------------------------------------------------===//
+//
+// Caches are evicted by writing and reading back a scratch buffer twice the
+// size of the last level cache. The size can be overridden, in bytes, with
+// TPP_PERF_FLUSH_SIZE.
+//
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+size_t getFlushSize() {
+  if (const char *env = getenv("TPP_PERF_FLUSH_SIZE")) {
+    size_t size = strtoull(env, nullptr, 10);
+    if (size)
+      return size;
+  }
+
+  long llcSize = 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+  llcSize = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+  // Assume a large server LLC when it cannot be queried.
+  if (llcSize <= 0)
+    llcSize = 64 * 1024 * 1024;
+  return 2 * static_cast<size_t>(llcSize);
+}
+
+// Thread-safe initialization of function local statics.
+std::vector<char> &getFlushBuffer() {
+  static std::vector<char> buffer(getFlushSize());
+  return buffer;
+}
+
+} // namespace
+
+void perf_flush_cache() {
+  auto &buffer = getFlushBuffer();
+  // One access per cache line is enough to pull the whole line in.
+  constexpr size_t kLineSize = 64;
+  for (size_t i = 0; i < buffer.size(); i += kLineSize)
+    buffer[i]++;
+
+  // The volatile read keeps the stores from being optimized away.
+  volatile char sink = 0;
+  for (size_t i = 0; i < buffer.size(); i += kLineSize)
+    sink = sink + buffer[i];
+}
+
+//===----------------------------------------------------------------------===//
+// Threading
+//===----------------------------------------------------------------------===//
+
+// The OpenMP runtime is loaded along with the JIT-ed program, if used at all.
+// Look it up at runtime to avoid a hard dependency.
+void perf_set_num_threads(int64_t numThreads) {
+#ifdef __unix__
+  using SetNumThreadsFn = void (*)(int);
+  static auto setNumThreads = reinterpret_cast<SetNumThreadsFn>(
+      dlsym(RTLD_DEFAULT, "omp_set_num_threads"));
+  if (setNumThreads)
+    setNumThreads(static_cast<int>(numThreads));
+#endif
+}
+
+//===----------------------------------------------------------------------===//
+// Timer statistics
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+// Copy the deltas into contiguous storage.
+std::vector<double> getDeltas(UnrankedMemRefType<double> *deltas) {
+  DynamicMemRefType<double> buffer(*deltas);
+  std::vector<double> values(buffer.sizes[0]);
+  for (int64_t i = 0; i < buffer.sizes[0]; i++)
+    values[i] = buffer.data[buffer.offset + i * buffer.strides[0]];
+  return values;
+}
+
+// Percentile with linear interpolation between the closest ranks.
+double getPercentile(std::vector<double> values, double percentile) {
+  if (values.empty())
+    return 0.0;
+  double rank = percentile / 100.0 * static_cast<double>(values.size() - 1);
+  size_t lower = static_cast<size_t>(rank);
+  size_t upper = std::min(lower + 1, values.size() - 1);
+  std::nth_element(values.begin(), values.begin() + lower, values.end());
+  double lowerValue = values[lower];
+  double upperValue = lowerValue;
+  if (upper != lower)
+    upperValue = *std::min_element(values.begin() + upper, values.end());
+  return lowerValue + (rank - lower) * (upperValue - lowerValue);
+}
+
+} // namespace
+
+double _mlir_ciface_perf_min(UnrankedMemRefType<double> *deltas) {
+  auto values = getDeltas(deltas);
+  if (values.empty())
+    return 0.0;
+  return *std::min_element(values.begin(), values.end());
+}
+
+double _mlir_ciface_perf_max(UnrankedMemRefType<double> *deltas) {
+  auto values = getDeltas(deltas);
+  if (values.empty())
+    return 0.0;
+  return *std::max_element(values.begin(), values.end());
+}
+
+double _mlir_ciface_perf_mean(UnrankedMemRefType<double> *deltas) {
+  auto values = getDeltas(deltas);
+  if (values.empty())
+    return 0.0;
+  double sum = 0.0;
+  for (double value : values)
+    sum += value;
+  return sum / static_cast<double>(values.size());
+}
+
+double _mlir_ciface_perf_median(UnrankedMemRefType<double> *deltas) {
+  return getPercentile(getDeltas(deltas), 50.0);
+}
+
+double _mlir_ciface_perf_percentile(UnrankedMemRefType<double> *deltas,
+                                    double percentile) {
+  return getPercentile(getDeltas(deltas), percentile);
+}
+
+// Write the deltas to a file, one per line.
+void _mlir_ciface_perf_dump(UnrankedMemRefType<double> *deltas,
+                            UnrankedMemRefType<int8_t> *file) {
+  DynamicMemRefType<int8_t> fileName(*file);
+  const char *path =
+      reinterpret_cast<const char *>(fileName.data + fileName.offset);
+
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    fprintf(stderr, "perf.dump: cannot open '%s'\n", path);
+    return;
+  }
+  for (double value : getDeltas(deltas))
+    fprintf(out, "%.9e\n", value);
+  fclose(out);
+}
+
+// Report the deltas as a JSON array, and keep them for the host.
+void _mlir_ciface_perf_report_memref_f64(UnrankedMemRefType<int8_t> *key,
+                                         UnrankedMemRefType<double> *deltas) {
+  std::vector<double> values = getDeltas(deltas);
+  std::string array = "[";
+  for (size_t i = 0; i < values.size(); i++) {
+    if (i)
+      array += ", ";
+    // JSON has no representation for NaN and infinity.
+    if (!std::isfinite(values[i])) {
+      array += "null";
+      continue;
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.9e", values[i]);
+    array += buf;
+  }
+  array += "]";
+
+  DynamicMemRefType<int8_t> keyStr(*key);
+  {
+    auto &report = getReport();
+    std::lock_guard<std::mutex> guard(report.lock);
+    report.samples[reinterpret_cast<const char *>(
+        keyStr.data + keyStr.offset)] = values;
+  }
+  addReportEntry(key, std::move(array));
+}
+
+int64_t tpp_perf_get_samples(const char *key, double *samples,
+                             int64_t capacity) {
+  auto &report = getReport();
+  std::lock_guard<std::mutex> guard(report.lock);
+  auto it = report.samples.find(key);
+  if (it == report.samples.end())
+    return -1;
+  int64_t numSamples = static_cast<int64_t>(it->second.size());
+  std::copy(it->second.begin(),
+            it->second.begin() + std::min(numSamples, capacity), samples);
+  return numSamples;
+}
+
+//===----------------------------------------------------------------------===//
+// Hardware performance counters
+//===----------------------------------------------------------------------===//
+//
+// Counters are backed by perf_event_open on Linux. Each event is opened as an
+// independent counter such that events unsupported by the host (or denied by
+// perf_event_paranoid) do not prevent measuring the others.
+//
+// The events are inherited by the threads created after they are opened, and
+// read as the sum over all of them. They are opened when the runtime is
+// loaded, before the kernels start their worker threads (OpenMP, tasks), so
+// the work of these threads is counted too. Threads which already existed
+// are not counted, nor are the threads of counters started while the ones
+// opened at load are in use.
+//
+// L2 misses and floating-point operations (FMA, AMX) have no generic perf
+// event, their raw encoding is model specific. They can be provided as raw
+// event configs (same as `perf stat -e rXXXX`) through the
+// TPP_PERF_L2_MISS_EVENT and TPP_PERF_FLOPS_EVENT environment variables.
+//
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+// Must match perf::StopCountersOp::kNumEvents.
+constexpr int kNumPerfEvents = 6;
+
+struct PerfCounters {
+  int fds[kNumPerfEvents];
+  // Counts at the start. Those of the threads which exited before it are
+  // kept by the inherited events, they are not reset.
+  uint64_t startCounts[kNumPerfEvents];
+  // False for the counters opened at load, which are reused.
+  bool owned;
+};
+
+#ifdef __linux__
+int openPerfEvent(uint32_t type, uint64_t config) {
+  perf_event_attr attr{};
+  attr.size = sizeof(perf_event_attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(SYS_perf_event_open, &attr, /*pid=*/0, /*cpu=*/-1,
+                 /*group_fd=*/-1, /*flags=*/0);
+}
+
+int openRawPerfEvent(const char *envName) {
+  const char *env = getenv(envName);
+  if (!env)
+    return -1;
+  char *end = nullptr;
+  uint64_t config = strtoull(env, &end, 16);
+  if (end == env)
+    return -1;
+  return openPerfEvent(PERF_TYPE_RAW, config);
+}
+#endif
+
+// Opens the counters, disabled.
+PerfCounters *openCounters(bool owned) {
+  auto *counters = new PerfCounters;
+  counters->owned = owned;
+  for (int i = 0; i < kNumPerfEvents; i++)
+    counters->fds[i] = -1;
+
+#ifdef __linux__
+  constexpr uint64_t l1dReadMiss =
+      PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  counters->fds[0] =
+      openPerfEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+  counters->fds[1] =
+      openPerfEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  counters->fds[2] = openPerfEvent(PERF_TYPE_HW_CACHE, l1dReadMiss);
+  counters->fds[3] = openRawPerfEvent("TPP_PERF_L2_MISS_EVENT");
+  counters->fds[4] =
+      openPerfEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  counters->fds[5] = openRawPerfEvent("TPP_PERF_FLOPS_EVENT");
+#endif
+  return counters;
+}
+
+// Counters opened when the runtime is loaded, and whether they are in use.
+PerfCounters *const loadCounters = openCounters(/*owned=*/false);
+std::atomic<bool> loadCountersInUse{false};
+
+} // namespace
+
+// Enable the counters opened at load, or open new ones if they are in use.
+// Returns an opaque handle.
+int64_t perf_start_counters() {
+  PerfCounters *counters = loadCounters;
+  if (loadCountersInUse.exchange(true, std::memory_order_acquire))
+    counters = openCounters(/*owned=*/true);
+
+#ifdef __linux__
+  for (int i = 0; i < kNumPerfEvents; i++) {
+    int fd = counters->fds[i];
+    counters->startCounts[i] = 0;
+    if (fd < 0)
+      continue;
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    if (read(fd, &counters->startCounts[i], sizeof(uint64_t)) !=
+        sizeof(uint64_t))
+      counters->startCounts[i] = 0;
+  }
+#endif
+
+  return reinterpret_cast<int64_t>(counters);
+}
+
+// Stop the counters and write the counted events into the buffer.
+// Unavailable events are reported as -1.
+void _mlir_ciface_perf_stop_counters(int64_t handle,
+                                     UnrankedMemRefType<int64_t> *events) {
+  auto *counters = reinterpret_cast<PerfCounters *>(handle);
+  int64_t values[kNumPerfEvents];
+
+  for (int i = 0; i < kNumPerfEvents; i++) {
+    values[i] = -1;
+#ifdef __linux__
+    int fd = counters->fds[i];
+    if (fd < 0)
+      continue;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t count = 0;
+    if (read(fd, &count, sizeof(count)) == sizeof(count))
+      values[i] = static_cast<int64_t>(count - counters->startCounts[i]);
+    if (counters->owned)
+      close(fd);
+#endif
+  }
+  if (counters->owned)
+    delete counters;
+  else
+    loadCountersInUse.store(false, std::memory_order_release);
+
+  DynamicMemRefType<int64_t> buffer(*events);
+  int64_t numEvents = std::min<int64_t>(buffer.sizes[0], kNumPerfEvents);
+  for (int64_t i = 0; i < numEvents; i++)
+    buffer.data[buffer.offset + i * buffer.strides[0]] = values[i];
+}
+
+//===----------------------------------------------------------------------===//
+// Energy counters
+//===----------------------------------------------------------------------===//
+//
+// Energy is read from the RAPL counters of the package and DRAM domains of
+// every package of the host. The powercap interface of Linux is used first,
+// it exposes RAPL on Intel and, since Zen, on AMD (the package domain only).
+// Without it, the energy status MSRs are read through the msr driver
+// (/dev/cpu/N/msr). Both usually require elevated privileges, the domains
+// which cannot be read are reported as -1.
+//
+// The counters wrap around (after minutes of full load); a single wrap
+// between the start and the stop is accounted for.
+//
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+// Must match perf::StopEnergyOp::kNumDomains.
+constexpr int kNumEnergyDomains = 2;
+
+// An energy counter of a domain of a package: a powercap energy_uj file or an
+// energy status MSR.
+struct RaplCounter {
+  std::string file;
+  int msrFd = -1;
+  uint32_t msr = 0;
+  // Joules per unit of the counter and joules at which it wraps around.
+  double unit = 0.0;
+  double range = 0.0;
+};
+
+// Reads the counter in joules, or returns a negative value on failure.
+double readRaplCounter(const RaplCounter &counter) {
+#ifdef __linux__
+  if (counter.msrFd >= 0) {
+    uint64_t value = 0;
+    if (pread(counter.msrFd, &value, sizeof(value), counter.msr) !=
+        sizeof(value))
+      return -1.0;
+    return static_cast<double>(value & 0xffffffff) * counter.unit;
+  }
+  FILE *in = fopen(counter.file.c_str(), "r");
+  if (!in)
+    return -1.0;
+  unsigned long long value = 0;
+  int matched = fscanf(in, "%llu", &value);
+  fclose(in);
+  if (matched != 1)
+    return -1.0;
+  return static_cast<double>(value) * counter.unit;
+#else
+  return -1.0;
+#endif
+}
+
+// Reads the first line of a sysfs file, empty if it cannot be read.
+std::string readSysfsLine(const std::string &path) {
+  FILE *in = fopen(path.c_str(), "r");
+  if (!in)
+    return "";
+  char line[256] = {0};
+  if (!fgets(line, sizeof(line), in))
+    line[0] = '\0';
+  fclose(in);
+  std::string result(line);
+  while (!result.empty() && (result.back() == '\n' || result.back() == ' '))
+    result.pop_back();
+  return result;
+}
+
+// Adds the powercap zone at `path` to its domain if it can be read.
+void addPowercapZone(std::vector<RaplCounter> *domains,
+                     const std::string &path) {
+  std::string name = readSysfsLine(path + "/name");
+  int domain;
+  if (name.rfind("package", 0) == 0)
+    domain = 0;
+  else if (name == "dram")
+    domain = 1;
+  else
+    return;
+
+  RaplCounter counter;
+  counter.file = path + "/energy_uj";
+  counter.unit = 1e-6;
+  counter.range = atof(readSysfsLine(path + "/max_energy_range_uj").c_str()) *
+                  1e-6;
+  if (readRaplCounter(counter) >= 0.0)
+    domains[domain].push_back(counter);
+}
+
+void findPowercapCounters(std::vector<RaplCounter> *domains) {
+  const std::string root = "/sys/class/powercap/intel-rapl:";
+  for (int zone = 0;; zone++) {
+    std::string zonePath = root + std::to_string(zone);
+    if (readSysfsLine(zonePath + "/name").empty())
+      break;
+    addPowercapZone(domains, zonePath);
+    for (int subzone = 0;; subzone++) {
+      std::string subzonePath = zonePath + ":" + std::to_string(subzone);
+      if (readSysfsLine(subzonePath + "/name").empty())
+        break;
+      addPowercapZone(domains, subzonePath);
+    }
+  }
+}
+
+void findMsrCounters(std::vector<RaplCounter> *domains) {
+#ifdef __linux__
+  // Intel and AMD power unit and energy status MSRs.
+  constexpr uint32_t intelPowerUnit = 0x606;
+  constexpr uint32_t intelPkgEnergy = 0x611;
+  constexpr uint32_t intelDramEnergy = 0x619;
+  constexpr uint32_t amdPowerUnit = 0xc0010299;
+  constexpr uint32_t amdPkgEnergy = 0xc001029b;
+
+  // One CPU per package.
+  std::vector<std::string> packages;
+  for (int cpu = 0;; cpu++) {
+    std::string cpuPath =
+        "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    std::string package =
+        readSysfsLine(cpuPath + "/topology/physical_package_id");
+    if (package.empty())
+      break;
+    if (std::find(packages.begin(), packages.end(), package) !=
+        packages.end())
+      continue;
+    packages.push_back(package);
+
+    std::string msrPath = "/dev/cpu/" + std::to_string(cpu) + "/msr";
+    int fd = open(msrPath.c_str(), O_RDONLY);
+    if (fd < 0)
+      return;
+
+    uint64_t units = 0;
+    bool intel = pread(fd, &units, sizeof(units), intelPowerUnit) ==
+                 sizeof(units);
+    if (!intel &&
+        pread(fd, &units, sizeof(units), amdPowerUnit) != sizeof(units)) {
+      close(fd);
+      return;
+    }
+
+    // Energy status unit of 1 / 2^ESU joules, 32-bit counters.
+    RaplCounter counter;
+    counter.msrFd = fd;
+    counter.unit = 1.0 / static_cast<double>(1ull << ((units >> 8) & 0x1f));
+    counter.range = 4294967296.0 * counter.unit;
+    counter.msr = intel ? intelPkgEnergy : amdPkgEnergy;
+    if (readRaplCounter(counter) >= 0.0)
+      domains[0].push_back(counter);
+    counter.msr = intelDramEnergy;
+    if (intel && readRaplCounter(counter) >= 0.0)
+      domains[1].push_back(counter);
+  }
+#endif
+}
+
+// The counters of each domain, found once per process. The MSR files stay
+// open for the lifetime of the process.
+const std::vector<RaplCounter> *getRaplCounters() {
+  static std::vector<RaplCounter> domains[kNumEnergyDomains];
+  static std::once_flag found;
+  std::call_once(found, [] {
+    findPowercapCounters(domains);
+    if (domains[0].empty() && domains[1].empty())
+      findMsrCounters(domains);
+  });
+  return domains;
+}
+
+struct EnergyCounters {
+  std::vector<double> start[kNumEnergyDomains];
+};
+
+} // namespace
+
+// Read the energy counters. Returns an opaque handle.
+int64_t perf_start_energy() {
+  const std::vector<RaplCounter> *domains = getRaplCounters();
+  auto *energy = new EnergyCounters;
+  for (int i = 0; i < kNumEnergyDomains; i++) {
+    for (const RaplCounter &counter : domains[i])
+      energy->start[i].push_back(readRaplCounter(counter));
+  }
+  return reinterpret_cast<int64_t>(energy);
+}
+
+// Stop the energy counters and write the joules consumed since their start
+// into the buffer. Unavailable domains are reported as -1.
+void _mlir_ciface_perf_stop_energy(int64_t handle,
+                                   UnrankedMemRefType<double> *joules) {
+  const std::vector<RaplCounter> *domains = getRaplCounters();
+  auto *energy = reinterpret_cast<EnergyCounters *>(handle);
+  double values[kNumEnergyDomains];
+
+  for (int i = 0; i < kNumEnergyDomains; i++) {
+    values[i] = domains[i].empty() ? -1.0 : 0.0;
+    for (size_t j = 0; j < domains[i].size(); j++) {
+      double start = energy->start[i][j];
+      double stop = readRaplCounter(domains[i][j]);
+      if (stop < 0.0 || start < 0.0) {
+        values[i] = -1.0;
+        break;
+      }
+      double delta = stop - start;
+      if (delta < 0.0)
+        delta += domains[i][j].range;
+      values[i] += delta;
+    }
+  }
+  delete energy;
+
+  DynamicMemRefType<double> buffer(*joules);
+  int64_t numDomains = std::min<int64_t>(buffer.sizes[0], kNumEnergyDomains);
+  for (int64_t i = 0; i < numDomains; i++)
+    buffer.data[buffer.offset + i * buffer.strides[0]] = values[i];
+}
+
+//===----------------------------------------------------------------------===//
+// Device timers
+//===----------------------------------------------------------------------===//
+//
+// Device timers accumulate the execution time of the GPU kernels, as measured
+// on the device, excluding the launch latency and the synchronizations. On
+// CUDA, the kernel activity records of CUPTI are summed as they complete.
+// CUPTI is loaded at runtime such that the runtime does not depend on the
+// CUDA toolkit. When it is not available, the device timers fall back to the
+// host timers.
+//
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+// Subset of the CUPTI activity API, see cupti_activity.h.
+constexpr int kCuptiSuccess = 0;
+constexpr int kCuptiActivityKindConcurrentKernel = 10;
+constexpr uint32_t kCuptiActivityFlagFlushForced = 1;
+constexpr size_t kCuptiBufferBytes = size_t(1) << 20;
+constexpr size_t kCuptiBufferAlignment = 8;
+// All the CUpti_ActivityKernel records start with the same fields, the
+// kind is followed by the cache and register configurations, then by the
+// start and end timestamps in nanoseconds.
+constexpr size_t kCuptiKernelStartOffset = 16;
+
+struct CuptiRecord {
+  int kind;
+};
+
+using CuptiBufferRequestFn = void (*)(uint8_t **, size_t *, size_t *);
+using CuptiBufferCompleteFn = void (*)(void *, uint32_t, uint8_t *, size_t,
+                                       size_t);
+
+struct DeviceTimers {
+  int (*activityFlushAll)(uint32_t) = nullptr;
+  int (*activityGetNextRecord)(uint8_t *, size_t, CuptiRecord **) = nullptr;
+  std::atomic<uint64_t> kernelNanoseconds{0};
+  bool available = false;
+
+  static DeviceTimers &get() {
+    static DeviceTimers timers;
+    return timers;
+  }
+
+private:
+  DeviceTimers() {
+#ifdef __unix__
+    void *cupti = dlopen("libcupti.so", RTLD_NOW | RTLD_GLOBAL);
+    if (!cupti)
+      cupti = dlopen("libcupti.so.12", RTLD_NOW | RTLD_GLOBAL);
+    if (!cupti)
+      return;
+    auto registerCallbacks =
+        reinterpret_cast<int (*)(CuptiBufferRequestFn, CuptiBufferCompleteFn)>(
+            dlsym(cupti, "cuptiActivityRegisterCallbacks"));
+    auto enable =
+        reinterpret_cast<int (*)(int)>(dlsym(cupti, "cuptiActivityEnable"));
+    activityFlushAll = reinterpret_cast<int (*)(uint32_t)>(
+        dlsym(cupti, "cuptiActivityFlushAll"));
+    activityGetNextRecord =
+        reinterpret_cast<int (*)(uint8_t *, size_t, CuptiRecord **)>(
+            dlsym(cupti, "cuptiActivityGetNextRecord"));
+    if (!registerCallbacks || !enable || !activityFlushAll ||
+        !activityGetNextRecord)
+      return;
+    available =
+        registerCallbacks(requestBuffer, completeBuffer) == kCuptiSuccess &&
+        enable(kCuptiActivityKindConcurrentKernel) == kCuptiSuccess;
+#endif
+  }
+
+  static void requestBuffer(uint8_t **buffer, size_t *size,
+                            size_t *maxNumRecords) {
+    void *data = nullptr;
+    if (posix_memalign(&data, kCuptiBufferAlignment, kCuptiBufferBytes) != 0)
+      data = nullptr;
+    *buffer = static_cast<uint8_t *>(data);
+    *size = data ? kCuptiBufferBytes : 0;
+    *maxNumRecords = 0;
+  }
+
+  // Sums the durations of the completed kernels of the buffer.
+  static void completeBuffer(void *context, uint32_t streamId,
+                             uint8_t *buffer, size_t size, size_t validSize) {
+    DeviceTimers &timers = get();
+    CuptiRecord *record = nullptr;
+    uint64_t total = 0;
+    while (timers.activityGetNextRecord(buffer, validSize, &record) ==
+           kCuptiSuccess) {
+      if (record->kind != kCuptiActivityKindConcurrentKernel)
+        continue;
+      uint64_t timestamps[2];
+      memcpy(timestamps,
+             reinterpret_cast<char *>(record) + kCuptiKernelStartOffset,
+             sizeof(timestamps));
+      if (timestamps[1] > timestamps[0])
+        total += timestamps[1] - timestamps[0];
+    }
+    timers.kernelNanoseconds.fetch_add(total);
+    free(buffer);
+  }
+};
+
+} // namespace
+
+// Return the kernel time accumulated so far, or the current timestamp if
+// the device cannot be profiled.
+int64_t perf_start_device_timer() {
+  DeviceTimers &timers = DeviceTimers::get();
+  if (!timers.available)
+    return perf_start_timer();
+  timers.activityFlushAll(kCuptiActivityFlagFlushForced);
+  return static_cast<int64_t>(timers.kernelNanoseconds.load());
+}
+
+// Compute the kernel time accumulated since the timer was started. The
+// kernels are synchronized by their launches, all their records are flushed.
+double perf_stop_device_timer(int64_t start) {
+  DeviceTimers &timers = DeviceTimers::get();
+  if (!timers.available) {
+    static bool warned = false;
+    if (!warned)
+      fprintf(stderr, "perf: no device profiler, device timers report the "
+                      "host time\n");
+    warned = true;
+    return perf_stop_timer(start);
+  }
+  timers.activityFlushAll(kCuptiActivityFlagFlushForced);
+  uint64_t stop = timers.kernelNanoseconds.load();
+  return static_cast<double>(stop - static_cast<uint64_t>(start)) * 1e-9;
+}
+
+//===----------------------------------------------------------------------===//
+// Tensor files
+//===----------------------------------------------------------------------===//
+//
+// Tensor files are mapped privately, the kernel can write to its arguments
+// without changing the files. NumPy files are checked against the element
+// type and shape of the memref, raw files against the size of its data.
+//
+// The descriptor of the returned unranked memref is allocated with malloc,
+// the caller copies it and frees it, as for any unranked memref result.
+//
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+void mapFileError(const char *path, const std::string &msg) {
+  fprintf(stderr, "perf.map_file: '%s': %s\n", path, msg.c_str());
+  exit(EXIT_FAILURE);
+}
+
+// Returns the value of a key of the NumPy header dictionary, e.g. '<f4' for
+// 'descr', or an empty string if the key is missing.
+std::string getNpyHeaderValue(const std::string &header, const char *key) {
+  size_t pos = header.find(std::string("'") + key + "'");
+  if (pos == std::string::npos)
+    return "";
+  pos = header.find(':', pos);
+  if (pos == std::string::npos)
+    return "";
+  pos = header.find_first_not_of(' ', pos + 1);
+  if (pos == std::string::npos)
+    return "";
+
+  // Quoted string, tuple or bare word.
+  size_t end;
+  if (header[pos] == '\'')
+    end = header.find('\'', pos + 1) + 1;
+  else if (header[pos] == '(')
+    end = header.find(')', pos) + 1;
+  else
+    end = header.find_first_of(",}", pos);
+  if (end == std::string::npos || end == 0)
+    return "";
+  return header.substr(pos, end - pos);
+}
+
+// Checks the NumPy header and returns the offset of the data, or 0 if the
+// file is not a NumPy file.
+size_t parseNpyHeader(const char *path, const char *data, size_t size,
+                      const std::vector<std::string> &dtypes,
+                      const std::vector<int64_t> &shape) {
+  if (size < 10 || memcmp(data, "\x93NUMPY", 6) != 0)
+    return 0;
+
+  // Version 1 has a 16-bit header length, later versions 32-bit.
+  size_t headerLength;
+  size_t headerStart;
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+  if (bytes[6] == 1) {
+    headerLength = bytes[8] | (bytes[9] << 8);
+    headerStart = 10;
+  } else {
+    if (size < 12)
+      mapFileError(path, "truncated NumPy header");
+    headerLength = bytes[8] | (bytes[9] << 8) | (bytes[10] << 16) |
+                   (static_cast<size_t>(bytes[11]) << 24);
+    headerStart = 12;
+  }
+  if (headerStart + headerLength > size)
+    mapFileError(path, "truncated NumPy header");
+  std::string header(data + headerStart, headerLength);
+
+  // Element type, little endian or single byte.
+  std::string descr = getNpyHeaderValue(header, "descr");
+  if (descr.size() < 3)
+    mapFileError(path, "missing NumPy dtype");
+  descr = descr.substr(1, descr.size() - 2);
+  if (descr[0] == '>')
+    mapFileError(path, "big endian data is not supported");
+  if (descr[0] == '<' || descr[0] == '|' || descr[0] == '=')
+    descr = descr.substr(1);
+  if (std::find(dtypes.begin(), dtypes.end(), descr) == dtypes.end())
+    mapFileError(path, "unexpected NumPy dtype " + descr);
+
+  if (getNpyHeaderValue(header, "fortran_order") != "False")
+    mapFileError(path, "only C order arrays are supported");
+
+  // Shape, e.g. (4, 8) or (4,) or ().
+  std::string shapeStr = getNpyHeaderValue(header, "shape");
+  if (shapeStr.empty())
+    mapFileError(path, "missing NumPy shape");
+  std::vector<int64_t> fileShape;
+  const char *cursor = shapeStr.c_str() + 1;
+  while (true) {
+    char *end;
+    long long dim = strtoll(cursor, &end, 10);
+    if (end == cursor)
+      break;
+    fileShape.push_back(dim);
+    cursor = end;
+    while (*cursor == ',' || *cursor == ' ')
+      cursor++;
+  }
+  if (fileShape != shape)
+    mapFileError(path, "NumPy shape " + shapeStr +
+                           " does not match the memref shape");
+
+  return headerStart + headerLength;
+}
+
+// Returns the sizes held by a shape memref.
+std::vector<int64_t> getShape(UnrankedMemRefType<int64_t> *shape) {
+  DynamicMemRefType<int64_t> dims(*shape);
+  return std::vector<int64_t>(dims.data + dims.offset,
+                              dims.data + dims.offset + dims.sizes[0]);
+}
+
+// Sets the malloc'ed ranked descriptor of an unranked memref result:
+// allocated and aligned pointers, offset, sizes and row-major strides.
+template <typename T>
+void setResultDescriptor(UnrankedMemRefType<T> *result, void *base, T *data,
+                         const std::vector<int64_t> &sizes) {
+  int64_t rank = sizes.size();
+  char *descriptor = static_cast<char *>(
+      malloc(2 * sizeof(T *) + (1 + 2 * rank) * sizeof(int64_t)));
+  T **ptrs = reinterpret_cast<T **>(descriptor);
+  ptrs[0] = static_cast<T *>(base);
+  ptrs[1] = data;
+  int64_t *ints = reinterpret_cast<int64_t *>(descriptor + 2 * sizeof(T *));
+  ints[0] = 0;
+  int64_t stride = 1;
+  for (int64_t i = rank - 1; i >= 0; i--) {
+    ints[1 + i] = sizes[i];
+    ints[1 + rank + i] = stride;
+    stride *= sizes[i];
+  }
+
+  result->rank = rank;
+  result->descriptor = descriptor;
+}
+
+template <typename T>
+void mapFile(UnrankedMemRefType<T> *result, UnrankedMemRefType<int8_t> *file,
+             UnrankedMemRefType<int64_t> *shape,
+             const std::vector<std::string> &dtypes) {
+  DynamicMemRefType<int8_t> fileName(*file);
+  const char *path =
+      reinterpret_cast<const char *>(fileName.data + fileName.offset);
+  std::vector<int64_t> sizes = getShape(shape);
+
+  int64_t numElements = 1;
+  for (int64_t size : sizes)
+    numElements *= size;
+  size_t dataSize = numElements * sizeof(T);
+
+#ifdef __unix__
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    mapFileError(path, strerror(errno));
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+    close(fd);
+    mapFileError(path, "cannot read the file size");
+  }
+  size_t fileSize = fileStat.st_size;
+  void *base = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                    fd, /*offset=*/0);
+  close(fd);
+  if (base == MAP_FAILED)
+    mapFileError(path, strerror(errno));
+#else
+  size_t fileSize = 0;
+  void *base = nullptr;
+  mapFileError(path, "memory-mapped files are not supported");
+#endif
+
+  const char *bytes = static_cast<const char *>(base);
+  size_t dataOffset = parseNpyHeader(path, bytes, fileSize, dtypes, sizes);
+  if (fileSize - dataOffset != dataSize)
+    mapFileError(path, "expected " + std::to_string(dataSize) +
+                           " bytes of data but got " +
+                           std::to_string(fileSize - dataOffset));
+
+  setResultDescriptor(
+      result, base,
+      reinterpret_cast<T *>(static_cast<char *>(base) + dataOffset), sizes);
+}
+
+} // namespace
+
+#define DEFINE_PERF_MAP_FILE(suffix, type, ...)                                \
+  void _mlir_ciface_perf_map_file_##suffix(                                    \
+      UnrankedMemRefType<type> *result, UnrankedMemRefType<int8_t> *file,      \
+      UnrankedMemRefType<int64_t> *shape) {                                    \
+    mapFile(result, file, shape, std::vector<std::string>{__VA_ARGS__});       \
+  }
+
+DEFINE_PERF_MAP_FILE(f32, float, "f4")
+DEFINE_PERF_MAP_FILE(f64, double, "f8")
+DEFINE_PERF_MAP_FILE(f16, int16_t, "f2")
+// NumPy has no bf16, ml_dtypes saves it as an opaque 2-byte type.
+DEFINE_PERF_MAP_FILE(bf16, int16_t, "V2", "u2")
+DEFINE_PERF_MAP_FILE(i8, int8_t, "i1", "u1", "b1")
+DEFINE_PERF_MAP_FILE(i16, int16_t, "i2", "u2")
+DEFINE_PERF_MAP_FILE(i32, int32_t, "i4", "u4")
+DEFINE_PERF_MAP_FILE(i64, int64_t, "i8", "u8")
+
+#undef DEFINE_PERF_MAP_FILE
+
+//===----------------------------------------------------------------------===//
+// Weight blobs
+//===----------------------------------------------------------------------===//
+//
+// A weight blob holds the large constants of a module, written at compile
+// time by -externalize-constants: the 'TPPBLOB1' magic, then the data of each
+// constant at an aligned offset. The blob is mapped once per process, shared
+// and read-only, so that the processes running the same kernels share its
+// pages through the page cache. The mapping lives until the process exits.
+//
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+void mapBlobError(const char *path, const std::string &msg) {
+  fprintf(stderr, "perf.map_blob: '%s': %s\n", path, msg.c_str());
+  exit(EXIT_FAILURE);
+}
+
+struct MappedBlob {
+  void *base;
+  size_t size;
+};
+
+// Maps the blob on first use and returns the same mapping afterwards.
+MappedBlob getMappedBlob(const char *path) {
+  static std::mutex blobsMutex;
+  static std::map<std::string, MappedBlob> blobs;
+
+  std::lock_guard<std::mutex> lock(blobsMutex);
+  auto it = blobs.find(path);
+  if (it != blobs.end())
+    return it->second;
+
+#ifdef __unix__
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    mapBlobError(path, strerror(errno));
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+    close(fd);
+    mapBlobError(path, "cannot read the file size");
+  }
+  size_t fileSize = fileStat.st_size;
+  void *base = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd,
+                    /*offset=*/0);
+  close(fd);
+  if (base == MAP_FAILED)
+    mapBlobError(path, strerror(errno));
+#else
+  size_t fileSize = 0;
+  void *base = nullptr;
+  mapBlobError(path, "memory-mapped files are not supported");
+#endif
+
+  if (fileSize < 8 || memcmp(base, "TPPBLOB1", 8) != 0)
+    mapBlobError(path, "not a weight blob");
+
+  MappedBlob blob{base, fileSize};
+  blobs.emplace(path, blob);
+  return blob;
+}
+
+template <typename T>
+void mapBlob(UnrankedMemRefType<T> *result, UnrankedMemRefType<int8_t> *file,
+             UnrankedMemRefType<int64_t> *shape, int64_t offset) {
+  DynamicMemRefType<int8_t> fileName(*file);
+  const char *path =
+      reinterpret_cast<const char *>(fileName.data + fileName.offset);
+  std::vector<int64_t> sizes = getShape(shape);
+
+  int64_t numElements = 1;
+  for (int64_t size : sizes)
+    numElements *= size;
+  size_t dataSize = numElements * sizeof(T);
+
+  MappedBlob blob = getMappedBlob(path);
+  if (offset <= 0 || static_cast<size_t>(offset) + dataSize > blob.size)
+    mapBlobError(path, "no " + std::to_string(dataSize) +
+                           " bytes of data at offset " +
+                           std::to_string(offset));
+
+  setResultDescriptor(
+      result, blob.base,
+      reinterpret_cast<T *>(static_cast<char *>(blob.base) + offset), sizes);
+}
+
+} // namespace
+
+#define DEFINE_PERF_MAP_BLOB(suffix, type)                                     \
+  void _mlir_ciface_perf_map_blob_##suffix(                                    \
+      UnrankedMemRefType<type> *result, UnrankedMemRefType<int8_t> *file,      \
+      UnrankedMemRefType<int64_t> *shape, int64_t offset) {                    \
+    mapBlob(result, file, shape, offset);                                      \
+  }
+
+DEFINE_PERF_MAP_BLOB(f32, float)
+DEFINE_PERF_MAP_BLOB(f64, double)
+DEFINE_PERF_MAP_BLOB(f16, int16_t)
+DEFINE_PERF_MAP_BLOB(bf16, int16_t)
+DEFINE_PERF_MAP_BLOB(i8, int8_t)
+DEFINE_PERF_MAP_BLOB(i16, int16_t)
+DEFINE_PERF_MAP_BLOB(i32, int32_t)
+DEFINE_PERF_MAP_BLOB(i64, int64_t)
+
+#undef DEFINE_PERF_MAP_BLOB
+
+//===----------------------------------------------------------------------===//
+// Tensor initialization
+//===----------------------------------------------------------------------===//
+//
+// Fills tensors at startup with the same distributions as the compile-time
+// initializers (TensorInit), so large kernel arguments don't have to be
+// materialized as dense attributes.
+//
+// The tensor is split in blocks of a fixed size, distributed over the threads.
+// Each block has its own generator seeded with the seed and the block index,
+// so the values only depend on the seed, not on the number of threads.
+//
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+// Initializer kinds, as numbered by the perf.init_tensor lowering.
+enum InitKind {
+  kInitConstant = 0,
+  kInitSimple = 1,
+  kInitContinuous = 2,
+  kInitRandom = 3,
+  kInitNormal = 4,
+};
+
+// Number of elements filled with the same generator.
+constexpr int64_t kInitBlockSize = 1 << 16;
+
+// Round to nearest even, as the compile-time APFloat conversions.
+int16_t floatToBF16(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  bits += 0x7fff + ((bits >> 16) & 1);
+  return static_cast<int16_t>(bits >> 16);
+}
+
+// Round to nearest even, initializer values are always finite.
+int16_t floatToF16(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint16_t sign = (bits >> 16) & 0x8000;
+  int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = bits & 0x7fffff;
+
+  // Overflow saturates to infinity.
+  if (exponent >= 31)
+    return static_cast<int16_t>(sign | 0x7c00);
+
+  // Subnormal or zero, shift the implicit bit into the mantissa.
+  uint32_t shift = 13;
+  if (exponent <= 0) {
+    if (exponent < -10)
+      return static_cast<int16_t>(sign);
+    mantissa |= 0x800000;
+    shift = 14 - exponent;
+    exponent = 0;
+  }
+  uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> shift);
+  uint32_t rest = mantissa & ((1u << shift) - 1);
+  uint32_t halfway = 1u << (shift - 1);
+  // A carry into the exponent is still the correctly rounded value.
+  if (rest > halfway || (rest == halfway && (half & 1)))
+    half++;
+  return static_cast<int16_t>(sign | half);
+}
+
+template <typename T> T convertInitValue(float value) {
+  return static_cast<T>(value);
+}
+
+// Fills the block of elements [begin, end) of a tensor of size elements.
+template <typename T, T (*convert)(float)>
+void initTensorBlock(T *data, int64_t begin, int64_t end, int64_t size,
+                     int64_t kind, int64_t seed, bool isFloat) {
+  std::seed_seq seedSeq{static_cast<uint32_t>(seed),
+                        static_cast<uint32_t>(begin / kInitBlockSize)};
+  std::default_random_engine generator(seedSeq);
+  std::uniform_real_distribution<float> uniformFloat(0.0, 1.0);
+  std::normal_distribution<float> normalFloat(0.0, 0.2);
+  std::uniform_int_distribution<uint64_t> uniformInt(0, 255);
+  std::binomial_distribution<uint64_t> normalInt(255, 0.5);
+  const float simpleFloat[3] = {0.3f, 0.6f, 0.9f};
+
+  for (int64_t i = begin; i < end; i++) {
+    float value = 1.0f;
+    switch (kind) {
+    case kInitSimple:
+      value = isFloat ? simpleFloat[i % 3] : static_cast<float>(i % 3);
+      break;
+    case kInitContinuous:
+      value = static_cast<float>(i) / static_cast<float>(size);
+      if (!isFloat)
+        value = static_cast<float>(static_cast<uint64_t>(value * 255));
+      break;
+    case kInitRandom:
+      value = isFloat ? uniformFloat(generator)
+                      : static_cast<float>(uniformInt(generator));
+      break;
+    case kInitNormal:
+      value = isFloat
+                  ? std::min(std::max(normalFloat(generator), 0.0f), 1.0f)
+                  : static_cast<float>(normalInt(generator));
+      break;
+    default:
+      break;
+    }
+    data[i] = convert(value);
+  }
+}
+
+template <typename T, T (*convert)(float)>
+void initTensor(UnrankedMemRefType<T> *buffer, int64_t kind, int64_t seed,
+                bool isFloat) {
+  DynamicMemRefType<T> tensor(*buffer);
+  T *data = tensor.data + tensor.offset;
+  int64_t size = 1;
+  for (int64_t i = 0; i < buffer->rank; i++)
+    size *= tensor.sizes[i];
+
+  int64_t numBlocks = (size + kInitBlockSize - 1) / kInitBlockSize;
+  int64_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+  numThreads = std::min(numThreads, numBlocks);
+
+  auto worker = [=](int64_t thread) {
+    for (int64_t block = thread; block < numBlocks; block += numThreads) {
+      int64_t begin = block * kInitBlockSize;
+      int64_t end = std::min(begin + kInitBlockSize, size);
+      initTensorBlock<T, convert>(data, begin, end, size, kind, seed, isFloat);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int64_t thread = 1; thread < numThreads; thread++)
+    threads.emplace_back(worker, thread);
+  if (numThreads > 0)
+    worker(0);
+  for (auto &thread : threads)
+    thread.join();
+}
+
+} // namespace
+
+#define DEFINE_PERF_INIT_TENSOR(suffix, type, convert, isFloat)                \
+  void _mlir_ciface_perf_init_tensor_##suffix(                                 \
+      UnrankedMemRefType<type> *buffer, int64_t kind, int64_t seed) {          \
+    initTensor<type, convert>(buffer, kind, seed, isFloat);                    \
+  }
+
+DEFINE_PERF_INIT_TENSOR(f32, float, convertInitValue<float>, true)
+DEFINE_PERF_INIT_TENSOR(f64, double, convertInitValue<double>, true)
+DEFINE_PERF_INIT_TENSOR(f16, int16_t, floatToF16, true)
+DEFINE_PERF_INIT_TENSOR(bf16, int16_t, floatToBF16, true)
+DEFINE_PERF_INIT_TENSOR(i8, int8_t, convertInitValue<int8_t>, false)
+DEFINE_PERF_INIT_TENSOR(i16, int16_t, convertInitValue<int16_t>, false)
+DEFINE_PERF_INIT_TENSOR(i32, int32_t, convertInitValue<int32_t>, false)
+DEFINE_PERF_INIT_TENSOR(i64, int64_t, convertInitValue<int64_t>, false)
+
+#undef DEFINE_PERF_INIT_TENSOR
+
+//===----------------------------------------------------------------------===//
+// Tensor allocation
+//===----------------------------------------------------------------------===//
+//
+// Tensors are allocated with anonymous mappings, so that no page is touched
+// before the kernel arguments are initialized: explicit huge pages when
+// requested, falling back to transparent huge pages if the huge page pool is
+// empty, and optionally interleaved over all online NUMA nodes or sharded by
+// their outermost dimension over them.
+//
+// As for mapped files, the memory is released when the program exits.
+//
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+void allocError(const std::string &msg) {
+  fprintf(stderr, "perf.alloc: %s\n", msg.c_str());
+  exit(EXIT_FAILURE);
+}
+
+#ifdef __linux__
+const int kMaxNodes = 1024;
+const int kBitsPerWord = 8 * sizeof(unsigned long);
+
+// Returns the online NUMA nodes, as listed in sysfs (e.g. "0-1,3").
+std::vector<int> getOnlineNodes() {
+  std::vector<int> nodes;
+  FILE *online = fopen("/sys/devices/system/node/online", "r");
+  if (!online)
+    return nodes;
+  int first, last;
+  while (fscanf(online, "%d", &first) == 1) {
+    last = first;
+    int sep = fgetc(online);
+    if (sep == '-') {
+      if (fscanf(online, "%d", &last) != 1)
+        break;
+      sep = fgetc(online);
+    }
+    for (int node = first; node <= last && node < kMaxNodes; node++)
+      nodes.push_back(node);
+    if (sep != ',')
+      break;
+  }
+  fclose(online);
+  return nodes;
+}
+
+// Sets the NUMA policy `mode` of the pages [base, base + length) to `nodes`.
+void bindPages(void *base, size_t length, int mode,
+               const std::vector<int> &nodes, const char *what) {
+  std::vector<unsigned long> nodeMask(kMaxNodes / kBitsPerWord, 0);
+  for (int node : nodes)
+    nodeMask[node / kBitsPerWord] |= 1UL << (node % kBitsPerWord);
+  if (syscall(SYS_mbind, base, length, mode, nodeMask.data(), kMaxNodes + 1,
+              0) != 0)
+    fprintf(stderr, "perf.alloc: cannot %s pages: %s\n", what,
+            strerror(errno));
+}
+
+// Interleaves the pages of a mapping over the online NUMA nodes. Does nothing
+// on a single node.
+void interleavePages(void *base, size_t length) {
+  std::vector<int> nodes = getOnlineNodes();
+  if (nodes.size() <= 1)
+    return;
+  bindPages(base, length, MPOL_INTERLEAVE, nodes, "interleave");
+}
+
+// Splits the `outerSize` slices of the outermost dimension of a mapping into
+// contiguous ranges, one per online NUMA node in order, and places the pages
+// of each range on its node. The range boundaries are rounded to `alignment`,
+// the page size of the mapping. Does nothing on a single node.
+void shardPages(void *base, size_t size, size_t alignment, int64_t outerSize) {
+  std::vector<int> nodes = getOnlineNodes();
+  if (nodes.size() <= 1 || outerSize <= 0)
+    return;
+  int64_t numNodes = nodes.size();
+  size_t sliceBytes = size / outerSize;
+  auto getBoundary = [&](int64_t node) {
+    size_t bytes = sliceBytes * (outerSize * node / numNodes);
+    return (bytes + alignment / 2) / alignment * alignment;
+  };
+  char *data = static_cast<char *>(base);
+  for (int64_t node = 0; node < numNodes; node++) {
+    size_t begin = getBoundary(node);
+    size_t end = node + 1 == numNodes
+                     ? (size + alignment - 1) / alignment * alignment
+                     : getBoundary(node + 1);
+    // Prefer the node, so that a full node falls back to the others.
+    if (begin < end)
+      bindPages(data + begin, end - begin, MPOL_PREFERRED, {nodes[node]},
+                "shard");
+  }
+}
+#endif
+
+// Page placement policies, as numbered by the perf.alloc lowering.
+enum AllocPolicy : int64_t { kFirstTouch = 0, kInterleave = 1, kShard = 2 };
+
+void *allocPages(size_t size, int64_t pageSize, int64_t policy,
+                 int64_t outerSize) {
+#ifdef __linux__
+  size_t alignment = pageSize ? pageSize : sysconf(_SC_PAGESIZE);
+  size_t length = (std::max<size_t>(size, 1) + alignment - 1) / alignment *
+                  alignment;
+  int prot = PROT_READ | PROT_WRITE;
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+  void *base = MAP_FAILED;
+  if (pageSize) {
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+    int hugeFlags = MAP_HUGETLB | (__builtin_ctzll(pageSize) << MAP_HUGE_SHIFT);
+    base = mmap(nullptr, length, prot, flags | hugeFlags, -1, /*offset=*/0);
+    if (base == MAP_FAILED)
+      fprintf(stderr,
+              "perf.alloc: no %lld kB huge pages available, using "
+              "transparent huge pages\n",
+              static_cast<long long>(pageSize / 1024));
+  }
+  if (base == MAP_FAILED) {
+    base = mmap(nullptr, length, prot, flags, -1, /*offset=*/0);
+    if (base == MAP_FAILED)
+      allocError(strerror(errno));
+#ifdef MADV_HUGEPAGE
+    if (pageSize)
+      madvise(base, length, MADV_HUGEPAGE);
+#endif
+  }
+
+  if (policy == kInterleave)
+    interleavePages(base, length);
+  else if (policy == kShard)
+    shardPages(base, size, alignment, outerSize);
+  return base;
+#else
+  (void)outerSize;
+  if (pageSize || policy != kFirstTouch)
+    allocError("huge pages and NUMA policies are not supported");
+  void *base = nullptr;
+  if (posix_memalign(&base, 128, std::max<size_t>(size, 1)) != 0)
+    allocError("out of memory");
+  return base;
+#endif
+}
+
+template <typename T>
+void allocTensor(UnrankedMemRefType<T> *result,
+                 UnrankedMemRefType<int64_t> *shape, int64_t policy,
+                 int64_t pageSize) {
+  std::vector<int64_t> sizes = getShape(shape);
+  int64_t numElements = 1;
+  for (int64_t size : sizes)
+    numElements *= size;
+
+  int64_t outerSize = sizes.empty() ? 1 : sizes.front();
+  void *base =
+      allocPages(numElements * sizeof(T), pageSize, policy, outerSize);
+  setResultDescriptor(result, base, static_cast<T *>(base), sizes);
+}
+
+} // namespace
+
+#define DEFINE_PERF_ALLOC(suffix, type)                                        \
+  void _mlir_ciface_perf_alloc_##suffix(UnrankedMemRefType<type> *result,      \
+                                        UnrankedMemRefType<int64_t> *shape,    \
+                                        int64_t policy, int64_t pageSize) {    \
+    allocTensor(result, shape, policy, pageSize);                              \
+  }
+
+DEFINE_PERF_ALLOC(f32, float)
+DEFINE_PERF_ALLOC(f64, double)
+DEFINE_PERF_ALLOC(f16, int16_t)
+DEFINE_PERF_ALLOC(bf16, int16_t)
+DEFINE_PERF_ALLOC(i8, int8_t)
+DEFINE_PERF_ALLOC(i16, int16_t)
+DEFINE_PERF_ALLOC(i32, int32_t)
+DEFINE_PERF_ALLOC(i64, int64_t)
+
+#undef DEFINE_PERF_ALLOC
@@ -23,4 +23,180 @@ extern "C" MLIR_RUNNERUTILS_EXPORT int64_t perf_start_timer();
 
 extern "C" MLIR_RUNNERUTILS_EXPORT double perf_stop_timer(int64_t);
 
+extern "C" MLIR_RUNNERUTILS_EXPORT int64_t perf_start_device_timer();
+
+extern "C" MLIR_RUNNERUTILS_EXPORT double perf_stop_device_timer(int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT int64_t perf_start_counters();
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+_mlir_ciface_perf_stop_counters(int64_t, UnrankedMemRefType<int64_t> *);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT int64_t perf_start_energy();
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+_mlir_ciface_perf_stop_energy(int64_t, UnrankedMemRefType<double> *);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void perf_flush_cache();
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void perf_set_num_threads(int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT double
+_mlir_ciface_perf_min(UnrankedMemRefType<double> *);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT double
+_mlir_ciface_perf_max(UnrankedMemRefType<double> *);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT double
+_mlir_ciface_perf_mean(UnrankedMemRefType<double> *);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT double
+_mlir_ciface_perf_median(UnrankedMemRefType<double> *);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT double
+_mlir_ciface_perf_percentile(UnrankedMemRefType<double> *, double);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+_mlir_ciface_perf_dump(UnrankedMemRefType<double> *,
+                       UnrankedMemRefType<int8_t> *);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+_mlir_ciface_perf_report_f64(UnrankedMemRefType<int8_t> *, double);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+_mlir_ciface_perf_report_i64(UnrankedMemRefType<int8_t> *, int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+_mlir_ciface_perf_report_memref_f64(UnrankedMemRefType<int8_t> *,
+                                    UnrankedMemRefType<double> *);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_map_file_f32(
+    UnrankedMemRefType<float> *, UnrankedMemRefType<int8_t> *,
+    UnrankedMemRefType<int64_t> *);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_map_file_f64(
+    UnrankedMemRefType<double> *, UnrankedMemRefType<int8_t> *,
+    UnrankedMemRefType<int64_t> *);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_map_file_f16(
+    UnrankedMemRefType<int16_t> *, UnrankedMemRefType<int8_t> *,
+    UnrankedMemRefType<int64_t> *);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_map_file_bf16(
+    UnrankedMemRefType<int16_t> *, UnrankedMemRefType<int8_t> *,
+    UnrankedMemRefType<int64_t> *);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_map_file_i8(
+    UnrankedMemRefType<int8_t> *, UnrankedMemRefType<int8_t> *,
+    UnrankedMemRefType<int64_t> *);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_map_file_i16(
+    UnrankedMemRefType<int16_t> *, UnrankedMemRefType<int8_t> *,
+    UnrankedMemRefType<int64_t> *);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_map_file_i32(
+    UnrankedMemRefType<int32_t> *, UnrankedMemRefType<int8_t> *,
+    UnrankedMemRefType<int64_t> *);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_map_file_i64(
+    UnrankedMemRefType<int64_t> *, UnrankedMemRefType<int8_t> *,
+    UnrankedMemRefType<int64_t> *);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_map_blob_f32(
+    UnrankedMemRefType<float> *, UnrankedMemRefType<int8_t> *,
+    UnrankedMemRefType<int64_t> *, int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_map_blob_f64(
+    UnrankedMemRefType<double> *, UnrankedMemRefType<int8_t> *,
+    UnrankedMemRefType<int64_t> *, int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_map_blob_f16(
+    UnrankedMemRefType<int16_t> *, UnrankedMemRefType<int8_t> *,
+    UnrankedMemRefType<int64_t> *, int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_map_blob_bf16(
+    UnrankedMemRefType<int16_t> *, UnrankedMemRefType<int8_t> *,
+    UnrankedMemRefType<int64_t> *, int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_map_blob_i8(
+    UnrankedMemRefType<int8_t> *, UnrankedMemRefType<int8_t> *,
+    UnrankedMemRefType<int64_t> *, int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_map_blob_i16(
+    UnrankedMemRefType<int16_t> *, UnrankedMemRefType<int8_t> *,
+    UnrankedMemRefType<int64_t> *, int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_map_blob_i32(
+    UnrankedMemRefType<int32_t> *, UnrankedMemRefType<int8_t> *,
+    UnrankedMemRefType<int64_t> *, int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_map_blob_i64(
+    UnrankedMemRefType<int64_t> *, UnrankedMemRefType<int8_t> *,
+    UnrankedMemRefType<int64_t> *, int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_init_tensor_f32(
+    UnrankedMemRefType<float> *, int64_t, int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_init_tensor_f64(
+    UnrankedMemRefType<double> *, int64_t, int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_init_tensor_f16(
+    UnrankedMemRefType<int16_t> *, int64_t, int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_init_tensor_bf16(
+    UnrankedMemRefType<int16_t> *, int64_t, int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_init_tensor_i8(
+    UnrankedMemRefType<int8_t> *, int64_t, int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_init_tensor_i16(
+    UnrankedMemRefType<int16_t> *, int64_t, int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_init_tensor_i32(
+    UnrankedMemRefType<int32_t> *, int64_t, int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_init_tensor_i64(
+    UnrankedMemRefType<int64_t> *, int64_t, int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_alloc_f32(
+    UnrankedMemRefType<float> *, UnrankedMemRefType<int64_t> *, int64_t,
+    int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_alloc_f64(
+    UnrankedMemRefType<double> *, UnrankedMemRefType<int64_t> *, int64_t,
+    int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_alloc_f16(
+    UnrankedMemRefType<int16_t> *, UnrankedMemRefType<int64_t> *, int64_t,
+    int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_alloc_bf16(
+    UnrankedMemRefType<int16_t> *, UnrankedMemRefType<int64_t> *, int64_t,
+    int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_alloc_i8(
+    UnrankedMemRefType<int8_t> *, UnrankedMemRefType<int64_t> *, int64_t,
+    int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_alloc_i16(
+    UnrankedMemRefType<int16_t> *, UnrankedMemRefType<int64_t> *, int64_t,
+    int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_alloc_i32(
+    UnrankedMemRefType<int32_t> *, UnrankedMemRefType<int64_t> *, int64_t,
+    int64_t);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void _mlir_ciface_perf_alloc_i64(
+    UnrankedMemRefType<int64_t> *, UnrankedMemRefType<int64_t> *, int64_t,
+    int64_t);
+
+//===----------------------------------------------------------------------===//
+// Host interface
+//===----------------------------------------------------------------------===//
+
+// Copies up to `capacity` of the samples reported under `key` to `samples`.
+// Returns the number of samples reported under `key`, -1 if there are none.
+extern "C" MLIR_RUNNERUTILS_EXPORT int64_t
+tpp_perf_get_samples(const char *key, double *samples, int64_t capacity);
+
 #endif // TPP_EXECUTIONENGINE_PERFRUNNERUTILS_H
@@ -0,0 +1,107 @@
+//===- ScratchRunnerUtils.cpp - Thread-local scratch arena ----------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "ScratchRunnerUtils.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+// Buffers are aligned to a cache line, chunks to a page.
+constexpr int64_t kAlignment = 64;
+constexpr size_t kChunkAlignment = 4096;
+constexpr int64_t kMinChunkBytes = 1 << 20;
+
+int64_t alignTo(int64_t value, int64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// The arena is a stack of bytes in a logical space of offsets. The current
+// chunk backs the offsets from `chunkStart`. When it is full, a bigger chunk
+// takes over the next offsets, and the previous chunks are kept until the
+// arena is empty since their buffers may still be in use.
+struct ScratchArena {
+  char *chunk = nullptr;
+  int64_t chunkStart = 0;
+  int64_t chunkBytes = 0;
+  int64_t top = 0;
+  std::vector<char *> retiredChunks;
+
+  ~ScratchArena() { release(); }
+
+  void *get(int64_t bytes) {
+    int64_t size = alignTo(std::max<int64_t>(bytes, 1), kAlignment);
+    // The start of a chunk is aligned, so are the offsets from it.
+    int64_t offset = chunkStart + alignTo(top - chunkStart, kAlignment);
+    if (!chunk || offset + size > chunkStart + chunkBytes) {
+      grow(size);
+      offset = chunkStart;
+    }
+    top = offset + size;
+    return chunk + (offset - chunkStart);
+  }
+
+  void reset(int64_t mark) {
+    top = mark;
+    // The buffers of the current chunk are all released.
+    chunkStart = std::min(chunkStart, mark);
+    if (mark == 0) {
+      for (char *retired : retiredChunks)
+        free(retired);
+      retiredChunks.clear();
+    }
+  }
+
+  void release() {
+    reset(0);
+    free(chunk);
+    chunk = nullptr;
+    chunkBytes = 0;
+  }
+
+private:
+  void grow(int64_t size) {
+    if (chunk)
+      retiredChunks.push_back(chunk);
+    int64_t bytes = std::max({size, 2 * chunkBytes, kMinChunkBytes});
+    bytes = alignTo(bytes, static_cast<int64_t>(kChunkAlignment));
+    void *data = nullptr;
+    if (posix_memalign(&data, kChunkAlignment, static_cast<size_t>(bytes)) !=
+        0) {
+      fprintf(stderr, "tpp_scratch_get: out of memory\n");
+      abort();
+    }
+    chunk = static_cast<char *>(data);
+    chunkBytes = bytes;
+    chunkStart = top;
+  }
+};
+
+thread_local ScratchArena arena;
+
+} // namespace
+
+int64_t tpp_scratch_mark() { return arena.top; }
+
+void _mlir_ciface_tpp_scratch_get(StridedMemRefType<int8_t, 1> *result,
+                                  int64_t bytes) {
+  auto *data = static_cast<int8_t *>(arena.get(bytes));
+  result->basePtr = data;
+  result->data = data;
+  result->offset = 0;
+  result->sizes[0] = bytes;
+  result->strides[0] = 1;
+}
+
+void tpp_scratch_reset(int64_t mark) { arena.reset(mark); }
+
+void tpp_scratch_release() { arena.release(); }
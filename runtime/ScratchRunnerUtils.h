@@ -0,0 +1,49 @@
+//===- ScratchRunnerUtils.h - Thread-local scratch arena ------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Per-thread arena of the transient buffers of the parallel loops, e.g. the
+// packed blocks, split-K partials or transposes of an iteration. Buffers are
+// bump-allocated, aligned to a cache line, and released together by resetting
+// the arena to a mark taken at the start of the iteration. The arena of a
+// thread grows to the peak of its iterations and is then reused, so the
+// steady state has no allocation and the big tiles do not live on the stack.
+//
+// A buffer is only valid on the thread that got it, until the arena of the
+// thread is reset below it.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TPP_EXECUTIONENGINE_SCRATCHRUNNERUTILS_H
+#define TPP_EXECUTIONENGINE_SCRATCHRUNNERUTILS_H
+
+#include "mlir/ExecutionEngine/RunnerUtils.h"
+
+//===----------------------------------------------------------------------===//
+// Compiler interface, see the convert-allocs-to-scratch pass
+//===----------------------------------------------------------------------===//
+
+// Returns the current top of the arena of the calling thread.
+extern "C" MLIR_RUNNERUTILS_EXPORT int64_t tpp_scratch_mark();
+
+// Returns a buffer of `bytes` bytes of the arena of the calling thread.
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+_mlir_ciface_tpp_scratch_get(StridedMemRefType<int8_t, 1> *result,
+                             int64_t bytes);
+
+// Releases the buffers of the arena of the calling thread got after `mark`.
+extern "C" MLIR_RUNNERUTILS_EXPORT void tpp_scratch_reset(int64_t mark);
+
+//===----------------------------------------------------------------------===//
+// User interface
+//===----------------------------------------------------------------------===//
+
+// Releases the memory of the arena of the calling thread. It must not hold
+// any buffer in use.
+extern "C" MLIR_RUNNERUTILS_EXPORT void tpp_scratch_release();
+
+#endif // TPP_EXECUTIONENGINE_SCRATCHRUNNERUTILS_H
@@ -0,0 +1,307 @@
+//===- TaskRunnerUtils.cpp - Work-stealing task runtime -------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "TaskRunnerUtils.h"
+#include "TraceRunnerUtils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <initializer_list>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+using TaskFn = void (*)(int64_t, int64_t, void *);
+
+// Idle workers spin this many times before they sleep.
+constexpr int kSpinIterations = 1 << 16;
+// Each thread takes its iterations in about this many chunks.
+constexpr int64_t kChunksPerThread = 8;
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+class SpinLock {
+public:
+  void lock() {
+    while (locked.exchange(true, std::memory_order_acquire))
+      cpuRelax();
+  }
+  void unlock() { locked.store(false, std::memory_order_release); }
+
+private:
+  std::atomic<bool> locked{false};
+};
+
+// The remaining iterations [begin, end) of a thread. The owner takes chunks
+// from the front, the thieves take half from the back. Padded to a cache line
+// to keep the threads off each other's lines.
+struct WorkRange {
+  SpinLock lock;
+  int64_t begin = 0;
+  int64_t end = 0;
+  char padding[64 - 3 * sizeof(int64_t)];
+};
+
+int readNumThreads() {
+  for (const char *name : {"TPP_NUM_THREADS", "OMP_NUM_THREADS"}) {
+    if (const char *value = std::getenv(name)) {
+      int numThreads = std::atoi(value);
+      if (numThreads > 0)
+        return numThreads;
+    }
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Reads the CPUs of the threads, in thread order, from TPP_THREAD_CPUS.
+std::vector<int> readThreadCpus() {
+  std::vector<int> cpus;
+  if (const char *value = std::getenv("TPP_THREAD_CPUS")) {
+    std::istringstream list(value);
+    std::string cpu;
+    while (std::getline(list, cpu, ','))
+      cpus.push_back(std::atoi(cpu.c_str()));
+  }
+  return cpus;
+}
+
+// Binds the calling thread to `cpu`.
+void bindToCpu(int cpu) {
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+  (void)cpu;
+#endif
+}
+
+// Set on the threads running a task, the loops they start run inline.
+thread_local bool inTask = false;
+
+class TaskPool {
+public:
+  // Starts the workers, the threads 1 to numThreads - 1. The thread i is bound
+  // to the CPU i of `cpus`, if any, the calling thread too with `bindCaller`.
+  TaskPool(int64_t numThreads, std::vector<int> cpus, bool bindCaller)
+      : numThreads(numThreads), ranges(numThreads), cpus(std::move(cpus)) {
+    if (bindCaller)
+      bindThread(0);
+    for (int64_t t = 1; t < numThreads; ++t)
+      workers.emplace_back(&TaskPool::workerLoop, this, t);
+  }
+
+  ~TaskPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleepMutex);
+      stop.store(true);
+      wakeUp.notify_all();
+    }
+    for (std::thread &worker : workers)
+      worker.join();
+  }
+
+  // The default pool, the first thread to use it is the thread 0.
+  static TaskPool &get() {
+    static TaskPool pool(readNumThreads(), readThreadCpus(),
+                         /*bindCaller=*/true);
+    return pool;
+  }
+
+  static TaskPool &getCurrent();
+
+  // Binds the thread `id` to its CPU, if any.
+  void bindThread(int64_t id) {
+    if (!cpus.empty())
+      bindToCpu(cpus[id % cpus.size()]);
+  }
+
+  int64_t getNumThreads() const { return numThreads; }
+
+  void parallelFor(TaskFn task, void *context, int64_t numIterations) {
+    if (numIterations <= 0)
+      return;
+    if (inTask || numThreads == 1 || numIterations == 1) {
+      task(0, numIterations, context);
+      return;
+    }
+
+    tpp_trace::ScopedEvent loopEvent("parallel", "parallel");
+    std::lock_guard<std::mutex> jobLock(jobMutex);
+    this->task = task;
+    this->context = context;
+    grain = std::max<int64_t>(1,
+                              numIterations / (numThreads * kChunksPerThread));
+    // The workers are idle, the job is published by the generation.
+    for (int64_t t = 0; t < numThreads; ++t) {
+      ranges[t].begin = numIterations * t / numThreads;
+      ranges[t].end = numIterations * (t + 1) / numThreads;
+    }
+    pending.store(static_cast<int>(numThreads - 1));
+    generation.fetch_add(1);
+    if (sleepers.load() > 0) {
+      std::lock_guard<std::mutex> lock(sleepMutex);
+      wakeUp.notify_all();
+    }
+
+    inTask = true;
+    runJob(0);
+    inTask = false;
+    tpp_trace::ScopedEvent joinEvent("barrier", "barrier");
+    while (pending.load(std::memory_order_acquire) != 0)
+      cpuRelax();
+  }
+
+private:
+  void workerLoop(int64_t id) {
+    bindThread(id);
+    inTask = true;
+    uint64_t seen = 0;
+    while (true) {
+      // Spin, then sleep, until the next job.
+      int spins = 0;
+      while (generation.load() == seen && !stop.load()) {
+        if (++spins < kSpinIterations) {
+          cpuRelax();
+          continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers.fetch_add(1);
+        wakeUp.wait(lock,
+                    [&] { return generation.load() != seen || stop.load(); });
+        sleepers.fetch_sub(1);
+        spins = 0;
+      }
+      if (stop.load())
+        return;
+      seen = generation.load();
+      runJob(id);
+      pending.fetch_sub(1, std::memory_order_release);
+    }
+  }
+
+  // Runs the iterations of thread `id`, then the stolen ones.
+  void runJob(int64_t id) {
+    tpp_trace::ScopedEvent taskEvent("task", "parallel");
+    int64_t begin, end;
+    do {
+      while (takeChunk(id, begin, end))
+        task(begin, end, context);
+    } while (steal(id));
+  }
+
+  bool takeChunk(int64_t id, int64_t &begin, int64_t &end) {
+    WorkRange &range = ranges[id];
+    range.lock.lock();
+    bool found = range.begin < range.end;
+    if (found) {
+      begin = range.begin;
+      end = std::min(range.end, range.begin + grain);
+      range.begin = end;
+    }
+    range.lock.unlock();
+    return found;
+  }
+
+  // Moves half of the remaining iterations of another thread to `thief`.
+  bool steal(int64_t thief) {
+    for (int64_t i = 1; i < numThreads; ++i) {
+      WorkRange &victim = ranges[(thief + i) % numThreads];
+      victim.lock.lock();
+      int64_t remaining = victim.end - victim.begin;
+      int64_t begin = victim.end - (remaining + 1) / 2;
+      int64_t end = victim.end;
+      if (remaining > 0)
+        victim.end = begin;
+      victim.lock.unlock();
+      if (remaining <= 0)
+        continue;
+      WorkRange &range = ranges[thief];
+      range.lock.lock();
+      range.begin = begin;
+      range.end = end;
+      range.lock.unlock();
+      return true;
+    }
+    return false;
+  }
+
+  const int64_t numThreads;
+  std::vector<WorkRange> ranges;
+  std::vector<int> cpus;
+  std::vector<std::thread> workers;
+
+  // The current job.
+  std::mutex jobMutex;
+  TaskFn task = nullptr;
+  void *context = nullptr;
+  int64_t grain = 1;
+  std::atomic<uint64_t> generation{0};
+  std::atomic<int> pending{0};
+
+  // Sleeping workers.
+  std::mutex sleepMutex;
+  std::condition_variable wakeUp;
+  std::atomic<int> sleepers{0};
+  std::atomic<bool> stop{false};
+};
+
+// The team of the calling thread, the default pool if none.
+thread_local TaskPool *currentTeam = nullptr;
+
+TaskPool &TaskPool::getCurrent() {
+  return currentTeam ? *currentTeam : get();
+}
+
+} // namespace
+
+void tpp_parallel_for(void (*task)(int64_t, int64_t, void *), void *context,
+                      int64_t numIterations) {
+  TaskPool::getCurrent().parallelFor(task, context, numIterations);
+}
+
+int64_t tpp_tasks_num_threads() {
+  return TaskPool::getCurrent().getNumThreads();
+}
+
+void *tpp_tasks_create_team(const int32_t *cpus, int64_t numCpus) {
+  if (numCpus <= 0)
+    return nullptr;
+  return new TaskPool(numCpus, std::vector<int>(cpus, cpus + numCpus),
+                      /*bindCaller=*/false);
+}
+
+void tpp_tasks_destroy_team(void *team) {
+  delete static_cast<TaskPool *>(team);
+}
+
+void tpp_tasks_set_team(void *team) {
+  currentTeam = static_cast<TaskPool *>(team);
+  if (currentTeam)
+    currentTeam->bindThread(0);
+}
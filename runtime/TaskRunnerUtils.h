@@ -0,0 +1,67 @@
+//===- TaskRunnerUtils.h - Work-stealing task runtime ---------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Thread pool running the parallel loops, as an alternative to OpenMP. The
+// workers are started on the first loop and persist, they spin for a while
+// between the loops so that back-to-back layers do not pay a fork-join. The
+// iterations of a loop are split evenly between the threads, each one takes
+// its own by chunks and steals half of the remaining iterations of another
+// thread when it runs out, which absorbs imbalanced iterations.
+//
+// The calling thread takes part in the loop. A loop started from a task runs
+// sequentially in it. The number of threads is read from TPP_NUM_THREADS,
+// then OMP_NUM_THREADS, and defaults to the number of hardware threads. With
+// TPP_THREAD_CPUS, a comma-separated list of CPUs, the thread i is bound to the
+// CPU i of the list, the calling thread being the thread 0.
+//
+// Kernels running concurrently in a process share the pool, their loops take
+// turns. To run them side by side instead, each one on its own cores, the
+// threads calling them join teams: pools of their own, bound to disjoint sets
+// of CPUs. The loops started by a thread run on its team, or on the default
+// pool above if it joined none.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TPP_EXECUTIONENGINE_TASKRUNNERUTILS_H
+#define TPP_EXECUTIONENGINE_TASKRUNNERUTILS_H
+
+#include "mlir/ExecutionEngine/RunnerUtils.h"
+
+//===----------------------------------------------------------------------===//
+// Compiler interface, see the convert-parallel-to-tasks pass
+//===----------------------------------------------------------------------===//
+
+// Runs the iterations [0, numIterations) of a loop on the pool. `task` runs
+// the iterations [begin, end) with the values of the loop in `context`.
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+tpp_parallel_for(void (*task)(int64_t begin, int64_t end, void *context),
+                 void *context, int64_t numIterations);
+
+//===----------------------------------------------------------------------===//
+// User interface
+//===----------------------------------------------------------------------===//
+
+// Returns the number of threads of the pool of the calling thread, itself
+// included.
+extern "C" MLIR_RUNNERUTILS_EXPORT int64_t tpp_tasks_num_threads();
+
+// Creates a team of `numCpus` threads, the thread i bound to `cpus[i]`. The
+// thread joining it takes the place of the thread 0.
+extern "C" MLIR_RUNNERUTILS_EXPORT void *
+tpp_tasks_create_team(const int32_t *cpus, int64_t numCpus);
+
+// Stops the threads of `team`. No thread may still run loops on it.
+extern "C" MLIR_RUNNERUTILS_EXPORT void tpp_tasks_destroy_team(void *team);
+
+// Runs the loops the calling thread starts on `team`, and binds the thread to
+// the first CPU of the team. A null team leaves it, back to the default pool.
+// The thread stays bound when it leaves. A team takes a single thread at a
+// time.
+extern "C" MLIR_RUNNERUTILS_EXPORT void tpp_tasks_set_team(void *team);
+
+#endif // TPP_EXECUTIONENGINE_TASKRUNNERUTILS_H
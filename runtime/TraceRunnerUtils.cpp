@@ -0,0 +1,320 @@
+//===- TraceRunnerUtils.cpp - Per-thread timeline tracing -----------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Each thread appends its events to its own buffer, registered once under a
+// lock, so recording an event never synchronizes with the other threads. The
+// buffers are never released, the events of the threads that already exited
+// are written too. The trace is written when the process exits, once the
+// parallel regions are over.
+//
+// The OpenMP regions are traced through OMPT: libomp looks up the
+// ompt_start_tool symbol at startup, and this library provides it when the
+// OpenMP tools interface is available.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TraceRunnerUtils.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#if defined(__has_include)
+#if __has_include(<omp-tools.h>)
+#include <omp-tools.h>
+#define TPP_TRACE_HAS_OMPT 1
+#endif
+#endif
+
+namespace {
+
+constexpr uint64_t kDefaultXsmmSample = 64;
+
+struct Event {
+  const char *name;
+  const char *category;
+  const char *detail;
+  uint64_t begin;
+  uint64_t end;
+};
+
+// A region begun by perf_trace_begin.
+struct OpenRegion {
+  const char *name;
+  uint64_t begin;
+};
+
+struct ThreadTrace {
+  int64_t tid;
+  std::vector<Event> events;
+  std::vector<OpenRegion> regions;
+  uint64_t xsmmCalls = 0;
+};
+
+struct Trace {
+  std::string path;
+  uint64_t xsmmSample = kDefaultXsmmSample;
+  uint64_t start = 0;
+
+  std::mutex lock;
+  std::vector<ThreadTrace *> threads;
+  // Names of the marked regions, interned so that events can point to them.
+  std::set<std::string> names;
+};
+
+uint64_t readClock() {
+  auto timestamp = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp)
+      .count();
+}
+
+Trace &getTrace() {
+  static Trace trace;
+  return trace;
+}
+
+ThreadTrace *createThreadTrace() {
+  Trace &trace = getTrace();
+  ThreadTrace *thread = new ThreadTrace;
+  std::lock_guard<std::mutex> guard(trace.lock);
+  thread->tid = static_cast<int64_t>(trace.threads.size());
+  trace.threads.push_back(thread);
+  return thread;
+}
+
+ThreadTrace &getThreadTrace() {
+  static thread_local ThreadTrace *thread = createThreadTrace();
+  return *thread;
+}
+
+const char *internName(const char *name) {
+  Trace &trace = getTrace();
+  std::lock_guard<std::mutex> guard(trace.lock);
+  return trace.names.insert(name).first->c_str();
+}
+
+void writeJsonString(FILE *file, const char *str) {
+  fputc('"', file);
+  for (const char *c = str; *c; c++) {
+    if (*c == '"' || *c == '\\')
+      fputc('\\', file);
+    fputc(*c, file);
+  }
+  fputc('"', file);
+}
+
+// Replaces the "%p" of the file name with the process id.
+std::string getTracePath(const std::string &path, long pid) {
+  std::string result = path;
+  size_t pos = result.find("%p");
+  if (pos != std::string::npos)
+    result.replace(pos, 2, std::to_string(pid));
+  return result;
+}
+
+void writeTrace() {
+  Trace &trace = getTrace();
+  std::lock_guard<std::mutex> guard(trace.lock);
+  long pid = static_cast<long>(getpid());
+  std::string path = getTracePath(trace.path, pid);
+  FILE *file = fopen(path.c_str(), "w");
+  if (!file) {
+    fprintf(stderr, "TPP_TRACE: cannot open %s\n", path.c_str());
+    return;
+  }
+
+  // Timestamps are in microseconds from the start of the trace.
+  fprintf(file, "{\"traceEvents\":[\n");
+  bool first = true;
+  for (const ThreadTrace *thread : trace.threads) {
+    fprintf(file,
+            "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,"
+            "\"tid\":%lld,\"args\":{\"name\":\"thread %lld\"}}",
+            first ? "" : ",\n", pid, static_cast<long long>(thread->tid),
+            static_cast<long long>(thread->tid));
+    first = false;
+    for (const Event &event : thread->events) {
+      fprintf(file, ",\n{\"name\":");
+      writeJsonString(file, event.name);
+      fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                    "\"pid\":%ld,\"tid\":%lld",
+              event.category, (event.begin - trace.start) * 1e-3,
+              (event.end - event.begin) * 1e-3, pid,
+              static_cast<long long>(thread->tid));
+      if (event.detail) {
+        fprintf(file, ",\"args\":{\"detail\":");
+        writeJsonString(file, event.detail);
+        fputc('}', file);
+      }
+      fputc('}', file);
+    }
+  }
+  fprintf(file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+  fclose(file);
+}
+
+bool readEnabled() {
+  const char *env = getenv("TPP_TRACE");
+  if (!env || !*env)
+    return false;
+
+  Trace &trace = getTrace();
+  trace.path = env;
+  if (const char *sample = getenv("TPP_TRACE_XSMM_SAMPLE")) {
+    long long value = atoll(sample);
+    trace.xsmmSample = value > 0 ? static_cast<uint64_t>(value) : 1;
+  }
+  trace.start = readClock();
+  atexit(writeTrace);
+  return true;
+}
+
+} // namespace
+
+namespace tpp_trace {
+
+bool isEnabled() {
+  // Thread-safe initialization of function local statics.
+  static const bool enabled = readEnabled();
+  return enabled;
+}
+
+uint64_t now() { return readClock(); }
+
+bool sampleXsmmCall() {
+  if (!isEnabled())
+    return false;
+  ThreadTrace &thread = getThreadTrace();
+  return thread.xsmmCalls++ % getTrace().xsmmSample == 0;
+}
+
+void recordEvent(const char *name, const char *category, uint64_t begin,
+                 uint64_t end, const char *detail) {
+  if (!isEnabled())
+    return;
+  Event event = {name, category, detail, begin, end};
+  getThreadTrace().events.push_back(event);
+}
+
+ScopedEvent::ScopedEvent(const char *name, const char *category)
+    : name(name), category(category), begin(isEnabled() ? now() : 0) {}
+
+ScopedEvent::~ScopedEvent() {
+  if (begin)
+    recordEvent(name, category, begin, now());
+}
+
+} // namespace tpp_trace
+
+void _mlir_ciface_perf_trace_begin(UnrankedMemRefType<int8_t> *name) {
+  if (!tpp_trace::isEnabled())
+    return;
+  DynamicMemRefType<int8_t> nameRef(*name);
+  const char *str = reinterpret_cast<const char *>(nameRef.data);
+  OpenRegion region = {internName(str), tpp_trace::now()};
+  getThreadTrace().regions.push_back(region);
+}
+
+void perf_trace_end() {
+  if (!tpp_trace::isEnabled())
+    return;
+  ThreadTrace &thread = getThreadTrace();
+  // An unmatched end is ignored.
+  if (thread.regions.empty())
+    return;
+  OpenRegion region = thread.regions.back();
+  thread.regions.pop_back();
+  tpp_trace::recordEvent(region.name, "perf", region.begin, tpp_trace::now());
+}
+
+//===----------------------------------------------------------------------===//
+// OpenMP tool
+//===----------------------------------------------------------------------===//
+
+#ifdef TPP_TRACE_HAS_OMPT
+
+namespace {
+
+// The begin of the parallel regions and of the implicit tasks are kept in
+// their OMPT data, barriers do not nest.
+thread_local uint64_t barrierBegin = 0;
+
+void onParallelBegin(ompt_data_t *, const ompt_frame_t *,
+                     ompt_data_t *parallelData, unsigned int, int,
+                     const void *) {
+  parallelData->value = tpp_trace::now();
+}
+
+void onParallelEnd(ompt_data_t *parallelData, ompt_data_t *, int,
+                   const void *) {
+  tpp_trace::recordEvent("parallel", "parallel", parallelData->value,
+                         tpp_trace::now());
+}
+
+void onImplicitTask(ompt_scope_endpoint_t endpoint, ompt_data_t *,
+                    ompt_data_t *taskData, unsigned int, unsigned int,
+                    int flags) {
+  // The initial task spans the whole program.
+  if (flags & ompt_task_initial)
+    return;
+  if (endpoint == ompt_scope_begin) {
+    taskData->value = tpp_trace::now();
+    return;
+  }
+  tpp_trace::recordEvent("task", "parallel", taskData->value,
+                         tpp_trace::now());
+}
+
+void onSyncRegionWait(ompt_sync_region_t, ompt_scope_endpoint_t endpoint,
+                      ompt_data_t *, ompt_data_t *, const void *) {
+  if (endpoint == ompt_scope_begin) {
+    barrierBegin = tpp_trace::now();
+    return;
+  }
+  if (barrierBegin)
+    tpp_trace::recordEvent("barrier", "barrier", barrierBegin,
+                           tpp_trace::now());
+  barrierBegin = 0;
+}
+
+int initializeTool(ompt_function_lookup_t lookup, int, ompt_data_t *) {
+  auto setCallback =
+      reinterpret_cast<ompt_set_callback_t>(lookup("ompt_set_callback"));
+  if (!setCallback)
+    return 0;
+  setCallback(ompt_callback_parallel_begin,
+              reinterpret_cast<ompt_callback_t>(&onParallelBegin));
+  setCallback(ompt_callback_parallel_end,
+              reinterpret_cast<ompt_callback_t>(&onParallelEnd));
+  setCallback(ompt_callback_implicit_task,
+              reinterpret_cast<ompt_callback_t>(&onImplicitTask));
+  setCallback(ompt_callback_sync_region_wait,
+              reinterpret_cast<ompt_callback_t>(&onSyncRegionWait));
+  return 1;
+}
+
+void finalizeTool(ompt_data_t *) {}
+
+} // namespace
+
+// Without tracing, the tool is not activated and OpenMP runs untouched.
+extern "C" MLIR_RUNNERUTILS_EXPORT ompt_start_tool_result_t *
+ompt_start_tool(unsigned int, const char *) {
+  static ompt_start_tool_result_t result = {&initializeTool, &finalizeTool,
+                                            {0}};
+  return tpp_trace::isEnabled() ? &result : nullptr;
+}
+
+#endif // TPP_TRACE_HAS_OMPT
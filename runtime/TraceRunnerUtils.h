@@ -0,0 +1,76 @@
+//===- TraceRunnerUtils.h - Per-thread timeline tracing -------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Opt-in timeline of the runtime. Each thread records the begin and end of the
+// parallel regions it runs (task pool loops and OpenMP implicit tasks), of the
+// barriers it waits on, of a sample of its XSMM kernel calls, and of the
+// regions marked by perf.trace_begin/perf.trace_end. The events are written at
+// exit in the Chrome trace event format, which chrome://tracing and Perfetto
+// load as one track per thread.
+//
+// The tracing is enabled by setting TPP_TRACE to the output file, "%p" in the
+// name is replaced with the process id. TPP_TRACE_XSMM_SAMPLE=N records one
+// XSMM call in N on each thread (64 by default, 1 records all of them). When
+// disabled, an event only pays for a check of a function local static.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TPP_EXECUTIONENGINE_TRACERUNNERUTILS_H
+#define TPP_EXECUTIONENGINE_TRACERUNNERUTILS_H
+
+#include "mlir/ExecutionEngine/RunnerUtils.h"
+
+#include <cstdint>
+
+//===----------------------------------------------------------------------===//
+// Perf dialect utils
+//===----------------------------------------------------------------------===//
+
+// Begins a region named by the null-terminated string `name` on the calling
+// thread.
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+_mlir_ciface_perf_trace_begin(UnrankedMemRefType<int8_t> *name);
+
+// Ends the innermost region begun on the calling thread.
+extern "C" MLIR_RUNNERUTILS_EXPORT void perf_trace_end();
+
+//===----------------------------------------------------------------------===//
+// Runtime interface
+//===----------------------------------------------------------------------===//
+
+namespace tpp_trace {
+
+// Returns true if the tracing is enabled.
+bool isEnabled();
+
+// Returns the trace clock, in nanoseconds.
+uint64_t now();
+
+// Returns true if the current XSMM call of the calling thread is sampled.
+bool sampleXsmmCall();
+
+// Records an event of the calling thread between `begin` and `end`. `name`,
+// `category` and `detail` must outlive the process, `detail` is optional.
+void recordEvent(const char *name, const char *category, uint64_t begin,
+                 uint64_t end, const char *detail = nullptr);
+
+// Records the enclosing scope as an event of the calling thread.
+class ScopedEvent {
+public:
+  ScopedEvent(const char *name, const char *category);
+  ~ScopedEvent();
+
+private:
+  const char *name;
+  const char *category;
+  uint64_t begin;
+};
+
+} // namespace tpp_trace
+
+#endif // TPP_EXECUTIONENGINE_TRACERUNNERUTILS_H
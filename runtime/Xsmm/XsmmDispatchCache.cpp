@@ -0,0 +1,165 @@
+//===- XsmmDispatchCache.cpp - Process-wide XSMM kernel cache -------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The cache is a fixed-size open addressing hash table. Each slot is claimed
+// with a single compare-and-swap on its state word and published with a
+// release store once the key and the kernel are written. Readers never block
+// on each other; a reader that hits a slot under construction spins until the
+// slot is published, which only happens on a race between two first-time
+// dispatches.
+//
+//===----------------------------------------------------------------------===//
+
+#include "XsmmDispatchCache.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace xsmm_cache {
+
+namespace {
+
+// Number of slots, must be a power of two. Kernels are tiny compared to the
+// number of distinct shapes in real workloads, this is plenty.
+constexpr uint64_t kNumSlots = 4096;
+constexpr uint64_t kMaxProbes = 64;
+
+// Slot states. Any other value is a published hash.
+constexpr uint64_t kEmpty = 0;
+constexpr uint64_t kBusy = 1;
+// Published hashes always have the top bit set to never alias the states.
+constexpr uint64_t kPublished = 1ULL << 63;
+
+struct Slot {
+  std::atomic<uint64_t> state;
+  DispatchKey key{DispatchKind::Gemm};
+  int64_t kernel;
+};
+
+Slot slots[kNumSlots];
+
+// Hits and misses are counted only with TPP_XSMM_DISPATCH_CACHE_STATS set, to
+// keep the shared counters off the hot path of parallel dispatches. Written
+// once by readEnabled, before any lookup.
+bool countStats = false;
+std::atomic<uint64_t> numHits{0};
+std::atomic<uint64_t> numMisses{0};
+std::atomic<uint64_t> numEntries{0};
+
+uint64_t hashKey(const DispatchKey &key) {
+  // FNV-1a over the kind and the arguments.
+  uint64_t hash = 14695981039346656037ULL;
+  auto mix = [&hash](uint64_t value) {
+    for (unsigned i = 0; i < 8; i++) {
+      hash ^= (value >> (i * 8)) & 0xff;
+      hash *= 1099511628211ULL;
+    }
+  };
+  mix(static_cast<uint64_t>(key.kind));
+  mix(key.numArgs);
+  for (unsigned i = 0; i < key.numArgs; i++)
+    mix(static_cast<uint64_t>(key.args[i]));
+  return hash | kPublished;
+}
+
+bool isEqual(const DispatchKey &lhs, const DispatchKey &rhs) {
+  return lhs.kind == rhs.kind && lhs.numArgs == rhs.numArgs &&
+         std::memcmp(lhs.args, rhs.args, lhs.numArgs * sizeof(int64_t)) == 0;
+}
+
+// Waits until a slot under construction is published.
+uint64_t waitForSlot(Slot &slot) {
+  uint64_t state = slot.state.load(std::memory_order_acquire);
+  while (state == kBusy)
+    state = slot.state.load(std::memory_order_acquire);
+  return state;
+}
+
+void printStats() {
+  DispatchCacheStats stats = getStats();
+  fprintf(stderr,
+          "XSMM dispatch cache: %llu hits, %llu misses, %llu kernels\n",
+          static_cast<unsigned long long>(stats.hits),
+          static_cast<unsigned long long>(stats.misses),
+          static_cast<unsigned long long>(stats.entries));
+}
+
+bool readEnabled() {
+  const char *cacheEnv = getenv("TPP_XSMM_DISPATCH_CACHE");
+  bool enabled = !cacheEnv || strcmp(cacheEnv, "0") != 0;
+
+  const char *statsEnv = getenv("TPP_XSMM_DISPATCH_CACHE_STATS");
+  if (enabled && statsEnv && strcmp(statsEnv, "0") != 0) {
+    countStats = true;
+    atexit(printStats);
+  }
+
+  return enabled;
+}
+
+} // namespace
+
+bool isEnabled() {
+  // Thread-safe initialization of function local statics.
+  static const bool enabled = readEnabled();
+  return enabled;
+}
+
+int64_t lookup(const DispatchKey &key) {
+  uint64_t hash = hashKey(key);
+  for (uint64_t probe = 0; probe < kMaxProbes; probe++) {
+    Slot &slot = slots[(hash + probe) & (kNumSlots - 1)];
+    uint64_t state = waitForSlot(slot);
+    if (state == kEmpty)
+      break;
+    if (state == hash && isEqual(slot.key, key)) {
+      if (countStats)
+        numHits.fetch_add(1, std::memory_order_relaxed);
+      return slot.kernel;
+    }
+  }
+  if (countStats)
+    numMisses.fetch_add(1, std::memory_order_relaxed);
+  return 0;
+}
+
+void insert(const DispatchKey &key, int64_t kernel) {
+  if (!kernel)
+    return;
+
+  uint64_t hash = hashKey(key);
+  for (uint64_t probe = 0; probe < kMaxProbes; probe++) {
+    Slot &slot = slots[(hash + probe) & (kNumSlots - 1)];
+    uint64_t expected = kEmpty;
+    if (slot.state.compare_exchange_strong(expected, kBusy,
+                                           std::memory_order_acquire)) {
+      slot.key = key;
+      slot.kernel = kernel;
+      slot.state.store(hash, std::memory_order_release);
+      numEntries.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    // Another thread raced us with the same key, keep its kernel.
+    expected = waitForSlot(slot);
+    if (expected == hash && isEqual(slot.key, key))
+      return;
+  }
+  // Cache is full around this hash, the kernel just won't be cached.
+}
+
+DispatchCacheStats getStats() {
+  DispatchCacheStats stats;
+  stats.hits = numHits.load(std::memory_order_relaxed);
+  stats.misses = numMisses.load(std::memory_order_relaxed);
+  stats.entries = numEntries.load(std::memory_order_relaxed);
+  return stats;
+}
+
+} // namespace xsmm_cache
@@ -0,0 +1,100 @@
+//===- XsmmDispatchCache.h - Process-wide XSMM kernel cache ---------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Lock-free cache of dispatched LIBXSMM kernels keyed by the raw dispatch
+// arguments (kind, shape, leading dimensions, flags, ...). A repeated dispatch
+// with the same arguments costs a hash lookup instead of rebuilding the
+// LIBXSMM shape descriptors and querying the LIBXSMM registry.
+//
+// The cache can be disabled by setting TPP_XSMM_DISPATCH_CACHE=0. Setting
+// TPP_XSMM_DISPATCH_CACHE_STATS=1 prints the hit/miss counters at exit.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TPP_EXECUTIONENGINE_XSMMDISPATCHCACHE_H
+#define TPP_EXECUTIONENGINE_XSMMDISPATCHCACHE_H
+
+#include <cstdint>
+
+namespace xsmm_cache {
+
+// Kind of the cached dispatch. It is part of the key so that different
+// dispatch entry points with identical integer arguments do not alias.
+enum class DispatchKind : int64_t {
+  Gemm = 1,
+  Brgemm = 2,
+  Unary = 3,
+  Binary = 4,
+  FusedBrgemm = 5,
+  Equation = 6,
+};
+
+// Maximum number of integer arguments stored per key. Equations store their
+// whole descriptor, three words per argument and per node: this fits 14 of
+// them besides the scalar arguments.
+constexpr unsigned kMaxKeyArgs = 48;
+
+// Dispatch cache key - the dispatch kind followed by all the integer
+// arguments passed to the dispatch function.
+struct DispatchKey {
+  DispatchKey(DispatchKind kind) : kind(kind) {}
+
+  // Appends an argument to the key. Returns false, and marks the key as
+  // truncated, if the key is full.
+  [[nodiscard]] bool push(int64_t arg) {
+    if (numArgs >= kMaxKeyArgs) {
+      truncated = true;
+      return false;
+    }
+    args[numArgs++] = arg;
+    return true;
+  }
+
+  DispatchKind kind;
+  unsigned numArgs = 0;
+  // A truncated key does not identify its kernel, it is never cached.
+  bool truncated = false;
+  int64_t args[kMaxKeyArgs] = {0};
+};
+
+// Returns the cached kernel for the key or 0 if there is none.
+int64_t lookup(const DispatchKey &key);
+
+// Inserts a kernel into the cache. The insertion is silently dropped if the
+// cache is full.
+void insert(const DispatchKey &key, int64_t kernel);
+
+// Returns true if the cache is enabled.
+bool isEnabled();
+
+// Cache counters. Hits and misses stay at zero unless
+// TPP_XSMM_DISPATCH_CACHE_STATS is set.
+struct DispatchCacheStats {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t entries;
+};
+
+DispatchCacheStats getStats();
+
+// Looks up the key and, on a miss, calls `dispatch` and caches its result.
+// A truncated key always dispatches, it could alias another kernel.
+template <typename DispatchFn>
+int64_t getOrDispatch(const DispatchKey &key, DispatchFn dispatch) {
+  if (!isEnabled() || key.truncated)
+    return dispatch();
+  if (int64_t kernel = lookup(key))
+    return kernel;
+  int64_t kernel = dispatch();
+  insert(key, kernel);
+  return kernel;
+}
+
+} // namespace xsmm_cache
+
+#endif // TPP_EXECUTIONENGINE_XSMMDISPATCHCACHE_H
@@ -13,6 +13,8 @@
 //===----------------------------------------------------------------------===//
 
 #include "XsmmRunnerUtils.h"
+#include "XsmmDispatchCache.h"
+#include "XsmmTelemetry.h"
 #include "libxsmm.h" // NOLINT [build/include_subdir]
 #include "libxsmm_utils.h"
 
@@ -68,34 +70,158 @@ void *get_base_ptr(const libxsmm_datatype dType, void *alignedPtr,
   } else if (dType == LIBXSMM_DATATYPE_BF16) {
     bf16 *base_ptr = (bf16 *)alignedPtr + offset;
     return (void *)base_ptr;
+  } else if (dType == LIBXSMM_DATATYPE_F16) {
+    libxsmm_float16 *base_ptr = (libxsmm_float16 *)alignedPtr + offset;
+    return (void *)base_ptr;
+  } else if (dType == LIBXSMM_DATATYPE_BF8 || dType == LIBXSMM_DATATYPE_HF8) {
+    uint8_t *base_ptr = (uint8_t *)alignedPtr + offset;
+    return (void *)base_ptr;
+  } else if (dType == LIBXSMM_DATATYPE_I8) {
+    int8_t *base_ptr = (int8_t *)alignedPtr + offset;
+    return (void *)base_ptr;
+  } else if (dType == LIBXSMM_DATATYPE_I32) {
+    int32_t *base_ptr = (int32_t *)alignedPtr + offset;
+    return (void *)base_ptr;
   }
   fprintf(stderr, "Unhandled data type in get_data_pointer_from_memref_desc:%d",
           dType);
   return nullptr;
 }
 
+bool isFP8(const libxsmm_datatype dType) {
+  return dType == LIBXSMM_DATATYPE_BF8 || dType == LIBXSMM_DATATYPE_HF8;
+}
+
+// Reduced precision floats are only a storage format, they compute in f32.
+bool hasF32Compute(const libxsmm_datatype dType) {
+  return dType == LIBXSMM_DATATYPE_BF16 || dType == LIBXSMM_DATATYPE_F16 ||
+         isFP8(dType);
+}
+
+// Mixed-precision gemms carry their output type in the second byte of the
+// data type (e.g., bf16 inputs with an f32 output), see ConvertXsmmToFunc.
+constexpr int kGemmOutputTypeShift = 8;
+
+libxsmm_datatype getGemmInputType(const libxsmm_datatype dType) {
+  return static_cast<libxsmm_datatype>(
+      static_cast<int>(dType) & ((1 << kGemmOutputTypeShift) - 1));
+}
+
+// Integer gemms accumulate i8 inputs into an i32 output and fp8 gemms
+// accumulate into an f32 output, unless the output type is explicit.
+libxsmm_datatype getGemmOutputType(const libxsmm_datatype dType) {
+  if (int outType = static_cast<int>(dType) >> kGemmOutputTypeShift)
+    return static_cast<libxsmm_datatype>(outType);
+  if (dType == LIBXSMM_DATATYPE_I8)
+    return LIBXSMM_DATATYPE_I32;
+  if (isFP8(dType))
+    return LIBXSMM_DATATYPE_F32;
+  return dType;
+}
+
+// Retarget computation type from reduced precision floats to f32 due to
+// missing hardware support.
+libxsmm_datatype getGemmComputeType(const libxsmm_datatype dType) {
+  libxsmm_datatype inType = getGemmInputType(dType);
+  return hasF32Compute(inType) ? LIBXSMM_DATATYPE_F32
+                               : getGemmOutputType(inType);
+}
+
+size_t getTypeSize(const libxsmm_datatype dType) {
+  switch (dType) {
+  case LIBXSMM_DATATYPE_F32:
+    return sizeof(float);
+  case LIBXSMM_DATATYPE_BF16:
+    return sizeof(bf16);
+  case LIBXSMM_DATATYPE_F16:
+    return sizeof(libxsmm_float16);
+  case LIBXSMM_DATATYPE_BF8:
+  case LIBXSMM_DATATYPE_HF8:
+    return sizeof(uint8_t);
+  case LIBXSMM_DATATYPE_I8:
+    return sizeof(int8_t);
+  case LIBXSMM_DATATYPE_I32:
+    return sizeof(int32_t);
+  default:
+    fprintf(stderr, "Unhandled data type in getTypeSize:%d", dType);
+    return 0;
+  }
+}
+
+// Prefetch flags as emitted by the compiler, see `Xsmm_GemmFlags`.
+constexpr int64_t PREFETCH_A = 1LL << 40;
+constexpr int64_t PREFETCH_B = 1LL << 41;
+
+// Maps the prefetch flags to the libxsmm prefetch strategy. The next blocks
+// are prefetched into L2. LIBXSMM is col-major, swap A and B.
+libxsmm_bitfield getPrefetchFlags(int64_t prefetch) {
+  libxsmm_bitfield prefetchFlags = LIBXSMM_GEMM_PREFETCH_NONE;
+  if (prefetch & PREFETCH_A)
+    prefetchFlags |= LIBXSMM_GEMM_PREFETCH_BL2_VIA_C;
+  if (prefetch & PREFETCH_B)
+    prefetchFlags |= LIBXSMM_GEMM_PREFETCH_AL2;
+  return prefetchFlags;
+}
+
+// Maps the gemm flags to libxsmm. The transpose flags refer to the row-major
+// operands, LIBXSMM is col-major, swap A and B.
+libxsmm_bitfield getColMajorGemmFlags(int64_t flags) {
+  libxsmm_bitfield gemmFlags =
+      flags & ~(LIBXSMM_GEMM_FLAG_TRANS_A | LIBXSMM_GEMM_FLAG_TRANS_B);
+  if (flags & LIBXSMM_GEMM_FLAG_TRANS_A)
+    gemmFlags |= LIBXSMM_GEMM_FLAG_TRANS_B;
+  if (flags & LIBXSMM_GEMM_FLAG_TRANS_B)
+    gemmFlags |= LIBXSMM_GEMM_FLAG_TRANS_A;
+  return gemmFlags;
+}
+
 } // namespace
 
 extern "C" void xsmm_gemm_invoke(const libxsmm_datatype dType, int64_t addr,
                                  void *alignedPtrA, int64_t offsetA,
                                  void *alignedPtrB, int64_t offsetB,
                                  void *alignedPtrC, int64_t offsetC) {
+  xsmm_telemetry::ScopedCall telemetry(addr);
   libxsmm_xmmfunction sgemm;
   libxsmm_gemm_param gemm_param;
+  const libxsmm_datatype inType = getGemmInputType(dType);
 
   // LIBXSMM col-major change A with B.
-  gemm_param.a.primary = get_base_ptr(dType, alignedPtrB, offsetB);
-  gemm_param.b.primary = get_base_ptr(dType, alignedPtrA, offsetA);
-  gemm_param.c.primary = get_base_ptr(dType, alignedPtrC, offsetC);
+  gemm_param.a.primary = get_base_ptr(inType, alignedPtrB, offsetB);
+  gemm_param.b.primary = get_base_ptr(inType, alignedPtrA, offsetA);
+  gemm_param.c.primary =
+      get_base_ptr(getGemmOutputType(dType), alignedPtrC, offsetC);
 
   sgemm.gemm = reinterpret_cast<libxsmm_gemmfunction>(addr);
   sgemm.gemm(&gemm_param);
 }
 
-extern "C" int64_t xsmm_gemm_dispatch(const libxsmm_datatype dtype, int64_t m,
-                                      int64_t n, int64_t k, int64_t lda,
-                                      int64_t ldb, int64_t ldc,
-                                      const libxsmm_gemm_flags flags) {
+extern "C" void xsmm_gemm_prefetch_invoke(
+    const libxsmm_datatype dType, int64_t addr, void *alignedPtrA,
+    int64_t offsetA, void *alignedPtrB, int64_t offsetB, void *alignedPtrC,
+    int64_t offsetC, void *alignedPtrNextA, int64_t offsetNextA,
+    void *alignedPtrNextB, int64_t offsetNextB) {
+  xsmm_telemetry::ScopedCall telemetry(addr);
+  libxsmm_xmmfunction sgemm;
+  libxsmm_gemm_param gemm_param;
+  const libxsmm_datatype inType = getGemmInputType(dType);
+
+  // LIBXSMM col-major change A with B.
+  gemm_param.a.primary = get_base_ptr(inType, alignedPtrB, offsetB);
+  gemm_param.b.primary = get_base_ptr(inType, alignedPtrA, offsetA);
+  gemm_param.c.primary =
+      get_base_ptr(getGemmOutputType(dType), alignedPtrC, offsetC);
+  gemm_param.a.quaternary = get_base_ptr(inType, alignedPtrNextB, offsetNextB);
+  gemm_param.b.quaternary = get_base_ptr(inType, alignedPtrNextA, offsetNextA);
+
+  sgemm.gemm = reinterpret_cast<libxsmm_gemmfunction>(addr);
+  sgemm.gemm(&gemm_param);
+}
+
+static int64_t dispatchGemm(const libxsmm_datatype dtype, int64_t m,
+                            int64_t n, int64_t k, int64_t lda, int64_t ldb,
+                            int64_t ldc, const libxsmm_gemm_flags flags,
+                            int64_t prefetch) {
   // std::cout << "lda: " << lda << "\n";
   // std::cout << "ldb: " << ldb << "\n";
   // std::cout << "ldc: " << ldc << "\n";
@@ -109,8 +235,8 @@ extern "C" int64_t xsmm_gemm_dispatch(const libxsmm_datatype dtype, int64_t m,
   libxsmm_blasint k_int = k;
 
   libxsmm_gemm_shape l_shape;
-  libxsmm_bitfield l_flags = flags;
-  libxsmm_bitfield l_prefetch_flags = 0;
+  libxsmm_bitfield l_flags = getColMajorGemmFlags(flags);
+  libxsmm_bitfield l_prefetch_flags = getPrefetchFlags(prefetch);
 
   // See:
   // https://stackoverflow.com/questions/56043539/cublassgemm-row-major-multiplication
@@ -121,12 +247,10 @@ extern "C" int64_t xsmm_gemm_dispatch(const libxsmm_datatype dtype, int64_t m,
   l_shape.lda = ldb;
   l_shape.ldb = lda;
   l_shape.ldc = ldc;
-  l_shape.a_in_type = dtype;
-  l_shape.b_in_type = dtype;
-  l_shape.out_type = dtype;
-  // Retarget computation type from bf16 to f32 due to missing hardware support.
-  l_shape.comp_type =
-      dtype == LIBXSMM_DATATYPE_BF16 ? LIBXSMM_DATATYPE_F32 : dtype;
+  l_shape.a_in_type = getGemmInputType(dtype);
+  l_shape.b_in_type = getGemmInputType(dtype);
+  l_shape.out_type = getGemmOutputType(dtype);
+  l_shape.comp_type = getGemmComputeType(dtype);
 
   auto sgemm = libxsmm_dispatch_gemm(l_shape, l_flags, l_prefetch_flags);
   if (!sgemm) {
@@ -139,11 +263,10 @@ extern "C" int64_t xsmm_gemm_dispatch(const libxsmm_datatype dtype, int64_t m,
   return reinterpret_cast<int64_t>(sgemm);
 }
 
-extern "C" int64_t
-xsmm_unary_dispatch(const libxsmm_meltw_unary_type op_type,
-                    const libxsmm_datatype dtype, int64_t m, int64_t n,
-                    int64_t ldi, int64_t ldo,
-                    const libxsmm_meltw_unary_flags unary_flags) {
+static int64_t dispatchUnary(const libxsmm_meltw_unary_type op_type,
+                             const libxsmm_datatype dtype, int64_t m,
+                             int64_t n, int64_t ldi, int64_t ldo,
+                             const libxsmm_meltw_unary_flags unary_flags) {
   // std::cout << "ldi: " << ldi << "\n";
   // std::cout << "ldo: " << ldo << "\n";
   // std::cout << "m: " << m << "\n";
@@ -158,7 +281,7 @@ xsmm_unary_dispatch(const libxsmm_meltw_unary_type op_type,
   unary_shape.in0_type = dtype;
   // Retarget computation type from bf16 to f32 due to missing hardware support.
   // Copy and Zero should remain in BF16 to avoid useless up/down casts
-  auto force_fp32 = (dtype == LIBXSMM_DATATYPE_BF16 &&
+  auto force_fp32 = (hasF32Compute(dtype) &&
                      !hasImplicitComputeDtypeUnary(op_type));
   unary_shape.comp_type = force_fp32 ? LIBXSMM_DATATYPE_F32 : dtype;
   unary_shape.out_type = dtype;
@@ -178,11 +301,11 @@ xsmm_unary_dispatch(const libxsmm_meltw_unary_type op_type,
   return reinterpret_cast<int64_t>(kernel);
 }
 
-extern "C" int64_t
-xsmm_binary_dispatch(const libxsmm_meltw_binary_type op_type,
-                     const libxsmm_datatype dtype, int64_t m, int64_t n,
-                     int64_t ldiLhs, int64_t ldiRhs, int64_t ldo,
-                     const libxsmm_meltw_binary_flags flags) {
+static int64_t dispatchBinary(const libxsmm_meltw_binary_type op_type,
+                              const libxsmm_datatype dtype, int64_t m,
+                              int64_t n, int64_t ldiLhs, int64_t ldiRhs,
+                              int64_t ldo,
+                              const libxsmm_meltw_binary_flags flags) {
   libxsmm_meltw_binary_shape binary_shape;
   // Row major to col major swap m with n.
   binary_shape.m = static_cast<libxsmm_blasint>(n);
@@ -190,8 +313,7 @@ xsmm_binary_dispatch(const libxsmm_meltw_binary_type op_type,
   binary_shape.in0_type = dtype;
   binary_shape.in1_type = dtype;
   // Retarget computation type from bf16 to f32 due to missing hardware support.
-  binary_shape.comp_type =
-      dtype == LIBXSMM_DATATYPE_BF16 ? LIBXSMM_DATATYPE_F32 : dtype;
+  binary_shape.comp_type = hasF32Compute(dtype) ? LIBXSMM_DATATYPE_F32 : dtype;
   binary_shape.out_type = dtype;
   binary_shape.ldi = static_cast<libxsmm_blasint>(ldiLhs);
   binary_shape.ldi2 = static_cast<libxsmm_blasint>(ldiRhs);
@@ -227,11 +349,10 @@ extern "C" int64_t xsmm_intel_amx_tile_config_dispatch(
   l_shape.lda = ldb;
   l_shape.ldb = lda;
   l_shape.ldc = ldc;
-  l_shape.a_in_type = dtype;
-  l_shape.b_in_type = dtype;
-  l_shape.out_type = dtype;
-  l_shape.comp_type =
-      dtype == LIBXSMM_DATATYPE_BF16 ? LIBXSMM_DATATYPE_F32 : dtype;
+  l_shape.a_in_type = getGemmInputType(dtype);
+  l_shape.b_in_type = getGemmInputType(dtype);
+  l_shape.out_type = getGemmOutputType(dtype);
+  l_shape.comp_type = getGemmComputeType(dtype);
 
   auto sgemm = libxsmm_dispatch_tilecfg_gemm(l_shape, l_cfg_flags);
   if (!sgemm) {
@@ -248,6 +369,7 @@ extern "C" int64_t xsmm_intel_amx_tile_config_dispatch(
 extern "C" void xsmm_unary_invoke(const libxsmm_datatype dType, int64_t addr,
                                   void *alignedPtrIn, int64_t offsetIn,
                                   void *alignedPtrOut, int64_t offsetOut) {
+  xsmm_telemetry::ScopedCall telemetry(addr);
   libxsmm_meltw_unary_param param;
 
   param.in.primary = get_base_ptr(dType, alignedPtrIn, offsetIn);
@@ -262,6 +384,7 @@ extern "C" void xsmm_binary_invoke(const libxsmm_datatype dType, int64_t addr,
                                    void *alignedPtrLhs, int64_t offsetLhs,
                                    void *alignedPtrRhs, int64_t offsetRhs,
                                    void *alignedPtrOut, int64_t offsetOut) {
+  xsmm_telemetry::ScopedCall telemetry(addr);
   libxsmm_meltw_binary_param param;
 
   param.in0.primary = get_base_ptr(dType, alignedPtrLhs, offsetLhs);
@@ -276,6 +399,7 @@ extern "C" void xsmm_binary_invoke(const libxsmm_datatype dType, int64_t addr,
 extern "C" void xsmm_unary_scalar_invoke(const libxsmm_datatype dType,
                                          int64_t addr, float input,
                                          void *alignedOut, int64_t offsetOut) {
+  xsmm_telemetry::ScopedCall telemetry(addr);
   libxsmm_meltwfunction_unary kernel =
       reinterpret_cast<libxsmm_meltwfunction_unary>(addr);
   libxsmm_meltw_unary_param param;
@@ -290,26 +414,172 @@ extern "C" void xsmm_brgemm_invoke(const libxsmm_datatype dType, int64_t addr,
                                    void *alignedPtrB, int64_t offsetB,
                                    void *alignedPtrC, int64_t offsetC,
                                    int64_t numBatches) {
+  xsmm_telemetry::ScopedCall telemetry(addr, numBatches);
   libxsmm_xmmfunction sgemm;
   libxsmm_gemm_param gemm_param;
+  const libxsmm_datatype inType = getGemmInputType(dType);
 
   unsigned long long numBatchesVar = numBatches;
   gemm_param.op.tertiary = (void *)&numBatchesVar;
 
   // LIBXSMM col-major change A with B.
-  gemm_param.a.primary = get_base_ptr(dType, alignedPtrB, offsetB);
-  gemm_param.b.primary = get_base_ptr(dType, alignedPtrA, offsetA);
-  gemm_param.c.primary = get_base_ptr(dType, alignedPtrC, offsetC);
+  gemm_param.a.primary = get_base_ptr(inType, alignedPtrB, offsetB);
+  gemm_param.b.primary = get_base_ptr(inType, alignedPtrA, offsetA);
+  gemm_param.c.primary =
+      get_base_ptr(getGemmOutputType(dType), alignedPtrC, offsetC);
 
   sgemm.gemm = reinterpret_cast<libxsmm_gemmfunction>(addr);
   sgemm.gemm(&gemm_param);
 }
 
-extern "C" int64_t xsmm_brgemm_dispatch(const libxsmm_datatype dtype, int64_t m,
-                                        int64_t n, int64_t k, int64_t lda,
-                                        int64_t ldb, int64_t ldc,
-                                        int64_t stride_a, int64_t stride_b,
-                                        const libxsmm_gemm_flags flags) {
+extern "C" void xsmm_brgemm_prefetch_invoke(
+    const libxsmm_datatype dType, int64_t addr, void *alignedPtrA,
+    int64_t offsetA, void *alignedPtrB, int64_t offsetB, void *alignedPtrC,
+    int64_t offsetC, int64_t numBatches, void *alignedPtrNextA,
+    int64_t offsetNextA, void *alignedPtrNextB, int64_t offsetNextB) {
+  xsmm_telemetry::ScopedCall telemetry(addr, numBatches);
+  libxsmm_xmmfunction sgemm;
+  libxsmm_gemm_param gemm_param;
+  const libxsmm_datatype inType = getGemmInputType(dType);
+
+  unsigned long long numBatchesVar = numBatches;
+  gemm_param.op.tertiary = (void *)&numBatchesVar;
+
+  // LIBXSMM col-major change A with B.
+  gemm_param.a.primary = get_base_ptr(inType, alignedPtrB, offsetB);
+  gemm_param.b.primary = get_base_ptr(inType, alignedPtrA, offsetA);
+  gemm_param.c.primary =
+      get_base_ptr(getGemmOutputType(dType), alignedPtrC, offsetC);
+  gemm_param.a.quaternary = get_base_ptr(inType, alignedPtrNextB, offsetNextB);
+  gemm_param.b.quaternary = get_base_ptr(inType, alignedPtrNextA, offsetNextA);
+
+  sgemm.gemm = reinterpret_cast<libxsmm_gemmfunction>(addr);
+  sgemm.gemm(&gemm_param);
+}
+
+// Address and offset lists are arrays of 64-bit entries, see
+// `xsmm.brgemm_indirect`.
+static unsigned long long *getListPtr(void *alignedPtr, int64_t offset) {
+  return static_cast<unsigned long long *>(alignedPtr) + offset;
+}
+
+extern "C" void xsmm_brgemm_offset_invoke(
+    const libxsmm_datatype dType, int64_t addr, void *alignedPtrA,
+    int64_t offsetA, void *alignedPtrB, int64_t offsetB, void *alignedPtrC,
+    int64_t offsetC, void *alignedPtrOffsetsA, int64_t offsetOffsetsA,
+    void *alignedPtrOffsetsB, int64_t offsetOffsetsB, int64_t numBatches) {
+  xsmm_telemetry::ScopedCall telemetry(addr, numBatches);
+  libxsmm_xmmfunction sgemm;
+  libxsmm_gemm_param gemm_param;
+  const libxsmm_datatype inType = getGemmInputType(dType);
+
+  unsigned long long numBatchesVar = numBatches;
+  gemm_param.op.tertiary = (void *)&numBatchesVar;
+
+  // LIBXSMM col-major change A with B.
+  gemm_param.a.primary = get_base_ptr(inType, alignedPtrB, offsetB);
+  gemm_param.a.secondary = getListPtr(alignedPtrOffsetsB, offsetOffsetsB);
+  gemm_param.b.primary = get_base_ptr(inType, alignedPtrA, offsetA);
+  gemm_param.b.secondary = getListPtr(alignedPtrOffsetsA, offsetOffsetsA);
+  gemm_param.c.primary =
+      get_base_ptr(getGemmOutputType(dType), alignedPtrC, offsetC);
+
+  sgemm.gemm = reinterpret_cast<libxsmm_gemmfunction>(addr);
+  sgemm.gemm(&gemm_param);
+}
+
+extern "C" void xsmm_brgemm_address_invoke(
+    const libxsmm_datatype dType, int64_t addr, void *alignedPtrA,
+    int64_t offsetA, void *alignedPtrB, int64_t offsetB, void *alignedPtrC,
+    int64_t offsetC, void *alignedPtrAddressesA, int64_t offsetAddressesA,
+    void *alignedPtrAddressesB, int64_t offsetAddressesB, int64_t numBatches) {
+  xsmm_telemetry::ScopedCall telemetry(addr, numBatches);
+  libxsmm_xmmfunction sgemm;
+  libxsmm_gemm_param gemm_param;
+
+  unsigned long long numBatchesVar = numBatches;
+  gemm_param.op.tertiary = (void *)&numBatchesVar;
+
+  // A and B only describe the blocks, the kernel reads the address lists.
+  // LIBXSMM col-major change A with B.
+  gemm_param.a.primary = getListPtr(alignedPtrAddressesB, offsetAddressesB);
+  gemm_param.b.primary = getListPtr(alignedPtrAddressesA, offsetAddressesA);
+  gemm_param.c.primary =
+      get_base_ptr(getGemmOutputType(dType), alignedPtrC, offsetC);
+
+  sgemm.gemm = reinterpret_cast<libxsmm_gemmfunction>(addr);
+  sgemm.gemm(&gemm_param);
+}
+
+// Maximum number of arguments of an equation.
+constexpr int64_t kMaxEquationArgs = 16;
+
+extern "C" void xsmm_equation_invoke(const libxsmm_datatype dType,
+                                     int64_t addr, void *alignedPtrArgs,
+                                     int64_t offsetArgs, void *alignedPtrOut,
+                                     int64_t offsetOut, int64_t numArgs) {
+  xsmm_telemetry::ScopedCall telemetry(addr);
+  if (numArgs > kMaxEquationArgs) {
+    fprintf(stderr, "too many equation arguments: %lld\n",
+            static_cast<long long>(numArgs));
+    exit(-1);
+  }
+
+  // The arguments are (aligned pointer, offset) pairs.
+  const int64_t *args = static_cast<int64_t *>(alignedPtrArgs) + offsetArgs;
+  libxsmm_matrix_arg inputs[kMaxEquationArgs];
+  for (int64_t idx = 0; idx < numArgs; idx++) {
+    void *alignedPtr = reinterpret_cast<void *>(args[idx * 2]);
+    inputs[idx].primary = get_base_ptr(dType, alignedPtr, args[idx * 2 + 1]);
+  }
+
+  libxsmm_meqn_param param;
+  param.inputs = inputs;
+  param.output.primary = get_base_ptr(dType, alignedPtrOut, offsetOut);
+
+  libxsmm_meqn_function kernel = reinterpret_cast<libxsmm_meqn_function>(addr);
+  kernel(&param);
+}
+
+extern "C" void xsmm_brgemm_grouped_invoke(
+    const libxsmm_datatype dType, int64_t addr, void *alignedPtrA,
+    int64_t offsetA, void *alignedPtrB, int64_t offsetB, void *alignedPtrC,
+    int64_t offsetC, void *alignedPtrDescs, int64_t offsetDescs,
+    int64_t numBatches, int64_t numGroups) {
+  xsmm_telemetry::ScopedCall telemetry(addr, numBatches, numGroups);
+  libxsmm_xmmfunction sgemm;
+  libxsmm_gemm_param gemm_param;
+
+  unsigned long long numBatchesVar = numBatches;
+  gemm_param.op.tertiary = (void *)&numBatchesVar;
+
+  // The descriptors hold the element offsets of the A, B and C tiles from
+  // the aligned pointers, the offsets of the base buffers are already
+  // accounted for.
+  const size_t inSize = getTypeSize(getGemmInputType(dType));
+  const size_t outSize = getTypeSize(getGemmOutputType(dType));
+  char *basePtrA = static_cast<char *>(alignedPtrA);
+  char *basePtrB = static_cast<char *>(alignedPtrB);
+  char *basePtrC = static_cast<char *>(alignedPtrC);
+  const int64_t *descs = static_cast<int64_t *>(alignedPtrDescs) + offsetDescs;
+
+  sgemm.gemm = reinterpret_cast<libxsmm_gemmfunction>(addr);
+  for (int64_t group = 0; group < numGroups; group++) {
+    const int64_t *desc = descs + group * 3;
+    // LIBXSMM col-major change A with B.
+    gemm_param.a.primary = basePtrB + desc[1] * inSize;
+    gemm_param.b.primary = basePtrA + desc[0] * inSize;
+    gemm_param.c.primary = basePtrC + desc[2] * outSize;
+    sgemm.gemm(&gemm_param);
+  }
+}
+
+static int64_t dispatchBrgemm(const libxsmm_datatype dtype, int64_t m,
+                              int64_t n, int64_t k, int64_t lda, int64_t ldb,
+                              int64_t ldc, int64_t stride_a, int64_t stride_b,
+                              const libxsmm_gemm_flags flags,
+                              int64_t prefetch,
+                              libxsmm_gemm_batch_reduce_type brType) {
   // std::cout << "lda: " << lda << "\n";
   // std::cout << "lbd: " << ldb << "\n";
   // std::cout << "ldc: " << ldc << "\n";
@@ -325,8 +595,8 @@ extern "C" int64_t xsmm_brgemm_dispatch(const libxsmm_datatype dtype, int64_t m,
   libxsmm_blasint k_int = k;
 
   libxsmm_gemm_shape l_shape;
-  libxsmm_bitfield l_flags = flags;
-  libxsmm_bitfield l_prefetch_flags = 0;
+  libxsmm_bitfield l_flags = getColMajorGemmFlags(flags);
+  libxsmm_bitfield l_prefetch_flags = getPrefetchFlags(prefetch);
   libxsmm_gemm_batch_reduce_config l_brconfig;
 
   l_shape.m = n_int;
@@ -335,16 +605,16 @@ extern "C" int64_t xsmm_brgemm_dispatch(const libxsmm_datatype dtype, int64_t m,
   l_shape.lda = ldb_int;
   l_shape.ldb = lda_int;
   l_shape.ldc = ldc_int;
-  l_shape.a_in_type = dtype;
-  l_shape.b_in_type = dtype;
-  l_shape.out_type = dtype;
-  // Retarget computation type from bf16 to f32 due to missing hardware support.
-  l_shape.comp_type =
-      dtype == LIBXSMM_DATATYPE_BF16 ? LIBXSMM_DATATYPE_F32 : dtype;
-  l_brconfig.br_type = LIBXSMM_GEMM_BATCH_REDUCE_STRIDE;
-  auto typeSize = dtype == LIBXSMM_DATATYPE_F32 ? sizeof(float) : sizeof(bf16);
-  l_brconfig.br_stride_a_hint = stride_b * typeSize;
-  l_brconfig.br_stride_b_hint = stride_a * typeSize;
+  l_shape.a_in_type = getGemmInputType(dtype);
+  l_shape.b_in_type = getGemmInputType(dtype);
+  l_shape.out_type = getGemmOutputType(dtype);
+  l_shape.comp_type = getGemmComputeType(dtype);
+  l_brconfig.br_type = brType;
+  auto typeSize = getTypeSize(getGemmInputType(dtype));
+  // Strides are meaningless for address and offset based batch-reduce.
+  bool isStrided = brType == LIBXSMM_GEMM_BATCH_REDUCE_STRIDE;
+  l_brconfig.br_stride_a_hint = isStrided ? stride_b * typeSize : 0;
+  l_brconfig.br_stride_b_hint = isStrided ? stride_a * typeSize : 0;
   l_brconfig.br_unroll_hint = 0;
 
   auto sgemm =
@@ -366,31 +636,34 @@ extern "C" void xsmm_fused_brgemm_invoke(const libxsmm_datatype dType,
                                          int64_t offsetB, void *alignedPtrC,
                                          int64_t offsetC, void *alignedPtrD,
                                          int64_t offsetD, int64_t numBatches) {
+  xsmm_telemetry::ScopedCall telemetry(addr, numBatches);
   libxsmm_xmmfunction sgemm;
   libxsmm_gemm_ext_param gemm_param;
+  const libxsmm_datatype inType = getGemmInputType(dType);
 
   unsigned long long numBatchesVar = numBatches;
   gemm_param.op.tertiary = (void *)&numBatchesVar;
 
   // LIBXSMM col-major change A with B.
-  gemm_param.a.primary = get_base_ptr(dType, alignedPtrB, offsetB);
-  gemm_param.b.primary = get_base_ptr(dType, alignedPtrA, offsetA);
-  gemm_param.c.primary = get_base_ptr(dType, alignedPtrC, offsetC);
+  gemm_param.a.primary = get_base_ptr(inType, alignedPtrB, offsetB);
+  gemm_param.b.primary = get_base_ptr(inType, alignedPtrA, offsetA);
+  gemm_param.c.primary =
+      get_base_ptr(getGemmOutputType(dType), alignedPtrC, offsetC);
   gemm_param.d.primary = get_base_ptr(dType, alignedPtrD, offsetD);
 
   sgemm.gemm_ext = reinterpret_cast<libxsmm_gemmfunction_ext>(addr);
   sgemm.gemm_ext(&gemm_param);
 }
 
-extern "C" int64_t
-xsmm_fused_brgemm_dispatch(const libxsmm_datatype data_type, int64_t m,
-                           int64_t n, int64_t k, int64_t lda, int64_t ldb,
-                           int64_t ldc, int64_t stride_a, int64_t stride_b,
-                           const libxsmm_gemm_flags gemm_flags,
-                           const libxsmm_meltw_unary_flags unary_flags,
-                           const libxsmm_meltw_unary_type unary_op_type,
-                           const libxsmm_meltw_binary_flags binary_flags,
-                           const libxsmm_meltw_binary_type binary_op_type) {
+static int64_t
+dispatchFusedBrgemm(const libxsmm_datatype data_type, int64_t m, int64_t n,
+                    int64_t k, int64_t lda, int64_t ldb, int64_t ldc,
+                    int64_t stride_a, int64_t stride_b,
+                    const libxsmm_gemm_flags gemm_flags,
+                    const libxsmm_meltw_unary_flags unary_flags,
+                    const libxsmm_meltw_unary_type unary_op_type,
+                    const libxsmm_meltw_binary_flags binary_flags,
+                    const libxsmm_meltw_binary_type binary_op_type) {
   // std::cout << "lda: " << lda << "\n";
   // std::cout << "lbd: " << ldb << "\n";
   // std::cout << "ldc: " << ldc << "\n";
@@ -405,7 +678,7 @@ xsmm_fused_brgemm_dispatch(const libxsmm_datatype data_type, int64_t m,
   libxsmm_blasint n_int = n;
   libxsmm_blasint k_int = k;
   libxsmm_gemm_shape l_shape;
-  libxsmm_bitfield l_flags = gemm_flags;
+  libxsmm_bitfield l_flags = getColMajorGemmFlags(gemm_flags);
   libxsmm_bitfield l_prefetch_flags = 0;
 
   l_shape.m = n_int;
@@ -419,12 +692,11 @@ xsmm_fused_brgemm_dispatch(const libxsmm_datatype data_type, int64_t m,
   l_shape.out_type = data_type;
   // Retarget computation type from bf16 to f32 due to missing hardware support.
   l_shape.comp_type =
-      data_type == LIBXSMM_DATATYPE_BF16 ? LIBXSMM_DATATYPE_F32 : data_type;
+      hasF32Compute(data_type) ? LIBXSMM_DATATYPE_F32 : data_type;
 
   libxsmm_gemm_batch_reduce_config l_brconfig;
   l_brconfig.br_type = LIBXSMM_GEMM_BATCH_REDUCE_STRIDE;
-  auto typeSize =
-      data_type == LIBXSMM_DATATYPE_F32 ? sizeof(float) : sizeof(bf16);
+  auto typeSize = getTypeSize(data_type);
   l_brconfig.br_stride_a_hint = stride_b * typeSize;
   l_brconfig.br_stride_b_hint = stride_a * typeSize;
   l_brconfig.br_unroll_hint = 0;
@@ -468,6 +740,262 @@ xsmm_intel_amx_tile_config_invoke(const libxsmm_datatype dType, int64_t addr,
   cfg_tr.tilecfg(l_tilestate);
 }
 
+//===----------------------------------------------------------------------===//
+// Cached dispatch entry points
+//===----------------------------------------------------------------------===//
+
+// All the dispatch entry points go through the process-wide dispatch cache,
+// so re-dispatching the same kernel (e.g., inside a loop or from another
+// function) costs only a hash lookup.
+
+// Registers a dispatched kernel with the telemetry, if enabled.
+static void registerTelemetry(int64_t kernel,
+                              xsmm_telemetry::KernelKind kind, int64_t dtype,
+                              int64_t m, int64_t n, int64_t k, int64_t flags,
+                              int64_t op = 0) {
+  if (!xsmm_telemetry::isEnabled())
+    return;
+  xsmm_telemetry::KernelInfo info = {kind, dtype, m, n, k, flags, op};
+  xsmm_telemetry::registerKernel(kernel, info);
+}
+
+extern "C" int64_t xsmm_gemm_prefetch_dispatch(
+    const libxsmm_datatype dtype, int64_t m, int64_t n, int64_t k, int64_t lda,
+    int64_t ldb, int64_t ldc, const libxsmm_gemm_flags flags,
+    int64_t prefetch) {
+  xsmm_cache::DispatchKey key(xsmm_cache::DispatchKind::Gemm);
+  for (int64_t arg :
+       {int64_t(dtype), m, n, k, lda, ldb, ldc, int64_t(flags), prefetch})
+    if (!key.push(arg))
+      break;
+  int64_t kernel = xsmm_cache::getOrDispatch(key, [&]() {
+    return dispatchGemm(dtype, m, n, k, lda, ldb, ldc, flags, prefetch);
+  });
+  registerTelemetry(kernel, xsmm_telemetry::KernelKind::Gemm, dtype, m, n, k,
+                    flags);
+  return kernel;
+}
+
+extern "C" int64_t xsmm_gemm_dispatch(const libxsmm_datatype dtype, int64_t m,
+                                      int64_t n, int64_t k, int64_t lda,
+                                      int64_t ldb, int64_t ldc,
+                                      const libxsmm_gemm_flags flags) {
+  return xsmm_gemm_prefetch_dispatch(dtype, m, n, k, lda, ldb, ldc, flags,
+                                     /*prefetch=*/0);
+}
+
+extern "C" int64_t
+xsmm_unary_dispatch(const libxsmm_meltw_unary_type op_type,
+                    const libxsmm_datatype dtype, int64_t m, int64_t n,
+                    int64_t ldi, int64_t ldo,
+                    const libxsmm_meltw_unary_flags unary_flags) {
+  xsmm_cache::DispatchKey key(xsmm_cache::DispatchKind::Unary);
+  for (int64_t arg : {int64_t(op_type), int64_t(dtype), m, n, ldi, ldo,
+                      int64_t(unary_flags)})
+    if (!key.push(arg))
+      break;
+  int64_t kernel = xsmm_cache::getOrDispatch(key, [&]() {
+    return dispatchUnary(op_type, dtype, m, n, ldi, ldo, unary_flags);
+  });
+  registerTelemetry(kernel, xsmm_telemetry::KernelKind::Unary, dtype, m, n,
+                    /*k=*/0, unary_flags, op_type);
+  return kernel;
+}
+
+// The descriptor holds an [m, n, ld] triple per argument followed by the
+// [kind, op, flags] triples of the nodes in pre-order. It lives in a constant
+// global of the compiled module, its address identifies the equation.
+static int64_t dispatchEquation(const libxsmm_datatype dtype, int64_t m,
+                                int64_t n, int64_t ldo, const int64_t *desc,
+                                int64_t numArgs, int64_t numNodes) {
+  enum NodeKind : int64_t { Arg = 0, Unary = 1, Binary = 2 };
+  // Retarget computation type from bf16 to f32 due to missing hardware support.
+  const libxsmm_datatype compType =
+      hasF32Compute(dtype) ? LIBXSMM_DATATYPE_F32 : dtype;
+  const int64_t *nodes = desc + numArgs * 3;
+
+  libxsmm_blasint eqn = libxsmm_meqn_create();
+  for (int64_t idx = 0; idx < numNodes; idx++) {
+    const int64_t *node = nodes + idx * 3;
+    switch (node[0]) {
+    case Arg: {
+      const int64_t *arg = desc + node[1] * 3;
+      // Row major to col major swap m with n.
+      libxsmm_meqn_push_back_arg(
+          libxsmm_create_meqn_arg_metadata(eqn, node[1]),
+          libxsmm_create_meqn_arg_shape(arg[1], arg[0], arg[2], dtype),
+          libxsmm_create_matrix_arg_attributes(
+              LIBXSMM_MATRIX_ARG_TYPE_SINGULAR,
+              LIBXSMM_MATRIX_ARG_SET_TYPE_NONE, 0, 0));
+      break;
+    }
+    case Unary:
+      libxsmm_meqn_push_back_unary_op(
+          libxsmm_create_meqn_op_metadata(eqn, -1),
+          static_cast<libxsmm_meltw_unary_type>(node[1]), compType,
+          static_cast<libxsmm_meltw_unary_flags>(node[2]));
+      break;
+    case Binary:
+      libxsmm_meqn_push_back_binary_op(
+          libxsmm_create_meqn_op_metadata(eqn, -1),
+          static_cast<libxsmm_meltw_binary_type>(node[1]), compType,
+          static_cast<libxsmm_meltw_binary_flags>(node[2]));
+      break;
+    default:
+      fprintf(stderr, "invalid equation node kind: %lld\n",
+              static_cast<long long>(node[0]));
+      exit(-1);
+    }
+  }
+
+  libxsmm_meqn_function kernel = libxsmm_dispatch_meqn(
+      eqn, libxsmm_create_meqn_arg_shape(n, m, ldo, dtype));
+  if (!kernel) {
+    fprintf(stderr, "failed to generate equation func\n");
+    fprintf(stderr, "m: %lld, n: %lld, ldo: %lld, nodes: %lld\n",
+            static_cast<long long>(m), static_cast<long long>(n),
+            static_cast<long long>(ldo), static_cast<long long>(numNodes));
+    exit(-1);
+  }
+
+  return reinterpret_cast<int64_t>(kernel);
+}
+
+extern "C" int64_t xsmm_equation_dispatch(const libxsmm_datatype dtype,
+                                          int64_t m, int64_t n, int64_t ldo,
+                                          void *alignedPtrDesc,
+                                          int64_t offsetDesc, int64_t numArgs,
+                                          int64_t numNodes) {
+  const int64_t *desc = static_cast<int64_t *>(alignedPtrDesc) + offsetDesc;
+  // The descriptor is keyed by contents, its buffer can be reused for
+  // another equation.
+  xsmm_cache::DispatchKey key(xsmm_cache::DispatchKind::Equation);
+  for (int64_t arg : {int64_t(dtype), m, n, ldo, numArgs, numNodes})
+    if (!key.push(arg))
+      break;
+  for (int64_t idx = 0; !key.truncated && idx < (numArgs + numNodes) * 3;
+       idx++)
+    if (!key.push(desc[idx]))
+      break;
+  int64_t kernel = xsmm_cache::getOrDispatch(key, [&]() {
+    return dispatchEquation(dtype, m, n, ldo, desc, numArgs, numNodes);
+  });
+  registerTelemetry(kernel, xsmm_telemetry::KernelKind::Equation, dtype, m, n,
+                    /*k=*/0, /*flags=*/0, /*op=*/numNodes);
+  return kernel;
+}
+
+extern "C" int64_t
+xsmm_binary_dispatch(const libxsmm_meltw_binary_type op_type,
+                     const libxsmm_datatype dtype, int64_t m, int64_t n,
+                     int64_t ldiLhs, int64_t ldiRhs, int64_t ldo,
+                     const libxsmm_meltw_binary_flags flags) {
+  xsmm_cache::DispatchKey key(xsmm_cache::DispatchKind::Binary);
+  for (int64_t arg : {int64_t(op_type), int64_t(dtype), m, n, ldiLhs, ldiRhs,
+                      ldo, int64_t(flags)})
+    if (!key.push(arg))
+      break;
+  int64_t kernel = xsmm_cache::getOrDispatch(key, [&]() {
+    return dispatchBinary(op_type, dtype, m, n, ldiLhs, ldiRhs, ldo, flags);
+  });
+  registerTelemetry(kernel, xsmm_telemetry::KernelKind::Binary, dtype, m, n,
+                    /*k=*/0, flags, op_type);
+  return kernel;
+}
+
+static int64_t
+cachedDispatchBrgemm(const libxsmm_datatype dtype, int64_t m, int64_t n,
+                     int64_t k, int64_t lda, int64_t ldb, int64_t ldc,
+                     int64_t stride_a, int64_t stride_b,
+                     const libxsmm_gemm_flags flags, int64_t prefetch,
+                     libxsmm_gemm_batch_reduce_type brType) {
+  xsmm_cache::DispatchKey key(xsmm_cache::DispatchKind::Brgemm);
+  for (int64_t arg : {int64_t(dtype), m, n, k, lda, ldb, ldc, stride_a,
+                      stride_b, int64_t(flags), prefetch, int64_t(brType)})
+    if (!key.push(arg))
+      break;
+  int64_t kernel = xsmm_cache::getOrDispatch(key, [&]() {
+    return dispatchBrgemm(dtype, m, n, k, lda, ldb, ldc, stride_a, stride_b,
+                          flags, prefetch, brType);
+  });
+  registerTelemetry(kernel, xsmm_telemetry::KernelKind::Brgemm, dtype, m, n,
+                    k, flags);
+  return kernel;
+}
+
+extern "C" int64_t xsmm_brgemm_prefetch_dispatch(
+    const libxsmm_datatype dtype, int64_t m, int64_t n, int64_t k, int64_t lda,
+    int64_t ldb, int64_t ldc, int64_t stride_a, int64_t stride_b,
+    const libxsmm_gemm_flags flags, int64_t prefetch) {
+  return cachedDispatchBrgemm(dtype, m, n, k, lda, ldb, ldc, stride_a,
+                              stride_b, flags, prefetch,
+                              LIBXSMM_GEMM_BATCH_REDUCE_STRIDE);
+}
+
+extern "C" int64_t xsmm_brgemm_address_dispatch(
+    const libxsmm_datatype dtype, int64_t m, int64_t n, int64_t k, int64_t lda,
+    int64_t ldb, int64_t ldc, int64_t stride_a, int64_t stride_b,
+    const libxsmm_gemm_flags flags) {
+  return cachedDispatchBrgemm(dtype, m, n, k, lda, ldb, ldc, stride_a,
+                              stride_b, flags, /*prefetch=*/0,
+                              LIBXSMM_GEMM_BATCH_REDUCE_ADDRESS);
+}
+
+extern "C" int64_t xsmm_brgemm_offset_dispatch(
+    const libxsmm_datatype dtype, int64_t m, int64_t n, int64_t k, int64_t lda,
+    int64_t ldb, int64_t ldc, int64_t stride_a, int64_t stride_b,
+    const libxsmm_gemm_flags flags) {
+  return cachedDispatchBrgemm(dtype, m, n, k, lda, ldb, ldc, stride_a,
+                              stride_b, flags, /*prefetch=*/0,
+                              LIBXSMM_GEMM_BATCH_REDUCE_OFFSET);
+}
+
+extern "C" int64_t xsmm_brgemm_dispatch(const libxsmm_datatype dtype, int64_t m,
+                                        int64_t n, int64_t k, int64_t lda,
+                                        int64_t ldb, int64_t ldc,
+                                        int64_t stride_a, int64_t stride_b,
+                                        const libxsmm_gemm_flags flags) {
+  return xsmm_brgemm_prefetch_dispatch(dtype, m, n, k, lda, ldb, ldc, stride_a,
+                                       stride_b, flags, /*prefetch=*/0);
+}
+
+extern "C" int64_t
+xsmm_fused_brgemm_dispatch(const libxsmm_datatype data_type, int64_t m,
+                           int64_t n, int64_t k, int64_t lda, int64_t ldb,
+                           int64_t ldc, int64_t stride_a, int64_t stride_b,
+                           const libxsmm_gemm_flags gemm_flags,
+                           const libxsmm_meltw_unary_flags unary_flags,
+                           const libxsmm_meltw_unary_type unary_op_type,
+                           const libxsmm_meltw_binary_flags binary_flags,
+                           const libxsmm_meltw_binary_type binary_op_type) {
+  xsmm_cache::DispatchKey key(xsmm_cache::DispatchKind::FusedBrgemm);
+  for (int64_t arg :
+       {int64_t(data_type), m, n, k, lda, ldb, ldc, stride_a, stride_b,
+        int64_t(gemm_flags), int64_t(unary_flags), int64_t(unary_op_type),
+        int64_t(binary_flags), int64_t(binary_op_type)})
+    if (!key.push(arg))
+      break;
+  int64_t kernel = xsmm_cache::getOrDispatch(key, [&]() {
+    return dispatchFusedBrgemm(data_type, m, n, k, lda, ldb, ldc, stride_a,
+                               stride_b, gemm_flags, unary_flags,
+                               unary_op_type, binary_flags, binary_op_type);
+  });
+  registerTelemetry(kernel, xsmm_telemetry::KernelKind::FusedBrgemm,
+                    data_type, m, n, k, gemm_flags);
+  return kernel;
+}
+
+extern "C" void xsmm_dispatch_cache_stats(int64_t *hits, int64_t *misses,
+                                          int64_t *entries) {
+  xsmm_cache::DispatchCacheStats stats = xsmm_cache::getStats();
+  if (hits)
+    *hits = static_cast<int64_t>(stats.hits);
+  if (misses)
+    *misses = static_cast<int64_t>(stats.misses);
+  if (entries)
+    *entries = static_cast<int64_t>(stats.entries);
+}
+
 static void printXsmmStruct(const libxsmm_gemm_shape &gemmShape,
                             FILE *outfile) {
   fprintf(outfile, "M: %d\n", gemmShape.m);
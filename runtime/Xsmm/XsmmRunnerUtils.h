@@ -35,6 +35,26 @@ extern "C" MLIR_RUNNERUTILS_EXPORT int64_t xsmm_brgemm_dispatch(
     const libxsmm_datatype, int64_t, int64_t, int64_t, int64_t, int64_t,
     int64_t, int64_t, int64_t, const libxsmm_gemm_flags);
 
+// Gemm and brgemm dispatch with software prefetch of the next A and B blocks.
+// `prefetch` holds the `prefetch_a`/`prefetch_b` gemm flags.
+extern "C" MLIR_RUNNERUTILS_EXPORT int64_t xsmm_gemm_prefetch_dispatch(
+    const libxsmm_datatype, int64_t, int64_t, int64_t, int64_t, int64_t,
+    int64_t, const libxsmm_gemm_flags, int64_t prefetch);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT int64_t xsmm_brgemm_prefetch_dispatch(
+    const libxsmm_datatype, int64_t, int64_t, int64_t, int64_t, int64_t,
+    int64_t, int64_t, int64_t, const libxsmm_gemm_flags, int64_t prefetch);
+
+// Brgemm dispatch over a list of addresses or offsets of the A/B blocks
+// instead of a fixed stride, the strides are ignored.
+extern "C" MLIR_RUNNERUTILS_EXPORT int64_t xsmm_brgemm_address_dispatch(
+    const libxsmm_datatype, int64_t, int64_t, int64_t, int64_t, int64_t,
+    int64_t, int64_t, int64_t, const libxsmm_gemm_flags);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT int64_t xsmm_brgemm_offset_dispatch(
+    const libxsmm_datatype, int64_t, int64_t, int64_t, int64_t, int64_t,
+    int64_t, int64_t, int64_t, const libxsmm_gemm_flags);
+
 extern "C" MLIR_RUNNERUTILS_EXPORT int64_t xsmm_fused_brgemm_dispatch(
     const libxsmm_datatype data_type, int64_t m, int64_t n, int64_t k,
     int64_t lda, int64_t ldb, int64_t ldc, int64_t stride_a, int64_t stride_b,
@@ -73,6 +93,52 @@ xsmm_brgemm_invoke(const libxsmm_datatype dType, int64_t addr,
                    int64_t offsetB, void *alignedPtrC, int64_t offsetC,
                    int64_t numBatches);
 
+extern "C" MLIR_RUNNERUTILS_EXPORT void xsmm_gemm_prefetch_invoke(
+    const libxsmm_datatype dType, int64_t addr, void *alignedPtrA,
+    int64_t offsetA, void *alignedPtrB, int64_t offsetB, void *alignedPtrC,
+    int64_t offsetC, void *alignedPtrNextA, int64_t offsetNextA,
+    void *alignedPtrNextB, int64_t offsetNextB);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void xsmm_brgemm_prefetch_invoke(
+    const libxsmm_datatype dType, int64_t addr, void *alignedPtrA,
+    int64_t offsetA, void *alignedPtrB, int64_t offsetB, void *alignedPtrC,
+    int64_t offsetC, int64_t numBatches, void *alignedPtrNextA,
+    int64_t offsetNextA, void *alignedPtrNextB, int64_t offsetNextB);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void xsmm_brgemm_offset_invoke(
+    const libxsmm_datatype dType, int64_t addr, void *alignedPtrA,
+    int64_t offsetA, void *alignedPtrB, int64_t offsetB, void *alignedPtrC,
+    int64_t offsetC, void *alignedPtrOffsetsA, int64_t offsetOffsetsA,
+    void *alignedPtrOffsetsB, int64_t offsetOffsetsB, int64_t numBatches);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void xsmm_brgemm_address_invoke(
+    const libxsmm_datatype dType, int64_t addr, void *alignedPtrA,
+    int64_t offsetA, void *alignedPtrB, int64_t offsetB, void *alignedPtrC,
+    int64_t offsetC, void *alignedPtrAddressesA, int64_t offsetAddressesA,
+    void *alignedPtrAddressesB, int64_t offsetAddressesB, int64_t numBatches);
+
+// Runs `numGroups` brgemms with the same kernel. Each descriptor holds the
+// element offsets of the A, B and C tiles from the aligned pointers.
+extern "C" MLIR_RUNNERUTILS_EXPORT void xsmm_brgemm_grouped_invoke(
+    const libxsmm_datatype dType, int64_t addr, void *alignedPtrA,
+    int64_t offsetA, void *alignedPtrB, int64_t offsetB, void *alignedPtrC,
+    int64_t offsetC, void *alignedPtrDescs, int64_t offsetDescs,
+    int64_t numBatches, int64_t numGroups);
+
+// Matrix equation over `numArgs` arguments. The descriptor holds the [m, n, ld]
+// of each argument followed by the [kind, op, flags] of each node in
+// pre-order. The invoke takes the arguments as a list of (aligned pointer,
+// offset) pairs.
+extern "C" MLIR_RUNNERUTILS_EXPORT int64_t xsmm_equation_dispatch(
+    const libxsmm_datatype dtype, int64_t m, int64_t n, int64_t ldo,
+    void *alignedPtrDesc, int64_t offsetDesc, int64_t numArgs,
+    int64_t numNodes);
+
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+xsmm_equation_invoke(const libxsmm_datatype dType, int64_t addr,
+                     void *alignedPtrArgs, int64_t offsetArgs,
+                     void *alignedPtrOut, int64_t offsetOut, int64_t numArgs);
+
 extern "C" MLIR_RUNNERUTILS_EXPORT void xsmm_fused_brgemm_invoke(
     const libxsmm_datatype dType, int64_t addr, void *alignedPtrA,
     int64_t offsetA, void *alignedPtrB, int64_t offsetB, void *alignedPtrC,
@@ -82,4 +148,10 @@ extern "C" MLIR_RUNNERUTILS_EXPORT void
 xsmm_intel_amx_tile_config_invoke(const libxsmm_datatype dType, int64_t addr,
                                   void *alignedPtrA, int64_t offset);
 
+// Returns the dispatch cache counters: number of hits, misses and cached
+// kernels. Any of the pointers can be null. Hits and misses are only counted
+// with TPP_XSMM_DISPATCH_CACHE_STATS set.
+extern "C" MLIR_RUNNERUTILS_EXPORT void
+xsmm_dispatch_cache_stats(int64_t *hits, int64_t *misses, int64_t *entries);
+
 #endif // TPP_EXECUTIONENGINE_CRUNNERUTILS_H
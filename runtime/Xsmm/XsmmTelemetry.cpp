@@ -0,0 +1,298 @@
+//===- XsmmTelemetry.cpp - Per-kernel XSMM call telemetry -----------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The records live in a fixed-size open addressing table keyed by the kernel
+// handle, claimed and published the same way as the dispatch cache slots.
+// Counters are updated with relaxed atomic adds, so concurrent invokes of the
+// same kernel from a parallel loop do not serialize.
+//
+//===----------------------------------------------------------------------===//
+
+#include "XsmmTelemetry.h"
+#include "../TraceRunnerUtils.h"
+#include "libxsmm.h" // NOLINT [build/include_subdir]
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace xsmm_telemetry {
+
+namespace {
+
+// Number of records, must be a power of two.
+constexpr uint64_t kNumRecords = 1024;
+constexpr uint64_t kMaxProbes = 64;
+
+// Record states. Any other value is the published kernel handle.
+constexpr uint64_t kEmpty = 0;
+constexpr uint64_t kBusy = 1;
+
+struct Record {
+  std::atomic<uint64_t> state;
+  KernelInfo info;
+  // Shape of the kernel in the trace events.
+  char detail[96];
+  std::atomic<uint64_t> calls;
+  std::atomic<uint64_t> batches;
+  std::atomic<uint64_t> cycles;
+  std::atomic<uint64_t> nanoseconds;
+};
+
+Record records[kNumRecords];
+
+uint64_t hashKernel(uint64_t kernel) {
+  // Kernels are code addresses, mix the low bits that are mostly aligned.
+  kernel ^= kernel >> 33;
+  kernel *= 0xff51afd7ed558ccdULL;
+  kernel ^= kernel >> 33;
+  return kernel;
+}
+
+// Waits until a record under construction is published.
+uint64_t waitForRecord(Record &record) {
+  uint64_t state = record.state.load(std::memory_order_acquire);
+  while (state == kBusy)
+    state = record.state.load(std::memory_order_acquire);
+  return state;
+}
+
+Record *findRecord(uint64_t kernel) {
+  uint64_t hash = hashKernel(kernel);
+  for (uint64_t probe = 0; probe < kMaxProbes; probe++) {
+    Record &record = records[(hash + probe) & (kNumRecords - 1)];
+    uint64_t state = waitForRecord(record);
+    if (state == kEmpty)
+      return nullptr;
+    if (state == kernel)
+      return &record;
+  }
+  return nullptr;
+}
+
+const char *getKindName(KernelKind kind) {
+  switch (kind) {
+  case KernelKind::Gemm:
+    return "gemm";
+  case KernelKind::Brgemm:
+    return "brgemm";
+  case KernelKind::Unary:
+    return "unary";
+  case KernelKind::Binary:
+    return "binary";
+  case KernelKind::FusedBrgemm:
+    return "fused_brgemm";
+  case KernelKind::Equation:
+    return "equation";
+  }
+  return "unknown";
+}
+
+bool isGemmLike(KernelKind kind) {
+  return kind == KernelKind::Gemm || kind == KernelKind::Brgemm ||
+         kind == KernelKind::FusedBrgemm;
+}
+
+// Immutable once the record is published, so it can be read by the trace at
+// exit.
+void formatDetail(Record &record) {
+  const KernelInfo &info = record.info;
+  snprintf(record.detail, sizeof(record.detail),
+           "dtype=%lld M=%lld N=%lld K=%lld op=%lld flags=%#llx",
+           static_cast<long long>(info.dtype), static_cast<long long>(info.m),
+           static_cast<long long>(info.n), static_cast<long long>(info.k),
+           static_cast<long long>(info.op),
+           static_cast<unsigned long long>(info.flags));
+}
+
+// Returns the records of the kernels that were called, most expensive first.
+std::vector<const Record *> getCalledRecords() {
+  std::vector<const Record *> used;
+  for (const Record &record : records) {
+    uint64_t state = record.state.load(std::memory_order_acquire);
+    if (state != kEmpty && state != kBusy &&
+        record.calls.load(std::memory_order_relaxed) != 0)
+      used.push_back(&record);
+  }
+  std::sort(used.begin(), used.end(), [](const Record *lhs, const Record *rhs) {
+    return lhs->cycles.load(std::memory_order_relaxed) >
+           rhs->cycles.load(std::memory_order_relaxed);
+  });
+  return used;
+}
+
+void printTable() {
+  std::vector<const Record *> used = getCalledRecords();
+
+  fprintf(stderr, "XSMM kernel telemetry:\n");
+  fprintf(stderr,
+          "%-12s %5s %6s %6s %6s %4s %18s %12s %14s %12s %10s\n", "kind",
+          "dtype", "M", "N", "K", "op", "flags", "calls", "cycles",
+          "time (ms)", "GFLOP/s");
+  for (const Record *record : used) {
+    const KernelInfo &info = record->info;
+    uint64_t calls = record->calls.load(std::memory_order_relaxed);
+    uint64_t batches = record->batches.load(std::memory_order_relaxed);
+    uint64_t cycles = record->cycles.load(std::memory_order_relaxed);
+    uint64_t nanoseconds = record->nanoseconds.load(std::memory_order_relaxed);
+
+    fprintf(stderr, "%-12s %5lld %6lld %6lld %6lld %4lld %#18llx %12llu %14llu "
+                    "%12.3f ",
+            getKindName(info.kind), static_cast<long long>(info.dtype),
+            static_cast<long long>(info.m), static_cast<long long>(info.n),
+            static_cast<long long>(info.k), static_cast<long long>(info.op),
+            static_cast<unsigned long long>(info.flags),
+            static_cast<unsigned long long>(calls),
+            static_cast<unsigned long long>(cycles), nanoseconds * 1e-6);
+    // Element-wise kernels do not report a FLOP count.
+    if (isGemmLike(info.kind) && nanoseconds != 0) {
+      double flops = 2.0 * info.m * info.n * info.k * batches;
+      fprintf(stderr, "%10.2f\n", flops / nanoseconds);
+    } else {
+      fprintf(stderr, "%10s\n", "-");
+    }
+  }
+}
+
+// Output file of the profile, empty when not written.
+const char *profilePath = "";
+
+void writeProfile() {
+  FILE *file = fopen(profilePath, "w");
+  if (!file) {
+    fprintf(stderr, "TPP_XSMM_PROFILE: cannot open %s\n", profilePath);
+    return;
+  }
+  fprintf(file, "{\"xsmm_kernels\":[");
+  bool first = true;
+  for (const Record *record : getCalledRecords()) {
+    const KernelInfo &info = record->info;
+    uint64_t calls = record->calls.load(std::memory_order_relaxed);
+    uint64_t batches = record->batches.load(std::memory_order_relaxed);
+    uint64_t nanoseconds = record->nanoseconds.load(std::memory_order_relaxed);
+    fprintf(file,
+            "%s\n{\"kind\":\"%s\",\"dtype\":%lld,\"m\":%lld,\"n\":%lld,"
+            "\"k\":%lld,\"op\":%lld,\"flags\":%llu,\"calls\":%llu,"
+            "\"batches\":%llu,\"seconds\":%.9f",
+            first ? "" : ",", getKindName(info.kind),
+            static_cast<long long>(info.dtype), static_cast<long long>(info.m),
+            static_cast<long long>(info.n), static_cast<long long>(info.k),
+            static_cast<long long>(info.op),
+            static_cast<unsigned long long>(info.flags),
+            static_cast<unsigned long long>(calls),
+            static_cast<unsigned long long>(batches), nanoseconds * 1e-9);
+    first = false;
+    if (isGemmLike(info.kind) && nanoseconds != 0) {
+      double flops = 2.0 * info.m * info.n * info.k * batches;
+      fprintf(file, ",\"gflops\":%.3f", flops / nanoseconds);
+    }
+    fputc('}', file);
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+}
+
+bool readTelemetryEnabled() {
+  const char *env = getenv("TPP_XSMM_TELEMETRY");
+  bool enabled = env && strcmp(env, "0") != 0;
+  if (enabled)
+    atexit(printTable);
+  const char *profile = getenv("TPP_XSMM_PROFILE");
+  if (profile && *profile) {
+    profilePath = profile;
+    atexit(writeProfile);
+    enabled = true;
+  }
+  return enabled;
+}
+
+// Thread-safe initialization of function local statics.
+bool isTelemetryEnabled() {
+  static const bool enabled = readTelemetryEnabled();
+  return enabled;
+}
+
+} // namespace
+
+std::atomic<bool> active{false};
+
+bool isEnabled() {
+  if (!isTelemetryEnabled() && !tpp_trace::isEnabled())
+    return false;
+  if (!active.load(std::memory_order_relaxed))
+    active.store(true, std::memory_order_relaxed);
+  return true;
+}
+
+void registerKernel(int64_t kernel, const KernelInfo &info) {
+  uint64_t handle = static_cast<uint64_t>(kernel);
+  if (!isEnabled() || handle == kEmpty || handle == kBusy)
+    return;
+
+  uint64_t hash = hashKernel(handle);
+  for (uint64_t probe = 0; probe < kMaxProbes; probe++) {
+    Record &record = records[(hash + probe) & (kNumRecords - 1)];
+    uint64_t expected = kEmpty;
+    if (record.state.compare_exchange_strong(expected, kBusy,
+                                             std::memory_order_acquire)) {
+      record.info = info;
+      formatDetail(record);
+      record.state.store(handle, std::memory_order_release);
+      return;
+    }
+    // Already registered, the kernel was dispatched again.
+    if (waitForRecord(record) == handle)
+      return;
+  }
+  // Table is full around this hash, the kernel just won't be recorded.
+}
+
+void recordCalls(int64_t kernel, uint64_t numCalls, uint64_t numBatches,
+                 uint64_t cycles, uint64_t nanoseconds) {
+  Record *record = findRecord(static_cast<uint64_t>(kernel));
+  if (!record)
+    return;
+  record->calls.fetch_add(numCalls, std::memory_order_relaxed);
+  record->batches.fetch_add(numBatches, std::memory_order_relaxed);
+  record->cycles.fetch_add(cycles, std::memory_order_relaxed);
+  record->nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+void ScopedCall::begin(int64_t kernel, int64_t numBatches, int64_t numCalls) {
+  this->kernel = kernel;
+  this->numBatches = numBatches * numCalls;
+  this->numCalls = numCalls;
+  start = 0;
+  traceStart = 0;
+  if (tpp_trace::sampleXsmmCall())
+    traceStart = tpp_trace::now();
+  if (isTelemetryEnabled())
+    start = libxsmm_timer_tick();
+}
+
+void ScopedCall::end() {
+  if (isTelemetryEnabled()) {
+    libxsmm_timer_tickint end = libxsmm_timer_tick();
+    uint64_t cycles = libxsmm_timer_ncycles(start, end);
+    uint64_t nanoseconds =
+        static_cast<uint64_t>(libxsmm_timer_duration(start, end) * 1e9);
+    recordCalls(kernel, numCalls, numBatches, cycles, nanoseconds);
+  }
+  if (traceStart) {
+    uint64_t traceEnd = tpp_trace::now();
+    const Record *record = findRecord(static_cast<uint64_t>(kernel));
+    tpp_trace::recordEvent(record ? getKindName(record->info.kind) : "xsmm",
+                           "xsmm", traceStart, traceEnd,
+                           record ? record->detail : nullptr);
+  }
+}
+
+} // namespace xsmm_telemetry
@@ -0,0 +1,96 @@
+//===- XsmmTelemetry.h - Per-kernel XSMM call telemetry -------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Opt-in instrumentation of the XSMM kernel calls. Every dispatched kernel
+// handle is registered with its shape and flags, every invoke of the handle
+// accumulates a call count, the elapsed cycles and time. A table with the
+// achieved GFLOP/s of each kernel is printed at exit.
+//
+// The telemetry is enabled by setting TPP_XSMM_TELEMETRY=1. Setting
+// TPP_XSMM_PROFILE to a file also enables it and writes the records there as
+// JSON at exit: the profile the compiler reads back to revisit the lowering of
+// the kernels that underperformed (see tpp-run -profile-out and -profile-in).
+// The kernels are also registered when tracing (TPP_TRACE), so that the
+// sampled calls of the trace carry their shape. When all are disabled, an
+// invoke only pays for the inline load of a flag.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TPP_EXECUTIONENGINE_XSMMTELEMETRY_H
+#define TPP_EXECUTIONENGINE_XSMMTELEMETRY_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace xsmm_telemetry {
+
+enum class KernelKind : int64_t {
+  Gemm = 1,
+  Brgemm = 2,
+  Unary = 3,
+  Binary = 4,
+  FusedBrgemm = 5,
+  Equation = 6,
+};
+
+// Description of a dispatched kernel. `op` is the unary or binary type of
+// element-wise kernels and is unused otherwise.
+struct KernelInfo {
+  KernelKind kind;
+  int64_t dtype;
+  int64_t m;
+  int64_t n;
+  int64_t k;
+  int64_t flags;
+  int64_t op;
+};
+
+// Returns true if the telemetry or the tracing is enabled.
+bool isEnabled();
+
+// Set by the first isEnabled returning true. Kernels are dispatched, and the
+// dispatch checks isEnabled, before they are invoked.
+extern std::atomic<bool> active;
+
+// Registers a dispatched kernel. Registering a kernel again is a no-op.
+void registerKernel(int64_t kernel, const KernelInfo &info);
+
+// Records `numCalls` calls of a kernel running `numBatches` gemms in total
+// (1 per call for gemms and element-wise kernels). Kernels that were not
+// registered are ignored.
+void recordCalls(int64_t kernel, uint64_t numCalls, uint64_t numBatches,
+                 uint64_t cycles, uint64_t nanoseconds);
+
+// Times the enclosing scope and records it as calls of `kernel`. A sampled
+// call is also recorded as an event of the trace.
+class ScopedCall {
+public:
+  ScopedCall(int64_t kernel, int64_t numBatches = 1, int64_t numCalls = 1)
+      : kernel(0) {
+    if (active.load(std::memory_order_relaxed))
+      begin(kernel, numBatches, numCalls);
+  }
+  ~ScopedCall() {
+    if (kernel)
+      end();
+  }
+
+private:
+  void begin(int64_t kernel, int64_t numBatches, int64_t numCalls);
+  void end();
+
+  int64_t kernel;
+  uint64_t numBatches;
+  uint64_t numCalls;
+  uint64_t start;
+  uint64_t traceStart;
+};
+
+} // namespace xsmm_telemetry
+
+#endif // TPP_EXECUTIONENGINE_XSMMTELEMETRY_H
@@ -0,0 +1,51 @@
+// RUN: env LIBXSMM_TARGET=hsw tpp-opt -pack-vnni="bf16-f32-compute" -split-input-file %s | FileCheck %s --check-prefix=FLAT
+// RUN: env LIBXSMM_TARGET=spr tpp-opt -pack-vnni="bf16-f32-compute" -split-input-file %s | FileCheck %s --check-prefix=VNNI
+// RUN: env LIBXSMM_TARGET=hsw tpp-opt -pack-vnni -split-input-file %s | FileCheck %s --check-prefix=VNNI
+
+func.func @brgemm(%arg0: tensor<32x4x4xbf16>, %arg1: tensor<32x4x4xbf16>,
+                  %arg2: tensor<4x4xbf16>) -> tensor<4x4xbf16>{
+  %0 = linalg.batch_reduce_matmul ins(%arg0, %arg1: tensor<32x4x4xbf16>, tensor<32x4x4xbf16>)
+                                  outs(%arg2: tensor<4x4xbf16>) -> tensor<4x4xbf16>
+  return %0: tensor<4x4xbf16>
+}
+
+// Without a bf16 dot product, the brgemm stays flat and is computed in f32.
+// FLAT-LABEL: brgemm
+// FLAT-NOT: tensor.pack
+// FLAT: linalg.batch_reduce_matmul
+
+// VNNI-LABEL: brgemm
+// VNNI: tensor.pack
+// VNNI-SAME: inner_dims_pos = [1] inner_tiles = [2]
+// VNNI: linalg.generic
+
+// -----
+
+#map = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d2, d3, d5)>
+#map1 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d1, d2, d5, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d1, d3, d4)>
+
+func.func @prepacked_matmul(%pack: tensor<4x4x32x32xbf16>, %pack_0: tensor<4x4x32x32xbf16>,
+                           %pack_1: tensor<4x4x32x32xbf16>) -> tensor<4x4x32x32xbf16> {
+  %1 = linalg.generic {
+    indexing_maps = [#map, #map1, #map2],
+    iterator_types = ["parallel", "parallel", "reduction", "parallel", "parallel", "reduction"]}
+    ins(%pack, %pack_0 : tensor<4x4x32x32xbf16>, tensor<4x4x32x32xbf16>)
+    outs(%pack_1 : tensor<4x4x32x32xbf16>) {
+    ^bb0(%in: bf16, %in_2: bf16, %out: bf16):
+      %4 = arith.mulf %in, %in_2 : bf16
+      %5 = arith.addf %out, %4 : bf16
+      linalg.yield %5 : bf16
+  } -> tensor<4x4x32x32xbf16>
+  return %1 : tensor<4x4x32x32xbf16>
+}
+
+// FLAT-LABEL: prepacked_matmul
+// FLAT-NOT: tensor.pack
+// FLAT: linalg.generic
+// FLAT-SAME: ins(%{{.+}}, %{{.+}} : tensor<4x4x32x32xbf16>, tensor<4x4x32x32xbf16>)
+
+// VNNI-LABEL: prepacked_matmul
+// VNNI: tensor.pack
+// VNNI-SAME: -> tensor<4x4x16x32x2xbf16>
+// VNNI: linalg.generic
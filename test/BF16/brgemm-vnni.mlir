@@ -125,3 +125,32 @@ func.func @already_packed_matmul(%arg0: tensor<4x4x32x32xbf16>, %arg1: tensor<4x
 // CHECK: already_packed_matmul
 // CHECK-NOT: tensor.pack
 // CHECK: linalg.generic
+
+// -----
+
+func.func @brgemm_i8(%arg0: tensor<32x4x8xi8>, %arg1: tensor<32x8x4xi8>,
+                     %arg2: tensor<4x4xi32>) -> tensor<4x4xi32>{
+  %0 = linalg.batch_reduce_matmul ins(%arg0, %arg1: tensor<32x4x8xi8>, tensor<32x8x4xi8>)
+                                  outs(%arg2: tensor<4x4xi32>) -> tensor<4x4xi32>
+  return %0: tensor<4x4xi32>
+}
+
+// CHECK-DAG: #[[MAP:.+]] = affine_map<(d0, d1, d2, d3, d4) -> (d0, d1, d3)>
+// CHECK-DAG: #[[MAP1:.+]] = affine_map<(d0, d1, d2, d3, d4) -> (d0, d3 floordiv 4, d2, d4)>
+// CHECK-DAG: #[[MAP2:.+]] = affine_map<(d0, d1, d2, d3, d4) -> (d1, d2)>
+
+// CHECK-LABEL: brgemm_i8
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<32x4x8xi8>, %[[ARG1:.+]]: tensor<32x8x4xi8>,
+// CHECK-SAME:  %[[ARG2:.+]]: tensor<4x4xi32>
+// CHECK: %[[EMPTY:.+]] = tensor.empty() : tensor<32x2x4x4xi8>
+// CHECK: %[[PACK:.+]] = tensor.pack %[[ARG1]]
+// CHECK-SAME:  inner_dims_pos = [1] inner_tiles = [4] into %[[EMPTY]]
+// CHECK-SAME:  : tensor<32x8x4xi8> -> tensor<32x2x4x4xi8>
+// CHECK: linalg.generic
+// CHECK-SAME: indexing_maps = [#[[MAP]], #[[MAP1]], #[[MAP2]]]
+// CHECK-SAME: ins(%[[ARG0]], %[[PACK]]
+// CHECK-SAME: outs(%[[ARG2]]
+// CHECK: arith.extsi
+// CHECK: arith.extsi
+// CHECK: arith.muli
+// CHECK: arith.addi
@@ -1,4 +1,4 @@
-// RUN: tpp-opt %s -bufferize -convert-check-to-loops | FileCheck %s
+// RUN: tpp-opt %s -bufferize -convert-check-to-loops -split-input-file | FileCheck %s
 
 func.func @entry() {
  %b = arith.constant dense<[
@@ -18,17 +18,51 @@ func.func @entry() {
   // CHECK-DAG: %[[c4:.+]] = arith.constant 4 : index
   // CHECK-DAG: %[[c0:.+]] = arith.constant 0 : index
   // CHECK-DAG: %[[c1:.+]] = arith.constant 1 : index
-  // CHECK-DAG: %[[cst:.+]] = arith.constant 1.000000e-01 : f32
+  // CHECK-DAG: %[[c8:.+]] = arith.constant 8 : index
+  // CHECK-DAG: %[[none:.+]] = arith.constant 0 : i64
+  // CHECK-DAG: %[[cst:.+]] = arith.constant dense<1.000000e-01> : vector<8xf32>
   // CHECK: %[[l0:.+]] = memref.get_global
   // CHECK: %[[l1:.+]] = memref.get_global
-  // CHECK: scf.for %[[arg0:.+]] = %[[c0]] to %[[c4]] step %[[c1]] {
-  // CHECK: scf.for %[[arg1:.+]] = %[[c0]] to %[[c4]] step %[[c1]] {
-  // CHECK: %[[a:.+]] = memref.load %[[l0]][%[[arg0]], %[[arg1]]]
-  // CHECK: %[[b:.+]] = memref.load %[[l1]][%[[arg0]], %[[arg1]]]
-  // CHECK: %[[sub:.+]] = arith.subf %[[a]], %[[b]] : f32
-  // CHECK: %[[abs:.+]] = math.absf %[[sub]] : f32
-  // CHECK: %[[cmp:.+]] = arith.cmpf ole, %[[abs]], %[[cst]]
-  // CHECK: cf.assert %[[cmp]], "Result mismatch"
+  // CHECK: %[[stats:.+]]:5 = scf.parallel (%[[arg0:.+]], %[[arg1:.+]]) = (%[[c0]], %[[c0]]) to (%[[c4]], %[[c4]]) step (%[[c1]], %[[c8]])
+  // CHECK-SAME: -> (i64, i64, i64, f32, f32)
+  // CHECK: %[[a:.+]] = vector.transfer_read %[[l0]][%[[arg0]], %[[arg1]]]
+  // CHECK: %[[b:.+]] = vector.transfer_read %[[l1]][%[[arg0]], %[[arg1]]]
+  // CHECK: %[[sub:.+]] = arith.subf %[[a]], %[[b]] : vector<8xf32>
+  // CHECK: %[[abs:.+]] = math.absf %[[sub]] : vector<8xf32>
+  // CHECK: %[[cmp:.+]] = arith.cmpf ugt, %[[abs]], %[[cst]] : vector<8xf32>
+  // CHECK: %[[mismatch:.+]] = arith.extui %[[cmp]] : vector<8xi1> to vector<8xi64>
+  // CHECK: vector.reduction <add>, %[[mismatch]] : vector<8xi64> into i64
+  // CHECK: vector.reduction <maxnumf>, %[[abs]] : vector<8xf32> into f32
+  // CHECK: scf.reduce
+  // CHECK: %[[failed:.+]] = arith.cmpi sgt, %[[stats]]#0, %[[none]] : i64
+  // CHECK: scf.if %[[failed]] {
+  // CHECK: vector.print str "check.expect_almost_eq: "
+  // CHECK: vector.print %[[stats]]#0 punctuation <no_punctuation> : i64
+  // CHECK: scf.for
+  // CHECK: scf.for
+  // CHECK: memref.load %[[l0]]
+  // CHECK: vector.print str "worst element "
+  // CHECK: cf.assert %{{.+}}, "Result mismatch"
   check.expect_almost_eq(%b, %c, %threshold):tensor<4x4xf32>, tensor<4x4xf32>, f32
   return
 }
+
+// -----
+
+// CHECK-LABEL: @sane_bf16
+// CHECK-SAME: %[[arg:.+]]: memref<3x20xbf16>
+func.func @sane_bf16(%arg0: memref<3x20xbf16>) {
+  // CHECK: %[[counts:.+]]:2 = scf.parallel
+  // CHECK-SAME: -> (i64, i64)
+  // CHECK: %[[read:.+]] = vector.transfer_read %[[arg]]
+  // CHECK-SAME: memref<3x20xbf16>, vector<8xbf16>
+  // CHECK: %[[ext:.+]] = arith.extf %[[read]] : vector<8xbf16> to vector<8xf32>
+  // CHECK: arith.cmpf uno, %[[ext]], %[[ext]] : vector<8xf32>
+  // CHECK: scf.reduce
+  // CHECK: %[[bad:.+]] = arith.addi %[[counts]]#0, %[[counts]]#1 : i64
+  // CHECK: scf.if
+  // CHECK: vector.print str "check.expect_sane: "
+  // CHECK: cf.assert %{{.+}}, "Buffer can't contain NaNs or Infinite values"
+  check.expect_sane(%arg0) : memref<3x20xbf16>
+  return
+}
@@ -1,4 +1,4 @@
-// RUN: tpp-opt %s -convert-linalg-to-xsmm -split-input-file | FileCheck %s
+// RUN: tpp-opt %s -convert-linalg-to-xsmm="skip-operations=equation" -split-input-file | FileCheck %s
 
 #map = affine_map<(d0, d1) -> (d0, d1)>
 #map1 = affine_map<(d0, d1) -> (0, d1)>
@@ -719,3 +719,57 @@ func.func @mul_bcast_row_in1(%arg0: memref<10xf32>, %arg1: memref<10x10xf32>) {
 // CHECK: %[[EXP:.+]] = memref.expand_shape %[[ARG0]] {{\[}}[0, 1]] output_shape [10, 1] : memref<10xf32> into memref<10x1xf32>
 // CHECK: %[[DIS:.+]] = xsmm.binary.dispatch mul [10, 10, 10, 1, 10] flags = (bcast_row_in1) data_type = f32
 // CHECK: xsmm.binary mul(data_type = f32, %[[DIS]], %[[ARG1]], %[[EXP]], %[[ARG1]])
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d0)>
+
+func.func @div_bcast_row_in1(%arg0: memref<10x10xf32>, %arg1: memref<10xf32>) {
+  linalg.generic {
+    indexing_maps = [#map, #map1, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg0, %arg1 : memref<10x10xf32>, memref<10xf32>)
+    outs(%arg0 : memref<10x10xf32>) {
+    ^bb0(%in: f32, %in_1: f32, %out: f32):
+      %0 = arith.divf %in, %in_1 : f32
+      linalg.yield %0 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: div_bcast_row_in1
+// CHECK-SAME: %[[ARG0:.+]]: memref<10x10xf32>, %[[ARG1:.+]]: memref<10xf32>
+// CHECK: %[[EXP:.+]] = memref.expand_shape %[[ARG1]] {{\[}}[0, 1]] output_shape [10, 1] : memref<10xf32> into memref<10x1xf32>
+// CHECK: %[[DIS:.+]] = xsmm.binary.dispatch div [10, 10, 10, 1, 10] flags = (bcast_row_in1) data_type = f32
+// CHECK: xsmm.binary div(data_type = f32, %[[DIS]], %[[ARG0]], %[[EXP]], %[[ARG0]])
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d0)>
+
+// Without equations, a binary sub followed by an in-place unary exp.
+func.func @sub_exp(%arg0: memref<10x10xf32>, %arg1: memref<10xf32>,
+                   %arg2: memref<10x10xf32>) {
+  linalg.generic {
+    indexing_maps = [#map, #map1, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg0, %arg1 : memref<10x10xf32>, memref<10xf32>)
+    outs(%arg2 : memref<10x10xf32>) {
+    ^bb0(%in: f32, %in_1: f32, %out: f32):
+      %0 = arith.subf %in, %in_1 : f32
+      %1 = math.exp %0 : f32
+      linalg.yield %1 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: sub_exp
+// CHECK-SAME: %[[ARG0:.+]]: memref<10x10xf32>, %[[ARG1:.+]]: memref<10xf32>, %[[ARG2:.+]]: memref<10x10xf32>
+// CHECK: %[[EXP:.+]] = memref.expand_shape %[[ARG1]] {{\[}}[0, 1]] output_shape [10, 1] : memref<10xf32> into memref<10x1xf32>
+// CHECK: %[[DIS:.+]] = xsmm.binary.dispatch sub [10, 10, 10, 1, 10] flags = (bcast_row_in1) data_type = f32
+// CHECK: xsmm.binary sub(data_type = f32, %[[DIS]], %[[ARG0]], %[[EXP]], %[[ARG2]])
+// CHECK: %[[DIS1:.+]] = xsmm.unary.dispatch exp [10, 10, 10, 10] flags = (none) data_type = f32
+// CHECK: xsmm.unary exp(data_type = f32, %[[DIS1]], %[[ARG2]], %[[ARG2]])
+// CHECK-NOT: linalg.generic
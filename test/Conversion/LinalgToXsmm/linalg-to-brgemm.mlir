@@ -149,11 +149,9 @@ func.func @brgemm_5(%arg0: memref<9x4x5xf32>, %arg1: memref<9x8x5xf32>, %arg2: m
 // CHECK-LABEL: brgemm_5
 // CHECK-SAME: %[[ARG0:.+]]: memref<9x4x5xf32>, %[[ARG1:.+]]: memref<9x8x5xf32>, %[[ARG2:.+]]: memref<4x8xf32>
 // CHECK: %[[C9:.+]] = arith.constant 9 : i64
-// CHECK: %[[ALLOC:.+]] = memref.alloc() : memref<9x5x8xf32>
-// CHECK: linalg.transpose ins(%[[ARG1]] : memref<9x8x5xf32>)
-// CHECK-SAME:  outs(%[[ALLOC]] : memref<9x5x8xf32>) permutation = [0, 2, 1]
-// CHECK: %[[DIS:.+]] = xsmm.brgemm.dispatch [4, 8, 5, 5, 8, 8, 20, 40] flags = (none) data_type = f32
-// CHECK: xsmm.brgemm(data_type = f32, %[[DIS]], %[[ARG0]], %[[ALLOC]], %[[ARG2]], %[[C9]])
+// CHECK-NOT: linalg.transpose
+// CHECK: %[[DIS:.+]] = xsmm.brgemm.dispatch [4, 8, 5, 5, 5, 8, 20, 40] flags = (trans_b) data_type = f32
+// CHECK: xsmm.brgemm(data_type = f32, %[[DIS]], %[[ARG0]], %[[ARG1]], %[[ARG2]], %[[C9]])
 
 
 // -----
@@ -229,14 +227,9 @@ func.func @gemm_3(%arg0: memref<64x32xf32>, %arg1: memref<32x64xf32>, %arg2: mem
 
 // CHECK-LABEL: gemm_3
 // CHECK-SAME: %[[ARG0:.+]]: memref<64x32xf32>, %[[ARG1:.+]]: memref<32x64xf32>, %[[ARG2:.+]]: memref<64x64xf32>
-// CHECK: %[[ALLOC:.+]] = memref.alloc() : memref<32x64xf32>
-// CHECK: %[[DIS_TRANS:.+]] = xsmm.unary.dispatch transpose [64, 32, 32, 64] flags = (none) data_type = f32
-// CHECK: xsmm.unary transpose(data_type = f32, %[[DIS_TRANS]], %[[ARG0]], %[[ALLOC]])
-// CHECK: %[[ALLOC_0:.+]] = memref.alloc() : memref<64x32xf32>
-// CHECK: %[[DIS_TRANS_1:.+]] = xsmm.unary.dispatch transpose [32, 64, 64, 32] flags = (none) data_type = f32
-// CHECK: xsmm.unary transpose(data_type = f32, %[[DIS_TRANS_1]], %[[ARG1]], %[[ALLOC_0]])
-// CHECK: %[[DIS:.+]] = xsmm.gemm.dispatch [64, 64, 32, 32, 64, 64] flags = (none) data_type = f32
-// CHECK: xsmm.gemm(data_type = f32, %[[DIS]], %[[ALLOC_0]], %[[ALLOC]], %[[ARG2]])
+// CHECK-NOT: xsmm.unary transpose
+// CHECK: %[[DIS:.+]] = xsmm.gemm.dispatch [64, 64, 32, 64, 32, 64] flags = (trans_a, trans_b) data_type = f32
+// CHECK: xsmm.gemm(data_type = f32, %[[DIS]], %[[ARG1]], %[[ARG0]], %[[ARG2]])
 
 // -----
 
@@ -260,11 +253,9 @@ func.func @gemm_4(%arg0: memref<64x32xf32>, %arg1: memref<64x32xf32>, %arg2: mem
 
 // CHECK-LABEL: gemm_4
 // CHECK-SAME: %[[ARG0:.+]]: memref<64x32xf32>, %[[ARG1:.+]]: memref<64x32xf32>, %[[ARG2:.+]]: memref<64x64xf32>
-// CHECK: %[[ALLOC:.+]] = memref.alloc() : memref<32x64xf32>
-// CHECK: %[[DIS_TRAN:.+]] = xsmm.unary.dispatch transpose [64, 32, 32, 64] flags = (none) data_type = f32
-// CHECK: xsmm.unary transpose(data_type = f32, %[[DIS_TRAN]], %[[ARG0]], %[[ALLOC]])
-// CHECK: %[[DIS:.+]] = xsmm.gemm.dispatch [64, 64, 32, 32, 64, 64] flags = (none) data_type = f32
-// CHECK: xsmm.gemm(data_type = f32, %[[DIS]], %[[ARG1]], %[[ALLOC]], %[[ARG2]])
+// CHECK-NOT: xsmm.unary transpose
+// CHECK: %[[DIS:.+]] = xsmm.gemm.dispatch [64, 64, 32, 32, 32, 64] flags = (trans_b) data_type = f32
+// CHECK: xsmm.gemm(data_type = f32, %[[DIS]], %[[ARG1]], %[[ARG0]], %[[ARG2]])
 
 // -----
 
@@ -0,0 +1,255 @@
+// RUN: tpp-opt %s -convert-linalg-to-xsmm -split-input-file | FileCheck %s
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d1)>
+
+func.func @bias_relu(%arg0: memref<64x32xf32>, %arg1: memref<32xf32>,
+                     %arg2: memref<64x32xf32>) {
+  %cst = arith.constant 0.000000e+00 : f32
+  linalg.generic {
+    indexing_maps = [#map, #map1, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg0, %arg1 : memref<64x32xf32>, memref<32xf32>)
+    outs(%arg2 : memref<64x32xf32>) {
+    ^bb0(%in: f32, %in_1: f32, %out: f32):
+      %0 = arith.addf %in, %in_1 : f32
+      %1 = arith.maximumf %0, %cst : f32
+      linalg.yield %1 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: bias_relu
+// CHECK-SAME: %[[ARG0:.+]]: memref<64x32xf32>, %[[ARG1:.+]]: memref<32xf32>, %[[ARG2:.+]]: memref<64x32xf32>
+// CHECK: %[[DIS:.+]] = xsmm.equation.dispatch [64, 32, 32] args = [64, 32, 32, 1, 32, 32]
+// CHECK-SAME: nodes = [1, 5, 0, 2, 1, 8, 0, 0, 0, 0, 1, 0] data_type = f32
+// CHECK: xsmm.equation(data_type = f32, %[[DIS]], %[[ARG0]], %[[ARG1]], %[[ARG2]])
+// CHECK-NOT: linalg.generic
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d0)>
+
+// The numerator of a softmax, exp(input - max), in a single kernel.
+func.func @sub_exp(%arg0: memref<10x10xf32>, %arg1: memref<10xf32>,
+                   %arg2: memref<10x10xf32>) {
+  linalg.generic {
+    indexing_maps = [#map, #map1, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg0, %arg1 : memref<10x10xf32>, memref<10xf32>)
+    outs(%arg2 : memref<10x10xf32>) {
+    ^bb0(%in: f32, %in_1: f32, %out: f32):
+      %0 = arith.subf %in, %in_1 : f32
+      %1 = math.exp %0 : f32
+      linalg.yield %1 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: sub_exp
+// CHECK-SAME: %[[ARG0:.+]]: memref<10x10xf32>, %[[ARG1:.+]]: memref<10xf32>, %[[ARG2:.+]]: memref<10x10xf32>
+// CHECK: %[[DIS:.+]] = xsmm.equation.dispatch [10, 10, 10] args = [10, 10, 10, 10, 1, 1]
+// CHECK-SAME: nodes = [1, 17, 0, 2, 3, 2, 0, 0, 0, 0, 1, 0] data_type = f32
+// CHECK: xsmm.equation(data_type = f32, %[[DIS]], %[[ARG0]], %[[ARG1]], %[[ARG2]])
+// CHECK-NOT: xsmm.binary
+// CHECK-NOT: xsmm.unary
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+
+func.func @add_mul(%arg0: memref<16x16xf32>, %arg1: memref<16x16xf32>,
+                   %arg2: memref<16x16xf32>, %arg3: memref<16x16xf32>) {
+  linalg.generic {
+    indexing_maps = [#map, #map, #map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg0, %arg1, %arg2 : memref<16x16xf32>, memref<16x16xf32>, memref<16x16xf32>)
+    outs(%arg3 : memref<16x16xf32>) {
+    ^bb0(%in: f32, %in_1: f32, %in_2: f32, %out: f32):
+      %0 = arith.addf %in, %in_1 : f32
+      %1 = arith.mulf %0, %in_2 : f32
+      linalg.yield %1 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: add_mul
+// CHECK-SAME: %[[ARG0:.+]]: memref<16x16xf32>, %[[ARG1:.+]]: memref<16x16xf32>, %[[ARG2:.+]]: memref<16x16xf32>, %[[ARG3:.+]]: memref<16x16xf32>
+// CHECK: %[[DIS:.+]] = xsmm.equation.dispatch [16, 16, 16] args = [16, 16, 16, 16, 16, 16, 16, 16, 16]
+// CHECK-SAME: nodes = [2, 2, 0, 2, 1, 0, 0, 0, 0, 0, 1, 0, 0, 2, 0] data_type = f32
+// CHECK: xsmm.equation(data_type = f32, %[[DIS]], %[[ARG0]], %[[ARG1]], %[[ARG2]], %[[ARG3]])
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+
+// An input used several times is a single argument.
+func.func @square_plus(%arg0: memref<16x16xf32>, %arg1: memref<16x16xf32>) {
+  linalg.generic {
+    indexing_maps = [#map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg0 : memref<16x16xf32>)
+    outs(%arg1 : memref<16x16xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      %0 = arith.mulf %in, %in : f32
+      %1 = arith.addf %0, %in : f32
+      linalg.yield %1 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: square_plus
+// CHECK-SAME: %[[ARG0:.+]]: memref<16x16xf32>, %[[ARG1:.+]]: memref<16x16xf32>
+// CHECK: %[[DIS:.+]] = xsmm.equation.dispatch [16, 16, 16] args = [16, 16, 16]
+// CHECK-SAME: nodes = [2, 1, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0] data_type = f32
+// CHECK: xsmm.equation(data_type = f32, %[[DIS]], %[[ARG0]], %[[ARG1]])
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+
+// Single operations are left to the unary and binary patterns.
+func.func @single_add(%arg0: memref<16x16xf32>, %arg1: memref<16x16xf32>,
+                      %arg2: memref<16x16xf32>) {
+  linalg.generic {
+    indexing_maps = [#map, #map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg0, %arg1 : memref<16x16xf32>, memref<16x16xf32>)
+    outs(%arg2 : memref<16x16xf32>) {
+    ^bb0(%in: f32, %in_1: f32, %out: f32):
+      %0 = arith.addf %in, %in_1 : f32
+      linalg.yield %0 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: single_add
+// CHECK-NOT: xsmm.equation
+// CHECK: xsmm.binary add
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+
+func.func @accumulate(%arg0: memref<16x16xf32>, %arg1: memref<16x16xf32>) {
+  linalg.generic {
+    indexing_maps = [#map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg0 : memref<16x16xf32>)
+    outs(%arg1 : memref<16x16xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      %0 = arith.mulf %in, %in : f32
+      %1 = arith.addf %0, %out : f32
+      linalg.yield %1 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: accumulate
+// CHECK-NOT: xsmm.equation
+// CHECK: linalg.generic
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+
+func.func @unsupported_op(%arg0: memref<16x16xf32>, %arg1: memref<16x16xf32>) {
+  linalg.generic {
+    indexing_maps = [#map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg0 : memref<16x16xf32>)
+    outs(%arg1 : memref<16x16xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      %0 = math.log %in : f32
+      %1 = math.exp %0 : f32
+      linalg.yield %1 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: unsupported_op
+// CHECK-NOT: xsmm.equation
+// CHECK: linalg.generic
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+
+// Scalar constants other than the zero of a relu are not arguments.
+func.func @scale_add(%arg0: memref<16x16xf32>, %arg1: memref<16x16xf32>) {
+  %cst = arith.constant 5.000000e-01 : f32
+  linalg.generic {
+    indexing_maps = [#map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg0 : memref<16x16xf32>)
+    outs(%arg1 : memref<16x16xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      %0 = arith.mulf %in, %cst : f32
+      %1 = arith.addf %0, %in : f32
+      linalg.yield %1 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: scale_add
+// CHECK-NOT: xsmm.equation
+// CHECK: linalg.generic
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> ()>
+
+// SGD with momentum, v' = mu * v + g and w' = w - lr * v', in place. The
+// weights are updated first, while the momentum is still the old one.
+func.func @sgd_momentum(%w: memref<64x32xf32>, %g: memref<64x32xf32>,
+                        %v: memref<64x32xf32>, %mu: memref<f32>,
+                        %lr: memref<f32>) {
+  linalg.generic {
+    indexing_maps = [#map, #map, #map, #map1, #map1, #map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%w, %g, %v, %mu, %lr : memref<64x32xf32>, memref<64x32xf32>,
+        memref<64x32xf32>, memref<f32>, memref<f32>)
+    outs(%v, %w : memref<64x32xf32>, memref<64x32xf32>) {
+    ^bb0(%in_w: f32, %in_g: f32, %in_v: f32, %in_mu: f32, %in_lr: f32,
+         %out_v: f32, %out_w: f32):
+      %0 = arith.mulf %in_mu, %in_v : f32
+      %1 = arith.addf %0, %in_g : f32
+      %2 = arith.mulf %in_lr, %1 : f32
+      %3 = arith.subf %in_w, %2 : f32
+      linalg.yield %1, %3 : f32, f32
+  }
+  return
+}
+
+// CHECK-LABEL: sgd_momentum
+// CHECK-SAME: %[[W:.+]]: memref<64x32xf32>, %[[G:.+]]: memref<64x32xf32>, %[[V:.+]]: memref<64x32xf32>, %[[MU:.+]]: memref<f32>, %[[LR:.+]]: memref<f32>
+// CHECK: %[[DIS:.+]] = xsmm.equation.dispatch [64, 32, 32] args = [64, 32, 32, 1, 1, 1, 1, 1, 1, 64, 32, 32, 64, 32, 32]
+// CHECK: xsmm.equation(data_type = f32, %[[DIS]], %[[W]], %[[LR]], %[[MU]], %[[V]], %[[G]], %[[W]])
+// CHECK: %[[DIS1:.+]] = xsmm.equation.dispatch [64, 32, 32] args = [1, 1, 1, 64, 32, 32, 64, 32, 32]
+// CHECK: xsmm.equation(data_type = f32, %[[DIS1]], %[[MU]], %[[V]], %[[G]], %[[V]])
+// CHECK-NOT: linalg.generic
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+
+// Each output overwrites an operand of the other one, no order works.
+func.func @swapped_outputs(%arg0: memref<64x32xf32>, %arg1: memref<64x32xf32>) {
+  linalg.generic {
+    indexing_maps = [#map, #map, #map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg0, %arg1 : memref<64x32xf32>, memref<64x32xf32>)
+    outs(%arg1, %arg0 : memref<64x32xf32>, memref<64x32xf32>) {
+    ^bb0(%in: f32, %in_1: f32, %out: f32, %out_1: f32):
+      %0 = arith.addf %in, %in_1 : f32
+      %1 = arith.subf %in, %in_1 : f32
+      linalg.yield %0, %1 : f32, f32
+  }
+  return
+}
+
+// CHECK-LABEL: swapped_outputs
+// CHECK-NOT: xsmm.equation
+// CHECK: linalg.generic
@@ -0,0 +1,98 @@
+// RUN: tpp-opt %s -convert-linalg-to-xsmm -split-input-file | FileCheck %s
+
+#map = affine_map<(d0, d1, d2) -> (d0, d1)>
+#map1 = affine_map<(d0, d1, d2) -> (d0, d2)>
+
+func.func @embedding_bag(%arg0: memref<1000x64xf32>, %arg1: memref<32x4xi64>,
+                         %arg2: memref<32x64xf32>) {
+  linalg.generic {
+    indexing_maps = [#map, #map1],
+    iterator_types = ["parallel", "reduction", "parallel"]}
+    ins(%arg1 : memref<32x4xi64>) outs(%arg2 : memref<32x64xf32>) {
+    ^bb0(%in: i64, %out: f32):
+      %0 = arith.index_cast %in : i64 to index
+      %1 = linalg.index 2 : index
+      %2 = memref.load %arg0[%0, %1] : memref<1000x64xf32>
+      %3 = arith.addf %2, %out : f32
+      linalg.yield %3 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: embedding_bag
+// CHECK-SAME: %[[ARG0:.+]]: memref<1000x64xf32>, %[[ARG1:.+]]: memref<32x4xi64>, %[[ARG2:.+]]: memref<32x64xf32>
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : index
+// CHECK-DAG: %[[C1:.+]] = arith.constant 1 : index
+// CHECK-DAG: %[[C3:.+]] = arith.constant 3 : index
+// CHECK-DAG: %[[C4:.+]] = arith.constant 4 : index
+// CHECK-DAG: %[[C32:.+]] = arith.constant 32 : index
+// CHECK: %[[DIS:.+]] = xsmm.binary.dispatch add [1, 64, 64, 64, 64] flags = (none) data_type = f32
+// CHECK: scf.for %[[BAG:.+]] = %[[C0]] to %[[C32]] step %[[C1]]
+// CHECK: scf.for %[[LOOKUP:.+]] = %[[C0]] to %[[C4]] step %[[C1]]
+// CHECK: %[[NEXT:.+]] = arith.addi %[[LOOKUP]], %[[C1]]
+// CHECK: %[[CLAMP:.+]] = arith.minui %[[NEXT]], %[[C3]]
+// CHECK: %[[IDX:.+]] = memref.load %[[ARG1]][%[[BAG]], %[[LOOKUP]]]
+// CHECK: %[[ROW:.+]] = arith.index_cast %[[IDX]] : i64 to index
+// CHECK: %[[NEXT_IDX:.+]] = memref.load %[[ARG1]][%[[BAG]], %[[CLAMP]]]
+// CHECK: %[[NEXT_ROW:.+]] = arith.index_cast %[[NEXT_IDX]] : i64 to index
+// CHECK: memref.prefetch %[[ARG0]][%[[NEXT_ROW]], %[[C0]]], read, locality<3>, data
+// CHECK: %[[TABLE_ROW:.+]] = memref.subview %[[ARG0]][%[[ROW]], 0] [1, 64] [1, 1]
+// CHECK: %[[OUT_ROW:.+]] = memref.subview %[[ARG2]][%[[BAG]], 0] [1, 64] [1, 1]
+// CHECK: xsmm.binary add(data_type = f32, %[[DIS]], %[[TABLE_ROW]], %[[OUT_ROW]], %[[OUT_ROW]])
+// CHECK-NOT: linalg.generic
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0)>
+#map1 = affine_map<(d0, d1) -> (d0, d1)>
+
+func.func @gather(%arg0: memref<1000x64xf32>, %arg1: memref<32xindex>,
+                  %arg2: memref<32x64xf32>) {
+  linalg.generic {
+    indexing_maps = [#map, #map1],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg1 : memref<32xindex>) outs(%arg2 : memref<32x64xf32>) {
+    ^bb0(%in: index, %out: f32):
+      %0 = linalg.index 1 : index
+      %1 = memref.load %arg0[%in, %0] : memref<1000x64xf32>
+      linalg.yield %1 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: gather
+// CHECK-SAME: %[[ARG0:.+]]: memref<1000x64xf32>, %[[ARG1:.+]]: memref<32xindex>, %[[ARG2:.+]]: memref<32x64xf32>
+// CHECK: %[[DIS:.+]] = xsmm.unary.dispatch identity [1, 64, 64, 64] flags = (none) data_type = f32
+// CHECK: scf.for %[[BAG:.+]] =
+// CHECK-NOT: scf.for
+// CHECK: %[[ROW:.+]] = memref.load %[[ARG1]][%[[BAG]]]
+// CHECK: memref.prefetch %[[ARG0]]
+// CHECK: %[[TABLE_ROW:.+]] = memref.subview %[[ARG0]][%[[ROW]], 0] [1, 64] [1, 1]
+// CHECK: %[[OUT_ROW:.+]] = memref.subview %[[ARG2]][%[[BAG]], 0] [1, 64] [1, 1]
+// CHECK: xsmm.unary identity(data_type = f32, %[[DIS]], %[[TABLE_ROW]], %[[OUT_ROW]])
+
+// -----
+
+#map = affine_map<(d0, d1, d2) -> (d0, d1)>
+#map1 = affine_map<(d0, d1, d2) -> (d0, d2)>
+
+// The rows are not contiguous in the table.
+func.func @embedding_bag_strided(%arg0: memref<1000x64xf32, strided<[1, 1000]>>,
+                                 %arg1: memref<32x4xi64>, %arg2: memref<32x64xf32>) {
+  linalg.generic {
+    indexing_maps = [#map, #map1],
+    iterator_types = ["parallel", "reduction", "parallel"]}
+    ins(%arg1 : memref<32x4xi64>) outs(%arg2 : memref<32x64xf32>) {
+    ^bb0(%in: i64, %out: f32):
+      %0 = arith.index_cast %in : i64 to index
+      %1 = linalg.index 2 : index
+      %2 = memref.load %arg0[%0, %1] : memref<1000x64xf32, strided<[1, 1000]>>
+      %3 = arith.addf %2, %out : f32
+      linalg.yield %3 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: embedding_bag_strided
+// CHECK-NOT: xsmm.binary
+// CHECK: linalg.generic
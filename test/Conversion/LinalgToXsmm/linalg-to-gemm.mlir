@@ -18,6 +18,36 @@ func.func @simple_gemm(%arg0: memref<32x64xf32, strided<[64, 1], offset: ?>>,
 
 // -----
 
+func.func @gemm_transpose_b(%arg0: memref<32x64xf32>, %arg1: memref<48x64xf32>,
+                            %arg2: memref<32x48xf32>) {
+  linalg.matmul_transpose_b ins(%arg0, %arg1 : memref<32x64xf32>, memref<48x64xf32>)
+                            outs(%arg2 : memref<32x48xf32>)
+  return
+}
+
+// CHECK-LABEL: gemm_transpose_b
+// CHECK-SAME: %[[ARG0:.+]]: memref<32x64xf32>, %[[ARG1:.+]]: memref<48x64xf32>, %[[ARG2:.+]]: memref<32x48xf32>
+// CHECK-NOT: xsmm.unary transpose
+// CHECK: %[[DIS:.+]] = xsmm.gemm.dispatch [32, 48, 64, 64, 64, 48] flags = (trans_b) data_type = f32
+// CHECK: xsmm.gemm(data_type = f32, %[[DIS]], %[[ARG0]], %[[ARG1]], %[[ARG2]])
+
+// -----
+
+func.func @gemm_transpose_a(%arg0: memref<64x32xf32>, %arg1: memref<64x48xf32>,
+                            %arg2: memref<32x48xf32>) {
+  linalg.matmul_transpose_a ins(%arg0, %arg1 : memref<64x32xf32>, memref<64x48xf32>)
+                            outs(%arg2 : memref<32x48xf32>)
+  return
+}
+
+// CHECK-LABEL: gemm_transpose_a
+// CHECK-SAME: %[[ARG0:.+]]: memref<64x32xf32>, %[[ARG1:.+]]: memref<64x48xf32>, %[[ARG2:.+]]: memref<32x48xf32>
+// CHECK-NOT: xsmm.unary transpose
+// CHECK: %[[DIS:.+]] = xsmm.gemm.dispatch [32, 48, 64, 32, 48, 48] flags = (trans_a) data_type = f32
+// CHECK: xsmm.gemm(data_type = f32, %[[DIS]], %[[ARG0]], %[[ARG1]], %[[ARG2]])
+
+// -----
+
 #map = affine_map<(d0, d1, d2) -> (d0, d1)>
 #map1 = affine_map<(d0, d1, d2) -> (d2, d1)>
 #map2 = affine_map<(d0, d1, d2) -> (d2, d0)>
@@ -55,11 +85,10 @@ func.func @mha_query_times_key(%arg0: memref<64x32x8x64xf32>, %arg1: memref<64x3
 // CHECK-SAME:  : memref<64x32x8x64xf32> to memref<32x64xf32, strided<[512, 1], offset: ?>>
 // CHECK: %[[SUB_1:.+]] = memref.subview %[[ARG1]][%[[ARG3]], 0, %[[ARG4]], 0] [1, 32, 1, 64] [1, 1, 1, 1]
 // CHECK-SAME:  : memref<64x32x8x64xf32> to memref<32x64xf32, strided<[512, 1], offset: ?>>
-// CHECK: %[[ALLOC:.+]] = memref.alloc() : memref<64x32xf32>
-// CHECK: %[[TRAN:.+]] = xsmm.unary.dispatch transpose [32, 64, 512, 32] flags = (none) data_type = f32
-// CHECK: xsmm.unary transpose(data_type = f32, %[[TRAN]], %[[SUB_0]], %[[ALLOC]])
-// CHECK: %[[GEMM:.+]] = xsmm.gemm.dispatch [32, 32, 64, 512, 32, 32] flags = (none) data_type = f32
-// CHECK: xsmm.gemm(data_type = f32, %[[GEMM]], %[[SUB_1]], %[[ALLOC]], %[[SUB]])
+// CHECK-NOT: memref.alloc
+// CHECK-NOT: xsmm.unary transpose
+// CHECK: %[[GEMM:.+]] = xsmm.gemm.dispatch [32, 32, 64, 512, 512, 32] flags = (trans_b) data_type = f32
+// CHECK: xsmm.gemm(data_type = f32, %[[GEMM]], %[[SUB_1]], %[[SUB_0]], %[[SUB]])
 
 // -----
 
@@ -362,3 +391,133 @@ func.func @non_square_vnni_gemm_1(%arg0: memref<4x16xbf16, strided<[64, 1], offs
 // CHECK-SAME:  %[[ARG2:.+]]: memref<4x64xbf16, strided<[64, 1], offset: ?>>
 // CHECK: %[[DIS:.+]] = xsmm.gemm.dispatch [4, 64, 16, 64, 64, 64] flags = (vnni_b) data_type = bf16
 // CHECK: xsmm.gemm(data_type = bf16, %[[DIS]], %[[ARG0]], %[[ARG1]], %[[ARG2]])
+
+// -----
+
+func.func @simple_gemm_i8(%arg0: memref<32x64xi8>, %arg1: memref<64x32xi8>,
+                          %arg2: memref<32x32xi32>) {
+  linalg.matmul ins(%arg0, %arg1 : memref<32x64xi8>, memref<64x32xi8>)
+                outs(%arg2 : memref<32x32xi32>)
+  return
+}
+
+// CHECK-LABEL: simple_gemm_i8
+// CHECK-SAME: %[[ARG0:.+]]: memref<32x64xi8>, %[[ARG1:.+]]: memref<64x32xi8>, %[[ARG2:.+]]: memref<32x32xi32>
+// CHECK: %[[DIS:.+]] = xsmm.gemm.dispatch [32, 32, 64, 64, 32, 32] flags = (none) data_type = i8
+// CHECK: xsmm.gemm(data_type = i8, %[[DIS]], %[[ARG0]], %[[ARG1]], %[[ARG2]])
+
+// -----
+
+#map = affine_map<(d0, d1, d2, d3) -> (d1, d3)>
+#map1 = affine_map<(d0, d1, d2, d3) -> (d3 floordiv 4, d2, d0)>
+#map2 = affine_map<(d0, d1, d2, d3) -> (d1, d2)>
+
+func.func @vnni_gemm_i8(%arg0: memref<64x64xi8>, %arg1: memref<16x64x4xi8>,
+                        %arg2: memref<64x64xi32>) {
+  linalg.generic {
+    indexing_maps = [#map, #map1, #map2],
+    iterator_types = ["reduction", "parallel", "parallel", "reduction"]}
+    ins(%arg0, %arg1 : memref<64x64xi8>, memref<16x64x4xi8>)
+    outs(%arg2 : memref<64x64xi32>) {
+      ^bb0(%in: i8, %in_2: i8, %out: i32):
+        %0 = arith.extsi %in : i8 to i32
+        %1 = arith.extsi %in_2 : i8 to i32
+        %2 = arith.muli %0, %1 : i32
+        %3 = arith.addi %out, %2 : i32
+        linalg.yield %3 : i32
+    }
+  return
+}
+
+// CHECK-LABEL: vnni_gemm_i8
+// CHECK-SAME:  %[[ARG0:.+]]: memref<64x64xi8>, %[[ARG1:.+]]: memref<16x64x4xi8>, %[[ARG2:.+]]: memref<64x64xi32>
+// CHECK: %[[DIS:.+]] = xsmm.gemm.dispatch [64, 64, 64, 64, 64, 64] flags = (vnni_b) data_type = i8
+// CHECK: xsmm.gemm(data_type = i8, %[[DIS]], %[[ARG0]], %[[ARG1]], %[[ARG2]])
+
+// -----
+
+func.func @simple_gemm_f16(%arg0: memref<32x64xf16>, %arg1: memref<64x32xf16>,
+                           %arg2: memref<32x32xf16>) {
+  linalg.matmul ins(%arg0, %arg1 : memref<32x64xf16>, memref<64x32xf16>)
+                outs(%arg2 : memref<32x32xf16>)
+  return
+}
+
+// CHECK-LABEL: simple_gemm_f16
+// CHECK-SAME: %[[ARG0:.+]]: memref<32x64xf16>, %[[ARG1:.+]]: memref<64x32xf16>, %[[ARG2:.+]]: memref<32x32xf16>
+// CHECK: %[[DIS:.+]] = xsmm.gemm.dispatch [32, 32, 64, 64, 32, 32] flags = (none) data_type = f16
+// CHECK: xsmm.gemm(data_type = f16, %[[DIS]], %[[ARG0]], %[[ARG1]], %[[ARG2]])
+
+// -----
+
+#map = affine_map<(d0, d1, d2) -> (d0, d2)>
+#map1 = affine_map<(d0, d1, d2) -> (d2, d1)>
+#map2 = affine_map<(d0, d1, d2) -> (d0, d1)>
+
+func.func @simple_gemm_fp8(%arg0: memref<32x64xf8E4M3FN>, %arg1: memref<64x32xf8E4M3FN>,
+                           %arg2: memref<32x32xf32>) {
+  linalg.generic {
+    indexing_maps = [#map, #map1, #map2],
+    iterator_types = ["parallel", "parallel", "reduction"]}
+    ins(%arg0, %arg1 : memref<32x64xf8E4M3FN>, memref<64x32xf8E4M3FN>)
+    outs(%arg2 : memref<32x32xf32>) {
+      ^bb0(%in: f8E4M3FN, %in_2: f8E4M3FN, %out: f32):
+        %0 = arith.extf %in : f8E4M3FN to f32
+        %1 = arith.extf %in_2 : f8E4M3FN to f32
+        %2 = arith.mulf %0, %1 : f32
+        %3 = arith.addf %out, %2 : f32
+        linalg.yield %3 : f32
+    }
+  return
+}
+
+// CHECK-LABEL: simple_gemm_fp8
+// CHECK-SAME: %[[ARG0:.+]]: memref<32x64xf8E4M3FN>, %[[ARG1:.+]]: memref<64x32xf8E4M3FN>, %[[ARG2:.+]]: memref<32x32xf32>
+// CHECK: %[[DIS:.+]] = xsmm.gemm.dispatch [32, 32, 64, 64, 32, 32] flags = (none) data_type = hf8
+// CHECK: xsmm.gemm(data_type = hf8, %[[DIS]], %[[ARG0]], %[[ARG1]], %[[ARG2]])
+
+// -----
+
+func.func @dynamic_m_gemm(%arg0: memref<?x64xf32>, %arg1: memref<64x32xf32>,
+                          %arg2: memref<?x32xf32>) {
+  linalg.matmul ins(%arg0, %arg1 : memref<?x64xf32>, memref<64x32xf32>)
+                outs(%arg2 : memref<?x32xf32>)
+  return
+}
+
+// CHECK-LABEL: dynamic_m_gemm
+// CHECK-SAME: %[[ARG0:.+]]: memref<?x64xf32>, %[[ARG1:.+]]: memref<64x32xf32>, %[[ARG2:.+]]: memref<?x32xf32>
+// CHECK: %[[C0:.+]] = arith.constant 0 : index
+// CHECK: %[[DIM:.+]] = memref.dim %[[ARG2]], %[[C0]] : memref<?x32xf32>
+// CHECK: %[[M:.+]] = arith.index_cast %[[DIM]] : index to i64
+// CHECK: %[[DIS:.+]] = xsmm.gemm.dispatch [%[[M]], 32, 64, 64, 32, 32] flags = (none) data_type = f32
+// CHECK: xsmm.gemm(data_type = f32, %[[DIS]], %[[ARG0]], %[[ARG1]], %[[ARG2]])
+
+// -----
+
+// Dynamic n changes the leading dimensions, keep the matmul.
+func.func @dynamic_n_gemm(%arg0: memref<32x64xf32>, %arg1: memref<64x?xf32>,
+                          %arg2: memref<32x?xf32>) {
+  linalg.matmul ins(%arg0, %arg1 : memref<32x64xf32>, memref<64x?xf32>)
+                outs(%arg2 : memref<32x?xf32>)
+  return
+}
+
+// CHECK-LABEL: dynamic_n_gemm
+// CHECK-NOT: xsmm.gemm
+// CHECK: linalg.matmul
+
+// -----
+
+// A bf16 gemm accumulating in f32 keeps its f32 output.
+func.func @mixed_gemm(%arg0: memref<64x32xbf16>, %arg1: memref<32x64xbf16>,
+                      %arg2: memref<64x64xf32>) {
+  linalg.matmul ins(%arg0, %arg1 : memref<64x32xbf16>, memref<32x64xbf16>)
+                outs(%arg2 : memref<64x64xf32>)
+  return
+}
+
+// CHECK-LABEL: mixed_gemm
+// CHECK-SAME:  %[[ARG0:.+]]: memref<64x32xbf16>, %[[ARG1:.+]]: memref<32x64xbf16>, %[[ARG2:.+]]: memref<64x64xf32>
+// CHECK: %[[DIS:.+]] = xsmm.gemm.dispatch [64, 64, 32, 32, 64, 64] flags = (none) data_type = bf16 output_type = f32
+// CHECK: xsmm.gemm(data_type = bf16, %[[DIS]], %[[ARG0]], %[[ARG1]], %[[ARG2]])
@@ -0,0 +1,193 @@
+// RUN: tpp-opt %s -convert-linalg-to-xsmm -split-input-file | FileCheck %s
+
+func.func @reduce_rows_add(%arg0: memref<256x1024xf32>, %arg1: memref<256xf32>) {
+  %cst = arith.constant 0.000000e+00 : f32
+  linalg.fill ins(%cst : f32) outs(%arg1 : memref<256xf32>)
+  linalg.reduce ins(%arg0 : memref<256x1024xf32>) outs(%arg1 : memref<256xf32>) dimensions = [1]
+    (%in: f32, %init: f32) {
+      %0 = arith.addf %in, %init : f32
+      linalg.yield %0 : f32
+    }
+  return
+}
+
+// CHECK-LABEL: reduce_rows_add
+// CHECK-SAME: %[[ARG0:.+]]: memref<256x1024xf32>, %[[ARG1:.+]]: memref<256xf32>
+// CHECK-NOT: linalg.fill
+// CHECK: %[[DIS:.+]] = xsmm.unary.dispatch reduce_add [256, 1024, 1024, 1024] flags = (reduce_rows) data_type = f32
+// CHECK: xsmm.unary reduce_add(data_type = f32, %[[DIS]], %[[ARG0]], %[[ARG1]])
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d0)>
+
+func.func @reduce_rows_max(%arg0: memref<256x1024xf32>, %arg1: memref<256xf32>) {
+  %cst = arith.constant 0xFF800000 : f32
+  linalg.fill ins(%cst : f32) outs(%arg1 : memref<256xf32>)
+  linalg.generic {
+    indexing_maps = [#map, #map1],
+    iterator_types = ["parallel", "reduction"]}
+    ins(%arg0 : memref<256x1024xf32>) outs(%arg1 : memref<256xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      %0 = arith.maxnumf %in, %out : f32
+      linalg.yield %0 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: reduce_rows_max
+// CHECK-SAME: %[[ARG0:.+]]: memref<256x1024xf32>, %[[ARG1:.+]]: memref<256xf32>
+// CHECK-NOT: linalg.fill
+// CHECK: %[[DIS:.+]] = xsmm.unary.dispatch reduce_max [256, 1024, 1024, 1024] flags = (reduce_rows) data_type = f32
+// CHECK: xsmm.unary reduce_max(data_type = f32, %[[DIS]], %[[ARG0]], %[[ARG1]])
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d1)>
+
+func.func @reduce_cols_add(%arg0: memref<256x1024xf32>, %arg1: memref<1024xf32>) {
+  %cst = arith.constant 0.000000e+00 : f32
+  linalg.fill ins(%cst : f32) outs(%arg1 : memref<1024xf32>)
+  linalg.generic {
+    indexing_maps = [#map, #map1],
+    iterator_types = ["reduction", "parallel"]}
+    ins(%arg0 : memref<256x1024xf32>) outs(%arg1 : memref<1024xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      %0 = arith.addf %out, %in : f32
+      linalg.yield %0 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: reduce_cols_add
+// CHECK-SAME: %[[ARG0:.+]]: memref<256x1024xf32>, %[[ARG1:.+]]: memref<1024xf32>
+// CHECK: %[[DIS:.+]] = xsmm.unary.dispatch reduce_add [256, 1024, 1024, 1024] flags = (reduce_cols) data_type = f32
+// CHECK: xsmm.unary reduce_add(data_type = f32, %[[DIS]], %[[ARG0]], %[[ARG1]])
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d0, 0)>
+
+// The unit reduced dimension of the output is collapsed.
+func.func @reduce_rows_keep_dim(%arg0: memref<256x1024xf32>, %arg1: memref<256x1xf32>) {
+  %cst = arith.constant 0.000000e+00 : f32
+  linalg.fill ins(%cst : f32) outs(%arg1 : memref<256x1xf32>)
+  linalg.generic {
+    indexing_maps = [#map, #map1],
+    iterator_types = ["parallel", "reduction"]}
+    ins(%arg0 : memref<256x1024xf32>) outs(%arg1 : memref<256x1xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      %0 = arith.addf %in, %out : f32
+      linalg.yield %0 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: reduce_rows_keep_dim
+// CHECK-SAME: %[[ARG0:.+]]: memref<256x1024xf32>, %[[ARG1:.+]]: memref<256x1xf32>
+// CHECK-NOT: xsmm.unary zero
+// CHECK: %[[COL:.+]] = memref.collapse_shape %[[ARG1]] {{\[}}[0, 1]] : memref<256x1xf32> into memref<256xf32>
+// CHECK: %[[DIS:.+]] = xsmm.unary.dispatch reduce_add [256, 1024, 1024, 1024] flags = (reduce_rows) data_type = f32
+// CHECK: xsmm.unary reduce_add(data_type = f32, %[[DIS]], %[[ARG0]], %[[COL]])
+
+// -----
+
+// LIBXSMM overwrites the output, do not convert a reduction accumulating
+// into existing values.
+func.func @reduce_rows_accumulate(%arg0: memref<256x1024xf32>, %arg1: memref<256xf32>) {
+  linalg.reduce ins(%arg0 : memref<256x1024xf32>) outs(%arg1 : memref<256xf32>) dimensions = [1]
+    (%in: f32, %init: f32) {
+      %0 = arith.addf %in, %init : f32
+      linalg.yield %0 : f32
+    }
+  return
+}
+
+// CHECK-LABEL: reduce_rows_accumulate
+// CHECK-NOT: xsmm.unary
+// CHECK: linalg.reduce
+
+// -----
+
+func.func @reduce_rows_max_zero_init(%arg0: memref<256x1024xf32>, %arg1: memref<256xf32>) {
+  %cst = arith.constant 0.000000e+00 : f32
+  linalg.fill ins(%cst : f32) outs(%arg1 : memref<256xf32>)
+  linalg.reduce ins(%arg0 : memref<256x1024xf32>) outs(%arg1 : memref<256xf32>) dimensions = [1]
+    (%in: f32, %init: f32) {
+      %0 = arith.maximumf %in, %init : f32
+      linalg.yield %0 : f32
+    }
+  return
+}
+
+// CHECK-LABEL: reduce_rows_max_zero_init
+// CHECK-NOT: xsmm.unary
+// CHECK: linalg.fill
+// CHECK: linalg.reduce
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d0)>
+
+// Decomposed linalg.softmax along the rows.
+func.func @softmax(%arg0: memref<64x128xf32>, %arg1: memref<64x128xf32>) {
+  %cst = arith.constant 0xFF800000 : f32
+  %cst_0 = arith.constant 0.000000e+00 : f32
+  %alloc = memref.alloc() : memref<64xf32>
+  linalg.fill ins(%cst : f32) outs(%alloc : memref<64xf32>)
+  linalg.generic {
+    indexing_maps = [#map, #map1],
+    iterator_types = ["parallel", "reduction"]}
+    ins(%arg0 : memref<64x128xf32>) outs(%alloc : memref<64xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      %0 = arith.maxnumf %in, %out : f32
+      linalg.yield %0 : f32
+  }
+  linalg.generic {
+    indexing_maps = [#map, #map1, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg0, %alloc : memref<64x128xf32>, memref<64xf32>)
+    outs(%arg1 : memref<64x128xf32>) {
+    ^bb0(%in: f32, %in_1: f32, %out: f32):
+      %0 = arith.subf %in, %in_1 : f32
+      %1 = math.exp %0 : f32
+      linalg.yield %1 : f32
+  }
+  %alloc_2 = memref.alloc() : memref<64xf32>
+  linalg.fill ins(%cst_0 : f32) outs(%alloc_2 : memref<64xf32>)
+  linalg.generic {
+    indexing_maps = [#map, #map1],
+    iterator_types = ["parallel", "reduction"]}
+    ins(%arg1 : memref<64x128xf32>) outs(%alloc_2 : memref<64xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      %0 = arith.addf %in, %out : f32
+      linalg.yield %0 : f32
+  }
+  linalg.generic {
+    indexing_maps = [#map, #map1, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg1, %alloc_2 : memref<64x128xf32>, memref<64xf32>)
+    outs(%arg1 : memref<64x128xf32>) {
+    ^bb0(%in: f32, %in_1: f32, %out: f32):
+      %0 = arith.divf %in, %in_1 : f32
+      linalg.yield %0 : f32
+  }
+  memref.dealloc %alloc : memref<64xf32>
+  memref.dealloc %alloc_2 : memref<64xf32>
+  return
+}
+
+// CHECK-LABEL: softmax
+// CHECK-SAME: %[[ARG0:.+]]: memref<64x128xf32>, %[[ARG1:.+]]: memref<64x128xf32>
+// CHECK-NOT: linalg.fill
+// CHECK: %[[MAX:.+]] = memref.alloc() : memref<64xf32>
+// CHECK: xsmm.unary reduce_max(data_type = f32, %{{.+}}, %[[ARG0]], %[[MAX]])
+// CHECK: xsmm.equation(data_type = f32, %{{.+}}, %[[ARG0]], %[[MAX]], %[[ARG1]])
+// CHECK: %[[SUM:.+]] = memref.alloc() : memref<64xf32>
+// CHECK: xsmm.unary reduce_add(data_type = f32, %{{.+}}, %[[ARG1]], %[[SUM]])
+// CHECK: xsmm.binary div(data_type = f32, %{{.+}}, %[[ARG1]], %{{.+}}, %[[ARG1]])
+// CHECK-NOT: linalg.generic
@@ -518,3 +518,56 @@ func.func @linalg_copy(%arg0: memref<2x2xf32>, %arg1: memref<2x2xf32>) {
 // CHECK-SAME: %[[ARG0:.+]]: memref<2x2xf32>, %[[ARG1:.+]]: memref<2x2xf32>
 // CHECK: %[[DIS:.+]] = xsmm.unary.dispatch identity [2, 2, 2, 2] flags = (none) data_type = f32
 // CHECK: xsmm.unary identity(data_type = f32, %[[DIS]], %[[ARG0]], %[[ARG1]])
+
+// -----
+
+func.func @linalg_copy_nontemporal(%arg0: memref<64x64xf32>, %arg1: memref<64x64xf32>) {
+  linalg.copy {tpp.nontemporal} ins(%arg0 : memref<64x64xf32>) outs(%arg1 : memref<64x64xf32>)
+  return
+}
+
+// CHECK-LABEL: linalg_copy_nontemporal
+// CHECK-SAME: %[[ARG0:.+]]: memref<64x64xf32>, %[[ARG1:.+]]: memref<64x64xf32>
+// CHECK: %[[DIS:.+]] = xsmm.unary.dispatch identity [64, 64, 64, 64] flags = (nts_hint) data_type = f32
+// CHECK: xsmm.unary identity(data_type = f32, %[[DIS]], %[[ARG0]], %[[ARG1]])
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+
+func.func @exp(%arg0: memref<4x3xf32>, %arg1: memref<4x3xf32>) {
+  linalg.generic {
+    indexing_maps = [#map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg0 : memref<4x3xf32>) outs(%arg1 : memref<4x3xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      %0 = math.exp %in : f32
+      linalg.yield %0 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: exp
+// CHECK-SAME: %[[ARG0:.+]]: memref<4x3xf32>, %[[ARG1:.+]]: memref<4x3xf32>
+// CHECK: %[[DIS:.+]] = xsmm.unary.dispatch exp [4, 3, 3, 3] flags = (none) data_type = f32
+// CHECK: xsmm.unary exp(data_type = f32, %[[DIS]], %[[ARG0]], %[[ARG1]])
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+
+func.func @exp_of_output(%arg0: memref<4x3xf32>, %arg1: memref<4x3xf32>) {
+  linalg.generic {
+    indexing_maps = [#map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg0 : memref<4x3xf32>) outs(%arg1 : memref<4x3xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      %0 = math.exp %out : f32
+      linalg.yield %0 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: exp_of_output
+// CHECK-NOT: xsmm.unary
+// CHECK: linalg.generic
@@ -0,0 +1,93 @@
+// RUN: tpp-opt %s -convert-parallel-to-tasks -split-input-file | FileCheck %s
+
+func.func @relu(%arg0: memref<8x16xf32>, %arg1: index) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c2 = arith.constant 2 : index
+  %c8 = arith.constant 8 : index
+  %cst = arith.constant 0.000000e+00 : f32
+  scf.parallel (%i, %j) = (%c0, %c0) to (%c8, %arg1) step (%c1, %c2) {
+    %0 = memref.load %arg0[%i, %j] : memref<8x16xf32>
+    %1 = arith.maximumf %0, %cst : f32
+    memref.store %1, %arg0[%i, %j] : memref<8x16xf32>
+    scf.reduce
+  }
+  return
+}
+
+// CHECK: func.func private @tpp_parallel_for((i64, i64, !llvm.ptr) -> (), !llvm.ptr, i64)
+
+// CHECK-LABEL: func.func private @relu_task(
+// CHECK-SAME:  %[[BEGIN:.+]]: i64, %[[END:.+]]: i64, %[[CTX:.+]]: !llvm.ptr)
+// CHECK: %[[CST:.+]] = arith.constant 0.000000e+00 : f32
+// CHECK: %[[VALUES:.+]] = llvm.load %[[CTX]] : !llvm.ptr -> !llvm.struct<(struct<(ptr, ptr, i64, array<2 x i64>, array<2 x i64>)>, i64)>
+// CHECK: %[[DESC:.+]] = llvm.extractvalue %[[VALUES]][0]
+// CHECK: %[[BUF:.+]] = builtin.unrealized_conversion_cast %[[DESC]] : !llvm.struct<{{.+}}> to memref<8x16xf32>
+// CHECK: %[[N1:.+]] = llvm.extractvalue %[[VALUES]][1]
+// CHECK: %[[TC1:.+]] = builtin.unrealized_conversion_cast %[[N1]] : i64 to index
+// CHECK: %[[LB:.+]] = arith.index_cast %[[BEGIN]] : i64 to index
+// CHECK: %[[UB:.+]] = arith.index_cast %[[END]] : i64 to index
+// CHECK: scf.for %[[IV:.+]] = %[[LB]] to %[[UB]] step %{{.+}} {
+// CHECK:   %[[IDX_J:.+]] = arith.remui %[[IV]], %[[TC1]] : index
+// CHECK:   %[[IDX_I:.+]] = arith.divui %[[IV]], %[[TC1]] : index
+// CHECK:   %[[OFF_J:.+]] = arith.muli %[[IDX_J]], %{{.+}} : index
+// CHECK:   %[[J:.+]] = arith.addi %{{.+}}, %[[OFF_J]] : index
+// CHECK:   %[[OFF_I:.+]] = arith.muli %[[IDX_I]], %{{.+}} : index
+// CHECK:   %[[I:.+]] = arith.addi %{{.+}}, %[[OFF_I]] : index
+// CHECK:   %[[V:.+]] = memref.load %[[BUF]][%[[I]], %[[J]]] : memref<8x16xf32>
+// CHECK:   %[[R:.+]] = arith.maximumf %[[V]], %[[CST]] : f32
+// CHECK:   memref.store %[[R]], %[[BUF]][%[[I]], %[[J]]] : memref<8x16xf32>
+// CHECK: return
+
+// CHECK-LABEL: func.func @relu(
+// CHECK-SAME:  %[[ARG0:.+]]: memref<8x16xf32>, %[[ARG1:.+]]: index)
+// CHECK: %[[CTX:.+]] = llvm.alloca %{{.+}} x !llvm.struct<(struct<(ptr, ptr, i64, array<2 x i64>, array<2 x i64>)>, i64)> : (i64) -> !llvm.ptr
+// CHECK: %[[TC1:.+]] = arith.ceildivsi %[[ARG1]], %{{.+}} : index
+// CHECK: %[[N:.+]] = arith.muli %{{.+}}, %[[TC1]] : index
+// CHECK: %[[DESC:.+]] = builtin.unrealized_conversion_cast %[[ARG0]] : memref<8x16xf32> to !llvm.struct<{{.+}}>
+// CHECK: %[[S0:.+]] = llvm.insertvalue %[[DESC]], %{{.+}}[0]
+// CHECK: %[[N1:.+]] = builtin.unrealized_conversion_cast %[[TC1]] : index to i64
+// CHECK: %[[S1:.+]] = llvm.insertvalue %[[N1]], %[[S0]][1]
+// CHECK: llvm.store %[[S1]], %[[CTX]]
+// CHECK: %[[TASK:.+]] = {{.*}}constant @relu_task : (i64, i64, !llvm.ptr) -> ()
+// CHECK: %[[COUNT:.+]] = arith.index_cast %[[N]] : index to i64
+// CHECK: call @tpp_parallel_for(%[[TASK]], %[[CTX]], %[[COUNT]])
+// CHECK-NOT: scf.parallel
+// CHECK: return
+
+// -----
+
+// The loop with a reduction stays sequential, the nested loop runs in the
+// task of the outer one.
+func.func @not_tasks(%arg0: memref<8x8xf32>) -> f32 {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c8 = arith.constant 8 : index
+  %cst = arith.constant 0.000000e+00 : f32
+  %0 = scf.parallel (%i) = (%c0) to (%c8) step (%c1) init (%cst) -> f32 {
+    %1 = memref.load %arg0[%i, %c0] : memref<8x8xf32>
+    scf.reduce(%1 : f32) {
+    ^bb0(%lhs: f32, %rhs: f32):
+      %2 = arith.addf %lhs, %rhs : f32
+      scf.reduce.return %2 : f32
+    }
+  }
+  scf.parallel (%i) = (%c0) to (%c8) step (%c1) {
+    scf.parallel (%j) = (%c0) to (%c8) step (%c1) {
+      memref.store %cst, %arg0[%i, %j] : memref<8x8xf32>
+      scf.reduce
+    }
+    scf.reduce
+  }
+  return %0 : f32
+}
+
+// CHECK-LABEL: func.func private @not_tasks_task(
+// CHECK: scf.for
+// CHECK:   scf.parallel
+// CHECK:     memref.store
+
+// CHECK-LABEL: func.func @not_tasks(
+// CHECK: scf.parallel {{.+}} init
+// CHECK: call @tpp_parallel_for
+// CHECK-NOT: scf.parallel
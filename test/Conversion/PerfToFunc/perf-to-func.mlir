@@ -13,6 +13,47 @@ func.func @func_stop_timer() -> f64 {
 
 // -----
 
+// CHECK-DAG: func.func private @perf_start_device_timer() -> i64
+// CHECK-DAG: func.func private @perf_stop_device_timer(i64) -> f64
+// CHECK-LABEL: @func_stop_device_timer
+func.func @func_stop_device_timer() -> f64 {
+  // CHECK: %[[timer:.*]] = call @perf_start_device_timer()
+  %t = perf.start_device_timer : !perf.timer
+  // CHECK: call @perf_stop_device_timer(%[[timer]])
+  %delta = perf.stop_device_timer(%t : !perf.timer) : f64
+  return %delta : f64
+}
+
+// -----
+
+// CHECK-DAG: func.func private @perf_start_counters() -> i64
+// CHECK-DAG: func.func private @perf_stop_counters(i64, memref<*xi64>) attributes {llvm.emit_c_interface}
+// CHECK-LABEL: @func_stop_counters
+func.func @func_stop_counters(%buf: memref<6xi64>) {
+  // CHECK: %[[cnt:.*]] = call @perf_start_counters()
+  %c = perf.start_counters : !perf.counters
+  // CHECK: %[[cast:.*]] = memref.cast %{{.*}} : memref<6xi64> to memref<*xi64>
+  // CHECK: call @perf_stop_counters(%[[cnt]], %[[cast]])
+  perf.stop_counters(%c, %buf : !perf.counters, memref<6xi64>)
+  return
+}
+
+// -----
+
+// CHECK-DAG: func.func private @perf_start_energy() -> i64
+// CHECK-DAG: func.func private @perf_stop_energy(i64, memref<*xf64>) attributes {llvm.emit_c_interface}
+// CHECK-LABEL: @func_stop_energy
+func.func @func_stop_energy(%buf: memref<2xf64>) {
+  // CHECK: %[[energy:.*]] = call @perf_start_energy()
+  %e = perf.start_energy : !perf.energy
+  // CHECK: %[[cast:.*]] = memref.cast %{{.*}} : memref<2xf64> to memref<*xf64>
+  // CHECK: call @perf_stop_energy(%[[energy]], %[[cast]])
+  perf.stop_energy(%e, %buf : !perf.energy, memref<2xf64>)
+  return
+}
+
+// -----
+
 // CHECK: func.func private @perf_sink_memref_f64({{.*}}: memref<*xf64>) attributes {passthrough = ["optnone", "noinline"]} {
 // CHECK:   return
 // CHECK: }
@@ -92,3 +133,189 @@ func.func @perf_example(%A: tensor<4x8xf32>,
   // CHECK: return %[[stats]], %[[res]]
   return %stats, %res : f64, i64
 }
+
+// -----
+
+// CHECK-LABEL: @perf_subtract_overhead
+func.func @perf_subtract_overhead(%A: tensor<4x8xf32>,
+          %B: tensor<8x4xf32>, %C: tensor<4x4xf32>, %n: i64) -> f64 {
+  // CHECK-DAG: %[[zero:.*]] = arith.constant 0.000000e+00 : f64
+  // CHECK: %[[timer:.*]] = call @perf_start_timer()
+  // CHECK: scf.for
+  // CHECK:   linalg.matmul
+  // CHECK: }
+  // CHECK: %[[delta:.*]] = call @perf_stop_timer(%[[timer]])
+  // CHECK: %[[otimer:.*]] = call @perf_start_timer()
+  // CHECK: scf.for %[[i:.*]] = %{{.*}} to %{{.*}} step %{{.*}} {
+  // CHECK-NEXT: call @perf_sink_index(%[[i]])
+  // CHECK-NEXT: }
+  // CHECK: %[[overhead:.*]] = call @perf_stop_timer(%[[otimer]])
+  // CHECK: %[[diff:.*]] = arith.subf %[[delta]], %[[overhead]]
+  // CHECK: %[[stats:.*]] = arith.maximumf %[[diff]], %[[zero]]
+  %stats = perf.bench (%n : i64) -> f64 {
+    %D = linalg.matmul ins(%A, %B: tensor<4x8xf32>, tensor<8x4xf32>)
+                       outs(%C: tensor<4x4xf32>) -> tensor<4x4xf32>
+    perf.sink(%D) : tensor<4x4xf32>
+  } {subtract_overhead}
+
+  // CHECK: return %[[stats]]
+  return %stats : f64
+}
+
+// -----
+
+// CHECK-DAG: memref.global "private" constant @__perf_str_0 : memref<11xi8> = dense<[100, 101, 108, 116, 97, 115, 46, 116, 120, 116, 0]>
+// CHECK-DAG: func.func private @perf_min(memref<*xf64>) -> f64 attributes {llvm.emit_c_interface}
+// CHECK-DAG: func.func private @perf_median(memref<*xf64>) -> f64 attributes {llvm.emit_c_interface}
+// CHECK-DAG: func.func private @perf_percentile(memref<*xf64>, f64) -> f64 attributes {llvm.emit_c_interface}
+// CHECK-DAG: func.func private @perf_dump(memref<*xf64>, memref<*xi8>) attributes {llvm.emit_c_interface}
+// CHECK-LABEL: @func_stats
+func.func @func_stats(%deltas: memref<8xf64>) -> (f64, f64, f64) {
+  // CHECK-DAG: %[[p90:.*]] = arith.constant 9.000000e+01 : f64
+  // CHECK: %[[cast:.*]] = memref.cast %{{.*}} : memref<8xf64> to memref<*xf64>
+  // CHECK: call @perf_min(%[[cast]])
+  %min = perf.min(%deltas : memref<8xf64>) : f64
+  // CHECK: call @perf_median(
+  %median = perf.median(%deltas : memref<8xf64>) : f64
+  // CHECK: call @perf_percentile(%{{.*}}, %[[p90]])
+  %p90 = perf.percentile(%deltas : memref<8xf64>) {percentile = 90.0 : f64} : f64
+  // CHECK: %[[file:.*]] = memref.get_global @__perf_str_0 : memref<11xi8>
+  // CHECK: %[[fcast:.*]] = memref.cast %[[file]] : memref<11xi8> to memref<*xi8>
+  // CHECK: call @perf_dump(%{{.*}}, %[[fcast]])
+  perf.dump(%deltas : memref<8xf64>) {file = "deltas.txt"}
+  return %min, %median, %p90 : f64, f64, f64
+}
+
+// -----
+
+// CHECK-DAG: func.func private @perf_flush_cache()
+// CHECK-LABEL: @func_flush_cache
+func.func @func_flush_cache() {
+  // CHECK: call @perf_flush_cache()
+  perf.flush_cache
+  return
+}
+
+// -----
+
+// CHECK-DAG: func.func private @perf_set_num_threads(i64)
+// CHECK-LABEL: @func_set_num_threads
+func.func @func_set_num_threads(%n: i64) {
+  // CHECK: call @perf_set_num_threads(%{{.+}}) : (i64) -> ()
+  perf.set_num_threads(%n : i64)
+  return
+}
+
+// -----
+
+// CHECK-DAG: memref.global "private" constant @__perf_str_0 : memref<7xi8> = dense<[108, 97, 121, 101, 114, 48, 0]>
+// CHECK-DAG: func.func private @perf_trace_begin(memref<*xi8>) attributes {llvm.emit_c_interface}
+// CHECK-DAG: func.func private @perf_trace_end()
+// CHECK-LABEL: @func_trace
+func.func @func_trace() {
+  // CHECK: %[[label:.*]] = memref.get_global @__perf_str_0 : memref<7xi8>
+  // CHECK: %[[lcast:.*]] = memref.cast %[[label]] : memref<7xi8> to memref<*xi8>
+  // CHECK: call @perf_trace_begin(%[[lcast]])
+  perf.trace_begin {label = "layer0"}
+  // CHECK: call @perf_trace_end() : () -> ()
+  perf.trace_end
+  return
+}
+
+// -----
+
+// CHECK-DAG: memref.global "private" constant @__perf_str_0 : memref<5xi8> = dense<[109, 101, 97, 110, 0]>
+// CHECK-DAG: func.func private @perf_report_f64(memref<*xi8>, f64) attributes {llvm.emit_c_interface}
+// CHECK-DAG: func.func private @perf_report_i64(memref<*xi8>, i64) attributes {llvm.emit_c_interface}
+// CHECK-DAG: func.func private @perf_report_memref_f64(memref<*xi8>, memref<*xf64>) attributes {llvm.emit_c_interface}
+// CHECK-LABEL: @func_report
+func.func @func_report(%mean: f64, %cycles: i64, %deltas: memref<8xf64>) {
+  // CHECK: %[[key:.*]] = memref.get_global @__perf_str_0 : memref<5xi8>
+  // CHECK: %[[kcast:.*]] = memref.cast %[[key]] : memref<5xi8> to memref<*xi8>
+  // CHECK: call @perf_report_f64(%[[kcast]], %{{.*}})
+  perf.report(%mean : f64) {key = "mean"}
+  // CHECK: call @perf_report_i64(
+  perf.report(%cycles : i64) {key = "cycles"}
+  // CHECK: %[[cast:.*]] = memref.cast %{{.*}} : memref<8xf64> to memref<*xf64>
+  // CHECK: call @perf_report_memref_f64(%{{.*}}, %[[cast]])
+  perf.report(%deltas : memref<8xf64>) {key = "samples"}
+  return
+}
+
+// -----
+
+// CHECK-DAG: memref.global "private" constant @__perf_str_0 : memref<12xi8>
+// CHECK-DAG: memref.global "private" constant @__perf_shape_0 : memref<2xi64> = dense<[4, 8]>
+// CHECK-DAG: func.func private @perf_map_file_f32(memref<*xi8>, memref<*xi64>) -> memref<*xf32> attributes {llvm.emit_c_interface}
+// CHECK-LABEL: @func_map_file
+func.func @func_map_file() -> memref<4x8xf32> {
+  // CHECK: %[[file:.*]] = memref.get_global @__perf_str_0 : memref<12xi8>
+  // CHECK: %[[shape:.*]] = memref.get_global @__perf_shape_0 : memref<2xi64>
+  // CHECK: %[[fcast:.*]] = memref.cast %[[file]] : memref<12xi8> to memref<*xi8>
+  // CHECK: %[[scast:.*]] = memref.cast %[[shape]] : memref<2xi64> to memref<*xi64>
+  // CHECK: %[[data:.*]] = call @perf_map_file_f32(%[[fcast]], %[[scast]])
+  // CHECK: %[[res:.*]] = memref.cast %[[data]] : memref<*xf32> to memref<4x8xf32>
+  // CHECK: return %[[res]]
+  %0 = perf.map_file "weights.npy" : memref<4x8xf32>
+  return %0 : memref<4x8xf32>
+}
+
+// -----
+
+// CHECK-DAG: memref.global "private" constant @__perf_str_0 : memref<11xi8>
+// CHECK-DAG: memref.global "private" constant @__perf_shape_0 : memref<2xi64> = dense<[4, 8]>
+// CHECK-DAG: func.func private @perf_map_blob_f32(memref<*xi8>, memref<*xi64>, i64) -> memref<*xf32> attributes {llvm.emit_c_interface}
+// CHECK-LABEL: @func_map_blob
+func.func @func_map_blob() -> memref<4x8xf32> {
+  // CHECK-DAG: %[[file:.*]] = memref.get_global @__perf_str_0 : memref<11xi8>
+  // CHECK-DAG: %[[shape:.*]] = memref.get_global @__perf_shape_0 : memref<2xi64>
+  // CHECK-DAG: %[[offset:.*]] = arith.constant 128 : i64
+  // CHECK-DAG: %[[fcast:.*]] = memref.cast %[[file]] : memref<11xi8> to memref<*xi8>
+  // CHECK-DAG: %[[scast:.*]] = memref.cast %[[shape]] : memref<2xi64> to memref<*xi64>
+  // CHECK: %[[data:.*]] = call @perf_map_blob_f32(%[[fcast]], %[[scast]], %[[offset]])
+  // CHECK: %[[res:.*]] = memref.cast %[[data]] : memref<*xf32> to memref<4x8xf32>
+  // CHECK: return %[[res]]
+  %0 = perf.map_blob "model.blob" offset 128 : memref<4x8xf32>
+  return %0 : memref<4x8xf32>
+}
+
+// -----
+
+// CHECK-DAG: func.func private @perf_init_tensor_f32(memref<*xf32>, i64, i64) attributes {llvm.emit_c_interface}
+// CHECK-LABEL: @func_init_tensor
+func.func @func_init_tensor(%arg0: memref<4x8xf32>) {
+  // CHECK-DAG: %[[kind:.*]] = arith.constant 4 : i64
+  // CHECK-DAG: %[[seed:.*]] = arith.constant 42 : i64
+  // CHECK: %[[cast:.*]] = memref.cast %{{.*}} : memref<4x8xf32> to memref<*xf32>
+  // CHECK: call @perf_init_tensor_f32(%[[cast]], %[[kind]], %[[seed]])
+  perf.init_tensor(%arg0 : memref<4x8xf32>) "normal" seed(42)
+  return
+}
+
+// -----
+
+// CHECK-DAG: memref.global "private" constant @__perf_shape_0 : memref<2xi64> = dense<[4, 8]>
+// CHECK-DAG: func.func private @perf_alloc_f32(memref<*xi64>, i64, i64) -> memref<*xf32> attributes {llvm.emit_c_interface}
+// CHECK-LABEL: @func_alloc
+func.func @func_alloc() -> memref<4x8xf32> {
+  // CHECK: %[[shape:.*]] = memref.get_global @__perf_shape_0 : memref<2xi64>
+  // CHECK-DAG: %[[interleave:.*]] = arith.constant 1 : i64
+  // CHECK-DAG: %[[page:.*]] = arith.constant 1073741824 : i64
+  // CHECK: %[[scast:.*]] = memref.cast %[[shape]] : memref<2xi64> to memref<*xi64>
+  // CHECK: %[[data:.*]] = call @perf_alloc_f32(%[[scast]], %[[interleave]], %[[page]])
+  // CHECK: %[[res:.*]] = memref.cast %[[data]] : memref<*xf32> to memref<4x8xf32>
+  // CHECK: return %[[res]]
+  %0 = perf.alloc {interleave, page_size = 1073741824 : i64} : memref<4x8xf32>
+  return %0 : memref<4x8xf32>
+}
+
+// -----
+
+// CHECK-LABEL: @func_alloc_shard
+func.func @func_alloc_shard() -> memref<8x4x32x32xbf16> {
+  // CHECK-DAG: %[[shard:.*]] = arith.constant 2 : i64
+  // CHECK-DAG: %[[page:.*]] = arith.constant 0 : i64
+  // CHECK: call @perf_alloc_bf16(%{{.*}}, %[[shard]], %[[page]])
+  %0 = perf.alloc {shard} : memref<8x4x32x32xbf16>
+  return %0 : memref<8x4x32x32xbf16>
+}
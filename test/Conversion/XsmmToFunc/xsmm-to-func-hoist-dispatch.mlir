@@ -0,0 +1,96 @@
+// RUN: tpp-opt %s -convert-xsmm-to-func="hoist-dispatch" -split-input-file | FileCheck %s
+
+func.func @gemm(%arg0: memref<4x8xf32>, %arg1: memref<8x4xf32>, %arg2: memref<4x4xf32>) {
+  %c0 = arith.constant 0 : index
+  %c8 = arith.constant 8 : index
+  %c1 = arith.constant 1 : index
+  scf.for %i = %c0 to %c8 step %c1 {
+    %0 = xsmm.gemm.dispatch [4, 4, 8, 8, 4, 4] flags = (none) data_type = f32
+    xsmm.gemm(data_type = f32, %0, %arg0, %arg1, %arg2) : (i64, memref<4x8xf32>, memref<8x4xf32>, memref<4x4xf32>) -> ()
+    %1 = xsmm.gemm.dispatch [4, 4, 8, 8, 4, 4] flags = (none) data_type = f32
+    xsmm.gemm(data_type = f32, %1, %arg0, %arg1, %arg2) : (i64, memref<4x8xf32>, memref<8x4xf32>, memref<4x4xf32>) -> ()
+  }
+  return
+}
+
+func.func @relu(%arg0: memref<4x4xf32>) {
+  %0 = xsmm.unary.dispatch relu [4, 4, 4, 4] flags = (none) data_type = f32
+  xsmm.unary relu(data_type = f32, %0, %arg0, %arg0) : (i64, memref<4x4xf32>, memref<4x4xf32>) -> ()
+  %1 = xsmm.gemm.dispatch [4, 4, 8, 8, 4, 4] flags = (none) data_type = f32
+  return
+}
+
+// CHECK-DAG: memref.global "private" @__xsmm_dispatch_0 : memref<i64> = dense<0>
+// CHECK-DAG: memref.global "private" @__xsmm_dispatch_1 : memref<i64> = dense<0>
+// CHECK-DAG: memref.global "private" @__xsmm_dispatch_initialized : memref<i64> = dense<0>
+
+// CHECK-LABEL: func.func @gemm(
+// CHECK: memref.get_global @__xsmm_dispatch_initialized
+// CHECK: %[[FLAG:.+]] = llvm.inttoptr
+// CHECK: %[[STATE:.+]] = llvm.load %[[FLAG]] atomic acquire {alignment = 8 : i64} : !llvm.ptr -> i64
+// CHECK: %[[NOT_DONE:.+]] = arith.cmpi ne, %[[STATE]], %{{.+}} : i64
+// CHECK: scf.if %[[NOT_DONE]] {
+// CHECK-NEXT: call @__xsmm_dispatch_init() : () -> ()
+// CHECK-NEXT: }
+// CHECK: %[[G0:.+]] = memref.get_global @__xsmm_dispatch_0 : memref<i64>
+// CHECK: %[[H0:.+]] = memref.load %[[G0]][] : memref<i64>
+// CHECK-NOT: xsmm_gemm_dispatch
+// CHECK: scf.for
+// CHECK: call @xsmm_gemm_invoke(%{{.+}}, %[[H0]],
+// CHECK: call @xsmm_gemm_invoke(%{{.+}}, %[[H0]],
+
+// CHECK-LABEL: func.func @relu(
+// CHECK: scf.if
+// CHECK-NEXT: call @__xsmm_dispatch_init() : () -> ()
+// CHECK: %[[G1:.+]] = memref.get_global @__xsmm_dispatch_1 : memref<i64>
+// CHECK: %[[H1:.+]] = memref.load %[[G1]][] : memref<i64>
+// CHECK-NOT: xsmm_unary_dispatch
+// CHECK: call @xsmm_unary_invoke(%{{.+}}, %[[H1]],
+
+// CHECK-LABEL: func.func private @__xsmm_dispatch_init()
+// CHECK: %[[FLAG:.+]] = llvm.inttoptr
+// CHECK: %[[CLAIM:.+]] = llvm.cmpxchg %[[FLAG]], %{{.+}}, %{{.+}} acquire monotonic
+// CHECK: %[[CLAIMED:.+]] = llvm.extractvalue %[[CLAIM]][1]
+// CHECK: scf.if %[[CLAIMED]] {
+// CHECK:   %[[K0:.+]] = call @xsmm_gemm_dispatch(
+// CHECK:   memref.store %[[K0]], %{{.+}}[] : memref<i64>
+// CHECK:   %[[K1:.+]] = call @xsmm_unary_dispatch(
+// CHECK:   memref.store %[[K1]], %{{.+}}[] : memref<i64>
+// CHECK-NOT: xsmm_gemm_dispatch
+// CHECK:   llvm.store %{{.+}}, %[[FLAG]] atomic release {alignment = 8 : i64} : i64, !llvm.ptr
+// CHECK: } else {
+// CHECK:   scf.while : () -> () {
+// CHECK:     %[[STATE:.+]] = llvm.load %[[FLAG]] atomic acquire {alignment = 8 : i64} : !llvm.ptr -> i64
+// CHECK:     %[[RUNNING:.+]] = arith.cmpi ne, %[[STATE]], %{{.+}} : i64
+// CHECK:     scf.condition(%[[RUNNING]])
+// CHECK: return
+
+// -----
+
+// CHECK-LABEL: func.func @no_dispatch
+// CHECK-NOT: __xsmm_dispatch
+func.func @no_dispatch(%arg0: memref<4x4xf32>) {
+  return
+}
+
+// -----
+
+// Dispatches with runtime sizes stay in place.
+// CHECK-NOT: __xsmm_dispatch_initialized
+// CHECK-LABEL: func.func @dynamic_gemm(
+// CHECK-SAME: %[[M:.+]]: i64
+// CHECK-NOT: __xsmm_dispatch_init
+// CHECK: scf.for
+// CHECK: %[[K:.+]] = call @xsmm_gemm_dispatch(%{{.+}}, %[[M]],
+// CHECK: call @xsmm_gemm_invoke(%{{.+}}, %[[K]],
+func.func @dynamic_gemm(%m: i64, %arg0: memref<?x8xf32>, %arg1: memref<8x4xf32>,
+                        %arg2: memref<?x4xf32>) {
+  %c0 = arith.constant 0 : index
+  %c8 = arith.constant 8 : index
+  %c1 = arith.constant 1 : index
+  scf.for %i = %c0 to %c8 step %c1 {
+    %0 = xsmm.gemm.dispatch [%m, 4, 8, 8, 4, 4] flags = (none) data_type = f32
+    xsmm.gemm(data_type = f32, %0, %arg0, %arg1, %arg2) : (i64, memref<?x8xf32>, memref<8x4xf32>, memref<?x4xf32>) -> ()
+  }
+  return
+}
@@ -430,3 +430,139 @@ func.func @dispatch_binary() -> i64 {
 // CHECK-DAG: %[[C32:.+]] = arith.constant 32 : i64
 // CHECK: %{{.+}} = call @xsmm_binary_dispatch(%[[C1]], %[[C1]], %[[C5]], %[[C6]], %[[C5]], %[[C6]], %[[C5]], %[[C32]])
 
+
+// -----
+
+// CHECK-LABEL: dispatch_brgemm_prefetch
+func.func @dispatch_brgemm_prefetch() -> i64 {
+  %0 = xsmm.brgemm.dispatch [5, 5, 4, 4, 5, 5, 5, 5] flags = (prefetch_a, prefetch_b) data_type = f32
+  return %0 : i64
+}
+
+// CHECK-DAG: %[[C1:.+]] = arith.constant 1 : i64
+// CHECK-DAG: %[[C5:.+]] = arith.constant 5 : i64
+// CHECK-DAG: %[[C4:.+]] = arith.constant 4 : i64
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : i64
+// CHECK-DAG: %[[PREFETCH:.+]] = arith.constant 3298534883328 : i64
+// CHECK: call @xsmm_brgemm_prefetch_dispatch(%[[C1]], %[[C5]], %[[C5]], %[[C4]], %[[C4]], %[[C5]], %[[C5]], %[[C5]], %[[C5]], %[[C0]], %[[PREFETCH]])
+
+// -----
+
+func.func @invoke_brgemm_prefetch(%arg0: memref<2x5x4xf32>, %arg1: memref<2x4x5xf32>,
+                                  %arg2: memref<4x4xf32>, %arg3: memref<2x5x4xf32>,
+                                  %arg4: memref<2x4x5xf32>) {
+  %0 = xsmm.brgemm.dispatch [5, 5, 4, 4, 5, 5, 5, 5] flags = (prefetch_a) data_type = f32
+  %c2_i64 = arith.constant 2 : i64
+  xsmm.brgemm(data_type = f32, %0, %arg0, %arg1, %arg2, %c2_i64, %arg3, %arg4)
+    : (i64, memref<2x5x4xf32>, memref<2x4x5xf32>, memref<4x4xf32>, i64,
+       memref<2x5x4xf32>, memref<2x4x5xf32>) -> ()
+  return
+}
+
+// CHECK-LABEL: invoke_brgemm_prefetch
+// CHECK-DAG: %[[C2:.+]] = arith.constant 2 : i64
+// CHECK-DAG: %[[PREFETCH:.+]] = arith.constant 1099511627776 : i64
+// CHECK: %[[ADDR:.+]] = call @xsmm_brgemm_prefetch_dispatch({{.+}}, %[[PREFETCH]])
+// CHECK: call @xsmm_brgemm_prefetch_invoke({{.+}}, %[[ADDR]], {{.+}}, %[[C2]], %{{.+}}, %{{.+}}, %{{.+}}, %{{.+}})
+// CHECK: func.func private @xsmm_brgemm_prefetch_invoke(i64, i64, !llvm.ptr, index, !llvm.ptr, index, !llvm.ptr, index, i64, !llvm.ptr, index, !llvm.ptr, index)
+
+// -----
+
+func.func @invoke_gemm_prefetch(%arg0: memref<4x8xf32>, %arg1: memref<8x4xf32>,
+                                %arg2: memref<4x4xf32>) {
+  %0 = xsmm.gemm.dispatch [4, 4, 8, 8, 4, 4] flags = (prefetch_b) data_type = f32
+  xsmm.gemm(data_type = f32, %0, %arg0, %arg1, %arg2, %arg0, %arg1)
+    : (i64, memref<4x8xf32>, memref<8x4xf32>, memref<4x4xf32>,
+       memref<4x8xf32>, memref<8x4xf32>) -> ()
+  return
+}
+
+// CHECK-LABEL: invoke_gemm_prefetch
+// CHECK-DAG: %[[PREFETCH:.+]] = arith.constant 2199023255552 : i64
+// CHECK: %[[ADDR:.+]] = call @xsmm_gemm_prefetch_dispatch({{.+}}, %[[PREFETCH]])
+// CHECK: call @xsmm_gemm_prefetch_invoke({{.+}}, %[[ADDR]], {{.+}})
+
+// -----
+
+func.func @invoke_brgemm_offset(%arg0: memref<8x5x4xf32>, %arg1: memref<8x4x5xf32>,
+                                %arg2: memref<5x5xf32>, %arg3: memref<2xi64>,
+                                %arg4: memref<2xi64>) {
+  %0 = xsmm.brgemm.dispatch [5, 5, 4, 4, 5, 5, 0, 0] flags = (batch_reduce_offset) data_type = f32
+  %c2_i64 = arith.constant 2 : i64
+  xsmm.brgemm_indirect offset(data_type = f32, %0, %arg0, %arg1, %arg2, %arg3, %arg4, %c2_i64)
+    : (i64, memref<8x5x4xf32>, memref<8x4x5xf32>, memref<5x5xf32>,
+       memref<2xi64>, memref<2xi64>, i64) -> ()
+  return
+}
+
+// CHECK-LABEL: invoke_brgemm_offset
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : i64
+// CHECK-DAG: %[[C2:.+]] = arith.constant 2 : i64
+// CHECK: %[[ADDR:.+]] = call @xsmm_brgemm_offset_dispatch({{.+}}, %[[C0]], %[[C0]], %[[C0]])
+// CHECK: call @xsmm_brgemm_offset_invoke({{.+}}, %[[ADDR]], {{.+}}, %[[C2]])
+// CHECK: func.func private @xsmm_brgemm_offset_invoke(i64, i64, !llvm.ptr, index, !llvm.ptr, index, !llvm.ptr, index, !llvm.ptr, index, !llvm.ptr, index, i64)
+
+// -----
+
+func.func @invoke_brgemm_address(%arg0: memref<8x5x4xf32>, %arg1: memref<8x4x5xf32>,
+                                 %arg2: memref<5x5xf32>, %arg3: memref<2xi64>,
+                                 %arg4: memref<2xi64>) {
+  %0 = xsmm.brgemm.dispatch [5, 5, 4, 4, 5, 5, 0, 0] flags = (batch_reduce_address) data_type = f32
+  %c2_i64 = arith.constant 2 : i64
+  xsmm.brgemm_indirect address(data_type = f32, %0, %arg0, %arg1, %arg2, %arg3, %arg4, %c2_i64)
+    : (i64, memref<8x5x4xf32>, memref<8x4x5xf32>, memref<5x5xf32>,
+       memref<2xi64>, memref<2xi64>, i64) -> ()
+  return
+}
+
+// CHECK-LABEL: invoke_brgemm_address
+// CHECK: %[[ADDR:.+]] = call @xsmm_brgemm_address_dispatch(
+// CHECK: call @xsmm_brgemm_address_invoke({{.+}}, %[[ADDR]], {{.+}})
+
+// -----
+
+func.func @invoke_brgemm_grouped(%arg0: memref<4x8x32x32xf32>, %arg1: memref<4x8x32x32xf32>,
+                                 %arg2: memref<4x4x32x32xf32>, %arg3: memref<4x3xi64>) {
+  %0 = xsmm.brgemm.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024] flags = (none) data_type = f32
+  %c8_i64 = arith.constant 8 : i64
+  xsmm.brgemm_grouped(data_type = f32, %0, %arg0, %arg1, %arg2, %arg3, %c8_i64)
+    : (i64, memref<4x8x32x32xf32>, memref<4x8x32x32xf32>, memref<4x4x32x32xf32>,
+       memref<4x3xi64>, i64) -> ()
+  return
+}
+
+// CHECK-LABEL: invoke_brgemm_grouped
+// CHECK-DAG: %[[C8:.+]] = arith.constant 8 : i64
+// CHECK-DAG: %[[C4:.+]] = arith.constant 4 : i64
+// CHECK: %[[ADDR:.+]] = call @xsmm_brgemm_dispatch(
+// CHECK: call @xsmm_brgemm_grouped_invoke({{.+}}, %[[ADDR]], {{.+}}, %[[C8]], %[[C4]])
+// CHECK: func.func private @xsmm_brgemm_grouped_invoke(i64, i64, !llvm.ptr, index, !llvm.ptr, index, !llvm.ptr, index, !llvm.ptr, index, i64, i64)
+
+// -----
+
+func.func @invoke_equation(%arg0: memref<32x32xf32>, %arg1: memref<32xf32>,
+                           %arg2: memref<32x32xf32>) {
+  %0 = xsmm.equation.dispatch [32, 32, 32] args = [32, 32, 32, 32, 1, 1]
+         nodes = [1, 17, 0, 2, 1, 2, 0, 0, 0, 0, 1, 0] data_type = f32
+  xsmm.equation(data_type = f32, %0, %arg0, %arg1, %arg2)
+    : (i64, memref<32x32xf32>, memref<32xf32>, memref<32x32xf32>) -> ()
+  return
+}
+
+// CHECK: memref.global "private" constant @__xsmm_equation : memref<18xi64> =
+// CHECK-SAME: dense<[32, 32, 32, 32, 1, 1, 1, 17, 0, 2, 1, 2, 0, 0, 0, 0, 1, 0]>
+// CHECK-LABEL: invoke_equation
+// CHECK-SAME: %[[ARG0:.+]]: memref<32x32xf32>, %[[ARG1:.+]]: memref<32xf32>, %[[ARG2:.+]]: memref<32x32xf32>
+// CHECK: %[[DESC:.+]] = memref.get_global @__xsmm_equation : memref<18xi64>
+// CHECK: %[[ADDR:.+]] = call @xsmm_equation_dispatch(
+// CHECK: memref.alloca_scope {
+// CHECK: %[[LIST:.+]] = memref.alloca() : memref<4xi64>
+// CHECK: memref.extract_aligned_pointer_as_index %[[ARG0]]
+// CHECK: memref.store %{{.+}}, %[[LIST]]
+// CHECK: memref.store %{{.+}}, %[[LIST]]
+// CHECK: memref.extract_aligned_pointer_as_index %[[ARG1]]
+// CHECK: memref.store %{{.+}}, %[[LIST]]
+// CHECK: memref.store %{{.+}}, %[[LIST]]
+// CHECK: call @xsmm_equation_invoke({{.+}}, %[[ADDR]], {{.+}})
+// CHECK-DAG: func.func private @xsmm_equation_dispatch(i64, i64, i64, i64, !llvm.ptr, index, i64, i64) -> i64
+// CHECK-DAG: func.func private @xsmm_equation_invoke(i64, i64, !llvm.ptr, index, !llvm.ptr, index, i64)
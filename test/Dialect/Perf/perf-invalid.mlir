@@ -151,9 +151,111 @@ func.func @perf_invalid_timer(%n: !perf.timer) {
 
 // -----
 
+func.func @perf_device_timer_host_start() {
+  %t = perf.start_timer : !perf.timer
+  // expected-error @below {{'perf.stop_device_timer' op invalid timer input}}
+  %del = perf.stop_device_timer(%t : !perf.timer) : f64
+  return
+}
+
+// -----
+
 func.func @perf_invalid_timer_1() {
   %c0 = arith.constant 0 : i64
   // expected-error @below {{custom op 'perf.stop_timer' invalid kind of type specified}}
   %del = perf.stop_timer(%c0 : i64) : f64
   return
 }
+
+// -----
+
+func.func @perf_counters_multi_stop(%buf: memref<6xi64>) {
+  %c = perf.start_counters : !perf.counters
+  // expected-error @below {{'perf.stop_counters' op counters stopped multiple times}}
+  perf.stop_counters(%c, %buf : !perf.counters, memref<6xi64>)
+  perf.stop_counters(%c, %buf : !perf.counters, memref<6xi64>)
+  return
+}
+
+// -----
+
+func.func @perf_invalid_counters_buffer(%buf: memref<6xf64>) {
+  %c = perf.start_counters : !perf.counters
+  // expected-error @below {{'perf.stop_counters' op operand #1 must be 1D memref of 64-bit signless integer values}}
+  perf.stop_counters(%c, %buf : !perf.counters, memref<6xf64>)
+  return
+}
+
+// -----
+
+func.func @perf_energy_multi_stop(%buf: memref<2xf64>) {
+  %e = perf.start_energy : !perf.energy
+  // expected-error @below {{'perf.stop_energy' op energy counters stopped multiple times}}
+  perf.stop_energy(%e, %buf : !perf.energy, memref<2xf64>)
+  perf.stop_energy(%e, %buf : !perf.energy, memref<2xf64>)
+  return
+}
+
+// -----
+
+func.func @perf_invalid_percentile(%deltas: memref<?xf64>) -> f64 {
+  // expected-error @below {{'perf.percentile' op expect percentile in range [0, 100] but got: 1.010000e+02}}
+  %p = perf.percentile(%deltas : memref<?xf64>) {percentile = 101.0 : f64} : f64
+  return %p : f64
+}
+
+// -----
+
+func.func @perf_invalid_map_file_type() -> memref<4xi1> {
+  // expected-error @below {{'perf.map_file' op unsupported element type: 'i1'}}
+  %0 = perf.map_file "mask.bin" : memref<4xi1>
+  return %0 : memref<4xi1>
+}
+
+// -----
+
+func.func @perf_invalid_map_file_shape() -> memref<?xf32> {
+  // expected-error @below {{'perf.map_file' op result #0 must be statically shaped memref of any type values}}
+  %0 = perf.map_file "data.bin" : memref<?xf32>
+  return %0 : memref<?xf32>
+}
+
+// -----
+
+func.func @perf_invalid_map_blob_offset() -> memref<4xf32> {
+  // expected-error @below {{'perf.map_blob' op expect a positive offset aligned to the element size but got: 66}}
+  %0 = perf.map_blob "model.blob" offset 66 : memref<4xf32>
+  return %0 : memref<4xf32>
+}
+
+// -----
+
+func.func @perf_invalid_init_tensor_kind(%arg0: memref<4xf32>) {
+  // expected-error @below {{'perf.init_tensor' op unknown initializer: uniform}}
+  perf.init_tensor(%arg0 : memref<4xf32>) "uniform" seed(1)
+  return
+}
+
+// -----
+
+func.func @perf_invalid_init_tensor_seed(%arg0: memref<4xf32>) {
+  // expected-error @below {{'perf.init_tensor' op expect a non-zero seed for random initializers}}
+  perf.init_tensor(%arg0 : memref<4xf32>) "random" seed(0)
+  return
+}
+
+// -----
+
+func.func @perf_invalid_alloc_page_size() -> memref<4xf32> {
+  // expected-error @below {{'perf.alloc' op expect a page size of 2MB or 1GB but got: 4096}}
+  %0 = perf.alloc {page_size = 4096 : i64} : memref<4xf32>
+  return %0 : memref<4xf32>
+}
+
+// -----
+
+func.func @perf_invalid_alloc_policy() -> memref<4xf32> {
+  // expected-error @below {{'perf.alloc' op expect either interleave or shard}}
+  %0 = perf.alloc {interleave, shard} : memref<4xf32>
+  return %0 : memref<4xf32>
+}
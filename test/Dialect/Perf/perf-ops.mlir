@@ -12,6 +12,42 @@ func.func @perf_timer(%a: i32, %b: i32, %n: i64) -> f64 {
 
 // -----
 
+// CHECK-LABEL: @perf_device_timer
+func.func @perf_device_timer() -> f64 {
+  // CHECK: %[[T:.+]] = perf.start_device_timer : !perf.timer
+  %t = perf.start_device_timer : !perf.timer
+  // CHECK: perf.stop_device_timer(%[[T]] : !perf.timer) : f64
+  %s = perf.stop_device_timer(%t : !perf.timer) : f64
+
+  return %s : f64
+}
+
+// -----
+
+// CHECK-LABEL: @perf_counters
+func.func @perf_counters(%buf: memref<6xi64>) {
+  // CHECK: %[[CNT:.+]] = perf.start_counters : !perf.counters
+  %c = perf.start_counters : !perf.counters
+  // CHECK: perf.stop_counters(%[[CNT]], %{{.+}} : !perf.counters, memref<6xi64>)
+  perf.stop_counters(%c, %buf : !perf.counters, memref<6xi64>)
+
+  return
+}
+
+// -----
+
+// CHECK-LABEL: @perf_energy
+func.func @perf_energy(%buf: memref<2xf64>) {
+  // CHECK: %[[ENERGY:.+]] = perf.start_energy : !perf.energy
+  %e = perf.start_energy : !perf.energy
+  // CHECK: perf.stop_energy(%[[ENERGY]], %{{.+}} : !perf.energy, memref<2xf64>)
+  perf.stop_energy(%e, %buf : !perf.energy, memref<2xf64>)
+
+  return
+}
+
+// -----
+
 /// CHECK-LABEL: @perf_matmul_bench
 func.func @perf_matmul_bench(%A: tensor<4x8xf32>,
           %B: tensor<8x4xf32>, %C: tensor<4x4xf32>, %n: i64) -> f64 {
@@ -110,3 +146,120 @@ func.func @perf_example(%A: tensor<4x8xf32>,
   // CHECK: return %[[res]]#0, %[[res]]#1
   return %stat, %res : f64, i64
 }
+
+// -----
+
+// CHECK-LABEL: @perf_bench_subtract_overhead
+func.func @perf_bench_subtract_overhead(%a: i64, %n: i64) -> f64 {
+  // CHECK: perf.bench
+  %stat = perf.bench (%n : i64) -> f64 {
+    perf.sink(%a) : i64
+  // CHECK: } {subtract_overhead}
+  } {subtract_overhead}
+
+  return %stat : f64
+}
+
+// -----
+
+// CHECK-LABEL: @perf_stats
+func.func @perf_stats(%deltas: memref<?xf64>) -> (f64, f64, f64, f64, f64) {
+  // CHECK: perf.min
+  %min = perf.min(%deltas : memref<?xf64>) : f64
+  // CHECK: perf.max
+  %max = perf.max(%deltas : memref<?xf64>) : f64
+  // CHECK: perf.mean
+  %mean = perf.mean(%deltas : memref<?xf64>) : f64
+  // CHECK: perf.median
+  %median = perf.median(%deltas : memref<?xf64>) : f64
+  // CHECK: perf.percentile({{.*}}) {percentile = 9.900000e+01 : f64} : f64
+  %p99 = perf.percentile(%deltas : memref<?xf64>) {percentile = 99.0 : f64} : f64
+  // CHECK: perf.dump({{.*}}) {file = "deltas.txt"}
+  perf.dump(%deltas : memref<?xf64>) {file = "deltas.txt"}
+
+  return %min, %max, %mean, %median, %p99 : f64, f64, f64, f64, f64
+}
+
+// -----
+
+// CHECK-LABEL: @perf_flush_cache
+func.func @perf_flush_cache() {
+  // CHECK: perf.flush_cache
+  perf.flush_cache
+  return
+}
+
+// -----
+
+// CHECK-LABEL: @perf_set_num_threads
+func.func @perf_set_num_threads(%n: i64) {
+  // CHECK: perf.set_num_threads(%{{.+}} : i64)
+  perf.set_num_threads(%n : i64)
+  return
+}
+
+// -----
+
+// CHECK-LABEL: @perf_trace
+func.func @perf_trace() {
+  // CHECK: perf.trace_begin {label = "layer0"}
+  perf.trace_begin {label = "layer0"}
+  // CHECK: perf.trace_end
+  perf.trace_end
+  return
+}
+
+// -----
+
+// CHECK-LABEL: @perf_report
+func.func @perf_report(%mean: f64, %cycles: i64, %deltas: memref<?xf64>) {
+  // CHECK: perf.report({{.*}} : f64) {key = "mean"}
+  perf.report(%mean : f64) {key = "mean"}
+  // CHECK: perf.report({{.*}} : i64) {key = "cycles"}
+  perf.report(%cycles : i64) {key = "cycles"}
+  // CHECK: perf.report({{.*}} : memref<?xf64>) {key = "samples"}
+  perf.report(%deltas : memref<?xf64>) {key = "samples"}
+  return
+}
+
+// -----
+
+// CHECK-LABEL: @perf_map_file
+func.func @perf_map_file() -> memref<4x8xf32> {
+  // CHECK: perf.map_file "weights.npy" : memref<4x8xf32>
+  %0 = perf.map_file "weights.npy" : memref<4x8xf32>
+  return %0 : memref<4x8xf32>
+}
+
+// -----
+
+// CHECK-LABEL: @perf_map_blob
+func.func @perf_map_blob() -> memref<4x8xbf16> {
+  // CHECK: perf.map_blob "model.blob" offset 4096 : memref<4x8xbf16>
+  %0 = perf.map_blob "model.blob" offset 4096 : memref<4x8xbf16>
+  return %0 : memref<4x8xbf16>
+}
+
+// -----
+
+// CHECK-LABEL: @perf_init_tensor
+func.func @perf_init_tensor(%arg0: memref<4x8xf32>, %arg1: memref<16xbf16>) {
+  // CHECK: perf.init_tensor(%{{.*}} : memref<4x8xf32>) "normal" seed(42)
+  perf.init_tensor(%arg0 : memref<4x8xf32>) "normal" seed(42)
+  // CHECK: perf.init_tensor(%{{.*}} : memref<16xbf16>) "const" seed(0)
+  perf.init_tensor(%arg1 : memref<16xbf16>) "const" seed(0)
+  return
+}
+
+// -----
+
+// CHECK-LABEL: @perf_alloc
+func.func @perf_alloc() -> (memref<4x8xf32>, memref<16xi8>, memref<8x4x32x32xbf16>) {
+  // CHECK: perf.alloc {interleave, page_size = 2097152 : i64} : memref<4x8xf32>
+  %0 = perf.alloc {interleave, page_size = 2097152 : i64} : memref<4x8xf32>
+  // CHECK: perf.alloc : memref<16xi8>
+  %1 = perf.alloc : memref<16xi8>
+  // CHECK: perf.alloc {shard} : memref<8x4x32x32xbf16>
+  %2 = perf.alloc {shard} : memref<8x4x32x32xbf16>
+  return %0, %1, %2 : memref<4x8xf32>, memref<16xi8>, memref<8x4x32x32xbf16>
+}
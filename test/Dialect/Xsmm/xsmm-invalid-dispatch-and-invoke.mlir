@@ -242,3 +242,57 @@ func.func @binary(%arg0: memref<3x3xf32>, %arg1: memref<3x3xf32>) {
     (i64, memref<3x3xf32>, memref<3x3xf32>, memref<3x3xf32>) -> ()
   return
 }
+
+// -----
+
+func.func @gemm(%arg0: memref<3x3xf32>, %arg1: memref<3x3xf32>) {
+  %0 = xsmm.gemm.dispatch [3, 3, 3, 3, 3, 3] flags = (prefetch_a) data_type = f32
+  // expected-error@+1 {{expect prefetch operands if and only if prefetch flags are set}}
+  xsmm.gemm(data_type = f32, %0, %arg0, %arg0, %arg1) :
+    (i64, memref<3x3xf32>, memref<3x3xf32>, memref<3x3xf32>) -> ()
+  return
+}
+
+// -----
+
+func.func @brgemm_indirect(%arg0: memref<4x3x3xf32>, %arg1: memref<3x3xf32>,
+                           %arg2: memref<2xi64>) {
+  %0 = xsmm.brgemm.dispatch [3, 3, 3, 3, 3, 3, 0, 0] flags = (batch_reduce_address) data_type = f32
+  %c2 = arith.constant 2 : i64
+  // expected-error@+1 {{inconsistent batch-reduce kind}}
+  xsmm.brgemm_indirect offset(data_type = f32, %0, %arg0, %arg0, %arg1, %arg2, %arg2, %c2) :
+    (i64, memref<4x3x3xf32>, memref<4x3x3xf32>, memref<3x3xf32>, memref<2xi64>, memref<2xi64>, i64) -> ()
+  return
+}
+
+// -----
+
+func.func @binary(%arg0: memref<3x3xf8E4M3FN>, %arg1: memref<3x3xf8E4M3FN>) {
+  %0 = xsmm.binary.dispatch add [3, 3, 3, 3, 3] flags = (none) data_type = hf8
+  // expected-error@+1 {{expect a data movement kernel for fp8 types}}
+  xsmm.binary add(data_type = hf8, %0, %arg0, %arg0, %arg1) :
+    (i64, memref<3x3xf8E4M3FN>, memref<3x3xf8E4M3FN>, memref<3x3xf8E4M3FN>) -> ()
+  return
+}
+
+// -----
+
+func.func @brgemm_grouped(%arg0: memref<4x3x3xf32>, %arg1: memref<2x3xi64>) {
+  %0 = xsmm.brgemm.dispatch [3, 3, 3, 3, 3, 3, 9, 9] flags = (prefetch_a) data_type = f32
+  %c2 = arith.constant 2 : i64
+  // expected-error@+1 {{expect a strided brgemm dispatch}}
+  xsmm.brgemm_grouped(data_type = f32, %0, %arg0, %arg0, %arg0, %arg1, %c2) :
+    (i64, memref<4x3x3xf32>, memref<4x3x3xf32>, memref<4x3x3xf32>, memref<2x3xi64>, i64) -> ()
+  return
+}
+
+// -----
+
+func.func @equation(%arg0: memref<4x8xf32>, %arg1: memref<4x4xf32>) {
+  %0 = xsmm.equation.dispatch [4, 4, 4] args = [4, 4, 4]
+         nodes = [1, 17, 0, 0, 0, 0] data_type = f32
+  // expected-error@+1 {{expect argument 0 to match its dispatched shape}}
+  xsmm.equation(data_type = f32, %0, %arg0, %arg1)
+    : (i64, memref<4x8xf32>, memref<4x4xf32>) -> ()
+  return
+}
@@ -75,6 +75,32 @@ func.func @gemm_dispatch() -> i64 {
 
 // -----
 
+func.func @gemm_dispatch() -> i64 {
+  // m, n, k, lda, ldb, ldc
+  // expected-error@+1 {{expect lda to be >= of dimension m}}
+  %0 = xsmm.gemm.dispatch [4, 2, 3, 3, 2, 6] flags = (trans_a) data_type = f32
+  return %0 : i64
+}
+
+// -----
+
+func.func @gemm_dispatch() -> i64 {
+  // m, n, k, lda, ldb, ldc
+  // expected-error@+1 {{expect ldb to be >= of dimension k}}
+  %0 = xsmm.gemm.dispatch [1, 4, 3, 3, 2, 6] flags = (trans_b) data_type = f32
+  return %0 : i64
+}
+
+// -----
+
+func.func @gemm_dispatch() -> i64 {
+  // expected-error@+1 {{transpose and VNNI flags on the same operand}}
+  %0 = xsmm.gemm.dispatch [2, 2, 2, 4, 4, 6] flags = (trans_b, vnni_b) data_type = bf16
+  return %0 : i64
+}
+
+// -----
+
 func.func @gemm_dispatch() -> i64 {
   // expected-error@+1 {{expect 6 args but got: 5}}
   %0 = xsmm.gemm.dispatch [1, 2, 3, 4, 5] flags = (none) data_type = f32
@@ -261,6 +287,46 @@ func.func @gemm_invoke(%arg0: i64, %arg1: memref<3x3xbf16>, %arg2: memref<3x3xbf
 
 // -----
 
+func.func @gemm_invoke(%arg0: i64, %arg1: memref<3x3xi8>, %arg2: memref<3x3xi8>,
+                       %arg3: memref<3x3xi8>) {
+  // expected-error@+1 {{expect i32 but got: 'i8' for operand at index: 3}}
+  xsmm.gemm(data_type = i8, %arg0, %arg1, %arg2, %arg3)
+    : (i64, memref<3x3xi8>, memref<3x3xi8>, memref<3x3xi8>) -> ()
+  return
+}
+
+// -----
+
+func.func @gemm_invoke(%arg0: i64, %arg1: memref<3x3xi32>, %arg2: memref<3x3xi8>,
+                       %arg3: memref<3x3xi32>) {
+  // expected-error@+1 {{expect i8 but got: 'i32' for operand at index: 1}}
+  xsmm.gemm(data_type = i8, %arg0, %arg1, %arg2, %arg3)
+    : (i64, memref<3x3xi32>, memref<3x3xi8>, memref<3x3xi32>) -> ()
+  return
+}
+
+// -----
+
+func.func @gemm_invoke(%arg0: i64, %arg1: memref<3x3xf8E5M2>,
+                       %arg2: memref<3x3xf8E5M2>, %arg3: memref<3x3xf8E5M2>) {
+  // expected-error@+1 {{expect f32 but got: 'f8E5M2' for operand at index: 3}}
+  xsmm.gemm(data_type = bf8, %arg0, %arg1, %arg2, %arg3)
+    : (i64, memref<3x3xf8E5M2>, memref<3x3xf8E5M2>, memref<3x3xf8E5M2>) -> ()
+  return
+}
+
+// -----
+
+func.func @gemm_invoke(%arg0: i64, %arg1: memref<3x3xf8E5M2>,
+                       %arg2: memref<3x3xf8E5M2>, %arg3: memref<3x3xf32>) {
+  // expected-error@+1 {{expect hf8 but got: 'f8E5M2' for operand at index: 1}}
+  xsmm.gemm(data_type = hf8, %arg0, %arg1, %arg2, %arg3)
+    : (i64, memref<3x3xf8E5M2>, memref<3x3xf8E5M2>, memref<3x3xf32>) -> ()
+  return
+}
+
+// -----
+
 func.func @gemm_invoke(%arg0: memref<3x3xf32>, %arg1: memref<3x3xf32>, %arg2: memref<3x3xf32>,
                        %arg3: memref<3x3xf32>) {
   // expected-error@+1 {{expect an i64 but got 'memref<3x3xf32>' for operand 0 (dispatch)}}
@@ -273,7 +339,7 @@ func.func @gemm_invoke(%arg0: memref<3x3xf32>, %arg1: memref<3x3xf32>, %arg2: me
 
 func.func @gemm_invoke(%arg0: f32, %arg1: memref<3x3xf32>, %arg2: memref<3x3xf32>,
                        %arg3: memref<3x3xf32>) {
-  // expected-error@+1 {{op operand #0 must be variadic of 2D/3D static memref of 32-bit float or bfloat16 type values or 64-bit signless integer, but got 'f32'}}
+  // expected-error@+1 {{op operand #0 must be variadic of 2D/3D memref of 32-bit float or bfloat16 type}}
   xsmm.gemm(data_type = f32, %arg0, %arg1, %arg2, %arg3)
     : (f32, memref<3x3xf32>, memref<3x3xf32>, memref<3x3xf32>) -> ()
   return
@@ -283,7 +349,7 @@ func.func @gemm_invoke(%arg0: f32, %arg1: memref<3x3xf32>, %arg2: memref<3x3xf32
 
 func.func @gemm_invoke(%arg0: i64, %arg1: memref<1x1x3x3xf32>, %arg2: memref<3x3xf32>,
                        %arg3: memref<3x3xf32>) {
-  // expected-error@+1 {{op operand #1 must be variadic of 2D/3D static memref of 32-bit float or bfloat16 type values or 64-bit signless integer, but got 'memref<1x1x3x3xf32>'}}
+  // expected-error@+1 {{op operand #1 must be variadic of 2D/3D memref of 32-bit float or bfloat16 type}}
   xsmm.gemm(data_type = f32, %arg0, %arg1, %arg2, %arg3)
     : (i64, memref<1x1x3x3xf32>, memref<3x3xf32>, memref<3x3xf32>) -> ()
   return
@@ -321,7 +387,7 @@ func.func @brgemm_invoke(%arg0: i64, %arg1: memref<3x3xf32>, %arg2: memref<3x3xf
 
 func.func @brgemm_invoke(%arg0: i64, %arg1: memref<3x3xf32>, %arg2: memref<2x3x3xf32>,
                          %arg3: memref<3x3xf32>, %arg4: memref<2xf32>) {
-  // expected-error@+1 {{operand #4 must be variadic of 2D/3D/4D static memref of 32-bit float or bfloat16 type values or 64-bit signless integer, but got 'memref<2xf32>'}}
+  // expected-error@+1 {{operand #4 must be variadic of 2D/3D/4D memref of 32-bit float or bfloat16 type}}
   xsmm.brgemm(data_type = f32, %arg0, %arg1, %arg2, %arg3, %arg4)
     : (i64, memref<3x3xf32>, memref<2x3x3xf32>, memref<3x3xf32>, memref<2xf32>) -> ()
   return
@@ -338,26 +404,8 @@ func.func @brgemm_invoke(%arg0: i64, %arg1: memref<2x3x3xf32>, %arg2: memref<2x3
 
 // -----
 
-func.func @gemm_invoke(%arg0: i64, %arg1: memref<?x?xf32>, %arg2: memref<?x?xf32>) {
-  // expected-error@+1 {{operand #1 must be variadic of 2D/3D static memref of 32-bit float or bfloat16 type values or 64-bit signless integer, but got 'memref<?x?xf32>'}}
-  xsmm.gemm(data_type = f32, %arg0, %arg1, %arg2, %arg2)
-    : (i64, memref<?x?xf32>, memref<?x?xf32>, memref<?x?xf32>) -> ()
-  return
-}
-
-// -----
-
-func.func @gemm_invoke(%arg0: i64, %arg1: memref<?x?x?xf32>, %arg2: memref<?x?x?xf32>, %arg3: memref<?x?xf32>) {
-  // expected-error@+1 {{operand #1 must be variadic of 2D/3D/4D static memref of 32-bit float or bfloat16 type values or 64-bit signless integer, but got 'memref<?x?x?xf32>'}}
-  xsmm.brgemm(data_type = f32, %arg0, %arg1, %arg2, %arg3, %arg0)
-    : (i64, memref<?x?x?xf32>, memref<?x?x?xf32>, memref<?x?xf32>, i64) -> ()
-  return
-}
-
-// -----
-
 func.func @unary_invoke(%arg0: memref<?x?xf32>, %arg1: memref<3x3xf32>, %disp: i64) {
-  // expected-error@+1 {{operand #1 must be variadic of 1D/2D/3D/4D static memref of 32-bit float or bfloat16 type values or 32-bit float or bfloat16 type or 64-bit signless integer, but got 'memref<?x?xf32>'}}
+  // expected-error@+1 {{operand #1 must be variadic of 1D/2D/3D/4D static memref of 32-bit float or bfloat16 type}}
   xsmm.unary relu(data_type = f32, %disp, %arg0, %arg1) : (i64, memref<?x?xf32>, memref<3x3xf32>) -> ()
   return
 }
@@ -365,7 +413,7 @@ func.func @unary_invoke(%arg0: memref<?x?xf32>, %arg1: memref<3x3xf32>, %disp: i
 // -----
 
 func.func @unary_invoke(%arg0: memref<?x?xf32>, %arg1: memref<3x3xf32>, %disp: i64) {
-  // expected-error@+1 {{operand #1 must be variadic of 1D/2D/3D/4D static memref of 32-bit float or bfloat16 type values or 32-bit float or bfloat16 type or 64-bit signless integer, but got 'memref<?x?xf32>'}}
+  // expected-error@+1 {{operand #1 must be variadic of 1D/2D/3D/4D static memref of 32-bit float or bfloat16 type}}
   xsmm.binary add(data_type = f32, %disp, %arg0, %arg0, %arg1)
     : (i64, memref<?x?xf32>, memref<?x?xf32>, memref<3x3xf32>) -> ()
   return
@@ -424,3 +472,124 @@ func.func @binary_invoke(%arg0: i64, %arg1: memref<3x3xf32>) {
     : (i64, memref<3x3xf32>, memref<3x3xf32>, memref<3x3xf32>, memref<3x3xf32>) -> ()
   return
 }
+
+// -----
+
+func.func @fused_brgemm_dispatch() -> i64 {
+  // expected-error@+1 {{prefetch flags are not supported}}
+  %0 = xsmm.fused_brgemm.dispatch [3, 2, 1, 1, 2, 2, 1, 1] [add, relu]
+    flags = (prefetch_a) binary_flags = (bcast_col_in0) unary_flags = (none) data_type = f32
+  return %0 : i64
+}
+
+// -----
+
+func.func @brgemm_invoke(%arg0: i64, %arg1: memref<2x3x4xf32>, %arg2: memref<2x4x3xf32>,
+                         %arg3: memref<3x3xf32>, %arg4: i64, %arg5: memref<2x3x3xf32>) {
+  // expected-error@+1 {{expect prefetch operand A to match operand A}}
+  xsmm.brgemm(data_type = f32, %arg0, %arg1, %arg2, %arg3, %arg4, %arg5, %arg2)
+    : (i64, memref<2x3x4xf32>, memref<2x4x3xf32>, memref<3x3xf32>, i64,
+       memref<2x3x3xf32>, memref<2x4x3xf32>) -> ()
+  return
+}
+
+// -----
+
+func.func @gemm_dispatch() -> i64 {
+  // expected-error@+1 {{batch-reduce flags are not supported}}
+  %0 = xsmm.gemm.dispatch [3, 2, 1, 3, 2, 2] flags = (batch_reduce_offset) data_type = f32
+  return %0 : i64
+}
+
+// -----
+
+func.func @brgemm_dispatch() -> i64 {
+  // expected-error@+1 {{conflicting batch-reduce flags}}
+  %0 = xsmm.brgemm.dispatch [3, 2, 1, 3, 2, 2, 0, 0]
+    flags = (batch_reduce_offset, batch_reduce_address) data_type = f32
+  return %0 : i64
+}
+
+// -----
+
+func.func @brgemm_indirect_invoke(%arg0: i64, %arg1: memref<4x2x2xf32>, %arg2: memref<2x2xf32>,
+                                  %arg3: memref<2xi64>, %arg4: memref<3xi64>, %arg5: i64) {
+  // expected-error@+1 {{expect lists of A and B to have the same size}}
+  xsmm.brgemm_indirect offset(data_type = f32, %arg0, %arg1, %arg1, %arg2, %arg3, %arg4, %arg5)
+    : (i64, memref<4x2x2xf32>, memref<4x2x2xf32>, memref<2x2xf32>, memref<2xi64>, memref<3xi64>, i64) -> ()
+  return
+}
+
+// -----
+
+func.func @brgemm_grouped_invoke(%arg0: i64, %arg1: memref<4x32x32xf32>,
+                                 %arg2: memref<4x2xi64>, %arg3: i64) {
+  // expected-error@+1 {{expect 3 offsets (A, B and C) per descriptor but got 2}}
+  xsmm.brgemm_grouped(data_type = f32, %arg0, %arg1, %arg1, %arg1, %arg2, %arg3)
+    : (i64, memref<4x32x32xf32>, memref<4x32x32xf32>, memref<4x32x32xf32>,
+       memref<4x2xi64>, i64) -> ()
+  return
+}
+
+// -----
+
+func.func @equation_dispatch_incomplete() -> i64 {
+  // expected-error@+1 {{expect 1 more node(s) to complete the tree}}
+  %0 = xsmm.equation.dispatch [4, 4, 4] args = [4, 4, 4]
+         nodes = [2, 1, 0, 0, 0, 0] data_type = f32
+  return %0 : i64
+}
+
+// -----
+
+func.func @equation_dispatch_extra_node() -> i64 {
+  // expected-error@+1 {{expect a single tree but got extra node 2}}
+  %0 = xsmm.equation.dispatch [4, 4, 4] args = [4, 4, 4]
+         nodes = [1, 17, 0, 0, 0, 0, 0, 0, 0] data_type = f32
+  return %0 : i64
+}
+
+// -----
+
+func.func @equation_dispatch_invalid_arg() -> i64 {
+  // expected-error@+1 {{expect argument index of node 1 to be < 1}}
+  %0 = xsmm.equation.dispatch [4, 4, 4] args = [4, 4, 4]
+         nodes = [1, 17, 0, 0, 1, 0] data_type = f32
+  return %0 : i64
+}
+
+// -----
+
+func.func @equation_dispatch_invalid_ld() -> i64 {
+  // expected-error@+1 {{expect ld to be >= of dimension n for argument 0}}
+  %0 = xsmm.equation.dispatch [4, 4, 4] args = [4, 4, 2]
+         nodes = [1, 17, 0, 0, 0, 0] data_type = f32
+  return %0 : i64
+}
+
+// -----
+
+func.func @equation_invoke_num_args(%arg0: memref<4x4xf32>) {
+  %0 = xsmm.equation.dispatch [4, 4, 4] args = [4, 4, 4, 4, 4, 4]
+         nodes = [2, 1, 0, 0, 0, 0, 0, 1, 0] data_type = f32
+  // expected-error@+1 {{expect 2 arguments as dispatched but got 1}}
+  xsmm.equation(data_type = f32, %0, %arg0, %arg0)
+    : (i64, memref<4x4xf32>, memref<4x4xf32>) -> ()
+  return
+}
+
+// -----
+
+func.func @gemm_dispatch_output_type() -> i64 {
+  // expected-error@+1 {{expect output type f32 only for bf16 and f16 data types}}
+  %0 = xsmm.gemm.dispatch [1, 2, 3, 4, 5, 6] flags = (none) data_type = f32 output_type = f32
+  return %0 : i64
+}
+
+// -----
+
+func.func @brgemm_dispatch_output_type() -> i64 {
+  // expected-error@+1 {{expect output type f32 only for bf16 and f16 data types}}
+  %0 = xsmm.brgemm.dispatch [1, 2, 3, 4, 5, 6, 1, 1] flags = (none) data_type = bf16 output_type = bf16
+  return %0 : i64
+}
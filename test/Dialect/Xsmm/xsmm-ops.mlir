@@ -44,6 +44,10 @@ func.func @xsmm_dialect(%arg0: memref<2x2xf32>,
   %4 = xsmm.gemm.dispatch [1, 2, 3, 4, 5, 6] flags = (beta_0) data_type = bf16
   // CHECK-NEXT: xsmm.gemm.dispatch
   %5 = xsmm.gemm.dispatch [1, 2, 3, 4, 5, 6] flags = (vnni_a, vnni_b) data_type = bf16
+  // CHECK-NEXT: xsmm.gemm.dispatch
+  %trans = xsmm.gemm.dispatch [4, 2, 3, 4, 3, 6] flags = (trans_a, trans_b) data_type = f32
+  // CHECK-NEXT: xsmm.gemm.dispatch {{.*}} data_type = bf16 output_type = f32
+  %mixed = xsmm.gemm.dispatch [1, 2, 3, 4, 5, 6] flags = (beta_0) data_type = bf16 output_type = f32
   // CHECK-NEXT: xsmm.brgemm.dispatch
   %6 = xsmm.brgemm.dispatch [1, 2, 3, 4, 5, 6, 1, 1] flags = (vnni_a, vnni_b) data_type = bf16
   // CHECK-NEXT: xsmm.brgemm.dispatch
@@ -52,6 +56,8 @@ func.func @xsmm_dialect(%arg0: memref<2x2xf32>,
   %8 = xsmm.brgemm.dispatch [1, 2, 3, 4, 5, 6, 1, 1] flags = (beta_0) data_type = f32
   // CHECK-NEXT: xsmm.brgemm.dispatch
   %9 = xsmm.brgemm.dispatch [1, 2, 3, 4, 5, 6, 1, 1] flags = (none) data_type = f32
+  // CHECK-NEXT: xsmm.brgemm.dispatch {{.*}} data_type = f16 output_type = f32
+  %mixed_br = xsmm.brgemm.dispatch [1, 2, 3, 4, 5, 6, 1, 1] flags = (none) data_type = f16 output_type = f32
   // CHECK: xsmm.gemm.dispatch {{.*}} {myAttr = "myattr"}
   %10 = xsmm.gemm.dispatch [1, 2, 3, 4, 5, 6] flags = (none) data_type = f32 {myAttr = "myattr"}
 
@@ -74,3 +80,115 @@ func.func @xsmm_dialect(%arg0: memref<2x2xf32>,
 
   return
 }
+
+// CHECK-LABEL: @xsmm_brgemm_indirect
+func.func @xsmm_brgemm_indirect(%arg0: memref<4x2x2xf32>, %arg1: memref<2x2xf32>,
+                                %arg2: memref<2xi64>) {
+  %b = arith.constant 2 : i64
+  // CHECK: xsmm.brgemm.dispatch {{.*}} flags = (batch_reduce_offset)
+  %0 = xsmm.brgemm.dispatch [2, 2, 2, 2, 2, 2, 0, 0] flags = (batch_reduce_offset) data_type = f32
+  // CHECK: xsmm.brgemm_indirect offset
+  xsmm.brgemm_indirect offset(data_type = f32, %0, %arg0, %arg0, %arg1, %arg2, %arg2, %b)
+    : (i64, memref<4x2x2xf32>, memref<4x2x2xf32>, memref<2x2xf32>, memref<2xi64>, memref<2xi64>, i64) -> ()
+  // CHECK: xsmm.brgemm.dispatch {{.*}} flags = (batch_reduce_address)
+  %1 = xsmm.brgemm.dispatch [2, 2, 2, 2, 2, 2, 0, 0] flags = (batch_reduce_address) data_type = f32
+  // CHECK: xsmm.brgemm_indirect address
+  xsmm.brgemm_indirect address(data_type = f32, %1, %arg0, %arg0, %arg1, %arg2, %arg2, %b)
+    : (i64, memref<4x2x2xf32>, memref<4x2x2xf32>, memref<2x2xf32>, memref<2xi64>, memref<2xi64>, i64) -> ()
+  return
+}
+
+// CHECK-LABEL: @xsmm_gemm_i8
+func.func @xsmm_gemm_i8(%arg0: memref<4x8xi8>, %arg1: memref<2x4x4xi8>,
+                        %arg2: memref<4x4xi32>, %arg3: memref<2x4x8xi8>,
+                        %arg4: memref<2x2x4x4xi8>) {
+  // CHECK: xsmm.gemm.dispatch {{.*}} flags = (vnni_b) data_type = i8
+  %0 = xsmm.gemm.dispatch [4, 4, 8, 8, 4, 4] flags = (vnni_b) data_type = i8
+  // CHECK: xsmm.gemm(data_type = i8
+  xsmm.gemm(data_type = i8, %0, %arg0, %arg1, %arg2)
+    : (i64, memref<4x8xi8>, memref<2x4x4xi8>, memref<4x4xi32>) -> ()
+  %b = arith.constant 2 : i64
+  // CHECK: xsmm.brgemm.dispatch {{.*}} flags = (vnni_b) data_type = i8
+  %1 = xsmm.brgemm.dispatch [4, 4, 8, 8, 4, 4, 32, 32] flags = (vnni_b) data_type = i8
+  // CHECK: xsmm.brgemm(data_type = i8
+  xsmm.brgemm(data_type = i8, %1, %arg3, %arg4, %arg2, %b)
+    : (i64, memref<2x4x8xi8>, memref<2x2x4x4xi8>, memref<4x4xi32>, i64) -> ()
+  // CHECK: xsmm.unary.dispatch vnni_4
+  %2 = xsmm.unary.dispatch vnni_4 [8, 4, 4, 4] flags = (none) data_type = i8
+  return
+}
+
+// CHECK-LABEL: @xsmm_gemm_f16
+func.func @xsmm_gemm_f16(%arg0: memref<4x8xf16>, %arg1: memref<8x4xf16>,
+                         %arg2: memref<4x4xf16>) {
+  // CHECK: xsmm.gemm.dispatch {{.*}} flags = (none) data_type = f16
+  %0 = xsmm.gemm.dispatch [4, 4, 8, 8, 4, 4] flags = (none) data_type = f16
+  // CHECK: xsmm.gemm(data_type = f16
+  xsmm.gemm(data_type = f16, %0, %arg0, %arg1, %arg2)
+    : (i64, memref<4x8xf16>, memref<8x4xf16>, memref<4x4xf16>) -> ()
+  return
+}
+
+// CHECK-LABEL: @xsmm_gemm_fp8
+func.func @xsmm_gemm_fp8(%arg0: memref<4x8xf8E5M2>, %arg1: memref<8x4xf8E5M2>,
+                         %arg2: memref<4x8xf8E4M3FN>, %arg3: memref<8x4xf8E4M3FN>,
+                         %arg4: memref<4x4xf32>) {
+  // CHECK: xsmm.gemm.dispatch {{.*}} flags = (none) data_type = bf8
+  %0 = xsmm.gemm.dispatch [4, 4, 8, 8, 4, 4] flags = (none) data_type = bf8
+  // CHECK: xsmm.gemm(data_type = bf8
+  xsmm.gemm(data_type = bf8, %0, %arg0, %arg1, %arg4)
+    : (i64, memref<4x8xf8E5M2>, memref<8x4xf8E5M2>, memref<4x4xf32>) -> ()
+  // CHECK: xsmm.gemm.dispatch {{.*}} flags = (none) data_type = hf8
+  %1 = xsmm.gemm.dispatch [4, 4, 8, 8, 4, 4] flags = (none) data_type = hf8
+  // CHECK: xsmm.gemm(data_type = hf8
+  xsmm.gemm(data_type = hf8, %1, %arg2, %arg3, %arg4)
+    : (i64, memref<4x8xf8E4M3FN>, memref<8x4xf8E4M3FN>, memref<4x4xf32>) -> ()
+  // CHECK: xsmm.unary.dispatch identity {{.*}} data_type = hf8
+  %2 = xsmm.unary.dispatch identity [4, 8, 8, 8] flags = (none) data_type = hf8
+  return
+}
+
+// CHECK-LABEL: @xsmm_brgemm_grouped
+func.func @xsmm_brgemm_grouped(%arg0: memref<4x8x32x32xf32>, %arg1: memref<4x4x32x32xf32>,
+                               %arg2: memref<4x3xi64>) {
+  %0 = xsmm.brgemm.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024] flags = (none) data_type = f32
+  %c8 = arith.constant 8 : i64
+  // CHECK: xsmm.brgemm_grouped(data_type = f32
+  xsmm.brgemm_grouped(data_type = f32, %0, %arg0, %arg0, %arg1, %arg2, %c8)
+    : (i64, memref<4x8x32x32xf32>, memref<4x8x32x32xf32>, memref<4x4x32x32xf32>,
+       memref<4x3xi64>, i64) -> ()
+  return
+}
+
+// CHECK-LABEL: @xsmm_gemm_dynamic
+// CHECK-SAME: %[[M:.+]]: i64, %[[N:.+]]: i64
+func.func @xsmm_gemm_dynamic(%m: i64, %n: i64, %arg0: memref<?x8xf32>,
+                             %arg1: memref<8x?xf32>, %arg2: memref<?x?xf32>,
+                             %arg3: memref<2x?x8xf32>, %arg4: memref<2x8x4xf32>,
+                             %arg5: memref<?x4xf32>) {
+  // CHECK: xsmm.gemm.dispatch [%[[M]], %[[N]], 8, 8, 4, 4] flags = (none) data_type = f32
+  %0 = xsmm.gemm.dispatch [%m, %n, 8, 8, 4, 4] flags = (none) data_type = f32
+  // CHECK: xsmm.gemm(data_type = f32
+  xsmm.gemm(data_type = f32, %0, %arg0, %arg1, %arg2)
+    : (i64, memref<?x8xf32>, memref<8x?xf32>, memref<?x?xf32>) -> ()
+  // CHECK: xsmm.brgemm.dispatch [%[[M]], 4, 8, 8, 4, 4, 64, 32] flags = (none) data_type = f32
+  %1 = xsmm.brgemm.dispatch [%m, 4, 8, 8, 4, 4, 64, 32] flags = (none) data_type = f32
+  %c2 = arith.constant 2 : i64
+  // CHECK: xsmm.brgemm(data_type = f32
+  xsmm.brgemm(data_type = f32, %1, %arg3, %arg4, %arg5, %c2)
+    : (i64, memref<2x?x8xf32>, memref<2x8x4xf32>, memref<?x4xf32>, i64) -> ()
+  return
+}
+
+// CHECK-LABEL: @xsmm_equation
+func.func @xsmm_equation(%arg0: memref<32x32xf32>, %arg1: memref<32xf32>,
+                         %arg2: memref<32x32xf32>) {
+  // CHECK: xsmm.equation.dispatch [32, 32, 32] args = [32, 32, 32, 32, 1, 1]
+  // CHECK-SAME: nodes = [1, 17, 0, 2, 1, 2, 0, 0, 0, 0, 1, 0] data_type = f32
+  %0 = xsmm.equation.dispatch [32, 32, 32] args = [32, 32, 32, 32, 1, 1]
+         nodes = [1, 17, 0, 2, 1, 2, 0, 0, 0, 0, 1, 0] data_type = f32
+  // CHECK: xsmm.equation(data_type = f32
+  xsmm.equation(data_type = f32, %0, %arg0, %arg1, %arg2)
+    : (i64, memref<32x32xf32>, memref<32xf32>, memref<32x32xf32>) -> ()
+  return
+}
@@ -0,0 +1,46 @@
+// RUN: tpp-opt %s -pass-pipeline="builtin.module(gpu.module(gpu-constant-memory))" -split-input-file | FileCheck %s
+// RUN: tpp-opt %s -pass-pipeline="builtin.module(gpu.module(gpu-constant-memory{max-bytes=64}))" -split-input-file | FileCheck %s --check-prefix=SMALL
+
+module attributes {gpu.container_module} {
+  gpu.module @kernels {
+    memref.global "private" constant @bias : memref<16xf32> = dense<1.000000e+00> {alignment = 64 : i64}
+    memref.global "private" constant @scale : memref<32xf32> = dense<2.000000e+00> {alignment = 64 : i64}
+    memref.global "private" @state : memref<16xf32> = dense<0.000000e+00>
+
+    gpu.func @kernel(%arg0: memref<16xf32>) kernel {
+      %c0 = arith.constant 0 : index
+      %0 = memref.get_global @bias : memref<16xf32>
+      %1 = memref.get_global @scale : memref<32xf32>
+      %2 = memref.get_global @state : memref<16xf32>
+      %3 = memref.load %0[%c0] : memref<16xf32>
+      %4 = memref.load %1[%c0] : memref<32xf32>
+      %5 = memref.load %2[%c0] : memref<16xf32>
+      %6 = arith.addf %3, %4 : f32
+      %7 = arith.addf %6, %5 : f32
+      memref.store %7, %arg0[%c0] : memref<16xf32>
+      gpu.return
+    }
+  }
+}
+
+// CHECK-LABEL: gpu.module @kernels
+// CHECK-DAG: memref.global "private" constant @bias : memref<16xf32, 4>
+// CHECK-DAG: memref.global "private" constant @scale : memref<32xf32, 4>
+// CHECK-DAG: memref.global "private" @state : memref<16xf32> =
+// CHECK-LABEL: gpu.func @kernel
+// CHECK: %[[BIAS:.+]] = memref.get_global @bias : memref<16xf32, 4>
+// CHECK: %[[BIAS_CAST:.+]] = memref.memory_space_cast %[[BIAS]] : memref<16xf32, 4> to memref<16xf32>
+// CHECK: %[[SCALE:.+]] = memref.get_global @scale : memref<32xf32, 4>
+// CHECK: %[[SCALE_CAST:.+]] = memref.memory_space_cast %[[SCALE]] : memref<32xf32, 4> to memref<32xf32>
+// CHECK: %[[STATE:.+]] = memref.get_global @state : memref<16xf32>
+// CHECK: memref.load %[[BIAS_CAST]]
+// CHECK: memref.load %[[SCALE_CAST]]
+// CHECK: memref.load %[[STATE]]
+
+// The scale does not fit in the constant memory left.
+// SMALL-LABEL: gpu.module @kernels
+// SMALL-DAG: memref.global "private" constant @bias : memref<16xf32, 4>
+// SMALL-DAG: memref.global "private" constant @scale : memref<32xf32> =
+// SMALL-LABEL: gpu.func @kernel
+// SMALL: memref.get_global @bias : memref<16xf32, 4>
+// SMALL: memref.get_global @scale : memref<32xf32>
@@ -0,0 +1,90 @@
+// RUN: tpp-opt %s -gpu-data-transfer="async" -split-input-file | \
+// RUN: FileCheck %s
+
+module attributes {gpu.container_module} {
+  func.func @independent_kernels() {
+    %c1 = arith.constant 1 : index
+
+    %0 = memref.alloc() : memref<8x8xf32>
+    %1 = memref.alloc() : memref<8x8xf32>
+    gpu.launch_func  @entry_kernel::@entry_kernel blocks in (%c1, %c1, %c1) threads in (%c1, %c1, %c1)
+        args(%0 : memref<8x8xf32>)
+    gpu.launch_func  @entry_kernel::@entry_kernel blocks in (%c1, %c1, %c1) threads in (%c1, %c1, %c1)
+        args(%1 : memref<8x8xf32>)
+    memref.dealloc %0 : memref<8x8xf32>
+    memref.dealloc %1 : memref<8x8xf32>
+
+    return
+  }
+  gpu.module @entry_kernel {
+    gpu.func @entry_kernel(%arg0: memref<8x8xf32>) kernel attributes {known_block_size = array<i32: 1, 1, 1>, known_grid_size = array<i32: 1, 1, 1>} {
+      gpu.return
+    }
+  }
+}
+
+// The allocations share a stream, each kernel runs on the stream of its
+// input copy and the host waits for a stream before releasing its buffer.
+// CHECK-LABEL: @independent_kernels
+// CHECK: %[[ALLOC_STREAM:.+]] = gpu.wait async
+// CHECK: %{{.+}}, %[[A0:.+]] = gpu.alloc async [%[[ALLOC_STREAM]]] ()
+// CHECK: %{{.+}}, %{{.+}} = gpu.alloc async [%[[A0]]] ()
+// CHECK-DAG: %[[HOST0:.+]] = memref.alloc
+// CHECK-DAG: %[[HOST1:.+]] = memref.alloc
+// CHECK: %[[S0:.+]] = gpu.wait async [%{{.+}}]
+// CHECK: %[[IN0:.+]] = gpu.memcpy async [%[[S0]]] %[[GPU0:.+]], %[[HOST0]]
+// CHECK: %[[K0:.+]] = gpu.launch_func async [%[[IN0]]] @entry_kernel::@entry_kernel
+// CHECK-SAME: args(%[[GPU0]] : memref<8x8xf32>)
+// CHECK: %[[OUT0:.+]] = gpu.memcpy async [%[[K0]]] %[[HOST0]], %[[GPU0]]
+// CHECK: %[[S1:.+]] = gpu.wait async [%{{.+}}]
+// CHECK: %[[IN1:.+]] = gpu.memcpy async [%[[S1]]] %[[GPU1:.+]], %[[HOST1]]
+// CHECK: %[[K1:.+]] = gpu.launch_func async [%[[IN1]]] @entry_kernel::@entry_kernel
+// CHECK-SAME: args(%[[GPU1]] : memref<8x8xf32>)
+// CHECK: %[[OUT1:.+]] = gpu.memcpy async [%[[K1]]] %[[HOST1]], %[[GPU1]]
+// CHECK: gpu.wait [%[[OUT0]]]
+// CHECK-NEXT: memref.dealloc %[[HOST0]]
+// CHECK: gpu.wait [%[[OUT1]]]
+// CHECK-NEXT: memref.dealloc %[[HOST1]]
+// CHECK: gpu.dealloc async
+// CHECK: gpu.dealloc async
+// CHECK: gpu.wait [
+// CHECK-NEXT: return
+
+// -----
+
+// The second kernel reads the output of the first one.
+module attributes {gpu.container_module} {
+  func.func @dependent_kernels() {
+    %c1 = arith.constant 1 : index
+
+    %0 = memref.alloc() : memref<8x8xf32>
+    gpu.launch_func  @entry_kernel::@entry_kernel blocks in (%c1, %c1, %c1) threads in (%c1, %c1, %c1)
+        args(%0 : memref<8x8xf32>)
+    gpu.launch_func  @entry_kernel::@entry_kernel blocks in (%c1, %c1, %c1) threads in (%c1, %c1, %c1)
+        args(%0 : memref<8x8xf32>)
+    memref.dealloc %0 : memref<8x8xf32>
+
+    return
+  }
+  gpu.module @entry_kernel {
+    gpu.func @entry_kernel(%arg0: memref<8x8xf32>) kernel attributes {known_block_size = array<i32: 1, 1, 1>, known_grid_size = array<i32: 1, 1, 1>} {
+      gpu.return
+    }
+  }
+}
+
+// The copies of the second kernel only wait on the device for the first one.
+// CHECK-LABEL: @dependent_kernels
+// CHECK: gpu.alloc async
+// CHECK: gpu.alloc async
+// CHECK: %[[HOST:.+]] = memref.alloc
+// CHECK: %[[IN0:.+]] = gpu.memcpy async
+// CHECK: %[[K0:.+]] = gpu.launch_func async [%[[IN0]]]
+// CHECK: %[[OUT0:.+]] = gpu.memcpy async [%[[K0]]] %[[HOST]]
+// CHECK-NOT: gpu.wait [
+// CHECK: %[[S1:.+]] = gpu.wait async [%[[OUT0]]]
+// CHECK: %[[IN1:.+]] = gpu.memcpy async [%[[S1]]]
+// CHECK: %[[K1:.+]] = gpu.launch_func async [%[[IN1]]]
+// CHECK: %[[OUT1:.+]] = gpu.memcpy async [%[[K1]]] %[[HOST]]
+// CHECK: gpu.wait [%[[OUT1]]]
+// CHECK-NEXT: memref.dealloc %[[HOST]]
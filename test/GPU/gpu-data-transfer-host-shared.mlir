@@ -0,0 +1,90 @@
+// RUN: tpp-opt %s -gpu-data-transfer="host-shared" -split-input-file | \
+// RUN: FileCheck %s
+
+module attributes {gpu.container_module} {
+  func.func @alloc_shared(%arg0: memref<8x8xf32>) {
+    %c1 = arith.constant 1 : index
+    %cst = arith.constant 1.0 : f32
+
+    %0 = memref.alloc() : memref<8x8xf32>
+    linalg.fill ins(%cst : f32) outs(%0 : memref<8x8xf32>)
+    gpu.launch_func  @entry_kernel::@entry_kernel blocks in (%c1, %c1, %c1) threads in (%c1, %c1, %c1)
+        args(%0 : memref<8x8xf32>)
+    memref.copy %0, %arg0 : memref<8x8xf32> to memref<8x8xf32>
+    memref.dealloc %0 : memref<8x8xf32>
+
+    return
+  }
+  gpu.module @entry_kernel {
+    gpu.func @entry_kernel(%arg0: memref<8x8xf32>) kernel attributes {known_block_size = array<i32: 1, 1, 1>, known_grid_size = array<i32: 1, 1, 1>} {
+      gpu.return
+    }
+  }
+}
+
+// The host and the kernel use the same buffer, without copies.
+// CHECK-LABEL: @alloc_shared(
+// CHECK-NOT: memref.alloc
+// CHECK: %[[BUF:.+]] = gpu.alloc  host_shared () : memref<8x8xf32>
+// CHECK: linalg.fill {{.*}} outs(%[[BUF]]
+// CHECK-NOT: gpu.memcpy
+// CHECK: gpu.launch_func{{.*}}args(%[[BUF]] : memref<8x8xf32>)
+// CHECK: memref.copy %[[BUF]]
+// CHECK: gpu.dealloc  %[[BUF]]
+// CHECK-NOT: memref.dealloc
+
+// -----
+
+module attributes {gpu.container_module} {
+  func.func @alloc_no_dealloc() {
+    %c1 = arith.constant 1 : index
+
+    %0 = memref.alloc() : memref<8x8xf32>
+    %1 = memref.subview %0[0, 0] [4, 8] [1, 1] : memref<8x8xf32> to memref<4x8xf32, strided<[8, 1]>>
+    gpu.launch_func  @entry_kernel::@entry_kernel blocks in (%c1, %c1, %c1) threads in (%c1, %c1, %c1)
+        args(%1 : memref<4x8xf32, strided<[8, 1]>>)
+
+    return
+  }
+  gpu.module @entry_kernel {
+    gpu.func @entry_kernel(%arg0: memref<4x8xf32, strided<[8, 1]>>) kernel attributes {known_block_size = array<i32: 1, 1, 1>, known_grid_size = array<i32: 1, 1, 1>} {
+      gpu.return
+    }
+  }
+}
+
+// CHECK-LABEL: @alloc_no_dealloc(
+// CHECK: %[[BUF:.+]] = gpu.alloc  host_shared () : memref<8x8xf32>
+// CHECK: %[[VIEW:.+]] = memref.subview %[[BUF]]
+// CHECK-NOT: gpu.memcpy
+// CHECK: gpu.launch_func{{.*}}args(%[[VIEW]]
+// CHECK: gpu.dealloc  %[[BUF]]
+// CHECK-NEXT: return
+
+// -----
+
+module attributes {gpu.container_module} {
+  func.func @alloc_returned() -> memref<8x8xf32> {
+    %c1 = arith.constant 1 : index
+
+    %0 = memref.alloc() : memref<8x8xf32>
+    gpu.launch_func  @entry_kernel::@entry_kernel blocks in (%c1, %c1, %c1) threads in (%c1, %c1, %c1)
+        args(%0 : memref<8x8xf32>)
+
+    return %0 : memref<8x8xf32>
+  }
+  gpu.module @entry_kernel {
+    gpu.func @entry_kernel(%arg0: memref<8x8xf32>) kernel attributes {known_block_size = array<i32: 1, 1, 1>, known_grid_size = array<i32: 1, 1, 1>} {
+      gpu.return
+    }
+  }
+}
+
+// The returned buffer outlives the function, it is copied as before.
+// CHECK-LABEL: @alloc_returned(
+// CHECK-DAG: %[[HOST:.+]] = memref.alloc
+// CHECK-DAG: %[[GPU:.+]] = gpu.alloc  ()
+// CHECK: gpu.memcpy  %[[GPU]], %[[HOST]]
+// CHECK: gpu.launch_func
+// CHECK: gpu.memcpy  %[[HOST]], %[[GPU]]
+// CHECK: return %[[HOST]]
@@ -0,0 +1,102 @@
+// RUN: tpp-opt %s -gpu-fuse-launches -split-input-file | FileCheck %s
+
+// RUN: tpp-opt %s -gpu-fuse-launches="max-blocks=1" -split-input-file | \
+// RUN: FileCheck %s --check-prefix=SHARED
+
+func.func @mlp(%arg0: memref<32x64xf32>, %arg1: memref<64x64xf32>,
+               %arg2: memref<32x64xf32>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c2 = arith.constant 2 : index
+  %c4 = arith.constant 4 : index
+  %c32 = arith.constant 32 : index
+  %c64 = arith.constant 64 : index
+  %cst = arith.constant 0.000000e+00 : f32
+  %act = memref.alloc() : memref<32x64xf32>
+  gpu.launch blocks(%bx, %by, %bz) in (%gx = %c2, %gy = %c1, %gz = %c1)
+             threads(%tx, %ty, %tz) in (%sx = %c32, %sy = %c1, %sz = %c1) {
+    %row = arith.muli %bx, %c32 : index
+    %i = arith.addi %row, %tx : index
+    scf.for %j = %c0 to %c64 step %c1 {
+      %0 = scf.for %k = %c0 to %c64 step %c1 iter_args(%acc = %cst) -> (f32) {
+        %1 = memref.load %arg0[%tx, %k] : memref<32x64xf32>
+        %2 = memref.load %arg1[%k, %j] : memref<64x64xf32>
+        %3 = arith.mulf %1, %2 : f32
+        %4 = arith.addf %acc, %3 : f32
+        scf.yield %4 : f32
+      }
+      memref.store %0, %act[%tx, %j] : memref<32x64xf32>
+    }
+    gpu.terminator
+  }
+  %out = memref.subview %arg2[0, 0] [32, 64] [1, 1]
+      : memref<32x64xf32> to memref<32x64xf32, strided<[64, 1]>>
+  gpu.launch blocks(%bx, %by, %bz) in (%gx = %c4, %gy = %c1, %gz = %c1)
+             threads(%tx, %ty, %tz) in (%sx = %c32, %sy = %c1, %sz = %c1) {
+    %col = arith.muli %bx, %c2 : index
+    scf.for %j = %c0 to %c2 step %c1 {
+      %k = arith.addi %col, %j : index
+      %0 = memref.load %act[%tx, %k] : memref<32x64xf32>
+      %1 = arith.maximumf %0, %cst : f32
+      memref.store %1, %out[%tx, %k] : memref<32x64xf32, strided<[64, 1]>>
+    }
+    gpu.terminator
+  }
+  memref.dealloc %act : memref<32x64xf32>
+  return
+}
+
+// CHECK-LABEL: func.func @mlp
+// CHECK: %[[ACT:.+]] = memref.alloc() : memref<32x64xf32>
+// CHECK: memref.subview
+// CHECK: %[[COUNTER:.+]] = memref.alloc() : memref<1xi32>
+// CHECK: gpu.launch blocks(%[[BX:[^,]+]],{{.*}} in (%{{[^ ]+}} = %[[GRID:[^,]+]],
+// CHECK: scf.for %[[B0:.+]] = %[[BX]] to %c2{{.*}} step %[[GRID]]
+// CHECK: memref.store {{.*}}, %[[ACT]]
+// CHECK: gpu.barrier
+// CHECK: scf.if
+// CHECK: memref.atomic_rmw addi {{.*}}, %[[COUNTER]]
+// CHECK: scf.while
+// CHECK: memref.atomic_rmw addi
+// CHECK: arith.cmpi ult
+// CHECK: gpu.barrier
+// CHECK: scf.for %[[B1:.+]] = %[[BX]] to %c4{{.*}} step %[[GRID]]
+// CHECK: memref.load %[[ACT]]
+// CHECK: gpu.terminator
+// CHECK-NOT: gpu.launch
+// CHECK: memref.dealloc %[[COUNTER]]
+
+// SHARED-LABEL: func.func @mlp
+// SHARED-NOT: memref.alloc()
+// SHARED: gpu.launch
+// SHARED-SAME: workgroup(%[[ACT:[^ ]+]] : memref<32x64xf32, #gpu.address_space<workgroup>>)
+// SHARED: memref.store {{.*}}, %[[ACT]]
+// SHARED-NOT: memref.atomic_rmw
+// SHARED: gpu.barrier
+// SHARED: memref.load %[[ACT]]
+// SHARED-NOT: gpu.launch
+// SHARED-NOT: memref.dealloc
+
+// -----
+
+// Launches with different block sizes are not fused.
+func.func @block_sizes(%arg0: memref<64xf32>) {
+  %c1 = arith.constant 1 : index
+  %c32 = arith.constant 32 : index
+  %c64 = arith.constant 64 : index
+  gpu.launch blocks(%bx, %by, %bz) in (%gx = %c1, %gy = %c1, %gz = %c1)
+             threads(%tx, %ty, %tz) in (%sx = %c32, %sy = %c1, %sz = %c1) {
+    %0 = memref.load %arg0[%tx] : memref<64xf32>
+    gpu.terminator
+  }
+  gpu.launch blocks(%bx, %by, %bz) in (%gx = %c1, %gy = %c1, %gz = %c1)
+             threads(%tx, %ty, %tz) in (%sx = %c64, %sy = %c1, %sz = %c1) {
+    %0 = memref.load %arg0[%tx] : memref<64xf32>
+    gpu.terminator
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @block_sizes
+// CHECK: gpu.launch
+// CHECK: gpu.launch
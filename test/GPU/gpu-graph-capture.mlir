@@ -0,0 +1,121 @@
+// RUN: tpp-opt %s -gpu-graph-capture -split-input-file | FileCheck %s
+
+// The launches of the function body are replayed from a graph, captured by
+// their first run. Its signature holds the buffers of the launches.
+module attributes {gpu.container_module} {
+  func.func @entry(%arg0: memref<8x8xf32>, %arg1: memref<8x8xf32>) {
+    %c1 = arith.constant 1 : index
+    %0 = gpu.wait async
+    %1 = gpu.launch_func async [%0] @kernels::@fill blocks in (%c1, %c1, %c1) threads in (%c1, %c1, %c1)
+        args(%arg0 : memref<8x8xf32>)
+    %c2 = arith.constant 2 : index
+    %2 = gpu.launch_func async [%1] @kernels::@copy blocks in (%c2, %c1, %c1) threads in (%c1, %c1, %c1)
+        args(%arg0 : memref<8x8xf32>, %arg1 : memref<8x8xf32>)
+    gpu.wait [%2]
+    return
+  }
+  gpu.module @kernels {
+    gpu.func @fill(%arg0: memref<8x8xf32>) kernel {
+      gpu.return
+    }
+    gpu.func @copy(%arg0: memref<8x8xf32>, %arg1: memref<8x8xf32>) kernel {
+      gpu.return
+    }
+  }
+}
+
+// CHECK-DAG: func.func private @tpp_cuda_graph_begin(!llvm.ptr, i64, memref<*xi64>) -> i1 attributes {llvm.emit_c_interface}
+// CHECK-DAG: func.func private @tpp_cuda_graph_end(!llvm.ptr, i64)
+// CHECK-LABEL: func.func @entry(
+// CHECK-SAME: %[[ARG0:.+]]: memref<8x8xf32>, %[[ARG1:.+]]: memref<8x8xf32>)
+// CHECK: %[[C2:.+]] = arith.constant 2 : index
+// CHECK: %[[PTR0:.+]] = memref.extract_aligned_pointer_as_index %[[ARG0]]
+// CHECK: %[[SIG0:.+]] = arith.index_cast %[[PTR0]] : index to i64
+// CHECK: memref.extract_aligned_pointer_as_index %[[ARG0]]
+// CHECK: %[[PTR2:.+]] = memref.extract_aligned_pointer_as_index %[[ARG1]]
+// CHECK: %[[SIG2:.+]] = arith.index_cast %[[PTR2]] : index to i64
+// CHECK: %[[SIG:.+]] = memref.alloca() : memref<3xi64>
+// CHECK: memref.store %[[SIG0]], %[[SIG]]
+// CHECK: memref.store %[[SIG2]], %[[SIG]]
+// CHECK: %[[SIG_ARG:.+]] = memref.cast %[[SIG]] : memref<3xi64> to memref<*xi64>
+// CHECK: %[[STREAM:.+]] = gpu.wait async
+// CHECK: %[[PTR:.+]] = builtin.unrealized_conversion_cast %[[STREAM]] : !gpu.async.token to !llvm.ptr
+// CHECK: %[[ID:.+]] = arith.constant 0 : i64
+// CHECK: %[[REPLAYED:.+]] = call @tpp_cuda_graph_begin(%[[PTR]], %[[ID]], %[[SIG_ARG]])
+// CHECK: cf.cond_br %[[REPLAYED]], ^[[DONE:bb[0-9]+]], ^[[CAPTURE:bb[0-9]+]]
+// CHECK: ^[[CAPTURE]]:
+// CHECK: %[[FILL:.+]] = gpu.launch_func async [%[[STREAM]]] @kernels::@fill
+// CHECK: gpu.launch_func async [%[[FILL]]] @kernels::@copy blocks in (%[[C2]],
+// CHECK: call @tpp_cuda_graph_end(%[[PTR]], %[[ID]])
+// CHECK: cf.br ^[[DONE]]
+// CHECK: ^[[DONE]]:
+// CHECK: gpu.wait [%[[STREAM]]]
+// CHECK-NEXT: return
+
+// -----
+
+// The dynamic sizes of the buffers are part of the signature.
+module attributes {gpu.container_module} {
+  func.func @dynamic(%arg0: memref<?x8xf32>, %n: index) {
+    %c1 = arith.constant 1 : index
+    %0 = gpu.wait async
+    %1 = gpu.launch_func async [%0] @kernels::@fill blocks in (%n, %c1, %c1) threads in (%c1, %c1, %c1)
+        args(%arg0 : memref<?x8xf32>)
+    %2 = gpu.launch_func async [%1] @kernels::@fill blocks in (%n, %c1, %c1) threads in (%c1, %c1, %c1)
+        args(%arg0 : memref<?x8xf32>)
+    gpu.wait [%2]
+    return
+  }
+  gpu.module @kernels {
+    gpu.func @fill(%arg0: memref<?x8xf32>) kernel {
+      gpu.return
+    }
+  }
+}
+
+// CHECK-LABEL: func.func @dynamic(
+// CHECK-SAME: %[[ARG0:.+]]: memref<?x8xf32>, %[[N:.+]]: index)
+// CHECK: arith.index_cast %[[N]] : index to i64
+// CHECK: memref.extract_aligned_pointer_as_index %[[ARG0]]
+// CHECK: memref.extract_strided_metadata %[[ARG0]]
+// CHECK: memref.alloca() : memref<14xi64>
+// CHECK: call @tpp_cuda_graph_begin(
+
+// -----
+
+// A single launch is not worth a graph, neither are the launches of a loop.
+module attributes {gpu.container_module} {
+  func.func @single(%arg0: memref<8x8xf32>) {
+    %c1 = arith.constant 1 : index
+    %0 = gpu.wait async
+    %1 = gpu.launch_func async [%0] @kernels::@fill blocks in (%c1, %c1, %c1) threads in (%c1, %c1, %c1)
+        args(%arg0 : memref<8x8xf32>)
+    gpu.wait [%1]
+    return
+  }
+  func.func @loop(%arg0: memref<8x8xf32>) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c4 = arith.constant 4 : index
+    scf.for %i = %c0 to %c4 step %c1 {
+      %0 = gpu.wait async
+      %1 = gpu.launch_func async [%0] @kernels::@fill blocks in (%c1, %c1, %c1) threads in (%c1, %c1, %c1)
+          args(%arg0 : memref<8x8xf32>)
+      %2 = gpu.launch_func async [%1] @kernels::@fill blocks in (%c1, %c1, %c1) threads in (%c1, %c1, %c1)
+          args(%arg0 : memref<8x8xf32>)
+      gpu.wait [%2]
+    }
+    return
+  }
+  gpu.module @kernels {
+    gpu.func @fill(%arg0: memref<8x8xf32>) kernel {
+      gpu.return
+    }
+  }
+}
+
+// CHECK-NOT: tpp_cuda_graph
+// CHECK-LABEL: func.func @single(
+// CHECK-NOT: tpp_cuda_graph
+// CHECK-LABEL: func.func @loop(
+// CHECK-NOT: tpp_cuda_graph
@@ -68,3 +68,44 @@ func.func @dense_constant(%arg0: memref<8x16xf16>, %arg1: memref<8x16xf16>) {
 // OUTLINED-LABEL: gpu.func @dense_constant_kernel
 // OUTLINED-DAG: arith.constant 0 : index
 // OUTLINED-DAG: arith.constant dense<0.000000e+00> : vector<8x16xf16>
+
+// -----
+
+memref.global "private" constant @__constant_16xf16 : memref<16xf16> = dense<1.000000e+00> {alignment = 64 : i64}
+memref.global "private" constant @__constant_4096xf16 : memref<4096xf16> = dense<1.000000e+00> {alignment = 64 : i64}
+
+func.func @small_global(%arg0: memref<8x16xf16>, %arg1: memref<8x16xf16>, %arg2: memref<4096xf16>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %0 = memref.get_global @__constant_16xf16 : memref<16xf16>
+  %1 = memref.expand_shape %0 [[0, 1]] output_shape [1, 16] : memref<16xf16> into memref<1x16xf16>
+  %2 = memref.get_global @__constant_4096xf16 : memref<4096xf16>
+  gpu.launch blocks(%arg3, %arg4, %arg5) in (%arg9 = %c1, %arg10 = %c1, %arg11 = %c1) threads(%arg6, %arg7, %arg8) in (%arg12 = %c1, %arg13 = %c1, %arg14 = %c1) {
+    %3 = vector.load %arg0[%c0, %c0] : memref<8x16xf16>, vector<16xf16>
+    %4 = vector.load %1[%c0, %c0] : memref<1x16xf16>, vector<16xf16>
+    %5 = vector.load %2[%c0] : memref<4096xf16>, vector<16xf16>
+    %6 = arith.addf %3, %4 : vector<16xf16>
+    %7 = arith.addf %6, %5 : vector<16xf16>
+    vector.store %7, %arg1[%c0, %c0] : memref<8x16xf16>, vector<16xf16>
+    gpu.terminator
+  }
+  return
+}
+
+// The small constant buffer is read inside the launch, the large one is
+// still passed to the kernel.
+// CHECK-LABEL: func.func @small_global
+// CHECK: %[[LARGE:.+]] = memref.get_global @__constant_4096xf16
+// CHECK: gpu.launch
+// CHECK-DAG: %[[SMALL:.+]] = memref.get_global @__constant_16xf16 : memref<16xf16>
+// CHECK-DAG: %[[VIEW:.+]] = memref.expand_shape %[[SMALL]]
+// CHECK-DAG: vector.load %[[VIEW]]
+// CHECK-DAG: vector.load %[[LARGE]]
+
+// OUTLINED-LABEL: func.func @small_global
+// OUTLINED: %[[LARGE:.+]] = memref.get_global @__constant_4096xf16
+// OUTLINED: gpu.launch_func{{.*}}%[[LARGE]] : memref<4096xf16>
+// OUTLINED: gpu.module
+// OUTLINED-LABEL: gpu.func @small_global_kernel
+// OUTLINED: memref.get_global @__constant_16xf16 : memref<16xf16>
+// OUTLINED: memref.global "private" constant @__constant_16xf16 : memref<16xf16>
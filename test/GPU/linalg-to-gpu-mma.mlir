@@ -0,0 +1,98 @@
+// RUN: tpp-opt %s -linalg-to-gpu-mma -split-input-file | FileCheck %s
+// RUN: tpp-opt %s -linalg-to-gpu-mma="stages=3" -split-input-file | FileCheck %s --check-prefix=STAGES
+
+func.func @matmul_tiles(%arg0: memref<64x32xf16>, %arg1: memref<32x64xf16>, %arg2: memref<64x64xf32>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c2 = arith.constant 2 : index
+  %c32 = arith.constant 32 : index
+  gpu.launch blocks(%bx, %by, %bz) in (%gx = %c1, %gy = %c1, %gz = %c1) threads(%tx, %ty, %tz) in (%sx = %c2, %sy = %c2, %sz = %c1) {
+    %m = arith.muli %tx, %c32 : index
+    %n = arith.muli %ty, %c32 : index
+    %a = memref.subview %arg0[%m, 0] [32, 32] [1, 1] : memref<64x32xf16> to memref<32x32xf16, strided<[32, 1], offset: ?>>
+    %b = memref.subview %arg1[0, %n] [32, 32] [1, 1] : memref<32x64xf16> to memref<32x32xf16, strided<[64, 1], offset: ?>>
+    %c = memref.subview %arg2[%m, %n] [32, 32] [1, 1] : memref<64x64xf32> to memref<32x32xf32, strided<[64, 1], offset: ?>>
+    linalg.matmul ins(%a, %b : memref<32x32xf16, strided<[32, 1], offset: ?>>, memref<32x32xf16, strided<[64, 1], offset: ?>>)
+                  outs(%c : memref<32x32xf32, strided<[64, 1], offset: ?>>)
+    gpu.terminator
+  }
+  return
+}
+
+// Each thread of the 2x2 block becomes a warp computing its 32x32 tile.
+// CHECK-LABEL: func.func @matmul_tiles
+// CHECK: %[[WIDE:.+]] = arith.constant 64 : index
+// CHECK: gpu.launch {{.*}} threads(%[[TX:.+]], %{{.+}}, %{{.+}}) in (%{{.+}} = %[[WIDE]]
+// CHECK: %[[LANES:.+]] = arith.constant 32 : index
+// CHECK: %[[WARP:.+]] = arith.divui %[[TX]], %[[LANES]]
+// CHECK: arith.muli %[[WARP]]
+// CHECK: %[[C:.+]] = memref.subview %arg2
+// CHECK: scf.for %[[ROW:.+]] =
+// CHECK: scf.for %[[COL:.+]] =
+// CHECK: %[[ACC:.+]] = gpu.subgroup_mma_load_matrix %[[C]][%[[ROW]], %[[COL]]] {leadDimension = 64 : index} {{.*}} -> !gpu.mma_matrix<16x16xf32, "COp">
+// CHECK: scf.for
+// CHECK: scf.for %[[K:.+]] =
+// CHECK: gpu.subgroup_mma_load_matrix {{.*}}[%[[ROW]], %[[K]]] {leadDimension = 32 : index} {{.*}} -> !gpu.mma_matrix<16x16xf16, "AOp">
+// CHECK: gpu.subgroup_mma_load_matrix {{.*}}[%[[K]], %[[COL]]] {leadDimension = 64 : index} {{.*}} -> !gpu.mma_matrix<16x16xf16, "BOp">
+// CHECK: gpu.subgroup_mma_compute
+// CHECK: gpu.subgroup_mma_store_matrix {{.*}}, %[[C]][%[[ROW]], %[[COL]]] {leadDimension = 64 : index}
+// CHECK-NOT: linalg.matmul
+
+// The inputs of each of the 4 warps go through 3 padded shared memory stages.
+// STAGES-LABEL: func.func @matmul_tiles
+// STAGES: gpu.launch
+// STAGES-SAME: workgroup(%[[SA:[a-z0-9_]+]] : memref<4x3x16x24xf16, #gpu.address_space<workgroup>>, %[[SB:[a-z0-9_]+]] : memref<4x3x16x24xf16, #gpu.address_space<workgroup>>)
+// STAGES: gpu.lane_id
+// STAGES: scf.for
+// STAGES: scf.for
+// STAGES: gpu.subgroup_mma_load_matrix {{.*}} -> !gpu.mma_matrix<16x16xf32, "COp">
+// STAGES-COUNT-2: nvgpu.device_async_create_group
+// STAGES: scf.for
+// STAGES: nvgpu.device_async_copy {{.*}}, %[[SA]]{{.*}}, 8
+// STAGES: nvgpu.device_async_copy {{.*}}, %[[SB]]{{.*}}, 8
+// STAGES: %[[GROUP:.+]] = nvgpu.device_async_create_group
+// STAGES: nvgpu.device_async_wait %[[GROUP]] {numGroups = 2 : i32}
+// STAGES: nvvm.bar.warp.sync
+// STAGES: gpu.subgroup_mma_load_matrix %[[SA]]{{.*}} {leadDimension = 24 : index}
+// STAGES: gpu.subgroup_mma_load_matrix %[[SB]]{{.*}} {leadDimension = 24 : index}
+// STAGES: gpu.subgroup_mma_compute
+// STAGES: nvvm.bar.warp.sync
+// STAGES: scf.yield
+// STAGES: gpu.subgroup_mma_store_matrix
+
+// -----
+
+// Other writes in the launch would be repeated by all the lanes.
+func.func @matmul_with_store(%arg0: memref<16x16xf16>, %arg1: memref<16x16xf16>, %arg2: memref<16x16xf16>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %cst = arith.constant 0.0 : f16
+  gpu.launch blocks(%bx, %by, %bz) in (%gx = %c1, %gy = %c1, %gz = %c1) threads(%tx, %ty, %tz) in (%sx = %c1, %sy = %c1, %sz = %c1) {
+    linalg.matmul ins(%arg0, %arg1 : memref<16x16xf16>, memref<16x16xf16>)
+                  outs(%arg2 : memref<16x16xf16>)
+    memref.store %cst, %arg2[%c0, %c0] : memref<16x16xf16>
+    gpu.terminator
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @matmul_with_store
+// CHECK-NOT: gpu.subgroup_mma
+// CHECK: linalg.matmul
+
+// -----
+
+// There are no WMMA fragments for f32 inputs.
+func.func @matmul_f32(%arg0: memref<16x16xf32>, %arg1: memref<16x16xf32>, %arg2: memref<16x16xf32>) {
+  %c1 = arith.constant 1 : index
+  gpu.launch blocks(%bx, %by, %bz) in (%gx = %c1, %gy = %c1, %gz = %c1) threads(%tx, %ty, %tz) in (%sx = %c1, %sy = %c1, %sz = %c1) {
+    linalg.matmul ins(%arg0, %arg1 : memref<16x16xf32>, memref<16x16xf32>)
+                  outs(%arg2 : memref<16x16xf32>)
+    gpu.terminator
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @matmul_f32
+// CHECK-NOT: gpu.subgroup_mma
+// CHECK: linalg.matmul
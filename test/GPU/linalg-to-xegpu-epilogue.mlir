@@ -0,0 +1,144 @@
+// RUN: tpp-opt %s -linalg-to-xegpu="dpas-tile=8,16,16 k-tile=16" -canonicalize -split-input-file | FileCheck %s
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d1)>
+
+func.func @matmul_bias_silu(%arg0: memref<8x16xf16>, %arg1: memref<16x16xf16>,
+    %arg2: memref<8x16xf32>, %arg3: memref<16xf32>) {
+  %c1 = arith.constant 1 : index
+  gpu.launch blocks(%arg4, %arg5, %arg6) in (%arg10 = %c1, %arg11 = %c1, %arg12 = %c1) threads(%arg7, %arg8, %arg9) in (%arg13 = %c1, %arg14 = %c1, %arg15 = %c1) {
+    linalg.matmul ins(%arg0, %arg1 : memref<8x16xf16>, memref<16x16xf16>)
+                  outs(%arg2 : memref<8x16xf32>)
+    linalg.generic {indexing_maps = [#map1, #map], iterator_types = ["parallel", "parallel"]}
+      ins(%arg3 : memref<16xf32>) outs(%arg2 : memref<8x16xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      %0 = arith.addf %in, %out : f32
+      linalg.yield %0 : f32
+    }
+    linalg.generic {indexing_maps = [#map], iterator_types = ["parallel", "parallel"]}
+      outs(%arg2 : memref<8x16xf32>) {
+    ^bb0(%out: f32):
+      %one = arith.constant 1.000000e+00 : f32
+      %0 = arith.negf %out : f32
+      %1 = math.exp %0 : f32
+      %2 = arith.addf %1, %one : f32
+      %3 = arith.divf %out, %2 : f32
+      linalg.yield %3 : f32
+    }
+    gpu.terminator
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @matmul_bias_silu
+// CHECK-SAME:  %[[A:.+]]: memref<8x16xf16>, %[[B:.+]]: memref<16x16xf16>, %[[C:.+]]: memref<8x16xf32>, %[[BIAS:.+]]: memref<16xf32>
+// CHECK-DAG: %[[ONE:.+]] = arith.constant dense<1.000000e+00> : vector<8x16xf32>
+// CHECK: %[[res:.+]]:3 = scf.for
+// CHECK:   xegpu.dpas
+// CHECK: }
+
+// The bias is loaded once and broadcast over the rows.
+// CHECK: %[[tBias:.+]] = xegpu.create_nd_tdesc %[[BIAS]]{{.*}}: memref<16xf32> -> !xegpu.tensor_desc<16xf32
+// CHECK: %[[vBias:.+]] = xegpu.load_nd %[[tBias]]{{.*}}-> vector<16xf32>
+// CHECK: %[[bias:.+]] = vector.broadcast %[[vBias]] : vector<16xf32> to vector<8x16xf32>
+// CHECK: %[[add:.+]] = arith.addf %[[bias]], %[[res]]#0 : vector<8x16xf32>
+
+// The activation is applied on the registers.
+// CHECK: %[[neg:.+]] = arith.negf %[[add]] : vector<8x16xf32>
+// CHECK: %[[exp:.+]] = math.exp %[[neg]] : vector<8x16xf32>
+// CHECK: %[[den:.+]] = arith.addf %[[exp]], %[[ONE]] : vector<8x16xf32>
+// CHECK: %[[silu:.+]] = arith.divf %[[add]], %[[den]] : vector<8x16xf32>
+
+// Only the final tile is stored.
+// CHECK: %[[rootC:.+]] = xegpu.create_nd_tdesc %[[C]]
+// CHECK: %[[tC:.+]] = xegpu.update_nd_offset %[[rootC]], [0, 0]
+// CHECK: xegpu.store_nd %[[silu]], %[[tC]]
+// CHECK-NOT: xegpu.store_nd
+// CHECK-NOT: linalg.generic
+// CHECK: gpu.terminator
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> ()>
+
+func.func @matmul_scale_residual_f16(%arg0: memref<8x16xf16>, %arg1: memref<16x16xf16>,
+    %arg2: memref<8x16xf32>, %arg3: memref<8x16xf16>, %arg4: f32) {
+  %c1 = arith.constant 1 : index
+  gpu.launch blocks(%arg5, %arg6, %arg7) in (%arg11 = %c1, %arg12 = %c1, %arg13 = %c1) threads(%arg8, %arg9, %arg10) in (%arg14 = %c1, %arg15 = %c1, %arg16 = %c1) {
+    %alloc = memref.alloc() : memref<8x16xf32>
+    linalg.matmul ins(%arg0, %arg1 : memref<8x16xf16>, memref<16x16xf16>)
+                  outs(%alloc : memref<8x16xf32>)
+    linalg.generic {indexing_maps = [#map1, #map], iterator_types = ["parallel", "parallel"]}
+      ins(%arg4 : f32) outs(%alloc : memref<8x16xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      %0 = arith.mulf %in, %out : f32
+      linalg.yield %0 : f32
+    }
+    linalg.add ins(%alloc, %arg2 : memref<8x16xf32>, memref<8x16xf32>)
+               outs(%alloc : memref<8x16xf32>)
+    linalg.generic {indexing_maps = [#map, #map], iterator_types = ["parallel", "parallel"]}
+      ins(%alloc : memref<8x16xf32>) outs(%arg3 : memref<8x16xf16>) {
+    ^bb0(%in: f32, %out: f16):
+      %0 = arith.truncf %in : f32 to f16
+      linalg.yield %0 : f16
+    }
+    memref.dealloc %alloc : memref<8x16xf32>
+    gpu.terminator
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @matmul_scale_residual_f16
+// CHECK-SAME:  %[[A:.+]]: memref<8x16xf16>, %[[B:.+]]: memref<16x16xf16>, %[[RES:.+]]: memref<8x16xf32>, %[[OUT:.+]]: memref<8x16xf16>, %[[SCALE:.+]]: f32
+// CHECK: %[[alloc:.+]] = memref.alloc
+// CHECK: %[[res:.+]]:3 = scf.for
+// CHECK:   xegpu.dpas
+// CHECK: }
+// CHECK: %[[vScale:.+]] = vector.broadcast %[[SCALE]] : f32 to vector<8x16xf32>
+// CHECK: %[[scaled:.+]] = arith.mulf %[[vScale]], %[[res]]#0 : vector<8x16xf32>
+// CHECK: %[[rootRes:.+]] = xegpu.create_nd_tdesc %[[RES]]
+// CHECK: %[[tRes:.+]] = xegpu.update_nd_offset %[[rootRes]], [0, 0]
+// CHECK: %[[vRes:.+]] = xegpu.load_nd %[[tRes]]
+// CHECK: %[[sum:.+]] = arith.addf %[[scaled]], %[[vRes]] : vector<8x16xf32>
+// CHECK: %[[trunc:.+]] = arith.truncf %[[sum]] : vector<8x16xf32> to vector<8x16xf16>
+
+// The temporary accumulator is never stored.
+// CHECK-NOT: xegpu.store_nd
+// CHECK: %[[rootOut:.+]] = xegpu.create_nd_tdesc %[[OUT]]
+// CHECK: %[[tOut:.+]] = xegpu.update_nd_offset %[[rootOut]], [0, 0]
+// CHECK: xegpu.store_nd %[[trunc]], %[[tOut]]
+// CHECK-NOT: xegpu.store_nd
+// CHECK-NOT: linalg
+// CHECK: memref.dealloc %[[alloc]]
+// CHECK: gpu.terminator
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d1, d0)>
+
+// Transposed consumers are not fused.
+func.func @matmul_transposed_consumer(%arg0: memref<8x16xf16>, %arg1: memref<16x16xf16>,
+    %arg2: memref<16x16xf32>, %arg3: memref<16x16xf32>) {
+  %c1 = arith.constant 1 : index
+  gpu.launch blocks(%arg4, %arg5, %arg6) in (%arg10 = %c1, %arg11 = %c1, %arg12 = %c1) threads(%arg7, %arg8, %arg9) in (%arg13 = %c1, %arg14 = %c1, %arg15 = %c1) {
+    %0 = memref.subview %arg2[0, 0] [8, 16] [1, 1] : memref<16x16xf32> to memref<8x16xf32, strided<[16, 1]>>
+    linalg.matmul ins(%arg0, %arg1 : memref<8x16xf16>, memref<16x16xf16>)
+                  outs(%0 : memref<8x16xf32, strided<[16, 1]>>)
+    linalg.generic {indexing_maps = [#map1, #map], iterator_types = ["parallel", "parallel"]}
+      ins(%arg2 : memref<16x16xf32>) outs(%arg3 : memref<16x16xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      %1 = arith.addf %in, %out : f32
+      linalg.yield %1 : f32
+    }
+    gpu.terminator
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @matmul_transposed_consumer
+// CHECK: xegpu.dpas
+// CHECK: xegpu.store_nd
+// CHECK: linalg.generic
+// CHECK: gpu.terminator
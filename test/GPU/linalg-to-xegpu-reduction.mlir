@@ -0,0 +1,95 @@
+// RUN: tpp-opt %s -linalg-to-xegpu -canonicalize -split-input-file | FileCheck %s
+
+func.func @reduce_sum(%arg0: memref<16x32xf32>, %arg1: memref<16xf32>) {
+  linalg.reduce ins(%arg0 : memref<16x32xf32>) outs(%arg1 : memref<16xf32>) dimensions = [1]
+    (%in: f32, %init: f32) {
+      %0 = arith.addf %in, %init : f32
+      linalg.yield %0 : f32
+    }
+  return
+}
+
+// CHECK-LABEL: func.func @reduce_sum
+// CHECK-SAME:  %[[IN:.+]]: memref<16x32xf32>, %[[OUT:.+]]: memref<16xf32>
+// CHECK: %[[rootIn:.+]] = xegpu.create_nd_tdesc %[[IN]]
+// CHECK: %[[t0:.+]] = xegpu.update_nd_offset %[[rootIn]], [0, 0]
+// CHECK: %[[t1:.+]] = xegpu.update_nd_offset %[[rootIn]], [0, 16]
+// CHECK: %[[v0:.+]] = xegpu.load_nd %[[t0]]{{.*}}-> vector<16x16xf32>
+// CHECK: %[[v1:.+]] = xegpu.load_nd %[[t1]]{{.*}}-> vector<16x16xf32>
+// CHECK: %[[acc:.+]] = arith.addf %[[v1]], %[[v0]] : vector<16x16xf32>
+// CHECK: %[[tOut:.+]] = xegpu.create_nd_tdesc %[[OUT]]{{.*}}: memref<16xf32> -> !xegpu.tensor_desc<16xf32
+// CHECK: %[[init:.+]] = xegpu.load_nd %[[tOut]]{{.*}}-> vector<16xf32>
+// CHECK: %[[sum:.+]] = vector.multi_reduction <add>, %[[acc]], %[[init]] [1] : vector<16x16xf32> to vector<16xf32>
+// CHECK: xegpu.store_nd %[[sum]], %[[tOut]]
+// CHECK-NOT: linalg.reduce
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d0)>
+
+func.func @reduce_max(%arg0: memref<64x16xf16>, %arg1: memref<64xf16>) {
+  linalg.generic {indexing_maps = [#map, #map1], iterator_types = ["parallel", "reduction"]}
+    ins(%arg0 : memref<64x16xf16>) outs(%arg1 : memref<64xf16>) {
+  ^bb0(%in: f16, %out: f16):
+    %0 = arith.maximumf %in, %out : f16
+    linalg.yield %0 : f16
+  }
+  return
+}
+
+// One reduction per block of rows.
+// CHECK-LABEL: func.func @reduce_max
+// CHECK-COUNT-2: xegpu.load_nd{{.*}}-> vector<32x16xf16>
+// CHECK: xegpu.load_nd{{.*}}-> vector<32xf16>
+// CHECK: vector.multi_reduction <maximumf>, {{.*}} [1] : vector<32x16xf16> to vector<32xf16>
+// CHECK: xegpu.store_nd
+// CHECK: xegpu.load_nd{{.*}}-> vector<32xf16>
+// CHECK: vector.multi_reduction <maximumf>, {{.*}} [1] : vector<32x16xf16> to vector<32xf16>
+// CHECK: xegpu.store_nd
+// CHECK-NOT: linalg.generic
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d0)>
+
+// Softmax numerator, the row maxima are broadcast along the columns.
+func.func @sub_exp_rows(%arg0: memref<16x16xf32>, %arg1: memref<16xf32>, %arg2: memref<16x16xf32>) {
+  linalg.generic {indexing_maps = [#map, #map1, #map], iterator_types = ["parallel", "parallel"]}
+    ins(%arg0, %arg1 : memref<16x16xf32>, memref<16xf32>) outs(%arg2 : memref<16x16xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %0 = arith.subf %in, %in_0 : f32
+    %1 = math.exp %0 : f32
+    linalg.yield %1 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @sub_exp_rows
+// CHECK-SAME:  %[[IN:.+]]: memref<16x16xf32>, %[[MAX:.+]]: memref<16xf32>, %[[OUT:.+]]: memref<16x16xf32>
+// CHECK: %[[vIn:.+]] = xegpu.load_nd{{.*}}-> vector<16x16xf32>
+// CHECK: %[[tMax:.+]] = xegpu.create_nd_tdesc %[[MAX]]
+// CHECK: %[[vMax:.+]] = xegpu.load_nd %[[tMax]]{{.*}}-> vector<16xf32>
+// CHECK: %[[bcast:.+]] = vector.broadcast %[[vMax]] : vector<16xf32> to vector<16x16xf32>
+// CHECK: %[[rows:.+]] = vector.transpose %[[bcast]], [1, 0]
+// CHECK: %[[sub:.+]] = arith.subf %[[vIn]], %[[rows]] : vector<16x16xf32>
+// CHECK: %[[exp:.+]] = math.exp %[[sub]] : vector<16x16xf32>
+// CHECK: xegpu.store_nd %[[exp]]
+// CHECK-NOT: linalg.generic
+
+// -----
+
+// Reductions along the columns are not supported.
+func.func @reduce_columns(%arg0: memref<16x32xf32>, %arg1: memref<32xf32>) {
+  linalg.reduce ins(%arg0 : memref<16x32xf32>) outs(%arg1 : memref<32xf32>) dimensions = [0]
+    (%in: f32, %init: f32) {
+      %0 = arith.addf %in, %init : f32
+      linalg.yield %0 : f32
+    }
+  return
+}
+
+// CHECK-LABEL: func.func @reduce_columns
+// CHECK-NOT: xegpu
+// CHECK: linalg.reduce
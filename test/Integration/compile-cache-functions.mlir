@@ -0,0 +1,51 @@
+// RUN: rm -rf %t && mkdir -p %t && cp %s %t/input.mlir
+// RUN: tpp-run %t/input.mlir -e entry -entry-point-result=void \
+// RUN:  -emit=obj -emit-output=%t/kernel.o \
+// RUN:  -compile-cache=%t/cache -compile-cache-functions -print-compile-time \
+// RUN:  2>&1 | FileCheck %s -check-prefix=COLD
+// RUN: llvm-nm %t/kernel.o | FileCheck %s -check-prefix=SYMBOLS
+// RUN: ls %t/cache | FileCheck %s -check-prefix=CACHE
+
+// The second run reuses both functions.
+// RUN: tpp-run %t/input.mlir -e entry -entry-point-result=void \
+// RUN:  -emit=obj -emit-output=%t/kernel.o \
+// RUN:  -compile-cache=%t/cache -compile-cache-functions -print-compile-time \
+// RUN:  2>&1 | FileCheck %s -check-prefix=WARM
+
+// Changing the scale only recompiles its function. The input path is part of
+// the cache key, so the changed input replaces the original one.
+// RUN: sed 's/2.000000e+00/3.000000e+00/' %s > %t/input.mlir
+// RUN: tpp-run %t/input.mlir -e entry -entry-point-result=void \
+// RUN:  -emit=obj -emit-output=%t/kernel.o \
+// RUN:  -compile-cache=%t/cache -compile-cache-functions -print-compile-time \
+// RUN:  2>&1 | FileCheck %s -check-prefix=CHANGED
+// RUN: llvm-nm %t/kernel.o | FileCheck %s -check-prefix=SYMBOLS
+
+// COLD: Compile cache: 0 of 2 functions reused
+// WARM: Compile cache: 2 of 2 functions reused
+// CHANGED: Compile cache: 1 of 2 functions reused
+
+// SYMBOLS-DAG: T _mlir_ciface_entry
+// SYMBOLS-DAG: T entry
+// SYMBOLS-DAG: T scale
+
+// CACHE-COUNT-2: {{^[0-9a-f]+}}.bc
+// CACHE-NOT: .bc
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+
+func.func private @scale(%A: memref<4x4xf32>) {
+  %cst = arith.constant 2.000000e+00 : f32
+  linalg.generic {indexing_maps = [#map], iterator_types = ["parallel", "parallel"]}
+    outs(%A : memref<4x4xf32>) {
+  ^bb0(%out: f32):
+    %0 = arith.mulf %out, %cst : f32
+    linalg.yield %0 : f32
+  }
+  return
+}
+
+func.func @entry(%A: memref<4x4xf32>) {
+  call @scale(%A) : (memref<4x4xf32>) -> ()
+  return
+}
@@ -0,0 +1,23 @@
+// RUN: rm -rf %t
+// RUN: tpp-run %s -compile-cache=%t -print \
+// RUN:  -e entry -entry-point-result=void | \
+// RUN: FileCheck %s
+// RUN: ls %t | FileCheck %s -check-prefix=CACHE
+
+// The second run loads the cached module and must print the same result.
+// RUN: tpp-run %s -compile-cache=%t -print \
+// RUN:  -e entry -entry-point-result=void | \
+// RUN: FileCheck %s
+// RUN: ls %t | FileCheck %s -check-prefix=CACHE
+
+// CACHE-COUNT-1: {{^[0-9a-f]+}}.bc
+// CACHE-NOT: .bc
+
+func.func @entry(%A: tensor<4x8xf32>,
+                 %B: tensor<8x4xf32>, %C: tensor<4x4xf32>) -> tensor<4x4xf32> {
+  %D = linalg.matmul ins(%A, %B: tensor<4x8xf32>, tensor<8x4xf32>)
+                     outs(%C: tensor<4x4xf32>) -> tensor<4x4xf32>
+  return %D : tensor<4x4xf32>
+}
+
+// CHECK-COUNT-4: ( 9, 9, 9, 9 )
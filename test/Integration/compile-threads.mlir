@@ -0,0 +1,18 @@
+// RUN: tpp-run %s -compile-threads=2 -print \
+// RUN:  -e entry -entry-point-result=void | \
+// RUN: FileCheck %s
+
+// RUN: tpp-run %s -compile-threads=2 -print-compile-time \
+// RUN:  -e entry -entry-point-result=void 2>&1 | \
+// RUN: FileCheck %s -check-prefix=TIME
+
+func.func @entry(%A: tensor<4x8xf32>,
+                 %B: tensor<8x4xf32>, %C: tensor<4x4xf32>) -> tensor<4x4xf32> {
+  %D = linalg.matmul ins(%A, %B: tensor<4x8xf32>, tensor<8x4xf32>)
+                     outs(%C: tensor<4x4xf32>) -> tensor<4x4xf32>
+  return %D : tensor<4x4xf32>
+}
+
+// CHECK-COUNT-4: ( 9, 9, 9, 9 )
+
+// TIME: Compile time: MLIR {{[0-9.]+}}s, LLVM {{[0-9.]+}}s (2 threads)
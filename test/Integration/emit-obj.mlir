@@ -0,0 +1,15 @@
+// RUN: tpp-run %s -e entry -entry-point-result=void \
+// RUN:  -emit=obj -emit-output=%t.o
+// RUN: llvm-nm %t.o | FileCheck %s
+
+// The kernel is exported with its C interface, without the runner wrapper.
+// CHECK-DAG: T _mlir_ciface_entry
+// CHECK-DAG: T entry
+// CHECK-DAG: U xsmm_gemm_invoke
+
+func.func @entry(%A: tensor<4x8xf32>,
+                 %B: tensor<8x4xf32>, %C: tensor<4x4xf32>) -> tensor<4x4xf32> {
+  %D = linalg.matmul ins(%A, %B: tensor<4x8xf32>, tensor<8x4xf32>)
+                     outs(%C: tensor<4x4xf32>) -> tensor<4x4xf32>
+  return %D : tensor<4x4xf32>
+}
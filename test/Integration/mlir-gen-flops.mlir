@@ -26,6 +26,32 @@
 // RUN: mlir-gen --output=named --kernel=args --bias --relu --seed=0 --float-type=f32 --batch=128 --layers=1024,4096 --tiles=64,64,64 2>&1 | FileCheck %s --check-prefix=FC-LARGE-NAMED
 // RUN: mlir-gen --kernel=const --bias --relu --seed=0 --float-type=f32 --batch=128 --layers=1024,1024,1024 --tiles=64,64,64 2>&1 | FileCheck %s --check-prefix=MLP-LARGE
 // RUN: mlir-gen --output=named --kernel=const --bias --relu --seed=0 --float-type=f32 --batch=128 --layers=1024,1024,1024 --tiles=64,64,64 2>&1 | FileCheck %s --check-prefix=MLP-LARGE-NAMED
+// Matrix-vector
+// RUN: mlir-gen --kernel=args --seed=0 --float-type=f32 --gemv --layers=4096,4096 2>&1 | FileCheck %s --check-prefix=MATMUL-GEMV
+// RUN: mlir-gen --kernel=args --bias --relu --seed=0 --float-type=f32 --gemv --layers=4096,4096 2>&1 | FileCheck %s --check-prefix=FC-GEMV
+// Normalizations
+// RUN: mlir-gen --kernel=args --seed=0 --float-type=f32 --batch=128 --layers=1024,4096 --norm=layernorm 2>&1 | FileCheck %s --check-prefix=LAYERNORM
+// RUN: mlir-gen --kernel=args --seed=0 --float-type=f32 --batch=128 --layers=1024,4096 --norm=rmsnorm 2>&1 | FileCheck %s --check-prefix=RMSNORM
+// Sparse weights
+// RUN: mlir-gen --kernel=const --seed=0 --float-type=f32 --batch=128 --layers=1024,1024 --tiles=64,64,64 --weight-density=0.25 2>&1 | FileCheck %s --check-prefix=SPARSE
+// Embedding lookups
+// RUN: mlir-gen --kernel=args --seed=0 --float-type=f32 --batch=128 --layers=64,64 --embedding-rows=1000 --embedding-bag=4 2>&1 | FileCheck %s --check-prefix=EMBEDDING-BAG
+// RUN: mlir-gen --kernel=args --seed=0 --float-type=f32 --batch=128 --layers=64,64 --embedding-rows=1000 2>&1 | FileCheck %s --check-prefix=GATHER
+// Transformer blocks
+// RUN: mlir-gen --kernel=transformer --seed=0 --float-type=f32 --batch=2 --seq-len=4 --heads=2 --layers=8,16 2>&1 | FileCheck %s --check-prefix=TRANSFORMER
+// RUN: mlir-gen --output=named --kernel=transformer --bias --seed=0 --float-type=f32 --batch=2 --seq-len=4 --heads=2 --layers=8,16 2>&1 | FileCheck %s --check-prefix=TRANSFORMER-NAMED
+// RUN: mlir-gen --kernel=transformer --seed=0 --float-type=f32 --batch=2 --seq-len=4 --kv-len=8 --heads=2 --layers=8,16 2>&1 | FileCheck %s --check-prefix=TRANSFORMER-KV
+// Convolutions
+// RUN: mlir-gen --kernel=conv --batch-norm --relu --seed=0 --float-type=f32 --batch=1 --image=8,8 --layers=4,8 --conv-padding=1 2>&1 | FileCheck %s --check-prefix=CONV-NHWC
+// RUN: mlir-gen --kernel=conv --conv-layout=nchw --seed=0 --float-type=f32 --batch=1 --image=8,8 --layers=4,8 --conv-stride=2 2>&1 | FileCheck %s --check-prefix=CONV-NCHW
+// RUN: mlir-gen --kernel=conv --depthwise --relu --seed=0 --float-type=f32 --batch=1 --image=8,8 --layers=4,4 --conv-padding=1 2>&1 | FileCheck %s --check-prefix=CONV-DEPTHWISE
+// RUN: mlir-gen --kernel=conv --conv-block=basic --seed=0 --float-type=f32 --batch=1 --image=8,8 --layers=4,4 2>&1 | FileCheck %s --check-prefix=RESNET-BASIC
+// RUN: mlir-gen --kernel=conv --conv-block=basic --conv-stride=2 --seed=0 --float-type=f32 --batch=1 --image=8,8 --layers=4,8 2>&1 | FileCheck %s --check-prefix=RESNET-DOWNSAMPLE
+// RUN: mlir-gen --output=named --kernel=conv --conv-block=bottleneck --seed=0 --float-type=f32 --batch=1 --image=8,8 --layers=16,16 2>&1 | FileCheck %s --check-prefix=RESNET-BOTTLENECK
+// RUN: mlir-gen --kernel=mlp-train --bias --relu --seed=0 --float-type=f32 --batch=8 --layers=4,8,16 2>&1 | FileCheck %s --check-prefix=MLP-TRAIN
+
+// RUN: mlir-gen --kernel=args --bias --relu --dynamic-batch --seed=0 --float-type=f32 --batch=8 --layers=4,16 2>&1 | FileCheck %s --check-prefix=FC-DYNAMIC
+// RUN: mlir-gen --output=named --kernel=const --bias --relu --dynamic-batch --seed=0 --float-type=f32 --batch=8 --layers=4,8,16 2>&1 | FileCheck %s --check-prefix=MLP-DYNAMIC-NAMED
 
 // Validate that flops are computed correctly
 // MATMUL-UNIT: // BENCH_TOTAL_FLOPS: 2
@@ -48,3 +74,96 @@
 // FC-LARGE-NAMED: // BENCH_TOTAL_FLOPS: 1074790400
 // MLP-LARGE: // BENCH_TOTAL_FLOPS: 537395200
 // MLP-LARGE-NAMED: // BENCH_TOTAL_FLOPS: 537395200
+
+// MATMUL-GEMV: // BENCH_TOTAL_FLOPS: 33554432
+// MATMUL-GEMV: func.func @entry(%arg0: tensor<1x4096xf32>, %arg1: tensor<4096x4096xf32>, %arg2: tensor<1x4096xf32>) -> tensor<1x4096xf32>
+// FC-GEMV: // BENCH_TOTAL_FLOPS: 33562624
+
+// LAYERNORM: // BENCH_TOTAL_FLOPS: 1077936128
+// LAYERNORM-COUNT-2: iterator_types = ["parallel", "reduction"]
+// LAYERNORM: math.rsqrt
+// RMSNORM: // BENCH_TOTAL_FLOPS: 1075838976
+// RMSNORM-COUNT-1: iterator_types = ["parallel", "reduction"]
+// RMSNORM: math.rsqrt
+
+// SPARSE: // BENCH_TOTAL_FLOPS: 67108864
+
+// EMBEDDING-BAG: // BENCH_TOTAL_FLOPS: 1081344
+// EMBEDDING-BAG: func.func @entry(%[[TABLE:.+]]: tensor<1000x64xf32>
+// EMBEDDING-BAG: arith.constant dense<{{.+}}> : tensor<128x4xi64>
+// EMBEDDING-BAG: iterator_types = ["parallel", "reduction", "parallel"]
+// EMBEDDING-BAG: tensor.extract %[[TABLE]]
+// GATHER: // BENCH_TOTAL_FLOPS: 1048576
+// GATHER: arith.constant dense<{{.+}}> : tensor<128xi64>
+// GATHER: iterator_types = ["parallel", "parallel"]
+// GATHER: tensor.extract
+
+// TRANSFORMER: // BENCH_TOTAL_FLOPS: 11840
+// TRANSFORMER: func.func @entry(%{{.+}}: tensor<8x8xf32>) -> tensor<8x8xf32>
+// TRANSFORMER-COUNT-3: tensor.expand_shape {{.+}} : tensor<8x8xf32> into tensor<2x4x2x4xf32>
+// TRANSFORMER: iterator_types = ["parallel", "parallel", "parallel", "parallel", "reduction"]
+// TRANSFORMER: math.exp
+// TRANSFORMER: iterator_types = ["parallel", "parallel", "parallel", "parallel", "reduction"]
+// TRANSFORMER: tensor.collapse_shape {{.+}} : tensor<2x4x2x4xf32> into tensor<8x8xf32>
+// TRANSFORMER: math.rsqrt
+// TRANSFORMER: math.tanh
+// TRANSFORMER: math.rsqrt
+// TRANSFORMER-NAMED: // BENCH_TOTAL_FLOPS: 12288
+// TRANSFORMER-NAMED-COUNT-4: linalg.matmul
+// TRANSFORMER-NAMED-COUNT-2: linalg.add
+// TRANSFORMER-NAMED: math.rsqrt
+// TRANSFORMER-NAMED: linalg.matmul
+// TRANSFORMER-NAMED: math.tanh
+// TRANSFORMER-KV: // BENCH_TOTAL_FLOPS: 13184
+// TRANSFORMER-KV: func.func @entry(%{{.+}}: tensor<8x8xf32>, %[[KEYS:.+]]: tensor<2x8x8xf32>, %[[VALUES:.+]]: tensor<2x8x8xf32>) -> tensor<8x8xf32>
+// TRANSFORMER-KV: tensor.insert_slice %{{.+}} into %[[KEYS]][0, 4, 0] [2, 4, 8] [1, 1, 1] : tensor<2x4x8xf32> into tensor<2x8x8xf32>
+// TRANSFORMER-KV: tensor.insert_slice %{{.+}} into %[[VALUES]][0, 4, 0] [2, 4, 8] [1, 1, 1] : tensor<2x4x8xf32> into tensor<2x8x8xf32>
+// TRANSFORMER-KV: tensor.collapse_shape {{.+}} : tensor<2x8x8xf32> into tensor<16x8xf32>
+// TRANSFORMER-KV: linalg.generic {{.+}} outs(%{{.+}} : tensor<2x2x4x8xf32>)
+
+// CONV-NHWC: // BENCH_TOTAL_FLOPS: 38400
+// CONV-NHWC: func.func @entry(%{{.+}}: tensor<1x8x8x4xf32>) -> tensor<1x8x8x8xf32>
+// CONV-NHWC: tensor.pad
+// CONV-NHWC: linalg.conv_2d_nhwc_hwcf {dilations = dense<1> : vector<2xi64>, strides = dense<1> : vector<2xi64>}
+// CONV-NHWC-SAME: ins(%{{.+}}, %{{.+}} : tensor<1x10x10x4xf32>, tensor<3x3x4x8xf32>)
+// CONV-NHWC: arith.mulf
+// CONV-NHWC: arith.addf
+// CONV-NHWC: arith.maximumf
+// CONV-NCHW: // BENCH_TOTAL_FLOPS: 5184
+// CONV-NCHW: func.func @entry(%{{.+}}: tensor<1x4x8x8xf32>) -> tensor<1x8x3x3xf32>
+// CONV-NCHW: linalg.conv_2d_nchw_fchw {dilations = dense<1> : vector<2xi64>, strides = dense<2> : vector<2xi64>}
+// CONV-DEPTHWISE: // BENCH_TOTAL_FLOPS: 4864
+// CONV-DEPTHWISE: linalg.depthwise_conv_2d_nhwc_hwc
+// CONV-DEPTHWISE-SAME: tensor<3x3x4xf32>
+// RESNET-BASIC: // BENCH_TOTAL_FLOPS: 38656
+// RESNET-BASIC-COUNT-2: linalg.conv_2d_nhwc_hwcf
+// RESNET-BASIC: arith.addf
+// RESNET-BASIC: arith.maximumf
+// RESNET-DOWNSAMPLE: // BENCH_TOTAL_FLOPS: 29824
+// RESNET-DOWNSAMPLE: func.func @entry(%{{.+}}: tensor<1x8x8x4xf32>) -> tensor<1x4x4x8xf32>
+// RESNET-DOWNSAMPLE-COUNT-3: linalg.conv_2d_nhwc_hwcf
+// RESNET-BOTTLENECK: // BENCH_TOTAL_FLOPS: 40448
+// RESNET-BOTTLENECK: linalg.conv_2d_nhwc_hwcf {{.+}} tensor<1x8x8x16xf32>, tensor<1x1x16x4xf32>
+// RESNET-BOTTLENECK: linalg.conv_2d_nhwc_hwcf {{.+}} tensor<1x10x10x4xf32>, tensor<3x3x4x4xf32>
+// RESNET-BOTTLENECK: linalg.conv_2d_nhwc_hwcf {{.+}} tensor<1x8x8x4xf32>, tensor<1x1x4x16xf32>
+// RESNET-BOTTLENECK: linalg.add
+// RESNET-BOTTLENECK: linalg.max
+
+// MLP-TRAIN: // BENCH_TOTAL_FLOPS: 8448
+// MLP-TRAIN: func.func @entry(%{{.+}}: tensor<8x4xf32>, %{{.+}}: tensor<8x16xf32>, %{{.+}}: tensor<4x8xf32>, %{{.+}}: memref<4x8xf32>, %{{.+}}: tensor<8xf32>, %{{.+}}: memref<8xf32>, %{{.+}}: tensor<8x16xf32>, %{{.+}}: memref<8x16xf32>, %{{.+}}: tensor<16xf32>, %{{.+}}: memref<16xf32>) -> tensor<8x4xf32>
+// MLP-TRAIN-COUNT-2: arith.maximumf
+// MLP-TRAIN: arith.cmpf ogt
+// MLP-TRAIN: linalg.matmul_transpose_a {{.+}} outs(%{{.+}} : tensor<8x16xf32>)
+// MLP-TRAIN: linalg.reduce {{.+}} dimensions = [0]
+// MLP-TRAIN: linalg.matmul_transpose_b {{.+}} outs(%{{.+}} : tensor<8x8xf32>)
+// MLP-TRAIN: arith.cmpf ogt
+// MLP-TRAIN: linalg.matmul_transpose_a {{.+}} outs(%{{.+}} : tensor<4x8xf32>)
+// MLP-TRAIN: linalg.matmul_transpose_b {{.+}} outs(%{{.+}} : tensor<8x4xf32>)
+
+// FC-DYNAMIC: // RUN:  -e entry -entry-point-result=void -dynamic-sizes=8
+// FC-DYNAMIC: // BENCH_TOTAL_FLOPS: 1280
+// FC-DYNAMIC: func.func @entry(%{{.+}}: tensor<?x4xf32>, %{{.+}}: tensor<4x16xf32>, %{{.+}}: tensor<16xf32>, %{{.+}}: tensor<?x16xf32>) -> tensor<?x16xf32>
+// MLP-DYNAMIC-NAMED: // BENCH_TOTAL_FLOPS: 2944
+// MLP-DYNAMIC-NAMED: func.func @entry(%[[ARG:.+]]: tensor<?x4xf32>) -> tensor<?x16xf32>
+// MLP-DYNAMIC-NAMED: %[[BATCH:.+]] = tensor.dim %[[ARG]], %{{.+}} : tensor<?x4xf32>
+// MLP-DYNAMIC-NAMED: tensor.empty(%[[BATCH]]) : tensor<?x8xf32>
@@ -1,6 +1,7 @@
 // RUN: mlir-gen --kernel=args --seed=0 --float-type=f32 --batch=128 --layers=2304,768 --tiles=64,48,64 2>&1 | FileCheck %s --check-prefix=FP32
 // RUN: mlir-gen --kernel=args --seed=0 --float-type=bf16 --batch=128 --layers=2304,768 --tiles=64,48,64 2>&1 | FileCheck %s --check-prefix=BF16
 // RUN: mlir-gen --kernel=args --seed=0 --float-type=f16 --batch=128 --layers=2304,768 --tiles=64,48,64 2>&1 | FileCheck %s --check-prefix=FP16
+// RUN: mlir-gen --kernel=args --seed=0 --float-type=i8 --batch=128 --layers=2304,768 --tiles=64,48,64 2>&1 | FileCheck %s --check-prefix=I8
 
 // FP32: // RUN{{.*}}tpp-run %s -n {{\d*}}
 // FP32: // RUN{{.*}}-e entry -entry-point-result=void
@@ -40,3 +41,18 @@
 // FP16:         arith.mulf
 // FP16:         arith.addf
 // FP16-NOT: dealloc
+
+// I8: // RUN{{.*}}tpp-run %s -n {{\d*}}
+// I8: // RUN{{.*}}-e entry -entry-point-result=void
+// I8: // BENCH_TOTAL_FLOPS: 452984832
+// I8-DAG: #map = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d2, d3, d5)>
+// I8-DAG: #map1 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d1, d2, d5, d4)>
+// I8-DAG: #map2 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d1, d3, d4)>
+// I8:     func.func @entry(%arg0: tensor<2x36x64x64xi8>, %arg1: tensor<16x36x64x48xi8>, %arg2: tensor<2x16x64x48xi32>) -> tensor<2x16x64x48xi32>
+// I8-NOT: alloc
+// I8:     linalg.generic {{.*}}iterator_types = ["parallel", "parallel", "reduction", "parallel", "parallel", "reduction"]
+// I8:         arith.extsi
+// I8:         arith.extsi
+// I8:         arith.muli
+// I8:         arith.addi
+// I8-NOT: dealloc
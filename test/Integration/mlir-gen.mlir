@@ -1,8 +1,7 @@
 // MLP with Softmax version
 // RUN: mlir-gen --kernel=const --bias --relu --seed=123 --batch=10 --layers=10,10,10 --softmax | tpp-run -e entry -entry-point-result=void
-// RUN: not --crash mlir-gen --output=named --kernel=const --bias --relu --seed=123 --batch=10 --layers=10,10,10 --softmax 2>&1 | FileCheck %s --check-prefix=SOFTMAX-TODO
-// SOFTMAX-TODO: Linalg named ops for softmax not implemented yet
-// SOFTMAX-TODO: UNREACHABLE executed
+// RUN: mlir-gen --output=named --kernel=const --bias --relu --seed=123 --batch=10 --layers=10,10,10 --softmax | tpp-run -e entry -entry-point-result=void
+// RUN: mlir-gen --output=named --kernel=const --bias --relu --seed=123 --batch=10 --layers=10,10,10 --softmax | FileCheck %s --check-prefix=SOFTMAX-NAMED
 
 // MLP without softmax
 // RUN: mlir-gen --kernel=const --bias --relu --seed=123 --batch=10 --layers=10,10,10 | tpp-run -e entry -entry-point-result=void
@@ -19,9 +18,37 @@
 // Kernel - fc
 // RUN: mlir-gen --kernel=args --bias --relu --seed=123 --float-type=f32 --batch=10 --layers=10,10 | tpp-run -e entry -entry-point-result=void -print | FileCheck %s --check-prefix=GEN-FC
 
+// Embedding lookups
+// RUN: mlir-gen --kernel=const --bias --relu --seed=123 --batch=10 --layers=10,10 --embedding-rows=100 --embedding-bag=4 | tpp-run -e entry -entry-point-result=void
+// RUN: mlir-gen --kernel=args --seed=123 --batch=10 --layers=10,10 --embedding-rows=100 | tpp-run -e entry -entry-point-result=void
+
+// Transformer blocks
+// RUN: mlir-gen --kernel=transformer --bias --seed=123 --batch=2 --seq-len=8 --heads=2 --layers=16,32 | tpp-run -e entry -entry-point-result=void
+// RUN: mlir-gen --output=named --kernel=transformer --bias --seed=123 --batch=2 --seq-len=8 --heads=2 --layers=16,32 | tpp-run -e entry -entry-point-result=void
+// RUN: mlir-gen --kernel=transformer --seed=123 --batch=2 --seq-len=1 --kv-len=16 --heads=2 --layers=16,32 | tpp-run -e entry -entry-point-result=void
+// RUN: mlir-gen --kernel=transformer --seed=123 --batch=2 --seq-len=1 --kv-len=16 --kv-capacity=32 --heads=2 --layers=16,32 | tpp-run -e entry -entry-point-result=void
+// RUN: mlir-gen --kernel=transformer --seed=123 --batch=2 --seq-len=1 --kv-len=16 --heads=2 --layers=16,32 --output=named | tpp-run -e entry -entry-point-result=void --fuse-attention --attention-kv-split=4
+
+// Convolutions
+// RUN: mlir-gen --kernel=conv --batch-norm --relu --seed=123 --batch=2 --image=8,8 --layers=4,8,8 --conv-padding=1 | tpp-run -e entry -entry-point-result=void
+// RUN: mlir-gen --kernel=conv --conv-layout=nchw --relu --seed=123 --batch=2 --image=8,8 --layers=4,8 --conv-stride=2 | tpp-run -e entry -entry-point-result=void
+// RUN: mlir-gen --kernel=conv --conv-block=bottleneck --conv-stride=2 --seed=123 --batch=2 --image=8,8 --layers=16,16,32 | tpp-run -e entry -entry-point-result=void
+
+// Training steps
+// RUN: mlir-gen --kernel=mlp-train --bias --relu --seed=123 --batch=16 --layers=16,32,16 | tpp-run -e entry -entry-point-result=void
+// RUN: mlir-gen --output=named --kernel=mlp-train --bias --relu --seed=123 --batch=16 --layers=16,32,16 | tpp-run -e entry -entry-point-result=void
+
+// Dynamic batch
+// RUN: mlir-gen --kernel=const --bias --relu --dynamic-batch --seed=123 --batch=10 --layers=10,10,10 | tpp-run -e entry -entry-point-result=void -dynamic-sizes=10
+// RUN: mlir-gen --output=named --kernel=args --bias --relu --dynamic-batch --seed=123 --batch=10 --layers=10,10 | tpp-run -e entry -entry-point-result=void -dynamic-sizes=7 -print
+
 // Packed versions
 // RUN: mlir-gen --kernel=const --bias --relu --seed=123 --batch=10 --layers=10,10 --tiles=2,2,2 | tpp-run -e entry -entry-point-result=void -n 10 | FileCheck %s --check-prefix=PERF
 // RUN: mlir-gen --kernel=const --bias --relu --seed=123 --batch=10 --layers=10,10,10 --tiles=2,2,2 | tpp-run -e entry -entry-point-result=void -n 10 | FileCheck %s --check-prefix=PERF
+// RUN: mlir-gen --kernel=args --bias --relu --seed=123 --batch=10 --layers=10,10,10 --tiles=2,2,2 | tpp-run -e entry -entry-point-result=void -n 10 -validate | FileCheck %s --check-prefix=PERF
+
+// SOFTMAX-NAMED-LABEL: @entry
+// SOFTMAX-NAMED: linalg.softmax dimension(1) ins(%{{.+}} : tensor<10x10xf32>) outs(%{{.+}} : tensor<10x10xf32>) -> tensor<10x10xf32>
 
 // CONSTANT:( 11, 11, 11, 11, 11, 11, 11, 11, 11, 11 )
 
@@ -0,0 +1,31 @@
+// RUN: tpp-opt %s -convert-linalg-to-func | tpp-run  \
+// RUN:  -e entry -entry-point-result=void -print | \
+// RUN: FileCheck %s
+
+#map = affine_map<(d0, d1) -> (d1)>
+#map1 = affine_map<(d0, d1) -> (d0, d1)>
+
+func.func @entry(%arg0: memref<16x16xf32>, %arg1: memref<16x16xf32>, %arg2: memref<16xf32>, %arg3: memref<16x16xf32>) -> memref<16x16xf32> {
+  %cst = arith.constant 0.0 : f32
+  linalg.matmul ins(%arg0, %arg1 : memref<16x16xf32>, memref<16x16xf32>)
+                outs(%arg3: memref<16x16xf32>)
+  linalg.generic {
+    indexing_maps = [#map, #map1],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg2 : memref<16xf32>) outs(%arg3 : memref<16x16xf32>) {
+      ^bb0(%in: f32, %out: f32):
+        %0 = arith.addf %in, %out : f32
+        linalg.yield %0 : f32
+  }
+  linalg.generic {
+    indexing_maps = [#map1],
+    iterator_types = ["parallel", "parallel"]}
+    outs(%arg3 : memref<16x16xf32>) {
+      ^bb0(%out: f32):
+        %0 = arith.maximumf %out, %cst : f32
+        linalg.yield %0 : f32
+  }
+  return %arg3 : memref<16x16xf32>
+}
+
+// CHECK-COUNT-16: ( 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18, 18 )
@@ -0,0 +1,18 @@
+// RUN: env TPP_TRACE=%t.json TPP_TRACE_XSMM_SAMPLE=1 tpp-run %s \
+// RUN:  -e entry -entry-point-result=void
+// RUN: FileCheck %s < %t.json
+
+func.func @entry(%A: tensor<4x8x32xf32>, %B: tensor<4x32x16xf32>,
+                 %C: tensor<8x16xf32>) -> tensor<8x16xf32> {
+  perf.trace_begin {label = "brgemm"}
+  %D = linalg.batch_reduce_matmul ins(%A, %B: tensor<4x8x32xf32>, tensor<4x32x16xf32>)
+                                  outs(%C: tensor<8x16xf32>) -> tensor<8x16xf32>
+  perf.trace_end
+  return %D : tensor<8x16xf32>
+}
+
+// CHECK: {"traceEvents":[
+// CHECK-DAG: {"name":"thread_name","ph":"M",{{.*}}"tid":0
+// CHECK-DAG: {"name":"brgemm","cat":"xsmm","ph":"X",{{.*}}"args":{"detail":"dtype=1 M=8 N=16 K=32
+// CHECK-DAG: {"name":"brgemm","cat":"perf","ph":"X"
+// CHECK: ],"displayTimeUnit":"ns"}
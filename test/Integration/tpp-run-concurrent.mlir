@@ -0,0 +1,26 @@
+// RUN: tpp-run %s -concurrent-kernels=2 -n 2 -def-parallel \
+// RUN:  -parallel-runtime=tasks -e entry -entry-point-result=void | \
+// RUN: FileCheck %s
+
+// RUN: not tpp-run %s -concurrent-kernels=2 -def-parallel \
+// RUN:  -e entry -entry-point-result=void 2>&1 | \
+// RUN: FileCheck %s --check-prefix=OMP
+
+// RUN: not tpp-run %s -concurrent-kernels=2 -serve=%t.sock \
+// RUN:  -e entry -entry-point-result=void 2>&1 | \
+// RUN: FileCheck %s --check-prefix=SERVE
+
+func.func @entry(%A: tensor<64x64xf32>, %B: tensor<64x64xf32>,
+                 %C: tensor<64x64xf32>) -> tensor<64x64xf32> {
+  %D = linalg.matmul ins(%A, %B: tensor<64x64xf32>, tensor<64x64xf32>)
+                     outs(%C: tensor<64x64xf32>) -> tensor<64x64xf32>
+  return %D : tensor<64x64xf32>
+}
+
+// CHECK: serial: {{[0-9.]+}} kernels/s
+// CHECK: concurrent: {{[0-9.]+}} kernels/s (2 teams of
+// CHECK: speedup: {{[0-9.]+}}
+
+// OMP: thread teams, which require -parallel-runtime=tasks
+
+// SERVE: The concurrent benchmark takes a single kernel to run
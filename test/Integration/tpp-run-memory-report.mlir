@@ -0,0 +1,18 @@
+// RUN: tpp-run %s -n 10 -memory-report \
+// RUN:  -e entry -entry-point-result=void 2>&1 | \
+// RUN: FileCheck %s
+
+// The packed operands of the matmul are allocated in the kernel.
+func.func @entry(%A: tensor<64x64xf32>, %B: tensor<64x64xf32>,
+                 %C: tensor<64x64xf32>) -> tensor<64x64xf32> {
+  %D = linalg.matmul ins(%A, %B: tensor<64x64xf32>, tensor<64x64xf32>)
+                     outs(%C: tensor<64x64xf32>) -> tensor<64x64xf32>
+  return %D : tensor<64x64xf32>
+}
+
+// CHECK: Memory report:
+// CHECK-NEXT: compile: RSS {{[0-9.]+}} MiB, peak RSS {{[0-9.]+}} MiB
+// CHECK-NEXT: execute: RSS {{[0-9.]+}} MiB, peak RSS {{[0-9.]+}} MiB
+// CHECK-NEXT: kernel: {{[1-9][0-9]*}} calls, {{[0-9.]+}} allocs ({{[0-9.]+}} MiB) per call, peak {{[0-9.]+}} MiB
+// CHECK-NEXT: harness: {{[0-9]+}} allocs ({{[0-9.]+}} MiB)
+// CHECK-NEXT: heap: peak {{[0-9.]+}} MiB
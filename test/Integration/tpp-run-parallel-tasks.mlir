@@ -0,0 +1,31 @@
+// RUN: tpp-run %s -def-parallel -parallel-runtime=tasks -e entry -entry-point-result=void -print-mlir=late -print 2>&1 | \
+// RUN: FileCheck %s
+
+// RUN: env TPP_NUM_THREADS=3 tpp-run %s -def-parallel -parallel-runtime=tasks -e entry -entry-point-result=void -print 2>&1 | \
+// RUN: FileCheck %s --check-prefix=RESULT
+
+// RUN: env TPP_NUM_THREADS=3 tpp-run %s -def-parallel -parallel-runtime=tasks -parallel-task-grid=auto -e entry -entry-point-result=void -print 2>&1 | \
+// RUN: FileCheck %s --check-prefix=RESULT
+
+func.func @entry(%arg0: tensor<8x8xf32>) -> tensor<8x8xf32> {
+  %empty = tensor.empty() : tensor<8x8xf32>
+  %0 = scf.forall (%arg1, %arg2) = (0, 0) to (8, 8) step(1, 1)
+                                          shared_outs(%o = %empty) -> (tensor<8x8xf32>) {
+    %slice = tensor.extract_slice %arg0[%arg1, %arg2] [1, 1] [1, 1]
+      : tensor<8x8xf32> to tensor<1x1xf32>
+    scf.forall.in_parallel {
+      tensor.parallel_insert_slice %slice into %o[%arg1, %arg2] [1, 1] [1, 1]
+        : tensor<1x1xf32> into tensor<8x8xf32>
+    }
+  }
+  return %0 : tensor<8x8xf32>
+}
+
+// CHECK-LABEL: func.func private @_entry_task
+// CHECK: scf.for
+// CHECK-LABEL: func.func @_entry
+// CHECK-NOT: omp.parallel
+// CHECK: call @tpp_parallel_for
+
+// CHECK-COUNT-8: ( 1, 1, 1, 1, 1, 1, 1, 1 )
+// RESULT-COUNT-8: ( 1, 1, 1, 1, 1, 1, 1, 1 )
@@ -0,0 +1,22 @@
+// RUN: not tpp-run %s -serve=%t.sock -emit=obj \
+// RUN:  -e entry -entry-point-result=void 2>&1 | \
+// RUN: FileCheck %s --check-prefix=EMIT
+
+// RUN: not tpp-run %s -serve=%t.sock \
+// RUN:  -e dynamic -entry-point-result=void 2>&1 | \
+// RUN: FileCheck %s --check-prefix=DYNAMIC
+
+func.func @entry(%A: tensor<16x16xf32>, %B: tensor<16x16xf32>,
+                 %C: tensor<16x16xf32>) -> tensor<16x16xf32> {
+  %D = linalg.matmul ins(%A, %B: tensor<16x16xf32>, tensor<16x16xf32>)
+                     outs(%C: tensor<16x16xf32>) -> tensor<16x16xf32>
+  return %D : tensor<16x16xf32>
+}
+
+func.func @dynamic(%A: tensor<?x16xf32>) -> tensor<?x16xf32> {
+  return %A : tensor<?x16xf32>
+}
+
+// EMIT: The kernel server takes a single kernel to run
+
+// DYNAMIC: Unsupported kernel argument of type {{.*}}tensor<?x16xf32>
@@ -0,0 +1,25 @@
+// RUN: tpp-run %s -tensor-parallel=2 -e entry -entry-point-result=void -print | \
+// RUN: FileCheck %s
+
+// RUN: tpp-run %s -tensor-parallel=2 -tensor-parallel-mode=row -e entry -entry-point-result=void -print | \
+// RUN: FileCheck %s
+
+// RUN: tpp-run %s -tensor-parallel=4 -tensor-parallel-mode=row -e entry -entry-point-result=void -print | \
+// RUN: FileCheck %s
+
+func.func @entry(%arg0: tensor<4x8xf32>) -> tensor<4x4xf32> {
+  %weight = arith.constant dense<[[1.0, 2.0, 3.0, 4.0], [1.0, 2.0, 3.0, 4.0],
+                                  [1.0, 2.0, 3.0, 4.0], [1.0, 2.0, 3.0, 4.0],
+                                  [1.0, 2.0, 3.0, 4.0], [1.0, 2.0, 3.0, 4.0],
+                                  [1.0, 2.0, 3.0, 4.0], [1.0, 2.0, 3.0, 4.0]]>
+    : tensor<8x4xf32>
+  %cst = arith.constant 0.0 : f32
+  %empty = tensor.empty() : tensor<4x4xf32>
+  %zeros = linalg.fill ins(%cst : f32) outs(%empty : tensor<4x4xf32>) -> tensor<4x4xf32>
+  %0 = linalg.matmul ins(%arg0, %weight : tensor<4x8xf32>, tensor<8x4xf32>)
+                     outs(%zeros : tensor<4x4xf32>) -> tensor<4x4xf32>
+  return %0 : tensor<4x4xf32>
+}
+
+// The columns of the ranks are gathered, or their partial sums reduced.
+// CHECK-COUNT-4: ( 8, 16, 24, 32 )
@@ -0,0 +1,35 @@
+// RUN: env TPP_NUM_THREADS=2 OMP_NUM_THREADS=2 tpp-run %s -def-parallel -bind-threads=compact -print-thread-binding -e entry -entry-point-result=void -print 2>&1 | \
+// RUN: FileCheck %s
+
+// RUN: env TPP_NUM_THREADS=2 OMP_NUM_THREADS=2 tpp-run %s -def-parallel -parallel-runtime=tasks -bind-threads=scatter -bind-no-smt -print-thread-binding -e entry -entry-point-result=void -print 2>&1 | \
+// RUN: FileCheck %s --check-prefix=TASKS
+
+// RUN: not tpp-run %s -bind-threads=spread -e entry -entry-point-result=void 2>&1 | \
+// RUN: FileCheck %s --check-prefix=INVALID
+
+// RUN: not tpp-run %s -bind-no-smt -e entry -entry-point-result=void 2>&1 | \
+// RUN: FileCheck %s --check-prefix=NOPOLICY
+
+func.func @entry(%arg0: tensor<8x8xf32>) -> tensor<8x8xf32> {
+  %empty = tensor.empty() : tensor<8x8xf32>
+  %0 = scf.forall (%arg1, %arg2) = (0, 0) to (8, 8) step(1, 1)
+                                          shared_outs(%o = %empty) -> (tensor<8x8xf32>) {
+    %slice = tensor.extract_slice %arg0[%arg1, %arg2] [1, 1] [1, 1]
+      : tensor<8x8xf32> to tensor<1x1xf32>
+    scf.forall.in_parallel {
+      tensor.parallel_insert_slice %slice into %o[%arg1, %arg2] [1, 1] [1, 1]
+        : tensor<1x1xf32> into tensor<8x8xf32>
+    }
+  }
+  return %0 : tensor<8x8xf32>
+}
+
+// CHECK: Thread binding (compact): 0->{{[0-9]+}} 1->{{[0-9]+}}{{$}}
+// CHECK-COUNT-8: ( 1, 1, 1, 1, 1, 1, 1, 1 )
+
+// TASKS: Thread binding (scatter, no SMT): 0->{{[0-9]+}} 1->{{[0-9]+}}{{$}}
+// TASKS-COUNT-8: ( 1, 1, 1, 1, 1, 1, 1, 1 )
+
+// INVALID: Invalid thread binding spread
+
+// NOPOLICY: -bind-no-smt and -print-thread-binding require -bind-threads
@@ -0,0 +1,24 @@
+// The database entry of the kernel applies its block factors to the pipeline.
+// RUN: tpp-run %s -e entry -entry-point-result=void -print-tuning-key | \
+// RUN:  sed 's/.*/{"&": {"options": {"matmul-block-factors": "16,16,16"}}}/' > %t
+// RUN: tpp-run %s -e entry -entry-point-result=void -tuning-db=%t \
+// RUN:  -print-mlir=mid 2>&1 | FileCheck %s
+
+// Without the database, the default block factors apply.
+// RUN: tpp-run %s -e entry -entry-point-result=void -tuning-db= \
+// RUN:  -print-mlir=mid 2>&1 | FileCheck %s --check-prefix=DEFAULT
+
+func.func @entry(%A: tensor<128x128xf32>, %B: tensor<128x128xf32>,
+                 %C: tensor<128x128xf32>) -> tensor<128x128xf32> {
+  %D = linalg.matmul ins(%A, %B: tensor<128x128xf32>, tensor<128x128xf32>)
+                     outs(%C: tensor<128x128xf32>) -> tensor<128x128xf32>
+  return %D : tensor<128x128xf32>
+}
+
+// CHECK-LABEL: @_entry
+// CHECK: memref<8x8x16x16xf32>
+// CHECK-NOT: memref<4x4x32x32xf32>
+
+// DEFAULT-LABEL: @_entry
+// DEFAULT: memref<4x4x32x32xf32>
+// DEFAULT-NOT: memref<8x8x16x16xf32>
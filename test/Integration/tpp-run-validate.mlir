@@ -0,0 +1,31 @@
+// RUN: tpp-run %s -e entry -entry-point-result=void -validate -print -seed=123 | FileCheck %s
+// RUN: tpp-run %s -e entry -entry-point-result=void -validate -def-parallel -n 10 | FileCheck %s --check-prefix=BENCH
+// RUN: tpp-run %s -e entry -entry-point-result=void -validate -linalg-to-loops -print | FileCheck %s --check-prefix=LOOPS
+
+#map = affine_map<(d0, d1) -> (d1)>
+#map1 = affine_map<(d0, d1) -> (d0, d1)>
+
+func.func @entry(%arg0: tensor<64x128xf32>, %arg1: tensor<128x64xf32>,
+                 %arg2: tensor<64xf32>) -> tensor<64x64xf32> {
+  %cst = arith.constant 0.0 : f32
+  %0 = tensor.empty() : tensor<64x64xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<64x64xf32>) -> tensor<64x64xf32>
+  %2 = linalg.matmul ins(%arg0, %arg1 : tensor<64x128xf32>, tensor<128x64xf32>)
+                     outs(%1 : tensor<64x64xf32>) -> tensor<64x64xf32>
+  %3 = linalg.generic {indexing_maps = [#map, #map1],
+                       iterator_types = ["parallel", "parallel"]}
+    ins(%arg2 : tensor<64xf32>) outs(%2 : tensor<64x64xf32>) {
+  ^bb0(%in: f32, %out: f32):
+    %4 = arith.addf %in, %out : f32
+    %5 = arith.maximumf %4, %cst : f32
+    linalg.yield %5 : f32
+  } -> tensor<64x64xf32>
+  return %3 : tensor<64x64xf32>
+}
+
+// The optimized kernel matches its loops reference, the result is printed.
+// CHECK-COUNT-64: ( {{.+}} )
+
+// BENCH: {{[0-9]+}}{{.?}}{{[0-9e-]+}}
+
+// LOOPS-COUNT-64: ( {{.+}} )
@@ -0,0 +1,33 @@
+// RUN: tpp-run %s -print \
+// RUN:  -e entry -entry-point-result=void | \
+// RUN: FileCheck %s
+
+memref.global "private" constant @__constant_a : memref<2x4x4xi8> =
+  dense<[[[1, 1, 1, 1], [1, 1, 1, 1], [1, 1, 1, 1], [1, 1, 1, 1]],
+         [[2, 2, 2, 2], [2, 2, 2, 2], [2, 2, 2, 2], [2, 2, 2, 2]]]> {alignment = 64 : i64}
+memref.global "private" constant @__constant_b : memref<1x1x4x4xi8> = dense<1> {alignment = 64 : i64}
+// Group 0 reads the first A tile into the first C tile, group 1 the second
+// ones. The offsets are in elements of the i8 inputs and i32 output.
+memref.global "private" constant @__constant_descs : memref<2x3xi64> =
+  dense<[[0, 0, 0], [16, 0, 16]]> {alignment = 64 : i64}
+
+func.func @entry(%arg0: memref<2x4x4xi32>) -> memref<2x4x4xi32> {
+  %a = memref.get_global @__constant_a : memref<2x4x4xi8>
+  %b = memref.get_global @__constant_b : memref<1x1x4x4xi8>
+  %descs = memref.get_global @__constant_descs : memref<2x3xi64>
+  %zero = arith.constant 0 : i32
+  linalg.fill ins(%zero : i32) outs(%arg0 : memref<2x4x4xi32>)
+  // [4x4] * [4x4] -> [4x4], B in VNNI layout
+  // m = 4, n = 4, k = 4
+  // lda = 4, ldb = 4, ldc = 4
+  // stride_a = 16, stride_b = 16
+  %0 = xsmm.brgemm.dispatch [4, 4, 4, 4, 4, 4, 16, 16] flags = (vnni_b) data_type = i8
+  %c1 = arith.constant 1 : i64
+  xsmm.brgemm_grouped(data_type = i8, %0, %a, %b, %arg0, %descs, %c1)
+    : (i64, memref<2x4x4xi8>, memref<1x1x4x4xi8>, memref<2x4x4xi32>,
+       memref<2x3xi64>, i64) -> ()
+  return %arg0 : memref<2x4x4xi32>
+}
+
+// CHECK-COUNT-4: ( 4, 4, 4, 4 )
+// CHECK-COUNT-4: ( 8, 8, 8, 8 )
@@ -0,0 +1,20 @@
+// RUN: env TPP_XSMM_DISPATCH_CACHE_STATS=1 tpp-run %s -n 10 \
+// RUN:  -e entry -entry-point-result=void 2>&1 | \
+// RUN: FileCheck %s
+
+// RUN: env TPP_XSMM_DISPATCH_CACHE=0 TPP_XSMM_DISPATCH_CACHE_STATS=1 \
+// RUN:  tpp-run %s -n 10 -e entry -entry-point-result=void 2>&1 | \
+// RUN: FileCheck %s --check-prefix=DISABLED
+
+// The kernel re-dispatches the same brgemm on every call, only the first
+// dispatch should miss the cache.
+func.func @entry(%A: tensor<4x8x32xf32>, %B: tensor<4x32x16xf32>,
+                 %C: tensor<8x16xf32>) -> tensor<8x16xf32> {
+  %D = linalg.batch_reduce_matmul ins(%A, %B: tensor<4x8x32xf32>, tensor<4x32x16xf32>)
+                                  outs(%C: tensor<8x16xf32>) -> tensor<8x16xf32>
+  return %D : tensor<8x16xf32>
+}
+
+// CHECK: XSMM dispatch cache: {{[1-9][0-9]*}} hits, 1 misses, 1 kernels
+
+// DISABLED-NOT: XSMM dispatch cache
@@ -0,0 +1,23 @@
+// RUN: tpp-run %s -n 10 -e entry -entry-point-result=void \
+// RUN:  -profile-out=%t.json
+// RUN: FileCheck %s --input-file=%t.json
+
+// The profile of the run is fed back to the compilation.
+// RUN: tpp-run %s -n 10 -e entry -entry-point-result=void \
+// RUN:  -profile-in=%t.json
+
+// RUN: not tpp-run %s -e entry -entry-point-result=void -emit=obj \
+// RUN:  -profile-out=%t.json 2>&1 | \
+// RUN: FileCheck %s --check-prefix=EMIT
+
+func.func @entry(%A: tensor<4x8x32xf32>, %B: tensor<4x32x16xf32>,
+                 %C: tensor<8x16xf32>) -> tensor<8x16xf32> {
+  %D = linalg.batch_reduce_matmul ins(%A, %B: tensor<4x8x32xf32>, tensor<4x32x16xf32>)
+                                  outs(%C: tensor<8x16xf32>) -> tensor<8x16xf32>
+  return %D : tensor<8x16xf32>
+}
+
+// CHECK: "xsmm_kernels":[
+// CHECK-NEXT: {"kind":"brgemm","dtype":1,"m":8,"n":16,"k":32,"op":0,"flags":{{[0-9]+}},"calls":{{[1-9][0-9]*}},"batches":{{[1-9][0-9]*}},"seconds":{{[0-9.]+}},"gflops":{{[0-9.]+}}}
+
+// EMIT: The kernel profile is only available when running the kernel on CPUs
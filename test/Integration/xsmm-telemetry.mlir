@@ -0,0 +1,19 @@
+// RUN: env TPP_XSMM_TELEMETRY=1 tpp-run %s -n 10 \
+// RUN:  -e entry -entry-point-result=void 2>&1 | \
+// RUN: FileCheck %s
+
+// RUN: tpp-run %s -n 10 -e entry -entry-point-result=void 2>&1 | \
+// RUN: FileCheck %s --check-prefix=DISABLED
+
+func.func @entry(%A: tensor<4x8x32xf32>, %B: tensor<4x32x16xf32>,
+                 %C: tensor<8x16xf32>) -> tensor<8x16xf32> {
+  %D = linalg.batch_reduce_matmul ins(%A, %B: tensor<4x8x32xf32>, tensor<4x32x16xf32>)
+                                  outs(%C: tensor<8x16xf32>) -> tensor<8x16xf32>
+  return %D : tensor<8x16xf32>
+}
+
+// CHECK: XSMM kernel telemetry:
+// CHECK-NEXT: kind dtype M N K op flags calls cycles time (ms) GFLOP/s
+// CHECK-NEXT: brgemm 1 8 16 32 0 {{.+}} {{[1-9][0-9]*}} {{[0-9]+}} {{[0-9.]+}} {{[0-9.]+}}
+
+// DISABLED-NOT: XSMM kernel telemetry
@@ -21,7 +21,7 @@ func.func @check_dialect() {
 
 // CHECK-LABEL: func.func @check_dialect(
 // CHECK-NOT: check.expect_almost_eq
-// CHECK: scf.for
+// CHECK: scf.parallel
 
 // -----
 
@@ -0,0 +1,27 @@
+// RUN: tpp-opt %s -bufferize="report-copies" -split-input-file -verify-diagnostics | FileCheck %s
+
+// The argument is still returned after the matmul, which accumulates into a
+// copy of it.
+func.func @conflict(%arg0: tensor<4x4xf32>, %arg1: tensor<4x4xf32>,
+    %arg2: tensor<4x4xf32>) -> (tensor<4x4xf32>, tensor<4x4xf32>) {
+  // expected-remark @below {{copy inserted by bufferization: memref<4x4xf32>}}
+  %0 = linalg.matmul ins(%arg1, %arg2 : tensor<4x4xf32>, tensor<4x4xf32>) outs(%arg0 : tensor<4x4xf32>) -> tensor<4x4xf32>
+  return %0, %arg0 : tensor<4x4xf32>, tensor<4x4xf32>
+}
+
+// CHECK-LABEL: func.func @conflict(
+// CHECK: linalg.copy
+// CHECK-NOT: tpp.bufferization_copy
+// CHECK: linalg.matmul
+
+// -----
+
+func.func @no_conflict(%arg0: tensor<4x4xf32>, %arg1: tensor<4x4xf32>,
+    %arg2: tensor<4x4xf32>) -> tensor<4x4xf32> {
+  %0 = linalg.matmul ins(%arg1, %arg2 : tensor<4x4xf32>, tensor<4x4xf32>) outs(%arg0 : tensor<4x4xf32>) -> tensor<4x4xf32>
+  return %0 : tensor<4x4xf32>
+}
+
+// CHECK-LABEL: func.func @no_conflict(
+// CHECK-NOT: linalg.copy
+// CHECK: linalg.matmul
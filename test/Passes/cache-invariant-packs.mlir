@@ -0,0 +1,70 @@
+// RUN: tpp-opt %s -cache-invariant-packs -split-input-file | FileCheck %s
+
+func.func @invariant_weight(%arg0: tensor<4x8x32x32xf32>,
+    %arg1: tensor<256x256xf32> {tpp.invariant}) -> tensor<8x8x32x32xf32> {
+  %0 = tensor.empty() : tensor<8x8x32x32xf32>
+  %pack = tensor.pack %arg1 outer_dims_perm = [1, 0] inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %0 : tensor<256x256xf32> -> tensor<8x8x32x32xf32>
+  return %pack : tensor<8x8x32x32xf32>
+}
+
+// CHECK-DAG: func.func private @tpp_pack_cache_lookup(i64, i64, i64) -> memref<*xi8> attributes {llvm.emit_c_interface}
+// CHECK-DAG: func.func private @tpp_pack_cache_is_valid(i64, i64) -> i64
+// CHECK-DAG: func.func private @tpp_pack_cache_commit(i64, i64)
+// CHECK-LABEL: func.func @invariant_weight(
+// CHECK-SAME:  %{{.+}}: tensor<4x8x32x32xf32>, %[[ARG1:.+]]: tensor<256x256xf32> {tpp.invariant})
+// CHECK: %[[SRC:.+]] = bufferization.to_memref %[[ARG1]] read_only : memref<256x256xf32>
+// CHECK: %[[PTR:.+]] = memref.extract_aligned_pointer_as_index %[[SRC]]
+// CHECK: %[[ADDR:.+]] = arith.index_cast %[[PTR]] : index to i64
+// CHECK: %[[LAYOUT:.+]] = arith.constant {{-?[0-9]+}} : i64
+// CHECK: %[[BYTES:.+]] = arith.constant 262144 : i64
+// CHECK: %[[ENTRY:.+]] = call @tpp_pack_cache_lookup(%[[ADDR]], %[[LAYOUT]], %[[BYTES]])
+// CHECK: %[[RAW:.+]] = memref.cast %[[ENTRY]] : memref<*xi8> to memref<?xi8>
+// CHECK: %[[C0:.+]] = arith.constant 0 : index
+// CHECK: %[[BUF:.+]] = memref.view %[[RAW]][%[[C0]]][] : memref<?xi8> to memref<8x8x32x32xf32>
+// CHECK: %[[VALID:.+]] = call @tpp_pack_cache_is_valid(%[[ADDR]], %[[LAYOUT]])
+// CHECK: %[[ZERO:.+]] = arith.constant 0 : i64
+// CHECK: %[[MISS:.+]] = arith.cmpi eq, %[[VALID]], %[[ZERO]] : i64
+// CHECK: scf.if %[[MISS]] {
+// CHECK:   %[[PACK:.+]] = tensor.pack %[[ARG1]] outer_dims_perm = [1, 0] inner_dims_pos = [0, 1] inner_tiles = [32, 32]
+// CHECK:   bufferization.materialize_in_destination %[[PACK]] in restrict writable %[[BUF]]
+// CHECK:   call @tpp_pack_cache_commit(%[[ADDR]], %[[LAYOUT]])
+// CHECK: }
+// CHECK: %[[PACKED:.+]] = bufferization.to_tensor %[[BUF]] restrict : memref<8x8x32x32xf32>
+// CHECK-NOT: tensor.pack
+// CHECK: return %[[PACKED]]
+
+// -----
+
+// The argument is not invariant, it is packed on every call.
+func.func @variant_input(%arg0: tensor<256x256xf32>) -> tensor<8x8x32x32xf32> {
+  %0 = tensor.empty() : tensor<8x8x32x32xf32>
+  %pack = tensor.pack %arg0 inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %0 : tensor<256x256xf32> -> tensor<8x8x32x32xf32>
+  return %pack : tensor<8x8x32x32xf32>
+}
+
+// CHECK-LABEL: func.func @variant_input(
+// CHECK-NOT: tpp_pack_cache
+// CHECK: tensor.pack
+// CHECK-NOT: tpp_pack_cache
+
+// -----
+
+// The blocking and VNNI packs of a weight are cached as one entry.
+func.func @invariant_vnni_weight(%arg0: tensor<256x256xbf16> {tpp.invariant}) -> tensor<8x8x16x32x2xbf16> {
+  %0 = tensor.empty() : tensor<8x8x32x32xbf16>
+  %pack = tensor.pack %arg0 outer_dims_perm = [1, 0] inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %0 : tensor<256x256xbf16> -> tensor<8x8x32x32xbf16>
+  %1 = tensor.empty() : tensor<8x8x16x32x2xbf16>
+  %pack_0 = tensor.pack %pack inner_dims_pos = [2] inner_tiles = [2] into %1 : tensor<8x8x32x32xbf16> -> tensor<8x8x16x32x2xbf16>
+  return %pack_0 : tensor<8x8x16x32x2xbf16>
+}
+
+// CHECK-LABEL: func.func @invariant_vnni_weight(
+// CHECK: %[[BYTES:.+]] = arith.constant 131072 : i64
+// CHECK: call @tpp_pack_cache_lookup(%{{.+}}, %{{.+}}, %[[BYTES]])
+// CHECK-NOT: tensor.pack
+// CHECK: scf.if
+// CHECK:   %[[BLOCKED:.+]] = tensor.pack %{{.+}} outer_dims_perm = [1, 0] inner_dims_pos = [0, 1] inner_tiles = [32, 32]
+// CHECK:   %[[VNNI:.+]] = tensor.pack %[[BLOCKED]] inner_dims_pos = [2] inner_tiles = [2]
+// CHECK:   bufferization.materialize_in_destination %[[VNNI]]
+// CHECK: }
+// CHECK-NOT: tensor.pack
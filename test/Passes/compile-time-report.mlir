@@ -0,0 +1,26 @@
+// RUN: tpp-opt %s -default-tpp-passes -compile-time-report=- -o /dev/null 2>&1 | FileCheck %s
+
+func.func @matmul(%A: tensor<4x8xf32>,
+                  %B: tensor<8x4xf32>, %C: tensor<4x4xf32>) -> tensor<4x4xf32> {
+  %D = linalg.matmul ins(%A, %B: tensor<4x8xf32>, tensor<8x4xf32>)
+                     outs(%C: tensor<4x4xf32>) -> tensor<4x4xf32>
+  return %D : tensor<4x4xf32>
+}
+
+// CHECK: "bundle_peak_rss_kb": {
+// CHECK-DAG: "bufferize": {{[0-9]+}}
+// CHECK-DAG: "tpp-mapping": {{[0-9]+}}
+// CHECK: "bundles": {
+// CHECK-DAG: "bufferize": {{[0-9.e+-]+}}
+// CHECK-DAG: "convert-xsmm-to-func": {{[0-9.e+-]+}}
+// CHECK-DAG: "default-tpp-passes": {{[0-9.e+-]+}}
+// CHECK-DAG: "linalg-lowering": {{[0-9.e+-]+}}
+// CHECK-DAG: "low-level-parallel": {{[0-9.e+-]+}}
+// CHECK-DAG: "tpp-mapping": {{[0-9.e+-]+}}
+// CHECK: "peak_rss_kb": {{[0-9]+}}
+// CHECK: "phases": {}
+// CHECK: "slowest_passes": {
+// CHECK: "tracked_passes": {
+// CHECK-DAG: "constant-fold-pack": {{[0-9.e+-]+}}
+// CHECK-DAG: "one-shot-bufferize": {{[0-9.e+-]+}}
+// CHECK-DAG: "tile-consumer-and-fuse-producers": {{[0-9.e+-]+}}
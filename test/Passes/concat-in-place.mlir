@@ -0,0 +1,91 @@
+// RUN: tpp-opt %s -concat-in-place -split-input-file | FileCheck %s
+// RUN: tpp-opt %s -bufferize -split-input-file | FileCheck %s --check-prefix=BUFF
+
+// The heads are computed before they are concatenated.
+func.func @concat_heads(%x: tensor<8x32xf32>, %w0: tensor<32x16xf32>,
+                        %w1: tensor<32x16xf32>) -> tensor<8x32xf32> {
+  %zero = arith.constant 0.0 : f32
+  %e0 = tensor.empty() : tensor<8x16xf32>
+  %f0 = linalg.fill ins(%zero : f32) outs(%e0 : tensor<8x16xf32>) -> tensor<8x16xf32>
+  %e1 = tensor.empty() : tensor<8x16xf32>
+  %f1 = linalg.fill ins(%zero : f32) outs(%e1 : tensor<8x16xf32>) -> tensor<8x16xf32>
+  %0 = linalg.matmul ins(%x, %w0 : tensor<8x32xf32>, tensor<32x16xf32>)
+                     outs(%f0 : tensor<8x16xf32>) -> tensor<8x16xf32>
+  %1 = linalg.matmul ins(%x, %w1 : tensor<8x32xf32>, tensor<32x16xf32>)
+                     outs(%f1 : tensor<8x16xf32>) -> tensor<8x16xf32>
+  %2 = tensor.concat dim(1) %0, %1
+    : (tensor<8x16xf32>, tensor<8x16xf32>) -> tensor<8x32xf32>
+  return %2 : tensor<8x32xf32>
+}
+
+// CHECK-LABEL: func.func @concat_heads(
+// CHECK: %[[DEST:.+]] = tensor.empty() : tensor<8x32xf32>
+// CHECK: %[[HEAD0:.+]] = linalg.matmul
+// CHECK: %[[INS0:.+]] = tensor.insert_slice %[[HEAD0]] into %[[DEST]][0, 0] [8, 16] [1, 1]
+// CHECK: tensor.empty() : tensor<8x16xf32>
+// CHECK: linalg.fill
+// CHECK: %[[HEAD1:.+]] = linalg.matmul
+// CHECK: %[[INS1:.+]] = tensor.insert_slice %[[HEAD1]] into %[[INS0]][0, 16] [8, 16] [1, 1]
+// CHECK: return %[[INS1]]
+
+// The heads are written in place into the concatenation.
+// BUFF-LABEL: func.func @concat_heads(
+// BUFF: %[[DEST:.+]] = memref.alloc() {{.*}}: memref<8x32xf32>
+// BUFF: %[[HEAD0:.+]] = memref.subview %[[DEST]][0, 0] [8, 16] [1, 1]
+// BUFF: linalg.matmul {{.*}} outs(%[[HEAD0]] :
+// BUFF: %[[HEAD1:.+]] = memref.subview %[[DEST]][0, 16] [8, 16] [1, 1]
+// BUFF: linalg.matmul {{.*}} outs(%[[HEAD1]] :
+// BUFF-NOT: memref.copy
+// BUFF-NOT: linalg.copy
+// BUFF: return
+
+// -----
+
+// The slices overlap, their order matters.
+func.func @overlapping(%a: tensor<8x16xf32>, %b: tensor<8x16xf32>)
+    -> tensor<8x24xf32> {
+  %0 = tensor.empty() : tensor<8x24xf32>
+  %1 = tensor.insert_slice %a into %0[0, 0] [8, 16] [1, 1]
+    : tensor<8x16xf32> into tensor<8x24xf32>
+  %2 = tensor.insert_slice %b into %1[0, 8] [8, 16] [1, 1]
+    : tensor<8x16xf32> into tensor<8x24xf32>
+  return %2 : tensor<8x24xf32>
+}
+
+// CHECK-LABEL: func.func @overlapping(
+// CHECK-SAME:  %[[A:[^:]+]]: tensor<8x16xf32>, %[[B:[^:]+]]: tensor<8x16xf32>
+// CHECK: %[[INS0:.+]] = tensor.insert_slice %[[A]]
+// CHECK: tensor.insert_slice %[[B]] into %[[INS0]][0, 8]
+
+// -----
+
+// The fused QKV projection is split into strided views of its output, read
+// in place.
+func.func @split_qkv(%x: tensor<8x32xf32>, %wqkv: tensor<32x48xf32>,
+                     %w: tensor<16x16xf32>) -> tensor<8x16xf32> {
+  %zero = arith.constant 0.0 : f32
+  %e = tensor.empty() : tensor<8x48xf32>
+  %f = linalg.fill ins(%zero : f32) outs(%e : tensor<8x48xf32>) -> tensor<8x48xf32>
+  %qkv = linalg.matmul ins(%x, %wqkv : tensor<8x32xf32>, tensor<32x48xf32>)
+                       outs(%f : tensor<8x48xf32>) -> tensor<8x48xf32>
+  %q = tensor.extract_slice %qkv[0, 0] [8, 16] [1, 1]
+    : tensor<8x48xf32> to tensor<8x16xf32>
+  %k = tensor.extract_slice %qkv[0, 16] [8, 16] [1, 1]
+    : tensor<8x48xf32> to tensor<8x16xf32>
+  %e0 = tensor.empty() : tensor<8x16xf32>
+  %f0 = linalg.fill ins(%zero : f32) outs(%e0 : tensor<8x16xf32>) -> tensor<8x16xf32>
+  %0 = linalg.matmul ins(%q, %w : tensor<8x16xf32>, tensor<16x16xf32>)
+                     outs(%f0 : tensor<8x16xf32>) -> tensor<8x16xf32>
+  %1 = linalg.matmul ins(%k, %w : tensor<8x16xf32>, tensor<16x16xf32>)
+                     outs(%0 : tensor<8x16xf32>) -> tensor<8x16xf32>
+  return %1 : tensor<8x16xf32>
+}
+
+// BUFF-LABEL: func.func @split_qkv(
+// BUFF: %[[QKV:.+]] = memref.alloc() {{.*}}: memref<8x48xf32>
+// BUFF-DAG: %[[Q:.+]] = memref.subview %[[QKV]][0, 0] [8, 16] [1, 1] : memref<8x48xf32> to memref<8x16xf32, strided<[48, 1]>>
+// BUFF-DAG: %[[K:.+]] = memref.subview %[[QKV]][0, 16] [8, 16] [1, 1] : memref<8x48xf32> to memref<8x16xf32, strided<[48, 1], offset: 16>>
+// BUFF-NOT: memref.copy
+// BUFF-NOT: linalg.copy
+// BUFF: linalg.matmul ins(%[[Q]], %{{.+}} : memref<8x16xf32, strided<[48, 1]>>, memref<16x16xf32>)
+// BUFF: linalg.matmul ins(%[[K]], %{{.+}} : memref<8x16xf32, strided<[48, 1], offset: 16>>, memref<16x16xf32>)
@@ -204,3 +204,83 @@ func.func @no_inplace_generic_transposed_maps(
 // CHECK:  %[[EMPTY:.+]] = tensor.empty
 // CHECK:  linalg.generic
 // CHECK-SAME: ins(%[[ARG0]] :{{.*}}) outs(%[[EMPTY]] :{{.*}})
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d1)>
+func.func @fc_chain_inplace(%arg0: tensor<8x16xf32>, %arg1: tensor<16x32xf32>,
+    %arg2: tensor<32xf32>) -> tensor<8x32xf32> {
+  %cst = arith.constant 0.000000e+00 : f32
+  %0 = tensor.empty() : tensor<8x32xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<8x32xf32>) -> tensor<8x32xf32>
+  %2 = linalg.matmul ins(%arg0, %arg1 : tensor<8x16xf32>, tensor<16x32xf32>) outs(%1 : tensor<8x32xf32>) -> tensor<8x32xf32>
+  %3 = tensor.empty() : tensor<8x32xf32>
+  %4 = linalg.generic {indexing_maps = [#map1, #map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg2, %2 : tensor<32xf32>, tensor<8x32xf32>) outs(%3 : tensor<8x32xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %6 = arith.subf %in_0, %in : f32
+    linalg.yield %6 : f32
+  } -> tensor<8x32xf32>
+  %5 = tensor.empty() : tensor<8x32xf32>
+  %6 = linalg.max ins(%4, %1 : tensor<8x32xf32>, tensor<8x32xf32>) outs(%5 : tensor<8x32xf32>) -> tensor<8x32xf32>
+  return %6 : tensor<8x32xf32>
+}
+
+// The bias updates the matmul result in place, the operand order of the
+// payload is kept.
+// CHECK-LABEL: func.func @fc_chain_inplace(
+// CHECK-SAME: %[[ARG0:.*]]: tensor<8x16xf32>, %[[ARG1:.*]]: tensor<16x32xf32>, %[[ARG2:.*]]: tensor<32xf32>
+// CHECK: %[[FILL:.+]] = linalg.fill
+// CHECK: %[[MM:.+]] = linalg.matmul ins(%[[ARG0]], %[[ARG1]] : {{.*}}) outs(%[[FILL]] :
+// CHECK: %[[BIAS:.+]] = linalg.generic
+// CHECK-SAME: ins(%[[ARG2]] : tensor<32xf32>) outs(%[[MM]] : tensor<8x32xf32>)
+// CHECK:   ^bb0(%[[IN:.*]]: f32, %[[OUT:.*]]: f32):
+// CHECK:     arith.subf %[[OUT]], %[[IN]] : f32
+// The fill has another use, the relu updates the bias result.
+// CHECK: %[[RELU:.+]] = linalg.generic
+// CHECK-SAME: ins(%[[FILL]] : tensor<8x32xf32>) outs(%[[BIAS]] : tensor<8x32xf32>)
+// CHECK:   ^bb0(%[[IN:.*]]: f32, %[[OUT:.*]]: f32):
+// CHECK:     arith.maximumf %[[OUT]], %[[IN]] : f32
+// CHECK: return %[[RELU]]
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d1)>
+func.func @fc_chain_into_dest(%arg0: tensor<8x16xf32>, %arg1: tensor<16x32xf32>,
+    %arg2: tensor<32xf32>, %arg3: tensor<8x32xf32>) -> tensor<8x32xf32> {
+  %cst = arith.constant 0.000000e+00 : f32
+  %0 = tensor.empty() : tensor<8x32xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<8x32xf32>) -> tensor<8x32xf32>
+  %2 = linalg.matmul ins(%arg0, %arg1 : tensor<8x16xf32>, tensor<16x32xf32>) outs(%1 : tensor<8x32xf32>) -> tensor<8x32xf32>
+  %3 = tensor.empty() : tensor<8x32xf32>
+  %4 = linalg.generic {indexing_maps = [#map1, #map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg2, %2 : tensor<32xf32>, tensor<8x32xf32>) outs(%3 : tensor<8x32xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %6 = arith.addf %in_0, %in : f32
+    linalg.yield %6 : f32
+  } -> tensor<8x32xf32>
+  %5 = linalg.generic {indexing_maps = [#map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%4 : tensor<8x32xf32>) outs(%arg3 : tensor<8x32xf32>) {
+  ^bb0(%in: f32, %out: f32):
+    %6 = arith.maximumf %in, %cst : f32
+    linalg.yield %6 : f32
+  } -> tensor<8x32xf32>
+  return %5 : tensor<8x32xf32>
+}
+
+// The whole chain writes into the output argument.
+// CHECK-LABEL: func.func @fc_chain_into_dest(
+// CHECK-SAME: %[[ARG0:.*]]: tensor<8x16xf32>, %[[ARG1:.*]]: tensor<16x32xf32>, %[[ARG2:.*]]: tensor<32xf32>, %[[ARG3:.*]]: tensor<8x32xf32>
+// CHECK-NOT: tensor.empty
+// CHECK: %[[FILL:.+]] = linalg.fill ins(%{{.+}} : f32) outs(%[[ARG3]] : tensor<8x32xf32>)
+// CHECK: %[[MM:.+]] = linalg.matmul ins(%[[ARG0]], %[[ARG1]] : {{.*}}) outs(%[[FILL]] :
+// CHECK: %[[BIAS:.+]] = linalg.generic
+// CHECK-SAME: ins(%[[ARG2]] : tensor<32xf32>) outs(%[[MM]] : tensor<8x32xf32>)
+// CHECK: %[[RELU:.+]] = linalg.generic
+// CHECK-SAME: outs(%[[BIAS]] : tensor<8x32xf32>)
+// CHECK: return %[[RELU]]
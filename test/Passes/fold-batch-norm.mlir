@@ -0,0 +1,76 @@
+// RUN: tpp-opt %s -split-input-file -fold-batch-norm | FileCheck %s
+
+#map = affine_map<(d0, d1, d2, d3) -> (d0, d1, d2, d3)>
+#map1 = affine_map<(d0, d1, d2, d3) -> (d3)>
+
+func.func @conv_bias_batchnorm(%arg0: tensor<1x4x4x1xf32>) -> tensor<1x2x2x2xf32> {
+  %filter = arith.constant dense<1.0> : tensor<3x3x1x2xf32>
+  %bias = arith.constant dense<[1.0, 2.0]> : tensor<2xf32>
+  %mean = arith.constant dense<[1.0, 0.0]> : tensor<2xf32>
+  %var = arith.constant dense<[4.0, 0.25]> : tensor<2xf32>
+  %gamma = arith.constant dense<[2.0, 1.0]> : tensor<2xf32>
+  %beta = arith.constant dense<[0.5, -1.0]> : tensor<2xf32>
+  %eps = arith.constant 0.0 : f32
+  %0 = tensor.empty() : tensor<1x2x2x2xf32>
+  %1 = linalg.generic {indexing_maps = [#map1, #map], iterator_types = ["parallel", "parallel", "parallel", "parallel"]}
+    ins(%bias : tensor<2xf32>) outs(%0 : tensor<1x2x2x2xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      linalg.yield %in : f32
+  } -> tensor<1x2x2x2xf32>
+  %2 = linalg.conv_2d_nhwc_hwcf {dilations = dense<1> : tensor<2xi64>, strides = dense<1> : tensor<2xi64>}
+    ins(%arg0, %filter : tensor<1x4x4x1xf32>, tensor<3x3x1x2xf32>) outs(%1 : tensor<1x2x2x2xf32>) -> tensor<1x2x2x2xf32>
+  %3 = linalg.generic {indexing_maps = [#map, #map1, #map1, #map1, #map1, #map], iterator_types = ["parallel", "parallel", "parallel", "parallel"]}
+    ins(%2, %mean, %var, %gamma, %beta : tensor<1x2x2x2xf32>, tensor<2xf32>, tensor<2xf32>, tensor<2xf32>, tensor<2xf32>)
+    outs(%0 : tensor<1x2x2x2xf32>) {
+    ^bb0(%x: f32, %m: f32, %v: f32, %g: f32, %b: f32, %out: f32):
+      %4 = arith.subf %x, %m : f32
+      %5 = arith.addf %v, %eps : f32
+      %6 = math.sqrt %5 : f32
+      %7 = arith.divf %4, %6 : f32
+      %8 = arith.mulf %7, %g : f32
+      %9 = arith.addf %8, %b : f32
+      linalg.yield %9 : f32
+  } -> tensor<1x2x2x2xf32>
+  return %3 : tensor<1x2x2x2xf32>
+}
+
+// scale = gamma / sqrt(var) = [1, 2], shift = beta - mean * scale = [-0.5, -1]
+// bias = bias * scale + shift = [0.5, 3]
+// CHECK-LABEL: func.func @conv_bias_batchnorm(
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<1x4x4x1xf32>
+// CHECK-DAG: %[[FILTER:.+]] = arith.constant dense<{{\[}}{{\[}}{{\[}}[1.000000e+00, 2.000000e+00]]
+// CHECK-SAME:  : tensor<3x3x1x2xf32>
+// CHECK-DAG: %[[BIAS:.+]] = arith.constant dense<[5.000000e-01, 3.000000e+00]> : tensor<2xf32>
+// CHECK: %[[INIT:.+]] = linalg.generic
+// CHECK-SAME:  ins(%[[BIAS]] : tensor<2xf32>)
+// CHECK: %[[CONV:.+]] = linalg.conv_2d_nhwc_hwcf
+// CHECK-SAME:  ins(%[[ARG0]], %[[FILTER]] : tensor<1x4x4x1xf32>, tensor<3x3x1x2xf32>)
+// CHECK-SAME:  outs(%[[INIT]] : tensor<1x2x2x2xf32>)
+// CHECK-NOT: math.sqrt
+// CHECK: return %[[CONV]]
+
+// -----
+
+#map = affine_map<(d0, d1, d2, d3) -> (d0, d1, d2, d3)>
+#map1 = affine_map<(d0, d1, d2, d3) -> (d3)>
+
+func.func @conv_relu(%arg0: tensor<1x4x4x1xf32>) -> tensor<1x2x2x2xf32> {
+  %filter = arith.constant dense<1.0> : tensor<3x3x1x2xf32>
+  %cst = arith.constant 0.0 : f32
+  %0 = tensor.empty() : tensor<1x2x2x2xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<1x2x2x2xf32>) -> tensor<1x2x2x2xf32>
+  %2 = linalg.conv_2d_nhwc_hwcf {dilations = dense<1> : tensor<2xi64>, strides = dense<1> : tensor<2xi64>}
+    ins(%arg0, %filter : tensor<1x4x4x1xf32>, tensor<3x3x1x2xf32>) outs(%1 : tensor<1x2x2x2xf32>) -> tensor<1x2x2x2xf32>
+  %3 = linalg.generic {indexing_maps = [#map, #map], iterator_types = ["parallel", "parallel", "parallel", "parallel"]}
+    ins(%2 : tensor<1x2x2x2xf32>) outs(%0 : tensor<1x2x2x2xf32>) {
+    ^bb0(%x: f32, %out: f32):
+      %4 = arith.maximumf %x, %cst : f32
+      linalg.yield %4 : f32
+  } -> tensor<1x2x2x2xf32>
+  return %3 : tensor<1x2x2x2xf32>
+}
+
+// Not affine, left as is.
+// CHECK-LABEL: func.func @conv_relu(
+// CHECK: linalg.conv_2d_nhwc_hwcf
+// CHECK: arith.maximumf
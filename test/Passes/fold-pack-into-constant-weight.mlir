@@ -197,3 +197,25 @@ func.func @non_splat_with_inner_and_outer() -> tensor<1x2x2x2x2xf32> {
 // CHECK: [8.000000e+00, 9.000000e+00], [1.200000e+01, 1.300000e+01]
 // CHECK: [2.000000e+00, 3.000000e+00], [6.000000e+00, 7.000000e+00]
 // CHECK: [1.000000e+01, 1.100000e+01], [1.400000e+01, 1.500000e+01]
+
+// -----
+
+func.func @resource() -> tensor<2x2x2x2xi32> {
+  %cst = arith.constant dense_resource<weights> : tensor<4x4xi32>
+  %0 = tensor.empty() : tensor<2x2x2x2xi32>
+  %pack = tensor.pack %cst inner_dims_pos = [0, 1] inner_tiles = [2, 2] into %0 : tensor<4x4xi32> -> tensor<2x2x2x2xi32>
+  return %pack : tensor<2x2x2x2xi32>
+}
+
+{-#
+  dialect_resources: {
+    builtin: {
+      weights: "0x04000000000000000100000002000000030000000400000005000000060000000700000008000000090000000A0000000B0000000C0000000D0000000E0000000F000000"
+    }
+  }
+#-}
+
+// CHECK-LABEL: func.func @resource
+// CHECK: %[[CST:.+]] = arith.constant dense_resource<weights_packed> : tensor<2x2x2x2xi32>
+// CHECK-NEXT: return %[[CST]] : tensor<2x2x2x2xi32>
+// CHECK: weights_packed: "0x04000000000000000100000004000000050000000200000003000000060000000700000008000000090000000C0000000D0000000A0000000B0000000E0000000F000000"
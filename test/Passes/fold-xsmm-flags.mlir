@@ -331,3 +331,124 @@ func.func @zero_flag_fused_brgemm(%arg0: memref<1x32x32xf32>, %arg1: memref<1x32
 // CHECK: %[[DIS:.+]] = xsmm.fused_brgemm.dispatch [32, 32, 32, 32, 32, 32, 32, 32][add,relu]
 // CHECK-SAME:  flags = (beta_0)  binary_flags = (none)  unary_flags = (none) data_type = f32
 // CHECK: xsmm.fused_brgemm(data_type = f32, %[[DIS]], %{{.+}}, %{{.+}}, %{{.+}}, %{{.+}}, %{{.+}})
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+
+func.func @trunc_gemm(%arg0: memref<32x64xbf16>, %arg1: memref<32x32x2xbf16>,
+                      %arg2: memref<32x32xbf16>) {
+  %cst = arith.constant 0.000000e+00 : f32
+  %alloc = memref.alloc() {alignment = 64 : i64} : memref<32x32xf32>
+  %0 = xsmm.unary.dispatch zero [32, 32, 1, 32] flags = (bcast_scalar) data_type = f32
+  xsmm.unary zero(data_type = f32, %0, %cst, %alloc) : (i64, f32, memref<32x32xf32>) -> ()
+  %1 = xsmm.gemm.dispatch [32, 32, 64, 64, 32, 32] flags = (vnni_b) data_type = bf16 output_type = f32
+  xsmm.gemm(data_type = bf16, %1, %arg0, %arg1, %alloc) : (i64, memref<32x64xbf16>, memref<32x32x2xbf16>, memref<32x32xf32>) -> ()
+  linalg.generic {
+    indexing_maps = [#map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%alloc : memref<32x32xf32>) outs(%arg2 : memref<32x32xbf16>) {
+    ^bb0(%in: f32, %out: bf16):
+      %2 = arith.truncf %in : f32 to bf16
+      linalg.yield %2 : bf16
+  }
+  memref.dealloc %alloc : memref<32x32xf32>
+  return
+}
+
+// CHECK-LABEL: trunc_gemm
+// CHECK-SAME: %[[ARG0:.+]]: memref<32x64xbf16>, %[[ARG1:.+]]: memref<32x32x2xbf16>, %[[ARG2:.+]]: memref<32x32xbf16>
+// CHECK-NOT: memref.alloc
+// CHECK: %[[DIS:.+]] = xsmm.gemm.dispatch [32, 32, 64, 64, 32, 32] flags = (vnni_b, beta_0) data_type = bf16
+// CHECK-NOT: output_type
+// CHECK: xsmm.gemm(data_type = bf16, %[[DIS]], %[[ARG0]], %[[ARG1]], %[[ARG2]])
+// CHECK-NOT: linalg.generic
+// CHECK-NOT: memref.dealloc
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+
+// The gemm accumulates into the f32 buffer, the rounding stays.
+func.func @trunc_gemm_no_beta_0(%arg0: memref<32x64xbf16>, %arg1: memref<32x32x2xbf16>,
+                                %arg2: memref<32x32xbf16>, %arg3: memref<32x32xf32>) {
+  %1 = xsmm.gemm.dispatch [32, 32, 64, 64, 32, 32] flags = (vnni_b) data_type = bf16 output_type = f32
+  xsmm.gemm(data_type = bf16, %1, %arg0, %arg1, %arg3) : (i64, memref<32x64xbf16>, memref<32x32x2xbf16>, memref<32x32xf32>) -> ()
+  linalg.generic {
+    indexing_maps = [#map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg3 : memref<32x32xf32>) outs(%arg2 : memref<32x32xbf16>) {
+    ^bb0(%in: f32, %out: bf16):
+      %2 = arith.truncf %in : f32 to bf16
+      linalg.yield %2 : bf16
+  }
+  return
+}
+
+// CHECK-LABEL: trunc_gemm_no_beta_0
+// CHECK: xsmm.gemm.dispatch [32, 32, 64, 64, 32, 32] flags = (vnni_b) data_type = bf16 output_type = f32
+// CHECK: linalg.generic
+// CHECK: arith.truncf
+
+// -----
+
+#map = affine_map<(d0) -> (d0 * 32)>
+
+// The forall computes the zeroed output tile by tile.
+func.func @zero_flag_forall_tiles(%arg0: memref<32x32xf32>, %arg1: memref<32x32xf32>,
+                                  %arg2: memref<64x64xf32>) {
+  %cst = arith.constant 0.000000e+00 : f32
+  %0 = xsmm.unary.dispatch zero [64, 64, 1, 64] flags = (bcast_scalar) data_type = f32
+  xsmm.unary zero(data_type = f32, %0, %cst, %arg2) : (i64, f32, memref<64x64xf32>) -> ()
+  %1 = xsmm.gemm.dispatch [32, 32, 32, 32, 32, 64] flags = (none) data_type = f32
+  scf.forall (%i, %j) in (2, 2) {
+    %off_i = affine.apply #map(%i)
+    %off_j = affine.apply #map(%j)
+    %sub = memref.subview %arg2[%off_i, %off_j] [32, 32] [1, 1] : memref<64x64xf32> to memref<32x32xf32, strided<[64, 1], offset: ?>>
+    xsmm.gemm(data_type = f32, %1, %arg0, %arg1, %sub) : (i64, memref<32x32xf32>, memref<32x32xf32>, memref<32x32xf32, strided<[64, 1], offset: ?>>) -> ()
+  }
+  return
+}
+
+// CHECK-LABEL: zero_flag_forall_tiles
+// CHECK-NOT: xsmm.unary zero
+// CHECK: %[[DIS:.+]] = xsmm.gemm.dispatch [32, 32, 32, 32, 32, 64] flags = (beta_0) data_type = f32
+// CHECK: scf.forall
+// CHECK: xsmm.gemm(data_type = f32, %[[DIS]], %{{.+}}, %{{.+}}, %{{.+}})
+
+// -----
+
+#map = affine_map<(d0) -> (d0 * 32)>
+
+// The tiles of the forall do not cover the output, and the gemm of the
+// second loop accumulates over K.
+func.func @zero_flag_forall_no_fold(%arg0: memref<32x32xf32>, %arg1: memref<32x32xf32>,
+                                    %arg2: memref<64x64xf32>, %arg3: memref<64x64xf32>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c4 = arith.constant 4 : index
+  %cst = arith.constant 0.000000e+00 : f32
+  %0 = xsmm.unary.dispatch zero [64, 64, 1, 64] flags = (bcast_scalar) data_type = f32
+  xsmm.unary zero(data_type = f32, %0, %cst, %arg2) : (i64, f32, memref<64x64xf32>) -> ()
+  %1 = xsmm.gemm.dispatch [32, 32, 32, 32, 32, 64] flags = (none) data_type = f32
+  scf.forall (%i) in (2) {
+    %off_i = affine.apply #map(%i)
+    %sub = memref.subview %arg2[%off_i, 0] [32, 32] [1, 1] : memref<64x64xf32> to memref<32x32xf32, strided<[64, 1], offset: ?>>
+    xsmm.gemm(data_type = f32, %1, %arg0, %arg1, %sub) : (i64, memref<32x32xf32>, memref<32x32xf32>, memref<32x32xf32, strided<[64, 1], offset: ?>>) -> ()
+  }
+  %2 = xsmm.unary.dispatch zero [64, 64, 1, 64] flags = (bcast_scalar) data_type = f32
+  xsmm.unary zero(data_type = f32, %2, %cst, %arg3) : (i64, f32, memref<64x64xf32>) -> ()
+  scf.forall (%i, %j) in (2, 2) {
+    %off_i = affine.apply #map(%i)
+    %off_j = affine.apply #map(%j)
+    %sub = memref.subview %arg3[%off_i, %off_j] [32, 32] [1, 1] : memref<64x64xf32> to memref<32x32xf32, strided<[64, 1], offset: ?>>
+    scf.for %k = %c0 to %c4 step %c1 {
+      xsmm.gemm(data_type = f32, %1, %arg0, %arg1, %sub) : (i64, memref<32x32xf32>, memref<32x32xf32>, memref<32x32xf32, strided<[64, 1], offset: ?>>) -> ()
+    }
+  }
+  return
+}
+
+// CHECK-LABEL: zero_flag_forall_no_fold
+// CHECK-COUNT-2: xsmm.unary zero
+// CHECK-NOT: beta_0
@@ -0,0 +1,125 @@
+// RUN: tpp-opt %s -fuse-attention="kv-split=4 kv-tile=16" -split-input-file | FileCheck %s
+
+#mapQ = affine_map<(d0, d1, d2, d3) -> (d0, d1, d3)>
+#mapK = affine_map<(d0, d1, d2, d3) -> (d0, d2, d3)>
+#mapS = affine_map<(d0, d1, d2, d3) -> (d0, d1, d2)>
+#mapP = affine_map<(d0, d1, d2, d3) -> (d0, d1, d3)>
+#mapV = affine_map<(d0, d1, d2, d3) -> (d0, d3, d2)>
+#mapO = affine_map<(d0, d1, d2, d3) -> (d0, d1, d2)>
+
+// Decoding: a single query per head, the blocks of keys give the threads
+// work.
+func.func @decode_attention(%q: tensor<2x1x16xf32>, %k: tensor<2x128x16xf32>,
+                            %v: tensor<2x128x16xf32>) -> tensor<2x1x16xf32> {
+  %cst = arith.constant 0.0 : f32
+  %0 = tensor.empty() : tensor<2x1x128xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<2x1x128xf32>) -> tensor<2x1x128xf32>
+  %2 = linalg.generic {
+    indexing_maps = [#mapQ, #mapK, #mapS],
+    iterator_types = ["parallel", "parallel", "parallel", "reduction"]}
+    ins(%q, %k : tensor<2x1x16xf32>, tensor<2x128x16xf32>)
+    outs(%1 : tensor<2x1x128xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %8 = arith.mulf %in, %in_0 : f32
+    %9 = arith.addf %out, %8 : f32
+    linalg.yield %9 : f32
+  } -> tensor<2x1x128xf32>
+  %3 = tensor.empty() : tensor<2x1x128xf32>
+  %4 = linalg.softmax dimension(2)
+    ins(%2 : tensor<2x1x128xf32>) outs(%3 : tensor<2x1x128xf32>) -> tensor<2x1x128xf32>
+  %5 = tensor.empty() : tensor<2x1x16xf32>
+  %6 = linalg.fill ins(%cst : f32) outs(%5 : tensor<2x1x16xf32>) -> tensor<2x1x16xf32>
+  %7 = linalg.generic {
+    indexing_maps = [#mapP, #mapV, #mapO],
+    iterator_types = ["parallel", "parallel", "parallel", "reduction"]}
+    ins(%4, %v : tensor<2x1x128xf32>, tensor<2x128x16xf32>)
+    outs(%6 : tensor<2x1x16xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %8 = arith.mulf %in, %in_0 : f32
+    %9 = arith.addf %out, %8 : f32
+    linalg.yield %9 : f32
+  } -> tensor<2x1x16xf32>
+  return %7 : tensor<2x1x16xf32>
+}
+
+// CHECK-DAG: #[[LB:.+]] = affine_map<(d0) -> (d0 * 32)>
+// CHECK-DAG: #[[UB:.+]] = affine_map<(d0) -> (d0 * 32 + 32)>
+// CHECK-LABEL: func.func @decode_attention(
+// CHECK-SAME:  %[[Q:.+]]: tensor<2x1x16xf32>, %[[K:.+]]: tensor<2x128x16xf32>, %[[V:.+]]: tensor<2x128x16xf32>
+// CHECK-NOT: linalg.softmax
+// CHECK: %[[PACC:.+]] = tensor.empty() : tensor<4x2x1x16xf32>
+// CHECK: %[[PMAX:.+]] = tensor.empty() : tensor<4x2x1xf32>
+// CHECK: %[[PSUM:.+]] = tensor.empty() : tensor<4x2x1xf32>
+// CHECK: %[[PARTS:.+]]:3 = scf.forall (%[[B:.+]], %[[BLK:.+]]) in (2, 4)
+// CHECK-SAME:  shared_outs(%[[ACCS:.+]] = %[[PACC]], %[[MAXS:.+]] = %[[PMAX]], %[[SUMS:.+]] = %[[PSUM]])
+// CHECK:   %[[ACC:.+]] = linalg.fill {{.*}} -> tensor<1x1x16xf32>
+// CHECK:   %[[LBV:.+]] = affine.apply #[[LB]](%[[BLK]])
+// CHECK:   %[[UBV:.+]] = affine.apply #[[UB]](%[[BLK]])
+// CHECK:   %[[RES:.+]]:3 = scf.for %[[KV:.+]] = %[[LBV]] to %[[UBV]] step %{{.+}}
+// CHECK:     tensor.extract_slice %[[K]][%[[B]], %[[KV]], 0] [1, 16, 16]
+// CHECK:     linalg.generic {{.*}} outs(%{{.+}} : tensor<1x1x16xf32>)
+// CHECK:     tensor.extract_slice %[[V]][%[[B]], %[[KV]], 0] [1, 16, 16]
+// CHECK:     scf.yield
+// CHECK-NOT: arith.divf
+// CHECK:   tensor.parallel_insert_slice %[[RES]]#0 into %[[ACCS]][%[[BLK]], %[[B]], 0, 0] [1, 1, 1, 16] [1, 1, 1, 1]
+// CHECK:   tensor.parallel_insert_slice %[[RES]]#1 into %[[MAXS]][%[[BLK]], %[[B]], 0] [1, 1, 1] [1, 1, 1]
+// CHECK:   tensor.parallel_insert_slice %[[RES]]#2 into %[[SUMS]][%[[BLK]], %[[B]], 0] [1, 1, 1] [1, 1, 1]
+// CHECK: } {fused_attention}
+// CHECK: %[[MAX:.+]] = linalg.reduce ins(%[[PARTS]]#1 : tensor<4x2x1xf32>) {{.*}} dimensions = [0]
+// CHECK:   arith.maximumf
+// CHECK: %[[SCALE:.+]] = linalg.generic {{.*}} ins(%[[PARTS]]#1, %[[MAX]] : tensor<4x2x1xf32>, tensor<2x1xf32>)
+// CHECK:   math.exp
+// CHECK: %[[SCALEDSUM:.+]] = linalg.generic {{.*}} ins(%[[PARTS]]#2, %[[SCALE]] : tensor<4x2x1xf32>, tensor<4x2x1xf32>)
+// CHECK: %[[SUM:.+]] = linalg.reduce ins(%[[SCALEDSUM]] : tensor<4x2x1xf32>) {{.*}} dimensions = [0]
+// CHECK: %[[SCALEDACC:.+]] = linalg.generic {{.*}} ins(%[[PARTS]]#0, %[[SCALE]] : tensor<4x2x1x16xf32>, tensor<4x2x1xf32>)
+// CHECK: %[[ACCSUM:.+]] = linalg.reduce ins(%[[SCALEDACC]] : tensor<4x2x1x16xf32>) {{.*}} dimensions = [0]
+// CHECK: %[[OUT:.+]] = linalg.generic {{.*}} ins(%[[ACCSUM]], %[[SUM]] : tensor<2x1x16xf32>, tensor<2x1xf32>)
+// CHECK:   arith.divf
+// CHECK: return %[[OUT]]
+
+// -----
+
+#mapQ = affine_map<(d0, d1, d2, d3) -> (d0, d1, d3)>
+#mapK = affine_map<(d0, d1, d2, d3) -> (d0, d2, d3)>
+#mapS = affine_map<(d0, d1, d2, d3) -> (d0, d1, d2)>
+#mapP = affine_map<(d0, d1, d2, d3) -> (d0, d1, d3)>
+#mapV = affine_map<(d0, d1, d2, d3) -> (d0, d3, d2)>
+#mapO = affine_map<(d0, d1, d2, d3) -> (d0, d1, d2)>
+
+// Without a softmax, the blocks are summed into the output.
+func.func @decode_scores(%q: tensor<2x1x16xf32>, %k: tensor<2x128x16xf32>,
+                         %v: tensor<2x128x16xf32>,
+                         %o: tensor<2x1x16xf32>) -> tensor<2x1x16xf32> {
+  %cst = arith.constant 0.0 : f32
+  %0 = tensor.empty() : tensor<2x1x128xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<2x1x128xf32>) -> tensor<2x1x128xf32>
+  %2 = linalg.generic {
+    indexing_maps = [#mapQ, #mapK, #mapS],
+    iterator_types = ["parallel", "parallel", "parallel", "reduction"]}
+    ins(%q, %k : tensor<2x1x16xf32>, tensor<2x128x16xf32>)
+    outs(%1 : tensor<2x1x128xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %8 = arith.mulf %in, %in_0 : f32
+    %9 = arith.addf %out, %8 : f32
+    linalg.yield %9 : f32
+  } -> tensor<2x1x128xf32>
+  %3 = linalg.generic {
+    indexing_maps = [#mapP, #mapV, #mapO],
+    iterator_types = ["parallel", "parallel", "parallel", "reduction"]}
+    ins(%2, %v : tensor<2x1x128xf32>, tensor<2x128x16xf32>)
+    outs(%o : tensor<2x1x16xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %8 = arith.mulf %in, %in_0 : f32
+    %9 = arith.addf %out, %8 : f32
+    linalg.yield %9 : f32
+  } -> tensor<2x1x16xf32>
+  return %3 : tensor<2x1x16xf32>
+}
+
+// CHECK-LABEL: func.func @decode_scores(
+// CHECK-SAME:  %{{.+}}: tensor<2x128x16xf32>, %[[O:.+]]: tensor<2x1x16xf32>
+// CHECK: %[[PARTS:.+]] = scf.forall (%{{.+}}, %{{.+}}) in (2, 4)
+// CHECK: } {fused_attention}
+// CHECK: %[[OUT:.+]] = linalg.reduce ins(%[[PARTS]] : tensor<4x2x1x16xf32>) outs(%[[O]] : tensor<2x1x16xf32>) dimensions = [0]
+// CHECK:   arith.addf
+// CHECK: return %[[OUT]]
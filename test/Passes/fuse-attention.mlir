@@ -0,0 +1,176 @@
+// RUN: tpp-opt %s -fuse-attention -split-input-file | FileCheck %s
+
+#mapQ = affine_map<(d0, d1, d2, d3) -> (d0, d1, d3)>
+#mapK = affine_map<(d0, d1, d2, d3) -> (d0, d2, d3)>
+#mapS = affine_map<(d0, d1, d2, d3) -> (d0, d1, d2)>
+#mapP = affine_map<(d0, d1, d2, d3) -> (d0, d1, d3)>
+#mapV = affine_map<(d0, d1, d2, d3) -> (d0, d3, d2)>
+#mapO = affine_map<(d0, d1, d2, d3) -> (d0, d1, d2)>
+
+func.func @attention(%q: tensor<2x64x16xf32>, %k: tensor<2x64x16xf32>,
+                     %v: tensor<2x64x16xf32>) -> tensor<2x64x16xf32> {
+  %cst = arith.constant 0.0 : f32
+  %0 = tensor.empty() : tensor<2x64x64xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<2x64x64xf32>) -> tensor<2x64x64xf32>
+  %2 = linalg.generic {
+    indexing_maps = [#mapQ, #mapK, #mapS],
+    iterator_types = ["parallel", "parallel", "parallel", "reduction"]}
+    ins(%q, %k : tensor<2x64x16xf32>, tensor<2x64x16xf32>)
+    outs(%1 : tensor<2x64x64xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %8 = arith.mulf %in, %in_0 : f32
+    %9 = arith.addf %out, %8 : f32
+    linalg.yield %9 : f32
+  } -> tensor<2x64x64xf32>
+  %3 = tensor.empty() : tensor<2x64x64xf32>
+  %4 = linalg.softmax dimension(2)
+    ins(%2 : tensor<2x64x64xf32>) outs(%3 : tensor<2x64x64xf32>) -> tensor<2x64x64xf32>
+  %5 = tensor.empty() : tensor<2x64x16xf32>
+  %6 = linalg.fill ins(%cst : f32) outs(%5 : tensor<2x64x16xf32>) -> tensor<2x64x16xf32>
+  %7 = linalg.generic {
+    indexing_maps = [#mapP, #mapV, #mapO],
+    iterator_types = ["parallel", "parallel", "parallel", "reduction"]}
+    ins(%4, %v : tensor<2x64x64xf32>, tensor<2x64x16xf32>)
+    outs(%6 : tensor<2x64x16xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %8 = arith.mulf %in, %in_0 : f32
+    %9 = arith.addf %out, %8 : f32
+    linalg.yield %9 : f32
+  } -> tensor<2x64x16xf32>
+  return %7 : tensor<2x64x16xf32>
+}
+
+// CHECK-LABEL: func.func @attention(
+// CHECK-SAME:  %[[Q:.+]]: tensor<2x64x16xf32>, %[[K:.+]]: tensor<2x64x16xf32>, %[[V:.+]]: tensor<2x64x16xf32>
+// CHECK-NOT: linalg.softmax
+// CHECK: %[[OUT:.+]] = scf.forall (%[[B:.+]], %[[M:.+]]) in (2, 2) shared_outs(%[[ARG:.+]] = %{{.+}})
+// CHECK:   %[[ROW:.+]] = affine.apply #{{.+}}(%[[M]])
+// CHECK:   %[[ACC:.+]] = tensor.extract_slice %[[ARG]][%[[B]], %[[ROW]], 0] [1, 32, 16] [1, 1, 1]
+// CHECK:   %[[NEGINF:.+]] = arith.constant 0xFF800000 : f32
+// CHECK:   %[[MAX:.+]] = linalg.fill ins(%[[NEGINF]] : f32) {{.*}} -> tensor<1x32xf32>
+// CHECK:   %[[SUM:.+]] = linalg.fill {{.*}} -> tensor<1x32xf32>
+// CHECK:   %[[RES:.+]]:3 = scf.for %[[KV:.+]] = %{{.+}} to %{{.+}} step %{{.+}}
+// CHECK-SAME:  iter_args(%{{.+}} = %[[ACC]], %{{.+}} = %[[MAX]], %{{.+}} = %[[SUM]])
+// CHECK:     tensor.extract_slice %[[Q]][%[[B]], %[[ROW]], 0] [1, 32, 16]
+// CHECK:     tensor.extract_slice %[[K]][%[[B]], %[[KV]], 0] [1, 32, 16]
+// CHECK:     %[[S:.+]] = linalg.generic {{.*}} outs(%{{.+}} : tensor<1x32x32xf32>)
+// CHECK:     %[[MAXNEW:.+]] = linalg.reduce {{.*}}ins(%[[S]] : tensor<1x32x32xf32>)
+// CHECK:     %[[P:.+]] = linalg.generic {{.*}} ins(%[[S]], %[[MAXNEW]] : tensor<1x32x32xf32>, tensor<1x32xf32>)
+// CHECK:       arith.subf
+// CHECK:       math.exp
+// CHECK:     %[[SCALE:.+]] = linalg.generic {{.*}} ins(%{{.+}}, %[[MAXNEW]] : tensor<1x32xf32>, tensor<1x32xf32>)
+// CHECK:       math.exp
+// CHECK:     linalg.reduce {{.*}}ins(%[[P]] : tensor<1x32x32xf32>)
+// CHECK:     %[[SCALED:.+]] = linalg.generic {{.*}} ins(%{{.+}}, %[[SCALE]] : tensor<1x32x16xf32>, tensor<1x32xf32>)
+// CHECK:       arith.mulf
+// CHECK:     tensor.extract_slice %[[V]][%[[B]], %[[KV]], 0] [1, 32, 16]
+// CHECK:     linalg.generic {{.*}} ins(%[[P]], %{{.+}} : tensor<1x32x32xf32>, tensor<1x32x16xf32>) outs(%[[SCALED]] : tensor<1x32x16xf32>)
+// CHECK:     scf.yield
+// CHECK:   %[[NORM:.+]] = linalg.generic {{.*}} ins(%[[RES]]#0, %[[RES]]#2 : tensor<1x32x16xf32>, tensor<1x32xf32>)
+// CHECK:     arith.divf
+// CHECK:   tensor.parallel_insert_slice %[[NORM]] into %[[ARG]][%[[B]], %[[ROW]], 0] [1, 32, 16] [1, 1, 1]
+// CHECK: } {fused_attention}
+// CHECK: return %[[OUT]]
+
+// -----
+
+// Multi-head attention in the layout of the TensorFlow benchmarks, without a
+// softmax: the tiles of the scores are accumulated as they are.
+
+#map4 = affine_map<(d0, d1, d2, d3, d4) -> (d0, d1, d2, d3)>
+#map5 = affine_map<(d0, d1, d2, d3, d4) -> (d0, d4, d2, d3)>
+#map6 = affine_map<(d0, d1, d2, d3, d4) -> (d0, d2, d4, d1)>
+#map9 = affine_map<(d0, d1, d2, d3, d4) -> (d0, d3, d1, d4)>
+#map10 = affine_map<(d0, d1, d2, d3, d4) -> (d0, d2, d1, d4)>
+
+func.func @mha(%k: tensor<2x64x2x16xf32>, %q: tensor<2x64x2x16xf32>,
+               %v: tensor<2x64x2x16xf32>) -> tensor<2x64x2x16xf32> {
+  %cst = arith.constant 0.0 : f32
+  %0 = tensor.empty() : tensor<2x2x64x64xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<2x2x64x64xf32>) -> tensor<2x2x64x64xf32>
+  %2 = linalg.generic {
+    indexing_maps = [#map4, #map5, #map6],
+    iterator_types = ["parallel", "parallel", "parallel", "reduction", "parallel"]}
+    ins(%k, %q : tensor<2x64x2x16xf32>, tensor<2x64x2x16xf32>)
+    outs(%1 : tensor<2x2x64x64xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %6 = arith.mulf %in, %in_0 : f32
+    %7 = arith.addf %out, %6 : f32
+    linalg.yield %7 : f32
+  } -> tensor<2x2x64x64xf32>
+  %3 = tensor.empty() : tensor<2x64x2x16xf32>
+  %4 = linalg.fill ins(%cst : f32) outs(%3 : tensor<2x64x2x16xf32>) -> tensor<2x64x2x16xf32>
+  %5 = linalg.generic {
+    indexing_maps = [#map4, #map9, #map10],
+    iterator_types = ["parallel", "parallel", "parallel", "reduction", "parallel"]}
+    ins(%2, %v : tensor<2x2x64x64xf32>, tensor<2x64x2x16xf32>)
+    outs(%4 : tensor<2x64x2x16xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %6 = arith.mulf %in, %in_0 : f32
+    %7 = arith.addf %out, %6 : f32
+    linalg.yield %7 : f32
+  } -> tensor<2x64x2x16xf32>
+  return %5 : tensor<2x64x2x16xf32>
+}
+
+// CHECK-LABEL: func.func @mha(
+// CHECK-SAME:  %[[K:.+]]: tensor<2x64x2x16xf32>, %[[Q:.+]]: tensor<2x64x2x16xf32>, %[[V:.+]]: tensor<2x64x2x16xf32>
+// CHECK: scf.forall (%[[B:.+]], %[[H:.+]], %[[M:.+]]) in (2, 2, 2) shared_outs(%[[ARG:.+]] = %{{.+}})
+// CHECK:   %[[ROW:.+]] = affine.apply #{{.+}}(%[[M]])
+// CHECK:   %[[ACC:.+]] = tensor.extract_slice %[[ARG]][%[[B]], %[[ROW]], %[[H]], 0] [1, 32, 1, 16] [1, 1, 1, 1]
+// CHECK:   %[[RES:.+]] = scf.for %[[KV:.+]] = %{{.+}} to %{{.+}} step %{{.+}} iter_args(%[[ITER:.+]] = %[[ACC]])
+// CHECK:     tensor.extract_slice %[[K]][%[[B]], %[[KV]], %[[H]], 0] [1, 32, 1, 16]
+// CHECK:     tensor.extract_slice %[[Q]][%[[B]], %[[ROW]], %[[H]], 0] [1, 32, 1, 16]
+// CHECK:     %[[S:.+]] = linalg.generic {{.*}} outs(%{{.+}} : tensor<1x1x32x32xf32>)
+// CHECK:     tensor.extract_slice %[[V]][%[[B]], %[[KV]], %[[H]], 0] [1, 32, 1, 16]
+// CHECK:     %[[NEXT:.+]] = linalg.generic {{.*}} ins(%[[S]], %{{.+}} : tensor<1x1x32x32xf32>, tensor<1x32x1x16xf32>) outs(%[[ITER]] : tensor<1x32x1x16xf32>)
+// CHECK:     scf.yield %[[NEXT]]
+// CHECK:   tensor.parallel_insert_slice %[[RES]] into %[[ARG]][%[[B]], %[[ROW]], %[[H]], 0] [1, 32, 1, 16] [1, 1, 1, 1]
+// CHECK: } {fused_attention}
+
+// -----
+
+#mapQ = affine_map<(d0, d1, d2, d3) -> (d0, d1, d3)>
+#mapK = affine_map<(d0, d1, d2, d3) -> (d0, d2, d3)>
+#mapS = affine_map<(d0, d1, d2, d3) -> (d0, d1, d2)>
+#mapP = affine_map<(d0, d1, d2, d3) -> (d0, d1, d3)>
+#mapV = affine_map<(d0, d1, d2, d3) -> (d0, d3, d2)>
+#mapO = affine_map<(d0, d1, d2, d3) -> (d0, d1, d2)>
+
+// The scores are returned as well, they are still materialized.
+func.func @scores_used(%q: tensor<2x64x16xf32>, %k: tensor<2x64x16xf32>,
+                       %v: tensor<2x64x16xf32>)
+    -> (tensor<2x64x64xf32>, tensor<2x64x16xf32>) {
+  %cst = arith.constant 0.0 : f32
+  %0 = tensor.empty() : tensor<2x64x64xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<2x64x64xf32>) -> tensor<2x64x64xf32>
+  %2 = linalg.generic {
+    indexing_maps = [#mapQ, #mapK, #mapS],
+    iterator_types = ["parallel", "parallel", "parallel", "reduction"]}
+    ins(%q, %k : tensor<2x64x16xf32>, tensor<2x64x16xf32>)
+    outs(%1 : tensor<2x64x64xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %6 = arith.mulf %in, %in_0 : f32
+    %7 = arith.addf %out, %6 : f32
+    linalg.yield %7 : f32
+  } -> tensor<2x64x64xf32>
+  %3 = tensor.empty() : tensor<2x64x16xf32>
+  %4 = linalg.fill ins(%cst : f32) outs(%3 : tensor<2x64x16xf32>) -> tensor<2x64x16xf32>
+  %5 = linalg.generic {
+    indexing_maps = [#mapP, #mapV, #mapO],
+    iterator_types = ["parallel", "parallel", "parallel", "reduction"]}
+    ins(%2, %v : tensor<2x64x64xf32>, tensor<2x64x16xf32>)
+    outs(%4 : tensor<2x64x16xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %6 = arith.mulf %in, %in_0 : f32
+    %7 = arith.addf %out, %6 : f32
+    linalg.yield %7 : f32
+  } -> tensor<2x64x16xf32>
+  return %2, %5 : tensor<2x64x64xf32>, tensor<2x64x16xf32>
+}
+
+// CHECK-LABEL: func.func @scores_used(
+// CHECK-NOT: scf.forall
+// CHECK: linalg.generic
+// CHECK: linalg.generic
+// CHECK-NOT: scf.forall
@@ -0,0 +1,277 @@
+// RUN: tpp-opt %s -fuse-normalization -split-input-file | FileCheck %s
+// RUN: tpp-opt %s -fuse-normalization="one-pass=false" -split-input-file | FileCheck %s --check-prefix=TWOPASS
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d0)>
+#map2 = affine_map<(d0, d1) -> (d1)>
+#map3 = affine_map<(d0) -> (d0)>
+
+func.func @layernorm(%x: tensor<64x128xf32>, %gamma: tensor<128xf32>,
+                     %beta: tensor<128xf32>,
+                     %out: tensor<64x128xf32>) -> tensor<64x128xf32> {
+  %cst = arith.constant 0.0 : f32
+  %n = arith.constant 128.0 : f32
+  %eps = arith.constant 1.0e-05 : f32
+  %0 = tensor.empty() : tensor<64xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<64xf32>) -> tensor<64xf32>
+  %2 = linalg.generic {
+    indexing_maps = [#map, #map1],
+    iterator_types = ["parallel", "reduction"]}
+    ins(%x : tensor<64x128xf32>) outs(%1 : tensor<64xf32>) {
+  ^bb0(%in: f32, %acc: f32):
+    %7 = arith.addf %in, %acc : f32
+    linalg.yield %7 : f32
+  } -> tensor<64xf32>
+  %3 = linalg.generic {
+    indexing_maps = [#map3, #map3],
+    iterator_types = ["parallel"]}
+    ins(%2 : tensor<64xf32>) outs(%0 : tensor<64xf32>) {
+  ^bb0(%in: f32, %o: f32):
+    %7 = arith.divf %in, %n : f32
+    linalg.yield %7 : f32
+  } -> tensor<64xf32>
+  %4 = linalg.generic {
+    indexing_maps = [#map, #map1, #map1],
+    iterator_types = ["parallel", "reduction"]}
+    ins(%x, %3 : tensor<64x128xf32>, tensor<64xf32>) outs(%1 : tensor<64xf32>) {
+  ^bb0(%in: f32, %mean: f32, %acc: f32):
+    %7 = arith.subf %in, %mean : f32
+    %8 = arith.mulf %7, %7 : f32
+    %9 = arith.addf %8, %acc : f32
+    linalg.yield %9 : f32
+  } -> tensor<64xf32>
+  %5 = linalg.generic {
+    indexing_maps = [#map3, #map3],
+    iterator_types = ["parallel"]}
+    ins(%4 : tensor<64xf32>) outs(%0 : tensor<64xf32>) {
+  ^bb0(%in: f32, %o: f32):
+    %7 = arith.divf %in, %n : f32
+    %8 = arith.addf %7, %eps : f32
+    %9 = math.rsqrt %8 : f32
+    linalg.yield %9 : f32
+  } -> tensor<64xf32>
+  %6 = linalg.generic {
+    indexing_maps = [#map, #map1, #map1, #map2, #map2, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%x, %3, %5, %gamma, %beta
+      : tensor<64x128xf32>, tensor<64xf32>, tensor<64xf32>, tensor<128xf32>, tensor<128xf32>)
+    outs(%out : tensor<64x128xf32>) {
+  ^bb0(%in: f32, %mean: f32, %rstd: f32, %g: f32, %b: f32, %o: f32):
+    %7 = arith.subf %in, %mean : f32
+    %8 = arith.mulf %7, %rstd : f32
+    %9 = arith.mulf %8, %g : f32
+    %10 = arith.addf %9, %b : f32
+    linalg.yield %10 : f32
+  } -> tensor<64x128xf32>
+  return %6 : tensor<64x128xf32>
+}
+
+// CHECK-LABEL: func.func @layernorm(
+// CHECK-SAME:  %[[X:.+]]: tensor<64x128xf32>, %[[GAMMA:.+]]: tensor<128xf32>, %[[BETA:.+]]: tensor<128xf32>, %[[OUT:.+]]: tensor<64x128xf32>
+// CHECK: %[[RES:.+]] = scf.forall (%[[I:.+]]) in (2) shared_outs(%[[ARG:.+]] = %[[OUT]])
+// CHECK:   %[[ROW:.+]] = affine.apply #{{.+}}(%[[I]])
+// CHECK:   %[[XS:.+]] = tensor.extract_slice %[[X]][%[[ROW]], 0] [32, 128] [1, 1]
+// CHECK:   %[[PART:.+]]:2 = linalg.generic
+// CHECK-SAME:  iterator_types = ["parallel", "reduction"]
+// CHECK-SAME:  ins(%[[XS]], %[[XS]] : tensor<32x128xf32>, tensor<32x128xf32>)
+// CHECK:     arith.subf
+// CHECK:     arith.mulf
+// CHECK:     arith.addf
+// CHECK:     arith.addf
+// CHECK:   %[[STATS:.+]]:2 = linalg.generic {{.*}} ins(%[[PART]]#0, %[[PART]]#1, %[[XS]] :
+// CHECK:   %[[MEAN:.+]] = linalg.generic {{.*}} ins(%[[STATS]]#0 : tensor<32xf32>)
+// CHECK:   %[[RSTD:.+]] = linalg.generic {{.*}} ins(%[[STATS]]#1 : tensor<32xf32>)
+// CHECK:   %[[OS:.+]] = tensor.extract_slice %[[ARG]][%[[ROW]], 0] [32, 128] [1, 1]
+// CHECK:   %[[NORM:.+]] = linalg.generic
+// CHECK-SAME:  ins(%[[XS]], %[[MEAN]], %[[RSTD]], %[[GAMMA]], %[[BETA]] :
+// CHECK-SAME:  outs(%[[OS]] : tensor<32x128xf32>)
+// CHECK:   tensor.parallel_insert_slice %[[NORM]] into %[[ARG]][%[[ROW]], 0] [32, 128] [1, 1]
+// CHECK: } {fused_normalization}
+// CHECK: return %[[RES]]
+
+// TWOPASS-LABEL: func.func @layernorm(
+// TWOPASS: scf.forall
+// TWOPASS:   %[[SUM:.+]] = linalg.generic {{.*}} iterator_types = ["parallel", "reduction"]
+// TWOPASS:   %[[MEAN:.+]] = linalg.generic {{.*}} ins(%[[SUM]] : tensor<32xf32>)
+// TWOPASS:   linalg.generic {{.*}} iterator_types = ["parallel", "reduction"]
+// TWOPASS-SAME:  ins(%{{.+}}, %[[MEAN]] : tensor<32x128xf32>, tensor<32xf32>)
+// TWOPASS: } {fused_normalization}
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d0, 0)>
+#map2 = affine_map<(d0, d1) -> (d1)>
+
+// The producer matmul is fused in the loop, its rows fit in a tile.
+func.func @matmul_rmsnorm(%a: tensor<128x256xf32>, %b: tensor<256x64xf32>,
+                          %gamma: tensor<64xf32>) -> tensor<128x64xf32> {
+  %cst = arith.constant 0.0 : f32
+  %n = arith.constant 64.0 : f32
+  %eps = arith.constant 1.0e-05 : f32
+  %0 = tensor.empty() : tensor<128x64xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<128x64xf32>) -> tensor<128x64xf32>
+  %2 = linalg.matmul ins(%a, %b : tensor<128x256xf32>, tensor<256x64xf32>)
+                     outs(%1 : tensor<128x64xf32>) -> tensor<128x64xf32>
+  %3 = tensor.empty() : tensor<128x1xf32>
+  %4 = linalg.fill ins(%cst : f32) outs(%3 : tensor<128x1xf32>) -> tensor<128x1xf32>
+  %5 = linalg.generic {
+    indexing_maps = [#map, #map1],
+    iterator_types = ["parallel", "reduction"]}
+    ins(%2 : tensor<128x64xf32>) outs(%4 : tensor<128x1xf32>) {
+  ^bb0(%in: f32, %acc: f32):
+    %8 = arith.mulf %in, %in : f32
+    %9 = arith.addf %8, %acc : f32
+    linalg.yield %9 : f32
+  } -> tensor<128x1xf32>
+  %6 = linalg.generic {
+    indexing_maps = [#map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%5 : tensor<128x1xf32>) outs(%3 : tensor<128x1xf32>) {
+  ^bb0(%in: f32, %o: f32):
+    %8 = arith.divf %in, %n : f32
+    %9 = arith.addf %8, %eps : f32
+    %10 = math.rsqrt %9 : f32
+    linalg.yield %10 : f32
+  } -> tensor<128x1xf32>
+  %7 = linalg.generic {
+    indexing_maps = [#map, #map1, #map2, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%2, %6, %gamma : tensor<128x64xf32>, tensor<128x1xf32>, tensor<64xf32>)
+    outs(%0 : tensor<128x64xf32>) {
+  ^bb0(%in: f32, %rstd: f32, %g: f32, %o: f32):
+    %8 = arith.mulf %in, %rstd : f32
+    %9 = arith.mulf %8, %g : f32
+    linalg.yield %9 : f32
+  } -> tensor<128x64xf32>
+  return %7 : tensor<128x64xf32>
+}
+
+// CHECK-LABEL: func.func @matmul_rmsnorm(
+// CHECK-SAME:  %[[A:.+]]: tensor<128x256xf32>, %[[B:.+]]: tensor<256x64xf32>, %[[GAMMA:.+]]: tensor<64xf32>
+// CHECK-NOT: linalg.matmul
+// CHECK: %[[RES:.+]] = scf.forall (%[[I:.+]]) in (4) shared_outs(%[[ARG:.+]] = %{{.+}})
+// CHECK:   %[[ROW:.+]] = affine.apply #{{.+}}(%[[I]])
+// CHECK:   %[[OS:.+]] = tensor.extract_slice %[[ARG]][%[[ROW]], 0] [32, 64] [1, 1]
+// CHECK:   %[[FILL:.+]] = linalg.fill {{.*}} outs(%[[OS]] : tensor<32x64xf32>)
+// CHECK:   %[[AS:.+]] = tensor.extract_slice %[[A]][%[[ROW]], 0] [32, 256] [1, 1]
+// CHECK:   %[[MM:.+]] = linalg.matmul ins(%[[AS]], %[[B]] : tensor<32x256xf32>, tensor<256x64xf32>) outs(%[[FILL]] : tensor<32x64xf32>)
+// CHECK:   %[[SQ:.+]] = linalg.generic {{.*}} ins(%[[MM]] : tensor<32x64xf32>) outs(%{{.+}} : tensor<32x1xf32>)
+// CHECK:   %[[RSTD:.+]] = linalg.generic {{.*}} ins(%[[SQ]] : tensor<32x1xf32>)
+// CHECK:     math.rsqrt
+// CHECK:   %[[NORM:.+]] = linalg.generic
+// CHECK-SAME:  ins(%[[MM]], %[[RSTD]], %[[GAMMA]] :
+// CHECK-SAME:  outs(%[[OS]] : tensor<32x64xf32>)
+// CHECK:   tensor.parallel_insert_slice %[[NORM]] into %[[ARG]][%[[ROW]], 0] [32, 64] [1, 1]
+// CHECK: } {fused_normalization}
+// CHECK: return %[[RES]]
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d0, 0)>
+#map2 = affine_map<(d0, d1) -> (d1)>
+
+// The rows of the matmul are too wide for its epilogue, it is not fused.
+func.func @matmul_rmsnorm_wide(%a: tensor<128x256xf32>, %b: tensor<256x128xf32>,
+                               %gamma: tensor<128xf32>) -> tensor<128x128xf32> {
+  %cst = arith.constant 0.0 : f32
+  %n = arith.constant 128.0 : f32
+  %0 = tensor.empty() : tensor<128x128xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<128x128xf32>) -> tensor<128x128xf32>
+  %2 = linalg.matmul ins(%a, %b : tensor<128x256xf32>, tensor<256x128xf32>)
+                     outs(%1 : tensor<128x128xf32>) -> tensor<128x128xf32>
+  %3 = tensor.empty() : tensor<128x1xf32>
+  %4 = linalg.fill ins(%cst : f32) outs(%3 : tensor<128x1xf32>) -> tensor<128x1xf32>
+  %5 = linalg.generic {
+    indexing_maps = [#map, #map1],
+    iterator_types = ["parallel", "reduction"]}
+    ins(%2 : tensor<128x128xf32>) outs(%4 : tensor<128x1xf32>) {
+  ^bb0(%in: f32, %acc: f32):
+    %7 = arith.mulf %in, %in : f32
+    %8 = arith.addf %acc, %7 : f32
+    linalg.yield %8 : f32
+  } -> tensor<128x1xf32>
+  %6 = linalg.generic {
+    indexing_maps = [#map, #map1, #map2, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%2, %5, %gamma : tensor<128x128xf32>, tensor<128x1xf32>, tensor<128xf32>)
+    outs(%0 : tensor<128x128xf32>) {
+  ^bb0(%in: f32, %sq: f32, %g: f32, %o: f32):
+    %7 = arith.divf %sq, %n : f32
+    %8 = math.rsqrt %7 : f32
+    %9 = arith.mulf %in, %8 : f32
+    %10 = arith.mulf %9, %g : f32
+    linalg.yield %10 : f32
+  } -> tensor<128x128xf32>
+  return %6 : tensor<128x128xf32>
+}
+
+// CHECK-LABEL: func.func @matmul_rmsnorm_wide(
+// CHECK: %[[MM:.+]] = linalg.matmul
+// CHECK: scf.forall
+// CHECK:   tensor.extract_slice %[[MM]][%{{.+}}, 0] [32, 128] [1, 1]
+// CHECK-NOT: linalg.matmul
+// CHECK: } {fused_normalization}
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d1)>
+
+// Element-wise operations without statistics of the rows are left to the
+// tiling of their producers.
+func.func @bias_add(%x: tensor<64x128xf32>,
+                    %bias: tensor<128xf32>) -> tensor<64x128xf32> {
+  %0 = linalg.generic {
+    indexing_maps = [#map, #map1, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%x, %bias : tensor<64x128xf32>, tensor<128xf32>)
+    outs(%x : tensor<64x128xf32>) {
+  ^bb0(%in: f32, %b: f32, %o: f32):
+    %1 = arith.addf %in, %b : f32
+    linalg.yield %1 : f32
+  } -> tensor<64x128xf32>
+  return %0 : tensor<64x128xf32>
+}
+
+// CHECK-LABEL: func.func @bias_add(
+// CHECK-NOT: scf.forall
+// CHECK: linalg.generic
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d0)>
+
+// The rows are not a multiple of the tile.
+func.func @rmsnorm_odd_rows(%x: tensor<40x64xf32>) -> tensor<40x64xf32> {
+  %cst = arith.constant 0.0 : f32
+  %0 = tensor.empty() : tensor<40xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<40xf32>) -> tensor<40xf32>
+  %2 = linalg.generic {
+    indexing_maps = [#map, #map1],
+    iterator_types = ["parallel", "reduction"]}
+    ins(%x : tensor<40x64xf32>) outs(%1 : tensor<40xf32>) {
+  ^bb0(%in: f32, %acc: f32):
+    %4 = arith.mulf %in, %in : f32
+    %5 = arith.addf %4, %acc : f32
+    linalg.yield %5 : f32
+  } -> tensor<40xf32>
+  %3 = linalg.generic {
+    indexing_maps = [#map, #map1, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%x, %2 : tensor<40x64xf32>, tensor<40xf32>)
+    outs(%x : tensor<40x64xf32>) {
+  ^bb0(%in: f32, %sq: f32, %o: f32):
+    %4 = math.rsqrt %sq : f32
+    %5 = arith.mulf %in, %4 : f32
+    linalg.yield %5 : f32
+  } -> tensor<40x64xf32>
+  return %3 : tensor<40x64xf32>
+}
+
+// CHECK-LABEL: func.func @rmsnorm_odd_rows(
+// CHECK-NOT: scf.forall
+// CHECK: linalg.generic
+// CHECK: linalg.generic
@@ -0,0 +1,108 @@
+// RUN: tpp-opt %s -fuse-rotary-embedding="tile-rows=32" -split-input-file | FileCheck %s
+
+#pairs = affine_map<(d0, d1, d2) -> (d0, d1, 0)>
+#pairs1 = affine_map<(d0, d1, d2) -> (d0, d1, 1)>
+#angles = affine_map<(d0, d1, d2) -> (d0, d1)>
+#id = affine_map<(d0, d1, d2) -> (d0, d1, d2)>
+
+// The queries of 64 positions are projected and rotated by the constant
+// angles of their positions.
+func.func @rope_queries(%h: tensor<64x32xf32>,
+                        %wq: tensor<32x64xf32>) -> tensor<64x32x2xf32> {
+  %zero = arith.constant 0.0 : f32
+  %angles = arith.constant dense<0.5> : tensor<64x32xf32>
+  %0 = tensor.empty() : tensor<64x64xf32>
+  %1 = linalg.fill ins(%zero : f32) outs(%0 : tensor<64x64xf32>) -> tensor<64x64xf32>
+  %q = linalg.matmul ins(%h, %wq : tensor<64x32xf32>, tensor<32x64xf32>)
+                     outs(%1 : tensor<64x64xf32>) -> tensor<64x64xf32>
+  %pairs = tensor.expand_shape %q [[0], [1, 2]] output_shape [64, 32, 2]
+    : tensor<64x64xf32> into tensor<64x32x2xf32>
+  %2 = tensor.empty() : tensor<64x32x2xf32>
+  %3 = linalg.generic {
+    indexing_maps = [#pairs, #pairs1, #angles, #id],
+    iterator_types = ["parallel", "parallel", "parallel"]}
+    ins(%pairs, %pairs, %angles : tensor<64x32x2xf32>, tensor<64x32x2xf32>, tensor<64x32xf32>)
+    outs(%2 : tensor<64x32x2xf32>) {
+  ^bb0(%x0: f32, %x1: f32, %angle: f32, %out: f32):
+    %cos = math.cos %angle : f32
+    %sin = math.sin %angle : f32
+    %x0c = arith.mulf %x0, %cos : f32
+    %x1s = arith.mulf %x1, %sin : f32
+    %r0 = arith.subf %x0c, %x1s : f32
+    %x0s = arith.mulf %x0, %sin : f32
+    %x1c = arith.mulf %x1, %cos : f32
+    %r1 = arith.addf %x0s, %x1c : f32
+    %i = linalg.index 2 : index
+    %c0 = arith.constant 0 : index
+    %first = arith.cmpi eq, %i, %c0 : index
+    %r = arith.select %first, %r0, %r1 : f32
+    linalg.yield %r : f32
+  } -> tensor<64x32x2xf32>
+  return %3 : tensor<64x32x2xf32>
+}
+
+// CHECK-LABEL: func.func @rope_queries(
+// CHECK-SAME:  %[[H:[^:]+]]: tensor<64x32xf32>, %[[WQ:[^:]+]]: tensor<32x64xf32>
+// CHECK-DAG: %[[COS:.+]] = arith.constant dense<{{.+}}> : tensor<64x32xf32>
+// CHECK-DAG: %[[SIN:.+]] = arith.constant dense<{{.+}}> : tensor<64x32xf32>
+// CHECK-NOT: linalg.matmul
+// CHECK: %[[RES:.+]] = scf.forall (%[[BLOCK:.+]]) in (2) shared_outs(%[[OUT:.+]] = %{{.+}})
+// CHECK:   %[[H_BLOCK:.+]] = tensor.extract_slice %[[H]]{{.*}} to tensor<32x32xf32>
+// CHECK:   %[[ROWS:.+]] = linalg.matmul ins(%[[H_BLOCK]], %[[WQ]] : tensor<32x32xf32>, tensor<32x64xf32>)
+// CHECK:   %[[PAIRS:.+]] = tensor.expand_shape %[[ROWS]] {{\[}}[0], [1, 2]] {{.*}} into tensor<32x32x2xf32>
+// CHECK:   %[[OUT_BLOCK:.+]] = tensor.extract_slice %[[OUT]]{{.*}} to tensor<32x32x2xf32>
+// CHECK:   %[[COS_BLOCK:.+]] = tensor.extract_slice %[[COS]]{{.*}} to tensor<32x32xf32>
+// CHECK:   %[[SIN_BLOCK:.+]] = tensor.extract_slice %[[SIN]]{{.*}} to tensor<32x32xf32>
+// CHECK:   %[[ROTATED:.+]] = linalg.generic
+// CHECK-SAME: ins(%[[PAIRS]], %[[PAIRS]], %[[COS_BLOCK]], %[[SIN_BLOCK]]
+// CHECK-SAME: outs(%[[OUT_BLOCK]]
+// CHECK-NOT:   math.cos
+// CHECK-NOT:   math.sin
+// CHECK:   scf.forall.in_parallel
+// CHECK:     tensor.parallel_insert_slice %[[ROTATED]] into %[[OUT]]
+// CHECK: } {fused_rotary_embedding}
+// CHECK: return %[[RES]]
+
+// -----
+
+#pairs = affine_map<(d0, d1, d2) -> (d0, d1, 0)>
+#pairs1 = affine_map<(d0, d1, d2) -> (d0, d1, 1)>
+#angles = affine_map<(d0, d1, d2) -> (d0, d1)>
+#id = affine_map<(d0, d1, d2) -> (d0, d1, d2)>
+
+// The keys are not computed here, only the tables are folded.
+func.func @rope_keys(%k: tensor<64x32x2xf32>) -> tensor<64x32x2xf32> {
+  %angles = arith.constant dense<0.5> : tensor<64x32xf32>
+  %0 = tensor.empty() : tensor<64x32x2xf32>
+  %1 = linalg.generic {
+    indexing_maps = [#pairs, #pairs1, #angles, #id],
+    iterator_types = ["parallel", "parallel", "parallel"]}
+    ins(%k, %k, %angles : tensor<64x32x2xf32>, tensor<64x32x2xf32>, tensor<64x32xf32>)
+    outs(%0 : tensor<64x32x2xf32>) {
+  ^bb0(%x0: f32, %x1: f32, %angle: f32, %out: f32):
+    %cos = math.cos %angle : f32
+    %sin = math.sin %angle : f32
+    %x0c = arith.mulf %x0, %cos : f32
+    %x1s = arith.mulf %x1, %sin : f32
+    %r0 = arith.subf %x0c, %x1s : f32
+    %x0s = arith.mulf %x0, %sin : f32
+    %x1c = arith.mulf %x1, %cos : f32
+    %r1 = arith.addf %x1c, %x0s : f32
+    %i = linalg.index 2 : index
+    %c1 = arith.constant 1 : index
+    %second = arith.cmpi eq, %i, %c1 : index
+    %r = arith.select %second, %r1, %r0 : f32
+    linalg.yield %r : f32
+  } -> tensor<64x32x2xf32>
+  return %1 : tensor<64x32x2xf32>
+}
+
+// CHECK-LABEL: func.func @rope_keys(
+// CHECK-SAME:  %[[K:[^:]+]]: tensor<64x32x2xf32>
+// CHECK-DAG: %[[COS:.+]] = arith.constant dense<{{.+}}> : tensor<64x32xf32>
+// CHECK-DAG: %[[SIN:.+]] = arith.constant dense<{{.+}}> : tensor<64x32xf32>
+// CHECK-NOT: scf.forall
+// CHECK: linalg.generic
+// CHECK-SAME: ins(%[[K]], %[[K]], %[[COS]], %[[SIN]]
+// CHECK-NOT: math.cos
+// CHECK: return
@@ -0,0 +1,145 @@
+// RUN: tpp-opt %s -fuse-top-k="vocab-block=256" -split-input-file | FileCheck %s
+
+#mapA = affine_map<(d0, d1, d2) -> (d0, d2)>
+#mapB = affine_map<(d0, d1, d2) -> (d2, d1)>
+#mapC = affine_map<(d0, d1, d2) -> (d0, d1)>
+#id = affine_map<(d0, d1) -> (d0, d1)>
+#col = affine_map<(d0, d1) -> (d1)>
+#row = affine_map<(d0, d1) -> (d0)>
+
+// Greedy decoding: the next token is the argmax of the biased logits of the
+// language model head.
+func.func @lm_head_argmax(%h: tensor<2x64xf32>, %w: tensor<64x1000xf32>,
+                          %bias: tensor<1000xf32>) -> tensor<2xi32> {
+  %zero = arith.constant 0.0 : f32
+  %ninf = arith.constant 0xFF800000 : f32
+  %c0 = arith.constant 0 : i32
+  %0 = tensor.empty() : tensor<2x1000xf32>
+  %1 = linalg.fill ins(%zero : f32) outs(%0 : tensor<2x1000xf32>) -> tensor<2x1000xf32>
+  %2 = linalg.generic {
+    indexing_maps = [#mapA, #mapB, #mapC],
+    iterator_types = ["parallel", "parallel", "reduction"]}
+    ins(%h, %w : tensor<2x64xf32>, tensor<64x1000xf32>)
+    outs(%1 : tensor<2x1000xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %m = arith.mulf %in, %in_0 : f32
+    %a = arith.addf %out, %m : f32
+    linalg.yield %a : f32
+  } -> tensor<2x1000xf32>
+  %3 = linalg.generic {
+    indexing_maps = [#col, #id],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%bias : tensor<1000xf32>) outs(%2 : tensor<2x1000xf32>) {
+  ^bb0(%in: f32, %out: f32):
+    %a = arith.addf %in, %out : f32
+    linalg.yield %a : f32
+  } -> tensor<2x1000xf32>
+  %4 = tensor.empty() : tensor<2xf32>
+  %5 = linalg.fill ins(%ninf : f32) outs(%4 : tensor<2xf32>) -> tensor<2xf32>
+  %6 = tensor.empty() : tensor<2xi32>
+  %7 = linalg.fill ins(%c0 : i32) outs(%6 : tensor<2xi32>) -> tensor<2xi32>
+  %8:2 = linalg.generic {
+    indexing_maps = [#id, #row, #row],
+    iterator_types = ["parallel", "reduction"]}
+    ins(%3 : tensor<2x1000xf32>) outs(%5, %7 : tensor<2xf32>, tensor<2xi32>) {
+  ^bb0(%in: f32, %max: f32, %idx: i32):
+    %i = linalg.index 1 : index
+    %ii = arith.index_cast %i : index to i32
+    %gt = arith.cmpf ogt, %in, %max : f32
+    %nmax = arith.select %gt, %in, %max : f32
+    %nidx = arith.select %gt, %ii, %idx : i32
+    linalg.yield %nmax, %nidx : f32, i32
+  } -> (tensor<2xf32>, tensor<2xi32>)
+  return %8#1 : tensor<2xi32>
+}
+
+// CHECK-DAG: #[[OFFSET:.+]] = affine_map<(d0) -> (d0 * 256)>
+// CHECK-DAG: #[[PARTS:.+]] = affine_map<(d0, d1) -> (d1, d0)>
+// CHECK-DAG: #[[ROWS:.+]] = affine_map<(d0, d1) -> (d0)>
+// CHECK-LABEL: func.func @lm_head_argmax(
+// CHECK-SAME:  %[[H:[^:]+]]: tensor<2x64xf32>, %[[W:[^:]+]]: tensor<64x1000xf32>, %[[BIAS:[^:]+]]: tensor<1000xf32>
+// CHECK-NOT: linalg.generic
+// CHECK: %[[MAXINIT:.+]] = linalg.fill {{.*}} -> tensor<2xf32>
+// CHECK: %[[IDXINIT:.+]] = linalg.fill {{.*}} -> tensor<2xi32>
+// CHECK: %[[PMAX:.+]] = tensor.empty() : tensor<4x2xf32>
+// CHECK: %[[PIDX:.+]] = tensor.empty() : tensor<4x2xi32>
+// CHECK: %[[BLOCKS:.+]]:2 = scf.forall (%[[BLK:.+]]) in (3)
+// CHECK-SAME:  shared_outs(%[[MAXS:.+]] = %[[PMAX]], %[[IDXS:.+]] = %[[PIDX]])
+// CHECK:   %[[OFF:.+]] = affine.apply #[[OFFSET]](%[[BLK]])
+// CHECK:   %[[WBLK:.+]] = tensor.extract_slice %[[W]][0, %[[OFF]]] [64, 256] [1, 1]
+// CHECK:   %[[ACC:.+]] = linalg.fill {{.*}} -> tensor<2x256xf32>
+// CHECK:   %[[LOGITS:.+]] = linalg.generic {{.*}} ins(%[[H]], %[[WBLK]] : tensor<2x64xf32>, tensor<64x256xf32>) outs(%[[ACC]] : tensor<2x256xf32>)
+// CHECK:   %[[BBLK:.+]] = tensor.extract_slice %[[BIAS]][%[[OFF]]] [256] [1]
+// CHECK:   %[[BIASED:.+]] = linalg.generic {{.*}} ins(%[[BBLK]] : tensor<256xf32>) outs(%[[LOGITS]] : tensor<2x256xf32>)
+// CHECK:   %[[ARG:.+]]:2 = linalg.generic {{.*}} ins(%[[BIASED]] : tensor<2x256xf32>) outs(%[[MAXINIT]], %[[IDXINIT]] : tensor<2xf32>, tensor<2xi32>)
+// CHECK:     linalg.index 1
+// CHECK:   %[[SHIFT:.+]] = arith.index_cast %[[OFF]] : index to i32
+// CHECK:   %[[IDX:.+]] = linalg.generic {{.*}} ins(%[[ARG]]#1 : tensor<2xi32>)
+// CHECK:     arith.addi %{{.+}}, %[[SHIFT]] : i32
+// CHECK:   tensor.parallel_insert_slice %[[ARG]]#0 into %[[MAXS]][%[[BLK]], 0] [1, 2] [1, 1]
+// CHECK:   tensor.parallel_insert_slice %[[IDX]] into %[[IDXS]][%[[BLK]], 0] [1, 2] [1, 1]
+// CHECK: } {fused_top_k}
+// CHECK: tensor.extract_slice %[[W]][0, 768] [64, 232] [1, 1]
+// CHECK: %[[LAST:.+]]:2 = linalg.generic {{.*}} outs(%[[MAXINIT]], %[[IDXINIT]] : tensor<2xf32>, tensor<2xi32>)
+// CHECK: %[[LASTIDX:.+]] = linalg.generic {{.*}} ins(%[[LAST]]#1 : tensor<2xi32>)
+// CHECK: %[[ALLMAX:.+]] = tensor.insert_slice %[[LAST]]#0 into %[[BLOCKS]]#0[3, 0] [1, 2] [1, 1]
+// CHECK: %[[ALLIDX:.+]] = tensor.insert_slice %[[LASTIDX]] into %[[BLOCKS]]#1[3, 0] [1, 2] [1, 1]
+// CHECK: %[[RES:.+]]:2 = linalg.generic
+// CHECK-SAME:  indexing_maps = [#[[PARTS]], #[[PARTS]], #[[ROWS]], #[[ROWS]]]
+// CHECK-SAME:  ins(%[[ALLMAX]], %[[ALLIDX]] : tensor<4x2xf32>, tensor<4x2xi32>) outs(%[[MAXINIT]], %[[IDXINIT]] : tensor<2xf32>, tensor<2xi32>)
+// CHECK-NEXT: ^bb0(%[[INMAX:[^:]+]]: f32, %[[INIDX:[^:]+]]: i32, %[[MAX:[^:]+]]: f32, %[[ACCIDX:[^:]+]]: i32):
+// CHECK-NOT:   linalg.index
+// CHECK:   %[[GT:.+]] = arith.cmpf ogt, %[[INMAX]], %[[MAX]] : f32
+// CHECK:   %[[NMAX:.+]] = arith.select %[[GT]], %[[INMAX]], %[[MAX]] : f32
+// CHECK:   %[[NIDX:.+]] = arith.select %[[GT]], %[[INIDX]], %[[ACCIDX]] : i32
+// CHECK:   linalg.yield %[[NMAX]], %[[NIDX]]
+// CHECK: return %[[RES]]#1
+
+// -----
+
+#mapA = affine_map<(d0, d1, d2) -> (d0, d2)>
+#mapB = affine_map<(d0, d1, d2) -> (d2, d1)>
+#mapC = affine_map<(d0, d1, d2) -> (d0, d1)>
+#id = affine_map<(d0, d1) -> (d0, d1)>
+#row = affine_map<(d0, d1) -> (d0)>
+
+// The logits are returned as well, they are materialized anyway.
+func.func @logits_used(%h: tensor<1x64xf32>, %w: tensor<64x1024xf32>)
+    -> (tensor<1x1024xf32>, tensor<1xi64>) {
+  %zero = arith.constant 0.0 : f32
+  %c0 = arith.constant 0 : i64
+  %0 = tensor.empty() : tensor<1x1024xf32>
+  %1 = linalg.fill ins(%zero : f32) outs(%0 : tensor<1x1024xf32>) -> tensor<1x1024xf32>
+  %2 = linalg.generic {
+    indexing_maps = [#mapA, #mapB, #mapC],
+    iterator_types = ["parallel", "parallel", "reduction"]}
+    ins(%h, %w : tensor<1x64xf32>, tensor<64x1024xf32>)
+    outs(%1 : tensor<1x1024xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %m = arith.mulf %in, %in_0 : f32
+    %a = arith.addf %out, %m : f32
+    linalg.yield %a : f32
+  } -> tensor<1x1024xf32>
+  %3 = tensor.empty() : tensor<1xf32>
+  %4 = linalg.fill ins(%zero : f32) outs(%3 : tensor<1xf32>) -> tensor<1xf32>
+  %5 = tensor.empty() : tensor<1xi64>
+  %6 = linalg.fill ins(%c0 : i64) outs(%5 : tensor<1xi64>) -> tensor<1xi64>
+  %7:2 = linalg.generic {
+    indexing_maps = [#id, #row, #row],
+    iterator_types = ["parallel", "reduction"]}
+    ins(%2 : tensor<1x1024xf32>) outs(%4, %6 : tensor<1xf32>, tensor<1xi64>) {
+  ^bb0(%in: f32, %max: f32, %idx: i64):
+    %i = linalg.index 1 : index
+    %ii = arith.index_cast %i : index to i64
+    %gt = arith.cmpf ogt, %in, %max : f32
+    %nmax = arith.maximumf %in, %max : f32
+    %nidx = arith.select %gt, %ii, %idx : i64
+    linalg.yield %nmax, %nidx : f32, i64
+  } -> (tensor<1xf32>, tensor<1xi64>)
+  return %2, %7#1 : tensor<1x1024xf32>, tensor<1xi64>
+}
+
+// CHECK-LABEL: func.func @logits_used(
+// CHECK-NOT: scf.forall
+// CHECK: linalg.index 1
+// CHECK: return
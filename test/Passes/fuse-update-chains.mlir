@@ -0,0 +1,120 @@
+// RUN: tpp-opt %s -fold-into-eltwise="fuse-update-chains" -split-input-file | FileCheck %s
+
+// SGD with momentum: v' = mu * v + g, w' = w - lr * v'
+func.func @sgd_momentum(%w: tensor<64x32xf32>, %g: tensor<64x32xf32>,
+    %v: tensor<64x32xf32>, %mu: tensor<f32>, %lr: tensor<f32>)
+    -> (tensor<64x32xf32>, tensor<64x32xf32>) {
+  %e = tensor.empty() : tensor<64x32xf32>
+  %mub = linalg.broadcast ins(%mu : tensor<f32>) outs(%e : tensor<64x32xf32>) dimensions = [0, 1]
+  %0 = linalg.mul ins(%mub, %v : tensor<64x32xf32>, tensor<64x32xf32>)
+                  outs(%e : tensor<64x32xf32>) -> tensor<64x32xf32>
+  %1 = linalg.add ins(%0, %g : tensor<64x32xf32>, tensor<64x32xf32>)
+                  outs(%e : tensor<64x32xf32>) -> tensor<64x32xf32>
+  %lrb = linalg.broadcast ins(%lr : tensor<f32>) outs(%e : tensor<64x32xf32>) dimensions = [0, 1]
+  %2 = linalg.mul ins(%lrb, %1 : tensor<64x32xf32>, tensor<64x32xf32>)
+                  outs(%e : tensor<64x32xf32>) -> tensor<64x32xf32>
+  %3 = linalg.sub ins(%w, %2 : tensor<64x32xf32>, tensor<64x32xf32>)
+                  outs(%e : tensor<64x32xf32>) -> tensor<64x32xf32>
+  return %3, %1 : tensor<64x32xf32>, tensor<64x32xf32>
+}
+
+// CHECK-LABEL: @sgd_momentum(
+// CHECK-NOT: linalg.broadcast
+// CHECK: %[[UPDATE:.+]]:2 = linalg.generic
+// CHECK: arith.mulf
+// CHECK: arith.addf
+// CHECK: arith.mulf
+// CHECK: arith.subf
+// CHECK: linalg.yield
+// CHECK-NOT: linalg.generic
+// CHECK: return %[[UPDATE]]#{{[01]}}, %[[UPDATE]]#{{[01]}}
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+
+// Adam: m' = b1 * m + (1 - b1) * g, v' = b2 * v + (1 - b2) * g * g,
+//       w' = w - lr * m' / (sqrt(v') + eps)
+func.func @adam(%w: tensor<64x32xf32>, %g: tensor<64x32xf32>,
+    %m: tensor<64x32xf32>, %v: tensor<64x32xf32>)
+    -> (tensor<64x32xf32>, tensor<64x32xf32>, tensor<64x32xf32>) {
+  %b1 = arith.constant 0.9 : f32
+  %b1c = arith.constant 0.1 : f32
+  %b2 = arith.constant 0.999 : f32
+  %b2c = arith.constant 0.001 : f32
+  %lr = arith.constant 0.001 : f32
+  %eps = arith.constant 1.0e-08 : f32
+  %e = tensor.empty() : tensor<64x32xf32>
+  %0 = linalg.generic {indexing_maps = [#map, #map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%m, %g : tensor<64x32xf32>, tensor<64x32xf32>)
+    outs(%e : tensor<64x32xf32>) {
+    ^bb0(%in: f32, %in_1: f32, %out: f32):
+      %5 = arith.mulf %b1, %in : f32
+      %6 = arith.mulf %b1c, %in_1 : f32
+      %7 = arith.addf %5, %6 : f32
+      linalg.yield %7 : f32
+  } -> tensor<64x32xf32>
+  %1 = linalg.generic {indexing_maps = [#map, #map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%v, %g : tensor<64x32xf32>, tensor<64x32xf32>)
+    outs(%e : tensor<64x32xf32>) {
+    ^bb0(%in: f32, %in_1: f32, %out: f32):
+      %5 = arith.mulf %b2, %in : f32
+      %6 = arith.mulf %in_1, %in_1 : f32
+      %7 = arith.mulf %b2c, %6 : f32
+      %8 = arith.addf %5, %7 : f32
+      linalg.yield %8 : f32
+  } -> tensor<64x32xf32>
+  %2 = linalg.generic {indexing_maps = [#map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%1 : tensor<64x32xf32>) outs(%e : tensor<64x32xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      %5 = math.sqrt %in : f32
+      %6 = arith.addf %5, %eps : f32
+      linalg.yield %6 : f32
+  } -> tensor<64x32xf32>
+  %3 = linalg.div ins(%0, %2 : tensor<64x32xf32>, tensor<64x32xf32>)
+                  outs(%e : tensor<64x32xf32>) -> tensor<64x32xf32>
+  %4 = linalg.generic {indexing_maps = [#map, #map, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%w, %3 : tensor<64x32xf32>, tensor<64x32xf32>)
+    outs(%e : tensor<64x32xf32>) {
+    ^bb0(%in: f32, %in_1: f32, %out: f32):
+      %5 = arith.mulf %lr, %in_1 : f32
+      %6 = arith.subf %in, %5 : f32
+      linalg.yield %6 : f32
+  } -> tensor<64x32xf32>
+  return %4, %0, %1 : tensor<64x32xf32>, tensor<64x32xf32>, tensor<64x32xf32>
+}
+
+// CHECK-LABEL: @adam(
+// CHECK-NOT: linalg.div
+// CHECK: %[[UPDATE:.+]]:3 = linalg.generic
+// CHECK: math.sqrt
+// CHECK: arith.divf
+// CHECK: arith.subf
+// CHECK: linalg.yield
+// CHECK-NOT: linalg.generic
+// CHECK: return %[[UPDATE]]#{{[0-2]}}, %[[UPDATE]]#{{[0-2]}}, %[[UPDATE]]#{{[0-2]}}
+
+// -----
+
+// The epilogues of the contractions are not update chains.
+func.func @matmul_epilogue(%arg0: tensor<64x32xf32>, %arg1: tensor<32x64xf32>,
+    %arg2: tensor<64x64xf32>) -> tensor<64x64xf32> {
+  %e = tensor.empty() : tensor<64x64xf32>
+  %0 = linalg.matmul ins(%arg0, %arg1 : tensor<64x32xf32>, tensor<32x64xf32>)
+                     outs(%arg2 : tensor<64x64xf32>) -> tensor<64x64xf32>
+  %1 = linalg.add ins(%0, %arg2 : tensor<64x64xf32>, tensor<64x64xf32>)
+                  outs(%e : tensor<64x64xf32>) -> tensor<64x64xf32>
+  %2 = linalg.mul ins(%1, %arg2 : tensor<64x64xf32>, tensor<64x64xf32>)
+                  outs(%e : tensor<64x64xf32>) -> tensor<64x64xf32>
+  return %2 : tensor<64x64xf32>
+}
+
+// CHECK-LABEL: @matmul_epilogue(
+// CHECK: linalg.matmul
+// CHECK: linalg.add
+// CHECK: linalg.mul
+// CHECK-NOT: linalg.generic
@@ -0,0 +1,97 @@
+// RUN: tpp-opt %s -group-expert-matmuls="tile-m=32 tile-n=32" -split-input-file | FileCheck %s
+
+// The tokens are sorted by expert, expert %e multiplies the rows
+// [offsets[%e], offsets[%e + 1]) by its weights.
+func.func @moe_experts(%tokens: tensor<128x64xf32>,
+                       %weights: tensor<4x64x64xf32>,
+                       %offsets: tensor<5xi32>) -> tensor<128x64xf32> {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c4 = arith.constant 4 : index
+  %zero = arith.constant 0.0 : f32
+  %0 = tensor.empty() : tensor<128x64xf32>
+  %1 = linalg.fill ins(%zero : f32) outs(%0 : tensor<128x64xf32>) -> tensor<128x64xf32>
+  %2 = scf.for %e = %c0 to %c4 step %c1 iter_args(%out = %1) -> (tensor<128x64xf32>) {
+    %e1 = arith.addi %e, %c1 : index
+    %s = tensor.extract %offsets[%e] : tensor<5xi32>
+    %t = tensor.extract %offsets[%e1] : tensor<5xi32>
+    %start = arith.index_cast %s : i32 to index
+    %end = arith.index_cast %t : i32 to index
+    %rows = arith.subi %end, %start : index
+    %x = tensor.extract_slice %tokens[%start, 0] [%rows, 64] [1, 1]
+      : tensor<128x64xf32> to tensor<?x64xf32>
+    %w = tensor.extract_slice %weights[%e, 0, 0] [1, 64, 64] [1, 1, 1]
+      : tensor<4x64x64xf32> to tensor<64x64xf32>
+    %empty = tensor.empty(%rows) : tensor<?x64xf32>
+    %acc = linalg.fill ins(%zero : f32) outs(%empty : tensor<?x64xf32>) -> tensor<?x64xf32>
+    %y = linalg.matmul ins(%x, %w : tensor<?x64xf32>, tensor<64x64xf32>)
+                       outs(%acc : tensor<?x64xf32>) -> tensor<?x64xf32>
+    %r = tensor.insert_slice %y into %out[%start, 0] [%rows, 64] [1, 1]
+      : tensor<?x64xf32> into tensor<128x64xf32>
+    scf.yield %r : tensor<128x64xf32>
+  }
+  return %2 : tensor<128x64xf32>
+}
+
+// CHECK-LABEL: func.func @moe_experts(
+// CHECK-SAME:  %[[TOKENS:[^:]+]]: tensor<128x64xf32>, %[[WEIGHTS:[^:]+]]: tensor<4x64x64xf32>, %[[OFFSETS:[^:]+]]: tensor<5xi32>
+// CHECK: %[[FILL:.+]] = linalg.fill
+// CHECK: %[[PREFIX:.+]]:2 = scf.for
+// CHECK:   arith.ceildivsi
+// CHECK:   tensor.insert
+// CHECK: %[[RES:.+]] = scf.forall (%[[TILE:.+]], %[[COL:.+]]) in (8, 2) shared_outs(%[[OUT:.+]] = %[[FILL]])
+// CHECK:   %[[EXPERT:.+]] = scf.for
+// CHECK:   %[[PANEL:.+]] = tensor.extract_slice %[[WEIGHTS]][%[[EXPERT]], 0, %{{.+}}] [1, 64, 32] [1, 1, 1]
+// CHECK-SAME: tensor<4x64x64xf32> to tensor<64x32xf32>
+// CHECK:   %[[TILE_RES:.+]] = scf.if
+// CHECK:     tensor.extract_slice %[[TOKENS]]{{.*}} to tensor<32x64xf32>
+// CHECK:     linalg.matmul ins(%{{.+}}, %[[PANEL]] : tensor<32x64xf32>, tensor<64x32xf32>)
+// CHECK:   } else {
+// CHECK:     tensor.pad
+// CHECK:     linalg.matmul ins(%{{.+}}, %[[PANEL]] : tensor<32x64xf32>, tensor<64x32xf32>)
+// CHECK:   }
+// CHECK:   %[[ROWS_RES:.+]] = tensor.extract_slice %[[TILE_RES]][0, 0] [%{{.+}}, 32] [1, 1]
+// CHECK:   scf.forall.in_parallel
+// CHECK:     tensor.parallel_insert_slice %[[ROWS_RES]] into %[[OUT]]
+// CHECK: } {grouped_experts}
+// CHECK: return %[[RES]]
+
+// -----
+
+// Every expert reads the weights of the first one, it is not a grouped
+// matmul.
+func.func @same_weights(%tokens: tensor<128x64xf32>,
+                        %weights: tensor<4x64x64xf32>,
+                        %offsets: tensor<5xi32>) -> tensor<128x64xf32> {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c4 = arith.constant 4 : index
+  %zero = arith.constant 0.0 : f32
+  %0 = tensor.empty() : tensor<128x64xf32>
+  %1 = linalg.fill ins(%zero : f32) outs(%0 : tensor<128x64xf32>) -> tensor<128x64xf32>
+  %2 = scf.for %e = %c0 to %c4 step %c1 iter_args(%out = %1) -> (tensor<128x64xf32>) {
+    %e1 = arith.addi %e, %c1 : index
+    %s = tensor.extract %offsets[%e] : tensor<5xi32>
+    %t = tensor.extract %offsets[%e1] : tensor<5xi32>
+    %start = arith.index_cast %s : i32 to index
+    %end = arith.index_cast %t : i32 to index
+    %rows = arith.subi %end, %start : index
+    %x = tensor.extract_slice %tokens[%start, 0] [%rows, 64] [1, 1]
+      : tensor<128x64xf32> to tensor<?x64xf32>
+    %w = tensor.extract_slice %weights[0, 0, 0] [1, 64, 64] [1, 1, 1]
+      : tensor<4x64x64xf32> to tensor<64x64xf32>
+    %empty = tensor.empty(%rows) : tensor<?x64xf32>
+    %acc = linalg.fill ins(%zero : f32) outs(%empty : tensor<?x64xf32>) -> tensor<?x64xf32>
+    %y = linalg.matmul ins(%x, %w : tensor<?x64xf32>, tensor<64x64xf32>)
+                       outs(%acc : tensor<?x64xf32>) -> tensor<?x64xf32>
+    %r = tensor.insert_slice %y into %out[%start, 0] [%rows, 64] [1, 1]
+      : tensor<?x64xf32> into tensor<128x64xf32>
+    scf.yield %r : tensor<128x64xf32>
+  }
+  return %2 : tensor<128x64xf32>
+}
+
+// CHECK-LABEL: func.func @same_weights(
+// CHECK-NOT: scf.forall
+// CHECK: scf.for
+// CHECK: linalg.matmul
@@ -0,0 +1,108 @@
+// RUN: tpp-opt %s -group-xsmm-invokes -split-input-file | FileCheck %s
+
+func.func @group_brgemm(%arg0: memref<4x8x32x32xf32>, %arg1: memref<4x8x32x32xf32>,
+                        %arg2: memref<4x4x32x32xf32>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c4 = arith.constant 4 : index
+  %c8_i64 = arith.constant 8 : i64
+  %0 = xsmm.brgemm.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024] flags = (none) data_type = f32
+  scf.parallel (%i) = (%c0) to (%c4) step (%c1) {
+    scf.for %j = %c0 to %c4 step %c1 {
+      %subA = memref.subview %arg0[%i, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+        : memref<4x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+      %subB = memref.subview %arg1[%j, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+        : memref<4x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+      %subC = memref.subview %arg2[%i, %j, 0, 0] [1, 1, 32, 32] [1, 1, 1, 1]
+        : memref<4x4x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
+      xsmm.brgemm(data_type = f32, %0, %subA, %subB, %subC, %c8_i64)
+        : (i64, memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>,
+           memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>,
+           memref<32x32xf32, strided<[32, 1], offset: ?>>, i64) -> ()
+    }
+    scf.reduce
+  }
+  return
+}
+
+// CHECK-LABEL: group_brgemm
+// CHECK-SAME: %[[ARG0:.+]]: memref<4x8x32x32xf32>, %[[ARG1:.+]]: memref<4x8x32x32xf32>, %[[ARG2:.+]]: memref<4x4x32x32xf32>
+// CHECK-DAG: %[[C8:.+]] = arith.constant 8 : i64
+// CHECK: %[[DIS:.+]] = xsmm.brgemm.dispatch
+// CHECK: scf.parallel
+// CHECK-NEXT: %[[DESCS:.+]] = memref.alloca() : memref<4x3xi64>
+// CHECK: scf.for %[[J:.+]] =
+// CHECK: %[[SUBA:.+]] = memref.subview %[[ARG0]]
+// CHECK: %[[SUBB:.+]] = memref.subview %[[ARG1]]
+// CHECK: %[[SUBC:.+]] = memref.subview %[[ARG2]]
+// CHECK-NOT: xsmm.brgemm(
+// CHECK: %{{.+}}, %[[OFFA:.+]], %{{.+}}:3, %{{.+}}:3 = memref.extract_strided_metadata %[[SUBA]]
+// CHECK: %[[OFFA_I64:.+]] = arith.index_cast %[[OFFA]] : index to i64
+// CHECK: memref.store %[[OFFA_I64]], %[[DESCS]]
+// CHECK: memref.extract_strided_metadata %[[SUBB]]
+// CHECK: memref.store
+// CHECK: memref.extract_strided_metadata %[[SUBC]]
+// CHECK: memref.store
+// CHECK: }
+// CHECK-NEXT: xsmm.brgemm_grouped(data_type = f32, %[[DIS]], %[[ARG0]], %[[ARG1]], %[[ARG2]], %[[DESCS]], %[[C8]])
+
+// -----
+
+// The side effect of the fill would be reordered with the brgemms.
+func.func @no_group_side_effect(%arg0: memref<4x8x32x32xf32>, %arg1: memref<4x8x32x32xf32>,
+                                %arg2: memref<4x32x32xf32>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c4 = arith.constant 4 : index
+  %c8_i64 = arith.constant 8 : i64
+  %cst = arith.constant 0.0 : f32
+  %0 = xsmm.brgemm.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024] flags = (none) data_type = f32
+  scf.for %j = %c0 to %c4 step %c1 {
+    %subA = memref.subview %arg0[%j, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+      : memref<4x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    %subB = memref.subview %arg1[%j, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+      : memref<4x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    %subC = memref.subview %arg2[%j, 0, 0] [1, 32, 32] [1, 1, 1]
+      : memref<4x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
+    linalg.fill ins(%cst : f32) outs(%subC : memref<32x32xf32, strided<[32, 1], offset: ?>>)
+    xsmm.brgemm(data_type = f32, %0, %subA, %subB, %subC, %c8_i64)
+      : (i64, memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>,
+         memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>,
+         memref<32x32xf32, strided<[32, 1], offset: ?>>, i64) -> ()
+  }
+  return
+}
+
+// CHECK-LABEL: no_group_side_effect
+// CHECK-NOT: xsmm.brgemm_grouped
+// CHECK: scf.for
+// CHECK: xsmm.brgemm(
+
+// -----
+
+// The kernel is dispatched inside the loop.
+func.func @no_group_dispatch_in_loop(%arg0: memref<4x8x32x32xf32>, %arg1: memref<4x8x32x32xf32>,
+                                     %arg2: memref<4x32x32xf32>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c4 = arith.constant 4 : index
+  %c8_i64 = arith.constant 8 : i64
+  scf.for %j = %c0 to %c4 step %c1 {
+    %0 = xsmm.brgemm.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024] flags = (none) data_type = f32
+    %subA = memref.subview %arg0[%j, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+      : memref<4x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    %subB = memref.subview %arg1[%j, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+      : memref<4x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    %subC = memref.subview %arg2[%j, 0, 0] [1, 32, 32] [1, 1, 1]
+      : memref<4x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
+    xsmm.brgemm(data_type = f32, %0, %subA, %subB, %subC, %c8_i64)
+      : (i64, memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>,
+         memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>,
+         memref<32x32xf32, strided<[32, 1], offset: ?>>, i64) -> ()
+  }
+  return
+}
+
+// CHECK-LABEL: no_group_dispatch_in_loop
+// CHECK-NOT: xsmm.brgemm_grouped
+// CHECK: xsmm.brgemm(
@@ -0,0 +1,66 @@
+// RUN: tpp-opt %s -split-input-file -pack-int4-weights | FileCheck %s
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d0 floordiv 2, d1)>
+
+func.func @int4_group_wise() -> tensor<2x4xf32> {
+  %cst = arith.constant dense<[[1, 2, 3, 4], [-1, -2, 7, -8]]> : tensor<2x4xi4>
+  %scales = arith.constant dense<[[0.5, 0.5, 0.5, 0.5]]> : tensor<1x4xf32>
+  %zeros = arith.constant dense<[[1.0, 1.0, 1.0, 1.0]]> : tensor<1x4xf32>
+  %0 = tensor.empty() : tensor<2x4xf32>
+  %1 = linalg.generic {
+      indexing_maps = [#map, #map1, #map1, #map],
+      iterator_types = ["parallel", "parallel"]}
+      ins(%cst, %scales, %zeros : tensor<2x4xi4>, tensor<1x4xf32>, tensor<1x4xf32>)
+      outs(%0 : tensor<2x4xf32>) {
+    ^bb0(%in: i4, %scale: f32, %zero: f32, %out: f32):
+      %2 = arith.sitofp %in : i4 to f32
+      %3 = arith.subf %2, %zero : f32
+      %4 = arith.mulf %3, %scale : f32
+      linalg.yield %4 : f32
+  } -> tensor<2x4xf32>
+  return %1 : tensor<2x4xf32>
+}
+
+// Two elements per byte, the even ones in the low nibble.
+// CHECK-DAG: #[[$NIBBLE:.+]] = affine_map<(d0, d1) -> (d0, d1 floordiv 2)>
+// CHECK-LABEL: func.func @int4_group_wise(
+// CHECK: %[[BYTES:.+]] = arith.constant dense<{{\[}}[33, 67], [-17, -121]]> : tensor<2x2xi8>
+// CHECK: linalg.generic
+// CHECK-SAME:  indexing_maps = [#[[$NIBBLE]],
+// CHECK-SAME:  ins(%[[BYTES]], %{{.+}}, %{{.+}} : tensor<2x2xi8>, tensor<1x4xf32>, tensor<1x4xf32>)
+// CHECK: ^bb0(%[[BYTE:.+]]: i8,
+// CHECK: %[[IDX:.+]] = linalg.index 1
+// CHECK: %[[REM:.+]] = arith.remui %[[IDX]]
+// CHECK: %[[ODD:.+]] = arith.cmpi ne, %[[REM]]
+// CHECK: %[[HIGH:.+]] = arith.shrsi %[[BYTE]]
+// CHECK: %[[SHL:.+]] = arith.shli %[[BYTE]]
+// CHECK: %[[LOW:.+]] = arith.shrsi %[[SHL]]
+// CHECK: %[[SEL:.+]] = arith.select %[[ODD]], %[[HIGH]], %[[LOW]] : i8
+// CHECK: %[[NIB:.+]] = arith.trunci %[[SEL]] : i8 to i4
+// CHECK: arith.sitofp %[[NIB]] : i4 to f32
+// CHECK: arith.subf
+// CHECK: arith.mulf
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+
+func.func @int4_argument(%arg0: tensor<2x4xi4>) -> tensor<2x4xf32> {
+  %0 = tensor.empty() : tensor<2x4xf32>
+  %1 = linalg.generic {
+      indexing_maps = [#map, #map],
+      iterator_types = ["parallel", "parallel"]}
+      ins(%arg0 : tensor<2x4xi4>) outs(%0 : tensor<2x4xf32>) {
+    ^bb0(%in: i4, %out: f32):
+      %2 = arith.sitofp %in : i4 to f32
+      linalg.yield %2 : f32
+  } -> tensor<2x4xf32>
+  return %1 : tensor<2x4xf32>
+}
+
+// Weights that are not constant are left as is.
+// CHECK-LABEL: func.func @int4_argument(
+// CHECK: linalg.generic
+// CHECK-SAME:  ins(%{{.+}} : tensor<2x4xi4>)
+// CHECK-NOT: linalg.index
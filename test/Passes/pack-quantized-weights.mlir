@@ -0,0 +1,66 @@
+// RUN: tpp-opt %s -split-input-file -pack-quantized-weights | FileCheck %s
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d1)>
+
+func.func @pack_int8_per_channel(%arg0: tensor<256x128xi8>,
+    %arg1: tensor<128xf32>) -> tensor<4x8x32x32xf32> {
+  %0 = tensor.empty() : tensor<256x128xf32>
+  %1 = linalg.generic {
+      indexing_maps = [#map, #map1, #map],
+      iterator_types = ["parallel", "parallel"]}
+      ins(%arg0, %arg1 : tensor<256x128xi8>, tensor<128xf32>)
+      outs(%0 : tensor<256x128xf32>) {
+    ^bb0(%in: i8, %scale: f32, %out: f32):
+      %2 = arith.sitofp %in : i8 to f32
+      %3 = arith.mulf %2, %scale : f32
+      linalg.yield %3 : f32
+  } -> tensor<256x128xf32>
+  %4 = tensor.empty() : tensor<4x8x32x32xf32>
+  %pack = tensor.pack %1 outer_dims_perm = [1, 0] inner_dims_pos = [0, 1]
+    inner_tiles = [32, 32] into %4 : tensor<256x128xf32> -> tensor<4x8x32x32xf32>
+  return %pack : tensor<4x8x32x32xf32>
+}
+
+// The integers are packed, the scales are read at the unpacked column.
+// CHECK-DAG: #[[$ID:.+]] = affine_map<(d0, d1, d2, d3) -> (d0, d1, d2, d3)>
+// CHECK-DAG: #[[$SCALE:.+]] = affine_map<(d0, d1, d2, d3) -> (d0 * 32 + d3)>
+// CHECK-LABEL: func.func @pack_int8_per_channel(
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<256x128xi8>, %[[ARG1:.+]]: tensor<128xf32>
+// CHECK: %[[QBUF:.+]] = tensor.empty() : tensor<4x8x32x32xi8>
+// CHECK: %[[PACK:.+]] = tensor.pack %[[ARG0]] outer_dims_perm = [1, 0] inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %[[QBUF]]
+// CHECK-SAME:  : tensor<256x128xi8> -> tensor<4x8x32x32xi8>
+// CHECK: linalg.generic
+// CHECK-SAME:  indexing_maps = [#[[$ID]], #[[$SCALE]], #[[$ID]]]
+// CHECK-SAME:  ins(%[[PACK]], %[[ARG1]] : tensor<4x8x32x32xi8>, tensor<128xf32>)
+// CHECK: arith.sitofp
+// CHECK: arith.mulf
+// CHECK-NOT: tensor.pack
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d0, d1)>
+
+func.func @pack_float_input(%arg0: tensor<256x128xf32>,
+    %arg1: tensor<256x128xf32>) -> tensor<4x8x32x32xf32> {
+  %0 = tensor.empty() : tensor<256x128xf32>
+  %1 = linalg.generic {
+      indexing_maps = [#map, #map1, #map],
+      iterator_types = ["parallel", "parallel"]}
+      ins(%arg0, %arg1 : tensor<256x128xf32>, tensor<256x128xf32>)
+      outs(%0 : tensor<256x128xf32>) {
+    ^bb0(%in: f32, %scale: f32, %out: f32):
+      %3 = arith.mulf %in, %scale : f32
+      linalg.yield %3 : f32
+  } -> tensor<256x128xf32>
+  %4 = tensor.empty() : tensor<4x8x32x32xf32>
+  %pack = tensor.pack %1 outer_dims_perm = [1, 0] inner_dims_pos = [0, 1]
+    inner_tiles = [32, 32] into %4 : tensor<256x128xf32> -> tensor<4x8x32x32xf32>
+  return %pack : tensor<4x8x32x32xf32>
+}
+
+// Not a dequantization, the floats are packed.
+// CHECK-LABEL: func.func @pack_float_input(
+// CHECK: linalg.generic
+// CHECK: tensor.pack {{.+}} : tensor<256x128xf32> -> tensor<4x8x32x32xf32>
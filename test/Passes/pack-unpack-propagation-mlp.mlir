@@ -0,0 +1,58 @@
+// RUN: tpp-opt %s -propagate-pack-and-unpack -simplify-pack -canonicalize | FileCheck %s
+
+#map = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d2, d3, d5)>
+#map1 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d1, d2, d5, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d1, d3, d4)>
+
+// Two FC layers with named bias and relu: the activations stay blocked
+// between the layers.
+func.func @mlp_named_bias_relu(%arg0: tensor<128x256xf32>, %arg1: tensor<256x256xf32>,
+    %arg2: tensor<256xf32>, %arg3: tensor<256x256xf32>,
+    %arg4: tensor<128x256xf32>) -> tensor<128x256xf32> {
+  %cst = arith.constant 0.000000e+00 : f32
+  %0 = tensor.empty() : tensor<4x8x32x32xf32>
+  %pack = tensor.pack %arg0 inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %0 : tensor<128x256xf32> -> tensor<4x8x32x32xf32>
+  %1 = tensor.empty() : tensor<8x8x32x32xf32>
+  %pack_0 = tensor.pack %arg1 outer_dims_perm = [1, 0] inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %1 : tensor<256x256xf32> -> tensor<8x8x32x32xf32>
+  %pack_1 = tensor.pack %arg4 inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %0 : tensor<128x256xf32> -> tensor<4x8x32x32xf32>
+  %2 = linalg.generic {indexing_maps = [#map, #map1, #map2], iterator_types = ["parallel", "parallel", "reduction", "parallel", "parallel", "reduction"]} ins(%pack, %pack_0 : tensor<4x8x32x32xf32>, tensor<8x8x32x32xf32>) outs(%pack_1 : tensor<4x8x32x32xf32>) {
+    ^bb0(%in: f32, %in_2: f32, %out: f32):
+      %9 = arith.mulf %in, %in_2 : f32
+      %10 = arith.addf %out, %9 : f32
+      linalg.yield %10 : f32
+  } -> tensor<4x8x32x32xf32>
+  %unpack = tensor.unpack %2 inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %arg4 : tensor<4x8x32x32xf32> -> tensor<128x256xf32>
+  %3 = tensor.empty() : tensor<128x256xf32>
+  %broadcasted = linalg.broadcast ins(%arg2 : tensor<256xf32>) outs(%3 : tensor<128x256xf32>) dimensions = [0]
+  %4 = linalg.add ins(%broadcasted, %unpack : tensor<128x256xf32>, tensor<128x256xf32>) outs(%3 : tensor<128x256xf32>) -> tensor<128x256xf32>
+  %5 = linalg.fill ins(%cst : f32) outs(%3 : tensor<128x256xf32>) -> tensor<128x256xf32>
+  %6 = linalg.max ins(%4, %5 : tensor<128x256xf32>, tensor<128x256xf32>) outs(%3 : tensor<128x256xf32>) -> tensor<128x256xf32>
+  %pack_3 = tensor.pack %6 inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %0 : tensor<128x256xf32> -> tensor<4x8x32x32xf32>
+  %pack_4 = tensor.pack %arg3 outer_dims_perm = [1, 0] inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %1 : tensor<256x256xf32> -> tensor<8x8x32x32xf32>
+  %pack_5 = tensor.pack %arg4 inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %0 : tensor<128x256xf32> -> tensor<4x8x32x32xf32>
+  %7 = linalg.generic {indexing_maps = [#map, #map1, #map2], iterator_types = ["parallel", "parallel", "reduction", "parallel", "parallel", "reduction"]} ins(%pack_3, %pack_4 : tensor<4x8x32x32xf32>, tensor<8x8x32x32xf32>) outs(%pack_5 : tensor<4x8x32x32xf32>) {
+    ^bb0(%in: f32, %in_2: f32, %out: f32):
+      %9 = arith.mulf %in, %in_2 : f32
+      %10 = arith.addf %out, %9 : f32
+      linalg.yield %10 : f32
+  } -> tensor<4x8x32x32xf32>
+  %unpack_6 = tensor.unpack %7 inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %arg4 : tensor<4x8x32x32xf32> -> tensor<128x256xf32>
+  return %unpack_6 : tensor<128x256xf32>
+}
+
+// CHECK-LABEL: func.func @mlp_named_bias_relu(
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<128x256xf32>, %[[ARG1:.+]]: tensor<256x256xf32>,
+// CHECK-SAME:  %[[ARG2:.+]]: tensor<256xf32>, %[[ARG3:.+]]: tensor<256x256xf32>,
+// CHECK-SAME:  %[[ARG4:.+]]: tensor<128x256xf32>)
+// CHECK: %[[MM0:.+]] = linalg.generic {{.+}}"reduction"
+// CHECK-NOT: tensor.unpack
+// CHECK: tensor.pack %[[ARG2]] inner_dims_pos = [0] inner_tiles = [32] {{.+}} : tensor<256xf32> -> tensor<8x32xf32>
+// CHECK-NOT: tensor.unpack
+// CHECK: %[[ADD:.+]] = linalg.generic {{.+}} ins(%{{.+}}, %[[MM0]] : tensor<4x8x32x32xf32>, tensor<4x8x32x32xf32>)
+// CHECK-NOT: tensor.unpack
+// CHECK: %[[RELU:.+]] = linalg.generic {{.+}} ins(%[[ADD]], %{{.+}} : tensor<4x8x32x32xf32>, tensor<4x8x32x32xf32>)
+// CHECK-NOT: tensor.unpack
+// CHECK: %[[MM1:.+]] = linalg.generic {{.+}} ins(%[[RELU]], %{{.+}} : tensor<4x8x32x32xf32>, tensor<8x8x32x32xf32>)
+// CHECK: %[[OUT:.+]] = tensor.unpack %[[MM1]]
+// CHECK-NOT: tensor.unpack
+// CHECK: return %[[OUT]]
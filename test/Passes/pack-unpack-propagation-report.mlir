@@ -0,0 +1,38 @@
+// RUN: tpp-opt %s -propagate-pack-and-unpack="report-residual=true" -split-input-file -verify-diagnostics
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d0)>
+
+// The row reduction of the softmax reduces a blocked dimension.
+func.func @unpack_into_reduction(%arg0: tensor<4x8x32x32xf32>, %arg1: tensor<128x256xf32>,
+    %arg2: tensor<128xf32>) -> tensor<128xf32> {
+  // expected-remark @below {{residual layout conversion into 'linalg.generic': reduction over a blocked dimension}}
+  %unpack = tensor.unpack %arg0 inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %arg1 : tensor<4x8x32x32xf32> -> tensor<128x256xf32>
+  %0 = linalg.generic {indexing_maps = [#map, #map1], iterator_types = ["parallel", "reduction"]} ins(%unpack : tensor<128x256xf32>) outs(%arg2 : tensor<128xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      %1 = arith.addf %in, %out : f32
+      linalg.yield %1 : f32
+  } -> tensor<128xf32>
+  return %0 : tensor<128xf32>
+}
+
+// -----
+
+// Layers blocked with different factors convert between them.
+func.func @repack_other_layout(%arg0: tensor<4x8x32x32xf32>, %arg1: tensor<128x256xf32>) -> tensor<4x4x32x64xf32> {
+  // expected-remark @below {{residual layout conversion into 'tensor.pack': repacked into a different layout}}
+  %unpack = tensor.unpack %arg0 inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %arg1 : tensor<4x8x32x32xf32> -> tensor<128x256xf32>
+  %0 = tensor.empty() : tensor<4x4x32x64xf32>
+  %pack = tensor.pack %unpack inner_dims_pos = [0, 1] inner_tiles = [32, 64] into %0 : tensor<128x256xf32> -> tensor<4x4x32x64xf32>
+  return %pack : tensor<4x4x32x64xf32>
+}
+
+// -----
+
+// The pair folds away, nothing is reported.
+func.func @repack_same_layout(%arg0: tensor<4x8x32x32xf32>, %arg1: tensor<128x256xf32>) -> tensor<4x8x32x32xf32> {
+  %unpack = tensor.unpack %arg0 inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %arg1 : tensor<4x8x32x32xf32> -> tensor<128x256xf32>
+  %0 = tensor.empty() : tensor<4x8x32x32xf32>
+  %pack = tensor.pack %unpack inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %0 : tensor<128x256xf32> -> tensor<4x8x32x32xf32>
+  return %pack : tensor<4x8x32x32xf32>
+}
@@ -0,0 +1,69 @@
+// RUN: tpp-opt %s --convert-allocs-to-scratch --split-input-file | FileCheck %s
+// RUN: tpp-opt %s --convert-allocs-to-scratch="min-alloca-bytes=0" --split-input-file | FileCheck %s --check-prefix=ALLOCA
+
+func.func @parallel_pack(%arg0: memref<8x32x32xf32>, %arg1: memref<8x32x32xf32>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c8 = arith.constant 8 : index
+  scf.parallel (%arg2) = (%c0) to (%c8) step (%c1) {
+    %subview = memref.subview %arg0[%arg2, 0, 0] [1, 32, 32] [1, 1, 1] : memref<8x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
+    %subview_0 = memref.subview %arg1[%arg2, 0, 0] [1, 32, 32] [1, 1, 1] : memref<8x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
+    %alloc = memref.alloc() {alignment = 64 : i64} : memref<32x32xf32>
+    linalg.transpose ins(%subview : memref<32x32xf32, strided<[32, 1], offset: ?>>) outs(%alloc : memref<32x32xf32>) permutation = [1, 0]
+    %alloca = memref.alloca() : memref<32xf32>
+    linalg.copy ins(%alloc : memref<32x32xf32>) outs(%subview_0 : memref<32x32xf32, strided<[32, 1], offset: ?>>)
+    memref.dealloc %alloc : memref<32x32xf32>
+    scf.reduce
+  }
+  return
+}
+
+// CHECK-DAG: func.func private @tpp_scratch_mark() -> i64
+// CHECK-DAG: func.func private @tpp_scratch_get(i64) -> memref<?xi8> attributes {llvm.emit_c_interface}
+// CHECK-DAG: func.func private @tpp_scratch_reset(i64)
+// CHECK-LABEL: func.func @parallel_pack(
+// CHECK: scf.parallel
+// CHECK:   %[[MARK:.+]] = func.call @tpp_scratch_mark() : () -> i64
+// CHECK:   %[[BYTES:.+]] = arith.constant 4096 : i64
+// CHECK:   %[[SCRATCH:.+]] = func.call @tpp_scratch_get(%[[BYTES]]) : (i64) -> memref<?xi8>
+// CHECK:   %[[C0:.+]] = arith.constant 0 : index
+// CHECK:   %[[BUF:.+]] = memref.view %[[SCRATCH]][%[[C0]]][] : memref<?xi8> to memref<32x32xf32>
+// CHECK:   linalg.transpose ins(%{{.+}} : {{.+}}) outs(%[[BUF]] : memref<32x32xf32>)
+// CHECK:   memref.alloca() : memref<32xf32>
+// CHECK:   linalg.copy ins(%[[BUF]] : memref<32x32xf32>)
+// CHECK-NOT: memref.dealloc
+// CHECK:   func.call @tpp_scratch_reset(%[[MARK]]) : (i64) -> ()
+// CHECK-NEXT: scf.reduce
+
+// ALLOCA-LABEL: func.func @parallel_pack(
+// ALLOCA: %[[MARK:.+]] = func.call @tpp_scratch_mark()
+// ALLOCA-COUNT-2: func.call @tpp_scratch_get
+// ALLOCA-NOT: memref.alloc
+// ALLOCA: func.call @tpp_scratch_reset(%[[MARK]])
+
+// -----
+
+// The buffers outside of the parallel loops, with a dynamic shape or kept
+// after the iteration are left alone.
+func.func @not_scratch(%arg0: memref<8x32xf32>, %arg1: index) -> memref<32xf32> {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c8 = arith.constant 8 : index
+  %alloc = memref.alloc() : memref<32xf32>
+  scf.parallel (%arg2) = (%c0) to (%c8) step (%c1) {
+    %alloc_0 = memref.alloc(%arg1) : memref<?xf32>
+    memref.dealloc %alloc_0 : memref<?xf32>
+    %alloc_1 = memref.alloc() : memref<32xf32>
+    %subview = memref.subview %arg0[%arg2, 0] [1, 32] [1, 1] : memref<8x32xf32> to memref<32xf32, strided<[1], offset: ?>>
+    linalg.copy ins(%subview : memref<32xf32, strided<[1], offset: ?>>) outs(%alloc_1 : memref<32xf32>)
+    scf.reduce
+  }
+  return %alloc : memref<32xf32>
+}
+
+// CHECK-LABEL: func.func @not_scratch(
+// CHECK-NOT: tpp_scratch
+// CHECK: memref.alloc() : memref<32xf32>
+// CHECK: memref.alloc(%{{.+}}) : memref<?xf32>
+// CHECK: memref.alloc() : memref<32xf32>
+// CHECK-NOT: tpp_scratch
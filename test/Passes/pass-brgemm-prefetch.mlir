@@ -0,0 +1,48 @@
+// RUN: tpp-opt %s --brgemm-prefetch="distance=2" --canonicalize --split-input-file | FileCheck %s
+
+func.func @brgemm(%arg0: memref<16x32x64xf32>, %arg1: memref<16x64x64xf32>, %arg2: memref<32x64xf32>) {
+  %cst = arith.constant 0.000000e+00 : f32
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c4 = arith.constant 4 : index
+  %c16 = arith.constant 16 : index
+  %c32 = arith.constant 32 : index
+  %c64 = arith.constant 64 : index
+  scf.for %arg3 = %c0 to %c32 step %c4 {
+    %subview = memref.subview %arg2[%arg3, 0] [4, 64] [1, 1] : memref<32x64xf32> to memref<4x64xf32, strided<[64, 1], offset: ?>>
+    %0 = vector.transfer_read %subview[%c0, %c0], %cst {in_bounds = [true, true]} : memref<4x64xf32, strided<[64, 1], offset: ?>>, vector<4x64xf32>
+    %1 = scf.for %arg4 = %c0 to %c16 step %c1 iter_args(%arg5 = %0) -> (vector<4x64xf32>) {
+      %2 = scf.for %arg6 = %c0 to %c64 step %c1 iter_args(%arg7 = %arg5) -> (vector<4x64xf32>) {
+        %subview_0 = memref.subview %arg0[%arg4, %arg3, %arg6] [1, 4, 1] [1, 1, 1] : memref<16x32x64xf32> to memref<1x4x1xf32, strided<[2048, 64, 1], offset: ?>>
+        %subview_1 = memref.subview %arg1[%arg4, %arg6, 0] [1, 1, 64] [1, 1, 1] : memref<16x64x64xf32> to memref<1x1x64xf32, strided<[4096, 64, 1], offset: ?>>
+        %3 = vector.transfer_read %subview_0[%c0, %c0, %c0], %cst {in_bounds = [true, true, true]} : memref<1x4x1xf32, strided<[2048, 64, 1], offset: ?>>, vector<1x4x1xf32>
+        %4 = vector.transfer_read %subview_1[%c0, %c0, %c0], %cst {in_bounds = [true, true, true]} : memref<1x1x64xf32, strided<[4096, 64, 1], offset: ?>>, vector<1x1x64xf32>
+        %5 = vector.contract {indexing_maps = [affine_map<(d0, d1, d2, d3) -> (d0, d1, d3)>, affine_map<(d0, d1, d2, d3) -> (d0, d3, d2)>, affine_map<(d0, d1, d2, d3) -> (d1, d2)>], iterator_types = ["reduction", "parallel", "parallel", "reduction"], kind = #vector.kind<add>} %3, %4, %arg7 : vector<1x4x1xf32>, vector<1x1x64xf32> into vector<4x64xf32>
+        scf.yield %5 : vector<4x64xf32>
+      }
+      scf.yield %2 : vector<4x64xf32>
+    }
+    vector.transfer_write %1, %subview[%c0, %c0] {in_bounds = [true, true]} : vector<4x64xf32>, memref<4x64xf32, strided<[64, 1], offset: ?>>
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @brgemm(
+// CHECK-SAME:  %[[ARG0:.+]]: memref<16x32x64xf32>, %[[ARG1:.+]]: memref<16x64x64xf32>, %[[ARG2:.+]]: memref<32x64xf32>
+// CHECK-DAG: %[[C15:.+]] = arith.constant 15 : index
+// CHECK-DAG: %[[C2:.+]] = arith.constant 2 : index
+// CHECK: scf.for %[[M:.+]] =
+// CHECK:   scf.for %[[B:.+]] = {{.+}} iter_args
+// CHECK:     %[[AHEAD:.+]] = arith.addi %[[B]], %[[C2]] : index
+// CHECK:     %[[NEXT:.+]] = arith.minsi %[[AHEAD]], %[[C15]] : index
+// CHECK:     scf.for %[[K:.+]] = {{.+}} iter_args
+// CHECK:       memref.prefetch %[[ARG0]][%[[NEXT]], %[[M]], %[[K]]], read, locality<3>, data
+// CHECK:       %[[M1:.+]] = arith.addi %[[M]], %{{.+}} : index
+// CHECK:       memref.prefetch %[[ARG0]][%[[NEXT]], %[[M1]], %[[K]]], read, locality<3>, data
+// CHECK-COUNT-2: memref.prefetch %[[ARG0]]
+// CHECK:       memref.subview %[[ARG0]][%[[B]], %[[M]], %[[K]]]
+// CHECK:       memref.prefetch %[[ARG1]][%[[NEXT]], %[[K]], %{{.+}}], read, locality<3>, data
+// CHECK-COUNT-3: memref.prefetch %[[ARG1]]
+// CHECK-NOT:   memref.prefetch
+// CHECK:       memref.subview %[[ARG1]][%[[B]], %[[K]], 0]
+// CHECK:       vector.contract
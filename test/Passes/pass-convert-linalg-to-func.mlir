@@ -39,13 +39,14 @@ func.func @dyn_matmul(%arg0: memref<64x?xf32>, %arg1: memref<?x32xf32>, %arg2: m
 // CHECK: %[[PTR_ARG0:.+]] = memref.extract_aligned_pointer_as_index %[[ARG0]] : memref<64x?xf32> -> index
 // CHECK: %[[PTR_CAST_ARG0:.+]] = arith.index_cast %[[PTR_ARG0]] : index to i64
 // CHECK: %[[LLVM_PTR_ARG0:.+]] = llvm.inttoptr %[[PTR_CAST_ARG0]] : i64 to !llvm.ptr
+// CHECK: %[[LDA:.+]] = memref.dim %[[ARG0]], %[[C1]] : memref<64x?xf32>
 // CHECK: %[[PTR_ARG1:.+]] = memref.extract_aligned_pointer_as_index %[[ARG1]] : memref<?x32xf32> -> index
 // CHECK: %[[PTR_CAST_ARG1:.+]] = arith.index_cast %[[PTR_ARG1]] : index to i64
 // CHECK: %[[LLVM_PTR_ARG1:.+]] = llvm.inttoptr %[[PTR_CAST_ARG1]] : i64 to !llvm.ptr
 // CHECK: %[[PTR_ARG2:.+]] = memref.extract_aligned_pointer_as_index %[[ARG2]] : memref<64x32xf32> -> index
 // CHECK: %[[PTR_CAST_ARG2:.+]] = arith.index_cast %[[PTR_ARG2]] : index to i64
 // CHECK: %[[LLVM_PTR_ARG2:.+]] = llvm.inttoptr %[[PTR_CAST_ARG2]] : i64 to !llvm.ptr
-// CHECK: call @linalg_matmul_blas(%[[C64]], %[[C32]], %[[DIM]], %[[LLVM_PTR_ARG0]], %[[C0]], %[[C64]], %[[LLVM_PTR_ARG1]], %[[C0]], %[[DIM]], %[[LLVM_PTR_ARG2]], %[[C0]], %[[C64]])
+// CHECK: call @linalg_matmul_blas(%[[C64]], %[[C32]], %[[DIM]], %[[LLVM_PTR_ARG0]], %[[C0]], %[[LDA]], %[[LLVM_PTR_ARG1]], %[[C0]], %[[C32]], %[[LLVM_PTR_ARG2]], %[[C0]], %[[C32]])
 
 // -----
 
@@ -57,6 +58,22 @@ func.func @strided_memref(%arg0: memref<64x64xf32, strided<[64, 1], offset: ?>>,
 }
 
 // CHECK-LABEL: strided_memref
+// CHECK-SAME: %[[ARG0:.+]]: memref<64x64xf32, strided<[64, 1], offset: ?>>
+// CHECK-DAG: %[[C64:.+]] = arith.constant 64 : index
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : index
+// CHECK: %{{.+}}, %[[OFFSET:.+]], %{{.+}}:2, %{{.+}}:2 = memref.extract_strided_metadata %[[ARG0]]
+// CHECK: call @linalg_matmul_blas(%[[C64]], %[[C64]], %[[C64]], %{{.+}}, %[[OFFSET]], %[[C64]], %{{.+}}, %[[C0]], %[[C64]], %{{.+}}, %[[C0]], %[[C64]])
+
+// -----
+
+func.func @transposed_memref(%arg0: memref<64x64xf32, strided<[1, 64]>>,
+                             %arg1: memref<64x64xf32>, %arg2: memref<64x64xf32>) {
+  linalg.matmul ins(%arg0, %arg1 : memref<64x64xf32, strided<[1, 64]>>, memref<64x64xf32>)
+                outs(%arg2 : memref<64x64xf32>)
+  return
+}
+
+// CHECK-LABEL: transposed_memref
 // CHECK: linalg.matmul
 // CHECK-NOT: call @linalg_matmul_blas
 
@@ -83,7 +100,7 @@ func.func @static_matmul_2(%arg0: memref<3x4xf32>, %arg1: memref<4x5xf32>, %arg2
 // CHECK: %[[ARG2_PTR:.+]] = memref.extract_aligned_pointer_as_index %[[ARG2]] : memref<3x5xf32> -> index
 // CHECK: %[[ARG2_PTR_CAST:.+]] = arith.index_cast %[[ARG2_PTR]] : index to i64
 // CHECK: %[[ARG2_LLVM_PTR:.+]] = llvm.inttoptr %[[ARG2_PTR_CAST]] : i64 to !llvm.ptr
-// CHECK: call @linalg_matmul_blas(%[[C3]], %[[C5]], %[[C4]], %[[ARG0_LLVM_PTR]], %[[C0]], %[[C3]], %[[ARG1_LLVM_PTR]], %[[C0]], %[[C4]], %[[ARG2_LLVM_PTR]], %[[C0]], %[[C3]])
+// CHECK: call @linalg_matmul_blas(%[[C3]], %[[C5]], %[[C4]], %[[ARG0_LLVM_PTR]], %[[C0]], %[[C4]], %[[ARG1_LLVM_PTR]], %[[C0]], %[[C5]], %[[ARG2_LLVM_PTR]], %[[C0]], %[[C5]])
 
 // -----
 
@@ -120,3 +137,97 @@ func.func @static_matmul_3(%arg0: memref<2048x2048xf32>, %arg1: memref<2048x2048
 // CHECK: %[[ARG2_PTR_CAST:.+]] = arith.index_cast %[[ARG2_PTR]] : index to i64
 // CHECK: %[[ARG2_LLVM_PTR:.+]] = llvm.inttoptr %[[ARG2_PTR_CAST]] : i64 to !llvm.ptr
 // CHECK: call @linalg_matmul_blas(%[[C2048]], %[[C2048]], %[[C2048]], %[[ARG0_LLVM_PTR]], %[[C0]], %[[C2048]], %[[ARG1_LLVM_PTR]], %[[C0]], %[[C2048]], %[[ARG2_LLVM_PTR]], %[[C0]], %[[C2048]])
+
+// -----
+
+func.func @bf16_matmul(%arg0: memref<32x64xbf16>, %arg1: memref<64x16xbf16>, %arg2: memref<32x16xf32>) {
+  linalg.matmul ins(%arg0, %arg1 : memref<32x64xbf16>, memref<64x16xbf16>)
+                outs(%arg2 : memref<32x16xf32>)
+  return
+}
+
+// CHECK-LABEL: bf16_matmul
+// CHECK-DAG: %[[TYPES:.+]] = arith.constant 2 : i64
+// CHECK-DAG: %[[NONE:.+]] = arith.constant 0 : i64
+// CHECK-DAG: %[[C1:.+]] = arith.constant 1 : index
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : index
+// CHECK-DAG: %[[C16:.+]] = arith.constant 16 : index
+// CHECK-DAG: %[[C32:.+]] = arith.constant 32 : index
+// CHECK-DAG: %[[C64:.+]] = arith.constant 64 : index
+// CHECK-DAG: %[[NULL:.+]] = llvm.mlir.zero : !llvm.ptr
+// CHECK: call @linalg_matmul_dnnl(%[[TYPES]], %[[NONE]], %[[C1]], %[[C32]], %[[C16]], %[[C64]],
+// CHECK-SAME: %{{.+}}, %[[C0]], %[[C0]], %[[C64]], %{{.+}}, %[[C0]], %[[C0]], %[[C16]], %{{.+}}, %[[C0]], %[[C0]], %[[C16]], %[[NULL]], %[[C0]])
+
+// -----
+
+func.func @i8_matmul(%arg0: memref<32x64xi8>, %arg1: memref<64x16xi8>, %arg2: memref<32x16xi32>) {
+  linalg.matmul ins(%arg0, %arg1 : memref<32x64xi8>, memref<64x16xi8>)
+                outs(%arg2 : memref<32x16xi32>)
+  return
+}
+
+// CHECK-LABEL: i8_matmul
+// CHECK-DAG: %[[TYPES:.+]] = arith.constant 3 : i64
+// CHECK: call @linalg_matmul_dnnl(%[[TYPES]]
+
+// -----
+
+func.func @batch_matmul(%arg0: memref<4x32x64xf32>, %arg1: memref<4x64x16xf32>, %arg2: memref<4x32x16xf32>) {
+  linalg.batch_matmul ins(%arg0, %arg1 : memref<4x32x64xf32>, memref<4x64x16xf32>)
+                      outs(%arg2 : memref<4x32x16xf32>)
+  return
+}
+
+// CHECK-LABEL: batch_matmul
+// CHECK-DAG: %[[TYPES:.+]] = arith.constant 0 : i64
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : index
+// CHECK-DAG: %[[C4:.+]] = arith.constant 4 : index
+// CHECK-DAG: %[[C16:.+]] = arith.constant 16 : index
+// CHECK-DAG: %[[C32:.+]] = arith.constant 32 : index
+// CHECK-DAG: %[[C64:.+]] = arith.constant 64 : index
+// CHECK-DAG: %[[C512:.+]] = arith.constant 512 : index
+// CHECK-DAG: %[[C1024:.+]] = arith.constant 1024 : index
+// CHECK-DAG: %[[C2048:.+]] = arith.constant 2048 : index
+// CHECK: call @linalg_matmul_dnnl(%[[TYPES]], %[[TYPES]], %[[C4]], %[[C32]], %[[C16]], %[[C64]],
+// CHECK-SAME: %{{.+}}, %[[C0]], %[[C2048]], %[[C64]], %{{.+}}, %[[C0]], %[[C1024]], %[[C16]], %{{.+}}, %[[C0]], %[[C512]], %[[C16]]
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d1)>
+
+func.func @matmul_bias_relu(%arg0: memref<32x64xf32>, %arg1: memref<64x16xf32>,
+                            %arg2: memref<16xf32>, %arg3: memref<32x16xf32>) {
+  %cst = arith.constant 0.0 : f32
+  linalg.matmul ins(%arg0, %arg1 : memref<32x64xf32>, memref<64x16xf32>)
+                outs(%arg3 : memref<32x16xf32>)
+  linalg.generic {
+    indexing_maps = [#map1, #map],
+    iterator_types = ["parallel", "parallel"]}
+    ins(%arg2 : memref<16xf32>) outs(%arg3 : memref<32x16xf32>) {
+    ^bb0(%in: f32, %out: f32):
+      %0 = arith.addf %in, %out : f32
+      linalg.yield %0 : f32
+  }
+  linalg.generic {
+    indexing_maps = [#map],
+    iterator_types = ["parallel", "parallel"]}
+    outs(%arg3 : memref<32x16xf32>) {
+    ^bb0(%out: f32):
+      %0 = arith.maximumf %out, %cst : f32
+      linalg.yield %0 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: matmul_bias_relu
+// CHECK-SAME: %{{.+}}: memref<32x64xf32>, %{{.+}}: memref<64x16xf32>, %[[BIAS:.+]]: memref<16xf32>, %{{.+}}: memref<32x16xf32>
+// CHECK-DAG: %[[TYPES:.+]] = arith.constant 0 : i64
+// CHECK-DAG: %[[POST_OPS:.+]] = arith.constant 3 : i64
+// CHECK: %[[BIAS_PTR:.+]] = memref.extract_aligned_pointer_as_index %[[BIAS]]
+// CHECK: %[[BIAS_PTR_CAST:.+]] = arith.index_cast %[[BIAS_PTR]] : index to i64
+// CHECK: %[[BIAS_LLVM_PTR:.+]] = llvm.inttoptr %[[BIAS_PTR_CAST]] : i64 to !llvm.ptr
+// CHECK: call @linalg_matmul_dnnl(%[[TYPES]], %[[POST_OPS]],
+// CHECK-SAME: %[[BIAS_LLVM_PTR]], %{{.+}})
+// CHECK-NOT: linalg.generic
+// CHECK: return
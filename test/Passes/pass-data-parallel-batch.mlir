@@ -0,0 +1,77 @@
+// RUN: tpp-opt %s --data-parallel-batch="num-ranks=2" --split-input-file | FileCheck %s
+// RUN: tpp-opt %s --data-parallel-batch --split-input-file | FileCheck %s --check-prefix=SINGLE
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d1)>
+
+func.func @mlp(%arg0: tensor<8x16xf32>, %arg1: tensor<16x32xf32>, %arg2: tensor<32xf32>) -> tensor<8x32xf32> {
+  %cst = arith.constant 0.000000e+00 : f32
+  %0 = tensor.empty() : tensor<8x32xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<8x32xf32>) -> tensor<8x32xf32>
+  %2 = linalg.matmul ins(%arg0, %arg1 : tensor<8x16xf32>, tensor<16x32xf32>) outs(%1 : tensor<8x32xf32>) -> tensor<8x32xf32>
+  %3 = linalg.generic {indexing_maps = [#map, #map1, #map], iterator_types = ["parallel", "parallel"]} ins(%2, %arg2 : tensor<8x32xf32>, tensor<32xf32>) outs(%0 : tensor<8x32xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %4 = arith.addf %in, %in_0 : f32
+    %5 = arith.maximumf %4, %cst : f32
+    linalg.yield %5 : f32
+  } -> tensor<8x32xf32>
+  return %3 : tensor<8x32xf32>
+}
+
+// CHECK-DAG: func.func private @tpp_all_gather_f32(memref<*xf32>, memref<*xf32>, i64) attributes {llvm.emit_c_interface}
+// CHECK-DAG: func.func private @tpp_collective_rank() -> i64
+// CHECK-LABEL: func.func @mlp(
+// CHECK-SAME: %[[ARG0:.+]]: tensor<4x16xf32>, %[[ARG1:.+]]: tensor<16x32xf32>, %[[ARG2:.+]]: tensor<32xf32>) -> tensor<8x32xf32>
+// CHECK: %[[RANK64:.+]] = {{.*}}call @tpp_collective_rank() : () -> i64
+// CHECK: %[[RANK:.+]] = arith.index_cast %[[RANK64]] : i64 to index
+// CHECK-NOT: tensor<8x16xf32>
+// CHECK-DAG: %[[ROWS:.+]] = arith.constant 4 : index
+// CHECK-DAG: arith.muli %[[RANK]], %[[ROWS]] : index
+// CHECK-NOT: tensor.extract_slice
+// CHECK: %[[FILL:.+]] = linalg.fill ins(%{{.+}} : f32) outs(%{{.+}} : tensor<4x32xf32>)
+// CHECK: %[[MM:.+]] = linalg.matmul ins(%[[ARG0]], %[[ARG1]] : tensor<4x16xf32>, tensor<16x32xf32>) outs(%[[FILL]] : tensor<4x32xf32>)
+// CHECK: %[[LOCAL:.+]] = linalg.generic {{.+}} ins(%[[MM]], %[[ARG2]] : tensor<4x32xf32>, tensor<32xf32>) outs(%{{.+}} : tensor<4x32xf32>)
+// CHECK: %[[DIM:.+]] = arith.constant 0 : i64
+// CHECK: %[[LBUF:.+]] = bufferization.to_memref %[[LOCAL]] : {{.*}}memref<4x32xf32>
+// CHECK: %[[FULL:.+]] = memref.alloc() {alignment = 64 : i64} : memref<8x32xf32>
+// CHECK: %[[LCAST:.+]] = memref.cast %[[LBUF]] : memref<4x32xf32> to memref<*xf32>
+// CHECK: %[[FCAST:.+]] = memref.cast %[[FULL]] : memref<8x32xf32> to memref<*xf32>
+// CHECK: call @tpp_all_gather_f32(%[[LCAST]], %[[FCAST]], %[[DIM]])
+// CHECK: %[[RES:.+]] = bufferization.to_tensor %[[FULL]] restrict writable
+// CHECK-NOT: linalg.matmul
+// CHECK: return %[[RES]] : tensor<8x32xf32>
+
+// SINGLE-LABEL: func.func @mlp(
+// SINGLE-SAME: tensor<8x16xf32>
+// SINGLE-NOT: tpp_collective_rank
+// SINGLE: linalg.matmul ins(%{{.+}}, %{{.+}} : tensor<8x16xf32>, tensor<16x32xf32>)
+
+// -----
+
+// The weight is a constant and the output is an argument, computed in place.
+func.func @inplace(%arg0: tensor<8x16xf32>, %arg1: tensor<8x32xf32>) -> tensor<8x32xf32> {
+  %cst = arith.constant dense<1.000000e+00> : tensor<16x32xf32>
+  %0 = linalg.matmul ins(%arg0, %cst : tensor<8x16xf32>, tensor<16x32xf32>) outs(%arg1 : tensor<8x32xf32>) -> tensor<8x32xf32>
+  return %0 : tensor<8x32xf32>
+}
+
+// CHECK-LABEL: func.func @inplace(
+// CHECK-SAME: %[[ARG0:.+]]: tensor<4x16xf32>, %[[ARG1:.+]]: tensor<4x32xf32>) -> tensor<8x32xf32>
+// CHECK: %[[CST:.+]] = arith.constant dense<1.000000e+00> : tensor<16x32xf32>
+// CHECK: %[[LOCAL:.+]] = linalg.matmul ins(%[[ARG0]], %[[CST]] : tensor<4x16xf32>, tensor<16x32xf32>) outs(%[[ARG1]] : tensor<4x32xf32>)
+// CHECK: bufferization.to_memref %[[LOCAL]]
+// CHECK: call @tpp_all_gather_f32(
+
+// -----
+
+// The batch does not split evenly over the ranks.
+func.func @uneven(%arg0: tensor<7x16xf32>, %arg1: tensor<16x32xf32>, %arg2: tensor<7x32xf32>) -> tensor<7x32xf32> {
+  %0 = linalg.matmul ins(%arg0, %arg1 : tensor<7x16xf32>, tensor<16x32xf32>) outs(%arg2 : tensor<7x32xf32>) -> tensor<7x32xf32>
+  return %0 : tensor<7x32xf32>
+}
+
+// CHECK-LABEL: func.func @uneven(
+// CHECK-SAME: tensor<7x16xf32>
+// CHECK-NOT: tensor.extract_slice
+// CHECK: linalg.matmul ins(%{{.+}}, %{{.+}} : tensor<7x16xf32>, tensor<16x32xf32>) outs(%{{.+}} : tensor<7x32xf32>)
+// CHECK-NOT: call
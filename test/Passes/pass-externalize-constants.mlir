@@ -0,0 +1,39 @@
+// RUN: tpp-opt %s -externalize-constants="blob-file=%t.blob min-bytes=64" | FileCheck %s
+
+memref.global "private" constant @__constant_2x32xi8 : memref<2x32xi8> = dense<"0x000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F"> {alignment = 64 : i64}
+memref.global "private" constant @__constant_2x32xi8_0 : memref<2x32xi8> = dense<"0x000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F"> {alignment = 64 : i64}
+memref.global "private" constant @__constant_4x8xbf16 : memref<4x8xbf16> = dense<"0x000306090C0F1215181B1E2124272A2D303336393C3F4245484B4E5154575A5D606366696C6F7275787B7E8184878A8D909396999C9FA2A5A8ABAEB1B4B7BABD"> {alignment = 128 : i64}
+memref.global "private" constant @__constant_4xf32 : memref<4xf32> = dense<[1.0, 2.0, 3.0, 4.0]> {alignment = 64 : i64}
+memref.global "private" constant @__constant_32xf32 : memref<32xf32> = dense<1.0> {alignment = 64 : i64}
+
+func.func @weights(%arg0: index, %arg1: memref<32xi8>) -> (memref<2x32xi8>, memref<2x32xi8>, memref<4x8xbf16>, memref<4xf32>, memref<32xf32>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  scf.for %i = %c0 to %arg0 step %c1 {
+    %0 = memref.get_global @__constant_2x32xi8 : memref<2x32xi8>
+    %1 = memref.load %0[%c1, %i] : memref<2x32xi8>
+    memref.store %1, %arg1[%i] : memref<32xi8>
+  }
+  %2 = memref.get_global @__constant_2x32xi8 : memref<2x32xi8>
+  %3 = memref.get_global @__constant_2x32xi8_0 : memref<2x32xi8>
+  %4 = memref.get_global @__constant_4x8xbf16 : memref<4x8xbf16>
+  %5 = memref.get_global @__constant_4xf32 : memref<4xf32>
+  %6 = memref.get_global @__constant_32xf32 : memref<32xf32>
+  return %2, %3, %4, %5, %6 : memref<2x32xi8>, memref<2x32xi8>, memref<4x8xbf16>, memref<4xf32>, memref<32xf32>
+}
+
+// The small and the splat constants stay in the module.
+// CHECK-NOT: memref.global "private" constant @__constant_2x32xi8
+// CHECK-NOT: memref.global "private" constant @__constant_4x8xbf16
+// CHECK-DAG: memref.global "private" constant @__constant_4xf32 : memref<4xf32> = dense<[1.000000e+00, 2.000000e+00, 3.000000e+00, 4.000000e+00]>
+// CHECK-DAG: memref.global "private" constant @__constant_32xf32 : memref<32xf32> = dense<1.000000e+00>
+// CHECK-LABEL: func.func @weights(
+// CHECK-DAG: %[[W:.+]] = perf.map_blob "{{.+}}.blob" offset 64 : memref<2x32xi8>
+// CHECK-DAG: %[[COPY:.+]] = perf.map_blob "{{.+}}.blob" offset 64 : memref<2x32xi8>
+// CHECK-DAG: %[[BF16:.+]] = perf.map_blob "{{.+}}.blob" offset 128 : memref<4x8xbf16>
+// CHECK: scf.for
+// CHECK-NOT: perf.map_blob
+// CHECK:   memref.load %[[W]]
+// CHECK: %[[SMALL:.+]] = memref.get_global @__constant_4xf32
+// CHECK: %[[SPLAT:.+]] = memref.get_global @__constant_32xf32
+// CHECK: return %[[W]], %[[COPY]], %[[BF16]], %[[SMALL]], %[[SPLAT]]
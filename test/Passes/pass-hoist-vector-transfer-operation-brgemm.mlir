@@ -62,19 +62,19 @@ module {
 // CHECK:           %[[VAL_10:.*]] = memref.alloc() {alignment = 64 : i64} : memref<8x24x32x64xf32>
 // CHECK:           scf.forall (%[[VAL_11:.*]], %[[VAL_12:.*]]) in (8, 24) {
 // CHECK:             %[[VAL_13:.*]] = memref.subview %[[VAL_10]]{{\[}}%[[VAL_11]], %[[VAL_12]], 0, 0] [1, 1, 32, 64] [1, 1, 1, 1] : memref<8x24x32x64xf32> to memref<32x64xf32, strided<[64, 1], offset: ?>>
-// CHECK:             vector.transfer_write %[[VAL_2]], %[[VAL_13]]{{\[}}%[[VAL_8]], %[[VAL_8]]] {in_bounds = [true, true]} : vector<32x64xf32>, memref<32x64xf32, strided<[64, 1], offset: ?>>
+// CHECK-NOT:         vector.transfer_write
 // CHECK:             %[[VAL_14:.*]] = memref.subview %[[VAL_0]]{{\[}}%[[VAL_11]], 0, 0, 0] [1, 24, 32, 64] [1, 1, 1, 1] : memref<8x24x32x64xf32> to memref<24x32x64xf32, strided<[2048, 64, 1], offset: ?>>
 // CHECK:             scf.for %[[VAL_15:.*]] = %[[VAL_8]] to %[[VAL_7]] step %[[VAL_6]] {
 // CHECK:               scf.for %[[VAL_16:.*]] = %[[VAL_8]] to %[[VAL_5]] step %[[VAL_5]] {
 // CHECK:                 %[[VAL_17:.*]] = memref.subview %[[VAL_13]]{{\[}}%[[VAL_15]], %[[VAL_16]]] [4, 64] [1, 1] : memref<32x64xf32, strided<[64, 1], offset: ?>> to memref<4x64xf32, strided<[64, 1], offset: ?>>
-// CHECK:                 %[[VAL_18:.*]] = vector.transfer_read %[[VAL_17]]{{\[}}%[[VAL_8]], %[[VAL_8]]], %[[VAL_1]] {in_bounds = [true, true]} : memref<4x64xf32, strided<[64, 1], offset: ?>>, vector<4x64xf32>
+// CHECK:                 %[[VAL_18:.*]] = arith.constant dense<0.000000e+00> : vector<4x64xf32>
 // CHECK:                 %[[VAL_19:.*]] = scf.for %[[VAL_20:.*]] = %[[VAL_8]] to %[[VAL_4]] step %[[VAL_3]] iter_args(%[[VAL_21:.*]] = %[[VAL_18]]) -> (vector<4x64xf32>) {
 // CHECK:                   %[[VAL_22:.*]] = scf.for %[[VAL_23:.*]] = %[[VAL_8]] to %[[VAL_5]] step %[[VAL_3]] iter_args(%[[VAL_24:.*]] = %[[VAL_21]]) -> (vector<4x64xf32>) {
 // CHECK:                     %[[VAL_25:.*]] = memref.subview %[[VAL_14]]{{\[}}%[[VAL_20]], %[[VAL_15]], %[[VAL_23]]] [1, 4, 1] [1, 1, 1] : memref<24x32x64xf32, strided<[2048, 64, 1], offset: ?>> to memref<1x4x1xf32, strided<[2048, 64, 1], offset: ?>>
 // CHECK:                     %[[VAL_26:.*]] = memref.subview %[[VAL_9]]{{\[}}%[[VAL_20]], %[[VAL_23]], %[[VAL_16]]] [1, 1, 64] [1, 1, 1] : memref<24x64x64xf32> to memref<1x1x64xf32, strided<[4096, 64, 1], offset: ?>>
 // CHECK:                     %[[VAL_27:.*]] = vector.transfer_read %[[VAL_25]]{{\[}}%[[VAL_8]], %[[VAL_8]], %[[VAL_8]]], %[[VAL_1]] {in_bounds = [true, true, true]} : memref<1x4x1xf32, strided<[2048, 64, 1], offset: ?>>, vector<1x4x1xf32>
 // CHECK:                     %[[VAL_28:.*]] = vector.transfer_read %[[VAL_26]]{{\[}}%[[VAL_8]], %[[VAL_8]], %[[VAL_8]]], %[[VAL_1]] {in_bounds = [true, true, true]} : memref<1x1x64xf32, strided<[4096, 64, 1], offset: ?>>, vector<1x1x64xf32>
-// CHECK:                     %[[VAL_29:.*]] = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction"], kind = #vector.kind<add>} %4, %5, %arg8 : vector<1x4x1xf32>, vector<1x1x64xf32> into vector<4x64xf32>
+// CHECK:                     %[[VAL_29:.*]] = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction"], kind = #vector.kind<add>} %[[VAL_27]], %[[VAL_28]], %[[VAL_24]] : vector<1x4x1xf32>, vector<1x1x64xf32> into vector<4x64xf32>
 // CHECK:                     scf.yield %[[VAL_29]] : vector<4x64xf32>
 // CHECK:                   }
 // CHECK:                   scf.yield %[[VAL_22]] : vector<4x64xf32>
@@ -190,19 +190,19 @@ module {
 // CHECK:           %[[VAL_9:.*]] = memref.alloc() {alignment = 64 : i64} : memref<8x48x32x32xf32>
 // CHECK:           scf.forall (%[[VAL_10:.*]], %[[VAL_11:.*]]) in (8, 48) {
 // CHECK:             %[[VAL_12:.*]] = memref.subview %[[VAL_9]]{{\[}}%[[VAL_10]], %[[VAL_11]], 0, 0] [1, 1, 32, 32] [1, 1, 1, 1] : memref<8x48x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
-// CHECK:             vector.transfer_write %[[VAL_2]], %[[VAL_12]]{{\[}}%[[VAL_7]], %[[VAL_7]]] {in_bounds = [true, true]} : vector<32x32xf32>, memref<32x32xf32, strided<[32, 1], offset: ?>>
+// CHECK-NOT:         vector.transfer_write
 // CHECK:             %[[VAL_13:.*]] = memref.subview %[[VAL_0]]{{\[}}%[[VAL_10]], 0, 0, 0] [1, 48, 32, 32] [1, 1, 1, 1] : memref<8x48x32x32xf32> to memref<48x32x32xf32, strided<[1024, 32, 1], offset: ?>>
 // CHECK:             scf.for %[[VAL_14:.*]] = %[[VAL_7]] to %[[VAL_6]] step %[[VAL_5]] {
 // CHECK:               scf.for %[[VAL_15:.*]] = %[[VAL_7]] to %[[VAL_6]] step %[[VAL_6]] {
 // CHECK:                 %[[VAL_16:.*]] = memref.subview %[[VAL_12]]{{\[}}%[[VAL_14]], %[[VAL_15]]] [8, 32] [1, 1] : memref<32x32xf32, strided<[32, 1], offset: ?>> to memref<8x32xf32, strided<[32, 1], offset: ?>>
-// CHECK:                 %[[VAL_17:.*]] = vector.transfer_read %[[VAL_16]]{{\[}}%[[VAL_7]], %[[VAL_7]]], %[[VAL_1]] {in_bounds = [true, true]} : memref<8x32xf32, strided<[32, 1], offset: ?>>, vector<8x32xf32>
+// CHECK:                 %[[VAL_17:.*]] = arith.constant dense<0.000000e+00> : vector<8x32xf32>
 // CHECK:                 %[[VAL_18:.*]] = scf.for %[[VAL_19:.*]] = %[[VAL_7]] to %[[VAL_4]] step %[[VAL_3]] iter_args(%[[VAL_20:.*]] = %[[VAL_17]]) -> (vector<8x32xf32>) {
 // CHECK:                   %[[VAL_21:.*]] = scf.for %[[VAL_22:.*]] = %[[VAL_7]] to %[[VAL_6]] step %[[VAL_3]] iter_args(%[[VAL_23:.*]] = %[[VAL_20]]) -> (vector<8x32xf32>) {
 // CHECK:                     %[[VAL_24:.*]] = memref.subview %[[VAL_13]]{{\[}}%[[VAL_19]], %[[VAL_14]], %[[VAL_22]]] [1, 8, 1] [1, 1, 1] : memref<48x32x32xf32, strided<[1024, 32, 1], offset: ?>> to memref<1x8x1xf32, strided<[1024, 32, 1], offset: ?>>
 // CHECK:                     %[[VAL_25:.*]] = memref.subview %[[VAL_8]]{{\[}}%[[VAL_19]], %[[VAL_22]], %[[VAL_15]]] [1, 1, 32] [1, 1, 1] : memref<48x32x32xf32> to memref<1x1x32xf32, strided<[1024, 32, 1], offset: ?>>
 // CHECK:                     %[[VAL_26:.*]] = vector.transfer_read %[[VAL_24]]{{\[}}%[[VAL_7]], %[[VAL_7]], %[[VAL_7]]], %[[VAL_1]] {in_bounds = [true, true, true]} : memref<1x8x1xf32, strided<[1024, 32, 1], offset: ?>>, vector<1x8x1xf32>
 // CHECK:                     %[[VAL_27:.*]] = vector.transfer_read %[[VAL_25]]{{\[}}%[[VAL_7]], %[[VAL_7]], %[[VAL_7]]], %[[VAL_1]] {in_bounds = [true, true, true]} : memref<1x1x32xf32, strided<[1024, 32, 1], offset: ?>>, vector<1x1x32xf32>
-// CHECK:                     %[[VAL_28:.*]] = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction"], kind = #vector.kind<add>} %4, %5, %arg8 : vector<1x8x1xf32>, vector<1x1x32xf32> into vector<8x32xf32> 
+// CHECK:                     %[[VAL_28:.*]] = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction"], kind = #vector.kind<add>} %[[VAL_26]], %[[VAL_27]], %[[VAL_23]] : vector<1x8x1xf32>, vector<1x1x32xf32> into vector<8x32xf32>
 // CHECK:                     scf.yield %[[VAL_28]] : vector<8x32xf32>
 // CHECK:                   }
 // CHECK:                   scf.yield %[[VAL_21]] : vector<8x32xf32>
@@ -214,19 +214,19 @@ module {
 // CHECK:           %[[VAL_29:.*]] = memref.alloc() {alignment = 64 : i64} : memref<8x48x32x32xf32>
 // CHECK:           scf.forall (%[[VAL_30:.*]], %[[VAL_31:.*]]) in (8, 48) {
 // CHECK:             %[[VAL_32:.*]] = memref.subview %[[VAL_29]]{{\[}}%[[VAL_30]], %[[VAL_31]], 0, 0] [1, 1, 32, 32] [1, 1, 1, 1] : memref<8x48x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
-// CHECK:             vector.transfer_write %[[VAL_2]], %[[VAL_32]]{{\[}}%[[VAL_7]], %[[VAL_7]]] {in_bounds = [true, true]} : vector<32x32xf32>, memref<32x32xf32, strided<[32, 1], offset: ?>>
+// CHECK-NOT:         vector.transfer_write
 // CHECK:             %[[VAL_33:.*]] = memref.subview %[[VAL_9]]{{\[}}%[[VAL_30]], 0, 0, 0] [1, 48, 32, 32] [1, 1, 1, 1] : memref<8x48x32x32xf32> to memref<48x32x32xf32, strided<[1024, 32, 1], offset: ?>>
 // CHECK:             scf.for %[[VAL_34:.*]] = %[[VAL_7]] to %[[VAL_6]] step %[[VAL_5]] {
 // CHECK:               scf.for %[[VAL_35:.*]] = %[[VAL_7]] to %[[VAL_6]] step %[[VAL_6]] {
 // CHECK:                 %[[VAL_36:.*]] = memref.subview %[[VAL_32]]{{\[}}%[[VAL_34]], %[[VAL_35]]] [8, 32] [1, 1] : memref<32x32xf32, strided<[32, 1], offset: ?>> to memref<8x32xf32, strided<[32, 1], offset: ?>>
-// CHECK:                 %[[VAL_37:.*]] = vector.transfer_read %[[VAL_36]]{{\[}}%[[VAL_7]], %[[VAL_7]]], %[[VAL_1]] {in_bounds = [true, true]} : memref<8x32xf32, strided<[32, 1], offset: ?>>, vector<8x32xf32>
+// CHECK:                 %[[VAL_37:.*]] = arith.constant dense<0.000000e+00> : vector<8x32xf32>
 // CHECK:                 %[[VAL_38:.*]] = scf.for %[[VAL_39:.*]] = %[[VAL_7]] to %[[VAL_4]] step %[[VAL_3]] iter_args(%[[VAL_40:.*]] = %[[VAL_37]]) -> (vector<8x32xf32>) {
 // CHECK:                   %[[VAL_41:.*]] = scf.for %[[VAL_42:.*]] = %[[VAL_7]] to %[[VAL_6]] step %[[VAL_3]] iter_args(%[[VAL_43:.*]] = %[[VAL_40]]) -> (vector<8x32xf32>) {
 // CHECK:                     %[[VAL_44:.*]] = memref.subview %[[VAL_33]]{{\[}}%[[VAL_39]], %[[VAL_34]], %[[VAL_42]]] [1, 8, 1] [1, 1, 1] : memref<48x32x32xf32, strided<[1024, 32, 1], offset: ?>> to memref<1x8x1xf32, strided<[1024, 32, 1], offset: ?>>
 // CHECK:                     %[[VAL_45:.*]] = memref.subview %[[VAL_8]]{{\[}}%[[VAL_39]], %[[VAL_42]], %[[VAL_35]]] [1, 1, 32] [1, 1, 1] : memref<48x32x32xf32> to memref<1x1x32xf32, strided<[1024, 32, 1], offset: ?>>
 // CHECK:                     %[[VAL_46:.*]] = vector.transfer_read %[[VAL_44]]{{\[}}%[[VAL_7]], %[[VAL_7]], %[[VAL_7]]], %[[VAL_1]] {in_bounds = [true, true, true]} : memref<1x8x1xf32, strided<[1024, 32, 1], offset: ?>>, vector<1x8x1xf32>
 // CHECK:                     %[[VAL_47:.*]] = vector.transfer_read %[[VAL_45]]{{\[}}%[[VAL_7]], %[[VAL_7]], %[[VAL_7]]], %[[VAL_1]] {in_bounds = [true, true, true]} : memref<1x1x32xf32, strided<[1024, 32, 1], offset: ?>>, vector<1x1x32xf32>
-// CHECK:                     %[[VAL_48:.*]] =  vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction"], kind = #vector.kind<add>} %4, %5, %arg8 : vector<1x8x1xf32>, vector<1x1x32xf32> into vector<8x32xf32>
+// CHECK:                     %[[VAL_48:.*]] =  vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction"], kind = #vector.kind<add>} %[[VAL_46]], %[[VAL_47]], %[[VAL_43]] : vector<1x8x1xf32>, vector<1x1x32xf32> into vector<8x32xf32>
 // CHECK:                     scf.yield %[[VAL_48]] : vector<8x32xf32>
 // CHECK:                   }
 // CHECK:                   scf.yield %[[VAL_41]] : vector<8x32xf32>
@@ -237,19 +237,19 @@ module {
 // CHECK:           }
 // CHECK:           scf.forall (%[[VAL_49:.*]], %[[VAL_50:.*]]) in (8, 48) {
 // CHECK:             %[[VAL_51:.*]] = memref.subview %[[VAL_9]]{{\[}}%[[VAL_49]], %[[VAL_50]], 0, 0] [1, 1, 32, 32] [1, 1, 1, 1] : memref<8x48x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
-// CHECK:             vector.transfer_write %[[VAL_2]], %[[VAL_51]]{{\[}}%[[VAL_7]], %[[VAL_7]]] {in_bounds = [true, true]} : vector<32x32xf32>, memref<32x32xf32, strided<[32, 1], offset: ?>>
+// CHECK-NOT:         vector.transfer_write
 // CHECK:             %[[VAL_52:.*]] = memref.subview %[[VAL_29]]{{\[}}%[[VAL_49]], 0, 0, 0] [1, 48, 32, 32] [1, 1, 1, 1] : memref<8x48x32x32xf32> to memref<48x32x32xf32, strided<[1024, 32, 1], offset: ?>>
 // CHECK:             scf.for %[[VAL_53:.*]] = %[[VAL_7]] to %[[VAL_6]] step %[[VAL_5]] {
 // CHECK:               scf.for %[[VAL_54:.*]] = %[[VAL_7]] to %[[VAL_6]] step %[[VAL_6]] {
 // CHECK:                 %[[VAL_55:.*]] = memref.subview %[[VAL_51]]{{\[}}%[[VAL_53]], %[[VAL_54]]] [8, 32] [1, 1] : memref<32x32xf32, strided<[32, 1], offset: ?>> to memref<8x32xf32, strided<[32, 1], offset: ?>>
-// CHECK:                 %[[VAL_56:.*]] = vector.transfer_read %[[VAL_55]]{{\[}}%[[VAL_7]], %[[VAL_7]]], %[[VAL_1]] {in_bounds = [true, true]} : memref<8x32xf32, strided<[32, 1], offset: ?>>, vector<8x32xf32>
+// CHECK:                 %[[VAL_56:.*]] = arith.constant dense<0.000000e+00> : vector<8x32xf32>
 // CHECK:                 %[[VAL_57:.*]] = scf.for %[[VAL_58:.*]] = %[[VAL_7]] to %[[VAL_4]] step %[[VAL_3]] iter_args(%[[VAL_59:.*]] = %[[VAL_56]]) -> (vector<8x32xf32>) {
 // CHECK:                   %[[VAL_60:.*]] = scf.for %[[VAL_61:.*]] = %[[VAL_7]] to %[[VAL_6]] step %[[VAL_3]] iter_args(%[[VAL_62:.*]] = %[[VAL_59]]) -> (vector<8x32xf32>) {
 // CHECK:                     %[[VAL_63:.*]] = memref.subview %[[VAL_52]]{{\[}}%[[VAL_58]], %[[VAL_53]], %[[VAL_61]]] [1, 8, 1] [1, 1, 1] : memref<48x32x32xf32, strided<[1024, 32, 1], offset: ?>> to memref<1x8x1xf32, strided<[1024, 32, 1], offset: ?>>
 // CHECK:                     %[[VAL_64:.*]] = memref.subview %[[VAL_8]]{{\[}}%[[VAL_58]], %[[VAL_61]], %[[VAL_54]]] [1, 1, 32] [1, 1, 1] : memref<48x32x32xf32> to memref<1x1x32xf32, strided<[1024, 32, 1], offset: ?>>
 // CHECK:                     %[[VAL_65:.*]] = vector.transfer_read %[[VAL_63]]{{\[}}%[[VAL_7]], %[[VAL_7]], %[[VAL_7]]], %[[VAL_1]] {in_bounds = [true, true, true]} : memref<1x8x1xf32, strided<[1024, 32, 1], offset: ?>>, vector<1x8x1xf32>
 // CHECK:                     %[[VAL_66:.*]] = vector.transfer_read %[[VAL_64]]{{\[}}%[[VAL_7]], %[[VAL_7]], %[[VAL_7]]], %[[VAL_1]] {in_bounds = [true, true, true]} : memref<1x1x32xf32, strided<[1024, 32, 1], offset: ?>>, vector<1x1x32xf32>
-// CHECK:                     %[[VAL_67:.*]] = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction"], kind = #vector.kind<add>} %4, %5, %arg8 : vector<1x8x1xf32>, vector<1x1x32xf32> into vector<8x32xf32>
+// CHECK:                     %[[VAL_67:.*]] = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction"], kind = #vector.kind<add>} %[[VAL_65]], %[[VAL_66]], %[[VAL_62]] : vector<1x8x1xf32>, vector<1x1x32xf32> into vector<8x32xf32>
 // CHECK:                     scf.yield %[[VAL_67]] : vector<8x32xf32>
 // CHECK:                   }
 // CHECK:                   scf.yield %[[VAL_60]] : vector<8x32xf32>
@@ -306,12 +306,12 @@ module {
 // CHECK:           %[[VAL_5:.*]] = memref.alloc() {alignment = 64 : i64} : memref<8x24x32x64xf32>
 // CHECK:           scf.forall (%[[VAL_6:.*]], %[[VAL_7:.*]]) in (8, 24) {
 // CHECK:             %[[VAL_8:.*]] = memref.subview %[[VAL_5]]{{\[}}%[[VAL_6]], %[[VAL_7]], 0, 0] [1, 1, 32, 64] [1, 1, 1, 1] : memref<8x24x32x64xf32> to memref<32x64xf32, strided<[64, 1], offset: ?>>
-// CHECK:             vector.transfer_write %[[VAL_2]], %[[VAL_8]]{{\[}}%[[VAL_3]], %[[VAL_3]]] {in_bounds = [true, true]} : vector<32x64xf32>, memref<32x64xf32, strided<[64, 1], offset: ?>>
+// CHECK-NOT:         vector.transfer_write
 // CHECK:             %[[VAL_9:.*]] = memref.subview %[[VAL_0]]{{\[}}%[[VAL_6]], 0, 0, 0] [1, 24, 32, 64] [1, 1, 1, 1] : memref<8x24x32x64xf32> to memref<24x32x64xf32, strided<[2048, 64, 1], offset: ?>>
 // CHECK:             %[[VAL_10:.*]] = vector.transfer_read %[[VAL_9]]{{\[}}%[[VAL_3]], %[[VAL_3]], %[[VAL_3]]], %[[VAL_1]] {in_bounds = [true, true, true]} : memref<24x32x64xf32, strided<[2048, 64, 1], offset: ?>>, vector<24x32x64xf32>
 // CHECK:             %[[VAL_11:.*]] = vector.transfer_read %[[VAL_4]]{{\[}}%[[VAL_3]], %[[VAL_3]], %[[VAL_3]]], %[[VAL_1]] {in_bounds = [true, true, true]} : memref<24x64x64xf32>, vector<24x64x64xf32>
-// CHECK:             %[[VAL_12:.*]] = vector.transfer_read %[[VAL_8]]{{\[}}%[[VAL_3]], %[[VAL_3]]], %[[VAL_1]] {in_bounds = [true, true]} : memref<32x64xf32, strided<[64, 1], offset: ?>>, vector<32x64xf32>
-// CHECK:             %[[VAL_13:.*]] = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction"], kind = #vector.kind<add>} %1, %2, %3 : vector<24x32x64xf32>, vector<24x64x64xf32> into vector<32x64xf32> 
+// CHECK:             %[[VAL_12:.*]] = arith.constant dense<0.000000e+00> : vector<32x64xf32>
+// CHECK:             %[[VAL_13:.*]] = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction"], kind = #vector.kind<add>} %[[VAL_10]], %[[VAL_11]], %[[VAL_12]] : vector<24x32x64xf32>, vector<24x64x64xf32> into vector<32x64xf32>
 // CHECK:             vector.transfer_write %[[VAL_13]], %[[VAL_8]]{{\[}}%[[VAL_3]], %[[VAL_3]]] {in_bounds = [true, true]} : vector<32x64xf32>, memref<32x64xf32, strided<[64, 1], offset: ?>>
 // CHECK:           }
 // CHECK:           return %[[VAL_5]] : memref<8x24x32x64xf32>
@@ -355,3 +355,144 @@ module {
 // CHECK:           %[[VAL_9:.*]] = vector.transfer_write %[[VAL_8]], %[[VAL_2]]{{\[}}%[[VAL_3]], %[[VAL_3]]] {in_bounds = [true, true]} : vector<4x64xf32>, tensor<4x64xf32>
 // CHECK:           return %[[VAL_9]] : tensor<4x64xf32>
 // CHECK:         }
+
+// -----
+
+#map = affine_map<(d0, d1, d2, d3) -> (d0, d1, d3)>
+#map1 = affine_map<(d0, d1, d2, d3) -> (d0, d3, d2)>
+#map2 = affine_map<(d0, d1, d2, d3) -> (d1, d2)>
+// Two accumulators share the reduction loops.
+func.func @brgemm_two_acc(%arg0: memref<8x4x16xf32>, %arg1: memref<8x16x64xf32>,
+    %arg2: memref<4x32xf32>, %arg3: memref<4x32xf32>) {
+  %cst = arith.constant 0.000000e+00 : f32
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c8 = arith.constant 8 : index
+  %c16 = arith.constant 16 : index
+  scf.for %arg4 = %c0 to %c8 step %c1 {
+    scf.for %arg5 = %c0 to %c16 step %c1 {
+      %subview = memref.subview %arg0[%arg4, 0, %arg5] [1, 4, 1] [1, 1, 1] : memref<8x4x16xf32> to memref<1x4x1xf32, strided<[64, 16, 1], offset: ?>>
+      %subview_0 = memref.subview %arg1[%arg4, %arg5, 0] [1, 1, 32] [1, 1, 1] : memref<8x16x64xf32> to memref<1x1x32xf32, strided<[1024, 64, 1], offset: ?>>
+      %subview_1 = memref.subview %arg1[%arg4, %arg5, 32] [1, 1, 32] [1, 1, 1] : memref<8x16x64xf32> to memref<1x1x32xf32, strided<[1024, 64, 1], offset: ?>>
+      %0 = vector.transfer_read %subview[%c0, %c0, %c0], %cst {in_bounds = [true, true, true]} : memref<1x4x1xf32, strided<[64, 16, 1], offset: ?>>, vector<1x4x1xf32>
+      %1 = vector.transfer_read %subview_0[%c0, %c0, %c0], %cst {in_bounds = [true, true, true]} : memref<1x1x32xf32, strided<[1024, 64, 1], offset: ?>>, vector<1x1x32xf32>
+      %2 = vector.transfer_read %subview_1[%c0, %c0, %c0], %cst {in_bounds = [true, true, true]} : memref<1x1x32xf32, strided<[1024, 64, 1], offset: ?>>, vector<1x1x32xf32>
+      %3 = vector.transfer_read %arg2[%c0, %c0], %cst {in_bounds = [true, true]} : memref<4x32xf32>, vector<4x32xf32>
+      %4 = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction"], kind = #vector.kind<add>} %0, %1, %3 : vector<1x4x1xf32>, vector<1x1x32xf32> into vector<4x32xf32>
+      vector.transfer_write %4, %arg2[%c0, %c0] {in_bounds = [true, true]} : vector<4x32xf32>, memref<4x32xf32>
+      %5 = vector.transfer_read %arg3[%c0, %c0], %cst {in_bounds = [true, true]} : memref<4x32xf32>, vector<4x32xf32>
+      %6 = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction"], kind = #vector.kind<add>} %0, %2, %5 : vector<1x4x1xf32>, vector<1x1x32xf32> into vector<4x32xf32>
+      vector.transfer_write %6, %arg3[%c0, %c0] {in_bounds = [true, true]} : vector<4x32xf32>, memref<4x32xf32>
+    }
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @brgemm_two_acc(
+// CHECK-SAME:  %{{.+}}: memref<8x4x16xf32>, %{{.+}}: memref<8x16x64xf32>, %[[ARG2:.+]]: memref<4x32xf32>, %[[ARG3:.+]]: memref<4x32xf32>
+// CHECK-DAG: vector.transfer_read %[[ARG2]]
+// CHECK-DAG: vector.transfer_read %[[ARG3]]
+// CHECK: %[[RES:.+]]:2 = scf.for {{.+}} -> (vector<4x32xf32>, vector<4x32xf32>)
+// CHECK:   scf.for {{.+}} -> (vector<4x32xf32>, vector<4x32xf32>)
+// CHECK:     vector.contract
+// CHECK:     vector.contract
+// CHECK-NOT: vector.transfer_write
+// CHECK:     scf.yield
+// CHECK-DAG: vector.transfer_write %[[RES]]#{{.}}, %[[ARG2]]
+// CHECK-DAG: vector.transfer_write %[[RES]]#{{.}}, %[[ARG3]]
+
+// -----
+
+#map = affine_map<(d0, d1, d2, d3) -> (d0, d1, d3)>
+#map1 = affine_map<(d0, d1, d2, d3) -> (d0, d3, d2)>
+#map2 = affine_map<(d0, d1, d2, d3) -> (d1, d2)>
+// The bf16 accumulator is carried in f32 and the bias of the epilogue is
+// added to the final value.
+func.func @brgemm_bf16_epilogue(%arg0: memref<8x4x16xbf16>, %arg1: memref<8x16x32xbf16>,
+    %arg2: memref<4x32xbf16>, %arg3: vector<4x32xf32>) {
+  %cst = arith.constant 0.000000e+00 : bf16
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c8 = arith.constant 8 : index
+  %c16 = arith.constant 16 : index
+  scf.for %arg4 = %c0 to %c8 step %c1 {
+    scf.for %arg5 = %c0 to %c16 step %c1 {
+      %subview = memref.subview %arg0[%arg4, 0, %arg5] [1, 4, 1] [1, 1, 1] : memref<8x4x16xbf16> to memref<1x4x1xbf16, strided<[64, 16, 1], offset: ?>>
+      %subview_0 = memref.subview %arg1[%arg4, %arg5, 0] [1, 1, 32] [1, 1, 1] : memref<8x16x32xbf16> to memref<1x1x32xbf16, strided<[512, 32, 1], offset: ?>>
+      %0 = vector.transfer_read %subview[%c0, %c0, %c0], %cst {in_bounds = [true, true, true]} : memref<1x4x1xbf16, strided<[64, 16, 1], offset: ?>>, vector<1x4x1xbf16>
+      %1 = vector.transfer_read %subview_0[%c0, %c0, %c0], %cst {in_bounds = [true, true, true]} : memref<1x1x32xbf16, strided<[512, 32, 1], offset: ?>>, vector<1x1x32xbf16>
+      %2 = vector.transfer_read %arg2[%c0, %c0], %cst {in_bounds = [true, true]} : memref<4x32xbf16>, vector<4x32xbf16>
+      %3 = arith.extf %2 : vector<4x32xbf16> to vector<4x32xf32>
+      %4 = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction"], kind = #vector.kind<add>} %0, %1, %3 : vector<1x4x1xbf16>, vector<1x1x32xbf16> into vector<4x32xf32>
+      %5 = arith.truncf %4 : vector<4x32xf32> to vector<4x32xbf16>
+      vector.transfer_write %5, %arg2[%c0, %c0] {in_bounds = [true, true]} : vector<4x32xbf16>, memref<4x32xbf16>
+    }
+  }
+  %6 = vector.transfer_read %arg2[%c0, %c0], %cst {in_bounds = [true, true]} : memref<4x32xbf16>, vector<4x32xbf16>
+  %7 = arith.extf %6 : vector<4x32xbf16> to vector<4x32xf32>
+  %8 = arith.addf %7, %arg3 : vector<4x32xf32>
+  %9 = arith.truncf %8 : vector<4x32xf32> to vector<4x32xbf16>
+  vector.transfer_write %9, %arg2[%c0, %c0] {in_bounds = [true, true]} : vector<4x32xbf16>, memref<4x32xbf16>
+  return
+}
+
+// CHECK-LABEL: func.func @brgemm_bf16_epilogue(
+// CHECK-SAME:  %{{.+}}: memref<8x4x16xbf16>, %{{.+}}: memref<8x16x32xbf16>, %[[ARG2:.+]]: memref<4x32xbf16>, %[[ARG3:.+]]: vector<4x32xf32>
+// CHECK: %[[READ:.+]] = vector.transfer_read %[[ARG2]]
+// CHECK: %[[ACC:.+]] = arith.extf %[[READ]] : vector<4x32xbf16> to vector<4x32xf32>
+// CHECK: %[[RES:.+]] = scf.for {{.+}} iter_args(%[[A:.+]] = %[[ACC]]) -> (vector<4x32xf32>)
+// CHECK:   %[[INNER:.+]] = scf.for {{.+}} iter_args(%[[A1:.+]] = %[[A]]) -> (vector<4x32xf32>)
+// CHECK:     %[[MUL:.+]] = vector.contract {{.+}} %{{.+}}, %{{.+}}, %[[A1]] : vector<1x4x1xbf16>, vector<1x1x32xbf16> into vector<4x32xf32>
+// CHECK-NOT: arith.truncf
+// CHECK:     scf.yield %[[MUL]]
+// CHECK:   scf.yield %[[INNER]]
+// CHECK: %[[TRUNC:.+]] = arith.truncf %[[RES]] : vector<4x32xf32> to vector<4x32xbf16>
+// CHECK: vector.transfer_write %[[TRUNC]], %[[ARG2]]
+// CHECK-NOT: vector.transfer_read
+// CHECK: %[[EXT:.+]] = arith.extf %[[TRUNC]]
+// CHECK: arith.addf %[[EXT]], %[[ARG3]]
+
+// -----
+
+#map = affine_map<(d0, d1, d2, d3) -> (d0, d1, d3)>
+#map1 = affine_map<(d0, d1, d2, d3) -> (d0, d3, d2)>
+#map2 = affine_map<(d0, d1, d2, d3) -> (d1, d2)>
+// The zeroed output is computed tile by tile, the accumulators start from
+// zero and the output is not zeroed.
+func.func @brgemm_zero_init(%arg0: memref<8x8x16xf32>, %arg1: memref<8x16x32xf32>,
+    %arg2: memref<8x32xf32>) {
+  %cst = arith.constant 0.000000e+00 : f32
+  %zero = arith.constant dense<0.000000e+00> : vector<8x32xf32>
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c4 = arith.constant 4 : index
+  %c8 = arith.constant 8 : index
+  %c16 = arith.constant 16 : index
+  vector.transfer_write %zero, %arg2[%c0, %c0] {in_bounds = [true, true]} : vector<8x32xf32>, memref<8x32xf32>
+  scf.for %arg3 = %c0 to %c8 step %c4 {
+    %subview = memref.subview %arg2[%arg3, 0] [4, 32] [1, 1] : memref<8x32xf32> to memref<4x32xf32, strided<[32, 1], offset: ?>>
+    scf.for %arg4 = %c0 to %c8 step %c1 {
+      scf.for %arg5 = %c0 to %c16 step %c1 {
+        %subview_0 = memref.subview %arg0[%arg4, %arg3, %arg5] [1, 4, 1] [1, 1, 1] : memref<8x8x16xf32> to memref<1x4x1xf32, strided<[128, 16, 1], offset: ?>>
+        %subview_1 = memref.subview %arg1[%arg4, %arg5, 0] [1, 1, 32] [1, 1, 1] : memref<8x16x32xf32> to memref<1x1x32xf32, strided<[512, 32, 1], offset: ?>>
+        %0 = vector.transfer_read %subview_0[%c0, %c0, %c0], %cst {in_bounds = [true, true, true]} : memref<1x4x1xf32, strided<[128, 16, 1], offset: ?>>, vector<1x4x1xf32>
+        %1 = vector.transfer_read %subview_1[%c0, %c0, %c0], %cst {in_bounds = [true, true, true]} : memref<1x1x32xf32, strided<[512, 32, 1], offset: ?>>, vector<1x1x32xf32>
+        %2 = vector.transfer_read %subview[%c0, %c0], %cst {in_bounds = [true, true]} : memref<4x32xf32, strided<[32, 1], offset: ?>>, vector<4x32xf32>
+        %3 = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction"], kind = #vector.kind<add>} %0, %1, %2 : vector<1x4x1xf32>, vector<1x1x32xf32> into vector<4x32xf32>
+        vector.transfer_write %3, %subview[%c0, %c0] {in_bounds = [true, true]} : vector<4x32xf32>, memref<4x32xf32, strided<[32, 1], offset: ?>>
+      }
+    }
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @brgemm_zero_init(
+// CHECK-SAME:  %{{.+}}: memref<8x8x16xf32>, %{{.+}}: memref<8x16x32xf32>, %[[ARG2:.+]]: memref<8x32xf32>
+// CHECK-NOT: vector.transfer_write %{{.+}}, %[[ARG2]]
+// CHECK: scf.for
+// CHECK:   %[[SUB:.+]] = memref.subview %[[ARG2]]
+// CHECK-NOT: vector.transfer_read %[[SUB]]
+// CHECK:   %[[ZERO:.+]] = arith.constant dense<0.000000e+00> : vector<4x32xf32>
+// CHECK:   %[[RES:.+]] = scf.for {{.+}} iter_args(%{{.+}} = %[[ZERO]]) -> (vector<4x32xf32>)
+// CHECK:     vector.contract
+// CHECK:   vector.transfer_write %[[RES]], %[[SUB]]
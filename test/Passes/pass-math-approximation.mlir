@@ -0,0 +1,87 @@
+// RUN: tpp-opt %s --math-approximation --split-input-file | FileCheck %s
+// RUN: tpp-opt %s --math-approximation="accuracy=fast" --split-input-file | FileCheck %s --check-prefix=FAST
+
+func.func @softmax_exp(%arg0: vector<4x16xf32>) -> vector<4x16xf32> {
+  %0 = math.exp %arg0 : vector<4x16xf32>
+  return %0 : vector<4x16xf32>
+}
+
+// CHECK-LABEL: func.func @softmax_exp(
+// CHECK-SAME: %[[X:[^:]+]]: vector<4x16xf32>
+// CHECK-NOT: math.exp
+// CHECK: %[[LO:.+]] = arith.maximumf %[[X]]
+// CHECK: %[[CLAMPED:.+]] = arith.minimumf %[[LO]]
+// CHECK: %[[N:.+]] = math.floor
+// CHECK-COUNT-8: math.fma
+// CHECK: %[[INT:.+]] = arith.fptosi %[[N]] : vector<4x16xf32> to vector<4x16xi32>
+// CHECK: %[[BIASED:.+]] = arith.addi %[[INT]]
+// CHECK: %[[BITS:.+]] = arith.shli %[[BIASED]]
+// CHECK: %[[POW2:.+]] = arith.bitcast %[[BITS]] : vector<4x16xi32> to vector<4x16xf32>
+// CHECK: %[[EXP:.+]] = arith.mulf %{{.+}}, %[[POW2]]
+// CHECK: return %[[EXP]]
+
+// FAST-LABEL: func.func @softmax_exp(
+// FAST-NOT: math.exp
+// FAST: math.floor
+// FAST-COUNT-6: math.fma
+// FAST: arith.bitcast
+// FAST-NOT: math.fma
+
+// -----
+
+func.func @gelu_tanh(%arg0: vector<[8]xf32>) -> vector<[8]xf32> {
+  %0 = math.tanh %arg0 : vector<[8]xf32>
+  return %0 : vector<[8]xf32>
+}
+
+// CHECK-LABEL: func.func @gelu_tanh(
+// CHECK-SAME: %[[X:[^:]+]]: vector<[8]xf32>
+// CHECK-NOT: math.tanh
+// CHECK: %[[ABS:.+]] = math.absf %[[X]]
+// CHECK: %[[TINY:.+]] = arith.cmpf olt, %[[ABS]]
+// CHECK: arith.maximumf %[[X]]
+// CHECK: %[[RATIO:.+]] = arith.divf %{{.+}}, %{{.+}} : vector<[8]xf32>
+// CHECK: %[[TANH:.+]] = arith.select %[[TINY]], %[[X]], %[[RATIO]]
+// CHECK: return %[[TANH]]
+
+// FAST-LABEL: func.func @gelu_tanh(
+// FAST-NOT: math.tanh
+// FAST-NOT: arith.select
+// FAST: %[[DIV:.+]] = arith.divf
+// FAST: return %[[DIV]]
+
+// -----
+
+func.func @gelu_erf(%arg0: bf16) -> bf16 {
+  %0 = math.erf %arg0 : bf16
+  return %0 : bf16
+}
+
+// CHECK-LABEL: func.func @gelu_erf(
+// CHECK-SAME: %[[X:[^:]+]]: bf16
+// CHECK-NOT: math.erf
+// CHECK: %[[EXT:.+]] = arith.extf %[[X]] : bf16 to f32
+// CHECK: math.absf %[[EXT]]
+// CHECK: arith.negf
+// CHECK: arith.bitcast
+// CHECK: %[[ERF:.+]] = math.copysign %{{.+}}, %[[EXT]] : f32
+// CHECK: %[[TRUNC:.+]] = arith.truncf %[[ERF]] : f32 to bf16
+// CHECK: return %[[TRUNC]]
+
+// FAST-LABEL: func.func @gelu_erf(
+// FAST-NOT: math.erf
+// FAST-NOT: arith.bitcast
+// FAST: math.copysign
+// FAST: arith.truncf
+
+// -----
+
+// The f64 ops keep libm.
+
+func.func @exp_f64(%arg0: f64) -> f64 {
+  %0 = math.exp %arg0 : f64
+  return %0 : f64
+}
+
+// CHECK-LABEL: func.func @exp_f64(
+// CHECK: math.exp
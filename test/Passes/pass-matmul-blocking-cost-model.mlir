@@ -0,0 +1,60 @@
+// RUN: tpp-opt %s -pack-matmul="cost-model" -split-input-file | FileCheck %s
+// RUN: tpp-opt %s -pack-matmul -split-input-file | FileCheck %s --check-prefix=DEFAULT
+
+// Default target: the blocks of highest intensity in a 32KB L1, vectorized by
+// 16 lanes along N.
+func.func @matmul_352(%arg0: tensor<352x352xf32>, %arg1: tensor<352x352xf32>,
+                      %arg2: tensor<352x352xf32>) -> tensor<352x352xf32> {
+  %0 = linalg.matmul ins(%arg0, %arg1: tensor<352x352xf32>, tensor<352x352xf32>)
+                     outs(%arg2: tensor<352x352xf32>) -> tensor<352x352xf32>
+  return %0 : tensor<352x352xf32>
+}
+
+// CHECK-LABEL: func.func @matmul_352(
+// CHECK: tensor.pack %{{.+}} inner_tiles = [88, 44] {{.+}} -> tensor<4x8x88x44xf32>
+// CHECK: tensor.pack %{{.+}} inner_tiles = [44, 32] {{.+}} -> tensor<11x8x44x32xf32>
+// CHECK: tensor.pack %{{.+}} inner_tiles = [88, 32] {{.+}} -> tensor<4x11x88x32xf32>
+
+// Without the option, an undescribed target keeps the default factors.
+// DEFAULT-LABEL: func.func @matmul_352(
+// DEFAULT: tensor.pack %{{.+}} inner_tiles = [32, 32] {{.+}} -> tensor<11x11x32x32xf32>
+
+// -----
+
+// A target described via DLTI always uses the cost model.
+module attributes {
+  dlti.target_system_spec = #dlti.target_system_spec<
+    "CPU" = #dlti.target_device_spec<
+      #dlti.dl_entry<"L1_cache_size_in_bytes", 49152 : i32>,
+      #dlti.dl_entry<"L2_cache_size_in_bytes", 2097152 : i32>>>
+} {
+  func.func @matmul_352_dlti(%arg0: tensor<352x352xf32>, %arg1: tensor<352x352xf32>,
+                             %arg2: tensor<352x352xf32>) -> tensor<352x352xf32> {
+    %0 = linalg.matmul ins(%arg0, %arg1: tensor<352x352xf32>, tensor<352x352xf32>)
+                       outs(%arg2: tensor<352x352xf32>) -> tensor<352x352xf32>
+    return %0 : tensor<352x352xf32>
+  }
+}
+
+// CHECK-LABEL: func.func @matmul_352_dlti(
+// CHECK: tensor.pack %{{.+}} inner_tiles = [32, 32] {{.+}} -> tensor<11x11x32x32xf32>
+// CHECK: tensor.pack %{{.+}} inner_tiles = [32, 176] {{.+}} -> tensor<2x11x32x176xf32>
+// CHECK: tensor.pack %{{.+}} inner_tiles = [32, 176] {{.+}} -> tensor<11x2x32x176xf32>
+
+// DEFAULT-LABEL: func.func @matmul_352_dlti(
+// DEFAULT: tensor.pack %{{.+}} inner_tiles = [32, 176] {{.+}} -> tensor<2x11x32x176xf32>
+
+// -----
+
+func.func @matmul_prime(%arg0: tensor<353x64xf32>, %arg1: tensor<64x64xf32>,
+                        %arg2: tensor<353x64xf32>) -> tensor<353x64xf32> {
+  %0 = linalg.matmul ins(%arg0, %arg1: tensor<353x64xf32>, tensor<64x64xf32>)
+                     outs(%arg2: tensor<353x64xf32>) -> tensor<353x64xf32>
+  return %0 : tensor<353x64xf32>
+}
+
+// No block of a prime dimension fits: fall back to the defaults, which don't
+// tile it fully either, so the matmul is not packed.
+// CHECK-LABEL: func.func @matmul_prime(
+// CHECK-NOT: tensor.pack
+// CHECK: linalg.matmul
@@ -0,0 +1,57 @@
+// RUN: tpp-opt %s -pack-matmul -split-input-file | FileCheck %s
+// RUN: tpp-opt %s -pack-matmul="gemv-max-rows=0" -split-input-file | FileCheck %s --check-prefix=NOGEMV
+// RUN: tpp-opt %s -pack-matmul="gemv-max-rows=4" -split-input-file | FileCheck %s --check-prefix=GEMV4
+
+func.func @gemv(%arg0: tensor<1x512xf32>, %arg1: tensor<512x256xf32>,
+                %arg2: tensor<1x256xf32>) -> tensor<1x256xf32> {
+  %0 = linalg.matmul ins(%arg0, %arg1 : tensor<1x512xf32>, tensor<512x256xf32>)
+                     outs(%arg2 : tensor<1x256xf32>) -> tensor<1x256xf32>
+  return %0 : tensor<1x256xf32>
+}
+
+// CHECK-LABEL: func.func @gemv(
+// CHECK-NOT: tensor.pack
+// CHECK: linalg.matmul ins({{.*}} : tensor<1x512xf32>, tensor<512x256xf32>)
+// CHECK-SAME: outs({{.*}} : tensor<1x256xf32>)
+
+// NOGEMV-LABEL: func.func @gemv(
+// NOGEMV: tensor.pack %{{.+}} outer_dims_perm = [1, 0] inner_dims_pos = [0, 1] inner_tiles = [32, 32]
+// NOGEMV-SAME: tensor<512x256xf32> -> tensor<8x16x32x32xf32>
+// NOGEMV: linalg.generic
+
+// GEMV4-LABEL: func.func @gemv(
+// GEMV4-NOT: tensor.pack
+// GEMV4: linalg.matmul
+
+// -----
+
+func.func @small_batch(%arg0: tensor<4x512xf32>, %arg1: tensor<512x256xf32>,
+                       %arg2: tensor<4x256xf32>) -> tensor<4x256xf32> {
+  %0 = linalg.matmul ins(%arg0, %arg1 : tensor<4x512xf32>, tensor<512x256xf32>)
+                     outs(%arg2 : tensor<4x256xf32>) -> tensor<4x256xf32>
+  return %0 : tensor<4x256xf32>
+}
+
+// CHECK-LABEL: func.func @small_batch(
+// CHECK: tensor.pack %{{.+}} inner_tiles = [4, 32]
+// CHECK-SAME: tensor<4x512xf32> -> tensor<1x16x4x32xf32>
+// CHECK: linalg.generic
+
+// GEMV4-LABEL: func.func @small_batch(
+// GEMV4-NOT: tensor.pack
+// GEMV4: linalg.matmul
+
+// -----
+
+// The weights of bf16 matmuls are still packed into VNNI layout.
+func.func @gemv_bf16(%arg0: tensor<1x512xbf16>, %arg1: tensor<512x256xbf16>,
+                     %arg2: tensor<1x256xbf16>) -> tensor<1x256xbf16> {
+  %0 = linalg.matmul ins(%arg0, %arg1 : tensor<1x512xbf16>, tensor<512x256xbf16>)
+                     outs(%arg2 : tensor<1x256xbf16>) -> tensor<1x256xbf16>
+  return %0 : tensor<1x256xbf16>
+}
+
+// CHECK-LABEL: func.func @gemv_bf16(
+// CHECK: tensor.pack %{{.+}} outer_dims_perm = [1, 0] inner_dims_pos = [0, 1] inner_tiles = [32, 32]
+// CHECK-SAME: tensor<512x256xbf16> -> tensor<8x16x32x32xbf16>
+// CHECK: linalg.generic
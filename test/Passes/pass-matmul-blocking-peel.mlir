@@ -0,0 +1,51 @@
+// RUN: tpp-opt %s -pack-matmul="block-factors=32,32,32 peel-remainders" -split-input-file | FileCheck %s
+// RUN: tpp-opt %s -pack-matmul="block-factors=32,32,32" -split-input-file | FileCheck %s --check-prefix=NOPEEL
+
+func.func @peel_m(%arg0: tensor<100x128xf32>, %arg1: tensor<128x128xf32>, %arg2: tensor<100x128xf32>) -> tensor<100x128xf32> {
+  %0 = linalg.matmul ins(%arg0, %arg1: tensor<100x128xf32>, tensor<128x128xf32>)
+                     outs(%arg2: tensor<100x128xf32>) -> tensor<100x128xf32>
+  return %0 : tensor<100x128xf32>
+}
+
+// The first 96 rows are packed with full blocks, the last 4 rows are blocked
+// by their size.
+// CHECK-LABEL: func.func @peel_m(
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<100x128xf32>, %[[ARG1:.+]]: tensor<128x128xf32>, %[[ARG2:.+]]: tensor<100x128xf32>
+// CHECK-DAG: %[[LHS0:.+]] = tensor.extract_slice %[[ARG0]][0, 0] [96, 128] [1, 1]
+// CHECK-DAG: %[[LHS1:.+]] = tensor.extract_slice %[[ARG0]][96, 0] [4, 128] [1, 1]
+// CHECK-DAG: %[[ACC0:.+]] = tensor.extract_slice %[[ARG2]][0, 0] [96, 128] [1, 1]
+// CHECK-DAG: %[[ACC1:.+]] = tensor.extract_slice %[[ARG2]][96, 0] [4, 128] [1, 1]
+// CHECK: tensor.pack %[[LHS0]] {{.*}}inner_tiles = [32, 32] {{.*}} -> tensor<3x4x32x32xf32>
+// CHECK: %[[MAIN:.+]] = tensor.unpack %{{.+}} inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %[[ACC0]]
+// CHECK: tensor.pack %[[LHS1]] {{.*}}inner_tiles = [4, 32] {{.*}} -> tensor<1x4x4x32xf32>
+// CHECK: %[[REM:.+]] = tensor.unpack %{{.+}} inner_dims_pos = [0, 1] inner_tiles = [4, 32] into %[[ACC1]]
+// CHECK: %[[INS:.+]] = tensor.insert_slice %[[MAIN]] into %[[ARG2]][0, 0] [96, 128] [1, 1]
+// CHECK: %[[OUT:.+]] = tensor.insert_slice %[[REM]] into %[[INS]][96, 0] [4, 128] [1, 1]
+// CHECK: return %[[OUT]]
+
+// Without peeling, the matmul is not packed.
+// NOPEEL-LABEL: func.func @peel_m(
+// NOPEEL-NOT: tensor.pack
+// NOPEEL: linalg.matmul
+
+// -----
+
+func.func @peel_k(%arg0: tensor<64x80xf32>, %arg1: tensor<80x64xf32>, %arg2: tensor<64x64xf32>) -> tensor<64x64xf32> {
+  %0 = linalg.matmul ins(%arg0, %arg1: tensor<64x80xf32>, tensor<80x64xf32>)
+                     outs(%arg2: tensor<64x64xf32>) -> tensor<64x64xf32>
+  return %0 : tensor<64x64xf32>
+}
+
+// The remainder of K accumulates into the result of the packed part.
+// CHECK-LABEL: func.func @peel_k(
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<64x80xf32>, %[[ARG1:.+]]: tensor<80x64xf32>, %[[ARG2:.+]]: tensor<64x64xf32>
+// CHECK-DAG: %[[LHS0:.+]] = tensor.extract_slice %[[ARG0]][0, 0] [64, 64] [1, 1]
+// CHECK-DAG: %[[RHS0:.+]] = tensor.extract_slice %[[ARG1]][0, 0] [64, 64] [1, 1]
+// CHECK-DAG: %[[LHS1:.+]] = tensor.extract_slice %[[ARG0]][0, 64] [64, 16] [1, 1]
+// CHECK-DAG: %[[RHS1:.+]] = tensor.extract_slice %[[ARG1]][64, 0] [16, 64] [1, 1]
+// CHECK: tensor.pack %[[LHS0]] {{.*}}inner_tiles = [32, 32] {{.*}} -> tensor<2x2x32x32xf32>
+// CHECK: %[[MAIN:.+]] = tensor.unpack %{{.+}} into %[[ARG2]]
+// CHECK: tensor.pack %[[LHS1]] {{.*}}inner_tiles = [32, 16] {{.*}} -> tensor<2x1x32x16xf32>
+// CHECK: tensor.pack %[[MAIN]] inner_dims_pos = [0, 1] inner_tiles = [32, 32]
+// CHECK: %[[OUT:.+]] = tensor.unpack %{{.+}} into %[[MAIN]]
+// CHECK: return %[[OUT]]
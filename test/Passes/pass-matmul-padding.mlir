@@ -0,0 +1,64 @@
+// RUN: tpp-opt %s -pad-matmul="block-factors=32,32,32" -split-input-file | FileCheck %s
+// RUN: tpp-opt %s -pad-matmul="block-factors=32,32,32" -pack-matmul="block-factors=32,32,32" -split-input-file | FileCheck %s --check-prefix=PACK
+
+module attributes {
+  dlti.target_system_spec = #dlti.target_system_spec<
+    "CPU" = #dlti.target_device_spec<
+      #dlti.dl_entry<"max_vector_op_width", 512 : i32>,
+      #dlti.dl_entry<"num_vector_registers", 32 : i32>>>
+} {
+  func.func @pad_n(%arg0: tensor<64x64xf32>, %arg1: tensor<64x40xf32>, %arg2: tensor<64x40xf32>) -> tensor<64x40xf32> {
+    %0 = linalg.matmul ins(%arg0, %arg1: tensor<64x64xf32>, tensor<64x40xf32>)
+                       outs(%arg2: tensor<64x40xf32>) -> tensor<64x40xf32>
+    return %0 : tensor<64x40xf32>
+  }
+}
+
+// The 8 columns past the last block would run on half vectors, a full block
+// is cheaper.
+// CHECK-LABEL: func.func @pad_n(
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<64x64xf32>, %[[ARG1:.+]]: tensor<64x40xf32>, %[[ARG2:.+]]: tensor<64x40xf32>
+// CHECK: %[[RHS:.+]] = tensor.pad %[[ARG1]] low[0, 0] high[0, 24]
+// CHECK: } : tensor<64x40xf32> to tensor<64x64xf32>
+// CHECK: %[[ACC:.+]] = tensor.pad %[[ARG2]] low[0, 0] high[0, 24]
+// CHECK: } : tensor<64x40xf32> to tensor<64x64xf32>
+// CHECK: %[[MM:.+]] = linalg.matmul ins(%[[ARG0]], %[[RHS]] : tensor<64x64xf32>, tensor<64x64xf32>) outs(%[[ACC]] : tensor<64x64xf32>)
+// CHECK: %[[OUT:.+]] = tensor.extract_slice %[[MM]][0, 0] [64, 40] [1, 1]
+// CHECK: return %[[OUT]]
+
+// The pads fold into the packs and the padded columns are dropped by the
+// unpack of the result.
+// PACK-LABEL: func.func @pad_n(
+// PACK-SAME:  %[[ARG0:.+]]: tensor<64x64xf32>, %[[ARG1:.+]]: tensor<64x40xf32>, %[[ARG2:.+]]: tensor<64x40xf32>
+// PACK-NOT: tensor.pad
+// PACK: tensor.pack %[[ARG0]] {{.*}}inner_tiles = [32, 32] {{.*}} : tensor<64x64xf32> -> tensor<2x2x32x32xf32>
+// PACK: tensor.pack %[[ARG1]] padding_value(%{{.+}} : f32) outer_dims_perm = [1, 0] inner_dims_pos = [0, 1] inner_tiles = [32, 32] {{.*}} : tensor<64x40xf32> -> tensor<2x2x32x32xf32>
+// PACK: tensor.pack %[[ARG2]] padding_value(%{{.+}} : f32) inner_dims_pos = [0, 1] inner_tiles = [32, 32] {{.*}} : tensor<64x40xf32> -> tensor<2x2x32x32xf32>
+// PACK: linalg.generic
+// PACK: %[[OUT:.+]] = tensor.unpack %{{.+}} inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %{{.+}} : tensor<2x2x32x32xf32> -> tensor<64x40xf32>
+// PACK-NOT: tensor.extract_slice
+// PACK: return %[[OUT]]
+
+// -----
+
+module attributes {
+  dlti.target_system_spec = #dlti.target_system_spec<
+    "CPU" = #dlti.target_device_spec<
+      #dlti.dl_entry<"max_vector_op_width", 512 : i32>,
+      #dlti.dl_entry<"num_vector_registers", 32 : i32>>>
+} {
+  func.func @no_pad_k(%arg0: tensor<64x100xf32>, %arg1: tensor<100x64xf32>, %arg2: tensor<64x64xf32>) -> tensor<64x64xf32> {
+    %0 = linalg.matmul ins(%arg0, %arg1: tensor<64x100xf32>, tensor<100x64xf32>)
+                       outs(%arg2: tensor<64x64xf32>) -> tensor<64x64xf32>
+    return %0 : tensor<64x64xf32>
+  }
+}
+
+// Padding K to 128 adds more work than its remainder costs.
+// CHECK-LABEL: func.func @no_pad_k(
+// CHECK-NOT: tensor.pad
+// CHECK: linalg.matmul ins(%{{.+}}, %{{.+}} : tensor<64x100xf32>, tensor<100x64xf32>)
+
+// PACK-LABEL: func.func @no_pad_k(
+// PACK-NOT: tensor.pack
+// PACK: linalg.matmul
@@ -0,0 +1,72 @@
+// RUN: tpp-opt %s -pack-grouped-conv -split-input-file | FileCheck %s
+
+func.func @depthwise_conv(%i: tensor<1x9x9x32xf32>, %f: tensor<3x3x32xf32>,
+                          %o: tensor<1x4x4x32xf32>) -> tensor<1x4x4x32xf32> {
+  %0 = linalg.depthwise_conv_2d_nhwc_hwc {dilations = dense<1> : tensor<2xi64>, strides = dense<2> : tensor<2xi64>}
+    ins(%i, %f: tensor<1x9x9x32xf32>, tensor<3x3x32xf32>) outs(%o: tensor<1x4x4x32xf32>) -> tensor<1x4x4x32xf32>
+  return %0: tensor<1x4x4x32xf32>
+}
+
+// CHECK-DAG: #[[MAP0:.+]] = affine_map<(d0, d1, d2, d3, d4, d5, d6) -> (d0, d1, d2 * 2 + d5, d3 * 2 + d6, d4)>
+// CHECK-DAG: #[[MAP1:.+]] = affine_map<(d0, d1, d2, d3, d4, d5, d6) -> (d1, d5, d6, d4)>
+// CHECK-DAG: #[[MAP2:.+]] = affine_map<(d0, d1, d2, d3, d4, d5, d6) -> (d0, d1, d2, d3, d4)>
+
+// CHECK: func.func @depthwise_conv(
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<1x9x9x32xf32>,
+// CHECK-SAME:  %[[ARG1:.+]]: tensor<3x3x32xf32>,
+// CHECK-SAME:  %[[ARG2:.+]]: tensor<1x4x4x32xf32>) -> tensor<1x4x4x32xf32> {
+// CHECK: %[[PACK0:.+]] = tensor.pack %[[ARG0]] outer_dims_perm = [0, 3, 1, 2] inner_dims_pos = [3] inner_tiles = [16]
+// CHECK-SAME:  : tensor<1x9x9x32xf32> -> tensor<1x2x9x9x16xf32>
+// CHECK: %[[PACK1:.+]] = tensor.pack %[[ARG1]] outer_dims_perm = [2, 0, 1] inner_dims_pos = [2] inner_tiles = [16]
+// CHECK-SAME:  : tensor<3x3x32xf32> -> tensor<2x3x3x16xf32>
+// CHECK: %[[PACK2:.+]] = tensor.pack %[[ARG2]] outer_dims_perm = [0, 3, 1, 2] inner_dims_pos = [3] inner_tiles = [16]
+// CHECK-SAME:  : tensor<1x4x4x32xf32> -> tensor<1x2x4x4x16xf32>
+// CHECK: %[[VAL:.+]] = linalg.generic {indexing_maps = [#[[MAP0]], #[[MAP1]], #[[MAP2]]], iterator_types = ["parallel", "parallel", "parallel", "parallel", "parallel", "reduction", "reduction"]}
+// CHECK-SAME:  ins(%[[PACK0]], %[[PACK1]] : tensor<1x2x9x9x16xf32>, tensor<2x3x3x16xf32>) outs(%[[PACK2]] : tensor<1x2x4x4x16xf32>)
+// CHECK: %[[OUT:.+]] = tensor.unpack %[[VAL]] outer_dims_perm = [0, 3, 1, 2] inner_dims_pos = [3] inner_tiles = [16] into %[[ARG2]]
+// CHECK: return %[[OUT]] : tensor<1x4x4x32xf32>
+
+// -----
+
+// We don't expect to block as the blocking factor does not create full tiles.
+func.func @depthwise_conv_partial(%i: tensor<1x9x9x24xf32>, %f: tensor<3x3x24xf32>,
+                                  %o: tensor<1x7x7x24xf32>) -> tensor<1x7x7x24xf32> {
+  %0 = linalg.depthwise_conv_2d_nhwc_hwc {dilations = dense<1> : tensor<2xi64>, strides = dense<1> : tensor<2xi64>}
+    ins(%i, %f: tensor<1x9x9x24xf32>, tensor<3x3x24xf32>) outs(%o: tensor<1x7x7x24xf32>) -> tensor<1x7x7x24xf32>
+  return %0: tensor<1x7x7x24xf32>
+}
+
+// CHECK-LABEL: func.func @depthwise_conv_partial(
+// CHECK-NOT: tensor.pack
+// CHECK: linalg.depthwise_conv_2d_nhwc_hwc
+
+// -----
+
+func.func @grouped_conv(%i: tensor<1x2x16x8x8xf32>, %f: tensor<32x2x16x3x3xf32>,
+                        %o: tensor<1x2x32x6x6xf32>) -> tensor<1x2x32x6x6xf32> {
+  %0 = linalg.conv_2d_ngchw_fgchw {dilations = dense<1> : tensor<2xi64>, strides = dense<1> : tensor<2xi64>}
+    ins(%i, %f: tensor<1x2x16x8x8xf32>, tensor<32x2x16x3x3xf32>) outs(%o: tensor<1x2x32x6x6xf32>) -> tensor<1x2x32x6x6xf32>
+  return %0: tensor<1x2x32x6x6xf32>
+}
+
+// CHECK: func.func @grouped_conv(
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<1x2x16x8x8xf32>,
+// CHECK-SAME:  %[[ARG1:.+]]: tensor<32x2x16x3x3xf32>,
+// CHECK-SAME:  %[[ARG2:.+]]: tensor<1x2x32x6x6xf32>) -> tensor<1x2x32x6x6xf32> {
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : index
+// CHECK-DAG: %[[C1:.+]] = arith.constant 1 : index
+// CHECK-DAG: %[[C2:.+]] = arith.constant 2 : index
+// CHECK: %[[LOOP:.+]] = scf.for %[[G:.+]] = %[[C0]] to %[[C2]] step %[[C1]]
+// CHECK-SAME:  iter_args(%[[ACC:.+]] = %[[ARG2]]) -> (tensor<1x2x32x6x6xf32>)
+// CHECK: %[[IMG:.+]] = tensor.extract_slice %[[ARG0]][0, %[[G]], 0, 0, 0] [1, 1, 16, 8, 8] [1, 1, 1, 1, 1]
+// CHECK-SAME:  : tensor<1x2x16x8x8xf32> to tensor<1x16x8x8xf32>
+// CHECK: %[[FIL:.+]] = tensor.extract_slice %[[ARG1]][0, %[[G]], 0, 0, 0] [32, 1, 16, 3, 3] [1, 1, 1, 1, 1]
+// CHECK-SAME:  : tensor<32x2x16x3x3xf32> to tensor<32x16x3x3xf32>
+// CHECK: %[[OUT:.+]] = tensor.extract_slice %[[ACC]][0, %[[G]], 0, 0, 0] [1, 1, 32, 6, 6] [1, 1, 1, 1, 1]
+// CHECK-SAME:  : tensor<1x2x32x6x6xf32> to tensor<1x32x6x6xf32>
+// CHECK: %[[CONV:.+]] = linalg.conv_2d_nchw_fchw
+// CHECK-SAME:  ins(%[[IMG]], %[[FIL]] : tensor<1x16x8x8xf32>, tensor<32x16x3x3xf32>)
+// CHECK-SAME:  outs(%[[OUT]] : tensor<1x32x6x6xf32>)
+// CHECK: %[[INS:.+]] = tensor.insert_slice %[[CONV]] into %[[ACC]][0, %[[G]], 0, 0, 0] [1, 1, 32, 6, 6] [1, 1, 1, 1, 1]
+// CHECK: scf.yield %[[INS]]
+// CHECK: return %[[LOOP]]
@@ -0,0 +1,56 @@
+// RUN: tpp-opt %s -lower-packs-unpacks="transpose-kernels" -split-input-file | FileCheck %s
+// RUN: tpp-opt %s -lower-packs-unpacks -split-input-file | FileCheck %s --check-prefix=DEFAULT
+
+// The blocks of the rhs are transposed by a 2-D kernel each.
+func.func @pack_transpose_blocks(%arg0: tensor<128x256xf32>, %arg1: tensor<4x8x32x32xf32>) -> tensor<4x8x32x32xf32> {
+  %pack = tensor.pack %arg0 inner_dims_pos = [1, 0] inner_tiles = [32, 32] into %arg1
+    : tensor<128x256xf32> -> tensor<4x8x32x32xf32>
+  return %pack : tensor<4x8x32x32xf32>
+}
+
+// CHECK-LABEL: pack_transpose_blocks
+// CHECK: scf.forall (%{{.+}}, %{{.+}}) in (4, 8)
+// CHECK: %[[TRN:.+]] = linalg.transpose ins(%{{.+}} : tensor<32x32xf32>) outs(%{{.+}} : tensor<32x32xf32>)
+// CHECK-SAME:  permutation = [1, 0]
+// CHECK: tensor.expand_shape %[[TRN]]
+// CHECK-SAME:  : tensor<32x32xf32> into tensor<1x1x32x32xf32>
+// CHECK: tensor.parallel_insert_slice
+
+// DEFAULT-LABEL: pack_transpose_blocks
+// DEFAULT: linalg.transpose ins(%{{.+}} : tensor<{{.+}}>) outs(%{{.+}} : tensor<1x1x32x32xf32>)
+
+// -----
+
+// The outer dimension moved by the first pack is a unit dimension of the
+// tile and becomes a copy, the VNNI interleave of the second pack is tiled
+// over its blocks.
+func.func @pack_fusion_outer_only(%arg0: tensor<1024x512xbf16>, %arg1: tensor<16x16x32x32x2xbf16>) -> tensor<16x16x32x32x2xbf16> {
+  %1 = tensor.empty() : tensor<16x32x32x32xbf16>
+  %pack_0 = tensor.pack %arg0 outer_dims_perm = [1, 0] inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %1
+    : tensor<1024x512xbf16> -> tensor<16x32x32x32xbf16>
+  %pack_1 = tensor.pack %pack_0 inner_dims_pos = [1] inner_tiles = [2] into %arg1
+    : tensor<16x32x32x32xbf16> -> tensor<16x16x32x32x2xbf16>
+  return %pack_1 : tensor<16x16x32x32x2xbf16>
+}
+
+// CHECK-LABEL: pack_fusion_outer_only
+// CHECK: scf.forall (%{{.+}}) in (16)
+// CHECK: linalg.copy ins(%{{.+}} : tensor<32x32x32xbf16>) outs(%{{.+}} : tensor<32x32x32xbf16>)
+// CHECK: scf.forall (%{{.+}}) in (16)
+// CHECK: linalg.transpose ins(%{{.+}} : tensor<2x32x32xbf16>) outs(%{{.+}} : tensor<32x32x2xbf16>)
+// CHECK-SAME:  permutation = [1, 2, 0]
+// CHECK-NOT: linalg.transpose
+
+// -----
+
+// A VNNI pack is left to the VNNI kernel.
+func.func @vnni_packing(%arg0: tensor<16x16xbf16>, %arg1: tensor<8x16x2xbf16>) -> tensor<8x16x2xbf16> {
+  %pack = tensor.pack %arg0 inner_dims_pos = [0] inner_tiles = [2] into %arg1 : tensor<16x16xbf16> -> tensor<8x16x2xbf16>
+  return %pack : tensor<8x16x2xbf16>
+}
+
+// CHECK-LABEL: vnni_packing
+// CHECK: scf.forall (%{{.+}}) in (8)
+// CHECK: %[[EXP:.+]] = tensor.expand_shape %{{.+}} : tensor<2x16xbf16> into tensor<1x2x16xbf16>
+// CHECK: linalg.transpose ins(%[[EXP]] : tensor<1x2x16xbf16>)
+// CHECK-SAME:  outs(%{{.+}} : tensor<1x16x2xbf16>) permutation = [0, 2, 1]
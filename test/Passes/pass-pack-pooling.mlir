@@ -0,0 +1,64 @@
+// RUN: tpp-opt %s -pack-conv2DNhwcHwcf="block-factors=32,32" -split-input-file | FileCheck %s
+
+func.func @max_pool(%i: tensor<1x8x8x64xf32>, %o: tensor<1x4x4x64xf32>) -> tensor<1x4x4x64xf32> {
+  %w = tensor.empty() : tensor<2x2xf32>
+  %0 = linalg.pooling_nhwc_max {dilations = dense<1> : tensor<2xi64>, strides = dense<2> : tensor<2xi64>}
+    ins(%i, %w: tensor<1x8x8x64xf32>, tensor<2x2xf32>) outs(%o: tensor<1x4x4x64xf32>) -> tensor<1x4x4x64xf32>
+  return %0: tensor<1x4x4x64xf32>
+}
+
+// CHECK-DAG: #[[MAP0:.+]] = affine_map<(d0, d1, d2, d3, d4, d5, d6) -> (d0, d1, d2 * 2 + d5, d3 * 2 + d6, d4)>
+// CHECK-DAG: #[[MAP1:.+]] = affine_map<(d0, d1, d2, d3, d4, d5, d6) -> (d5, d6)>
+// CHECK-DAG: #[[MAP2:.+]] = affine_map<(d0, d1, d2, d3, d4, d5, d6) -> (d0, d1, d2, d3, d4)>
+
+// CHECK: func.func @max_pool(
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<1x8x8x64xf32>,
+// CHECK-SAME:  %[[ARG1:.+]]: tensor<1x4x4x64xf32>) -> tensor<1x4x4x64xf32> {
+// CHECK: %[[WIN:.+]] = tensor.empty() : tensor<2x2xf32>
+// CHECK: %[[PACK0:.+]] = tensor.pack %[[ARG0]] outer_dims_perm = [0, 3, 1, 2] inner_dims_pos = [3] inner_tiles = [32]
+// CHECK-SAME:  : tensor<1x8x8x64xf32> -> tensor<1x2x8x8x32xf32>
+// CHECK: %[[PACK1:.+]] = tensor.pack %[[ARG1]] outer_dims_perm = [0, 3, 1, 2] inner_dims_pos = [3] inner_tiles = [32]
+// CHECK-SAME:  : tensor<1x4x4x64xf32> -> tensor<1x2x4x4x32xf32>
+// CHECK: %[[VAL:.+]] = linalg.generic {indexing_maps = [#[[MAP0]], #[[MAP1]], #[[MAP2]]], iterator_types = ["parallel", "parallel", "parallel", "parallel", "parallel", "reduction", "reduction"]}
+// CHECK-SAME:  ins(%[[PACK0]], %[[WIN]] : tensor<1x2x8x8x32xf32>, tensor<2x2xf32>) outs(%[[PACK1]] : tensor<1x2x4x4x32xf32>)
+// CHECK: arith.maximumf
+// CHECK: %[[OUT:.+]] = tensor.unpack %[[VAL]] outer_dims_perm = [0, 3, 1, 2] inner_dims_pos = [3] inner_tiles = [32] into %[[ARG1]]
+// CHECK: return %[[OUT]] : tensor<1x4x4x64xf32>
+
+// -----
+
+func.func @conv_relu_sum_pool(%i: tensor<1x6x6x32xf32>, %f: tensor<3x3x32x64xf32>,
+    %o: tensor<1x4x4x64xf32>, %p: tensor<1x2x2x64xf32>) -> tensor<1x2x2x64xf32> {
+  %cst = arith.constant 0.0 : f32
+  %0 = linalg.conv_2d_nhwc_hwcf {dilations = dense<1> : tensor<2xi64>, strides = dense<1> : tensor<2xi64>}
+    ins(%i, %f: tensor<1x6x6x32xf32>, tensor<3x3x32x64xf32>) outs(%o: tensor<1x4x4x64xf32>) -> tensor<1x4x4x64xf32>
+  %w = tensor.empty() : tensor<2x2xf32>
+  %1 = linalg.pooling_nhwc_sum {dilations = dense<1> : tensor<2xi64>, strides = dense<2> : tensor<2xi64>}
+    ins(%0, %w: tensor<1x4x4x64xf32>, tensor<2x2xf32>) outs(%p: tensor<1x2x2x64xf32>) -> tensor<1x2x2x64xf32>
+  return %1: tensor<1x2x2x64xf32>
+}
+
+// The pooling packs the output of the convolution with the same block.
+// CHECK-LABEL: func.func @conv_relu_sum_pool(
+// CHECK: %[[CONV:.+]] = linalg.generic
+// CHECK-SAME:  outs(%{{.+}} : tensor<1x2x4x4x32xf32>)
+// CHECK: %[[UNPACK:.+]] = tensor.unpack %[[CONV]] outer_dims_perm = [0, 3, 1, 2] inner_dims_pos = [3] inner_tiles = [32]
+// CHECK: tensor.pack %[[UNPACK]] outer_dims_perm = [0, 3, 1, 2] inner_dims_pos = [3] inner_tiles = [32]
+// CHECK-SAME:  : tensor<1x4x4x64xf32> -> tensor<1x2x4x4x32xf32>
+// CHECK: linalg.generic
+// CHECK-SAME:  outs(%{{.+}} : tensor<1x2x2x2x32xf32>)
+// CHECK: arith.addf
+
+// -----
+
+// We don't expect to block as the blocking factor does not create full tiles.
+func.func @max_pool_partial(%i: tensor<1x8x8x24xf32>, %o: tensor<1x4x4x24xf32>) -> tensor<1x4x4x24xf32> {
+  %w = tensor.empty() : tensor<2x2xf32>
+  %0 = linalg.pooling_nhwc_max {dilations = dense<1> : tensor<2xi64>, strides = dense<2> : tensor<2xi64>}
+    ins(%i, %w: tensor<1x8x8x24xf32>, tensor<2x2xf32>) outs(%o: tensor<1x4x4x24xf32>) -> tensor<1x4x4x24xf32>
+  return %0: tensor<1x4x4x24xf32>
+}
+
+// CHECK-LABEL: func.func @max_pool_partial(
+// CHECK-NOT: tensor.pack
+// CHECK: linalg.pooling_nhwc_max
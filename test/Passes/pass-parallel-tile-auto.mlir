@@ -0,0 +1,65 @@
+// RUN: tpp-opt %s --scf-parallel-loop-tiling-pass="parallel-loop-tile-sizes=0 num-threads=16" -split-input-file | FileCheck %s
+// RUN: tpp-opt %s --scf-parallel-loop-tiling-pass="parallel-loop-tile-sizes=0 num-threads=56" -split-input-file | FileCheck %s --check-prefix=THREADS56
+// RUN: tpp-opt %s --scf-parallel-loop-tiling-pass="parallel-loop-tile-sizes=2,0 num-threads=16" -split-input-file | FileCheck %s --check-prefix=FIXED
+
+func.func @grid(%arg0: memref<8x32xi32>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c8 = arith.constant 8 : index
+  %c32 = arith.constant 32 : index
+  %c0_i32 = arith.constant 0 : i32
+  scf.parallel (%i, %j) = (%c0, %c0) to (%c8, %c32) step (%c1, %c1) {
+    memref.store %c0_i32, %arg0[%i, %j] : memref<8x32xi32>
+    scf.reduce
+  }
+  return
+}
+
+// 16 threads run one square tile each.
+// CHECK-LABEL: func.func @grid(
+// CHECK-DAG: %[[C1:.+]] = arith.constant 1 : index
+// CHECK-DAG: %[[C4:.+]] = arith.constant 4 : index
+// CHECK-DAG: %[[C4_0:.+]] = arith.constant 4 : index
+// CHECK: %[[STEP0:.+]] = arith.muli %[[C1]], %[[C4]] : index
+// CHECK: %[[STEP1:.+]] = arith.muli %[[C1]], %[[C4_0]] : index
+// CHECK: scf.parallel ({{.+}}) = ({{.+}}) to ({{.+}}) step (%[[STEP0]], %[[STEP1]])
+// CHECK:   scf.for %{{.+}} = %{{.+}} to %[[STEP0]]
+// CHECK:     scf.for %{{.+}} = %{{.+}} to %[[STEP1]]
+
+// 56 threads run one 1x5 tile each, the last column of tiles is partial.
+// THREADS56-LABEL: func.func @grid(
+// THREADS56-DAG: %[[C1:.+]] = arith.constant 1 : index
+// THREADS56-DAG: %[[C5:.+]] = arith.constant 5 : index
+// THREADS56: %[[STEP0:.+]] = arith.muli %[[C1]], %[[C1]]{{.*}} : index
+// THREADS56: %[[STEP1:.+]] = arith.muli %[[C1]], %[[C5]] : index
+// THREADS56: scf.parallel ({{.+}}) = ({{.+}}) to ({{.+}}) step (%[[STEP0]], %[[STEP1]])
+// THREADS56:   affine.min
+// THREADS56:   scf.for
+
+// The fixed rows leave 4 rows of tiles, 4 columns fill the 16 threads.
+// FIXED-LABEL: func.func @grid(
+// FIXED-DAG: %[[C2:.+]] = arith.constant 2 : index
+// FIXED-DAG: %[[C8:.+]] = arith.constant 8 : index
+// FIXED: arith.muli %{{.+}}, %[[C2]] : index
+// FIXED: arith.muli %{{.+}}, %[[C8]]{{.*}} : index
+
+// -----
+
+// Dynamic dimensions are not tiled.
+func.func @dynamic(%arg0: memref<?x32xi32>, %arg1: index) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c32 = arith.constant 32 : index
+  %c0_i32 = arith.constant 0 : i32
+  scf.parallel (%i, %j) = (%c0, %c0) to (%arg1, %c32) step (%c1, %c1) {
+    memref.store %c0_i32, %arg0[%i, %j] : memref<?x32xi32>
+    scf.reduce
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @dynamic(
+// CHECK-DAG: %[[C1:.+]] = arith.constant 1 : index
+// CHECK-DAG: %[[C2:.+]] = arith.constant 2 : index
+// CHECK: arith.muli %{{.+}}, %[[C1]]{{.*}} : index
+// CHECK: arith.muli %{{.+}}, %[[C2]] : index
@@ -0,0 +1,29 @@
+// RUN: tpp-opt %s --scf-parallel-loop-tiling-pass="parallel-loop-tile-sizes=2,4 distribute-last-dim" | FileCheck %s
+
+func.func @columns_first(%arg0: memref<8x32xi32>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c8 = arith.constant 8 : index
+  %c32 = arith.constant 32 : index
+  %c0_i32 = arith.constant 0 : i32
+  scf.parallel (%i, %j) = (%c0, %c0) to (%c8, %c32) step (%c1, %c1) {
+    memref.store %c0_i32, %arg0[%i, %j] : memref<8x32xi32>
+    scf.reduce
+  }
+  return
+}
+
+// The columns are the outermost dimension, with their tile size.
+// CHECK-LABEL: func.func @columns_first(
+// CHECK-DAG: %[[C8:.+]] = arith.constant 8 : index
+// CHECK-DAG: %[[C32:.+]] = arith.constant 32 : index
+// CHECK-DAG: %[[C2:.+]] = arith.constant 2 : index
+// CHECK-DAG: %[[C4:.+]] = arith.constant 4 : index
+// CHECK: %[[STEP0:.+]] = arith.muli %{{.+}}, %[[C4]] : index
+// CHECK: %[[STEP1:.+]] = arith.muli %{{.+}}, %[[C2]] : index
+// CHECK: scf.parallel (%[[J:.+]], %[[I:.+]]) = (%{{.+}}, %{{.+}}) to (%[[C32]], %[[C8]]) step (%[[STEP0]], %[[STEP1]])
+// CHECK:   scf.for %[[JJ:.+]] = %{{.+}} to %[[STEP0]]
+// CHECK:     scf.for %[[II:.+]] = %{{.+}} to %[[STEP1]]
+// CHECK:       %[[COL:.+]] = arith.addi %[[JJ]], %[[J]] : index
+// CHECK:       %[[ROW:.+]] = arith.addi %[[II]], %[[I]] : index
+// CHECK:       memref.store %{{.+}}, %{{.+}}[%[[ROW]], %[[COL]]] : memref<8x32xi32>
@@ -0,0 +1,107 @@
+// RUN: tpp-opt %s -split-input-file --scf-parallel-loop-tiling-pass="parallel-loop-tile-sizes=2,4 num-threads=3 tile-traversal=col" | FileCheck %s --check-prefix=COL
+// RUN: tpp-opt %s -split-input-file --scf-parallel-loop-tiling-pass="parallel-loop-tile-sizes=2,4 num-threads=4 tile-traversal=grouped" | FileCheck %s --check-prefix=GROUPED
+// RUN: tpp-opt %s -split-input-file --scf-parallel-loop-tiling-pass="parallel-loop-tile-sizes=2,4 num-threads=4 tile-traversal=morton" | FileCheck %s --check-prefix=MORTON
+// RUN: tpp-opt %s -split-input-file --scf-parallel-loop-tiling-pass="parallel-loop-tile-sizes=1,1 num-threads=8 tile-traversal=auto" | FileCheck %s --check-prefix=AUTO
+
+func.func @store(%arg0: memref<16x32xi32>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c16 = arith.constant 16 : index
+  %c32 = arith.constant 32 : index
+  %c0_i32 = arith.constant 0 : i32
+  scf.parallel (%i, %j) = (%c0, %c0) to (%c16, %c32) step (%c1, %c1) {
+    memref.store %c0_i32, %arg0[%i, %j] : memref<16x32xi32>
+    scf.reduce
+  }
+  return
+}
+
+// The 8x8 tiles are numbered by columns and dealt to the threads round-robin,
+// the last round is partial.
+// COL-LABEL: func.func @store(
+// COL: scf.parallel (%[[T:.+]]) = (%{{.+}}) to (%{{.+}}) step (%{{.+}}) {
+// COL:   scf.for %[[ROUND:.+]] = %{{.+}} to %{{.+}} step %{{.+}} {
+// COL:     %[[FIRST:.+]] = arith.muli %[[ROUND]], %{{.+}} : index
+// COL:     %[[K:.+]] = arith.addi %[[FIRST]], %[[T]] : index
+// COL:     %[[IN:.+]] = arith.cmpi ult, %[[K]], %{{.+}} : index
+// COL:     scf.if %[[IN]] {
+// COL:       %[[ROW:.+]] = arith.remui %[[K]], %{{.+}} : index
+// COL:       %[[COL:.+]] = arith.divui %[[K]], %{{.+}} : index
+// COL:       %[[ROWOFF:.+]] = arith.muli %[[ROW]], %{{.+}} : index
+// COL:       %[[I:.+]] = arith.addi %{{.+}}, %[[ROWOFF]] : index
+// COL:       %[[COLOFF:.+]] = arith.muli %[[COL]], %{{.+}} : index
+// COL:       %[[J:.+]] = arith.addi %{{.+}}, %[[COLOFF]] : index
+// COL:       scf.for %[[II:.+]] =
+// COL:         scf.for %[[JJ:.+]] =
+// COL:           %[[R:.+]] = arith.addi %[[II]], %[[I]] : index
+// COL:           %[[C:.+]] = arith.addi %[[JJ]], %[[J]] : index
+// COL:           memref.store %{{.+}}, %{{.+}}[%[[R]], %[[C]]] : memref<16x32xi32>
+
+// The groups of two rows of tiles are walked by columns.
+// GROUPED-LABEL: func.func @store(
+// GROUPED: scf.parallel (%[[T:.+]]) = (%{{.+}}) to (%{{.+}}) step (%{{.+}}) {
+// GROUPED:   scf.for %[[ROUND:.+]] =
+// GROUPED:     %[[K:.+]] = arith.addi %{{.+}}, %[[T]] : index
+// GROUPED-NOT: scf.if
+// GROUPED:     %[[GROUP:.+]] = arith.divui %[[K]], %{{.+}} : index
+// GROUPED:     %[[FIRST:.+]] = arith.muli %[[GROUP]], %{{.+}} : index
+// GROUPED:     %[[WITHIN:.+]] = arith.remui %[[K]], %{{.+}} : index
+// GROUPED:     %[[LEFT:.+]] = arith.subi %{{.+}}, %[[FIRST]] : index
+// GROUPED:     %[[ROWS:.+]] = arith.minui %[[LEFT]], %{{.+}} : index
+// GROUPED:     %[[OFF:.+]] = arith.remui %[[WITHIN]], %[[ROWS]] : index
+// GROUPED:     %[[ROW:.+]] = arith.addi %[[FIRST]], %[[OFF]] : index
+// GROUPED:     %[[COL:.+]] = arith.divui %[[WITHIN]], %[[ROWS]] : index
+// GROUPED:     arith.muli %[[ROW]], %{{.+}} : index
+// GROUPED:     arith.muli %[[COL]], %{{.+}} : index
+// GROUPED:     memref.store
+
+// The 8x8 grid is a single Morton block, the odd bits of the tile number give
+// the row and the even ones the column.
+// MORTON-LABEL: func.func @store(
+// MORTON: scf.parallel (%[[T:.+]]) = (%{{.+}}) to (%{{.+}}) step (%{{.+}}) {
+// MORTON:   scf.for %[[ROUND:.+]] =
+// MORTON:     %[[K:.+]] = arith.addi %{{.+}}, %[[T]] : index
+// MORTON:     %[[BLOCK:.+]] = arith.divui %[[K]], %{{.+}} : index
+// MORTON:     %[[WITHIN:.+]] = arith.remui %[[K]], %{{.+}} : index
+// MORTON:     arith.divui %[[BLOCK]], %{{.+}} : index
+// MORTON:     arith.remui %[[BLOCK]], %{{.+}} : index
+// MORTON-COUNT-6: arith.shrui %[[WITHIN]], %{{.+}} : index
+// MORTON:     memref.store
+
+// -----
+
+module attributes {
+  dlti.target_system_spec = #dlti.target_system_spec<
+    "CPU" = #dlti.target_device_spec<
+      #dlti.dl_entry<"L3_cache_size_in_bytes", 1048576 : i32>>>
+} {
+  func.func @brgemm(%arg0: memref<16x16x32x32xf32>, %arg1: memref<16x16x32x32xf32>,
+                    %arg2: memref<16x16x32x32xf32>) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c16 = arith.constant 16 : index
+    scf.parallel (%i, %j) = (%c0, %c0) to (%c16, %c16) step (%c1, %c1) {
+      %a = memref.subview %arg0[%i, 0, 0, 0] [1, 16, 32, 32] [1, 1, 1, 1]
+        : memref<16x16x32x32xf32> to memref<16x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+      %b = memref.subview %arg1[%j, 0, 0, 0] [1, 16, 32, 32] [1, 1, 1, 1]
+        : memref<16x16x32x32xf32> to memref<16x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+      %c = memref.subview %arg2[%i, %j, 0, 0] [1, 1, 32, 32] [1, 1, 1, 1]
+        : memref<16x16x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
+      linalg.batch_reduce_matmul
+        ins(%a, %b : memref<16x32x32xf32, strided<[1024, 32, 1], offset: ?>>,
+                     memref<16x32x32xf32, strided<[1024, 32, 1], offset: ?>>)
+        outs(%c : memref<32x32xf32, strided<[32, 1], offset: ?>>)
+      scf.reduce
+    }
+    return
+  }
+}
+
+// The A and B panels of the 16x16 tiles take 2 MiB, over the 1 MiB of L3:
+// the 8 threads run the tiles of groups of two rows, which read 6 panels per
+// round instead of the 9 of the rows.
+// AUTO-LABEL: func.func @brgemm(
+// AUTO: scf.parallel (%[[T:.+]]) = (%{{.+}}) to (%{{.+}}) step (%{{.+}}) {
+// AUTO:   scf.for
+// AUTO:     arith.minui
+// AUTO:     linalg.batch_reduce_matmul
@@ -0,0 +1,91 @@
+// RUN: tpp-opt %s --parallelize-standalone-ops --split-input-file | FileCheck %s
+// RUN: tpp-opt %s --parallelize-standalone-ops="row-tile=64 min-elements=0" --split-input-file | FileCheck %s --check-prefix=TILE
+
+func.func @fill(%arg0: memref<256x128xf32>) {
+  %cst = arith.constant 1.000000e+00 : f32
+  linalg.fill ins(%cst : f32) outs(%arg0 : memref<256x128xf32>)
+  return
+}
+
+// CHECK-LABEL: func.func @fill(
+// CHECK-SAME: %[[ARG0:.+]]: memref<256x128xf32>
+// CHECK: %[[CST:.+]] = arith.constant 1.000000e+00 : f32
+// CHECK: scf.forall (%[[ROW:.+]]) = (0) to (256) step (32) {
+// CHECK:   %[[SUB:.+]] = memref.subview %[[ARG0]][%[[ROW]], 0] [32, 128] [1, 1]
+// CHECK:   linalg.fill ins(%[[CST]] : f32) outs(%[[SUB]] : memref<32x128xf32, strided<[128, 1], offset: ?>>)
+// CHECK: }
+// CHECK-NEXT: return
+
+// TILE-LABEL: func.func @fill(
+// TILE: scf.forall (%{{.+}}) = (0) to (256) step (64)
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+#map1 = affine_map<(d0, d1) -> (d1)>
+
+// The bias is broadcast along the rows and used whole by each tile.
+func.func @bias_relu(%arg0: memref<96x256xf32>, %arg1: memref<256xf32>, %arg2: memref<96x256xf32>) {
+  %cst = arith.constant 0.000000e+00 : f32
+  linalg.generic {indexing_maps = [#map, #map1, #map], iterator_types = ["parallel", "parallel"]}
+    ins(%arg0, %arg1 : memref<96x256xf32>, memref<256xf32>) outs(%arg2 : memref<96x256xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %0 = arith.addf %in, %in_0 : f32
+    %1 = arith.maximumf %0, %cst : f32
+    linalg.yield %1 : f32
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @bias_relu(
+// CHECK-SAME: %[[ARG0:.+]]: memref<96x256xf32>, %[[ARG1:.+]]: memref<256xf32>, %[[ARG2:.+]]: memref<96x256xf32>
+// CHECK: scf.forall (%[[ROW:.+]]) = (0) to (96) step (32) {
+// CHECK:   %[[IN:.+]] = memref.subview %[[ARG0]][%[[ROW]], 0] [32, 256] [1, 1]
+// CHECK:   %[[OUT:.+]] = memref.subview %[[ARG2]][%[[ROW]], 0] [32, 256] [1, 1]
+// CHECK:   linalg.generic
+// CHECK-SAME: ins(%[[IN]], %[[ARG1]] : memref<32x256xf32, strided<[256, 1], offset: ?>>, memref<256xf32>)
+// CHECK-SAME: outs(%[[OUT]] : memref<32x256xf32, strided<[256, 1], offset: ?>>)
+
+// TILE-LABEL: func.func @bias_relu(
+// TILE: scf.forall (%{{.+}}) = (0) to (96) step (48)
+
+// -----
+
+// Bufferization copies become tiled linalg copies.
+func.func @copy(%arg0: memref<512x64xf32>, %arg1: memref<512x64xf32>) {
+  memref.copy %arg0, %arg1 : memref<512x64xf32> to memref<512x64xf32>
+  return
+}
+
+// CHECK-LABEL: func.func @copy(
+// CHECK-SAME: %[[ARG0:.+]]: memref<512x64xf32>, %[[ARG1:.+]]: memref<512x64xf32>
+// CHECK-NOT: memref.copy
+// CHECK: scf.forall (%[[ROW:.+]]) = (0) to (512) step (32) {
+// CHECK:   %[[SRC:.+]] = memref.subview %[[ARG0]][%[[ROW]], 0] [32, 64] [1, 1]
+// CHECK:   %[[DST:.+]] = memref.subview %[[ARG1]][%[[ROW]], 0] [32, 64] [1, 1]
+// CHECK:   linalg.copy ins(%[[SRC]] : {{.+}}) outs(%[[DST]] : {{.+}})
+
+// -----
+
+// Small ops, ops in loops and reductions are left alone.
+func.func @skipped(%arg0: memref<16x16xf32>, %arg1: memref<256x128xf32>, %arg2: memref<256xf32>) {
+  %cst = arith.constant 0.000000e+00 : f32
+  linalg.fill ins(%cst : f32) outs(%arg0 : memref<16x16xf32>)
+  scf.forall (%i) in (2) {
+    linalg.fill ins(%cst : f32) outs(%arg1 : memref<256x128xf32>)
+  }
+  linalg.reduce ins(%arg1 : memref<256x128xf32>) outs(%arg2 : memref<256xf32>) dimensions = [1]
+    (%in: f32, %init: f32) {
+      %0 = arith.addf %in, %init : f32
+      linalg.yield %0 : f32
+    }
+  return
+}
+
+// CHECK-LABEL: func.func @skipped(
+// CHECK: linalg.fill ins(%{{.+}} : f32) outs(%{{.+}} : memref<16x16xf32>)
+// CHECK: scf.forall (%{{.+}}) in (2) {
+// CHECK-NEXT: linalg.fill ins(%{{.+}} : f32) outs(%{{.+}} : memref<256x128xf32>)
+// CHECK: }
+// CHECK-NOT: scf.forall
+// CHECK: linalg.reduce
@@ -0,0 +1,95 @@
+// RUN: tpp-opt %s --pipeline-parallel-layers --split-input-file | FileCheck %s
+
+// Two layers chained through %buf by rows of 32x32 blocks.
+func.func @two_layers(%arg0: memref<4x8x32x32xf32>, %arg1: memref<8x8x32x32xf32>,
+                      %arg2: memref<4x8x32x32xf32>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c4 = arith.constant 4 : index
+  %c8 = arith.constant 8 : index
+  %buf = memref.alloc() : memref<4x8x32x32xf32>
+  scf.parallel (%i, %j) = (%c0, %c0) to (%c4, %c8) step (%c1, %c1) {
+    %in = memref.subview %arg0[%i, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1] : memref<4x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    %w = memref.subview %arg1[%j, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1] : memref<8x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    %out = memref.subview %buf[%i, %j, 0, 0] [1, 1, 32, 32] [1, 1, 1, 1] : memref<4x8x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
+    linalg.batch_reduce_matmul ins(%in, %w : memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>, memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>) outs(%out : memref<32x32xf32, strided<[32, 1], offset: ?>>)
+    scf.reduce
+  }
+  %w2 = memref.alloc() : memref<8x8x32x32xf32>
+  scf.parallel (%i, %j) = (%c0, %c0) to (%c4, %c8) step (%c1, %c1) {
+    %in = memref.subview %buf[%i, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1] : memref<4x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    %w = memref.subview %w2[%j, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1] : memref<8x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    %out = memref.subview %arg2[%i, %j, 0, 0] [1, 1, 32, 32] [1, 1, 1, 1] : memref<4x8x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
+    linalg.batch_reduce_matmul ins(%in, %w : memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>, memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>) outs(%out : memref<32x32xf32, strided<[32, 1], offset: ?>>)
+    scf.reduce
+  }
+  memref.dealloc %buf : memref<4x8x32x32xf32>
+  memref.dealloc %w2 : memref<8x8x32x32xf32>
+  return
+}
+
+// CHECK-LABEL: func.func @two_layers(
+// CHECK-SAME:  %[[ARG0:.+]]: memref<4x8x32x32xf32>, %[[ARG1:.+]]: memref<8x8x32x32xf32>, %[[ARG2:.+]]: memref<4x8x32x32xf32>
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : index
+// CHECK-DAG: %[[C1:.+]] = arith.constant 1 : index
+// CHECK-DAG: %[[C4:.+]] = arith.constant 4 : index
+// CHECK-DAG: %[[C8:.+]] = arith.constant 8 : index
+// CHECK: %[[BUF:.+]] = memref.alloc() : memref<4x8x32x32xf32>
+// CHECK: %[[W2:.+]] = memref.alloc() : memref<8x8x32x32xf32>
+// CHECK-NOT: scf.parallel
+// CHECK: %[[ROWS:.+]] = async.create_group %[[C4]] : !async.group
+// CHECK: scf.for %[[R:.+]] = %{{.+}} to %[[C4]] step %{{.+}} {
+// CHECK:   %[[OFF:.+]] = arith.muli %[[R]], %[[C1]] : index
+// CHECK:   %[[ROW:.+]] = arith.addi %[[C0]], %[[OFF]] : index
+// CHECK:   %[[T0:.+]] = async.execute {
+// CHECK:     %[[G0:.+]] = async.create_group %[[C8]] : !async.group
+// CHECK:     scf.for %[[J:.+]] = %[[C0]] to %[[C8]] step %[[C1]] {
+// CHECK:       %[[TILE:.+]] = async.execute {
+// CHECK:         memref.subview %[[ARG0]][%[[ROW]], 0, 0, 0]
+// CHECK:         memref.subview %[[BUF]][%[[ROW]], %[[J]], 0, 0]
+// CHECK:         linalg.batch_reduce_matmul
+// CHECK:         async.yield
+// CHECK:       async.add_to_group %[[TILE]], %[[G0]] : !async.token
+// CHECK:     async.await_all %[[G0]]
+// CHECK:     async.yield
+// CHECK:   %[[T1:.+]] = async.execute [%[[T0]]] {
+// CHECK:     async.create_group %[[C8]] : !async.group
+// CHECK:     scf.for
+// CHECK:       async.execute {
+// CHECK:         memref.subview %[[BUF]][%[[ROW]], 0, 0, 0]
+// CHECK:         memref.subview %[[W2]]
+// CHECK:         memref.subview %[[ARG2]][%[[ROW]], %{{.+}}, 0, 0]
+// CHECK:         linalg.batch_reduce_matmul
+// CHECK:   async.add_to_group %[[T1]], %[[ROWS]] : !async.token
+// CHECK: async.await_all %[[ROWS]]
+// CHECK: memref.dealloc %[[BUF]]
+// CHECK: memref.dealloc %[[W2]]
+
+// -----
+
+// The second loop reads %buf across the rows, the loops are left alone.
+func.func @not_rows(%arg0: memref<4x32xf32>, %arg1: memref<4x32xf32>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c4 = arith.constant 4 : index
+  %cst = arith.constant 0.0 : f32
+  %buf = memref.alloc() : memref<4x32xf32>
+  scf.parallel (%i) = (%c0) to (%c4) step (%c1) {
+    %out = memref.subview %buf[%i, 0] [1, 32] [1, 1] : memref<4x32xf32> to memref<32xf32, strided<[1], offset: ?>>
+    linalg.fill ins(%cst : f32) outs(%out : memref<32xf32, strided<[1], offset: ?>>)
+    scf.reduce
+  }
+  scf.parallel (%i) = (%c0) to (%c4) step (%c1) {
+    %out = memref.subview %arg1[%i, 0] [1, 32] [1, 1] : memref<4x32xf32> to memref<32xf32, strided<[1], offset: ?>>
+    %in = memref.subview %buf[0, 0] [1, 32] [1, 1] : memref<4x32xf32> to memref<32xf32, strided<[1]>>
+    linalg.copy ins(%in : memref<32xf32, strided<[1]>>) outs(%out : memref<32xf32, strided<[1], offset: ?>>)
+    scf.reduce
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @not_rows(
+// CHECK-NOT: async.
+// CHECK: scf.parallel
+// CHECK: scf.parallel
+// CHECK-NOT: async.
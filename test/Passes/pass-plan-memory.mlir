@@ -0,0 +1,89 @@
+// RUN: tpp-opt %s --plan-memory --split-input-file | FileCheck %s
+// RUN: tpp-opt %s --plan-memory="global-arena" --split-input-file | FileCheck %s --check-prefix=GLOBAL
+
+// The first and the last buffers of the chain are never live at the same time
+// and share the start of the arena.
+func.func @mlp(%arg0: memref<4x8xf32>, %arg1: memref<8x8xf32>, %arg2: memref<4x8xf32>) {
+  %cst = arith.constant 0.000000e+00 : f32
+  %alloc = memref.alloc() {alignment = 64 : i64} : memref<4x8xf32>
+  linalg.fill ins(%cst : f32) outs(%alloc : memref<4x8xf32>)
+  linalg.matmul ins(%arg0, %arg1 : memref<4x8xf32>, memref<8x8xf32>) outs(%alloc : memref<4x8xf32>)
+  %alloc_0 = memref.alloc() {alignment = 64 : i64} : memref<4x8xf32>
+  linalg.fill ins(%cst : f32) outs(%alloc_0 : memref<4x8xf32>)
+  linalg.matmul ins(%alloc, %arg1 : memref<4x8xf32>, memref<8x8xf32>) outs(%alloc_0 : memref<4x8xf32>)
+  memref.dealloc %alloc : memref<4x8xf32>
+  %alloc_1 = memref.alloc() {alignment = 64 : i64} : memref<4x8xf32>
+  linalg.fill ins(%cst : f32) outs(%alloc_1 : memref<4x8xf32>)
+  linalg.matmul ins(%alloc_0, %arg1 : memref<4x8xf32>, memref<8x8xf32>) outs(%alloc_1 : memref<4x8xf32>)
+  memref.dealloc %alloc_0 : memref<4x8xf32>
+  linalg.copy ins(%alloc_1 : memref<4x8xf32>) outs(%arg2 : memref<4x8xf32>)
+  memref.dealloc %alloc_1 : memref<4x8xf32>
+  return
+}
+
+// CHECK-LABEL: func.func @mlp(
+// CHECK-SAME:  %[[ARG0:.+]]: memref<4x8xf32>, %[[ARG1:.+]]: memref<8x8xf32>, %[[ARG2:.+]]: memref<4x8xf32>
+// CHECK: %[[ARENA:.+]] = memref.alloc() {alignment = 64 : i64} : memref<256xi8>
+// CHECK: %[[OFF0:.+]] = arith.constant 0 : index
+// CHECK: %[[BUF0:.+]] = memref.view %[[ARENA]][%[[OFF0]]][] : memref<256xi8> to memref<4x8xf32>
+// CHECK: linalg.matmul ins(%[[ARG0]], %[[ARG1]] : {{.+}}) outs(%[[BUF0]] : memref<4x8xf32>)
+// CHECK: %[[OFF1:.+]] = arith.constant 128 : index
+// CHECK: %[[BUF1:.+]] = memref.view %[[ARENA]][%[[OFF1]]][] : memref<256xi8> to memref<4x8xf32>
+// CHECK: linalg.matmul ins(%[[BUF0]], %[[ARG1]] : {{.+}}) outs(%[[BUF1]] : memref<4x8xf32>)
+// CHECK: %[[OFF2:.+]] = arith.constant 0 : index
+// CHECK: %[[BUF2:.+]] = memref.view %[[ARENA]][%[[OFF2]]][] : memref<256xi8> to memref<4x8xf32>
+// CHECK: linalg.matmul ins(%[[BUF1]], %[[ARG1]] : {{.+}}) outs(%[[BUF2]] : memref<4x8xf32>)
+// CHECK: linalg.copy ins(%[[BUF2]] : memref<4x8xf32>) outs(%[[ARG2]] : memref<4x8xf32>)
+// CHECK-NOT: memref.dealloc %[[BUF
+// CHECK: memref.dealloc %[[ARENA]] : memref<256xi8>
+// CHECK-NEXT: return
+
+// GLOBAL: memref.global "private" @__arena_mlp : memref<256xi8> = uninitialized {alignment = 64 : i64}
+// GLOBAL-LABEL: func.func @mlp(
+// GLOBAL: %[[ARENA:.+]] = memref.get_global @__arena_mlp : memref<256xi8>
+// GLOBAL-COUNT-3: memref.view %[[ARENA]]
+// GLOBAL-NOT: memref.alloc
+// GLOBAL-NOT: memref.dealloc
+// GLOBAL: return
+
+// -----
+
+// The returned buffer, the dynamic one and the one escaping through the loop
+// are not planned. The single planned buffer is only moved to the arena when
+// the arena is global.
+func.func @not_planned(%arg0: memref<4x8xf32>, %arg1: index) -> memref<4x8xf32> {
+  %cst = arith.constant 0.000000e+00 : f32
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c4 = arith.constant 4 : index
+  %alloc = memref.alloc() : memref<4x8xf32>
+  linalg.copy ins(%arg0 : memref<4x8xf32>) outs(%alloc : memref<4x8xf32>)
+  %alloc_0 = memref.alloc(%arg1) : memref<?x8xf32>
+  memref.dealloc %alloc_0 : memref<?x8xf32>
+  %alloc_1 = memref.alloc() : memref<4x8xf32>
+  %0 = scf.for %arg2 = %c0 to %c4 step %c1 iter_args(%arg3 = %arg0) -> (memref<4x8xf32>) {
+    scf.yield %alloc_1 : memref<4x8xf32>
+  }
+  linalg.copy ins(%0 : memref<4x8xf32>) outs(%alloc : memref<4x8xf32>)
+  memref.dealloc %alloc_1 : memref<4x8xf32>
+  %alloc_2 = memref.alloc() : memref<8xf32>
+  linalg.fill ins(%cst : f32) outs(%alloc_2 : memref<8xf32>)
+  memref.dealloc %alloc_2 : memref<8xf32>
+  return %alloc : memref<4x8xf32>
+}
+
+// CHECK-LABEL: func.func @not_planned(
+// CHECK: memref.alloc() : memref<4x8xf32>
+// CHECK: memref.alloc(%{{.+}}) : memref<?x8xf32>
+// CHECK: memref.alloc() : memref<4x8xf32>
+// CHECK: memref.alloc() : memref<8xf32>
+// CHECK-NOT: memref.view
+
+// GLOBAL: memref.global "private" @__arena_not_planned : memref<64xi8> = uninitialized {alignment = 64 : i64}
+// GLOBAL-LABEL: func.func @not_planned(
+// GLOBAL: %[[ARENA:.+]] = memref.get_global @__arena_not_planned : memref<64xi8>
+// GLOBAL: memref.alloc() : memref<4x8xf32>
+// GLOBAL: memref.alloc(%{{.+}}) : memref<?x8xf32>
+// GLOBAL: memref.alloc() : memref<4x8xf32>
+// GLOBAL: memref.view %[[ARENA]][%{{.+}}][] : memref<64xi8> to memref<8xf32>
+// GLOBAL-NOT: memref.dealloc %{{.+}} : memref<8xf32>
@@ -0,0 +1,87 @@
+// RUN: tpp-opt %s -prefetch-next-layer -split-input-file | FileCheck %s
+
+// Two layers of an MLP on packed weights.
+func.func @mlp(%x: memref<2x8x32x32xf32>, %w0: memref<8x8x32x32xf32>,
+               %w1: memref<4x8x32x32xf32>, %h: memref<2x8x32x32xf32>,
+               %out: memref<2x4x32x32xf32>) {
+  scf.forall (%i, %j) in (2, 8) {
+    %a = memref.subview %x[%i, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+      : memref<2x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    %b = memref.subview %w0[%j, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+      : memref<8x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    %c = memref.subview %h[%i, %j, 0, 0] [1, 1, 32, 32] [1, 1, 1, 1]
+      : memref<2x8x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
+    linalg.batch_reduce_matmul
+      ins(%a, %b : memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>,
+                   memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>)
+      outs(%c : memref<32x32xf32, strided<[32, 1], offset: ?>>)
+  }
+  scf.forall (%i, %j) in (2, 4) {
+    %a = memref.subview %h[%i, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+      : memref<2x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    %b = memref.subview %w1[%j, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+      : memref<4x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    %c = memref.subview %out[%i, %j, 0, 0] [1, 1, 32, 32] [1, 1, 1, 1]
+      : memref<2x4x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
+    linalg.batch_reduce_matmul
+      ins(%a, %b : memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>,
+                   memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>)
+      outs(%c : memref<32x32xf32, strided<[32, 1], offset: ?>>)
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @mlp(
+// CHECK-SAME:  %{{[^:]+}}: memref<2x8x32x32xf32>, %{{[^:]+}}: memref<8x8x32x32xf32>, %[[W1:[^:]+]]: memref<4x8x32x32xf32>
+// CHECK: scf.forall (%[[I:.+]], %[[J:.+]]) in (2, 8)
+// The iteration i * 8 + j of 16 prefetches the iteration (i * 8 + j) / 2 of 8.
+// CHECK:   %[[NJ:.+]] = arith.remui
+// CHECK:   %[[JSTEP:.+]] = arith.muli %[[NJ]]
+// CHECK:   %[[JOFF:.+]] = arith.addi %{{.+}}, %[[JSTEP]] : index
+// CHECK:   %[[PANEL:.+]] = memref.subview %[[W1]][%[[JOFF]], 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+// CHECK:   scf.for
+// CHECK:     scf.for
+// CHECK:       scf.for
+// CHECK:         memref.prefetch %[[PANEL]][%{{.+}}, %{{.+}}, %{{.+}}], read, locality<2>, data
+// CHECK-SAME:      memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+// CHECK:   linalg.batch_reduce_matmul
+// CHECK: scf.forall (%{{.+}}, %{{.+}}) in (2, 4)
+// CHECK-NOT: memref.prefetch
+// CHECK:   linalg.batch_reduce_matmul
+
+// -----
+
+// The weights of the next layer are only known once the previous one ran.
+func.func @weights_computed(%x: memref<2x8x32x32xf32>, %w: memref<8x8x32x32xf32>,
+                            %h: memref<2x8x32x32xf32>) {
+  scf.forall (%i, %j) in (2, 8) {
+    %a = memref.subview %x[%i, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+      : memref<2x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    %b = memref.subview %w[%j, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+      : memref<8x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    %c = memref.subview %h[%i, %j, 0, 0] [1, 1, 32, 32] [1, 1, 1, 1]
+      : memref<2x8x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
+    linalg.batch_reduce_matmul
+      ins(%a, %b : memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>,
+                   memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>)
+      outs(%c : memref<32x32xf32, strided<[32, 1], offset: ?>>)
+  }
+  %w1 = memref.alloc() : memref<8x8x32x32xf32>
+  scf.forall (%i, %j) in (2, 8) {
+    %a = memref.subview %h[%i, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+      : memref<2x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    %b = memref.subview %w1[%j, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+      : memref<8x8x32x32xf32> to memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    %c = memref.subview %x[%i, %j, 0, 0] [1, 1, 32, 32] [1, 1, 1, 1]
+      : memref<2x8x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
+    linalg.batch_reduce_matmul
+      ins(%a, %b : memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>,
+                   memref<8x32x32xf32, strided<[1024, 32, 1], offset: ?>>)
+      outs(%c : memref<32x32xf32, strided<[32, 1], offset: ?>>)
+  }
+  memref.dealloc %w1 : memref<8x8x32x32xf32>
+  return
+}
+
+// CHECK-LABEL: func.func @weights_computed(
+// CHECK-NOT: memref.prefetch
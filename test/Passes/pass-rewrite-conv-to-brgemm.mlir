@@ -0,0 +1,88 @@
+// RUN: tpp-opt %s -rewrite-conv-to-matmul-or-brgemm="enable-brgemm" -canonicalize -split-input-file | FileCheck %s
+
+#map = affine_map<(d0, d1, d2, d3, d4, d5, d6, d7, d8) -> (d0, d5, d2 * 2 + d6, d3 * 2 + d7, d8)>
+#map1 = affine_map<(d0, d1, d2, d3, d4, d5, d6, d7, d8) -> (d1, d5, d6, d7, d8, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4, d5, d6, d7, d8) -> (d0, d1, d2, d3, d4)>
+
+// A blocked 3x3 convolution with stride 2 maps to a BRGEMM over the blocks of
+// C for each position of the filter, reading the image in place.
+func.func @conv_2d_blocked_strided(%arg0: tensor<1x2x9x9x32xf32>, %arg1: tensor<4x2x3x3x32x32xf32>, %arg2: tensor<1x4x4x4x32xf32>) -> tensor<1x4x4x4x32xf32> {
+  %0 = linalg.generic {
+    indexing_maps = [#map, #map1, #map2],
+    iterator_types = ["parallel", "parallel", "parallel", "parallel", "parallel",
+                      "reduction", "reduction", "reduction", "reduction"]}
+    ins(%arg0, %arg1: tensor<1x2x9x9x32xf32>, tensor<4x2x3x3x32x32xf32>)
+    outs(%arg2: tensor<1x4x4x4x32xf32>) {
+  ^bb0(%in: f32, %in_1: f32, %out: f32):
+    %1 = arith.mulf %in, %in_1 : f32
+    %2 = arith.addf %out, %1 : f32
+    linalg.yield %2 : f32
+  } -> tensor<1x4x4x4x32xf32>
+  return %0 : tensor<1x4x4x4x32xf32>
+}
+
+// CHECK: #[[MAP:.+]] = affine_map<(d0, d1) -> (d0 * 2 + d1)>
+// CHECK: func.func @conv_2d_blocked_strided(
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<1x2x9x9x32xf32>,
+// CHECK-SAME:  %[[ARG1:.+]]: tensor<4x2x3x3x32x32xf32>,
+// CHECK-SAME:  %[[ARG2:.+]]: tensor<1x4x4x4x32xf32>)
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : index
+// CHECK-DAG: %[[C1:.+]] = arith.constant 1 : index
+// CHECK-DAG: %[[C3:.+]] = arith.constant 3 : index
+// CHECK-DAG: %[[C4:.+]] = arith.constant 4 : index
+// CHECK: scf.for %[[K:.+]] = %[[C0]] to %[[C4]] step %[[C1]]
+// CHECK: scf.for %[[P:.+]] = %[[C0]] to %[[C4]] step %[[C1]]
+// CHECK: scf.for %[[R:.+]] = %[[C0]] to %[[C3]] step %[[C1]]
+// CHECK: scf.for %[[S:.+]] = %[[C0]] to %[[C3]] step %[[C1]]
+// CHECK: %[[H:.+]] = affine.apply #[[MAP]](%[[P]], %[[R]])
+// CHECK: %[[IMG:.+]] = tensor.extract_slice %[[ARG0]]
+// CHECK-SAME:  [0, 0, %[[H]], %[[S]], 0] [1, 2, 1, 4, 32] [1, 1, 1, 2, 1]
+// CHECK-SAME:  : tensor<1x2x9x9x32xf32> to tensor<2x4x32xf32>
+// CHECK: %[[FIL:.+]] = tensor.extract_slice %[[ARG1]]
+// CHECK-SAME:  [%[[K]], 0, %[[R]], %[[S]], 0, 0] [1, 2, 1, 1, 32, 32] [1, 1, 1, 1, 1, 1]
+// CHECK-SAME:  : tensor<4x2x3x3x32x32xf32> to tensor<2x32x32xf32>
+// CHECK: %[[OUT:.+]] = tensor.extract_slice
+// CHECK-SAME:  [0, %[[K]], %[[P]], 0, 0] [1, 1, 1, 4, 32] [1, 1, 1, 1, 1]
+// CHECK-SAME:  : tensor<1x4x4x4x32xf32> to tensor<4x32xf32>
+// CHECK: %[[BRGEMM:.+]] = linalg.batch_reduce_matmul
+// CHECK-SAME:  ins(%[[IMG]], %[[FIL]] : tensor<2x4x32xf32>, tensor<2x32x32xf32>)
+// CHECK-SAME:  outs(%[[OUT]] : tensor<4x32xf32>) -> tensor<4x32xf32>
+// CHECK: tensor.insert_slice %[[BRGEMM]]
+
+// -----
+
+#map = affine_map<(d0, d1, d2, d3, d4, d5, d6, d7, d8) -> (d0, d5, d2 + d6 * 2, d3 + d7 * 2, d8)>
+#map1 = affine_map<(d0, d1, d2, d3, d4, d5, d6, d7, d8) -> (d1, d5, d6, d7, d8, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4, d5, d6, d7, d8) -> (d0, d1, d2, d3, d4)>
+
+// The dilation only moves the offset of the image slice.
+func.func @conv_2d_blocked_dilated(%arg0: tensor<1x2x10x10x32xf32>, %arg1: tensor<4x2x3x3x32x32xf32>, %arg2: tensor<1x4x6x6x32xf32>) -> tensor<1x4x6x6x32xf32> {
+  %0 = linalg.generic {
+    indexing_maps = [#map, #map1, #map2],
+    iterator_types = ["parallel", "parallel", "parallel", "parallel", "parallel",
+                      "reduction", "reduction", "reduction", "reduction"]}
+    ins(%arg0, %arg1: tensor<1x2x10x10x32xf32>, tensor<4x2x3x3x32x32xf32>)
+    outs(%arg2: tensor<1x4x6x6x32xf32>) {
+  ^bb0(%in: f32, %in_1: f32, %out: f32):
+    %1 = arith.mulf %in, %in_1 : f32
+    %2 = arith.addf %out, %1 : f32
+    linalg.yield %2 : f32
+  } -> tensor<1x4x6x6x32xf32>
+  return %0 : tensor<1x4x6x6x32xf32>
+}
+
+// CHECK-DAG: #[[MAPH:.+]] = affine_map<(d0, d1) -> (d0 + d1 * 2)>
+// CHECK-DAG: #[[MAPW:.+]] = affine_map<(d0) -> (d0 * 2)>
+// CHECK: func.func @conv_2d_blocked_dilated(
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<1x2x10x10x32xf32>
+// CHECK: scf.for %[[K:.+]] =
+// CHECK: scf.for %[[P:.+]] =
+// CHECK: scf.for %[[R:.+]] =
+// CHECK: scf.for %[[S:.+]] =
+// CHECK-DAG: %[[H:.+]] = affine.apply #[[MAPH]](%[[P]], %[[R]])
+// CHECK-DAG: %[[W:.+]] = affine.apply #[[MAPW]](%[[S]])
+// CHECK: tensor.extract_slice %[[ARG0]]
+// CHECK-SAME:  [0, 0, %[[H]], %[[W]], 0] [1, 2, 1, 6, 32] [1, 1, 1, 1, 1]
+// CHECK-SAME:  : tensor<1x2x10x10x32xf32> to tensor<2x6x32xf32>
+// CHECK: linalg.batch_reduce_matmul
+// CHECK-SAME:  -> tensor<6x32xf32>
@@ -89,3 +89,86 @@ func.func @conv_2d_blocked(%arg0: tensor<1x2x113x113x32xf32>, %arg1: tensor<8x2x
 // CHECK: {{.+}} = tensor.insert_slice %[[MUL]]
 // CHECK-SAME:  into %{{.+}}[0, %[[ARG3]], %[[ARG5]], 0, 0] [1, 1, 1, 111, 32] [1, 1, 1, 1, 1]
 // CHECK-SAME:  : tensor<111x32xf32> into tensor<1x8x111x111x32xf32>
+
+// -----
+
+func.func @conv2d_nhwc_hwcf_dilated(%arg0: tensor<1x10x10x16xf32>, %arg1: tensor<3x3x16x32xf32>, %arg2: tensor<1x6x6x32xf32>) -> tensor<1x6x6x32xf32> {
+  %1 = linalg.conv_2d_nhwc_hwcf {dilations = dense<2> : tensor<2xi64>,
+                                 strides = dense<1> : tensor<2xi64>}
+    ins(%arg0, %arg1 : tensor<1x10x10x16xf32>, tensor<3x3x16x32xf32>)
+    outs(%arg2: tensor<1x6x6x32xf32>) -> tensor<1x6x6x32xf32>
+  return %1 : tensor<1x6x6x32xf32>
+}
+
+// CHECK-DAG: #[[MAPH:.+]] = affine_map<(d0, d1) -> (d0 + d1 * 2)>
+// CHECK-DAG: #[[MAPW:.+]] = affine_map<(d0) -> (d0 * 2)>
+// CHECK: func.func @conv2d_nhwc_hwcf_dilated
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<1x10x10x16xf32>,
+// CHECK-SAME:  %[[ARG1:.+]]: tensor<3x3x16x32xf32>,
+// CHECK-SAME:  %[[ARG2:.+]]: tensor<1x6x6x32xf32>) -> tensor<1x6x6x32xf32> {
+// CHECK: scf.for %[[P:.+]] = %{{.+}} to %{{.+}} step
+// CHECK: scf.for %[[R:.+]] = %{{.+}} to %{{.+}} step
+// CHECK: scf.for %[[S:.+]] = %{{.+}} to %{{.+}} step
+// CHECK-DAG: %[[H:.+]] = affine.apply #[[MAPH]](%[[P]], %[[R]])
+// CHECK-DAG: %[[W:.+]] = affine.apply #[[MAPW]](%[[S]])
+// CHECK: %[[SLICE:.+]] = tensor.extract_slice
+// CHECK-SAME:  %[[ARG0]][0, %[[H]], %[[W]], 0] [1, 1, 6, 16] [1, 1, 1, 1]
+// CHECK-SAME:   : tensor<1x10x10x16xf32> to tensor<6x16xf32>
+// CHECK: %[[SLICE0:.+]] = tensor.extract_slice
+// CHECK-SAME:  %[[ARG1]][%[[R]], %[[S]], 0, 0] [1, 1, 16, 32] [1, 1, 1, 1]
+// CHECK-SAME:  : tensor<3x3x16x32xf32> to tensor<16x32xf32>
+// CHECK: linalg.matmul ins(%[[SLICE]], %[[SLICE0]] : tensor<6x16xf32>, tensor<16x32xf32>)
+// CHECK-SAME:  -> tensor<6x32xf32>
+
+// -----
+
+#map = affine_map<(d0, d1, d2, d3, d4, d5, d6) -> (d0, d1, d2 * 2 + d5, d3 * 2 + d6, d4)>
+#map1 = affine_map<(d0, d1, d2, d3, d4, d5, d6) -> (d1, d5, d6, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4, d5, d6) -> (d0, d1, d2, d3, d4)>
+
+// A blocked depthwise convolution maps to a multiply and accumulate on rows
+// of channels, the filter is broadcasted along the rows.
+func.func @depthwise_conv_blocked(%arg0: tensor<1x2x9x9x16xf32>, %arg1: tensor<2x3x3x16xf32>, %arg2: tensor<1x2x4x4x16xf32>) -> tensor<1x2x4x4x16xf32> {
+  %0 = linalg.generic {
+    indexing_maps = [#map, #map1, #map2],
+    iterator_types = ["parallel", "parallel", "parallel", "parallel", "parallel",
+                      "reduction", "reduction"]}
+    ins(%arg0, %arg1: tensor<1x2x9x9x16xf32>, tensor<2x3x3x16xf32>)
+    outs(%arg2: tensor<1x2x4x4x16xf32>) {
+  ^bb0(%in: f32, %in_1: f32, %out: f32):
+    %1 = arith.mulf %in, %in_1 : f32
+    %2 = arith.addf %out, %1 : f32
+    linalg.yield %2 : f32
+  } -> tensor<1x2x4x4x16xf32>
+  return %0 : tensor<1x2x4x4x16xf32>
+}
+
+// CHECK-DAG: #[[MAPH:.+]] = affine_map<(d0, d1) -> (d0 * 2 + d1)>
+// CHECK-DAG: #[[ID:.+]] = affine_map<(d0, d1) -> (d0, d1)>
+// CHECK-DAG: #[[BCAST:.+]] = affine_map<(d0, d1) -> (d1)>
+// CHECK: func.func @depthwise_conv_blocked(
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<1x2x9x9x16xf32>,
+// CHECK-SAME:  %[[ARG1:.+]]: tensor<2x3x3x16xf32>,
+// CHECK-SAME:  %[[ARG2:.+]]: tensor<1x2x4x4x16xf32>)
+// CHECK: scf.for %[[C:.+]] =
+// CHECK: scf.for %[[P:.+]] =
+// CHECK: scf.for %[[R:.+]] =
+// CHECK: scf.for %[[S:.+]] =
+// CHECK: %[[H:.+]] = affine.apply #[[MAPH]](%[[P]], %[[R]])
+// CHECK: %[[IMG:.+]] = tensor.extract_slice %[[ARG0]]
+// CHECK-SAME:  [0, %[[C]], %[[H]], %[[S]], 0] [1, 1, 1, 4, 16] [1, 1, 1, 2, 1]
+// CHECK-SAME:  : tensor<1x2x9x9x16xf32> to tensor<4x16xf32>
+// CHECK: %[[FIL:.+]] = tensor.extract_slice %[[ARG1]]
+// CHECK-SAME:  [%[[C]], %[[R]], %[[S]], 0] [1, 1, 1, 16] [1, 1, 1, 1]
+// CHECK-SAME:  : tensor<2x3x3x16xf32> to tensor<16xf32>
+// CHECK: %[[OUT:.+]] = tensor.extract_slice
+// CHECK-SAME:  [0, %[[C]], %[[P]], 0, 0] [1, 1, 1, 4, 16] [1, 1, 1, 1, 1]
+// CHECK-SAME:  : tensor<1x2x4x4x16xf32> to tensor<4x16xf32>
+// CHECK: %[[FMA:.+]] = linalg.generic
+// CHECK-SAME:  indexing_maps = [#[[ID]], #[[BCAST]], #[[ID]]]
+// CHECK-SAME:  iterator_types = ["parallel", "parallel"]
+// CHECK-SAME:  ins(%[[IMG]], %[[FIL]] : tensor<4x16xf32>, tensor<16xf32>)
+// CHECK-SAME:  outs(%[[OUT]] : tensor<4x16xf32>)
+// CHECK: arith.mulf
+// CHECK: arith.addf
+// CHECK: tensor.insert_slice %[[FMA]]
@@ -0,0 +1,104 @@
+// RUN: tpp-opt %s --tensor-parallel-matmuls="num-ranks=2" --split-input-file | FileCheck %s --check-prefix=COLUMN
+// RUN: tpp-opt %s --tensor-parallel-matmuls="num-ranks=2 mode=row" --split-input-file | FileCheck %s --check-prefix=ROW
+// RUN: tpp-opt %s --tensor-parallel-matmuls --split-input-file | FileCheck %s --check-prefix=SINGLE
+
+func.func @layer(%arg0: tensor<8x16xf32>, %arg1: tensor<16x32xf32>) -> tensor<8x32xf32> {
+  %cst = arith.constant 0.000000e+00 : f32
+  %0 = tensor.empty() : tensor<8x32xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<8x32xf32>) -> tensor<8x32xf32>
+  %2 = linalg.matmul ins(%arg0, %arg1 : tensor<8x16xf32>, tensor<16x32xf32>) outs(%1 : tensor<8x32xf32>) -> tensor<8x32xf32>
+  return %2 : tensor<8x32xf32>
+}
+
+// COLUMN-DAG: func.func private @tpp_all_gather_f32(memref<*xf32>, memref<*xf32>, i64) attributes {llvm.emit_c_interface}
+// COLUMN-DAG: func.func private @tpp_collective_rank() -> i64
+// COLUMN-LABEL: func.func @layer(
+// COLUMN-SAME: %[[ARG0:.+]]: tensor<8x16xf32>, %[[ARG1:.+]]: tensor<16x16xf32>) -> tensor<8x32xf32>
+// COLUMN: %[[RANK64:.+]] = {{.*}}call @tpp_collective_rank() : () -> i64
+// COLUMN: %[[RANK:.+]] = arith.index_cast %[[RANK64]] : i64 to index
+// COLUMN: %[[FILL:.+]] = linalg.fill
+// COLUMN: %[[SIZE:.+]] = arith.constant 16 : index
+// COLUMN: %[[OFF:.+]] = arith.muli %[[RANK]], %[[SIZE]] : index
+// COLUMN: %[[INIT:.+]] = tensor.extract_slice %[[FILL]][0, %[[OFF]]] [8, 16] [1, 1] : tensor<8x32xf32> to tensor<8x16xf32>
+// COLUMN: %[[LOCAL:.+]] = linalg.matmul ins(%[[ARG0]], %[[ARG1]] : tensor<8x16xf32>, tensor<16x16xf32>) outs(%[[INIT]] : tensor<8x16xf32>) -> tensor<8x16xf32>
+// COLUMN: %[[DIM:.+]] = arith.constant 1 : i64
+// COLUMN: %[[LBUF:.+]] = bufferization.to_memref %[[LOCAL]] : {{.*}}memref<8x16xf32>
+// COLUMN: %[[FULL:.+]] = memref.alloc() {alignment = 64 : i64} : memref<8x32xf32>
+// COLUMN: %[[LCAST:.+]] = memref.cast %[[LBUF]] : memref<8x16xf32> to memref<*xf32>
+// COLUMN: %[[FCAST:.+]] = memref.cast %[[FULL]] : memref<8x32xf32> to memref<*xf32>
+// COLUMN: call @tpp_all_gather_f32(%[[LCAST]], %[[FCAST]], %[[DIM]])
+// COLUMN: %[[RES:.+]] = bufferization.to_tensor %[[FULL]] restrict writable
+// COLUMN: return %[[RES]] : tensor<8x32xf32>
+
+// ROW-DAG: func.func private @tpp_all_reduce_f32(memref<*xf32>, memref<*xf32>) attributes {llvm.emit_c_interface}
+// ROW-DAG: func.func private @tpp_collective_rank() -> i64
+// ROW-LABEL: func.func @layer(
+// ROW-SAME: %[[ARG0:.+]]: tensor<8x16xf32>, %[[ARG1:.+]]: tensor<8x32xf32>) -> tensor<8x32xf32>
+// ROW: %[[RANK64:.+]] = {{.*}}call @tpp_collective_rank() : () -> i64
+// ROW: %[[RANK:.+]] = arith.index_cast %[[RANK64]] : i64 to index
+// ROW: %[[SIZE:.+]] = arith.constant 8 : index
+// ROW: %[[OFF:.+]] = arith.muli %[[RANK]], %[[SIZE]] : index
+// ROW: %[[INPUT:.+]] = tensor.extract_slice %[[ARG0]][0, %[[OFF]]] [8, 8] [1, 1] : tensor<8x16xf32> to tensor<8x8xf32>
+// ROW: %[[ZERO:.+]] = arith.constant 0.000000e+00 : f32
+// ROW: %[[EMPTY:.+]] = tensor.empty() : tensor<8x32xf32>
+// ROW: %[[ZEROS:.+]] = linalg.fill ins(%[[ZERO]] : f32) outs(%[[EMPTY]] : tensor<8x32xf32>)
+// ROW: %[[PARTIAL:.+]] = linalg.matmul ins(%[[INPUT]], %[[ARG1]] : tensor<8x8xf32>, tensor<8x32xf32>) outs(%[[ZEROS]] : tensor<8x32xf32>)
+// ROW: %[[PBUF:.+]] = bufferization.to_memref %[[PARTIAL]]
+// ROW: %[[SUM:.+]] = memref.alloc() {alignment = 64 : i64} : memref<8x32xf32>
+// ROW: %[[PCAST:.+]] = memref.cast %[[PBUF]]
+// ROW: %[[SCAST:.+]] = memref.cast %[[SUM]]
+// ROW: call @tpp_all_reduce_f32(%[[PCAST]], %[[SCAST]])
+// ROW: %[[RES:.+]] = bufferization.to_tensor %[[SUM]] restrict writable
+// ROW-NOT: linalg.add
+// ROW: return %[[RES]] : tensor<8x32xf32>
+
+// SINGLE-LABEL: func.func @layer(
+// SINGLE-SAME: tensor<16x32xf32>
+// SINGLE-NOT: tpp_collective_rank
+// SINGLE: linalg.matmul ins(%{{.+}}, %{{.+}} : tensor<8x16xf32>, tensor<16x32xf32>)
+
+// -----
+
+// The weight is a constant and the init holds the bias.
+func.func @bias(%arg0: tensor<8x16xf32>, %arg1: tensor<8x32xf32>) -> tensor<8x32xf32> {
+  %cst = arith.constant dense<1.000000e+00> : tensor<16x32xf32>
+  %0 = linalg.matmul ins(%arg0, %cst : tensor<8x16xf32>, tensor<16x32xf32>) outs(%arg1 : tensor<8x32xf32>) -> tensor<8x32xf32>
+  return %0 : tensor<8x32xf32>
+}
+
+// COLUMN-LABEL: func.func @bias(
+// COLUMN-SAME: %[[ARG0:.+]]: tensor<8x16xf32>, %[[ARG1:.+]]: tensor<8x32xf32>) -> tensor<8x32xf32>
+// COLUMN: %[[CST:.+]] = arith.constant dense<1.000000e+00> : tensor<16x32xf32>
+// COLUMN: %[[WEIGHT:.+]] = tensor.extract_slice %[[CST]][0, %{{.+}}] [16, 16] [1, 1] : tensor<16x32xf32> to tensor<16x16xf32>
+// COLUMN: %[[INIT:.+]] = tensor.extract_slice %[[ARG1]][0, %{{.+}}] [8, 16] [1, 1] : tensor<8x32xf32> to tensor<8x16xf32>
+// COLUMN: linalg.matmul ins(%[[ARG0]], %[[WEIGHT]] : tensor<8x16xf32>, tensor<16x16xf32>) outs(%[[INIT]] : tensor<8x16xf32>)
+// COLUMN: call @tpp_all_gather_f32(
+
+// ROW-LABEL: func.func @bias(
+// ROW-SAME: %[[ARG0:.+]]: tensor<8x16xf32>, %[[ARG1:.+]]: tensor<8x32xf32>) -> tensor<8x32xf32>
+// ROW: %[[CST:.+]] = arith.constant dense<1.000000e+00> : tensor<16x32xf32>
+// ROW: %[[INPUT:.+]] = tensor.extract_slice %[[ARG0]][0, %{{.+}}] [8, 8] [1, 1] : tensor<8x16xf32> to tensor<8x8xf32>
+// ROW: %[[WEIGHT:.+]] = tensor.extract_slice %[[CST]][%{{.+}}, 0] [8, 32] [1, 1] : tensor<16x32xf32> to tensor<8x32xf32>
+// ROW: linalg.matmul ins(%[[INPUT]], %[[WEIGHT]] : tensor<8x8xf32>, tensor<8x32xf32>)
+// ROW: call @tpp_all_reduce_f32(
+// ROW: %[[SUM:.+]] = bufferization.to_tensor
+// ROW: %[[RES:.+]] = linalg.add ins(%[[SUM]], %[[ARG1]] : tensor<8x32xf32>, tensor<8x32xf32>) outs(%[[ARG1]] : tensor<8x32xf32>)
+// ROW: return %[[RES]] : tensor<8x32xf32>
+
+// -----
+
+// The sharded dimensions do not split evenly over the ranks.
+func.func @uneven(%arg0: tensor<8x15xf32>, %arg1: tensor<15x31xf32>, %arg2: tensor<8x31xf32>) -> tensor<8x31xf32> {
+  %0 = linalg.matmul ins(%arg0, %arg1 : tensor<8x15xf32>, tensor<15x31xf32>) outs(%arg2 : tensor<8x31xf32>) -> tensor<8x31xf32>
+  return %0 : tensor<8x31xf32>
+}
+
+// COLUMN-LABEL: func.func @uneven(
+// COLUMN-NOT: tensor.extract_slice
+// COLUMN: linalg.matmul ins(%{{.+}}, %{{.+}} : tensor<8x15xf32>, tensor<15x31xf32>) outs(%{{.+}} : tensor<8x31xf32>)
+// COLUMN-NOT: call
+
+// ROW-LABEL: func.func @uneven(
+// ROW-NOT: tensor.extract_slice
+// ROW: linalg.matmul ins(%{{.+}}, %{{.+}} : tensor<8x15xf32>, tensor<15x31xf32>) outs(%{{.+}} : tensor<8x31xf32>)
+// ROW-NOT: call
@@ -0,0 +1,68 @@
+// RUN: tpp-opt %s --tile-brgemm-linalg="peel-remainders report-register-block" --split-input-file --verify-diagnostics | FileCheck %s
+
+module attributes {
+  dlti.target_system_spec = #dlti.target_system_spec<
+    "CPU" = #dlti.target_device_spec<
+      #dlti.dl_entry<"max_vector_op_width", 512 : i32>,
+      #dlti.dl_entry<"num_vector_registers", 32 : i32>>>
+} {
+  func.func @peel_n(%arg0: memref<4x30x32xf32>, %arg1: memref<4x32x100xf32>, %arg2: memref<30x100xf32>) {
+    // expected-remark @+2 {{register block 3x96 uses 27 of 32 vector registers}}
+    // expected-remark @below {{register block 15x4 uses 31 of 32 vector registers}}
+    linalg.batch_reduce_matmul ins(%arg0, %arg1 : memref<4x30x32xf32>, memref<4x32x100xf32>) outs(%arg2 : memref<30x100xf32>)
+    return
+  }
+}
+
+// The columns past the last full vector are a brgemm of their own.
+// CHECK-LABEL: func.func @peel_n(
+// CHECK-SAME:  %[[ARG0:.+]]: memref<4x30x32xf32>, %[[ARG1:.+]]: memref<4x32x100xf32>, %[[ARG2:.+]]: memref<30x100xf32>
+// CHECK: %[[RHS0:.+]] = memref.subview %[[ARG1]][0, 0, 0] [4, 32, 96] [1, 1, 1]
+// CHECK: %[[ACC0:.+]] = memref.subview %[[ARG2]][0, 0] [30, 96] [1, 1]
+// CHECK: scf.for
+// CHECK: memref.subview %[[ARG0]]{{.+}} [1, 3, 1] [1, 1, 1]
+// CHECK: memref.subview %[[RHS0]]{{.+}} [1, 1, 96] [1, 1, 1]
+// CHECK: memref.subview %[[ACC0]]{{.+}} [3, 96] [1, 1]
+// CHECK: linalg.batch_reduce_matmul
+// CHECK: %[[RHS1:.+]] = memref.subview %[[ARG1]][0, 0, 96] [4, 32, 4] [1, 1, 1]
+// CHECK: %[[ACC1:.+]] = memref.subview %[[ARG2]][0, 96] [30, 4] [1, 1]
+// CHECK: scf.for
+// CHECK: memref.subview %[[ARG0]]{{.+}} [1, 15, 1] [1, 1, 1]
+// CHECK: memref.subview %[[RHS1]]{{.+}} [1, 1, 4] [1, 1, 1]
+// CHECK: memref.subview %[[ACC1]]{{.+}} [15, 4] [1, 1]
+// CHECK: linalg.batch_reduce_matmul
+
+// -----
+
+module attributes {
+  dlti.target_system_spec = #dlti.target_system_spec<
+    "CPU" = #dlti.target_device_spec<
+      #dlti.dl_entry<"max_vector_op_width", 512 : i32>,
+      #dlti.dl_entry<"num_vector_registers", 32 : i32>>>
+} {
+  func.func @peel_m(%arg0: memref<4x29x32xf32>, %arg1: memref<4x32x96xf32>, %arg2: memref<29x96xf32>) {
+    // expected-remark @+2 {{register block 7x48 uses 31 of 32 vector registers}}
+    // expected-remark @below {{register block 1x96 uses 13 of 32 vector registers}}
+    linalg.batch_reduce_matmul ins(%arg0, %arg1 : memref<4x29x32xf32>, memref<4x32x96xf32>) outs(%arg2 : memref<29x96xf32>)
+    return
+  }
+}
+
+// A prime M keeps the 7x48 tile on the first 28 rows rather than falling
+// back on a single row tile.
+// CHECK-LABEL: func.func @peel_m(
+// CHECK-SAME:  %[[ARG0:.+]]: memref<4x29x32xf32>, %[[ARG1:.+]]: memref<4x32x96xf32>, %[[ARG2:.+]]: memref<29x96xf32>
+// CHECK: %[[LHS0:.+]] = memref.subview %[[ARG0]][0, 0, 0] [4, 28, 32] [1, 1, 1]
+// CHECK: %[[ACC0:.+]] = memref.subview %[[ARG2]][0, 0] [28, 96] [1, 1]
+// CHECK: scf.for
+// CHECK: memref.subview %[[LHS0]]{{.+}} [1, 7, 1] [1, 1, 1]
+// CHECK: memref.subview %[[ARG1]]{{.+}} [1, 1, 48] [1, 1, 1]
+// CHECK: memref.subview %[[ACC0]]{{.+}} [7, 48] [1, 1]
+// CHECK: linalg.batch_reduce_matmul
+// CHECK: %[[LHS1:.+]] = memref.subview %[[ARG0]][0, 28, 0] [4, 1, 32] [1, 1, 1]
+// CHECK: %[[ACC1:.+]] = memref.subview %[[ARG2]][28, 0] [1, 96] [1, 1]
+// CHECK: scf.for
+// CHECK: memref.subview %[[LHS1]]{{.+}} [1, 1, 1] [1, 1, 1]
+// CHECK: memref.subview %[[ARG1]]{{.+}} [1, 1, 96] [1, 1, 1]
+// CHECK: memref.subview %[[ACC1]]{{.+}} [1, 96] [1, 1]
+// CHECK: linalg.batch_reduce_matmul
@@ -0,0 +1,104 @@
+// RUN: tpp-opt %s --tile-brgemm-linalg="report-register-block" --split-input-file --verify-diagnostics | FileCheck %s
+// RUN: tpp-opt %s --tile-brgemm-linalg="lhsTile=1,32 rhsTile=32,1" --split-input-file 2>&1 | FileCheck %s --check-prefix=SPILL
+
+module attributes {
+  dlti.target_system_spec = #dlti.target_system_spec<
+    "CPU" = #dlti.target_device_spec<
+      #dlti.dl_entry<"max_vector_op_width", 512 : i32>,
+      #dlti.dl_entry<"num_vector_registers", 32 : i32>>>
+} {
+  func.func @avx512(%arg0: memref<48x32x32xf32>, %arg1: memref<48x32x32xf32>, %arg2: memref<32x32xf32>) {
+    // expected-remark @below {{register block 8x32 uses 26 of 32 vector registers}}
+    linalg.batch_reduce_matmul ins(%arg0, %arg1 : memref<48x32x32xf32>, memref<48x32x32xf32>) outs(%arg2 : memref<32x32xf32>)
+    return
+  }
+}
+
+// CHECK-LABEL: func.func @avx512(
+// CHECK-SAME:  %[[ARG0:.+]]: memref<48x32x32xf32>, %[[ARG1:.+]]: memref<48x32x32xf32>, %[[ARG2:.+]]: memref<32x32xf32>
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : index
+// CHECK-DAG: %[[C1:.+]] = arith.constant 1 : index
+// CHECK-DAG: %[[C8:.+]] = arith.constant 8 : index
+// CHECK-DAG: %[[C32:.+]] = arith.constant 32 : index
+// CHECK-DAG: %[[C48:.+]] = arith.constant 48 : index
+// CHECK: scf.for %[[M:.+]] = %[[C0]] to %[[C32]] step %[[C8]]
+// CHECK:   scf.for %[[N:.+]] = %[[C0]] to %[[C32]] step %[[C32]]
+// CHECK:     scf.for %[[B:.+]] = %[[C0]] to %[[C48]] step %[[C1]]
+// CHECK:       scf.for %[[K:.+]] = %[[C0]] to %[[C32]] step %[[C1]]
+// CHECK:         %[[LHS:.+]] = memref.subview %[[ARG0]][%[[B]], %[[M]], %[[K]]] [1, 8, 1] [1, 1, 1]
+// CHECK:         %[[RHS:.+]] = memref.subview %[[ARG1]][%[[B]], %[[K]], %[[N]]] [1, 1, 32] [1, 1, 1]
+// CHECK:         %[[ACC:.+]] = memref.subview %[[ARG2]][%[[M]], %[[N]]] [8, 32] [1, 1]
+// CHECK:         linalg.batch_reduce_matmul ins(%[[LHS]], %[[RHS]] : {{.+}}) outs(%[[ACC]] : {{.+}})
+
+// SPILL: warning: register block 32x32 needs 98 vector registers, the target has 32
+
+// -----
+
+module attributes {
+  dlti.target_system_spec = #dlti.target_system_spec<
+    "CPU" = #dlti.target_device_spec<
+      #dlti.dl_entry<"max_vector_op_width", 256 : i32>,
+      #dlti.dl_entry<"num_vector_registers", 16 : i32>>>
+} {
+  func.func @avx2(%arg0: memref<48x32x32xf32>, %arg1: memref<48x32x32xf32>, %arg2: memref<32x32xf32>) {
+    // expected-remark @below {{register block 2x32 uses 14 of 16 vector registers}}
+    linalg.batch_reduce_matmul ins(%arg0, %arg1 : memref<48x32x32xf32>, memref<48x32x32xf32>) outs(%arg2 : memref<32x32xf32>)
+    return
+  }
+}
+
+// CHECK-LABEL: func.func @avx2(
+// CHECK: memref.subview %{{.+}} [1, 2, 1] [1, 1, 1]
+// CHECK: memref.subview %{{.+}} [1, 1, 32] [1, 1, 1]
+// CHECK: memref.subview %{{.+}} [2, 32] [1, 1]
+// CHECK: linalg.batch_reduce_matmul
+
+// SPILL: warning: register block 32x32 needs 164 vector registers, the target has 16
+
+// -----
+
+module attributes {
+  dlti.target_system_spec = #dlti.target_system_spec<
+    "CPU" = #dlti.target_device_spec<
+      #dlti.dl_entry<"max_vector_op_width", 512 : i32>,
+      #dlti.dl_entry<"num_vector_registers", 32 : i32>,
+      #dlti.dl_entry<"has_sve", 1 : i32>>>
+} {
+  func.func @sve(%arg0: memref<48x32x32xf32>, %arg1: memref<48x32x32xf32>, %arg2: memref<32x32xf32>) {
+    // expected-remark @below {{register block 8x32 uses 17 of 32 vector registers}}
+    linalg.batch_reduce_matmul ins(%arg0, %arg1 : memref<48x32x32xf32>, memref<48x32x32xf32>) outs(%arg2 : memref<32x32xf32>)
+    return
+  }
+}
+
+// The scalable kernel keeps one accumulator and one broadcast per row.
+// CHECK-LABEL: func.func @sve(
+// CHECK: memref.subview %{{.+}} [1, 8, 1] [1, 1, 1]
+// CHECK: memref.subview %{{.+}} [1, 1, 32] [1, 1, 1]
+// CHECK: memref.subview %{{.+}} [8, 32] [1, 1]
+// CHECK: linalg.batch_reduce_matmul
+
+// SPILL: warning: register block 32x32 needs 65 vector registers, the target has 32
+
+// -----
+
+module attributes {
+  dlti.target_system_spec = #dlti.target_system_spec<
+    "CPU" = #dlti.target_device_spec<
+      #dlti.dl_entry<"max_vector_op_width", 512 : i32>,
+      #dlti.dl_entry<"has_sve", 1 : i32>,
+      #dlti.dl_entry<"has_sme", 1 : i32>>>
+} {
+  func.func @sme(%arg0: memref<48x32x32xf32>, %arg1: memref<48x32x32xf32>, %arg2: memref<32x32xf32>) {
+    // expected-remark @below {{register block 32x32 accumulates in the ZA array}}
+    linalg.batch_reduce_matmul ins(%arg0, %arg1 : memref<48x32x32xf32>, memref<48x32x32xf32>) outs(%arg2 : memref<32x32xf32>)
+    return
+  }
+}
+
+// With SME the block spans 2x2 ZA tiles and K is not tiled.
+// CHECK-LABEL: func.func @sme(
+// CHECK: memref.subview %{{.+}} [1, 32, 32] [1, 1, 1]
+// CHECK: memref.subview %{{.+}} [1, 32, 32] [1, 1, 1]
+// CHECK: memref.subview %{{.+}} [32, 32] [1, 1]
+// CHECK: linalg.batch_reduce_matmul
@@ -0,0 +1,93 @@
+// RUN: tpp-opt %s --intel-amx-tile-config-hoisting-pass --split-input-file | FileCheck %s
+
+func.func @coalesce(%arg0: memref<8x32x32x32xbf16>, %arg1: memref<32x16x32x2xbf16>, %arg2: memref<8x32x32x32xbf16>) {
+  %c1 = arith.constant 1 : index
+  %c8 = arith.constant 8 : index
+  %c0 = arith.constant 0 : index
+  %c32_i64 = arith.constant 32 : i64
+  %0 = xsmm.IntelAMXtileConfig.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024] flags = (no_reset_tileconfig, vnni_b, beta_0) data_type = bf16
+  %1 = xsmm.IntelAMXtileConfig.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024] flags = (no_setup_tileconfig, vnni_b, beta_0) data_type = bf16
+  %2 = xsmm.brgemm.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024] flags = (no_reset_tileconfig, no_setup_tileconfig, vnni_b, beta_0) data_type = bf16
+  %3 = xsmm.unary.dispatch relu [32, 32, 32, 32] flags = (none) data_type = bf16
+  scf.parallel (%arg3) = (%c0) to (%c8) step (%c1) {
+    scf.for %arg4 = %c0 to %c8 step %c1 {
+      %subview = memref.subview %arg0[%arg3, 0, 0, 0] [1, 32, 32, 32] [1, 1, 1, 1] : memref<8x32x32x32xbf16> to memref<32x32x32xbf16, strided<[1024, 32, 1], offset: ?>>
+      %subview_0 = memref.subview %arg2[%arg3, %arg4, 0, 0] [1, 1, 32, 32] [1, 1, 1, 1] : memref<8x32x32x32xbf16> to memref<32x32xbf16, strided<[32, 1], offset: ?>>
+      %alloca = memref.alloca() : memref<64xi8>
+      "xsmm.IntelAMXtileConfig"(%0, %alloca) : (i64, memref<64xi8>) -> ()
+      xsmm.brgemm(data_type = bf16, %2, %subview, %arg1, %subview_0, %c32_i64) : (i64, memref<32x32x32xbf16, strided<[1024, 32, 1], offset: ?>>, memref<32x16x32x2xbf16>, memref<32x32xbf16, strided<[32, 1], offset: ?>>, i64) -> ()
+      "xsmm.IntelAMXtileConfig"(%1, %alloca) : (i64, memref<64xi8>) -> ()
+      xsmm.unary relu(data_type = bf16, %3, %subview_0, %subview_0) : (i64, memref<32x32xbf16, strided<[32, 1], offset: ?>>, memref<32x32xbf16, strided<[32, 1], offset: ?>>) -> ()
+      %alloca_1 = memref.alloca() : memref<64xi8>
+      "xsmm.IntelAMXtileConfig"(%0, %alloca_1) : (i64, memref<64xi8>) -> ()
+      xsmm.brgemm(data_type = bf16, %2, %subview, %arg1, %subview_0, %c32_i64) : (i64, memref<32x32x32xbf16, strided<[1024, 32, 1], offset: ?>>, memref<32x16x32x2xbf16>, memref<32x32xbf16, strided<[32, 1], offset: ?>>, i64) -> ()
+      "xsmm.IntelAMXtileConfig"(%1, %alloca_1) : (i64, memref<64xi8>) -> ()
+    }
+    scf.reduce
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @coalesce(
+// CHECK: %[[SETUP:.+]] = xsmm.IntelAMXtileConfig.dispatch {{.+}} flags = (no_reset_tileconfig, vnni_b, beta_0)
+// CHECK: %[[RESET:.+]] = xsmm.IntelAMXtileConfig.dispatch {{.+}} flags = (no_setup_tileconfig, vnni_b, beta_0)
+// CHECK: scf.parallel
+// CHECK-NEXT: %[[ALLOCA:.+]] = memref.alloca() : memref<64xi8>
+// CHECK-NEXT: "xsmm.IntelAMXtileConfig"(%[[SETUP]], %[[ALLOCA]])
+// CHECK-NEXT: scf.for
+// CHECK-NOT: xsmm.IntelAMXtileConfig"
+// CHECK: xsmm.brgemm
+// CHECK-NOT: xsmm.IntelAMXtileConfig"
+// CHECK: xsmm.unary relu
+// CHECK-NOT: xsmm.IntelAMXtileConfig"
+// CHECK: xsmm.brgemm
+// CHECK-NOT: xsmm.IntelAMXtileConfig"
+// CHECK: }
+// CHECK-NEXT: "xsmm.IntelAMXtileConfig"(%[[RESET]], %[[ALLOCA]])
+// CHECK-NEXT: scf.reduce
+
+// -----
+
+// Different configurations are neither coalesced nor hoisted.
+func.func @different_configs(%arg0: memref<8x32x32x32xbf16>, %arg1: memref<32x16x32x2xbf16>, %arg2: memref<8x32x32x32xbf16>, %arg3: memref<8x32x32x32xbf16>, %arg4: memref<64x32x32xbf16>) {
+  %c1 = arith.constant 1 : index
+  %c8 = arith.constant 8 : index
+  %c0 = arith.constant 0 : index
+  %c32_i64 = arith.constant 32 : i64
+  %c64_i64 = arith.constant 64 : i64
+  %0 = xsmm.IntelAMXtileConfig.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024] flags = (no_reset_tileconfig, vnni_b, beta_0) data_type = bf16
+  %1 = xsmm.IntelAMXtileConfig.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024] flags = (no_setup_tileconfig, vnni_b, beta_0) data_type = bf16
+  %2 = xsmm.brgemm.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024] flags = (no_reset_tileconfig, no_setup_tileconfig, vnni_b, beta_0) data_type = bf16
+  %3 = xsmm.IntelAMXtileConfig.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024] flags = (no_reset_tileconfig, beta_0) data_type = bf16
+  %4 = xsmm.IntelAMXtileConfig.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024] flags = (no_setup_tileconfig, beta_0) data_type = bf16
+  %5 = xsmm.brgemm.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024] flags = (no_reset_tileconfig, no_setup_tileconfig, beta_0) data_type = bf16
+  scf.parallel (%arg5) = (%c0) to (%c8) step (%c1) {
+    scf.for %arg6 = %c0 to %c8 step %c1 {
+      %subview = memref.subview %arg0[%arg5, 0, 0, 0] [1, 32, 32, 32] [1, 1, 1, 1] : memref<8x32x32x32xbf16> to memref<32x32x32xbf16, strided<[1024, 32, 1], offset: ?>>
+      %subview_0 = memref.subview %arg2[%arg5, %arg6, 0, 0] [1, 1, 32, 32] [1, 1, 1, 1] : memref<8x32x32x32xbf16> to memref<32x32xbf16, strided<[32, 1], offset: ?>>
+      %subview_1 = memref.subview %arg3[%arg5, %arg6, 0, 0] [1, 1, 32, 32] [1, 1, 1, 1] : memref<8x32x32x32xbf16> to memref<32x32xbf16, strided<[32, 1], offset: ?>>
+      %alloca = memref.alloca() : memref<64xi8>
+      "xsmm.IntelAMXtileConfig"(%0, %alloca) : (i64, memref<64xi8>) -> ()
+      xsmm.brgemm(data_type = bf16, %2, %subview, %arg1, %subview_0, %c32_i64) : (i64, memref<32x32x32xbf16, strided<[1024, 32, 1], offset: ?>>, memref<32x16x32x2xbf16>, memref<32x32xbf16, strided<[32, 1], offset: ?>>, i64) -> ()
+      "xsmm.IntelAMXtileConfig"(%1, %alloca) : (i64, memref<64xi8>) -> ()
+      %alloca_2 = memref.alloca() : memref<64xi8>
+      "xsmm.IntelAMXtileConfig"(%3, %alloca_2) : (i64, memref<64xi8>) -> ()
+      xsmm.brgemm(data_type = bf16, %5, %subview, %arg4, %subview_1, %c32_i64) : (i64, memref<32x32x32xbf16, strided<[1024, 32, 1], offset: ?>>, memref<64x32x32xbf16>, memref<32x32xbf16, strided<[32, 1], offset: ?>>, i64) -> ()
+      "xsmm.IntelAMXtileConfig"(%4, %alloca_2) : (i64, memref<64xi8>) -> ()
+    }
+    scf.reduce
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @different_configs(
+// CHECK: scf.parallel
+// CHECK-NEXT: scf.for
+// CHECK: memref.alloca
+// CHECK-NEXT: "xsmm.IntelAMXtileConfig"
+// CHECK-NEXT: xsmm.brgemm
+// CHECK-NEXT: "xsmm.IntelAMXtileConfig"
+// CHECK-NEXT: memref.alloca
+// CHECK-NEXT: "xsmm.IntelAMXtileConfig"
+// CHECK-NEXT: xsmm.brgemm
+// CHECK-NEXT: "xsmm.IntelAMXtileConfig"
@@ -0,0 +1,86 @@
+// RUN: tpp-opt %s --intel-amx-tile-config-thread-hoisting-pass --split-input-file | FileCheck %s
+
+func.func @thread_config(%arg0: i64, %arg1: i64, %arg2: i64) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c2 = arith.constant 2 : index
+  %c8 = arith.constant 8 : index
+  %c32 = arith.constant 32 : index
+  omp.parallel {
+    omp.wsloop {
+      omp.loop_nest (%arg3, %arg4) : index = (%c0, %c0) to (%c8, %c32) step (%c2, %c8) {
+        memref.alloca_scope  {
+          %c1_i64 = arith.constant 1 : i64
+          %alloca = memref.alloca() : memref<64xi8>
+          %intptr = memref.extract_aligned_pointer_as_index %alloca : memref<64xi8> -> index
+          %0 = arith.index_cast %intptr : index to i64
+          %1 = llvm.inttoptr %0 : i64 to !llvm.ptr
+          func.call @xsmm_intel_amx_tile_config_invoke(%c1_i64, %arg0, %1, %c0) : (i64, i64, !llvm.ptr, index) -> ()
+          scf.for %arg5 = %c0 to %c2 step %c1 {
+            func.call @kernel(%arg2, %arg3, %arg4, %arg5) : (i64, index, index, index) -> ()
+          }
+          %intptr_0 = memref.extract_aligned_pointer_as_index %alloca : memref<64xi8> -> index
+          %2 = arith.index_cast %intptr_0 : index to i64
+          %3 = llvm.inttoptr %2 : i64 to !llvm.ptr
+          func.call @xsmm_intel_amx_tile_config_invoke(%c1_i64, %arg1, %3, %c0) : (i64, i64, !llvm.ptr, index) -> ()
+        }
+        omp.yield
+      }
+    }
+    omp.terminator
+  }
+  return
+}
+func.func private @xsmm_intel_amx_tile_config_invoke(i64, i64, !llvm.ptr, index)
+func.func private @kernel(i64, index, index, index)
+
+// CHECK-LABEL: func.func @thread_config(
+// CHECK-SAME:  %[[SETUP:.+]]: i64, %[[RESET:.+]]: i64, %{{.+}}: i64
+// CHECK: omp.parallel {
+// CHECK:   %[[ALLOCA:.+]] = memref.alloca() : memref<64xi8>
+// CHECK:   %[[PTR:.+]] = memref.extract_aligned_pointer_as_index %[[ALLOCA]]
+// CHECK:   call @xsmm_intel_amx_tile_config_invoke(%{{.+}}, %[[SETUP]], %{{.+}}, %{{.+}})
+// CHECK-NEXT: omp.wsloop {
+// CHECK:     omp.loop_nest
+// CHECK-NEXT:  memref.alloca_scope
+// CHECK-NEXT:    scf.for
+// CHECK-NEXT:      call @kernel
+// CHECK-NOT:   call @xsmm_intel_amx_tile_config_invoke
+// CHECK:     omp.yield
+// CHECK:   }
+// CHECK-NEXT: call @xsmm_intel_amx_tile_config_invoke(%{{.+}}, %[[RESET]], %{{.+}}, %{{.+}})
+// CHECK-NEXT: omp.terminator
+
+// -----
+
+// The configuration depends on the iteration and stays in the loop.
+func.func @variant_config(%arg0: memref<8x64xi8>, %arg1: i64, %arg2: i64) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c8 = arith.constant 8 : index
+  %c1_i64 = arith.constant 1 : i64
+  omp.parallel {
+    omp.wsloop {
+      omp.loop_nest (%arg3) : index = (%c0) to (%c8) step (%c1) {
+        %subview = memref.subview %arg0[%arg3, 0] [1, 64] [1, 1] : memref<8x64xi8> to memref<64xi8, strided<[1], offset: ?>>
+        %intptr = memref.extract_aligned_pointer_as_index %subview : memref<64xi8, strided<[1], offset: ?>> -> index
+        %0 = arith.index_cast %intptr : index to i64
+        %1 = llvm.inttoptr %0 : i64 to !llvm.ptr
+        func.call @xsmm_intel_amx_tile_config_invoke(%c1_i64, %arg1, %1, %arg3) : (i64, i64, !llvm.ptr, index) -> ()
+        func.call @xsmm_intel_amx_tile_config_invoke(%c1_i64, %arg2, %1, %arg3) : (i64, i64, !llvm.ptr, index) -> ()
+        omp.yield
+      }
+    }
+    omp.terminator
+  }
+  return
+}
+func.func private @xsmm_intel_amx_tile_config_invoke(i64, i64, !llvm.ptr, index)
+
+// CHECK-LABEL: func.func @variant_config(
+// CHECK: omp.parallel {
+// CHECK-NEXT: omp.wsloop {
+// CHECK-NEXT:   omp.loop_nest
+// CHECK:          call @xsmm_intel_amx_tile_config_invoke
+// CHECK-NEXT:     call @xsmm_intel_amx_tile_config_invoke
+// CHECK-NEXT:     omp.yield
@@ -0,0 +1,41 @@
+// RUN: tpp-opt %s -lower-packs-unpacks="nontemporal-stores" -split-input-file | FileCheck %s
+// RUN: tpp-opt %s -lower-packs-unpacks -split-input-file | FileCheck %s --check-prefix=NOHINT
+
+module attributes {
+  dlti.target_system_spec = #dlti.target_system_spec<
+    "CPU" = #dlti.target_device_spec<
+      #dlti.dl_entry<"L3_cache_size_in_bytes", 1024 : i32>>>
+} {
+  func.func @streaming_unpack(%arg0: tensor<16x16x32x32xbf16>, %arg1: tensor<512x512xbf16>) -> tensor<512x512xbf16> {
+    %unpack = tensor.unpack %arg0 inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %arg1 : tensor<16x16x32x32xbf16> -> tensor<512x512xbf16>
+    return %unpack : tensor<512x512xbf16>
+  }
+}
+
+// CHECK-LABEL: streaming_unpack
+// CHECK-SAME: %[[ARG0:.+]]: tensor<16x16x32x32xbf16>, %[[ARG1:.+]]: tensor<512x512xbf16>
+// CHECK: scf.forall (%[[I:.+]], %[[J:.+]]) = (0, 0) to (512, 512) step (32, 32) shared_outs(%[[OUT:.+]] = %[[ARG1]])
+// CHECK: %[[TILE:.+]] = tensor.extract_slice %[[ARG0]]
+// CHECK: %[[DEST:.+]] = tensor.extract_slice %[[OUT]][%[[I]], %[[J]]] [32, 32] [1, 1]
+// CHECK: %[[COPY:.+]] = linalg.copy {tpp.nontemporal} ins(%[[TILE]] : tensor<32x32xbf16>) outs(%[[DEST]] : tensor<32x32xbf16>)
+// CHECK: scf.forall.in_parallel
+// CHECK: tensor.parallel_insert_slice %[[COPY]] into %[[OUT]][%[[I]], %[[J]]] [32, 32] [1, 1]
+
+// NOHINT-LABEL: streaming_unpack
+// NOHINT-NOT: tpp.nontemporal
+// NOHINT-NOT: linalg.copy
+
+// -----
+
+// The output fits in the last level cache.
+func.func @cached_unpack(%arg0: tensor<16x16x32x32xbf16>, %arg1: tensor<512x512xbf16>) -> tensor<512x512xbf16> {
+  %unpack = tensor.unpack %arg0 inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %arg1 : tensor<16x16x32x32xbf16> -> tensor<512x512xbf16>
+  return %unpack : tensor<512x512xbf16>
+}
+
+// CHECK-LABEL: cached_unpack
+// CHECK-NOT: tpp.nontemporal
+// CHECK: tensor.parallel_insert_slice
+
+// NOHINT-LABEL: cached_unpack
+// NOHINT-NOT: tpp.nontemporal
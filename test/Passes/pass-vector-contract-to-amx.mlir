@@ -0,0 +1,95 @@
+// RUN: env LIBXSMM_TARGET=spr tpp-opt %s --vector-contract-to-amx --split-input-file | FileCheck %s
+// RUN: env LIBXSMM_TARGET=clx tpp-opt %s --vector-contract-to-amx --split-input-file | FileCheck %s --check-prefix=NOAMX
+
+#map = affine_map<(d0, d1, d2, d3, d4) -> (d0, d1, d3, d4)>
+#map1 = affine_map<(d0, d1, d2, d3, d4) -> (d0, d3, d2, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4) -> (d1, d2)>
+func.func @brgemm_bf16(%arg0: memref<4x16x32x2xbf16>, %arg1: memref<4x32x16x2xbf16>, %arg2: memref<16x16xf32>) {
+  %cst = arith.constant 0.000000e+00 : bf16
+  %cst_0 = arith.constant 0.000000e+00 : f32
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c4 = arith.constant 4 : index
+  %c16 = arith.constant 16 : index
+  %c32 = arith.constant 32 : index
+  %0 = vector.transfer_read %arg2[%c0, %c0], %cst_0 {in_bounds = [true, true]} : memref<16x16xf32>, vector<16x16xf32>
+  %1 = scf.for %arg3 = %c0 to %c4 step %c1 iter_args(%arg4 = %0) -> (vector<16x16xf32>) {
+    %2 = scf.for %arg5 = %c0 to %c32 step %c16 iter_args(%arg6 = %arg4) -> (vector<16x16xf32>) {
+      %subview = memref.subview %arg0[%arg3, 0, %arg5, 0] [1, 16, 16, 2] [1, 1, 1, 1] : memref<4x16x32x2xbf16> to memref<1x16x16x2xbf16, strided<[1024, 64, 2, 1], offset: ?>>
+      %subview_1 = memref.subview %arg1[%arg3, %arg5, 0, 0] [1, 16, 16, 2] [1, 1, 1, 1] : memref<4x32x16x2xbf16> to memref<1x16x16x2xbf16, strided<[1024, 32, 2, 1], offset: ?>>
+      %3 = vector.transfer_read %subview[%c0, %c0, %c0, %c0], %cst {in_bounds = [true, true, true, true]} : memref<1x16x16x2xbf16, strided<[1024, 64, 2, 1], offset: ?>>, vector<1x16x16x2xbf16>
+      %4 = vector.transfer_read %subview_1[%c0, %c0, %c0, %c0], %cst {in_bounds = [true, true, true, true]} : memref<1x16x16x2xbf16, strided<[1024, 32, 2, 1], offset: ?>>, vector<1x16x16x2xbf16>
+      %5 = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction", "reduction"], kind = #vector.kind<add>} %3, %4, %arg6 : vector<1x16x16x2xbf16>, vector<1x16x16x2xbf16> into vector<16x16xf32>
+      scf.yield %5 : vector<16x16xf32>
+    }
+    scf.yield %2 : vector<16x16xf32>
+  }
+  vector.transfer_write %1, %arg2[%c0, %c0] {in_bounds = [true, true]} : vector<16x16xf32>, memref<16x16xf32>
+  return
+}
+
+// CHECK-LABEL: func.func @brgemm_bf16(
+// CHECK-SAME:  %[[ARG0:.+]]: memref<4x16x32x2xbf16>, %[[ARG1:.+]]: memref<4x32x16x2xbf16>, %[[ARG2:.+]]: memref<16x16xf32>
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : index
+// CHECK: %[[ACC:.+]] = amx.tile_load %[[ARG2]][%[[C0]], %[[C0]]] : memref<16x16xf32> into vector<16x16xf32>
+// CHECK: %[[RES:.+]] = scf.for %{{.+}} iter_args(%[[A:.+]] = %[[ACC]])
+// CHECK:   %[[INNER:.+]] = scf.for %{{.+}} iter_args(%[[A1:.+]] = %[[A]])
+// CHECK:     %[[SA:.+]] = memref.subview %[[ARG0]]
+// CHECK:     %[[SB:.+]] = memref.subview %[[ARG1]]
+// CHECK:     %[[CA:.+]] = memref.collapse_shape %[[SA]] {{\[}}[0, 1], [2, 3]]
+// CHECK-SAME:  into memref<16x32xbf16, strided<[64, 1], offset: ?>>
+// CHECK:     %[[TA:.+]] = amx.tile_load %[[CA]][%[[C0]], %[[C0]]] : {{.+}} into vector<16x32xbf16>
+// CHECK:     %[[CB:.+]] = memref.collapse_shape %[[SB]] {{\[}}[0, 1], [2, 3]]
+// CHECK-SAME:  into memref<16x32xbf16, strided<[32, 1], offset: ?>>
+// CHECK:     %[[TB:.+]] = amx.tile_load %[[CB]][%[[C0]], %[[C0]]] : {{.+}} into vector<16x32xbf16>
+// CHECK:     %[[MUL:.+]] = amx.tile_mulf %[[TA]], %[[TB]], %[[A1]] : vector<16x32xbf16>, vector<16x32xbf16>, vector<16x16xf32>
+// CHECK:     scf.yield %[[MUL]]
+// CHECK:   scf.yield %[[INNER]]
+// CHECK: amx.tile_store %[[ARG2]][%[[C0]], %[[C0]]], %[[RES]] : memref<16x16xf32>, vector<16x16xf32>
+// CHECK-NOT: vector.contract
+
+// NOAMX-LABEL: func.func @brgemm_bf16(
+// NOAMX-NOT: amx.
+// NOAMX: vector.contract
+
+// -----
+
+#map = affine_map<(d0, d1, d2, d3, d4) -> (d0, d1, d3, d4)>
+#map1 = affine_map<(d0, d1, d2, d3, d4) -> (d0, d3, d2, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4) -> (d1, d2)>
+func.func @gemm_i8(%arg0: memref<1x16x16x4xi8>, %arg1: memref<1x16x16x4xi8>, %arg2: memref<16x16xi32>) {
+  %c0_i8 = arith.constant 0 : i8
+  %c0_i32 = arith.constant 0 : i32
+  %c0 = arith.constant 0 : index
+  %0 = vector.transfer_read %arg0[%c0, %c0, %c0, %c0], %c0_i8 {in_bounds = [true, true, true, true]} : memref<1x16x16x4xi8>, vector<1x16x16x4xi8>
+  %1 = vector.transfer_read %arg1[%c0, %c0, %c0, %c0], %c0_i8 {in_bounds = [true, true, true, true]} : memref<1x16x16x4xi8>, vector<1x16x16x4xi8>
+  %2 = vector.transfer_read %arg2[%c0, %c0], %c0_i32 {in_bounds = [true, true]} : memref<16x16xi32>, vector<16x16xi32>
+  %3 = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction", "reduction"], kind = #vector.kind<add>} %0, %1, %2 : vector<1x16x16x4xi8>, vector<1x16x16x4xi8> into vector<16x16xi32>
+  vector.transfer_write %3, %arg2[%c0, %c0] {in_bounds = [true, true]} : vector<16x16xi32>, memref<16x16xi32>
+  return
+}
+
+// CHECK-LABEL: func.func @gemm_i8(
+// CHECK-SAME:  %[[ARG0:.+]]: memref<1x16x16x4xi8>, %[[ARG1:.+]]: memref<1x16x16x4xi8>, %[[ARG2:.+]]: memref<16x16xi32>
+// CHECK-DAG: %[[CA:.+]] = memref.collapse_shape %[[ARG0]] {{\[}}[0, 1], [2, 3]] : memref<1x16x16x4xi8> into memref<16x64xi8>
+// CHECK-DAG: %[[CB:.+]] = memref.collapse_shape %[[ARG1]] {{\[}}[0, 1], [2, 3]] : memref<1x16x16x4xi8> into memref<16x64xi8>
+// CHECK-DAG: %[[ACC:.+]] = amx.tile_load %[[ARG2]]{{.*}} into vector<16x16xi32>
+// CHECK-DAG: %[[TA:.+]] = amx.tile_load %[[CA]]{{.*}} into vector<16x64xi8>
+// CHECK-DAG: %[[TB:.+]] = amx.tile_load %[[CB]]{{.*}} into vector<16x64xi8>
+// CHECK: %[[MUL:.+]] = amx.tile_muli %[[TA]], %[[TB]], %[[ACC]] : vector<16x64xi8>, vector<16x64xi8>, vector<16x16xi32>
+// CHECK: amx.tile_store %[[ARG2]]{{.*}}, %[[MUL]]
+
+// -----
+
+#map = affine_map<(d0, d1, d2, d3, d4) -> (d0, d1, d3, d4)>
+#map1 = affine_map<(d0, d1, d2, d3, d4) -> (d0, d3, d2, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4) -> (d1, d2)>
+// Rows of 32 columns in VNNI layout do not fit in a tile.
+func.func @too_wide(%arg0: vector<1x16x16x2xbf16>, %arg1: vector<1x16x32x2xbf16>, %arg2: vector<16x32xf32>) -> vector<16x32xf32> {
+  %0 = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction", "reduction"], kind = #vector.kind<add>} %arg0, %arg1, %arg2 : vector<1x16x16x2xbf16>, vector<1x16x32x2xbf16> into vector<16x32xf32>
+  return %0 : vector<16x32xf32>
+}
+
+// CHECK-LABEL: func.func @too_wide(
+// CHECK-NOT: amx.
+// CHECK: vector.contract
@@ -0,0 +1,77 @@
+// RUN: env LIBXSMM_TARGET=spr tpp-opt %s --vector-contract-to-fma --split-input-file | FileCheck %s
+// RUN: env LIBXSMM_TARGET=hsw tpp-opt %s --vector-contract-to-fma --split-input-file | FileCheck %s --check-prefix=NODOT
+
+#map = affine_map<(d0, d1, d2, d3, d4) -> (d0, d1, d3, d4)>
+#map1 = affine_map<(d0, d1, d2, d3, d4) -> (d0, d3, d2, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4) -> (d1, d2)>
+func.func @brgemm_vnni(%arg0: memref<16x32x32x2xbf16>, %arg1: memref<16x32x32x2xbf16>, %arg2: memref<32x32xf32>) {
+  %cst = arith.constant 0.000000e+00 : bf16
+  %cst_0 = arith.constant 0.000000e+00 : f32
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c2 = arith.constant 2 : index
+  %c16 = arith.constant 16 : index
+  %c32 = arith.constant 32 : index
+  scf.for %arg3 = %c0 to %c32 step %c2 {
+    scf.for %arg4 = %c0 to %c32 step %c32 {
+      %subview = memref.subview %arg2[%arg3, %arg4] [2, 32] [1, 1] : memref<32x32xf32> to memref<2x32xf32, strided<[32, 1], offset: ?>>
+      %0 = vector.transfer_read %subview[%c0, %c0], %cst_0 {in_bounds = [true, true]} : memref<2x32xf32, strided<[32, 1], offset: ?>>, vector<2x32xf32>
+      %1 = scf.for %arg5 = %c0 to %c16 step %c1 iter_args(%arg6 = %0) -> (vector<2x32xf32>) {
+        %2 = scf.for %arg7 = %c0 to %c32 step %c1 iter_args(%arg8 = %arg6) -> (vector<2x32xf32>) {
+          %subview_1 = memref.subview %arg0[%arg5, %arg3, %arg7, 0] [1, 2, 1, 2] [1, 1, 1, 1] : memref<16x32x32x2xbf16> to memref<1x2x1x2xbf16, strided<[2048, 64, 2, 1], offset: ?>>
+          %subview_2 = memref.subview %arg1[%arg5, %arg7, %arg4, 0] [1, 1, 32, 2] [1, 1, 1, 1] : memref<16x32x32x2xbf16> to memref<1x1x32x2xbf16, strided<[2048, 64, 2, 1], offset: ?>>
+          %3 = vector.transfer_read %subview_1[%c0, %c0, %c0, %c0], %cst {in_bounds = [true, true, true, true]} : memref<1x2x1x2xbf16, strided<[2048, 64, 2, 1], offset: ?>>, vector<1x2x1x2xbf16>
+          %4 = vector.transfer_read %subview_2[%c0, %c0, %c0, %c0], %cst {in_bounds = [true, true, true, true]} : memref<1x1x32x2xbf16, strided<[2048, 64, 2, 1], offset: ?>>, vector<1x1x32x2xbf16>
+          %5 = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction", "reduction"], kind = #vector.kind<add>} %3, %4, %arg8 : vector<1x2x1x2xbf16>, vector<1x1x32x2xbf16> into vector<2x32xf32>
+          scf.yield %5 : vector<2x32xf32>
+        }
+        scf.yield %2 : vector<2x32xf32>
+      }
+      vector.transfer_write %1, %subview[%c0, %c0] {in_bounds = [true, true]} : vector<2x32xf32>, memref<2x32xf32, strided<[32, 1], offset: ?>>
+    }
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @brgemm_vnni(
+// CHECK-SAME:  %[[ARG0:.+]]: memref<16x32x32x2xbf16>, %[[ARG1:.+]]: memref<16x32x32x2xbf16>, %[[ARG2:.+]]: memref<32x32xf32>
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : index
+// CHECK-DAG: %[[C1:.+]] = arith.constant 1 : index
+// CHECK-DAG: %[[C16:.+]] = arith.constant 16 : index
+// CHECK-DAG: %[[C32:.+]] = arith.constant 32 : index
+// CHECK: %[[SUB:.+]] = memref.subview %[[ARG2]]
+// CHECK: %[[ROW0:.+]] = memref.subview %[[SUB]][0, 0] [1, 32] [1, 1]
+// CHECK: %[[ROW1:.+]] = memref.subview %[[SUB]][1, 0] [1, 32] [1, 1]
+// CHECK: %[[ACC0:.+]] = vector.load %[[ROW0]][%[[C0]], %[[C0]]]{{.*}}vector<16xf32>
+// CHECK: %[[ACC1:.+]] = vector.load %[[ROW0]][%[[C0]], %[[C16]]]{{.*}}vector<16xf32>
+// CHECK: %[[ACC2:.+]] = vector.load %[[ROW1]][%[[C0]], %[[C0]]]{{.*}}vector<16xf32>
+// CHECK: %[[ACC3:.+]] = vector.load %[[ROW1]][%[[C0]], %[[C16]]]{{.*}}vector<16xf32>
+// CHECK: %[[RES:.+]]:4 = scf.for %[[B:.+]] = %[[C0]] to %[[C16]] step %[[C1]] iter_args({{.*}}) -> (vector<16xf32>, vector<16xf32>, vector<16xf32>, vector<16xf32>)
+// CHECK:   scf.for %[[K:.+]] = %[[C0]] to %[[C32]] step %[[C1]] iter_args(%[[A0:.+]] = %{{.+}}, %[[A1:.+]] = %{{.+}}, %[[A2:.+]] = %{{.+}}, %[[A3:.+]] = %{{.+}})
+// CHECK:     %[[LHS:.+]] = memref.subview %[[ARG0]][%[[B]], %{{.+}}, %[[K]], 0] [1, 2, 1, 2]
+// CHECK:     %[[P0:.+]] = vector.load %[[LHS]][%[[C0]], %[[C0]], %[[C0]], %[[C0]]]{{.*}}vector<2xbf16>
+// CHECK:     %[[I0:.+]] = vector.bitcast %[[P0]] : vector<2xbf16> to vector<1xi32>
+// CHECK:     %[[B0:.+]] = vector.broadcast %[[I0]] : vector<1xi32> to vector<16xi32>
+// CHECK:     %[[L0:.+]] = vector.bitcast %[[B0]] : vector<16xi32> to vector<32xbf16>
+// CHECK:     %[[P1:.+]] = vector.load %[[LHS]][%[[C0]], %[[C1]], %[[C0]], %[[C0]]]{{.*}}vector<2xbf16>
+// CHECK:     %[[L1:.+]] = vector.bitcast %{{.+}} : vector<16xi32> to vector<32xbf16>
+// CHECK:     %[[RHS:.+]] = memref.subview %[[ARG1]][%[[B]], %[[K]], %{{.+}}, 0] [1, 1, 32, 2]
+// CHECK:     %[[FLAT:.+]] = memref.collapse_shape %[[RHS]] {{\[}}[0], [1], [2, 3]]
+// CHECK:     %[[R0:.+]] = vector.load %[[FLAT]][%[[C0]], %[[C0]], %[[C0]]]{{.*}}vector<32xbf16>
+// CHECK:     %[[R1:.+]] = vector.load %[[FLAT]][%[[C0]], %[[C0]], %[[C32]]]{{.*}}vector<32xbf16>
+// CHECK:     %[[D0:.+]] = x86vector.avx512.dot %[[A0]], %[[L0]], %[[R0]] : vector<32xbf16> -> vector<16xf32>
+// CHECK:     %[[D1:.+]] = x86vector.avx512.dot %[[A1]], %[[L0]], %[[R1]] : vector<32xbf16> -> vector<16xf32>
+// CHECK:     %[[D2:.+]] = x86vector.avx512.dot %[[A2]], %[[L1]], %[[R0]] : vector<32xbf16> -> vector<16xf32>
+// CHECK:     %[[D3:.+]] = x86vector.avx512.dot %[[A3]], %[[L1]], %[[R1]] : vector<32xbf16> -> vector<16xf32>
+// CHECK:     scf.yield %[[D0]], %[[D1]], %[[D2]], %[[D3]]
+// CHECK: vector.store %[[RES]]#0, %[[ROW0]][%[[C0]], %[[C0]]]
+// CHECK: vector.store %[[RES]]#1, %[[ROW0]][%[[C0]], %[[C16]]]
+// CHECK: vector.store %[[RES]]#2, %[[ROW1]][%[[C0]], %[[C0]]]
+// CHECK: vector.store %[[RES]]#3, %[[ROW1]][%[[C0]], %[[C16]]]
+// CHECK-NOT: vector.contract
+// CHECK-NOT: vector.transfer_write
+
+// Without AVX512-BF16 the contraction is left as is.
+// NODOT-LABEL: func.func @brgemm_vnni(
+// NODOT-NOT: x86vector.avx512.dot
+// NODOT: vector.contract
@@ -0,0 +1,76 @@
+// RUN: tpp-opt %s --vector-contract-to-outerproduct="sme" --split-input-file | FileCheck %s
+
+#map = affine_map<(d0, d1, d2, d3) -> (d0, d1, d3)>
+#map1 = affine_map<(d0, d1, d2, d3) -> (d0, d3, d2)>
+#map2 = affine_map<(d0, d1, d2, d3) -> (d1, d2)>
+module attributes {
+  dlti.target_system_spec = #dlti.target_system_spec<
+    "CPU" = #dlti.target_device_spec<
+      #dlti.dl_entry<"has_sve", 1 : i32>,
+      #dlti.dl_entry<"has_sme", 1 : i32>>>
+} {
+  func.func @brgemm_sme(%arg0: memref<4x32x64xf32>, %arg1: memref<4x64x48xf32>, %arg2: memref<32x48xf32>) {
+    %cst = arith.constant 0.000000e+00 : f32
+    %c0 = arith.constant 0 : index
+    %0 = vector.transfer_read %arg0[%c0, %c0, %c0], %cst {in_bounds = [true, true, true]} : memref<4x32x64xf32>, vector<4x32x64xf32>
+    %1 = vector.transfer_read %arg1[%c0, %c0, %c0], %cst {in_bounds = [true, true, true]} : memref<4x64x48xf32>, vector<4x64x48xf32>
+    %2 = vector.transfer_read %arg2[%c0, %c0], %cst {in_bounds = [true, true]} : memref<32x48xf32>, vector<32x48xf32>
+    %3 = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction"], kind = #vector.kind<add>} %0, %1, %2 : vector<4x32x64xf32>, vector<4x64x48xf32> into vector<32x48xf32>
+    vector.transfer_write %3, %arg2[%c0, %c0] {in_bounds = [true, true]} : vector<32x48xf32>, memref<32x48xf32>
+    return
+  }
+}
+
+// CHECK: #[[$LHS:.+]] = affine_map<(d0, d1, d2) -> (d1)>
+// CHECK-LABEL: func.func @brgemm_sme(
+// CHECK-SAME:  %[[ARG0:.+]]: memref<4x32x64xf32>, %[[ARG1:.+]]: memref<4x64x48xf32>, %[[ARG2:.+]]: memref<32x48xf32>
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : index
+// CHECK-DAG: %[[C1:.+]] = arith.constant 1 : index
+// CHECK-DAG: %[[C4:.+]] = arith.constant 4 : index
+// CHECK-DAG: %[[C8:.+]] = arith.constant 8 : index
+// CHECK-DAG: %[[C32:.+]] = arith.constant 32 : index
+// CHECK-DAG: %[[C48:.+]] = arith.constant 48 : index
+// CHECK-DAG: %[[C64:.+]] = arith.constant 64 : index
+// CHECK: %[[VSCALE:.+]] = vector.vscale
+// CHECK: %[[VL:.+]] = arith.muli %[[VSCALE]], %[[C8]] : index
+// CHECK: scf.for %[[M:.+]] = %[[C0]] to %[[C32]] step %[[VL]]
+// CHECK:   scf.for %[[N:.+]] = %[[C0]] to %[[C48]] step %[[VL]]
+// CHECK:     %[[REMM:.+]] = arith.subi %[[C32]], %[[M]]
+// CHECK:     %[[REMN:.+]] = arith.subi %[[C48]], %[[N]]
+// CHECK:     %[[MASK:.+]] = vector.create_mask %[[REMM]], %[[REMN]] : vector<[8]x[8]xi1>
+// CHECK:     %[[LMASK:.+]] = vector.create_mask %[[REMM]] : vector<[8]xi1>
+// CHECK:     %[[RMASK:.+]] = vector.create_mask %[[REMN]] : vector<[8]xi1>
+// CHECK:     %[[ACC:.+]] = vector.transfer_read %[[ARG2]][%[[M]], %[[N]]], %{{.+}}, %[[MASK]]
+// CHECK-SAME:  memref<32x48xf32>, vector<[8]x[8]xf32>
+// CHECK:     %[[RES:.+]] = scf.for %[[B:.+]] = %[[C0]] to %[[C4]] step %[[C1]] iter_args(%[[A:.+]] = %[[ACC]])
+// CHECK:       %[[INNER:.+]] = scf.for %[[K:.+]] = %[[C0]] to %[[C64]] step %[[C1]] iter_args(%[[A1:.+]] = %[[A]])
+// CHECK:         %[[COL:.+]] = vector.transfer_read %[[ARG0]][%[[B]], %[[M]], %[[K]]], %{{.+}}, %[[LMASK]] {{{.*}}permutation_map = #[[$LHS]]
+// CHECK-SAME:      vector<[8]xf32>
+// CHECK:         %[[ROW:.+]] = vector.transfer_read %[[ARG1]][%[[B]], %[[K]], %[[N]]], %{{.+}}, %[[RMASK]]
+// CHECK-SAME:      vector<[8]xf32>
+// CHECK:         %[[OP:.+]] = vector.outerproduct %[[COL]], %[[ROW]], %[[A1]] {kind = #vector.kind<add>} : vector<[8]xf32>, vector<[8]xf32>
+// CHECK:         scf.yield %[[OP]]
+// CHECK:       scf.yield %[[INNER]]
+// CHECK:     vector.transfer_write %[[RES]], %[[ARG2]][%[[M]], %[[N]]], %[[MASK]]
+// CHECK-NOT: vector.contract
+
+// -----
+
+#map = affine_map<(d0, d1, d2) -> (d0, d2)>
+#map1 = affine_map<(d0, d1, d2) -> (d2, d1)>
+#map2 = affine_map<(d0, d1, d2) -> (d0, d1)>
+// Without SME the contraction is left as is.
+func.func @no_sme(%arg0: memref<16x16xf32>, %arg1: memref<16x16xf32>, %arg2: memref<16x16xf32>) {
+  %cst = arith.constant 0.000000e+00 : f32
+  %c0 = arith.constant 0 : index
+  %0 = vector.transfer_read %arg0[%c0, %c0], %cst {in_bounds = [true, true]} : memref<16x16xf32>, vector<16x16xf32>
+  %1 = vector.transfer_read %arg1[%c0, %c0], %cst {in_bounds = [true, true]} : memref<16x16xf32>, vector<16x16xf32>
+  %2 = vector.transfer_read %arg2[%c0, %c0], %cst {in_bounds = [true, true]} : memref<16x16xf32>, vector<16x16xf32>
+  %3 = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["parallel", "parallel", "reduction"], kind = #vector.kind<add>} %0, %1, %2 : vector<16x16xf32>, vector<16x16xf32> into vector<16x16xf32>
+  vector.transfer_write %3, %arg2[%c0, %c0] {in_bounds = [true, true]} : vector<16x16xf32>, memref<16x16xf32>
+  return
+}
+
+// CHECK-LABEL: func.func @no_sme(
+// CHECK-NOT: vector.outerproduct
+// CHECK: vector.contract
@@ -0,0 +1,70 @@
+// RUN: tpp-opt %s --vector-contract-to-fma --split-input-file | FileCheck %s
+
+#map = affine_map<(d0, d1, d2, d3) -> (d0, d1, d3)>
+#map1 = affine_map<(d0, d1, d2, d3) -> (d0, d3, d2)>
+#map2 = affine_map<(d0, d1, d2, d3) -> (d1, d2)>
+module attributes {
+  dlti.target_system_spec = #dlti.target_system_spec<
+    "CPU" = #dlti.target_device_spec<
+      #dlti.dl_entry<"has_sve", 1 : i32>>>
+} {
+  func.func @brgemm_sve(%arg0: memref<16x32x64xf32>, %arg1: memref<16x64x60xf32>, %arg2: memref<32x60xf32>) {
+    %cst = arith.constant 0.000000e+00 : f32
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c2 = arith.constant 2 : index
+    %c16 = arith.constant 16 : index
+    %c32 = arith.constant 32 : index
+    %c64 = arith.constant 64 : index
+    scf.for %arg3 = %c0 to %c32 step %c2 {
+      %subview = memref.subview %arg2[%arg3, 0] [2, 60] [1, 1] : memref<32x60xf32> to memref<2x60xf32, strided<[60, 1], offset: ?>>
+      %0 = vector.transfer_read %subview[%c0, %c0], %cst {in_bounds = [true, true]} : memref<2x60xf32, strided<[60, 1], offset: ?>>, vector<2x60xf32>
+      %1 = scf.for %arg4 = %c0 to %c16 step %c1 iter_args(%arg5 = %0) -> (vector<2x60xf32>) {
+        %2 = scf.for %arg6 = %c0 to %c64 step %c1 iter_args(%arg7 = %arg5) -> (vector<2x60xf32>) {
+          %subview_0 = memref.subview %arg0[%arg4, %arg3, %arg6] [1, 2, 1] [1, 1, 1] : memref<16x32x64xf32> to memref<1x2x1xf32, strided<[2048, 64, 1], offset: ?>>
+          %subview_1 = memref.subview %arg1[%arg4, %arg6, 0] [1, 1, 60] [1, 1, 1] : memref<16x64x60xf32> to memref<1x1x60xf32, strided<[3840, 60, 1], offset: ?>>
+          %3 = vector.transfer_read %subview_0[%c0, %c0, %c0], %cst {in_bounds = [true, true, true]} : memref<1x2x1xf32, strided<[2048, 64, 1], offset: ?>>, vector<1x2x1xf32>
+          %4 = vector.transfer_read %subview_1[%c0, %c0, %c0], %cst {in_bounds = [true, true, true]} : memref<1x1x60xf32, strided<[3840, 60, 1], offset: ?>>, vector<1x1x60xf32>
+          %5 = vector.contract {indexing_maps = [#map, #map1, #map2], iterator_types = ["reduction", "parallel", "parallel", "reduction"], kind = #vector.kind<add>} %3, %4, %arg7 : vector<1x2x1xf32>, vector<1x1x60xf32> into vector<2x60xf32>
+          scf.yield %5 : vector<2x60xf32>
+        }
+        scf.yield %2 : vector<2x60xf32>
+      }
+      vector.transfer_write %1, %subview[%c0, %c0] {in_bounds = [true, true]} : vector<2x60xf32>, memref<2x60xf32, strided<[60, 1], offset: ?>>
+    }
+    return
+  }
+}
+
+// CHECK-LABEL: func.func @brgemm_sve(
+// CHECK-SAME:  %[[ARG0:.+]]: memref<16x32x64xf32>, %[[ARG1:.+]]: memref<16x64x60xf32>, %[[ARG2:.+]]: memref<32x60xf32>
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : index
+// CHECK-DAG: %[[C4:.+]] = arith.constant 4 : index
+// CHECK-DAG: %[[C60:.+]] = arith.constant 60 : index
+// CHECK-DAG: %[[ZERO:.+]] = arith.constant dense<0.000000e+00> : vector<[4]xf32>
+// CHECK: %[[SUB:.+]] = memref.subview %[[ARG2]]
+// CHECK: %[[ROW0:.+]] = memref.subview %[[SUB]][0, 0] [1, 60] [1, 1]
+// CHECK: %[[ROW1:.+]] = memref.subview %[[SUB]][1, 0] [1, 60] [1, 1]
+// CHECK: %[[VSCALE:.+]] = vector.vscale
+// CHECK: %[[STEP:.+]] = arith.muli %[[VSCALE]], %[[C4]] : index
+// CHECK: scf.for %[[N:.+]] = %[[C0]] to %[[C60]] step %[[STEP]] {
+// CHECK:   %[[REM:.+]] = arith.subi %[[C60]], %[[N]] : index
+// CHECK:   %[[MASK:.+]] = vector.create_mask %[[REM]] : vector<[4]xi1>
+// CHECK:   %[[ACC0:.+]] = vector.maskedload %[[ROW0]][%[[C0]], %[[N]]], %[[MASK]], %[[ZERO]]
+// CHECK:   %[[ACC1:.+]] = vector.maskedload %[[ROW1]][%[[C0]], %[[N]]], %[[MASK]], %[[ZERO]]
+// CHECK:   %[[RES:.+]]:2 = scf.for %{{.+}} iter_args(%{{.+}} = %[[ACC0]], %{{.+}} = %[[ACC1]]) -> (vector<[4]xf32>, vector<[4]xf32>)
+// CHECK:     scf.for %{{.+}} iter_args(%[[A0:.+]] = %{{.+}}, %[[A1:.+]] = %{{.+}})
+// CHECK:       %[[LHS:.+]] = memref.subview %[[ARG0]]
+// CHECK:       %[[RHS:.+]] = memref.subview %[[ARG1]]
+// CHECK:       %[[ROW:.+]] = vector.maskedload %[[RHS]][%[[C0]], %[[C0]], %[[N]]], %[[MASK]], %[[ZERO]]
+// CHECK:       %[[E0:.+]] = memref.load %[[LHS]]
+// CHECK:       %[[B0:.+]] = vector.broadcast %[[E0]] : f32 to vector<[4]xf32>
+// CHECK:       %[[F0:.+]] = vector.fma %[[B0]], %[[ROW]], %[[A0]] : vector<[4]xf32>
+// CHECK:       %[[E1:.+]] = memref.load %[[LHS]]
+// CHECK:       %[[B1:.+]] = vector.broadcast %[[E1]] : f32 to vector<[4]xf32>
+// CHECK:       %[[F1:.+]] = vector.fma %[[B1]], %[[ROW]], %[[A1]] : vector<[4]xf32>
+// CHECK:       scf.yield %[[F0]], %[[F1]]
+// CHECK:   vector.maskedstore %[[ROW0]][%[[C0]], %[[N]]], %[[MASK]], %[[RES]]#0
+// CHECK:   vector.maskedstore %[[ROW1]][%[[C0]], %[[N]]], %[[MASK]], %[[RES]]#1
+// CHECK-NOT: vector.contract
+// CHECK-NOT: vector.transfer_write
@@ -0,0 +1,167 @@
+// RUN: tpp-opt %s -rewrite-loops-to-brgemm -split-input-file | FileCheck %s
+
+#map = affine_map<(d0) -> (d0 * 32)>
+
+// Hand-tiled matmul: parallel tiles of C, reduction over the tiles of K.
+func.func @forall_k_inner(%A: memref<128x256xf32>, %B: memref<256x128xf32>,
+                          %C: memref<128x128xf32>) {
+  %c0 = arith.constant 0 : index
+  %c32 = arith.constant 32 : index
+  %c256 = arith.constant 256 : index
+  scf.forall (%i, %j) in (4, 4) {
+    %ii = affine.apply #map(%i)
+    %jj = affine.apply #map(%j)
+    %c = memref.subview %C[%ii, %jj] [32, 32] [1, 1]
+      : memref<128x128xf32> to memref<32x32xf32, strided<[128, 1], offset: ?>>
+    scf.for %k = %c0 to %c256 step %c32 {
+      %a = memref.subview %A[%ii, %k] [32, 32] [1, 1]
+        : memref<128x256xf32> to memref<32x32xf32, strided<[256, 1], offset: ?>>
+      %b = memref.subview %B[%k, %jj] [32, 32] [1, 1]
+        : memref<256x128xf32> to memref<32x32xf32, strided<[128, 1], offset: ?>>
+      linalg.matmul ins(%a, %b : memref<32x32xf32, strided<[256, 1], offset: ?>>,
+                                 memref<32x32xf32, strided<[128, 1], offset: ?>>)
+                    outs(%c : memref<32x32xf32, strided<[128, 1], offset: ?>>)
+    }
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @forall_k_inner(
+// CHECK-SAME:  %[[A:[^:]+]]: memref<128x256xf32>, %[[B:[^:]+]]: memref<256x128xf32>, %[[C:[^:]+]]: memref<128x128xf32>
+// CHECK: %[[C0:.+]] = arith.constant 0 : index
+// CHECK: scf.forall
+// CHECK-NOT: scf.for
+// CHECK:   %[[CT:.+]] = memref.subview %[[C]]
+// CHECK:   %[[AT:.+]] = memref.subview %[[A]][%{{.+}}, %[[C0]]] [32, 32] [1, 1]
+// CHECK:   %[[BT:.+]] = memref.subview %[[B]][%[[C0]], %{{.+}}] [32, 32] [1, 1]
+// CHECK:   %[[ABASE:.+]], %[[AOFF:.+]], %{{.+}}:2, %{{.+}}:2 = memref.extract_strided_metadata %[[AT]]
+// CHECK:   %[[AB:.+]] = memref.reinterpret_cast %[[ABASE]] to offset: [%[[AOFF]]], sizes: [8, 32, 32], strides: [32, 256, 1]
+// CHECK-SAME:  memref<f32> to memref<8x32x32xf32, strided<[32, 256, 1], offset: ?>>
+// CHECK:   %[[BBASE:.+]], %[[BOFF:.+]], %{{.+}}:2, %{{.+}}:2 = memref.extract_strided_metadata %[[BT]]
+// CHECK:   %[[BB:.+]] = memref.reinterpret_cast %[[BBASE]] to offset: [%[[BOFF]]], sizes: [8, 32, 32], strides: [4096, 128, 1]
+// CHECK:   linalg.batch_reduce_matmul ins(%[[AB]], %[[BB]] : {{.+}}) outs(%[[CT]] : memref<32x32xf32, strided<[128, 1], offset: ?>>)
+// CHECK-NOT: linalg.matmul
+
+// -----
+
+// The reduction loop is the outermost one.
+func.func @k_outer(%A: memref<128x256xf32>, %B: memref<256x128xf32>,
+                   %C: memref<128x128xf32>) {
+  %c0 = arith.constant 0 : index
+  %c32 = arith.constant 32 : index
+  %c64 = arith.constant 64 : index
+  %c128 = arith.constant 128 : index
+  %c256 = arith.constant 256 : index
+  scf.for %k = %c0 to %c256 step %c64 {
+    scf.for %i = %c0 to %c128 step %c32 {
+      scf.for %j = %c0 to %c128 step %c32 {
+        %a = memref.subview %A[%i, %k] [32, 64] [1, 1]
+          : memref<128x256xf32> to memref<32x64xf32, strided<[256, 1], offset: ?>>
+        %b = memref.subview %B[%k, %j] [64, 32] [1, 1]
+          : memref<256x128xf32> to memref<64x32xf32, strided<[128, 1], offset: ?>>
+        %c = memref.subview %C[%i, %j] [32, 32] [1, 1]
+          : memref<128x128xf32> to memref<32x32xf32, strided<[128, 1], offset: ?>>
+        linalg.matmul ins(%a, %b : memref<32x64xf32, strided<[256, 1], offset: ?>>,
+                                   memref<64x32xf32, strided<[128, 1], offset: ?>>)
+                      outs(%c : memref<32x32xf32, strided<[128, 1], offset: ?>>)
+      }
+    }
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @k_outer(
+// CHECK: %[[C0:.+]] = arith.constant 0 : index
+// CHECK: scf.for %[[I:.+]] = %[[C0]]
+// CHECK:   scf.for %[[J:.+]] = %[[C0]]
+// CHECK:     memref.subview %{{.+}}[%[[I]], %[[C0]]] [32, 64] [1, 1]
+// CHECK:     memref.reinterpret_cast {{.+}} sizes: [4, 32, 64], strides: [64, 256, 1]
+// CHECK:     memref.reinterpret_cast {{.+}} sizes: [4, 64, 32], strides: [8192, 128, 1]
+// CHECK:     linalg.batch_reduce_matmul
+// CHECK-NOT: scf.for
+// CHECK-NOT: linalg.matmul
+
+// -----
+
+// Reduction over the blocks of K of packed operands, on tensors.
+func.func @packed_iter_args(%A: tensor<4x8x32x32xf32>, %B: tensor<4x8x32x32xf32>,
+                            %C: tensor<32x32xf32>) -> tensor<32x32xf32> {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c8 = arith.constant 8 : index
+  %0 = scf.for %k = %c0 to %c8 step %c1 iter_args(%acc = %C) -> (tensor<32x32xf32>) {
+    %a = tensor.extract_slice %A[1, %k, 0, 0] [1, 1, 32, 32] [1, 1, 1, 1]
+      : tensor<4x8x32x32xf32> to tensor<32x32xf32>
+    %b = tensor.extract_slice %B[2, %k, 0, 0] [1, 1, 32, 32] [1, 1, 1, 1]
+      : tensor<4x8x32x32xf32> to tensor<32x32xf32>
+    %1 = linalg.matmul ins(%a, %b : tensor<32x32xf32>, tensor<32x32xf32>)
+                       outs(%acc : tensor<32x32xf32>) -> tensor<32x32xf32>
+    scf.yield %1 : tensor<32x32xf32>
+  }
+  return %0 : tensor<32x32xf32>
+}
+
+// CHECK-LABEL: func.func @packed_iter_args(
+// CHECK-SAME:  %[[A:[^:]+]]: tensor<4x8x32x32xf32>, %[[B:[^:]+]]: tensor<4x8x32x32xf32>, %[[C:[^:]+]]: tensor<32x32xf32>
+// CHECK: %[[C0:.+]] = arith.constant 0 : index
+// CHECK-NOT: scf.for
+// CHECK: %[[AB:.+]] = tensor.extract_slice %[[A]][1, %[[C0]], 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+// CHECK-SAME:  tensor<4x8x32x32xf32> to tensor<8x32x32xf32>
+// CHECK: %[[BB:.+]] = tensor.extract_slice %[[B]][2, %[[C0]], 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+// CHECK: %[[RES:.+]] = linalg.batch_reduce_matmul ins(%[[AB]], %[[BB]] : tensor<8x32x32xf32>, tensor<8x32x32xf32>)
+// CHECK-SAME:  outs(%[[C]] : tensor<32x32xf32>)
+// CHECK: return %[[RES]]
+
+// -----
+
+// Split-K: each iteration accumulates into its own partial tile.
+func.func @c_varies(%A: memref<32x256xf32>, %B: memref<256x32xf32>,
+                    %P: memref<8x32x32xf32>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c8 = arith.constant 8 : index
+  %c32 = arith.constant 32 : index
+  scf.for %k = %c0 to %c8 step %c1 {
+    %kk = arith.muli %k, %c32 : index
+    %a = memref.subview %A[0, %kk] [32, 32] [1, 1]
+      : memref<32x256xf32> to memref<32x32xf32, strided<[256, 1], offset: ?>>
+    %b = memref.subview %B[%kk, 0] [32, 32] [1, 1]
+      : memref<256x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
+    %p = memref.subview %P[%k, 0, 0] [1, 32, 32] [1, 1, 1]
+      : memref<8x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
+    linalg.matmul ins(%a, %b : memref<32x32xf32, strided<[256, 1], offset: ?>>,
+                               memref<32x32xf32, strided<[32, 1], offset: ?>>)
+                  outs(%p : memref<32x32xf32, strided<[32, 1], offset: ?>>)
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @c_varies(
+// CHECK: scf.for
+// CHECK:   linalg.matmul
+// CHECK-NOT: linalg.batch_reduce_matmul
+
+// -----
+
+// The tiles of K are not a dimension of the slices.
+func.func @k_kept(%A: tensor<32x256xf32>, %B: tensor<256x32xf32>,
+                  %C: tensor<32x32xf32>) -> tensor<32x32xf32> {
+  %c0 = arith.constant 0 : index
+  %c32 = arith.constant 32 : index
+  %c256 = arith.constant 256 : index
+  %0 = scf.for %k = %c0 to %c256 step %c32 iter_args(%acc = %C) -> (tensor<32x32xf32>) {
+    %a = tensor.extract_slice %A[0, %k] [32, 32] [1, 1]
+      : tensor<32x256xf32> to tensor<32x32xf32>
+    %b = tensor.extract_slice %B[%k, 0] [32, 32] [1, 1]
+      : tensor<256x32xf32> to tensor<32x32xf32>
+    %1 = linalg.matmul ins(%a, %b : tensor<32x32xf32>, tensor<32x32xf32>)
+                       outs(%acc : tensor<32x32xf32>) -> tensor<32x32xf32>
+    scf.yield %1 : tensor<32x32xf32>
+  }
+  return %0 : tensor<32x32xf32>
+}
+
+// CHECK-LABEL: func.func @k_kept(
+// CHECK: scf.for
+// CHECK:   linalg.matmul
+// CHECK-NOT: linalg.batch_reduce_matmul
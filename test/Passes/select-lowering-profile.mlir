@@ -0,0 +1,67 @@
+// RUN: echo '{"xsmm_kernels":[{"kind":"brgemm","dtype":1,"m":64,"n":64,"k":64,"calls":10,"batches":80,"seconds":0.01},{"kind":"brgemm","dtype":1,"m":32,"n":32,"k":32,"calls":10,"batches":80,"seconds":0.0001},{"kind":"unary","dtype":1,"m":64,"n":64,"k":0,"calls":10,"batches":10,"seconds":0.01}]}' > %t.json
+// RUN: tpp-opt %s -select-lowering="profile=%t.json" -split-input-file | FileCheck %s
+// RUN: not tpp-opt %s -select-lowering="profile=%t.missing" 2>&1 | FileCheck %s --check-prefix=MISSING
+
+// An AVX-512 target without AMX.
+module attributes {
+  dlti.target_system_spec = #dlti.target_system_spec<
+    "CPU" = #dlti.target_device_spec<
+      #dlti.dl_entry<"max_vector_op_width", 512 : i32>,
+      #dlti.dl_entry<"num_vector_registers", 32 : i32>,
+      #dlti.dl_entry<"has_amx", 0 : i32>>>
+} {
+  // The kernel achieved 8% of the rate of the fastest one.
+  func.func @slow_brgemm(%arg0: memref<8x64x64xf32>, %arg1: memref<8x64x64xf32>,
+                         %arg2: memref<64x64xf32>) {
+    linalg.batch_reduce_matmul ins(%arg0, %arg1 : memref<8x64x64xf32>, memref<8x64x64xf32>)
+                               outs(%arg2 : memref<64x64xf32>)
+    return
+  }
+
+  // The fastest kernel of the profile.
+  func.func @fast_brgemm(%arg0: memref<8x32x32xf32>, %arg1: memref<8x32x32xf32>,
+                         %arg2: memref<32x32xf32>) {
+    linalg.batch_reduce_matmul ins(%arg0, %arg1 : memref<8x32x32xf32>, memref<8x32x32xf32>)
+                               outs(%arg2 : memref<32x32xf32>)
+    return
+  }
+
+  // Not profiled, the cost model decides.
+  func.func @unprofiled_brgemm(%arg0: memref<8x128x64xf32>, %arg1: memref<8x64x64xf32>,
+                               %arg2: memref<128x64xf32>) {
+    linalg.batch_reduce_matmul ins(%arg0, %arg1 : memref<8x128x64xf32>, memref<8x64x64xf32>)
+                               outs(%arg2 : memref<128x64xf32>)
+    return
+  }
+}
+
+// CHECK-LABEL: slow_brgemm
+// CHECK: linalg.batch_reduce_matmul {tpp.lowering = "vector"}
+// CHECK-LABEL: fast_brgemm
+// CHECK: linalg.batch_reduce_matmul {tpp.lowering = "xsmm"}
+// CHECK-LABEL: unprofiled_brgemm
+// CHECK: linalg.batch_reduce_matmul {tpp.lowering = "xsmm"}
+
+// -----
+
+module attributes {
+  dlti.target_system_spec = #dlti.target_system_spec<
+    "CPU" = #dlti.target_device_spec<
+      #dlti.dl_entry<"max_vector_op_width", 512 : i32>,
+      #dlti.dl_entry<"num_vector_registers", 32 : i32>,
+      #dlti.dl_entry<"has_amx", 0 : i32>>>
+} {
+  // The micro-kernels only take f32, low precision contractions stay in
+  // libxsmm.
+  func.func @slow_bf16_brgemm(%arg0: memref<8x64x64xbf16>, %arg1: memref<8x64x64xbf16>,
+                              %arg2: memref<64x64xbf16>) {
+    linalg.batch_reduce_matmul ins(%arg0, %arg1 : memref<8x64x64xbf16>, memref<8x64x64xbf16>)
+                               outs(%arg2 : memref<64x64xbf16>)
+    return
+  }
+}
+
+// CHECK-LABEL: slow_bf16_brgemm
+// CHECK: linalg.batch_reduce_matmul {tpp.lowering = "xsmm"}
+
+// MISSING: select-lowering: cannot read {{.*}}.missing
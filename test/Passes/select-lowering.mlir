@@ -0,0 +1,120 @@
+// RUN: tpp-opt %s -select-lowering -split-input-file | FileCheck %s
+// RUN: tpp-opt %s -select-lowering -convert-linalg-to-xsmm -split-input-file | FileCheck %s --check-prefix=XSMM
+
+// An AVX-512 target without AMX.
+module attributes {
+  dlti.target_system_spec = #dlti.target_system_spec<
+    "CPU" = #dlti.target_device_spec<
+      #dlti.dl_entry<"max_vector_op_width", 512 : i32>,
+      #dlti.dl_entry<"num_vector_registers", 32 : i32>,
+      #dlti.dl_entry<"has_amx", 0 : i32>>>
+} {
+  // The accumulator is a single register tile.
+  func.func @small_brgemm(%arg0: memref<8x4x8xf32>, %arg1: memref<8x8x32xf32>,
+                          %arg2: memref<4x32xf32>) {
+    linalg.batch_reduce_matmul ins(%arg0, %arg1 : memref<8x4x8xf32>, memref<8x8x32xf32>)
+                               outs(%arg2 : memref<4x32xf32>)
+    return
+  }
+
+  func.func @large_brgemm(%arg0: memref<8x64x64xf32>, %arg1: memref<8x64x64xf32>,
+                          %arg2: memref<64x64xf32>) {
+    linalg.batch_reduce_matmul ins(%arg0, %arg1 : memref<8x64x64xf32>, memref<8x64x64xf32>)
+                               outs(%arg2 : memref<64x64xf32>)
+    return
+  }
+}
+
+// CHECK-LABEL: small_brgemm
+// CHECK: linalg.batch_reduce_matmul {tpp.lowering = "vector"}
+// CHECK-LABEL: large_brgemm
+// CHECK: linalg.batch_reduce_matmul {tpp.lowering = "xsmm"}
+
+// XSMM-LABEL: small_brgemm
+// XSMM-NOT: xsmm.brgemm
+// XSMM: linalg.batch_reduce_matmul
+// XSMM-LABEL: large_brgemm
+// XSMM: xsmm.brgemm
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+
+module attributes {
+  dlti.target_system_spec = #dlti.target_system_spec<
+    "CPU" = #dlti.target_device_spec<
+      #dlti.dl_entry<"max_vector_op_width", 512 : i32>,
+      #dlti.dl_entry<"num_vector_registers", 32 : i32>,
+      #dlti.dl_entry<"has_amx", 0 : i32>>>
+} {
+  // The operands fit in the vector registers.
+  func.func @small_add(%arg0: memref<8x16xf32>, %arg1: memref<8x16xf32>) {
+    linalg.generic {
+      indexing_maps = [#map, #map],
+      iterator_types = ["parallel", "parallel"]}
+      ins(%arg0 : memref<8x16xf32>) outs(%arg1 : memref<8x16xf32>) {
+        ^bb0(%in: f32, %out: f32):
+          %0 = arith.addf %in, %out : f32
+          linalg.yield %0 : f32
+    }
+    return
+  }
+
+  func.func @large_add(%arg0: memref<64x64xf32>, %arg1: memref<64x64xf32>) {
+    linalg.generic {
+      indexing_maps = [#map, #map],
+      iterator_types = ["parallel", "parallel"]}
+      ins(%arg0 : memref<64x64xf32>) outs(%arg1 : memref<64x64xf32>) {
+        ^bb0(%in: f32, %out: f32):
+          %0 = arith.addf %in, %out : f32
+          linalg.yield %0 : f32
+    }
+    return
+  }
+
+  // Annotated operations are left as is.
+  func.func @annotated_add(%arg0: memref<64x64xf32>, %arg1: memref<64x64xf32>) {
+    linalg.generic {
+      indexing_maps = [#map, #map],
+      iterator_types = ["parallel", "parallel"]}
+      ins(%arg0 : memref<64x64xf32>) outs(%arg1 : memref<64x64xf32>)
+      attrs = {tpp.lowering = "vector"} {
+        ^bb0(%in: f32, %out: f32):
+          %0 = arith.addf %in, %out : f32
+          linalg.yield %0 : f32
+    }
+    return
+  }
+}
+
+// CHECK-LABEL: small_add
+// CHECK: linalg.generic
+// CHECK-SAME: tpp.lowering = "vector"
+// CHECK-LABEL: large_add
+// CHECK: linalg.generic
+// CHECK-SAME: tpp.lowering = "xsmm"
+// CHECK-LABEL: annotated_add
+// CHECK: linalg.generic
+// CHECK-SAME: tpp.lowering = "vector"
+
+// XSMM-LABEL: small_add
+// XSMM-NOT: xsmm.binary
+// XSMM: linalg.generic
+// XSMM-LABEL: large_add
+// XSMM: xsmm.binary add
+// XSMM-LABEL: annotated_add
+// XSMM-NOT: xsmm.binary
+// XSMM: linalg.generic
+
+// -----
+
+// Low precision contractions are left to libxsmm.
+func.func @bf16_brgemm(%arg0: memref<8x4x8xbf16>, %arg1: memref<8x8x32xbf16>,
+                       %arg2: memref<4x32xbf16>) {
+  linalg.batch_reduce_matmul ins(%arg0, %arg1 : memref<8x4x8xbf16>, memref<8x8x32xbf16>)
+                             outs(%arg2 : memref<4x32xbf16>)
+  return
+}
+
+// CHECK-LABEL: bf16_brgemm
+// CHECK: linalg.batch_reduce_matmul {tpp.lowering = "xsmm"}
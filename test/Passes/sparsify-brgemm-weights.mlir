@@ -0,0 +1,79 @@
+// RUN: tpp-opt %s -sparsify-brgemm-weights -split-input-file | FileCheck %s
+
+// Row 0 has two non-zero blocks, row 1 none.
+memref.global "private" constant @__constant_2x4x2x2xf32 : memref<2x4x2x2xf32> =
+  dense<[[[[1.0, 2.0], [3.0, 4.0]], [[0.0, 0.0], [0.0, 0.0]],
+          [[0.0, 0.0], [0.0, 0.0]], [[5.0, 6.0], [7.0, 8.0]]],
+         [[[0.0, 0.0], [0.0, 0.0]], [[0.0, 0.0], [0.0, 0.0]],
+          [[0.0, 0.0], [0.0, 0.0]], [[0.0, 0.0], [0.0, 0.0]]]]> {alignment = 64 : i64}
+
+func.func @sparse_weights(%arg0: memref<4x4x2x2xf32>, %arg1: memref<4x2x2x2xf32>) {
+  %c0 = arith.constant 0 : index
+  %c1 = arith.constant 1 : index
+  %c2 = arith.constant 2 : index
+  %c4 = arith.constant 4 : index
+  %c4_i64 = arith.constant 4 : i64
+  %0 = memref.get_global @__constant_2x4x2x2xf32 : memref<2x4x2x2xf32>
+  %1 = xsmm.brgemm.dispatch [2, 2, 2, 2, 2, 2, 4, 4] flags = (beta_0) data_type = f32
+  scf.parallel (%arg2, %arg3) = (%c0, %c0) to (%c4, %c2) step (%c1, %c1) {
+    %subview = memref.subview %arg0[%arg2, 0, 0, 0] [1, 4, 2, 2] [1, 1, 1, 1]
+      : memref<4x4x2x2xf32> to memref<4x2x2xf32, strided<[4, 2, 1], offset: ?>>
+    %subview_0 = memref.subview %0[%arg3, 0, 0, 0] [1, 4, 2, 2] [1, 1, 1, 1]
+      : memref<2x4x2x2xf32> to memref<4x2x2xf32, strided<[4, 2, 1], offset: ?>>
+    %subview_1 = memref.subview %arg1[%arg2, %arg3, 0, 0] [1, 1, 2, 2] [1, 1, 1, 1]
+      : memref<4x2x2x2xf32> to memref<2x2xf32, strided<[2, 1], offset: ?>>
+    xsmm.brgemm(data_type = f32, %1, %subview, %subview_0, %subview_1, %c4_i64)
+      : (i64, memref<4x2x2xf32, strided<[4, 2, 1], offset: ?>>,
+         memref<4x2x2xf32, strided<[4, 2, 1], offset: ?>>,
+         memref<2x2xf32, strided<[2, 1], offset: ?>>, i64) -> ()
+    scf.reduce
+  }
+  return
+}
+
+// CHECK-NOT: @__constant_2x4x2x2xf32
+// CHECK-DAG: memref.global "private" constant @__sparse_blocks : memref<3x2x2xf32> = dense<{{.+}}> {alignment = 64 : i64}
+// CHECK-DAG: memref.global "private" constant @__sparse_offsets_a : memref<2x2xi64> = dense<{{\[\[}}0, 48], [0, 0]]>
+// CHECK-DAG: memref.global "private" constant @__sparse_offsets_b : memref<2x2xi64> = dense<{{\[\[}}0, 16], [32, 0]]>
+// CHECK-DAG: memref.global "private" constant @__sparse_batches : memref<2xi64> = dense<[2, 1]>
+
+// CHECK-LABEL: sparse_weights
+// CHECK-SAME: %[[ARG0:.+]]: memref<4x4x2x2xf32>, %[[ARG1:.+]]: memref<4x2x2x2xf32>
+// CHECK: %[[DIS:.+]] = xsmm.brgemm.dispatch [2, 2, 2, 2, 2, 2, 4, 4] flags = (beta_0, batch_reduce_offset) data_type = f32
+// CHECK: scf.parallel (%[[I:.+]], %[[J:.+]]) =
+// CHECK: %[[A:.+]] = memref.subview %[[ARG0]][%[[I]], 0, 0, 0]
+// CHECK: %[[C:.+]] = memref.subview %[[ARG1]][%[[I]], %[[J]], 0, 0]
+// CHECK: %[[BATCHES:.+]] = memref.get_global @__sparse_batches : memref<2xi64>
+// CHECK: %[[BATCH:.+]] = memref.load %[[BATCHES]][%[[J]]] : memref<2xi64>
+// CHECK: %[[BLOCKS:.+]] = memref.get_global @__sparse_blocks : memref<3x2x2xf32>
+// CHECK: %[[TABLE_A:.+]] = memref.get_global @__sparse_offsets_a : memref<2x2xi64>
+// CHECK: %[[OFFSETS_A:.+]] = memref.subview %[[TABLE_A]][%[[J]], 0] [1, 2] [1, 1]
+// CHECK: %[[TABLE_B:.+]] = memref.get_global @__sparse_offsets_b : memref<2x2xi64>
+// CHECK: %[[OFFSETS_B:.+]] = memref.subview %[[TABLE_B]][%[[J]], 0] [1, 2] [1, 1]
+// CHECK: xsmm.brgemm_indirect offset(data_type = f32, %[[DIS]], %[[A]], %[[BLOCKS]], %[[C]], %[[OFFSETS_A]], %[[OFFSETS_B]], %[[BATCH]])
+// CHECK-NOT: xsmm.brgemm(
+
+// -----
+
+// Three of the four blocks are non-zero, keep the dense brgemm.
+memref.global "private" constant @__constant_2x2x1x2xf32 : memref<2x2x1x2xf32> =
+  dense<[[[[1.0, 2.0]], [[0.0, 0.0]]], [[[3.0, 4.0]], [[5.0, 0.0]]]]> {alignment = 64 : i64}
+
+func.func @dense_weights(%arg0: memref<2x1x1xf32>, %arg1: memref<1x2xf32>) {
+  %c0 = arith.constant 0 : index
+  %c2_i64 = arith.constant 2 : i64
+  %0 = memref.get_global @__constant_2x2x1x2xf32 : memref<2x2x1x2xf32>
+  %1 = xsmm.brgemm.dispatch [1, 2, 1, 1, 2, 2, 1, 2] flags = (beta_0) data_type = f32
+  %subview = memref.subview %0[%c0, 0, 0, 0] [1, 2, 1, 2] [1, 1, 1, 1]
+    : memref<2x2x1x2xf32> to memref<2x1x2xf32, strided<[2, 2, 1], offset: ?>>
+  xsmm.brgemm(data_type = f32, %1, %arg0, %subview, %arg1, %c2_i64)
+    : (i64, memref<2x1x1xf32>, memref<2x1x2xf32, strided<[2, 2, 1], offset: ?>>,
+       memref<1x2xf32>, i64) -> ()
+  return
+}
+
+// CHECK: memref.global "private" constant @__constant_2x2x1x2xf32
+// CHECK-LABEL: dense_weights
+// CHECK: xsmm.brgemm.dispatch [1, 2, 1, 1, 2, 2, 1, 2] flags = (beta_0) data_type = f32
+// CHECK: xsmm.brgemm(
+// CHECK-NOT: xsmm.brgemm_indirect
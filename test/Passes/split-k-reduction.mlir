@@ -0,0 +1,179 @@
+// RUN: tpp-opt %s -split-k-reduction="num-threads=16" -split-input-file | FileCheck %s
+// RUN: tpp-opt %s -split-k-reduction="num-threads=16 stream-k=true" -split-input-file | FileCheck %s -check-prefix=STREAMK
+// RUN: env TPP_NUM_THREADS=16 tpp-opt %s -split-k-reduction="num-threads=-1" -split-input-file | FileCheck %s
+// RUN: tpp-opt %s -split-k-reduction="num-threads=16 min-tiles-per-thread=2" -split-input-file | FileCheck %s -check-prefix=WAVES
+
+#map = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d2, d3, d5)>
+#map1 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d1, d2, d5, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d1, d3, d4)>
+
+func.func @blocked_matmul(%arg0: tensor<2x8x32x32xf32>, %arg1: tensor<2x8x32x32xf32>,
+                          %arg2: tensor<2x2x32x32xf32>) -> tensor<2x2x32x32xf32> {
+  %0 = linalg.generic {
+    indexing_maps = [#map, #map1, #map2],
+    iterator_types = ["parallel", "parallel", "reduction", "parallel", "parallel", "reduction"]}
+    ins(%arg0, %arg1 : tensor<2x8x32x32xf32>, tensor<2x8x32x32xf32>)
+    outs(%arg2 : tensor<2x2x32x32xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %1 = arith.mulf %in, %in_0 : f32
+    %2 = arith.addf %out, %1 : f32
+    linalg.yield %2 : f32
+  } -> tensor<2x2x32x32xf32>
+  return %0 : tensor<2x2x32x32xf32>
+}
+
+// The 4 tiles of the output are computed in 4 splits of the 8 blocks of K.
+// CHECK-DAG: #[[SPLIT_MAP:.+]] = affine_map<(d0) -> (d0 * 2)>
+// CHECK-LABEL: func.func @blocked_matmul(
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<2x8x32x32xf32>, %[[ARG1:.+]]: tensor<2x8x32x32xf32>, %[[ARG2:.+]]: tensor<2x2x32x32xf32>
+// CHECK: %[[EMPTY:.+]] = tensor.empty() : tensor<4x2x2x32x32xf32>
+// CHECK: %[[ZERO:.+]] = arith.constant 0.000000e+00 : f32
+// CHECK: %[[FILL:.+]] = linalg.fill ins(%[[ZERO]] : f32) outs(%[[EMPTY]] : tensor<4x2x2x32x32xf32>)
+// CHECK: %[[PARTIAL:.+]] = scf.forall (%[[S:.+]], %[[I:.+]], %[[J:.+]]) in (4, 2, 2) shared_outs(%[[ACC:.+]] = %[[FILL]])
+// CHECK:   %[[K:.+]] = affine.apply #[[SPLIT_MAP]](%[[S]])
+// CHECK:   %[[C:.+]] = tensor.extract_slice %[[ACC]][%[[S]], %[[I]], %[[J]], 0, 0] [1, 1, 1, 32, 32] [1, 1, 1, 1, 1]
+// CHECK-SAME: tensor<4x2x2x32x32xf32> to tensor<1x1x32x32xf32>
+// CHECK:   %[[A:.+]] = tensor.extract_slice %[[ARG0]][%[[I]], %[[K]], 0, 0] [1, 2, 32, 32] [1, 1, 1, 1]
+// CHECK:   %[[B:.+]] = tensor.extract_slice %[[ARG1]][%[[J]], %[[K]], 0, 0] [1, 2, 32, 32] [1, 1, 1, 1]
+// CHECK:   %[[GEMM:.+]] = linalg.generic
+// CHECK-SAME: ins(%[[A]], %[[B]] : tensor<1x2x32x32xf32>, tensor<1x2x32x32xf32>)
+// CHECK-SAME: outs(%[[C]] : tensor<1x1x32x32xf32>)
+// CHECK:   scf.forall.in_parallel
+// CHECK:     tensor.parallel_insert_slice %[[GEMM]] into %[[ACC]][%[[S]], %[[I]], %[[J]], 0, 0] [1, 1, 1, 32, 32] [1, 1, 1, 1, 1]
+// CHECK: split_reduction
+// CHECK: %[[RES:.+]] = scf.forall
+// CHECK-SAME: shared_outs(%{{.+}} = %[[ARG2]])
+// CHECK:   tensor.extract_slice %[[PARTIAL]]
+// CHECK:   linalg.reduce
+// CHECK:     arith.addf
+// CHECK:   dimensions = [0]
+// CHECK: return %[[RES]] : tensor<2x2x32x32xf32>
+
+// With 2 tiles per thread, the 4 tiles are computed in 8 splits.
+// WAVES-LABEL: func.func @blocked_matmul(
+// WAVES: tensor.empty() : tensor<8x2x2x32x32xf32>
+// WAVES: scf.forall (%{{.+}}, %{{.+}}, %{{.+}}) in (8, 2, 2)
+
+// -----
+
+func.func @skinny_matmul(%arg0: tensor<32x512xf32>, %arg1: tensor<512x64xf32>,
+                         %arg2: tensor<32x64xf32>) -> tensor<32x64xf32> {
+  %0 = linalg.matmul ins(%arg0, %arg1 : tensor<32x512xf32>, tensor<512x64xf32>)
+                     outs(%arg2 : tensor<32x64xf32>) -> tensor<32x64xf32>
+  return %0 : tensor<32x64xf32>
+}
+
+// The 2 tiles of 32x32 of the output are computed in 8 splits of K.
+// CHECK-LABEL: func.func @skinny_matmul(
+// CHECK: tensor.empty() : tensor<8x32x64xf32>
+// CHECK: scf.forall (%[[S:.+]], %[[I:.+]], %[[J:.+]]) in (8, 1, 2)
+// CHECK:   linalg.matmul
+// CHECK-SAME: ins(%{{.+}}, %{{.+}} : tensor<32x64xf32>, tensor<64x32xf32>)
+// CHECK-SAME: outs(%{{.+}} : tensor<32x32xf32>)
+// CHECK: split_reduction
+// CHECK: scf.forall
+// CHECK:   linalg.reduce
+
+// WAVES-LABEL: func.func @skinny_matmul(
+// WAVES: tensor.empty() : tensor<16x32x64xf32>
+// WAVES: scf.forall (%{{.+}}, %{{.+}}, %{{.+}}) in (16, 1, 2)
+
+// -----
+
+#map = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d2, d3, d5)>
+#map1 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d1, d2, d5, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d1, d3, d4)>
+
+func.func @enough_tiles(%arg0: tensor<4x8x32x32xf32>, %arg1: tensor<4x8x32x32xf32>,
+                        %arg2: tensor<4x4x32x32xf32>) -> tensor<4x4x32x32xf32> {
+  %0 = linalg.generic {
+    indexing_maps = [#map, #map1, #map2],
+    iterator_types = ["parallel", "parallel", "reduction", "parallel", "parallel", "reduction"]}
+    ins(%arg0, %arg1 : tensor<4x8x32x32xf32>, tensor<4x8x32x32xf32>)
+    outs(%arg2 : tensor<4x4x32x32xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %1 = arith.mulf %in, %in_0 : f32
+    %2 = arith.addf %out, %1 : f32
+    linalg.yield %2 : f32
+  } -> tensor<4x4x32x32xf32>
+  return %0 : tensor<4x4x32x32xf32>
+}
+
+// CHECK-LABEL: func.func @enough_tiles(
+// CHECK-NOT: scf.forall
+// CHECK: linalg.generic
+// CHECK-NOT: scf.forall
+// CHECK: return
+
+// A tile per thread is not enough, the reduction is split in 2.
+// WAVES-LABEL: func.func @enough_tiles(
+// WAVES: tensor.empty() : tensor<2x4x4x32x32xf32>
+// WAVES: scf.forall (%{{.+}}, %{{.+}}, %{{.+}}) in (2, 4, 4)
+// WAVES: split_reduction
+
+// -----
+
+#map = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d2, d3, d5)>
+#map1 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d1, d2, d5, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d1, d3, d4)>
+
+func.func @last_wave(%arg0: tensor<5x8x32x32xf32>, %arg1: tensor<4x8x32x32xf32>,
+                     %arg2: tensor<5x4x32x32xf32>) -> tensor<5x4x32x32xf32> {
+  %0 = linalg.generic {
+    indexing_maps = [#map, #map1, #map2],
+    iterator_types = ["parallel", "parallel", "reduction", "parallel", "parallel", "reduction"]}
+    ins(%arg0, %arg1 : tensor<5x8x32x32xf32>, tensor<4x8x32x32xf32>)
+    outs(%arg2 : tensor<5x4x32x32xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %1 = arith.mulf %in, %in_0 : f32
+    %2 = arith.addf %out, %1 : f32
+    linalg.yield %2 : f32
+  } -> tensor<5x4x32x32xf32>
+  return %0 : tensor<5x4x32x32xf32>
+}
+
+// Without stream-K, the 20 tiles are left to the default tiling.
+// CHECK-LABEL: func.func @last_wave(
+// CHECK-NOT: scf.forall
+// CHECK: linalg.generic
+// CHECK-NOT: scf.forall
+// CHECK: return
+
+// The 16 tiles of the full wave are computed whole, the 4 tiles of the last
+// wave in 4 shares of the 8 blocks of K, added into the output afterwards.
+// STREAMK-LABEL: func.func @last_wave(
+// STREAMK-SAME:  %[[ARG0:.+]]: tensor<5x8x32x32xf32>, %[[ARG1:.+]]: tensor<4x8x32x32xf32>, %[[ARG2:.+]]: tensor<5x4x32x32xf32>
+// STREAMK: %[[FULL:.+]] = scf.forall (%{{.+}}) in (16) shared_outs(%[[OUT:.+]] = %[[ARG2]])
+// STREAMK:   %[[C:.+]] = tensor.extract_slice %[[OUT]]
+// STREAMK-SAME: tensor<5x4x32x32xf32> to tensor<1x1x32x32xf32>
+// STREAMK:   tensor.extract_slice %[[ARG0]]
+// STREAMK-SAME: [1, 8, 32, 32] [1, 1, 1, 1] : tensor<5x8x32x32xf32> to tensor<1x8x32x32xf32>
+// STREAMK:   tensor.extract_slice %[[ARG1]]
+// STREAMK-SAME: [1, 8, 32, 32] [1, 1, 1, 1] : tensor<4x8x32x32xf32> to tensor<1x8x32x32xf32>
+// STREAMK:   linalg.generic
+// STREAMK-SAME: outs(%[[C]] : tensor<1x1x32x32xf32>)
+// STREAMK: split_reduction
+// STREAMK: %[[EMPTY:.+]] = tensor.empty() : tensor<4x4x1x1x32x32xf32>
+// STREAMK: %[[FILL:.+]] = linalg.fill
+// STREAMK: %[[SHARES:.+]] = scf.forall (%[[S:.+]], %[[T:.+]]) in (4, 4) shared_outs(%[[ACC:.+]] = %[[FILL]])
+// STREAMK:   %[[PARTIAL:.+]] = tensor.extract_slice %[[ACC]][%[[S]], %[[T]], 0, 0, 0, 0] [1, 1, 1, 1, 32, 32] [1, 1, 1, 1, 1, 1]
+// STREAMK-SAME: tensor<4x4x1x1x32x32xf32> to tensor<1x1x32x32xf32>
+// STREAMK:   tensor.extract_slice %[[ARG0]]
+// STREAMK-SAME: [1, 2, 32, 32] [1, 1, 1, 1] : tensor<5x8x32x32xf32> to tensor<1x2x32x32xf32>
+// STREAMK:   tensor.extract_slice %[[ARG1]]
+// STREAMK-SAME: [1, 2, 32, 32] [1, 1, 1, 1] : tensor<4x8x32x32xf32> to tensor<1x2x32x32xf32>
+// STREAMK:   linalg.generic
+// STREAMK-SAME: outs(%[[PARTIAL]] : tensor<1x1x32x32xf32>)
+// STREAMK: split_reduction
+// STREAMK: %[[FIXUP:.+]] = scf.forall (%[[L:.+]]) in (4) shared_outs(%[[RES:.+]] = %[[FULL]])
+// STREAMK:   %[[TILE:.+]] = tensor.extract_slice %[[RES]]
+// STREAMK:   %[[SHARE:.+]] = tensor.extract_slice %[[SHARES]][0, %[[L]], 0, 0, 0, 0] [4, 1, 1, 1, 32, 32] [1, 1, 1, 1, 1, 1]
+// STREAMK-SAME: tensor<4x4x1x1x32x32xf32> to tensor<4x1x1x32x32xf32>
+// STREAMK:   linalg.reduce ins(%[[SHARE]] : tensor<4x1x1x32x32xf32>) outs(%[[TILE]] : tensor<1x1x32x32xf32>)
+// STREAMK: split_reduction
+// STREAMK: return %[[FIXUP]] : tensor<5x4x32x32xf32>
+
+// WAVES-LABEL: func.func @last_wave(
+// WAVES: tensor.empty() : tensor<2x5x4x32x32xf32>
+// WAVES: scf.forall (%{{.+}}, %{{.+}}, %{{.+}}) in (2, 5, 4)
+// WAVES: split_reduction
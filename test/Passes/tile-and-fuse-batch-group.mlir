@@ -0,0 +1,80 @@
+// RUN: tpp-opt %s -split-input-file -tile-consumer-and-fuse-producers="batch-group-size=8 use-for-all=false" -cse | FileCheck %s
+// RUN: tpp-opt %s -split-input-file -tile-consumer-and-fuse-producers="batch-group-size=8" -cse | FileCheck %s --check-prefix=FORALL
+
+#map = affine_map<(d0, d1, d2, d3, d4, d5, d6) -> (d0, d1, d3, d4, d6)>
+#map1 = affine_map<(d0, d1, d2, d3, d4, d5, d6) -> (d0, d2, d3, d6, d5)>
+#map2 = affine_map<(d0, d1, d2, d3, d4, d5, d6) -> (d0, d1, d2, d4, d5)>
+
+// Each batch is a single 32x32 block, the batches run in groups of 8.
+func.func @blocked_batch_matmul_groups(%arg0: tensor<64x1x2x32x32xf32>,
+    %arg1: tensor<64x1x2x32x32xf32>) -> tensor<64x1x1x32x32xf32> {
+  %0 = tensor.empty() : tensor<64x1x1x32x32xf32>
+  %cst = arith.constant 0.0 : f32
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<64x1x1x32x32xf32>) -> tensor<64x1x1x32x32xf32>
+  %2 = linalg.generic {
+    indexing_maps = [#map, #map1, #map2],
+    iterator_types = ["parallel", "parallel", "parallel", "reduction", "parallel", "parallel", "reduction"]}
+    ins(%arg0, %arg1 : tensor<64x1x2x32x32xf32>, tensor<64x1x2x32x32xf32>) outs(%1 : tensor<64x1x1x32x32xf32>) {
+    ^bb0(%in: f32, %in_1: f32, %out: f32):
+      %3 = arith.mulf %in, %in_1 : f32
+      %4 = arith.addf %out, %3 : f32
+      linalg.yield %4 : f32
+    } -> tensor<64x1x1x32x32xf32>
+  return %2 : tensor<64x1x1x32x32xf32>
+}
+
+// CHECK-LABEL: func.func @blocked_batch_matmul_groups
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : index
+// CHECK-DAG: %[[C1:.+]] = arith.constant 1 : index
+// CHECK-DAG: %[[C8:.+]] = arith.constant 8 : index
+// CHECK-DAG: %[[C64:.+]] = arith.constant 64 : index
+// CHECK: scf.for %{{.+}} = %[[C0]] to %[[C64]] step %[[C8]]
+// CHECK-NOT: linalg.batch_reduce_matmul
+// CHECK: scf.for %{{.+}} = %[[C0]] to %[[C8]] step %[[C1]]
+// CHECK: linalg.fill ins(%{{.+}} : f32) outs(%{{.+}} : tensor<32x32xf32>) -> tensor<32x32xf32>
+// CHECK: linalg.batch_reduce_matmul ins(%{{.+}}, %{{.+}} : tensor<2x32x32xf32>, tensor<2x32x32xf32>)
+// CHECK-SAME:  outs(%{{.+}} : tensor<32x32xf32>) -> tensor<32x32xf32>
+
+// Only the groups run in parallel.
+// FORALL-LABEL: func.func @blocked_batch_matmul_groups
+// FORALL: scf.forall
+// FORALL-NOT: scf.forall
+// FORALL: scf.for
+// FORALL: linalg.batch_reduce_matmul{{.*}}-> tensor<32x32xf32>
+
+// -----
+
+#map = affine_map<(d0, d1, d2, d3, d4, d5, d6) -> (d0, d1, d3, d4, d6)>
+#map1 = affine_map<(d0, d1, d2, d3, d4, d5, d6) -> (d0, d2, d3, d6, d5)>
+#map2 = affine_map<(d0, d1, d2, d3, d4, d5, d6) -> (d0, d1, d2, d4, d5)>
+
+// Batches with several blocks of output already expose enough parallelism,
+// the batch and the blocks run in parallel with a single level.
+func.func @blocked_batch_matmul_no_groups(%arg0: tensor<64x2x2x32x32xf32>,
+    %arg1: tensor<64x2x2x32x32xf32>, %arg2: tensor<64x2x2x32x32xf32>) -> tensor<64x2x2x32x32xf32> {
+  %0 = linalg.generic {
+    indexing_maps = [#map, #map1, #map2],
+    iterator_types = ["parallel", "parallel", "parallel", "reduction", "parallel", "parallel", "reduction"]}
+    ins(%arg0, %arg1 : tensor<64x2x2x32x32xf32>, tensor<64x2x2x32x32xf32>) outs(%arg2 : tensor<64x2x2x32x32xf32>) {
+    ^bb0(%in: f32, %in_1: f32, %out: f32):
+      %1 = arith.mulf %in, %in_1 : f32
+      %2 = arith.addf %out, %1 : f32
+      linalg.yield %2 : f32
+    } -> tensor<64x2x2x32x32xf32>
+  return %0 : tensor<64x2x2x32x32xf32>
+}
+
+// CHECK-LABEL: func.func @blocked_batch_matmul_no_groups
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : index
+// CHECK-DAG: %[[C1:.+]] = arith.constant 1 : index
+// CHECK-DAG: %[[C2:.+]] = arith.constant 2 : index
+// CHECK-DAG: %[[C64:.+]] = arith.constant 64 : index
+// CHECK: scf.for %{{.+}} = %[[C0]] to %[[C64]] step %[[C1]]
+// CHECK-NEXT: scf.for %{{.+}} = %[[C0]] to %[[C2]] step %[[C1]]
+// CHECK-NEXT: scf.for %{{.+}} = %[[C0]] to %[[C2]] step %[[C1]]
+// CHECK: linalg.batch_reduce_matmul{{.*}}-> tensor<32x32xf32>
+// CHECK-NOT: scf.for
+
+// FORALL-LABEL: func.func @blocked_batch_matmul_no_groups
+// FORALL: scf.forall (%{{.+}}, %{{.+}}, %{{.+}}) in (64, 2, 2)
+// FORALL: linalg.batch_reduce_matmul{{.*}}-> tensor<32x32xf32>
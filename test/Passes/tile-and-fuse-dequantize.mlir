@@ -0,0 +1,53 @@
+// RUN: tpp-opt %s -tile-consumer-and-fuse-producers="tile-sizes=1,1 fuse-dequantize use-for-all=false" -cse | FileCheck %s
+// RUN: tpp-opt %s -tile-consumer-and-fuse-producers="tile-sizes=1,1 use-for-all=false" -cse | FileCheck %s --check-prefix=NOFUSE
+
+#map = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d2, d3, d5)>
+#map1 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d1, d2, d5, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d1, d3, d4)>
+#id = affine_map<(d0, d1, d2, d3) -> (d0, d1, d2, d3)>
+#scale = affine_map<(d0, d1, d2, d3) -> (d0 * 32 + d3)>
+
+func.func @blocked_matmul_dequantize(%arg0: tensor<4x8x32x32xf32>, %arg1: tensor<4x8x32x32xi8>,
+    %arg2: tensor<128xf32>, %arg3: tensor<4x4x32x32xf32>) -> tensor<4x4x32x32xf32> {
+  %0 = tensor.empty() : tensor<4x8x32x32xf32>
+  %1 = linalg.generic {
+      indexing_maps = [#id, #scale, #id],
+      iterator_types = ["parallel", "parallel", "parallel", "parallel"]}
+      ins(%arg1, %arg2 : tensor<4x8x32x32xi8>, tensor<128xf32>)
+      outs(%0 : tensor<4x8x32x32xf32>) {
+    ^bb0(%in: i8, %scale: f32, %out: f32):
+      %2 = arith.sitofp %in : i8 to f32
+      %3 = arith.mulf %2, %scale : f32
+      linalg.yield %3 : f32
+  } -> tensor<4x8x32x32xf32>
+  %4 = linalg.generic {
+      indexing_maps = [#map, #map1, #map2],
+      iterator_types = ["parallel", "parallel", "reduction", "parallel", "parallel", "reduction"]}
+      ins(%arg0, %1 : tensor<4x8x32x32xf32>, tensor<4x8x32x32xf32>)
+      outs(%arg3 : tensor<4x4x32x32xf32>) {
+    ^bb0(%in: f32, %in_2: f32, %out: f32):
+      %5 = arith.mulf %in, %in_2 : f32
+      %6 = arith.addf %out, %5 : f32
+      linalg.yield %6 : f32
+  } -> tensor<4x4x32x32xf32>
+  return %4 : tensor<4x4x32x32xf32>
+}
+
+// Each tile dequantizes the block column of the weights it reads.
+// CHECK-LABEL: func.func @blocked_matmul_dequantize(
+// CHECK-SAME:  %[[ARG1:.+]]: tensor<4x8x32x32xi8>
+// CHECK-NOT: linalg.generic
+// CHECK: scf.for
+// CHECK: %[[SLICE:.+]] = tensor.extract_slice %[[ARG1]][%{{.+}}, 0, 0, 0] [1, 8, 32, 32] [1, 1, 1, 1]
+// CHECK: %[[BUF:.+]] = tensor.empty() : tensor<1x8x32x32xf32>
+// CHECK: linalg.generic
+// CHECK-SAME:  ins(%[[SLICE]], %{{.+}} : tensor<1x8x32x32xi8>, tensor<32xf32>)
+// CHECK-SAME:  outs(%[[BUF]] : tensor<1x8x32x32xf32>)
+// CHECK: arith.sitofp
+// CHECK: linalg.generic
+
+// The whole weights are dequantized ahead of the tile loops.
+// NOFUSE-LABEL: func.func @blocked_matmul_dequantize(
+// NOFUSE: linalg.generic
+// NOFUSE-SAME:  ins(%{{.+}}, %{{.+}} : tensor<4x8x32x32xi8>, tensor<128xf32>)
+// NOFUSE: scf.for
@@ -0,0 +1,71 @@
+// RUN: tpp-opt %s -split-input-file -tile-consumer-and-fuse-producers -cse | FileCheck %s
+
+#map = affine_map<(d0, d1, d2) -> (d0, d1)>
+#map1 = affine_map<(d0, d1, d2) -> (d0, d2)>
+
+func.func @embedding_bag(%table: tensor<1000x64xf32>,
+                         %indices: tensor<128x4xi64>) -> tensor<128x64xf32> {
+  %cst = arith.constant 0.000000e+00 : f32
+  %0 = tensor.empty() : tensor<128x64xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<128x64xf32>) -> tensor<128x64xf32>
+  %2 = linalg.generic {
+    indexing_maps = [#map, #map1],
+    iterator_types = ["parallel", "reduction", "parallel"]}
+    ins(%indices : tensor<128x4xi64>) outs(%1 : tensor<128x64xf32>) {
+    ^bb0(%in: i64, %out: f32):
+      %row = arith.index_cast %in : i64 to index
+      %col = linalg.index 2 : index
+      %3 = tensor.extract %table[%row, %col] : tensor<1000x64xf32>
+      %4 = arith.addf %3, %out : f32
+      linalg.yield %4 : f32
+  } -> tensor<128x64xf32>
+  return %2 : tensor<128x64xf32>
+}
+
+// The bags are distributed by groups of 32, whole bags and rows per thread.
+// CHECK-LABEL: embedding_bag
+// CHECK-SAME: %[[TABLE:.+]]: tensor<1000x64xf32>, %[[INDICES:.+]]: tensor<128x4xi64>
+// CHECK: scf.forall (%[[I:.+]]) = (0) to (128) step (32)
+// CHECK-DAG: %[[SLICE:.+]] = tensor.extract_slice %[[INDICES]][%[[I]], 0] [32, 4] [1, 1]
+// CHECK-DAG: linalg.fill {{.+}} -> tensor<32x64xf32>
+// CHECK: linalg.generic
+// CHECK-SAME: iterator_types = ["parallel", "reduction", "parallel"]
+// CHECK-SAME: ins(%[[SLICE]] : tensor<32x4xi64>)
+// CHECK: tensor.extract %[[TABLE]]
+
+// -----
+
+#map = affine_map<(d0, d1, d2) -> (d0, d1)>
+#map1 = affine_map<(d0, d1, d2) -> (d0, d2)>
+#map2 = affine_map<(d0, d1) -> (d0, d1)>
+
+// The lookups are not recomputed for each tile of the matmul.
+func.func @embedding_bag_matmul(%table: tensor<1000x64xf32>,
+                                %indices: tensor<128x4xi64>,
+                                %weights: tensor<64x64xf32>) -> tensor<128x64xf32> {
+  %cst = arith.constant 0.000000e+00 : f32
+  %0 = tensor.empty() : tensor<128x64xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<128x64xf32>) -> tensor<128x64xf32>
+  %2 = linalg.generic {
+    indexing_maps = [#map, #map1],
+    iterator_types = ["parallel", "reduction", "parallel"]}
+    ins(%indices : tensor<128x4xi64>) outs(%1 : tensor<128x64xf32>) {
+    ^bb0(%in: i64, %out: f32):
+      %row = arith.index_cast %in : i64 to index
+      %col = linalg.index 2 : index
+      %3 = tensor.extract %table[%row, %col] : tensor<1000x64xf32>
+      %4 = arith.addf %3, %out : f32
+      linalg.yield %4 : f32
+  } -> tensor<128x64xf32>
+  %5 = linalg.matmul ins(%2, %weights : tensor<128x64xf32>, tensor<64x64xf32>)
+                     outs(%1 : tensor<128x64xf32>) -> tensor<128x64xf32>
+  return %5 : tensor<128x64xf32>
+}
+
+// CHECK-LABEL: embedding_bag_matmul
+// CHECK: %[[BAGS:.+]] = scf.forall (%{{.+}}) = (0) to (128) step (32)
+// CHECK: tensor.extract
+// CHECK-NOT: linalg.matmul
+// CHECK: scf.forall (%{{.+}}, %{{.+}}) = (0, 0) to (128, 64) step (32, 32)
+// CHECK-NOT: tensor.extract
+// CHECK: linalg.matmul
@@ -0,0 +1,112 @@
+// RUN: tpp-opt %s -split-input-file -tile-consumer-and-fuse-producers="fuse-layers" -cse | FileCheck %s
+
+#map = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d2, d3, d5)>
+#map1 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d1, d2, d5, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d1, d3, d4)>
+#map3 = affine_map<(d0, d1, d2, d3) -> (d0, d1, d2, d3)>
+
+func.func @mlp(%arg0: tensor<2x4x32x32xf32>, %arg1: tensor<8x4x32x32xf32>,
+    %arg2: tensor<4x8x32x32xf32>) -> tensor<2x4x32x32xf32> {
+  %cst = arith.constant 0.000000e+00 : f32
+  %0 = tensor.empty() : tensor<2x8x32x32xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<2x8x32x32xf32>) -> tensor<2x8x32x32xf32>
+  %2 = linalg.generic {
+      indexing_maps = [#map, #map1, #map2],
+      iterator_types = ["parallel", "parallel", "reduction", "parallel", "parallel", "reduction"]}
+      ins(%arg0, %arg1 : tensor<2x4x32x32xf32>, tensor<8x4x32x32xf32>)
+      outs(%1 : tensor<2x8x32x32xf32>) {
+    ^bb0(%in: f32, %in_0: f32, %out: f32):
+      %9 = arith.mulf %in, %in_0 : f32
+      %10 = arith.addf %out, %9 : f32
+      linalg.yield %10 : f32
+  } -> tensor<2x8x32x32xf32>
+  %3 = linalg.generic {
+      indexing_maps = [#map3],
+      iterator_types = ["parallel", "parallel", "parallel", "parallel"]}
+      outs(%2 : tensor<2x8x32x32xf32>) {
+    ^bb0(%out: f32):
+      %9 = arith.maximumf %out, %cst : f32
+      linalg.yield %9 : f32
+  } -> tensor<2x8x32x32xf32>
+  %4 = tensor.empty() : tensor<2x4x32x32xf32>
+  %5 = linalg.fill ins(%cst : f32) outs(%4 : tensor<2x4x32x32xf32>) -> tensor<2x4x32x32xf32>
+  %6 = linalg.generic {
+      indexing_maps = [#map, #map1, #map2],
+      iterator_types = ["parallel", "parallel", "reduction", "parallel", "parallel", "reduction"]}
+      ins(%3, %arg2 : tensor<2x8x32x32xf32>, tensor<4x8x32x32xf32>)
+      outs(%5 : tensor<2x4x32x32xf32>) {
+    ^bb0(%in: f32, %in_0: f32, %out: f32):
+      %9 = arith.mulf %in, %in_0 : f32
+      %10 = arith.addf %out, %9 : f32
+      linalg.yield %10 : f32
+  } -> tensor<2x4x32x32xf32>
+  %7 = linalg.generic {
+      indexing_maps = [#map3],
+      iterator_types = ["parallel", "parallel", "parallel", "parallel"]}
+      outs(%6 : tensor<2x4x32x32xf32>) {
+    ^bb0(%out: f32):
+      %9 = arith.maximumf %out, %cst : f32
+      linalg.yield %9 : f32
+  } -> tensor<2x4x32x32xf32>
+  return %7 : tensor<2x4x32x32xf32>
+}
+
+// A single loop over the row panels runs both layers, the activations of the
+// first layer are computed for the panel only.
+// CHECK-LABEL: func.func @mlp(
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<2x4x32x32xf32>, %[[ARG1:.+]]: tensor<8x4x32x32xf32>, %[[ARG2:.+]]: tensor<4x8x32x32xf32>
+// CHECK: scf.forall (%[[I:.+]]) in (2)
+// CHECK:   tensor.extract_slice %[[ARG0]][%[[I]], 0, 0, 0] [1, 4, 32, 32] [1, 1, 1, 1]
+// CHECK:   linalg.fill
+// CHECK:   linalg.generic
+// CHECK:     arith.mulf
+// CHECK:   linalg.generic
+// CHECK:     arith.maximumf
+// CHECK:   linalg.fill
+// CHECK:   linalg.generic
+// CHECK:     arith.mulf
+// CHECK:   linalg.generic
+// CHECK:     arith.maximumf
+// CHECK:   tensor.parallel_insert_slice
+// CHECK-NOT: scf.forall
+
+// -----
+
+#map = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d2, d3, d5)>
+#map1 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d1, d2, d5, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d1, d3, d4)>
+
+func.func @hidden_returned(%arg0: tensor<2x4x32x32xf32>, %arg1: tensor<8x4x32x32xf32>,
+    %arg2: tensor<4x8x32x32xf32>) -> (tensor<2x8x32x32xf32>, tensor<2x4x32x32xf32>) {
+  %cst = arith.constant 0.000000e+00 : f32
+  %0 = tensor.empty() : tensor<2x8x32x32xf32>
+  %1 = linalg.fill ins(%cst : f32) outs(%0 : tensor<2x8x32x32xf32>) -> tensor<2x8x32x32xf32>
+  %2 = linalg.generic {
+      indexing_maps = [#map, #map1, #map2],
+      iterator_types = ["parallel", "parallel", "reduction", "parallel", "parallel", "reduction"]}
+      ins(%arg0, %arg1 : tensor<2x4x32x32xf32>, tensor<8x4x32x32xf32>)
+      outs(%1 : tensor<2x8x32x32xf32>) {
+    ^bb0(%in: f32, %in_0: f32, %out: f32):
+      %9 = arith.mulf %in, %in_0 : f32
+      %10 = arith.addf %out, %9 : f32
+      linalg.yield %10 : f32
+  } -> tensor<2x8x32x32xf32>
+  %4 = tensor.empty() : tensor<2x4x32x32xf32>
+  %5 = linalg.fill ins(%cst : f32) outs(%4 : tensor<2x4x32x32xf32>) -> tensor<2x4x32x32xf32>
+  %6 = linalg.generic {
+      indexing_maps = [#map, #map1, #map2],
+      iterator_types = ["parallel", "parallel", "reduction", "parallel", "parallel", "reduction"]}
+      ins(%2, %arg2 : tensor<2x8x32x32xf32>, tensor<4x8x32x32xf32>)
+      outs(%5 : tensor<2x4x32x32xf32>) {
+    ^bb0(%in: f32, %in_0: f32, %out: f32):
+      %9 = arith.mulf %in, %in_0 : f32
+      %10 = arith.addf %out, %9 : f32
+      linalg.yield %10 : f32
+  } -> tensor<2x4x32x32xf32>
+  return %2, %6 : tensor<2x8x32x32xf32>, tensor<2x4x32x32xf32>
+}
+
+// The hidden activations are returned, the layers are tiled on their own.
+// CHECK-LABEL: func.func @hidden_returned(
+// CHECK: scf.forall (%{{.+}}, %{{.+}}) in (2, 8)
+// CHECK: scf.forall (%{{.+}}, %{{.+}}) in (2, 4)
@@ -0,0 +1,88 @@
+// RUN: tpp-opt %s -split-input-file -tile-consumer-and-fuse-producers="tile-sizes=1,0 fuse-lhs-pack use-for-all=false" -cse | FileCheck %s
+// RUN: tpp-opt %s -split-input-file -tile-consumer-and-fuse-producers="tile-sizes=1,1 outer-tile-sizes=1,4 min-tile-factor=1 fuse-lhs-pack use-for-all=false" -cse | FileCheck %s --check-prefix=OUTER
+// RUN: tpp-opt %s -split-input-file -tile-consumer-and-fuse-producers="tile-sizes=1,1 fuse-lhs-pack use-for-all=false" -cse | FileCheck %s --check-prefix=NOFUSE
+
+#map = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d2, d3, d5)>
+#map1 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d1, d2, d5, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d1, d3, d4)>
+
+func.func @blocked_matmul_lhs_pack(%arg0: tensor<128x256xf32>, %arg1: tensor<4x8x32x32xf32>,
+    %arg2: tensor<4x4x32x32xf32>) -> tensor<4x4x32x32xf32> {
+  %0 = tensor.empty() : tensor<4x8x32x32xf32>
+  %pack = tensor.pack %arg0 inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %0
+    : tensor<128x256xf32> -> tensor<4x8x32x32xf32>
+  %1 = linalg.generic {
+      indexing_maps = [#map, #map1, #map2],
+      iterator_types = ["parallel", "parallel", "reduction", "parallel", "parallel", "reduction"]}
+      ins(%pack, %arg1 : tensor<4x8x32x32xf32>, tensor<4x8x32x32xf32>)
+      outs(%arg2 : tensor<4x4x32x32xf32>) {
+    ^bb0(%in: f32, %in_2: f32, %out: f32):
+      %2 = arith.mulf %in, %in_2 : f32
+      %3 = arith.addf %out, %2 : f32
+      linalg.yield %3 : f32
+  } -> tensor<4x4x32x32xf32>
+  return %1 : tensor<4x4x32x32xf32>
+}
+
+// Each tile spans the columns and packs its own block row.
+// CHECK-LABEL: func.func @blocked_matmul_lhs_pack(
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<128x256xf32>
+// CHECK-NOT: tensor.pack
+// CHECK: scf.for
+// CHECK: %[[SLICE:.+]] = tensor.extract_slice %[[ARG0]][%{{.+}}, 0] [32, 256] [1, 1]
+// CHECK: %[[BUF:.+]] = tensor.empty() : tensor<1x8x32x32xf32>
+// CHECK: %[[PACK:.+]] = tensor.pack %[[SLICE]] inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %[[BUF]]
+// CHECK-SAME:  : tensor<32x256xf32> -> tensor<1x8x32x32xf32>
+// CHECK: linalg.generic
+// CHECK-NOT: tensor.pack
+
+// The outer row panels pack their block row, which the inner tiles reuse.
+// OUTER-LABEL: func.func @blocked_matmul_lhs_pack(
+// OUTER-NOT: tensor.pack
+// OUTER: scf.for
+// OUTER: tensor.pack {{.+}} : tensor<32x256xf32> -> tensor<1x8x32x32xf32>
+// OUTER-NOT: tensor.pack
+// OUTER: scf.for
+// OUTER: linalg.generic
+
+// The tiles over the columns would pack the same block row again.
+// NOFUSE-LABEL: func.func @blocked_matmul_lhs_pack(
+// NOFUSE: tensor.pack {{.+}} : tensor<128x256xf32> -> tensor<4x8x32x32xf32>
+// NOFUSE: scf.for
+// NOFUSE-NOT: tensor.pack
+
+// -----
+
+#map = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d2, d3, d5)>
+#map1 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d1, d2, d5, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d1, d3, d4)>
+
+func.func @blocked_matmul_shared_pack(%arg0: tensor<128x256xf32>, %arg1: tensor<4x8x32x32xf32>,
+    %arg2: tensor<4x4x32x32xf32>) -> (tensor<4x4x32x32xf32>, tensor<4x8x32x32xf32>) {
+  %0 = tensor.empty() : tensor<4x8x32x32xf32>
+  %pack = tensor.pack %arg0 inner_dims_pos = [0, 1] inner_tiles = [32, 32] into %0
+    : tensor<128x256xf32> -> tensor<4x8x32x32xf32>
+  %1 = linalg.generic {
+      indexing_maps = [#map, #map1, #map2],
+      iterator_types = ["parallel", "parallel", "reduction", "parallel", "parallel", "reduction"]}
+      ins(%pack, %arg1 : tensor<4x8x32x32xf32>, tensor<4x8x32x32xf32>)
+      outs(%arg2 : tensor<4x4x32x32xf32>) {
+    ^bb0(%in: f32, %in_2: f32, %out: f32):
+      %2 = arith.mulf %in, %in_2 : f32
+      %3 = arith.addf %out, %2 : f32
+      linalg.yield %3 : f32
+  } -> tensor<4x4x32x32xf32>
+  return %1, %pack : tensor<4x4x32x32xf32>, tensor<4x8x32x32xf32>
+}
+
+// A pack with other uses is kept whole.
+// CHECK-LABEL: func.func @blocked_matmul_shared_pack(
+// CHECK: tensor.pack {{.+}} : tensor<128x256xf32> -> tensor<4x8x32x32xf32>
+// CHECK: scf.for
+// CHECK-NOT: tensor.pack
+
+// OUTER-LABEL: func.func @blocked_matmul_shared_pack(
+// OUTER: tensor.pack {{.+}} : tensor<128x256xf32> -> tensor<4x8x32x32xf32>
+
+// NOFUSE-LABEL: func.func @blocked_matmul_shared_pack(
+// NOFUSE: tensor.pack {{.+}} : tensor<128x256xf32> -> tensor<4x8x32x32xf32>
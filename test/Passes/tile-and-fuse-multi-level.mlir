@@ -0,0 +1,86 @@
+// RUN: tpp-opt %s -split-input-file -tile-consumer-and-fuse-producers="tile-sizes=32,32 outer-tile-sizes=128,256 use-for-all=false" -cse | FileCheck %s
+// RUN: tpp-opt %s -split-input-file -tile-consumer-and-fuse-producers="tile-sizes=32,32 outer-tile-sizes=128,256" -cse | FileCheck %s --check-prefix=FORALL
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+
+// A is streamed over a resident panel of B: the outer N loop goes first.
+func.func @matmul_relu_wide(%arg0: tensor<256x128xf32>, %arg1: tensor<128x512xf32>,
+    %arg2: tensor<256x512xf32>) -> tensor<256x512xf32> {
+  %c0 = arith.constant 0.0 : f32
+  %0 = linalg.matmul ins(%arg0, %arg1 : tensor<256x128xf32>, tensor<128x512xf32>)
+    outs(%arg2 : tensor<256x512xf32>) -> tensor<256x512xf32>
+  %1 = linalg.generic {indexing_maps = [#map],
+                       iterator_types = ["parallel", "parallel"]}
+    outs(%0: tensor<256x512xf32>) {
+      ^bb0(%out: f32):
+        %2 = arith.maximumf %out, %c0 : f32
+        linalg.yield %2 : f32
+    } -> tensor<256x512xf32>
+  return %1 : tensor<256x512xf32>
+}
+
+// CHECK-LABEL: func.func @matmul_relu_wide
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : index
+// CHECK-DAG: %[[C32:.+]] = arith.constant 32 : index
+// CHECK-DAG: %[[C128:.+]] = arith.constant 128 : index
+// CHECK-DAG: %[[C256:.+]] = arith.constant 256 : index
+// CHECK-DAG: %[[C512:.+]] = arith.constant 512 : index
+// CHECK: scf.for %{{.+}} = %[[C0]] to %[[C512]] step %[[C256]]
+// CHECK-NEXT: scf.for %{{.+}} = %[[C0]] to %[[C256]] step %[[C128]]
+// CHECK-NOT: linalg.matmul
+// CHECK: scf.for %{{.+}} = %[[C0]] to %[[C128]] step %[[C32]]
+// CHECK-NEXT: scf.for %{{.+}} = %[[C0]] to %[[C256]] step %[[C32]]
+// CHECK: linalg.matmul ins(%{{.+}}, %{{.+}} : tensor<32x128xf32>, tensor<128x32xf32>){{.*}}-> tensor<32x32xf32>
+// CHECK: linalg.generic {{.+}} -> tensor<32x32xf32>
+// CHECK-NOT: linalg.matmul
+
+// Only the outer level runs in parallel.
+// FORALL-LABEL: func.func @matmul_relu_wide
+// FORALL: scf.forall
+// FORALL-NOT: scf.forall
+// FORALL: scf.for
+// FORALL-NEXT: scf.for
+// FORALL: linalg.matmul{{.*}}-> tensor<32x32xf32>
+
+// -----
+
+#map = affine_map<(d0, d1) -> (d0, d1)>
+
+// B is streamed over a resident panel of A: the outer M loop goes first.
+func.func @matmul_relu_tall(%arg0: tensor<512x128xf32>, %arg1: tensor<128x256xf32>,
+    %arg2: tensor<512x256xf32>) -> tensor<512x256xf32> {
+  %c0 = arith.constant 0.0 : f32
+  %0 = linalg.matmul ins(%arg0, %arg1 : tensor<512x128xf32>, tensor<128x256xf32>)
+    outs(%arg2 : tensor<512x256xf32>) -> tensor<512x256xf32>
+  %1 = linalg.generic {indexing_maps = [#map],
+                       iterator_types = ["parallel", "parallel"]}
+    outs(%0: tensor<512x256xf32>) {
+      ^bb0(%out: f32):
+        %2 = arith.maximumf %out, %c0 : f32
+        linalg.yield %2 : f32
+    } -> tensor<512x256xf32>
+  return %1 : tensor<512x256xf32>
+}
+
+// CHECK-LABEL: func.func @matmul_relu_tall
+// CHECK-DAG: %[[C0:.+]] = arith.constant 0 : index
+// CHECK-DAG: %[[C128:.+]] = arith.constant 128 : index
+// CHECK-DAG: %[[C512:.+]] = arith.constant 512 : index
+// CHECK: scf.for %{{.+}} = %[[C0]] to %[[C512]] step %[[C128]]
+// CHECK: linalg.matmul{{.*}}-> tensor<32x32xf32>
+// CHECK: linalg.generic {{.+}} -> tensor<32x32xf32>
+
+// -----
+
+// Outer tiles that don't divide the loops keep a single level.
+func.func @matmul_single_level(%arg0: tensor<96x128xf32>, %arg1: tensor<128x512xf32>,
+    %arg2: tensor<96x512xf32>) -> tensor<96x512xf32> {
+  %0 = linalg.matmul ins(%arg0, %arg1 : tensor<96x128xf32>, tensor<128x512xf32>)
+    outs(%arg2 : tensor<96x512xf32>) -> tensor<96x512xf32>
+  return %0 : tensor<96x512xf32>
+}
+
+// CHECK-LABEL: func.func @matmul_single_level
+// CHECK-COUNT-2: scf.for
+// CHECK-NOT: scf.for
+// CHECK: linalg.matmul{{.*}}-> tensor<32x32xf32>
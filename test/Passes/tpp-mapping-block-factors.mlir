@@ -0,0 +1,12 @@
+// RUN: tpp-opt %s -tpp-mapping="matmul-block-factors=16,16,16" | FileCheck %s
+
+func.func @matmul(%arg0: tensor<128x128xf32>, %arg1: tensor<128x128xf32>,
+                  %arg2: tensor<128x128xf32>) -> tensor<128x128xf32> {
+  %0 = linalg.matmul ins(%arg0, %arg1: tensor<128x128xf32>, tensor<128x128xf32>)
+                     outs(%arg2: tensor<128x128xf32>) -> tensor<128x128xf32>
+  return %0 : tensor<128x128xf32>
+}
+
+// CHECK-LABEL: func.func @matmul(
+// CHECK-COUNT-3: tensor.pack {{.+}} inner_tiles = [16, 16] {{.+}} -> tensor<8x8x16x16xf32>
+// CHECK: tensor.unpack {{.+}} inner_tiles = [16, 16] {{.+}} : tensor<8x8x16x16xf32> -> tensor<128x128xf32>
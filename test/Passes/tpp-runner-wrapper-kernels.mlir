@@ -0,0 +1,49 @@
+// RUN: tpp-opt %s -tpp-runner-wrapper="kernel-name=entry kernels=entry,gemm_large bench-loops=10 bench-warmup=false" | FileCheck %s
+// RUN: tpp-opt %s -tpp-runner-wrapper="kernel-name=entry kernels=entry,gemm_large bench-loops=10 bench-warmup=false output-format=json" | FileCheck %s --check-prefix=JSON
+// RUN: tpp-opt %s -tpp-runner-wrapper="kernel-name=entry kernels=entry,gemm_large bench-loops=10 bench-warmup=false dump-deltas=deltas.txt" | FileCheck %s --check-prefix=DELTAS
+
+func.func @entry(%arg0: memref<4x8xf32>, %arg1: memref<8x4xf32>,
+                 %arg2: memref<4x4xf32>) {
+  linalg.matmul ins(%arg0, %arg1 : memref<4x8xf32>, memref<8x4xf32>)
+                outs(%arg2 : memref<4x4xf32>)
+  return
+}
+
+func.func @gemm_large(%arg0: memref<16x32xf32>, %arg1: memref<32x16xf32>,
+                      %arg2: memref<16x16xf32>) {
+  linalg.matmul ins(%arg0, %arg1 : memref<16x32xf32>, memref<32x16xf32>)
+                outs(%arg2 : memref<16x16xf32>)
+  return
+}
+
+func.func @not_benchmarked(%arg0: memref<4x4xf32>) {
+  return
+}
+
+// CHECK-LABEL: func.func @_entry
+// CHECK-LABEL: func.func @gemm_large
+// CHECK-LABEL: func.func @not_benchmarked
+// CHECK-LABEL: func.func @entry()
+// CHECK: vector.print str "entry"
+// CHECK: memref.get_global @{{.+}} : memref<4x8xf32>
+// CHECK: perf.bench
+// CHECK: call @_entry(
+// CHECK: vector.print %{{.+}} : f64
+// CHECK: vector.print str "gemm_large"
+// CHECK: memref.get_global @{{.+}} : memref<16x32xf32>
+// CHECK: perf.bench
+// CHECK: call @gemm_large(
+// CHECK: vector.print %{{.+}} : f64
+// CHECK-NOT: call @not_benchmarked
+// CHECK: return
+
+// JSON-LABEL: func.func @entry()
+// JSON-NOT: vector.print
+// JSON: perf.report(%{{.+}} : f64) {key = "entry.mean"}
+// JSON: perf.report(%{{.+}} : f64) {key = "gemm_large.mean"}
+
+// DELTAS-LABEL: func.func @entry()
+// DELTAS: call @_entry(
+// DELTAS: perf.dump(%{{.+}} : memref<10xf64>) {file = "deltas.0.txt"}
+// DELTAS: call @gemm_large(
+// DELTAS: perf.dump(%{{.+}} : memref<10xf64>) {file = "deltas.1.txt"}
@@ -0,0 +1,55 @@
+// RUN: tpp-opt %s -tpp-runner-wrapper="numa=shard" -split-input-file | FileCheck %s
+
+#map = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d2, d3, d5)>
+#map1 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d1, d2, d5, d4)>
+#map2 = affine_map<(d0, d1, d2, d3, d4, d5) -> (d0, d1, d3, d4)>
+
+func.func @entry(%arg0: tensor<2x2x4x4xf32>,
+                 %arg1: tensor<2x2x4x4xf32>,
+                 %arg2: tensor<2x2x4x4xf32>) -> tensor<2x2x4x4xf32> {
+  %0 = linalg.generic {
+    indexing_maps = [#map, #map1, #map2],
+    iterator_types = ["parallel", "parallel", "reduction", "parallel", "parallel", "reduction"]}
+    ins(%arg0, %arg1 : tensor<2x2x4x4xf32>, tensor<2x2x4x4xf32>)
+    outs(%arg2 : tensor<2x2x4x4xf32>) {
+  ^bb0(%in: f32, %in_0: f32, %out: f32):
+    %1 = arith.mulf %in, %in_0 : f32
+    %2 = arith.addf %out, %1 : f32
+    linalg.yield %2 : f32
+  } -> tensor<2x2x4x4xf32>
+  return %0 : tensor<2x2x4x4xf32>
+}
+
+// The blocked weight is sharded by its blocks of output columns, the other
+// arguments are first touched.
+// CHECK-LABEL: func.func @entry
+// CHECK-NOT: shard
+// CHECK: %[[ARG0:.+]] = perf.alloc{{.*}} : memref<2x2x4x4xf32>
+// CHECK: scf.parallel
+// CHECK: memref.copy %{{.+}}, %[[ARG0]]
+// CHECK: %[[ARG1:.+]] = perf.alloc {{.*}}shard{{.*}} : memref<2x2x4x4xf32>
+// CHECK-NOT: scf.parallel
+// CHECK: memref.copy %{{.+}}, %[[ARG1]]
+// CHECK-NOT: shard
+// CHECK: %[[ARG2:.+]] = perf.alloc{{.*}} : memref<2x2x4x4xf32>
+// CHECK: scf.parallel
+// CHECK: memref.copy %{{.+}}, %[[ARG2]]
+// CHECK: call @_entry
+
+// -----
+
+func.func @entry(%arg0: tensor<8x8xf32>,
+                 %arg1: tensor<8x8xf32>,
+                 %arg2: tensor<8x8xf32>) -> tensor<8x8xf32> {
+  %0 = linalg.matmul ins(%arg0, %arg1 : tensor<8x8xf32>, tensor<8x8xf32>)
+                     outs(%arg2 : tensor<8x8xf32>) -> tensor<8x8xf32>
+  return %0 : tensor<8x8xf32>
+}
+
+// The outermost dimension of an unblocked weight is the reduction, it is
+// first touched.
+// CHECK-LABEL: func.func @entry
+// CHECK-NOT: shard
+// CHECK-COUNT-3: scf.parallel
+// CHECK-NOT: shard
+// CHECK: call @_entry
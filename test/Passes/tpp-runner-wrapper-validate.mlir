@@ -0,0 +1,76 @@
+// RUN: tpp-opt %s -tpp-runner-wrapper="validate validate-threshold=0.01" -split-input-file | FileCheck %s
+// RUN: tpp-opt %s -tpp-runner-wrapper="validate bench-loops=10" -split-input-file | FileCheck %s --check-prefix=BENCH
+
+func.func @entry(%arg0: tensor<8x8xf32>,
+                 %arg1: tensor<8x8xf32>,
+                 %arg2: tensor<8x8xf32>) -> tensor<8x8xf32> {
+  %0 = linalg.matmul ins(%arg0, %arg1 : tensor<8x8xf32>, tensor<8x8xf32>)
+                     outs(%arg2 : tensor<8x8xf32>) -> tensor<8x8xf32>
+  return %0 : tensor<8x8xf32>
+}
+
+// The reference is lowered to loops on its own, its signature is left to the
+// bufferization of the module.
+// CHECK-LABEL: func.func @_entry(
+// CHECK: linalg.matmul
+// CHECK-LABEL: func.func private @_entry_reference(
+// CHECK-SAME: tensor<8x8xf32>, %{{.+}}: tensor<8x8xf32>, %{{.+}}: tensor<8x8xf32>) -> tensor<8x8xf32>
+// CHECK-NOT: linalg.matmul
+// CHECK: bufferization.to_memref
+// CHECK: scf.for
+// CHECK: scf.for
+// CHECK: scf.for
+// CHECK: arith.mulf
+// CHECK: arith.addf
+// CHECK: %[[RES:.+]] = bufferization.to_tensor %{{.+}} restrict
+// CHECK: return %[[RES]]
+// CHECK-LABEL: func.func @entry(
+// CHECK: %[[ARG0:.+]] = bufferization.to_tensor
+// CHECK: %[[ARG1:.+]] = bufferization.to_tensor
+// CHECK: %[[ARG2:.+]] = bufferization.to_tensor
+// CHECK: %[[OUT:.+]] = call @_entry(%[[ARG0]], %[[ARG1]], %[[ARG2]])
+// CHECK: %[[REF:.+]] = call @_entry_reference(%[[ARG0]], %[[ARG1]], %[[ARG2]])
+// CHECK: %[[THRESHOLD:.+]] = arith.constant 1.000000e-02 : f32
+// CHECK: check.expect_almost_eq(%[[OUT]], %[[REF]], %[[THRESHOLD]])
+
+// The kernel is validated once, before the warmup.
+// BENCH-LABEL: func.func @entry(
+// BENCH: call @_entry(
+// BENCH: call @_entry_reference(
+// BENCH: check.expect_almost_eq
+// BENCH: scf.for
+// BENCH: call @_entry(
+// BENCH-NOT: call @_entry_reference(
+
+// -----
+
+func.func @entry(%arg0: memref<8x8xf32>, %arg1: memref<8x8xf32>,
+                 %arg2: memref<8x8xf32>) {
+  linalg.matmul ins(%arg0, %arg1 : memref<8x8xf32>, memref<8x8xf32>)
+                outs(%arg2 : memref<8x8xf32>)
+  return
+}
+
+// Memref arguments are written in place, the reference runs on copies and the
+// buffers are compared.
+// CHECK-LABEL: func.func private @_entry_reference(
+// CHECK-NOT: linalg.matmul
+// CHECK: scf.for
+// CHECK-LABEL: func.func @entry(
+// CHECK: %[[ARG0:.+]] = memref.get_global
+// CHECK: %[[ARG1:.+]] = memref.get_global
+// CHECK: %[[ARG2:.+]] = memref.get_global
+// CHECK: %[[COPY0:.+]] = memref.alloc() : memref<8x8xf32>
+// CHECK: memref.copy %[[ARG0]], %[[COPY0]]
+// CHECK: %[[COPY1:.+]] = memref.alloc() : memref<8x8xf32>
+// CHECK: memref.copy %[[ARG1]], %[[COPY1]]
+// CHECK: %[[COPY2:.+]] = memref.alloc() : memref<8x8xf32>
+// CHECK: memref.copy %[[ARG2]], %[[COPY2]]
+// CHECK: call @_entry(%[[ARG0]], %[[ARG1]], %[[ARG2]])
+// CHECK: call @_entry_reference(%[[COPY0]], %[[COPY1]], %[[COPY2]])
+// CHECK: check.expect_almost_eq(%[[ARG0]], %[[COPY0]]
+// CHECK: check.expect_almost_eq(%[[ARG1]], %[[COPY1]]
+// CHECK: check.expect_almost_eq(%[[ARG2]], %[[COPY2]]
+// CHECK: memref.dealloc %[[COPY0]]
+// CHECK: memref.dealloc %[[COPY1]]
+// CHECK: memref.dealloc %[[COPY2]]
@@ -1,5 +1,20 @@
 // RUN: tpp-opt %s -tpp-runner-wrapper -split-input-file | FileCheck %s
 // RUN: tpp-opt %s -tpp-runner-wrapper=backend=cuda -split-input-file | FileCheck %s --check-prefix=CUDA
+// RUN: tpp-opt %s -tpp-runner-wrapper="backend=cuda bench-loops=10" -split-input-file | FileCheck %s --check-prefix=CUDA-BENCH
+// RUN: tpp-opt %s -tpp-runner-wrapper="backend=cuda bench-loops=10 bench-warmup=false device-timer" -split-input-file | FileCheck %s --check-prefix=DEVICE
+// RUN: tpp-opt %s -tpp-runner-wrapper="bench-loops=10 bench-warmup=false perf-counters" -split-input-file | FileCheck %s --check-prefix=COUNTERS
+// RUN: tpp-opt %s -tpp-runner-wrapper="bench-loops=10 bench-warmup=false perf-energy" -split-input-file | FileCheck %s --check-prefix=ENERGY
+// RUN: tpp-opt %s -tpp-runner-wrapper="bench-loops=10 bench-warmup=false bench-stats dump-deltas=deltas.txt" -split-input-file | FileCheck %s --check-prefix=STATS
+// RUN: tpp-opt %s -tpp-runner-wrapper="bench-loops=10 bench-warmup=false flush-cache" -split-input-file | FileCheck %s --check-prefix=FLUSH
+// RUN: tpp-opt %s -tpp-runner-wrapper="bench-loops=10 bench-warmup=false roofline" -split-input-file | FileCheck %s --check-prefix=ROOFLINE
+// RUN: tpp-opt %s -tpp-runner-wrapper="bench-loops=10 bench-warmup=false bench-stats output-format=json" -split-input-file | FileCheck %s --check-prefix=JSON
+// RUN: tpp-opt %s -tpp-runner-wrapper="bench-loops=10 bench-warmup=false report-samples output-format=json" -split-input-file | FileCheck %s --check-prefix=SAMPLES
+// RUN: tpp-opt %s -tpp-runner-wrapper="bench-loops=10 bench-warmup=false sweep-threads=4" -split-input-file | FileCheck %s --check-prefix=SWEEP
+// RUN: rm -rf %t && mkdir -p %t && touch %t/arg0.npy %t/arg2.bin
+// RUN: tpp-opt %s -tpp-runner-wrapper="input-dir=%t" -split-input-file | FileCheck %s --check-prefix=INPUT
+// RUN: tpp-opt %s -tpp-runner-wrapper="runtime-init seed=123" -split-input-file | FileCheck %s --check-prefix=INIT
+// RUN: tpp-opt %s -tpp-runner-wrapper="numa=first-touch huge-pages=2MB" -split-input-file | FileCheck %s --check-prefix=NUMA
+// RUN: tpp-opt %s -tpp-runner-wrapper="numa=interleave runtime-init" -split-input-file | FileCheck %s --check-prefix=INTERLEAVE
 
 func.func @entry(%arg0: tensor<8x8xf16>,
                  %arg1: tensor<8x8xf16>,
@@ -28,3 +43,172 @@ func.func @entry(%arg0: tensor<8x8xf16>,
 // CUDA: gpu.memcpy
 // CUDA: bufferization.to_tensor
 // CUDA: call @_entry
+
+// The output stays on the device, each call runs in place of the previous one.
+// CUDA-BENCH-LABEL: func.func @entry
+// CUDA-BENCH: bufferization.to_tensor
+// CUDA-BENCH: bufferization.to_tensor
+// CUDA-BENCH: %[[OUT:.+]] = bufferization.to_tensor
+// CUDA-BENCH: %[[WARM:.+]]:2 = perf.bench ({{.+}}) iter_args(%[[ARG:.+]] = %[[OUT]]) -> (f64, tensor<8x8xf16>)
+// CUDA-BENCH: %[[RES:.+]] = {{.*}}call @_entry({{.+}}, %[[ARG]])
+// CUDA-BENCH: perf.yield %[[RES]]
+// CUDA-BENCH: perf.bench ({{.+}}) iter_args(%[[ARG2:.+]] = %[[WARM]]#1) -> (f64, tensor<8x8xf16>)
+// CUDA-BENCH: call @_entry({{.+}}, %[[ARG2]])
+
+// The kernel time is measured on the device over the whole benchmark loop.
+// DEVICE-LABEL: func.func @entry
+// DEVICE: %[[TIMER:.+]] = perf.start_device_timer : !perf.timer
+// DEVICE: %[[DELTA:.+]]:2 = perf.bench
+// DEVICE: call @_entry
+// DEVICE: %[[HOST:.+]] = arith.divf %[[DELTA]]#0
+// DEVICE: vector.print %[[HOST]] : f64
+// DEVICE: %[[KERNEL:.+]] = perf.stop_device_timer(%[[TIMER]] : !perf.timer) : f64
+// DEVICE: %[[ITERS:.+]] = arith.constant 1.000000e+01 : f64
+// DEVICE: %[[MEAN:.+]] = arith.divf %[[KERNEL]], %[[ITERS]] : f64
+// DEVICE: vector.print %[[MEAN]] : f64
+
+// COUNTERS-LABEL: func.func @entry
+// COUNTERS: %[[BUF:.+]] = memref.alloca() : memref<6xi64>
+// COUNTERS: %[[CNT:.+]] = perf.start_counters : !perf.counters
+// COUNTERS: perf.bench
+// COUNTERS: call @_entry
+// COUNTERS: perf.stop_counters(%[[CNT]], %[[BUF]] : !perf.counters, memref<6xi64>)
+// COUNTERS: vector.print
+// COUNTERS: %[[EVENTS:.+]] = vector.transfer_read %[[BUF]]
+// COUNTERS: vector.print %[[EVENTS]] : vector<6xi64>
+
+// The energy of the whole loop is divided by its iterations, 2 * 8^3 FLOPs
+// are spent per iteration.
+// ENERGY-LABEL: func.func @entry
+// ENERGY: %[[BUF:.+]] = memref.alloca() : memref<2xf64>
+// ENERGY: %[[ENERGY:.+]] = perf.start_energy : !perf.energy
+// ENERGY: perf.bench
+// ENERGY: call @_entry
+// ENERGY: perf.stop_energy(%[[ENERGY]], %[[BUF]] : !perf.energy, memref<2xf64>)
+// ENERGY: vector.print
+// ENERGY: %[[ITERS:.+]] = arith.constant 1.000000e+01 : f64
+// ENERGY: %[[PKG:.+]] = memref.load %[[BUF]]
+// ENERGY: arith.divf %[[PKG]], %[[ITERS]] : f64
+// ENERGY: %[[DRAM:.+]] = memref.load %[[BUF]]
+// ENERGY: arith.divf %[[DRAM]], %[[ITERS]] : f64
+// ENERGY: arith.constant 1.024000e-06 : f64
+// ENERGY: vector.print %{{.+}} : vector<3xf64>
+
+// INPUT-LABEL: func.func @entry
+// INPUT: perf.map_file "{{.*}}arg0.npy" : memref<8x8xf16>
+// INPUT: bufferization.to_tensor
+// INPUT: memref.get_global @__wrapper_0
+// INPUT: bufferization.to_tensor
+// INPUT: perf.map_file "{{.*}}arg2.bin" : memref<8x8xf16>
+// INPUT: bufferization.to_tensor
+// INPUT: call @_entry
+
+// INIT-NOT: memref.global
+// INIT-LABEL: func.func @entry
+// INIT: %[[ARG0:.+]] = memref.alloc() {alignment = 128 : i64} : memref<8x8xf16>
+// INIT: perf.init_tensor(%[[ARG0]] : memref<8x8xf16>) "normal" seed(123)
+// INIT: %[[ARG1:.+]] = memref.alloc() {alignment = 128 : i64} : memref<8x8xf16>
+// INIT: perf.init_tensor(%[[ARG1]] : memref<8x8xf16>) "normal" seed(123)
+// INIT: %[[ARG2:.+]] = memref.alloc() {alignment = 128 : i64} : memref<8x8xf16>
+// INIT: perf.init_tensor(%[[ARG2]] : memref<8x8xf16>) "normal" seed(123)
+// INIT: call @_entry
+// INIT-DAG: memref.dealloc %[[ARG0]]
+// INIT-DAG: memref.dealloc %[[ARG1]]
+// INIT-DAG: memref.dealloc %[[ARG2]]
+// INIT: return
+
+// NUMA-LABEL: func.func @entry
+// NUMA: %[[ARG0:.+]] = perf.alloc {page_size = 2097152 : i64} : memref<8x8xf16>
+// NUMA: scf.parallel
+// NUMA: %[[ROW:.+]] = memref.subview %[[ARG0]]
+// NUMA: linalg.fill ins(%{{.+}} : f16) outs(%[[ROW]]
+// NUMA: %[[INIT0:.+]] = memref.get_global @__wrapper_0
+// NUMA: memref.copy %[[INIT0]], %[[ARG0]]
+// NUMA: bufferization.to_tensor %[[ARG0]]
+// NUMA: perf.alloc {page_size = 2097152 : i64} : memref<8x8xf16>
+// NUMA: scf.parallel
+// NUMA: perf.alloc {page_size = 2097152 : i64} : memref<8x8xf16>
+// NUMA: scf.parallel
+// NUMA: call @_entry
+
+// INTERLEAVE-LABEL: func.func @entry
+// INTERLEAVE: %[[ARG0:.+]] = perf.alloc {interleave{{.*}}} : memref<8x8xf16>
+// INTERLEAVE-NOT: scf.parallel
+// INTERLEAVE: perf.init_tensor(%[[ARG0]] : memref<8x8xf16>)
+// INTERLEAVE: call @_entry
+
+// SWEEP-LABEL: func.func @entry
+// SWEEP: perf.set_num_threads(%{{.+}} : i64)
+// SWEEP: perf.bench
+// SWEEP: call @_entry
+// SWEEP: %[[BASE:.+]] = arith.divf
+// SWEEP: vector.print
+// SWEEP: perf.set_num_threads(%{{.+}} : i64)
+// SWEEP: perf.bench
+// SWEEP: call @_entry
+// SWEEP: vector.print
+// SWEEP: perf.set_num_threads(%{{.+}} : i64)
+// SWEEP: perf.bench
+// SWEEP: call @_entry
+// SWEEP: %[[MEAN:.+]] = arith.divf
+// SWEEP: arith.divf %[[BASE]], %[[MEAN]] : f64
+// SWEEP: vector.print
+// SWEEP-NOT: perf.set_num_threads
+
+// STATS-LABEL: func.func @entry
+// STATS: %[[DELTAS:.+]] = memref.alloc() : memref<10xf64>
+// STATS: scf.for %[[IV:.+]] =
+// STATS:   %[[TIMER:.+]] = perf.start_timer
+// STATS:   call @_entry
+// STATS:   %[[DELTA:.+]] = perf.stop_timer(%[[TIMER]] : !perf.timer) : f64
+// STATS:   memref.store %[[DELTA]], %[[DELTAS]][%[[IV]]]
+// STATS: }
+// STATS: %[[MEAN:.+]] = perf.mean(%[[DELTAS]] : memref<10xf64>) : f64
+// STATS: vector.print %[[MEAN]]
+// STATS: perf.min(%[[DELTAS]]
+// STATS: perf.median(%[[DELTAS]]
+// STATS: perf.percentile(%[[DELTAS]] : memref<10xf64>) {percentile = 9.000000e+01 : f64}
+// STATS: perf.percentile(%[[DELTAS]] : memref<10xf64>) {percentile = 9.900000e+01 : f64}
+// STATS: perf.max(%[[DELTAS]]
+// STATS: vector.print %{{.+}} : vector<5xf64>
+// STATS: perf.dump(%[[DELTAS]] : memref<10xf64>) {file = "deltas.txt"}
+// STATS: memref.dealloc %[[DELTAS]]
+
+// FLUSH-LABEL: func.func @entry
+// FLUSH: %[[DELTAS:.+]] = memref.alloc() : memref<10xf64>
+// FLUSH: scf.for
+// FLUSH-NEXT: perf.flush_cache
+// FLUSH-NEXT: %[[TIMER:.+]] = perf.start_timer
+// FLUSH-NEXT: call @_entry
+// FLUSH-NEXT: perf.stop_timer(%[[TIMER]] : !perf.timer) : f64
+// FLUSH: perf.mean(%[[DELTAS]] : memref<10xf64>) : f64
+
+// 2 * 8 * 8 * 8 FLOPs and 3 * 8 * 8 * 2 + 8 * 8 * 2 bytes.
+// ROOFLINE-LABEL: func.func @entry
+// ROOFLINE: %[[DELTA:.+]] = perf.bench
+// ROOFLINE: %[[MEAN:.+]] = arith.divf %[[DELTA]]
+// ROOFLINE: vector.print %[[MEAN]]
+// ROOFLINE: %[[FLOPS:.+]] = arith.constant 1.024000e-06 : f64
+// ROOFLINE: arith.divf %[[FLOPS]], %[[MEAN]]
+// ROOFLINE: %[[BYTES:.+]] = arith.constant 5.120000e-07 : f64
+// ROOFLINE: arith.divf %[[BYTES]], %[[MEAN]]
+// ROOFLINE: arith.constant 2.000000e+00 : f64
+// ROOFLINE: vector.print %{{.+}} : vector<3xf64>
+
+// JSON-LABEL: func.func @entry
+// JSON: %[[MEAN:.+]] = perf.mean
+// JSON-NOT: vector.print
+// JSON: perf.report(%[[MEAN]] : f64) {key = "mean"}
+// JSON: perf.report(%{{.+}} : f64) {key = "min"}
+// JSON: perf.report(%{{.+}} : f64) {key = "p50"}
+// JSON: perf.report(%{{.+}} : f64) {key = "p90"}
+// JSON: perf.report(%{{.+}} : f64) {key = "p99"}
+// JSON: perf.report(%{{.+}} : f64) {key = "max"}
+// JSON-NOT: vector.print
+
+// SAMPLES-LABEL: func.func @entry
+// SAMPLES: %[[DELTAS:.+]] = memref.alloc() : memref<10xf64>
+// SAMPLES: perf.report(%{{.+}} : f64) {key = "mean"}
+// SAMPLES-NOT: {key = "p50"}
+// SAMPLES: perf.report(%[[DELTAS]] : memref<10xf64>) {key = "samples"}
+// SAMPLES-NOT: vector.print
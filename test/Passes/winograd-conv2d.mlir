@@ -0,0 +1,67 @@
+// RUN: tpp-opt %s -split-input-file -winograd-conv2d | FileCheck %s
+
+func.func @conv_3x3(%arg0: tensor<1x10x10x8xf32>, %arg1: tensor<3x3x8x16xf32>,
+    %arg2: tensor<1x8x8x16xf32>) -> tensor<1x8x8x16xf32> {
+  %0 = linalg.conv_2d_nhwc_hwcf {dilations = dense<1> : tensor<2xi64>, strides = dense<1> : tensor<2xi64>}
+    ins(%arg0, %arg1 : tensor<1x10x10x8xf32>, tensor<3x3x8x16xf32>)
+    outs(%arg2 : tensor<1x8x8x16xf32>) -> tensor<1x8x8x16xf32>
+  return %0 : tensor<1x8x8x16xf32>
+}
+
+// CHECK-DAG: #[[$IMAGE:.+]] = affine_map<(d0, d1, d2, d3, d4, d5, d6, d7) -> (d2, d3 * 2 + d6, d4 * 2 + d7, d5)>
+// CHECK-LABEL: func.func @conv_3x3(
+// CHECK-SAME:  %[[ARG0:.+]]: tensor<1x10x10x8xf32>, %[[ARG1:.+]]: tensor<3x3x8x16xf32>, %[[ARG2:.+]]: tensor<1x8x8x16xf32>
+// CHECK-NOT: linalg.conv_2d_nhwc_hwcf
+// CHECK: %[[U:.+]] = linalg.generic
+// CHECK-SAME:  ins(%{{.+}}, %[[ARG1]], %{{.+}} : tensor<4x3xf32>, tensor<3x3x8x16xf32>, tensor<4x3xf32>)
+// CHECK-SAME:  outs(%{{.+}} : tensor<4x4x8x16xf32>)
+// CHECK: %[[V:.+]] = linalg.generic
+// CHECK-SAME:  #[[$IMAGE]]
+// CHECK-SAME:  ins(%{{.+}}, %[[ARG0]], %{{.+}} : tensor<4x4xf32>, tensor<1x10x10x8xf32>, tensor<4x4xf32>)
+// CHECK-SAME:  outs(%{{.+}} : tensor<4x4x1x4x4x8xf32>)
+// CHECK: %[[LHS:.+]] = tensor.collapse_shape %[[V]] {{\[}}[0, 1], [2, 3, 4], [5]]
+// CHECK-SAME:  into tensor<16x16x8xf32>
+// CHECK: %[[RHS:.+]] = tensor.collapse_shape %[[U]] {{\[}}[0, 1], [2], [3]]
+// CHECK-SAME:  into tensor<16x8x16xf32>
+// CHECK: %[[M:.+]] = linalg.batch_matmul ins(%[[LHS]], %[[RHS]] : tensor<16x16x8xf32>, tensor<16x8x16xf32>)
+// CHECK: %[[MEXP:.+]] = tensor.expand_shape %[[M]] {{\[}}[0, 1], [2, 3, 4], [5]]
+// CHECK: %[[OUT:.+]] = tensor.expand_shape %[[ARG2]] {{\[}}[0], [1, 2], [3, 4], [5]]
+// CHECK-SAME:  into tensor<1x4x2x4x2x16xf32>
+// CHECK: %[[Y:.+]] = linalg.generic
+// CHECK-SAME:  ins(%{{.+}}, %[[MEXP]], %{{.+}} : tensor<2x4xf32>, tensor<4x4x1x4x4x16xf32>, tensor<2x4xf32>)
+// CHECK-SAME:  outs(%[[OUT]] : tensor<1x4x2x4x2x16xf32>)
+// CHECK: %[[RES:.+]] = tensor.collapse_shape %[[Y]] {{\[}}[0], [1, 2], [3, 4], [5]]
+// CHECK-SAME:  into tensor<1x8x8x16xf32>
+// CHECK: return %[[RES]]
+
+// -----
+
+func.func @conv_3x3_constant_filter(%arg0: tensor<1x4x4x1xf32>,
+    %arg1: tensor<1x2x2x1xf32>) -> tensor<1x2x2x1xf32> {
+  %cst = arith.constant dense<1.0> : tensor<3x3x1x1xf32>
+  %0 = linalg.conv_2d_nhwc_hwcf {dilations = dense<1> : tensor<2xi64>, strides = dense<1> : tensor<2xi64>}
+    ins(%arg0, %cst : tensor<1x4x4x1xf32>, tensor<3x3x1x1xf32>)
+    outs(%arg1 : tensor<1x2x2x1xf32>) -> tensor<1x2x2x1xf32>
+  return %0 : tensor<1x2x2x1xf32>
+}
+
+// The filter is transformed at compile time, G * ones * G^T.
+// CHECK-LABEL: func.func @conv_3x3_constant_filter(
+// CHECK-NOT: tensor<3x3x1x1xf32>
+// CHECK: arith.constant dense<{{\[}}[{{\[}}[1.000000e+00]], {{\[}}[1.500000e+00]], {{\[}}[5.000000e-01]], {{\[}}[1.000000e+00]]],
+// CHECK: linalg.batch_matmul
+
+// -----
+
+func.func @conv_3x3_strided(%arg0: tensor<1x9x9x8xf32>, %arg1: tensor<3x3x8x16xf32>,
+    %arg2: tensor<1x4x4x16xf32>) -> tensor<1x4x4x16xf32> {
+  %0 = linalg.conv_2d_nhwc_hwcf {dilations = dense<1> : tensor<2xi64>, strides = dense<2> : tensor<2xi64>}
+    ins(%arg0, %arg1 : tensor<1x9x9x8xf32>, tensor<3x3x8x16xf32>)
+    outs(%arg2 : tensor<1x4x4x16xf32>) -> tensor<1x4x4x16xf32>
+  return %0 : tensor<1x4x4x16xf32>
+}
+
+// Strided convolutions are left as is.
+// CHECK-LABEL: func.func @conv_3x3_strided(
+// CHECK: linalg.conv_2d_nhwc_hwcf
+// CHECK-NOT: linalg.batch_matmul
@@ -306,3 +306,94 @@ func.func @forward(%arg0: memref<256x1024xf32>) -> memref<256x1024xf32> {
 // CHECK:    }
 // CHECK:    return %{{.*}} : memref<256x1024xf32>
 
+
+// -----
+
+memref.global "private" constant @__constant_4x32x32xf32 : memref<4x32x32xf32> = dense<1.000000e+00> {alignment = 128 : i64}
+memref.global "private" constant @__constant_32x1xf32 : memref<32x1xf32> = dense<1.000000e+00> {alignment = 128 : i64}
+
+// Bias add alone, without an activation.
+func.func @bcast_row_in0_on_binary_add_only(%arg0: memref<8x4x32x32xf32>, %arg1: memref<8x32x32xf32>) {
+  %c4_i64 = arith.constant 4 : i64
+  %0 = memref.get_global @__constant_4x32x32xf32 : memref<4x32x32xf32>
+  %1 = memref.get_global @__constant_32x1xf32 : memref<32x1xf32>
+  %2 = xsmm.brgemm.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024] flags = (beta_0) data_type = f32
+  %3 = xsmm.binary.dispatch add [32, 32, 1, 32, 32] flags = (bcast_row_in0) data_type = f32
+  scf.forall (%arg2) in (8) {
+    %subview = memref.subview %arg1[%arg2, 0, 0] [1, 32, 32] [1, 1, 1] : memref<8x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
+    %subview_0 = memref.subview %arg0[%arg2, 0, 0, 0] [1, 4, 32, 32] [1, 1, 1, 1] : memref<8x4x32x32xf32> to memref<4x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    xsmm.brgemm(data_type = f32, %2, %subview_0, %0, %subview, %c4_i64) : (i64, memref<4x32x32xf32, strided<[1024, 32, 1], offset: ?>>, memref<4x32x32xf32>, memref<32x32xf32, strided<[32, 1], offset: ?>>, i64) -> ()
+    xsmm.binary add(data_type = f32, %3, %1, %subview, %subview) : (i64, memref<32x1xf32>, memref<32x32xf32, strided<[32, 1], offset: ?>>, memref<32x32xf32, strided<[32, 1], offset: ?>>) -> ()
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @bcast_row_in0_on_binary_add_only(
+// CHECK: %[[BIAS:.*]] = memref.get_global @__constant_32x1xf32 : memref<32x1xf32>
+// CHECK-NOT: xsmm.brgemm.dispatch
+// CHECK-NOT: xsmm.binary.dispatch
+// CHECK: %[[DISPATCH:.*]] = xsmm.fused_brgemm.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024][add,none]  flags = (beta_0)  binary_flags = (bcast_row_in0)  unary_flags = (none) data_type = f32
+// CHECK-NOT: xsmm.brgemm(
+// CHECK-NOT: xsmm.binary add
+// CHECK: xsmm.fused_brgemm(data_type = f32, %[[DISPATCH]], %{{.*}}, %{{.*}}, %{{.*}}, %[[BIAS]], %{{.*}})
+
+// -----
+
+memref.global "private" constant @__constant_4x32x32xf32 : memref<4x32x32xf32> = dense<1.000000e+00> {alignment = 128 : i64}
+
+// Activation alone, operand D is not used by the kernel.
+func.func @gelu_only(%arg0: memref<8x4x32x32xf32>, %arg1: memref<8x32x32xf32>) {
+  %c4_i64 = arith.constant 4 : i64
+  %0 = memref.get_global @__constant_4x32x32xf32 : memref<4x32x32xf32>
+  %2 = xsmm.brgemm.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024] flags = (beta_0) data_type = f32
+  %3 = xsmm.unary.dispatch gelu [32, 32, 32, 32] flags = (none) data_type = f32
+  scf.forall (%arg2) in (8) {
+    %subview = memref.subview %arg1[%arg2, 0, 0] [1, 32, 32] [1, 1, 1] : memref<8x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
+    %subview_0 = memref.subview %arg0[%arg2, 0, 0, 0] [1, 4, 32, 32] [1, 1, 1, 1] : memref<8x4x32x32xf32> to memref<4x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    xsmm.brgemm(data_type = f32, %2, %subview_0, %0, %subview, %c4_i64) : (i64, memref<4x32x32xf32, strided<[1024, 32, 1], offset: ?>>, memref<4x32x32xf32>, memref<32x32xf32, strided<[32, 1], offset: ?>>, i64) -> ()
+    xsmm.unary gelu(data_type = f32, %3, %subview, %subview) : (i64, memref<32x32xf32, strided<[32, 1], offset: ?>>, memref<32x32xf32, strided<[32, 1], offset: ?>>) -> ()
+  }
+  return
+}
+
+// CHECK-LABEL: func.func @gelu_only(
+// CHECK-NOT: xsmm.brgemm.dispatch
+// CHECK-NOT: xsmm.unary.dispatch
+// CHECK: %[[SUBVIEW:.*]] = memref.subview %{{.*}}[%{{.*}}, 0, 0] [1, 32, 32] [1, 1, 1]
+// CHECK: %[[DISPATCH:.*]] = xsmm.fused_brgemm.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024][none,gelu]  flags = (beta_0)  binary_flags = (none)  unary_flags = (none) data_type = f32
+// CHECK-NOT: xsmm.brgemm(
+// CHECK-NOT: xsmm.unary gelu
+// CHECK: xsmm.fused_brgemm(data_type = f32, %[[DISPATCH]], %{{.*}}, %{{.*}}, %[[SUBVIEW]], %[[SUBVIEW]], %{{.*}})
+
+// -----
+
+memref.global "private" constant @__constant_4x32x32xf32 : memref<4x32x32xf32> = dense<1.000000e+00> {alignment = 128 : i64}
+memref.global "private" constant @__constant_1x1xf32 : memref<1x1xf32> = dense<1.000000e+00> {alignment = 128 : i64}
+
+// Scalar bias followed by tanh, the shared tanh dispatch is kept.
+func.func @bcast_scalar_in0_on_binary_add_tanh(%arg0: memref<8x4x32x32xf32>, %arg1: memref<8x32x32xf32>, %arg3: memref<32x32xf32>) {
+  %c4_i64 = arith.constant 4 : i64
+  %0 = memref.get_global @__constant_4x32x32xf32 : memref<4x32x32xf32>
+  %1 = memref.get_global @__constant_1x1xf32 : memref<1x1xf32>
+  %2 = xsmm.brgemm.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024] flags = (beta_0) data_type = f32
+  %3 = xsmm.binary.dispatch add [32, 32, 1, 32, 32] flags = (bcast_scalar_in0) data_type = f32
+  %4 = xsmm.unary.dispatch tanh [32, 32, 32, 32] flags = (none) data_type = f32
+  scf.forall (%arg2) in (8) {
+    %subview = memref.subview %arg1[%arg2, 0, 0] [1, 32, 32] [1, 1, 1] : memref<8x32x32xf32> to memref<32x32xf32, strided<[32, 1], offset: ?>>
+    %subview_0 = memref.subview %arg0[%arg2, 0, 0, 0] [1, 4, 32, 32] [1, 1, 1, 1] : memref<8x4x32x32xf32> to memref<4x32x32xf32, strided<[1024, 32, 1], offset: ?>>
+    xsmm.brgemm(data_type = f32, %2, %subview_0, %0, %subview, %c4_i64) : (i64, memref<4x32x32xf32, strided<[1024, 32, 1], offset: ?>>, memref<4x32x32xf32>, memref<32x32xf32, strided<[32, 1], offset: ?>>, i64) -> ()
+    xsmm.binary add(data_type = f32, %3, %1, %subview, %subview) : (i64, memref<1x1xf32>, memref<32x32xf32, strided<[32, 1], offset: ?>>, memref<32x32xf32, strided<[32, 1], offset: ?>>) -> ()
+    xsmm.unary tanh(data_type = f32, %4, %subview, %subview) : (i64, memref<32x32xf32, strided<[32, 1], offset: ?>>, memref<32x32xf32, strided<[32, 1], offset: ?>>) -> ()
+  }
+  xsmm.unary tanh(data_type = f32, %4, %arg3, %arg3) : (i64, memref<32x32xf32>, memref<32x32xf32>) -> ()
+  return
+}
+
+// CHECK-LABEL: func.func @bcast_scalar_in0_on_binary_add_tanh(
+// CHECK: %[[BIAS:.*]] = memref.get_global @__constant_1x1xf32 : memref<1x1xf32>
+// CHECK-NOT: xsmm.brgemm.dispatch
+// CHECK-NOT: xsmm.binary.dispatch
+// CHECK: %[[TANH:.*]] = xsmm.unary.dispatch tanh [32, 32, 32, 32] flags = (none) data_type = f32
+// CHECK: %[[DISPATCH:.*]] = xsmm.fused_brgemm.dispatch [32, 32, 32, 32, 32, 32, 1024, 1024][add,tanh]  flags = (beta_0)  binary_flags = (bcast_scalar_in0)  unary_flags = (none) data_type = f32
+// CHECK: xsmm.fused_brgemm(data_type = f32, %[[DISPATCH]], %{{.*}}, %{{.*}}, %{{.*}}, %[[BIAS]], %{{.*}})
+// CHECK: xsmm.unary tanh(data_type = f32, %[[TANH]], %{{.*}}, %{{.*}})
@@ -0,0 +1,189 @@
+//===- CpuKernels.h - -----------------------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Reference CPU kernels on row-major FP32 buffers: naive single-threaded
+// loops, cache-blocked OpenMP loops vectorized along the rows, and oneDNN
+// calls when built with it (BENCH_REF_DNNL).
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "llvm/ADT/StringSwitch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+
+#ifdef BENCH_REF_DNNL
+#include <dnnl.h>
+#endif
+
+enum class CpuKernelType {
+  Naive,
+  Blocked,
+  Dnnl,
+};
+
+// Returns the kernel type named `opt`, std::nullopt if unknown or not built.
+inline std::optional<CpuKernelType> parseCpuKernel(llvm::StringRef opt) {
+  auto type = llvm::StringSwitch<std::optional<CpuKernelType>>(opt)
+                  .CaseLower("naive", CpuKernelType::Naive)
+                  .CaseLower("blocked", CpuKernelType::Blocked)
+                  .CaseLower("dnnl", CpuKernelType::Dnnl)
+                  .Default(std::nullopt);
+#ifndef BENCH_REF_DNNL
+  if (type == CpuKernelType::Dnnl)
+    return std::nullopt;
+#endif
+  return type;
+}
+
+// Cache blocks of the blocked matmul: a block of C rows by columns stays in
+// L2 while the K blocks of A and B stream through it.
+constexpr int kBlockM = 64;
+constexpr int kBlockN = 256;
+constexpr int kBlockK = 256;
+
+// C(m, n) += A(m, k) * B(k, n), with leading dimensions lda, ldb and ldc.
+inline void matmulNaive(const float *A, const float *B, float *C, int m, int n,
+                        int k, int lda, int ldb, int ldc) {
+  for (int i = 0; i < m; i++)
+    for (int j = 0; j < n; j++)
+      for (int p = 0; p < k; p++)
+        C[i * ldc + j] += A[i * lda + p] * B[p * ldb + j];
+}
+
+// Blocked matmul: the threads split the blocks of C, the innermost loop runs
+// along the rows of B and C so that it vectorizes.
+inline void matmulBlocked(const float *A, const float *B, float *C, int m,
+                          int n, int k, int lda, int ldb, int ldc) {
+#pragma omp parallel for collapse(2) schedule(static)
+  for (int i0 = 0; i0 < m; i0 += kBlockM) {
+    for (int j0 = 0; j0 < n; j0 += kBlockN) {
+      int iEnd = std::min(i0 + kBlockM, m);
+      int jEnd = std::min(j0 + kBlockN, n);
+      for (int p0 = 0; p0 < k; p0 += kBlockK) {
+        int pEnd = std::min(p0 + kBlockK, k);
+        for (int i = i0; i < iEnd; i++) {
+          float *c = &C[i * ldc];
+          for (int p = p0; p < pEnd; p++) {
+            float a = A[i * lda + p];
+            const float *b = &B[p * ldb];
+#pragma omp simd
+            for (int j = j0; j < jEnd; j++)
+              c[j] += a * b[j];
+          }
+        }
+      }
+    }
+  }
+}
+
+// C(m, n) += A(m, k) * B(k, n) with the kernel `type`.
+inline void matmul(CpuKernelType type, const float *A, const float *B,
+                   float *C, int m, int n, int k) {
+  switch (type) {
+  case CpuKernelType::Naive:
+    matmulNaive(A, B, C, m, n, k, k, n, n);
+    break;
+  case CpuKernelType::Blocked:
+    matmulBlocked(A, B, C, m, n, k, k, n, n);
+    break;
+  case CpuKernelType::Dnnl:
+#ifdef BENCH_REF_DNNL
+    dnnl_sgemm('N', 'N', m, n, k, 1.0f, A, k, B, n, 1.0f, C, n);
+#endif
+    break;
+  }
+}
+
+// O(m, n) = max(O(m, n) + bias(n), 0), one thread per block of rows.
+inline void biasRelu(CpuKernelType type, const float *bias, float *O, int m,
+                     int n) {
+  if (type == CpuKernelType::Naive) {
+    for (int i = 0; i < m; i++)
+      for (int j = 0; j < n; j++)
+        O[i * n + j] = std::max(O[i * n + j] + bias[j], 0.0f);
+    return;
+  }
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < m; i++) {
+    float *o = &O[i * n];
+#pragma omp simd
+    for (int j = 0; j < n; j++)
+      o[j] = std::max(o[j] + bias[j], 0.0f);
+  }
+}
+
+// Attention of one head of `seq` query tokens over `kvLen` key and value
+// tokens (the KV cache) of `headDim` features, whose rows are `stride`
+// elements apart:
+//   O = softmax(Q * K^T / sqrt(headDim)) * V
+// `scores` holds seq x kvLen elements.
+inline void attentionHead(CpuKernelType type, const float *Q, const float *K,
+                          const float *V, float *O, float *scores, int seq,
+                          int kvLen, int headDim, int stride) {
+  float scale = 1.0f / std::sqrt(static_cast<float>(headDim));
+#ifdef BENCH_REF_DNNL
+  if (type == CpuKernelType::Dnnl) {
+    dnnl_sgemm('N', 'T', seq, kvLen, headDim, scale, Q, stride, K, stride,
+               0.0f, scores, kvLen);
+  } else
+#endif
+  {
+    for (int i = 0; i < seq; i++) {
+      for (int j = 0; j < kvLen; j++) {
+        float sum = 0.0f;
+#pragma omp simd reduction(+ : sum)
+        for (int d = 0; d < headDim; d++)
+          sum += Q[i * stride + d] * K[j * stride + d];
+        scores[i * kvLen + j] = sum * scale;
+      }
+    }
+  }
+
+  for (int i = 0; i < seq; i++) {
+    float *row = &scores[i * kvLen];
+    float rowMax = *std::max_element(row, row + kvLen);
+    float sum = 0.0f;
+    for (int j = 0; j < kvLen; j++) {
+      row[j] = std::exp(row[j] - rowMax);
+      sum += row[j];
+    }
+    float inv = 1.0f / sum;
+#pragma omp simd
+    for (int j = 0; j < kvLen; j++)
+      row[j] *= inv;
+  }
+
+  for (int i = 0; i < seq; i++)
+    std::fill(&O[i * stride], &O[i * stride] + headDim, 0.0f);
+  switch (type) {
+  case CpuKernelType::Naive:
+    matmulNaive(scores, V, O, seq, headDim, kvLen, kvLen, stride, stride);
+    break;
+  case CpuKernelType::Blocked:
+    // The heads run in parallel already.
+    for (int i = 0; i < seq; i++) {
+      for (int p = 0; p < kvLen; p++) {
+        float s = scores[i * kvLen + p];
+#pragma omp simd
+        for (int d = 0; d < headDim; d++)
+          O[i * stride + d] += s * V[p * stride + d];
+      }
+    }
+    break;
+  case CpuKernelType::Dnnl:
+#ifdef BENCH_REF_DNNL
+    dnnl_sgemm('N', 'N', seq, headDim, kvLen, 1.0f, scores, kvLen, V, stride,
+               0.0f, O, stride);
+#endif
+    break;
+  }
+}
@@ -0,0 +1,144 @@
+//===- MHARef.cpp ------------------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "Bench.h"
+#include "Config.h"
+#include "CpuKernels.h"
+#include "Tensor.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <iomanip>
+#include <iostream>
+
+namespace {
+llvm::cl::opt<std::string> kernelType{
+    "kernel", llvm::cl::desc("Kernel type (naive, blocked, dnnl)"),
+    llvm::cl::init("blocked")};
+
+llvm::cl::opt<unsigned> kvLen{
+    "kv-len",
+    llvm::cl::desc("Tokens of the KV cache the queries attend to (the "
+                   "sequence length if zero)"),
+    llvm::cl::init(0)};
+} // namespace
+
+// Multi-head attention of the projected queries, laid out as [batch, seq,
+// heads x headDim], over the keys and values of the KV cache, laid out as
+// [batch, kvLen, heads x headDim], into the output of the query layout. The
+// last argument holds the scores of each head, [batch, heads, seq, kvLen].
+struct MHAKernel : public KernelInterface<Tensor<float>> {
+  MHAKernel() : kernel(*parseCpuKernel(kernelType)) {}
+
+  void runRef(std::vector<Tensor<float>> &args) override {
+    assert(args.size() == 5 && "wrong rank for MHA");
+    auto &q = args[0];
+    auto &k = args[1];
+    auto &v = args[2];
+    auto &o = args[3];
+    auto &scores = args[4];
+    int batch = q.getDim(0);
+    int seq = q.getDim(1);
+    int stride = q.getDim(2);
+    int heads = scores.getDim(1);
+    int cacheLen = k.getDim(1);
+    int headDim = stride / heads;
+
+    auto runHead = [&](int b, int h) {
+      size_t offset = static_cast<size_t>(b) * seq * stride + h * headDim;
+      size_t cacheOffset =
+          static_cast<size_t>(b) * cacheLen * stride + h * headDim;
+      float *headScores =
+          &scores[(static_cast<size_t>(b) * heads + h) * seq * cacheLen];
+      attentionHead(kernel, &q[offset], &k[cacheOffset], &v[cacheOffset],
+                    &o[offset], headScores, seq, cacheLen, headDim, stride);
+    };
+
+    // oneDNN threads each GEMM, the other kernels split the heads.
+    if (kernel == CpuKernelType::Blocked) {
+#pragma omp parallel for collapse(2) schedule(static)
+      for (int b = 0; b < batch; b++)
+        for (int h = 0; h < heads; h++)
+          runHead(b, h);
+      return;
+    }
+    for (int b = 0; b < batch; b++)
+      for (int h = 0; h < heads; h++)
+        runHead(b, h);
+  }
+
+  CpuKernelType kernel;
+};
+
+int main(int argc, char *argv[]) {
+  // These need to be from the command line
+  unsigned batch = 0;
+  unsigned seq = 0;
+  unsigned heads = 0;
+  unsigned headDim = 0;
+
+  // Cmd-line args
+  BenchConfig config(argc, argv);
+  if (config.dims.size() == 4) {
+    batch = config.dims[0];
+    seq = config.dims[1];
+    heads = config.dims[2];
+    headDim = config.dims[3];
+  } else {
+    std::cerr << "--input argument required to be 4D (BxSxHxD), use --help "
+                 "for options\n";
+    return 1;
+  }
+  if (!parseCpuKernel(kernelType)) {
+    std::cerr << "Invalid or unavailable kernel type: " << kernelType << "\n";
+    return 1;
+  }
+  if (!heads || !headDim) {
+    std::cerr << "At least one head of one feature required\n";
+    return 1;
+  }
+  unsigned cacheLen = kvLen ? kvLen : seq;
+
+  if (config.verbose) {
+    std::cerr << "Kernel version: " << kernelType << std::endl;
+    std::cerr << "[ " << batch << ", " << seq << ", " << heads << " x "
+              << headDim << " ] over " << cacheLen << " tokens X "
+              << config.iter << std::endl;
+  }
+
+  // Two matmuls of seq x kvLen x headDim per head
+  double gflops = config.gflops ? static_cast<double>(batch) * heads * 4.0 *
+                                      seq * cacheLen * headDim / 1e9
+                                : 0.0;
+  auto bench = Benchmark<MHAKernel, Tensor<float>>(config.iter, gflops);
+  unsigned width = heads * headDim;
+  std::vector<Tensor<float>> args;
+  args.push_back(SplatTensor<float>{{batch, seq, width}, 0.1f});
+  args.push_back(SplatTensor<float>{{batch, cacheLen, width}, 0.1f});
+  args.push_back(SplatTensor<float>{{batch, cacheLen, width}, 1});
+  args.push_back(EmptyTensor<float>{{batch, seq, width}});
+  args.push_back(EmptyTensor<float>{{batch, heads, seq, cacheLen}});
+  bench.setArg(std::move(args));
+
+  // Warmup
+  bench.warmup();
+
+  // Run the reference benchmark
+  bench.run();
+
+  double mean = bench.getMean();
+  double stdev = bench.getStdev();
+  std::string unit = "ms";
+  if (gflops)
+    unit = "gflops";
+
+  std::cout << std::fixed << std::setw(9) << std::setprecision(3) << mean
+            << " +- " << std::setw(9) << stdev << " " << unit << std::endl;
+
+  return 0;
+}
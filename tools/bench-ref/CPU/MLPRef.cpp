@@ -0,0 +1,117 @@
+//===- MLPRef.cpp ------------------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "Bench.h"
+#include "Config.h"
+#include "CpuKernels.h"
+#include "Tensor.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <iomanip>
+#include <iostream>
+
+namespace {
+llvm::cl::opt<std::string> kernelType{
+    "kernel", llvm::cl::desc("Kernel type (naive, blocked, dnnl)"),
+    llvm::cl::init("blocked")};
+} // namespace
+
+// Layers of O = relu(I x W + bias), the output of a layer is the input of the
+// next one. The arguments are the input, the weight and the bias shared by
+// the layers, and the buffers of the layer outputs.
+struct MLPKernel : public KernelInterface<Tensor<float>> {
+  MLPKernel() : kernel(*parseCpuKernel(kernelType)) {}
+
+  void runRef(std::vector<Tensor<float>> &args) override {
+    assert(args.size() >= 4 && "wrong rank for MLP");
+    auto &weight = args[1];
+    auto &bias = args[2];
+    int n = weight.getDim(0);
+
+    const float *in = args[0].getData();
+    for (size_t layer = 3; layer < args.size(); layer++) {
+      auto &o = args[layer];
+      int m = o.getDim(0);
+      o.clear();
+      matmul(kernel, in, weight.getData(), o.getData(), m, n, n);
+      biasRelu(kernel, bias.getData(), o.getData(), m, n);
+      in = o.getData();
+    }
+  }
+
+  CpuKernelType kernel;
+};
+
+int main(int argc, char *argv[]) {
+  // These need to be from the command line
+  unsigned m = 0;
+  unsigned n = 0;
+  unsigned layers = 0;
+
+  // Cmd-line args
+  BenchConfig config(argc, argv);
+  if (config.dims.size() == 3) {
+    m = config.dims[0];
+    n = config.dims[1];
+    layers = config.dims[2];
+  } else {
+    std::cerr << "--input argument required to be 3D (MxNxLayers), use --help "
+                 "for options\n";
+    return 1;
+  }
+  if (!parseCpuKernel(kernelType)) {
+    std::cerr << "Invalid or unavailable kernel type: " << kernelType << "\n";
+    return 1;
+  }
+  if (!layers) {
+    std::cerr << "At least one layer required\n";
+    return 1;
+  }
+
+  // The iterations are calculated per matmul
+  int iter = std::max(config.iter / static_cast<int>(layers), 1);
+  if (config.verbose) {
+    std::cerr << "Kernel version: " << kernelType << std::endl;
+    std::cerr << layers << " x [ " << m << ", " << n << " ] = relu("
+              << "[ " << m << ", " << n << " ] * "
+              << "[ " << n << ", " << n << " ] + [ " << n << " ]) X " << iter
+              << std::endl;
+  }
+
+  double gflops =
+      config.gflops
+          ? static_cast<double>(layers) * (2.0 * m * n * n + 2.0 * m * n) / 1e9
+          : 0.0;
+  auto bench = Benchmark<MLPKernel, Tensor<float>>(iter, gflops);
+  std::vector<Tensor<float>> args;
+  args.push_back(SplatTensor<float>{{m, n}, 1});
+  // Small weights keep the activations in range across the layers
+  args.push_back(SplatTensor<float>{{n, n}, 1.0f / n});
+  args.push_back(SplatTensor<float>{{n}, 0.5f});
+  for (unsigned layer = 0; layer < layers; layer++)
+    args.push_back(EmptyTensor<float>{{m, n}});
+  bench.setArg(std::move(args));
+
+  // Warmup
+  bench.warmup();
+
+  // Run the reference benchmark
+  bench.run();
+
+  double mean = bench.getMean();
+  double stdev = bench.getStdev();
+  std::string unit = "ms";
+  if (gflops)
+    unit = "gflops";
+
+  std::cout << std::fixed << std::setw(9) << std::setprecision(3) << mean
+            << " +- " << std::setw(9) << stdev << " " << unit << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,97 @@
+//===- MatmulRef.cpp ---------------------------------------------*- C++-*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "Bench.h"
+#include "Config.h"
+#include "CpuKernels.h"
+#include "Tensor.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <iomanip>
+#include <iostream>
+
+namespace {
+llvm::cl::opt<std::string> kernelType{
+    "kernel", llvm::cl::desc("Kernel type (naive, blocked, dnnl)"),
+    llvm::cl::init("blocked")};
+} // namespace
+
+struct MatmulKernel : public KernelInterface<Tensor<float>> {
+  MatmulKernel() : kernel(*parseCpuKernel(kernelType)) {}
+
+  void runRef(std::vector<Tensor<float>> &args) override {
+    assert(args.size() == 3 && "wrong rank for matmul");
+    auto &a = args[0];
+    auto &b = args[1];
+    auto &o = args[2];
+
+    // MATMUL O += A x B
+    int m = o.getDim(0);
+    int n = o.getDim(1);
+    int k = a.getDim(1);
+    matmul(kernel, a.getData(), b.getData(), o.getData(), m, n, k);
+  }
+
+  CpuKernelType kernel;
+};
+
+int main(int argc, char *argv[]) {
+  // These need to be from the command line
+  unsigned m = 0;
+  unsigned n = 0;
+  unsigned k = 0;
+
+  // Cmd-line args
+  BenchConfig config(argc, argv);
+  if (config.dims.size() == 3) {
+    m = config.dims[0];
+    n = config.dims[1];
+    k = config.dims[2];
+  } else {
+    std::cerr << "--input argument required to be 3D, use --help for options\n";
+    return 1;
+  }
+  if (!parseCpuKernel(kernelType)) {
+    std::cerr << "Invalid or unavailable kernel type: " << kernelType << "\n";
+    return 1;
+  }
+
+  if (config.verbose) {
+    std::cerr << "Kernel version: " << kernelType << std::endl;
+    std::cerr << "[ " << m << ", " << n << " ] = "
+              << "[ " << m << ", " << k << " ] * "
+              << "[ " << k << ", " << n << " ] X " << config.iter << std::endl;
+  }
+
+  double gflops =
+      config.gflops ? static_cast<double>(2.0 * n * m * k) / 1e9 : 0.0;
+  auto bench = Benchmark<MatmulKernel, Tensor<float>>(config.iter, gflops);
+  std::vector<Tensor<float>> args;
+  args.push_back(SplatTensor<float>{{m, k}, 1});
+  args.push_back(SplatTensor<float>{{k, n}, 1});
+  args.push_back(SplatTensor<float>{{m, n}, 0});
+  bench.setArg(std::move(args));
+
+  // Warmup
+  bench.warmup();
+
+  // Run the reference benchmark
+  bench.run();
+
+  double mean = bench.getMean();
+  double stdev = bench.getStdev();
+  std::string unit = "ms";
+  if (gflops)
+    unit = "gflops";
+
+  std::cout << std::fixed << std::setw(9) << std::setprecision(3) << mean
+            << " +- " << std::setw(9) << stdev << " " << unit << std::endl;
+
+  return 0;
+}
@@ -92,6 +92,9 @@ public:
   // Get RO data
   const T *getData() const { return data; }
 
+  // Get RW data
+  T *getData() { return data; }
+
   // Get data size in bytes
   size_t getDataSize() const { return dataSize; }
 
@@ -19,8 +19,11 @@
 
 #include "MLIRGen.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MathExtras.h"
 
+#include <cmath>
 #include <optional>
+#include <random>
 
 using namespace mlir;
 
@@ -68,11 +71,25 @@ MLIRGenerator::MLIRGenerator(StringRef outputOpKindStr, StringRef kernelStr,
                              StringRef tilesStr, StringRef targetType, int seed,
                              bool enableBias, bool enableRelu,
                              bool enableSoftmax, bool keepGenericMatmul,
-                             int vnniBlockingFactor)
-    : builder(&context), loc(builder.getUnknownLoc()), batch(batch), seed(seed),
+                             int vnniBlockingFactor, bool gemv,
+                             StringRef normStr, double weightDensity,
+                             unsigned embeddingRows, unsigned embeddingBag,
+                             unsigned heads, unsigned seqLen, unsigned kvLen,
+                             unsigned kvCapacity, StringRef convLayoutStr,
+                             StringRef imageStr, unsigned convFilter,
+                             unsigned convStride, unsigned convPadding,
+                             bool depthwise, bool batchNorm,
+                             StringRef convBlockStr, bool dynamicBatch)
+    : builder(&context), loc(builder.getUnknownLoc()), batch(batch),
+      dynamicBatch(dynamicBatch), seed(seed),
       flops(0), enableBias(enableBias), enableRelu(enableRelu),
       enableSoftmax(enableSoftmax), keepGenericMatmul(keepGenericMatmul),
-      vnniFactor(vnniBlockingFactor) {
+      vnniFactor(vnniBlockingFactor), weightDensity(weightDensity),
+      embeddingRows(embeddingRows), embeddingBag(embeddingBag), heads(heads),
+      seqLen(seqLen), kvLen(kvLen),
+      kvCapacity(kvCapacity ? kvCapacity : kvLen), convFilter(convFilter),
+      convStride(convStride), convPadding(convPadding), depthwise(depthwise),
+      batchNorm(batchNorm) {
 
   // Register all necessary dialects
   context
@@ -94,10 +111,37 @@ MLIRGenerator::MLIRGenerator(StringRef outputOpKindStr, StringRef kernelStr,
   auto optKernel = llvm::StringSwitch<std::optional<KernelType>>(kernelStr)
                        .CaseLower("const", KernelType::Const)
                        .CaseLower("args", KernelType::Args)
+                       .CaseLower("transformer", KernelType::Transformer)
+                       .CaseLower("conv", KernelType::Conv)
+                       .CaseLower("mlp-train", KernelType::MlpTrain)
                        .Default(std::nullopt);
   assert(optKernel && "Invalid kernel type");
   kernelType = *optKernel;
 
+  // Parse normalization kind
+  auto optNorm = llvm::StringSwitch<std::optional<NormKind>>(normStr)
+                     .CaseLower("", NormKind::None)
+                     .CaseLower("layernorm", NormKind::LayerNorm)
+                     .CaseLower("rmsnorm", NormKind::RMSNorm)
+                     .Default(std::nullopt);
+  assert(optNorm && "Invalid normalization kind");
+  normKind = *optNorm;
+
+  // Parse convolution layout and blocks
+  auto optLayout = llvm::StringSwitch<std::optional<ConvLayout>>(convLayoutStr)
+                       .CaseLower("nhwc", ConvLayout::NHWC)
+                       .CaseLower("nchw", ConvLayout::NCHW)
+                       .Default(std::nullopt);
+  assert(optLayout && "Invalid convolution layout");
+  convLayout = *optLayout;
+  auto optBlock = llvm::StringSwitch<std::optional<ConvBlock>>(convBlockStr)
+                      .CaseLower("", ConvBlock::None)
+                      .CaseLower("basic", ConvBlock::Basic)
+                      .CaseLower("bottleneck", ConvBlock::Bottleneck)
+                      .Default(std::nullopt);
+  assert(optBlock && "Invalid convolution block");
+  convBlock = *optBlock;
+
   // Argument validation
   assert(batch != 0 && "Batch cannot be zero");
 
@@ -110,17 +154,92 @@ MLIRGenerator::MLIRGenerator(StringRef outputOpKindStr, StringRef kernelStr,
   assert((tiles.size() == 0 || tiles.size() == 3) &&
          "Must have 3 tile sizes (or none)");
 
+  // Sparse weights are pruned by blocks of constant packed weights
+  assert(weightDensity > 0.0 && weightDensity <= 1.0 &&
+         "Invalid weight density");
+  assert((weightDensity == 1.0 ||
+          (tiles.size() == 3 && kernelType == KernelType::Const)) &&
+         "Sparse weights must be constant and packed");
+
+  // Matrix-vector products of token decode, a single row in plain layout
+  if (gemv) {
+    assert(tiles.size() == 0 && "Cannot tile matrix-vector products");
+    this->batch = 1;
+  }
+
   // Pick data type
   auto elementType = llvm::StringSwitch<std::optional<Type>>(targetType)
                          .CaseLower("f32", builder.getF32Type())
                          .CaseLower("f16", builder.getF16Type())
                          .CaseLower("bf16", builder.getBF16Type())
+                         .CaseLower("i8", builder.getIntegerType(8))
                          .Default(std::nullopt);
   assert(elementType && "Unsupported data type");
   dataType = *elementType;
+  accType = dataType.isInteger(8) ? builder.getI32Type() : dataType;
+
+  // Embedding lookups produce the plain floating point input of the model
+  assert((embeddingRows == 0 ||
+          (tiles.size() == 0 && isa<FloatType>(dataType))) &&
+         "Embedding lookups need a plain floating point input");
+  assert(embeddingBag != 0 && "Bag size cannot be zero");
+
+  // Transformer blocks are plain floating point layers over all the tokens
+  if (kernelType == KernelType::Transformer) {
+    assert(layers.size() == 2 && "Transformer layers are hidden,ffn sizes");
+    assert(tiles.size() == 0 && "Cannot tile transformer blocks");
+    assert(isa<FloatType>(dataType) && "Integer transformers not supported");
+    assert(!gemv && embeddingRows == 0 &&
+           "Transformer blocks take the embedded tokens");
+    assert(heads != 0 && layers[0] % heads == 0 &&
+           "Hidden size must be a multiple of the heads");
+    assert(seqLen != 0 && "Sequence length cannot be zero");
+    assert((kvLen == 0 || kvLen >= seqLen) &&
+           "The KV cache holds the tokens of the sequence");
+    assert(this->kvCapacity >= kvLen &&
+           "The KV cache buffer holds all the cached tokens");
+    // There is always a normalization, the original one by default
+    if (normKind == NormKind::None)
+      normKind = NormKind::LayerNorm;
+  }
+
+  // Convolutions are plain floating point layers over the images
+  if (kernelType == KernelType::Conv) {
+    parseStringList(imageStr, image);
+    assert(image.size() == 2 && "Images must have a height and a width");
+    assert(tiles.size() == 0 && "Convolutions are packed by tpp-run");
+    assert(isa<FloatType>(dataType) && "Integer convolutions not supported");
+    assert(!gemv && embeddingRows == 0 && "Convolutions take images");
+    assert(convFilter != 0 && convStride != 0 && "Invalid convolution");
+    assert((!depthwise || llvm::all_equal(layers)) &&
+           "Depthwise convolutions preserve the channels");
+    // Residual blocks always normalize and rectify their convolutions
+    if (convBlock != ConvBlock::None) {
+      assert(!depthwise && "Residual blocks of depthwise convolutions");
+      this->batchNorm = true;
+      this->enableRelu = true;
+    }
+  }
 
-  // Disable VNNI packing if it is not BF16 data type
-  if (!dataType.isBF16())
+  // Training steps are plain floating point layers, the weights are packed by
+  // tpp-run for the forward and backward passes alike
+  if (kernelType == KernelType::MlpTrain) {
+    assert(tiles.size() == 0 && "Training layers are packed by tpp-run");
+    assert(isa<FloatType>(dataType) && "Integer training not supported");
+    assert(!gemv && embeddingRows == 0 && "Training layers take the input");
+    assert(normKind == NormKind::None && !enableSoftmax &&
+           "Training layers have no normalization or softmax");
+  }
+
+  // Dynamic batches are plain rows of the model input
+  assert((!dynamicBatch ||
+          ((kernelType == KernelType::Const ||
+            kernelType == KernelType::Args) &&
+           tiles.size() == 0 && !gemv && embeddingRows == 0)) &&
+         "Dynamic batches need plain layers without embedding lookups");
+
+  // Disable VNNI packing if it is not BF16 or I8 data type
+  if (!dataType.isBF16() && !dataType.isInteger(8))
     vnniFactor = 0;
   assert(((vnniFactor >= 0) && (vnniFactor % 2 == 0)) &&
          "Invalid VNNI packing factor");
@@ -145,7 +264,8 @@ MLIRGenerator::MLIRGenerator(StringRef outputOpKindStr, StringRef kernelStr,
 
 void MLIRGenerator::getKernelTypes(KernelArgs &args) {
   // Input type, also first layer's input
-  TensorType currentType = getShape({batch, layers.front()}, PACK_INPUT);
+  int64_t batchDim = dynamicBatch ? ShapedType::kDynamic : batch;
+  TensorType currentType = getShape({batchDim, layers.front()}, PACK_INPUT);
 
   // Weights and biases types (which is also relu and input to the next)
   for (unsigned i = 1, max = layers.size(); i < max; i++) {
@@ -160,11 +280,12 @@ void MLIRGenerator::getKernelTypes(KernelArgs &args) {
     arg.input.type = currentType;
     arg.weight.type = getShape({inputSize, outputSize}, PACK_WEIGHT);
     arg.bias.type = getShape({outputSize}, PACK_OUTPUT);
-    arg.output.type = getShape({batch, outputSize}, PACK_OUTPUT);
+    arg.output.type = getShape({batchDim, outputSize}, PACK_OUTPUT);
     args.push_back(arg);
 
-    // Update next input type with the output type of this layer
-    currentType = arg.output.type;
+    // Update next input type with the output type of this layer, integer
+    // outputs are truncated back to the input data type
+    currentType = cast<TensorType>(arg.output.type.clone(dataType));
   }
 }
 
@@ -183,8 +304,11 @@ Value MLIRGenerator::createLayer(LayerArgs &args) {
     chain = lowerNamedRelu(chain, args.output.value);
   }
 
-  // Last layer may output softmax
+  // Last layer may output a normalization and softmax
   if (args.index == layers.size() - 1) {
+    // There is no named normalization, both kinds get generics
+    chain = lowerNorm(chain, args.output.value);
+
     if (outputOpKind == OutputOpKind::Generic) {
       chain = lowerSoftmax(chain, args.output.value);
     } else if (outputOpKind == OutputOpKind::NamedOp) {
@@ -213,7 +337,11 @@ void MLIRGenerator::createKernel() {
   // Model type only has `input`, while Layer type has everything
   // We need to create the function type list first, to set the values from
   // the function's arguments on the kernel type `layer`.
+  // An embedding lookup takes the table instead of the input
   SmallVector<Type, 1> inputTypes{firstArg.input.type};
+  if (embeddingRows)
+    inputTypes[0] = RankedTensorType::get(
+        {embeddingRows, firstArg.input.type.getDimSize(1)}, dataType);
   if (kernelType == KernelType::Args) {
     for (auto &layer : args) {
       inputTypes.push_back(layer.weight.type);
@@ -231,6 +359,11 @@ void MLIRGenerator::createKernel() {
   //   * Model: input = arg, weights/bias = const, output = zero
   //   * Layer: input/weights/bias/output = args
   firstArg.input.value = func.getArgument(0);
+  if (dynamicBatch)
+    batchSize = builder.create<tensor::DimOp>(loc, firstArg.input.value, 0);
+  if (embeddingRows)
+    firstArg.input.value =
+        lowerEmbedding(firstArg.input.value, firstArg.input.type);
 
   // Argument position is input + N * { weight/bias } + output
   // First weight is at position 1, every two
@@ -240,7 +373,7 @@ void MLIRGenerator::createKernel() {
   for (auto &arg : args) {
     // Chain the last output into this layer
     if (!arg.input.value)
-      arg.input.value = lastOutput;
+      arg.input.value = lowerRequantize(lastOutput, arg.input.type);
 
     // Initialize weights and biases
     if (kernelType == KernelType::Args) {
@@ -251,6 +384,8 @@ void MLIRGenerator::createKernel() {
     } else { // Model
       arg.weight.value =
           createDenseTensor(builder, initType, arg.weight.type, getRand());
+      if (weightDensity < 1.0)
+        pruneWeights(arg.weight.value);
       if (enableBias)
         arg.bias.value =
             createDenseTensor(builder, initType, arg.bias.type, getRand());
@@ -265,9 +400,150 @@ void MLIRGenerator::createKernel() {
   builder.create<func::ReturnOp>(loc, lastArg.output.value);
 }
 
+void MLIRGenerator::createTransformerKernel() {
+  OpBuilder::InsertionGuard guard(builder);
+
+  // All the sequences of the batch are projected together, as rows of tokens
+  int64_t tokens = static_cast<int64_t>(batch) * seqLen;
+  int64_t hidden = layers[0];
+  int64_t ffnSize = layers[1];
+  auto type = getShape({tokens, hidden}, PACK_INPUT);
+  SmallVector<Type> inputTypes{type};
+  // With a KV cache, the keys and values of the previous tokens are inputs,
+  // in buffers that may have room for more tokens
+  if (kvLen) {
+    auto cacheTy = RankedTensorType::get(
+        {static_cast<int64_t>(batch), kvCapacity, hidden}, accType);
+    inputTypes.append(2, cacheTy);
+  }
+  auto func = createFunction(builder, module, "entry", inputTypes, {type});
+  Value input = func.getArgument(0);
+
+  // Self-attention, then a residual connection and a normalization
+  Value query = lowerProjection(input, hidden);
+  Value key = lowerProjection(input, hidden);
+  Value value = lowerProjection(input, hidden);
+  if (kvLen) {
+    key = lowerCacheUpdate(key, func.getArgument(1));
+    value = lowerCacheUpdate(value, func.getArgument(2));
+  }
+  Value chain = lowerAttention(query, key, value);
+  chain = lowerProjection(chain, hidden);
+  chain = lowerResidual(chain, input);
+  // There is no named normalization, both kinds get generics
+  Value attention = lowerNorm(chain, chain);
+
+  // Feed-forward network, then a residual connection and a normalization
+  chain = lowerProjection(attention, ffnSize);
+  chain = lowerGelu(chain);
+  chain = lowerProjection(chain, hidden);
+  chain = lowerResidual(chain, attention);
+  chain = lowerNorm(chain, chain);
+
+  builder.create<func::ReturnOp>(loc, chain);
+}
+
+void MLIRGenerator::createConvKernel() {
+  OpBuilder::InsertionGuard guard(builder);
+
+  // The output shape depends on the strides, the function type is set last
+  auto type = getConvShape(batch, layers.front(), image[0], image[1]);
+  auto func = createFunction(builder, module, "entry", {type}, {});
+  Value chain = func.getArgument(0);
+
+  // Each layer (or block) outputs its channels
+  for (int64_t channels : ArrayRef(layers).drop_front()) {
+    if (convBlock == ConvBlock::None)
+      chain = lowerConvLayer(chain, channels, convFilter, convStride,
+                             convPadding, enableRelu);
+    else
+      chain = lowerConvBlock(chain, channels);
+  }
+
+  func.setType(builder.getFunctionType({type}, {chain.getType()}));
+  builder.create<func::ReturnOp>(loc, chain);
+}
+
+void MLIRGenerator::createTrainKernel() {
+  OpBuilder::InsertionGuard guard(builder);
+
+  KernelArgs args;
+  getKernelTypes(args);
+  assert(args.size() > 0 && "Invalid model size");
+  auto &firstArg = args.front();
+  auto &lastArg = args.back();
+
+  // The input and the gradient of the model output, then the weights and
+  // biases of every layer, each followed by the buffer of its gradient
+  auto getGradType = [](TensorType type) -> Type {
+    return MemRefType::get(type.getShape(), type.getElementType());
+  };
+  SmallVector<Type> inputTypes{firstArg.input.type, lastArg.output.type};
+  for (auto &layer : args) {
+    inputTypes.push_back(layer.weight.type);
+    inputTypes.push_back(getGradType(layer.weight.type));
+    if (enableBias) {
+      inputTypes.push_back(layer.bias.type);
+      inputTypes.push_back(getGradType(layer.bias.type));
+    }
+  }
+
+  // The gradient of the model input is returned
+  auto func = createFunction(builder, module, "entry", inputTypes,
+                             {firstArg.input.type});
+
+  // Forward pass, keeping the input and activation of every layer
+  SmallVector<Value> weightGrads, biasGrads;
+  unsigned argPos = 2;
+  Value chain = func.getArgument(0);
+  for (auto &arg : args) {
+    arg.input.value = chain;
+    arg.weight.value = func.getArgument(argPos++);
+    weightGrads.push_back(func.getArgument(argPos++));
+    if (enableBias) {
+      arg.bias.value = func.getArgument(argPos++);
+      biasGrads.push_back(func.getArgument(argPos++));
+    }
+    arg.output.value = getZeroInitTensor(arg.output.type);
+    chain = createLayer(arg);
+    arg.output.value = chain;
+  }
+
+  // Backward pass, from the gradient of the model output
+  Value grad = func.getArgument(1);
+  for (int i = args.size() - 1; i >= 0; i--) {
+    auto &arg = args[i];
+    grad = lowerReluBackward(grad, arg.output.value);
+
+    Value weightOut = getZeroInitTensor(arg.weight.type);
+    builder.create<bufferization::MaterializeInDestinationOp>(
+        loc, /*result=*/Type(),
+        lowerWeightGradient(arg.input.value, grad, weightOut), weightGrads[i],
+        /*restrict=*/true, /*writable=*/true);
+    if (enableBias) {
+      Value biasOut = getZeroInitTensor(arg.bias.type);
+      builder.create<bufferization::MaterializeInDestinationOp>(
+          loc, /*result=*/Type(), lowerBiasGradient(grad, biasOut),
+          biasGrads[i], /*restrict=*/true, /*writable=*/true);
+    }
+
+    Value inputOut = getZeroInitTensor(arg.input.type);
+    grad = lowerInputGradient(grad, arg.weight.value, inputOut);
+  }
+
+  builder.create<func::ReturnOp>(loc, grad);
+}
+
 int MLIRGenerator::generate(StringRef filename) {
   // First, populate the module with all functions
-  createKernel();
+  if (kernelType == KernelType::Transformer)
+    createTransformerKernel();
+  else if (kernelType == KernelType::Conv)
+    createConvKernel();
+  else if (kernelType == KernelType::MlpTrain)
+    createTrainKernel();
+  else
+    createKernel();
 
   // Verify
   if (failed(module.verify())) {
@@ -298,7 +574,10 @@ std::string MLIRGenerator::createMetadata() {
   assert(flops && "FLOPS not computed?");
   std::string data = "";
   data += "// RUN: tpp-run %s -n 10 \\\n";
-  data += "// RUN:  -e entry -entry-point-result=void\n";
+  data += "// RUN:  -e entry -entry-point-result=void";
+  if (dynamicBatch)
+    data += " -dynamic-sizes=" + std::to_string(batch);
+  data += "\n";
   data += "\n";
   data += "// BENCH_TOTAL_FLOPS: " + std::to_string(flops);
   data += "\n";
@@ -310,23 +589,20 @@ std::string MLIRGenerator::createMetadata() {
 void MLIRGenerator::computeMatmulFlops(ShapedType inputShape,
                                        ShapedType outputShape) {
   // Matmul flops = 2 * M * N * K = 2 * prod(inputDims) * N (outShape[1])
-  int64_t mkFlops = 1;
-  for (int i = 0, max = inputShape.getRank(); i < max; i++)
-    mkFlops *= inputShape.getDimSize(i);
+  int64_t mkFlops = getNumElements(inputShape);
   int outRank = outputShape.getRank();
   assert((outRank == 2 || outRank == 4) && "Invalid outRank");
   // Tiled: N = NB * n = outShape[0] + outShape[3]
   int64_t nFlops = outputShape.getDimSize(outRank - 1);
   if (outRank > 2)
     nFlops *= outputShape.getDimSize(1);
-  flops += 2 * mkFlops * nFlops;
+  // Only the non-zero blocks of sparse weights are multiplied
+  flops += static_cast<int64_t>(2 * mkFlops * nFlops * weightDensity);
 }
 
 void MLIRGenerator::computeBiasOrReluFlops(ShapedType outputShape) {
   // Add flops = M * N = prod(outputDims)
-  int64_t addReluFlops = 1;
-  for (int i = 0, max = outputShape.getRank(); i < max; i++)
-    addReluFlops *= outputShape.getDimSize(i);
+  int64_t addReluFlops = getNumElements(outputShape);
   flops += addReluFlops;
 }
 
@@ -402,11 +678,24 @@ Value MLIRGenerator::lowerGenericMatmul(Value input, Value weight,
               getIterators(MAP_MATMUL),
               [&](OpBuilder &nestedBuilder, Location nestedLoc,
                   ValueRange blockArgs) {
-                auto arg0 = blockArgs[0];
-                auto arg1 = blockArgs[1];
-                auto arg2 = blockArgs[2];
-                auto mul = nestedBuilder.create<arith::MulFOp>(loc, arg0, arg1);
-                auto add = nestedBuilder.create<arith::AddFOp>(loc, arg2, mul);
+                Value arg0 = blockArgs[0];
+                Value arg1 = blockArgs[1];
+                Value arg2 = blockArgs[2];
+                Value add;
+                if (isa<IntegerType>(accType)) {
+                  // Sign-extend the inputs to the accumulation type
+                  arg0 = nestedBuilder.create<arith::ExtSIOp>(loc, accType,
+                                                              arg0);
+                  arg1 = nestedBuilder.create<arith::ExtSIOp>(loc, accType,
+                                                              arg1);
+                  auto mul =
+                      nestedBuilder.create<arith::MulIOp>(loc, arg0, arg1);
+                  add = nestedBuilder.create<arith::AddIOp>(loc, arg2, mul);
+                } else {
+                  auto mul =
+                      nestedBuilder.create<arith::MulFOp>(loc, arg0, arg1);
+                  add = nestedBuilder.create<arith::AddFOp>(loc, arg2, mul);
+                }
                 nestedBuilder.create<linalg::YieldOp>(loc, ValueRange{add});
               })
           .getResult(0);
@@ -430,7 +719,11 @@ Value MLIRGenerator::lowerBiasAdd(Value input, Value bias, Value output) {
                   ValueRange blockArgs) {
                 auto arg0 = blockArgs[0];
                 auto arg1 = blockArgs[1];
-                auto add = nestedBuilder.create<arith::AddFOp>(loc, arg0, arg1);
+                Value add;
+                if (isa<IntegerType>(accType))
+                  add = nestedBuilder.create<arith::AddIOp>(loc, arg0, arg1);
+                else
+                  add = nestedBuilder.create<arith::AddFOp>(loc, arg0, arg1);
                 nestedBuilder.create<linalg::YieldOp>(loc, ValueRange{add});
               })
           .getResult(0);
@@ -445,7 +738,7 @@ Value MLIRGenerator::lowerNamedBiasAdd(Value input, Value bias, Value output) {
 
   auto outTy = cast<ShapedType>(input.getType());
   auto biasTy = cast<ShapedType>(bias.getType());
-  Value emptyTensor = builder.create<tensor::EmptyOp>(loc, outTy, ValueRange{});
+  Value emptyTensor = getEmptyTensor(outTy);
   SmallVector<int64_t> addedDimensions;
   SmallVector<bool> dimsNeeded =
       getBroadcastDims(biasTy.getShape(), outTy.getShape());
@@ -473,8 +766,8 @@ Value MLIRGenerator::lowerNamedRelu(Value input, Value output) {
     return input;
 
   auto outTy = cast<ShapedType>(input.getType());
-  auto zero = getConstFloat(builder, 0.0, cast<FloatType>(dataType));
-  Value emptyTensor = builder.create<tensor::EmptyOp>(loc, outTy, ValueRange{});
+  auto zero = getAccZero();
+  Value emptyTensor = getEmptyTensor(outTy);
   auto fill =
       builder.create<linalg::FillOp>(loc, zero, emptyTensor)->getResult(0);
   Value relu =
@@ -491,19 +784,26 @@ Value MLIRGenerator::lowerRelu(Value input, Value output) {
   if (!enableRelu)
     return input;
 
-  auto zero = getConstFloat(builder, 0.0, cast<FloatType>(dataType));
+  auto zero = getAccZero();
   auto outTy = cast<ShapedType>(input.getType());
   auto map = getMap(input, MAP_PARALLEL);
+  // Plain images of convolutions are 4D too
+  SmallVector<utils::IteratorType> iterators(outTy.getRank(),
+                                             utils::IteratorType::parallel);
   auto relu =
       builder
           .create<linalg::GenericOp>(
               loc, outTy, ValueRange{}, ValueRange{input},
-              ArrayRef<AffineMap>{map}, getIterators(MAP_PARALLEL),
+              ArrayRef<AffineMap>{map}, iterators,
               [&](OpBuilder &nestedBuilder, Location nestedLoc,
                   ValueRange blockArgs) {
                 auto arg0 = blockArgs[0];
-                auto max =
-                    nestedBuilder.create<arith::MaximumFOp>(loc, arg0, zero);
+                Value max;
+                if (isa<IntegerType>(accType))
+                  max = nestedBuilder.create<arith::MaxSIOp>(loc, arg0, zero);
+                else
+                  max =
+                      nestedBuilder.create<arith::MaximumFOp>(loc, arg0, zero);
                 nestedBuilder.create<linalg::YieldOp>(loc, ValueRange{max});
               })
           .getResult(0);
@@ -516,17 +816,20 @@ Value MLIRGenerator::lowerNamedSoftmax(Value input, Value output) {
   if (!enableSoftmax)
     return input;
 
-  // TODO: Add lowering of softmax to sequence of named Ops
-  llvm_unreachable("Linalg named ops for softmax not implemented yet");
-  
+  assert(cast<ShapedType>(input.getType()).getRank() == 2 &&
+         "Packed softmax not implemented yet");
+  assert(isa<FloatType>(accType) && "Integer softmax not implemented yet");
   auto outTy = cast<ShapedType>(input.getType());
+  auto softmax = builder
+                     .create<linalg::SoftmaxOp>(loc, outTy, input, output,
+                                                /*dimension=*/1)
+                     .getResult()[0];
+
   // Softmax flops = 4 * M * N = 4 * prod(outputDims)
-  int64_t softmaxFlops = 1;
-  for (int i = 0, max = outTy.getRank(); i < max; i++)
-    softmaxFlops *= outTy.getDimSize(i);
+  int64_t softmaxFlops = getNumElements(outTy);
   flops += 4 * softmaxFlops;
 
-  return input;
+  return softmax;
 }
 
 Value MLIRGenerator::lowerSoftmax(Value input, Value output) {
@@ -535,12 +838,13 @@ Value MLIRGenerator::lowerSoftmax(Value input, Value output) {
 
   assert(cast<ShapedType>(input.getType()).getRank() == 2 &&
          "Packed softmax not implemented yet");
+  assert(isa<FloatType>(accType) && "Integer softmax not implemented yet");
   auto map1 = getMap(input, MAP_PARALLEL);
   auto map2 = getMap(input, MAP_REDUCTION);
   auto outTy = cast<ShapedType>(input.getType());
 
   // First, we calculate the element-wise exp
-  Value expTensor = builder.create<tensor::EmptyOp>(loc, outTy, ValueRange{});
+  Value expTensor = getEmptyTensor(outTy);
   auto exp = builder.create<linalg::GenericOp>(
       loc, outTy, ValueRange{input}, ValueRange{expTensor},
       ArrayRef<AffineMap>{map1, map1}, getIterators(MAP_PARALLEL),
@@ -551,10 +855,10 @@ Value MLIRGenerator::lowerSoftmax(Value input, Value output) {
       });
 
   // Second, we sum-reduce and splat
-  SmallVector<int64_t> dims{batch, 1};
+  SmallVector<int64_t> dims{outTy.getDimSize(0), 1};
   auto redTy = getShape(dims, PACK_OUTPUT);
   Value redTensor =
-      builder.create<tensor::EmptyOp>(loc, dims, outTy.getElementType());
+      getEmptyTensor(RankedTensorType::get(dims, outTy.getElementType()));
   auto zero = getConstFloat(builder, 0.0, cast<FloatType>(dataType));
   auto fill = builder.create<linalg::FillOp>(loc, zero, redTensor);
   auto redux = builder.create<linalg::GenericOp>(
@@ -567,7 +871,7 @@ Value MLIRGenerator::lowerSoftmax(Value input, Value output) {
         nestedBuilder.create<linalg::YieldOp>(loc, ValueRange{add});
       });
   // Splat back to the same dims
-  Value meanTensor = builder.create<tensor::EmptyOp>(loc, outTy, ValueRange{});
+  Value meanTensor = getEmptyTensor(outTy);
   auto mean = builder.create<linalg::GenericOp>(
       loc, outTy, ValueRange{redux.getResult(0)}, ValueRange{meanTensor},
       ArrayRef<AffineMap>{map2, map1}, getIterators(MAP_PARALLEL),
@@ -593,22 +897,761 @@ Value MLIRGenerator::lowerSoftmax(Value input, Value output) {
           .getResult(0);
 
   // Softmax flops = 4 * M * N = 4 * prod(outputDims)
-  int64_t softmaxFlops = 1;
-  for (int i = 0, max = outTy.getRank(); i < max; i++)
-    softmaxFlops *= outTy.getDimSize(i);
+  int64_t softmaxFlops = getNumElements(outTy);
   flops += 4 * softmaxFlops;
 
   return softmax;
 }
 
+Value MLIRGenerator::lowerNorm(Value input, Value output) {
+  if (normKind == NormKind::None)
+    return input;
+
+  assert(cast<ShapedType>(input.getType()).getRank() == 2 &&
+         "Packed normalization not implemented yet");
+  assert(isa<FloatType>(accType) &&
+         "Integer normalization not implemented yet");
+  auto map1 = getMap(input, MAP_PARALLEL);
+  auto map2 = getMap(input, MAP_REDUCTION);
+  auto map3 = getMap(input, MAP_BROADCAST);
+  auto outTy = cast<ShapedType>(input.getType());
+  auto floatType = cast<FloatType>(accType);
+  int64_t cols = outTy.getDimSize(1);
+  bool isLayerNorm = normKind == NormKind::LayerNorm;
+
+  // Statistics of the rows are kept as {rows, 1}, like the softmax sums
+  SmallVector<int64_t> dims{outTy.getDimSize(0), 1};
+  auto redTy = RankedTensorType::get(dims, accType);
+  auto statMap = builder.getMultiDimIdentityMap(2);
+  auto zero = getConstFloat(builder, 0.0, floatType);
+  auto count = getConstFloat(builder, cols, floatType);
+  auto eps = getConstFloat(builder, 1e-5, floatType);
+  auto getZeroStats = [&]() {
+    Value redTensor = getEmptyTensor(redTy);
+    return builder.create<linalg::FillOp>(loc, zero, redTensor).getResult(0);
+  };
+
+  // First, the mean of the rows (layer norm only)
+  Value mean;
+  if (isLayerNorm) {
+    auto sum = builder.create<linalg::GenericOp>(
+        loc, redTy, ValueRange{input}, ValueRange{getZeroStats()},
+        ArrayRef<AffineMap>{map1, map2}, getIterators(MAP_REDUCTION),
+        [&](OpBuilder &nestedBuilder, Location nestedLoc,
+            ValueRange blockArgs) {
+          auto add = nestedBuilder.create<arith::AddFOp>(loc, blockArgs[0],
+                                                         blockArgs[1]);
+          nestedBuilder.create<linalg::YieldOp>(loc, ValueRange{add});
+        });
+    Value meanTensor = getEmptyTensor(redTy);
+    mean = builder
+               .create<linalg::GenericOp>(
+                   loc, redTy, ValueRange{sum.getResult(0)},
+                   ValueRange{meanTensor},
+                   ArrayRef<AffineMap>{statMap, statMap},
+                   getIterators(MAP_PARALLEL),
+                   [&](OpBuilder &nestedBuilder, Location nestedLoc,
+                       ValueRange blockArgs) {
+                     auto div = nestedBuilder.create<arith::DivFOp>(
+                         loc, blockArgs[0], count);
+                     nestedBuilder.create<linalg::YieldOp>(loc,
+                                                           ValueRange{div});
+                   })
+               .getResult(0);
+  }
+
+  // Second, the sum of the squares of the (centered) rows
+  SmallVector<Value> redInputs{input};
+  SmallVector<AffineMap> redMaps{map1};
+  if (isLayerNorm) {
+    redInputs.push_back(mean);
+    redMaps.push_back(map2);
+  }
+  redMaps.push_back(map2);
+  auto squares = builder.create<linalg::GenericOp>(
+      loc, redTy, redInputs, ValueRange{getZeroStats()}, redMaps,
+      getIterators(MAP_REDUCTION),
+      [&](OpBuilder &nestedBuilder, Location nestedLoc, ValueRange blockArgs) {
+        Value value = blockArgs[0];
+        if (isLayerNorm)
+          value = nestedBuilder.create<arith::SubFOp>(loc, value, blockArgs[1]);
+        auto square = nestedBuilder.create<arith::MulFOp>(loc, value, value);
+        auto add =
+            nestedBuilder.create<arith::AddFOp>(loc, square, blockArgs.back());
+        nestedBuilder.create<linalg::YieldOp>(loc, ValueRange{add});
+      });
+
+  // Third, the inverse of the standard deviation (or root mean square)
+  Value rstdTensor = getEmptyTensor(redTy);
+  auto rstd = builder.create<linalg::GenericOp>(
+      loc, redTy, ValueRange{squares.getResult(0)}, ValueRange{rstdTensor},
+      ArrayRef<AffineMap>{statMap, statMap}, getIterators(MAP_PARALLEL),
+      [&](OpBuilder &nestedBuilder, Location nestedLoc, ValueRange blockArgs) {
+        auto div =
+            nestedBuilder.create<arith::DivFOp>(loc, blockArgs[0], count);
+        auto add = nestedBuilder.create<arith::AddFOp>(loc, div, eps);
+        auto rsqrt = nestedBuilder.create<math::RsqrtOp>(loc, add);
+        nestedBuilder.create<linalg::YieldOp>(loc, ValueRange{rsqrt});
+      });
+
+  // Last, normalize and scale the rows (and shift them, layer norm only)
+  auto weightTy = RankedTensorType::get({cols}, accType);
+  Value gamma = createDenseTensor(builder, initType, weightTy, getRand());
+  SmallVector<Value> inputs{input};
+  SmallVector<AffineMap> maps{map1};
+  if (isLayerNorm) {
+    inputs.push_back(mean);
+    maps.push_back(map2);
+  }
+  inputs.append({rstd.getResult(0), gamma});
+  maps.append({map2, map3});
+  if (isLayerNorm) {
+    inputs.push_back(
+        createDenseTensor(builder, initType, weightTy, getRand()));
+    maps.push_back(map3);
+  }
+  maps.push_back(map1);
+  auto norm =
+      builder
+          .create<linalg::GenericOp>(
+              loc, outTy, inputs, ValueRange{output}, maps,
+              getIterators(MAP_PARALLEL),
+              [&](OpBuilder &nestedBuilder, Location nestedLoc,
+                  ValueRange blockArgs) {
+                Value value = blockArgs[0];
+                unsigned pos = 1;
+                if (isLayerNorm)
+                  value = nestedBuilder.create<arith::SubFOp>(
+                      loc, value, blockArgs[pos++]);
+                value = nestedBuilder.create<arith::MulFOp>(loc, value,
+                                                            blockArgs[pos++]);
+                value = nestedBuilder.create<arith::MulFOp>(loc, value,
+                                                            blockArgs[pos++]);
+                if (isLayerNorm)
+                  value = nestedBuilder.create<arith::AddFOp>(
+                      loc, value, blockArgs[pos++]);
+                nestedBuilder.create<linalg::YieldOp>(loc, ValueRange{value});
+              })
+          .getResult(0);
+
+  // Layer norm flops = 8 * M * N, RMS norm flops = 4 * M * N
+  int64_t normFlops = getNumElements(outTy);
+  flops += (isLayerNorm ? 8 : 4) * normFlops;
+
+  return norm;
+}
+
+Value MLIRGenerator::lowerEmbedding(Value table, TensorType type) {
+  // The indices are part of the model, spread over the whole table
+  bool isBag = embeddingBag > 1;
+  SmallVector<int64_t> indexShape{batch};
+  if (isBag)
+    indexShape.push_back(embeddingBag);
+  auto indexType = RankedTensorType::get(indexShape, builder.getI64Type());
+  std::minstd_rand generator(seed);
+  std::uniform_int_distribution<int64_t> distribution(0, embeddingRows - 1);
+  SmallVector<int64_t> indexData(indexType.getNumElements());
+  for (auto &index : indexData)
+    index = distribution(generator);
+  Value indices = builder.create<arith::ConstantOp>(
+      loc, DenseElementsAttr::get(indexType, ArrayRef<int64_t>(indexData)));
+
+  // Bags accumulate their rows, a gather overwrites the output
+  Value output =
+      isBag ? getZeroInitTensor(type)
+            : builder.create<tensor::EmptyOp>(loc, type, ValueRange{})
+                  .getResult();
+
+  // out[b, c] (+)= table[indices[b (, l)], c]
+  unsigned numDims = isBag ? 3 : 2;
+  SmallVector<AffineExpr> indexExprs(affineExprs.begin(),
+                                     affineExprs.begin() + numDims - 1);
+  auto indexMap = AffineMap::get(numDims, 0, indexExprs, &context);
+  auto outputMap = AffineMap::get(
+      numDims, 0, {affineExprs[0], affineExprs[numDims - 1]}, &context);
+  SmallVector<utils::IteratorType> iterators(numDims,
+                                             utils::IteratorType::parallel);
+  if (isBag)
+    iterators[1] = utils::IteratorType::reduction;
+  auto lookup =
+      builder
+          .create<linalg::GenericOp>(
+              loc, type, ValueRange{indices}, ValueRange{output},
+              ArrayRef<AffineMap>{indexMap, outputMap}, iterators,
+              [&](OpBuilder &nestedBuilder, Location nestedLoc,
+                  ValueRange blockArgs) {
+                Value row = nestedBuilder.create<arith::IndexCastOp>(
+                    loc, nestedBuilder.getIndexType(), blockArgs[0]);
+                Value col =
+                    nestedBuilder.create<linalg::IndexOp>(loc, numDims - 1);
+                Value value = nestedBuilder.create<tensor::ExtractOp>(
+                    loc, table, ValueRange{row, col});
+                if (isBag)
+                  value = nestedBuilder.create<arith::AddFOp>(loc, value,
+                                                              blockArgs[1]);
+                nestedBuilder.create<linalg::YieldOp>(loc, ValueRange{value});
+              })
+          .getResult(0);
+
+  // Add flops = batch * bag * row
+  if (isBag)
+    flops += static_cast<int64_t>(batch) * embeddingBag * type.getDimSize(1);
+  return lookup;
+}
+
+Value MLIRGenerator::lowerRequantize(Value input, TensorType type) {
+  auto inTy = cast<ShapedType>(input.getType());
+  if (inTy.getElementType() == type.getElementType())
+    return input;
+
+  // Plain truncation, there is no quantization scale to apply
+  auto map = getMap(input, MAP_PARALLEL);
+  Value emptyTensor = getEmptyTensor(type);
+  return builder
+      .create<linalg::GenericOp>(
+          loc, type, ValueRange{input}, ValueRange{emptyTensor},
+          ArrayRef<AffineMap>{map, map}, getIterators(MAP_PARALLEL),
+          [&](OpBuilder &nestedBuilder, Location nestedLoc,
+              ValueRange blockArgs) {
+            auto trunc = nestedBuilder.create<arith::TruncIOp>(
+                loc, type.getElementType(), blockArgs[0]);
+            nestedBuilder.create<linalg::YieldOp>(loc, ValueRange{trunc});
+          })
+      .getResult(0);
+}
+
+Value MLIRGenerator::lowerProjection(Value input, int64_t outputSize) {
+  auto inTy = cast<ShapedType>(input.getType());
+  auto weightTy = getShape({inTy.getDimSize(1), outputSize}, PACK_WEIGHT);
+  auto outTy = getShape({inTy.getDimSize(0), outputSize}, PACK_OUTPUT);
+  Value weight = createDenseTensor(builder, initType, weightTy, getRand());
+  Value chain = lowerMatmul(input, weight, getZeroInitTensor(outTy));
+  if (!enableBias)
+    return chain;
+
+  auto biasTy = getShape({outputSize}, PACK_OUTPUT);
+  Value bias = createDenseTensor(builder, initType, biasTy, getRand());
+  if (outputOpKind == OutputOpKind::NamedOp)
+    return lowerNamedBiasAdd(chain, bias, chain);
+  return lowerBiasAdd(chain, bias, chain);
+}
+
+Value MLIRGenerator::lowerAttention(Value query, Value key, Value value) {
+  // The heads split the features of the tokens of each sequence:
+  //   {B * S, H * D} -> {B, S, H, D}
+  // The keys and values have L tokens per sequence, S without a KV cache,
+  // in which case they come from the cache as {B, L, H * D}
+  auto inTy = cast<ShapedType>(query.getType());
+  auto keyTy = cast<ShapedType>(key.getType());
+  int64_t numHeads = heads;
+  int64_t seq = seqLen;
+  int64_t headSize = inTy.getDimSize(1) / numHeads;
+  int64_t numBatch = inTy.getDimSize(0) / seq;
+  int64_t keyLen = keyTy.getRank() == 3 ? keyTy.getDimSize(1)
+                                        : keyTy.getDimSize(0) / numBatch;
+  auto headsTy =
+      RankedTensorType::get({numBatch, seq, numHeads, headSize}, accType);
+  SmallVector<ReassociationIndices> reassociation{{0, 1}, {2, 3}};
+  auto splitHeads = [&](Value tensor, int64_t tokens) -> Value {
+    auto rank = cast<ShapedType>(tensor.getType()).getRank();
+    SmallVector<ReassociationIndices> split{{0}, {1}, {2, 3}};
+    return builder.create<tensor::ExpandShapeOp>(
+        loc,
+        RankedTensorType::get({numBatch, tokens, numHeads, headSize}, accType),
+        tensor, rank == 3 ? split : reassociation);
+  };
+  Value q = splitHeads(query, seq);
+  Value k = splitHeads(key, keyLen);
+  Value v = splitHeads(value, keyLen);
+
+  // Named ops scale the queries rather than the scores, so that the scores
+  // feed a linalg.softmax as they are
+  auto floatType = cast<FloatType>(accType);
+  auto scale = getConstFloat(builder, 1.0 / std::sqrt(headSize), floatType);
+  bool namedSoftmax = outputOpKind == OutputOpKind::NamedOp;
+  if (namedSoftmax) {
+    auto qTy = cast<RankedTensorType>(q.getType());
+    auto identity = builder.getMultiDimIdentityMap(4);
+    q = builder
+            .create<linalg::GenericOp>(
+                loc, qTy, ValueRange{q},
+                ValueRange{builder.create<tensor::EmptyOp>(loc, qTy,
+                                                           ValueRange{})},
+                ArrayRef<AffineMap>{identity, identity},
+                SmallVector<utils::IteratorType>(
+                    4, utils::IteratorType::parallel),
+                [&](OpBuilder &nestedBuilder, Location nestedLoc,
+                    ValueRange blockArgs) {
+                  auto mul = nestedBuilder.create<arith::MulFOp>(
+                      loc, blockArgs[0], scale);
+                  nestedBuilder.create<linalg::YieldOp>(loc,
+                                                        ValueRange{mul});
+                })
+            .getResult(0);
+  }
+
+  // Both contractions have 5 loops, the innermost one is the reduction
+  auto getHeadMap = [&](ArrayRef<unsigned> dims) {
+    SmallVector<AffineExpr> exprs;
+    for (unsigned dim : dims)
+      exprs.push_back(affineExprs[dim]);
+    return AffineMap::get(5, 0, exprs, &context);
+  };
+  SmallVector<utils::IteratorType> contraction(4,
+                                               utils::IteratorType::parallel);
+  contraction.push_back(utils::IteratorType::reduction);
+  auto getMulAdd = [&](OpBuilder &nestedBuilder, Location nestedLoc,
+                       ValueRange blockArgs) {
+    auto mul =
+        nestedBuilder.create<arith::MulFOp>(loc, blockArgs[0], blockArgs[1]);
+    auto add = nestedBuilder.create<arith::AddFOp>(loc, blockArgs[2], mul);
+    nestedBuilder.create<linalg::YieldOp>(loc, ValueRange{add});
+  };
+
+  // First, the scores: S[b, h, i, j] = sum_d Q[b, i, h, d] * K[b, j, h, d]
+  auto scoresTy =
+      RankedTensorType::get({numBatch, numHeads, seq, keyLen}, accType);
+  auto scores = builder.create<linalg::GenericOp>(
+      loc, scoresTy, ValueRange{q, k}, ValueRange{getZeroInitTensor(scoresTy)},
+      ArrayRef<AffineMap>{getHeadMap({0, 2, 1, 4}), getHeadMap({0, 3, 1, 4}),
+                          getHeadMap({0, 1, 2, 3})},
+      contraction, getMulAdd);
+
+  // Second, the softmax of the scaled scores along the keys
+  Value probs;
+  if (namedSoftmax) {
+    probs = builder
+                .create<linalg::SoftmaxOp>(
+                    loc, scoresTy, scores.getResult(0),
+                    builder.create<tensor::EmptyOp>(loc, scoresTy,
+                                                    ValueRange{}),
+                    /*dimension=*/3)
+                .getResult()[0];
+  } else {
+    probs = lowerScaledSoftmax(scores.getResult(0), scale);
+  }
+
+  // Third, the context: C[b, i, h, d] = sum_j P[b, h, i, j] * V[b, j, h, d]
+  auto attended = builder.create<linalg::GenericOp>(
+      loc, headsTy, ValueRange{probs, v},
+      ValueRange{getZeroInitTensor(headsTy)},
+      ArrayRef<AffineMap>{getHeadMap({0, 1, 2, 4}), getHeadMap({0, 4, 1, 3}),
+                          getHeadMap({0, 2, 1, 3})},
+      contraction, getMulAdd);
+
+  // Last, concatenate the heads back: {B, S, H, D} -> {B * S, H * D}
+  Value concat = builder.create<tensor::CollapseShapeOp>(
+      loc, inTy, attended.getResult(0), reassociation);
+
+  // Attention flops = 2 * 2 * B * H * S * L * D (contractions)
+  //                 + 5 * B * H * S * L (scaled softmax)
+  int64_t scoreFlops = numBatch * numHeads * seq * keyLen;
+  flops += 4 * scoreFlops * headSize + 5 * scoreFlops;
+
+  return concat;
+}
+
+Value MLIRGenerator::lowerScaledSoftmax(Value scores, Value scale) {
+  // P = exp(S * scale) / sum_j exp(S * scale), along the last dimension
+  auto scoresTy = cast<RankedTensorType>(scores.getType());
+  auto floatType = cast<FloatType>(accType);
+  auto zero = getConstFloat(builder, 0.0, floatType);
+  auto map1 = builder.getMultiDimIdentityMap(4);
+  auto map2 = AffineMap::get(
+      4, 0,
+      {affineExprs[0], affineExprs[1], affineExprs[2],
+       getAffineConstantExpr(0, &context)},
+      &context);
+  SmallVector<utils::IteratorType> parallel(4, utils::IteratorType::parallel);
+  SmallVector<utils::IteratorType> reduction(parallel);
+  reduction.back() = utils::IteratorType::reduction;
+  Value expTensor =
+      builder.create<tensor::EmptyOp>(loc, scoresTy, ValueRange{});
+  auto exp = builder.create<linalg::GenericOp>(
+      loc, scoresTy, ValueRange{scores}, ValueRange{expTensor},
+      ArrayRef<AffineMap>{map1, map1}, parallel,
+      [&](OpBuilder &nestedBuilder, Location nestedLoc, ValueRange blockArgs) {
+        auto mul =
+            nestedBuilder.create<arith::MulFOp>(loc, blockArgs[0], scale);
+        auto exp = nestedBuilder.create<math::ExpOp>(loc, mul);
+        nestedBuilder.create<linalg::YieldOp>(loc, ValueRange{exp});
+      });
+  SmallVector<int64_t> sumShape(scoresTy.getShape());
+  sumShape.back() = 1;
+  auto sumTy = RankedTensorType::get(sumShape, accType);
+  Value sumTensor = builder.create<tensor::EmptyOp>(loc, sumTy, ValueRange{});
+  auto fill = builder.create<linalg::FillOp>(loc, zero, sumTensor);
+  auto sum = builder.create<linalg::GenericOp>(
+      loc, sumTy, ValueRange{exp.getResult(0)}, ValueRange{fill.getResult(0)},
+      ArrayRef<AffineMap>{map1, map2}, reduction,
+      [&](OpBuilder &nestedBuilder, Location nestedLoc, ValueRange blockArgs) {
+        auto add = nestedBuilder.create<arith::AddFOp>(loc, blockArgs[0],
+                                                       blockArgs[1]);
+        nestedBuilder.create<linalg::YieldOp>(loc, ValueRange{add});
+      });
+  auto probs = builder.create<linalg::GenericOp>(
+      loc, scoresTy, ValueRange{sum.getResult(0)},
+      ValueRange{exp.getResult(0)}, ArrayRef<AffineMap>{map2, map1}, parallel,
+      [&](OpBuilder &nestedBuilder, Location nestedLoc, ValueRange blockArgs) {
+        auto div = nestedBuilder.create<arith::DivFOp>(loc, blockArgs[1],
+                                                       blockArgs[0]);
+        nestedBuilder.create<linalg::YieldOp>(loc, ValueRange{div});
+      });
+  return probs.getResult(0);
+}
+
+Value MLIRGenerator::lowerCacheUpdate(Value tokens, Value cache) {
+  // The new tokens of each sequence go last: {B * S, N} -> {B, S, N}
+  auto cacheTy = cast<ShapedType>(cache.getType());
+  int64_t numBatch = cacheTy.getDimSize(0);
+  int64_t seq = seqLen;
+  int64_t features = cacheTy.getDimSize(2);
+  SmallVector<ReassociationIndices> reassociation{{0, 1}, {2}};
+  Value update = builder.create<tensor::ExpandShapeOp>(
+      loc, RankedTensorType::get({numBatch, seq, features}, accType), tokens,
+      reassociation);
+  SmallVector<OpFoldResult> offsets{builder.getIndexAttr(0),
+                                    builder.getIndexAttr(kvLen - seq),
+                                    builder.getIndexAttr(0)};
+  SmallVector<OpFoldResult> sizes{builder.getIndexAttr(numBatch),
+                                  builder.getIndexAttr(seq),
+                                  builder.getIndexAttr(features)};
+  SmallVector<OpFoldResult> strides(3, builder.getIndexAttr(1));
+  Value updated = builder.create<tensor::InsertSliceOp>(
+      loc, update, cache, offsets, sizes, strides);
+  if (kvCapacity == kvLen)
+    return updated;
+
+  // Only the first L tokens of the buffer are cached, the slice keeps the
+  // strides of the buffer, which the attention reads in place
+  sizes[1] = builder.getIndexAttr(kvLen);
+  offsets[1] = builder.getIndexAttr(0);
+  return builder.create<tensor::ExtractSliceOp>(
+      loc, RankedTensorType::get({numBatch, kvLen, features}, accType),
+      updated, offsets, sizes, strides);
+}
+
+Value MLIRGenerator::lowerGelu(Value input) {
+  // GELU(x) = 0.5 * x * (1 + tanh(sqrt(2 / pi) * (x + 0.044715 * x^3)))
+  auto outTy = cast<ShapedType>(input.getType());
+  auto floatType = cast<FloatType>(accType);
+  auto half = getConstFloat(builder, 0.5, floatType);
+  auto one = getConstFloat(builder, 1.0, floatType);
+  auto cubic = getConstFloat(builder, 0.044715, floatType);
+  auto scale =
+      getConstFloat(builder, std::sqrt(2.0 / llvm::numbers::pi), floatType);
+  auto map = getMap(input, MAP_PARALLEL);
+  auto gelu =
+      builder
+          .create<linalg::GenericOp>(
+              loc, outTy, ValueRange{}, ValueRange{input},
+              ArrayRef<AffineMap>{map}, getIterators(MAP_PARALLEL),
+              [&](OpBuilder &nestedBuilder, Location nestedLoc,
+                  ValueRange blockArgs) {
+                Value x = blockArgs[0];
+                Value cube = nestedBuilder.create<arith::MulFOp>(loc, x, x);
+                cube = nestedBuilder.create<arith::MulFOp>(loc, cube, x);
+                cube = nestedBuilder.create<arith::MulFOp>(loc, cube, cubic);
+                Value inner = nestedBuilder.create<arith::AddFOp>(loc, x, cube);
+                inner = nestedBuilder.create<arith::MulFOp>(loc, inner, scale);
+                Value value = nestedBuilder.create<math::TanhOp>(loc, inner);
+                value = nestedBuilder.create<arith::AddFOp>(loc, value, one);
+                value = nestedBuilder.create<arith::MulFOp>(loc, value, x);
+                value = nestedBuilder.create<arith::MulFOp>(loc, value, half);
+                nestedBuilder.create<linalg::YieldOp>(loc, ValueRange{value});
+              })
+          .getResult(0);
+
+  // GELU flops = 9 * M * N (counting tanh as one)
+  int64_t geluFlops = 1;
+  for (int i = 0, max = outTy.getRank(); i < max; i++)
+    geluFlops *= outTy.getDimSize(i);
+  flops += 9 * geluFlops;
+
+  return gelu;
+}
+
+Value MLIRGenerator::lowerResidual(Value input, Value residual) {
+  auto outTy = cast<ShapedType>(input.getType());
+  Value sum;
+  if (outputOpKind == OutputOpKind::NamedOp) {
+    sum = builder
+              .create<linalg::AddOp>(loc, TypeRange{outTy},
+                                     ValueRange{input, residual},
+                                     ValueRange{input})
+              .getResult(0);
+  } else {
+    auto map = getMap(input, MAP_PARALLEL);
+    SmallVector<utils::IteratorType> iterators(outTy.getRank(),
+                                               utils::IteratorType::parallel);
+    sum = builder
+              .create<linalg::GenericOp>(
+                  loc, outTy, ValueRange{residual}, ValueRange{input},
+                  ArrayRef<AffineMap>{map, map}, iterators,
+                  [&](OpBuilder &nestedBuilder, Location nestedLoc,
+                      ValueRange blockArgs) {
+                    auto add = nestedBuilder.create<arith::AddFOp>(
+                        loc, blockArgs[0], blockArgs[1]);
+                    nestedBuilder.create<linalg::YieldOp>(loc,
+                                                          ValueRange{add});
+                  })
+              .getResult(0);
+  }
+
+  computeBiasOrReluFlops(outTy);
+  return sum;
+}
+
+Value MLIRGenerator::lowerReluBackward(Value grad, Value output) {
+  if (!enableRelu)
+    return grad;
+
+  auto zero = getAccZero();
+  auto outTy = cast<ShapedType>(grad.getType());
+  auto map = getMap(grad, MAP_PARALLEL);
+  auto relu =
+      builder
+          .create<linalg::GenericOp>(
+              loc, outTy, ValueRange{output}, ValueRange{grad},
+              ArrayRef<AffineMap>{map, map}, getIterators(MAP_PARALLEL),
+              [&](OpBuilder &nestedBuilder, Location nestedLoc,
+                  ValueRange blockArgs) {
+                auto positive = nestedBuilder.create<arith::CmpFOp>(
+                    loc, arith::CmpFPredicate::OGT, blockArgs[0], zero);
+                auto select = nestedBuilder.create<arith::SelectOp>(
+                    loc, positive, blockArgs[1], zero);
+                nestedBuilder.create<linalg::YieldOp>(loc,
+                                                      ValueRange{select});
+              })
+          .getResult(0);
+
+  computeBiasOrReluFlops(outTy);
+  return relu;
+}
+
+Value MLIRGenerator::lowerWeightGradient(Value input, Value grad,
+                                         Value output) {
+  // The batch is the reduction dimension, read through the transposed input
+  auto gemm = builder
+                  .create<linalg::MatmulTransposeAOp>(
+                      loc, TypeRange{output.getType()},
+                      ValueRange{input, grad}, ValueRange{output})
+                  .getResult(0);
+
+  computeMatmulFlops(cast<ShapedType>(input.getType()),
+                     cast<ShapedType>(output.getType()));
+  return gemm;
+}
+
+Value MLIRGenerator::lowerInputGradient(Value grad, Value weight,
+                                        Value output) {
+  // The output features are the reduction dimension of the transposed weight
+  auto gemm = builder
+                  .create<linalg::MatmulTransposeBOp>(
+                      loc, TypeRange{output.getType()},
+                      ValueRange{grad, weight}, ValueRange{output})
+                  .getResult(0);
+
+  computeMatmulFlops(cast<ShapedType>(grad.getType()),
+                     cast<ShapedType>(output.getType()));
+  return gemm;
+}
+
+Value MLIRGenerator::lowerBiasGradient(Value grad, Value output) {
+  auto sum = builder
+                 .create<linalg::ReduceOp>(
+                     loc, ValueRange{grad}, ValueRange{output},
+                     ArrayRef<int64_t>{0},
+                     [&](OpBuilder &nestedBuilder, Location nestedLoc,
+                         ValueRange blockArgs) {
+                       auto add = nestedBuilder.create<arith::AddFOp>(
+                           loc, blockArgs[0], blockArgs[1]);
+                       nestedBuilder.create<linalg::YieldOp>(
+                           loc, ValueRange{add});
+                     })
+                 .getResult(0);
+
+  computeBiasOrReluFlops(cast<ShapedType>(grad.getType()));
+  return sum;
+}
+
+void MLIRGenerator::computeConvFlops(ShapedType filterShape,
+                                     ShapedType outputShape) {
+  // Conv flops = 2 * prod(outputDims) * KH * KW * C, where the filter holds
+  // KH * KW * C values for each output channel (KH * KW if depthwise)
+  int64_t outFlops = 1;
+  for (int i = 0, max = outputShape.getRank(); i < max; i++)
+    outFlops *= outputShape.getDimSize(i);
+  unsigned channelDim = convLayout == ConvLayout::NHWC ? 3 : 1;
+  int64_t macs =
+      filterShape.getNumElements() / outputShape.getDimSize(channelDim);
+  flops += 2 * outFlops * macs;
+}
+
+TensorType MLIRGenerator::getConvShape(int64_t n, int64_t c, int64_t h,
+                                       int64_t w) {
+  if (convLayout == ConvLayout::NHWC)
+    return RankedTensorType::get({n, h, w, c}, dataType);
+  return RankedTensorType::get({n, c, h, w}, dataType);
+}
+
+Value MLIRGenerator::lowerConv(Value input, int64_t channels, int64_t filter,
+                               int64_t stride, int64_t padding) {
+  bool isNhwc = convLayout == ConvLayout::NHWC;
+  unsigned channelDim = isNhwc ? 3 : 1;
+  unsigned heightDim = isNhwc ? 1 : 2;
+  auto inTy = cast<ShapedType>(input.getType());
+
+  // Zero padding of the borders of the images
+  if (padding) {
+    SmallVector<int64_t> shape(inTy.getShape());
+    shape[heightDim] += 2 * padding;
+    shape[heightDim + 1] += 2 * padding;
+    SmallVector<OpFoldResult> pads(4, builder.getIndexAttr(0));
+    pads[heightDim] = builder.getIndexAttr(padding);
+    pads[heightDim + 1] = builder.getIndexAttr(padding);
+    auto paddedTy = RankedTensorType::get(shape, dataType);
+    input = builder.create<tensor::PadOp>(loc, paddedTy, input, pads, pads,
+                                          getAccZero());
+    inTy = paddedTy;
+  }
+
+  // Output images only cover the whole filter windows
+  int64_t inChannels = inTy.getDimSize(channelDim);
+  int64_t height = (inTy.getDimSize(heightDim) - filter) / stride + 1;
+  int64_t width = (inTy.getDimSize(heightDim + 1) - filter) / stride + 1;
+  assert(height > 0 && width > 0 && "Filter larger than the images");
+  auto outTy = getConvShape(inTy.getDimSize(0), channels, height, width);
+  Value output = getZeroInitTensor(outTy);
+
+  // Filters: HWCF/FCHW, depthwise HWC/CHW
+  SmallVector<int64_t> filterDims;
+  if (depthwise)
+    filterDims = isNhwc ? SmallVector<int64_t>{filter, filter, channels}
+                        : SmallVector<int64_t>{channels, filter, filter};
+  else
+    filterDims =
+        isNhwc ? SmallVector<int64_t>{filter, filter, inChannels, channels}
+               : SmallVector<int64_t>{channels, inChannels, filter, filter};
+  auto filterTy = RankedTensorType::get(filterDims, dataType);
+  Value weights = createDenseTensor(builder, initType, filterTy, getRand());
+
+  // There are no generic convolutions, the passes match the named ops
+  auto strides = builder.getI64VectorAttr({stride, stride});
+  auto dilations = builder.getI64VectorAttr({1, 1});
+  Operation *conv;
+  if (depthwise && isNhwc)
+    conv = builder.create<linalg::DepthwiseConv2DNhwcHwcOp>(
+        loc, TypeRange{outTy}, ValueRange{input, weights}, output, strides,
+        dilations);
+  else if (depthwise)
+    conv = builder.create<linalg::DepthwiseConv2DNchwChwOp>(
+        loc, TypeRange{outTy}, ValueRange{input, weights}, output, strides,
+        dilations);
+  else if (isNhwc)
+    conv = builder.create<linalg::Conv2DNhwcHwcfOp>(
+        loc, TypeRange{outTy}, ValueRange{input, weights}, output, strides,
+        dilations);
+  else
+    conv = builder.create<linalg::Conv2DNchwFchwOp>(
+        loc, TypeRange{outTy}, ValueRange{input, weights}, output, strides,
+        dilations);
+
+  computeConvFlops(filterTy, outTy);
+  return conv->getResult(0);
+}
+
+Value MLIRGenerator::lowerBatchNorm(Value input) {
+  if (!batchNorm)
+    return input;
+
+  // Inference normalization folds the statistics into a scale and a shift
+  // of each channel: out = in * scale[c] + shift[c]
+  auto outTy = cast<ShapedType>(input.getType());
+  unsigned channelDim = convLayout == ConvLayout::NHWC ? 3 : 1;
+  auto channelTy =
+      RankedTensorType::get({outTy.getDimSize(channelDim)}, dataType);
+  Value scale = createDenseTensor(builder, initType, channelTy, getRand());
+  Value shift = createDenseTensor(builder, initType, channelTy, getRand());
+  auto map = builder.getMultiDimIdentityMap(outTy.getRank());
+  auto channelMap =
+      AffineMap::get(outTy.getRank(), 0, {affineExprs[channelDim]}, &context);
+  SmallVector<utils::IteratorType> iterators(outTy.getRank(),
+                                             utils::IteratorType::parallel);
+  auto norm =
+      builder
+          .create<linalg::GenericOp>(
+              loc, outTy, ValueRange{scale, shift}, ValueRange{input},
+              ArrayRef<AffineMap>{channelMap, channelMap, map}, iterators,
+              [&](OpBuilder &nestedBuilder, Location nestedLoc,
+                  ValueRange blockArgs) {
+                auto mul = nestedBuilder.create<arith::MulFOp>(
+                    loc, blockArgs[2], blockArgs[0]);
+                auto add =
+                    nestedBuilder.create<arith::AddFOp>(loc, mul, blockArgs[1]);
+                nestedBuilder.create<linalg::YieldOp>(loc, ValueRange{add});
+              })
+          .getResult(0);
+
+  // Batch norm flops = 2 * prod(outputDims)
+  int64_t normFlops = 1;
+  for (int i = 0, max = outTy.getRank(); i < max; i++)
+    normFlops *= outTy.getDimSize(i);
+  flops += 2 * normFlops;
+
+  return norm;
+}
+
+Value MLIRGenerator::lowerConvLayer(Value input, int64_t channels,
+                                    int64_t filter, int64_t stride,
+                                    int64_t padding, bool relu) {
+  Value chain = lowerConv(input, channels, filter, stride, padding);
+  chain = lowerBatchNorm(chain);
+  if (!relu)
+    return chain;
+  if (outputOpKind == OutputOpKind::NamedOp)
+    return lowerNamedRelu(chain, chain);
+  return lowerRelu(chain, chain);
+}
+
+Value MLIRGenerator::lowerConvBlock(Value input, int64_t channels) {
+  // Blocks changing the channels are strided and project their shortcut
+  unsigned channelDim = convLayout == ConvLayout::NHWC ? 3 : 1;
+  int64_t inChannels = cast<ShapedType>(input.getType()).getDimSize(channelDim);
+  int64_t stride = inChannels == channels ? 1 : convStride;
+  Value shortcut = input;
+  if (inChannels != channels)
+    shortcut = lowerConvLayer(input, channels, 1, stride, 0, false);
+
+  Value chain;
+  if (convBlock == ConvBlock::Basic) {
+    chain = lowerConvLayer(input, channels, 3, stride, 1, true);
+    chain = lowerConvLayer(chain, channels, 3, 1, 1, false);
+  } else {
+    // The 3x3 convolution runs on a quarter of the channels
+    int64_t width = std::max<int64_t>(1, channels / 4);
+    chain = lowerConvLayer(input, width, 1, 1, 0, true);
+    chain = lowerConvLayer(chain, width, 3, stride, 1, true);
+    chain = lowerConvLayer(chain, channels, 1, 1, 0, false);
+  }
+
+  chain = lowerResidual(chain, shortcut);
+  if (outputOpKind == OutputOpKind::NamedOp)
+    return lowerNamedRelu(chain, chain);
+  return lowerRelu(chain, chain);
+}
+
 TensorType MLIRGenerator::getShape(ArrayRef<int64_t> dims, PackingType type) {
+  // Outputs and biases hold the accumulation type
+  Type elementType = type == PACK_OUTPUT ? accType : dataType;
+
   // Already packed type, just return ND tensor
   if (dims.size() > 2)
-    return RankedTensorType::get(dims, dataType);
+    return RankedTensorType::get(dims, elementType);
 
   // Unpacked type, just return 2D tensor
   if (!tiles.size())
-    return RankedTensorType::get(dims, dataType);
+    return RankedTensorType::get(dims, elementType);
 
   // Packed types block by tile size
   assert(tiles.size() == 3 && "Invalid tile size format");
@@ -642,11 +1685,11 @@ TensorType MLIRGenerator::getShape(ArrayRef<int64_t> dims, PackingType type) {
 
     // Broadcast 1D -> 2D is Bk x bk only
     if (!y)
-      return RankedTensorType::get({x / k, k}, dataType);
+      return RankedTensorType::get({x / k, k}, elementType);
 
     // N x K -> BN x BK x bn x bk
     assert(y % k == 0 && "Invalid tile size for K dim");
-    return RankedTensorType::get({x / n, y / k, n, k}, dataType);
+    return RankedTensorType::get({x / n, y / k, n, k}, elementType);
   }
 
   llvm_unreachable("Unknown packing type");
@@ -782,6 +1825,27 @@ SmallVector<utils::IteratorType> MLIRGenerator::getIterators(MapType type) {
   return {};
 }
 
+void MLIRGenerator::pruneWeights(Value weight) {
+  // Packed weights are blocked on the two outer dimensions
+  auto constant = weight.getDefiningOp<arith::ConstantOp>();
+  auto values = cast<DenseElementsAttr>(constant.getValue());
+  auto type = cast<ShapedType>(weight.getType());
+  int64_t numBlocks = type.getDimSize(0) * type.getDimSize(1);
+  int64_t blockSize = type.getNumElements() / numBlocks;
+
+  // Keep a random subset of the blocks, at least one
+  SmallVector<int64_t> blocks(llvm::seq<int64_t>(0, numBlocks));
+  std::shuffle(blocks.begin(), blocks.end(), std::mt19937(getRand()));
+  int64_t numKept =
+      std::max<int64_t>(1, std::lround(weightDensity * numBlocks));
+
+  SmallVector<Attribute> elements(values.getValues<Attribute>());
+  Attribute zero = builder.getZeroAttr(type.getElementType());
+  for (int64_t block : ArrayRef(blocks).drop_front(numKept))
+    std::fill_n(elements.begin() + block * blockSize, blockSize, zero);
+  constant.setValueAttr(DenseElementsAttr::get(type, elements));
+}
+
 int MLIRGenerator::getRand() {
   // Not random
   if (!seed) {
@@ -793,10 +1857,28 @@ int MLIRGenerator::getRand() {
   return temp;
 }
 
+Value MLIRGenerator::getAccZero() {
+  if (isa<IntegerType>(accType))
+    return getConstInt(builder, 0, accType.getIntOrFloatBitWidth());
+  return getConstFloat(builder, 0.0, cast<FloatType>(accType));
+}
+
+Value MLIRGenerator::getEmptyTensor(TensorType type) {
+  // Dynamic dimensions are all the batch
+  SmallVector<Value> dynamicSizes(type.getNumDynamicDims(), batchSize);
+  return builder.create<tensor::EmptyOp>(loc, type, dynamicSizes);
+}
+
+int64_t MLIRGenerator::getNumElements(ShapedType type) {
+  int64_t numElements = 1;
+  for (int64_t size : type.getShape())
+    numElements *= ShapedType::isDynamic(size) ? batch : size;
+  return numElements;
+}
+
 Value MLIRGenerator::getZeroInitTensor(TensorType type) {
-  auto zero = getConstFloat(builder, 0.0, cast<FloatType>(dataType));
-  Value tensor =
-      builder.create<tensor::EmptyOp>(loc, type, ValueRange{}).getResult();
+  auto zero = getAccZero();
+  Value tensor = getEmptyTensor(type);
   tensor = builder.create<linalg::FillOp>(loc, zero, tensor).getResult(0);
   return tensor;
 }
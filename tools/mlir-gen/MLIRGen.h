@@ -45,6 +45,13 @@ class MLIRGenerator {
   /// Batch size
   unsigned batch;
 
+  /// Leave the batch dimension dynamic in the kernel types, the batch size
+  /// only sizes the flops and the run line
+  bool dynamicBatch;
+
+  /// Batch size of the kernel at runtime, when the batch is dynamic
+  Value batchSize;
+
   /// Layer sizes
   SmallVector<int64_t> layers;
 
@@ -54,6 +61,10 @@ class MLIRGenerator {
   /// Data type (element type of all tensors)
   Type dataType;
 
+  /// Accumulation type (element type of matmul outputs and biases). Same as
+  /// the data type except for i8, which accumulates in i32.
+  Type accType;
+
   /// Random seed
   int seed;
 
@@ -74,6 +85,12 @@ class MLIRGenerator {
   /// Lower softmax at the last layer
   bool enableSoftmax;
 
+  /// List of normalizations which can be lowered at the last layer
+  enum class NormKind { None, LayerNorm, RMSNorm };
+
+  /// Normalization of the last layer
+  NormKind normKind;
+
   /// List of linalg output Op kind which can be generated
   enum class OutputOpKind { Generic, NamedOp };
 
@@ -86,7 +103,14 @@ class MLIRGenerator {
   /// List of supported kernel types that can be generated
   ///  * Const: Generates weights and biases as constant (RO).
   ///  * Args: Generates weights and biaseds as arguments (RW).
-  enum class KernelType { Const, Args };
+  ///  * Transformer: Generates a transformer encoder block with constant
+  ///    weights, the layers are the hidden and feed-forward sizes.
+  ///  * Conv: Generates convolution layers (or blocks) with constant filters,
+  ///    the layers are the channels.
+  ///  * MlpTrain: Generates the forward and backward passes of the MLP layers,
+  ///    with weights and biases as arguments and their gradients written to
+  ///    argument buffers.
+  enum class KernelType { Const, Args, Transformer, Conv, MlpTrain };
 
   /// Type of kernel to be generated
   KernelType kernelType;
@@ -94,6 +118,55 @@ class MLIRGenerator {
   /// VNNI packing factor (0, 2, 4)
   int vnniFactor;
 
+  /// Fraction of non-zero blocks of the weights (1 for dense weights)
+  double weightDensity;
+
+  /// Rows of the embedding table the input is looked up in (0 for no lookup)
+  unsigned embeddingRows;
+
+  /// Lookups summed into each input row (1 for a gather)
+  unsigned embeddingBag;
+
+  /// Attention heads of the transformer block
+  unsigned heads;
+
+  /// Tokens of each sequence of the transformer block
+  unsigned seqLen;
+
+  /// Tokens of the KV cache of each sequence, self-attention if zero
+  unsigned kvLen;
+
+  /// Tokens the KV cache buffers have room for, at least kvLen
+  unsigned kvCapacity;
+
+  /// List of supported image layouts of the convolutions
+  enum class ConvLayout { NHWC, NCHW };
+
+  /// Layout of the images and filters of the convolutions
+  ConvLayout convLayout;
+
+  /// Height and width of the input images
+  SmallVector<int64_t> image;
+
+  /// Filter size, stride and zero padding of the convolution layers
+  int64_t convFilter;
+  int64_t convStride;
+  int64_t convPadding;
+
+  /// Generate depthwise convolutions (channel preserving)
+  bool depthwise;
+
+  /// Lower an inference batch normalization after every convolution
+  bool batchNorm;
+
+  /// List of residual blocks which can be generated instead of layers
+  ///  * Basic: 3x3 + 3x3 convolutions (ResNet-18/34)
+  ///  * Bottleneck: 1x1 + 3x3 + 1x1 convolutions (ResNet-50 and deeper)
+  enum class ConvBlock { None, Basic, Bottleneck };
+
+  /// Residual block of the convolution layers
+  ConvBlock convBlock;
+
   // ============================ Helpers
 
   /// Return current random seed, update next
@@ -105,15 +178,35 @@ class MLIRGenerator {
   /// Return shaped type (packed if requested)
   TensorType getShape(ArrayRef<int64_t>, PackingType);
 
+  /// Return an empty tensor, sized by the runtime batch if dynamic
+  Value getEmptyTensor(TensorType);
+
   /// Return a zero-init tensor for matmul outputs
   Value getZeroInitTensor(TensorType);
 
+  /// Return the number of elements of the type, counting the dynamic batch as
+  /// the batch size
+  int64_t getNumElements(ShapedType);
+
+  /// Zero random blocks of constant packed weights, keeping the weight density
+  void pruneWeights(Value);
+
+  /// Return a zero constant of the accumulation type
+  Value getAccZero();
+
   /// Computes required flops for matmul
   void computeMatmulFlops(ShapedType inputShape, ShapedType outputShape);
 
   /// Computes required flops for bias/relu
   void computeBiasOrReluFlops(ShapedType outputShape);
 
+  /// Computes required flops for convolutions
+  void computeConvFlops(ShapedType filterShape, ShapedType outputShape);
+
+  /// Return the image type of the convolution layout
+  /// Args: batch, channels, height, width
+  TensorType getConvShape(int64_t, int64_t, int64_t, int64_t);
+
   /// Affine expressions for maps
   SmallVector<AffineExpr, 6> affineExprs;
 
@@ -177,6 +270,81 @@ class MLIRGenerator {
   /// Creates linalg named softmax
   Value lowerNamedSoftmax(Value, Value);
 
+  /// Creates a layer or RMS normalization of the rows in the current function
+  /// Args: Input, Output (same for in-place)
+  /// Returns the chain value to be used in the next op
+  Value lowerNorm(Value, Value);
+
+  /// Creates an embedding lookup of the model input in the current function
+  /// Args: Table, input type
+  /// Returns the input of the first layer
+  Value lowerEmbedding(Value, TensorType);
+
+  /// Truncates an integer layer output back to the data type so that it can
+  /// feed the next layer. Args: Input, next layer's input type
+  Value lowerRequantize(Value, TensorType);
+
+  /// Creates a fully connected layer with constant weights and biases
+  /// Args: Input, output size
+  /// Returns the chain value to be used in the next op
+  Value lowerProjection(Value, int64_t);
+
+  /// Creates the multi-head attention of the projected tokens
+  /// Args: Query, Key, Value (of the same number of tokens per sequence)
+  /// Returns the concatenated heads, with the shape of the query
+  Value lowerAttention(Value, Value, Value);
+
+  /// Creates the softmax of the scaled scores along their last dimension
+  /// Args: Scores, Scale
+  Value lowerScaledSoftmax(Value, Value);
+
+  /// Writes the keys or values of the tokens in place at the end of the
+  /// cached tokens of the KV cache buffer
+  /// Args: Tokens, Cache
+  /// Returns the cached tokens of each sequence, {B, L, N}
+  Value lowerCacheUpdate(Value, Value);
+
+  /// Creates a GELU (tanh approximation) in the current function
+  /// Args: Input (same for in-place)
+  Value lowerGelu(Value);
+
+  /// Creates a residual connection in the current function
+  /// Args: Input (same for in-place), Residual
+  Value lowerResidual(Value, Value);
+
+  /// Creates the gradient of a ReLU, zero where the activation is not positive
+  /// Args: Gradient of the activation (same for in-place), Activation
+  Value lowerReluBackward(Value, Value);
+
+  /// Creates the gradient of the weights of a layer (input^T x gradient)
+  /// Args: Input, Gradient of the layer output, Output
+  Value lowerWeightGradient(Value, Value, Value);
+
+  /// Creates the gradient of the input of a layer (gradient x weight^T)
+  /// Args: Gradient of the layer output, Weight, Output
+  Value lowerInputGradient(Value, Value, Value);
+
+  /// Creates the gradient of the bias of a layer (sum over the batch)
+  /// Args: Gradient of the layer output, Output
+  Value lowerBiasGradient(Value, Value);
+
+  /// Creates a convolution with constant filters in the current function
+  /// Args: Input, output channels, filter size, stride, padding
+  /// Returns the chain value to be used in the next op
+  Value lowerConv(Value, int64_t, int64_t, int64_t, int64_t);
+
+  /// Creates an inference batch normalization (per channel scale and shift)
+  /// Args: Input (same for in-place)
+  Value lowerBatchNorm(Value);
+
+  /// Creates a convolution, batch normalization (if enabled) and ReLU
+  /// Args: Input, output channels, filter size, stride, padding, ReLU
+  Value lowerConvLayer(Value, int64_t, int64_t, int64_t, int64_t, bool);
+
+  /// Creates a residual block of convolutions
+  /// Args: Input, output channels
+  Value lowerConvBlock(Value, int64_t);
+
   // ============================ Main API
 
   /// Creates metadata string containing run command, flops info etc.
@@ -211,16 +379,33 @@ class MLIRGenerator {
   /// Creates a layer function, to be called by the kernel
   Value createLayer(LayerArgs &);
 
-  /// Creates a kernel (N * {GEMM + AddBias + ReLU} + Softmax)
-  /// AddBias, ReLU and Softmax are optional
+  /// Creates a kernel (N * {GEMM + AddBias + ReLU} + Norm + Softmax)
+  /// AddBias, ReLU, Norm and Softmax are optional
   void createKernel();
 
+  /// Creates a transformer encoder block:
+  ///   Attention(QKV projections) + projection + residual + norm +
+  ///   FFN(projection + GELU + projection) + residual + norm
+  void createTransformerKernel();
+
+  /// Creates a kernel of convolutions:
+  ///   N * {Conv + BatchNorm + ReLU} or N * residual blocks
+  void createConvKernel();
+
+  /// Creates a training step of the MLP layers:
+  ///   N * {GEMM + AddBias + ReLU} +
+  ///   N * {ReLU' + GEMM(weight grad) + Reduce(bias grad) + GEMM(input grad)}
+  void createTrainKernel();
+
 public:
   /// Creates a specific module. Different configurations need different modules
   /// so should create new objects to not have to share / cleanup existing MLIR
   /// modules.
   MLIRGenerator(StringRef, StringRef, unsigned, StringRef, StringRef, StringRef,
-                int, bool, bool, bool, bool, int);
+                int, bool, bool, bool, bool, int, bool, StringRef, double,
+                unsigned, unsigned, unsigned, unsigned, unsigned, unsigned,
+                StringRef, StringRef, unsigned, unsigned, unsigned, bool, bool,
+                StringRef, bool);
 
   ~MLIRGenerator() { module->destroy(); }
 
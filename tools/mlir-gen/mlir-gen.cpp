@@ -44,10 +44,10 @@ llvm::cl::opt<bool> keepGenericMatmul(
     llvm::cl::value_desc("bool"), llvm::cl::init(false));
 
 // Type of kernel to be generated
-llvm::cl::opt<std::string> kernel("kernel",
-                                  llvm::cl::desc("Kernel type to be generated"),
-                                  llvm::cl::value_desc("const,args"),
-                                  llvm::cl::init("const"));
+llvm::cl::opt<std::string>
+    kernel("kernel", llvm::cl::desc("Kernel type to be generated"),
+           llvm::cl::value_desc("const,args,transformer,conv,mlp-train"),
+           llvm::cl::init("const"));
 
 // Input layer
 llvm::cl::opt<unsigned> batch("batch", llvm::cl::desc("Mini batch size"),
@@ -68,7 +68,7 @@ llvm::cl::opt<std::string>
 // Float type
 llvm::cl::opt<std::string>
     floatType("float-type", llvm::cl::desc("Float type and its bitsize"),
-              llvm::cl::value_desc("f32|f16|bf16"), llvm::cl::init("f32"));
+              llvm::cl::value_desc("f32|f16|bf16|i8"), llvm::cl::init("f32"));
 
 // Random seed
 llvm::cl::opt<int> seed("seed", llvm::cl::desc("Random seed"),
@@ -101,6 +101,109 @@ llvm::cl::opt<int>
     vnni("vnni", llvm::cl::desc("VNNI packing factor (disabled if zero)"),
          llvm::cl::value_desc("0|2|4"), llvm::cl::init(0));
 
+// Generate matrix-vector products (batch of one, e.g. token decode)
+llvm::cl::opt<bool>
+    gemv("gemv",
+         llvm::cl::desc("Generate matrix-vector layers (batch of one)"),
+         llvm::cl::value_desc("bool"), llvm::cl::init(false));
+
+// Normalize the rows of the last layer, as in transformers
+llvm::cl::opt<std::string>
+    norm("norm", llvm::cl::desc("Normalization of the last layer"),
+         llvm::cl::value_desc("layernorm|rmsnorm"), llvm::cl::init(""));
+
+// Prune the weights to a fraction of non-zero blocks, as in sparse models
+llvm::cl::opt<double> weightDensity(
+    "weight-density",
+    llvm::cl::desc("Fraction of non-zero blocks of the packed weights"),
+    llvm::cl::value_desc("0.0-1.0"), llvm::cl::init(1.0));
+
+// Look up the input rows in an embedding table, as in recommendation models
+llvm::cl::opt<unsigned> embeddingRows(
+    "embedding-rows",
+    llvm::cl::desc("Rows of the embedding table of the input (disabled if "
+                   "zero)"),
+    llvm::cl::value_desc("0"), llvm::cl::init(0));
+
+// Number of rows summed into each input row, plain gather if one
+llvm::cl::opt<unsigned>
+    embeddingBag("embedding-bag",
+                 llvm::cl::desc("Lookups per bag of the embedding table"),
+                 llvm::cl::value_desc("1"), llvm::cl::init(1));
+
+// Attention heads of the transformer block
+llvm::cl::opt<unsigned>
+    heads("heads", llvm::cl::desc("Attention heads of the transformer block"),
+          llvm::cl::value_desc("8"), llvm::cl::init(8));
+
+// Sequence length of the transformer block, the batch is of sequences
+llvm::cl::opt<unsigned>
+    seqLen("seq-len",
+           llvm::cl::desc("Tokens per sequence of the transformer block"),
+           llvm::cl::value_desc("128"), llvm::cl::init(128));
+
+// KV cache of the transformer block, the new tokens are written at its end
+llvm::cl::opt<unsigned>
+    kvLen("kv-len",
+          llvm::cl::desc("Tokens per sequence of the KV cache of the "
+                         "transformer block (self-attention if zero)"),
+          llvm::cl::value_desc("0"), llvm::cl::init(0));
+
+// KV cache buffers with room for more tokens, e.g., to decode at growing cache
+// lengths in the same buffers
+llvm::cl::opt<unsigned>
+    kvCapacity("kv-capacity",
+               llvm::cl::desc("Tokens per sequence the KV cache buffers have "
+                              "room for (kv-len if zero)"),
+               llvm::cl::value_desc("0"), llvm::cl::init(0));
+
+// Image layout of the convolutions
+llvm::cl::opt<std::string> convLayout(
+    "conv-layout", llvm::cl::desc("Image layout of the convolutions"),
+    llvm::cl::value_desc("nhwc|nchw"), llvm::cl::init("nhwc"));
+
+// Input images of the convolutions
+llvm::cl::opt<std::string>
+    image("image", llvm::cl::desc("Height and width of the input images"),
+          llvm::cl::value_desc("56,56"), llvm::cl::init("56,56"));
+
+// Convolution filters, square
+llvm::cl::opt<unsigned>
+    convFilter("conv-filter", llvm::cl::desc("Filter size of the convolutions"),
+               llvm::cl::value_desc("3"), llvm::cl::init(3));
+
+llvm::cl::opt<unsigned>
+    convStride("conv-stride", llvm::cl::desc("Stride of the convolutions"),
+               llvm::cl::value_desc("1"), llvm::cl::init(1));
+
+llvm::cl::opt<unsigned> convPadding(
+    "conv-padding", llvm::cl::desc("Zero padding of the convolution images"),
+    llvm::cl::value_desc("0"), llvm::cl::init(0));
+
+// Depthwise convolutions, as in mobile networks
+llvm::cl::opt<bool>
+    depthwise("depthwise", llvm::cl::desc("Generate depthwise convolutions"),
+              llvm::cl::value_desc("bool"), llvm::cl::init(false));
+
+// Batch normalization after every convolution
+llvm::cl::opt<bool> batchNorm(
+    "batch-norm",
+    llvm::cl::desc("Enable batch normalization after every convolution"),
+    llvm::cl::value_desc("bool"), llvm::cl::init(false));
+
+// Residual blocks of convolutions, as in ResNets
+llvm::cl::opt<std::string> convBlock(
+    "conv-block",
+    llvm::cl::desc("Residual blocks of convolutions instead of layers"),
+    llvm::cl::value_desc("basic|bottleneck"), llvm::cl::init(""));
+
+// Dynamic batch size in the kernel types, as in online serving
+llvm::cl::opt<bool> dynamicBatch(
+    "dynamic-batch",
+    llvm::cl::desc("Leave the batch dimension dynamic (tpp-run sets it with "
+                   "-dynamic-sizes)"),
+    llvm::cl::value_desc("bool"), llvm::cl::init(false));
+
 int main(int argc, char **argv) {
   // Add the following to include *all* MLIR Core dialects, or selectively
   // include what you need like above. You only need to register dialects that
@@ -112,6 +215,9 @@ int main(int argc, char **argv) {
 
   MLIRGenerator gen(outputOpKind, kernel, batch, layers, tiles, floatType, seed,
                     enableBias, enableRelu, enableSoftmax, keepGenericMatmul,
-                    vnni);
+                    vnni, gemv, norm, weightDensity, embeddingRows,
+                    embeddingBag, heads, seqLen, kvLen, kvCapacity,
+                    convLayout, image, convFilter, convStride, convPadding,
+                    depthwise, batchNorm, convBlock, dynamicBatch);
   return gen.generate(filename);
 }
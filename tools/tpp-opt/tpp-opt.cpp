@@ -6,6 +6,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "mlir/Bytecode/BytecodeReader.h"
 #include "mlir/Dialect/Linalg/TransformOps/DialectExtension.h"
 #include "mlir/Dialect/Tensor/TransformOps/TensorTransformOps.h"
 #include "mlir/IR/Dialect.h"
@@ -20,9 +21,11 @@
 #include "mlir/Tools/mlir-opt/MlirOptMain.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/ToolOutputFile.h"
 
+#include "TPP/CompileTimeReport.h"
 #include "TPP/Dialect/Check/BufferizableOpInterfaceImpl.h"
 #include "TPP/Dialect/Check/CheckDialect.h"
 #include "TPP/Dialect/Perf/BufferizableOpInterfaceImpl.h"
@@ -31,6 +34,27 @@
 #include "TPP/PassBundles.h"
 #include "TPP/Passes.h"
 
+// Compile-time breakdown of the pass bundles
+llvm::cl::opt<std::string> compileTimeReport(
+    "compile-time-report",
+    llvm::cl::desc("Write the compile-time breakdown as JSON (- for stderr)"),
+    llvm::cl::value_desc("filename"), llvm::cl::init(""));
+
+// Opens the input, bytecode is always memory-mapped: its dense resources are
+// then read in place, lazily, instead of being copied. The textual parser
+// needs a null-terminated buffer, which is only mapped if the file size
+// leaves room for it.
+static std::unique_ptr<llvm::MemoryBuffer>
+openInput(llvm::StringRef inputFilename, std::string *errorMessage) {
+  if (inputFilename != "-") {
+    auto mapped = llvm::MemoryBuffer::getFile(
+        inputFilename, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (mapped && mlir::isBytecode(**mapped))
+      return std::move(*mapped);
+  }
+  return mlir::openInputFile(inputFilename, errorMessage);
+}
+
 int main(int argc, char **argv) {
   mlir::registerAllPasses();
   mlir::tpp::registerTppCompilerPasses();
@@ -54,6 +78,37 @@ int main(int argc, char **argv) {
   mlir::tensor::registerTransformDialectExtension(registry);
   registerAllToLLVMIRTranslations(registry);
 
-  return mlir::asMainReturnCode(
-      mlir::MlirOptMain(argc, argv, "TPP optimizer driver\n", registry));
+  // Same as the MlirOptMain entry point, with a hook to time the pipeline.
+  auto [inputFilename, outputFilename] = mlir::registerAndParseCLIOptions(
+      argc, argv, "TPP optimizer driver\n", registry);
+  auto config = mlir::MlirOptMainConfig::createFromCLOptions();
+
+  mlir::tpp::CompileTimeReport report;
+  if (!compileTimeReport.empty()) {
+    config.setPassPipelineSetupFn([&](mlir::PassManager &pm) {
+      report.attach(pm);
+      return mlir::success();
+    });
+  }
+
+  std::string errorMessage;
+  auto file = openInput(inputFilename, &errorMessage);
+  if (!file) {
+    llvm::errs() << errorMessage << "\n";
+    return EXIT_FAILURE;
+  }
+  auto output = mlir::openOutputFile(outputFilename, &errorMessage);
+  if (!output) {
+    llvm::errs() << errorMessage << "\n";
+    return EXIT_FAILURE;
+  }
+  if (mlir::failed(mlir::MlirOptMain(output->os(), std::move(file), registry,
+                                     config)))
+    return EXIT_FAILURE;
+  output->keep();
+
+  if (!compileTimeReport.empty() &&
+      mlir::failed(report.write(compileTimeReport)))
+    return EXIT_FAILURE;
+  return EXIT_SUCCESS;
 }
@@ -0,0 +1,489 @@
+//===- Autotuner.cpp - Search of the pipeline tuning options ----*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "Autotuner.h"
+
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FileUtilities.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/SHA256.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/TargetParser/Host.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+namespace {
+
+// Tuned options of the default pipeline.
+constexpr const char *kBlockFactors = "matmul-block-factors";
+constexpr const char *kTaskGrid = "parallel-task-grid";
+constexpr const char *kTileTraversal = "tile-traversal";
+constexpr const char *kLhsTile = "lhsTile";
+constexpr const char *kRhsTile = "rhsTile";
+constexpr const char *kPrefetchDistance = "prefetch-distance";
+
+// Tuned options of the GPU pipeline.
+constexpr const char *kGpuBlockTile = "gpu-block-tile";
+constexpr const char *kGpuThreadTile = "gpu-thread-tile";
+constexpr const char *kKTile = "k-tile";
+constexpr const char *kStages = "stages";
+constexpr const char *kDpasTile = "dpas-tile";
+
+// Options that change the code or the sizes of the kernel, beyond the tuned
+// ones.
+bool isPipelineOption(StringRef name) {
+  static const llvm::StringSet<> options{
+      "triple",
+      "cpu",
+      "fpu",
+      "O",
+      "gpu",
+      "def-parallel",
+      "parallel-runtime",
+      "linalg-to-loops",
+      "linalg-to-blas",
+      "linalg-to-vector",
+      "vector-to-XSMM",
+      "vector-to-kernels",
+      "per-op-lowering",
+      "profile-in",
+      "hoist-xsmm-dispatch",
+      "group-xsmm-invokes",
+      "lower-pack-unpack-without-transpose",
+      "nontemporal-stores",
+      "math-approx",
+      "peel-remainders",
+      "pad-matmuls",
+      "transpose-kernels",
+      "fuse-lhs-pack",
+      "fuse-dequantize",
+      "fuse-top-k",
+      "fuse-layers",
+      "group-expert-matmuls",
+      "fuse-rotary-embedding",
+      "loops-to-brgemm",
+      "prefetch-next-layer",
+      "winograd-conv",
+      "fuse-updates",
+      "plan-memory",
+      "global-arena",
+      "scratch-arena",
+      "parallel-standalone-ops",
+      "pipeline-layers",
+      "distribute-last-dim",
+      "gpu-args",
+      "gpu-vector",
+      "gpu-mma",
+      "gpu-async-transfers",
+      "gpu-shared-memory",
+      "gpu-graphs",
+      "gpu-megakernel",
+      "gpu-megakernel-blocks",
+      "dynamic-sizes",
+      kBlockFactors,
+      kTaskGrid,
+      kTileTraversal,
+      kLhsTile,
+      kRhsTile,
+      kPrefetchDistance,
+      kGpuBlockTile,
+      kGpuThreadTile,
+      kKTile,
+      kStages,
+      kDpasTile};
+  return options.contains(name);
+}
+
+// Options of the tuning run, not passed to the candidate runs. The candidates
+// report in JSON and don't write the compile-time report of the tuning run.
+bool isTuningRunOption(StringRef name) {
+  static const llvm::StringSet<> options{
+      "autotune", "autotune-jobs", "tuning-db", "output-format",
+      "print-compile-time", "compile-time-report", "profile-out"};
+  return options.contains(name);
+}
+
+// Name of the option of a command line argument, empty for positionals.
+StringRef getOptionName(StringRef arg) {
+  if (!arg.consume_front("-"))
+    return {};
+  arg.consume_front("-");
+  return arg.take_until([](char c) { return c == '='; });
+}
+
+llvm::cl::Option *getOption(StringRef name) {
+  return llvm::cl::getRegisteredOptions().lookup(name);
+}
+
+bool isGivenOption(StringRef name) {
+  auto *option = getOption(name);
+  return option && option->getNumOccurrences() > 0;
+}
+
+bool isFlagSet(StringRef name) {
+  auto *option = getOption(name);
+  return option && static_cast<llvm::cl::opt<bool> *>(option)->getValue();
+}
+
+// Target GPU backend of the run, empty on CPUs.
+StringRef getGpuBackend() {
+  auto *option = getOption("gpu");
+  if (!option)
+    return {};
+  return static_cast<llvm::cl::opt<std::string> *>(option)->getValue();
+}
+
+// Returns the first line of `path` starting with `prefix`, without it.
+std::string readLine(const Twine &path, StringRef prefix) {
+  // Kernel files report no size, read them as streams.
+  auto buffer = llvm::MemoryBuffer::getFileAsStream(path);
+  if (!buffer)
+    return {};
+  SmallVector<StringRef> lines;
+  (*buffer)->getBuffer().split(lines, '\n');
+  for (StringRef line : lines) {
+    if (line.consume_front(prefix))
+      return line.trim().str();
+  }
+  return {};
+}
+
+// Describes the GPUs the kernel runs on: the selected devices and the model
+// of the NVIDIA GPUs or the PCI device ids of the Intel ones.
+std::string getGpuDevices(StringRef backend) {
+  std::string devices;
+  auto addDevices = [&](StringRef dir, StringRef file, StringRef prefix,
+                        StringRef vendor) {
+    std::error_code error;
+    SmallVector<std::string> found;
+    for (llvm::sys::fs::directory_iterator it(dir, error), end;
+         it != end && !error; it.increment(error)) {
+      const std::string &path = it->path();
+      if (!vendor.empty() && readLine(path + "/device/vendor", "") != vendor)
+        continue;
+      std::string device = readLine(path + file, prefix);
+      if (!device.empty())
+        found.push_back(device);
+    }
+    // Directory order is not stable, and the render nodes repeat the cards.
+    llvm::sort(found);
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    for (auto &device : found)
+      devices += device + ',';
+  };
+  if (backend == "cuda") {
+    if (const char *visible = getenv("CUDA_VISIBLE_DEVICES"))
+      devices += std::string(visible) + ';';
+    addDevices("/proc/driver/nvidia/gpus", "/information", "Model:", "");
+  } else if (backend == "intel") {
+    if (const char *visible = getenv("ZE_AFFINITY_MASK"))
+      devices += std::string(visible) + ';';
+    addDevices("/sys/class/drm", "/device/device", "", "0x8086");
+  }
+  return devices;
+}
+
+// Adds the GPU pipeline options to the search space: the block and thread
+// tiles of the kernel, and the K tile, the prefetch stages and the DPAS tile
+// of the lowerings that use them.
+void addGpuDims(SmallVector<SmallVector<TuningConfig>> &dims,
+                StringRef backend,
+                function_ref<void(StringRef, ArrayRef<StringRef>)> addDim) {
+  // The thread tiles must divide the block tiles, they are tuned together.
+  static const std::pair<StringRef, StringRef> tiles[] = {
+      {"64,64", "32,32"},   {"128,128", "32,32"}, {"128,256", "32,64"},
+      {"256,128", "64,32"}, {"256,256", "64,64"}};
+  if (!isGivenOption(kGpuBlockTile) && !isGivenOption(kGpuThreadTile)) {
+    auto &dim = dims.emplace_back();
+    for (auto [block, thread] : tiles)
+      dim.push_back({{kGpuBlockTile, block.str()},
+                     {kGpuThreadTile, thread.str()}});
+  }
+
+  bool isIntel = backend == "intel";
+  // The K tile splits the reduction of the XeGPU and vectorized kernels.
+  if (isIntel || isFlagSet("gpu-vector"))
+    addDim(kKTile, {"16", "32", "64"});
+  // Prefetch stages of the XeGPU kernels and of the tensor core inputs.
+  if (isIntel || isFlagSet("gpu-mma"))
+    addDim(kStages, {"1", "2", "3"});
+  // DPAS shapes of the Data Center (PVC) and Arc (DG2) GPUs.
+  if (isIntel)
+    addDim(kDpasTile, {"8,16,16", "8,8,16"});
+}
+
+// Runs the tool with the candidate options and returns the mean time of its
+// JSON report, none if the candidate failed.
+std::optional<double> benchmarkCandidate(StringRef tool,
+                                         ArrayRef<std::string> args,
+                                         const TuningConfig &config) {
+  SmallString<128> outputPath;
+  if (llvm::sys::fs::createTemporaryFile("tpp-autotune", "json", outputPath))
+    return std::nullopt;
+  llvm::FileRemover remover(outputPath);
+
+  SmallVector<std::string> options{"-output-format=json", "-tuning-db="};
+  for (auto &[name, value] : config)
+    options.push_back("-" + name + "=" + value);
+
+  SmallVector<StringRef> childArgs{tool};
+  for (size_t i = 0; i < args.size(); i++) {
+    StringRef name = getOptionName(args[i]);
+    if (!isTuningRunOption(name)) {
+      childArgs.push_back(args[i]);
+      continue;
+    }
+    // Drop the value of a dropped option given as a separate argument.
+    bool isFlag = name == "autotune" || name == "print-compile-time";
+    if (!isFlag && !StringRef(args[i]).contains('='))
+      i++;
+  }
+  childArgs.append(options.begin(), options.end());
+
+  // Only keep the report, candidates that fail to compile just drop out.
+  std::optional<StringRef> redirects[] = {std::nullopt, StringRef(outputPath),
+                                          StringRef("")};
+  if (llvm::sys::ExecuteAndWait(tool, childArgs, /*Env=*/std::nullopt,
+                                redirects) != 0)
+    return std::nullopt;
+
+  auto buffer = llvm::MemoryBuffer::getFile(outputPath);
+  if (!buffer)
+    return std::nullopt;
+
+  // The report is the last line of the output.
+  StringRef output = (*buffer)->getBuffer().rtrim();
+  output = output.substr(output.rfind('\n') + 1);
+  auto report = llvm::json::parse(output);
+  if (!report) {
+    llvm::consumeError(report.takeError());
+    return std::nullopt;
+  }
+  if (auto *members = report->getAsObject())
+    return members->getNumber("mean");
+  return std::nullopt;
+}
+
+} // namespace
+
+std::string tpp::formatTuningConfig(const TuningConfig &config) {
+  std::string str;
+  for (auto &[name, value] : config) {
+    if (!str.empty())
+      str += " ";
+    str += "-" + name + "=" + value;
+  }
+  return str;
+}
+
+SmallVector<TuningConfig> tpp::getTuningCandidates() {
+  // Alternative values of each dimension of the search space.
+  SmallVector<SmallVector<TuningConfig>> dims;
+  auto addDim = [&](StringRef name, ArrayRef<StringRef> values) {
+    if (isGivenOption(name))
+      return;
+    auto &dim = dims.emplace_back();
+    for (auto value : values)
+      dim.push_back({{name.str(), value.str()}});
+  };
+
+  StringRef backend = getGpuBackend();
+  if (!backend.empty()) {
+    addGpuDims(dims, backend, addDim);
+  } else {
+    addDim(kBlockFactors,
+           {"16,16,16", "32,32,32", "64,64,64", "32,32,64", "64,64,32"});
+
+
+    // The task grid only matters when the parallel loops run on threads.
+    if (isFlagSet("def-parallel")) {
+      addDim(kTaskGrid, {"auto", "2,8", "4,8", "8,8", "4,16", "16,16"});
+      addDim(kTileTraversal, {"row", "col", "grouped", "morton"});
+    }
+
+    // Brgemm tiles are only used by the vector lowering, as MxK and KxN.
+    if (isFlagSet("linalg-to-vector") || isFlagSet("vector-to-XSMM") ||
+        isFlagSet("vector-to-kernels") || isFlagSet("per-op-lowering")) {
+      if (!isGivenOption(kLhsTile) && !isGivenOption(kRhsTile)) {
+        auto &dim = dims.emplace_back();
+        for (int m : {4, 8})
+          for (int n : {16, 32})
+            for (int k : {1, 8})
+              dim.push_back(
+                  {{kLhsTile, llvm::formatv("{0},{1}", m, k).str()},
+                   {kRhsTile, llvm::formatv("{0},{1}", k, n).str()}});
+      }
+    }
+
+    // Software prefetches are only inserted in the vectorized brgemm loops.
+    if (isFlagSet("linalg-to-vector") || isFlagSet("vector-to-kernels") ||
+        isFlagSet("per-op-lowering"))
+      addDim(kPrefetchDistance, {"0", "1", "2", "4"});
+  }
+
+  SmallVector<TuningConfig> candidates{{}};
+  for (auto &dim : dims) {
+    SmallVector<TuningConfig> product;
+    for (auto &candidate : candidates) {
+      for (auto &value : dim) {
+        auto &config = product.emplace_back(candidate);
+        config.append(value.begin(), value.end());
+      }
+    }
+    candidates = std::move(product);
+  }
+  if (candidates.size() == 1 && candidates.front().empty())
+    candidates.clear();
+  return candidates;
+}
+
+TuningConfig tpp::applyTuningConfig(const TuningConfig &config) {
+  TuningConfig applied;
+  for (auto &[name, value] : config) {
+    auto *option = getOption(name);
+    if (!option || option->getNumOccurrences() > 0)
+      continue;
+    // Lists take one occurrence per element, the first one drops the
+    // defaults.
+    SmallVector<StringRef> elements;
+    StringRef(value).split(elements, ',');
+    for (auto element : elements)
+      (void)option->addOccurrence(/*pos=*/0, name, element);
+    applied.push_back({name, value});
+  }
+  return applied;
+}
+
+std::string tpp::getTuningKey(ModuleOp module, StringRef entry,
+                              ArrayRef<std::string> args) {
+  std::string key;
+  llvm::raw_string_ostream os(key);
+  os << entry << '\0' << llvm::sys::getHostCPUName() << '\0';
+  if (const char *threads = getenv("OMP_NUM_THREADS"))
+    os << threads;
+  os << '\0';
+  // GPU kernels are tuned per device.
+  StringRef backend = getGpuBackend();
+  if (!backend.empty())
+    os << getGpuDevices(backend);
+  os << '\0';
+  for (auto &arg : args) {
+    if (isPipelineOption(getOptionName(arg)))
+      os << arg << '\0';
+  }
+  module->print(os);
+  os.flush();
+
+  auto hash = llvm::SHA256::hash(llvm::arrayRefFromStringRef(key));
+  return llvm::toHex(hash, /*LowerCase=*/true);
+}
+
+FailureOr<std::pair<TuningConfig, double>>
+tpp::runAutotuner(StringRef tool, ArrayRef<std::string> args,
+                  ArrayRef<TuningConfig> candidates, unsigned jobs) {
+  // Candidates run one at a time by default, concurrent runs share the cores
+  // and the memory bandwidth and skew the timings.
+  SmallVector<std::optional<double>> means(candidates.size());
+  llvm::parallel::strategy = llvm::hardware_concurrency(jobs);
+  llvm::parallelFor(0, candidates.size(), [&](size_t i) {
+    means[i] = benchmarkCandidate(tool, args, candidates[i]);
+  });
+
+  std::optional<size_t> best;
+  for (size_t i = 0; i < candidates.size(); i++) {
+    if (!means[i]) {
+      llvm::errs() << "Autotune: candidate failed: "
+                   << formatTuningConfig(candidates[i]) << "\n";
+      continue;
+    }
+    if (!best || *means[i] < *means[*best])
+      best = i;
+  }
+  if (!best)
+    return failure();
+  return std::make_pair(candidates[*best], *means[*best]);
+}
+
+llvm::json::Object TuningDatabase::load() const {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer)
+    return {};
+  auto db = llvm::json::parse((*buffer)->getBuffer());
+  if (!db) {
+    llvm::errs() << "Ignoring invalid tuning database " << path << ": "
+                 << llvm::toString(db.takeError()) << "\n";
+    return {};
+  }
+  if (auto *entries = db->getAsObject())
+    return std::move(*entries);
+  return {};
+}
+
+std::optional<TuningConfig> TuningDatabase::lookup(StringRef key) const {
+  auto entries = load();
+  auto *entry = entries.getObject(key);
+  if (!entry)
+    return std::nullopt;
+  auto *options = entry->getObject("options");
+  if (!options)
+    return std::nullopt;
+
+  TuningConfig config;
+  for (auto &option : *options) {
+    if (auto value = option.second.getAsString())
+      config.push_back({option.first.str(), value->str()});
+  }
+  // JSON objects are unordered, keep the config stable.
+  llvm::sort(config);
+  return config;
+}
+
+LogicalResult TuningDatabase::record(StringRef key, const TuningConfig &config,
+                                     double mean) const {
+  llvm::json::Object options;
+  for (auto &[name, value] : config)
+    options[name] = value;
+
+  auto entries = load();
+  entries[key] =
+      llvm::json::Object{{"options", std::move(options)}, {"mean", mean}};
+
+  // Write a new file and move it over, so that a concurrent lookup never
+  // reads a partial database.
+  SmallString<128> tmpPath(path);
+  tmpPath += ".tmp";
+  {
+    std::error_code error;
+    llvm::raw_fd_ostream os(tmpPath, error);
+    if (error) {
+      llvm::errs() << "Error while writing the tuning database " << path
+                   << ": " << error.message() << "\n";
+      return failure();
+    }
+    os << llvm::formatv("{0:2}", llvm::json::Value(std::move(entries)))
+       << "\n";
+  }
+  if (auto error = llvm::sys::fs::rename(tmpPath, path)) {
+    llvm::errs() << "Error while writing the tuning database " << path << ": "
+                 << error.message() << "\n";
+    return failure();
+  }
+  return success();
+}
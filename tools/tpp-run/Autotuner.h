@@ -0,0 +1,77 @@
+//===- Autotuner.h - Search of the pipeline tuning options ------*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Searches the tiling and parallelization options of the default pipeline for
+// a kernel by benchmarking every candidate in a child tpp-run, and keeps the
+// fastest configuration in a tuning database, keyed by the kernel and the
+// machine, that later runs apply automatically.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/Support/LogicalResult.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/JSON.h"
+
+#include <optional>
+#include <string>
+#include <utility>
+
+namespace mlir {
+namespace tpp {
+
+/// Values of the tuned pipeline options, as (option name, value) pairs.
+using TuningConfig = SmallVector<std::pair<std::string, std::string>>;
+
+/// Prints the config as command line options.
+std::string formatTuningConfig(const TuningConfig &config);
+
+/// Returns the candidates of the search for the current pipeline options.
+/// Options given on the command line are not tuned.
+SmallVector<TuningConfig> getTuningCandidates();
+
+/// Sets the options of the config that were not given on the command line and
+/// returns the ones applied.
+TuningConfig applyTuningConfig(const TuningConfig &config);
+
+/// Returns the tuning key of the kernel: the input IR, the entry point, the
+/// options that change the pipeline, the host CPU and thread count and the
+/// GPUs of GPU kernels.
+std::string getTuningKey(ModuleOp module, StringRef entry,
+                         ArrayRef<std::string> args);
+
+/// Benchmarks every candidate with the tool arguments in a child process of
+/// the tool, `jobs` at a time, and returns the fastest configuration with
+/// its mean time. Fails if no candidate ran.
+FailureOr<std::pair<TuningConfig, double>>
+runAutotuner(StringRef tool, ArrayRef<std::string> args,
+             ArrayRef<TuningConfig> candidates, unsigned jobs);
+
+/// JSON file of the best known configuration of each tuning key.
+class TuningDatabase {
+public:
+  explicit TuningDatabase(StringRef path) : path(path) {}
+
+  /// Returns the configuration of the key, if known.
+  std::optional<TuningConfig> lookup(StringRef key) const;
+
+  /// Stores the configuration of the key, replacing any previous one.
+  LogicalResult record(StringRef key, const TuningConfig &config,
+                       double mean) const;
+
+private:
+  llvm::json::Object load() const;
+
+  std::string path;
+};
+
+} // namespace tpp
+} // namespace mlir
@@ -0,0 +1,192 @@
+//===- ConcurrentBench.cpp - Concurrent execution of a kernel ---*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "ConcurrentBench.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemAlloc.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+namespace {
+
+constexpr size_t kBufferAlignment = 64;
+
+// Zero-initialized buffers of an instance of the kernel.
+class Instance {
+public:
+  explicit Instance(const KernelSignature &signature) {
+    SmallVector<KernelBuffer> buffers(signature.args);
+    buffers.append(signature.results);
+    for (const KernelBuffer &buffer : buffers) {
+      size_t bytes = std::max<int64_t>(buffer.getNumBytes(), 1);
+      void *data = llvm::allocate_buffer(bytes, kBufferAlignment);
+      std::memset(data, 0, bytes);
+      allocations.push_back({data, bytes});
+      descriptors.push_back(createMemRefDescriptor(data, buffer.shape));
+    }
+    // The descriptors no longer move, point to them.
+    for (auto [descriptor, buffer] : llvm::zip(descriptors, buffers))
+      bufferRefs.push_back(getKernelBufferRef(descriptor, buffer));
+  }
+
+  ~Instance() {
+    for (auto [data, bytes] : allocations)
+      llvm::deallocate_buffer(data, bytes, kBufferAlignment);
+  }
+
+  Instance(const Instance &) = delete;
+  Instance &operator=(const Instance &) = delete;
+
+  LogicalResult run(Kernel &kernel, unsigned iterations) {
+    for (unsigned i = 0; i < iterations; i++) {
+      if (failed(kernel.invoke(bufferRefs)))
+        return failure();
+    }
+    return success();
+  }
+
+private:
+  SmallVector<std::pair<void *, size_t>> allocations;
+  SmallVector<SmallVector<int64_t>> descriptors;
+  SmallVector<KernelBufferRef> bufferRefs;
+};
+
+double getElapsedSeconds(std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+// Runs the instances one after the other on a team of all the CPUs, after a
+// warm-up run each. Returns the elapsed time.
+FailureOr<double> runSerially(Kernel &kernel,
+                              ArrayRef<std::unique_ptr<Instance>> instances,
+                              ArrayRef<unsigned> cpus, unsigned iterations) {
+  ThreadTeam team(cpus);
+  team.join();
+  auto run = [&](unsigned rounds) -> FailureOr<double> {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < rounds; i++) {
+      for (const auto &instance : instances) {
+        if (failed(instance->run(kernel, 1)))
+          return failure();
+      }
+    }
+    return getElapsedSeconds(start);
+  };
+  FailureOr<double> seconds = run(1);
+  if (succeeded(seconds))
+    seconds = run(iterations);
+  ThreadTeam::leave();
+  return seconds;
+}
+
+// Runs the instances side by side, each on its own thread and team of CPUs.
+// The clock starts once all of them are warmed up. Returns the elapsed time.
+FailureOr<double>
+runConcurrently(Kernel &kernel, ArrayRef<std::unique_ptr<Instance>> instances,
+                ArrayRef<SmallVector<unsigned>> teamCpus, unsigned iterations) {
+  SmallVector<std::unique_ptr<ThreadTeam>> teams;
+  for (ArrayRef<unsigned> cpus : teamCpus)
+    teams.push_back(std::make_unique<ThreadTeam>(cpus));
+
+  std::atomic<unsigned> ready{0};
+  std::atomic<bool> start{false};
+  std::atomic<bool> anyFailed{false};
+  SmallVector<std::thread> threads;
+  for (unsigned index = 0; index < instances.size(); index++) {
+    threads.emplace_back([&, index] {
+      teams[index]->join();
+      if (failed(instances[index]->run(kernel, 1)))
+        anyFailed.store(true);
+      ready.fetch_add(1);
+      while (!start.load())
+        std::this_thread::yield();
+      if (!anyFailed.load() &&
+          failed(instances[index]->run(kernel, iterations)))
+        anyFailed.store(true);
+      ThreadTeam::leave();
+    });
+  }
+
+  while (ready.load() != instances.size())
+    std::this_thread::yield();
+  auto startTime = std::chrono::steady_clock::now();
+  start.store(true);
+  for (std::thread &thread : threads)
+    thread.join();
+  double seconds = getElapsedSeconds(startTime);
+  if (anyFailed.load())
+    return failure();
+  return seconds;
+}
+
+} // namespace
+
+void mlir::tpp::benchConcurrentKernels(Kernel &kernel, unsigned numKernels,
+                                       ArrayRef<unsigned> cpus,
+                                       unsigned iterations) {
+  if (cpus.size() < numKernels) {
+    llvm::errs() << "Error: " << numKernels << " concurrent kernels need as "
+                 << "many CPUs, " << cpus.size() << " available\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  SmallVector<std::unique_ptr<Instance>> instances;
+  for (unsigned index = 0; index < numKernels; index++)
+    instances.push_back(std::make_unique<Instance>(kernel.getSignature()));
+
+  // Contiguous shares of the CPUs, which keeps the SMT siblings and the cores
+  // of a socket together with the compact and socket placements.
+  SmallVector<SmallVector<unsigned>> teamCpus;
+  size_t minTeamSize = cpus.size(), maxTeamSize = 0;
+  for (unsigned index = 0; index < numKernels; index++) {
+    size_t begin = cpus.size() * index / numKernels;
+    size_t end = cpus.size() * (index + 1) / numKernels;
+    teamCpus.emplace_back(cpus.slice(begin, end - begin));
+    minTeamSize = std::min(minTeamSize, end - begin);
+    maxTeamSize = std::max(maxTeamSize, end - begin);
+  }
+
+  auto serialSeconds = runSerially(kernel, instances, cpus, iterations);
+  if (failed(serialSeconds))
+    std::exit(EXIT_FAILURE);
+  auto concurrentSeconds =
+      runConcurrently(kernel, instances, teamCpus, iterations);
+  if (failed(concurrentSeconds))
+    std::exit(EXIT_FAILURE);
+
+  double numRuns = static_cast<double>(numKernels) * iterations;
+  double serialThroughput = numRuns / *serialSeconds;
+  double concurrentThroughput = numRuns / *concurrentSeconds;
+  llvm::outs() << llvm::format("serial: %.3f kernels/s (1 team of %u "
+                               "threads)\n",
+                               serialThroughput,
+                               static_cast<unsigned>(cpus.size()))
+               << llvm::format("concurrent: %.3f kernels/s (%u teams of %u "
+                               "to %u threads)\n",
+                               concurrentThroughput, numKernels,
+                               static_cast<unsigned>(minTeamSize),
+                               static_cast<unsigned>(maxTeamSize))
+               << llvm::format("speedup: %.3f\n",
+                               concurrentThroughput / serialThroughput);
+  llvm::outs().flush();
+  std::exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,32 @@
+//===- ConcurrentBench.h - Concurrent execution of a kernel -----*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Measures what co-locating several instances of a kernel in a process costs
+// or gains: the instances run one after the other on all the cores, then side
+// by side, each on a thread team of its share of the cores.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "TPP/Runner/Engine.h"
+#include "llvm/ADT/ArrayRef.h"
+
+namespace mlir {
+namespace tpp {
+
+/// Runs `numKernels` instances of the kernel on their own buffers, `iterations`
+/// times each: serially on a team of all the `cpus`, then concurrently on
+/// disjoint teams splitting the `cpus`. Prints the aggregate throughput of both
+/// and exits the process.
+[[noreturn]] void benchConcurrentKernels(Kernel &kernel, unsigned numKernels,
+                                         ArrayRef<unsigned> cpus,
+                                         unsigned iterations);
+
+} // namespace tpp
+} // namespace mlir
@@ -0,0 +1,316 @@
+//===- KernelServer.cpp - Persistent execution of a kernel ------*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The requests are lines of text, one client at a time:
+//   info     replies with a line per buffer, "arg <i> <segment> <bytes>
+//            <shape>" or "result <i> <segment> <bytes> <shape>", then "end";
+//   run [n]  runs the kernel n times (once by default) on the buffers and
+//            replies "ok <mean seconds>";
+//   quit     replies "ok" and stops the server.
+// Anything else is answered with "error <message>". The segments are POSIX
+// shared memory objects (/dev/shm/<segment> on Linux) the clients map.
+//
+//===----------------------------------------------------------------------===//
+
+#include "KernelServer.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+namespace {
+
+// Set by SIGINT and SIGTERM, which interrupt the blocking socket calls.
+volatile sig_atomic_t stopRequested = 0;
+
+void onStopSignal(int) { stopRequested = 1; }
+
+std::string formatShape(ArrayRef<int64_t> shape) {
+  if (shape.empty())
+    return "scalar";
+  return llvm::join(llvm::map_range(shape,
+                                    [](int64_t dim) {
+                                      return std::to_string(dim);
+                                    }),
+                    "x");
+}
+
+// A buffer of the kernel in a shared memory segment.
+struct SharedBuffer {
+  std::string segment;
+  void *data = nullptr;
+  size_t mappedBytes = 0;
+};
+
+class KernelServer {
+public:
+  explicit KernelServer(Kernel &kernel)
+      : kernel(kernel), signature(kernel.getSignature()) {}
+
+  ~KernelServer() { release(); }
+
+  /// Maps the buffers of the kernel.
+  LogicalResult allocate();
+
+  /// Runs the kernel `iterations` times and returns the mean time.
+  FailureOr<double> runKernel(unsigned iterations);
+
+  /// Serves the requests until a client quits or the process is interrupted.
+  LogicalResult serve(StringRef socketPath);
+
+private:
+  LogicalResult mapBuffer(StringRef kind, unsigned index,
+                          const KernelBuffer &buffer);
+  void release();
+
+  /// Answers the requests of a client until it disconnects. Returns true if
+  /// it asked the server to quit.
+  bool serveClient(int client);
+  std::string handleRequest(StringRef request, bool &quit);
+
+  Kernel &kernel;
+  const KernelSignature &signature;
+
+  SmallVector<SharedBuffer> buffers;
+  SmallVector<SmallVector<int64_t>> descriptors;
+  // Buffers of the kernel calls, pointing to the descriptors.
+  SmallVector<KernelBufferRef> bufferRefs;
+};
+
+LogicalResult KernelServer::mapBuffer(StringRef kind, unsigned index,
+                                      const KernelBuffer &buffer) {
+  SharedBuffer shared;
+  shared.segment = ("/tpp-serve-" + Twine(getpid()) + "-" + kind + Twine(index))
+                       .str();
+  // Empty mappings are invalid, empty buffers get a page.
+  shared.mappedBytes = std::max<size_t>(buffer.getNumBytes(), 1);
+
+  int fd = shm_open(shared.segment.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    llvm::errs() << "Error while creating the shared memory segment "
+                 << shared.segment << ": " << strerror(errno) << "\n";
+    return failure();
+  }
+  void *data = MAP_FAILED;
+  if (ftruncate(fd, shared.mappedBytes) == 0)
+    data = mmap(nullptr, shared.mappedBytes, PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    llvm::errs() << "Error while mapping the shared memory segment "
+                 << shared.segment << ": " << strerror(errno) << "\n";
+    shm_unlink(shared.segment.c_str());
+    return failure();
+  }
+  shared.data = data;
+  descriptors.push_back(createMemRefDescriptor(data, buffer.shape));
+  buffers.push_back(std::move(shared));
+  return success();
+}
+
+LogicalResult KernelServer::allocate() {
+  for (auto [index, buffer] : llvm::enumerate(signature.args)) {
+    if (failed(mapBuffer("arg", index, buffer)))
+      return failure();
+  }
+  for (auto [index, buffer] : llvm::enumerate(signature.results)) {
+    if (failed(mapBuffer("result", index, buffer)))
+      return failure();
+  }
+
+  // The descriptors no longer move, point to them.
+  SmallVector<KernelBuffer> kernelBuffers(signature.args);
+  kernelBuffers.append(signature.results);
+  for (auto [descriptor, buffer] : llvm::zip(descriptors, kernelBuffers))
+    bufferRefs.push_back(getKernelBufferRef(descriptor, buffer));
+  return success();
+}
+
+void KernelServer::release() {
+  for (auto &buffer : buffers) {
+    munmap(buffer.data, buffer.mappedBytes);
+    shm_unlink(buffer.segment.c_str());
+  }
+  buffers.clear();
+}
+
+FailureOr<double> KernelServer::runKernel(unsigned iterations) {
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < iterations; i++) {
+    if (failed(kernel.invoke(bufferRefs)))
+      return failure();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+std::string KernelServer::handleRequest(StringRef request, bool &quit) {
+  auto [command, operand] = request.split(' ');
+  operand = operand.trim();
+  std::string reply;
+  llvm::raw_string_ostream os(reply);
+
+  if (command == "info" && operand.empty()) {
+    auto printBuffers = [&](StringRef kind, ArrayRef<KernelBuffer> kinds,
+                            unsigned first) {
+      for (auto [index, buffer] : llvm::enumerate(kinds))
+        os << kind << " " << index << " " << buffers[first + index].segment
+           << " " << buffer.getNumBytes() << " " << formatShape(buffer.shape)
+           << "\n";
+    };
+    printBuffers("arg", signature.args, 0);
+    printBuffers("result", signature.results, signature.args.size());
+    os << "end\n";
+  } else if (command == "run") {
+    unsigned iterations = 1;
+    if (!operand.empty() &&
+        (operand.getAsInteger(10, iterations) || iterations == 0)) {
+      os << "error invalid iteration count " << operand << "\n";
+      return reply;
+    }
+    auto seconds = runKernel(iterations);
+    if (failed(seconds))
+      os << "error kernel failed\n";
+    else
+      os << llvm::format("ok %.9e\n", *seconds);
+  } else if (command == "quit" && operand.empty()) {
+    quit = true;
+    os << "ok\n";
+  } else {
+    os << "error unknown request " << request << "\n";
+  }
+  return reply;
+}
+
+bool KernelServer::serveClient(int client) {
+  std::string pending;
+  char chunk[256];
+  while (!stopRequested) {
+    size_t eol = pending.find('\n');
+    if (eol == std::string::npos) {
+      ssize_t received = read(client, chunk, sizeof(chunk));
+      if (received < 0 && errno == EINTR)
+        continue;
+      if (received <= 0)
+        return false;
+      pending.append(chunk, received);
+      continue;
+    }
+
+    bool quit = false;
+    std::string reply =
+        handleRequest(StringRef(pending).take_front(eol).trim(), quit);
+    pending.erase(0, eol + 1);
+    // A client that went away does not stop the server.
+    for (size_t sent = 0; sent < reply.size();) {
+      ssize_t written = send(client, reply.data() + sent, reply.size() - sent,
+                             MSG_NOSIGNAL);
+      if (written < 0 && errno == EINTR)
+        continue;
+      if (written < 0)
+        return false;
+      sent += written;
+    }
+    if (quit)
+      return true;
+  }
+  return false;
+}
+
+LogicalResult KernelServer::serve(StringRef socketPath) {
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(address.sun_path)) {
+    llvm::errs() << "Error: socket path too long: " << socketPath << "\n";
+    return failure();
+  }
+  memcpy(address.sun_path, socketPath.data(), socketPath.size());
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    llvm::errs() << "Error while creating the socket: " << strerror(errno)
+                 << "\n";
+    return failure();
+  }
+  // Replace the socket of a previous server.
+  unlink(address.sun_path);
+  if (bind(listener, reinterpret_cast<sockaddr *>(&address),
+           sizeof(address)) != 0 ||
+      listen(listener, /*backlog=*/8) != 0) {
+    llvm::errs() << "Error while listening on " << socketPath << ": "
+                 << strerror(errno) << "\n";
+    close(listener);
+    return failure();
+  }
+
+  // No restart, the signals interrupt the blocking calls to stop.
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = onStopSignal;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+
+  llvm::errs() << "Serving " << signature.entryName << " on " << socketPath
+               << "\n";
+  LogicalResult result = success();
+  while (!stopRequested) {
+    int client = accept(listener, nullptr, nullptr);
+    if (client < 0) {
+      if (errno == EINTR)
+        continue;
+      llvm::errs() << "Error while accepting a client: " << strerror(errno)
+                   << "\n";
+      result = failure();
+      break;
+    }
+    bool quit = serveClient(client);
+    close(client);
+    if (quit)
+      break;
+  }
+  close(listener);
+  unlink(address.sun_path);
+  return result;
+}
+
+} // namespace
+
+void mlir::tpp::serveKernel(Kernel &kernel, StringRef socketPath) {
+  bool failed = false;
+  {
+    KernelServer server(kernel);
+    // A first run starts the threads of the parallel runtimes and dispatches
+    // the library kernels, before the first request.
+    failed = mlir::failed(server.allocate()) ||
+             mlir::failed(server.runKernel(/*iterations=*/1)) ||
+             mlir::failed(server.serve(socketPath));
+  }
+  llvm::outs().flush();
+  std::exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
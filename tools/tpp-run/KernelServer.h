@@ -0,0 +1,30 @@
+//===- KernelServer.h - Persistent execution of a kernel --------*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Compiles a kernel once and runs it on request, so that repeated executions
+// only pay for the kernel itself: the JIT'd code, its buffers and the threads
+// of the parallel runtimes stay alive between the requests. The buffers of the
+// kernel are shared memory segments the clients write the inputs to and read
+// the results from, the requests go through a Unix socket.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "TPP/Runner/Engine.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace mlir {
+namespace tpp {
+
+/// Serves the kernel on the Unix socket `socketPath` until a client asks it
+/// to quit or the process is interrupted. Exits the process.
+[[noreturn]] void serveKernel(Kernel &kernel, StringRef socketPath);
+
+} // namespace tpp
+} // namespace mlir
@@ -0,0 +1,188 @@
+//===- RegressionCheck.cpp - Comparison with a baseline run -----*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "RegressionCheck.h"
+
+#include "PerfRunnerUtils.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <string>
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+// Significance level of the test: the probability of reporting a regression
+// when the kernel is not slower than the tolerated slowdown.
+static constexpr double kSignificance = 0.01;
+
+// Fewest samples per run for the normal approximation of the U statistic.
+static constexpr size_t kMinSamples = 8;
+
+// Returns the samples this run reported under `key`.
+static SmallVector<double> getRunSamples(StringRef key) {
+  std::string keyStr = key.str();
+  int64_t numSamples = tpp_perf_get_samples(keyStr.c_str(), nullptr, 0);
+  if (numSamples <= 0)
+    return {};
+  SmallVector<double> samples(numSamples);
+  tpp_perf_get_samples(keyStr.c_str(), samples.data(), numSamples);
+  return samples;
+}
+
+static double getMedian(ArrayRef<double> values) {
+  SmallVector<double> sorted(values);
+  llvm::sort(sorted);
+  size_t mid = sorted.size() / 2;
+  if (sorted.size() % 2)
+    return sorted[mid];
+  return (sorted[mid - 1] + sorted[mid]) / 2;
+}
+
+// Returns the p-value of the one-sided Mann-Whitney U test of `samples` being
+// larger than `reference`: the probability of a U statistic as large if both
+// came from the same distribution. Uses the normal approximation, corrected
+// for ties and continuity.
+static double getMannWhitneyPValue(ArrayRef<double> samples,
+                                   ArrayRef<double> reference) {
+  // Rank all the values together, tied values share the mean of their ranks.
+  SmallVector<std::pair<double, bool>> values;
+  for (double value : samples)
+    values.emplace_back(value, true);
+  for (double value : reference)
+    values.emplace_back(value, false);
+  llvm::sort(values, llvm::less_first());
+
+  double rankSum = 0.0;
+  double tieSum = 0.0;
+  for (size_t begin = 0, end; begin < values.size(); begin = end) {
+    end = begin + 1;
+    while (end < values.size() && values[end].first == values[begin].first)
+      ++end;
+    double rank = (begin + 1 + end) / 2.0;
+    for (size_t i = begin; i < end; ++i) {
+      if (values[i].second)
+        rankSum += rank;
+    }
+    double ties = end - begin;
+    tieSum += ties * ties * ties - ties;
+  }
+
+  double n1 = samples.size();
+  double n2 = reference.size();
+  double n = n1 + n2;
+  double u = rankSum - n1 * (n1 + 1) / 2;
+  double mean = n1 * n2 / 2;
+  double variance = n1 * n2 / 12 * ((n + 1) - tieSum / (n * (n - 1)));
+  // All the values are equal.
+  if (variance <= 0.0)
+    return 1.0;
+  double z = (u - mean - 0.5) / std::sqrt(variance);
+  return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+// Returns an error if the `member` of the baseline report differs from the
+// one of this run.
+static LogicalResult checkSameMember(const llvm::json::Object &baseline,
+                                     const llvm::json::Object &header,
+                                     StringRef member, StringRef path) {
+  const llvm::json::Value *baselineValue = baseline.get(member);
+  const llvm::json::Value *value = header.get(member);
+  if (baselineValue && value && *baselineValue == *value)
+    return success();
+  llvm::errs() << "Baseline '" << path << "' was not recorded with the same "
+               << member;
+  if (value)
+    llvm::errs() << " (" << *value << ")";
+  llvm::errs() << "\n";
+  return failure();
+}
+
+LogicalResult tpp::checkRegression(StringRef baselinePath,
+                                   const llvm::json::Object &header,
+                                   double tolerance) {
+  auto buffer = llvm::MemoryBuffer::getFile(baselinePath);
+  if (!buffer) {
+    llvm::errs() << "Cannot read the baseline '" << baselinePath
+                 << "': " << buffer.getError().message() << "\n";
+    return failure();
+  }
+  auto json = llvm::json::parse((*buffer)->getBuffer());
+  if (!json) {
+    llvm::errs() << "Invalid baseline '" << baselinePath
+                 << "': " << llvm::toString(json.takeError()) << "\n";
+    return failure();
+  }
+  const llvm::json::Object *baseline = json->getAsObject();
+  if (!baseline) {
+    llvm::errs() << "Invalid baseline '" << baselinePath
+                 << "': expected a JSON report\n";
+    return failure();
+  }
+
+  // Samples are only comparable on the same kernel, compiled and run the
+  // same way. The number of iterations may differ.
+  for (StringRef member : {"kernel", "threads", "options"}) {
+    if (failed(checkSameMember(*baseline, header, member, baselinePath)))
+      return failure();
+  }
+
+  // Each kernel of the report has its samples, in key order for a stable
+  // output.
+  SmallVector<StringRef> keys;
+  for (const auto &[key, value] : *baseline) {
+    StringRef keyRef = key;
+    if (keyRef == "samples" || keyRef.ends_with(".samples"))
+      keys.push_back(keyRef);
+  }
+  if (keys.empty()) {
+    llvm::errs() << "Baseline '" << baselinePath
+                 << "' has no samples, record it with -bench-samples\n";
+    return failure();
+  }
+  llvm::sort(keys);
+
+  bool regressed = false;
+  for (StringRef key : keys) {
+    // The baseline slowed down by the tolerance is the reference.
+    SmallVector<double> reference;
+    if (const llvm::json::Array *array = baseline->getArray(key)) {
+      for (const llvm::json::Value &value : *array) {
+        if (std::optional<double> sample = value.getAsNumber())
+          reference.push_back(*sample * (1.0 + tolerance));
+      }
+    }
+    SmallVector<double> samples = getRunSamples(key);
+    if (reference.size() < kMinSamples || samples.size() < kMinSamples) {
+      llvm::errs() << "Baseline " << key << ": at least " << kMinSamples
+                   << " samples are needed, the baseline has "
+                   << reference.size() << " and this run " << samples.size()
+                   << "\n";
+      return failure();
+    }
+
+    double baselineMedian = getMedian(reference) / (1.0 + tolerance);
+    double median = getMedian(samples);
+    double pValue = getMannWhitneyPValue(samples, reference);
+    bool isRegression = pValue < kSignificance;
+    llvm::errs() << llvm::format(
+        "Baseline %s: median %.3e s -> %.3e s (%+.1f%%), p = %.2g, %s\n",
+        key.str().c_str(), baselineMedian, median,
+        (median / baselineMedian - 1.0) * 100.0, pValue,
+        isRegression ? "regression" : "ok");
+    regressed |= isRegression;
+  }
+  return failure(regressed);
+}
@@ -0,0 +1,36 @@
+//===- RegressionCheck.h - Comparison with a baseline run -------*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Checks the benchmark iterations of a run against the ones of a JSON report
+// recorded earlier for the same kernel and options. The samples of both runs
+// are compared with a one-sided Mann-Whitney U test, which does not assume
+// the iteration times are normally distributed, as they rarely are.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "mlir/Support/LLVM.h"
+#include "mlir/Support/LogicalResult.h"
+#include "llvm/Support/JSON.h"
+
+namespace mlir {
+namespace tpp {
+
+/// Compares the samples this run reported with the ones of the JSON report
+/// `baselinePath`, under the same keys. `header` is the JSON report header of
+/// this run, its kernel, threads and options must match the ones of the
+/// baseline. Prints the comparison of each kernel and fails if the baseline
+/// cannot be compared, or if a kernel is significantly slower than the
+/// baseline slowed down by `tolerance`, a fraction.
+LogicalResult checkRegression(StringRef baselinePath,
+                              const llvm::json::Object &header,
+                              double tolerance);
+
+} // namespace tpp
+} // namespace mlir
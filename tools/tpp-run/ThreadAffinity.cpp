@@ -0,0 +1,171 @@
+//===- ThreadAffinity.cpp - Placement of the runtime threads ----*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "ThreadAffinity.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/Threading.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <optional>
+#include <tuple>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+using namespace mlir;
+using namespace mlir::tpp;
+
+namespace {
+
+// A hardware thread, `smt` is its rank among the siblings of its core and
+// `core` the rank of its core in its socket.
+struct HardwareThread {
+  unsigned cpu;
+  unsigned socket;
+  unsigned core;
+  unsigned smt;
+};
+
+// Reads an integer of the sysfs topology of `cpu`.
+std::optional<unsigned> readTopology(unsigned cpu, StringRef name) {
+  std::ifstream file(
+      llvm::formatv("/sys/devices/system/cpu/cpu{0}/topology/{1}", cpu, name)
+          .str());
+  unsigned value;
+  if (!(file >> value))
+    return std::nullopt;
+  return value;
+}
+
+// Returns the CPUs the process may run on.
+SmallVector<unsigned> getAllowedCpus() {
+  SmallVector<unsigned> cpus;
+#if defined(__linux__)
+  cpu_set_t set;
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set))
+        cpus.push_back(cpu);
+    }
+  }
+#endif
+  if (cpus.empty()) {
+    unsigned numCpus = llvm::hardware_concurrency().compute_thread_count();
+    for (unsigned cpu = 0; cpu < numCpus; ++cpu)
+      cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+// Returns the topology of the allowed CPUs. Without a topology, each CPU is
+// a core of a single socket.
+SmallVector<HardwareThread> getHardwareThreads() {
+  SmallVector<HardwareThread> threads;
+  for (unsigned cpu : getAllowedCpus()) {
+    threads.push_back(
+        {cpu, readTopology(cpu, "physical_package_id").value_or(0),
+         readTopology(cpu, "core_id").value_or(cpu), /*smt=*/0});
+  }
+
+  // Rank the cores in their socket and the siblings in their core.
+  llvm::sort(threads, [](const HardwareThread &a, const HardwareThread &b) {
+    return std::tie(a.socket, a.core, a.cpu) <
+           std::tie(b.socket, b.core, b.cpu);
+  });
+  for (size_t i = 1; i < threads.size(); ++i) {
+    const HardwareThread &prev = threads[i - 1];
+    if (threads[i].socket == prev.socket && threads[i].core == prev.core)
+      threads[i].smt = prev.smt + 1;
+  }
+  llvm::DenseMap<std::pair<unsigned, unsigned>, unsigned> coreRanks;
+  llvm::DenseMap<unsigned, unsigned> numCores;
+  for (HardwareThread &thread : threads) {
+    auto [it, inserted] =
+        coreRanks.try_emplace({thread.socket, thread.core}, 0);
+    if (inserted)
+      it->second = numCores[thread.socket]++;
+    thread.core = it->second;
+  }
+  return threads;
+}
+
+// Reads the thread count of the environment, as the task runtime does, 0 if
+// not set.
+unsigned readNumThreads() {
+  for (const char *name : {"TPP_NUM_THREADS", "OMP_NUM_THREADS"}) {
+    unsigned numThreads = 0;
+    const char *value = getenv(name);
+    if (value && !StringRef(value).getAsInteger(10, numThreads) &&
+        numThreads > 0)
+      return numThreads;
+  }
+  return 0;
+}
+
+} // namespace
+
+FailureOr<SmallVector<unsigned>> mlir::tpp::getThreadCpus(StringRef policy,
+                                                          bool noSmt) {
+  SmallVector<HardwareThread> threads = getHardwareThreads();
+  if (noSmt)
+    llvm::erase_if(threads, [](const HardwareThread &t) { return t.smt != 0; });
+
+  auto key = [&](const HardwareThread &t) {
+    if (policy == "socket")
+      return std::make_tuple(t.socket, t.smt, t.core);
+    if (policy == "scatter")
+      return std::make_tuple(t.smt, t.core, t.socket);
+    return std::make_tuple(t.socket, t.core, t.smt);
+  };
+  if (policy != "compact" && policy != "socket" && policy != "scatter")
+    return failure();
+  llvm::stable_sort(threads,
+                    [&](const HardwareThread &a, const HardwareThread &b) {
+                      return key(a) < key(b);
+                    });
+
+  SmallVector<unsigned> cpus;
+  for (const HardwareThread &thread : threads)
+    cpus.push_back(thread.cpu);
+  return cpus;
+}
+
+void mlir::tpp::bindThreads(ArrayRef<unsigned> cpus) {
+  // OpenMP binds its thread i to the place i when they are listed in order.
+  std::string places = llvm::join(
+      llvm::map_range(
+          cpus,
+          [](unsigned cpu) { return llvm::formatv("{{{0}}", cpu).str(); }),
+      ",");
+  setenv("OMP_PLACES", places.c_str(), /*overwrite=*/1);
+  setenv("OMP_PROC_BIND", "close", /*overwrite=*/1);
+  std::string cpuList = llvm::join(
+      llvm::map_range(cpus, [](unsigned cpu) { return llvm::utostr(cpu); }),
+      ",");
+  setenv("TPP_THREAD_CPUS", cpuList.c_str(), /*overwrite=*/1);
+
+  // The runtimes default to a thread per hardware thread, which would double
+  // up on the cores without SMT.
+  if (!readNumThreads()) {
+    std::string numThreads = llvm::utostr(cpus.size());
+    setenv("OMP_NUM_THREADS", numThreads.c_str(), /*overwrite=*/1);
+    setenv("TPP_NUM_THREADS", numThreads.c_str(), /*overwrite=*/1);
+  }
+}
+
+unsigned mlir::tpp::getNumThreads() {
+  if (unsigned numThreads = readNumThreads())
+    return numThreads;
+  return llvm::hardware_concurrency().compute_thread_count();
+}
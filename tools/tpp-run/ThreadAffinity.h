@@ -0,0 +1,43 @@
+//===- ThreadAffinity.h - Placement of the runtime threads ------*- C++ -*-===//
+//
+// This file is licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Binds the threads of the parallel runtimes to the CPUs of the host, in the
+// order given by a placement policy, so that the benchmarks don't depend on
+// the OS migrating the threads nor on the user setting the OpenMP affinity.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "mlir/Support/LogicalResult.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace mlir {
+namespace tpp {
+
+/// Returns the CPUs the threads are bound to, thread i on the CPU i (modulo
+/// their number), among the CPUs the process may run on:
+///   compact: the SMT siblings of a core, then the next core of the socket;
+///   socket:  the cores of a socket, then their SMT siblings, then the next
+///            socket;
+///   scatter: a core of each socket in turn, then the SMT siblings.
+/// With `noSmt`, only the first hardware thread of each core is used.
+FailureOr<SmallVector<unsigned>> getThreadCpus(StringRef policy, bool noSmt);
+
+/// Binds the threads of the OpenMP and task runtimes to `cpus`, through
+/// OMP_PLACES/OMP_PROC_BIND and TPP_THREAD_CPUS. Without a thread count in
+/// the environment, runs a thread per CPU. Must be called before the
+/// runtimes start their threads.
+void bindThreads(ArrayRef<unsigned> cpus);
+
+/// Returns the number of threads of the parallel runtimes.
+unsigned getNumThreads();
+
+} // namespace tpp
+} // namespace mlir
@@ -13,18 +13,51 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "Autotuner.h"
+#include "ConcurrentBench.h"
+#include "KernelServer.h"
+#include "RegressionCheck.h"
+#include "ThreadAffinity.h"
+
 #include "TPP/Runner/MLIRBench.h"
 
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/CodeGen/ParallelCG.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/Mangling.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Linker/Linker.h"
 #include "llvm/MC/TargetRegistry.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA256.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
+#include "llvm/TargetParser/Host.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
 
 #include "TPP/Transforms/Utils/TensorInit.h"
+#include "mlir/AsmParser/AsmParser.h"
 #include "mlir/Dialect/Arith/IR/Arith.h"
 #include "mlir/Dialect/Arith/Transforms/Passes.h"
+#include "mlir/Dialect/DLTI/DLTI.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
 #include "mlir/Dialect/Linalg/Passes.h"
@@ -38,6 +71,7 @@
 #include "mlir/IR/BuiltinAttributes.h"
 #include "mlir/IR/BuiltinTypes.h"
 #include "mlir/IR/Diagnostics.h"
+#include "mlir/IR/DialectResourceBlobManager.h"
 #include "mlir/IR/Dialect.h"
 #include "mlir/IR/Location.h"
 #include "mlir/IR/ValueRange.h"
@@ -51,6 +85,8 @@
 #include "mlir/Target/LLVMIR/Export.h"
 #include "mlir/Target/LLVMIR/ModuleTranslation.h"
 
+#include "MemoryRunnerUtils.h"
+#include "TPP/CompileTimeReport.h"
 #include "TPP/Dialect/Check/CheckDialect.h"
 #include "TPP/Dialect/Perf/PerfDialect.h"
 #include "TPP/Dialect/Xsmm/XsmmDialect.h"
@@ -59,6 +95,10 @@
 #include "TPP/Passes.h"
 
 #include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <optional>
 
 using namespace mlir;
 
@@ -67,11 +107,172 @@ llvm::cl::opt<unsigned>
     benchNumLoops("n", llvm::cl::desc("Number of loops for benchmarks"),
                   llvm::cl::value_desc("int"), llvm::cl::init(1));
 
+// Collect hardware counters for benchmarks. The events of all the threads the
+// kernel starts are counted, worker threads which existed before the runtime
+// library was loaded are not.
+llvm::cl::opt<bool> perfCounters(
+    "perf-counters",
+    llvm::cl::desc("Print hardware counters of the benchmark loop (cycles, "
+                   "instructions, L1D/L2/LLC misses, FP ops)"),
+    llvm::cl::init(false));
+
+// Collect the energy of benchmarks
+llvm::cl::opt<bool> perfEnergy(
+    "perf-energy",
+    llvm::cl::desc("Print the package and DRAM energy per iteration of the "
+                   "benchmark loop and the GFLOP/J of the kernel (RAPL)"),
+    llvm::cl::init(false));
+
+// Time the GPU kernels on the device
+llvm::cl::opt<bool> deviceTimer(
+    "device-timer",
+    llvm::cl::desc("Also print the mean GPU kernel time of the benchmark "
+                   "loop, measured on the device"),
+    llvm::cl::init(false));
+
+// Subtract the empty benchmark loop time
+llvm::cl::opt<bool> benchSubtractOverhead(
+    "bench-subtract-overhead",
+    llvm::cl::desc("Subtract the empty benchmark loop time from the mean"),
+    llvm::cl::init(false));
+
+// Print per-iteration statistics
+llvm::cl::opt<bool> benchStats(
+    "bench-stats",
+    llvm::cl::desc("Print min, p50, p90, p99 and max of the benchmark loop"),
+    llvm::cl::init(false));
+
+// Dump per-iteration deltas
+llvm::cl::opt<std::string>
+    benchDumpDeltas("bench-dump-deltas",
+                    llvm::cl::desc("Write every benchmark iteration time to "
+                                   "the given file"),
+                    llvm::cl::value_desc("filename"), llvm::cl::init(""));
+
+// Report per-iteration deltas
+llvm::cl::opt<bool> benchSamples(
+    "bench-samples",
+    llvm::cl::desc("Report every benchmark iteration time in the JSON output, "
+                   "to use it as a -baseline"),
+    llvm::cl::init(false));
+
+// Performance regression check
+llvm::cl::opt<std::string> baselineFile(
+    "baseline",
+    llvm::cl::desc("Compare the benchmark iterations with the ones of a JSON "
+                   "output recorded with -bench-samples, and fail on a "
+                   "significant slowdown"),
+    llvm::cl::value_desc("filename"), llvm::cl::init(""));
+
+llvm::cl::opt<std::string> baselineTolerance(
+    "tolerance",
+    llvm::cl::desc("Slowdown over the -baseline tolerated before it is "
+                   "reported as a regression"),
+    llvm::cl::value_desc("percent"), llvm::cl::init("5%"));
+
+// Cold cache benchmarks
+llvm::cl::opt<bool> flushCache(
+    "flush-cache",
+    llvm::cl::desc("Flush caches before each benchmark iteration (not timed)"),
+    llvm::cl::init(false));
+
+// Roofline metrics
+llvm::cl::opt<bool> roofline(
+    "roofline",
+    llvm::cl::desc("Print GFLOP/s, GB/s and FLOP/byte of the kernel, "
+                   "estimated from its linalg ops"),
+    llvm::cl::init(false));
+
+// Thread scaling sweep
+llvm::cl::opt<unsigned> sweepThreads(
+    "sweep-threads",
+    llvm::cl::desc("Benchmark at 1, 2, 4, ... up to the given number of "
+                   "threads, compiling once"),
+    llvm::cl::value_desc("int"), llvm::cl::init(0));
+
+// Several kernels of the same module benchmarked in one process
+llvm::cl::list<std::string> kernelNames(
+    "kernels",
+    llvm::cl::desc("Benchmark each of these functions in turn, reporting "
+                   "their results together under the entry point (-e)"),
+    llvm::cl::value_desc("name,..."), llvm::cl::CommaSeparated);
+
+// Kernel inputs from tensor files
+llvm::cl::opt<std::string> inputDir(
+    "input",
+    llvm::cl::desc("Memory-map argN.npy or argN.bin (raw) files of the given "
+                   "directory into the kernel arguments"),
+    llvm::cl::value_desc("dir"), llvm::cl::init(""));
+
+// Kernel inputs filled at startup
+llvm::cl::opt<bool> runtimeInit(
+    "runtime-init",
+    llvm::cl::desc("Fill the kernel arguments in parallel at startup instead "
+                   "of embedding them as dense constants"),
+    llvm::cl::init(false));
+
+// Kernel argument page placement
+llvm::cl::opt<std::string> numaPolicy(
+    "numa",
+    llvm::cl::desc("NUMA placement of the kernel arguments: interleaved over "
+                   "all nodes, first touched by the threads using them, or "
+                   "the blocked weights split over the nodes"),
+    llvm::cl::value_desc("interleave,first-touch,shard"), llvm::cl::init(""));
+
+llvm::cl::opt<std::string>
+    hugePages("huge-pages",
+              llvm::cl::desc("Back the kernel arguments with huge pages"),
+              llvm::cl::value_desc("2MB,1GB"), llvm::cl::init(""));
+
+// Sizes of the dynamic kernel arguments
+llvm::cl::list<int64_t> dynamicSizes(
+    "dynamic-sizes",
+    llvm::cl::desc("Sizes of the dynamic dimensions of the kernel arguments, "
+                   "in order; the last one repeats for the others"),
+    llvm::cl::value_desc("size,..."), llvm::cl::CommaSeparated);
+
+// Placement of the threads of the parallel runtimes
+llvm::cl::opt<std::string> bindThreads(
+    "bind-threads",
+    llvm::cl::desc("Bind the threads of the parallel loops to the CPUs: the "
+                   "SMT siblings of a core first, the cores of a socket "
+                   "first, or across the sockets"),
+    llvm::cl::value_desc("compact,socket,scatter"), llvm::cl::init(""));
+
+llvm::cl::opt<bool> bindNoSmt(
+    "bind-no-smt",
+    llvm::cl::desc("Bind a single thread per core, the SMT siblings are "
+                   "left idle"),
+    llvm::cl::init(false));
+
+llvm::cl::opt<bool>
+    printThreadBinding("print-thread-binding",
+                       llvm::cl::desc("Print the CPU of each thread"),
+                       llvm::cl::init(false));
+
+// Benchmark output format
+llvm::cl::opt<std::string>
+    outputFormat("output-format",
+                 llvm::cl::desc("Benchmark output format (text, json)"),
+                 llvm::cl::value_desc("text,json"), llvm::cl::init("text"));
+
 // Print result
 llvm::cl::opt<bool> printKernelResult("print",
                                       llvm::cl::desc("Print kernel result"),
                                       llvm::cl::init(false));
 
+// Check the kernel against a loops reference
+llvm::cl::opt<bool>
+    validate("validate",
+             llvm::cl::desc("Check the kernel results against the ones of "
+                            "the kernel lowered to loops"),
+             llvm::cl::init(false));
+
+llvm::cl::opt<double> validateThreshold(
+    "validate-threshold",
+    llvm::cl::desc("Largest absolute difference to the reference results"),
+    llvm::cl::value_desc("float"), llvm::cl::init(1e-3));
+
 // Replace dense splat tensors with random dense
 llvm::cl::opt<bool>
     splatRandom("splat-to-random",
@@ -114,7 +315,8 @@ llvm::cl::opt<std::string>
 // Target FPU name
 // Default avx2 is old enough to be relevant for most cases
 llvm::cl::opt<std::string>
-    fpuName("fpu", llvm::cl::desc("FPU name (avx, avx2, avx512bf16)"),
+    fpuName("fpu",
+            llvm::cl::desc("FPU name (avx, avx2, avx512bf16, sve, sme)"),
 #if defined(__x86_64__)
             llvm::cl::init("sse4.2"));
 #elif defined(__aarch64__)
@@ -147,6 +349,604 @@ llvm::cl::opt<bool>
                llvm::cl::desc("Kernel buffers are allocated on GPU"),
                llvm::cl::init(true));
 
+// Persistent compilation cache
+llvm::cl::opt<std::string> compileCacheDir(
+    "compile-cache",
+    llvm::cl::desc("Directory to cache the optimized LLVM module across runs"),
+    llvm::cl::value_desc("dir"), llvm::cl::init(""));
+
+llvm::cl::opt<bool> compileCacheFunctions(
+    "compile-cache-functions",
+    llvm::cl::desc("Compile and cache the functions of -emit separately, to "
+                   "only recompile the changed ones"),
+    llvm::cl::init(false));
+
+// Ahead-of-time compilation
+llvm::cl::opt<std::string>
+    emitKind("emit",
+             llvm::cl::desc("Compile the kernel to a file instead of running "
+                            "it (obj, so)"),
+             llvm::cl::value_desc("obj,so"), llvm::cl::init(""));
+
+llvm::cl::opt<std::string>
+    emitOutput("emit-output",
+               llvm::cl::desc("Output file of -emit, default <kernel>.o/.so"),
+               llvm::cl::value_desc("filename"), llvm::cl::init(""));
+
+// Persistent execution of the kernel
+llvm::cl::opt<std::string> serveSocket(
+    "serve",
+    llvm::cl::desc("Compile the kernel once and run it on the requests of "
+                   "the clients of the given Unix socket"),
+    llvm::cl::value_desc("socket"), llvm::cl::init(""));
+
+// Concurrent execution of instances of the kernel
+llvm::cl::opt<unsigned> concurrentKernels(
+    "concurrent-kernels",
+    llvm::cl::desc("Run instances of the kernel concurrently, each on a "
+                   "thread team of its share of the CPUs, and compare their "
+                   "throughput with serial execution"),
+    llvm::cl::value_desc("int"), llvm::cl::init(0));
+
+// Parallel LLVM optimization and code generation
+llvm::cl::opt<unsigned> compileThreads(
+    "compile-threads",
+    llvm::cl::desc("Split the LLVM module to optimize it on multiple threads"),
+    llvm::cl::value_desc("int"), llvm::cl::init(1));
+
+// Large constants of the input, e.g. the weights of a bytecode file, read in
+// place by the JIT'd kernel
+llvm::cl::opt<bool> mapResources(
+    "map-resources",
+    llvm::cl::desc("Bind the large constant dense resources to the kernel in "
+                   "place instead of copying them into the LLVM module"),
+    llvm::cl::init(true));
+
+// Compile-time breakdown
+llvm::cl::opt<bool>
+    printCompileTime("print-compile-time",
+                     llvm::cl::desc("Print the MLIR and LLVM compile times"),
+                     llvm::cl::init(false));
+
+// Structured compile-time breakdown
+llvm::cl::opt<std::string> compileTimeReport(
+    "compile-time-report",
+    llvm::cl::desc("Write the compile-time breakdown as JSON (- for stderr)"),
+    llvm::cl::value_desc("filename"), llvm::cl::init(""));
+
+// Heap and resident set of the compilation and the execution
+llvm::cl::opt<bool> memoryReport(
+    "memory-report",
+    llvm::cl::desc("Print the resident set of the compilation and the "
+                   "execution, and the heap allocations of the kernel"),
+    llvm::cl::init(false));
+
+// Achieved performance of the XSMM kernels, read back by -profile-in
+llvm::cl::opt<std::string> profileOut(
+    "profile-out",
+    llvm::cl::desc("Write the achieved performance of the XSMM kernels of "
+                   "the run to the file, as JSON"),
+    llvm::cl::value_desc("filename"), llvm::cl::init(""));
+
+// Search of the tiling and parallelization options
+llvm::cl::opt<bool>
+    autotune("autotune",
+             llvm::cl::desc("Benchmark the pipeline tuning options and keep "
+                            "the fastest"),
+             llvm::cl::init(false));
+
+llvm::cl::opt<unsigned> autotuneJobs(
+    "autotune-jobs",
+    llvm::cl::desc("Number of configurations benchmarked concurrently"),
+    llvm::cl::value_desc("int"), llvm::cl::init(1));
+
+// Best known tuning options, TPP_TUNING_DB if not given, empty to disable
+llvm::cl::opt<std::string> tuningDb(
+    "tuning-db",
+    llvm::cl::desc("Tuning database recorded by -autotune and applied to "
+                   "later runs"),
+    llvm::cl::value_desc("filename"), llvm::cl::init(""));
+
+// Key of the kernel in the tuning database, to edit or seed it by hand
+llvm::cl::opt<bool> printTuningKey(
+    "print-tuning-key",
+    llvm::cl::desc("Print the tuning database key of the kernel and exit"),
+    llvm::cl::init(false));
+
+// Tensor-parallel ranks, launched by the first one
+llvm::cl::opt<unsigned> tensorParallel(
+    "tensor-parallel",
+    llvm::cl::desc("Shard the matmuls of the kernel across this many "
+                   "processes, launched by tpp-run"),
+    llvm::cl::value_desc("int"), llvm::cl::init(1));
+
+llvm::cl::opt<std::string> tensorParallelMode(
+    "tensor-parallel-mode",
+    llvm::cl::desc("Sharding of the matmuls: by output columns, gathered, or "
+                   "by reduction rows, reduced"),
+    llvm::cl::value_desc("column,row"), llvm::cl::init("column"));
+
+// Data-parallel ranks, launched by the first one
+llvm::cl::opt<unsigned> dataParallel(
+    "data-parallel",
+    llvm::cl::desc("Split the batch of the kernel across this many "
+                   "processes, launched by tpp-run, one per GPU with -gpu"),
+    llvm::cl::value_desc("int"), llvm::cl::init(1));
+
+llvm::cl::opt<unsigned>
+    tensorParallelRank("tensor-parallel-rank",
+                       llvm::cl::desc("Rank of a launched process"),
+                       llvm::cl::Hidden, llvm::cl::init(0));
+
+// Compile-time breakdown and kernel name for the JSON report
+static double mlirCompileTime = 0.0;
+static double llvmCompileTime = 0.0;
+static tpp::CompileTimeReport compileTimes;
+static std::string reportKernelName;
+// Resident set at the end of the compilation, for the memory report
+static uint64_t compileRss = 0;
+static uint64_t compilePeakRss = 0;
+
+// Cached module of this run, set when the input hits the compilation cache
+static std::string cachedModulePath;
+// CPUs of the bound threads, in thread order
+static SmallVector<unsigned> threadCpus;
+// Cache entry to write once the module is optimized, on a cache miss
+static std::string cacheEntryPath;
+// All options of this run, part of the cache key
+static std::string commandLine;
+// Path and arguments of this tool, to benchmark the autotuning candidates
+static std::string toolPath;
+static SmallVector<std::string> toolArgs;
+// The other ranks of a -tensor-parallel or -data-parallel run, launched by
+// rank 0
+static SmallVector<llvm::sys::ProcessInfo> rankProcesses;
+// Tolerated slowdown over the baseline, as a fraction
+static double baselineSlowdown = 0.0;
+// Data of the dense resources bound in place to the JIT'd kernel, by symbol
+static llvm::StringMap<const void *> mappedResources;
+
+// Constant globals of dense resources this large and up are bound in place,
+// the smaller ones stay in the LLVM module, where loads can fold
+static constexpr size_t kMinMappedResourceBytes = 4096;
+
+// Turns the large constant globals of dense resources into declarations,
+// bound to the data of their resource when the kernel is JIT'd. Parsed from
+// bytecode, the data is the memory-mapped input itself: it is neither copied
+// into the LLVM module nor optimized and emitted with the code.
+static void mapResourceGlobals(ModuleOp module) {
+  for (auto global : module.getOps<LLVM::GlobalOp>()) {
+    auto resource =
+        dyn_cast_or_null<DenseResourceElementsAttr>(global.getValueOrNull());
+    if (!global.getConstant() || !resource)
+      continue;
+    AsmResourceBlob *blob = resource.getRawHandle().getBlob();
+    if (!blob || blob->getData().size() < kMinMappedResourceBytes)
+      continue;
+    mappedResources[global.getSymName()] = blob->getData().data();
+    global.removeValueAttr();
+    global.setLinkage(LLVM::Linkage::External);
+    global.setDsoLocal(false);
+  }
+}
+
+static llvm::orc::SymbolMap
+getMappedResources(llvm::orc::MangleAndInterner interner) {
+  llvm::orc::SymbolMap symbols;
+  for (const auto &[name, data] : mappedResources) {
+    symbols[interner(name)] = {llvm::orc::ExecutorAddr::fromPtr(data),
+                               llvm::JITSymbolFlags::Exported};
+  }
+  return symbols;
+}
+
+static double getElapsedSeconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Print the compile-time breakdown, to compare across -compile-threads. The
+// JIT code generation happens later, within the execution engine, so only
+// ahead-of-time compilation reports it.
+static void printCompileTimes() {
+  if (printCompileTime)
+    llvm::errs() << llvm::format("Compile time: MLIR %.3fs, LLVM %.3fs "
+                                 "(%u threads)\n",
+                                 mlirCompileTime, llvmCompileTime,
+                                 compileThreads.getValue());
+  if (!compileTimeReport.empty() && emitKind.empty())
+    (void)compileTimes.write(compileTimeReport);
+}
+
+// Returns the host side information of the JSON report.
+static llvm::json::Object getJsonReportHeader() {
+  unsigned threads = llvm::hardware_concurrency().compute_thread_count();
+  if (const char *ompThreads = getenv("OMP_NUM_THREADS"))
+    threads = std::max(atoi(ompThreads), 1);
+
+  llvm::json::Object header{
+      {"kernel", reportKernelName},
+      {"iterations", static_cast<int64_t>(benchNumLoops)},
+      {"threads", static_cast<int64_t>(threads)},
+      {"options", llvm::json::Object{{"triple", triple.getValue()},
+                                     {"cpu", cpuName.getValue()},
+                                     {"fpu", fpuName.getValue()},
+                                     {"opt_level", optLevel.getValue()},
+                                     {"gpu", defGpuBackend.getValue()},
+                                     {"init_type", initType.getValue()},
+                                     {"seed", seed.getValue()},
+                                     {"runtime_init", runtimeInit.getValue()},
+                                     {"numa", numaPolicy.getValue()},
+                                     {"huge_pages", hugePages.getValue()},
+                                     {"bind_threads", bindThreads.getValue()},
+                                     {"bind_no_smt", bindNoSmt.getValue()},
+                                     {"flush_cache", flushCache.getValue()},
+                                     {"compile_threads",
+                                      compileThreads.getValue()}}},
+      {"compile_time", llvm::json::Object{{"mlir", mlirCompileTime},
+                                          {"llvm", llvmCompileTime}}},
+      {"compile_cache_hit", !cachedModulePath.empty()}};
+  if (!threadCpus.empty()) {
+    llvm::json::Array cpus;
+    for (unsigned thread = 0; thread < threads; ++thread)
+      cpus.push_back(static_cast<int64_t>(
+          threadCpus[thread % threadCpus.size()]));
+    header["thread_cpus"] = std::move(cpus);
+  }
+  return header;
+}
+
+// Pass the host side information to the perf runtime, which prints it along
+// with the benchmark results as a single JSON object.
+static void setJsonReportHeader() {
+  // The runtime expects the members only, drop the enclosing braces.
+  std::string members;
+  llvm::raw_string_ostream os(members);
+  os << llvm::json::Value(getJsonReportHeader());
+  os.flush();
+  members = members.substr(1, members.size() - 2);
+  setenv("TPP_PERF_REPORT_HEADER", members.c_str(), /*overwrite=*/1);
+}
+
+// The weights sharded with -numa=shard are split over the nodes in order, by
+// output columns: unless given, the threads fill the sockets in order and the
+// parallel loops split the output columns over them.
+static void applyNumaSharding() {
+  if (numaPolicy != "shard")
+    return;
+  if (bindThreads.getNumOccurrences() == 0)
+    bindThreads = "socket";
+  (void)tpp::applyTuningConfig({{"distribute-last-dim", "true"}});
+}
+
+// Returns the trimmed contents of the kernel file `path`, empty if unreadable.
+static std::string readSysFile(const Twine &path) {
+  // Kernel files report no size, read them as streams.
+  auto buffer = llvm::MemoryBuffer::getFileAsStream(path);
+  if (!buffer)
+    return {};
+  return (*buffer)->getBuffer().trim().str();
+}
+
+// Returns true if the GPU of the backend shares the host memory: the GPU of
+// a NVIDIA Tegra SoC, or an Intel GPU integrated in the CPU, device 00:02.0
+// of the root PCI bus, when it is the only Intel display controller.
+static bool isIntegratedGpu() {
+  if (defGpuBackend == "cuda") {
+    return StringRef(readSysFile("/proc/device-tree/compatible"))
+        .contains("nvidia,tegra");
+  }
+  if (defGpuBackend != "intel")
+    return false;
+  unsigned numIntelGpus = 0;
+  bool hasIntegratedGpu = false;
+  std::error_code error;
+  for (llvm::sys::fs::directory_iterator it("/sys/bus/pci/devices", error), end;
+       it != end && !error; it.increment(error)) {
+    const std::string &path = it->path();
+    if (readSysFile(path + "/vendor") != "0x8086" ||
+        !StringRef(readSysFile(path + "/class")).starts_with("0x03"))
+      continue;
+    numIntelGpus++;
+    hasIntegratedGpu |= llvm::sys::path::filename(path) == "0000:00:02.0";
+  }
+  return hasIntegratedGpu && numIntelGpus == 1;
+}
+
+// The kernels of an integrated GPU access the host buffers in place, unless
+// -gpu-shared-memory is given.
+static void applySharedGpuMemory() {
+  if (defGpuBackend.empty() || !isIntegratedGpu())
+    return;
+  (void)tpp::applyTuningConfig({{"gpu-shared-memory", "true"}});
+}
+
+// Returns true if the GPU kernels use the host memory in place.
+static bool useSharedGpuMemory() {
+  auto *sharedMemory = static_cast<llvm::cl::opt<bool> *>(
+      llvm::cl::getRegisteredOptions().lookup("gpu-shared-memory"));
+  return sharedMemory && *sharedMemory;
+}
+
+// Returns the environment variable selecting the visible devices of the GPU
+// backend, empty if there is none.
+static StringRef getVisibleDevicesVar() {
+  if (defGpuBackend == "cuda")
+    return "CUDA_VISIBLE_DEVICES";
+  if (defGpuBackend == "intel")
+    return "ZE_AFFINITY_MASK";
+  return "";
+}
+
+// Makes the device of `rank` the only one visible to the processes launched
+// next: the rank-th of the visible `devices`, all of them if empty, wrapping
+// around if there are fewer devices than ranks.
+static void selectRankDevice(unsigned rank, ArrayRef<std::string> devices) {
+  StringRef var = getVisibleDevicesVar();
+  if (var.empty())
+    return;
+  std::string device = devices.empty() ? std::to_string(rank)
+                                       : devices[rank % devices.size()];
+  setenv(var.str().c_str(), device.c_str(), /*overwrite=*/1);
+}
+
+// Launches the other ranks of a -tensor-parallel or -data-parallel run: the
+// same command line with their rank, the standard output of which is dropped.
+// The ranks find each other through the environment of the collective
+// runtime. Each rank of a data-parallel GPU run gets its own device.
+static LogicalResult launchRanks(Operation *op) {
+  if (tensorParallel > 1 && dataParallel > 1)
+    return op->emitOpError("-tensor-parallel and -data-parallel are "
+                           "exclusive");
+  unsigned numRanks = std::max(tensorParallel, dataParallel);
+  if (numRanks <= 1)
+    return success();
+  if (tensorParallelMode != "column" && tensorParallelMode != "row")
+    return op->emitOpError("Invalid tensor parallel mode " +
+                           tensorParallelMode);
+  if (autotune || !emitKind.empty())
+    return op->emitOpError("-tensor-parallel and -data-parallel take neither "
+                           "-autotune nor -emit");
+  // The rows of the ranks are gathered on the host.
+  if (dataParallel > 1 && !defGpuBackend.empty()) {
+    if (defGpuArgs.getNumOccurrences() && defGpuArgs)
+      return op->emitOpError("-data-parallel takes host kernel buffers "
+                             "(-gpu-args=false)");
+    defGpuArgs = false;
+  }
+  if (tensorParallelRank.getNumOccurrences()) {
+    setenv("TPP_RANK", std::to_string(tensorParallelRank).c_str(),
+           /*overwrite=*/1);
+    return success();
+  }
+
+  std::string name =
+      "tpp-tp-" + std::to_string(llvm::sys::Process::getProcessId());
+  setenv("TPP_NUM_RANKS", std::to_string(numRanks).c_str(),
+         /*overwrite=*/1);
+  setenv("TPP_COLLECTIVE_NAME", name.c_str(), /*overwrite=*/1);
+  setenv("TPP_RANK", "0", /*overwrite=*/1);
+  SmallVector<std::string> devices;
+  StringRef devicesVar = getVisibleDevicesVar();
+  if (dataParallel > 1 && !devicesVar.empty()) {
+    if (const char *visible = getenv(devicesVar.str().c_str())) {
+      SmallVector<StringRef> parts;
+      StringRef(visible).split(parts, ',', /*MaxSplit=*/-1,
+                               /*KeepEmpty=*/false);
+      for (StringRef part : parts)
+        devices.push_back(part.trim().str());
+    }
+  }
+  std::optional<StringRef> redirects[] = {std::nullopt, StringRef(""),
+                                          std::nullopt};
+  for (unsigned rank = 1; rank < numRanks; rank++) {
+    if (dataParallel > 1)
+      selectRankDevice(rank, devices);
+    std::string rankArg = "-tensor-parallel-rank=" + std::to_string(rank);
+    SmallVector<StringRef> args{toolPath};
+    args.append(toolArgs.begin(), toolArgs.end());
+    args.push_back(rankArg);
+    std::string errMsg;
+    auto process = llvm::sys::ExecuteNoWait(toolPath, args,
+                                            /*Env=*/std::nullopt, redirects,
+                                            /*MemoryLimit=*/0, &errMsg);
+    if (process.Pid == llvm::sys::ProcessInfo::InvalidPid)
+      return op->emitOpError("Failed to launch rank " + std::to_string(rank) +
+                             ": " + errMsg);
+    rankProcesses.push_back(process);
+  }
+  if (dataParallel > 1)
+    selectRankDevice(/*rank=*/0, devices);
+  return success();
+}
+
+// Waits for the other ranks of a -tensor-parallel or -data-parallel run. They
+// are killed if this one failed, since they would wait for it at the next
+// collective.
+static int waitForRanks(int ret) {
+  for (auto &process : rankProcesses) {
+    if (ret != 0)
+      ::kill(process.Pid, SIGKILL);
+    auto result = llvm::sys::Wait(process, /*SecondsToWait=*/std::nullopt);
+    if (result.ReturnCode != 0)
+      ret = EXIT_FAILURE;
+  }
+  return ret;
+}
+
+// Binds the threads of the parallel runtimes with -bind-threads, before they
+// start on the first parallel loop of the kernel.
+static LogicalResult applyThreadBinding(Operation *op) {
+  if (bindThreads.empty()) {
+    if (bindNoSmt || printThreadBinding)
+      return op->emitOpError("-bind-no-smt and -print-thread-binding require "
+                             "-bind-threads");
+    return success();
+  }
+  auto cpus = tpp::getThreadCpus(bindThreads, bindNoSmt);
+  if (failed(cpus))
+    return op->emitOpError("Invalid thread binding " + bindThreads);
+  tpp::bindThreads(*cpus);
+  threadCpus = std::move(*cpus);
+
+  if (printThreadBinding) {
+    llvm::errs() << "Thread binding (" << bindThreads
+                 << (bindNoSmt ? ", no SMT" : "") << "):";
+    for (unsigned thread = 0, e = tpp::getNumThreads(); thread < e; ++thread)
+      llvm::errs() << " " << thread << "->"
+                   << threadCpus[thread % threadCpus.size()];
+    llvm::errs() << "\n";
+  }
+  return success();
+}
+
+// Returns the cache entry of the input module. The key covers the input IR,
+// the command line and the tpp-run binary, by its modification time and size,
+// so that relinking it against changed pass libraries invalidates the entries.
+// Pass libraries loaded as shared objects are not covered, clear the cache
+// after rebuilding them.
+static std::string getCacheEntryPath(ModuleOp module) {
+  std::string key;
+  llvm::raw_string_ostream os(key);
+  os << LLVM_VERSION_STRING << '\0';
+  llvm::sys::fs::file_status toolStatus;
+  if (!llvm::sys::fs::status(toolPath, toolStatus)) {
+    os << toolStatus.getLastModificationTime().time_since_epoch().count()
+       << ' ' << toolStatus.getSize();
+  }
+  os << '\0';
+  os << commandLine << '\0';
+  // The code is generated for the host unless a target is given on the
+  // command line. A cache shared across machines must not load the code of
+  // another ISA.
+  if (auto host = llvm::orc::JITTargetMachineBuilder::detectHost()) {
+    os << host->getTargetTriple().str() << '\0' << host->getCPU() << '\0'
+       << host->getFeatures().getString() << '\0';
+  } else {
+    llvm::consumeError(host.takeError());
+    os << llvm::sys::getHostCPUName() << '\0';
+  }
+  // The lowering follows the contents of the profile, not only its name.
+  auto *profileIn = static_cast<llvm::cl::opt<std::string> *>(
+      llvm::cl::getRegisteredOptions().lookup("profile-in"));
+  if (profileIn && !profileIn->empty()) {
+    if (auto buffer = llvm::MemoryBuffer::getFile(*profileIn))
+      os << (*buffer)->getBuffer();
+  }
+  os << '\0';
+  module->print(os);
+  os.flush();
+
+  auto hash = llvm::SHA256::hash(llvm::arrayRefFromStringRef(key));
+  SmallString<128> path(compileCacheDir);
+  llvm::sys::path::append(path, llvm::toHex(hash, /*LowerCase=*/true) + ".bc");
+  return std::string(path);
+}
+
+// Replaces the module with a stub entry point. The JIT runner only checks the
+// entry point exists, the code comes from the cached module.
+static void stubCachedModule(ModuleOp module, JitRunnerOptions &options) {
+  module.getBody()->clear();
+  OpBuilder builder(module.getBodyRegion());
+  auto loc = module.getLoc();
+  auto funcType = LLVM::LLVMFunctionType::get(
+      LLVM::LLVMVoidType::get(module.getContext()), {});
+  auto func =
+      builder.create<LLVM::LLVMFuncOp>(loc, options.mainFuncName, funcType);
+  builder.setInsertionPointToStart(func.addEntryBlock());
+  builder.create<LLVM::ReturnOp>(loc, ValueRange{});
+}
+
+static llvm::Error compileAheadOfTime(ModuleOp module);
+static llvm::Error compileFunctionsAheadOfTime(ModuleOp module);
+[[noreturn]] static void runKernelEntry(ModuleOp module,
+                                        const tpp::KernelSignature &signature);
+
+// Set once the MLIR transformer did all the work of the run, like writing the
+// ahead-of-time output: it then fails to stop JitRunnerMain before the JIT,
+// and tpp-run still succeeds.
+static bool transformerDone = false;
+
+// Reports the outcome of the ahead-of-time compilation, which always stops
+// the pipeline.
+static LogicalResult finishAheadOfTime(llvm::Error err) {
+  if (err)
+    llvm::logAllUnhandledErrors(std::move(err), llvm::errs(), "ERROR: ");
+  else
+    transformerDone = true;
+  return failure();
+}
+
+// Applies the tuning options of the kernel: searched with -autotune, or looked
+// up in the tuning database otherwise. Options given on the command line are
+// kept, the applied ones become part of the cache key.
+static LogicalResult applyTuning(ModuleOp module, JitRunnerOptions &options) {
+  std::string dbPath = tuningDb;
+  if (!tuningDb.getNumOccurrences()) {
+    if (const char *envPath = getenv("TPP_TUNING_DB"))
+      dbPath = envPath;
+  }
+  if (!autotune && dbPath.empty() && !printTuningKey)
+    return success();
+
+  auto key = tpp::getTuningKey(module, options.mainFuncName, toolArgs);
+  if (printTuningKey) {
+    llvm::outs() << key << "\n";
+    transformerDone = true;
+    return failure();
+  }
+  tpp::TuningDatabase db(dbPath);
+  tpp::TuningConfig config;
+  if (autotune) {
+    auto candidates = tpp::getTuningCandidates();
+    if (candidates.empty())
+      return module->emitOpError("Autotune: all tuned options are fixed");
+    llvm::errs() << "Autotune: benchmarking " << candidates.size()
+                 << " configurations\n";
+    auto best =
+        tpp::runAutotuner(toolPath, toolArgs, candidates, autotuneJobs);
+    if (failed(best))
+      return module->emitOpError("Autotune: no configuration ran");
+    llvm::errs() << "Autotune: best configuration: "
+                 << tpp::formatTuningConfig(best->first)
+                 << llvm::format(" (mean %.9e)\n", best->second);
+    if (!dbPath.empty() && failed(db.record(key, best->first, best->second)))
+      return failure();
+    config = best->first;
+  } else if (auto known = db.lookup(key)) {
+    config = *known;
+  }
+
+  for (auto &[name, value] : tpp::applyTuningConfig(config))
+    commandLine += "-" + name + "=" + value + '\0';
+  return success();
+}
+
+// The scalable vector lowerings are selected by the DLTI spec of the module,
+// describe the SVE and SME features requested by `--fpu` unless the module
+// already describes its target.
+static LogicalResult setScalableTargetSpec(ModuleOp module) {
+  StringRef fpu = fpuName;
+  bool hasSme = fpu.contains("sme");
+  if (!(hasSme || fpu.contains("sve")) ||
+      module->hasAttr(DLTIDialect::kTargetSystemDescAttrName))
+    return success();
+
+  MLIRContext *ctx = module.getContext();
+  ctx->getOrLoadDialect<DLTIDialect>();
+  std::string spec = "#dlti.target_system_spec<\"CPU\" = "
+                     "#dlti.target_device_spec<"
+                     "#dlti.dl_entry<\"has_sve\", 1 : i32>";
+  if (hasSme)
+    spec += ", #dlti.dl_entry<\"has_sme\", 1 : i32>";
+  spec += ">>";
+  Attribute attr = parseAttribute(spec, ctx);
+  if (!attr)
+    return module.emitOpError("Invalid target spec for FPU " + fpuName);
+  module->setAttr(DLTIDialect::kTargetSystemDescAttrName, attr);
+  return success();
+}
+
 // This function will be called by the pass manager after parsing,
 // so we can modify the IR with the needed wrappers
 static LogicalResult prepareMLIRKernel(Operation *op,
@@ -155,6 +955,142 @@ static LogicalResult prepareMLIRKernel(Operation *op,
   if (!module)
     return op->emitOpError("Expected a 'builtin.module' op");
 
+  // Results are only reported from the benchmark loop
+  if (outputFormat == "json" && benchNumLoops <= 1)
+    return op->emitOpError("JSON output requires benchmark loops (-n > 1)");
+
+  // The samples of both runs are compared through their JSON reports
+  if ((benchSamples || !baselineFile.empty()) && outputFormat != "json")
+    return op->emitOpError("Reporting the samples requires JSON output");
+  if (!baselineFile.empty()) {
+    if (!emitKind.empty() || !serveSocket.empty() || concurrentKernels ||
+        autotune || sweepThreads > 0)
+      return op->emitOpError("The baseline comparison requires the default "
+                             "benchmark loop");
+    StringRef tolerance = StringRef(baselineTolerance).trim();
+    tolerance.consume_back("%");
+    double percent;
+    if (tolerance.getAsDouble(percent) || percent < 0.0)
+      return op->emitOpError("Invalid tolerance " + baselineTolerance +
+                             ", expected a percentage");
+    baselineSlowdown = percent / 100.0;
+  }
+
+  if (!inputDir.empty() && !llvm::sys::fs::is_directory(inputDir))
+    return op->emitOpError("Input directory not found: " + inputDir);
+
+  if (!kernelNames.empty() && benchNumLoops <= 1)
+    return op->emitOpError("Multiple kernels require benchmark loops (-n > 1)");
+
+  if (!emitKind.empty()) {
+    if (!kernelNames.empty())
+      return op->emitOpError("Ahead-of-time compilation takes a single kernel");
+    if (emitKind != "obj" && emitKind != "so")
+      return op->emitOpError("Invalid -emit kind " + emitKind);
+    if (!defGpuBackend.empty())
+      return op->emitOpError("Ahead-of-time compilation only supports CPUs");
+    if (validate)
+      return op->emitOpError("Ahead-of-time compilation cannot validate, "
+                             "there is no benchmark wrapper");
+  }
+  if (memoryReport && !emitKind.empty())
+    return op->emitOpError("The memory report is only available when running "
+                           "the kernel");
+  if (!profileOut.empty()) {
+    if (!emitKind.empty() || !defGpuBackend.empty())
+      return op->emitOpError("The kernel profile is only available when "
+                             "running the kernel on CPUs");
+    // All the ranks would write the same file.
+    if (tensorParallel > 1)
+      return op->emitOpError("The kernel profile takes a single process");
+    // Read by the XSMM runtime on the first dispatch, once the kernel runs.
+    setenv("TPP_XSMM_PROFILE", profileOut.c_str(), /*overwrite=*/1);
+  }
+  if (!serveSocket.empty()) {
+    if (!emitKind.empty() || !kernelNames.empty() || autotune)
+      return op->emitOpError("The kernel server takes a single kernel to run");
+    if (!defGpuBackend.empty())
+      return op->emitOpError("The kernel server only supports CPUs");
+    if (tensorParallel > 1 || dataParallel > 1 || memoryReport || validate)
+      return op->emitOpError("The kernel server has no benchmark wrapper, it "
+                             "takes no -tensor-parallel, -data-parallel, "
+                             "-memory-report nor -validate");
+  }
+  if (concurrentKernels) {
+    if (!serveSocket.empty() || !emitKind.empty() || !kernelNames.empty() ||
+        autotune)
+      return op->emitOpError("The concurrent benchmark takes a single kernel "
+                             "to run");
+    if (!defGpuBackend.empty())
+      return op->emitOpError("The concurrent benchmark only supports CPUs");
+    if (tensorParallel > 1 || dataParallel > 1 || memoryReport || validate)
+      return op->emitOpError("The concurrent benchmark has no benchmark "
+                             "wrapper, it takes no -tensor-parallel, "
+                             "-data-parallel, -memory-report nor -validate");
+    // OpenMP has a single pool per process, only the task runtime has teams.
+    auto &registered = llvm::cl::getRegisteredOptions();
+    auto *defParallel =
+        static_cast<llvm::cl::opt<bool> *>(registered.lookup("def-parallel"));
+    auto *parallelRuntime = static_cast<llvm::cl::opt<std::string> *>(
+        registered.lookup("parallel-runtime"));
+    if (defParallel && *defParallel && parallelRuntime &&
+        parallelRuntime->getValue() != "tasks")
+      return op->emitOpError("The concurrent benchmark runs the kernels on "
+                             "thread teams, which require "
+                             "-parallel-runtime=tasks");
+  }
+  if (compileCacheFunctions && (emitKind.empty() || compileCacheDir.empty()))
+    return op->emitOpError("Caching the functions requires -emit and "
+                           "-compile-cache");
+
+  applyNumaSharding();
+  applySharedGpuMemory();
+  if (failed(applyThreadBinding(op)))
+    return failure();
+
+  if (failed(launchRanks(op)))
+    return failure();
+
+  if (autotune) {
+    if (benchNumLoops <= 1)
+      return op->emitOpError("Autotune requires benchmark loops (-n > 1)");
+    if (!kernelNames.empty() || !emitKind.empty())
+      return op->emitOpError("Autotune takes a single kernel to run");
+  }
+
+  // The tuned options must be set before the cache lookup
+  if (failed(applyTuning(module, options)))
+    return failure();
+
+  // The entry point of the server and of the concurrent benchmark is part of
+  // the cache key
+  std::optional<tpp::KernelSignature> entrySignature;
+  if (!serveSocket.empty() || concurrentKernels) {
+    auto signature = tpp::createKernelEntry(module, options.mainFuncName);
+    if (failed(signature))
+      return failure();
+    entrySignature = std::move(*signature);
+  }
+
+  // Skip the whole pipeline if this input was compiled before
+  if (!compileCacheDir.empty() && !compileCacheFunctions) {
+    auto entryPath = getCacheEntryPath(module);
+    if (llvm::sys::fs::exists(entryPath)) {
+      reportKernelName = options.mainFuncName;
+      cachedModulePath = entryPath;
+      if (!emitKind.empty())
+        return finishAheadOfTime(compileAheadOfTime(module));
+      if (entrySignature)
+        runKernelEntry(module, *entrySignature);
+      stubCachedModule(module, options);
+      return success();
+    }
+    cacheEntryPath = entryPath;
+  }
+
+  if (failed(setScalableTargetSpec(module)))
+    return failure();
+
   // A set of default passes that lower any input IR to LLVM
   PassManager passManager(module.getContext());
 
@@ -162,94 +1098,753 @@ static LogicalResult prepareMLIRKernel(Operation *op,
   if (failed(applyPassManagerCLOptions(passManager)))
     return failure();
 
-  tpp::TppRunnerWrapperOptions wrapperOpts;
-  wrapperOpts.kernelName = options.mainFuncName;
-  wrapperOpts.kernelType = options.mainFuncType;
-  wrapperOpts.backend = defGpuBackend;
-  wrapperOpts.offloadToDevice = defGpuArgs;
-  wrapperOpts.numBenchLoops = benchNumLoops;
-  // Warmup on GPUs are currently breaking buffer allocation on GPUs
-  wrapperOpts.benchWarmup = defGpuBackend.empty();
-  wrapperOpts.printResult = printKernelResult;
-  wrapperOpts.randomSplat = splatRandom;
-  wrapperOpts.seed = seed;
-  wrapperOpts.initType = initType;
-  passManager.addPass(tpp::createTppRunnerWrapper(wrapperOpts));
+  reportKernelName = options.mainFuncName;
+
+  // Ahead-of-time compilation exports the kernel itself with the C interface
+  // of its memref arguments, and the kernel server and the concurrent
+  // benchmark call it from their own entry point: none has a benchmark wrapper
+  // around the kernel.
+  if (!emitKind.empty()) {
+    auto kernel = module.lookupSymbol<func::FuncOp>(options.mainFuncName);
+    if (!kernel)
+      return op->emitOpError("Kernel function not found: " +
+                             options.mainFuncName);
+    kernel->setAttr(LLVM::LLVMDialect::getEmitCWrapperAttrName(),
+                    UnitAttr::get(module.getContext()));
+  } else if (!entrySignature) {
+    if (tensorParallel > 1) {
+      tpp::TensorParallelMatmulsOptions tensorParallelOpts;
+      tensorParallelOpts.numRanks = tensorParallel;
+      tensorParallelOpts.mode = tensorParallelMode;
+      passManager.addPass(
+          tpp::createTensorParallelMatmuls(tensorParallelOpts));
+    }
+    if (dataParallel > 1) {
+      tpp::DataParallelBatchOptions dataParallelOpts;
+      dataParallelOpts.numRanks = dataParallel;
+      passManager.addPass(tpp::createDataParallelBatch(dataParallelOpts));
+    }
+    tpp::TppRunnerWrapperOptions wrapperOpts;
+    wrapperOpts.kernelName = options.mainFuncName;
+    wrapperOpts.kernelNames =
+        SmallVector<std::string>{kernelNames.begin(), kernelNames.end()};
+    wrapperOpts.kernelType = options.mainFuncType;
+    wrapperOpts.backend = defGpuBackend;
+    wrapperOpts.offloadToDevice = defGpuArgs;
+    wrapperOpts.sharedMemory = useSharedGpuMemory();
+    wrapperOpts.numBenchLoops = benchNumLoops;
+    wrapperOpts.benchWarmup = true;
+    wrapperOpts.perfCounters = perfCounters;
+    wrapperOpts.perfEnergy = perfEnergy;
+    wrapperOpts.deviceTimer = deviceTimer;
+    wrapperOpts.subtractOverhead = benchSubtractOverhead;
+    wrapperOpts.benchStats = benchStats;
+    wrapperOpts.dumpDeltas = benchDumpDeltas;
+    wrapperOpts.reportSamples = benchSamples || !baselineFile.empty();
+    wrapperOpts.flushCache = flushCache;
+    wrapperOpts.roofline = roofline;
+    wrapperOpts.sweepThreads = sweepThreads;
+    wrapperOpts.inputDir = inputDir;
+    wrapperOpts.runtimeInit = runtimeInit;
+    wrapperOpts.numaPolicy = numaPolicy;
+    wrapperOpts.hugePages = hugePages;
+    wrapperOpts.dynamicSizes =
+        SmallVector<int64_t>{dynamicSizes.begin(), dynamicSizes.end()};
+    wrapperOpts.outputFormat = outputFormat;
+    wrapperOpts.printResult = printKernelResult;
+    wrapperOpts.validate = validate;
+    wrapperOpts.validateThreshold = validateThreshold;
+    wrapperOpts.randomSplat = splatRandom;
+    wrapperOpts.seed = seed;
+    wrapperOpts.initType = initType;
+    passManager.addPass(tpp::createTppRunnerWrapper(wrapperOpts));
+  }
+
+  // The functions go through the pipeline on their own, unless cached
+  if (compileCacheFunctions)
+    return finishAheadOfTime(compileFunctionsAheadOfTime(module));
 
   tpp::DefaultPipelineOptions defPipelineOpts{defGpuBackend};
   passManager.addPass(tpp::createDefaultPipeline(defPipelineOpts));
 
+  if (!compileTimeReport.empty())
+    compileTimes.attach(passManager);
+
+  auto start = std::chrono::steady_clock::now();
   auto result = passManager.run(module);
+  mlirCompileTime = getElapsedSeconds(start);
+  compileTimes.addPhase("mlir", mlirCompileTime);
   if (failed(result)) {
     llvm::errs() << "ERROR: Failed to lower IR to LLVM dialect\n";
     module->print(llvm::errs());
     return result;
   }
 
+  if (!emitKind.empty())
+    return finishAheadOfTime(compileAheadOfTime(module));
+  if (entrySignature)
+    runKernelEntry(module, *entrySignature);
+
+  // A cached module would refer to the resources of this run
+  if (mapResources && cacheEntryPath.empty())
+    mapResourceGlobals(module);
+
   return success();
 }
 
-std::unique_ptr<llvm::Module> lowerToLLVMIR(Operation *module,
-                                            llvm::LLVMContext &llvmContext) {
-  // Default lowering for mlir-cpu-runner
-  auto llvmModule = translateModuleToLLVMIR(module, llvmContext);
-  assert(llvmModule);
+// Creates the target machine of the triple, CPU and FPU options
+static std::unique_ptr<llvm::TargetMachine> createTargetMachine() {
+  std::string error;
+  const llvm::Target *target = llvm::TargetRegistry::lookupTarget(triple, error);
+  if (!target) {
+    llvm::errs() << "Error while looking up target triple: ";
+    llvm::errs() << error << "\n";
+    return nullptr;
+  }
 
-  // Target machine, null if not specified
-  std::unique_ptr<llvm::TargetMachine> targetMachine;
+  auto codeGenOpt = (llvm::CodeGenOptLevel)optLevel.getValue();
 
-  // Specify target machine
-  if (!triple.empty() && !cpuName.empty()) {
-    std::string error;
-    const llvm::Target *target =
-        llvm::TargetRegistry::lookupTarget(triple, error);
-    if (!target) {
-      llvm::errs() << "Error while looking up target triple: ";
+  // Shared libraries need position independent code
+  std::optional<llvm::Reloc::Model> relocModel;
+  if (emitKind == "so")
+    relocModel = llvm::Reloc::PIC_;
+
+  // These options should force fused MLA, but they don't. :/
+  // Adding unsafe math attribute to functions below do the trick.
+  llvm::TargetOptions targetOptions;
+  targetOptions.UnsafeFPMath = true;
+  targetOptions.AllowFPOpFusion = llvm::FPOpFusion::FPOpFusionMode::Fast;
+  std::unique_ptr<llvm::TargetMachine> targetMachine(
+      target->createTargetMachine(triple, cpuName, "+" + fpuName,
+                                  targetOptions, relocModel,
+                                  /* code model */ std::nullopt, codeGenOpt));
+  if (!targetMachine) {
+    llvm::errs() << "Error while looking up target CPU: ";
+    llvm::errs() << cpuName << "\n";
+    return nullptr;
+  }
+  return targetMachine;
+}
+
+// Links object files into a shared library against the TPP and MLIR
+// runtimes. The C compiler driver can be changed with the CC variable.
+static LogicalResult linkSharedLibrary(ArrayRef<std::string> objPaths,
+                                       StringRef output) {
+  const char *ccEnv = getenv("CC");
+  auto cc = llvm::sys::findProgramByName(ccEnv ? ccEnv : "cc");
+  if (!cc) {
+    llvm::errs() << "Error while looking up the C compiler driver: "
+                 << cc.getError().message() << "\n";
+    return failure();
+  }
+
+  std::string tppLibDir = "-L" TPP_RUNTIME_LIB_DIR;
+  std::string tppRpath = "-Wl,-rpath," TPP_RUNTIME_LIB_DIR;
+  std::string mlirLibDir = "-L" MLIR_RUNTIME_LIB_DIR;
+  std::string mlirRpath = "-Wl,-rpath," MLIR_RUNTIME_LIB_DIR;
+  SmallVector<StringRef> args{*cc, "-shared", "-o", output};
+  args.append(objPaths.begin(), objPaths.end());
+  args.append({tppLibDir, tppRpath, "-ltpp_xsmm_runner_utils", mlirLibDir,
+               mlirRpath, "-lmlir_c_runner_utils"});
+  // The optional runtimes of the build: oneDNN and OpenMP
+  StringRef(AOT_RUNTIME_LIBS).split(args, ' ', /*MaxSplit=*/-1,
+                                    /*KeepEmpty=*/false);
+  std::string errMsg;
+  int ret = llvm::sys::ExecuteAndWait(*cc, args, /*Env=*/std::nullopt,
+                                      /*Redirects=*/{}, /*SecondsToWait=*/0,
+                                      /*MemoryLimit=*/0, &errMsg);
+  if (ret != 0) {
+    llvm::errs() << "Error while linking " << output << ": " << errMsg
+                 << "\n";
+    return failure();
+  }
+  return success();
+}
+
+// Compiles the optimized module to a relocatable object or a shared library.
+// Shared libraries are generated in parallel, one object per compile thread.
+static LogicalResult emitAheadOfTime(llvm::Module &llvmModule) {
+  auto targetMachine = createTargetMachine();
+  if (!targetMachine)
+    return failure();
+  llvmModule.setDataLayout(targetMachine->createDataLayout());
+  llvmModule.setTargetTriple(targetMachine->getTargetTriple().str());
+
+  std::string output = emitOutput;
+  if (output.empty())
+    output = reportKernelName + (emitKind == "so" ? ".so" : ".o");
+
+  // Shared libraries are linked from temporary objects
+  unsigned numObjects =
+      emitKind == "so" ? std::max(compileThreads.getValue(), 1u) : 1;
+  SmallVector<std::string> objPaths;
+  if (emitKind == "so") {
+    for (unsigned i = 0; i < numObjects; i++) {
+      SmallString<128> objPath;
+      if (auto err =
+              llvm::sys::fs::createTemporaryFile("tpp-run", "o", objPath)) {
+        llvm::errs() << "Error while creating a temporary object: "
+                     << err.message() << "\n";
+        return failure();
+      }
+      objPaths.push_back(std::string(objPath));
+    }
+  } else {
+    objPaths.push_back(output);
+  }
+  auto removeObjects = [&]() {
+    if (emitKind == "so")
+      for (auto &objPath : objPaths)
+        llvm::sys::fs::remove(objPath);
+  };
+
+  {
+    SmallVector<std::unique_ptr<llvm::raw_fd_ostream>> streams;
+    for (auto &objPath : objPaths) {
+      std::error_code err;
+      streams.push_back(std::make_unique<llvm::raw_fd_ostream>(
+          objPath, err, llvm::sys::fs::OF_None));
+      if (err) {
+        llvm::errs() << "Error while opening " << objPath << ": "
+                     << err.message() << "\n";
+        removeObjects();
+        return failure();
+      }
+    }
+
+    if (numObjects > 1) {
+      SmallVector<llvm::raw_pwrite_stream *> objStreams;
+      for (auto &stream : streams)
+        objStreams.push_back(stream.get());
+      llvm::splitCodeGen(llvmModule, objStreams, /*BCOSs=*/{},
+                         createTargetMachine,
+                         llvm::CodeGenFileType::ObjectFile);
+    } else {
+      llvm::legacy::PassManager codegenPasses;
+      if (targetMachine->addPassesToEmitFile(
+              codegenPasses, *streams.front(), nullptr,
+              llvm::CodeGenFileType::ObjectFile)) {
+        llvm::errs() << "Error: target cannot emit object files\n";
+        removeObjects();
+        return failure();
+      }
+      codegenPasses.run(llvmModule);
+    }
+  }
+
+  if (emitKind != "so")
+    return success();
+
+  auto result = linkSharedLibrary(objPaths, output);
+  removeObjects();
+  return result;
+}
+
+// Optimizes the module with one partition per compile thread. LLVM contexts
+// are not thread-safe, so each partition is moved through bitcode to its own
+// context and linked back once optimized. Calls across partitions are not
+// inlined.
+static std::unique_ptr<llvm::Module>
+optimizeInParallel(std::unique_ptr<llvm::Module> llvmModule) {
+  SmallVector<SmallString<0>> partitions;
+  llvm::SplitModule(*llvmModule, compileThreads,
+                    [&](std::unique_ptr<llvm::Module> partition) {
+                      llvm::raw_svector_ostream os(partitions.emplace_back());
+                      llvm::WriteBitcodeToFile(*partition, os);
+                    });
+
+  SmallVector<std::string> errors(partitions.size());
+  llvm::parallel::strategy = llvm::hardware_concurrency(compileThreads);
+  llvm::parallelFor(0, partitions.size(), [&](size_t i) {
+    llvm::LLVMContext context;
+    auto partition = llvm::parseBitcodeFile(
+        llvm::MemoryBufferRef(partitions[i], "partition"), context);
+    if (!partition) {
+      errors[i] = llvm::toString(partition.takeError());
+      return;
+    }
+
+    // Target machines are not shared across threads
+    std::unique_ptr<llvm::TargetMachine> targetMachine;
+    if (!triple.empty() && !cpuName.empty()) {
+      targetMachine = createTargetMachine();
+      if (!targetMachine) {
+        errors[i] = "invalid target";
+        return;
+      }
+    }
+
+    int sizeLevel = 0;
+    auto optPipeline =
+        makeOptimizingTransformer(optLevel, sizeLevel, targetMachine.get());
+    if (auto err = optPipeline(partition->get())) {
+      errors[i] = llvm::toString(std::move(err));
+      return;
+    }
+
+    partitions[i].clear();
+    llvm::raw_svector_ostream os(partitions[i]);
+    llvm::WriteBitcodeToFile(**partition, os);
+  });
+
+  for (auto &error : errors) {
+    if (!error.empty()) {
+      llvm::errs() << "Error while passing through the LLVM pipeline: ";
       llvm::errs() << error << "\n";
       return nullptr;
     }
+  }
 
-    auto codeGenOpt = (llvm::CodeGenOptLevel)optLevel.getValue();
-
-    // These options should force fused MLA, but they don't. :/
-    // Adding unsafe math attribute to functions below do the trick.
-    llvm::TargetOptions targetOptions;
-    targetOptions.UnsafeFPMath = true;
-    targetOptions.AllowFPOpFusion = llvm::FPOpFusion::FPOpFusionMode::Fast;
-    targetMachine.reset(target->createTargetMachine(
-        triple, cpuName, "+" + fpuName, targetOptions,
-        /* reloc model */ std::nullopt,
-        /* code model */ std::nullopt, codeGenOpt));
-    if (!targetMachine) {
-      llvm::errs() << "Error while looking up target CPU: ";
-      llvm::errs() << cpuName << "\n";
+  // Link the optimized partitions back into the original context
+  auto &llvmContext = llvmModule->getContext();
+  auto merged = std::make_unique<llvm::Module>(
+      llvmModule->getModuleIdentifier(), llvmContext);
+  merged->setDataLayout(llvmModule->getDataLayout());
+  merged->setTargetTriple(llvmModule->getTargetTriple());
+  llvm::Linker linker(*merged);
+  for (auto &partition : partitions) {
+    auto part = llvm::parseBitcodeFile(
+        llvm::MemoryBufferRef(partition, "partition"), llvmContext);
+    if (!part || linker.linkInModule(std::move(*part))) {
+      if (!part)
+        llvm::consumeError(part.takeError());
+      llvm::errs() << "Error while linking the optimized partitions\n";
       return nullptr;
     }
   }
+  return merged;
+}
 
-  // Run the optimized pipeline
-  int sizeLevel = 0;
-  auto optPipeline =
-      makeOptimizingTransformer(optLevel, sizeLevel, targetMachine.get());
-  if (auto err = optPipeline(llvmModule.get())) {
-    llvmModule->print(llvm::errs(), nullptr);
-    llvm::errs() << "Error while passing through the LLVM pipeline: ";
-    llvm::errs() << err << "\n";
+// Loads an optimized module from the compilation cache
+static std::unique_ptr<llvm::Module>
+loadCachedModule(StringRef entryPath, llvm::LLVMContext &llvmContext) {
+  auto buffer = llvm::MemoryBuffer::getFile(entryPath);
+  if (!buffer) {
+    llvm::errs() << "Error while reading cached module " << entryPath << ": "
+                 << buffer.getError().message() << "\n";
     return nullptr;
   }
+  auto llvmModule =
+      llvm::parseBitcodeFile(buffer.get()->getMemBufferRef(), llvmContext);
+  if (!llvmModule) {
+    llvm::errs() << "Error while parsing cached module " << entryPath << ": "
+                 << llvm::toString(llvmModule.takeError()) << "\n";
+    return nullptr;
+  }
+  return std::move(llvmModule.get());
+}
+
+// Stores an optimized module in the compilation cache. Written to a unique
+// file first, so that concurrent runs never see a partial entry.
+static void storeCachedModule(llvm::Module &llvmModule, StringRef entryPath) {
+  auto dir = llvm::sys::path::parent_path(entryPath);
+  if (auto err = llvm::sys::fs::create_directories(dir)) {
+    llvm::errs() << "Warning: cannot create compile cache " << dir << ": "
+                 << err.message() << "\n";
+    return;
+  }
+
+  int fd;
+  SmallString<128> tmpPath;
+  if (llvm::sys::fs::createUniqueFile(entryPath + ".%%%%%%", fd, tmpPath))
+    return;
+  {
+    llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+    llvm::WriteBitcodeToFile(llvmModule, os);
+  }
+  if (llvm::sys::fs::rename(tmpPath, entryPath))
+    llvm::sys::fs::remove(tmpPath);
+}
+
+// Runs the LLVM optimization pipeline, split across threads if asked to.
+static std::unique_ptr<llvm::Module>
+optimizeLLVMModule(std::unique_ptr<llvm::Module> llvmModule) {
+  // Target machine, null if not specified
+  std::unique_ptr<llvm::TargetMachine> targetMachine;
+
+  // Specify target machine
+  if (!triple.empty() && !cpuName.empty()) {
+    targetMachine = createTargetMachine();
+    if (!targetMachine)
+      return nullptr;
+  }
+
+  if (compileThreads > 1) {
+    llvmModule = optimizeInParallel(std::move(llvmModule));
+    if (!llvmModule)
+      return nullptr;
+  } else {
+    int sizeLevel = 0;
+    auto optPipeline =
+        makeOptimizingTransformer(optLevel, sizeLevel, targetMachine.get());
+    if (auto err = optPipeline(llvmModule.get())) {
+      llvmModule->print(llvm::errs(), nullptr);
+      llvm::errs() << "Error while passing through the LLVM pipeline: ";
+      llvm::errs() << err << "\n";
+      return nullptr;
+    }
+  }
 
   // MLIR doesn't lower LLVM with fast-math flags, but we need that, so we
   // add for each function, to get FMAs and other goodies.
   for (auto &func : llvmModule->functions()) {
     func.addFnAttr("unsafe-fp-math", "true");
   }
+  return llvmModule;
+}
+
+// Current and peak resident set of the process, in bytes. The peak covers
+// the time since the last resetPeakRss, where Linux supports it.
+static void readRss(uint64_t &current, uint64_t &peak) {
+  current = peak = 0;
+  auto status = llvm::MemoryBuffer::getFileAsStream("/proc/self/status");
+  if (!status)
+    return;
+  SmallVector<StringRef> lines;
+  (*status)->getBuffer().split(lines, '\n');
+  for (StringRef line : lines) {
+    uint64_t *value = line.starts_with("VmRSS:")   ? &current
+                      : line.starts_with("VmHWM:") ? &peak
+                                                   : nullptr;
+    if (!value)
+      continue;
+    uint64_t kiloBytes = 0;
+    StringRef digits = line.drop_until(llvm::isDigit).take_while(llvm::isDigit);
+    (void)digits.getAsInteger(10, kiloBytes);
+    *value = kiloBytes * 1024;
+  }
+}
+
+static void resetPeakRss() {
+  std::error_code err;
+  llvm::raw_fd_ostream clearRefs("/proc/self/clear_refs", err);
+  if (!err)
+    clearRefs << "5";
+}
+
+// Symbols of the kernel functions of the wrapper, which moves the one named
+// after the entry point to a local name.
+static SmallVector<std::string> getKernelSymbols() {
+  SmallVector<std::string> symbols;
+  if (kernelNames.empty())
+    symbols.push_back("_" + reportKernelName);
+  for (auto &name : kernelNames)
+    symbols.push_back(name == reportKernelName ? "_" + name : name);
+  return symbols;
+}
+
+// Marks the calls of the kernels for the memory runtime. This is done before
+// the optimizations, which may inline the kernels into the wrapper.
+static void markKernelCalls(llvm::Module &llvmModule) {
+  auto &ctx = llvmModule.getContext();
+  auto *fnType = llvm::FunctionType::get(llvm::Type::getVoidTy(ctx), false);
+  auto begin =
+      llvmModule.getOrInsertFunction("tpp_memory_kernel_begin", fnType);
+  auto end = llvmModule.getOrInsertFunction("tpp_memory_kernel_end", fnType);
+  for (auto &symbol : getKernelSymbols()) {
+    llvm::Function *kernel = llvmModule.getFunction(symbol);
+    if (!kernel || kernel->isDeclaration())
+      continue;
+    llvm::IRBuilder<> builder(&*kernel->getEntryBlock().getFirstInsertionPt());
+    builder.CreateCall(begin);
+    for (auto &block : *kernel) {
+      if (auto *ret = dyn_cast<llvm::ReturnInst>(block.getTerminator())) {
+        builder.SetInsertPoint(ret);
+        builder.CreateCall(end);
+      }
+    }
+  }
+}
+
+// Redirects the allocations of the module to the memory runtime. This is done
+// after the optimizations, which know the semantics of the allocation
+// functions and remove the unused ones.
+static void trackAllocations(llvm::Module &llvmModule) {
+  const std::pair<StringRef, StringRef> functions[] = {
+      {"malloc", "tpp_memory_malloc"},
+      {"aligned_alloc", "tpp_memory_aligned_alloc"},
+      {"free", "tpp_memory_free"}};
+  for (auto &[name, tracked] : functions) {
+    llvm::Function *fn = llvmModule.getFunction(name);
+    if (fn && fn->isDeclaration())
+      fn->setName(tracked);
+  }
+}
+
+// Prints the resident set of the compilation and of the execution, and the
+// heap allocations of the kernels and of the benchmark harness.
+static void printMemoryReport() {
+  auto toMiB = [](uint64_t bytes) { return bytes / (1024.0 * 1024.0); };
+  uint64_t runRss, runPeakRss;
+  readRss(runRss, runPeakRss);
+  TppMemoryStats stats;
+  tpp_memory_get_stats(&stats);
+  int64_t calls = std::max<int64_t>(stats.kernelCalls, 1);
+
+  llvm::errs() << "Memory report:\n";
+  llvm::errs() << llvm::format("  compile: RSS %.1f MiB, peak RSS %.1f MiB\n",
+                               toMiB(compileRss), toMiB(compilePeakRss));
+  llvm::errs() << llvm::format("  execute: RSS %.1f MiB, peak RSS %.1f MiB\n",
+                               toMiB(runRss), toMiB(runPeakRss));
+  llvm::errs() << llvm::format(
+      "  kernel: %lld calls, %.1f allocs (%.3f MiB) per call, "
+      "peak %.3f MiB\n",
+      static_cast<long long>(stats.kernelCalls),
+      static_cast<double>(stats.kernelAllocs) / calls,
+      toMiB(stats.kernelBytes) / calls, toMiB(stats.kernelPeakBytes));
+  llvm::errs() << llvm::format("  harness: %lld allocs (%.3f MiB)\n",
+                               static_cast<long long>(stats.harnessAllocs),
+                               toMiB(stats.harnessBytes));
+  llvm::errs() << llvm::format("  heap: peak %.3f MiB\n",
+                               toMiB(stats.peakBytes));
+}
+
+std::unique_ptr<llvm::Module> lowerToLLVMIR(Operation *module,
+                                            llvm::LLVMContext &llvmContext) {
+  auto start = std::chrono::steady_clock::now();
+
+  // Compiled on a previous run, the module is already optimized
+  if (!cachedModulePath.empty()) {
+    auto llvmModule = loadCachedModule(cachedModulePath, llvmContext);
+    if (llvmModule && printLLVM)
+      llvmModule->print(llvm::outs(), nullptr);
+    llvmCompileTime = getElapsedSeconds(start);
+    compileTimes.addPhase("cache_load", llvmCompileTime);
+    printCompileTimes();
+    if (llvmModule && outputFormat == "json")
+      setJsonReportHeader();
+    if (memoryReport) {
+      readRss(compileRss, compilePeakRss);
+      resetPeakRss();
+    }
+    return llvmModule;
+  }
+
+  // Default lowering for mlir-cpu-runner
+  auto llvmModule = translateModuleToLLVMIR(module, llvmContext);
+  assert(llvmModule);
+  compileTimes.addPhase("llvm_translate", getElapsedSeconds(start));
+  if (memoryReport)
+    markKernelCalls(*llvmModule);
+  auto optStart = std::chrono::steady_clock::now();
+  llvmModule = optimizeLLVMModule(std::move(llvmModule));
+  if (!llvmModule)
+    return nullptr;
+  compileTimes.addPhase("llvm_opt", getElapsedSeconds(optStart));
+  if (memoryReport)
+    trackAllocations(*llvmModule);
 
   if (printLLVM)
     llvmModule->print(llvm::outs(), nullptr);
 
+  if (!cacheEntryPath.empty())
+    storeCachedModule(*llvmModule, cacheEntryPath);
+
+  llvmCompileTime = getElapsedSeconds(start);
+  printCompileTimes();
+  if (outputFormat == "json")
+    setJsonReportHeader();
+
+  // The compilation ends here, the JIT code generation counts as execution
+  if (memoryReport) {
+    readRss(compileRss, compilePeakRss);
+    resetPeakRss();
+  }
+
   return llvmModule;
 }
 
+// Writes the compile time report of the ahead-of-time compilation, whose
+// code generation failed or not.
+static llvm::Error finishCompileTimes(bool codegenFailed) {
+  if (!compileTimeReport.empty() &&
+      mlir::failed(compileTimes.write(compileTimeReport)))
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Failed to write the compile times to " +
+                                       compileTimeReport);
+  llvm::outs().flush();
+  if (codegenFailed)
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Failed to emit " + reportKernelName);
+  return llvm::Error::success();
+}
+
+// JitRunnerMain always runs the entry point, which a kernel returning memrefs
+// doesn't even qualify for. Ahead-of-time compilation lowers the module from
+// the MLIR transformer instead and writes the output.
+static llvm::Error compileAheadOfTime(ModuleOp module) {
+  llvm::LLVMContext llvmContext;
+  auto llvmModule = lowerToLLVMIR(module, llvmContext);
+  if (!llvmModule)
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Failed to lower " + reportKernelName +
+                                       " to LLVM IR");
+  auto start = std::chrono::steady_clock::now();
+  bool failed = mlir::failed(emitAheadOfTime(*llvmModule));
+  compileTimes.addPhase("codegen", getElapsedSeconds(start));
+  return finishCompileTimes(failed);
+}
+
+// Like ahead-of-time compilation, the kernel server and the concurrent
+// benchmark run from the MLIR transformer: they JIT-compile the lowered module
+// into a kernel of the engine library and exit once done.
+static void runKernelEntry(ModuleOp module,
+                           const tpp::KernelSignature &signature) {
+  ExecutionEngineOptions engineOptions;
+  engineOptions.llvmModuleBuilder = lowerToLLVMIR;
+  engineOptions.jitCodeGenOptLevel =
+      static_cast<llvm::CodeGenOptLevel>(optLevel.getValue());
+  auto kernel = tpp::Kernel::create(module, signature, engineOptions);
+  if (failed(kernel))
+    std::exit(EXIT_FAILURE);
+  if (!concurrentKernels)
+    tpp::serveKernel(**kernel, serveSocket);
+
+  // The teams split the CPUs of -bind-threads, or all of them.
+  SmallVector<unsigned> cpus = threadCpus;
+  if (cpus.empty()) {
+    auto allCpus = tpp::getThreadCpus("compact", /*noSmt=*/false);
+    if (failed(allCpus))
+      std::exit(EXIT_FAILURE);
+    cpus = std::move(*allCpus);
+  }
+  tpp::benchConcurrentKernels(**kernel, concurrentKernels, cpus,
+                              benchNumLoops);
+}
+
+// Clones the module with only the body of `func`, the other functions become
+// declarations. The public globals are only defined by the first unit, the
+// other ones declare them.
+static OwningOpRef<ModuleOp>
+createFunctionUnit(ModuleOp module, func::FuncOp func, bool definesGlobals) {
+  OpBuilder builder(module.getContext());
+  OwningOpRef<ModuleOp> unit =
+      cast<ModuleOp>(builder.cloneWithoutRegions(*module.getOperation()));
+  builder.setInsertionPointToStart(&unit->getBodyRegion().emplaceBlock());
+  for (Operation &op : module.getBody()->getOperations()) {
+    auto other = dyn_cast<func::FuncOp>(op);
+    if (other && other != func && !other.isDeclaration()) {
+      auto decl = other.cloneWithoutRegions();
+      decl.setPrivate();
+      builder.insert(decl);
+      continue;
+    }
+    Operation *clone = builder.clone(op);
+    if (other == func)
+      cast<func::FuncOp>(clone).setPublic();
+    auto global = dyn_cast<memref::GlobalOp>(clone);
+    if (global && global.isPublic() && !definesGlobals)
+      global.removeInitialValueAttr();
+  }
+  return unit;
+}
+
+// Compiles a unit of createFunctionUnit to an optimized LLVM module. All its
+// definitions are internal but the ones it exports, so that the units can be
+// linked together.
+static std::unique_ptr<llvm::Module>
+compileFunctionUnit(ModuleOp unit, const llvm::StringSet<> &exported,
+                    llvm::LLVMContext &llvmContext) {
+  PassManager passManager(unit.getContext());
+  if (failed(applyPassManagerCLOptions(passManager)))
+    return nullptr;
+  passManager.addPass(
+      tpp::createDefaultPipeline(tpp::DefaultPipelineOptions{defGpuBackend}));
+  if (!compileTimeReport.empty())
+    compileTimes.attach(passManager);
+
+  auto start = std::chrono::steady_clock::now();
+  auto result = passManager.run(unit);
+  double seconds = getElapsedSeconds(start);
+  mlirCompileTime += seconds;
+  compileTimes.addPhase("mlir", seconds);
+  if (failed(result)) {
+    llvm::errs() << "ERROR: Failed to lower IR to LLVM dialect\n";
+    unit->print(llvm::errs());
+    return nullptr;
+  }
+
+  auto llvmStart = std::chrono::steady_clock::now();
+  auto llvmModule = translateModuleToLLVMIR(unit, llvmContext);
+  if (!llvmModule)
+    return nullptr;
+  for (llvm::GlobalValue &global : llvmModule->global_values()) {
+    if (!global.isDeclaration() && !exported.contains(global.getName()))
+      global.setLinkage(llvm::GlobalValue::InternalLinkage);
+  }
+  compileTimes.addPhase("llvm_translate", getElapsedSeconds(llvmStart));
+
+  auto optStart = std::chrono::steady_clock::now();
+  llvmModule = optimizeLLVMModule(std::move(llvmModule));
+  compileTimes.addPhase("llvm_opt", getElapsedSeconds(optStart));
+  llvmCompileTime += getElapsedSeconds(llvmStart);
+  return llvmModule;
+}
+
+// Ahead-of-time compilation, one function at a time. Each function is cached
+// with the declarations of the rest of the module, so that changing a
+// function only recompiles that one. The units are then linked and emitted.
+static llvm::Error compileFunctionsAheadOfTime(ModuleOp module) {
+  llvm::StringSet<> globals;
+  for (auto global : module.getOps<memref::GlobalOp>()) {
+    if (global.isPublic() && !global.isExternal())
+      globals.insert(global.getSymName());
+  }
+
+  llvm::LLVMContext llvmContext;
+  auto linked = std::make_unique<llvm::Module>("tpp-run", llvmContext);
+  llvm::Linker linker(*linked);
+  unsigned numFunctions = 0;
+  unsigned numCached = 0;
+  bool failed = false;
+  for (auto func : module.getOps<func::FuncOp>()) {
+    if (func.isDeclaration())
+      continue;
+    auto unit = createFunctionUnit(module, func, numFunctions++ == 0);
+    auto entryPath = getCacheEntryPath(*unit);
+
+    std::unique_ptr<llvm::Module> llvmModule;
+    if (llvm::sys::fs::exists(entryPath)) {
+      auto start = std::chrono::steady_clock::now();
+      llvmModule = loadCachedModule(entryPath, llvmContext);
+      compileTimes.addPhase("cache_load", getElapsedSeconds(start));
+      numCached++;
+    } else {
+      llvm::StringSet<> exported;
+      if (numFunctions == 1)
+        exported = globals;
+      exported.insert(func.getSymName());
+      exported.insert(("_mlir_ciface_" + func.getSymName()).str());
+      llvmModule = compileFunctionUnit(*unit, exported, llvmContext);
+      if (llvmModule)
+        storeCachedModule(*llvmModule, entryPath);
+    }
+    if (llvmModule && numFunctions == 1) {
+      linked->setDataLayout(llvmModule->getDataLayout());
+      linked->setTargetTriple(llvmModule->getTargetTriple());
+    }
+    if (!llvmModule || linker.linkInModule(std::move(llvmModule))) {
+      llvm::errs() << "Error while compiling function " << func.getSymName()
+                   << "\n";
+      failed = true;
+      break;
+    }
+  }
+
+  if (printCompileTime)
+    llvm::errs() << "Compile cache: " << numCached << " of " << numFunctions
+                 << " functions reused\n";
+  printCompileTimes();
+  if (!failed) {
+    if (printLLVM)
+      linked->print(llvm::outs(), nullptr);
+    auto start = std::chrono::steady_clock::now();
+    failed = mlir::failed(emitAheadOfTime(*linked));
+    compileTimes.addPhase("codegen", getElapsedSeconds(start));
+  }
+  return finishCompileTimes(failed);
+}
+
 LogicalResult emitError(StringRef msg) {
   llvm::errs() << "ERROR: " << msg << "\n";
   return failure();
@@ -270,6 +1865,13 @@ int main(int argc, char **argv) {
   if (failed(validateInput()))
     return 1;
 
+  for (int i = 1; i < argc; i++) {
+    commandLine += std::string(argv[i]) + '\0';
+    toolArgs.push_back(argv[i]);
+  }
+  toolPath = llvm::sys::fs::getMainExecutable(
+      argv[0], (void *)(intptr_t)&prepareMLIRKernel);
+
   // Initialize the LLVM machinery
   llvm::InitLLVM y(argc, argv);
   llvm::InitializeNativeTarget();
@@ -305,7 +1907,17 @@ int main(int argc, char **argv) {
   JitRunnerConfig config;
   config.mlirTransformer = prepareMLIRKernel;
   config.llvmModuleBuilder = lowerToLLVMIR;
+  config.runtimeSymbolMap = getMappedResources;
 
   // Call the main JIT function
-  return JitRunnerMain(argc, argv, registry, config);
+  int ret = JitRunnerMain(argc, argv, registry, config);
+  if (transformerDone)
+    ret = EXIT_SUCCESS;
+  if (memoryReport && ret == 0)
+    printMemoryReport();
+  if (!baselineFile.empty() && ret == 0 &&
+      failed(tpp::checkRegression(baselineFile, getJsonReportHeader(),
+                                  baselineSlowdown)))
+    ret = 1;
+  return waitForRanks(ret);
 }